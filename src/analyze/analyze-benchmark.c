@@ -0,0 +1,592 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "analyze-benchmark.h"
+#include "bus-error.h"
+#include "bus-message.h"
+#include "fileio.h"
+#include "format-table.h"
+#include "hashmap.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "log.h"
+#include "manager.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+
+/* Microbenchmarks of the building blocks whose speed matters most during boot. Each benchmark prepares what it
+ * needs, then times 'n' repetitions of one operation. The sizes are fixed, so that the numbers can be compared
+ * between machines, kernels and versions. */
+
+typedef struct Benchmark {
+        const char *name;
+        const char *operation;
+        unsigned n;
+        int (*run)(unsigned n, usec_t *ret);
+} Benchmark;
+
+/* The unit graph used for loading and transactions is a binary tree, every unit pulls in two more */
+#define BENCHMARK_UNITS 1023U
+
+static int write_units(const char *dir, unsigned n) {
+        unsigned i;
+        int r;
+
+        for (i = 0; i < n; i++) {
+                _cleanup_free_ char *name = NULL, *path = NULL, *deps = NULL, *contents = NULL;
+
+                if (asprintf(&name, "bench-%u.service", i) < 0)
+                        return -ENOMEM;
+
+                if (2 * i + 2 < n)
+                        r = asprintf(&deps, "bench-%u.service bench-%u.service", 2 * i + 1, 2 * i + 2);
+                else if (2 * i + 1 < n)
+                        r = asprintf(&deps, "bench-%u.service", 2 * i + 1);
+                else
+                        r = 0;
+                if (r < 0)
+                        return -ENOMEM;
+
+                if (asprintf(&contents,
+                             "[Unit]\n"
+                             "Description=Benchmark unit %u\n"
+                             "%s%s%s"
+                             "%s%s%s"
+                             "\n[Service]\n"
+                             "Type=oneshot\n"
+                             "Environment=BENCHMARK=%u\n"
+                             "ExecStart=/bin/true\n",
+                             i,
+                             deps ? "Requires=" : "", strempty(deps), deps ? "\n" : "",
+                             deps ? "After=" : "", strempty(deps), deps ? "\n" : "",
+                             i) < 0)
+                        return -ENOMEM;
+
+                path = path_join(dir, name);
+                if (!path)
+                        return -ENOMEM;
+
+                r = write_string_file(path, contents, WRITE_STRING_FILE_CREATE);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int benchmark_manager_new(const char *dir, Manager **ret) {
+        _cleanup_(manager_freep) Manager *m = NULL;
+        int r;
+
+        r = write_units(dir, BENCHMARK_UNITS);
+        if (r < 0)
+                return r;
+
+        /* Only look at our own units */
+        if (setenv("SYSTEMD_UNIT_PATH", dir, true) < 0)
+                return -errno;
+
+        r = manager_new(UNIT_FILE_SYSTEM, MANAGER_TEST_RUN_MINIMAL, &m);
+        if (r < 0)
+                return r;
+
+        r = manager_startup(m, NULL, NULL);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(m);
+        return 0;
+}
+
+static int benchmark_unit_load(unsigned n, usec_t *ret) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        assert(n <= BENCHMARK_UNITS);
+
+        r = mkdtemp_malloc("/tmp/systemd-analyze-XXXXXX", &dir);
+        if (r < 0)
+                return r;
+
+        r = benchmark_manager_new(dir, &m);
+        if (r < 0)
+                return r;
+
+        /* Go from the leaves to the root, so that each call loads exactly one unit */
+        t = now(CLOCK_MONOTONIC);
+        for (i = n; i > 0; i--) {
+                _cleanup_free_ char *name = NULL;
+
+                if (asprintf(&name, "bench-%u.service", i - 1) < 0)
+                        return -ENOMEM;
+
+                r = manager_load_unit(m, name, NULL, NULL, NULL);
+                if (r < 0)
+                        return r;
+        }
+        *ret = now(CLOCK_MONOTONIC) - t;
+
+        return 0;
+}
+
+static int benchmark_transaction(unsigned n, usec_t *ret) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        usec_t total = 0;
+        unsigned i;
+        Unit *u;
+        int r;
+
+        r = mkdtemp_malloc("/tmp/systemd-analyze-XXXXXX", &dir);
+        if (r < 0)
+                return r;
+
+        r = benchmark_manager_new(dir, &m);
+        if (r < 0)
+                return r;
+
+        r = manager_load_unit(m, "bench-0.service", NULL, NULL, &u);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+                usec_t t;
+
+                t = now(CLOCK_MONOTONIC);
+                r = manager_add_job(m, JOB_START, u, JOB_REPLACE, &error, NULL);
+                total += now(CLOCK_MONOTONIC) - t;
+                if (r < 0)
+                        return log_error_errno(r, "Failed to build transaction: %s", bus_error_message(&error, r));
+
+                manager_clear_jobs(m);
+        }
+
+        *ret = total;
+        return 0;
+}
+
+static int benchmark_hashmap(unsigned n, usec_t *ret, unsigned step) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        unsigned i, s;
+        usec_t t = 0;
+        int r;
+
+        /* step 0: put, 1: get, 2: remove; the steps before the one measured are run untimed */
+
+        h = hashmap_new(NULL);
+        if (!h)
+                return -ENOMEM;
+
+        for (s = 0; s <= step; s++) {
+                t = now(CLOCK_MONOTONIC);
+
+                for (i = 1; i <= n; i++)
+                        switch (s) {
+
+                        case 0:
+                                r = hashmap_put(h, UINT_TO_PTR(i), UINT_TO_PTR(i));
+                                if (r < 0)
+                                        return r;
+                                break;
+
+                        case 1:
+                                if (hashmap_get(h, UINT_TO_PTR(i)) != UINT_TO_PTR(i))
+                                        return -EBADMSG;
+                                break;
+
+                        case 2:
+                                if (hashmap_remove(h, UINT_TO_PTR(i)) != UINT_TO_PTR(i))
+                                        return -EBADMSG;
+                                break;
+                        }
+
+                t = now(CLOCK_MONOTONIC) - t;
+        }
+
+        *ret = t;
+        return 0;
+}
+
+static int benchmark_hashmap_put(unsigned n, usec_t *ret) {
+        return benchmark_hashmap(n, ret, 0);
+}
+
+static int benchmark_hashmap_get(unsigned n, usec_t *ret) {
+        return benchmark_hashmap(n, ret, 1);
+}
+
+static int benchmark_hashmap_remove(unsigned n, usec_t *ret) {
+        return benchmark_hashmap(n, ret, 2);
+}
+
+static int benchmark_bus_open(sd_bus **ret) {
+        int r;
+
+        r = sd_bus_open_system(ret);
+        if (r < 0)
+                r = sd_bus_open_user(ret);
+
+        return r;
+}
+
+static int benchmark_bus_message(sd_bus *bus, sd_bus_message **ret) {
+        static const uint64_t array[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        int r;
+
+        r = sd_bus_message_new_method_call(bus, &m, "org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                           "org.freedesktop.systemd1.Manager", "Benchmark");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append(m, "sas", "benchmark.service", 4, "foo", "bar", "waldo", "piep");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append_array(m, 't', array, sizeof(array));
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_seal(m, 1, 0);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(m);
+        return 0;
+}
+
+static int benchmark_bus_marshal(unsigned n, usec_t *ret) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        r = benchmark_bus_open(&bus);
+        if (r < 0)
+                return r;
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                r = benchmark_bus_message(bus, &m);
+                if (r < 0)
+                        return r;
+        }
+        *ret = now(CLOCK_MONOTONIC) - t;
+
+        return 0;
+}
+
+static int benchmark_bus_unmarshal(unsigned n, usec_t *ret) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ void *blob = NULL;
+        size_t size;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        r = benchmark_bus_open(&bus);
+        if (r < 0)
+                return r;
+
+        r = benchmark_bus_message(bus, &m);
+        if (r < 0)
+                return r;
+
+        r = bus_message_get_blob(m, &blob, &size);
+        if (r < 0)
+                return r;
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *p = NULL;
+                _cleanup_strv_free_ char **l = NULL;
+                const uint64_t *array;
+                const char *s;
+                void *copy;
+                size_t sz;
+
+                /* bus_message_from_malloc() takes possession of the buffer */
+                copy = memdup(blob, size);
+                if (!copy)
+                        return -ENOMEM;
+
+                r = bus_message_from_malloc(bus, copy, size, NULL, 0, NULL, &p);
+                if (r < 0) {
+                        free(copy);
+                        return r;
+                }
+
+                r = sd_bus_message_read(p, "s", &s);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_read_strv(p, &l);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_read_array(p, 't', (const void**) &array, &sz);
+                if (r < 0)
+                        return r;
+        }
+        *ret = now(CLOCK_MONOTONIC) - t;
+
+        return 0;
+}
+
+static int benchmark_bus_roundtrip(unsigned n, usec_t *ret) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        r = benchmark_bus_open(&bus);
+        if (r < 0)
+                return r;
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+
+                r = sd_bus_call_method(bus, "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus.Peer",
+                                       "Ping", &error, NULL, NULL);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to call Ping(): %s", bus_error_message(&error, r));
+        }
+        *ret = now(CLOCK_MONOTONIC) - t;
+
+        return 0;
+}
+
+static int benchmark_journal_fill(const char *path, unsigned n, usec_t *ret) {
+        JournalFile *f = NULL;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        r = journal_file_open(-1, path, O_RDWR|O_CREAT, 0644, true, UINT64_MAX, false, NULL, NULL, NULL, NULL, &f);
+        if (r < 0)
+                return r;
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                char message[STRLEN("MESSAGE=Benchmark message ") + DECIMAL_STR_MAX(unsigned)];
+                struct iovec iovec[3];
+                dual_timestamp ts;
+
+                xsprintf(message, "MESSAGE=Benchmark message %u", i);
+                iovec[0] = IOVEC_MAKE_STRING(message);
+                iovec[1] = IOVEC_MAKE_STRING("PRIORITY=6");
+                iovec[2] = IOVEC_MAKE_STRING("SYSLOG_IDENTIFIER=systemd-analyze");
+
+                dual_timestamp_get(&ts);
+
+                r = journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL);
+                if (r < 0)
+                        break;
+        }
+        t = now(CLOCK_MONOTONIC) - t;
+
+        (void) journal_file_close(f);
+
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = t;
+
+        return 0;
+}
+
+static int benchmark_journal_append(unsigned n, usec_t *ret) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_free_ char *path = NULL;
+        int r;
+
+        r = mkdtemp_malloc("/var/tmp/systemd-analyze-XXXXXX", &dir);
+        if (r < 0)
+                return r;
+
+        path = path_join(dir, "benchmark.journal");
+        if (!path)
+                return -ENOMEM;
+
+        return benchmark_journal_fill(path, n, ret);
+}
+
+static int benchmark_journal_read(unsigned n, usec_t *ret) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_free_ char *path = NULL;
+        JournalFile *f = NULL;
+        uint64_t p = 0;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        r = mkdtemp_malloc("/var/tmp/systemd-analyze-XXXXXX", &dir);
+        if (r < 0)
+                return r;
+
+        path = path_join(dir, "benchmark.journal");
+        if (!path)
+                return -ENOMEM;
+
+        r = benchmark_journal_fill(path, n, NULL);
+        if (r < 0)
+                return r;
+
+        r = journal_file_open(-1, path, O_RDONLY, 0, false, UINT64_MAX, false, NULL, NULL, NULL, NULL, &f);
+        if (r < 0)
+                return r;
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+                Object *o;
+
+                r = journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p);
+                if (r <= 0) {
+                        if (r == 0)
+                                r = -ENODATA;
+                        break;
+                }
+        }
+        t = now(CLOCK_MONOTONIC) - t;
+
+        (void) journal_file_close(f);
+
+        if (r < 0)
+                return r;
+
+        *ret = t;
+        return 0;
+}
+
+static int on_defer(sd_event_source *s, void *userdata) {
+        unsigned *counter = userdata;
+
+        (*counter)++;
+        return 0;
+}
+
+static int benchmark_event_dispatch(unsigned n, usec_t *ret) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        unsigned counter = 0;
+        usec_t t;
+        int r;
+
+        r = sd_event_new(&e);
+        if (r < 0)
+                return r;
+
+        r = sd_event_add_defer(e, &s, on_defer, &counter);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_enabled(s, SD_EVENT_ON);
+        if (r < 0)
+                return r;
+
+        t = now(CLOCK_MONOTONIC);
+        while (counter < n) {
+                r = sd_event_run(e, 0);
+                if (r < 0)
+                        return r;
+        }
+        *ret = now(CLOCK_MONOTONIC) - t;
+
+        return 0;
+}
+
+static const Benchmark benchmarks[] = {
+        { "unit-load",      "Load one unit file",                                 BENCHMARK_UNITS, benchmark_unit_load      },
+        { "transaction",    "Build a start transaction for 1023 units",           100,             benchmark_transaction    },
+        { "hashmap-put",    "Add an entry to a hashmap",                          1000000,         benchmark_hashmap_put    },
+        { "hashmap-get",    "Look up an entry in a hashmap",                      1000000,         benchmark_hashmap_get    },
+        { "hashmap-remove", "Remove an entry from a hashmap",                     1000000,         benchmark_hashmap_remove },
+        { "bus-marshal",    "Build and seal a method call message",               100000,          benchmark_bus_marshal    },
+        { "bus-unmarshal",  "Parse a method call message and read its arguments", 100000,          benchmark_bus_unmarshal  },
+        { "bus-roundtrip",  "Call Ping() on the bus broker",                      10000,           benchmark_bus_roundtrip  },
+        { "journal-append", "Append an entry with three fields to a journal",     100000,          benchmark_journal_append },
+        { "journal-read",   "Move to the next entry of a journal",                100000,          benchmark_journal_read   },
+        { "event-dispatch", "Dispatch an event source",                           1000000,         benchmark_event_dispatch },
+};
+
+int analyze_benchmark(char **names, bool json, JsonFormatFlags json_flags) {
+        _cleanup_(table_unrefp) Table *table = NULL;
+        char **name;
+        size_t i;
+        int r;
+
+        STRV_FOREACH(name, names) {
+                for (i = 0; i < ELEMENTSOF(benchmarks); i++)
+                        if (streq(*name, benchmarks[i].name))
+                                break;
+
+                if (i >= ELEMENTSOF(benchmarks))
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Unknown benchmark: %s", *name);
+        }
+
+        table = table_new("benchmark", "operation", "count", "time", "nsec-per-op", "ops-per-sec");
+        if (!table)
+                return log_oom();
+
+        (void) table_set_align_percent(table, TABLE_HEADER_CELL(2), 100);
+        (void) table_set_align_percent(table, TABLE_HEADER_CELL(3), 100);
+        (void) table_set_align_percent(table, TABLE_HEADER_CELL(4), 100);
+        (void) table_set_align_percent(table, TABLE_HEADER_CELL(5), 100);
+
+        for (i = 0; i < ELEMENTSOF(benchmarks); i++) {
+                const Benchmark *b = benchmarks + i;
+                usec_t t;
+
+                if (!strv_isempty(names) && !strv_contains(names, b->name))
+                        continue;
+
+                log_debug("Running benchmark %s...", b->name);
+
+                r = b->run(b->n, &t);
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0) {
+                        log_notice_errno(r, "Skipping benchmark %s: %m", b->name);
+                        continue;
+                }
+
+                r = table_add_many(table,
+                                   TABLE_STRING, b->name,
+                                   TABLE_STRING, b->operation,
+                                   TABLE_UINT64, (uint64_t) b->n,
+                                   TABLE_TIMESPAN, t,
+                                   TABLE_UINT64, (uint64_t) (t * NSEC_PER_USEC / b->n),
+                                   TABLE_UINT64, (uint64_t) (t > 0 ? b->n * USEC_PER_SEC / t : 0));
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add table row: %m");
+        }
+
+        if (json)
+                r = table_print_json(table, NULL, json_flags);
+        else
+                r = table_print(table, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to print table: %m");
+
+        return 0;
+}
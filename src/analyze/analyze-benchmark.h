@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "json.h"
+
+int analyze_benchmark(char **names, bool json, JsonFormatFlags json_flags);
@@ -12,6 +12,7 @@
 #include "sd-bus.h"
 
 #include "alloc-util.h"
+#include "analyze-benchmark.h"
 #include "analyze-security.h"
 #include "analyze-verify.h"
 #include "build.h"
@@ -22,10 +23,13 @@
 #include "conf-files.h"
 #include "copy.h"
 #include "def.h"
+#include "execute.h"
+#include "extract-word.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "glob-util.h"
 #include "hashmap.h"
+#include "json.h"
 #include "locale-util.h"
 #include "log.h"
 #include "main-func.h"
@@ -36,7 +40,10 @@
 #if HAVE_SECCOMP
 #  include "seccomp-util.h"
 #endif
+#include "signal-util.h"
 #include "special.h"
+#include "stdio-util.h"
+#include "string-util.h"
 #include "strv.h"
 #include "strxcpyx.h"
 #include "time-util.h"
@@ -78,6 +85,11 @@ static UnitFileScope arg_scope = UNIT_FILE_SYSTEM;
 static bool arg_man = true;
 static bool arg_generators = false;
 static const char *arg_root = NULL;
+static enum {
+        JSON_OFF,
+        JSON_SHORT,
+        JSON_PRETTY,
+} arg_json = JSON_OFF;
 
 STATIC_DESTRUCTOR_REGISTER(arg_dot_from_patterns, strv_freep);
 STATIC_DESTRUCTOR_REGISTER(arg_dot_to_patterns, strv_freep);
@@ -124,6 +136,25 @@ struct unit_times {
         usec_t deactivated;
         usec_t deactivating;
         usec_t time;
+        usec_t job_installed;
+        usec_t job_run;
+        usec_t cgroup_realize;
+        usec_t cgroup_realize_duration;
+};
+
+struct exec_times {
+        char *name;
+        usec_t timestamps[_EXEC_TIMESTAMP_MAX];
+        usec_t total;
+};
+
+struct generator_times {
+        const char *path;
+        usec_t start;
+        usec_t wall;
+        usec_t cpu;
+        const char *result;
+        int status;
 };
 
 struct host_info {
@@ -330,10 +361,14 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(struct host_info*, free_host_info);
 
 static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
         static const struct bus_properties_map property_map[] = {
-                { "InactiveExitTimestampMonotonic",  "t", NULL, offsetof(struct unit_times, activating)   },
-                { "ActiveEnterTimestampMonotonic",   "t", NULL, offsetof(struct unit_times, activated)    },
-                { "ActiveExitTimestampMonotonic",    "t", NULL, offsetof(struct unit_times, deactivating) },
-                { "InactiveEnterTimestampMonotonic", "t", NULL, offsetof(struct unit_times, deactivated)  },
+                { "InactiveExitTimestampMonotonic",  "t", NULL, offsetof(struct unit_times, activating)              },
+                { "ActiveEnterTimestampMonotonic",   "t", NULL, offsetof(struct unit_times, activated)               },
+                { "ActiveExitTimestampMonotonic",    "t", NULL, offsetof(struct unit_times, deactivating)            },
+                { "InactiveEnterTimestampMonotonic", "t", NULL, offsetof(struct unit_times, deactivated)             },
+                { "JobInstallTimestampMonotonic",    "t", NULL, offsetof(struct unit_times, job_installed)           },
+                { "JobRunTimestampMonotonic",        "t", NULL, offsetof(struct unit_times, job_run)                 },
+                { "CGroupRealizeTimestampMonotonic", "t", NULL, offsetof(struct unit_times, cgroup_realize)          },
+                { "CGroupRealizeUSec",               "t", NULL, offsetof(struct unit_times, cgroup_realize_duration) },
                 {},
         };
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
@@ -391,6 +426,9 @@ static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
                 subtract_timestamp(&t->activated, boot_times->reverse_offset);
                 subtract_timestamp(&t->deactivating, boot_times->reverse_offset);
                 subtract_timestamp(&t->deactivated, boot_times->reverse_offset);
+                subtract_timestamp(&t->job_installed, boot_times->reverse_offset);
+                subtract_timestamp(&t->job_run, boot_times->reverse_offset);
+                subtract_timestamp(&t->cgroup_realize, boot_times->reverse_offset);
 
                 if (t->activated >= t->activating)
                         t->time = t->activated - t->activating;
@@ -1075,6 +1113,845 @@ static int analyze_blame(int argc, char *argv[], void *userdata) {
         return 0;
 }
 
+static void exec_times_free_many(struct exec_times *t, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                free(t[i].name);
+        free(t);
+}
+
+static int compare_exec_times(const struct exec_times *a, const struct exec_times *b) {
+        return CMP(b->total, a->total);
+}
+
+static int acquire_exec_times(sd_bus *bus, const char *name, struct exec_times *ret) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ char *path = NULL;
+        const char *stage;
+        usec_t usec;
+        int r;
+
+        path = unit_dbus_path_from_name(name);
+        if (!path)
+                return log_oom();
+
+        r = sd_bus_get_property(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        path,
+                        "org.freedesktop.systemd1.Service",
+                        "ExecMainStartupTimestamps",
+                        &error,
+                        &reply,
+                        "a(st)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get start-up timestamps of %s: %s", name, bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(st)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        *ret = (struct exec_times) {};
+
+        while ((r = sd_bus_message_read(reply, "(st)", &stage, &usec)) > 0) {
+                ExecTimestamp t;
+
+                t = exec_timestamp_from_string(stage);
+                if (t < 0) {
+                        log_debug("Unknown start-up stage '%s' of %s, ignoring.", stage, name);
+                        continue;
+                }
+
+                ret->timestamps[t] = usec;
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        return sd_bus_message_exit_container(reply);
+}
+
+static int analyze_exec_timing(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_strv_free_ char **patterns = NULL;
+        struct exec_times *times = NULL;
+        size_t allocated = 0, n = 0, i;
+        ExecTimestamp t;
+        UnitInfo u;
+        int r;
+
+        r = acquire_bus(&bus, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create bus connection: %m");
+
+        if (strv_isempty(strv_skip(argv, 1))) {
+                r = strv_extend(&patterns, "*.service");
+                if (r < 0)
+                        return log_oom();
+        } else {
+                char **name;
+
+                STRV_FOREACH(name, strv_skip(argv, 1)) {
+                        char *mangled;
+
+                        r = unit_name_mangle(*name, UNIT_NAME_MANGLE_GLOB, &mangled);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to mangle unit name %s: %m", *name);
+
+                        r = strv_consume(&patterns, mangled);
+                        if (r < 0)
+                                return log_oom();
+                }
+        }
+
+        r = sd_bus_message_new_method_call(
+                        bus,
+                        &m,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "ListUnitsByPatterns");
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append_strv(m, NULL);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append_strv(m, patterns);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_call(bus, m, 0, &error, &reply);
+        if (r < 0)
+                return log_error_errno(r, "Failed to list units: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = bus_parse_unit_info(reply, &u)) > 0) {
+                struct exec_times *e;
+
+                if (!endswith(u.id, ".service"))
+                        continue;
+
+                if (!GREEDY_REALLOC(times, allocated, n + 1)) {
+                        r = log_oom();
+                        goto finish;
+                }
+
+                e = times + n;
+
+                r = acquire_exec_times(bus, u.id, e);
+                if (r < 0)
+                        goto finish;
+
+                /* Skip services whose main process was never forked off since the manager started */
+                if (e->timestamps[EXEC_TIMESTAMP_SPAWN] == 0 || e->timestamps[EXEC_TIMESTAMP_FORK] == 0)
+                        continue;
+
+                e->name = strdup(u.id);
+                if (!e->name) {
+                        r = log_oom();
+                        goto finish;
+                }
+
+                for (t = _EXEC_TIMESTAMP_MAX - 1; t > EXEC_TIMESTAMP_SPAWN; t--)
+                        if (e->timestamps[t] > 0) {
+                                e->total = usec_sub_unsigned(e->timestamps[t], e->timestamps[EXEC_TIMESTAMP_SPAWN]);
+                                break;
+                        }
+
+                n++;
+        }
+        if (r < 0) {
+                r = bus_log_parse_error(r);
+                goto finish;
+        }
+
+        typesafe_qsort(times, n, compare_exec_times);
+
+        (void) pager_open(arg_pager_flags);
+
+        printf("%s%10s", ansi_underline(), "TOTAL");
+        for (t = EXEC_TIMESTAMP_FORK; t < _EXEC_TIMESTAMP_MAX; t++)
+                printf(" %10s", exec_timestamp_to_string(t));
+        printf(" %s%s\n", "UNIT", ansi_normal());
+
+        for (i = 0; i < n; i++) {
+                char ts[FORMAT_TIMESPAN_MAX];
+                usec_t last;
+
+                printf("%10s", format_timespan(ts, sizeof(ts), times[i].total, USEC_PER_MSEC / 10));
+
+                /* Show how long each stage took relative to the previous one that was reached */
+                last = times[i].timestamps[EXEC_TIMESTAMP_SPAWN];
+                for (t = EXEC_TIMESTAMP_FORK; t < _EXEC_TIMESTAMP_MAX; t++) {
+                        if (times[i].timestamps[t] == 0) {
+                                printf(" %10s", "-");
+                                continue;
+                        }
+
+                        printf(" %10s", format_timespan(ts, sizeof(ts), usec_sub_unsigned(times[i].timestamps[t], last), USEC_PER_MSEC / 10));
+                        last = times[i].timestamps[t];
+                }
+
+                printf(" %s\n", times[i].name);
+        }
+
+        r = 0;
+
+finish:
+        exec_times_free_many(times, n);
+        return r;
+}
+
+static int compare_generator_times(const struct generator_times *a, const struct generator_times *b) {
+        return CMP(b->wall, a->wall);
+}
+
+static int acquire_generator_times(sd_bus *bus, sd_bus_message **ret_reply, struct generator_times **ret) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ struct generator_times *times = NULL;
+        size_t allocated = 0, n = 0;
+        struct generator_times g;
+        int r;
+
+        /* The strings in the returned array point into the returned message */
+
+        r = sd_bus_get_property(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "GeneratorTimings",
+                        &error,
+                        &reply,
+                        "a(stttsi)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get generator timings: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(stttsi)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(stttsi)", &g.path, &g.start, &g.wall, &g.cpu, &g.result, &g.status)) > 0) {
+                if (!GREEDY_REALLOC(times, allocated, n + 1))
+                        return log_oom();
+
+                times[n++] = g;
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        *ret_reply = TAKE_PTR(reply);
+        *ret = TAKE_PTR(times);
+        return (int) n;
+}
+
+static int analyze_generator_timing(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_free_ struct generator_times *times = NULL;
+        size_t n, i;
+        int r;
+
+        r = acquire_bus(&bus, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create bus connection: %m");
+
+        r = acquire_generator_times(bus, &reply, &times);
+        if (r < 0)
+                return r;
+        n = r;
+
+        if (n == 0) {
+                log_info("No generators were run.");
+                return 0;
+        }
+
+        typesafe_qsort(times, n, compare_generator_times);
+
+        (void) pager_open(arg_pager_flags);
+
+        printf("%s%10s %10s %-10s %s%s\n", ansi_underline(), "WALL", "CPU", "STATUS", "GENERATOR", ansi_normal());
+
+        for (i = 0; i < n; i++) {
+                char ts[FORMAT_TIMESPAN_MAX], tc[FORMAT_TIMESPAN_MAX], status[DECIMAL_STR_MAX(int)];
+                const char *s;
+
+                if (streq(times[i].result, "exited")) {
+                        xsprintf(status, "%i", times[i].status);
+                        s = status;
+                } else if (STR_IN_SET(times[i].result, "killed", "dumped"))
+                        s = strna(signal_to_string(times[i].status));
+                else
+                        s = times[i].result;
+
+                printf("%10s %10s %s%-10s%s %s\n",
+                       format_timespan(ts, sizeof(ts), times[i].wall, USEC_PER_MSEC / 10),
+                       format_timespan(tc, sizeof(tc), times[i].cpu, USEC_PER_MSEC / 10),
+                       streq(s, "0") ? "" : ansi_highlight_red(), s, streq(s, "0") ? "" : ansi_normal(),
+                       times[i].path);
+        }
+
+        return 0;
+}
+
+struct udev_event_times {
+        uint64_t seqnum;
+        usec_t queued;
+        usec_t start;
+        usec_t end;
+        char *action;
+        char *devpath;
+};
+
+static void udev_event_times_free_many(struct udev_event_times *t, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+                free(t[i].action);
+                free(t[i].devpath);
+        }
+        free(t);
+}
+
+static int compare_udev_event_start(const struct udev_event_times *a, const struct udev_event_times *b) {
+        return CMP(a->start, b->start);
+}
+
+static int compare_generator_start(const struct generator_times *a, const struct generator_times *b) {
+        return CMP(a->start, b->start);
+}
+
+static int acquire_udev_event_times(struct udev_event_times **ret, size_t *ret_n) {
+        _cleanup_fclose_ FILE *f = NULL;
+        struct udev_event_times *times = NULL;
+        size_t allocated = 0, n = 0;
+        unsigned line = 0;
+        int r;
+
+        /* systemd-udevd records the events it processed in this file, one per line:
+         * SEQNUM QUEUED-USEC START-USEC END-USEC ACTION DEVPATH */
+
+        f = fopen("/run/udev/event-timings", "re");
+        if (!f) {
+                if (errno != ENOENT)
+                        log_debug_errno(errno, "Failed to open /run/udev/event-timings, ignoring: %m");
+
+                *ret = NULL;
+                *ret_n = 0;
+                return 0;
+        }
+
+        for (;;) {
+                _cleanup_free_ char *l = NULL, *seqnum = NULL, *queued = NULL, *start = NULL, *end = NULL, *action = NULL;
+                struct udev_event_times *e;
+                const char *p;
+
+                r = read_line(f, LONG_LINE_MAX, &l);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to read /run/udev/event-timings: %m");
+                        goto fail;
+                }
+                if (r == 0)
+                        break;
+
+                line++;
+
+                p = l;
+                r = extract_many_words(&p, NULL, 0, &seqnum, &queued, &start, &end, &action, NULL);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to parse /run/udev/event-timings:%u: %m", line);
+                        goto fail;
+                }
+                if (r < 5 || isempty(p)) {
+                        log_debug("Incomplete line /run/udev/event-timings:%u, ignoring.", line);
+                        continue;
+                }
+
+                if (!GREEDY_REALLOC(times, allocated, n + 1)) {
+                        r = log_oom();
+                        goto fail;
+                }
+
+                e = times + n;
+                *e = (struct udev_event_times) {};
+
+                if (safe_atou64(seqnum, &e->seqnum) < 0 ||
+                    safe_atou64(queued, &e->queued) < 0 ||
+                    safe_atou64(start, &e->start) < 0 ||
+                    safe_atou64(end, &e->end) < 0 ||
+                    e->start < e->queued || e->end < e->start) {
+                        log_debug("Invalid line /run/udev/event-timings:%u, ignoring.", line);
+                        continue;
+                }
+
+                e->devpath = strdup(p);
+                if (!e->devpath) {
+                        r = log_oom();
+                        goto fail;
+                }
+
+                e->action = TAKE_PTR(action);
+                n++;
+        }
+
+        *ret = times;
+        *ret_n = n;
+        return 0;
+
+fail:
+        udev_event_times_free_many(times, n);
+        return r;
+}
+
+static int trace_lane(usec_t **lanes, size_t *n_lanes, size_t *allocated, usec_t begin, usec_t end) {
+        size_t i;
+
+        /* Complete events on the same thread of a trace must nest properly. Put things that may run in parallel
+         * on the first "lane" that is free again when they begin, and open up a new lane when all are busy. Expects
+         * to be called in the order of the begin timestamps. */
+
+        for (i = 0; i < *n_lanes; i++)
+                if ((*lanes)[i] <= begin)
+                        break;
+
+        if (i >= *n_lanes) {
+                if (!GREEDY_REALLOC(*lanes, *allocated, *n_lanes + 1))
+                        return -ENOMEM;
+
+                (*n_lanes)++;
+        }
+
+        (*lanes)[i] = end;
+        return (int) i;
+}
+
+static int trace_event(
+                JsonWriter *w,
+                const char *phase,
+                const char *name,
+                const char *category,
+                unsigned pid,
+                unsigned tid,
+                usec_t begin,
+                usec_t end,
+                JsonVariant *args) {
+
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        int r;
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name)),
+                                       JSON_BUILD_PAIR_CONDITION(!!category, "cat", JSON_BUILD_STRING(category)),
+                                       JSON_BUILD_PAIR("ph", JSON_BUILD_STRING(phase)),
+                                       JSON_BUILD_PAIR("pid", JSON_BUILD_UNSIGNED(pid)),
+                                       JSON_BUILD_PAIR("tid", JSON_BUILD_UNSIGNED(tid)),
+                                       JSON_BUILD_PAIR("ts", JSON_BUILD_UNSIGNED(begin)),
+                                       JSON_BUILD_PAIR_CONDITION(streq(phase, "X"), "dur", JSON_BUILD_UNSIGNED(usec_sub_unsigned(end, begin))),
+                                       JSON_BUILD_PAIR_CONDITION(!!args, "args", JSON_BUILD_VARIANT(args))));
+        if (r < 0)
+                return r;
+
+        return json_writer_variant(w, v);
+}
+
+static int trace_name(JsonWriter *w, const char *what, unsigned pid, unsigned tid, const char *name) {
+        _cleanup_(json_variant_unrefp) JsonVariant *args = NULL;
+        int r;
+
+        r = json_build(&args, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name))));
+        if (r < 0)
+                return r;
+
+        return trace_event(w, "M", what, NULL, pid, tid, 0, 0, args);
+}
+
+/* Trace "processes" the events are grouped into */
+enum {
+        TRACE_PID_BOOT = 1,
+        TRACE_PID_GENERATORS,
+        TRACE_PID_UNITS,
+        TRACE_PID_UDEV,
+};
+
+static int trace_boot(JsonWriter *w, const struct boot_times *boot, usec_t base) {
+        int r;
+
+        /* Thread 1 shows the phases of the boot, thread 2 what the manager did before starting units */
+
+        r = trace_name(w, "process_name", TRACE_PID_BOOT, 0, "boot");
+        if (r < 0)
+                return r;
+        r = trace_name(w, "thread_name", TRACE_PID_BOOT, 1, "phases");
+        if (r < 0)
+                return r;
+        r = trace_name(w, "thread_name", TRACE_PID_BOOT, 2, "manager");
+        if (r < 0)
+                return r;
+
+        if (boot->firmware_time > boot->loader_time) {
+                r = trace_event(w, "X", "firmware", "boot", TRACE_PID_BOOT, 1, base - boot->firmware_time, base - boot->loader_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->loader_time > 0) {
+                r = trace_event(w, "X", "loader", "boot", TRACE_PID_BOOT, 1, base - boot->loader_time, base, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->kernel_done_time > 0) {
+                r = trace_event(w, "X", "kernel", "boot", TRACE_PID_BOOT, 1, base, base + boot->kernel_done_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->initrd_time > 0) {
+                r = trace_event(w, "X", "initrd", "boot", TRACE_PID_BOOT, 1, base + boot->initrd_time, base + boot->userspace_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->finish_time > 0) {
+                r = trace_event(w, "X", "userspace", "boot", TRACE_PID_BOOT, 1, base + boot->userspace_time, base + boot->finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+
+        if (boot->initrd_security_start_time < boot->initrd_security_finish_time) {
+                r = trace_event(w, "X", "security", "manager", TRACE_PID_BOOT, 2,
+                                base + boot->initrd_security_start_time, base + boot->initrd_security_finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->initrd_generators_start_time < boot->initrd_generators_finish_time) {
+                r = trace_event(w, "X", "generators", "manager", TRACE_PID_BOOT, 2,
+                                base + boot->initrd_generators_start_time, base + boot->initrd_generators_finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->initrd_unitsload_start_time < boot->initrd_unitsload_finish_time) {
+                r = trace_event(w, "X", "units-load", "manager", TRACE_PID_BOOT, 2,
+                                base + boot->initrd_unitsload_start_time, base + boot->initrd_unitsload_finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->security_start_time < boot->security_finish_time) {
+                r = trace_event(w, "X", "security", "manager", TRACE_PID_BOOT, 2,
+                                base + boot->security_start_time, base + boot->security_finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->generators_start_time < boot->generators_finish_time) {
+                r = trace_event(w, "X", "generators", "manager", TRACE_PID_BOOT, 2,
+                                base + boot->generators_start_time, base + boot->generators_finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+        if (boot->unitsload_start_time < boot->unitsload_finish_time) {
+                r = trace_event(w, "X", "units-load", "manager", TRACE_PID_BOOT, 2,
+                                base + boot->unitsload_start_time, base + boot->unitsload_finish_time, NULL);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int trace_generators(JsonWriter *w, struct generator_times *times, size_t n, usec_t reverse_offset, usec_t base) {
+        _cleanup_free_ usec_t *lanes = NULL;
+        size_t n_lanes = 0, allocated = 0, i;
+        int r;
+
+        r = trace_name(w, "process_name", TRACE_PID_GENERATORS, 0, "generators");
+        if (r < 0)
+                return r;
+
+        typesafe_qsort(times, n, compare_generator_start);
+
+        for (i = 0; i < n; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *args = NULL;
+                usec_t start;
+                int lane;
+
+                if (times[i].start < reverse_offset)
+                        continue;
+                start = times[i].start - reverse_offset;
+
+                lane = trace_lane(&lanes, &n_lanes, &allocated, start, start + times[i].wall);
+                if (lane < 0)
+                        return lane;
+
+                r = json_build(&args, JSON_BUILD_OBJECT(
+                                               JSON_BUILD_PAIR("cpu-usec", JSON_BUILD_UNSIGNED(times[i].cpu)),
+                                               JSON_BUILD_PAIR("result", JSON_BUILD_STRING(times[i].result)),
+                                               JSON_BUILD_PAIR("status", JSON_BUILD_INTEGER(times[i].status))));
+                if (r < 0)
+                        return r;
+
+                r = trace_event(w, "X", times[i].path, "generator", TRACE_PID_GENERATORS, lane + 1,
+                                base + start, base + start + times[i].wall, args);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int trace_units(JsonWriter *w, const struct unit_times *times, usec_t finish, usec_t base) {
+        const struct unit_times *u;
+        unsigned tid = 0;
+        int r;
+
+        /* Each unit gets a thread of its own, showing the state transitions of its most recent activation, and
+         * when its last job waited in the queue or its cgroup was realized, as far as those fit in without
+         * overlapping the state transitions. */
+
+        r = trace_name(w, "process_name", TRACE_PID_UNITS, 0, "units");
+        if (r < 0)
+                return r;
+
+        for (u = times; u->has_data; u++) {
+                usec_t activated, deactivating, deactivated;
+
+                tid++;
+
+                r = trace_name(w, "thread_name", TRACE_PID_UNITS, tid, u->name);
+                if (r < 0)
+                        return r;
+
+                /* The timestamps are those of the last transition each, so they might be from different cycles
+                 * of a unit that was restarted. Treat those of earlier cycles as unset. */
+                activated = u->activated >= u->activating ? u->activated : 0;
+                deactivating = activated > 0 && u->deactivating >= activated ? u->deactivating : 0;
+                deactivated = u->deactivated >= MAX3(u->activating, activated, deactivating) ? u->deactivated : 0;
+
+                if (u->job_run > 0 && u->job_installed <= u->job_run && u->job_run <= u->activating) {
+                        r = trace_event(w, "X", "job-queued", "job", TRACE_PID_UNITS, tid,
+                                        base + u->job_installed, base + u->job_run, NULL);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = trace_event(w, "X", "activating", "unit", TRACE_PID_UNITS, tid,
+                                base + u->activating, base + (activated > 0 ? activated : deactivated > 0 ? deactivated : MAX(finish, u->activating)), NULL);
+                if (r < 0)
+                        return r;
+
+                if (activated > 0) {
+                        r = trace_event(w, "X", "active", "unit", TRACE_PID_UNITS, tid,
+                                        base + activated, base + (deactivating > 0 ? deactivating : MAX(finish, activated)), NULL);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (deactivating > 0 && deactivated > 0) {
+                        r = trace_event(w, "X", "deactivating", "unit", TRACE_PID_UNITS, tid,
+                                        base + deactivating, base + deactivated, NULL);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (u->cgroup_realize > 0 &&
+                    (u->cgroup_realize + u->cgroup_realize_duration <= u->activating ||
+                     (u->cgroup_realize >= u->activating && activated > 0 && u->cgroup_realize + u->cgroup_realize_duration <= activated))) {
+                        r = trace_event(w, "X", "cgroup-realize", "cgroup", TRACE_PID_UNITS, tid,
+                                        base + u->cgroup_realize, base + u->cgroup_realize + u->cgroup_realize_duration, NULL);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+static int trace_udev(JsonWriter *w, struct udev_event_times *times, size_t n, usec_t base) {
+        _cleanup_free_ usec_t *lanes = NULL;
+        size_t n_lanes = 0, allocated = 0, i;
+        int r;
+
+        /* The lanes correspond to the workers that were busy at the same time, not to particular worker processes */
+
+        r = trace_name(w, "process_name", TRACE_PID_UDEV, 0, "systemd-udevd");
+        if (r < 0)
+                return r;
+
+        typesafe_qsort(times, n, compare_udev_event_start);
+
+        for (i = 0; i < n; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *args = NULL;
+                int lane;
+
+                lane = trace_lane(&lanes, &n_lanes, &allocated, times[i].start, times[i].end);
+                if (lane < 0)
+                        return lane;
+
+                r = json_build(&args, JSON_BUILD_OBJECT(
+                                               JSON_BUILD_PAIR("seqnum", JSON_BUILD_UNSIGNED(times[i].seqnum)),
+                                               JSON_BUILD_PAIR("action", JSON_BUILD_STRING(times[i].action)),
+                                               JSON_BUILD_PAIR("queued-usec", JSON_BUILD_UNSIGNED(times[i].start - times[i].queued))));
+                if (r < 0)
+                        return r;
+
+                r = trace_event(w, "X", times[i].devpath, "udev", TRACE_PID_UDEV, lane + 1,
+                                base + times[i].start, base + times[i].end, args);
+                if (r < 0)
+                        return r;
+        }
+
+        for (i = 0; i < n_lanes; i++) {
+                char name[STRLEN("worker ") + DECIMAL_STR_MAX(size_t)];
+
+                xsprintf(name, "worker %zu", i + 1);
+                r = trace_name(w, "thread_name", TRACE_PID_UDEV, i + 1, name);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int analyze_trace(int argc, char *argv[], void *userdata) {
+        _cleanup_(free_host_infop) struct host_info *host = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *generators_reply = NULL;
+        _cleanup_(unit_times_freep) struct unit_times *times = NULL;
+        _cleanup_free_ struct generator_times *generators = NULL;
+        _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+        struct udev_event_times *udev_events = NULL;
+        size_t n_udev_events = 0;
+        bool use_full_bus = arg_scope == UNIT_FILE_SYSTEM;
+        struct boot_times *boot;
+        int n, n_generators, r;
+        usec_t base;
+
+        r = acquire_bus(&bus, &use_full_bus);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create bus connection: %m");
+
+        r = acquire_boot_times(bus, &boot);
+        if (r < 0)
+                return r;
+
+        if (use_full_bus || arg_scope != UNIT_FILE_SYSTEM) {
+                r = acquire_host_info(bus, &host);
+                if (r < 0)
+                        return r;
+        }
+
+        n = acquire_time_data(bus, &times);
+        if (n < 0)
+                return n;
+
+        n_generators = acquire_generator_times(bus, &generators_reply, &generators);
+        if (n_generators < 0)
+                return n_generators;
+
+        /* The event timings of udevd are only available locally, and only relevant for the system manager */
+        if (arg_scope == UNIT_FILE_SYSTEM && arg_transport == BUS_TRANSPORT_LOCAL) {
+                r = acquire_udev_event_times(&udev_events, &n_udev_events);
+                if (r < 0)
+                        return r;
+        }
+
+        if (n > 0)
+                typesafe_qsort(times, n, compare_unit_start);
+
+        /* The timestamps of the trace are relative to the start of the firmware, so that they are never negative */
+        base = boot->firmware_time;
+
+        r = json_writer_new(&w, stdout, arg_json == JSON_PRETTY ? JSON_FORMAT_PRETTY|JSON_FORMAT_NEWLINE : JSON_FORMAT_NEWLINE);
+        if (r < 0)
+                goto finish;
+
+        r = json_writer_object_begin(w);
+        if (r < 0)
+                goto finish;
+
+        r = json_writer_key(w, "traceEvents");
+        if (r < 0)
+                goto finish;
+
+        r = json_writer_array_begin(w);
+        if (r < 0)
+                goto finish;
+
+        r = trace_boot(w, boot, base);
+        if (r < 0)
+                goto finish;
+
+        r = trace_generators(w, generators, n_generators, boot->reverse_offset, base);
+        if (r < 0)
+                goto finish;
+
+        if (n > 0) {
+                r = trace_units(w, times, boot->finish_time, base);
+                if (r < 0)
+                        goto finish;
+        }
+
+        if (n_udev_events > 0) {
+                r = trace_udev(w, udev_events, n_udev_events, base);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = json_writer_array_end(w);
+        if (r < 0)
+                goto finish;
+
+        r = json_writer_key(w, "displayTimeUnit");
+        if (r < 0)
+                goto finish;
+
+        r = json_writer_string(w, "ms");
+        if (r < 0)
+                goto finish;
+
+        if (host) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                r = json_build(&v, JSON_BUILD_OBJECT(
+                                               JSON_BUILD_PAIR("systemd-version", JSON_BUILD_STRING(GIT_VERSION)),
+                                               JSON_BUILD_PAIR("hostname", JSON_BUILD_STRING(strempty(host->hostname))),
+                                               JSON_BUILD_PAIR("os", JSON_BUILD_STRING(strempty(host->os_pretty_name))),
+                                               JSON_BUILD_PAIR("kernel-release", JSON_BUILD_STRING(strempty(host->kernel_release))),
+                                               JSON_BUILD_PAIR("architecture", JSON_BUILD_STRING(strempty(host->architecture))),
+                                               JSON_BUILD_PAIR("virtualization", JSON_BUILD_STRING(strempty(host->virtualization)))));
+                if (r < 0)
+                        goto finish;
+
+                r = json_writer_key(w, "otherData");
+                if (r < 0)
+                        goto finish;
+
+                r = json_writer_variant(w, v);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = json_writer_object_end(w);
+        if (r < 0)
+                goto finish;
+
+        r = json_writer_finish(w);
+
+finish:
+        udev_event_times_free_many(udev_events, n_udev_events);
+
+        if (r == -ENOMEM)
+                return log_oom();
+        if (r < 0)
+                return log_error_errno(r, "Failed to write trace: %m");
+
+        return 0;
+}
+
 static int analyze_time(int argc, char *argv[], void *userdata) {
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         _cleanup_free_ char *buf = NULL;
@@ -1799,6 +2676,12 @@ static int do_security(int argc, char *argv[], void *userdata) {
         return analyze_security(bus, strv_skip(argv, 1), 0);
 }
 
+static int do_benchmark(int argc, char *argv[], void *userdata) {
+        return analyze_benchmark(strv_skip(argv, 1),
+                                 arg_json != JSON_OFF,
+                                 arg_json == JSON_PRETTY ? JSON_FORMAT_PRETTY|JSON_FORMAT_NEWLINE|JSON_FORMAT_COLOR_AUTO : JSON_FORMAT_NEWLINE);
+}
+
 static int help(int argc, char *argv[], void *userdata) {
         _cleanup_free_ char *link = NULL;
         int r;
@@ -1827,11 +2710,16 @@ static int help(int argc, char *argv[], void *userdata) {
                "                           earlier than the latest in the branch\n"
                "     --man[=BOOL]          Do [not] check for existence of man pages\n"
                "     --generators[=BOOL]   Do [not] run unit generators (requires privileges)\n"
+               "     --json=MODE           Output benchmark results and traces as JSON (short or\n"
+               "                           pretty)\n"
                "\nCommands:\n"
                "  time                     Print time spent in the kernel\n"
                "  blame                    Print list of running units ordered by time to init\n"
                "  critical-chain [UNIT...] Print a tree of the time critical chain of units\n"
+               "  exec-timing [UNIT...]    Print time spent setting up the main process of services\n"
+               "  generator-timing         Print time spent in each unit generator\n"
                "  plot                     Output SVG graphic showing service initialization\n"
+               "  trace                    Output boot trace in Chrome trace event format\n"
                "  dot [UNIT...]            Output dependency graph in man:dot(1) format\n"
                "  log-level [LEVEL]        Get/set logging threshold for manager\n"
                "  log-target [TARGET]      Get/set logging target for manager\n"
@@ -1844,6 +2732,7 @@ static int help(int argc, char *argv[], void *userdata) {
                "  service-watchdogs [BOOL] Get/set service watchdog state\n"
                "  timespan SPAN...         Validate a time span\n"
                "  security [UNIT...]       Analyze security of unit\n"
+               "  benchmark [NAME...]      Run microbenchmarks of core code paths\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
                , link
@@ -1870,6 +2759,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_NO_PAGER,
                 ARG_MAN,
                 ARG_GENERATORS,
+                ARG_JSON,
         };
 
         static const struct option options[] = {
@@ -1889,6 +2779,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "generators",   optional_argument, NULL, ARG_GENERATORS       },
                 { "host",         required_argument, NULL, 'H'                  },
                 { "machine",      required_argument, NULL, 'M'                  },
+                { "json",         required_argument, NULL, ARG_JSON             },
                 {}
         };
 
@@ -1988,6 +2879,22 @@ static int parse_argv(int argc, char *argv[]) {
 
                         break;
 
+                case ARG_JSON:
+                        if (streq(optarg, "short"))
+                                arg_json = JSON_SHORT;
+                        else if (streq(optarg, "pretty"))
+                                arg_json = JSON_PRETTY;
+                        else if (streq(optarg, "help")) {
+                                fputs("short\n"
+                                      "pretty\n", stdout);
+                                return 0;
+                        } else
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Unknown JSON out mode: %s",
+                                                       optarg);
+
+                        break;
+
                 case '?':
                         return -EINVAL;
 
@@ -2014,7 +2921,10 @@ static int run(int argc, char *argv[]) {
                 { "time",              VERB_ANY, 1,        VERB_DEFAULT, analyze_time           },
                 { "blame",             VERB_ANY, 1,        0,            analyze_blame          },
                 { "critical-chain",    VERB_ANY, VERB_ANY, 0,            analyze_critical_chain },
+                { "exec-timing",       VERB_ANY, VERB_ANY, 0,            analyze_exec_timing    },
+                { "generator-timing",  VERB_ANY, 1,        0,            analyze_generator_timing },
                 { "plot",              VERB_ANY, 1,        0,            analyze_plot           },
+                { "trace",             VERB_ANY, 1,        0,            analyze_trace          },
                 { "dot",               VERB_ANY, VERB_ANY, 0,            dot                    },
                 { "log-level",         VERB_ANY, 2,        0,            get_or_set_log_level   },
                 { "log-target",        VERB_ANY, 2,        0,            get_or_set_log_target  },
@@ -2032,6 +2942,7 @@ static int run(int argc, char *argv[]) {
                 { "service-watchdogs", VERB_ANY, 2,        0,            service_watchdogs      },
                 { "timespan",          2,        VERB_ANY, 0,            dump_timespan          },
                 { "security",          VERB_ANY, VERB_ANY, 0,            do_security            },
+                { "benchmark",         VERB_ANY, VERB_ANY, 0,            do_benchmark           },
                 {}
         };
 
@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-util.h"
+#include "arena.h"
+#include "strv.h"
+#include "util.h"
+
+/* The first block is small, so that short parse passes stay cheap, later ones double in size up to the maximum.
+ * Larger allocations get a block of their own. */
+#define ARENA_BLOCK_SIZE_MIN (4U * 1024U)
+#define ARENA_BLOCK_SIZE_MAX (256U * 1024U)
+
+/* Like malloc(), hand out memory suitable for any basic type */
+typedef union ArenaAlign {
+        long double ld;
+        uint64_t u;
+        void *p;
+} ArenaAlign;
+
+#define ARENA_ALIGN __alignof(ArenaAlign)
+
+struct ArenaBlock {
+        ArenaBlock *next;
+        size_t size;
+        size_t used;
+        uint8_t data[] _alignas_(ArenaAlign);
+};
+
+void *arena_alloc(Arena *a, size_t size) {
+        ArenaBlock *b;
+        void *p;
+
+        assert(a);
+
+        if (size > SIZE_MAX - ARENA_ALIGN - offsetof(ArenaBlock, data))
+                return NULL;
+
+        size = ALIGN_TO(MAX(size, (size_t) 1), ARENA_ALIGN);
+
+        b = a->blocks;
+        if (!b || b->size - b->used < size) {
+                size_t n;
+
+                n = b ? MIN(b->size * 2, (size_t) ARENA_BLOCK_SIZE_MAX) : ARENA_BLOCK_SIZE_MIN;
+                n = MAX(n, size);
+
+                b = malloc(offsetof(ArenaBlock, data) + n);
+                if (!b)
+                        return NULL;
+
+                b->size = n;
+                b->used = 0;
+                b->next = a->blocks;
+                a->blocks = b;
+        }
+
+        p = b->data + b->used;
+        b->used += size;
+
+        return p;
+}
+
+void *arena_alloc0(Arena *a, size_t size) {
+        void *p;
+
+        p = arena_alloc(a, size);
+        if (!p)
+                return NULL;
+
+        return memset(p, 0, size);
+}
+
+void *arena_memdup(Arena *a, const void *p, size_t size) {
+        void *q;
+
+        q = arena_alloc(a, size);
+        if (!q)
+                return NULL;
+
+        memcpy_safe(q, p, size);
+        return q;
+}
+
+char *arena_strndup(Arena *a, const char *s, size_t n) {
+        char *t;
+
+        assert(s);
+
+        n = strnlen(s, n);
+
+        t = arena_alloc(a, n + 1);
+        if (!t)
+                return NULL;
+
+        memcpy(t, s, n);
+        t[n] = 0;
+
+        return t;
+}
+
+char *arena_strdup(Arena *a, const char *s) {
+        return arena_strndup(a, s, (size_t) -1);
+}
+
+static size_t arena_strv_capacity(size_t n) {
+        size_t c = 4;
+
+        /* The capacity of an array with n slots (including the trailing NULL) built by arena_strv_extend(). It
+         * is implied by the length, so that it does not need to be stored anywhere. */
+        while (c < n)
+                c *= 2;
+
+        return c;
+}
+
+int arena_strv_extend(Arena *a, char ***l, const char *value) {
+        size_t n;
+        char *v;
+
+        assert(a);
+        assert(l);
+
+        if (!value)
+                return 0;
+
+        n = strv_length(*l);
+
+        v = arena_strdup(a, value);
+        if (!v)
+                return -ENOMEM;
+
+        if (!*l || n + 2 > arena_strv_capacity(n + 1)) {
+                char **t;
+
+                t = arena_alloc(a, sizeof(char*) * arena_strv_capacity(n + 2));
+                if (!t)
+                        return -ENOMEM;
+
+                memcpy_safe(t, *l, sizeof(char*) * n);
+                *l = t;
+        }
+
+        (*l)[n] = v;
+        (*l)[n + 1] = NULL;
+
+        return 0;
+}
+
+void arena_done(Arena *a) {
+        ArenaBlock *b;
+
+        assert(a);
+
+        while ((b = a->blocks)) {
+                a->blocks = b->next;
+                free(b);
+        }
+
+        a->scratch = mfree(a->scratch);
+        a->scratch_allocated = 0;
+}
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stddef.h>
+
+#include "macro.h"
+
+/* A bump allocator for the many small and short-lived allocations done while parsing something. Memory is handed
+ * out from larger blocks, and only ever freed all at once by arena_done(). Nothing allocated from an arena may be
+ * passed to free(). */
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena {
+        ArenaBlock *blocks;
+
+        /* Buffer for building strings whose length is not known in advance, before they are copied into the
+         * arena. Reused by all such calls. */
+        char *scratch;
+        size_t scratch_allocated;
+} Arena;
+
+#define ARENA_NULL ((Arena) {})
+
+void *arena_alloc(Arena *a, size_t size);
+void *arena_alloc0(Arena *a, size_t size);
+void *arena_memdup(Arena *a, const void *p, size_t size);
+char *arena_strndup(Arena *a, const char *s, size_t n);
+char *arena_strdup(Arena *a, const char *s);
+
+/* Like strv_extend(), but the array and the copied string are allocated from the arena. *l must be NULL or an
+ * array built by this function on the same arena, and must not be freed with strv_free(). */
+int arena_strv_extend(Arena *a, char ***l, const char *value);
+
+void arena_done(Arena *a);
+
+#define _cleanup_arena_ _cleanup_(arena_done)
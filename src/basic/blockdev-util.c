@@ -160,6 +160,96 @@ int block_get_originating(dev_t dt, dev_t *ret) {
         return 1;
 }
 
+/* dm on top of md on top of partitions is about as deep as it gets in practice */
+#define BLOCK_STACK_DEPTH_MAX 16U
+
+static int block_collect_physical_disks(dev_t d, unsigned level, dev_t **disks, size_t *n_disks, size_t *allocated) {
+        _cleanup_closedir_ DIR *dir = NULL;
+        char p[SYS_BLOCK_PATH_MAX("/slaves")];
+        struct dirent *de;
+        bool stacked = false;
+        size_t i;
+        int r;
+
+        if (level > BLOCK_STACK_DEPTH_MAX)
+                return -ELOOP;
+
+        r = block_get_whole_disk(d, &d);
+        if (r < 0)
+                return r;
+
+        xsprintf_sys_block_path(p, "/slaves", d);
+        dir = opendir(p);
+        if (!dir && errno != ENOENT)
+                return -errno;
+
+        if (dir) {
+                FOREACH_DIRENT_ALL(de, dir, return -errno) {
+                        _cleanup_free_ char *q = NULL, *t = NULL;
+                        dev_t devt;
+
+                        if (dot_or_dot_dot(de->d_name))
+                                continue;
+
+                        if (!IN_SET(de->d_type, DT_LNK, DT_UNKNOWN))
+                                continue;
+
+                        q = strjoin(p, "/", de->d_name, "/dev");
+                        if (!q)
+                                return -ENOMEM;
+
+                        r = read_one_line_file(q, &t);
+                        if (r < 0)
+                                return r;
+
+                        r = parse_dev(t, &devt);
+                        if (r < 0)
+                                return -EINVAL;
+
+                        r = block_collect_physical_disks(devt, level + 1, disks, n_disks, allocated);
+                        if (r < 0)
+                                return r;
+
+                        stacked = true;
+                }
+        }
+
+        if (stacked)
+                return 0;
+
+        /* Not backed by anything else, hence this is a physical disk. Mirrors or stripes might end up here more
+         * than once. */
+        for (i = 0; i < *n_disks; i++)
+                if ((*disks)[i] == d)
+                        return 0;
+
+        if (!GREEDY_REALLOC(*disks, *allocated, *n_disks + 1))
+                return -ENOMEM;
+
+        (*disks)[(*n_disks)++] = d;
+        return 0;
+}
+
+int block_get_physical_disks(dev_t d, dev_t **ret, size_t *ret_n) {
+        _cleanup_free_ dev_t *disks = NULL;
+        size_t n = 0, allocated = 0;
+        int r;
+
+        assert(ret);
+        assert(ret_n);
+
+        /* For the specified block device returns the whole disks it ultimately resides on, following partitions
+         * and stacked devices (dm, md, ...) all the way down. */
+
+        r = block_collect_physical_disks(d, 0, &disks, &n, &allocated);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(disks);
+        *ret_n = n;
+        return 0;
+}
+
 int get_block_device_harder(const char *path, dev_t *ret) {
         int r;
 
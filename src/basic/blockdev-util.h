@@ -14,6 +14,7 @@
 
 int block_get_whole_disk(dev_t d, dev_t *ret);
 int block_get_originating(dev_t d, dev_t *ret);
+int block_get_physical_disks(dev_t d, dev_t **ret, size_t *ret_n);
 
 int get_block_device(const char *path, dev_t *dev);
 
@@ -260,6 +260,28 @@ int btrfs_clone_range(int infd, uint64_t in_offset, int outfd, uint64_t out_offs
         return 0;
 }
 
+int btrfs_get_fsid_fd(int fd, sd_id128_t *ret) {
+        struct btrfs_ioctl_fs_info_args fsi = {};
+        int r;
+
+        assert(fd >= 0);
+        assert(ret);
+
+        r = btrfs_is_filesystem(fd);
+        if (r < 0)
+                return r;
+        if (!r)
+                return -ENOTTY;
+
+        if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsi) < 0)
+                return -errno;
+
+        assert_cc(sizeof(fsi.fsid) == sizeof(ret->bytes));
+        memcpy(ret->bytes, fsi.fsid, sizeof(ret->bytes));
+
+        return 0;
+}
+
 int btrfs_get_block_device_fd(int fd, dev_t *dev) {
         struct btrfs_ioctl_fs_info_args fsi = {};
         uint64_t id;
@@ -642,6 +664,199 @@ int btrfs_qgroup_get_quota(const char *path, uint64_t qgroupid, BtrfsQuotaInfo *
         return btrfs_qgroup_get_quota_fd(fd, qgroupid, ret);
 }
 
+static int btrfs_qgroup_quota_compare(const BtrfsQgroupQuota *a, const BtrfsQgroupQuota *b) {
+        return CMP(a->qgroupid, b->qgroupid);
+}
+
+static BtrfsQgroupQuota* btrfs_qgroup_quota_lookup(const BtrfsQgroupQuota *q, size_t n, uint64_t qgroupid) {
+        BtrfsQgroupQuota key = {
+                .qgroupid = qgroupid,
+        };
+
+        return typesafe_bsearch(&key, q, n, btrfs_qgroup_quota_compare);
+}
+
+int btrfs_qgroup_get_quota_all_fd(int fd, BtrfsQgroupQuota **ret, size_t *ret_n) {
+
+        struct btrfs_ioctl_search_args args = {
+                /* Tree of quota items */
+                .key.tree_id = BTRFS_QUOTA_TREE_OBJECTID,
+
+                /* All of it: the info and limit items of all qgroups, which have the object ID 0, followed by the
+                 * relation items, which have the ID of either qgroup as object ID */
+                .key.min_objectid = 0,
+                .key.max_objectid = (uint64_t) -1,
+
+                .key.min_type = BTRFS_QGROUP_STATUS_KEY,
+                .key.max_type = BTRFS_QGROUP_RELATION_KEY,
+
+                .key.min_offset = 0,
+                .key.max_offset = (uint64_t) -1,
+
+                .key.min_transid = 0,
+                .key.max_transid = (uint64_t) -1,
+        };
+
+        _cleanup_free_ BtrfsQgroupQuota *items = NULL;
+        size_t n_items = 0, n_allocated = 0, k;
+        bool sorted = true;
+        int r;
+
+        assert(fd >= 0);
+        assert(ret);
+        assert(ret_n);
+
+        /* Reads the quota data of all qgroups of the file system in one sweep over the quota tree, rather than
+         * searching it once per qgroup as btrfs_qgroup_get_quota_fd() and btrfs_subvol_get_subtree_quota_fd() do.
+         * The returned array is sorted by qgroup ID, look up entries with btrfs_qgroup_quota_find() or
+         * btrfs_qgroup_quota_find_subtree(). */
+
+        r = btrfs_is_filesystem(fd);
+        if (r < 0)
+                return r;
+        if (!r)
+                return -ENOTTY;
+
+        while (btrfs_ioctl_search_args_compare(&args) <= 0) {
+                const struct btrfs_ioctl_search_header *sh;
+                unsigned i;
+
+                args.key.nr_items = 256;
+                if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0) {
+                        if (errno == ENOENT) /* quota tree is missing: quota disabled */
+                                break;
+
+                        return -errno;
+                }
+
+                if (args.key.nr_items <= 0)
+                        break;
+
+                FOREACH_BTRFS_IOCTL_SEARCH_HEADER(i, sh, args) {
+                        BtrfsQgroupQuota *e;
+
+                        /* Make sure we start the next search at least from this entry */
+                        btrfs_ioctl_search_args_set(&args, sh);
+
+                        if (sh->objectid == 0 && IN_SET(sh->type, BTRFS_QGROUP_INFO_KEY, BTRFS_QGROUP_LIMIT_KEY)) {
+
+                                /* The info items come first, ordered by qgroup ID, hence usually we just append
+                                 * to the array here, and find the entries again for the limit items */
+                                if (!sorted) {
+                                        typesafe_qsort(items, n_items, btrfs_qgroup_quota_compare);
+                                        sorted = true;
+                                }
+
+                                e = btrfs_qgroup_quota_lookup(items, n_items, sh->offset);
+                                if (!e) {
+                                        if (!GREEDY_REALLOC(items, n_allocated, n_items+1))
+                                                return -ENOMEM;
+
+                                        if (n_items > 0 && items[n_items-1].qgroupid > sh->offset)
+                                                sorted = false;
+
+                                        e = items + n_items++;
+                                        *e = (BtrfsQgroupQuota) {
+                                                .qgroupid = sh->offset,
+                                                .subtree_qgroupid = sh->offset,
+                                                .quota.referenced = (uint64_t) -1,
+                                                .quota.exclusive = (uint64_t) -1,
+                                                .quota.referenced_max = (uint64_t) -1,
+                                                .quota.exclusive_max = (uint64_t) -1,
+                                        };
+                                }
+
+                                if (sh->type == BTRFS_QGROUP_INFO_KEY) {
+                                        const struct btrfs_qgroup_info_item *qii = BTRFS_IOCTL_SEARCH_HEADER_BODY(sh);
+
+                                        e->quota.referenced = le64toh(qii->rfer);
+                                        e->quota.exclusive = le64toh(qii->excl);
+                                } else {
+                                        const struct btrfs_qgroup_limit_item *qli = BTRFS_IOCTL_SEARCH_HEADER_BODY(sh);
+
+                                        if (le64toh(qli->flags) & BTRFS_QGROUP_LIMIT_MAX_RFER)
+                                                e->quota.referenced_max = le64toh(qli->max_rfer);
+                                        if (le64toh(qli->flags) & BTRFS_QGROUP_LIMIT_MAX_EXCL)
+                                                e->quota.exclusive_max = le64toh(qli->max_excl);
+                                }
+
+                        } else if (sh->type == BTRFS_QGROUP_RELATION_KEY && sh->objectid < sh->offset) {
+                                uint64_t level, id, current;
+
+                                /* Relations are stored twice, the child's ID as object ID is the first copy. All
+                                 * items with object ID 0 are behind us at this point. */
+                                if (!sorted) {
+                                        typesafe_qsort(items, n_items, btrfs_qgroup_quota_compare);
+                                        sorted = true;
+                                }
+
+                                r = btrfs_qgroupid_split(sh->objectid, &level, NULL);
+                                if (r < 0)
+                                        return r;
+                                if (level != 0)
+                                        continue;
+
+                                r = btrfs_qgroupid_split(sh->offset, &level, &id);
+                                if (r < 0)
+                                        return r;
+                                if (id != sh->objectid)
+                                        continue;
+
+                                e = btrfs_qgroup_quota_lookup(items, n_items, sh->objectid);
+                                if (!e)
+                                        continue;
+
+                                /* Pick the parent with the lowest level, see btrfs_subvol_find_subtree_qgroup() */
+                                r = btrfs_qgroupid_split(e->subtree_qgroupid, &current, NULL);
+                                if (r < 0)
+                                        return r;
+                                if (current == 0 || level < current)
+                                        e->subtree_qgroupid = sh->offset;
+                        }
+                }
+
+                /* Increase search key by one, to read the next item, if we can. */
+                if (!btrfs_ioctl_search_args_inc(&args))
+                        break;
+        }
+
+        if (!sorted)
+                typesafe_qsort(items, n_items, btrfs_qgroup_quota_compare);
+
+        /* Only the subtree qgroups that exist are useful */
+        for (k = 0; k < n_items; k++)
+                if (!btrfs_qgroup_quota_lookup(items, n_items, items[k].subtree_qgroupid))
+                        items[k].subtree_qgroupid = items[k].qgroupid;
+
+        *ret = TAKE_PTR(items);
+        *ret_n = n_items;
+
+        return 0;
+}
+
+const BtrfsQuotaInfo* btrfs_qgroup_quota_find(const BtrfsQgroupQuota *q, size_t n, uint64_t qgroupid) {
+        const BtrfsQgroupQuota *e;
+
+        e = btrfs_qgroup_quota_lookup(q, n, qgroupid);
+        if (!e)
+                return NULL;
+
+        return &e->quota;
+}
+
+const BtrfsQuotaInfo* btrfs_qgroup_quota_find_subtree(const BtrfsQgroupQuota *q, size_t n, uint64_t subvol_id) {
+        const BtrfsQgroupQuota *e;
+
+        /* Like btrfs_subvol_get_subtree_quota_fd(), but looks the data up in what btrfs_qgroup_get_quota_all_fd()
+         * returned */
+
+        e = btrfs_qgroup_quota_lookup(q, n, subvol_id);
+        if (!e)
+                return NULL;
+
+        return btrfs_qgroup_quota_find(q, n, e->subtree_qgroupid);
+}
+
 int btrfs_subvol_find_subtree_qgroup(int fd, uint64_t subvol_id, uint64_t *ret) {
         uint64_t level, lowest = (uint64_t) -1, lowest_qgroupid = 0;
         _cleanup_free_ uint64_t *qgroups = NULL;
@@ -1628,7 +1843,7 @@ int btrfs_subvol_snapshot_fd_full(
                 } else if (r < 0)
                         return r;
 
-                r = copy_directory_fd_full(old_fd, new_path, COPY_MERGE|COPY_REFLINK, progress_path, progress_bytes, userdata);
+                r = copy_directory_fd_full(old_fd, new_path, COPY_MERGE|COPY_REFLINK|COPY_PARALLEL, progress_path, progress_bytes, userdata);
                 if (r < 0)
                         goto fallback_fail;
 
@@ -27,6 +27,16 @@ typedef struct BtrfsQuotaInfo {
         uint64_t exclusive_max;
 } BtrfsQuotaInfo;
 
+typedef struct BtrfsQgroupQuota {
+        uint64_t qgroupid;
+
+        /* For leaf qgroups, the qgroup btrfs_subvol_find_subtree_qgroup() would return, the qgroup itself for
+         * all others */
+        uint64_t subtree_qgroupid;
+
+        BtrfsQuotaInfo quota;
+} BtrfsQgroupQuota;
+
 typedef enum BtrfsSnapshotFlags {
         BTRFS_SNAPSHOT_FALLBACK_COPY      = 1 << 0, /* If the source isn't a subvolume, reflink everything */
         BTRFS_SNAPSHOT_READ_ONLY          = 1 << 1,
@@ -49,6 +59,7 @@ int btrfs_is_subvol(const char *path);
 int btrfs_reflink(int infd, int outfd);
 int btrfs_clone_range(int infd, uint64_t in_offset, int ofd, uint64_t out_offset, uint64_t sz);
 
+int btrfs_get_fsid_fd(int fd, sd_id128_t *ret);
 int btrfs_get_block_device_fd(int fd, dev_t *dev);
 int btrfs_get_block_device(const char *path, dev_t *dev);
 
@@ -118,3 +129,7 @@ int btrfs_qgroup_find_parents(int fd, uint64_t qgroupid, uint64_t **ret);
 
 int btrfs_qgroup_get_quota_fd(int fd, uint64_t qgroupid, BtrfsQuotaInfo *quota);
 int btrfs_qgroup_get_quota(const char *path, uint64_t qgroupid, BtrfsQuotaInfo *quota);
+
+int btrfs_qgroup_get_quota_all_fd(int fd, BtrfsQgroupQuota **ret, size_t *ret_n);
+const BtrfsQuotaInfo* btrfs_qgroup_quota_find(const BtrfsQgroupQuota *q, size_t n, uint64_t qgroupid);
+const BtrfsQuotaInfo* btrfs_qgroup_quota_find_subtree(const BtrfsQgroupQuota *q, size_t n, uint64_t subvol_id);
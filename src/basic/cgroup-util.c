@@ -212,6 +212,59 @@ int cg_rmdir(const char *controller, const char *path) {
         return 0;
 }
 
+/* Processes that fork quicker than we can kill them could keep us busy forever, hence don't go through the process
+ * list more often than this */
+#define CG_KILL_PASSES_MAX 64U
+
+static int cg_read_pids(const char *controller, const char *path, pid_t **ret, size_t *ret_n) {
+        _cleanup_free_ char *fs = NULL, *contents = NULL;
+        _cleanup_free_ pid_t *pids = NULL;
+        size_t n = 0, allocated = 0;
+        const char *p;
+        int r;
+
+        assert(ret);
+        assert(ret_n);
+
+        /* Reads all PIDs of the cgroup at once, which is a lot cheaper than parsing it one by one with stdio in the
+         * case of large cgroups. Note that the list might contain duplicates. */
+
+        r = cg_get_path(controller, path, "cgroup.procs", &fs);
+        if (r < 0)
+                return r;
+
+        r = read_full_file(fs, &contents, NULL);
+        if (r < 0)
+                return r;
+
+        for (p = contents; *p; ) {
+                size_t l;
+                pid_t pid;
+                char *t;
+
+                l = strcspn(p, NEWLINE);
+                t = strndupa(p, l);
+                p += l;
+                p += strspn(p, NEWLINE);
+
+                if (isempty(t))
+                        continue;
+
+                r = parse_pid(t, &pid);
+                if (r < 0)
+                        return r;
+
+                if (!GREEDY_REALLOC(pids, allocated, n + 1))
+                        return -ENOMEM;
+
+                pids[n++] = pid;
+        }
+
+        *ret = TAKE_PTR(pids);
+        *ret_n = n;
+        return 0;
+}
+
 int cg_kill(
                 const char *controller,
                 const char *path,
@@ -223,6 +276,7 @@ int cg_kill(
 
         _cleanup_set_free_ Set *allocated_set = NULL;
         bool done = false;
+        unsigned n_passes;
         int r, ret = 0;
         pid_t my_pid;
 
@@ -245,12 +299,18 @@ int cg_kill(
 
         my_pid = getpid_cached();
 
-        do {
-                _cleanup_fclose_ FILE *f = NULL;
-                pid_t pid = 0;
+        for (n_passes = 0; !done; n_passes++) {
+                _cleanup_free_ pid_t *pids = NULL;
+                size_t n_pids, i;
+
+                if (n_passes >= CG_KILL_PASSES_MAX) {
+                        log_debug("Processes in cgroup %s keep appearing, giving up after %u passes.", path, n_passes);
+                        break;
+                }
+
                 done = true;
 
-                r = cg_enumerate_processes(controller, path, &f);
+                r = cg_read_pids(controller, path, &pids, &n_pids);
                 if (r < 0) {
                         if (ret >= 0 && r != -ENOENT)
                                 return r;
@@ -258,7 +318,8 @@ int cg_kill(
                         return ret;
                 }
 
-                while ((r = cg_read_pid(f, &pid)) > 0) {
+                for (i = 0; i < n_pids; i++) {
+                        pid_t pid = pids[i];
 
                         if ((flags & CGROUP_IGNORE_SELF) && pid == my_pid)
                                 continue;
@@ -293,22 +354,124 @@ int cg_kill(
                         }
                 }
 
-                if (r < 0) {
-                        if (ret >= 0)
-                                return r;
-
-                        return ret;
-                }
-
                 /* To avoid racing against processes which fork
                  * quicker than we can kill them we repeat this until
                  * no new pids need to be killed. */
-
-        } while (!done);
+        }
 
         return ret;
 }
 
+static int cg_kill_log_recursive(
+                const char *controller,
+                const char *path,
+                int sig,
+                Set *s,
+                cg_kill_log_func_t log_kill,
+                void *userdata) {
+
+        _cleanup_free_ pid_t *pids = NULL;
+        _cleanup_closedir_ DIR *d = NULL;
+        size_t n_pids, i;
+        char *fn;
+        int r;
+
+        /* Invokes the log callback for all processes in the subtree, as cgroup.kill won't tell us whom it killed */
+
+        r = cg_read_pids(controller, path, &pids, &n_pids);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n_pids; i++)
+                if (set_get(s, PID_TO_PTR(pids[i])) != PID_TO_PTR(pids[i]))
+                        log_kill(pids[i], sig, userdata);
+
+        r = cg_enumerate_subgroups(controller, path, &d);
+        if (r < 0)
+                return r;
+
+        while ((r = cg_read_subgroup(d, &fn)) > 0) {
+                _cleanup_free_ char *p = NULL;
+
+                p = strjoin(path, "/", fn);
+                free(fn);
+                if (!p)
+                        return -ENOMEM;
+
+                (void) cg_kill_log_recursive(controller, p, sig, s, log_kill, userdata);
+        }
+
+        return r;
+}
+
+static int cg_kill_via_kill_attribute(
+                const char *controller,
+                const char *path,
+                int sig,
+                CGroupFlags flags,
+                Set *s,
+                cg_kill_log_func_t log_kill,
+                void *userdata) {
+
+        _cleanup_free_ char *fs = NULL;
+        int r;
+
+        assert(path);
+
+        /* On the unified hierarchy, newer kernels let us SIGKILL a whole subtree with a single write to cgroup.kill,
+         * which also takes care of processes forking while we are at it. It only knows SIGKILL, and can't exclude
+         * anything, hence we only use it if the caller neither wants to spare us nor any process in the set.
+         * Returns -EOPNOTSUPP if we need to go the slow way. */
+
+        if (sig != SIGKILL)
+                return -EOPNOTSUPP;
+
+        if (!set_isempty(s))
+                return -EOPNOTSUPP;
+
+        if (flags & CGROUP_REMOVE)
+                return -EOPNOTSUPP;
+
+        r = cg_unified_controller(controller);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EOPNOTSUPP;
+
+        if (flags & CGROUP_IGNORE_SELF) {
+                _cleanup_free_ char *own = NULL;
+
+                r = cg_pid_get_path(controller, 0, &own);
+                if (r < 0)
+                        return r;
+
+                if (path_startswith(own, path))
+                        return -EOPNOTSUPP;
+        }
+
+        r = cg_get_path(controller, path, "cgroup.kill", &fs);
+        if (r < 0)
+                return r;
+
+        if (access(fs, F_OK) < 0)
+                return errno == ENOENT ? -EOPNOTSUPP : -errno;
+
+        r = cg_is_empty_recursive(controller, path);
+        if (r < 0)
+                return r;
+        if (r > 0)
+                return 0; /* Nothing to kill */
+
+        if (log_kill)
+                (void) cg_kill_log_recursive(controller, path, sig, s, log_kill, userdata);
+
+        r = write_string_file(fs, "1", WRITE_STRING_FILE_DISABLE_BUFFER);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
 int cg_kill_recursive(
                 const char *controller,
                 const char *path,
@@ -326,6 +489,10 @@ int cg_kill_recursive(
         assert(path);
         assert(sig >= 0);
 
+        r = cg_kill_via_kill_attribute(controller, path, sig, flags, s, log_kill, userdata);
+        if (r != -EOPNOTSUPP)
+                return r;
+
         if (!s) {
                 s = allocated_set = set_new(NULL);
                 if (!s)
@@ -2292,6 +2459,104 @@ int cg_trim_everywhere(CGroupMask supported, const char *path, bool delete_root)
         return r;
 }
 
+static int read_pressure_file(const char *fs, CGroupPressure *ret) {
+        _cleanup_free_ char *contents = NULL;
+        const char *p;
+        int r;
+
+        r = read_full_file(fs, &contents, NULL);
+        if (r < 0)
+                return r;
+
+        for (p = contents; *p; ) {
+                CGroupPressure pressure;
+
+                if (sscanf(p, "some avg10=%lf avg60=%lf avg300=%lf total=%" SCNu64,
+                           &pressure.avg10, &pressure.avg60, &pressure.avg300, &pressure.total) == 4) {
+                        *ret = pressure;
+                        return 0;
+                }
+
+                p += strcspn(p, NEWLINE);
+                p += strspn(p, NEWLINE);
+        }
+
+        return -EBADMSG;
+}
+
+int cg_get_pressure(const char *path, CGroupPressureResource resource, CGroupPressure *ret) {
+        _cleanup_free_ char *fs = NULL;
+        const char *attribute;
+        int r;
+
+        assert(path);
+        assert(resource >= 0 && resource < _CGROUP_PRESSURE_RESOURCE_MAX);
+        assert(ret);
+
+        /* Pressure files are part of the cgroup core on the unified hierarchy, hence always available there,
+         * regardless which controllers are enabled, as long as the kernel supports PSI. */
+
+        attribute = strjoina(cgroup_pressure_resource_to_string(resource), ".pressure");
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, path, attribute, &fs);
+        if (r < 0)
+                return r;
+
+        return read_pressure_file(fs, ret);
+}
+
+int cg_get_system_pressure(CGroupPressureResource resource, CGroupPressure *ret) {
+        const char *fs;
+
+        assert(resource >= 0 && resource < _CGROUP_PRESSURE_RESOURCE_MAX);
+        assert(ret);
+
+        /* Same as cg_get_pressure(), but for the system as a whole. This works independently of the cgroup
+         * setup, i.e. also on the legacy and hybrid hierarchies. */
+
+        fs = strjoina("/proc/pressure/", cgroup_pressure_resource_to_string(resource));
+
+        return read_pressure_file(fs, ret);
+}
+
+int cg_open_pressure_trigger(const char *path, CGroupPressureResource resource, usec_t threshold_usec, usec_t window_usec) {
+        _cleanup_free_ char *fs = NULL;
+        _cleanup_close_ int fd = -1;
+        char trigger[STRLEN("some ") + DECIMAL_STR_MAX(usec_t) + 1 + DECIMAL_STR_MAX(usec_t) + 1];
+        const char *attribute;
+        int r;
+
+        assert(path);
+        assert(resource >= 0 && resource < _CGROUP_PRESSURE_RESOURCE_MAX);
+
+        /* Registers a PSI trigger on the cgroup and returns the fd to poll on. The fd gets EPOLLPRI each time the
+         * time at least one task of the cgroup was stalled on the resource exceeded the threshold within the
+         * window, and EPOLLERR once the cgroup is gone. */
+
+        if (threshold_usec <= 0 || threshold_usec > window_usec)
+                return -EINVAL;
+        if (window_usec < CGROUP_PRESSURE_WINDOW_MIN_USEC || window_usec > CGROUP_PRESSURE_WINDOW_MAX_USEC)
+                return -ERANGE;
+
+        attribute = strjoina(cgroup_pressure_resource_to_string(resource), ".pressure");
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, path, attribute, &fs);
+        if (r < 0)
+                return r;
+
+        fd = open(fs, O_RDWR|O_NONBLOCK|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        xsprintf(trigger, "some " USEC_FMT " " USEC_FMT, threshold_usec, window_usec);
+
+        /* The kernel wants the trailing NUL byte to be written too */
+        if (write(fd, trigger, strlen(trigger) + 1) < 0)
+                return -errno;
+
+        return TAKE_FD(fd);
+}
+
 int cg_mask_to_string(CGroupMask mask, char **ret) {
         _cleanup_free_ char *s = NULL;
         size_t n = 0, allocated = 0;
@@ -2396,7 +2661,7 @@ int cg_mask_supported(CGroupMask *ret) {
                 if (r < 0)
                         return r;
 
-                /* Currently, we support the cpu, memory, io and pids controller in the unified hierarchy, mask
+                /* Currently, we support the cpu, cpuset, memory, io and pids controller in the unified hierarchy, mask
                  * everything else off. */
                 mask &= CGROUP_MASK_V2;
 
@@ -2813,6 +3078,14 @@ static const char* const cgroup_io_limit_type_table[_CGROUP_IO_LIMIT_TYPE_MAX] =
 
 DEFINE_STRING_TABLE_LOOKUP(cgroup_io_limit_type, CGroupIOLimitType);
 
+static const char* const cgroup_pressure_resource_table[_CGROUP_PRESSURE_RESOURCE_MAX] = {
+        [CGROUP_PRESSURE_CPU]    = "cpu",
+        [CGROUP_PRESSURE_IO]     = "io",
+        [CGROUP_PRESSURE_MEMORY] = "memory",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(cgroup_pressure_resource, CGroupPressureResource);
+
 int cg_cpu_shares_parse(const char *s, uint64_t *ret) {
         uint64_t u;
         int r;
@@ -2870,6 +3143,7 @@ bool fd_is_cgroup_fs(int fd) {
 static const char *cgroup_controller_table[_CGROUP_CONTROLLER_MAX] = {
         [CGROUP_CONTROLLER_CPU] = "cpu",
         [CGROUP_CONTROLLER_CPUACCT] = "cpuacct",
+        [CGROUP_CONTROLLER_CPUSET] = "cpuset",
         [CGROUP_CONTROLLER_IO] = "io",
         [CGROUP_CONTROLLER_BLKIO] = "blkio",
         [CGROUP_CONTROLLER_MEMORY] = "memory",
@@ -10,6 +10,7 @@
 
 #include "def.h"
 #include "set.h"
+#include "time-util.h"
 
 #define SYSTEMD_CGROUP_CONTROLLER_LEGACY "name=systemd"
 #define SYSTEMD_CGROUP_CONTROLLER_HYBRID "name=unified"
@@ -20,6 +21,7 @@ typedef enum CGroupController {
         /* Original cgroup controllers */
         CGROUP_CONTROLLER_CPU,
         CGROUP_CONTROLLER_CPUACCT,    /* v1 only */
+        CGROUP_CONTROLLER_CPUSET,     /* v2 only */
         CGROUP_CONTROLLER_IO,         /* v2 only */
         CGROUP_CONTROLLER_BLKIO,      /* v1 only */
         CGROUP_CONTROLLER_MEMORY,
@@ -40,6 +42,7 @@ typedef enum CGroupController {
 typedef enum CGroupMask {
         CGROUP_MASK_CPU = CGROUP_CONTROLLER_TO_MASK(CGROUP_CONTROLLER_CPU),
         CGROUP_MASK_CPUACCT = CGROUP_CONTROLLER_TO_MASK(CGROUP_CONTROLLER_CPUACCT),
+        CGROUP_MASK_CPUSET = CGROUP_CONTROLLER_TO_MASK(CGROUP_CONTROLLER_CPUSET),
         CGROUP_MASK_IO = CGROUP_CONTROLLER_TO_MASK(CGROUP_CONTROLLER_IO),
         CGROUP_MASK_BLKIO = CGROUP_CONTROLLER_TO_MASK(CGROUP_CONTROLLER_BLKIO),
         CGROUP_MASK_MEMORY = CGROUP_CONTROLLER_TO_MASK(CGROUP_CONTROLLER_MEMORY),
@@ -52,7 +55,7 @@ typedef enum CGroupMask {
         CGROUP_MASK_V1 = CGROUP_MASK_CPU|CGROUP_MASK_CPUACCT|CGROUP_MASK_BLKIO|CGROUP_MASK_MEMORY|CGROUP_MASK_DEVICES|CGROUP_MASK_PIDS,
 
         /* All real cgroup v2 controllers */
-        CGROUP_MASK_V2 = CGROUP_MASK_CPU|CGROUP_MASK_IO|CGROUP_MASK_MEMORY|CGROUP_MASK_PIDS,
+        CGROUP_MASK_V2 = CGROUP_MASK_CPU|CGROUP_MASK_CPUSET|CGROUP_MASK_IO|CGROUP_MASK_MEMORY|CGROUP_MASK_PIDS,
 
         /* All cgroup v2 BPF pseudo-controllers */
         CGROUP_MASK_BPF = CGROUP_MASK_BPF_FIREWALL|CGROUP_MASK_BPF_DEVICES,
@@ -103,6 +106,32 @@ extern const uint64_t cgroup_io_limit_defaults[_CGROUP_IO_LIMIT_TYPE_MAX];
 const char* cgroup_io_limit_type_to_string(CGroupIOLimitType t) _const_;
 CGroupIOLimitType cgroup_io_limit_type_from_string(const char *s) _pure_;
 
+/* Pressure stall information on unified hierarchy */
+typedef enum CGroupPressureResource {
+        CGROUP_PRESSURE_CPU,
+        CGROUP_PRESSURE_IO,
+        CGROUP_PRESSURE_MEMORY,
+
+        _CGROUP_PRESSURE_RESOURCE_MAX,
+        _CGROUP_PRESSURE_RESOURCE_INVALID = -1
+} CGroupPressureResource;
+
+/* The "some" line of a pressure file: percentages of wall clock time at least one task was stalled, averaged over
+ * 10s, 60s and 300s, and the total stall time in µs */
+typedef struct CGroupPressure {
+        double avg10;
+        double avg60;
+        double avg300;
+        uint64_t total;
+} CGroupPressure;
+
+/* The kernel only accepts trigger windows in this range */
+#define CGROUP_PRESSURE_WINDOW_MIN_USEC (500 * USEC_PER_MSEC)
+#define CGROUP_PRESSURE_WINDOW_MAX_USEC (10 * USEC_PER_SEC)
+
+const char* cgroup_pressure_resource_to_string(CGroupPressureResource r) _const_;
+CGroupPressureResource cgroup_pressure_resource_from_string(const char *s) _pure_;
+
 /* Special values for the cpu.shares attribute */
 #define CGROUP_CPU_SHARES_INVALID ((uint64_t) -1)
 #define CGROUP_CPU_SHARES_MIN UINT64_C(2)
@@ -197,6 +226,10 @@ int cg_set_attribute(const char *controller, const char *path, const char *attri
 int cg_get_attribute(const char *controller, const char *path, const char *attribute, char **ret);
 int cg_get_keyed_attribute(const char *controller, const char *path, const char *attribute, char **keys, char **values);
 
+int cg_get_pressure(const char *path, CGroupPressureResource resource, CGroupPressure *ret);
+int cg_get_system_pressure(CGroupPressureResource resource, CGroupPressure *ret);
+int cg_open_pressure_trigger(const char *path, CGroupPressureResource resource, usec_t threshold_usec, usec_t window_usec);
+
 int cg_set_access(const char *controller, const char *path, uid_t uid, gid_t gid);
 
 int cg_set_xattr(const char *controller, const char *path, const char *name, const void *value, size_t size, int flags);
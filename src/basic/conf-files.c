@@ -21,26 +21,72 @@
 #include "string-util.h"
 #include "strv.h"
 #include "terminal-util.h"
+#include "time-util.h"
 #include "util.h"
 
-static int files_add(
-                Hashmap *h,
-                Set *masked,
-                const char *suffix,
-                const char *root,
-                unsigned flags,
-                const char *path) {
+/* Checking these needs a stat() of each entry, hence directory listings are not cached for them */
+#define CONF_FILES_NEED_STAT (CONF_FILES_FILTER_MASKED|CONF_FILES_REGULAR|CONF_FILES_DIRECTORY|CONF_FILES_EXECUTABLE)
+
+/* The same directories are listed over and over again, for example the drop-in directories of all units on each
+ * daemon reload. Hence remember what we found in each directory, and only read it again if its device, inode or
+ * modification time changed. The timestamp granularity of the file system might be too coarse to notice changes
+ * right after one was made, hence listings of recently modified directories are not trusted. */
+#define DIR_CACHE_MAX 4096U
+#define DIR_CACHE_SETTLE_USEC USEC_PER_SEC
+
+typedef struct DirCacheEntry {
+        dev_t dev;
+        ino_t ino;
+        struct timespec mtime;
+        bool settled;
+        char **names;
+        char path[];
+} DirCacheEntry;
+
+static DirCacheEntry *dir_cache_entry_free(DirCacheEntry *e) {
+        if (!e)
+                return NULL;
+
+        strv_free(e->names);
+        return mfree(e);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(dir_cache_hash_ops, char, path_hash_func, path_compare_func,
+                                              DirCacheEntry, dir_cache_entry_free);
 
+static thread_local Hashmap *dir_cache = NULL;
+
+static int dir_list_cached(const char *dirpath, char ***ret) {
         _cleanup_closedir_ DIR *dir = NULL;
-        const char *dirpath;
+        _cleanup_strv_free_ char **names = NULL;
+        size_t n = 0, allocated = 0;
+        DirCacheEntry *e;
         struct dirent *de;
+        struct stat st;
         int r;
 
-        assert(h);
-        assert((flags & CONF_FILES_FILTER_MASKED) == 0 || masked);
-        assert(path);
+        assert(dirpath);
+        assert(ret);
 
-        dirpath = prefix_roota(root, path);
+        /* Returns the names of the directory entries, with hidden and backup files skipped. The array is owned by the
+         * cache. Returns 0 if the directory does not exist. */
+
+        if (stat(dirpath, &st) < 0) {
+                if (errno == ENOENT)
+                        return 0;
+
+                return log_debug_errno(errno, "Failed to stat directory '%s': %m", dirpath);
+        }
+
+        e = hashmap_get(dir_cache, dirpath);
+        if (e && e->settled &&
+            e->dev == st.st_dev &&
+            e->ino == st.st_ino &&
+            e->mtime.tv_sec == st.st_mtim.tv_sec &&
+            e->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                *ret = e->names;
+                return 1;
+        }
 
         dir = opendir(dirpath);
         if (!dir) {
@@ -50,85 +96,193 @@ static int files_add(
                 return log_debug_errno(errno, "Failed to open directory '%s': %m", dirpath);
         }
 
+        if (!GREEDY_REALLOC(names, allocated, 1))
+                return -ENOMEM;
+        names[0] = NULL;
+
         FOREACH_DIRENT(de, dir, return -errno) {
-                struct stat st;
-                char *p, *key;
+                if (!GREEDY_REALLOC(names, allocated, n + 2))
+                        return -ENOMEM;
 
-                /* Does this match the suffix? */
-                if (suffix && !endswith(de->d_name, suffix))
-                        continue;
+                names[n] = strdup(de->d_name);
+                if (!names[n])
+                        return -ENOMEM;
 
-                /* Has this file already been found in an earlier directory? */
-                if (hashmap_contains(h, de->d_name)) {
-                        log_debug("Skipping overridden file '%s/%s'.", dirpath, de->d_name);
-                        continue;
-                }
+                names[++n] = NULL;
+        }
 
-                /* Has this been masked in an earlier directory? */
-                if ((flags & CONF_FILES_FILTER_MASKED) && set_contains(masked, de->d_name)) {
-                        log_debug("File '%s/%s' is masked by previous entry.", dirpath, de->d_name);
-                        continue;
+        if (!e) {
+                r = hashmap_ensure_allocated(&dir_cache, &dir_cache_hash_ops);
+                if (r < 0)
+                        return r;
+
+                if (hashmap_size(dir_cache) >= DIR_CACHE_MAX)
+                        hashmap_clear(dir_cache);
+
+                e = malloc(offsetof(DirCacheEntry, path) + strlen(dirpath) + 1);
+                if (!e)
+                        return -ENOMEM;
+
+                *e = (DirCacheEntry) {};
+                strcpy(e->path, dirpath);
+
+                r = hashmap_put(dir_cache, e->path, e);
+                if (r < 0) {
+                        free(e);
+                        return r;
                 }
+        }
 
-                /* Read file metadata if we shall validate the check for file masks, for node types or whether the node is marked executable. */
-                if (flags & (CONF_FILES_FILTER_MASKED|CONF_FILES_REGULAR|CONF_FILES_DIRECTORY|CONF_FILES_EXECUTABLE))
-                        if (fstatat(dirfd(dir), de->d_name, &st, 0) < 0) {
-                                log_debug_errno(errno, "Failed to stat '%s/%s', ignoring: %m", dirpath, de->d_name);
-                                continue;
-                        }
+        /* The stat() above happened before reading the directory, so if it changes in between, we'll notice the
+         * next time. */
+        e->dev = st.st_dev;
+        e->ino = st.st_ino;
+        e->mtime = st.st_mtim;
+        e->settled = timespec_load(&st.st_mtim) + DIR_CACHE_SETTLE_USEC < now(CLOCK_REALTIME);
+        strv_free_and_replace(e->names, names);
 
-                /* Is this a masking entry? */
-                if ((flags & CONF_FILES_FILTER_MASKED))
-                        if (null_or_empty(&st)) {
-                                /* Mark this one as masked */
-                                r = set_put_strdup(masked, de->d_name);
-                                if (r < 0)
-                                        return r;
+        *ret = e->names;
+        return 1;
+}
 
-                                log_debug("File '%s/%s' is a mask.", dirpath, de->d_name);
-                                continue;
-                        }
+static int files_add_entry(
+                Hashmap *h,
+                Set *masked,
+                const char *suffix,
+                unsigned flags,
+                const char *dirpath,
+                int dir_fd,
+                const char *name) {
 
-                /* Does this node have the right type? */
-                if (flags & (CONF_FILES_REGULAR|CONF_FILES_DIRECTORY))
-                        if (!((flags & CONF_FILES_DIRECTORY) && S_ISDIR(st.st_mode)) &&
-                            !((flags & CONF_FILES_REGULAR) && S_ISREG(st.st_mode))) {
-                                log_debug("Ignoring '%s/%s', as it is not a of the right type.", dirpath, de->d_name);
-                                continue;
-                        }
+        struct stat st;
+        char *p, *key;
+        int r;
 
-                /* Does this node have the executable bit set? */
-                if (flags & CONF_FILES_EXECUTABLE)
-                        /* As requested: check if the file is marked exectuable. Note that we don't check access(X_OK)
-                         * here, as we care about whether the file is marked executable at all, and not whether it is
-                         * executable for us, because if so, such errors are stuff we should log about. */
+        /* Does this match the suffix? */
+        if (suffix && !endswith(name, suffix))
+                return 0;
 
-                        if ((st.st_mode & 0111) == 0) { /* not executable */
-                                log_debug("Ignoring '%s/%s', as it is not marked executable.", dirpath, de->d_name);
-                                continue;
-                        }
+        /* Has this file already been found in an earlier directory? */
+        if (hashmap_contains(h, name)) {
+                log_debug("Skipping overridden file '%s/%s'.", dirpath, name);
+                return 0;
+        }
 
-                if (flags & CONF_FILES_BASENAME) {
-                        p = strdup(de->d_name);
-                        if (!p)
-                                return -ENOMEM;
+        /* Has this been masked in an earlier directory? */
+        if ((flags & CONF_FILES_FILTER_MASKED) && set_contains(masked, name)) {
+                log_debug("File '%s/%s' is masked by previous entry.", dirpath, name);
+                return 0;
+        }
+
+        /* Read file metadata if we shall validate the check for file masks, for node types or whether the node is marked executable. */
+        if (flags & CONF_FILES_NEED_STAT)
+                if (fstatat(dir_fd, name, &st, 0) < 0) {
+                        log_debug_errno(errno, "Failed to stat '%s/%s', ignoring: %m", dirpath, name);
+                        return 0;
+                }
 
-                        key = p;
-                } else {
-                        p = strjoin(dirpath, "/", de->d_name);
-                        if (!p)
-                                return -ENOMEM;
+        /* Is this a masking entry? */
+        if ((flags & CONF_FILES_FILTER_MASKED))
+                if (null_or_empty(&st)) {
+                        /* Mark this one as masked */
+                        r = set_put_strdup(masked, name);
+                        if (r < 0)
+                                return r;
 
-                        key = basename(p);
+                        log_debug("File '%s/%s' is a mask.", dirpath, name);
+                        return 0;
                 }
 
-                r = hashmap_put(h, key, p);
-                if (r < 0) {
-                        free(p);
-                        return log_debug_errno(r, "Failed to add item to hashmap: %m");
+        /* Does this node have the right type? */
+        if (flags & (CONF_FILES_REGULAR|CONF_FILES_DIRECTORY))
+                if (!((flags & CONF_FILES_DIRECTORY) && S_ISDIR(st.st_mode)) &&
+                    !((flags & CONF_FILES_REGULAR) && S_ISREG(st.st_mode))) {
+                        log_debug("Ignoring '%s/%s', as it is not a of the right type.", dirpath, name);
+                        return 0;
                 }
 
-                assert(r > 0);
+        /* Does this node have the executable bit set? */
+        if (flags & CONF_FILES_EXECUTABLE)
+                /* As requested: check if the file is marked exectuable. Note that we don't check access(X_OK)
+                 * here, as we care about whether the file is marked executable at all, and not whether it is
+                 * executable for us, because if so, such errors are stuff we should log about. */
+
+                if ((st.st_mode & 0111) == 0) { /* not executable */
+                        log_debug("Ignoring '%s/%s', as it is not marked executable.", dirpath, name);
+                        return 0;
+                }
+
+        if (flags & CONF_FILES_BASENAME) {
+                p = strdup(name);
+                if (!p)
+                        return -ENOMEM;
+
+                key = p;
+        } else {
+                p = strjoin(dirpath, "/", name);
+                if (!p)
+                        return -ENOMEM;
+
+                key = basename(p);
+        }
+
+        r = hashmap_put(h, key, p);
+        if (r < 0) {
+                free(p);
+                return log_debug_errno(r, "Failed to add item to hashmap: %m");
+        }
+
+        assert(r > 0);
+        return 0;
+}
+
+static int files_add(
+                Hashmap *h,
+                Set *masked,
+                const char *suffix,
+                const char *root,
+                unsigned flags,
+                const char *path) {
+
+        _cleanup_closedir_ DIR *dir = NULL;
+        const char *dirpath;
+        struct dirent *de;
+        int r;
+
+        assert(h);
+        assert((flags & CONF_FILES_FILTER_MASKED) == 0 || masked);
+        assert(path);
+
+        dirpath = prefix_roota(root, path);
+
+        if (!(flags & CONF_FILES_NEED_STAT)) {
+                char **names = NULL, **name;
+
+                r = dir_list_cached(dirpath, &names);
+                if (r <= 0)
+                        return r;
+
+                STRV_FOREACH(name, names) {
+                        r = files_add_entry(h, masked, suffix, flags, dirpath, -1, *name);
+                        if (r < 0)
+                                return r;
+                }
+
+                return 0;
+        }
+
+        dir = opendir(dirpath);
+        if (!dir) {
+                if (errno == ENOENT)
+                        return 0;
+
+                return log_debug_errno(errno, "Failed to open directory '%s': %m", dirpath);
+        }
+
+        FOREACH_DIRENT(de, dir, return -errno) {
+                r = files_add_entry(h, masked, suffix, flags, dirpath, dirfd(dir), de->d_name);
+                if (r < 0)
+                        return r;
         }
 
         return 0;
@@ -3,6 +3,8 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -363,36 +365,27 @@ static int fd_copy_symlink(
         return 0;
 }
 
-static int fd_copy_regular(
-                int df,
-                const char *from,
-                const struct stat *st,
+static int fd_copy_regular_contents(
+                int fdf,
+                int fdt,
                 int dt,
                 const char *to,
+                const struct stat *st,
                 uid_t override_uid,
                 gid_t override_gid,
                 CopyFlags copy_flags,
                 copy_progress_bytes_t progress,
                 void *userdata) {
 
-        _cleanup_close_ int fdf = -1, fdt = -1;
         struct timespec ts[2];
-        int r, q;
-
-        assert(from);
-        assert(st);
-        assert(to);
-
-        fdf = openat(df, from, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW);
-        if (fdf < 0)
-                return -errno;
+        int r;
 
-        fdt = openat(dt, to, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW, st->st_mode & 07777);
-        if (fdt < 0)
-                return -errno;
+        /* Copies the data and metadata of a regular file into the file 'to' in 'dt' just created and opened as
+         * fdt. Takes possession of fdt. */
 
         r = copy_bytes_full(fdf, fdt, (uint64_t) -1, copy_flags, NULL, NULL, progress, userdata);
         if (r < 0) {
+                safe_close(fdt);
                 (void) unlinkat(dt, to, 0);
                 return r;
         }
@@ -410,10 +403,7 @@ static int fd_copy_regular(
         (void) futimens(fdt, ts);
         (void) copy_xattr(fdf, fdt);
 
-        q = close(fdt);
-        fdt = -1;
-
-        if (q < 0) {
+        if (close(fdt) < 0) {
                 r = -errno;
                 (void) unlinkat(dt, to, 0);
         }
@@ -421,6 +411,355 @@ static int fd_copy_regular(
         return r;
 }
 
+/* With COPY_PARALLEL, regular files found while copying a tree are created right away, but the copying of their
+ * contents and metadata is handed to a small pool of worker threads, as that is where most of the time goes. The
+ * tree itself is still walked, and directories, symlinks and device nodes are still created, by the calling thread
+ * only. Since the files are created before their parent directory's timestamps are restored, the threads do not
+ * modify anything but the files themselves. The number of queued files is bounded, to limit the number of open
+ * fds. */
+
+#define COPY_THREADS_MAX 8U
+#define COPY_QUEUE_MAX 64U
+
+typedef struct CopyJob {
+        int fdf, fdt;
+
+        /* Directory and name of the target, for removing it again if copying fails */
+        int dt;
+        char *to;
+
+        struct stat st;
+        uid_t override_uid;
+        gid_t override_gid;
+        CopyFlags copy_flags;
+} CopyJob;
+
+typedef struct CopyPool {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        CopyJob *queue[COPY_QUEUE_MAX];
+        size_t queue_start, n_queued;
+        unsigned n_busy;
+        bool shutdown;
+
+        /* The first error encountered by any of the threads */
+        int error;
+
+        pthread_t threads[COPY_THREADS_MAX];
+        unsigned n_threads;
+
+        /* Serializes calls to the progress callback, which is not expected to be thread-safe */
+        pthread_mutex_t progress_mutex;
+        copy_progress_bytes_t progress;
+        void *userdata;
+} CopyPool;
+
+static CopyJob *copy_job_free(CopyJob *j) {
+        if (!j)
+                return NULL;
+
+        safe_close(j->fdf);
+        safe_close(j->fdt);
+        safe_close(j->dt);
+        free(j->to);
+
+        return mfree(j);
+}
+
+static int copy_pool_get_error(CopyPool *p) {
+        int r;
+
+        if (!p)
+                return 0;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        r = p->error;
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return r;
+}
+
+static int copy_pool_progress(uint64_t n_bytes, void *userdata) {
+        CopyPool *p = userdata;
+        int r;
+
+        assert_se(pthread_mutex_lock(&p->progress_mutex) == 0);
+        r = p->progress(n_bytes, p->userdata);
+        assert_se(pthread_mutex_unlock(&p->progress_mutex) == 0);
+
+        return r;
+}
+
+static int copy_pool_progress_path(CopyPool *p, copy_progress_path_t progress_path, const char *path, const struct stat *st, void *userdata) {
+        int r;
+
+        /* The path and byte progress callbacks usually share their state, hence serialize them too */
+
+        if (!p)
+                return progress_path(path, st, userdata);
+
+        assert_se(pthread_mutex_lock(&p->progress_mutex) == 0);
+        r = progress_path(path, st, userdata);
+        assert_se(pthread_mutex_unlock(&p->progress_mutex) == 0);
+
+        return r;
+}
+
+static void copy_pool_run(CopyPool *p, CopyJob *j) {
+        int r;
+
+        r = fd_copy_regular_contents(j->fdf, TAKE_FD(j->fdt), j->dt, j->to, &j->st,
+                                     j->override_uid, j->override_gid, j->copy_flags,
+                                     p->progress ? copy_pool_progress : NULL, p);
+        if (r < 0) {
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+                if (p->error >= 0) {
+                        p->error = r;
+
+                        /* Wake up the walk, if it waits for room in the queue */
+                        assert_se(pthread_cond_broadcast(&p->cond) == 0);
+                }
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        }
+}
+
+static void *copy_pool_thread(void *userdata) {
+        CopyPool *p = userdata;
+
+        (void) pthread_setname_np(pthread_self(), "copy");
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        for (;;) {
+                CopyJob *j;
+                bool failed;
+
+                if (p->n_queued == 0) {
+                        if (p->shutdown)
+                                break;
+
+                        assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+                        continue;
+                }
+
+                j = p->queue[p->queue_start];
+                p->queue_start = (p->queue_start + 1) % COPY_QUEUE_MAX;
+                p->n_queued--;
+                p->n_busy++;
+                failed = p->error < 0;
+
+                /* There's room in the queue again */
+                assert_se(pthread_cond_broadcast(&p->cond) == 0);
+
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+                if (failed)
+                        /* Copying is aborted, don't leave the created file behind empty */
+                        (void) unlinkat(j->dt, j->to, 0);
+                else
+                        copy_pool_run(p, j);
+                copy_job_free(j);
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                p->n_busy--;
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return NULL;
+}
+
+static int copy_pool_finish(CopyPool *p) {
+        unsigned i;
+        int r;
+
+        if (!p)
+                return 0;
+
+        /* Waits for all queued files to be copied, and returns the first error any of them ran into */
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        p->shutdown = true;
+        assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        for (i = 0; i < p->n_threads; i++)
+                assert_se(pthread_join(p->threads[i], NULL) == 0);
+
+        /* Only if no thread could be started at all there might be something left */
+        for (; p->n_queued > 0; p->n_queued--) {
+                copy_job_free(p->queue[p->queue_start]);
+                p->queue_start = (p->queue_start + 1) % COPY_QUEUE_MAX;
+        }
+
+        r = p->error;
+
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+        pthread_mutex_destroy(&p->progress_mutex);
+        free(p);
+
+        return r;
+}
+
+static int copy_pool_new(CopyPool **ret, copy_progress_bytes_t progress, void *userdata) {
+        _cleanup_free_ CopyPool *p = NULL;
+        sigset_t ss, saved_ss;
+        unsigned n;
+        long ncpus;
+        int r;
+
+        assert(ret);
+
+        p = new(CopyPool, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (CopyPool) {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+                .progress_mutex = PTHREAD_MUTEX_INITIALIZER,
+                .progress = progress,
+                .userdata = userdata,
+        };
+
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = ncpus > 0 ? MIN((unsigned) ncpus, COPY_THREADS_MAX) : 1U;
+
+        /* Start the threads with all signals blocked, so that they do not affect signal handling in the calling
+         * thread, see asynchronous_job() */
+        assert_se(sigfillset(&ss) >= 0);
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        for (; p->n_threads < n; p->n_threads++) {
+                r = pthread_create(p->threads + p->n_threads, NULL, copy_pool_thread, p);
+                if (r > 0)
+                        break;
+        }
+
+        assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+
+        if (p->n_threads == 0) {
+                /* Not a single thread? Then copy serially instead. */
+                pthread_cond_destroy(&p->cond);
+                pthread_mutex_destroy(&p->mutex);
+                pthread_mutex_destroy(&p->progress_mutex);
+
+                *ret = NULL;
+                return 0;
+        }
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+static int copy_pool_add(
+                CopyPool *p,
+                int fdf,
+                int fdt,
+                int dt,
+                const char *to,
+                const struct stat *st,
+                uid_t override_uid,
+                gid_t override_gid,
+                CopyFlags copy_flags) {
+
+        CopyJob *j;
+        int r;
+
+        assert(p);
+
+        /* Takes possession of fdf and fdt, also on failure */
+
+        j = new(CopyJob, 1);
+        if (!j) {
+                safe_close(fdf);
+                safe_close(fdt);
+                return -ENOMEM;
+        }
+
+        *j = (CopyJob) {
+                .fdf = fdf,
+                .fdt = fdt,
+                .dt = fcntl(dt, F_DUPFD_CLOEXEC, 3),
+                .st = *st,
+                .override_uid = override_uid,
+                .override_gid = override_gid,
+                .copy_flags = copy_flags,
+        };
+        if (j->dt < 0) {
+                r = -errno;
+                copy_job_free(j);
+                return r;
+        }
+
+        j->to = strdup(to);
+        if (!j->to) {
+                copy_job_free(j);
+                return -ENOMEM;
+        }
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        while (p->n_queued >= COPY_QUEUE_MAX && p->error >= 0)
+                assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+
+        /* Once a file failed to copy, don't queue any more */
+        r = p->error;
+        if (r >= 0) {
+                p->queue[(p->queue_start + p->n_queued) % COPY_QUEUE_MAX] = TAKE_PTR(j);
+                p->n_queued++;
+
+                assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        copy_job_free(j);
+        return r;
+}
+
+static int fd_copy_regular(
+                int df,
+                const char *from,
+                const struct stat *st,
+                int dt,
+                const char *to,
+                uid_t override_uid,
+                gid_t override_gid,
+                CopyFlags copy_flags,
+                CopyPool *pool,
+                copy_progress_bytes_t progress,
+                void *userdata) {
+
+        _cleanup_close_ int fdf = -1, fdt = -1;
+        int r;
+
+        assert(from);
+        assert(st);
+        assert(to);
+
+        fdf = openat(df, from, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW);
+        if (fdf < 0)
+                return -errno;
+
+        fdt = openat(dt, to, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW, st->st_mode & 07777);
+        if (fdt < 0)
+                return -errno;
+
+        if (pool) {
+                r = copy_pool_add(pool, TAKE_FD(fdf), TAKE_FD(fdt), dt, to, st, override_uid, override_gid, copy_flags);
+                if (r < 0)
+                        (void) unlinkat(dt, to, 0);
+
+                return r;
+        }
+
+        return fd_copy_regular_contents(fdf, TAKE_FD(fdt), dt, to, st, override_uid, override_gid, copy_flags, progress, userdata);
+}
+
 static int fd_copy_fifo(
                 int df,
                 const char *from,
@@ -494,6 +833,7 @@ static int fd_copy_directory(
                 uid_t override_uid,
                 gid_t override_gid,
                 CopyFlags copy_flags,
+                CopyPool *pool,
                 const char *display_path,
                 copy_progress_path_t progress_path,
                 copy_progress_bytes_t progress_bytes,
@@ -559,6 +899,11 @@ static int fd_copy_directory(
                 if (dot_or_dot_dot(de->d_name))
                         continue;
 
+                /* Stop right away when a file copied in the background failed */
+                q = copy_pool_get_error(pool);
+                if (q < 0)
+                        return q;
+
                 if (fstatat(dirfd(d), de->d_name, &buf, AT_SYMLINK_NOFOLLOW) < 0) {
                         r = -errno;
                         continue;
@@ -570,7 +915,7 @@ static int fd_copy_directory(
                         else
                                 child_display_path = de->d_name;
 
-                        r = progress_path(child_display_path, &buf, userdata);
+                        r = copy_pool_progress_path(pool, progress_path, child_display_path, &buf, userdata);
                         if (r < 0)
                                 return r;
                 }
@@ -606,9 +951,9 @@ static int fd_copy_directory(
                                         continue;
                         }
 
-                        q = fd_copy_directory(dirfd(d), de->d_name, &buf, fdt, de->d_name, original_device, depth_left-1, override_uid, override_gid, copy_flags, child_display_path, progress_path, progress_bytes, userdata);
+                        q = fd_copy_directory(dirfd(d), de->d_name, &buf, fdt, de->d_name, original_device, depth_left-1, override_uid, override_gid, copy_flags, pool, child_display_path, progress_path, progress_bytes, userdata);
                 } else if (S_ISREG(buf.st_mode))
-                        q = fd_copy_regular(dirfd(d), de->d_name, &buf, fdt, de->d_name, override_uid, override_gid, copy_flags, progress_bytes, userdata);
+                        q = fd_copy_regular(dirfd(d), de->d_name, &buf, fdt, de->d_name, override_uid, override_gid, copy_flags, pool, progress_bytes, userdata);
                 else if (S_ISLNK(buf.st_mode))
                         q = fd_copy_symlink(dirfd(d), de->d_name, &buf, fdt, de->d_name, override_uid, override_gid, copy_flags);
                 else if (S_ISFIFO(buf.st_mode))
@@ -646,6 +991,37 @@ static int fd_copy_directory(
         return r;
 }
 
+static int fd_copy_tree(
+                int df,
+                const char *from,
+                const struct stat *st,
+                int dt,
+                const char *to,
+                uid_t override_uid,
+                gid_t override_gid,
+                CopyFlags copy_flags,
+                copy_progress_path_t progress_path,
+                copy_progress_bytes_t progress_bytes,
+                void *userdata) {
+
+        CopyPool *pool = NULL;
+        int r, q;
+
+        if (copy_flags & COPY_PARALLEL) {
+                r = copy_pool_new(&pool, progress_bytes, userdata);
+                if (r < 0)
+                        return r;
+        }
+
+        r = fd_copy_directory(df, from, st, dt, to, st->st_dev, COPY_DEPTH_MAX, override_uid, override_gid, copy_flags, pool, NULL, progress_path, progress_bytes, userdata);
+
+        q = copy_pool_finish(pool);
+        if (q < 0 && r >= 0)
+                r = q;
+
+        return r;
+}
+
 int copy_tree_at_full(
                 int fdf,
                 const char *from,
@@ -667,9 +1043,9 @@ int copy_tree_at_full(
                 return -errno;
 
         if (S_ISREG(st.st_mode))
-                return fd_copy_regular(fdf, from, &st, fdt, to, override_uid, override_gid, copy_flags, progress_bytes, userdata);
+                return fd_copy_regular(fdf, from, &st, fdt, to, override_uid, override_gid, copy_flags, NULL, progress_bytes, userdata);
         else if (S_ISDIR(st.st_mode))
-                return fd_copy_directory(fdf, from, &st, fdt, to, st.st_dev, COPY_DEPTH_MAX, override_uid, override_gid, copy_flags, NULL, progress_path, progress_bytes, userdata);
+                return fd_copy_tree(fdf, from, &st, fdt, to, override_uid, override_gid, copy_flags, progress_path, progress_bytes, userdata);
         else if (S_ISLNK(st.st_mode))
                 return fd_copy_symlink(fdf, from, &st, fdt, to, override_uid, override_gid, copy_flags);
         else if (S_ISFIFO(st.st_mode))
@@ -699,7 +1075,7 @@ int copy_directory_fd_full(
         if (!S_ISDIR(st.st_mode))
                 return -ENOTDIR;
 
-        return fd_copy_directory(dirfd, NULL, &st, AT_FDCWD, to, st.st_dev, COPY_DEPTH_MAX, UID_INVALID, GID_INVALID, copy_flags, NULL, progress_path, progress_bytes, userdata);
+        return fd_copy_tree(dirfd, NULL, &st, AT_FDCWD, to, UID_INVALID, GID_INVALID, copy_flags, progress_path, progress_bytes, userdata);
 }
 
 int copy_directory_full(
@@ -721,7 +1097,7 @@ int copy_directory_full(
         if (!S_ISDIR(st.st_mode))
                 return -ENOTDIR;
 
-        return fd_copy_directory(AT_FDCWD, from, &st, AT_FDCWD, to, st.st_dev, COPY_DEPTH_MAX, UID_INVALID, GID_INVALID, copy_flags, NULL, progress_path, progress_bytes, userdata);
+        return fd_copy_tree(AT_FDCWD, from, &st, AT_FDCWD, to, UID_INVALID, GID_INVALID, copy_flags, progress_path, progress_bytes, userdata);
 }
 
 int copy_file_fd_full(
@@ -10,6 +10,7 @@
 #include <syslog.h>
 
 #include "alloc-util.h"
+#include "arena.h"
 #include "escape.h"
 #include "extract-word.h"
 #include "log.h"
@@ -17,9 +18,16 @@
 #include "string-util.h"
 #include "utf8.h"
 
-int extract_first_word(const char **p, char **ret, const char *separators, ExtractFlags flags) {
-        _cleanup_free_ char *s = NULL;
-        size_t allocated = 0, sz = 0;
+static int extract_first_word_internal(
+                const char **p,
+                char **buf,
+                size_t *allocated,
+                size_t *ret_size,
+                const char *separators,
+                ExtractFlags flags) {
+
+        bool found = false;
+        size_t sz = 0;
         char c;
         int r;
 
@@ -27,7 +35,8 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
         bool backslash = false;         /* whether we've just seen a backslash */
 
         assert(p);
-        assert(ret);
+        assert(buf);
+        assert(allocated);
 
         /* Bail early if called after last value or with no input */
         if (!*p)
@@ -42,9 +51,11 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
          * (because of an uneven number of quotes or similar), leaves
          * the pointer *p at the first invalid character. */
 
-        if (flags & EXTRACT_DONT_COALESCE_SEPARATORS)
-                if (!GREEDY_REALLOC(s, allocated, sz+1))
+        if (flags & EXTRACT_DONT_COALESCE_SEPARATORS) {
+                if (!GREEDY_REALLOC(*buf, *allocated, sz+1))
                         return -ENOMEM;
+                found = true;
+        }
 
         for (;; (*p)++, c = **p) {
                 if (c == 0)
@@ -58,15 +69,16 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                         /* We found a non-blank character, so we will always
                          * want to return a string (even if it is empty),
                          * allocate it here. */
-                        if (!GREEDY_REALLOC(s, allocated, sz+1))
+                        if (!GREEDY_REALLOC(*buf, *allocated, sz+1))
                                 return -ENOMEM;
+                        found = true;
                         break;
                 }
         }
 
         for (;; (*p)++, c = **p) {
                 if (backslash) {
-                        if (!GREEDY_REALLOC(s, allocated, sz+7))
+                        if (!GREEDY_REALLOC(*buf, *allocated, sz+7))
                                 return -ENOMEM;
 
                         if (c == 0) {
@@ -79,7 +91,7 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                                          * Unbalanced quotes will only be allowed in EXTRACT_RELAX
                                          * mode, EXTRACT_CUNESCAPE_RELAX mode does not allow them.
                                          */
-                                        s[sz++] = '\\';
+                                        (*buf)[sz++] = '\\';
                                         goto finish_force_terminate;
                                 }
                                 if (flags & EXTRACT_RELAX)
@@ -94,20 +106,20 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                                 r = cunescape_one(*p, (size_t) -1, &u, &eight_bit);
                                 if (r < 0) {
                                         if (flags & EXTRACT_CUNESCAPE_RELAX) {
-                                                s[sz++] = '\\';
-                                                s[sz++] = c;
+                                                (*buf)[sz++] = '\\';
+                                                (*buf)[sz++] = c;
                                         } else
                                                 return -EINVAL;
                                 } else {
                                         (*p) += r - 1;
 
                                         if (eight_bit)
-                                                s[sz++] = u;
+                                                (*buf)[sz++] = u;
                                         else
-                                                sz += utf8_encode_unichar(s + sz, u);
+                                                sz += utf8_encode_unichar(*buf + sz, u);
                                 }
                         } else
-                                s[sz++] = c;
+                                (*buf)[sz++] = c;
 
                         backslash = false;
 
@@ -124,10 +136,10 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                                         backslash = true;
                                         break;
                                 } else {
-                                        if (!GREEDY_REALLOC(s, allocated, sz+2))
+                                        if (!GREEDY_REALLOC(*buf, *allocated, sz+2))
                                                 return -ENOMEM;
 
-                                        s[sz++] = c;
+                                        (*buf)[sz++] = c;
                                 }
                         }
 
@@ -156,10 +168,10 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                                         goto finish;
 
                                 } else {
-                                        if (!GREEDY_REALLOC(s, allocated, sz+2))
+                                        if (!GREEDY_REALLOC(*buf, *allocated, sz+2))
                                                 return -ENOMEM;
 
-                                        s[sz++] = c;
+                                        (*buf)[sz++] = c;
                                 }
                         }
                 }
@@ -168,19 +180,66 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
 finish_force_terminate:
         *p = NULL;
 finish:
-        if (!s) {
+        if (!found) {
                 *p = NULL;
-                *ret = NULL;
                 return 0;
         }
 
 finish_force_next:
-        s[sz] = 0;
+        (*buf)[sz] = 0;
+        if (ret_size)
+                *ret_size = sz;
+
+        return 1;
+}
+
+int extract_first_word(const char **p, char **ret, const char *separators, ExtractFlags flags) {
+        _cleanup_free_ char *s = NULL;
+        size_t allocated = 0;
+        int r;
+
+        assert(ret);
+
+        r = extract_first_word_internal(p, &s, &allocated, NULL, separators, flags);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                *ret = NULL;
+                return 0;
+        }
+
         *ret = TAKE_PTR(s);
+        return 1;
+}
+
+int extract_first_word_arena(Arena *arena, const char **p, char **ret, const char *separators, ExtractFlags flags) {
+        size_t sz;
+        char *s;
+        int r;
+
+        assert(arena);
+        assert(ret);
+
+        /* Builds the word in the arena's scratch buffer, and only copies the final result into the arena, so that
+         * neither growing the word nor freeing it again costs a heap allocation. */
 
+        r = extract_first_word_internal(p, &arena->scratch, &arena->scratch_allocated, &sz, separators, flags);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                *ret = NULL;
+                return 0;
+        }
+
+        s = arena_memdup(arena, arena->scratch, sz + 1);
+        if (!s)
+                return -ENOMEM;
+
+        *ret = s;
         return 1;
 }
 
+
 int extract_first_word_and_warn(
                 const char **p,
                 char **ret,
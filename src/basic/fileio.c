@@ -17,6 +17,7 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
+#include "io-util.h"
 #include "log.h"
 #include "macro.h"
 #include "missing.h"
@@ -212,19 +213,78 @@ int write_string_filef(
 
 int read_one_line_file(const char *fn, char **line) {
         _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *rest = NULL;
+        _cleanup_close_ int fd = -1;
+        char buf[LINE_MAX];
+        size_t n = 0, k = 0;
+        struct stat st;
+        char *l;
         int r;
 
         assert(fn);
         assert(line);
 
-        f = fopen(fn, "re");
+        fd = open(fn, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        /* Most files read this way are short /proc and /sys attributes, which are regular files that fit into a
+         * buffer on the stack. Read until the first line is complete, and copy it out directly. Fifos, ttys and
+         * the like are read through stdio, as they might block until more is written. */
+        if (S_ISREG(st.st_mode))
+                for (;;) {
+                        ssize_t m;
+
+                        m = read(fd, buf + n, sizeof(buf) - n);
+                        if (m < 0) {
+                                if (errno == EINTR)
+                                        continue;
+
+                                return -errno;
+                        }
+
+                        n += m;
+                        for (; k < n && !IN_SET(buf[k], '\n', '\r', 0); k++)
+                                ;
+
+                        if (m == 0 || k < n) {
+                                l = memdup_suffix0(buf, k);
+                                if (!l)
+                                        return -ENOMEM;
+
+                                *line = l;
+                                return 0;
+                        }
+
+                        /* A long line, read the rest of it through stdio below */
+                        if (n == sizeof(buf))
+                                break;
+                }
+
+        f = fdopen(fd, "re");
         if (!f)
                 return -errno;
+        TAKE_FD(fd);
 
         (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
 
-        r = read_line(f, LONG_LINE_MAX, line);
-        return r < 0 ? r : 0;
+        r = read_line(f, LONG_LINE_MAX - n, n > 0 ? &rest : line);
+        if (r < 0)
+                return r;
+
+        if (n > 0) {
+                l = new(char, n + strlen(rest) + 1);
+                if (!l)
+                        return -ENOMEM;
+
+                strcpy(mempcpy(l, buf, n), rest);
+                *line = l;
+        }
+
+        return 0;
 }
 
 int verify_file(const char *fn, const char *blob, bool accept_extra_nl) {
@@ -353,19 +413,106 @@ int read_full_stream(
         return 0;
 }
 
+static int read_full_fd_append(int fd, char **buf, size_t *allocated, size_t *size) {
+        size_t l = *size;
+        ssize_t k;
+
+        /* Reads the rest of the file, appending it to *buf, which is grown as needed. Leaves room for a NUL byte. */
+
+        for (;;) {
+                if (!GREEDY_REALLOC(*buf, *allocated, l + LINE_MAX))
+                        return -ENOMEM;
+
+                k = read(fd, *buf + l, *allocated - l - 1);
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+                if (k == 0)
+                        break;
+
+                l += k;
+
+                /* Safety check */
+                if (l > READ_FULL_BYTES_MAX)
+                        return -E2BIG;
+        }
+
+        *size = l;
+        return 0;
+}
+
 int read_full_file(const char *fn, char **contents, size_t *size) {
-        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *buf = NULL;
+        _cleanup_close_ int fd = -1;
+        size_t l = 0, allocated = 0;
+        struct stat st;
+        int r;
 
         assert(fn);
         assert(contents);
 
-        f = fopen(fn, "re");
-        if (!f)
+        /* Same as read_full_stream(), but reads directly from the fd. If the size of the file is known, the contents
+         * are read right into a buffer of that size, otherwise into a buffer that is grown as needed, and shrunk to
+         * the right size at the end. */
+
+        fd = open(fn, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
                 return -errno;
 
-        (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+                ssize_t k;
+
+                /* Safety check */
+                if (st.st_size > READ_FULL_BYTES_MAX)
+                        return -E2BIG;
+
+                /* Ask for one byte more than we expect, so that we notice if the file grew in the meantime */
+                allocated = st.st_size + 2;
+                buf = malloc(allocated);
+                if (!buf)
+                        return -ENOMEM;
+
+                k = loop_read(fd, buf, st.st_size + 1, true);
+                if (k < 0)
+                        return (int) k;
+
+                l = k;
+        }
+
+        /* Files of unknown size, and ones that grew since we looked */
+        if (!buf || l > (size_t) st.st_size) {
+                r = read_full_fd_append(fd, &buf, &allocated, &l);
+                if (r < 0)
+                        return r;
+
+                if (allocated > l + 1) {
+                        char *p;
 
-        return read_full_stream(f, contents, size);
+                        p = realloc(buf, l + 1);
+                        if (p)
+                                buf = p;
+                }
+        }
+
+        if (!size) {
+                /* Safety check: see read_full_stream() */
+                if (memchr(buf, 0, l))
+                        return -EBADMSG;
+        }
+
+        buf[l] = 0;
+        *contents = TAKE_PTR(buf);
+
+        if (size)
+                *size = l;
+
+        return 0;
 }
 
 int executable_is_script(const char *path, char **interpreter) {
@@ -692,12 +839,12 @@ static EndOfLineMarker categorize_eol(char c, ReadLineFlags flags) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(FILE*, funlockfile);
 
-int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
-        size_t n = 0, allocated = 0, count = 0;
-        _cleanup_free_ char *buffer = NULL;
+static int read_line_into(FILE *f, size_t limit, ReadLineFlags flags, char **buffer, size_t *allocated) {
+        size_t n = 0, count = 0;
         int r;
 
         assert(f);
+        assert(allocated);
 
         /* Something like a bounded version of getline().
          *
@@ -721,10 +868,10 @@ int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
          * The input parameter limit is the maximum numbers of characters in the returned string, i.e. excluding
          * delimiters. If the limit is hit we fail and return -ENOBUFS.
          *
-         * If a line shall be skipped ret may be initialized as NULL. */
+         * If a line shall be skipped buffer may be passed as NULL. */
 
-        if (ret) {
-                if (!GREEDY_REALLOC(buffer, allocated, 1))
+        if (buffer) {
+                if (!GREEDY_REALLOC(*buffer, *allocated, 1))
                         return -ENOMEM;
         }
 
@@ -743,11 +890,18 @@ int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
                         if (count >= INT_MAX) /* We couldn't return the counter anymore as "int", hence refuse this */
                                 return -ENOBUFS;
 
-                        r = safe_fgetc(f, &c);
-                        if (r < 0)
-                                return r;
-                        if (r == 0) /* EOF is definitely EOL */
-                                break;
+                        /* We hold the lock on the stream already, hence use the unlocked variant here. This is
+                         * the same as safe_fgetc(), but avoids taking the lock again for every single character,
+                         * which matters when reading large files such as our own serialization line by line. */
+                        errno = 0;
+                        r = getc_unlocked(f);
+                        if (r == EOF) {
+                                if (ferror_unlocked(f))
+                                        return errno > 0 ? -errno : -EIO;
+
+                                break; /* EOF is definitely EOL */
+                        }
+                        c = (char) r;
 
                         eol = categorize_eol(c, flags);
 
@@ -774,24 +928,46 @@ int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
                                 continue;
                         }
 
-                        if (ret) {
-                                if (!GREEDY_REALLOC(buffer, allocated, n + 2))
+                        if (buffer) {
+                                if (!GREEDY_REALLOC(*buffer, *allocated, n + 2))
                                         return -ENOMEM;
 
-                                buffer[n] = c;
+                                (*buffer)[n] = c;
                         }
 
                         n++;
                 }
         }
 
-        if (ret) {
-                buffer[n] = 0;
+        if (buffer)
+                (*buffer)[n] = 0;
 
+        return (int) count;
+}
+
+int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
+        _cleanup_free_ char *buffer = NULL;
+        size_t allocated = 0;
+        int r;
+
+        r = read_line_into(f, limit, flags, ret ? &buffer : NULL, &allocated);
+        if (r < 0)
+                return r;
+
+        if (ret)
                 *ret = TAKE_PTR(buffer);
-        }
 
-        return (int) count;
+        return r;
+}
+
+int read_line_reuse(FILE *f, size_t limit, char **buffer, size_t *allocated) {
+        assert(buffer);
+
+        /* Like read_line(), but reads into *buffer, which is grown as needed and can be passed in again for the next
+         * line, so that reading a file line by line does not allocate for every single line. The buffer needs to be
+         * freed by the caller in the end. */
+
+        return read_line_into(f, limit, 0, buffer, allocated);
 }
 
 int safe_fgetc(FILE *f, char *ret) {
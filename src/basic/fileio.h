@@ -75,4 +75,6 @@ static inline int read_nul_string(FILE *f, size_t limit, char **ret) {
         return read_line_full(f, limit, READ_LINE_ONLY_NUL, ret);
 }
 
+int read_line_reuse(FILE *f, size_t limit, char **buffer, size_t *allocated);
+
 int safe_fgetc(FILE *f, char *ret);
@@ -11,6 +11,12 @@ void string_hash_func(const char *p, struct siphash *state) {
 
 DEFINE_HASH_OPS(string_hash_ops, char, string_hash_func, string_compare_func);
 
+const struct hash_ops string_hash_ops_siphash13 = {
+        .hash = (hash_func_t) string_hash_func,
+        .compare = (compare_func_t) string_compare_func,
+        .siphash13 = true,
+};
+
 void path_hash_func(const char *q, struct siphash *state) {
         size_t n;
 
@@ -68,6 +74,12 @@ const struct hash_ops trivial_hash_ops = {
         .compare = trivial_compare_func,
 };
 
+const struct hash_ops trivial_hash_ops_siphash13 = {
+        .hash = trivial_hash_func,
+        .compare = trivial_compare_func,
+        .siphash13 = true,
+};
+
 void uint64_hash_func(const uint64_t *p, struct siphash *state) {
         siphash24_compress(p, sizeof(uint64_t), state);
 }
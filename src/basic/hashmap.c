@@ -23,6 +23,16 @@
 #include "list.h"
 #endif
 
+#if HASHMAP_SIMD_PROBING && defined(__SSE2__)
+#include <emmintrin.h>
+#define HASHMAP_GROUP_PROBING 1
+#elif HASHMAP_SIMD_PROBING && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HASHMAP_GROUP_PROBING 1
+#else
+#define HASHMAP_GROUP_PROBING 0
+#endif
+
 /*
  * Implementation of hashmaps.
  * Addressing: open
@@ -126,6 +136,64 @@ typedef uint8_t dib_raw_t;
 
 #define DIB_FREE UINT_MAX
 
+#if HASHMAP_GROUP_PROBING
+/* Number of DIB bytes looked at in one go when scanning. */
+#define GROUP_SIZE 16U
+
+#if defined(__SSE2__)
+static unsigned group_movemask(__m128i v) {
+        return (unsigned) _mm_movemask_epi8(v);
+}
+
+/* Returns a mask with one bit per bucket of the group, set for the free ones. */
+static unsigned group_match_free(const dib_raw_t *dibs) {
+        return group_movemask(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) dibs),
+                                             _mm_set1_epi8((char) DIB_RAW_FREE)));
+}
+
+/* Compares the DIBs of a group against those an entry would have in each of its buckets, if its search started
+ * 'distance' buckets before the group. Sets bits in *ret_match for buckets with exactly that DIB, which are the
+ * candidates for the key, and in *ret_stop for buckets which are free or have a smaller DIB, beyond which the
+ * key cannot be found. */
+static void group_match_dib(const dib_raw_t *dibs, unsigned distance, unsigned *ret_match, unsigned *ret_stop) {
+        __m128i d, e, eq, lt;
+
+        d = _mm_loadu_si128((const __m128i*) dibs);
+        e = _mm_add_epi8(_mm_set1_epi8((char) distance),
+                         _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        eq = _mm_cmpeq_epi8(d, e);
+        /* There is no unsigned byte comparison in SSE2: d < e iff max(d, e) == e and d != e */
+        lt = _mm_andnot_si128(eq, _mm_cmpeq_epi8(_mm_max_epu8(d, e), e));
+
+        *ret_match = group_movemask(eq);
+        *ret_stop = group_movemask(lt) | group_match_free(dibs);
+}
+#else
+static unsigned group_movemask(uint8x16_t v) {
+        static const uint8_t bits[GROUP_SIZE] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        uint8x16_t m;
+
+        m = vandq_u8(v, vld1q_u8(bits));
+        return vaddv_u8(vget_low_u8(m)) | ((unsigned) vaddv_u8(vget_high_u8(m)) << 8);
+}
+
+static unsigned group_match_free(const dib_raw_t *dibs) {
+        return group_movemask(vceqq_u8(vld1q_u8(dibs), vdupq_n_u8(DIB_RAW_FREE)));
+}
+
+static void group_match_dib(const dib_raw_t *dibs, unsigned distance, unsigned *ret_match, unsigned *ret_stop) {
+        static const uint8_t offsets[GROUP_SIZE] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+        uint8x16_t d, e;
+
+        d = vld1q_u8(dibs);
+        e = vaddq_u8(vdupq_n_u8((uint8_t) distance), vld1q_u8(offsets));
+
+        *ret_match = group_movemask(vceqq_u8(d, e));
+        *ret_stop = group_movemask(vorrq_u8(vcltq_u8(d, e), vceqq_u8(d, vdupq_n_u8(DIB_RAW_FREE))));
+}
+#endif
+#endif
+
 #if ENABLE_DEBUG_HASHMAP
 struct hashmap_debug_info {
         LIST_FIELDS(struct hashmap_debug_info, debug_list);
@@ -335,7 +403,10 @@ static unsigned base_bucket_hash(HashmapBase *h, const void *p) {
         struct siphash state;
         uint64_t hash;
 
-        siphash24_init(&state, hash_key(h));
+        if (h->hash_ops->siphash13)
+                siphash13_init(&state, hash_key(h));
+        else
+                siphash24_init(&state, hash_key(h));
 
         h->hash_ops->hash(p, &state);
 
@@ -445,6 +516,16 @@ static unsigned skip_free_buckets(HashmapBase *h, unsigned idx) {
 
         dibs = dib_raw_ptr(h);
 
+#if HASHMAP_GROUP_PROBING
+        for ( ; idx + GROUP_SIZE <= n_buckets(h); idx += GROUP_SIZE) {
+                unsigned used;
+
+                used = ~group_match_free(dibs + idx) & ((1U << GROUP_SIZE) - 1);
+                if (used != 0)
+                        return idx + __builtin_ctz(used);
+        }
+#endif
+
         for ( ; idx < n_buckets(h); idx++)
                 if (dibs[idx] != DIB_RAW_FREE)
                         return idx;
@@ -1187,6 +1268,33 @@ static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key)
         assert(idx < n_buckets(h));
 
         for (distance = 0; ; distance++) {
+#if HASHMAP_GROUP_PROBING
+                /* Look at a whole group of buckets at once, as long as it does not wrap around the end of the
+                 * table and none of the DIBs to compare with would have to be stored as DIB_RAW_OVERFLOW. */
+                while (idx + GROUP_SIZE <= n_buckets(h) && distance + GROUP_SIZE <= DIB_RAW_OVERFLOW) {
+                        unsigned match, stop;
+
+                        group_match_dib(dibs + idx, distance, &match, &stop);
+
+                        /* Entries after the first stop bucket belong to other chains */
+                        if (stop != 0)
+                                match &= (1U << __builtin_ctz(stop)) - 1;
+
+                        for (; match != 0; match &= match - 1) {
+                                unsigned i = idx + __builtin_ctz(match);
+
+                                e = bucket_at(h, i);
+                                if (h->hash_ops->compare(e->key, key) == 0)
+                                        return i;
+                        }
+
+                        if (stop != 0)
+                                return IDX_NIL;
+
+                        idx = (idx + GROUP_SIZE) % n_buckets(h);
+                        distance += GROUP_SIZE;
+                }
+#endif
                 if (dibs[idx] == DIB_RAW_FREE)
                         return IDX_NIL;
 
@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-util.h"
+#include "intern.h"
+#include "set.h"
+#include "strv.h"
+
+typedef struct InternedString {
+        unsigned n_ref;
+        char string[];
+} InternedString;
+
+/* Contains the 'string' fields of all InternedString objects */
+static Set *interned = NULL;
+
+static InternedString *interned_string_from_string(const char *s) {
+        return (InternedString*) (s - offsetof(InternedString, string));
+}
+
+const char *intern_lookup(const char *s) {
+        assert(s);
+
+        return set_get(interned, (char*) s);
+}
+
+const char *intern(const char *s) {
+        InternedString *i;
+        const char *found;
+        size_t l;
+
+        assert(s);
+
+        found = intern_lookup(s);
+        if (found)
+                return intern_ref(found);
+
+        if (set_ensure_allocated(&interned, &string_hash_ops) < 0)
+                return NULL;
+
+        l = strlen(s);
+
+        i = malloc(offsetof(InternedString, string) + l + 1);
+        if (!i)
+                return NULL;
+
+        i->n_ref = 1;
+        memcpy(i->string, s, l + 1);
+
+        if (set_put(interned, i->string) < 0) {
+                free(i);
+                return NULL;
+        }
+
+        return i->string;
+}
+
+const char *intern_ref(const char *s) {
+        InternedString *i;
+
+        if (!s)
+                return NULL;
+
+        i = interned_string_from_string(s);
+        assert(i->n_ref > 0);
+        assert(i->n_ref < UINT_MAX);
+
+        i->n_ref++;
+        return s;
+}
+
+const char *intern_unref(const char *s) {
+        InternedString *i;
+
+        if (!s)
+                return NULL;
+
+        i = interned_string_from_string(s);
+        assert(i->n_ref > 0);
+
+        i->n_ref--;
+        if (i->n_ref > 0)
+                return NULL;
+
+        assert_se(set_remove(interned, s) == s);
+        free(i);
+
+        if (set_isempty(interned))
+                interned = set_free(interned);
+
+        return NULL;
+}
+
+size_t intern_size(void) {
+        return set_size(interned);
+}
+
+int intern_strv_extend(char ***l, const char *value) {
+        const char *s;
+        char **i;
+        int r;
+
+        assert(l);
+        assert(value);
+
+        s = intern(value);
+        if (!s)
+                return -ENOMEM;
+
+        /* All entries are interned, hence a pointer comparison suffices */
+        STRV_FOREACH(i, *l)
+                if (*i == s) {
+                        intern_unref(s);
+                        return 0;
+                }
+
+        r = strv_push(l, (char*) s);
+        if (r < 0) {
+                intern_unref(s);
+                return r;
+        }
+
+        return 1;
+}
+
+char **intern_strv_free(char **l) {
+        char **i;
+
+        STRV_FOREACH(i, l)
+                intern_unref(*i);
+
+        return mfree(l);
+}
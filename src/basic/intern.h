@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stddef.h>
+
+#include "macro.h"
+
+/* A process-wide table of reference counted strings. Each distinct string is stored only once, no matter how often
+ * it is interned, hence interned strings may be compared by pointer. Interned strings must not be modified or
+ * passed to free(), but only released with intern_unref(). Not thread-safe, meant for use by the main thread of
+ * daemons like PID 1 that keep many copies of the same strings around. */
+
+const char *intern(const char *s);
+const char *intern_ref(const char *s);
+const char *intern_unref(const char *s);
+
+/* Returns the interned version of s if there is one, without taking a reference */
+const char *intern_lookup(const char *s);
+
+size_t intern_size(void);
+
+/* Appends the interned version of value to the string array *l, unless it is already contained in it */
+int intern_strv_extend(char ***l, const char *value);
+
+/* Releases all strings in an array built with intern_strv_extend(), and the array itself */
+char **intern_strv_free(char **l);
+DEFINE_TRIVIAL_CLEANUP_FUNC(char**, intern_strv_free);
@@ -41,6 +41,9 @@
 
 #define SNDBUF_SIZE (8*1024*1024)
 
+/* How many queued journal messages to pass to a single sendmmsg() call */
+#define LOG_QUEUE_BATCH_MAX 64U
+
 static LogTarget log_target = LOG_TARGET_CONSOLE;
 static int log_max_level[] = {LOG_INFO, LOG_INFO};
 assert_cc(ELEMENTSOF(log_max_level) == _LOG_REALM_MAX);
@@ -65,6 +68,19 @@ static bool prohibit_ipc = false;
  * use here. */
 static char *log_abort_msg = NULL;
 
+/* If enabled, messages for the journal are copied into a bounded queue instead of being sent one by one, and the
+ * queue is sent in batches by log_queue_flush(). Only the thread and the process that enabled the queue use it:
+ * other threads send directly, and a forked off child ignores what it inherited, so that nothing is sent twice. */
+typedef struct LogQueueEntry {
+        struct iovec iovec;
+        int level;
+} LogQueueEntry;
+
+static thread_local LogQueueEntry *log_queue = NULL;
+static thread_local size_t log_queue_max = 0, log_queue_head = 0, log_queue_n = 0;
+static thread_local pid_t log_queue_pid = 0;
+static thread_local uint64_t log_queue_n_dropped = 0, log_queue_n_reported = 0;
+
 /* An assert to use in logging functions that does not call recursively
  * into our logging functions (since that might lead to a loop). */
 #define assert_raw(expr)                                                \
@@ -186,7 +202,161 @@ fail:
         return r;
 }
 
+static bool log_queue_active(void) {
+        return log_queue && log_queue_pid == getpid_cached();
+}
+
+static void log_queue_pop(size_t n) {
+        assert_raw(n <= log_queue_n);
+
+        for (; n > 0; n--) {
+                free(log_queue[log_queue_head].iovec.iov_base);
+                log_queue[log_queue_head] = (LogQueueEntry) {};
+
+                log_queue_head = (log_queue_head + 1) % log_queue_max;
+                log_queue_n--;
+        }
+}
+
+static void log_queue_discard(void) {
+        log_queue_n_dropped += log_queue_n;
+        log_queue_pop(log_queue_n);
+}
+
+static void log_queue_replay(void) {
+        size_t n;
+
+        /* The journal is gone. Pass what was queued for it on to the next log target, the way it would have
+         * been if it had been sent directly. Only the messages queued right now are looked at, in case they
+         * end up queued again. */
+
+        if (IN_SET(log_target, LOG_TARGET_AUTO, LOG_TARGET_JOURNAL_OR_KMSG))
+                (void) log_open_kmsg();
+
+        for (n = log_queue_n; n > 0 && log_queue_n > 0; n--) {
+                LogQueueEntry *e = log_queue + log_queue_head;
+                const char *p, *end;
+                char *buffer;
+                int level;
+
+                level = e->level;
+                p = e->iovec.iov_base;
+                end = p + e->iovec.iov_len;
+
+                /* Find the MESSAGE= field, each field is terminated by a newline */
+                while (p < end && !memory_startswith(p, end - p, "MESSAGE=")) {
+                        p = memchr(p, '\n', end - p);
+                        if (!p)
+                                break;
+                        p++;
+                }
+
+                if (p && p < end) {
+                        p += STRLEN("MESSAGE=");
+                        buffer = strndup(p, (const char*) (memchr(p, '\n', end - p) ?: end) - p);
+                } else
+                        buffer = NULL;
+
+                log_queue_pop(1);
+
+                if (!buffer) {
+                        log_queue_n_dropped++;
+                        continue;
+                }
+
+                (void) log_dispatch_internal(level, 0, NULL, 0, NULL, NULL, NULL, NULL, NULL, buffer);
+                free(buffer);
+        }
+}
+
+static int log_queue_drain(void) {
+
+        if (!log_queue_active())
+                return 0;
+
+        while (log_queue_n > 0) {
+                struct mmsghdr mmsg[LOG_QUEUE_BATCH_MAX] = {};
+                size_t n, i;
+                int k;
+
+                if (journal_fd < 0) {
+                        log_queue_replay();
+                        return 0;
+                }
+
+                n = MIN(log_queue_n, LOG_QUEUE_BATCH_MAX);
+                for (i = 0; i < n; i++) {
+                        mmsg[i].msg_hdr.msg_iov = &log_queue[(log_queue_head + i) % log_queue_max].iovec;
+                        mmsg[i].msg_hdr.msg_iovlen = 1;
+                }
+
+                k = sendmmsg(journal_fd, mmsg, n, MSG_NOSIGNAL);
+                if (k < 0) {
+                        int r = -errno;
+
+                        if (r == -EAGAIN)
+                                return r;
+
+                        /* The journal went away, hand what is queued to the next log target instead */
+                        journal_fd = safe_close(journal_fd);
+                        log_queue_replay();
+                        return r;
+                }
+
+                log_queue_pop(k);
+        }
+
+        return 0;
+}
+
+static int log_queue_push(int level, const struct iovec *iovec, size_t n) {
+        char timestamp[STRLEN("SOURCE_REALTIME_TIMESTAMP=") + DECIMAL_STR_MAX(usec_t) + 2];
+        size_t size = 0, i;
+        char *p, *q;
+
+        /* Returns 1 if the message was queued, -EAGAIN if the queue is full and the journal does not take
+         * anything right now, and 0 if the message should be sent directly. */
+
+        if (!log_queue_active())
+                return 0;
+
+        if (log_queue_n >= log_queue_max) {
+                (void) log_queue_drain();
+
+                if (log_queue_n >= log_queue_max) {
+                        log_queue_n_dropped++;
+                        return -EAGAIN;
+                }
+        }
+
+        /* The message reaches the journal later than it would have if it was sent right away. Tell it when the
+         * message was logged, so that it can use that rather than the time it received the message. */
+        xsprintf(timestamp, "SOURCE_REALTIME_TIMESTAMP=" USEC_FMT "\n", now(CLOCK_REALTIME));
+
+        for (i = 0; i < n; i++)
+                size += iovec[i].iov_len;
+        size += strlen(timestamp);
+
+        p = malloc(size);
+        if (!p)
+                return 0;
+
+        q = p;
+        for (i = 0; i < n; i++)
+                q = mempcpy(q, iovec[i].iov_base, iovec[i].iov_len);
+        memcpy(q, timestamp, strlen(timestamp));
+
+        log_queue[(log_queue_head + log_queue_n) % log_queue_max] = (LogQueueEntry) {
+                .iovec = IOVEC_MAKE(p, size),
+                .level = level,
+        };
+        log_queue_n++;
+
+        return 1;
+}
+
 static void log_close_journal(void) {
+        (void) log_queue_drain();
         journal_fd = safe_close(journal_fd);
 }
 
@@ -522,6 +692,29 @@ static int log_do_header(
         return 0;
 }
 
+static int send_to_journal(int level, const struct iovec *iovec, size_t n) {
+        struct msghdr mh = {
+                .msg_iov = (struct iovec*) iovec,
+                .msg_iovlen = n,
+        };
+        int r;
+
+        /* Errors are sent right away, after everything that was queued before them, so that they are not lost if
+         * we die before the queue is drained. */
+        if (LOG_PRI(level) > LOG_ERR) {
+                r = log_queue_push(level, iovec, n);
+                if (r != 0)
+                        return r;
+        }
+
+        (void) log_queue_drain();
+
+        if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL) < 0)
+                return -errno;
+
+        return 1;
+}
+
 static int write_to_journal(
                 int level,
                 int error,
@@ -536,7 +729,6 @@ static int write_to_journal(
 
         char header[LINE_MAX];
         struct iovec iovec[4] = {};
-        struct msghdr mh = {};
 
         if (journal_fd < 0)
                 return 0;
@@ -548,13 +740,7 @@ static int write_to_journal(
         iovec[2] = IOVEC_MAKE_STRING(buffer);
         iovec[3] = IOVEC_MAKE_STRING("\n");
 
-        mh.msg_iov = iovec;
-        mh.msg_iovlen = ELEMENTSOF(iovec);
-
-        if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL) < 0)
-                return -errno;
-
-        return 1;
+        return send_to_journal(level, iovec, ELEMENTSOF(iovec));
 }
 
 int log_dispatch_internal(
@@ -901,9 +1087,6 @@ int log_struct_internal(
                         struct iovec iovec[17] = {};
                         size_t n = 0, i;
                         int r;
-                        struct msghdr mh = {
-                                .msg_iov = iovec,
-                        };
                         bool fallback = false;
 
                         /* If the journal is available do structured logging.
@@ -915,10 +1098,8 @@ int log_struct_internal(
                         r = log_format_iovec(iovec, ELEMENTSOF(iovec), &n, true, error, format, ap);
                         if (r < 0)
                                 fallback = true;
-                        else {
-                                mh.msg_iovlen = n;
-                                (void) sendmsg(journal_fd, &mh, MSG_NOSIGNAL);
-                        }
+                        else
+                                (void) send_to_journal(level, iovec, n);
 
                         va_end(ap);
                         for (i = 1; i < n; i += 2)
@@ -994,10 +1175,6 @@ int log_struct_iovec_internal(
 
                 struct iovec iovec[1 + n_input_iovec*2];
                 char header[LINE_MAX];
-                struct msghdr mh = {
-                        .msg_iov = iovec,
-                        .msg_iovlen = 1 + n_input_iovec*2,
-                };
 
                 log_do_header(header, sizeof(header), level, error, file, line, func, NULL, NULL, NULL, NULL);
                 iovec[0] = IOVEC_MAKE_STRING(header);
@@ -1007,7 +1184,7 @@ int log_struct_iovec_internal(
                         iovec[1+i*2+1] = IOVEC_MAKE_STRING("\n");
                 }
 
-                if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL) >= 0)
+                if (send_to_journal(level, iovec, 1 + n_input_iovec*2) > 0)
                         return -ERRNO_VALUE(error);
         }
 
@@ -1289,6 +1466,53 @@ void log_set_prohibit_ipc(bool b) {
         prohibit_ipc = b;
 }
 
+int log_queue_enable(size_t max) {
+        assert(max > 0);
+
+        if (log_queue_active())
+                return 0;
+
+        log_queue = new0(LogQueueEntry, max);
+        if (!log_queue)
+                return -ENOMEM;
+
+        log_queue_max = max;
+        log_queue_head = log_queue_n = 0;
+        log_queue_pid = getpid_cached();
+
+        return 0;
+}
+
+void log_queue_disable(void) {
+        if (!log_queue_active())
+                return;
+
+        (void) log_queue_drain();
+        log_queue_discard();
+
+        log_queue = mfree(log_queue);
+        log_queue_max = 0;
+}
+
+int log_queue_flush(void) {
+        int r;
+
+        r = log_queue_drain();
+
+        if (log_queue_n_dropped > log_queue_n_reported) {
+                uint64_t n = log_queue_n_dropped - log_queue_n_reported;
+
+                log_queue_n_reported = log_queue_n_dropped;
+                log_warning("%" PRIu64 " log messages could not be queued for or sent to the journal.", n);
+        }
+
+        return r;
+}
+
+uint64_t log_queue_get_dropped(void) {
+        return log_queue_n_dropped;
+}
+
 int log_emergency_level(void) {
         /* Returns the log level to use for log_emergency() logging. We use LOG_EMERG only when we are PID 1, as only
          * then the system of the whole system is obviously affected. */
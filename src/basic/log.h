@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <syslog.h>
 
@@ -280,6 +281,15 @@ void log_set_open_when_needed(bool b);
  * stderr, the console or kmsg */
 void log_set_prohibit_ipc(bool b);
 
+/* If enabled, messages for the journal below LOG_ERR are queued, up to the specified number, and sent in batches when
+ * log_queue_flush() is called, which should hence be done from the event loop after each iteration. If the queue is
+ * full it is drained synchronously, and if that does not work either the message goes to the next log target. Do not
+ * call from library code. */
+int log_queue_enable(size_t max);
+void log_queue_disable(void);
+int log_queue_flush(void);
+uint64_t log_queue_get_dropped(void);
+
 int log_dup_console(void);
 
 int log_syntax_internal(
@@ -86,7 +86,6 @@ bool mempool_enabled(void) {
         return b;
 }
 
-#if VALGRIND
 void mempool_drop(struct mempool *mp) {
         struct pool *p = mp->first_pool;
         while (p) {
@@ -95,5 +94,7 @@ void mempool_drop(struct mempool *mp) {
                 free(p);
                 p = n;
         }
+
+        mp->first_pool = NULL;
+        mp->freelist = NULL;
 }
-#endif
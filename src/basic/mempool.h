@@ -26,6 +26,4 @@ static struct mempool pool_name = { \
 extern const bool mempool_use_allowed;
 bool mempool_enabled(void);
 
-#if VALGRIND
 void mempool_drop(struct mempool *mp);
-#endif
@@ -5,6 +5,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -444,3 +445,135 @@ static inline ssize_t missing_statx(int dfd, const char *filename, unsigned flag
 
 #  define statx missing_statx
 #endif
+
+/* ======================================================================= */
+
+#if HAVE_PIDFD_OPEN
+#  include <sys/pidfd.h>
+#else
+#  ifndef __NR_pidfd_open
+#    if defined __alpha__
+#      define __NR_pidfd_open 544
+#    else
+/* New system calls got the same number on all other architectures since Linux 5.1 */
+#      define __NR_pidfd_open 434
+#    endif
+#  endif
+
+static inline int missing_pidfd_open(pid_t pid, unsigned flags) {
+        return syscall(__NR_pidfd_open, pid, flags);
+}
+
+#  define pidfd_open missing_pidfd_open
+#endif
+
+/* ======================================================================= */
+
+#if !HAVE_SET_MEMPOLICY
+static inline long missing_set_mempolicy(int mode, const unsigned long *nodemask, unsigned long maxnode) {
+#  ifdef __NR_set_mempolicy
+        return syscall(__NR_set_mempolicy, mode, nodemask, maxnode);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+
+#  define set_mempolicy missing_set_mempolicy
+#endif
+
+#if !HAVE_GET_MEMPOLICY
+static inline long missing_get_mempolicy(int *mode, unsigned long *nodemask, unsigned long maxnode, void *addr, unsigned long flags) {
+#  ifdef __NR_get_mempolicy
+        return syscall(__NR_get_mempolicy, mode, nodemask, maxnode, addr, flags);
+#  else
+        errno = ENOSYS;
+        return -1;
+#  endif
+}
+
+#  define get_mempolicy missing_get_mempolicy
+#endif
+
+/* ======================================================================= */
+
+#if HAVE_OPEN_TREE || HAVE_MOVE_MOUNT || HAVE_MOUNT_SETATTR
+#  include <sys/mount.h>
+#endif
+
+#ifndef OPEN_TREE_CLONE
+#  define OPEN_TREE_CLONE 1
+#endif
+
+#ifndef OPEN_TREE_CLOEXEC
+#  define OPEN_TREE_CLOEXEC O_CLOEXEC
+#endif
+
+#ifndef MOVE_MOUNT_F_EMPTY_PATH
+#  define MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+#endif
+
+#ifndef MOUNT_ATTR_IDMAP
+#  define MOUNT_ATTR_IDMAP 0x00100000
+#endif
+
+#ifndef AT_RECURSIVE
+#  define AT_RECURSIVE 0x8000
+#endif
+
+#if !HAVE_OPEN_TREE
+#  ifndef __NR_open_tree
+#    if defined __alpha__
+#      define __NR_open_tree 538
+#    else
+#      define __NR_open_tree 428
+#    endif
+#  endif
+
+static inline int missing_open_tree(int dfd, const char *filename, unsigned flags) {
+        return syscall(__NR_open_tree, dfd, filename, flags);
+}
+
+#  define open_tree missing_open_tree
+#endif
+
+#if !HAVE_MOVE_MOUNT
+#  ifndef __NR_move_mount
+#    if defined __alpha__
+#      define __NR_move_mount 539
+#    else
+#      define __NR_move_mount 429
+#    endif
+#  endif
+
+static inline int missing_move_mount(int from_dfd, const char *from_pathname, int to_dfd, const char *to_pathname, unsigned flags) {
+        return syscall(__NR_move_mount, from_dfd, from_pathname, to_dfd, to_pathname, flags);
+}
+
+#  define move_mount missing_move_mount
+#endif
+
+#if !HAVE_MOUNT_SETATTR
+#  ifndef __NR_mount_setattr
+#    if defined __alpha__
+#      define __NR_mount_setattr 552
+#    else
+#      define __NR_mount_setattr 442
+#    endif
+#  endif
+
+struct missing_mount_attr {
+        uint64_t attr_set;
+        uint64_t attr_clr;
+        uint64_t propagation;
+        uint64_t userns_fd;
+};
+
+#  define mount_attr missing_mount_attr
+
+static inline int missing_mount_setattr(int dfd, const char *path, unsigned flags, struct mount_attr *attr, size_t size) {
+        return syscall(__NR_mount_setattr, dfd, path, flags, attr, size);
+}
+
+#  define mount_setattr missing_mount_setattr
+#endif
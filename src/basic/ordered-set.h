@@ -36,6 +36,10 @@ static inline bool ordered_set_isempty(OrderedSet *s) {
         return ordered_hashmap_isempty((OrderedHashmap*) s);
 }
 
+static inline unsigned ordered_set_size(OrderedSet *s) {
+        return ordered_hashmap_size((OrderedHashmap*) s);
+}
+
 static inline bool ordered_set_iterate(OrderedSet *s, Iterator *i, void **value) {
         return ordered_hashmap_iterate((OrderedHashmap*) s, i, value, NULL);
 }
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "hashmap.h"
 #include "macro.h"
@@ -10,14 +11,21 @@ typedef struct Prioq Prioq;
 
 #define PRIOQ_IDX_NULL ((unsigned) -1)
 
+/* If compare is NULL, items are ordered by the key passed to prioq_put_key() and prioq_reshuffle_key(), smallest
+ * first. */
 Prioq *prioq_new(compare_func_t compare);
 Prioq *prioq_free(Prioq *q);
 DEFINE_TRIVIAL_CLEANUP_FUNC(Prioq*, prioq_free);
 int prioq_ensure_allocated(Prioq **q, compare_func_t compare_func);
 
 int prioq_put(Prioq *q, void *data, unsigned *idx);
+int prioq_put_key(Prioq *q, void *data, unsigned *idx, uint64_t key);
+/* Adds n items at once. idx and keys may be NULL. Cheaper than adding them one by one when filling a queue. */
+int prioq_put_many(Prioq *q, void * const *data, unsigned * const *idx, const uint64_t *keys, unsigned n);
 int prioq_remove(Prioq *q, void *data, unsigned *idx);
 int prioq_reshuffle(Prioq *q, void *data, unsigned *idx);
+/* Changes the key of an item in a queue without compare function, and moves it to its new position */
+int prioq_reshuffle_key(Prioq *q, void *data, unsigned *idx, uint64_t key);
 
 void *prioq_peek(Prioq *q) _pure_;
 void *prioq_pop(Prioq *q);
@@ -109,7 +109,7 @@ int mac_selinux_fix(const char *path, LabelFixFlags flags) {
 
 #if HAVE_SELINUX
         char procfs_path[STRLEN("/proc/self/fd/") + DECIMAL_STR_MAX(int)];
-        _cleanup_freecon_ char* fcon = NULL;
+        _cleanup_freecon_ char* fcon = NULL, *oldcon = NULL;
         _cleanup_close_ int fd = -1;
         struct stat st;
         int r;
@@ -143,9 +143,13 @@ int mac_selinux_fix(const char *path, LabelFixFlags flags) {
         }
 
         xsprintf(procfs_path, "/proc/self/fd/%i", fd);
-        if (setfilecon_raw(procfs_path, fcon) < 0) {
-                _cleanup_freecon_ char *oldcon = NULL;
 
+        /* If the old label is identical to the new one, there's nothing to do. Reading it is cheaper than
+         * writing it again, and this also avoids any kind of error on read-only file systems. */
+        if (getfilecon_raw(procfs_path, &oldcon) >= 0 && streq(fcon, oldcon))
+                return 0;
+
+        if (setfilecon_raw(procfs_path, fcon) < 0) {
                 r = -errno;
 
                 /* If the FS doesn't support labels, then exit without warning */
@@ -156,10 +160,6 @@ int mac_selinux_fix(const char *path, LabelFixFlags flags) {
                 if (r == -EROFS && (flags & LABEL_IGNORE_EROFS))
                         return 0;
 
-                /* If the old label is identical to the new one, suppress any kind of error */
-                if (getfilecon_raw(procfs_path, &oldcon) >= 0 && streq(fcon, oldcon))
-                        return 0;
-
                 goto fail;
         }
 
@@ -48,7 +48,7 @@ static void sipround(struct siphash *state) {
         state->v2 = rotate_left(state->v2, 32);
 }
 
-void siphash24_init(struct siphash *state, const uint8_t k[static 16]) {
+static void siphash_init(struct siphash *state, const uint8_t k[static 16], bool siphash13) {
         uint64_t k0, k1;
 
         assert(state);
@@ -65,9 +65,24 @@ void siphash24_init(struct siphash *state, const uint8_t k[static 16]) {
                 .v3 = 0x7465646279746573ULL ^ k1,
                 .padding = 0,
                 .inlen = 0,
+                .siphash13 = siphash13,
         };
 }
 
+void siphash24_init(struct siphash *state, const uint8_t k[static 16]) {
+        siphash_init(state, k, false);
+}
+
+void siphash13_init(struct siphash *state, const uint8_t k[static 16]) {
+        siphash_init(state, k, true);
+}
+
+static void sipround_compress(struct siphash *state) {
+        sipround(state);
+        if (!state->siphash13)
+                sipround(state);
+}
+
 void siphash24_compress(const void *_in, size_t inlen, struct siphash *state) {
 
         const uint8_t *in = _in;
@@ -99,8 +114,7 @@ void siphash24_compress(const void *_in, size_t inlen, struct siphash *state) {
 #endif
 
                 state->v3 ^= state->padding;
-                sipround(state);
-                sipround(state);
+                sipround_compress(state);
                 state->v0 ^= state->padding;
 
                 state->padding = 0;
@@ -118,8 +132,7 @@ void siphash24_compress(const void *_in, size_t inlen, struct siphash *state) {
                 printf("(%3zu) compress %08x %08x\n", state->inlen, (uint32_t) (m >> 32), (uint32_t) m);
 #endif
                 state->v3 ^= m;
-                sipround(state);
-                sipround(state);
+                sipround_compress(state);
                 state->v0 ^= m;
         }
 
@@ -167,8 +180,7 @@ uint64_t siphash24_finalize(struct siphash *state) {
 #endif
 
         state->v3 ^= b;
-        sipround(state);
-        sipround(state);
+        sipround_compress(state);
         state->v0 ^= b;
 
 #if ENABLE_DEBUG_SIPHASH
@@ -182,7 +194,8 @@ uint64_t siphash24_finalize(struct siphash *state) {
         sipround(state);
         sipround(state);
         sipround(state);
-        sipround(state);
+        if (!state->siphash13)
+                sipround(state);
 
         return state->v0 ^ state->v1 ^ state->v2  ^ state->v3;
 }
@@ -198,3 +211,15 @@ uint64_t siphash24(const void *in, size_t inlen, const uint8_t k[static 16]) {
 
         return siphash24_finalize(&state);
 }
+
+uint64_t siphash13(const void *in, size_t inlen, const uint8_t k[static 16]) {
+        struct siphash state;
+
+        assert(in);
+        assert(k);
+
+        siphash13_init(&state, k);
+        siphash24_compress(in, inlen, &state);
+
+        return siphash24_finalize(&state);
+}
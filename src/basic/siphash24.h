@@ -1,6 +1,7 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
@@ -13,15 +14,21 @@ struct siphash {
         uint64_t v3;
         uint64_t padding;
         size_t inlen;
+        bool siphash13;
 };
 
 void siphash24_init(struct siphash *state, const uint8_t k[static 16]);
+/* SipHash-1-3, i.e. with one compression and three finalization rounds instead of two and four. Considerably faster
+ * for short inputs, and still keyed, but with a smaller security margin. Use the same siphash24_compress() and
+ * siphash24_finalize() calls on the state. */
+void siphash13_init(struct siphash *state, const uint8_t k[static 16]);
 void siphash24_compress(const void *in, size_t inlen, struct siphash *state);
 #define siphash24_compress_byte(byte, state) siphash24_compress((const uint8_t[]) { (byte) }, 1, (state))
 
 uint64_t siphash24_finalize(struct siphash *state);
 
 uint64_t siphash24(const void *in, size_t inlen, const uint8_t k[static 16]);
+uint64_t siphash13(const void *in, size_t inlen, const uint8_t k[static 16]);
 
 static inline uint64_t siphash24_string(const char *s, const uint8_t k[static 16]) {
         return siphash24(s, strlen(s) + 1, k);
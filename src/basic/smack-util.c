@@ -124,6 +124,7 @@ int mac_smack_apply_pid(pid_t pid, const char *label) {
 
 static int smack_fix_fd(int fd , const char *abspath, LabelFixFlags flags) {
         char procfs_path[STRLEN("/proc/self/fd/") + DECIMAL_STR_MAX(int)];
+        _cleanup_free_ char *old_label = NULL;
         const char *label;
         struct stat st;
         int r;
@@ -155,9 +156,13 @@ static int smack_fix_fd(int fd , const char *abspath, LabelFixFlags flags) {
                 return 0;
 
         xsprintf(procfs_path, "/proc/self/fd/%i", fd);
-        if (setxattr(procfs_path, "security.SMACK64", label, strlen(label), 0) < 0) {
-                _cleanup_free_ char *old_label = NULL;
 
+        /* If the old label is identical to the new one, there's nothing to do, and no error to report */
+        if (getxattr_malloc(procfs_path, "security.SMACK64", &old_label, false) >= 0 &&
+            streq(old_label, label))
+                return 0;
+
+        if (setxattr(procfs_path, "security.SMACK64", label, strlen(label), 0) < 0) {
                 r = -errno;
 
                 /* If the FS doesn't support labels, then exit without warning */
@@ -168,11 +173,6 @@ static int smack_fix_fd(int fd , const char *abspath, LabelFixFlags flags) {
                 if (r == -EROFS && (flags & LABEL_IGNORE_EROFS))
                         return 0;
 
-                /* If the old label is identical to the new one, suppress any kind of error */
-                if (getxattr_malloc(procfs_path, "security.SMACK64", &old_label, false) >= 0 &&
-                    streq(old_label, label))
-                        return 0;
-
                 return log_debug_errno(r, "Unable to fix SMACK label of %s: %m", abspath);
         }
 
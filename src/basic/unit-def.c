@@ -2,6 +2,7 @@
 
 #include "alloc-util.h"
 #include "bus-label.h"
+#include "fs-util.h"
 #include "string-table.h"
 #include "unit-def.h"
 #include "unit-name.h"
@@ -34,6 +35,58 @@ int unit_name_from_dbus_path(const char *path, char **name) {
         return 0;
 }
 
+/* PID 1 exports the active state of each loaded unit as a symlink "active-state:<unit>" in /run/systemd/units/,
+ * pointing to the state string. Other programs may read it without connecting to PID 1. The directory is only
+ * overridden in tests. */
+static const char *active_state_dir(const char *dir) {
+        return dir ?: "/run/systemd/units";
+}
+
+int unit_active_state_export(const char *dir, const char *unit, UnitActiveState state) {
+        const char *p;
+
+        assert(unit);
+        assert(state >= 0 && state < _UNIT_ACTIVE_STATE_MAX);
+
+        /* Replaces the link atomically, readers always see either the old or the new state */
+        p = strjoina(active_state_dir(dir), "/active-state:", unit);
+        return symlink_atomic(unit_active_state_to_string(state), p);
+}
+
+int unit_active_state_read_exported(const char *dir, const char *unit, UnitActiveState *ret) {
+        _cleanup_free_ char *s = NULL;
+        UnitActiveState state;
+        const char *p;
+        int r;
+
+        assert(unit);
+        assert(ret);
+
+        p = strjoina(active_state_dir(dir), "/active-state:", unit);
+        r = readlink_malloc(p, &s);
+        if (r < 0)
+                return r;
+
+        state = unit_active_state_from_string(s);
+        if (state < 0)
+                return -EBADMSG;
+
+        *ret = state;
+        return 0;
+}
+
+int unit_active_state_unexport(const char *dir, const char *unit) {
+        const char *p;
+
+        assert(unit);
+
+        p = strjoina(active_state_dir(dir), "/active-state:", unit);
+        if (unlink(p) < 0)
+                return -errno;
+
+        return 0;
+}
+
 const char* unit_dbus_interface_from_type(UnitType t) {
 
         static const char *const table[_UNIT_TYPE_MAX] = {
@@ -235,6 +235,10 @@ int unit_name_from_dbus_path(const char *path, char **name);
 const char* unit_dbus_interface_from_type(UnitType t);
 const char *unit_dbus_interface_from_name(const char *name);
 
+int unit_active_state_export(const char *dir, const char *unit, UnitActiveState state);
+int unit_active_state_read_exported(const char *dir, const char *unit, UnitActiveState *ret);
+int unit_active_state_unexport(const char *dir, const char *unit);
+
 const char *unit_type_to_string(UnitType i) _const_;
 UnitType unit_type_from_string(const char *s) _pure_;
 
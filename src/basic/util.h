@@ -217,6 +217,12 @@ static inline unsigned log2u(unsigned x) {
         return sizeof(unsigned) * 8 - __builtin_clz(x) - 1;
 }
 
+static inline unsigned log2u64(uint64_t x) {
+        assert(x > 0);
+
+        return sizeof(uint64_t) * 8 - __builtin_clzll(x) - 1;
+}
+
 static inline unsigned log2u_round_up(unsigned x) {
         assert(x > 0);
 
@@ -37,6 +37,8 @@ typedef struct {
         enum loader_type type;
         CHAR16 *loader;
         CHAR16 *options;
+        UINTN options_offset;   /* if options_size > 0, the options are read from the loader when first needed */
+        UINTN options_size;
         CHAR16 key;
         EFI_STATUS (*call)(VOID);
         BOOLEAN no_autoselect;
@@ -351,6 +353,33 @@ static UINTN entry_lookup_key(Config *config, UINTN start, CHAR16 key) {
         return -1;
 }
 
+static VOID config_entry_load_options(ConfigEntry *entry) {
+        _cleanup_(FileHandleClosep) EFI_FILE_HANDLE root_dir = NULL;
+        _cleanup_freepool_ CHAR8 *content = NULL;
+        UINTN size;
+        EFI_STATUS err;
+
+        if (entry->options || entry->options_size == 0)
+                return;
+
+        size = entry->options_size;
+        entry->options_size = 0;
+
+        root_dir = LibOpenRoot(entry->device);
+        if (!root_dir)
+                return;
+
+        err = file_read(root_dir, entry->loader, entry->options_offset, size, &content, &size);
+        if (EFI_ERROR(err) || size == 0)
+                return;
+
+        /* chomp the newline */
+        if (content[size-1] == '\n')
+                content[size-1] = '\0';
+
+        entry->options = stra_to_str(content);
+}
+
 static VOID print_status(Config *config, CHAR16 *loaded_image_path) {
         UINT64 key;
         UINTN i;
@@ -446,6 +475,7 @@ static VOID print_status(Config *config, CHAR16 *loaded_image_path) {
                 }
                 if (entry->loader)
                         Print(L"loader                  '%s'\n", entry->loader);
+                config_entry_load_options(entry);
                 if (entry->options)
                         Print(L"options                 '%s'\n", entry->options);
                 Print(L"auto-select             %s\n", yes_no(!entry->no_autoselect));
@@ -797,6 +827,7 @@ static BOOLEAN menu_run(
                         uefi_call_wrapper(ST->ConOut->SetAttribute, 2, ST->ConOut, EFI_LIGHTGRAY|EFI_BACKGROUND_BLACK);
                         uefi_call_wrapper(ST->ConOut->SetCursorPosition, 3, ST->ConOut, 0, y_max-1);
                         uefi_call_wrapper(ST->ConOut->OutputString, 2, ST->ConOut, clearline+1);
+                        config_entry_load_options(config->entries[idx_highlight]);
                         if (line_edit(config->entries[idx_highlight]->options, &config->options_edit, x_max-1, y_max-1))
                                 exit = TRUE;
                         uefi_call_wrapper(ST->ConOut->SetCursorPosition, 3, ST->ConOut, 0, y_max-1);
@@ -1834,6 +1865,232 @@ static VOID config_entry_add_osx(Config *config) {
         }
 }
 
+/* What we learned about a unified kernel image in \EFI\Linux\ from its PE sections, as remembered in the
+ * LoaderLinuxCache EFI variable. The variable starts with the format version, followed by one record per image.
+ * Each record is followed by the file name, the entry id and the title as NUL-terminated CHAR16 strings, of the
+ * given lengths. An empty id marks an image that is not a boot entry. */
+typedef struct {
+        UINT64 file_size;
+        EFI_TIME modification_time;
+        UINT64 options_offset;
+        UINT64 options_size;
+        UINT16 file_name_len;
+        UINT16 id_len;
+        UINT16 title_len;
+} __attribute__((packed)) LinuxCacheRecord;
+
+#define LINUX_CACHE_VERSION 1U /* bump when changing the format */
+#define LINUX_CACHE_SIZE_MAX (16U * 1024U)
+
+typedef struct {
+        CHAR8 *buffer;
+        UINTN size;
+} LinuxCache;
+
+static VOID linux_cache_load(LinuxCache *cache) {
+        EFI_STATUS err;
+        UINT32 version;
+
+        *cache = (LinuxCache) {};
+
+        err = efivar_get_raw(&loader_guid, L"LoaderLinuxCache", &cache->buffer, &cache->size);
+        if (EFI_ERROR(err))
+                return;
+
+        if (cache->size < sizeof(version))
+                goto invalid;
+
+        CopyMem(&version, cache->buffer, sizeof(version));
+        if (version != LINUX_CACHE_VERSION)
+                goto invalid;
+
+        return;
+
+invalid:
+        FreePool(cache->buffer);
+        *cache = (LinuxCache) {};
+}
+
+static BOOLEAN linux_cache_find(
+                LinuxCache *cache,
+                EFI_FILE_INFO *f,
+                LinuxCacheRecord *ret,
+                CHAR16 **ret_id,
+                CHAR16 **ret_title) {
+
+        UINTN pos = sizeof(UINT32);
+
+        if (!cache->buffer)
+                return FALSE;
+
+        while (pos + sizeof(LinuxCacheRecord) <= cache->size) {
+                LinuxCacheRecord record;
+                CHAR16 *file_name, *id, *title;
+                UINTN len;
+
+                CopyMem(&record, cache->buffer + pos, sizeof(record));
+                pos += sizeof(record);
+
+                len = ((UINTN) record.file_name_len + record.id_len + record.title_len) * sizeof(CHAR16);
+                if (record.file_name_len == 0 || record.id_len == 0 || record.title_len == 0 || pos + len > cache->size)
+                        return FALSE;
+
+                /* The records and strings are all of even size, hence the strings are suitably aligned */
+                file_name = (CHAR16 *) (cache->buffer + pos);
+                id = file_name + record.file_name_len;
+                title = id + record.id_len;
+                pos += len;
+
+                if (file_name[record.file_name_len-1] != '\0' ||
+                    id[record.id_len-1] != '\0' ||
+                    title[record.title_len-1] != '\0')
+                        return FALSE;
+
+                if (record.file_size != f->FileSize ||
+                    CompareMem(&record.modification_time, &f->ModificationTime, sizeof(EFI_TIME)) != 0 ||
+                    StrCmp(file_name, f->FileName) != 0)
+                        continue;
+
+                *ret = record;
+                *ret_id = id[0] ? StrDuplicate(id) : NULL;
+                *ret_title = id[0] ? StrDuplicate(title) : NULL;
+                return TRUE;
+        }
+
+        return FALSE;
+}
+
+static VOID linux_cache_append(
+                LinuxCache *cache,
+                EFI_FILE_INFO *f,
+                UINTN options_offset,
+                UINTN options_size,
+                CHAR16 *id,
+                CHAR16 *title) {
+
+        LinuxCacheRecord record = {
+                .file_size = f->FileSize,
+                .modification_time = f->ModificationTime,
+                .options_offset = options_offset,
+                .options_size = options_size,
+                .file_name_len = StrLen(f->FileName) + 1,
+                .id_len = id ? StrLen(id) + 1 : 1,
+                .title_len = title ? StrLen(title) + 1 : 1,
+        };
+        UINTN size;
+        CHAR8 *p;
+
+        size = sizeof(record) + ((UINTN) record.file_name_len + record.id_len + record.title_len) * sizeof(CHAR16);
+
+        if (!cache->buffer) {
+                UINT32 version = LINUX_CACHE_VERSION;
+
+                cache->buffer = AllocatePool(sizeof(version) + size);
+                CopyMem(cache->buffer, &version, sizeof(version));
+                cache->size = sizeof(version);
+        } else
+                cache->buffer = ReallocatePool(cache->buffer, cache->size, cache->size + size);
+
+        p = cache->buffer + cache->size;
+        CopyMem(p, &record, sizeof(record));
+        p += sizeof(record);
+        CopyMem(p, f->FileName, record.file_name_len * sizeof(CHAR16));
+        p += record.file_name_len * sizeof(CHAR16);
+        CopyMem(p, id ? : L"", record.id_len * sizeof(CHAR16));
+        p += record.id_len * sizeof(CHAR16);
+        CopyMem(p, title ? : L"", record.title_len * sizeof(CHAR16));
+
+        cache->size += size;
+}
+
+static VOID linux_cache_store(LinuxCache *old, LinuxCache *new) {
+        /* Only write to NVRAM if something changed, to spare the flash */
+        if (old->size == new->size && (new->size == 0 || CompareMem(old->buffer, new->buffer, new->size) == 0))
+                return;
+
+        if (new->size > LINUX_CACHE_SIZE_MAX) {
+                (void) efivar_set_raw(&loader_guid, L"LoaderLinuxCache", NULL, 0, TRUE);
+                return;
+        }
+
+        (void) efivar_set_raw(&loader_guid, L"LoaderLinuxCache", new->buffer, new->size, TRUE);
+}
+
+static EFI_STATUS config_entry_read_linux(
+                EFI_FILE_HANDLE linux_dir,
+                CHAR16 *file_name,
+                UINTN *ret_options_offset,
+                UINTN *ret_options_size,
+                CHAR16 **ret_id,
+                CHAR16 **ret_title) {
+
+        CHAR8 *sections[] = {
+                (UINT8 *)".osrel",
+                (UINT8 *)".cmdline",
+                NULL
+        };
+        UINTN offs[ELEMENTSOF(sections)-1] = {};
+        UINTN szs[ELEMENTSOF(sections)-1] = {};
+        UINTN addrs[ELEMENTSOF(sections)-1] = {};
+        _cleanup_freepool_ CHAR8 *content = NULL;
+        CHAR8 *line;
+        UINTN pos = 0;
+        CHAR8 *key, *value;
+        _cleanup_freepool_ CHAR16 *os_name = NULL, *os_id = NULL, *os_version = NULL, *os_build = NULL;
+        EFI_STATUS err;
+
+        /* look for .osrel and .cmdline sections in the .efi binary */
+        err = pe_file_locate_sections(linux_dir, file_name, sections, addrs, offs, szs);
+        if (EFI_ERROR(err))
+                return err;
+
+        err = file_read(linux_dir, file_name, offs[0], szs[0], &content, NULL);
+        if (EFI_ERROR(err))
+                return err;
+
+        /* read properties from the embedded os-release file */
+        while ((line = line_get_key_value(content, (CHAR8 *)"=", &pos, &key, &value))) {
+                if (strcmpa((CHAR8 *)"PRETTY_NAME", key) == 0) {
+                        FreePool(os_name);
+                        os_name = stra_to_str(value);
+                        continue;
+                }
+
+                if (strcmpa((CHAR8 *)"ID", key) == 0) {
+                        FreePool(os_id);
+                        os_id = stra_to_str(value);
+                        continue;
+                }
+
+                if (strcmpa((CHAR8 *)"VERSION_ID", key) == 0) {
+                        FreePool(os_version);
+                        os_version = stra_to_str(value);
+                        continue;
+                }
+
+                if (strcmpa((CHAR8 *)"BUILD_ID", key) == 0) {
+                        FreePool(os_build);
+                        os_build = stra_to_str(value);
+                        continue;
+                }
+        }
+
+        /* The embedded cmdline is only read once it is needed */
+        *ret_options_offset = offs[1];
+        *ret_options_size = szs[1];
+
+        if (os_name && os_id && (os_version || os_build)) {
+                *ret_id = PoolPrint(L"%s-%s", os_id, os_version ? : os_build);
+                *ret_title = os_name;
+                os_name = NULL;
+        } else {
+                *ret_id = NULL;
+                *ret_title = NULL;
+        }
+
+        return EFI_SUCCESS;
+}
+
 static VOID config_entry_add_linux(
                 Config *config,
                 EFI_LOADED_IMAGE *loaded_image,
@@ -1842,32 +2099,25 @@ static VOID config_entry_add_linux(
         EFI_FILE_HANDLE linux_dir;
         EFI_STATUS err;
         ConfigEntry *entry;
+        LinuxCache old_cache, new_cache = {};
 
         err = uefi_call_wrapper(root_dir->Open, 5, root_dir, &linux_dir, L"\\EFI\\Linux", EFI_FILE_MODE_READ, 0ULL);
         if (EFI_ERROR(err))
                 return;
 
+        /* Parsing the PE headers and reading the .osrel section of every image takes a while on slow media, and
+         * is usually redundant, since the images rarely change. Remember what we found, keyed by file name, size
+         * and modification time. */
+        linux_cache_load(&old_cache);
+
         for (;;) {
                 CHAR16 buf[256];
                 UINTN bufsize = sizeof buf;
                 EFI_FILE_INFO *f;
-                CHAR8 *sections[] = {
-                        (UINT8 *)".osrel",
-                        (UINT8 *)".cmdline",
-                        NULL
-                };
-                UINTN offs[ELEMENTSOF(sections)-1] = {};
-                UINTN szs[ELEMENTSOF(sections)-1] = {};
-                UINTN addrs[ELEMENTSOF(sections)-1] = {};
-                CHAR8 *content = NULL;
+                LinuxCacheRecord record;
+                UINTN options_offset, options_size;
+                _cleanup_freepool_ CHAR16 *id = NULL, *title = NULL;
                 UINTN len;
-                CHAR8 *line;
-                UINTN pos = 0;
-                CHAR8 *key, *value;
-                CHAR16 *os_name = NULL;
-                CHAR16 *os_id = NULL;
-                CHAR16 *os_version = NULL;
-                CHAR16 *os_build = NULL;
 
                 err = uefi_call_wrapper(linux_dir->Read, 3, linux_dir, &bufsize, buf);
                 if (bufsize == 0 || EFI_ERROR(err))
@@ -1884,75 +2134,36 @@ static VOID config_entry_add_linux(
                 if (StriCmp(f->FileName + len - 4, L".efi") != 0)
                         continue;
 
-                /* look for .osrel and .cmdline sections in the .efi binary */
-                err = pe_file_locate_sections(linux_dir, f->FileName, sections, addrs, offs, szs);
-                if (EFI_ERROR(err))
-                        continue;
-
-                err = file_read(linux_dir, f->FileName, offs[0], szs[0], &content, NULL);
-                if (EFI_ERROR(err))
-                        continue;
-
-                /* read properties from the embedded os-release file */
-                while ((line = line_get_key_value(content, (CHAR8 *)"=", &pos, &key, &value))) {
-                        if (strcmpa((CHAR8 *)"PRETTY_NAME", key) == 0) {
-                                FreePool(os_name);
-                                os_name = stra_to_str(value);
-                                continue;
-                        }
-
-                        if (strcmpa((CHAR8 *)"ID", key) == 0) {
-                                FreePool(os_id);
-                                os_id = stra_to_str(value);
-                                continue;
-                        }
-
-                        if (strcmpa((CHAR8 *)"VERSION_ID", key) == 0) {
-                                FreePool(os_version);
-                                os_version = stra_to_str(value);
-                                continue;
-                        }
-
-                        if (strcmpa((CHAR8 *)"BUILD_ID", key) == 0) {
-                                FreePool(os_build);
-                                os_build = stra_to_str(value);
+                if (linux_cache_find(&old_cache, f, &record, &id, &title)) {
+                        options_offset = record.options_offset;
+                        options_size = record.options_size;
+                } else {
+                        err = config_entry_read_linux(linux_dir, f->FileName, &options_offset, &options_size, &id, &title);
+                        if (EFI_ERROR(err))
                                 continue;
-                        }
                 }
 
-                if (os_name && os_id && (os_version || os_build)) {
-                        _cleanup_freepool_ CHAR16 *conf = NULL, *path = NULL;
-
-                        conf = PoolPrint(L"%s-%s", os_id, os_version ? : os_build);
-                        path = PoolPrint(L"\\EFI\\Linux\\%s", f->FileName);
+                linux_cache_append(&new_cache, f, options_offset, options_size, id, title);
 
-                        entry = config_entry_add_loader(config, loaded_image->DeviceHandle, LOADER_LINUX, conf, 'l', os_name, path);
+                if (id) {
+                        _cleanup_freepool_ CHAR16 *path = NULL;
 
-                        FreePool(content);
-                        content = NULL;
-
-                        /* read the embedded cmdline file */
-                        err = file_read(linux_dir, f->FileName, offs[1], szs[1], &content, NULL);
-                        if (!EFI_ERROR(err)) {
-
-                                /* chomp the newline */
-                                if (content[szs[1]-1] == '\n')
-                                        content[szs[1]-1] = '\0';
+                        path = PoolPrint(L"\\EFI\\Linux\\%s", f->FileName);
 
-                                entry->options = stra_to_str(content);
-                        }
+                        entry = config_entry_add_loader(config, loaded_image->DeviceHandle, LOADER_LINUX, id, 'l', title, path);
+                        entry->options_offset = options_offset;
+                        entry->options_size = options_size;
 
                         config_entry_parse_tries(entry, L"\\EFI\\Linux", f->FileName, L".efi");
                 }
-
-                FreePool(os_name);
-                FreePool(os_id);
-                FreePool(os_version);
-                FreePool(os_build);
-                FreePool(content);
         }
 
         uefi_call_wrapper(linux_dir->Close, 1, linux_dir);
+
+        linux_cache_store(&old_cache, &new_cache);
+
+        FreePool(old_cache.buffer);
+        FreePool(new_cache.buffer);
 }
 
 static EFI_STATUS image_start(
@@ -2223,6 +2434,7 @@ EFI_STATUS efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *sys_table) {
                         continue;
                 }
 
+                config_entry_load_options(entry);
                 config_entry_bump_counters(entry, root_dir);
 
                 /* export the selected boot entry to the system */
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <getopt.h>
+#include <poll.h>
 #include <stdio_ext.h>
 
 #include "sd-bus.h"
@@ -10,12 +11,14 @@
 #include "bus-internal.h"
 #include "bus-message.h"
 #include "bus-signature.h"
+#include "bus-socket.h"
 #include "bus-type.h"
 #include "bus-util.h"
 #include "busctl-introspect.h"
 #include "escape.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "io-util.h"
 #include "json.h"
 #include "locale-util.h"
 #include "log.h"
@@ -25,8 +28,10 @@
 #include "path-util.h"
 #include "pretty-print.h"
 #include "set.h"
+#include "socket-util.h"
 #include "strv.h"
 #include "terminal-util.h"
+#include "unaligned.h"
 #include "user-util.h"
 #include "util.h"
 #include "verbs.h"
@@ -47,7 +52,11 @@ static char **arg_matches = NULL;
 static BusTransport arg_transport = BUS_TRANSPORT_LOCAL;
 static const char *arg_host = NULL;
 static bool arg_user = false;
+/* How much to read from the bus at once when capturing */
+#define CAPTURE_READ_MAX (1U*1024U*1024U)
+
 static size_t arg_snaplen = 4096;
+static size_t arg_buffer_size = 8U*1024U*1024U;
 static bool arg_list = false;
 static bool arg_quiet = false;
 static bool arg_verbose = false;
@@ -1169,7 +1178,135 @@ static int message_json(sd_bus_message *m, FILE *f) {
         return 0;
 }
 
-static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f)) {
+static int frame_size(const uint8_t *p, size_t *ret) {
+        uint32_t body, fields;
+        uint64_t sum;
+
+        /* Calculates the size of a dbus1 message from its fixed header */
+
+        body = unaligned_read_ne32(p + 4);
+        fields = unaligned_read_ne32(p + 12);
+
+        if (p[0] == BUS_LITTLE_ENDIAN) {
+                body = le32toh(body);
+                fields = le32toh(fields);
+        } else if (p[0] == BUS_BIG_ENDIAN) {
+                body = be32toh(body);
+                fields = be32toh(fields);
+        } else
+                return -EBADMSG;
+
+        if (p[3] != 1)
+                return -EPROTONOSUPPORT;
+
+        sum = (uint64_t) sizeof(struct bus_header) + (uint64_t) ALIGN_TO(fields, 8) + (uint64_t) body;
+        if (sum >= BUS_MESSAGE_SIZE_MAX)
+                return -EBADMSG;
+
+        *ret = (size_t) sum;
+        return 0;
+}
+
+static int capture_raw(sd_bus *bus, void *buffer, size_t size, FILE *f) {
+        _cleanup_free_ uint8_t *buf = buffer;
+        size_t allocated = size, need = 0;
+        usec_t timestamp;
+        int fd, r;
+
+        /* Once we are a monitor, everything the bus sends us is a message to capture. Hence, instead of letting
+         * sd-bus parse each message, we read the socket in large chunks and write the messages out as they
+         * are, only looking at their fixed headers to find where one ends and the next begins. */
+
+        fd = sd_bus_get_fd(bus);
+        if (fd < 0)
+                return log_error_errno(fd, "Failed to get bus fd: %m");
+
+        r = fd_inc_rcvbuf(fd, arg_buffer_size);
+        if (r < 0)
+                log_debug_errno(r, "Failed to increase receive buffer size, ignoring: %m");
+
+        timestamp = now(CLOCK_REALTIME);
+
+        for (;;) {
+                union {
+                        struct cmsghdr cmsghdr;
+                        uint8_t buf[CMSG_SPACE(sizeof(int) * BUS_FDS_MAX)];
+                } control;
+                struct iovec iov;
+                struct msghdr mh = {
+                        .msg_iov = &iov,
+                        .msg_iovlen = 1,
+                        .msg_control = &control,
+                        .msg_controllen = sizeof(control),
+                };
+                size_t begin = 0;
+                ssize_t k;
+
+                for (;;) {
+                        if (size - begin < sizeof(struct bus_header)) {
+                                need = sizeof(struct bus_header);
+                                break;
+                        }
+
+                        r = frame_size(buf + begin, &need);
+                        if (r == -EPROTONOSUPPORT)
+                                return log_error_errno(r, "Unsupported message encoding, can't capture: %m");
+                        if (r < 0)
+                                return log_error_errno(r, "Received invalid message, can't capture: %m");
+
+                        if (size - begin < need)
+                                break;
+
+                        bus_pcap_frame_raw(buf + begin, need, arg_snaplen, timestamp, f);
+                        begin += need;
+                }
+
+                if (begin > 0) {
+                        memmove(buf, buf + begin, size - begin);
+                        size -= begin;
+                }
+
+                if (!GREEDY_REALLOC(buf, allocated, MAX(need, CAPTURE_READ_MAX)))
+                        return log_oom();
+
+                iov = IOVEC_MAKE(buf + size, allocated - size);
+
+                k = recvmsg(fd, &mh, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        if (errno != EAGAIN)
+                                return log_error_errno(errno, "Failed to read from bus: %m");
+
+                        /* Nothing more queued, a good time to write out what we have */
+                        r = fflush_and_check(f);
+                        if (r < 0)
+                                return log_error_errno(r, "Couldn't write capture file: %m");
+
+                        r = fd_wait_for_event(fd, POLLIN, USEC_INFINITY);
+                        if (r < 0 && r != -EINTR)
+                                return log_error_errno(r, "Failed to wait for bus: %m");
+
+                        continue;
+                }
+
+                /* We don't capture fds, but make sure they don't pile up */
+                cmsg_close_all(&mh);
+
+                if (k == 0) {
+                        if (size > 0)
+                                log_warning("Connection terminated in the middle of a message.");
+
+                        log_info("Connection terminated, exiting.");
+                        return 0;
+                }
+
+                size += k;
+                timestamp = now(CLOCK_REALTIME);
+        }
+}
+
+static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f), bool raw) {
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *message = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
@@ -1245,6 +1382,20 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
         for (;;) {
                 _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
 
+                if (is_monitor && raw) {
+                        void *buffer;
+                        size_t size;
+
+                        /* This fails as long as sd-bus has any messages queued, which we need to process first */
+                        r = bus_socket_take_rbuffer(bus, &buffer, &size);
+                        if (r != -EBUSY) {
+                                if (r < 0)
+                                        return log_error_errno(r, "Failed to take over bus connection: %m");
+
+                                return capture_raw(bus, buffer, size, stdout);
+                        }
+                }
+
                 r = sd_bus_process(bus, &m);
                 if (r < 0)
                         return log_error_errno(r, "Failed to process bus: %m");
@@ -1288,7 +1439,7 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
 }
 
 static int verb_monitor(int argc, char **argv, void *userdata) {
-        return monitor(argc, argv, arg_json != JSON_OFF ? message_json : message_dump);
+        return monitor(argc, argv, arg_json != JSON_OFF ? message_json : message_dump, false);
 }
 
 static int verb_capture(int argc, char **argv, void *userdata) {
@@ -1298,9 +1449,13 @@ static int verb_capture(int argc, char **argv, void *userdata) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Refusing to write message data to console, please redirect output to a file.");
 
+        /* Messages are written out in one go whenever we caught up with the bus, give that some room */
+        if (setvbuf(stdout, NULL, _IOFBF, arg_buffer_size) != 0)
+                return log_oom();
+
         bus_pcap_header(arg_snaplen, stdout);
 
-        r = monitor(argc, argv, message_pcap);
+        r = monitor(argc, argv, message_pcap, true);
         if (r < 0)
                 return r;
 
@@ -2169,6 +2324,7 @@ static int help(void) {
                "     --activatable        Only show activatable names\n"
                "     --match=MATCH        Only show matching messages\n"
                "     --size=SIZE          Maximum length of captured packet\n"
+               "     --buffer-size=SIZE   Size of the socket and output buffers for capture\n"
                "     --list               Don't show tree, but simple object path list\n"
                "  -q --quiet              Don't show method call reply\n"
                "     --verbose            Show result values in long format\n"
@@ -2223,6 +2379,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_ACQUIRED,
                 ARG_ACTIVATABLE,
                 ARG_SIZE,
+                ARG_BUFFER_SIZE,
                 ARG_LIST,
                 ARG_VERBOSE,
                 ARG_EXPECT_REPLY,
@@ -2250,6 +2407,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "host",                            required_argument, NULL, 'H'                                 },
                 { "machine",                         required_argument, NULL, 'M'                                 },
                 { "size",                            required_argument, NULL, ARG_SIZE                            },
+                { "buffer-size",                     required_argument, NULL, ARG_BUFFER_SIZE                     },
                 { "list",                            no_argument,       NULL, ARG_LIST                            },
                 { "quiet",                           no_argument,       NULL, 'q'                                 },
                 { "verbose",                         no_argument,       NULL, ARG_VERBOSE                         },
@@ -2334,6 +2492,21 @@ static int parse_argv(int argc, char *argv[]) {
                         break;
                 }
 
+                case ARG_BUFFER_SIZE: {
+                        uint64_t sz;
+
+                        r = parse_size(optarg, 1024, &sz);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse buffer size '%s': %m", optarg);
+
+                        if (sz <= 0 || sz > INT_MAX)
+                                return log_error_errno(SYNTHETIC_ERRNO(ERANGE),
+                                                       "Buffer size out of range.");
+
+                        arg_buffer_size = (size_t) sz;
+                        break;
+                }
+
                 case ARG_LIST:
                         arg_list = true;
                         break;
@@ -16,15 +16,18 @@
 #include "bus-util.h"
 #include "cgroup-show.h"
 #include "cgroup-util.h"
+#include "dirent-util.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "hashmap.h"
+#include "json.h"
 #include "main-func.h"
 #include "parse-util.h"
 #include "path-util.h"
 #include "pretty-print.h"
 #include "process-util.h"
 #include "procfs-util.h"
+#include "rlimit-util.h"
 #include "stdio-util.h"
 #include "strv.h"
 #include "terminal-util.h"
@@ -55,9 +58,58 @@ typedef struct Group {
         uint64_t io_input_bps, io_output_bps;
 } Group;
 
+typedef enum GroupAttribute {
+        GROUP_ATTRIBUTE_CGROUP_PROCS,
+        GROUP_ATTRIBUTE_PIDS_CURRENT,
+        GROUP_ATTRIBUTE_CPU_STAT,
+        GROUP_ATTRIBUTE_CPUACCT_USAGE,
+        GROUP_ATTRIBUTE_MEMORY_CURRENT,
+        GROUP_ATTRIBUTE_MEMORY_USAGE_IN_BYTES,
+        GROUP_ATTRIBUTE_IO_STAT,
+        GROUP_ATTRIBUTE_BLKIO_IO_SERVICE_BYTES,
+        _GROUP_ATTRIBUTE_MAX,
+} GroupAttribute;
+
+static const char* const group_attribute_table[_GROUP_ATTRIBUTE_MAX] = {
+        [GROUP_ATTRIBUTE_CGROUP_PROCS]           = "cgroup.procs",
+        [GROUP_ATTRIBUTE_PIDS_CURRENT]           = "pids.current",
+        [GROUP_ATTRIBUTE_CPU_STAT]               = "cpu.stat",
+        [GROUP_ATTRIBUTE_CPUACCT_USAGE]          = "cpuacct.usage",
+        [GROUP_ATTRIBUTE_MEMORY_CURRENT]         = "memory.current",
+        [GROUP_ATTRIBUTE_MEMORY_USAGE_IN_BYTES]  = "memory.usage_in_bytes",
+        [GROUP_ATTRIBUTE_IO_STAT]                = "io.stat",
+        [GROUP_ATTRIBUTE_BLKIO_IO_SERVICE_BYTES] = "blkio.io_service_bytes",
+};
+
+/* A cgroup directory we keep open between refreshes, together with the attribute files we read from it, so that each
+ * refresh only costs us a pread() per attribute. On the unified hierarchy all controllers share the same directory. */
+typedef struct Directory {
+        char *path;
+        int fd;
+        int attribute_fd[_GROUP_ATTRIBUTE_MAX];
+
+        unsigned iteration;
+
+        /* The list of subgroups, and the link count and modification time of the directory it was read at */
+        char **children;
+        nlink_t children_nlink;
+        nsec_t children_mtime;
+        bool children_valid;
+} Directory;
+
+typedef struct Sampler {
+        Hashmap *directories;
+        unsigned iteration;
+
+        /* Reused for reading all attributes */
+        char *buffer;
+        size_t allocated;
+} Sampler;
+
 static unsigned arg_depth = 3;
 static unsigned arg_iterations = (unsigned) -1;
 static bool arg_batch = false;
+static bool arg_json = false;
 static bool arg_raw = false;
 static usec_t arg_delay = 1*USEC_PER_SEC;
 static char* arg_machine = NULL;
@@ -92,6 +144,194 @@ static Group *group_free(Group *g) {
         return mfree(g);
 }
 
+static Directory *directory_free(Directory *d) {
+        if (!d)
+                return NULL;
+
+        safe_close(d->fd);
+        close_many(d->attribute_fd, _GROUP_ATTRIBUTE_MAX);
+        strv_free(d->children);
+        free(d->path);
+        return mfree(d);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(directory_hash_ops, char, path_hash_func, path_compare_func, Directory, directory_free);
+
+static void sampler_done(Sampler *s) {
+        assert(s);
+
+        s->directories = hashmap_free(s->directories);
+        s->buffer = mfree(s->buffer);
+        s->allocated = 0;
+}
+
+static int sampler_get_directory(Sampler *s, const char *controller, const char *path, Directory **ret) {
+        _cleanup_free_ char *fs = NULL;
+        Directory *d;
+        size_t i;
+        int r;
+
+        assert(s);
+        assert(controller);
+        assert(path);
+        assert(ret);
+
+        r = cg_get_path(controller, path, NULL, &fs);
+        if (r < 0)
+                return r;
+
+        d = hashmap_get(s->directories, fs);
+        if (d) {
+                d->iteration = s->iteration;
+                *ret = d;
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&s->directories, &directory_hash_ops);
+        if (r < 0)
+                return r;
+
+        d = new(Directory, 1);
+        if (!d)
+                return -ENOMEM;
+
+        *d = (Directory) {
+                .fd = -1,
+                .iteration = s->iteration,
+        };
+        for (i = 0; i < _GROUP_ATTRIBUTE_MAX; i++)
+                d->attribute_fd[i] = -1;
+
+        d->fd = open(fs, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (d->fd < 0) {
+                r = -errno;
+                directory_free(d);
+                return r;
+        }
+
+        d->path = TAKE_PTR(fs);
+
+        r = hashmap_put(s->directories, d->path, d);
+        if (r < 0) {
+                directory_free(d);
+                return r;
+        }
+
+        *ret = d;
+        return 0;
+}
+
+static void sampler_prune(Sampler *s) {
+        Directory *d;
+        Iterator i;
+
+        assert(s);
+
+        /* Close everything we didn't come across during the last refresh */
+
+        HASHMAP_FOREACH(d, s->directories, i)
+                if (d->iteration != s->iteration)
+                        directory_free(hashmap_remove(s->directories, d->path));
+}
+
+static int sampler_read_attribute(Sampler *s, Directory *d, GroupAttribute a, char **ret) {
+        size_t n = 0;
+
+        assert(s);
+        assert(d);
+        assert(a >= 0 && a < _GROUP_ATTRIBUTE_MAX);
+        assert(ret);
+
+        /* Reads the whole attribute into the shared buffer, which is valid until the next call. Expect -ENOENT if
+         * the attribute doesn't exist and -ENODEV if the cgroup went away in the meantime. */
+
+        if (d->attribute_fd[a] < 0) {
+                d->attribute_fd[a] = openat(d->fd, group_attribute_table[a], O_RDONLY|O_CLOEXEC|O_NOCTTY);
+                if (d->attribute_fd[a] < 0)
+                        return -errno;
+        }
+
+        for (;;) {
+                ssize_t k;
+
+                if (!GREEDY_REALLOC(s->buffer, s->allocated, n + page_size() + 1))
+                        return -ENOMEM;
+
+                k = pread(d->attribute_fd[a], s->buffer + n, s->allocated - n - 1, n);
+                if (k < 0)
+                        return -errno;
+                if (k == 0)
+                        break;
+
+                n += k;
+        }
+
+        s->buffer[n] = 0;
+        *ret = s->buffer;
+
+        return 0;
+}
+
+static int sampler_read_attribute_u64(Sampler *s, Directory *d, GroupAttribute a, uint64_t *ret) {
+        char *v;
+        int r;
+
+        r = sampler_read_attribute(s, d, a, &v);
+        if (r < 0)
+                return r;
+
+        return safe_atou64(strstrip(v), ret);
+}
+
+static int sampler_get_children(Directory *d, char ***ret) {
+        _cleanup_closedir_ DIR *dir = NULL;
+        _cleanup_strv_free_ char **l = NULL;
+        struct dirent *de;
+        struct stat st;
+        int r;
+
+        assert(d);
+        assert(ret);
+
+        /* The kernel bumps the link count and modification time of a cgroup directory whenever a subgroup is
+         * created or removed below it, hence only enumerate the directory again if one of them changed. */
+
+        if (fstat(d->fd, &st) < 0)
+                return -errno;
+
+        if (d->children_valid &&
+            d->children_nlink == st.st_nlink &&
+            d->children_mtime == timespec_load_nsec(&st.st_mtim)) {
+                *ret = d->children;
+                return 0;
+        }
+
+        dir = xopendirat(d->fd, ".", 0);
+        if (!dir)
+                return -errno;
+
+        FOREACH_DIRENT_ALL(de, dir, return -errno) {
+                if (dot_or_dot_dot(de->d_name))
+                        continue;
+
+                dirent_ensure_type(dir, de);
+                if (de->d_type != DT_DIR)
+                        continue;
+
+                r = strv_extend(&l, de->d_name);
+                if (r < 0)
+                        return r;
+        }
+
+        strv_free_and_replace(d->children, l);
+        d->children_nlink = st.st_nlink;
+        d->children_mtime = timespec_load_nsec(&st.st_mtim);
+        d->children_valid = true;
+
+        *ret = d->children;
+        return 0;
+}
+
 static const char *maybe_format_bytes(char *buf, size_t l, bool is_valid, uint64_t t) {
         if (!is_valid)
                 return "-";
@@ -127,6 +367,8 @@ static bool is_root_cgroup(const char *path) {
 }
 
 static int process(
+                Sampler *s,
+                Directory *d,
                 const char *controller,
                 const char *path,
                 Hashmap *a,
@@ -137,6 +379,8 @@ static int process(
         Group *g;
         int r, all_unified;
 
+        assert(s);
+        assert(d);
         assert(controller);
         assert(path);
         assert(a);
@@ -175,17 +419,20 @@ static int process(
 
         if (streq(controller, SYSTEMD_CGROUP_CONTROLLER) &&
             IN_SET(arg_count, COUNT_ALL_PROCESSES, COUNT_USERSPACE_PROCESSES)) {
-                _cleanup_fclose_ FILE *f = NULL;
-                pid_t pid;
+                char *pids, *word;
 
-                r = cg_enumerate_processes(controller, path, &f);
-                if (r == -ENOENT)
+                r = sampler_read_attribute(s, d, GROUP_ATTRIBUTE_CGROUP_PROCS, &pids);
+                if (IN_SET(r, -ENOENT, -ENODEV))
                         return 0;
                 if (r < 0)
                         return r;
 
                 g->n_tasks = 0;
-                while (cg_read_pid(f, &pid) > 0) {
+                while ((word = strsep(&pids, NEWLINE))) {
+                        pid_t pid;
+
+                        if (parse_pid(word, &pid) < 0)
+                                continue;
 
                         if (arg_count == COUNT_USERSPACE_PROCESSES && is_kernel_thread(pid) > 0)
                                 continue;
@@ -203,28 +450,17 @@ static int process(
                         if (r < 0)
                                 return r;
                 } else {
-                        _cleanup_free_ char *p = NULL, *v = NULL;
-
-                        r = cg_get_path(controller, path, "pids.current", &p);
-                        if (r < 0)
-                                return r;
-
-                        r = read_one_line_file(p, &v);
-                        if (r == -ENOENT)
+                        r = sampler_read_attribute_u64(s, d, GROUP_ATTRIBUTE_PIDS_CURRENT, &g->n_tasks);
+                        if (IN_SET(r, -ENOENT, -ENODEV))
                                 return 0;
                         if (r < 0)
                                 return r;
-
-                        r = safe_atou64(v, &g->n_tasks);
-                        if (r < 0)
-                                return r;
                 }
 
                 if (g->n_tasks > 0)
                         g->n_tasks_valid = true;
 
         } else if (STR_IN_SET(controller, "cpu", "cpuacct") || cpu_accounting_is_cheap()) {
-                _cleanup_free_ char *p = NULL, *v = NULL;
                 uint64_t new_usage;
                 nsec_t timestamp;
 
@@ -233,17 +469,26 @@ static int process(
                         if (r < 0)
                                 return r;
                 } else if (all_unified) {
-                        _cleanup_free_ char *val = NULL;
+                        char *stat, *line;
+                        const char *val = NULL;
 
                         if (!streq(controller, "cpu"))
                                 return 0;
 
-                        r = cg_get_keyed_attribute("cpu", path, "cpu.stat", STRV_MAKE("usage_usec"), &val);
-                        if (IN_SET(r, -ENOENT, -ENXIO))
+                        r = sampler_read_attribute(s, d, GROUP_ATTRIBUTE_CPU_STAT, &stat);
+                        if (IN_SET(r, -ENOENT, -ENODEV))
                                 return 0;
                         if (r < 0)
                                 return r;
 
+                        while ((line = strsep(&stat, NEWLINE))) {
+                                val = first_word(line, "usage_usec");
+                                if (val)
+                                        break;
+                        }
+                        if (!val)
+                                return 0;
+
                         r = safe_atou64(val, &new_usage);
                         if (r < 0)
                                 return r;
@@ -253,19 +498,11 @@ static int process(
                         if (!streq(controller, "cpuacct"))
                                 return 0;
 
-                        r = cg_get_path(controller, path, "cpuacct.usage", &p);
-                        if (r < 0)
-                                return r;
-
-                        r = read_one_line_file(p, &v);
-                        if (r == -ENOENT)
+                        r = sampler_read_attribute_u64(s, d, GROUP_ATTRIBUTE_CPUACCT_USAGE, &new_usage);
+                        if (IN_SET(r, -ENOENT, -ENODEV))
                                 return 0;
                         if (r < 0)
                                 return r;
-
-                        r = safe_atou64(v, &new_usage);
-                        if (r < 0)
-                                return r;
                 }
 
                 timestamp = now_nsec(CLOCK_MONOTONIC);
@@ -295,24 +532,13 @@ static int process(
                         if (r < 0)
                                 return r;
                 } else {
-                        _cleanup_free_ char *p = NULL, *v = NULL;
-
-                        if (all_unified)
-                                r = cg_get_path(controller, path, "memory.current", &p);
-                        else
-                                r = cg_get_path(controller, path, "memory.usage_in_bytes", &p);
-                        if (r < 0)
-                                return r;
-
-                        r = read_one_line_file(p, &v);
-                        if (r == -ENOENT)
+                        r = sampler_read_attribute_u64(s, d,
+                                                       all_unified ? GROUP_ATTRIBUTE_MEMORY_CURRENT : GROUP_ATTRIBUTE_MEMORY_USAGE_IN_BYTES,
+                                                       &g->memory);
+                        if (IN_SET(r, -ENOENT, -ENODEV))
                                 return 0;
                         if (r < 0)
                                 return r;
-
-                        r = safe_atou64(v, &g->memory);
-                        if (r < 0)
-                                return r;
                 }
 
                 if (g->memory > 0)
@@ -320,33 +546,22 @@ static int process(
 
         } else if ((streq(controller, "io") && all_unified) ||
                    (streq(controller, "blkio") && !all_unified)) {
-                _cleanup_fclose_ FILE *f = NULL;
-                _cleanup_free_ char *p = NULL;
                 uint64_t wr = 0, rd = 0;
                 nsec_t timestamp;
+                char *stat, *line;
 
-                r = cg_get_path(controller, path, all_unified ? "io.stat" : "blkio.io_service_bytes", &p);
+                r = sampler_read_attribute(s, d,
+                                           all_unified ? GROUP_ATTRIBUTE_IO_STAT : GROUP_ATTRIBUTE_BLKIO_IO_SERVICE_BYTES,
+                                           &stat);
+                if (IN_SET(r, -ENOENT, -ENODEV))
+                        return 0;
                 if (r < 0)
                         return r;
 
-                f = fopen(p, "re");
-                if (!f) {
-                        if (errno == ENOENT)
-                                return 0;
-                        return -errno;
-                }
-
-                for (;;) {
-                        _cleanup_free_ char *line = NULL;
+                while ((line = strsep(&stat, NEWLINE))) {
                         uint64_t k, *q;
                         char *l;
 
-                        r = read_line(f, LONG_LINE_MAX, &line);
-                        if (r < 0)
-                                return r;
-                        if (r == 0)
-                                break;
-
                         /* Trim and skip the device */
                         l = strstrip(line);
                         l += strcspn(l, WHITESPACE);
@@ -420,6 +635,7 @@ static int process(
 }
 
 static int refresh_one(
+                Sampler *s,
                 const char *controller,
                 const char *path,
                 Hashmap *a,
@@ -428,10 +644,12 @@ static int refresh_one(
                 unsigned depth,
                 Group **ret) {
 
-        _cleanup_closedir_ DIR *d = NULL;
+        char **children, **fn;
         Group *ours = NULL;
+        Directory *d;
         int r;
 
+        assert(s);
         assert(controller);
         assert(path);
         assert(a);
@@ -439,33 +657,38 @@ static int refresh_one(
         if (depth > arg_depth)
                 return 0;
 
-        r = process(controller, path, a, b, iteration, &ours);
+        r = sampler_get_directory(s, controller, path, &d);
+        if (r == -ENOENT)
+                return 0;
         if (r < 0)
                 return r;
 
-        r = cg_enumerate_subgroups(controller, path, &d);
-        if (r == -ENOENT)
-                return 0;
+        r = process(s, d, controller, path, a, b, iteration, &ours);
         if (r < 0)
                 return r;
 
-        for (;;) {
-                _cleanup_free_ char *fn = NULL, *p = NULL;
-                Group *child = NULL;
+        if (depth >= arg_depth)
+                goto finish;
 
-                r = cg_read_subgroup(d, &fn);
-                if (r < 0)
-                        return r;
-                if (r == 0)
-                        break;
+        /* Note that the returned list is owned by the directory object, and stays valid while we recurse, as
+         * nothing is pruned before the refresh is complete. */
+        r = sampler_get_children(d, &children);
+        if (IN_SET(r, -ENOENT, -ENODEV))
+                goto finish;
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(fn, children) {
+                _cleanup_free_ char *p = NULL;
+                Group *child = NULL;
 
-                p = strjoin(path, "/", fn);
+                p = strjoin(path, "/", *fn);
                 if (!p)
                         return -ENOMEM;
 
                 path_simplify(p, false);
 
-                r = refresh_one(controller, p, a, b, iteration, depth + 1, &child);
+                r = refresh_one(s, controller, p, a, b, iteration, depth + 1, &child);
                 if (r < 0)
                         return r;
 
@@ -486,22 +709,29 @@ static int refresh_one(
                 }
         }
 
+finish:
         if (ret)
                 *ret = ours;
 
         return 1;
 }
 
-static int refresh(const char *root, Hashmap *a, Hashmap *b, unsigned iteration) {
+static int refresh(Sampler *s, const char *root, Hashmap *a, Hashmap *b, unsigned iteration) {
         const char *c;
         int r;
 
+        assert(s);
+
+        s->iteration = iteration;
+
         FOREACH_STRING(c, SYSTEMD_CGROUP_CONTROLLER, "cpu", "cpuacct", "memory", "io", "blkio", "pids") {
-                r = refresh_one(c, root, a, b, iteration, 0, NULL);
+                r = refresh_one(s, c, root, a, b, iteration, 0, NULL);
                 if (r < 0)
                         return r;
         }
 
+        sampler_prune(s);
+
         return 0;
 }
 
@@ -686,6 +916,51 @@ static void display(Hashmap *a) {
         }
 }
 
+static int display_json(Hashmap *a) {
+        Iterator i;
+        Group *g;
+        Group **array;
+        unsigned n = 0, j;
+        usec_t timestamp;
+        int r;
+
+        assert(a);
+
+        /* Writes one JSON object per control group and line, for consumption by other programs */
+
+        array = newa(Group*, hashmap_size(a));
+
+        HASHMAP_FOREACH(g, a, i)
+                if (g->n_tasks_valid || g->cpu_valid || g->memory_valid || g->io_valid)
+                        array[n++] = g;
+
+        typesafe_qsort(array, n, group_compare);
+
+        timestamp = now(CLOCK_REALTIME);
+
+        for (j = 0; j < n; j++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                g = array[j];
+
+                r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("timestamp", JSON_BUILD_UNSIGNED(timestamp)),
+                                       JSON_BUILD_PAIR("cgroup", JSON_BUILD_STRING(empty_to_root(g->path))),
+                                       JSON_BUILD_PAIR_CONDITION(g->n_tasks_valid, "tasks", JSON_BUILD_UNSIGNED(g->n_tasks)),
+                                       JSON_BUILD_PAIR_CONDITION(g->cpu_usage > 0, "cpu_usage_nsec", JSON_BUILD_UNSIGNED(g->cpu_usage)),
+                                       JSON_BUILD_PAIR_CONDITION(g->cpu_valid, "cpu_fraction", JSON_BUILD_REAL(g->cpu_fraction)),
+                                       JSON_BUILD_PAIR_CONDITION(g->memory_valid, "memory_bytes", JSON_BUILD_UNSIGNED(g->memory)),
+                                       JSON_BUILD_PAIR_CONDITION(g->io_valid, "io_input_bps", JSON_BUILD_UNSIGNED(g->io_input_bps)),
+                                       JSON_BUILD_PAIR_CONDITION(g->io_valid, "io_output_bps", JSON_BUILD_UNSIGNED(g->io_output_bps))));
+                if (r < 0)
+                        return r;
+
+                json_variant_dump(v, JSON_FORMAT_NEWLINE, stdout, NULL);
+        }
+
+        return 0;
+}
+
 static int help(void) {
         _cleanup_free_ char *link = NULL;
         int r;
@@ -713,6 +988,7 @@ static int help(void) {
                "  -n --iterations=N   Run for N iterations before exiting\n"
                "  -1                  Shortcut for --iterations=1\n"
                "  -b --batch          Run in batch mode, accepting no input\n"
+               "     --json           Stream samples as JSON, one object per line\n"
                "     --depth=DEPTH    Maximum traversal depth (default: %u)\n"
                "  -M --machine=       Show container\n"
                "\nSee the %s for details.\n"
@@ -731,6 +1007,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_CPU_TYPE,
                 ARG_ORDER,
                 ARG_RECURSIVE,
+                ARG_JSON,
         };
 
         static const struct option options[] = {
@@ -739,6 +1016,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "delay",        required_argument, NULL, 'd'           },
                 { "iterations",   required_argument, NULL, 'n'           },
                 { "batch",        no_argument,       NULL, 'b'           },
+                { "json",         no_argument,       NULL, ARG_JSON      },
                 { "raw",          no_argument,       NULL, 'r'           },
                 { "depth",        required_argument, NULL, ARG_DEPTH     },
                 { "cpu",          optional_argument, NULL, ARG_CPU_TYPE  },
@@ -815,6 +1093,11 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_raw = true;
                         break;
 
+                case ARG_JSON:
+                        arg_json = true;
+                        arg_batch = true;
+                        break;
+
                 case 'p':
                         arg_order = ORDER_PATH;
                         break;
@@ -902,6 +1185,7 @@ DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(group_hash_ops, char, path_hash_fu
 
 static int run(int argc, char *argv[]) {
         _cleanup_hashmap_free_ Hashmap *a = NULL, *b = NULL;
+        _cleanup_(sampler_done) Sampler sampler = {};
         unsigned iteration = 0;
         usec_t last_refresh = 0;
         bool quit = false, immediate_refresh = false;
@@ -937,12 +1221,16 @@ static int run(int argc, char *argv[]) {
         if (!a || !b)
                 return log_oom();
 
+        /* We keep the directories and attribute files of all cgroups we show open */
+        (void) rlimit_nofile_bump(HIGH_RLIMIT_NOFILE);
+
         signal(SIGWINCH, columns_lines_cache_reset);
 
         if (arg_iterations == (unsigned) -1)
-                arg_iterations = on_tty() ? 0 : 1;
+                arg_iterations = on_tty() || arg_json ? 0 : 1;
 
         while (!quit) {
+                bool refreshed = false;
                 usec_t t;
                 char key;
                 char h[FORMAT_TIMESPAN_MAX];
@@ -951,7 +1239,7 @@ static int run(int argc, char *argv[]) {
 
                 if (t >= last_refresh + arg_delay || immediate_refresh) {
 
-                        r = refresh(root, a, b, iteration++);
+                        r = refresh(&sampler, root, a, b, iteration++);
                         if (r < 0)
                                 return log_error_errno(r, "Failed to refresh: %m");
 
@@ -960,14 +1248,22 @@ static int run(int argc, char *argv[]) {
 
                         last_refresh = t;
                         immediate_refresh = false;
+                        refreshed = true;
                 }
 
-                display(b);
+                if (arg_json) {
+                        if (refreshed) {
+                                r = display_json(b);
+                                if (r < 0)
+                                        return log_error_errno(r, "Failed to format JSON output: %m");
+                        }
+                } else
+                        display(b);
 
                 if (arg_iterations && iteration >= arg_iterations)
                         break;
 
-                if (!on_tty()) /* non-TTY: Empty newline as delimiter between polls */
+                if (!on_tty() && !arg_json) /* non-TTY: Empty newline as delimiter between polls */
                         fputs("\n", stdout);
                 fflush(stdout);
 
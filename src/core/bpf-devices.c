@@ -3,9 +3,100 @@
 
 #include "bpf-devices.h"
 #include "bpf-program.h"
+#include "hashmap.h"
 
 #define PASS_JUMP_OFF 4096
 
+/* A device control program loaded into the kernel, shared by all units that ended up with the very same
+ * instructions, which is common for units instantiated from the same template. */
+struct BPFDevicesShared {
+        unsigned n_ref;
+        Manager *manager;
+        BPFProgram *program;
+};
+
+static void bpf_program_instructions_hash_func(const BPFProgram *p, struct siphash *state) {
+        siphash24_compress(&p->prog_type, sizeof(p->prog_type), state);
+        siphash24_compress(&p->n_instructions, sizeof(p->n_instructions), state);
+        siphash24_compress(p->instructions, p->n_instructions * sizeof(struct bpf_insn), state);
+}
+
+static int bpf_program_instructions_compare_func(const BPFProgram *a, const BPFProgram *b) {
+        int r;
+
+        r = CMP(a->prog_type, b->prog_type);
+        if (r != 0)
+                return r;
+
+        r = CMP(a->n_instructions, b->n_instructions);
+        if (r != 0)
+                return r;
+
+        return memcmp(a->instructions, b->instructions, a->n_instructions * sizeof(struct bpf_insn));
+}
+
+DEFINE_PRIVATE_HASH_OPS(bpf_program_instructions_hash_ops, BPFProgram, bpf_program_instructions_hash_func, bpf_program_instructions_compare_func);
+
+static BPFDevicesShared *bpf_devices_shared_free(BPFDevicesShared *s) {
+        if (!s)
+                return NULL;
+
+        if (s->manager)
+                (void) hashmap_remove(s->manager->bpf_devices_shared, s->program);
+
+        bpf_program_unref(s->program);
+
+        return mfree(s);
+}
+
+DEFINE_TRIVIAL_UNREF_FUNC(BPFDevicesShared, bpf_devices_shared, bpf_devices_shared_free);
+
+static int bpf_devices_shared_get(Manager *m, BPFProgram *prog, BPFDevicesShared **ret) {
+        BPFDevicesShared *s;
+        int r;
+
+        assert(m);
+        assert(prog);
+        assert(ret);
+
+        /* Returns a reference to the loaded program with the same instructions as the specified one, uploading it to
+         * the kernel if there is none yet. */
+
+        s = hashmap_get(m->bpf_devices_shared, prog);
+        if (s) {
+                s->n_ref++;
+                *ret = s;
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&m->bpf_devices_shared, &bpf_program_instructions_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = bpf_program_load_kernel(prog, NULL, 0);
+        if (r < 0)
+                return r;
+
+        s = new(BPFDevicesShared, 1);
+        if (!s)
+                return -ENOMEM;
+
+        *s = (BPFDevicesShared) {
+                .n_ref = 1,
+                .program = bpf_program_ref(prog),
+        };
+
+        r = hashmap_put(m->bpf_devices_shared, s->program, s);
+        if (r < 0) {
+                bpf_devices_shared_free(s);
+                return r;
+        }
+
+        s->manager = m;
+        *ret = s;
+        return 0;
+}
+
 static int bpf_access_type(const char *acc) {
         int r = 0;
 
@@ -167,12 +258,15 @@ int cgroup_apply_device_bpf(Unit *u, BPFProgram *prog, CGroupDevicePolicy policy
                 BPF_EXIT_INSN()
         };
 
+        _cleanup_(bpf_program_unrefp) BPFProgram *clone = NULL;
         _cleanup_free_ char *path = NULL;
+        BPFDevicesShared *shared;
         int r;
 
         if (!prog) {
                 /* Remove existing program. */
                 u->bpf_device_control_installed = bpf_program_unref(u->bpf_device_control_installed);
+                u->bpf_device_control_shared = bpf_devices_shared_unref(u->bpf_device_control_shared);
                 return 0;
         }
 
@@ -198,19 +292,42 @@ int cgroup_apply_device_bpf(Unit *u, BPFProgram *prog, CGroupDevicePolicy policy
         if (r < 0)
                 return log_error_errno(r, "Extending device control BPF program failed: %m");
 
-        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, NULL, &path);
+        r = bpf_devices_shared_get(u->manager, prog, &shared);
         if (r < 0)
+                return log_error_errno(r, "Loading device control BPF program failed: %m");
+
+        if (u->bpf_device_control_installed && u->bpf_device_control_shared == shared) {
+                /* The very same program is attached already, nothing to do. */
+                bpf_devices_shared_unref(shared);
+                return 0;
+        }
+
+        /* Every cgroup needs its own program object, since we track the attachment in it. */
+        r = bpf_program_clone(shared->program, &clone);
+        if (r < 0) {
+                bpf_devices_shared_unref(shared);
+                return log_error_errno(r, "Failed to duplicate device control BPF program: %m");
+        }
+
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, NULL, &path);
+        if (r < 0) {
+                bpf_devices_shared_unref(shared);
                 return log_error_errno(r, "Failed to determine cgroup path: %m");
+        }
 
-        r = bpf_program_cgroup_attach(prog, BPF_CGROUP_DEVICE, path, BPF_F_ALLOW_MULTI);
-        if (r < 0)
+        r = bpf_program_cgroup_attach(clone, BPF_CGROUP_DEVICE, path, BPF_F_ALLOW_MULTI);
+        if (r < 0) {
+                bpf_devices_shared_unref(shared);
                 return log_error_errno(r, "Attaching device control BPF program to cgroup %s failed: %m", path);
+        }
 
         /* Unref the old BPF program (which will implicitly detach it) right before attaching the new program. */
         u->bpf_device_control_installed = bpf_program_unref(u->bpf_device_control_installed);
+        bpf_devices_shared_unref(u->bpf_device_control_shared);
 
         /* Remember that this BPF program is installed now. */
-        u->bpf_device_control_installed = bpf_program_ref(prog);
+        u->bpf_device_control_installed = TAKE_PTR(clone);
+        u->bpf_device_control_shared = shared;
 
         return 0;
 }
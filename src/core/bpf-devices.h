@@ -15,3 +15,7 @@ int cgroup_bpf_whitelist_class(BPFProgram *prog, int type, const char *acc);
 
 int cgroup_init_device_bpf(BPFProgram **ret, CGroupDevicePolicy policy, bool whitelist);
 int cgroup_apply_device_bpf(Unit *u, BPFProgram *p, CGroupDevicePolicy policy, bool whitelist);
+
+typedef struct BPFDevicesShared BPFDevicesShared;
+
+BPFDevicesShared *bpf_devices_shared_unref(BPFDevicesShared *s);
@@ -19,13 +19,25 @@
 #include "bpf-firewall.h"
 #include "bpf-program.h"
 #include "fd-util.h"
+#include "hashmap.h"
+#include "in-addr-util.h"
 #include "ip-address-access.h"
 #include "missing_syscall.h"
+#include "stdio-util.h"
+#include "string-util.h"
 #include "unit.h"
 
-enum {
-        MAP_KEY_PACKETS,
-        MAP_KEY_BYTES,
+/* The accounting map has a single entry, holding all counters of both directions, so that they may be read with a
+ * single lookup. The counters are indexed by CGroupIPAccountingMetric. */
+#define ACCOUNTING_MAP_KEY 0U
+#define ACCOUNTING_MAP_VALUE_SIZE (sizeof(uint64_t) * _CGROUP_IP_ACCOUNTING_METRIC_MAX)
+
+struct BPFFirewallShared {
+        unsigned n_ref;
+        Manager *manager;
+        char *key;
+
+        BPFProgram *ingress, *egress;
 };
 
 enum {
@@ -171,15 +183,15 @@ static int bpf_firewall_compile_bpf(
         };
 
         _cleanup_(bpf_program_unrefp) BPFProgram *p = NULL;
-        int accounting_map_fd, r;
+        int accounting_map_fd, bytes_offset, packets_offset, r;
         bool access_enabled;
 
         assert(u);
         assert(ret);
 
-        accounting_map_fd = is_ingress ?
-                u->ip_accounting_ingress_map_fd :
-                u->ip_accounting_egress_map_fd;
+        accounting_map_fd = u->ip_accounting_map_fd;
+        bytes_offset = sizeof(uint64_t) * (is_ingress ? CGROUP_IP_INGRESS_BYTES : CGROUP_IP_EGRESS_BYTES);
+        packets_offset = sizeof(uint64_t) * (is_ingress ? CGROUP_IP_INGRESS_PACKETS : CGROUP_IP_EGRESS_PACKETS);
 
         access_enabled =
                 u->ipv4_allow_map_fd >= 0 ||
@@ -246,27 +258,22 @@ static int bpf_firewall_compile_bpf(
                          */
                         BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 0),
 
-                        /* Count packets */
-                        BPF_MOV64_IMM(BPF_REG_0, MAP_KEY_PACKETS), /* r0 = 0 */
+                        /* Look up the counters once */
+                        BPF_MOV64_IMM(BPF_REG_0, ACCOUNTING_MAP_KEY), /* r0 = 0 */
                         BPF_STX_MEM(BPF_W, BPF_REG_10, BPF_REG_0, -4), /* *(u32 *)(fp - 4) = r0 */
                         BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
                         BPF_ALU64_IMM(BPF_ADD, BPF_REG_2, -4), /* r2 = fp - 4 */
                         BPF_LD_MAP_FD(BPF_REG_1, accounting_map_fd), /* load map fd to r1 */
                         BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem),
-                        BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 2),
+                        BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 4),
+
+                        /* Count packets */
                         BPF_MOV64_IMM(BPF_REG_1, 1), /* r1 = 1 */
-                        BPF_RAW_INSN(BPF_STX | BPF_XADD | BPF_DW, BPF_REG_0, BPF_REG_1, 0, 0), /* xadd r0 += r1 */
+                        BPF_RAW_INSN(BPF_STX | BPF_XADD | BPF_DW, BPF_REG_0, BPF_REG_1, packets_offset, 0), /* xadd r0[packets] += r1 */
 
                         /* Count bytes */
-                        BPF_MOV64_IMM(BPF_REG_0, MAP_KEY_BYTES), /* r0 = 1 */
-                        BPF_STX_MEM(BPF_W, BPF_REG_10, BPF_REG_0, -4), /* *(u32 *)(fp - 4) = r0 */
-                        BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
-                        BPF_ALU64_IMM(BPF_ADD, BPF_REG_2, -4), /* r2 = fp - 4 */
-                        BPF_LD_MAP_FD(BPF_REG_1, accounting_map_fd),
-                        BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem),
-                        BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 2),
                         BPF_LDX_MEM(BPF_W, BPF_REG_1, BPF_REG_6, offsetof(struct __sk_buff, len)), /* r1 = skb->len */
-                        BPF_RAW_INSN(BPF_STX | BPF_XADD | BPF_DW, BPF_REG_0, BPF_REG_1, 0, 0), /* xadd r0 += r1 */
+                        BPF_RAW_INSN(BPF_STX | BPF_XADD | BPF_DW, BPF_REG_0, BPF_REG_1, bytes_offset, 0), /* xadd r0[bytes] += r1 */
 
                         /* Allow the packet to pass */
                         BPF_MOV64_IMM(BPF_REG_0, 1),
@@ -435,41 +442,210 @@ static int bpf_firewall_prepare_access_maps(
         return 0;
 }
 
-static int bpf_firewall_prepare_accounting_maps(Unit *u, bool enabled, int *fd_ingress, int *fd_egress) {
+static int bpf_firewall_prepare_accounting_map(Unit *u, bool enabled, int *fd) {
         int r;
 
         assert(u);
-        assert(fd_ingress);
-        assert(fd_egress);
+        assert(fd);
 
         if (enabled) {
-                if (*fd_ingress < 0) {
-                        r = bpf_map_new(BPF_MAP_TYPE_ARRAY, sizeof(int), sizeof(uint64_t), 2, 0);
+                if (*fd < 0) {
+                        r = bpf_map_new(BPF_MAP_TYPE_ARRAY, sizeof(int), ACCOUNTING_MAP_VALUE_SIZE, 1, 0);
                         if (r < 0)
                                 return r;
 
-                        *fd_ingress = r;
+                        *fd = r;
                 }
 
-                if (*fd_egress < 0) {
+        } else {
+                *fd = safe_close(*fd);
 
-                        r = bpf_map_new(BPF_MAP_TYPE_ARRAY, sizeof(int), sizeof(uint64_t), 2, 0);
-                        if (r < 0)
-                                return r;
+                zero(u->ip_accounting_extra);
+        }
 
-                        *fd_egress = r;
-                }
+        return 0;
+}
 
-        } else {
-                *fd_ingress = safe_close(*fd_ingress);
-                *fd_egress = safe_close(*fd_egress);
+static int bpf_firewall_append_access_key(char **key, const char *prefix, IPAddressAccessItem *list) {
+        IPAddressAccessItem *a;
+        int r;
 
-                zero(u->ip_accounting_extra);
+        assert(key);
+        assert(prefix);
+
+        LIST_FOREACH(items, a, list) {
+                _cleanup_free_ char *s = NULL;
+                char buf[DECIMAL_STR_MAX(unsigned)];
+
+                r = in_addr_to_string(a->family, &a->address, &s);
+                if (r < 0)
+                        return r;
+
+                xsprintf(buf, "%u", a->prefixlen);
+
+                if (!strextend(key, prefix, s, "/", buf, NULL))
+                        return -ENOMEM;
         }
 
         return 0;
 }
 
+static int bpf_firewall_shared_key(Unit *u, char **ret) {
+        _cleanup_free_ char *key = NULL;
+        Unit *p;
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        /* Generates a string that describes the access lists that apply to this unit, in the order we'd put them
+         * into the BPF maps. Units with the same string end up with identical programs. Returns 0 if there are no
+         * access lists to apply at all. */
+
+        for (p = u; p; p = UNIT_DEREF(p->slice)) {
+                CGroupContext *cc;
+
+                cc = unit_get_cgroup_context(p);
+                if (!cc)
+                        continue;
+
+                r = bpf_firewall_append_access_key(&key, " allow:", cc->ip_address_allow);
+                if (r < 0)
+                        return r;
+
+                r = bpf_firewall_append_access_key(&key, " deny:", cc->ip_address_deny);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!key) {
+                *ret = NULL;
+                return 0;
+        }
+
+        *ret = TAKE_PTR(key);
+        return 1;
+}
+
+static BPFFirewallShared *bpf_firewall_shared_free(BPFFirewallShared *s) {
+        if (!s)
+                return NULL;
+
+        if (s->manager)
+                (void) hashmap_remove(s->manager->bpf_firewall_shared, s->key);
+
+        bpf_program_unref(s->ingress);
+        bpf_program_unref(s->egress);
+        free(s->key);
+
+        return mfree(s);
+}
+
+DEFINE_PRIVATE_TRIVIAL_REF_FUNC(BPFFirewallShared, bpf_firewall_shared);
+DEFINE_TRIVIAL_UNREF_FUNC(BPFFirewallShared, bpf_firewall_shared, bpf_firewall_shared_free);
+DEFINE_TRIVIAL_CLEANUP_FUNC(BPFFirewallShared*, bpf_firewall_shared_unref);
+
+static int bpf_firewall_shared_new(Unit *u, char *key, BPFFirewallShared **ret) {
+        _cleanup_(bpf_firewall_shared_unrefp) BPFFirewallShared *s = NULL;
+        int r;
+
+        assert(u);
+        assert(key);
+        assert(ret);
+        assert(u->ip_accounting_map_fd < 0);
+
+        s = new0(BPFFirewallShared, 1);
+        if (!s)
+                return -ENOMEM;
+
+        s->n_ref = 1;
+        s->key = key;
+
+        r = bpf_firewall_prepare_access_maps(u, ACCESS_ALLOWED, &u->ipv4_allow_map_fd, &u->ipv6_allow_map_fd);
+        if (r < 0)
+                goto finish;
+
+        r = bpf_firewall_prepare_access_maps(u, ACCESS_DENIED, &u->ipv4_deny_map_fd, &u->ipv6_deny_map_fd);
+        if (r < 0)
+                goto finish;
+
+        r = bpf_firewall_compile_bpf(u, true, &s->ingress);
+        if (r < 0)
+                goto finish;
+
+        r = bpf_firewall_compile_bpf(u, false, &s->egress);
+        if (r < 0)
+                goto finish;
+
+        /* Upload the programs right away, so that they reference the maps in the kernel, and we don't need to keep
+         * them open ourselves anymore */
+        r = bpf_program_load_kernel(s->ingress, NULL, 0);
+        if (r < 0)
+                goto finish;
+
+        r = bpf_program_load_kernel(s->egress, NULL, 0);
+        if (r < 0)
+                goto finish;
+
+        r = hashmap_ensure_allocated(&u->manager->bpf_firewall_shared, &string_hash_ops);
+        if (r < 0)
+                goto finish;
+
+        r = hashmap_put(u->manager->bpf_firewall_shared, s->key, s);
+        if (r < 0)
+                goto finish;
+
+        s->manager = u->manager;
+        *ret = TAKE_PTR(s);
+        r = 0;
+
+finish:
+        if (r < 0 && s)
+                s->key = NULL; /* On failure, the caller still owns the key */
+
+        u->ipv4_allow_map_fd = safe_close(u->ipv4_allow_map_fd);
+        u->ipv4_deny_map_fd = safe_close(u->ipv4_deny_map_fd);
+        u->ipv6_allow_map_fd = safe_close(u->ipv6_allow_map_fd);
+        u->ipv6_deny_map_fd = safe_close(u->ipv6_deny_map_fd);
+
+        return r;
+}
+
+static int bpf_firewall_compile_shared(Unit *u) {
+        _cleanup_free_ char *key = NULL;
+        BPFFirewallShared *s;
+        int r;
+
+        assert(u);
+
+        /* If a unit needs access control but no accounting, its programs only depend on the access lists, hence
+         * units with identical lists can share the same programs (and maps) in the kernel. Returns 0 if there's
+         * nothing to compile. */
+
+        r = bpf_firewall_shared_key(u, &key);
+        if (r <= 0)
+                return r;
+
+        s = hashmap_get(u->manager->bpf_firewall_shared, key);
+        if (s)
+                s = bpf_firewall_shared_ref(s);
+        else {
+                r = bpf_firewall_shared_new(u, key, &s);
+                if (r < 0)
+                        return r;
+
+                key = NULL; /* now owned by the shared object */
+        }
+
+        u->ip_bpf_shared = s;
+
+        r = bpf_program_clone(s->ingress, &u->ip_bpf_ingress);
+        if (r < 0)
+                return r;
+
+        return bpf_program_clone(s->egress, &u->ip_bpf_egress);
+}
+
 int bpf_firewall_compile(Unit *u) {
         CGroupContext *cc;
         int r, supported;
@@ -503,6 +679,7 @@ int bpf_firewall_compile(Unit *u) {
 
         u->ip_bpf_ingress = bpf_program_unref(u->ip_bpf_ingress);
         u->ip_bpf_egress = bpf_program_unref(u->ip_bpf_egress);
+        u->ip_bpf_shared = bpf_firewall_shared_unref(u->ip_bpf_shared);
 
         u->ipv4_allow_map_fd = safe_close(u->ipv4_allow_map_fd);
         u->ipv4_deny_map_fd = safe_close(u->ipv4_deny_map_fd);
@@ -510,6 +687,18 @@ int bpf_firewall_compile(Unit *u) {
         u->ipv6_allow_map_fd = safe_close(u->ipv6_allow_map_fd);
         u->ipv6_deny_map_fd = safe_close(u->ipv6_deny_map_fd);
 
+        r = bpf_firewall_prepare_accounting_map(u, cc->ip_accounting, &u->ip_accounting_map_fd);
+        if (r < 0)
+                return log_unit_error_errno(u, r, "Preparation of eBPF accounting map failed: %m");
+
+        if (u->type != UNIT_SLICE && !cc->ip_accounting) {
+                r = bpf_firewall_compile_shared(u);
+                if (r < 0)
+                        return log_unit_error_errno(u, r, "Compilation of shared BPF programs failed: %m");
+
+                return 0;
+        }
+
         if (u->type != UNIT_SLICE) {
                 /* In inner nodes we only do accounting, we do not actually bother with access control. However, leaf
                  * nodes will incorporate all IP access rules set on all their parent nodes. This has the benefit that
@@ -526,10 +715,6 @@ int bpf_firewall_compile(Unit *u) {
                         return log_unit_error_errno(u, r, "Preparation of eBPF deny maps failed: %m");
         }
 
-        r = bpf_firewall_prepare_accounting_maps(u, cc->ip_accounting, &u->ip_accounting_ingress_map_fd, &u->ip_accounting_egress_map_fd);
-        if (r < 0)
-                return log_unit_error_errno(u, r, "Preparation of eBPF accounting maps failed: %m");
-
         r = bpf_firewall_compile_bpf(u, true, &u->ip_bpf_ingress);
         if (r < 0)
                 return log_unit_error_errno(u, r, "Compilation for ingress BPF program failed: %m");
@@ -601,47 +786,25 @@ int bpf_firewall_install(Unit *u) {
         return 0;
 }
 
-int bpf_firewall_read_accounting(int map_fd, uint64_t *ret_bytes, uint64_t *ret_packets) {
-        uint64_t key, packets;
-        int r;
+int bpf_firewall_read_accounting(int map_fd, uint64_t ret[_CGROUP_IP_ACCOUNTING_METRIC_MAX]) {
+        uint32_t key = ACCOUNTING_MAP_KEY;
+
+        assert(ret);
 
         if (map_fd < 0)
                 return -EBADF;
 
-        if (ret_packets) {
-                key = MAP_KEY_PACKETS;
-                r = bpf_map_lookup_element(map_fd, &key, &packets);
-                if (r < 0)
-                        return r;
-        }
-
-        if (ret_bytes) {
-                key = MAP_KEY_BYTES;
-                r = bpf_map_lookup_element(map_fd, &key, ret_bytes);
-                if (r < 0)
-                        return r;
-        }
-
-        if (ret_packets)
-                *ret_packets = packets;
-
-        return 0;
+        return bpf_map_lookup_element(map_fd, &key, ret);
 }
 
 int bpf_firewall_reset_accounting(int map_fd) {
-        uint64_t key, value = 0;
-        int r;
+        uint64_t value[_CGROUP_IP_ACCOUNTING_METRIC_MAX] = {};
+        uint32_t key = ACCOUNTING_MAP_KEY;
 
         if (map_fd < 0)
                 return -EBADF;
 
-        key = MAP_KEY_PACKETS;
-        r = bpf_map_update_element(map_fd, &key, &value);
-        if (r < 0)
-                return r;
-
-        key = MAP_KEY_BYTES;
-        return bpf_map_update_element(map_fd, &key, &value);
+        return bpf_map_update_element(map_fd, &key, value);
 }
 
 int bpf_firewall_supported(void) {
@@ -16,5 +16,9 @@ int bpf_firewall_supported(void);
 int bpf_firewall_compile(Unit *u);
 int bpf_firewall_install(Unit *u);
 
-int bpf_firewall_read_accounting(int map_fd, uint64_t *ret_bytes, uint64_t *ret_packets);
+int bpf_firewall_read_accounting(int map_fd, uint64_t ret[_CGROUP_IP_ACCOUNTING_METRIC_MAX]);
 int bpf_firewall_reset_accounting(int map_fd);
+
+typedef struct BPFFirewallShared BPFFirewallShared;
+
+BPFFirewallShared *bpf_firewall_shared_unref(BPFFirewallShared *s);
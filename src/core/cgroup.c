@@ -11,6 +11,7 @@
 #include "bus-error.h"
 #include "cgroup-util.h"
 #include "cgroup.h"
+#include "dbus-unit.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
@@ -27,6 +28,9 @@
 
 #define CGROUP_CPU_QUOTA_PERIOD_USEC ((usec_t) 100 * USEC_PER_MSEC)
 
+/* How many units with empty cgroups to dispatch per event loop iteration */
+#define CGROUP_EMPTY_BATCH_MAX 64U
+
 /* Returns the log level to use when cgroup attribute writes fail. When an attribute is missing or we have access
  * problems we downgrade to LOG_DEBUG. This is supposed to be nice to container managers and kernels which want to mask
  * out specific attributes from us. */
@@ -61,9 +65,32 @@ bool unit_has_host_root_cgroup(Unit *u) {
         return unit_has_name(u, SPECIAL_ROOT_SLICE);
 }
 
+static bool cgroup_attribute_has_value(Unit *u, const char *controller, const char *attribute, const char *value) {
+        _cleanup_free_ char *current = NULL;
+        size_t n;
+
+        /* Values are written with a trailing newline, which isn't part of the value read back */
+        n = strcspn(value, NEWLINE);
+        if (value[n] != 0 && !streq(value + n, "\n"))
+                return false;
+
+        if (cg_get_attribute(controller, u->cgroup_path, attribute, &current) < 0)
+                return false;
+
+        return strlen(current) == n && memcmp(current, value, n) == 0;
+}
+
 static int set_attribute_and_warn(Unit *u, const char *controller, const char *attribute, const char *value) {
         int r;
 
+        /* We reapply all settings whenever anything about a unit's cgroup changes, but usually most of the values
+         * are the same as before. Writing some attributes is expensive, e.g. memory.max triggers reclaim, hence
+         * skip writing a value the attribute already has. The attribute is read each time rather than
+         * remembering what we wrote, so that values changed behind our back are still put right. Attributes
+         * that don't read back the way they are written, e.g. keyed ones, are always written. */
+        if (cgroup_attribute_has_value(u, controller, attribute, value))
+                return 0;
+
         r = cg_set_attribute(controller, u->cgroup_path, attribute, value);
         if (r < 0)
                 log_unit_full(u, LOG_LEVEL_CGROUP_WRITE(r), r, "Failed to set '%s' attribute on '%s' to '%.*s': %m",
@@ -115,6 +142,8 @@ void cgroup_context_init(CGroupContext *c) {
                 .startup_blockio_weight = CGROUP_BLKIO_WEIGHT_INVALID,
 
                 .tasks_max = CGROUP_LIMIT_MAX,
+
+                .pressure_window_usec = CGROUP_PRESSURE_WINDOW_DEFAULT_USEC,
         };
 }
 
@@ -195,6 +224,9 @@ void cgroup_context_done(CGroupContext *c) {
 
         c->ip_address_allow = ip_address_access_free_all(c->ip_address_allow);
         c->ip_address_deny = ip_address_access_free_all(c->ip_address_deny);
+
+        c->cpuset_cpus = cpu_set_mfree(c->cpuset_cpus);
+        c->cpuset_mems = cpu_set_mfree(c->cpuset_mems);
 }
 
 void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix) {
@@ -205,7 +237,8 @@ void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix) {
         CGroupBlockIODeviceWeight *w;
         CGroupDeviceAllow *a;
         IPAddressAccessItem *iaai;
-        char u[FORMAT_TIMESPAN_MAX];
+        CGroupPressureResource resource;
+        char u[FORMAT_TIMESPAN_MAX], v[FORMAT_TIMESPAN_MAX];
 
         assert(c);
         assert(f);
@@ -236,6 +269,8 @@ void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix) {
                 "%sMemoryLimit=%" PRIu64 "\n"
                 "%sTasksMax=%" PRIu64 "\n"
                 "%sDevicePolicy=%s\n"
+                "%sPressureWindowSec=%s\n"
+                "%sPressureAction=%s\n"
                 "%sDelegate=%s\n",
                 prefix, yes_no(c->cpu_accounting),
                 prefix, yes_no(c->io_accounting),
@@ -260,6 +295,8 @@ void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix) {
                 prefix, c->memory_limit,
                 prefix, c->tasks_max,
                 prefix, cgroup_device_policy_to_string(c->device_policy),
+                prefix, format_timespan(v, sizeof(v), c->pressure_window_usec, 1),
+                prefix, cgroup_pressure_action_to_string(c->pressure_action),
                 prefix, yes_no(c->delegate));
 
         if (c->delegate) {
@@ -272,6 +309,33 @@ void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix) {
                         strempty(t));
         }
 
+        if (c->cpuset_cpus) {
+                _cleanup_free_ char *t = NULL;
+
+                t = cpu_set_to_range_string(c->cpuset_cpus, c->cpuset_cpus_ncpus);
+                fprintf(f, "%sAllowedCPUs=%s\n", prefix, strnull(t));
+        }
+
+        if (c->cpuset_mems) {
+                _cleanup_free_ char *t = NULL;
+
+                t = cpu_set_to_range_string(c->cpuset_mems, c->cpuset_mems_nnodes);
+                fprintf(f, "%sAllowedMemoryNodes=%s\n", prefix, strnull(t));
+        }
+
+        for (resource = 0; resource < _CGROUP_PRESSURE_RESOURCE_MAX; resource++) {
+                static const char* const pressure_setting[_CGROUP_PRESSURE_RESOURCE_MAX] = {
+                        [CGROUP_PRESSURE_CPU]    = "CPUPressureThresholdSec",
+                        [CGROUP_PRESSURE_IO]     = "IOPressureThresholdSec",
+                        [CGROUP_PRESSURE_MEMORY] = "MemoryPressureThresholdSec",
+                };
+
+                if (c->pressure_threshold_usec[resource] > 0)
+                        fprintf(f, "%s%s=%s\n",
+                                prefix, pressure_setting[resource],
+                                format_timespan(u, sizeof(u), c->pressure_threshold_usec[resource], 1));
+        }
+
         LIST_FOREACH(device_allow, a, c->device_allow)
                 fprintf(f,
                         "%sDeviceAllow=%s %s%s%s\n",
@@ -674,6 +738,19 @@ static void cgroup_apply_unified_cpu_quota(Unit *u, usec_t quota) {
         (void) set_attribute_and_warn(u, "cpu", "cpu.max", buf);
 }
 
+static void cgroup_apply_unified_cpuset(Unit *u, const cpu_set_t *set, unsigned n, const char *name) {
+        _cleanup_free_ char *buf = NULL;
+
+        /* An empty set makes the cgroup inherit the effective set of its parent */
+        buf = cpu_set_to_range_string(set, n);
+        if (!buf) {
+                log_oom();
+                return;
+        }
+
+        (void) set_attribute_and_warn(u, "cpuset", name, buf);
+}
+
 static void cgroup_apply_legacy_cpu_shares(Unit *u, uint64_t shares) {
         char buf[DECIMAL_STR_MAX(uint64_t) + 2];
 
@@ -934,6 +1011,13 @@ static void cgroup_context_apply(
                 }
         }
 
+        /* Same for the 'cpuset' controller, which we only support on the unified hierarchy. Note that the settings
+         * are hierarchical: whatever is configured on a slice confines all units below it too. */
+        if ((apply_mask & CGROUP_MASK_CPUSET) && !is_local_root) {
+                cgroup_apply_unified_cpuset(u, c->cpuset_cpus, c->cpuset_cpus_ncpus, "cpuset.cpus");
+                cgroup_apply_unified_cpuset(u, c->cpuset_mems, c->cpuset_mems_nnodes, "cpuset.mems");
+        }
+
         /* The 'io' controller attributes are not exported on the host's root cgroup (being a pure cgroup v2
          * controller), and in case of containers we want to leave control of these attributes to the container manager
          * (and we couldn't access that stuff anyway, even if we tried if proper delegation is used). */
@@ -1290,6 +1374,9 @@ static CGroupMask cgroup_context_get_mask(CGroupContext *c) {
             c->cpu_quota_per_sec_usec != USEC_INFINITY)
                 mask |= CGROUP_MASK_CPU;
 
+        if (c->cpuset_cpus || c->cpuset_mems)
+                mask |= CGROUP_MASK_CPUSET;
+
         if (cgroup_context_has_io_config(c) || cgroup_context_has_blockio_config(c))
                 mask |= CGROUP_MASK_IO | CGROUP_MASK_BLKIO;
 
@@ -1371,11 +1458,10 @@ CGroupMask unit_get_members_mask(Unit *u) {
         u->cgroup_members_mask = 0;
 
         if (u->type == UNIT_SLICE) {
-                void *v;
                 Unit *member;
-                Iterator i;
+                UnitDependencyIterator i;
 
-                HASHMAP_FOREACH_KEY(v, member, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(member, u, UNIT_BEFORE, i) {
                         if (UNIT_DEREF(member->slice) == u)
                                 u->cgroup_members_mask |= unit_get_subtree_mask(member); /* note that this calls ourselves again, for the children */
                 }
@@ -1588,6 +1674,25 @@ int unit_watch_cgroup(Unit *u) {
                                       * it, so this is not an error */
                         return 0;
 
+                if (errno == ENOSPC && u->type != UNIT_SLICE) {
+                        /* We ran out of inotify watches. Since "populated" in cgroup.events covers the whole
+                         * subtree, the slice this unit is located in will still tell us when everything below
+                         * it ran empty, hence let's check the unit then, and retry as soon as a watch frees
+                         * up. Slices are not handled this way, as that's what everything else relies on. */
+                        r = set_ensure_allocated(&u->manager->cgroup_inotify_unwatched, NULL);
+                        if (r < 0)
+                                return log_oom();
+
+                        r = set_put(u->manager->cgroup_inotify_unwatched, u);
+                        if (r < 0)
+                                return log_oom();
+
+                        log_unit_full(u, u->manager->cgroup_inotify_exhausted ? LOG_DEBUG : LOG_WARNING, 0,
+                                      "Out of inotify watches, only tracking control group %s through its slice.", u->cgroup_path);
+                        u->manager->cgroup_inotify_exhausted = true;
+                        return 0;
+                }
+
                 return log_unit_error_errno(u, errno, "Failed to add inotify watch descriptor for control group %s: %m", u->cgroup_path);
         }
 
@@ -1598,6 +1703,164 @@ int unit_watch_cgroup(Unit *u) {
         return 0;
 }
 
+static int on_pressure_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        char t[FORMAT_TIMESPAN_MAX], w[FORMAT_TIMESPAN_MAX];
+        CGroupPressureResource resource;
+        Unit *u = userdata;
+        CGroupContext *c;
+        int r = 0;
+
+        assert(s);
+        assert(u);
+
+        for (resource = 0; resource < _CGROUP_PRESSURE_RESOURCE_MAX; resource++)
+                if (u->pressure_event_source[resource] == s)
+                        break;
+        assert(resource < _CGROUP_PRESSURE_RESOURCE_MAX);
+
+        if (revents & EPOLLERR) {
+                /* The cgroup is gone */
+                u->pressure_event_source[resource] = sd_event_source_unref(s);
+                return 0;
+        }
+
+        c = unit_get_cgroup_context(u);
+        if (!c)
+                return 0;
+
+        log_unit_notice(u, "Tasks stalled on %s for more than %s within %s.",
+                        cgroup_pressure_resource_to_string(resource),
+                        format_timespan(t, sizeof(t), u->pressure_trigger_usec[resource], 1),
+                        format_timespan(w, sizeof(w), u->pressure_trigger_window_usec, 1));
+
+        bus_unit_send_pressure_signal(u, resource);
+
+        /* The kernel notifies us at most once per window, hence no need to rate limit the actions */
+        if (!UNIT_IS_ACTIVE_OR_RELOADING(unit_active_state(u)))
+                return 0;
+
+        switch (c->pressure_action) {
+
+        case CGROUP_PRESSURE_ACTION_STOP:
+                log_unit_notice(u, "Stopping, as requested by PressureAction=.");
+                r = manager_add_job(u->manager, JOB_STOP, u, JOB_REPLACE, &error, NULL);
+                break;
+
+        case CGROUP_PRESSURE_ACTION_KILL:
+                log_unit_notice(u, "Killing processes, as requested by PressureAction=.");
+                r = unit_kill(u, KILL_ALL, SIGKILL, &error);
+                break;
+
+        default:
+                break;
+        }
+        if (r < 0)
+                log_unit_warning(u, "Failed to execute PressureAction=%s, ignoring: %s",
+                                 cgroup_pressure_action_to_string(c->pressure_action), bus_error_message(&error, r));
+
+        return 0;
+}
+
+static int unit_watch_pressure_one(Unit *u, CGroupPressureResource resource, usec_t threshold_usec, usec_t window_usec) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        char t[FORMAT_TIMESPAN_MAX], w[FORMAT_TIMESPAN_MAX];
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(u);
+
+        fd = cg_open_pressure_trigger(u->cgroup_path, resource, threshold_usec, window_usec);
+        if (fd == -ENOENT) {
+                /* Either the cgroup is gone already, or the kernel doesn't do PSI */
+                log_unit_debug_errno(u, fd, "Not watching %s pressure: %m", cgroup_pressure_resource_to_string(resource));
+                return 0;
+        }
+        if (IN_SET(fd, -EINVAL, -ERANGE))
+                return log_unit_warning_errno(u, fd, "Invalid %s pressure threshold %s for window %s, ignoring.",
+                                              cgroup_pressure_resource_to_string(resource),
+                                              format_timespan(t, sizeof(t), threshold_usec, 1),
+                                              format_timespan(w, sizeof(w), window_usec, 1));
+        if (fd < 0)
+                return log_unit_warning_errno(u, fd, "Failed to register %s pressure trigger, ignoring: %m",
+                                              cgroup_pressure_resource_to_string(resource));
+
+        r = sd_event_add_io(u->manager->event, &s, fd, EPOLLPRI, on_pressure_event, u);
+        if (r < 0)
+                return log_unit_warning_errno(u, r, "Failed to watch %s pressure trigger, ignoring: %m",
+                                              cgroup_pressure_resource_to_string(resource));
+
+        r = sd_event_source_set_io_fd_own(s, true);
+        if (r < 0)
+                return log_unit_warning_errno(u, r, "Failed to pass ownership of pressure trigger fd to event source: %m");
+        TAKE_FD(fd);
+
+        (void) sd_event_source_set_description(s, "cgroup-pressure");
+
+        u->pressure_event_source[resource] = TAKE_PTR(s);
+        u->pressure_trigger_usec[resource] = threshold_usec;
+
+        return 0;
+}
+
+int unit_watch_pressure(Unit *u) {
+        CGroupPressureResource resource;
+        CGroupContext *c;
+        int r, ret = 0;
+
+        assert(u);
+
+        /* Registers (or updates) PSI triggers on the unit's cgroup for all resources that have a threshold
+         * configured. Unchanged triggers are left alone, so that this is cheap to call on every realization. */
+
+        c = unit_get_cgroup_context(u);
+        if (!c)
+                return 0;
+
+        if (!u->cgroup_path) {
+                unit_unwatch_pressure(u);
+                return 0;
+        }
+
+        /* PSI is only available on the unified hierarchy */
+        r = cg_unified_controller(SYSTEMD_CGROUP_CONTROLLER);
+        if (r < 0)
+                return log_unit_error_errno(u, r, "Failed to determine whether the name=systemd hierarchy is unified: %m");
+        if (r == 0)
+                return 0;
+
+        for (resource = 0; resource < _CGROUP_PRESSURE_RESOURCE_MAX; resource++) {
+                usec_t threshold = c->pressure_threshold_usec[resource];
+
+                if (u->pressure_event_source[resource] &&
+                    u->pressure_trigger_usec[resource] == threshold &&
+                    u->pressure_trigger_window_usec == c->pressure_window_usec)
+                        continue;
+
+                u->pressure_event_source[resource] = sd_event_source_unref(u->pressure_event_source[resource]);
+
+                if (threshold <= 0)
+                        continue;
+
+                r = unit_watch_pressure_one(u, resource, threshold, c->pressure_window_usec);
+                if (r < 0 && ret >= 0)
+                        ret = r;
+        }
+
+        u->pressure_trigger_window_usec = c->pressure_window_usec;
+
+        return ret;
+}
+
+void unit_unwatch_pressure(Unit *u) {
+        CGroupPressureResource resource;
+
+        assert(u);
+
+        for (resource = 0; resource < _CGROUP_PRESSURE_RESOURCE_MAX; resource++)
+                u->pressure_event_source[resource] = sd_event_source_unref(u->pressure_event_source[resource]);
+}
+
 int unit_pick_cgroup_path(Unit *u) {
         _cleanup_free_ char *path = NULL;
         int r;
@@ -1650,6 +1913,7 @@ static int unit_create_cgroup(
 
         /* Start watching it */
         (void) unit_watch_cgroup(u);
+        (void) unit_watch_pressure(u);
 
         /* Preserve enabled controllers in delegated units, adjust others. */
         if (created || !u->cgroup_realized || !unit_cgroup_delegate(u)) {
@@ -1955,16 +2219,15 @@ static int unit_realize_cgroup_now_enable(Unit *u, ManagerState state) {
 /* Controllers can only be disabled depth-first, from the leaves of the
  * hierarchy upwards to the unit in question. */
 static int unit_realize_cgroup_now_disable(Unit *u, ManagerState state) {
-        Iterator i;
+        UnitDependencyIterator i;
         Unit *m;
-        void *v;
 
         assert(u);
 
         if (u->type != UNIT_SLICE)
                 return 0;
 
-        HASHMAP_FOREACH_KEY(v, m, u->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(m, u, UNIT_BEFORE, i) {
                 CGroupMask target_mask, enable_mask, new_target_mask, new_enable_mask;
                 int r;
 
@@ -2047,6 +2310,7 @@ static int unit_realize_cgroup_now_disable(Unit *u, ManagerState state) {
  * Returns 0 on success and < 0 on failure. */
 static int unit_realize_cgroup_now(Unit *u, ManagerState state) {
         CGroupMask target_mask, enable_mask;
+        dual_timestamp ts;
         int r;
 
         assert(u);
@@ -2059,6 +2323,8 @@ static int unit_realize_cgroup_now(Unit *u, ManagerState state) {
         if (unit_has_mask_realized(u, target_mask, enable_mask))
                 return 0;
 
+        dual_timestamp_get(&ts);
+
         /* Disable controllers below us, if there are any */
         r = unit_realize_cgroup_now_disable(u, state);
         if (r < 0)
@@ -2078,6 +2344,9 @@ static int unit_realize_cgroup_now(Unit *u, ManagerState state) {
 
         /* Now, reset the invalidation mask */
         u->cgroup_invalidated_mask = 0;
+
+        u->cgroup_realize_timestamp = ts;
+        u->cgroup_realize_usec = usec_sub_unsigned(now(CLOCK_MONOTONIC), ts.monotonic);
         return 0;
 }
 
@@ -2118,11 +2387,10 @@ static void unit_add_siblings_to_cgroup_realize_queue(Unit *u) {
          * neither the specified unit itself nor the parents.) */
 
         while ((slice = UNIT_DEREF(u->slice))) {
-                Iterator i;
+                UnitDependencyIterator i;
                 Unit *m;
-                void *v;
 
-                HASHMAP_FOREACH_KEY(v, m, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(m, u, UNIT_BEFORE, i) {
                         /* Skip units that have a dependency on the slice
                          * but aren't actually in it. */
                         if (UNIT_DEREF(m->slice) != slice)
@@ -2172,6 +2440,23 @@ int unit_realize_cgroup(Unit *u) {
         return unit_realize_cgroup_now(u, manager_state(u->manager));
 }
 
+static void unit_add_to_cgroup_empty_check_queue(Unit *u);
+
+static void unit_rewatch_cgroup_unwatched(Manager *m) {
+        Unit *u;
+
+        assert(m);
+
+        u = set_steal_first(m->cgroup_inotify_unwatched);
+        if (!u)
+                return;
+
+        (void) unit_watch_cgroup(u);
+
+        /* The cgroup might have run empty while we weren't looking */
+        unit_add_to_cgroup_empty_check_queue(u);
+}
+
 void unit_release_cgroup(Unit *u) {
         assert(u);
 
@@ -2183,13 +2468,21 @@ void unit_release_cgroup(Unit *u) {
                 u->cgroup_path = mfree(u->cgroup_path);
         }
 
+        unit_unwatch_pressure(u);
+        u->accounting_sample_timestamp = 0;
+
         if (u->cgroup_inotify_wd >= 0) {
                 if (inotify_rm_watch(u->manager->cgroup_inotify_fd, u->cgroup_inotify_wd) < 0)
                         log_unit_debug_errno(u, errno, "Failed to remove cgroup inotify watch %i for %s, ignoring: %m", u->cgroup_inotify_wd, u->id);
 
                 (void) hashmap_remove(u->manager->cgroup_inotify_wd_unit, INT_TO_PTR(u->cgroup_inotify_wd));
                 u->cgroup_inotify_wd = -1;
+
+                /* A watch just freed up, hand it to one of the units that didn't get one */
+                unit_rewatch_cgroup_unwatched(u->manager);
         }
+
+        (void) set_remove(u->manager->cgroup_inotify_unwatched, u);
 }
 
 void unit_prune_cgroup(Unit *u) {
@@ -2223,6 +2516,7 @@ void unit_prune_cgroup(Unit *u) {
         u->cgroup_enabled_mask = 0;
 
         u->bpf_device_control_installed = bpf_program_unref(u->bpf_device_control_installed);
+        u->bpf_device_control_shared = bpf_devices_shared_unref(u->bpf_device_control_shared);
 }
 
 int unit_search_main_pid(Unit *u, pid_t *ret) {
@@ -2366,32 +2660,45 @@ int unit_watch_all_pids(Unit *u) {
 
 static int on_cgroup_empty_event(sd_event_source *s, void *userdata) {
         Manager *m = userdata;
+        unsigned n = 0;
         Unit *u;
         int r;
 
         assert(s);
         assert(m);
 
-        u = m->cgroup_empty_queue;
-        if (!u)
-                return 0;
+        /* First, verify all cgroups we got notifications for since the last iteration. Each one is checked only
+         * once, regardless how many notifications we got for it in the meantime. */
+        while ((u = m->cgroup_empty_check_queue)) {
+                assert(u->in_cgroup_empty_check_queue);
+                u->in_cgroup_empty_check_queue = false;
+                LIST_REMOVE(cgroup_empty_check_queue, m->cgroup_empty_check_queue, u);
+
+                unit_add_to_cgroup_empty_queue(u);
+        }
+
+        /* Then, dispatch a batch of the ones that turned out to be empty. We don't dispatch all of them at once,
+         * so that SIGCHLD events that come in in the meantime still get a chance to be processed first. */
+        while (n < CGROUP_EMPTY_BATCH_MAX && (u = m->cgroup_empty_queue)) {
+                assert(u->in_cgroup_empty_queue);
+                u->in_cgroup_empty_queue = false;
+                LIST_REMOVE(cgroup_empty_queue, m->cgroup_empty_queue, u);
+
+                unit_add_to_gc_queue(u);
 
-        assert(u->in_cgroup_empty_queue);
-        u->in_cgroup_empty_queue = false;
-        LIST_REMOVE(cgroup_empty_queue, m->cgroup_empty_queue, u);
+                if (UNIT_VTABLE(u)->notify_cgroup_empty)
+                        UNIT_VTABLE(u)->notify_cgroup_empty(u);
 
-        if (m->cgroup_empty_queue) {
+                n++;
+        }
+
+        if (m->cgroup_empty_queue || m->cgroup_empty_check_queue) {
                 /* More stuff queued, let's make sure we remain enabled */
                 r = sd_event_source_set_enabled(s, SD_EVENT_ONESHOT);
                 if (r < 0)
                         log_debug_errno(r, "Failed to reenable cgroup empty event source, ignoring: %m");
         }
 
-        unit_add_to_gc_queue(u);
-
-        if (UNIT_VTABLE(u)->notify_cgroup_empty)
-                UNIT_VTABLE(u)->notify_cgroup_empty(u);
-
         return 0;
 }
 
@@ -2440,6 +2747,46 @@ void unit_add_to_cgroup_empty_queue(Unit *u) {
                 log_debug_errno(r, "Failed to enable cgroup empty event source: %m");
 }
 
+static void unit_add_to_cgroup_empty_check_queue(Unit *u) {
+        int r;
+
+        assert(u);
+
+        /* Like unit_add_to_cgroup_empty_queue(), but defers checking whether the cgroup is actually empty to the
+         * next run of the cgroup empty event source, so that a flood of notifications for the same cgroup results
+         * in reading its attributes only once. */
+
+        if (u->in_cgroup_empty_check_queue || u->in_cgroup_empty_queue)
+                return;
+
+        if (!u->cgroup_path)
+                return;
+
+        LIST_PREPEND(cgroup_empty_check_queue, u->manager->cgroup_empty_check_queue, u);
+        u->in_cgroup_empty_check_queue = true;
+
+        r = sd_event_source_set_enabled(u->manager->cgroup_empty_event_source, SD_EVENT_ONESHOT);
+        if (r < 0)
+                log_debug_errno(r, "Failed to enable cgroup empty event source: %m");
+}
+
+static void unit_add_unwatched_to_cgroup_empty_check_queue(Unit *slice) {
+        Iterator i;
+        Unit *u;
+
+        assert(slice);
+
+        /* The slice's subtree changed its populated state. Check the units below it we couldn't get an inotify
+         * watch for, as they might have run empty along with it. */
+
+        if (slice->type != UNIT_SLICE || !slice->cgroup_path)
+                return;
+
+        SET_FOREACH(u, slice->manager->cgroup_inotify_unwatched, i)
+                if (u->cgroup_path && path_startswith(u->cgroup_path, slice->cgroup_path))
+                        unit_add_to_cgroup_empty_check_queue(u);
+}
+
 static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         Manager *m = userdata;
 
@@ -2479,7 +2826,8 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
                                  * this here safely. */
                                 continue;
 
-                        unit_add_to_cgroup_empty_queue(u);
+                        unit_add_to_cgroup_empty_check_queue(u);
+                        unit_add_unwatched_to_cgroup_empty_check_queue(u);
                 }
         }
 }
@@ -2664,8 +3012,10 @@ void manager_shutdown_cgroup(Manager *m, bool delete) {
                 (void) cg_trim(SYSTEMD_CGROUP_CONTROLLER, m->cgroup_root, false);
 
         m->cgroup_empty_event_source = sd_event_source_unref(m->cgroup_empty_event_source);
+        m->accounting_sample_event_source = sd_event_source_unref(m->accounting_sample_event_source);
 
         m->cgroup_inotify_wd_unit = hashmap_free(m->cgroup_inotify_wd_unit);
+        m->cgroup_inotify_unwatched = set_free(m->cgroup_inotify_unwatched);
 
         m->cgroup_inotify_event_source = sd_event_source_unref(m->cgroup_inotify_event_source);
         m->cgroup_inotify_fd = safe_close(m->cgroup_inotify_fd);
@@ -2761,7 +3111,7 @@ int manager_notify_cgroup_empty(Manager *m, const char *cgroup) {
         if (!u)
                 return 0;
 
-        unit_add_to_cgroup_empty_queue(u);
+        unit_add_to_cgroup_empty_check_queue(u);
         return 1;
 }
 
@@ -2829,6 +3179,31 @@ int unit_get_tasks_current(Unit *u, uint64_t *ret) {
         return safe_atou64(v, ret);
 }
 
+int unit_get_pressure(Unit *u, CGroupPressureResource resource, CGroupPressure *ret) {
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        if (!UNIT_HAS_CGROUP_CONTEXT(u))
+                return -ENODATA;
+
+        if (!u->cgroup_path)
+                return -ENODATA;
+
+        r = cg_unified_controller(SYSTEMD_CGROUP_CONTROLLER);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -ENODATA;
+
+        r = cg_get_pressure(u->cgroup_path, resource, ret);
+        if (r == -ENOENT)
+                return -ENODATA;
+
+        return r;
+}
+
 static int unit_get_cpu_usage_raw(Unit *u, nsec_t *ret) {
         _cleanup_free_ char *v = NULL;
         uint64_t ns;
@@ -2919,32 +3294,22 @@ int unit_get_cpu_usage(Unit *u, nsec_t *ret) {
         return 0;
 }
 
-int unit_get_ip_accounting(
-                Unit *u,
-                CGroupIPAccountingMetric metric,
-                uint64_t *ret) {
-
-        uint64_t value;
-        int fd, r;
+int unit_get_ip_accounting_all(Unit *u, uint64_t ret[_CGROUP_IP_ACCOUNTING_METRIC_MAX]) {
+        CGroupIPAccountingMetric metric;
+        int r;
 
         assert(u);
-        assert(metric >= 0);
-        assert(metric < _CGROUP_IP_ACCOUNTING_METRIC_MAX);
         assert(ret);
 
+        /* Retrieves all IP accounting counters at once, which requires a single lookup in the unit's BPF map */
+
         if (!UNIT_CGROUP_BOOL(u, ip_accounting))
                 return -ENODATA;
 
-        fd = IN_SET(metric, CGROUP_IP_INGRESS_BYTES, CGROUP_IP_INGRESS_PACKETS) ?
-                u->ip_accounting_ingress_map_fd :
-                u->ip_accounting_egress_map_fd;
-        if (fd < 0)
+        if (u->ip_accounting_map_fd < 0)
                 return -ENODATA;
 
-        if (IN_SET(metric, CGROUP_IP_INGRESS_BYTES, CGROUP_IP_EGRESS_BYTES))
-                r = bpf_firewall_read_accounting(fd, &value, NULL);
-        else
-                r = bpf_firewall_read_accounting(fd, NULL, &value);
+        r = bpf_firewall_read_accounting(u->ip_accounting_map_fd, ret);
         if (r < 0)
                 return r;
 
@@ -2952,9 +3317,168 @@ int unit_get_ip_accounting(
          * all BPF programs and maps anew, but serialize the old counters. When deserializing we store them in the
          * ip_accounting_extra[] field, and add them in here transparently. */
 
-        *ret = value + u->ip_accounting_extra[metric];
+        for (metric = 0; metric < _CGROUP_IP_ACCOUNTING_METRIC_MAX; metric++)
+                ret[metric] += u->ip_accounting_extra[metric];
 
-        return r;
+        return 0;
+}
+
+int unit_get_ip_accounting(
+                Unit *u,
+                CGroupIPAccountingMetric metric,
+                uint64_t *ret) {
+
+        uint64_t values[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
+        int r;
+
+        assert(u);
+        assert(metric >= 0);
+        assert(metric < _CGROUP_IP_ACCOUNTING_METRIC_MAX);
+        assert(ret);
+
+        r = unit_get_ip_accounting_all(u, values);
+        if (r < 0)
+                return r;
+
+        *ret = values[metric];
+        return 0;
+}
+
+int unit_sample_accounting(Unit *u) {
+        int r;
+
+        assert(u);
+
+        /* Reads the current accounting data of the unit and stores it away, so that it may be served by
+         * unit_has_accounting_sample() users without touching the cgroup file system again. */
+
+        r = unit_get_cpu_usage(u, &u->cpu_usage_sample);
+        if (r < 0) {
+                if (r != -ENODATA)
+                        log_unit_debug_errno(u, r, "Failed to sample CPU usage, ignoring: %m");
+                u->cpu_usage_sample = NSEC_INFINITY;
+        }
+
+        r = unit_get_memory_current(u, &u->memory_current_sample);
+        if (r < 0) {
+                if (r != -ENODATA)
+                        log_unit_debug_errno(u, r, "Failed to sample current memory usage, ignoring: %m");
+                u->memory_current_sample = (uint64_t) -1;
+        }
+
+        r = unit_get_tasks_current(u, &u->tasks_current_sample);
+        if (r < 0) {
+                if (r != -ENODATA)
+                        log_unit_debug_errno(u, r, "Failed to sample current number of tasks, ignoring: %m");
+                u->tasks_current_sample = (uint64_t) -1;
+        }
+
+        r = unit_get_ip_accounting_all(u, u->ip_accounting_sample);
+        if (r < 0) {
+                CGroupIPAccountingMetric metric;
+
+                if (r != -ENODATA)
+                        log_unit_debug_errno(u, r, "Failed to sample IP accounting data, ignoring: %m");
+
+                for (metric = 0; metric < _CGROUP_IP_ACCOUNTING_METRIC_MAX; metric++)
+                        u->ip_accounting_sample[metric] = (uint64_t) -1;
+        }
+
+        u->accounting_sample_timestamp = now(CLOCK_REALTIME);
+        return 0;
+}
+
+bool unit_has_accounting_sample(Unit *u) {
+        assert(u);
+
+        /* Samples are only used while the sampler keeps them up-to-date */
+        return u->manager->accounting_sample_event_source &&
+                u->accounting_sample_timestamp > 0;
+}
+
+static int on_accounting_sample_timer(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *m = userdata;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(s);
+        assert(m);
+
+        /* Read the accounting data of all units with a cgroup in one go, instead of doing so whenever a client
+         * asks for it. */
+        HASHMAP_FOREACH(u, m->cgroup_unit, i) {
+                if (!UNIT_CGROUP_BOOL(u, cpu_accounting) &&
+                    !UNIT_CGROUP_BOOL(u, memory_accounting) &&
+                    !UNIT_CGROUP_BOOL(u, tasks_accounting) &&
+                    !UNIT_CGROUP_BOOL(u, ip_accounting))
+                        continue;
+
+                (void) unit_sample_accounting(u);
+        }
+
+        r = sd_event_source_set_time(s, usec_add(usec, m->accounting_sample_usec));
+        if (r < 0)
+                return log_error_errno(r, "Failed to rearm accounting sample timer: %m");
+
+        r = sd_event_source_set_enabled(s, SD_EVENT_ONESHOT);
+        if (r < 0)
+                return log_error_errno(r, "Failed to enable accounting sample timer: %m");
+
+        return 0;
+}
+
+int manager_set_accounting_sample_interval(Manager *m, usec_t usec) {
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(m);
+
+        /* Sets up, reschedules or stops the accounting sampler, for example when the setting changed on reload.
+         * Both 0 and infinity turn sampling off. */
+
+        m->accounting_sample_usec = usec;
+
+        if (usec <= 0 || usec == USEC_INFINITY) {
+                if (!m->accounting_sample_event_source)
+                        return 0;
+
+                m->accounting_sample_event_source = sd_event_source_unref(m->accounting_sample_event_source);
+
+                /* Don't serve outdated samples should sampling be turned on again later */
+                HASHMAP_FOREACH(u, m->cgroup_unit, i)
+                        u->accounting_sample_timestamp = 0;
+
+                return 0;
+        }
+
+        if (m->accounting_sample_event_source) {
+                r = sd_event_source_set_time(m->accounting_sample_event_source, usec_add(now(CLOCK_MONOTONIC), usec));
+                if (r < 0)
+                        return log_error_errno(r, "Failed to reschedule accounting sample timer: %m");
+
+                r = sd_event_source_set_enabled(m->accounting_sample_event_source, SD_EVENT_ONESHOT);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to enable accounting sample timer: %m");
+
+                return 0;
+        }
+
+        r = sd_event_add_time(m->event, &m->accounting_sample_event_source, CLOCK_MONOTONIC,
+                              usec_add(now(CLOCK_MONOTONIC), usec), 0,
+                              on_accounting_sample_timer, m);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate accounting sample timer: %m");
+
+        /* Run after everything else, this is just statistics */
+        r = sd_event_source_set_priority(m->accounting_sample_event_source, SD_EVENT_PRIORITY_IDLE);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set priority of accounting sample timer: %m");
+
+        (void) sd_event_source_set_description(m->accounting_sample_event_source, "accounting-sample");
+
+        return 0;
 }
 
 int unit_reset_cpu_accounting(Unit *u) {
@@ -2964,6 +3488,7 @@ int unit_reset_cpu_accounting(Unit *u) {
         assert(u);
 
         u->cpu_usage_last = NSEC_INFINITY;
+        u->accounting_sample_timestamp = 0;
 
         r = unit_get_cpu_usage_raw(u, &ns);
         if (r < 0) {
@@ -2976,19 +3501,16 @@ int unit_reset_cpu_accounting(Unit *u) {
 }
 
 int unit_reset_ip_accounting(Unit *u) {
-        int r = 0, q = 0;
+        int r = 0;
 
         assert(u);
 
-        if (u->ip_accounting_ingress_map_fd >= 0)
-                r = bpf_firewall_reset_accounting(u->ip_accounting_ingress_map_fd);
-
-        if (u->ip_accounting_egress_map_fd >= 0)
-                q = bpf_firewall_reset_accounting(u->ip_accounting_egress_map_fd);
+        if (u->ip_accounting_map_fd >= 0)
+                r = bpf_firewall_reset_accounting(u->ip_accounting_map_fd);
 
         zero(u->ip_accounting_extra);
 
-        return r < 0 ? r : q;
+        return r;
 }
 
 void unit_invalidate_cgroup(Unit *u, CGroupMask m) {
@@ -3030,10 +3552,9 @@ void unit_invalidate_cgroup_bpf(Unit *u) {
          * list of our children includes our own. */
         if (u->type == UNIT_SLICE) {
                 Unit *member;
-                Iterator i;
-                void *v;
+                UnitDependencyIterator i;
 
-                HASHMAP_FOREACH_KEY(v, member, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(member, u, UNIT_BEFORE, i) {
                         if (UNIT_DEREF(member->slice) == u)
                                 unit_invalidate_cgroup_bpf(member);
                 }
@@ -3072,3 +3593,11 @@ static const char* const cgroup_device_policy_table[_CGROUP_DEVICE_POLICY_MAX] =
 };
 
 DEFINE_STRING_TABLE_LOOKUP(cgroup_device_policy, CGroupDevicePolicy);
+
+static const char* const cgroup_pressure_action_table[_CGROUP_PRESSURE_ACTION_MAX] = {
+        [CGROUP_PRESSURE_ACTION_NONE] = "none",
+        [CGROUP_PRESSURE_ACTION_STOP] = "stop",
+        [CGROUP_PRESSURE_ACTION_KILL] = "kill",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(cgroup_pressure_action, CGroupPressureAction);
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 
 #include "cgroup-util.h"
+#include "cpu-set-util.h"
 #include "ip-address-access.h"
 #include "list.h"
 #include "time-util.h"
@@ -32,6 +33,16 @@ typedef enum CGroupDevicePolicy {
         _CGROUP_DEVICE_POLICY_INVALID = -1
 } CGroupDevicePolicy;
 
+typedef enum CGroupPressureAction {
+        CGROUP_PRESSURE_ACTION_NONE,
+        CGROUP_PRESSURE_ACTION_STOP,
+        CGROUP_PRESSURE_ACTION_KILL,
+        _CGROUP_PRESSURE_ACTION_MAX,
+        _CGROUP_PRESSURE_ACTION_INVALID = -1
+} CGroupPressureAction;
+
+#define CGROUP_PRESSURE_WINDOW_DEFAULT_USEC (2 * USEC_PER_SEC)
+
 struct CGroupDeviceAllow {
         LIST_FIELDS(CGroupDeviceAllow, device_allow);
         char *path;
@@ -84,6 +95,11 @@ struct CGroupContext {
         uint64_t startup_cpu_weight;
         usec_t cpu_quota_per_sec_usec;
 
+        cpu_set_t *cpuset_cpus;
+        unsigned cpuset_cpus_ncpus;
+        cpu_set_t *cpuset_mems;
+        unsigned cpuset_mems_nnodes;
+
         uint64_t io_weight;
         uint64_t startup_io_weight;
         LIST_HEAD(CGroupIODeviceWeight, io_device_weights);
@@ -99,6 +115,11 @@ struct CGroupContext {
         LIST_HEAD(IPAddressAccessItem, ip_address_allow);
         LIST_HEAD(IPAddressAccessItem, ip_address_deny);
 
+        /* Stall time per window above which we consider a resource under pressure, 0 if not watched */
+        usec_t pressure_threshold_usec[_CGROUP_PRESSURE_RESOURCE_MAX];
+        usec_t pressure_window_usec;
+        CGroupPressureAction pressure_action;
+
         /* For legacy hierarchies */
         uint64_t cpu_shares;
         uint64_t startup_cpu_shares;
@@ -172,6 +193,8 @@ int unit_realize_cgroup(Unit *u);
 void unit_release_cgroup(Unit *u);
 void unit_prune_cgroup(Unit *u);
 int unit_watch_cgroup(Unit *u);
+int unit_watch_pressure(Unit *u);
+void unit_unwatch_pressure(Unit *u);
 
 void unit_add_to_cgroup_empty_queue(Unit *u);
 
@@ -195,6 +218,12 @@ int unit_get_memory_current(Unit *u, uint64_t *ret);
 int unit_get_tasks_current(Unit *u, uint64_t *ret);
 int unit_get_cpu_usage(Unit *u, nsec_t *ret);
 int unit_get_ip_accounting(Unit *u, CGroupIPAccountingMetric metric, uint64_t *ret);
+int unit_get_ip_accounting_all(Unit *u, uint64_t ret[_CGROUP_IP_ACCOUNTING_METRIC_MAX]);
+int unit_get_pressure(Unit *u, CGroupPressureResource resource, CGroupPressure *ret);
+
+int unit_sample_accounting(Unit *u);
+bool unit_has_accounting_sample(Unit *u);
+int manager_set_accounting_sample_interval(Manager *m, usec_t usec);
 
 int unit_reset_cpu_accounting(Unit *u);
 int unit_reset_ip_accounting(Unit *u);
@@ -218,4 +247,7 @@ void manager_invalidate_startup_units(Manager *m);
 const char* cgroup_device_policy_to_string(CGroupDevicePolicy i) _const_;
 CGroupDevicePolicy cgroup_device_policy_from_string(const char *s) _pure_;
 
+const char* cgroup_pressure_action_to_string(CGroupPressureAction a) _const_;
+CGroupPressureAction cgroup_pressure_action_from_string(const char *s) _pure_;
+
 bool unit_cgroup_delegate(Unit *u);
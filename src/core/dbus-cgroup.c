@@ -16,6 +16,7 @@
 #include "path-util.h"
 
 static BUS_DEFINE_PROPERTY_GET_ENUM(property_get_cgroup_device_policy, cgroup_device_policy, CGroupDevicePolicy);
+static BUS_DEFINE_PROPERTY_GET_ENUM(property_get_cgroup_pressure_action, cgroup_pressure_action, CGroupPressureAction);
 
 static int property_get_cgroup_mask(
                 sd_bus *bus,
@@ -70,6 +71,27 @@ static int property_get_delegate_controllers(
         return property_get_cgroup_mask(bus, path, interface, property, reply, &c->delegate_controllers, error);
 }
 
+static int property_get_cpuset(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        CGroupContext *c = userdata;
+
+        assert(bus);
+        assert(reply);
+        assert(c);
+
+        if (streq(property, "AllowedCPUs"))
+                return sd_bus_message_append_array(reply, 'y', c->cpuset_cpus, CPU_ALLOC_SIZE(c->cpuset_cpus_ncpus));
+
+        return sd_bus_message_append_array(reply, 'y', c->cpuset_mems, CPU_ALLOC_SIZE(c->cpuset_mems_nnodes));
+}
+
 static int property_get_io_device_weight(
                 sd_bus *bus,
                 const char *path,
@@ -330,6 +352,8 @@ const sd_bus_vtable bus_cgroup_vtable[] = {
         SD_BUS_PROPERTY("CPUShares", "t", NULL, offsetof(CGroupContext, cpu_shares), 0),
         SD_BUS_PROPERTY("StartupCPUShares", "t", NULL, offsetof(CGroupContext, startup_cpu_shares), 0),
         SD_BUS_PROPERTY("CPUQuotaPerSecUSec", "t", bus_property_get_usec, offsetof(CGroupContext, cpu_quota_per_sec_usec), 0),
+        SD_BUS_PROPERTY("AllowedCPUs", "ay", property_get_cpuset, 0, 0),
+        SD_BUS_PROPERTY("AllowedMemoryNodes", "ay", property_get_cpuset, 0, 0),
         SD_BUS_PROPERTY("IOAccounting", "b", bus_property_get_bool, offsetof(CGroupContext, io_accounting), 0),
         SD_BUS_PROPERTY("IOWeight", "t", NULL, offsetof(CGroupContext, io_weight), 0),
         SD_BUS_PROPERTY("StartupIOWeight", "t", NULL, offsetof(CGroupContext, startup_io_weight), 0),
@@ -360,6 +384,11 @@ const sd_bus_vtable bus_cgroup_vtable[] = {
         SD_BUS_PROPERTY("IPAddressAllow", "a(iayu)", property_get_ip_address_access, offsetof(CGroupContext, ip_address_allow), 0),
         SD_BUS_PROPERTY("IPAddressDeny", "a(iayu)", property_get_ip_address_access, offsetof(CGroupContext, ip_address_deny), 0),
         SD_BUS_PROPERTY("DisableControllers", "as", property_get_cgroup_mask, offsetof(CGroupContext, disable_controllers), 0),
+        SD_BUS_PROPERTY("CPUPressureThresholdUSec", "t", bus_property_get_usec, offsetof(CGroupContext, pressure_threshold_usec[CGROUP_PRESSURE_CPU]), 0),
+        SD_BUS_PROPERTY("IOPressureThresholdUSec", "t", bus_property_get_usec, offsetof(CGroupContext, pressure_threshold_usec[CGROUP_PRESSURE_IO]), 0),
+        SD_BUS_PROPERTY("MemoryPressureThresholdUSec", "t", bus_property_get_usec, offsetof(CGroupContext, pressure_threshold_usec[CGROUP_PRESSURE_MEMORY]), 0),
+        SD_BUS_PROPERTY("PressureWindowUSec", "t", bus_property_get_usec, offsetof(CGroupContext, pressure_window_usec), 0),
+        SD_BUS_PROPERTY("PressureAction", "s", property_get_cgroup_pressure_action, offsetof(CGroupContext, pressure_action), 0),
         SD_BUS_VTABLE_END
 };
 
@@ -727,6 +756,56 @@ int bus_cgroup_set_property(
 
                 return 1;
 
+        } else if (STR_IN_SET(name, "AllowedCPUs", "AllowedMemoryNodes")) {
+                const void *a;
+                size_t n = 0;
+
+                r = sd_bus_message_read_array(message, 'y', &a, &n);
+                if (r < 0)
+                        return r;
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        cpu_set_t **set;
+                        unsigned *ncpus;
+
+                        if (streq(name, "AllowedCPUs")) {
+                                set = &c->cpuset_cpus;
+                                ncpus = &c->cpuset_cpus_ncpus;
+                        } else {
+                                set = &c->cpuset_mems;
+                                ncpus = &c->cpuset_mems_nnodes;
+                        }
+
+                        if (n == 0) {
+                                *set = cpu_set_mfree(*set);
+                                *ncpus = 0;
+                                unit_write_settingf(u, flags, name, "%s=", name);
+                        } else {
+                                _cleanup_cpu_free_ cpu_set_t *t = NULL;
+                                _cleanup_free_ char *str = NULL;
+                                unsigned tn = 0;
+
+                                /* Like the unit file parser, assignments are cumulative */
+                                r = cpu_set_merge_array(set, ncpus, a, n);
+                                if (r < 0)
+                                        return r;
+
+                                r = cpu_set_merge_array(&t, &tn, a, n);
+                                if (r < 0)
+                                        return r;
+
+                                str = cpu_set_to_range_string(t, tn);
+                                if (!str)
+                                        return -ENOMEM;
+
+                                unit_write_settingf(u, flags, name, "%s=%s", name, str);
+                        }
+
+                        unit_invalidate_cgroup(u, CGROUP_MASK_CPUSET);
+                }
+
+                return 1;
+
         } else if ((iol_type = cgroup_io_limit_type_from_string(name)) >= 0) {
                 const char *path;
                 unsigned n = 0;
@@ -1267,6 +1346,77 @@ int bus_cgroup_set_property(
 
                 return 1;
 
+        } else if (STR_IN_SET(name, "CPUPressureThresholdUSec", "IOPressureThresholdUSec", "MemoryPressureThresholdUSec")) {
+                CGroupPressureResource resource;
+                uint64_t u64;
+
+                resource = streq(name, "CPUPressureThresholdUSec") ? CGROUP_PRESSURE_CPU :
+                           streq(name, "IOPressureThresholdUSec") ? CGROUP_PRESSURE_IO : CGROUP_PRESSURE_MEMORY;
+
+                r = sd_bus_message_read(message, "t", &u64);
+                if (r < 0)
+                        return r;
+
+                if (u64 > CGROUP_PRESSURE_WINDOW_MAX_USEC)
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "%s= value out of range", name);
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        char ts[FORMAT_TIMESPAN_MAX];
+                        const char *directive;
+
+                        c->pressure_threshold_usec[resource] = u64;
+                        (void) unit_watch_pressure(u);
+
+                        /* Strip the "USec" suffix, and use "Sec" instead */
+                        directive = strndupa(name, strlen(name) - STRLEN("USec"));
+                        if (u64 <= 0)
+                                unit_write_settingf(u, flags, name, "%sSec=", directive);
+                        else
+                                unit_write_settingf(u, flags, name, "%sSec=%s", directive, format_timespan(ts, sizeof(ts), u64, 1));
+                }
+
+                return 1;
+
+        } else if (streq(name, "PressureWindowUSec")) {
+                uint64_t u64;
+
+                r = sd_bus_message_read(message, "t", &u64);
+                if (r < 0)
+                        return r;
+
+                if (u64 < CGROUP_PRESSURE_WINDOW_MIN_USEC || u64 > CGROUP_PRESSURE_WINDOW_MAX_USEC)
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "PressureWindowUSec= value out of range");
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        char ts[FORMAT_TIMESPAN_MAX];
+
+                        c->pressure_window_usec = u64;
+                        (void) unit_watch_pressure(u);
+
+                        unit_write_settingf(u, flags, name, "PressureWindowSec=%s", format_timespan(ts, sizeof(ts), u64, 1));
+                }
+
+                return 1;
+
+        } else if (streq(name, "PressureAction")) {
+                CGroupPressureAction a;
+                const char *s;
+
+                r = sd_bus_message_read(message, "s", &s);
+                if (r < 0)
+                        return r;
+
+                a = cgroup_pressure_action_from_string(s);
+                if (a < 0)
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Invalid pressure action '%s'", s);
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        c->pressure_action = a;
+                        unit_write_settingf(u, flags, name, "PressureAction=%s", s);
+                }
+
+                return 1;
+
         } else if (streq(name, "IPAccounting")) {
                 int b;
 
@@ -223,6 +223,24 @@ static int property_get_cpu_affinity(
         return sd_bus_message_append_array(reply, 'y', c->cpuset, CPU_ALLOC_SIZE(c->cpuset_ncpus));
 }
 
+static int property_get_numa_mask(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        ExecContext *c = userdata;
+
+        assert(bus);
+        assert(reply);
+        assert(c);
+
+        return sd_bus_message_append_array(reply, 'y', c->numa_policy.nodes, CPU_ALLOC_SIZE(c->numa_policy.n_nodes));
+}
+
 static int property_get_timer_slack_nsec(
                 sd_bus *bus,
                 const char *path,
@@ -698,6 +716,8 @@ const sd_bus_vtable bus_exec_vtable[] = {
         SD_BUS_PROPERTY("CPUSchedulingPolicy", "i", property_get_cpu_sched_policy, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("CPUSchedulingPriority", "i", property_get_cpu_sched_priority, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("CPUAffinity", "ay", property_get_cpu_affinity, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("NUMAPolicy", "i", bus_property_get_int, offsetof(ExecContext, numa_policy.type), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("NUMAMask", "ay", property_get_numa_mask, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("TimerSlackNSec", "t", property_get_timer_slack_nsec, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("CPUSchedulingResetOnFork", "b", bus_property_get_bool, offsetof(ExecContext, cpu_sched_reset_on_fork), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("NonBlocking", "b", bus_property_get_bool, offsetof(ExecContext, non_blocking), SD_BUS_VTABLE_PROPERTY_CONST),
@@ -1358,8 +1378,10 @@ int bus_exec_context_set_transient_property(
 
 #if HAVE_SECCOMP
 
-        if (streq(name, "SystemCallErrorNumber"))
+        if (streq(name, "SystemCallErrorNumber")) {
+                exec_context_invalidate_syscall_filter(c);
                 return bus_set_transient_errno(u, name, &c->syscall_errno, message, flags, error);
+        }
 
         if (streq(name, "SystemCallFilter")) {
                 int whitelist;
@@ -1386,6 +1408,8 @@ int bus_exec_context_set_transient_property(
                         bool invert = !whitelist;
                         char **s;
 
+                        exec_context_invalidate_syscall_filter(c);
+
                         if (strv_isempty(l)) {
                                 c->syscall_whitelist = false;
                                 c->syscall_filter = hashmap_free(c->syscall_filter);
@@ -1605,6 +1629,59 @@ int bus_exec_context_set_transient_property(
 
                 return 1;
 
+        } else if (streq(name, "NUMAPolicy")) {
+                int32_t type;
+
+                r = sd_bus_message_read(message, "i", &type);
+                if (r < 0)
+                        return r;
+
+                if (type != -1 && !mpol_is_valid(type))
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Invalid NUMAPolicy value: %" PRIi32, type);
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        c->numa_policy.type = type;
+                        unit_write_settingf(u, flags, name, "%s=%s", name, strempty(mpol_to_string(type)));
+                }
+
+                return 1;
+
+        } else if (streq(name, "NUMAMask")) {
+                const void *a;
+                size_t n = 0;
+
+                r = sd_bus_message_read_array(message, 'y', &a, &n);
+                if (r < 0)
+                        return r;
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        if (n == 0) {
+                                c->numa_policy.nodes = cpu_set_mfree(c->numa_policy.nodes);
+                                c->numa_policy.n_nodes = 0;
+                                unit_write_settingf(u, flags, name, "%s=", name);
+                        } else {
+                                _cleanup_cpu_free_ cpu_set_t *t = NULL;
+                                _cleanup_free_ char *str = NULL;
+                                unsigned tn = 0;
+
+                                r = cpu_set_merge_array(&c->numa_policy.nodes, &c->numa_policy.n_nodes, a, n);
+                                if (r < 0)
+                                        return r;
+
+                                r = cpu_set_merge_array(&t, &tn, a, n);
+                                if (r < 0)
+                                        return r;
+
+                                str = cpu_set_to_range_string(t, tn);
+                                if (!str)
+                                        return -ENOMEM;
+
+                                unit_write_settingf(u, flags, name, "%s=%s", name, str);
+                        }
+                }
+
+                return 1;
+
         } else if (streq(name, "Nice")) {
                 int32_t q;
 
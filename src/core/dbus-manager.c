@@ -9,6 +9,7 @@
 #include "architecture.h"
 #include "build.h"
 #include "bus-common-errors.h"
+#include "bus-objects.h"
 #include "dbus-execute.h"
 #include "dbus-job.h"
 #include "dbus-manager.h"
@@ -25,6 +26,7 @@
 #include "os-util.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "process-util.h"
 #include "selinux-access.h"
 #include "stat-util.h"
 #include "string-util.h"
@@ -241,6 +243,41 @@ static int property_get_environment(
         return sd_bus_message_append_strv(reply, l);
 }
 
+static int property_get_generator_timings(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+        size_t i;
+        int r;
+
+        assert(bus);
+        assert(reply);
+        assert(m);
+
+        r = sd_bus_message_open_container(reply, 'a', "(stttsi)");
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < m->n_generator_timings; i++) {
+                const ExecTiming *t = m->generator_timings + i;
+
+                r = sd_bus_message_append(reply, "(stttsi)",
+                                          t->path, t->start, t->wall, t->cpu,
+                                          t->timed_out ? "timeout" : sigchld_code_to_string(t->code),
+                                          t->status);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
 static int property_get_show_status(
                 sd_bus *bus,
                 const char *path,
@@ -1135,6 +1172,261 @@ static int method_list_units_by_patterns(sd_bus_message *message, void *userdata
         return list_units_filtered(message, userdata, error, states, patterns);
 }
 
+static int method_list_units_changed_since(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        Manager *m = userdata;
+        uint64_t generation;
+        const char *k;
+        Iterator i;
+        bool full;
+        size_t j;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read(message, "t", &generation);
+        if (r < 0)
+                return r;
+
+        /* If we cannot tell what changed since the specified generation (because it is from before a reload or
+         * reexec, or some removals since were forgotten), return all units, and let the caller know it should
+         * drop all units not included. */
+        full = generation == 0 ||
+                generation > m->unit_generation ||
+                generation < m->units_removed_forgotten;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append(reply, "tb", m->unit_generation, full);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ssssssouso)");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                if (k != u->id)
+                        continue;
+
+                if (!full && u->generation <= generation)
+                        continue;
+
+                r = reply_unit_info(reply, u);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "s");
+        if (r < 0)
+                return r;
+
+        if (!full)
+                for (j = 0; j < m->n_units_removed; j++) {
+                        const RemovedUnit *ru = m->units_removed + j;
+
+                        if (ru->generation <= generation)
+                                continue;
+
+                        /* Loaded again in the meantime? Then it has been included above already. */
+                        u = manager_get_unit(m, ru->id);
+                        if (u && streq(u->id, ru->id))
+                                continue;
+
+                        r = sd_bus_message_append(reply, "s", ru->id);
+                        if (r < 0)
+                                return r;
+                }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int method_get_units_accounting(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **patterns = NULL;
+        Manager *m = userdata;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(stttt)");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH(u, m->cgroup_unit, i) {
+
+                if (!strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE))
+                        continue;
+
+                /* Without a sampler, or before it ran for the first time for this unit, read the data now */
+                if (!unit_has_accounting_sample(u))
+                        (void) unit_sample_accounting(u);
+
+                r = sd_bus_message_append(reply, "(stttt)",
+                                          u->id,
+                                          u->accounting_sample_timestamp,
+                                          u->cpu_usage_sample,
+                                          u->memory_current_sample,
+                                          u->tasks_current_sample);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int reply_units_properties(
+                sd_bus_message *message,
+                Manager *m,
+                char **patterns,
+                char **properties,
+                sd_bus_message **ret,
+                sd_bus_error *error) {
+
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        const char *k;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+        assert(ret);
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "{sa{sv}}");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                _cleanup_free_ char *path = NULL;
+
+                if (k != u->id)
+                        continue;
+
+                if (!strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE))
+                        continue;
+
+                /* Same check as for a GetAll() call on the unit object itself */
+                r = mac_selinux_unit_access_check(u, message, "status", error);
+                if (r < 0)
+                        return r;
+
+                path = unit_dbus_path(u);
+                if (!path)
+                        return -ENOMEM;
+
+                r = sd_bus_message_open_container(reply, 'e', "sa{sv}");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "s", u->id);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_open_container(reply, 'a', "{sv}");
+                if (r < 0)
+                        return r;
+
+                r = bus_object_append_properties(sd_bus_message_get_bus(message), reply, path, properties, error);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(reply);
+        return 0;
+}
+
+static int method_get_units_properties(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **patterns = NULL, **properties = NULL;
+        Manager *m = userdata;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &properties);
+        if (r < 0)
+                return r;
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        /* If the objects registered on the bus changed while we collected the properties, the reply might be
+         * incomplete. Start over then, like the object manager does when emitting its signals. */
+        do {
+                reply = sd_bus_message_unref(reply);
+
+                r = reply_units_properties(message, m, patterns, properties, &reply, error);
+        } while (r == -ESTALE);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_list_jobs(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
@@ -1223,6 +1515,40 @@ static int method_subscribe(sd_bus_message *message, void *userdata, sd_bus_erro
         return sd_bus_reply_method_return(message, NULL);
 }
 
+static int method_subscribe_batched(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        Manager *m = userdata;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        if (sd_bus_message_get_bus(message) == m->api_bus) {
+
+                /* Like Subscribe(), but instead of the per-unit signals the client gets UnitsChanged signals
+                 * covering many units at once. Direct connections always get the per-unit signals. */
+
+                if (!m->subscribed_batched) {
+                        r = sd_bus_track_new(sd_bus_message_get_bus(message), &m->subscribed_batched, NULL, NULL);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = sd_bus_track_add_sender(m->subscribed_batched, message);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return sd_bus_error_setf(error, BUS_ERROR_ALREADY_SUBSCRIBED, "Client is already subscribed.");
+        }
+
+        return sd_bus_reply_method_return(message, NULL);
+}
+
 static int method_unsubscribe(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         Manager *m = userdata;
         int r;
@@ -1237,10 +1563,18 @@ static int method_unsubscribe(sd_bus_message *message, void *userdata, sd_bus_er
                 return r;
 
         if (sd_bus_message_get_bus(message) == m->api_bus) {
+                int k;
+
+                /* A client may have subscribed both ways, drop both */
                 r = sd_bus_track_remove_sender(m->subscribed, message);
                 if (r < 0)
                         return r;
-                if (r == 0)
+
+                k = sd_bus_track_remove_sender(m->subscribed_batched, message);
+                if (k < 0)
+                        return k;
+
+                if (r == 0 && k == 0)
                         return sd_bus_error_setf(error, BUS_ERROR_NOT_SUBSCRIBED, "Client is not subscribed.");
         }
 
@@ -1290,6 +1624,22 @@ static int method_dump_by_fd(sd_bus_message *message, void *userdata, sd_bus_err
         return dump_impl(message, userdata, error, reply_dump_by_fd);
 }
 
+static int method_list_event_sources(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        Manager *m = userdata;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        return bus_reply_event_source_stats(message, m->event);
+}
+
 static int method_refuse_snapshot(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         return sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED, "Support for snapshots has been removed.");
 }
@@ -1328,8 +1678,7 @@ int verify_run_space_and_log(const char *message) {
         return 0;
 }
 
-static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        Manager *m = userdata;
+static int reload_with_objective(sd_bus_message *message, Manager *m, ManagerObjective objective, sd_bus_error *error) {
         int r;
 
         assert(message);
@@ -1359,11 +1708,19 @@ static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *
         if (r < 0)
                 return r;
 
-        m->objective = MANAGER_RELOAD;
+        m->objective = objective;
 
         return 1;
 }
 
+static int method_reload(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        return reload_with_objective(message, userdata, MANAGER_RELOAD, error);
+}
+
+static int method_reload_incremental(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        return reload_with_objective(message, userdata, MANAGER_RELOAD_INCREMENTAL, error);
+}
+
 static int method_reexecute(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         Manager *m = userdata;
         int r;
@@ -2481,6 +2838,8 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_PROPERTY("NFailedJobs", "u", bus_property_get_unsigned, offsetof(Manager, n_failed_jobs), 0),
         SD_BUS_PROPERTY("Progress", "d", property_get_progress, 0, 0),
         SD_BUS_PROPERTY("Environment", "as", property_get_environment, 0, 0),
+        SD_BUS_PROPERTY("GeneratorTimings", "a(stttsi)", property_get_generator_timings, 0, 0),
+        SD_BUS_PROPERTY("GeneratorTimeoutUSec", "t", bus_property_get_usec, offsetof(Manager, generator_timeout_usec), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("ConfirmSpawn", "b", bus_property_get_bool, offsetof(Manager, confirm_spawn), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("ShowStatus", "b", property_get_show_status, 0, 0),
         SD_BUS_PROPERTY("UnitPath", "as", NULL, offsetof(Manager, lookup_paths.search_path), SD_BUS_VTABLE_PROPERTY_CONST),
@@ -2538,6 +2897,8 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_PROPERTY("DefaultLimitRTTIME", "t", bus_property_get_rlimit, offsetof(Manager, rlimit[RLIMIT_RTTIME]), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultLimitRTTIMESoft", "t", bus_property_get_rlimit, offsetof(Manager, rlimit[RLIMIT_RTTIME]), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("DefaultTasksMax", "t", NULL, offsetof(Manager, default_tasks_max), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("DefaultStartConcurrency", "u", bus_property_get_unsigned, offsetof(Manager, default_start_concurrency), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("AccountingSampleIntervalUSec", "t", bus_property_get_usec, offsetof(Manager, accounting_sample_usec), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("TimerSlackNSec", "t", property_get_timer_slack_nsec, 0, SD_BUS_VTABLE_PROPERTY_CONST),
 
         SD_BUS_METHOD("GetUnit", "s", "o", method_get_unit, SD_BUS_VTABLE_UNPRIVILEGED),
@@ -2571,15 +2932,21 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_METHOD("ListUnits", NULL, "a(ssssssouso)", method_list_units, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsFiltered", "as", "a(ssssssouso)", method_list_units_filtered, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsByPatterns", "asas", "a(ssssssouso)", method_list_units_by_patterns, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("GetUnitsProperties", "asas", "a{sa{sv}}", method_get_units_properties, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("GetUnitsAccounting", "as", "a(stttt)", method_get_units_accounting, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsByNames", "as", "a(ssssssouso)", method_list_units_by_names, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitsChangedSince", "t", "tba(ssssssouso)as", method_list_units_changed_since, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListJobs", NULL, "a(usssoo)", method_list_jobs, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Subscribe", NULL, NULL, method_subscribe, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Unsubscribe", NULL, NULL, method_unsubscribe, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("SubscribeBatched", NULL, NULL, method_subscribe_batched, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Dump", NULL, "s", method_dump, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("DumpByFileDescriptor", NULL, "h", method_dump_by_fd, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListEventSources", NULL, "a(ssttttt)", method_list_event_sources, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("CreateSnapshot", "sb", "o", method_refuse_snapshot, SD_BUS_VTABLE_UNPRIVILEGED|SD_BUS_VTABLE_HIDDEN),
         SD_BUS_METHOD("RemoveSnapshot", "s", NULL, method_refuse_snapshot, SD_BUS_VTABLE_UNPRIVILEGED|SD_BUS_VTABLE_HIDDEN),
         SD_BUS_METHOD("Reload", NULL, NULL, method_reload, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ReloadIncremental", NULL, NULL, method_reload_incremental, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Reexecute", NULL, NULL, method_reexecute, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Exit", NULL, NULL, method_exit, 0),
         SD_BUS_METHOD("Reboot", NULL, NULL, method_reboot, SD_BUS_VTABLE_CAPABILITY(CAP_SYS_BOOT)),
@@ -2614,6 +2981,8 @@ const sd_bus_vtable bus_manager_vtable[] = {
 
         SD_BUS_SIGNAL("UnitNew", "so", 0),
         SD_BUS_SIGNAL("UnitRemoved", "so", 0),
+        SD_BUS_SIGNAL("UnitPressureThresholdReached", "sos", 0),
+        SD_BUS_SIGNAL("UnitsChanged", "a(sosss)", 0),
         SD_BUS_SIGNAL("JobNew", "uos", 0),
         SD_BUS_SIGNAL("JobRemoved", "uoss", 0),
         SD_BUS_SIGNAL("StartupFinished", "tttttt", 0),
@@ -2716,3 +3085,64 @@ void bus_manager_send_change_signal(Manager *m) {
         if (r < 0)
                 log_debug_errno(r, "Failed to send manager change signal: %m");
 }
+
+static int send_units_changed(sd_bus *bus, Manager *m) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *message = NULL;
+        Unit *u;
+        int r;
+
+        assert(bus);
+        assert(m);
+
+        r = sd_bus_message_new_signal(bus, &message, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager", "UnitsChanged");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(message, 'a', "(sosss)");
+        if (r < 0)
+                return r;
+
+        LIST_FOREACH(units_changed_queue, u, m->units_changed_queue) {
+                _cleanup_free_ char *p = NULL;
+
+                p = unit_dbus_path(u);
+                if (!p)
+                        return -ENOMEM;
+
+                r = sd_bus_message_append(message, "(sosss)",
+                                          u->id,
+                                          p,
+                                          unit_load_state_to_string(u->load_state),
+                                          unit_active_state_to_string(unit_active_state(u)),
+                                          unit_sub_state_to_string(u));
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(message);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(bus, message, NULL);
+}
+
+void bus_manager_send_units_changed(Manager *m) {
+        Unit *u;
+        int r;
+
+        assert(m);
+
+        /* Sends one signal with the current state of all units we sent change signals for since the last time, to
+         * the clients on the API bus that subscribed with SubscribeBatched(). */
+
+        if (m->api_bus && sd_bus_track_count(m->subscribed_batched) > 0) {
+                r = send_units_changed(m->api_bus, m);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to send units changed signal: %m");
+        }
+
+        while ((u = m->units_changed_queue)) {
+                LIST_REMOVE(units_changed_queue, m->units_changed_queue, u);
+                u->in_units_changed_queue = false;
+        }
+}
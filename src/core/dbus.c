@@ -676,6 +676,12 @@ static int bus_on_connection(sd_event_source *s, int fd, uint32_t revents, void
                 return 0;
         }
 
+        r = sd_bus_negotiate_memfd(bus, true);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to enable memfd payloads for new connection: %m");
+                return 0;
+        }
+
         r = sd_bus_set_sender(bus, "org.freedesktop.systemd1");
         if (r < 0) {
                 log_warning_errno(r, "Failed to set direct connection sender: %m");
@@ -1061,6 +1067,8 @@ static void destroy_bus(Manager *m, sd_bus **bus) {
         /* Get rid of tracked clients on this bus */
         if (m->subscribed && sd_bus_track_get_bus(m->subscribed) == *bus)
                 m->subscribed = sd_bus_track_unref(m->subscribed);
+        if (m->subscribed_batched && sd_bus_track_get_bus(m->subscribed_batched) == *bus)
+                m->subscribed_batched = sd_bus_track_unref(m->subscribed_batched);
 
         HASHMAP_FOREACH(j, m->jobs, i)
                 if (j->bus_track && sd_bus_track_get_bus(j->bus_track) == *bus)
@@ -1114,8 +1122,10 @@ void bus_done(Manager *m) {
         bus_done_private(m);
 
         assert(!m->subscribed);
+        assert(!m->subscribed_batched);
 
         m->deserialized_subscribed = strv_free(m->deserialized_subscribed);
+        m->deserialized_subscribed_batched = strv_free(m->deserialized_subscribed_batched);
         bus_verify_polkit_async_registry_free(m->polkit_registry);
 }
 
@@ -14,12 +14,15 @@
 #include "parse-util.h"
 #include "path-util.h"
 #include "serialize.h"
+#include "siphash24.h"
 #include "stat-util.h"
 #include "string-util.h"
 #include "swap.h"
 #include "unit-name.h"
 #include "unit.h"
 
+#define UDEV_HASH_KEY SD_ID128_MAKE(5a,0d,3c,77,e1,62,4b,b9,8f,41,2e,c5,9a,13,d4,60)
+
 static const UnitActiveState state_translation_table[_DEVICE_STATE_MAX] = {
         [DEVICE_DEAD] = UNIT_INACTIVE,
         [DEVICE_TENTATIVE] = UNIT_ACTIVATING,
@@ -465,13 +468,12 @@ static bool device_is_bound_by_mounts(Device *d, sd_device *dev) {
 
 static void device_upgrade_mount_deps(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
         int r;
 
         /* Let's upgrade Requires= to BindsTo= on us. (Used when SYSTEMD_MOUNT_DEVICE_BOUND is set) */
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REQUIRED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRED_BY, i) {
                 if (other->type != UNIT_MOUNT)
                         continue;
 
@@ -644,6 +646,120 @@ static int device_process_new(Manager *m, sd_device *dev) {
         return 0;
 }
 
+static void hash_string_or_null(const char *s, struct siphash *state) {
+        uint8_t b = !!s;
+
+        /* Include the terminating NUL, so that concatenations can't collide, and a flag so that a missing
+         * property differs from an empty one */
+        siphash24_compress(&b, sizeof(b), state);
+        siphash24_compress(strempty(s), strlen(strempty(s)) + 1, state);
+}
+
+static uint64_t device_udev_hash(sd_device *dev) {
+        static const char * const properties[] = {
+                /* Everything device_process_new() and device_setup_unit() look at */
+                "SYSTEMD_WANTS",
+                "SYSTEMD_USER_WANTS",
+                "SYSTEMD_ALIAS",
+                "SYSTEMD_MOUNT_DEVICE_BOUND",
+                "ID_MODEL_FROM_DATABASE",
+                "ID_MODEL",
+                "ID_FS_LABEL",
+                "ID_PART_ENTRY_NAME",
+                "ID_PART_ENTRY_NUMBER",
+        };
+
+        struct siphash state;
+        const char *v;
+        uint64_t links = 0;
+        dev_t devnum;
+        size_t i;
+
+        assert(dev);
+
+        siphash24_init(&state, UDEV_HASH_KEY.bytes);
+
+        for (i = 0; i < ELEMENTSOF(properties); i++) {
+                if (sd_device_get_property_value(dev, properties[i], &v) < 0)
+                        v = NULL;
+
+                hash_string_or_null(v, &state);
+        }
+
+        if (sd_device_get_devname(dev, &v) < 0)
+                v = NULL;
+        hash_string_or_null(v, &state);
+
+        if (sd_device_get_devnum(dev, &devnum) < 0)
+                devnum = 0;
+        siphash24_compress(&devnum, sizeof(devnum), &state);
+
+        /* The order in which we get the symlinks is not stable, hence combine their hashes */
+        FOREACH_DEVICE_DEVLINK(dev, v)
+                links ^= siphash24(v, strlen(v), UDEV_HASH_KEY.bytes);
+        siphash24_compress(&links, sizeof(links), &state);
+
+        return siphash24_finalize(&state);
+}
+
+static bool device_udev_unchanged(Manager *m, const char *sysfs, uint64_t hash) {
+        Device *l, *d;
+        unsigned n = 0;
+
+        assert(m);
+        assert(sysfs);
+
+        /* Checks whether all units we set up for this device the last time are still around and plugged, and
+         * whether the device's udev data they were derived from is still the same. */
+
+        l = hashmap_get(m->devices_by_sysfs, sysfs);
+        if (!l)
+                return false;
+
+        LIST_FOREACH(same_sysfs, d, l) {
+                if (!d->udev_hash_valid || d->udev_hash != hash)
+                        return false;
+
+                if (d->state != DEVICE_PLUGGED)
+                        return false;
+
+                n++;
+        }
+
+        return n == l->udev_n_units;
+}
+
+static void device_udev_remember(Manager *m, const char *sysfs, uint64_t hash) {
+        Device *l, *d;
+        unsigned n = 0;
+
+        assert(m);
+        assert(sysfs);
+
+        l = hashmap_get(m->devices_by_sysfs, sysfs);
+
+        LIST_FOREACH(same_sysfs, d, l)
+                n++;
+
+        LIST_FOREACH(same_sysfs, d, l) {
+                d->udev_hash = hash;
+                d->udev_n_units = n;
+                d->udev_hash_valid = true;
+        }
+}
+
+static void device_udev_forget(Manager *m, const char *sysfs) {
+        Device *l, *d;
+
+        assert(m);
+        assert(sysfs);
+
+        l = hashmap_get(m->devices_by_sysfs, sysfs);
+
+        LIST_FOREACH(same_sysfs, d, l)
+                d->udev_hash_valid = false;
+}
+
 static void device_found_changed(Device *d, DeviceFound previous, DeviceFound now) {
         assert(d);
 
@@ -890,7 +1006,7 @@ static void device_propagate_reload_by_sysfs(Manager *m, const char *sysfs) {
 static int device_dispatch_io(sd_device_monitor *monitor, sd_device *dev, void *userdata) {
         Manager *m = userdata;
         const char *action, *sysfs;
-        int r;
+        int r, k;
 
         assert(m);
         assert(dev);
@@ -924,18 +1040,36 @@ static int device_dispatch_io(sd_device_monitor *monitor, sd_device *dev, void *
                 device_update_found_by_sysfs(m, sysfs, 0, DEVICE_FOUND_UDEV|DEVICE_FOUND_MOUNT|DEVICE_FOUND_SWAP);
 
         } else if (device_is_ready(dev)) {
+                uint64_t hash;
 
-                (void) device_process_new(m, dev);
+                hash = device_udev_hash(dev);
 
-                r = swap_process_device_new(m, dev);
-                if (r < 0)
-                        log_device_warning_errno(dev, r, "Failed to process swap device new event, ignoring: %m");
+                /* Change events often come in storms, and usually they don't change anything we care about. If the
+                 * device is plugged already and looks exactly the same as the last time we processed it, there's
+                 * nothing to update. */
+                if (streq(action, "change") && device_udev_unchanged(m, sysfs, hash)) {
+                        m->n_device_events_skipped++;
+                        return 0;
+                }
+
+                m->n_device_events_processed++;
+
+                r = device_process_new(m, dev);
+
+                k = swap_process_device_new(m, dev);
+                if (k < 0)
+                        log_device_warning_errno(dev, k, "Failed to process swap device new event, ignoring: %m");
 
                 manager_dispatch_load_queue(m);
 
                 /* The device is found now, set the udev found bit */
                 device_update_found_by_sysfs(m, sysfs, DEVICE_FOUND_UDEV, DEVICE_FOUND_UDEV);
 
+                if (r >= 0 && k >= 0)
+                        device_udev_remember(m, sysfs, hash);
+                else
+                        device_udev_forget(m, sysfs);
+
         } else {
                 /* The device is nominally around, but not ready for
                  * us. Hence unset the udev bit, but leave the rest
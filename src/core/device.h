@@ -33,6 +33,12 @@ struct Device {
 
         /* The SYSTEMD_WANTS udev property for this device the last time we saw it */
         char **wants_property;
+
+        /* Hash of the udev data we derived this unit from the last time we processed the device, and how many units
+         * we ended up with for the device. Used to skip change events that don't change anything for us. */
+        uint64_t udev_hash;
+        unsigned udev_n_units;
+        bool udev_hash_valid;
 };
 
 extern const UnitVTable device_vtable;
@@ -59,6 +59,7 @@
 #include "format-util.h"
 #include "fs-util.h"
 #include "glob-util.h"
+#include "image-mount.h"
 #include "io-util.h"
 #include "ioprio.h"
 #include "label.h"
@@ -1424,8 +1425,53 @@ static bool skip_seccomp_unavailable(const Unit* u, const char* msg) {
         return true;
 }
 
+static void context_get_syscall_filter_actions(const ExecContext *c, uint32_t *ret_default_action, uint32_t *ret_action) {
+        uint32_t negative_action;
+
+        assert(c);
+        assert(ret_default_action);
+        assert(ret_action);
+
+        negative_action = c->syscall_errno == 0 ? SCMP_ACT_KILL : SCMP_ACT_ERRNO(c->syscall_errno);
+
+        if (c->syscall_whitelist) {
+                *ret_default_action = negative_action;
+                *ret_action = SCMP_ACT_ALLOW;
+        } else {
+                *ret_default_action = SCMP_ACT_ALLOW;
+                *ret_action = negative_action;
+        }
+}
+
+static void exec_context_compile_syscall_filter(const Unit *u, ExecContext *c) {
+        uint32_t default_action, action;
+        int r;
+
+        assert(u);
+        assert(c);
+
+        /* Generates the BPF program for SystemCallFilter= once in PID 1, so that the processes we fork off only need
+         * to install it, instead of resolving and compiling the filter again for each of them. On failure we leave
+         * it to the child, which will then report the error properly. */
+
+        if (c->syscall_filter_program)
+                return;
+
+        if (!context_has_syscall_filters(c))
+                return;
+
+        if (!is_seccomp_available())
+                return;
+
+        context_get_syscall_filter_actions(c, &default_action, &action);
+
+        r = seccomp_compile_syscall_filter_set_raw(default_action, c->syscall_filter, action, false, &c->syscall_filter_program);
+        if (r < 0)
+                log_unit_debug_errno(u, r, "Failed to precompile system call filter, ignoring: %m");
+}
+
 static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_ambient_hack) {
-        uint32_t negative_action, default_action, action;
+        uint32_t default_action, action;
         int r;
 
         assert(u);
@@ -1437,15 +1483,11 @@ static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_
         if (skip_seccomp_unavailable(u, "SystemCallFilter="))
                 return 0;
 
-        negative_action = c->syscall_errno == 0 ? SCMP_ACT_KILL : SCMP_ACT_ERRNO(c->syscall_errno);
+        /* The ambient capabilities hack extends the filter, hence the precompiled version doesn't fit then */
+        if (c->syscall_filter_program && !needs_ambient_hack)
+                return seccomp_program_load(c->syscall_filter_program);
 
-        if (c->syscall_whitelist) {
-                default_action = negative_action;
-                action = SCMP_ACT_ALLOW;
-        } else {
-                default_action = SCMP_ACT_ALLOW;
-                action = negative_action;
-        }
+        context_get_syscall_filter_actions(c, &default_action, &action);
 
         if (needs_ambient_hack) {
                 r = seccomp_filter_set_add(c->syscall_filter, c->syscall_whitelist, syscall_filter_sets + SYSCALL_FILTER_SET_SETUID);
@@ -2368,7 +2410,7 @@ static int apply_mount_namespace(
 
         _cleanup_strv_free_ char **empty_directories = NULL;
         char *tmp = NULL, *var = NULL;
-        const char *root_dir = NULL, *root_image = NULL;
+        const char *root_dir = NULL, *root_image = NULL, *root_image_shared_dir = NULL;
         NamespaceInfo ns_info;
         bool needs_sandboxing;
         BindMount *bind_mounts = NULL;
@@ -2395,6 +2437,10 @@ static int apply_mount_namespace(
                         root_dir = context->root_directory;
         }
 
+        /* The runtime might be shared with a unit using a different image, via JoinsNamespaceOf= */
+        if (root_image && runtime && runtime->image_mount && path_equal(runtime->image_mount->image, root_image))
+                root_image_shared_dir = runtime->image_mount->directory;
+
         r = compile_bind_mounts(context, params, &bind_mounts, &n_bind_mounts, &empty_directories);
         if (r < 0)
                 return r;
@@ -2422,7 +2468,7 @@ static int apply_mount_namespace(
         else
                 ns_info = (NamespaceInfo) {};
 
-        r = setup_namespace(root_dir, root_image,
+        r = setup_namespace(root_dir, root_image, root_image_shared_dir,
                             &ns_info, context->read_write_paths,
                             needs_sandboxing ? context->read_only_paths : NULL,
                             needs_sandboxing ? context->inaccessible_paths : NULL,
@@ -2831,6 +2877,7 @@ static int exec_child(
         _cleanup_strv_free_ char **our_env = NULL, **pass_env = NULL, **accum_env = NULL, **final_argv = NULL;
         int *fds_with_exec_fd, n_fds_with_exec_fd, r, ngids = 0, exec_fd = -1;
         _cleanup_free_ gid_t *supplementary_gids = NULL;
+        ExecFdMessage message = {};
         const char *username = NULL, *groupname = NULL;
         _cleanup_free_ char *home_buffer = NULL;
         const char *home = NULL, *shell = NULL;
@@ -2862,6 +2909,8 @@ static int exec_child(
         assert(params);
         assert(exit_status);
 
+        message.timestamps[EXEC_TIMESTAMP_FORK] = now(CLOCK_MONOTONIC);
+
         rename_process_from_path(command->path);
 
         /* We reset exactly these signals, since they are the
@@ -3101,6 +3150,16 @@ static int exec_child(
                         return log_unit_error_errno(unit, errno, "Failed to set up CPU affinity: %m");
                 }
 
+        if (mpol_is_valid(context->numa_policy.type)) {
+                r = apply_numa_policy(&context->numa_policy);
+                if (r == -EOPNOTSUPP)
+                        log_unit_debug_errno(unit, r, "NUMA support not available, ignoring.");
+                else if (r < 0) {
+                        *exit_status = EXIT_NUMA_POLICY;
+                        return log_unit_error_errno(unit, r, "Failed to set NUMA memory policy: %m");
+                }
+        }
+
         if (context->ioprio_set)
                 if (ioprio_set(IOPRIO_WHO_PROCESS, 0, context->ioprio) < 0) {
                         *exit_status = EXIT_IOPRIO;
@@ -3233,6 +3292,8 @@ static int exec_child(
                                 *exit_status = EXIT_PAM;
                                 return log_unit_error_errno(unit, r, "Failed to set up PAM session: %m");
                         }
+
+                        message.timestamps[EXEC_TIMESTAMP_PAM] = now(CLOCK_MONOTONIC);
                 }
         }
 
@@ -3254,6 +3315,8 @@ static int exec_child(
                         *exit_status = EXIT_NAMESPACE;
                         return log_unit_error_errno(unit, r, "Failed to set up mount namespacing: %m");
                 }
+
+                message.timestamps[EXEC_TIMESTAMP_NAMESPACE] = now(CLOCK_MONOTONIC);
         }
 
         /* Drop groups as early as possbile */
@@ -3542,6 +3605,8 @@ static int exec_child(
                         *exit_status = EXIT_SECCOMP;
                         return log_unit_error_errno(unit, r, "Failed to apply system call filters: %m");
                 }
+
+                message.timestamps[EXEC_TIMESTAMP_SECCOMP] = now(CLOCK_MONOTONIC);
 #endif
         }
 
@@ -3576,12 +3641,14 @@ static int exec_child(
         }
 
         if (exec_fd >= 0) {
-                uint8_t hot = 1;
+                /* We have finished with all our initializations. Let's now let the manager know that, together with
+                 * how long the individual steps took. From this point on, if the manager sees POLLHUP on the exec_fd,
+                 * then execve() was successful. */
 
-                /* We have finished with all our initializations. Let's now let the manager know that. From this point
-                 * on, if the manager sees POLLHUP on the exec_fd, then execve() was successful. */
+                message.hot = 1;
+                message.timestamps[EXEC_TIMESTAMP_EXEC] = now(CLOCK_MONOTONIC);
 
-                if (write(exec_fd, &hot, sizeof(hot)) < 0) {
+                if (write(exec_fd, &message, sizeof(message)) < 0) {
                         *exit_status = EXIT_EXEC;
                         return log_unit_error_errno(unit, errno, "Failed to enable exec_fd: %m");
                 }
@@ -3591,12 +3658,12 @@ static int exec_child(
         r = -errno;
 
         if (exec_fd >= 0) {
-                uint8_t hot = 0;
-
                 /* The execve() failed. This means the exec_fd is still open. Which means we need to tell the manager
                  * that POLLHUP on it no longer means execve() succeeded. */
 
-                if (write(exec_fd, &hot, sizeof(hot)) < 0) {
+                message.hot = 0;
+
+                if (write(exec_fd, &message, sizeof(message)) < 0) {
                         *exit_status = EXIT_EXEC;
                         return log_unit_error_errno(unit, errno, "Failed to disable exec_fd: %m");
                 }
@@ -3622,7 +3689,7 @@ static int exec_context_named_iofds(const ExecContext *c, const ExecParameters *
 
 int exec_spawn(Unit *unit,
                ExecCommand *command,
-               const ExecContext *context,
+               ExecContext *context,
                const ExecParameters *params,
                ExecRuntime *runtime,
                DynamicCreds *dcreds,
@@ -3633,6 +3700,7 @@ int exec_spawn(Unit *unit,
         _cleanup_strv_free_ char **files_env = NULL;
         size_t n_storage_fds = 0, n_socket_fds = 0;
         _cleanup_free_ char *line = NULL;
+        usec_t fork_begin, fork_usec;
         pid_t pid;
 
         assert(unit);
@@ -3693,6 +3761,12 @@ int exec_spawn(Unit *unit,
                 }
         }
 
+#if HAVE_SECCOMP
+        exec_context_compile_syscall_filter(unit, context);
+#endif
+
+        fork_begin = now(CLOCK_MONOTONIC);
+
         pid = fork();
         if (pid < 0)
                 return log_unit_error_errno(unit, errno, "Failed to fork: %m");
@@ -3728,6 +3802,11 @@ int exec_spawn(Unit *unit,
                 _exit(exit_status);
         }
 
+        fork_usec = usec_sub_unsigned(now(CLOCK_MONOTONIC), fork_begin);
+        unit->manager->n_spawned++;
+        unit->manager->spawn_fork_usec += fork_usec;
+        unit->manager->spawn_fork_max_usec = MAX(unit->manager->spawn_fork_max_usec, fork_usec);
+
         log_unit_debug(unit, "Forked %s as "PID_FMT, command->path, pid);
 
         /* We add the new process to the cgroup both in the child (so that we can be sure that no user code is ever
@@ -3750,6 +3829,7 @@ void exec_context_init(ExecContext *c) {
         c->umask = 0022;
         c->ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 0);
         c->cpu_sched_policy = SCHED_OTHER;
+        c->numa_policy.type = -1;
         c->syslog_priority = LOG_DAEMON|LOG_INFO;
         c->syslog_level_prefix = true;
         c->ignore_sigpipe = true;
@@ -3805,6 +3885,7 @@ void exec_context_done(ExecContext *c) {
         c->n_temporary_filesystems = 0;
 
         c->cpuset = cpu_set_mfree(c->cpuset);
+        numa_policy_reset(&c->numa_policy);
 
         c->utmp_id = mfree(c->utmp_id);
         c->selinux_context = mfree(c->selinux_context);
@@ -3812,6 +3893,7 @@ void exec_context_done(ExecContext *c) {
         c->smack_process_label = mfree(c->smack_process_label);
 
         c->syscall_filter = hashmap_free(c->syscall_filter);
+        exec_context_invalidate_syscall_filter(c);
         c->syscall_archs = set_free(c->syscall_archs);
         c->address_families = set_free(c->address_families);
 
@@ -3829,6 +3911,17 @@ void exec_context_done(ExecContext *c) {
         c->stdin_data_size = 0;
 }
 
+void exec_context_invalidate_syscall_filter(ExecContext *c) {
+        assert(c);
+
+        /* Drops the precompiled SystemCallFilter= program, call this whenever any of the settings it is built from
+         * changes */
+
+#if HAVE_SECCOMP
+        c->syscall_filter_program = seccomp_program_free(c->syscall_filter_program);
+#endif
+}
+
 int exec_context_destroy_runtime_directory(const ExecContext *c, const char *runtime_prefix) {
         char **i;
 
@@ -4232,6 +4325,14 @@ void exec_context_dump(const ExecContext *c, FILE* f, const char *prefix) {
                 fputs("\n", f);
         }
 
+        if (mpol_is_valid(c->numa_policy.type)) {
+                _cleanup_free_ char *nodes = NULL;
+
+                nodes = cpu_set_to_range_string(c->numa_policy.nodes, c->numa_policy.n_nodes);
+                fprintf(f, "%sNUMAPolicy: %s\n", prefix, mpol_to_string(c->numa_policy.type));
+                fprintf(f, "%sNUMAMask: %s\n", prefix, strnull(nodes));
+        }
+
         if (c->timer_slack_nsec != NSEC_INFINITY)
                 fprintf(f, "%sTimerSlackNSec: "NSEC_FMT "\n", prefix, c->timer_slack_nsec);
 
@@ -4798,6 +4899,9 @@ static ExecRuntime* exec_runtime_free(ExecRuntime *rt, bool destroy) {
                 rt->var_tmp_dir = NULL;
         }
 
+        /* When destroy is true and we are the last user, then also unmount the shared root image. */
+        rt->image_mount = image_mount_unref(rt->image_mount, destroy);
+
         rt->id = mfree(rt->id);
         rt->tmp_dir = mfree(rt->tmp_dir);
         rt->var_tmp_dir = mfree(rt->var_tmp_dir);
@@ -4827,6 +4931,7 @@ static int exec_runtime_add(
                 const char *tmp_dir,
                 const char *var_tmp_dir,
                 const int netns_storage_socket[2],
+                const char *root_image,
                 ExecRuntime **ret) {
 
         _cleanup_(exec_runtime_freep) ExecRuntime *rt = NULL;
@@ -4864,6 +4969,12 @@ static int exec_runtime_add(
                 rt->netns_storage_socket[1] = netns_storage_socket[1];
         }
 
+        if (root_image) {
+                r = image_mount_acquire(m, root_image, &rt->image_mount);
+                if (r < 0)
+                        return r;
+        }
+
         r = hashmap_put(m->exec_runtime_by_id, rt->id, rt);
         if (r < 0)
                 return r;
@@ -4881,14 +4992,20 @@ static int exec_runtime_add(
 static int exec_runtime_make(Manager *m, const ExecContext *c, const char *id, ExecRuntime **ret) {
         _cleanup_free_ char *tmp_dir = NULL, *var_tmp_dir = NULL;
         _cleanup_close_pair_ int netns_storage_socket[2] = {-1, -1};
+        const char *root_image = NULL;
         int r;
 
         assert(m);
         assert(c);
         assert(id);
 
+        /* Only the system manager can set up loop devices, the user manager's services do so on their own, if
+         * they can at all. */
+        if (c->root_image && MANAGER_IS_SYSTEM(m))
+                root_image = c->root_image;
+
         /* It is not necessary to create ExecRuntime object. */
-        if (!c->private_network && !c->private_tmp)
+        if (!c->private_network && !c->private_tmp && !root_image)
                 return 0;
 
         if (c->private_tmp) {
@@ -4902,7 +5019,7 @@ static int exec_runtime_make(Manager *m, const ExecContext *c, const char *id, E
                         return -errno;
         }
 
-        r = exec_runtime_add(m, id, tmp_dir, var_tmp_dir, netns_storage_socket, ret);
+        r = exec_runtime_add(m, id, tmp_dir, var_tmp_dir, netns_storage_socket, root_image, ret);
         if (r < 0)
                 return r;
 
@@ -4954,6 +5071,14 @@ ExecRuntime *exec_runtime_unref(ExecRuntime *rt, bool destroy) {
         return exec_runtime_free(rt, destroy);
 }
 
+bool exec_runtime_has_namespaces(const ExecRuntime *rt) {
+        assert(rt);
+
+        /* Whether there's anything for JoinsNamespaceOf= to share. The shared root image only concerns the units
+         * using that image, hence a runtime carrying nothing else must not be adopted by others. */
+        return rt->tmp_dir || rt->var_tmp_dir || rt->netns_storage_socket[0] >= 0;
+}
+
 int exec_runtime_serialize(const Manager *m, FILE *f, FDSet *fds) {
         ExecRuntime *rt;
         Iterator i;
@@ -4991,6 +5116,10 @@ int exec_runtime_serialize(const Manager *m, FILE *f, FDSet *fds) {
                         fprintf(f, " netns-socket-1=%i", copy);
                 }
 
+                /* Last, as the path may contain spaces */
+                if (rt->image_mount)
+                        fprintf(f, " root-image=%s", rt->image_mount->image);
+
                 fputc('\n', f);
         }
 
@@ -5011,6 +5140,11 @@ int exec_runtime_deserialize_compat(Unit *u, const char *key, const char *value,
         assert(key);
         assert(value);
 
+        /* This is called for every unit-type specific key we deserialize, hence don't bother allocating anything
+         * before we know the key is one of ours. */
+        if (!STR_IN_SET(key, "tmp-dir", "var-tmp-dir", "netns-socket-0", "netns-socket-1"))
+                return 0;
+
         /* Manager manages ExecRuntime objects by the unit id.
          * So, we omit the serialized text when the unit does not have id (yet?)... */
         if (isempty(u->id)) {
@@ -5098,6 +5232,7 @@ int exec_runtime_deserialize_compat(Unit *u, const char *key, const char *value,
 
 void exec_runtime_deserialize_one(Manager *m, const char *value, FDSet *fds) {
         char *id = NULL, *tmp_dir = NULL, *var_tmp_dir = NULL;
+        const char *root_image = NULL;
         int r, fd0 = -1, fd1 = -1;
         const char *p, *v = value;
         size_t n;
@@ -5157,11 +5292,19 @@ void exec_runtime_deserialize_one(Manager *m, const char *value, FDSet *fds) {
                         return;
                 }
                 fd1 = fdset_remove(fds, fd1);
+                if (v[n] != ' ')
+                        goto finalize;
+                p = v + n + 1;
         }
 
+        /* Takes the rest of the line */
+        v = startswith(p, "root-image=");
+        if (v && !isempty(v))
+                root_image = v;
+
 finalize:
 
-        r = exec_runtime_add(m, id, tmp_dir, var_tmp_dir, (int[]) { fd0, fd1 }, NULL);
+        r = exec_runtime_add(m, id, tmp_dir, var_tmp_dir, (int[]) { fd0, fd1 }, root_image, NULL);
         if (r < 0)
                 log_debug_errno(r, "Failed to add exec-runtime: %m");
 }
@@ -5263,3 +5406,14 @@ static const char* const exec_keyring_mode_table[_EXEC_KEYRING_MODE_MAX] = {
 };
 
 DEFINE_STRING_TABLE_LOOKUP(exec_keyring_mode, ExecKeyringMode);
+
+static const char* const exec_timestamp_table[_EXEC_TIMESTAMP_MAX] = {
+        [EXEC_TIMESTAMP_SPAWN]     = "spawn",
+        [EXEC_TIMESTAMP_FORK]      = "fork",
+        [EXEC_TIMESTAMP_PAM]       = "pam",
+        [EXEC_TIMESTAMP_NAMESPACE] = "namespace",
+        [EXEC_TIMESTAMP_SECCOMP]   = "seccomp",
+        [EXEC_TIMESTAMP_EXEC]      = "exec",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(exec_timestamp, ExecTimestamp);
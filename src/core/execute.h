@@ -6,6 +6,7 @@ typedef struct ExecCommand ExecCommand;
 typedef struct ExecContext ExecContext;
 typedef struct ExecRuntime ExecRuntime;
 typedef struct ExecParameters ExecParameters;
+typedef struct ImageMount ImageMount;
 typedef struct Manager Manager;
 
 #include <sched.h>
@@ -19,6 +20,7 @@ typedef struct Manager Manager;
 #include "missing_resource.h"
 #include "namespace.h"
 #include "nsflags.h"
+#include "numa-util.h"
 
 #define EXEC_STDIN_DATA_MAX (64U*1024U*1024U)
 
@@ -86,6 +88,26 @@ struct ExecStatus {
         int status;   /* as in sigingo_t::si_status */
 };
 
+/* Points in time while a process is being started, so that start-up latency can be attributed to its steps. All
+ * but the first are taken in the child and reported back through the exec_fd. */
+typedef enum ExecTimestamp {
+        EXEC_TIMESTAMP_SPAWN,     /* The manager started preparing the process */
+        EXEC_TIMESTAMP_FORK,      /* The child process started running */
+        EXEC_TIMESTAMP_PAM,       /* The PAM session was opened */
+        EXEC_TIMESTAMP_NAMESPACE, /* The mount namespace was set up */
+        EXEC_TIMESTAMP_SECCOMP,   /* The seccomp filters were installed */
+        EXEC_TIMESTAMP_EXEC,      /* The child is about to call execve() */
+        _EXEC_TIMESTAMP_MAX,
+        _EXEC_TIMESTAMP_INVALID = -1
+} ExecTimestamp;
+
+/* What the child writes to the exec_fd right before execve(), and once more with hot == 0 if execve() failed. This
+ * is small enough to be written atomically to a pipe. Timestamps of steps that were not taken are 0. */
+typedef struct ExecFdMessage {
+        uint8_t hot;
+        usec_t timestamps[_EXEC_TIMESTAMP_MAX];
+} ExecFdMessage;
+
 typedef enum ExecCommandFlags {
         EXEC_COMMAND_IGNORE_FAILURE   = 1 << 0,
         EXEC_COMMAND_FULLY_PRIVILEGED = 1 << 1,
@@ -119,6 +141,9 @@ struct ExecRuntime {
         /* An AF_UNIX socket pair, that contains a datagram containing a file descriptor referring to the network
          * namespace. */
         int netns_storage_socket[2];
+
+        /* The RootImage= of the owner, mounted once for all units using it */
+        ImageMount *image_mount;
 };
 
 typedef enum ExecDirectoryType {
@@ -160,6 +185,8 @@ struct ExecContext {
         cpu_set_t *cpuset;
         unsigned cpuset_ncpus;
 
+        NUMAPolicy numa_policy;
+
         ExecInput std_input;
         ExecOutput std_output;
         ExecOutput std_error;
@@ -263,6 +290,7 @@ struct ExecContext {
         Set *syscall_archs;
         int syscall_errno;
         bool syscall_whitelist:1;
+        struct SeccompProgram *syscall_filter_program; /* SystemCallFilter= compiled to BPF, generated on first use */
 
         Set *address_families;
         bool address_families_whitelist:1;
@@ -339,7 +367,7 @@ struct ExecParameters {
 
 int exec_spawn(Unit *unit,
                ExecCommand *command,
-               const ExecContext *context,
+               ExecContext *context,
                const ExecParameters *exec_params,
                ExecRuntime *runtime,
                DynamicCreds *dynamic_creds,
@@ -357,6 +385,7 @@ int exec_command_append(ExecCommand *c, const char *path, ...) _sentinel_;
 
 void exec_context_init(ExecContext *c);
 void exec_context_done(ExecContext *c);
+void exec_context_invalidate_syscall_filter(ExecContext *c);
 void exec_context_dump(const ExecContext *c, FILE* f, const char *prefix);
 
 int exec_context_destroy_runtime_directory(const ExecContext *c, const char *runtime_root);
@@ -377,6 +406,7 @@ void exec_status_reset(ExecStatus *s);
 
 int exec_runtime_acquire(Manager *m, const ExecContext *c, const char *name, bool create, ExecRuntime **ret);
 ExecRuntime *exec_runtime_unref(ExecRuntime *r, bool destroy);
+bool exec_runtime_has_namespaces(const ExecRuntime *rt);
 
 int exec_runtime_serialize(const Manager *m, FILE *f, FDSet *fds);
 int exec_runtime_deserialize_compat(Unit *u, const char *key, const char *value, FDSet *fds);
@@ -400,5 +430,8 @@ ExecPreserveMode exec_preserve_mode_from_string(const char *s) _pure_;
 const char* exec_keyring_mode_to_string(ExecKeyringMode i) _const_;
 ExecKeyringMode exec_keyring_mode_from_string(const char *s) _pure_;
 
+const char* exec_timestamp_to_string(ExecTimestamp i) _const_;
+ExecTimestamp exec_timestamp_from_string(const char *s) _pure_;
+
 const char* exec_directory_type_to_string(ExecDirectoryType i) _const_;
 ExecDirectoryType exec_directory_type_from_string(const char *s) _pure_;
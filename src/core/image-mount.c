@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/mount.h>
+
+#include "sd-id128.h"
+
+#include "alloc-util.h"
+#include "image-mount.h"
+#include "mount-util.h"
+#include "rm-rf.h"
+#include "siphash24.h"
+
+/* Picks the directory names below /run/systemd/image-mounts/, so that they are stable across daemon reloads */
+#define IMAGE_MOUNT_HASH_KEY SD_ID128_MAKE(5a,44,ef,0e,13,59,4c,5f,9a,b2,81,a0,3c,7d,d2,16)
+
+static ImageMount* image_mount_free(ImageMount *i) {
+        if (!i)
+                return NULL;
+
+        if (i->manager)
+                (void) hashmap_remove(i->manager->image_mounts, i->image);
+
+        free(i->image);
+        free(i->directory);
+        return mfree(i);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ImageMount*, image_mount_free);
+
+int image_mount_acquire(Manager *m, const char *image, ImageMount **ret) {
+        _cleanup_(image_mount_freep) ImageMount *i = NULL;
+        ImageMount *existing;
+        int r;
+
+        assert(m);
+        assert(image);
+        assert(ret);
+
+        existing = hashmap_get(m->image_mounts, image);
+        if (existing) {
+                existing->n_ref++;
+                *ret = existing;
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&m->image_mounts, &path_hash_ops);
+        if (r < 0)
+                return r;
+
+        i = new0(ImageMount, 1);
+        if (!i)
+                return -ENOMEM;
+
+        i->image = strdup(image);
+        if (!i->image)
+                return -ENOMEM;
+
+        if (asprintf(&i->directory, "/run/systemd/image-mounts/%016" PRIx64,
+                     siphash24(image, strlen(image), IMAGE_MOUNT_HASH_KEY.bytes)) < 0)
+                return -ENOMEM;
+
+        r = hashmap_put(m->image_mounts, i->image, i);
+        if (r < 0)
+                return r;
+
+        i->manager = m;
+        i->n_ref = 1;
+
+        *ret = TAKE_PTR(i);
+        return 1;
+}
+
+ImageMount *image_mount_unref(ImageMount *i, bool destroy) {
+        int r;
+
+        if (!i)
+                return NULL;
+
+        assert(i->n_ref > 0);
+
+        i->n_ref--;
+        if (i->n_ref > 0)
+                return NULL;
+
+        /* When destroy is true, detach the mounts. The loop and device mapper devices were set up for automatic
+         * removal, and go away once the last service's mount namespace is gone too. */
+        if (destroy) {
+                log_debug("Unmounting shared image %s from %s.", i->image, i->directory);
+
+                r = umount_recursive(i->directory, MNT_DETACH);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to unmount %s, ignoring: %m", i->directory);
+
+                (void) rm_rf(i->directory, REMOVE_ROOT|REMOVE_ONLY_DIRECTORIES);
+        }
+
+        return image_mount_free(i);
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct ImageMount ImageMount;
+
+#include "manager.h"
+
+/* A RootImage= image shared by all units using it. The first of their processes to start sets up the loop and
+ * device mapper devices and mounts the image below the directory, in the host's mount namespace. All later ones
+ * only bind mount it from there into their own namespace. The image is unmounted again when the last unit using it
+ * is gone. */
+struct ImageMount {
+        unsigned n_ref;
+        Manager *manager;
+
+        char *image;
+        char *directory;
+};
+
+int image_mount_acquire(Manager *m, const char *image, ImageMount **ret);
+ImageMount *image_mount_unref(ImageMount *i, bool destroy);
@@ -86,6 +86,11 @@ void job_unlink(Job *j) {
                 j->in_gc_queue = false;
         }
 
+        if (j->in_start_queue) {
+                prioq_remove(j->manager->start_queue, j, &j->start_queue_idx);
+                j->in_start_queue = false;
+        }
+
         j->timer_event_source = sd_event_source_unref(j->timer_event_source);
 }
 
@@ -128,6 +133,17 @@ static void job_set_state(Job *j, JobState state) {
 
                 if (j->unit->manager->n_running_jobs <= 0)
                         j->unit->manager->jobs_in_progress_event_source = sd_event_source_unref(j->unit->manager->jobs_in_progress_event_source);
+
+                if (j->start_slot) {
+                        assert(j->manager->n_starting_jobs > 0);
+
+                        j->manager->n_starting_jobs--;
+                        j->start_slot = false;
+
+                        /* Let the next job waiting for a slot have a go */
+                        if (!prioq_isempty(j->manager->start_queue))
+                                (void) sd_event_source_set_enabled(j->manager->run_queue_event_source, SD_EVENT_ONESHOT);
+                }
         }
 }
 
@@ -149,6 +165,8 @@ void job_uninstall(Job *j) {
 
         *pj = NULL;
 
+        /* The Job property of the unit has changed now */
+        unit_bump_generation(j->unit);
         unit_add_to_gc_queue(j->unit);
 
         hashmap_remove_value(j->manager->jobs, UINT32_TO_PTR(j->id), j);
@@ -229,6 +247,11 @@ Job* job_install(Job *j) {
         *pj = j;
         j->installed = true;
 
+        if (j->type != JOB_NOP) {
+                dual_timestamp_get(&j->unit->job_install_timestamp);
+                j->unit->job_run_timestamp = DUAL_TIMESTAMP_NULL;
+        }
+
         j->manager->n_installed_jobs++;
         log_unit_debug(j->unit,
                        "Installed new job %s/%s as %u",
@@ -449,9 +472,8 @@ int job_type_merge_and_collapse(JobType *a, JobType b, Unit *u) {
 }
 
 static bool job_is_runnable(Job *j) {
-        Iterator i;
+        UnitDependencyIterator i;
         Unit *other;
-        void *v;
 
         assert(j);
         assert(j->installed);
@@ -479,7 +501,7 @@ static bool job_is_runnable(Job *j) {
                  * dependencies, regardless whether they are
                  * starting or stopping something. */
 
-                HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i)
+                UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER, i)
                         if (other->job)
                                 return false;
         }
@@ -487,7 +509,7 @@ static bool job_is_runnable(Job *j) {
         /* Also, if something else is being stopped and we should
          * change state after it, then let's wait. */
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE, i)
                 if (other->job &&
                     IN_SET(other->job->type, JOB_STOP, JOB_RESTART))
                         return false;
@@ -657,6 +679,93 @@ static int job_perform_on_unit(Job **j) {
         return r;
 }
 
+static int job_compare_start_priority(const void *a, const void *b) {
+        const Job *x = a, *y = b;
+        int r;
+
+        /* Jobs of units many other units are ordered after go first, they are likely on the critical chain. The
+         * rest goes in the order the jobs were created in. */
+        r = CMP(y->start_priority, x->start_priority);
+        if (r != 0)
+                return r;
+
+        return CMP(x->id, y->id);
+}
+
+bool job_needs_start_slot(Job *j) {
+        UnitDependencyIterator i;
+        Unit *other;
+
+        assert(j);
+
+        /* Only service start jobs are throttled, as that's where the actual work is done. Other units usually
+         * become active right-away or wait for something external, such as devices, and shouldn't block a slot
+         * that long. */
+        if (j->manager->default_start_concurrency == 0 ||
+            j->type != JOB_START ||
+            j->unit->type != UNIT_SERVICE)
+                return false;
+
+        /* Services activated by sockets, paths and the like are started because somebody is waiting for them,
+         * possibly one of the units holding a slot. */
+        if (unit_first_dependency(j->unit, UNIT_TRIGGERED_BY))
+                return false;
+
+        /* The same goes for units ordered after this one which are starting up already, as this job was only
+         * enqueued afterwards. They might not get anywhere before this one is done. */
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE, i)
+                if (other->job && other->job->start_slot)
+                        return false;
+
+        return true;
+}
+
+static bool job_acquire_start_slot(Job *j) {
+        bool throttle;
+        Manager *m;
+        int r;
+
+        assert(j);
+
+        m = j->manager;
+
+        throttle = job_needs_start_slot(j);
+
+        if (throttle && m->n_starting_jobs >= m->default_start_concurrency) {
+
+                if (j->in_start_queue)
+                        return false;
+
+                j->start_priority = unit_dependency_count(j->unit, UNIT_BEFORE);
+
+                r = prioq_ensure_allocated(&m->start_queue, job_compare_start_priority);
+                if (r >= 0)
+                        r = prioq_put(m->start_queue, j, &j->start_queue_idx);
+                if (r >= 0) {
+                        log_unit_debug(j->unit, "Too many units starting up already, delaying job %s/%s.",
+                                       j->unit->id, job_type_to_string(j->type));
+
+                        j->in_start_queue = true;
+                        return false;
+                }
+
+                /* Rather start the unit right-away than never */
+                log_oom();
+        }
+
+        if (j->in_start_queue) {
+                prioq_remove(m->start_queue, j, &j->start_queue_idx);
+                j->in_start_queue = false;
+        }
+
+        if (throttle) {
+                m->n_starting_jobs++;
+                j->start_slot = true;
+        }
+
+        return true;
+}
+
 int job_run_and_invalidate(Job *j) {
         int r;
 
@@ -674,10 +783,16 @@ int job_run_and_invalidate(Job *j) {
         if (!job_is_runnable(j))
                 return -EAGAIN;
 
+        if (!job_acquire_start_slot(j))
+                return -EAGAIN;
+
         job_start_timer(j, true);
         job_set_state(j, JOB_RUNNING);
         job_add_to_dbus_queue(j);
 
+        if (j->type != JOB_NOP)
+                dual_timestamp_get(&j->unit->job_run_timestamp);
+
         switch (j->type) {
 
                 case JOB_VERIFY_ACTIVE: {
@@ -956,12 +1071,11 @@ static void job_emit_done_status_message(Unit *u, uint32_t job_id, JobType t, Jo
 
 static void job_fail_dependencies(Unit *u, UnitDependency d) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         assert(u);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[d], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, d, i) {
                 Job *j = other->job;
 
                 if (!j)
@@ -977,8 +1091,7 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
         Unit *u;
         Unit *other;
         JobType t;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         assert(j);
         assert(j->installed);
@@ -1045,12 +1158,12 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
 
 finish:
         /* Try to start the next jobs that can be started */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_AFTER], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_AFTER, i)
                 if (other->job) {
                         job_add_to_run_queue(other->job);
                         job_add_to_gc_queue(other->job);
                 }
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BEFORE, i)
                 if (other->job) {
                         job_add_to_run_queue(other->job);
                         job_add_to_gc_queue(other->job);
@@ -1397,8 +1510,7 @@ int job_get_timeout(Job *j, usec_t *timeout) {
 
 bool job_may_gc(Job *j) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         assert(j);
 
@@ -1428,7 +1540,7 @@ bool job_may_gc(Job *j) {
 
         /* If a job is ordered after ours, and is to be started, then it needs to wait for us, regardless if we stop or
          * start, hence let's not GC in that case. */
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE, i) {
                 if (!other->job)
                         continue;
 
@@ -1441,7 +1553,7 @@ bool job_may_gc(Job *j) {
 
         /* If we are going down, but something else is ordered After= us, then it needs to wait for us */
         if (IN_SET(j->type, JOB_STOP, JOB_RESTART))
-                HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i) {
+                UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER, i) {
                         if (!other->job)
                                 continue;
 
@@ -1510,8 +1622,7 @@ int job_get_before(Job *j, Job*** ret) {
         _cleanup_free_ Job** list = NULL;
         size_t n = 0, n_allocated = 0;
         Unit *other = NULL;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         /* Returns a list of all pending jobs that need to finish before this job may be started. */
 
@@ -1525,7 +1636,7 @@ int job_get_before(Job *j, Job*** ret) {
 
         if (IN_SET(j->type, JOB_START, JOB_VERIFY_ACTIVE, JOB_RELOAD)) {
 
-                HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i) {
+                UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER, i) {
                         if (!other->job)
                                 continue;
 
@@ -1535,7 +1646,7 @@ int job_get_before(Job *j, Job*** ret) {
                 }
         }
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE, i) {
                 if (!other->job)
                         continue;
 
@@ -1558,15 +1669,14 @@ int job_get_after(Job *j, Job*** ret) {
         _cleanup_free_ Job** list = NULL;
         size_t n = 0, n_allocated = 0;
         Unit *other = NULL;
-        void *v;
-        Iterator i;
+        UnitDependencyIterator i;
 
         assert(j);
         assert(ret);
 
         /* Returns a list of all pending jobs that are waiting for this job to finish. */
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE, i) {
                 if (!other->job)
                         continue;
 
@@ -1583,7 +1693,7 @@ int job_get_after(Job *j, Job*** ret) {
 
         if (IN_SET(j->type, JOB_STOP, JOB_RESTART)) {
 
-                HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i) {
+                UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER, i) {
                         if (!other->job)
                                 continue;
 
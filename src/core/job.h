@@ -119,6 +119,10 @@ struct Job {
         LIST_FIELDS(Job, dbus_queue);
         LIST_FIELDS(Job, gc_queue);
 
+        /* For the manager's start_queue */
+        unsigned start_queue_idx;
+        unsigned start_priority;
+
         LIST_HEAD(JobDependency, subject_list);
         LIST_HEAD(JobDependency, object_list);
 
@@ -156,6 +160,8 @@ struct Job {
         bool irreversible:1;
         bool in_gc_queue:1;
         bool ref_by_private_bus:1;
+        bool in_start_queue:1;
+        bool start_slot:1; /* counted in n_starting_jobs */
 };
 
 Job* job_new(Unit *unit, JobType type);
@@ -207,6 +213,7 @@ void job_add_to_dbus_queue(Job *j);
 
 int job_start_timer(Job *j, bool job_running);
 
+bool job_needs_start_slot(Job *j);
 int job_run_and_invalidate(Job *j);
 int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool already);
 
@@ -2,6 +2,7 @@
 
 #include "conf-parser.h"
 #include "fs-util.h"
+#include "intern.h"
 #include "load-dropin.h"
 #include "load-fragment.h"
 #include "log.h"
@@ -44,6 +45,11 @@ static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suff
         if (r < 0)
                 return r;
 
+        /* Remember what we found, so that we can tell later on whether the directories changed */
+        r = strv_extend_strv(&u->dependency_dropin_paths, paths, false);
+        if (r < 0)
+                return log_oom();
+
         STRV_FOREACH(p, paths) {
                 _cleanup_free_ char *target = NULL;
                 const char *entry;
@@ -101,6 +107,34 @@ static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suff
         return 0;
 }
 
+int unit_find_dependency_dropin_paths(Unit *u, char ***ret) {
+        _cleanup_strv_free_ char **paths = NULL, **requires = NULL;
+        int r;
+
+        assert(u);
+        assert(ret);
+
+        /* Returns the symlinks in the .wants/ and .requires/ directories of the unit, in the same order as
+         * unit_load_dropin() processes them. */
+
+        r = unit_file_find_dropin_paths(NULL, u->manager->lookup_paths.search_path, u->manager->unit_path_cache,
+                                        ".wants", NULL, u->names, &paths);
+        if (r < 0)
+                return r;
+
+        r = unit_file_find_dropin_paths(NULL, u->manager->lookup_paths.search_path, u->manager->unit_path_cache,
+                                        ".requires", NULL, u->names, &requires);
+        if (r < 0)
+                return r;
+
+        r = strv_extend_strv(&paths, requires, false);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(paths);
+        return 0;
+}
+
 int unit_load_dropin(Unit *u) {
         _cleanup_strv_free_ char **l = NULL;
         char **f;
@@ -122,10 +156,10 @@ int unit_load_dropin(Unit *u) {
         if (r <= 0)
                 return 0;
 
-        if (!u->dropin_paths)
-                u->dropin_paths = TAKE_PTR(l);
-        else {
-                r = strv_extend_strv(&u->dropin_paths, l, true);
+        /* Top-level drop-ins such as service.d/ apply to many units, intern the paths so that they are stored
+         * only once */
+        STRV_FOREACH(f, l) {
+                r = intern_strv_extend(&u->dropin_paths, *f);
                 if (r < 0)
                         return log_oom();
         }
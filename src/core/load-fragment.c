@@ -30,6 +30,7 @@
 #include "errno-list.h"
 #include "escape.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "hexdecoct.h"
 #include "io-util.h"
@@ -72,6 +73,7 @@ DEFINE_CONFIG_PARSE(config_parse_socket_protocol, parse_socket_protocol, "Failed
 DEFINE_CONFIG_PARSE(config_parse_exec_secure_bits, secure_bits_from_string, "Failed to parse secure bits");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_collect_mode, collect_mode, CollectMode, "Failed to parse garbage collection mode");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_device_policy, cgroup_device_policy, CGroupDevicePolicy, "Failed to parse device policy");
+DEFINE_CONFIG_PARSE_ENUM(config_parse_pressure_action, cgroup_pressure_action, CGroupPressureAction, "Failed to parse pressure action");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_exec_keyring_mode, exec_keyring_mode, ExecKeyringMode, "Failed to parse keyring mode");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_exec_utmp_mode, exec_utmp_mode, ExecUtmpMode, "Failed to parse utmp mode");
 DEFINE_CONFIG_PARSE_ENUM(config_parse_job_mode, job_mode, JobMode, "Failed to parse job mode");
@@ -101,6 +103,7 @@ int config_parse_unit_deps(
                 void *data,
                 void *userdata) {
 
+        _cleanup_arena_ Arena arena = ARENA_NULL;
         UnitDependency d = ltype;
         Unit *u = userdata;
         const char *p;
@@ -111,10 +114,11 @@ int config_parse_unit_deps(
 
         p = rvalue;
         for (;;) {
-                _cleanup_free_ char *word = NULL, *k = NULL;
+                _cleanup_free_ char *k = NULL;
+                char *word;
                 int r;
 
-                r = extract_first_word(&p, &word, NULL, EXTRACT_RETAIN_ESCAPE);
+                r = extract_first_word_arena(&arena, &p, &word, NULL, EXTRACT_RETAIN_ESCAPE);
                 if (r == 0)
                         break;
                 if (r == -ENOMEM)
@@ -1205,6 +1209,51 @@ int config_parse_exec_cpu_sched_prio(const char *unit,
         return 0;
 }
 
+static int parse_and_merge_cpu_set(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *lvalue,
+                const char *rvalue,
+                cpu_set_t **set,
+                unsigned *n) {
+
+        _cleanup_cpu_free_ cpu_set_t *cpuset = NULL;
+        int ncpus;
+
+        assert(set);
+        assert(n);
+
+        ncpus = parse_cpu_set_and_warn(rvalue, &cpuset, unit, filename, line, lvalue);
+        if (ncpus < 0)
+                return ncpus;
+
+        if (ncpus == 0) {
+                /* An empty assignment resets the list */
+                *set = cpu_set_mfree(*set);
+                *n = 0;
+                return 0;
+        }
+
+        if (!*set) {
+                *set = TAKE_PTR(cpuset);
+                *n = (unsigned) ncpus;
+                return 0;
+        }
+
+        if (*n < (unsigned) ncpus) {
+                CPU_OR_S(CPU_ALLOC_SIZE(*n), cpuset, *set, cpuset);
+                CPU_FREE(*set);
+                *set = TAKE_PTR(cpuset);
+                *n = (unsigned) ncpus;
+                return 0;
+        }
+
+        CPU_OR_S(CPU_ALLOC_SIZE((unsigned) ncpus), *set, *set, cpuset);
+
+        return 0;
+}
+
 int config_parse_exec_cpu_affinity(const char *unit,
                                    const char *filename,
                                    unsigned line,
@@ -1217,44 +1266,72 @@ int config_parse_exec_cpu_affinity(const char *unit,
                                    void *userdata) {
 
         ExecContext *c = data;
-        _cleanup_cpu_free_ cpu_set_t *cpuset = NULL;
-        int ncpus;
 
         assert(filename);
         assert(lvalue);
         assert(rvalue);
         assert(data);
 
-        ncpus = parse_cpu_set_and_warn(rvalue, &cpuset, unit, filename, line, lvalue);
-        if (ncpus < 0)
-                return ncpus;
+        return parse_and_merge_cpu_set(unit, filename, line, lvalue, rvalue, &c->cpuset, &c->cpuset_ncpus);
+}
 
-        if (ncpus == 0) {
-                /* An empty assignment resets the CPU list */
-                c->cpuset = cpu_set_mfree(c->cpuset);
-                c->cpuset_ncpus = 0;
-                return 0;
-        }
+int config_parse_numa_policy(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        ExecContext *c = data;
+        int t;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
 
-        if (!c->cpuset) {
-                c->cpuset = TAKE_PTR(cpuset);
-                c->cpuset_ncpus = (unsigned) ncpus;
+        if (isempty(rvalue)) {
+                c->numa_policy.type = -1;
                 return 0;
         }
 
-        if (c->cpuset_ncpus < (unsigned) ncpus) {
-                CPU_OR_S(CPU_ALLOC_SIZE(c->cpuset_ncpus), cpuset, c->cpuset, cpuset);
-                CPU_FREE(c->cpuset);
-                c->cpuset = TAKE_PTR(cpuset);
-                c->cpuset_ncpus = (unsigned) ncpus;
+        t = mpol_from_string(rvalue);
+        if (t < 0) {
+                log_syntax(unit, LOG_ERR, filename, line, 0, "Invalid NUMA policy type, ignoring: %s", rvalue);
                 return 0;
         }
 
-        CPU_OR_S(CPU_ALLOC_SIZE((unsigned) ncpus), c->cpuset, c->cpuset, cpuset);
-
+        c->numa_policy.type = t;
         return 0;
 }
 
+int config_parse_numa_mask(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        ExecContext *c = data;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
+
+        return parse_and_merge_cpu_set(unit, filename, line, lvalue, rvalue, &c->numa_policy.nodes, &c->numa_policy.n_nodes);
+}
+
 int config_parse_capability_set(
                 const char *unit,
                 const char *filename,
@@ -1542,7 +1619,7 @@ int config_parse_trigger_unit(
         assert(rvalue);
         assert(data);
 
-        if (!hashmap_isempty(u->dependencies[UNIT_TRIGGERS])) {
+        if (unit_dependency_count(u, UNIT_TRIGGERS) > 0) {
                 log_syntax(unit, LOG_ERR, filename, line, 0, "Multiple units to trigger specified, ignoring: %s", rvalue);
                 return 0;
         }
@@ -1623,7 +1700,6 @@ int config_parse_path_spec(const char *unit,
         s->unit = UNIT(p);
         s->path = TAKE_PTR(k);
         s->type = b;
-        s->inotify_fd = -1;
 
         LIST_PREPEND(spec, p->specs, s);
 
@@ -2662,6 +2738,8 @@ int config_parse_syscall_filter(
         assert(rvalue);
         assert(u);
 
+        exec_context_invalidate_syscall_filter(c);
+
         if (isempty(rvalue)) {
                 /* Empty assignment resets the list */
                 c->syscall_filter = hashmap_free(c->syscall_filter);
@@ -2794,6 +2872,8 @@ int config_parse_syscall_errno(
         assert(lvalue);
         assert(rvalue);
 
+        exec_context_invalidate_syscall_filter(c);
+
         if (isempty(rvalue)) {
                 /* Empty assignment resets to KILL */
                 c->syscall_errno = 0;
@@ -3018,6 +3098,132 @@ int config_parse_cpu_quota(
         return 0;
 }
 
+int config_parse_pressure_threshold(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        CGroupContext *c = data;
+        CGroupPressureResource resource = ltype;
+        usec_t usec;
+        int r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(resource >= 0 && resource < _CGROUP_PRESSURE_RESOURCE_MAX);
+
+        if (isempty(rvalue)) {
+                c->pressure_threshold_usec[resource] = 0;
+                return 0;
+        }
+
+        r = parse_sec(rvalue, &usec);
+        if (r < 0) {
+                log_syntax(unit, LOG_ERR, filename, line, r, "Failed to parse %s=, ignoring: %s", lvalue, rvalue);
+                return 0;
+        }
+
+        if (usec > CGROUP_PRESSURE_WINDOW_MAX_USEC) {
+                log_syntax(unit, LOG_ERR, filename, line, 0, "%s= must not be longer than the maximum pressure window, ignoring: %s", lvalue, rvalue);
+                return 0;
+        }
+
+        c->pressure_threshold_usec[resource] = usec;
+        return 0;
+}
+
+int config_parse_pressure_window(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        CGroupContext *c = data;
+        usec_t usec;
+        int r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+
+        if (isempty(rvalue)) {
+                c->pressure_window_usec = CGROUP_PRESSURE_WINDOW_DEFAULT_USEC;
+                return 0;
+        }
+
+        r = parse_sec(rvalue, &usec);
+        if (r < 0) {
+                log_syntax(unit, LOG_ERR, filename, line, r, "Failed to parse %s=, ignoring: %s", lvalue, rvalue);
+                return 0;
+        }
+
+        if (usec < CGROUP_PRESSURE_WINDOW_MIN_USEC || usec > CGROUP_PRESSURE_WINDOW_MAX_USEC) {
+                log_syntax(unit, LOG_ERR, filename, line, 0, "%s= must be between 500ms and 10s, ignoring: %s", lvalue, rvalue);
+                return 0;
+        }
+
+        c->pressure_window_usec = usec;
+        return 0;
+}
+
+int config_parse_allowed_cpus(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        CGroupContext *c = data;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
+
+        return parse_and_merge_cpu_set(unit, filename, line, lvalue, rvalue, &c->cpuset_cpus, &c->cpuset_cpus_ncpus);
+}
+
+int config_parse_allowed_mems(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        CGroupContext *c = data;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(data);
+
+        return parse_and_merge_cpu_set(unit, filename, line, lvalue, rvalue, &c->cpuset_mems, &c->cpuset_mems_nnodes);
+}
+
 int config_parse_memory_limit(
                 const char *unit,
                 const char *filename,
@@ -4483,21 +4689,18 @@ static int merge_by_names(Unit **u, Set *names, const char *id) {
         return 0;
 }
 
-static int load_from_path(Unit *u, const char *path) {
-        _cleanup_set_free_free_ Set *symlink_names = NULL;
+static int find_and_open(Unit *u, const char *path, char **ret_filename, FILE **ret_f, Set *symlink_names, char **ret_id) {
         _cleanup_fclose_ FILE *f = NULL;
         _cleanup_free_ char *filename = NULL;
         char *id = NULL;
-        Unit *merged;
-        struct stat st;
         int r;
 
         assert(u);
         assert(path);
-
-        symlink_names = set_new(&string_hash_ops);
-        if (!symlink_names)
-                return -ENOMEM;
+        assert(ret_filename);
+        assert(ret_f);
+        assert(symlink_names);
+        assert(ret_id);
 
         if (path_is_absolute(path)) {
 
@@ -4548,47 +4751,73 @@ static int load_from_path(Unit *u, const char *path) {
                 }
         }
 
-        if (!filename)
+        if (!filename) {
                 /* Hmm, no suitable file found? */
+                *ret_filename = NULL;
+                *ret_f = NULL;
+                *ret_id = NULL;
                 return 0;
+        }
+
+        *ret_filename = TAKE_PTR(filename);
+        *ret_f = TAKE_PTR(f);
+        *ret_id = id;
+        return 1;
+}
+
+static int load_from_file(Unit *u, char *filename, FILE *f, Set *symlink_names, char *id, bool masked, usec_t mtime) {
+        Unit *merged;
+        int r;
+
+        assert(u);
+        assert(filename);
+        assert(f || masked);
+        assert(symlink_names);
+
+        /* Takes possession of filename, but not of the rest */
 
         if (!unit_type_may_alias(u->type) && set_size(symlink_names) > 1) {
                 log_unit_warning(u, "Unit type of %s does not support alias names, refusing loading via symlink.", u->id);
+                free(filename);
                 return -ELOOP;
         }
 
         merged = u;
         r = merge_by_names(&merged, symlink_names, id);
-        if (r < 0)
+        if (r < 0) {
+                free(filename);
                 return r;
+        }
 
         if (merged != u) {
                 u->load_state = UNIT_MERGED;
+                free(filename);
                 return 0;
         }
 
-        if (fstat(fileno(f), &st) < 0)
-                return -errno;
-
-        if (null_or_empty(&st)) {
+        if (masked) {
                 u->load_state = UNIT_MASKED;
                 u->fragment_mtime = 0;
         } else {
                 u->load_state = UNIT_LOADED;
-                u->fragment_mtime = timespec_load(&st.st_mtim);
+                u->fragment_mtime = mtime;
 
                 /* Now, parse the file contents */
                 r = config_parse(u->id, filename, f,
                                  UNIT_VTABLE(u)->sections,
                                  config_item_perf_lookup, load_fragment_gperf_lookup,
                                  CONFIG_PARSE_ALLOW_INCLUDE, u);
-                if (r < 0)
+                if (r < 0) {
+                        free(filename);
                         return r;
+                }
         }
 
         free_and_replace(u->fragment_path, filename);
 
         if (u->source_path) {
+                struct stat st;
+
                 if (stat(u->source_path, &st) >= 0)
                         u->source_mtime = timespec_load(&st.st_mtim);
                 else
@@ -4598,6 +4827,205 @@ static int load_from_path(Unit *u, const char *path) {
         return 0;
 }
 
+static int load_from_path(Unit *u, const char *path) {
+        _cleanup_set_free_free_ Set *symlink_names = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        char *filename, *id;
+        struct stat st;
+        int r;
+
+        assert(u);
+        assert(path);
+
+        symlink_names = set_new(&string_hash_ops);
+        if (!symlink_names)
+                return -ENOMEM;
+
+        r = find_and_open(u, path, &filename, &f, symlink_names, &id);
+        if (r <= 0)
+                return r;
+
+        if (fstat(fileno(f), &st) < 0) {
+                free(filename);
+                return -errno;
+        }
+
+        return load_from_file(u, filename, f, symlink_names, id, null_or_empty(&st), timespec_load(&st.st_mtim));
+}
+
+typedef struct UnitTemplate {
+        char *name;
+        char *path;
+        char **symlink_names;
+        char *id;
+        bool masked;
+        usec_t mtime;
+        uint64_t size;
+        char *contents;
+} UnitTemplate;
+
+static UnitTemplate* unit_template_free(UnitTemplate *t) {
+        if (!t)
+                return NULL;
+
+        free(t->name);
+        free(t->path);
+        strv_free(t->symlink_names);
+        free(t->id);
+        free(t->contents);
+        return mfree(t);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(UnitTemplate*, unit_template_free);
+
+void unit_template_cache_flush(Manager *m) {
+        assert(m);
+
+        m->unit_template_cache = hashmap_free_with_destructor(m->unit_template_cache, unit_template_free);
+}
+
+static bool unit_template_is_current(UnitTemplate *t) {
+        struct stat st;
+
+        assert(t);
+
+        /* Which file the template is loaded from can only change when the unit path cache is rebuilt, which
+         * flushes this cache, but the file itself might have been edited in place. */
+
+        if (stat(t->path, &st) < 0)
+                return false;
+
+        return null_or_empty(&st) == t->masked &&
+                timespec_load(&st.st_mtim) == t->mtime &&
+                (t->masked || (uint64_t) st.st_size == t->size);
+}
+
+static int unit_template_read(Unit *u, const char *name, UnitTemplate **ret) {
+        _cleanup_(unit_template_freep) UnitTemplate *t = NULL;
+        _cleanup_set_free_free_ Set *symlink_names = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        char *filename, *id;
+        struct stat st;
+        size_t size;
+        int r;
+
+        symlink_names = set_new(&string_hash_ops);
+        if (!symlink_names)
+                return -ENOMEM;
+
+        t = new0(UnitTemplate, 1);
+        if (!t)
+                return -ENOMEM;
+
+        r = find_and_open(u, name, &filename, &f, symlink_names, &id);
+        if (r <= 0) {
+                *ret = NULL;
+                return r;
+        }
+        t->path = filename;
+
+        t->name = strdup(name);
+        if (!t->name)
+                return -ENOMEM;
+
+        if (id) {
+                t->id = strdup(id);
+                if (!t->id)
+                        return -ENOMEM;
+        }
+
+        t->symlink_names = set_get_strv(symlink_names);
+        if (!t->symlink_names)
+                return -ENOMEM;
+        symlink_names = set_free(symlink_names); /* the strings belong to the strv now */
+
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+
+        t->masked = null_or_empty(&st);
+        t->mtime = timespec_load(&st.st_mtim);
+
+        if (!t->masked) {
+                r = read_full_stream(f, &t->contents, &size);
+                if (r < 0)
+                        return r;
+
+                t->size = size;
+        }
+
+        *ret = TAKE_PTR(t);
+        return 1;
+}
+
+static int load_from_template(Unit *u, const char *name) {
+        _cleanup_set_free_free_ Set *symlink_names = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        UnitTemplate *t;
+        char *filename, *id = NULL, **n;
+        int r;
+
+        assert(u);
+        assert(name);
+
+        /* Loads an instance from its template. The template is found and read once, and kept around until the unit
+         * path cache is rebuilt, so that spawning lots of instances of the same template, as Accept=yes sockets do,
+         * doesn't have to search the unit path and read the file each time. It still has to be parsed for each
+         * instance though, as specifiers are resolved while parsing. */
+
+        if (!u->manager->unit_path_cache)
+                return load_from_path(u, name);
+
+        t = hashmap_get(u->manager->unit_template_cache, name);
+        if (t && !unit_template_is_current(t)) {
+                hashmap_remove(u->manager->unit_template_cache, name);
+                t = unit_template_free(t);
+        }
+
+        if (!t) {
+                _cleanup_(unit_template_freep) UnitTemplate *nt = NULL;
+
+                r = unit_template_read(u, name, &nt);
+                if (r <= 0)
+                        return r;
+
+                r = hashmap_ensure_allocated(&u->manager->unit_template_cache, &string_hash_ops);
+                if (r < 0)
+                        return r;
+
+                r = hashmap_put(u->manager->unit_template_cache, nt->name, nt);
+                if (r < 0)
+                        return r;
+
+                t = TAKE_PTR(nt);
+        }
+
+        symlink_names = set_new(&string_hash_ops);
+        if (!symlink_names)
+                return -ENOMEM;
+
+        STRV_FOREACH(n, t->symlink_names) {
+                r = set_put_strdup(symlink_names, *n);
+                if (r < 0)
+                        return r;
+        }
+
+        /* merge_by_names() recognizes the id by its address in the set */
+        if (t->id)
+                id = set_get(symlink_names, t->id);
+
+        if (!t->masked) {
+                f = fmemopen(t->contents, t->size, "r");
+                if (!f)
+                        return -errno;
+        }
+
+        filename = strdup(t->path);
+        if (!filename)
+                return -ENOMEM;
+
+        return load_from_file(u, filename, f, symlink_names, id, t->masked, t->mtime);
+}
+
 int unit_load_fragment(Unit *u) {
         int r;
         Iterator i;
@@ -4657,7 +5085,7 @@ int unit_load_fragment(Unit *u) {
                 if (r < 0)
                         return r;
 
-                r = load_from_path(u, k);
+                r = load_from_template(u, k);
                 if (r < 0) {
                         if (r == -ENOEXEC)
                                 log_unit_notice(u, "Unit configuration has fatal error, unit will not be started.");
@@ -4688,6 +5116,74 @@ int unit_load_fragment(Unit *u) {
         return 0;
 }
 
+static int find_fragment(Unit *u, const char *name, char **ret) {
+        char **p;
+        int r;
+
+        STRV_FOREACH(p, u->manager->lookup_paths.search_path) {
+                _cleanup_free_ char *filename = NULL;
+                unsigned c = 0;
+
+                filename = path_make_absolute(name, *p);
+                if (!filename)
+                        return -ENOMEM;
+
+                if (u->manager->unit_path_cache &&
+                    !set_get(u->manager->unit_path_cache, filename))
+                        continue;
+
+                /* Follow symlinks the same way open_follow() does, so that we end up with the same path */
+                for (;;) {
+                        char *target;
+
+                        if (c++ >= FOLLOW_MAX)
+                                return -ELOOP;
+
+                        path_simplify(filename, false);
+
+                        r = readlink_and_make_absolute(filename, &target);
+                        if (r < 0)
+                                break;
+
+                        free_and_replace(filename, target);
+                }
+
+                if (r == -EINVAL) {
+                        /* Not a symlink, hence this is the file we'd load */
+                        *ret = TAKE_PTR(filename);
+                        return 1;
+                }
+
+                if (!IN_SET(r, -ENOENT, -ENOTDIR, -EACCES))
+                        return r;
+        }
+
+        *ret = NULL;
+        return 0;
+}
+
+int unit_find_fragment(Unit *u, char **ret) {
+        _cleanup_free_ char *template = NULL;
+        int r;
+
+        assert(u);
+        assert(u->id);
+        assert(ret);
+
+        /* Determines which file unit_load_fragment() would load the unit from right now, looking at the unit's id
+         * and its template. Returns 0 and NULL if there's none. */
+
+        r = find_fragment(u, u->id, ret);
+        if (r != 0 || !u->instance)
+                return r;
+
+        r = unit_name_template(u->id, &template);
+        if (r < 0)
+                return r;
+
+        return find_fragment(u, template, ret);
+}
+
 void unit_dump_config_items(FILE *f) {
         static const struct {
                 const ConfigParserCallback callback;
@@ -4711,6 +5207,8 @@ void unit_dump_config_items(FILE *f) {
                 { config_parse_exec_cpu_sched_policy, "CPUSCHEDPOLICY" },
                 { config_parse_exec_cpu_sched_prio,   "CPUSCHEDPRIO" },
                 { config_parse_exec_cpu_affinity,     "CPUAFFINITY" },
+                { config_parse_numa_policy,           "NUMAPOLICY" },
+                { config_parse_numa_mask,             "NUMAMASK" },
                 { config_parse_mode,                  "MODE" },
                 { config_parse_unit_env_file,         "FILE" },
                 { config_parse_exec_output,           "OUTPUT" },
@@ -4763,6 +5261,11 @@ void unit_dump_config_items(FILE *f) {
                 { config_parse_memory_limit,          "LIMIT" },
                 { config_parse_device_allow,          "DEVICE" },
                 { config_parse_device_policy,         "POLICY" },
+                { config_parse_pressure_threshold,    "SECONDS" },
+                { config_parse_pressure_window,       "SECONDS" },
+                { config_parse_pressure_action,       "ACTION" },
+                { config_parse_allowed_cpus,          "CPUSET" },
+                { config_parse_allowed_mems,          "CPUSET" },
                 { config_parse_io_limit,              "LIMIT" },
                 { config_parse_io_device_weight,      "DEVICEWEIGHT" },
                 { config_parse_io_device_latency,     "DEVICELATENCY" },
@@ -113,6 +113,9 @@ static usec_t arg_default_timeout_start_usec = DEFAULT_TIMEOUT_USEC;
 static usec_t arg_default_timeout_stop_usec = DEFAULT_TIMEOUT_USEC;
 static usec_t arg_default_start_limit_interval = DEFAULT_START_LIMIT_INTERVAL;
 static unsigned arg_default_start_limit_burst = DEFAULT_START_LIMIT_BURST;
+static unsigned arg_default_start_concurrency = 0;
+static usec_t arg_accounting_sample_usec = 0;
+static usec_t arg_generator_timeout_usec = USEC_INFINITY;
 static usec_t arg_runtime_watchdog = 0;
 static usec_t arg_shutdown_watchdog = 10 * USEC_PER_MINUTE;
 static char *arg_early_core_pattern = NULL;
@@ -699,6 +702,7 @@ static int parse_config_file(void) {
                 { "Manager", "DefaultStartLimitInterval", config_parse_sec,              0, &arg_default_start_limit_interval      }, /* obsolete alias */
                 { "Manager", "DefaultStartLimitIntervalSec",config_parse_sec,            0, &arg_default_start_limit_interval      },
                 { "Manager", "DefaultStartLimitBurst",    config_parse_unsigned,         0, &arg_default_start_limit_burst         },
+                { "Manager", "DefaultStartConcurrency",   config_parse_unsigned,         0, &arg_default_start_concurrency         },
                 { "Manager", "DefaultEnvironment",        config_parse_environ,          0, &arg_default_environment               },
                 { "Manager", "DefaultLimitCPU",           config_parse_rlimit,           RLIMIT_CPU, arg_default_rlimit            },
                 { "Manager", "DefaultLimitFSIZE",         config_parse_rlimit,           RLIMIT_FSIZE, arg_default_rlimit          },
@@ -723,6 +727,8 @@ static int parse_config_file(void) {
                 { "Manager", "DefaultMemoryAccounting",   config_parse_bool,             0, &arg_default_memory_accounting         },
                 { "Manager", "DefaultTasksAccounting",    config_parse_bool,             0, &arg_default_tasks_accounting          },
                 { "Manager", "DefaultTasksMax",           config_parse_tasks_max,        0, &arg_default_tasks_max                 },
+                { "Manager", "AccountingSampleIntervalSec",config_parse_sec,             0, &arg_accounting_sample_usec            },
+                { "Manager", "GeneratorTimeoutSec",       config_parse_sec,              0, &arg_generator_timeout_usec            },
                 { "Manager", "CtrlAltDelBurstAction",     config_parse_emergency_action, 0, &arg_cad_burst_action                  },
                 {}
         };
@@ -745,6 +751,8 @@ static int parse_config_file(void) {
                 arg_default_timeout_start_usec = USEC_INFINITY;
         if (arg_default_timeout_stop_usec <= 0)
                 arg_default_timeout_stop_usec = USEC_INFINITY;
+        if (arg_generator_timeout_usec <= 0)
+                arg_generator_timeout_usec = USEC_INFINITY;
 
         return 0;
 }
@@ -798,6 +806,9 @@ static void set_manager_settings(Manager *m) {
         m->runtime_watchdog = arg_runtime_watchdog;
         m->shutdown_watchdog = arg_shutdown_watchdog;
         m->cad_burst_action = arg_cad_burst_action;
+        m->default_start_concurrency = arg_default_start_concurrency;
+        (void) manager_set_accounting_sample_interval(m, arg_accounting_sample_usec);
+        m->generator_timeout_usec = arg_generator_timeout_usec;
 
         manager_set_show_status(m, arg_show_status);
 }
@@ -1797,6 +1808,18 @@ static int invoke_main_loop(
 
                 switch ((ManagerObjective) r) {
 
+                case MANAGER_RELOAD_INCREMENTAL:
+                        r = manager_reload_incremental(m);
+                        if (r < 0) {
+                                m->objective = MANAGER_OK;
+                                break;
+                        }
+                        if (r == 0)
+                                break;
+
+                        /* Some unit can't be reloaded on its own, do a full reload instead */
+                        _fallthrough_;
+
                 case MANAGER_RELOAD: {
                         LogTarget saved_log_target;
                         int saved_log_level;
@@ -1814,6 +1837,7 @@ static int invoke_main_loop(
                                 log_warning_errno(r, "Failed to parse config file, ignoring: %m");
 
                         set_manager_defaults(m);
+                        (void) manager_set_accounting_sample_interval(m, arg_accounting_sample_usec);
 
                         if (saved_log_level >= 0)
                                 manager_override_log_level(m, saved_log_level);
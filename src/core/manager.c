@@ -24,6 +24,7 @@
 
 #include "all-units.h"
 #include "alloc-util.h"
+#include "async.h"
 #include "audit-fd.h"
 #include "boot-timestamps.h"
 #include "bus-common-errors.h"
@@ -48,6 +49,7 @@
 #include "hashmap.h"
 #include "io-util.h"
 #include "label.h"
+#include "load-fragment.h"
 #include "locale-setup.h"
 #include "log.h"
 #include "macro.h"
@@ -96,6 +98,30 @@
 /* How many units and jobs to process of the bus queue before returning to the event loop. */
 #define MANAGER_BUS_MESSAGE_BUDGET 100U
 
+/* How many units to process of the GC queue before returning to the event loop. */
+#define MANAGER_GC_UNIT_BUDGET 500U
+
+/* How many threads to use at most for prefetching unit files during startup and reload, and how many files each
+ * thread should get at least */
+#define UNIT_FILE_PREFETCH_THREADS_MAX 8U
+#define UNIT_FILE_PREFETCH_BATCH 64U
+
+/* How many notification datagrams to read with a single recvmmsg() call */
+#define NOTIFY_BATCH_MAX 16U
+
+/* How many log messages for the journal to queue while the event loop runs, before sending them synchronously */
+#define LOG_QUEUE_MAX 1024U
+
+struct NotifySlot {
+        struct iovec iovec;
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) +
+                            CMSG_SPACE(sizeof(int) * NOTIFY_FD_MAX)];
+        } control;
+        char buffer[NOTIFY_BUFFER_MAX+1];
+};
+
 static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_cgroups_agent_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_signal_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
@@ -338,6 +364,20 @@ static int manager_watch_idle_pipe(Manager *m) {
         return 0;
 }
 
+void manager_open_idle_pipe(Manager *m) {
+        assert(m);
+
+        /* We don't really care too much whether this works or not, as the idle pipe is a feature for cosmetics,
+         * not actually useful for anything beyond that. */
+
+        if (m->idle_pipe[0] >= 0 || m->idle_pipe[1] >= 0 ||
+            m->idle_pipe[2] >= 0 || m->idle_pipe[3] >= 0)
+                return;
+
+        (void) pipe2(m->idle_pipe, O_NONBLOCK|O_CLOEXEC);
+        (void) pipe2(m->idle_pipe + 2, O_NONBLOCK|O_CLOEXEC);
+}
+
 static void manager_close_idle_pipe(Manager *m) {
         assert(m);
 
@@ -737,6 +777,7 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
                 .default_memory_accounting = MEMORY_ACCOUNTING_DEFAULT,
                 .default_tasks_accounting = true,
                 .default_tasks_max = UINT64_MAX,
+                .generator_timeout_usec = USEC_INFINITY,
                 .default_timeout_start_usec = DEFAULT_TIMEOUT_USEC,
                 .default_timeout_stop_usec = DEFAULT_TIMEOUT_USEC,
                 .default_restart_usec = DEFAULT_RESTART_USEC,
@@ -754,6 +795,7 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
                 .cgroup_inotify_fd = -1,
                 .pin_cgroupfs_fd = -1,
                 .ask_password_inotify_fd = -1,
+                .path_inotify_fd = -1,
                 .idle_pipe = { -1, -1, -1, -1},
 
                  /* start as id #1, so that we can leave #0 around as "null-like" value */
@@ -913,6 +955,18 @@ static int manager_setup_notify(Manager *m) {
         }
 
         if (!m->notify_event_source) {
+                if (!m->notify_batch) {
+                        m->notify_batch = new0(struct mmsghdr, NOTIFY_BATCH_MAX);
+                        if (!m->notify_batch)
+                                return log_oom();
+                }
+
+                if (!m->notify_slots) {
+                        m->notify_slots = new0(struct NotifySlot, NOTIFY_BATCH_MAX);
+                        if (!m->notify_slots)
+                                return log_oom();
+                }
+
                 r = sd_event_add_io(m->event, &m->notify_event_source, m->notify_fd, EPOLLIN, manager_dispatch_notify_fd, m);
                 if (r < 0)
                         return log_error_errno(r, "Failed to allocate notify event source: %m");
@@ -924,6 +978,12 @@ static int manager_setup_notify(Manager *m) {
                         return log_error_errno(r, "Failed to set priority of notify event source: %m");
 
                 (void) sd_event_source_set_description(m->notify_event_source, "manager-notify");
+
+                /* Due to its high priority a flood of notification messages would starve everything else
+                 * we do, hence put a generous limit on how often we process them. */
+                r = sd_event_source_set_ratelimit(m->notify_event_source, 1 * USEC_PER_SEC, 2500);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to set rate limit of notify event source, ignoring: %m");
         }
 
         return 0;
@@ -1083,13 +1143,12 @@ enum {
 
 static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         u->gc_marker = gc_marker + GC_OFFSET_GOOD;
 
         /* Recursively mark referenced units as GOOD as well */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REFERENCES], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCES, i)
                 if (other->gc_marker == gc_marker + GC_OFFSET_UNSURE)
                         unit_gc_mark_good(other, gc_marker);
 }
@@ -1097,8 +1156,7 @@ static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
 static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
         Unit *other;
         bool is_bad;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         assert(u);
 
@@ -1116,7 +1174,7 @@ static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
 
         is_bad = true;
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REFERENCED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCED_BY, i) {
                 unit_gc_sweep(other, gc_marker);
 
                 if (other->gc_marker == gc_marker + GC_OFFSET_GOOD)
@@ -1161,13 +1219,26 @@ good:
 }
 
 static unsigned manager_dispatch_gc_unit_queue(Manager *m) {
-        unsigned n = 0, gc_marker;
+        unsigned n = 0, n_collected = 0, gc_marker;
+        usec_t start, elapsed;
         Unit *u;
 
         assert(m);
 
+        /* Only process a certain number of units per event loop iteration, so that collecting a large number of
+         * units at once (for example after a lot of transient units stopped) does not delay processing of everything
+         * else, in particular bus requests. If we ran out of budget, the rest is picked up again only after the event
+         * loop ran once. Every run starts a new generation of markers, since whatever we learnt about the units in
+         * an earlier run might be outdated by then. Units we decide to collect are freed by the cleanup queue right
+         * after this, before the event loop runs, hence no state is carried over between runs. */
+
+        if (m->gc_unit_queue_throttled || !m->gc_unit_queue)
+                return 0;
+
         /* log_debug("Running GC..."); */
 
+        start = now(CLOCK_MONOTONIC);
+
         m->gc_marker += _GC_OFFSET_MAX;
         if (m->gc_marker + _GC_OFFSET_MAX <= _GC_OFFSET_MAX)
                 m->gc_marker = 1;
@@ -1177,6 +1248,11 @@ static unsigned manager_dispatch_gc_unit_queue(Manager *m) {
         while ((u = m->gc_unit_queue)) {
                 assert(u->in_gc_queue);
 
+                if (n >= MANAGER_GC_UNIT_BUDGET) {
+                        m->gc_unit_queue_throttled = true;
+                        break;
+                }
+
                 unit_gc_sweep(u, gc_marker);
 
                 LIST_REMOVE(gc_queue, m->gc_unit_queue, u);
@@ -1190,9 +1266,16 @@ static unsigned manager_dispatch_gc_unit_queue(Manager *m) {
                                 log_unit_debug(u, "Collecting.");
                         u->gc_marker = gc_marker + GC_OFFSET_BAD;
                         unit_add_to_cleanup_queue(u);
+                        n_collected++;
                 }
         }
 
+        elapsed = now(CLOCK_MONOTONIC) - start;
+
+        m->n_gc_units_collected += n_collected;
+        m->gc_usec += elapsed;
+        m->gc_max_usec = MAX(m->gc_max_usec, elapsed);
+
         return n;
 }
 
@@ -1220,6 +1303,22 @@ static unsigned manager_dispatch_gc_job_queue(Manager *m) {
         return n;
 }
 
+static unsigned manager_dispatch_transient_write_queue(Manager *m) {
+        unsigned n = 0;
+        Unit *u;
+
+        assert(m);
+
+        while ((u = m->transient_write_queue)) {
+                assert(u->in_transient_write_queue);
+
+                (void) unit_write_transient_file(u);
+                n++;
+        }
+
+        return n;
+}
+
 static unsigned manager_dispatch_stop_when_unneeded_queue(Manager *m) {
         unsigned n = 0;
         Unit *u;
@@ -1259,6 +1358,24 @@ static unsigned manager_dispatch_stop_when_unneeded_queue(Manager *m) {
         return n;
 }
 
+static void manager_forget_removed_units(Manager *m, size_t n) {
+        size_t i;
+
+        assert(m);
+        assert(n <= m->n_units_removed);
+
+        if (n == 0)
+                return;
+
+        for (i = 0; i < n; i++)
+                free(m->units_removed[i].id);
+
+        m->units_removed_forgotten = MAX(m->units_removed_forgotten, m->units_removed[n - 1].generation);
+
+        memmove(m->units_removed, m->units_removed + n, (m->n_units_removed - n) * sizeof(RemovedUnit));
+        m->n_units_removed -= n;
+}
+
 static void manager_clear_jobs_and_units(Manager *m) {
         Unit *u;
 
@@ -1287,6 +1404,24 @@ static void manager_clear_jobs_and_units(Manager *m) {
         m->n_failed_jobs = 0;
 }
 
+typedef struct UnitPathCacheDir {
+        char *path;
+        nsec_t mtime;
+        usec_t timestamp;
+        char **entries;
+} UnitPathCacheDir;
+
+static UnitPathCacheDir* unit_path_cache_dir_free(UnitPathCacheDir *d) {
+        if (!d)
+                return NULL;
+
+        free(d->path);
+        strv_free(d->entries);
+        return mfree(d);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(UnitPathCacheDir*, unit_path_cache_dir_free);
+
 Manager* manager_free(Manager *m) {
         ExecDirectoryType dt;
         UnitType c;
@@ -1309,19 +1444,26 @@ Manager* manager_free(Manager *m) {
 
         exec_runtime_vacuum(m);
         hashmap_free(m->exec_runtime_by_id);
+        hashmap_free(m->image_mounts);
 
         dynamic_user_vacuum(m, false);
         hashmap_free(m->dynamic_users);
 
         hashmap_free(m->units);
         hashmap_free(m->units_by_invocation_id);
+        hashmap_free(m->bpf_firewall_shared);
+        hashmap_free(m->bpf_devices_shared);
         hashmap_free(m->jobs);
+        prioq_free(m->start_queue);
         hashmap_free(m->watch_pids);
         hashmap_free(m->watch_bus);
 
         set_free(m->startup_units);
         set_free(m->failed_units);
 
+        manager_forget_removed_units(m, m->n_units_removed);
+        free(m->units_removed);
+
         sd_event_source_unref(m->signal_event_source);
         sd_event_source_unref(m->sigchld_event_source);
         sd_event_source_unref(m->notify_event_source);
@@ -1332,11 +1474,13 @@ Manager* manager_free(Manager *m) {
         sd_event_source_unref(m->run_queue_event_source);
         sd_event_source_unref(m->user_lookup_event_source);
         sd_event_source_unref(m->sync_bus_names_event_source);
+        sd_event_source_unref(m->path_inotify_event_source);
 
         safe_close(m->signal_fd);
         safe_close(m->notify_fd);
         safe_close(m->cgroups_agent_fd);
         safe_close(m->time_change_fd);
+        safe_close(m->path_inotify_fd);
         safe_close_pair(m->user_lookup_fds);
 
         manager_close_ask_password(m);
@@ -1346,13 +1490,20 @@ Manager* manager_free(Manager *m) {
         sd_event_unref(m->event);
 
         free(m->notify_socket);
+        free(m->notify_batch);
+        free(m->notify_slots);
 
         lookup_paths_free(&m->lookup_paths);
         strv_free(m->transient_environment);
         strv_free(m->client_environment);
 
         hashmap_free(m->cgroup_unit);
+        hashmap_free(m->path_watches);
         set_free_free(m->unit_path_cache);
+        hashmap_free_with_destructor(m->unit_path_cache_dirs, unit_path_cache_dir_free);
+        unit_template_cache_flush(m);
+
+        exec_timing_free_many(m->generator_timings, m->n_generator_timings);
 
         free(m->switch_root);
         free(m->switch_root_init);
@@ -1450,13 +1601,68 @@ static void manager_catchup(Manager *m) {
         }
 }
 
+static int unit_path_cache_dir_scan(const char *path, nsec_t mtime, UnitPathCacheDir **ret) {
+        _cleanup_(unit_path_cache_dir_freep) UnitPathCacheDir *d = NULL;
+        _cleanup_closedir_ DIR *dir = NULL;
+        size_t n_allocated = 0, n = 0;
+        struct dirent *de;
+
+        d = new0(UnitPathCacheDir, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->path = strdup(path);
+        if (!d->path)
+                return -ENOMEM;
+
+        /* Take the timestamp before reading the directory, so that anything changing while we read it has a newer
+         * mtime */
+        d->mtime = mtime;
+        d->timestamp = now(CLOCK_REALTIME);
+
+        dir = opendir(path);
+        if (!dir)
+                return -errno;
+
+        FOREACH_DIRENT(de, dir, return -errno) {
+                if (!GREEDY_REALLOC(d->entries, n_allocated, n + 2))
+                        return -ENOMEM;
+
+                d->entries[n] = strjoin(streq(path, "/") ? "" : path, "/", de->d_name);
+                if (!d->entries[n])
+                        return -ENOMEM;
+
+                d->entries[++n] = NULL;
+        }
+
+        *ret = TAKE_PTR(d);
+        return 0;
+}
+
+static bool unit_path_cache_dir_is_current(UnitPathCacheDir *d, const struct stat *st) {
+        assert(st);
+
+        if (!d)
+                return false;
+
+        if (d->mtime != timespec_load_nsec(&st->st_mtim))
+                return false;
+
+        /* If the directory was modified within a second of when we read it, we cannot be sure that a later
+         * modification would have bumped the mtime on file systems with coarse timestamps. Better read it again. */
+        return timespec_load(&st->st_mtim) + USEC_PER_SEC < d->timestamp;
+}
+
 static void manager_build_unit_path_cache(Manager *m) {
-        char **i;
+        Hashmap *old_dirs = NULL;
+        size_t n_reused = 0;
+        char **i, **j;
         int r;
 
         assert(m);
 
         set_free_free(m->unit_path_cache);
+        unit_template_cache_flush(m);
 
         m->unit_path_cache = set_new(&path_hash_ops);
         if (!m->unit_path_cache) {
@@ -1465,39 +1671,160 @@ static void manager_build_unit_path_cache(Manager *m) {
         }
 
         /* This simply builds a list of files we know exist, so that
-         * we don't always have to go to disk */
+         * we don't always have to go to disk.
+         *
+         * We keep the directory listings from the previous run around, together with the mtime of the directory
+         * they were read from, so that on reloads only directories that actually changed are read again. */
+
+        old_dirs = TAKE_PTR(m->unit_path_cache_dirs);
+
+        m->unit_path_cache_dirs = hashmap_new(&path_hash_ops);
+        if (!m->unit_path_cache_dirs) {
+                r = -ENOMEM;
+                goto fail;
+        }
 
         STRV_FOREACH(i, m->lookup_paths.search_path) {
-                _cleanup_closedir_ DIR *d = NULL;
-                struct dirent *de;
+                _cleanup_(unit_path_cache_dir_freep) UnitPathCacheDir *d = NULL;
+                struct stat st;
+
+                if (hashmap_contains(m->unit_path_cache_dirs, *i))
+                        continue;
 
-                d = opendir(*i);
-                if (!d) {
+                if (stat(*i, &st) < 0) {
                         if (errno != ENOENT)
-                                log_warning_errno(errno, "Failed to open directory %s, ignoring: %m", *i);
+                                log_warning_errno(errno, "Failed to stat directory %s, ignoring: %m", *i);
                         continue;
                 }
 
-                FOREACH_DIRENT(de, d, r = -errno; goto fail) {
-                        char *p;
+                d = hashmap_remove(old_dirs, *i);
+                if (unit_path_cache_dir_is_current(d, &st))
+                        n_reused++;
+                else {
+                        d = unit_path_cache_dir_free(d);
 
-                        p = strjoin(streq(*i, "/") ? "" : *i, "/", de->d_name);
-                        if (!p) {
-                                r = -ENOMEM;
+                        r = unit_path_cache_dir_scan(*i, timespec_load_nsec(&st.st_mtim), &d);
+                        if (r == -ENOENT)
+                                continue;
+                        if (r == -ENOMEM)
                                 goto fail;
+                        if (r < 0) {
+                                log_warning_errno(r, "Failed to read directory %s, ignoring: %m", *i);
+                                continue;
                         }
+                }
 
-                        r = set_consume(m->unit_path_cache, p);
+                STRV_FOREACH(j, d->entries) {
+                        r = set_put_strdup(m->unit_path_cache, *j);
                         if (r < 0)
                                 goto fail;
                 }
+
+                r = hashmap_put(m->unit_path_cache_dirs, d->path, d);
+                if (r < 0)
+                        goto fail;
+
+                TAKE_PTR(d);
         }
 
+        hashmap_free_with_destructor(old_dirs, unit_path_cache_dir_free);
+
+        if (n_reused > 0)
+                log_debug("Reused %zu unchanged unit directory listings for the unit path cache.", n_reused);
+
         return;
 
 fail:
         log_warning_errno(r, "Failed to build unit path cache, proceeding without: %m");
         m->unit_path_cache = set_free_free(m->unit_path_cache);
+        m->unit_path_cache_dirs = hashmap_free_with_destructor(m->unit_path_cache_dirs, unit_path_cache_dir_free);
+        unit_template_cache_flush(m);
+        hashmap_free_with_destructor(old_dirs, unit_path_cache_dir_free);
+}
+
+static void prefetch_file(int dir_fd, const char *path) {
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+
+        fd = openat(dir_fd, path, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+        if (fd < 0)
+                return;
+
+        if (fstat(fd, &st) < 0)
+                return;
+
+        if (S_ISREG(st.st_mode))
+                (void) readahead(fd, 0, st.st_size);
+        else if (S_ISDIR(st.st_mode) && dir_fd == AT_FDCWD) {
+                _cleanup_closedir_ DIR *d = NULL;
+                struct dirent *de;
+
+                /* Drop-in and .wants/ directories: pull in their contents too, but don't descend any further */
+                d = fdopendir(fd);
+                if (!d)
+                        return;
+                fd = -1;
+
+                FOREACH_DIRENT(de, d, return)
+                        prefetch_file(dirfd(d), de->d_name);
+        }
+}
+
+static void *prefetch_thread(void *p) {
+        _cleanup_strv_free_ char **paths = p;
+        char **i;
+
+        STRV_FOREACH(i, paths)
+                prefetch_file(AT_FDCWD, *i);
+
+        return NULL;
+}
+
+static void manager_prefetch_unit_files(Manager *m) {
+        _cleanup_free_ char **paths = NULL;
+        size_t n, n_threads, k;
+        int r;
+
+        assert(m);
+
+        /* Loading units is strictly serial, and on a cold cache most of that time is spent waiting for the disk to
+         * deliver the unit files one by one. Hence, read all files and drop-in directories from the unit path cache
+         * on a couple of threads in the background, so that they are in the page cache by the time we parse them.
+         * This is entirely optional, errors are ignored. */
+
+        n = set_size(m->unit_path_cache);
+        if (n == 0)
+                return;
+
+        n_threads = CLAMP(n / UNIT_FILE_PREFETCH_BATCH, 1U, UNIT_FILE_PREFETCH_THREADS_MAX);
+
+        paths = set_get_strv(m->unit_path_cache); /* Note: the strings are owned by the set */
+        if (!paths)
+                return (void) log_oom();
+
+        for (k = 0; k < n_threads; k++) {
+                _cleanup_strv_free_ char **batch = NULL;
+                size_t j;
+
+                batch = new0(char*, n / n_threads + 2);
+                if (!batch)
+                        return (void) log_oom();
+
+                /* Distribute round-robin, set order is random anyway */
+                for (j = 0; k + j * n_threads < n; j++) {
+                        batch[j] = strdup(paths[k + j * n_threads]);
+                        if (!batch[j])
+                                return (void) log_oom();
+                }
+
+                r = asynchronous_job(prefetch_thread, batch);
+                if (r < 0)
+                        return (void) log_debug_errno(r, "Failed to start unit file prefetch thread, ignoring: %m");
+
+                TAKE_PTR(batch);
+        }
+
+        log_debug("Prefetching %zu unit files and directories on %zu threads.", n, n_threads);
 }
 
 static void manager_distribute_fds(Manager *m, FDSet *fds) {
@@ -1658,6 +1985,7 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
                 log_warning_errno(r, "Failed ot reduce unit file paths, ignoring: %m");
 
         manager_build_unit_path_cache(m);
+        manager_prefetch_unit_files(m);
 
         {
                 /* This block is (optionally) done with the reloading counter bumped */
@@ -1711,6 +2039,11 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
                         log_warning_errno(r, "Failed to deserialized tracked clients, ignoring: %m");
                 m->deserialized_subscribed = strv_free(m->deserialized_subscribed);
 
+                r = bus_track_coldplug(m, &m->subscribed_batched, false, m->deserialized_subscribed_batched);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to deserialized tracked clients, ignoring: %m");
+                m->deserialized_subscribed_batched = strv_free(m->deserialized_subscribed_batched);
+
                 /* Third, fire things up! */
                 manager_coldplug(m);
 
@@ -1729,8 +2062,11 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
 }
 
 int manager_add_job(Manager *m, JobType type, Unit *unit, JobMode mode, sd_bus_error *e, Job **_ret) {
-        int r;
+        char buf1[FORMAT_TIMESPAN_MAX], buf2[FORMAT_TIMESPAN_MAX];
+        usec_t start, built, activated;
         Transaction *tr;
+        unsigned n_jobs;
+        int r;
 
         assert(m);
         assert(type < _JOB_TYPE_MAX);
@@ -1747,6 +2083,8 @@ int manager_add_job(Manager *m, JobType type, Unit *unit, JobMode mode, sd_bus_e
 
         type = job_type_collapse(type, unit);
 
+        start = now(CLOCK_MONOTONIC);
+
         tr = transaction_new(mode == JOB_REPLACE_IRREVERSIBLY);
         if (!tr)
                 return -ENOMEM;
@@ -1763,13 +2101,25 @@ int manager_add_job(Manager *m, JobType type, Unit *unit, JobMode mode, sd_bus_e
                         goto tr_abort;
         }
 
+        built = now(CLOCK_MONOTONIC);
+        n_jobs = hashmap_size(tr->jobs);
+
         r = transaction_activate(tr, m, mode, e);
         if (r < 0)
                 goto tr_abort;
 
+        activated = now(CLOCK_MONOTONIC);
+
+        m->n_transactions++;
+        m->transactions_build_usec += built - start;
+        m->transactions_activate_usec += activated - built;
+        m->transactions_max_usec = MAX(m->transactions_max_usec, activated - start);
+
         log_unit_debug(unit,
-                       "Enqueued job %s/%s as %u", unit->id,
-                       job_type_to_string(type), (unsigned) tr->anchor_job->id);
+                       "Enqueued job %s/%s as %u (transaction of %u jobs built in %s, activated in %s)", unit->id,
+                       job_type_to_string(type), (unsigned) tr->anchor_job->id, n_jobs,
+                       format_timespan(buf1, sizeof(buf1), built - start, 0),
+                       format_timespan(buf2, sizeof(buf2), activated - built, 0));
 
         if (_ret)
                 *_ret = tr->anchor_job;
@@ -1783,6 +2133,93 @@ tr_abort:
         return r;
 }
 
+static bool unit_start_needs_transaction(Unit *u) {
+        static const UnitDependency pull_in[] = {
+                UNIT_REQUIRES,
+                UNIT_BINDS_TO,
+                UNIT_WANTS,
+                UNIT_REQUISITE,
+        }, conflict[] = {
+                UNIT_CONFLICTS,
+                UNIT_CONFLICTED_BY,
+        };
+        UnitDependencyIterator i;
+        Unit *other;
+        size_t k;
+
+        assert(u);
+
+        /* A transaction to start a unit that has no job yet, whose requirements are all up and that conflicts
+         * with nothing that is running ends up with just the start job for the unit itself, as the jobs for
+         * everything else are redundant and dropped again. Anything else is left to the transaction logic. */
+
+        if (MANAGER_IS_RELOADING(u->manager))
+                return true;
+
+        if (u->load_state != UNIT_LOADED || u->job || u->nop_job)
+                return true;
+
+        if (!unit_job_is_applicable(u, JOB_START) || unit_following(u))
+                return true;
+
+        for (k = 0; k < ELEMENTSOF(pull_in); k++)
+                UNIT_FOREACH_DEPENDENCY(other, u, pull_in[k], i)
+                        if (other->load_state != UNIT_LOADED || other->job ||
+                            unit_active_state(other) != UNIT_ACTIVE)
+                                return true;
+
+        for (k = 0; k < ELEMENTSOF(conflict); k++)
+                UNIT_FOREACH_DEPENDENCY(other, u, conflict[k], i)
+                        if (other->job || !UNIT_IS_INACTIVE_OR_FAILED(unit_active_state(other)))
+                                return true;
+
+        return false;
+}
+
+int manager_add_start_job(Manager *m, Unit *unit, sd_bus_error *e, Job **ret) {
+        Job *j;
+        int r;
+
+        assert(m);
+        assert(unit);
+
+        /* Like manager_add_job() for JOB_START in JOB_REPLACE mode, but installs the job right away if the
+         * transaction would consist of just that job anyway. This is cheap enough to be done for each connection
+         * on Accept=yes sockets. */
+
+        if (unit_start_needs_transaction(unit))
+                return manager_add_job(m, JOB_START, unit, JOB_REPLACE, e, ret);
+
+        j = job_new(unit, JOB_START);
+        if (!j)
+                return -ENOMEM;
+
+        r = hashmap_put(m->jobs, UINT32_TO_PTR(j->id), j);
+        if (r < 0) {
+                job_free(j);
+                return r;
+        }
+
+        /* The unit has no job, hence nothing to merge with */
+        assert_se(job_install(j) == j);
+
+        job_add_to_run_queue(j);
+        job_add_to_dbus_queue(j);
+        job_start_timer(j, false);
+        job_shutdown_magic(j);
+
+        manager_open_idle_pipe(m);
+
+        m->n_jobs_without_transaction++;
+
+        log_unit_debug(unit, "Enqueued job %s/%s as %u without transaction", unit->id, job_type_to_string(j->type), (unsigned) j->id);
+
+        if (ret)
+                *ret = j;
+
+        return 0;
+}
+
 int manager_add_job_by_name(Manager *m, JobType type, const char *name, JobMode mode, sd_bus_error *e, Job **ret) {
         Unit *unit = NULL;  /* just to appease gcc, initialization is not really necessary */
         int r;
@@ -1885,10 +2322,9 @@ static int manager_dispatch_target_deps_queue(Manager *m) {
 
                 for (k = 0; k < ELEMENTSOF(deps); k++) {
                         Unit *target;
-                        Iterator i;
-                        void *v;
+                        UnitDependencyIterator i;
 
-                        HASHMAP_FOREACH_KEY(v, target, u->dependencies[deps[k]], i) {
+                        UNIT_FOREACH_DEPENDENCY(target, u, deps[k], i) {
                                 r = unit_add_default_target_dependency(u, target);
                                 if (r < 0)
                                         return r;
@@ -2085,6 +2521,54 @@ void manager_dump(Manager *m, FILE *f, const char *prefix) {
                                 format_timestamp(buf, sizeof(buf), m->timestamps[q].realtime));
         }
 
+        if (m->n_transactions > 0) {
+                char buf1[FORMAT_TIMESPAN_MAX], buf2[FORMAT_TIMESPAN_MAX], buf3[FORMAT_TIMESPAN_MAX];
+
+                fprintf(f,
+                        "%sTransactions: %u\n"
+                        "%sTransactions build time: %s\n"
+                        "%sTransactions activation time: %s\n"
+                        "%sSlowest transaction: %s\n",
+                        strempty(prefix), m->n_transactions,
+                        strempty(prefix), format_timespan(buf1, sizeof(buf1), m->transactions_build_usec, 0),
+                        strempty(prefix), format_timespan(buf2, sizeof(buf2), m->transactions_activate_usec, 0),
+                        strempty(prefix), format_timespan(buf3, sizeof(buf3), m->transactions_max_usec, 0));
+        }
+
+        if (m->n_jobs_without_transaction > 0)
+                fprintf(f, "%sJobs enqueued without transaction: %u\n", strempty(prefix), m->n_jobs_without_transaction);
+
+        if (m->gc_usec > 0) {
+                char buf1[FORMAT_TIMESPAN_MAX], buf2[FORMAT_TIMESPAN_MAX];
+
+                fprintf(f,
+                        "%sUnits garbage collected: %u\n"
+                        "%sGarbage collection time: %s\n"
+                        "%sLongest garbage collection run: %s\n",
+                        strempty(prefix), m->n_gc_units_collected,
+                        strempty(prefix), format_timespan(buf1, sizeof(buf1), m->gc_usec, 0),
+                        strempty(prefix), format_timespan(buf2, sizeof(buf2), m->gc_max_usec, 0));
+        }
+
+        if (m->n_device_events_processed > 0 || m->n_device_events_skipped > 0)
+                fprintf(f,
+                        "%sDevice events processed: %u\n"
+                        "%sDevice events skipped as unchanged: %u\n",
+                        strempty(prefix), m->n_device_events_processed,
+                        strempty(prefix), m->n_device_events_skipped);
+
+        if (m->n_spawned > 0) {
+                char buf1[FORMAT_TIMESPAN_MAX], buf2[FORMAT_TIMESPAN_MAX];
+
+                fprintf(f,
+                        "%sProcesses spawned: %u\n"
+                        "%sTime spent forking: %s\n"
+                        "%sSlowest fork: %s\n",
+                        strempty(prefix), m->n_spawned,
+                        strempty(prefix), format_timespan(buf1, sizeof(buf1), m->spawn_fork_usec, 0),
+                        strempty(prefix), format_timespan(buf2, sizeof(buf2), m->spawn_fork_max_usec, 0));
+        }
+
         manager_dump_units(m, f, prefix);
         manager_dump_jobs(m, f, prefix);
 }
@@ -2127,6 +2611,27 @@ void manager_clear_jobs(Manager *m) {
                 job_finish_and_invalidate(j, JOB_CANCELED, false, false);
 }
 
+static unsigned manager_dispatch_start_queue(Manager *m) {
+        unsigned n = 0;
+        Job *j;
+
+        assert(m);
+
+        /* Moves as many jobs waiting for a free start slot to the run queue as there are free slots */
+
+        while (m->default_start_concurrency == 0 || m->n_starting_jobs + n < m->default_start_concurrency) {
+                j = prioq_pop(m->start_queue);
+                if (!j)
+                        break;
+
+                j->in_start_queue = false;
+                job_add_to_run_queue(j);
+                n++;
+        }
+
+        return n;
+}
+
 static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         Manager *m = userdata;
         Job *j;
@@ -2134,12 +2639,17 @@ static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         assert(source);
         assert(m);
 
-        while ((j = m->run_queue)) {
-                assert(j->installed);
-                assert(j->in_run_queue);
+        do {
+                while ((j = m->run_queue)) {
+                        assert(j->installed);
+                        assert(j->in_run_queue);
 
-                (void) job_run_and_invalidate(j);
-        }
+                        (void) job_run_and_invalidate(j);
+                }
+
+                /* Jobs moved over from the start queue might turn out to be not runnable after all, so repeat until
+                 * all free slots are taken or nothing is waiting anymore. */
+        } while (manager_dispatch_start_queue(m) > 0);
 
         if (m->n_running_jobs > 0)
                 manager_watch_jobs_in_progress(m);
@@ -2163,7 +2673,7 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
                 budget = (unsigned) -1; /* infinite budget in this case */
         else {
                 /* Anything to do at all? */
-                if (!m->dbus_unit_queue && !m->dbus_job_queue)
+                if (!m->dbus_unit_queue && !m->dbus_job_queue && !m->units_changed_queue)
                         return 0;
 
                 /* Do we have overly many messages queued at the moment? If so, let's not enqueue more on top, let's
@@ -2206,6 +2716,13 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
                         budget--;
         }
 
+        /* Clients which asked for batched notifications get one UnitsChanged signal covering all units we sent
+         * change signals for, instead of the individual signals */
+        if (m->units_changed_queue) {
+                bus_manager_send_units_changed(m);
+                n++;
+        }
+
         if (m->send_reloading_done) {
                 m->send_reloading_done = false;
                 bus_manager_send_reloading(m, false);
@@ -2254,6 +2771,7 @@ static void manager_invoke_notify_message(
                 Unit *u,
                 const struct ucred *ucred,
                 const char *buf,
+                bool watchdog_only,
                 FDSet *fds) {
 
         assert(m);
@@ -2265,7 +2783,10 @@ static void manager_invoke_notify_message(
                 return;
         u->notifygen = m->notifygen;
 
-        if (UNIT_VTABLE(u)->notify_message) {
+        if (watchdog_only && UNIT_VTABLE(u)->notify_watchdog)
+                UNIT_VTABLE(u)->notify_watchdog(u, ucred);
+
+        else if (UNIT_VTABLE(u)->notify_message) {
                 _cleanup_strv_free_ char **tags = NULL;
 
                 tags = strv_split(buf, NEWLINE);
@@ -2287,56 +2808,21 @@ static void manager_invoke_notify_message(
         }
 }
 
-static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
-
+static void manager_process_notify_datagram(Manager *m, char *buf, size_t n, struct msghdr *msghdr) {
         _cleanup_fdset_free_ FDSet *fds = NULL;
-        Manager *m = userdata;
-        char buf[NOTIFY_BUFFER_MAX+1];
-        struct iovec iovec = {
-                .iov_base = buf,
-                .iov_len = sizeof(buf)-1,
-        };
-        union {
-                struct cmsghdr cmsghdr;
-                uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) +
-                            CMSG_SPACE(sizeof(int) * NOTIFY_FD_MAX)];
-        } control = {};
-        struct msghdr msghdr = {
-                .msg_iov = &iovec,
-                .msg_iovlen = 1,
-                .msg_control = &control,
-                .msg_controllen = sizeof(control),
-        };
-
         struct cmsghdr *cmsg;
         struct ucred *ucred = NULL;
         _cleanup_free_ Unit **array_copy = NULL;
         Unit *u1, *u2, **array;
         int r, *fd_array = NULL;
         size_t n_fds = 0;
-        bool found = false;
-        ssize_t n;
+        bool found = false, watchdog_only;
 
         assert(m);
-        assert(m->notify_fd == fd);
-
-        if (revents != EPOLLIN) {
-                log_warning("Got unexpected poll event for notify fd.");
-                return 0;
-        }
-
-        n = recvmsg(m->notify_fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC);
-        if (n < 0) {
-                if (IN_SET(errno, EAGAIN, EINTR))
-                        return 0; /* Spurious wakeup, try again */
-
-                /* If this is any other, real error, then let's stop processing this socket. This of course means we
-                 * won't take notification messages anymore, but that's still better than busy looping around this:
-                 * being woken up over and over again but being unable to actually read the message off the socket. */
-                return log_error_errno(errno, "Failed to receive notification message: %m");
-        }
+        assert(buf);
+        assert(msghdr);
 
-        CMSG_FOREACH(cmsg, &msghdr) {
+        CMSG_FOREACH(cmsg, msghdr) {
                 if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
 
                         fd_array = (int*) CMSG_DATA(cmsg);
@@ -2357,30 +2843,34 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
                 if (r < 0) {
                         close_many(fd_array, n_fds);
                         log_oom();
-                        return 0;
+                        return;
                 }
         }
 
         if (!ucred || !pid_is_valid(ucred->pid)) {
                 log_warning("Received notify message without valid credentials. Ignoring.");
-                return 0;
+                return;
         }
 
-        if ((size_t) n >= sizeof(buf) || (msghdr.msg_flags & MSG_TRUNC)) {
+        if (n > NOTIFY_BUFFER_MAX || (msghdr->msg_flags & MSG_TRUNC)) {
                 log_warning("Received notify message exceeded maximum size. Ignoring.");
-                return 0;
+                return;
         }
 
         /* As extra safety check, let's make sure the string we get doesn't contain embedded NUL bytes. We permit one
          * trailing NUL byte in the message, but don't expect it. */
         if (n > 1 && memchr(buf, 0, n-1)) {
                 log_warning("Received notify message with embedded NUL bytes. Ignoring.");
-                return 0;
+                return;
         }
 
         /* Make sure it's NUL-terminated. */
         buf[n] = 0;
 
+        /* Plain watchdog keep-alive pings are by far the most frequent messages we get, let's recognize them right
+         * away so that the units can skip the generic parsing for them. */
+        watchdog_only = fdset_size(fds) <= 0 && STR_IN_SET(buf, "WATCHDOG=1", "WATCHDOG=1\n");
+
         /* Increase the generation counter used for filtering out duplicate unit invocations. */
         m->notifygen++;
 
@@ -2401,16 +2891,16 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         /* And now invoke the per-unit callbacks. Note that manager_invoke_notify_message() will handle duplicate units
          * make sure we only invoke each unit's handler once. */
         if (u1) {
-                manager_invoke_notify_message(m, u1, ucred, buf, fds);
+                manager_invoke_notify_message(m, u1, ucred, buf, watchdog_only, fds);
                 found = true;
         }
         if (u2) {
-                manager_invoke_notify_message(m, u2, ucred, buf, fds);
+                manager_invoke_notify_message(m, u2, ucred, buf, watchdog_only, fds);
                 found = true;
         }
         if (array_copy)
                 for (size_t i = 0; array_copy[i]; i++) {
-                        manager_invoke_notify_message(m, array_copy[i], ucred, buf, fds);
+                        manager_invoke_notify_message(m, array_copy[i], ucred, buf, watchdog_only, fds);
                         found = true;
                 }
 
@@ -2419,6 +2909,53 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
 
         if (fdset_size(fds) > 0)
                 log_warning("Got extra auxiliary fds with notification message, closing them.");
+}
+
+static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        Manager *m = userdata;
+        size_t i;
+        int k;
+
+        assert(m);
+        assert(m->notify_fd == fd);
+        assert(m->notify_batch);
+        assert(m->notify_slots);
+
+        if (revents != EPOLLIN) {
+                log_warning("Got unexpected poll event for notify fd.");
+                return 0;
+        }
+
+        /* Read as many datagrams as we have slots for in one go. If there are more queued than that, the event loop
+         * will wake us up again right away, after giving other event sources of the same priority a chance to run. */
+        for (i = 0; i < NOTIFY_BATCH_MAX; i++) {
+                struct NotifySlot *slot = m->notify_slots + i;
+
+                slot->iovec = IOVEC_MAKE(slot->buffer, sizeof(slot->buffer) - 1); /* Leave room for trailing NUL */
+
+                m->notify_batch[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = &slot->iovec,
+                                .msg_iovlen = 1,
+                                .msg_control = &slot->control,
+                                .msg_controllen = sizeof(slot->control),
+                        },
+                };
+        }
+
+        k = recvmmsg(m->notify_fd, m->notify_batch, NOTIFY_BATCH_MAX, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC, NULL);
+        if (k < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0; /* Spurious wakeup, try again */
+
+                /* If this is any other, real error, then let's stop processing this socket. This of course means we
+                 * won't take notification messages anymore, but that's still better than busy looping around this:
+                 * being woken up over and over again but being unable to actually read the message off the socket. */
+                return log_error_errno(errno, "Failed to receive notification message: %m");
+        }
+
+        for (i = 0; i < (size_t) k; i++)
+                manager_process_notify_datagram(m, m->notify_slots[i].buffer, m->notify_batch[i].msg_len, &m->notify_batch[i].msg_hdr);
 
         return 0;
 }
@@ -2862,6 +3399,10 @@ int manager_loop(Manager *m) {
         if (r < 0)
                 return log_error_errno(r, "Failed to enable SIGCHLD event source: %m");
 
+        /* Messages logged while processing an event are sent to the journal in one go before we wait for the
+         * next one, instead of one by one */
+        (void) log_queue_enable(LOG_QUEUE_MAX);
+
         while (m->objective == MANAGER_OK) {
                 usec_t wait_usec;
 
@@ -2895,6 +3436,11 @@ int manager_loop(Manager *m) {
                 if (manager_dispatch_dbus_queue(m) > 0)
                         continue;
 
+                /* Write out transient unit files only now, after the replies to the requests that created them
+                 * have been sent */
+                if (manager_dispatch_transient_write_queue(m) > 0)
+                        continue;
+
                 /* Sleep for half the watchdog time */
                 if (m->runtime_watchdog > 0 && m->runtime_watchdog != USEC_INFINITY && MANAGER_IS_SYSTEM(m)) {
                         wait_usec = m->runtime_watchdog / 2;
@@ -2903,11 +3449,24 @@ int manager_loop(Manager *m) {
                 } else
                         wait_usec = USEC_INFINITY;
 
+                /* If we stopped garbage collecting units half-way, don't wait, but continue right after processing
+                 * what is pending */
+                if (m->gc_unit_queue_throttled)
+                        wait_usec = 0;
+
+                (void) log_queue_flush();
+
                 r = sd_event_run(m->event, wait_usec);
-                if (r < 0)
+                if (r < 0) {
+                        log_queue_disable();
                         return log_error_errno(r, "Failed to run event loop: %m");
+                }
+
+                m->gc_unit_queue_throttled = false;
         }
 
+        log_queue_disable();
+
         return m->objective;
 }
 
@@ -3121,9 +3680,14 @@ int manager_serialize(
 
         _cleanup_(manager_reloading_stopp) _unused_ Manager *reloading = manager_reloading_start(m);
 
+        /* Units are loaded from disk again after the reload or reexec, hence make sure all transient unit files
+         * are there */
+        (void) manager_dispatch_transient_write_queue(m);
+
         (void) serialize_item_format(f, "current-job-id", "%" PRIu32, m->current_job_id);
         (void) serialize_item_format(f, "n-installed-jobs", "%u", m->n_installed_jobs);
         (void) serialize_item_format(f, "n-failed-jobs", "%u", m->n_failed_jobs);
+        (void) serialize_item_format(f, "unit-generation", "%" PRIu64, m->unit_generation);
         (void) serialize_bool(f, "taint-usr", m->taint_usr);
         (void) serialize_bool(f, "ready-sent", m->ready_sent);
         (void) serialize_bool(f, "taint-logged", m->taint_logged);
@@ -3183,6 +3747,7 @@ int manager_serialize(
         }
 
         bus_track_serialize(m->subscribed, f, "subscribed");
+        bus_track_serialize(m->subscribed_batched, f, "subscribed-batched");
 
         r = dynamic_user_serialize(m, f, fds);
         if (r < 0)
@@ -3321,6 +3886,17 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
                         else
                                 m->n_failed_jobs += n;
 
+                } else if ((val = startswith(l, "unit-generation="))) {
+                        uint64_t n;
+
+                        if (safe_atou64(val, &n) < 0)
+                                log_notice("Failed to parse unit generation counter '%s', ignoring.", val);
+                        else {
+                                /* We don't know which units were removed before, hence make clients start over */
+                                m->unit_generation = MAX(m->unit_generation, n);
+                                m->units_removed_forgotten = ++m->unit_generation;
+                        }
+
                 } else if ((val = startswith(l, "taint-usr="))) {
                         int b;
 
@@ -3441,6 +4017,11 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
                         if (strv_extend(&m->deserialized_subscribed, val) < 0)
                                 return -ENOMEM;
 
+                } else if ((val = startswith(l, "subscribed-batched="))) {
+
+                        if (strv_extend(&m->deserialized_subscribed_batched, val) < 0)
+                                return -ENOMEM;
+
                 } else {
                         ManagerTimestamp q;
 
@@ -3519,6 +4100,7 @@ int manager_reload(Manager *m) {
                 log_warning_errno(r, "Failed ot reduce unit file paths, ignoring: %m");
 
         manager_build_unit_path_cache(m);
+        manager_prefetch_unit_files(m);
 
         /* First, enumerate what we can from kernel and suchlike */
         manager_enumerate_perpetual(m);
@@ -3553,6 +4135,275 @@ int manager_reload(Manager *m) {
         return 0;
 }
 
+typedef struct ReloadDependency {
+        Unit *source;
+        UnitDependency dependency;
+        UnitDependencyMask mask;
+        size_t target; /* index into the list of reloaded unit names */
+} ReloadDependency;
+
+typedef struct ReloadRef {
+        UnitRef *ref;
+        Unit *source;
+        size_t target;
+} ReloadRef;
+
+static bool unit_can_reload_incremental(Unit *u) {
+        assert(u);
+
+        /* Units with jobs, aliases, or state that is rebuilt from the kernel on a full reload (mounts, swaps,
+         * devices, …) are not reloaded in place. */
+
+        if (u->job || u->nop_job)
+                return false;
+
+        if (u->perpetual || u->transient)
+                return false;
+
+        if (set_size(u->names) > 1)
+                return false;
+
+        if (!IN_SET(u->load_state, UNIT_LOADED, UNIT_NOT_FOUND, UNIT_BAD_SETTING, UNIT_ERROR, UNIT_MASKED))
+                return false;
+
+        return IN_SET(u->type, UNIT_SERVICE, UNIT_SOCKET, UNIT_TARGET, UNIT_TIMER, UNIT_PATH, UNIT_SLICE);
+}
+
+int manager_reload_incremental(Manager *m) {
+        _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
+        _cleanup_free_ ReloadDependency *deps = NULL;
+        _cleanup_free_ ReloadRef *refs = NULL;
+        _cleanup_free_ ExecRuntime **runtimes = NULL;
+        size_t n_deps = 0, n_allocated_deps = 0, n_refs = 0, n_allocated_refs = 0, n_runtimes = 0, idx;
+        _cleanup_set_free_ Set *units = NULL, *seen = NULL;
+        _cleanup_strv_free_ char **names = NULL;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        Iterator i;
+        char **n;
+        Unit *u;
+        char *k;
+        int r;
+
+        assert(m);
+
+        /* Reloads only the units whose unit files, drop-ins or .wants/ and .requires/ directories changed since they
+         * were loaded. Everything else stays in place. Generators are not rerun, the list of unit directories and
+         * the manager configuration are not reread: for those a full reload is needed. If some changed unit cannot
+         * be reloaded on its own, returns 1 without having changed anything, and the caller has to do a full
+         * reload instead. */
+
+        reloading = manager_reloading_start(m);
+
+        (void) manager_dispatch_transient_write_queue(m);
+
+        manager_build_unit_path_cache(m);
+
+        units = set_new(NULL);
+        if (!units)
+                return log_oom();
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                if (u->id != k)
+                        continue;
+
+                if (!unit_changed_on_disk(u))
+                        continue;
+
+                if (!unit_can_reload_incremental(u)) {
+                        log_unit_info(u, "Unit changed on disk and cannot be reloaded on its own, doing a full reload.");
+                        return 1;
+                }
+
+                r = strv_extend(&names, u->id);
+                if (r < 0)
+                        return log_oom();
+
+                r = set_put(units, u);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        if (strv_isempty(names)) {
+                log_info("No unit files changed, nothing to reload.");
+                m->objective = MANAGER_OK;
+                return 0;
+        }
+
+        runtimes = new(ExecRuntime*, strv_length(names));
+        if (!runtimes)
+                return log_oom();
+
+        seen = set_new(NULL);
+        if (!seen)
+                return log_oom();
+
+        r = manager_open_serialization(m, &f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create serialization file: %m");
+
+        fds = fdset_new();
+        if (!fds)
+                return log_oom();
+
+        /* First, remember everything that other units hold on the units we are going to reload: dependencies they
+         * created themselves and UnitRef references. Reloading the unit itself recreates everything else. */
+        idx = 0;
+        STRV_FOREACH(n, names) {
+                UnitDependencyIterator di;
+                ExecRuntime *rt;
+                UnitDependency d;
+                UnitRef *ref;
+                Unit *other;
+
+                u = manager_get_unit(m, *n);
+                assert(u);
+
+                set_clear(seen);
+
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
+                        UNIT_FOREACH_DEPENDENCY(other, u, d, di) {
+                                UnitDependency e;
+
+                                if (set_contains(units, other))
+                                        continue;
+
+                                r = set_put(seen, other);
+                                if (r < 0)
+                                        return log_oom();
+                                if (r == 0)
+                                        continue;
+
+                                for (e = 0; e < _UNIT_DEPENDENCY_MAX; e++) {
+                                        UnitDependencyInfo info;
+
+                                        info = unit_get_dependency_info(other, e, u);
+                                        if (info.origin_mask == 0)
+                                                continue;
+
+                                        if (!GREEDY_REALLOC(deps, n_allocated_deps, n_deps + 1))
+                                                return log_oom();
+
+                                        deps[n_deps++] = (ReloadDependency) {
+                                                .source = other,
+                                                .dependency = e,
+                                                .mask = info.origin_mask,
+                                                .target = idx,
+                                        };
+                                }
+                        }
+
+                LIST_FOREACH(refs_by_target, ref, u->refs_by_target) {
+                        if (set_contains(units, ref->source))
+                                continue;
+
+                        if (!GREEDY_REALLOC(refs, n_allocated_refs, n_refs + 1))
+                                return log_oom();
+
+                        refs[n_refs++] = (ReloadRef) {
+                                .ref = ref,
+                                .source = ref->source,
+                                .target = idx,
+                        };
+                }
+
+                /* Keep the runtime directories and namespaces around while the unit is gone */
+                rt = unit_get_exec_runtime(u);
+                if (rt && exec_runtime_acquire(m, NULL, rt->id, false, &rt) > 0)
+                        runtimes[n_runtimes++] = rt;
+
+                fputs(u->id, f);
+                fputc('\n', f);
+
+                r = unit_serialize(u, f, fds, false);
+                if (r < 0)
+                        goto fail;
+
+                idx++;
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0) {
+                log_error_errno(r, "Failed to flush serialization: %m");
+                goto fail;
+        }
+
+        if (fseeko(f, 0, SEEK_SET) < 0) {
+                r = log_error_errno(errno, "Failed to seek to beginning of serialization: %m");
+                goto fail;
+        }
+
+        /* 💀 This is the point of no return, from here on there is no way back. 💀 */
+        reloading = NULL;
+
+        bus_manager_send_reloading(m, true);
+
+        log_info("Reloading %zu changed units.", strv_length(names));
+
+        STRV_FOREACH(n, names)
+                unit_free(manager_get_unit(m, *n));
+
+        /* Load the units again and put back their state */
+        r = manager_deserialize_units(m, f, fds);
+        if (r < 0)
+                log_warning_errno(r, "Deserialization failed, proceeding anyway: %m");
+
+        f = safe_fclose(f);
+
+        for (idx = 0; idx < n_deps; idx++) {
+                u = manager_get_unit(m, names[deps[idx].target]);
+                if (!u)
+                        continue;
+
+                r = unit_add_dependency(deps[idx].source, deps[idx].dependency, u, false, deps[idx].mask);
+                if (r < 0)
+                        log_unit_warning_errno(deps[idx].source, r, "Failed to restore dependency on %s, ignoring: %m", u->id);
+        }
+
+        for (idx = 0; idx < n_refs; idx++) {
+                u = manager_get_unit(m, names[refs[idx].target]);
+                if (u)
+                        unit_ref_set(refs[idx].ref, refs[idx].source, u);
+        }
+
+        STRV_FOREACH(n, names) {
+                u = manager_get_unit(m, *n);
+                if (!u)
+                        continue;
+
+                r = unit_coldplug(u);
+                if (r < 0)
+                        log_unit_warning_errno(u, r, "We couldn't coldplug unit, proceeding anyway: %m");
+        }
+
+        for (idx = 0; idx < n_runtimes; idx++)
+                (void) exec_runtime_unref(runtimes[idx], false);
+
+        manager_vacuum(m);
+
+        assert(m->n_reloading > 0);
+        m->n_reloading--;
+
+        m->objective = MANAGER_OK;
+
+        (void) manager_enqueue_sync_bus_names(m);
+
+        STRV_FOREACH(n, names) {
+                u = manager_get_unit(m, *n);
+                if (u)
+                        unit_catchup(u);
+        }
+
+        m->send_reloading_done = true;
+        return 0;
+
+fail:
+        for (idx = 0; idx < n_runtimes; idx++)
+                (void) exec_runtime_unref(runtimes[idx], false);
+
+        return r;
+}
+
 void manager_reset_failed(Manager *m) {
         Unit *u;
         Iterator i;
@@ -3817,6 +4668,8 @@ static int manager_run_environment_generators(Manager *m) {
 
 static int manager_run_generators(Manager *m) {
         _cleanup_strv_free_ char **paths = NULL;
+        ExecTiming *timings = NULL;
+        size_t n_timings = 0;
         const char *argv[5];
         int r;
 
@@ -3845,8 +4698,15 @@ static int manager_run_generators(Manager *m) {
         argv[4] = NULL;
 
         RUN_WITH_UMASK(0022)
-                (void) execute_directories((const char* const*) paths, DEFAULT_TIMEOUT_USEC,
-                                           NULL, NULL, (char**) argv, m->transient_environment);
+                r = execute_directories_full((const char* const*) paths, DEFAULT_TIMEOUT_USEC, m->generator_timeout_usec,
+                                             NULL, NULL, (char**) argv, m->transient_environment,
+                                             &timings, &n_timings);
+        if (r >= 0) {
+                /* Remember how long each generator took, for "systemd-analyze generator-timing" */
+                exec_timing_free_many(m->generator_timings, m->n_generator_timings);
+                m->generator_timings = timings;
+                m->n_generator_timings = n_timings;
+        }
 
         r = 0;
 
@@ -4183,6 +5043,38 @@ int manager_update_failed_units(Manager *m, Unit *u, bool failed) {
         return 0;
 }
 
+void manager_record_removed_unit(Manager *m, const char *id) {
+        _cleanup_free_ char *s = NULL;
+
+        assert(m);
+        assert(id);
+
+        /* All units are removed and loaded again on reload, there's no point in recording all of them. Instead
+         * make everybody who asks ListUnitsChangedSince() for an older generation start over. */
+        if (MANAGER_IS_RELOADING(m))
+                goto forget;
+
+        /* Drop the older half if we remember too many, so that this doesn't happen on every removal */
+        if (m->n_units_removed >= MANAGER_UNITS_REMOVED_MAX)
+                manager_forget_removed_units(m, m->n_units_removed / 2);
+
+        s = strdup(id);
+        if (!s)
+                goto forget;
+
+        if (!GREEDY_REALLOC(m->units_removed, m->n_units_removed_allocated, m->n_units_removed + 1))
+                goto forget;
+
+        m->units_removed[m->n_units_removed++] = (RemovedUnit) {
+                .id = TAKE_PTR(s),
+                .generation = ++m->unit_generation,
+        };
+        return;
+
+forget:
+        m->units_removed_forgotten = ++m->unit_generation;
+}
+
 ManagerState manager_state(Manager *m) {
         Unit *u;
 
@@ -9,10 +9,12 @@
 #include "sd-event.h"
 
 #include "cgroup-util.h"
+#include "exec-util.h"
 #include "fdset.h"
 #include "hashmap.h"
 #include "ip-address-access.h"
 #include "list.h"
+#include "prioq.h"
 #include "ratelimit.h"
 
 struct libmnt_monitor;
@@ -21,6 +23,9 @@ typedef struct Unit Unit;
 /* Enforce upper limit how many names we allow */
 #define MANAGER_MAX_NAMES 131072 /* 128K */
 
+/* How many removed units to remember for ListUnitsChangedSince() */
+#define MANAGER_UNITS_REMOVED_MAX 4096U
+
 typedef struct Manager Manager;
 
 /* An externally visible state. We don't actually maintain this as state variable, but derive it from various fields
@@ -40,6 +45,7 @@ typedef enum ManagerObjective {
         MANAGER_OK,
         MANAGER_EXIT,
         MANAGER_RELOAD,
+        MANAGER_RELOAD_INCREMENTAL,
         MANAGER_REEXECUTE,
         MANAGER_REBOOT,
         MANAGER_POWEROFF,
@@ -119,6 +125,11 @@ typedef enum ManagerTestRunFlags {
 
 assert_cc((MANAGER_TEST_FULL & UINT8_MAX) == MANAGER_TEST_FULL);
 
+typedef struct RemovedUnit {
+        char *id;
+        uint64_t generation;
+} RemovedUnit;
+
 struct Manager {
         /* Note that the set of units we know of is allowed to be
          * inconsistent. However the subset of it that is loaded may
@@ -139,6 +150,10 @@ struct Manager {
         /* Jobs that need to be run */
         LIST_HEAD(Job, run_queue);   /* more a stack than a queue, too */
 
+        /* Start jobs that are runnable, but wait for a free slot, see DefaultStartConcurrency=. Ordered by
+         * priority. */
+        Prioq *start_queue;
+
         /* Units and jobs that have not yet been announced via
          * D-Bus. When something about a job changes it is added here
          * if it is not in there yet. This allows easy coalescing of
@@ -159,12 +174,21 @@ struct Manager {
         /* Units whose cgroup ran empty */
         LIST_HEAD(Unit, cgroup_empty_queue);
 
+        /* Units we got a cgroup notification for, whose cgroup we still need to check for emptiness */
+        LIST_HEAD(Unit, cgroup_empty_check_queue);
+
         /* Target units whose default target dependencies haven't been set yet */
         LIST_HEAD(Unit, target_deps_queue);
 
         /* Units that might be subject to StopWhenUnneeded= clean-up */
         LIST_HEAD(Unit, stop_when_unneeded_queue);
 
+        /* Units we sent change signals for, that still need to be included in a UnitsChanged signal */
+        LIST_HEAD(Unit, units_changed_queue);
+
+        /* Transient units whose unit file has not been written to disk yet */
+        LIST_HEAD(Unit, transient_write_queue);
+
         sd_event *event;
 
         /* This maps PIDs we care about to units that are interested in. We allow multiple units to he interested in
@@ -182,11 +206,23 @@ struct Manager {
         /* A set which contains all currently failed units */
         Set *failed_units;
 
+        /* Increased whenever anything ListUnits() reports about a unit changes, and stored in the unit, so
+         * that ListUnitsChangedSince() can tell clients just what changed since they last asked */
+        uint64_t unit_generation;
+
+        /* Recently removed units with the generation of their removal, oldest first. Removals older than
+         * units_removed_forgotten are not known anymore. */
+        RemovedUnit *units_removed;
+        size_t n_units_removed, n_units_removed_allocated;
+        uint64_t units_removed_forgotten;
+
         sd_event_source *run_queue_event_source;
 
         char *notify_socket;
         int notify_fd;
         sd_event_source *notify_event_source;
+        struct mmsghdr *notify_batch;
+        struct NotifySlot *notify_slots;
 
         int cgroups_agent_fd;
         sd_event_source *cgroups_agent_event_source;
@@ -211,6 +247,8 @@ struct Manager {
         UnitFileScope unit_file_scope;
         LookupPaths lookup_paths;
         Set *unit_path_cache;
+        Hashmap *unit_path_cache_dirs; /* the directory listings unit_path_cache was built from, by path */
+        Hashmap *unit_template_cache;  /* templates instances were loaded from, valid as long as unit_path_cache */
 
         char **transient_environment;  /* The environment, as determined from config files, kernel cmdline and environment generators */
         char **client_environment;     /* Environment variables created by clients through the bus API */
@@ -220,13 +258,23 @@ struct Manager {
 
         dual_timestamp timestamps[_MANAGER_TIMESTAMP_MAX];
 
+        /* How many transactions we enqueued, and how long building and activating them took, in total and for the
+         * slowest one. Shown in the state dump. */
+        unsigned n_transactions;
+        usec_t transactions_build_usec;
+        usec_t transactions_activate_usec;
+        usec_t transactions_max_usec;
+        unsigned n_jobs_without_transaction; /* see manager_add_start_job() */
+
         /* Data specific to the device subsystem */
         sd_device_monitor *device_monitor;
         Hashmap *devices_by_sysfs;
+        unsigned n_device_events_processed, n_device_events_skipped; /* Shown in the state dump */
 
         /* Data specific to the mount subsystem */
         struct libmnt_monitor *mount_monitor;
         sd_event_source *mount_event_source;
+        OrderedHashmap *mountinfo_entries; /* mount point → MountinfoEntry, as of the last time we looked */
 
         /* Data specific to the swap filesystem */
         FILE *proc_swaps;
@@ -246,6 +294,11 @@ struct Manager {
         sd_bus_track *subscribed;
         char **deserialized_subscribed;
 
+        /* Clients on the API bus that asked for one UnitsChanged signal per batch of unit changes instead of the
+         * individual per-unit signals. */
+        sd_bus_track *subscribed_batched;
+        char **deserialized_subscribed_batched;
+
         /* This is used during reloading: before the reload we queue
          * the reply message here, and afterwards we send it */
         sd_bus_message *pending_reload_message;
@@ -270,6 +323,27 @@ struct Manager {
         sd_event_source *cgroup_inotify_event_source;
         Hashmap *cgroup_inotify_wd_unit;
 
+        /* Units we couldn't add an inotify watch for, because we ran out of watches. These are checked whenever
+         * the slice they are located in reports a change, and get a watch of their own as soon as one frees up. */
+        Set *cgroup_inotify_unwatched;
+        bool cgroup_inotify_exhausted;
+
+        /* BPF firewall programs shared between units with identical access lists, keyed by these lists */
+        Hashmap *bpf_firewall_shared;
+
+        /* BPF device control programs shared between units, keyed by their instructions */
+        Hashmap *bpf_devices_shared;
+
+        /* If non-zero, accounting data of all units is read at this interval, and served from that cache */
+        usec_t accounting_sample_usec;
+        sd_event_source *accounting_sample_event_source;
+
+        /* Generators running longer than this are killed. How long each generator took the last time they were
+         * run is kept in generator_timings. */
+        usec_t generator_timeout_usec;
+        ExecTiming *generator_timings;
+        size_t n_generator_timings;
+
         /* A defer event for handling cgroup empty events and processing them after SIGCHLD in all cases. */
         sd_event_source *cgroup_empty_event_source;
 
@@ -279,6 +353,18 @@ struct Manager {
 
         unsigned gc_marker;
 
+        /* How many units the GC collected, and how long it took in total and for the longest run. Shown in the state
+         * dump. */
+        unsigned n_gc_units_collected;
+        usec_t gc_usec;
+        usec_t gc_max_usec;
+
+        /* How many processes exec_spawn() forked off, and how long fork() took in total and at most. The latter grows
+         * with our own memory footprint. Shown in the state dump. */
+        unsigned n_spawned;
+        usec_t spawn_fork_usec;
+        usec_t spawn_fork_max_usec;
+
         /* The stat() data the last time we saw /etc/localtime */
         usec_t etc_localtime_mtime;
         bool etc_localtime_accessible:1;
@@ -288,6 +374,9 @@ struct Manager {
         /* Flags */
         bool dispatching_load_queue:1;
 
+        /* Did the GC run out of budget, and is waiting for the event loop to run once before it continues? */
+        bool gc_unit_queue_throttled:1;
+
         bool taint_usr:1;
 
         /* Have we already sent out the READY=1 notification? */
@@ -317,6 +406,7 @@ struct Manager {
 
         usec_t default_start_limit_interval;
         unsigned default_start_limit_burst;
+        unsigned default_start_concurrency;
 
         bool default_cpu_accounting;
         bool default_memory_accounting;
@@ -343,6 +433,7 @@ struct Manager {
 
         /* Jobs in progress watching */
         unsigned n_running_jobs;
+        unsigned n_starting_jobs; /* Running start jobs that count towards DefaultStartConcurrency= */
         unsigned n_on_console;
         unsigned jobs_in_progress_iteration;
 
@@ -351,6 +442,12 @@ struct Manager {
         int ask_password_inotify_fd;
         sd_event_source *ask_password_event_source;
 
+        /* The inotify instance shared by all path specs, see path.c */
+        int path_inotify_fd;
+        sd_event_source *path_inotify_event_source;
+        Hashmap *path_watches;                   /* wd → PathWatch */
+        struct PathSpec *path_specs_pending;     /* specs that got events, to be dispatched */
+
         /* Type=idle pipes */
         int idle_pipe[4];
         sd_event_source *idle_pipe_event_source;
@@ -376,6 +473,9 @@ struct Manager {
         /* ExecRuntime, indexed by their owner unit id */
         Hashmap *exec_runtime_by_id;
 
+        /* RootImage= images shared between units, indexed by the image path */
+        Hashmap *image_mounts;
+
         /* When the user hits C-A-D more than 7 times per 2s, do something immediately... */
         RateLimit ctrl_alt_del_ratelimit;
         EmergencyAction cad_burst_action;
@@ -428,6 +528,7 @@ int manager_load_unit_from_dbus_path(Manager *m, const char *s, sd_bus_error *e,
 int manager_add_job(Manager *m, JobType type, Unit *unit, JobMode mode, sd_bus_error *e, Job **_ret);
 int manager_add_job_by_name(Manager *m, JobType type, const char *name, JobMode mode, sd_bus_error *e, Job **_ret);
 int manager_add_job_by_name_and_warn(Manager *m, JobType type, const char *name, JobMode mode, Job **ret);
+int manager_add_start_job(Manager *m, Unit *unit, sd_bus_error *e, Job **ret);
 int manager_propagate_reload(Manager *m, Unit *unit, JobMode mode, sd_bus_error *e);
 
 void manager_dump_units(Manager *s, FILE *f, const char *prefix);
@@ -437,6 +538,8 @@ int manager_get_dump_string(Manager *m, char **ret);
 
 void manager_clear_jobs(Manager *m);
 
+void manager_open_idle_pipe(Manager *m);
+
 unsigned manager_dispatch_load_queue(Manager *m);
 
 int manager_default_environment(Manager *m);
@@ -454,6 +557,7 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root);
 int manager_deserialize(Manager *m, FILE *f, FDSet *fds);
 
 int manager_reload(Manager *m);
+int manager_reload_incremental(Manager *m);
 
 void manager_reset_failed(Manager *m);
 
@@ -478,6 +582,7 @@ Set *manager_get_units_requiring_mounts_for(Manager *m, const char *path);
 ManagerState manager_state(Manager *m);
 
 int manager_update_failed_units(Manager *m, Unit *u, bool failed);
+void manager_record_removed_unit(Manager *m, const char *id);
 
 void manager_unref_uid(Manager *m, uid_t uid, bool destroy_now);
 int manager_ref_uid(Manager *m, uid_t uid, bool clean_ipc);
@@ -1563,7 +1563,8 @@ static int mount_setup_unit(
                 const char *where,
                 const char *options,
                 const char *fstype,
-                bool set_flags) {
+                bool set_flags,
+                Unit **ret) {
 
         _cleanup_free_ char *e = NULL;
         MountProcFlags flags;
@@ -1575,6 +1576,9 @@ static int mount_setup_unit(
         assert(where);
         assert(options);
         assert(fstype);
+        assert(ret);
+
+        *ret = NULL;
 
         /* Ignore API mount points. They should never be referenced in
          * dependencies ever. */
@@ -1609,12 +1613,34 @@ static int mount_setup_unit(
         if (set_flags)
                 MOUNT(u)->proc_flags = flags;
 
+        *ret = u;
         return 0;
 }
 
+typedef struct MountinfoEntry {
+        char **fields; /* what, options and fstype of each fs mounted at this point, in mount order */
+        char *unit;    /* The mount unit we set up for this, if any */
+} MountinfoEntry;
+
+static MountinfoEntry* mountinfo_entry_free(MountinfoEntry *e) {
+        if (!e)
+                return NULL;
+
+        strv_free(e->fields);
+        free(e->unit);
+        return mfree(e);
+}
+
+DEFINE_PRIVATE_HASH_OPS_FULL(mountinfo_entry_hash_ops, char, string_hash_func, string_compare_func, free,
+                             MountinfoEntry, mountinfo_entry_free);
+
 static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
         _cleanup_(mnt_free_tablep) struct libmnt_table *t = NULL;
         _cleanup_(mnt_free_iterp) struct libmnt_iter *i = NULL;
+        _cleanup_ordered_hashmap_free_ OrderedHashmap *entries = NULL;
+        MountinfoEntry *e;
+        Iterator j;
+        const char *p;
         int r;
 
         assert(m);
@@ -1628,10 +1654,16 @@ static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
         if (r < 0)
                 return log_error_errno(r, "Failed to parse /proc/self/mountinfo: %m");
 
+        entries = ordered_hashmap_new(&mountinfo_entry_hash_ops);
+        if (!entries)
+                return log_oom();
+
+        /* First, group all file systems by their mount point, so that we can compare them to what we saw the last
+         * time. Mount changes usually affect only a handful of entries, even with thousands of mounts around. */
         for (;;) {
                 struct libmnt_fs *fs;
                 const char *device, *path, *options, *fstype;
-                _cleanup_free_ char *d = NULL, *p = NULL;
+                _cleanup_free_ char *d = NULL, *q = NULL;
                 int k;
 
                 k = mnt_table_next_fs(t, i, &fs);
@@ -1651,14 +1683,68 @@ static int mount_load_proc_self_mountinfo(Manager *m, bool set_flags) {
                 if (cunescape(device, UNESCAPE_RELAX, &d) < 0)
                         return log_oom();
 
-                if (cunescape(path, UNESCAPE_RELAX, &p) < 0)
+                if (cunescape(path, UNESCAPE_RELAX, &q) < 0)
+                        return log_oom();
+
+                e = ordered_hashmap_get(entries, q);
+                if (!e) {
+                        e = new0(MountinfoEntry, 1);
+                        if (!e)
+                                return log_oom();
+
+                        r = ordered_hashmap_put(entries, q, e);
+                        if (r < 0) {
+                                mountinfo_entry_free(e);
+                                return log_oom();
+                        }
+
+                        TAKE_PTR(q);
+                }
+
+                if (strv_push(&e->fields, d) < 0 ||
+                    strv_extend(&e->fields, strempty(options)) < 0 ||
+                    strv_extend(&e->fields, strempty(fstype)) < 0)
                         return log_oom();
 
-                device_found_node(m, d, DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
+                TAKE_PTR(d);
+        }
+
+        ORDERED_HASHMAP_FOREACH_KEY(e, p, entries, j) {
+                MountinfoEntry *old;
+                char **f;
 
-                (void) mount_setup_unit(m, d, p, options, fstype, set_flags);
+                old = ordered_hashmap_get(m->mountinfo_entries, p);
+                if (old && old->unit && strv_equal(old->fields, e->fields)) {
+                        Unit *u;
+
+                        /* Nothing changed for this mount point since the last time, hence skip the expensive part,
+                         * and only mark the unit as still mounted. Let's make sure the unit is still around and in
+                         * the state we left it in, though. */
+                        u = manager_get_unit(m, old->unit);
+                        if (u && MOUNT(u)->from_proc_self_mountinfo && u->load_state == UNIT_LOADED) {
+                                if (set_flags)
+                                        MOUNT(u)->proc_flags = MOUNT_PROC_IS_MOUNTED;
+
+                                e->unit = TAKE_PTR(old->unit);
+                                continue;
+                        }
+                }
+
+                for (f = e->fields; f && *f; f += 3) {
+                        const char *what = f[0], *options = f[1], *fstype = f[2];
+                        Unit *u;
+
+                        device_found_node(m, what, DEVICE_FOUND_MOUNT, DEVICE_FOUND_MOUNT);
+
+                        (void) mount_setup_unit(m, what, p, options, fstype, set_flags, &u);
+                        if (u && free_and_strdup(&e->unit, u->id) < 0)
+                                return log_oom();
+                }
         }
 
+        ordered_hashmap_free(m->mountinfo_entries);
+        m->mountinfo_entries = TAKE_PTR(entries);
+
         return 0;
 }
 
@@ -1669,6 +1755,8 @@ static void mount_shutdown(Manager *m) {
 
         mnt_unref_monitor(m->mount_monitor);
         m->mount_monitor = NULL;
+
+        m->mountinfo_entries = ordered_hashmap_free(m->mountinfo_entries);
 }
 
 static int mount_get_timeout(Unit *u, usec_t *timeout) {
@@ -1770,6 +1858,9 @@ static void mount_enumerate(Manager *m) {
                 (void) sd_event_source_set_description(m->mount_event_source, "mount-monitor-dispatch");
         }
 
+        /* We are (re-)enumerating, hence process all mount points, regardless what we saw before */
+        m->mountinfo_entries = ordered_hashmap_free(m->mountinfo_entries);
+
         r = mount_load_proc_self_mountinfo(m, false);
         if (r < 0)
                 goto fail;
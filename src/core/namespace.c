@@ -4,6 +4,7 @@
 #include <sched.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -1133,9 +1134,104 @@ static void normalize_mounts(const char *root_directory, MountEntry *mounts, siz
         drop_nop(mounts, n_mounts);
 }
 
+int setup_shared_root_image(
+                const char *root_image,
+                const char *shared_dir,
+                DissectImageFlags dissect_image_flags,
+                char **ret_path) {
+
+        _cleanup_(loop_device_unrefp) LoopDevice *loop_device = NULL;
+        _cleanup_(decrypted_image_unrefp) DecryptedImage *decrypted_image = NULL;
+        _cleanup_(dissected_image_unrefp) DissectedImage *dissected_image = NULL;
+        _cleanup_free_ void *root_hash = NULL;
+        _cleanup_free_ char *path = NULL;
+        _cleanup_close_ int dir_fd = -1;
+        size_t root_hash_size = 0;
+        struct stat st;
+        int r;
+
+        assert(root_image);
+        assert(shared_dir);
+        assert(ret_path);
+
+        /* Called before the mount namespace is unshared, i.e. still in the host's namespace. Mounts the image below
+         * shared_dir, unless the process of another unit did that already, and returns the path to bind mount the
+         * root directory from. The mount point is named after the identity of the image file, so that an image
+         * that is replaced in the meantime is set up anew. */
+
+        if (stat(root_image, &st) < 0)
+                return -errno;
+
+        if (asprintf(&path, "%s/%s-%" PRIx64 "-%" PRIx64 "-%" PRIx64,
+                     shared_dir,
+                     dissect_image_flags & DISSECT_IMAGE_READ_ONLY ? "ro" : "rw",
+                     (uint64_t) st.st_dev, (uint64_t) st.st_ino, (uint64_t) timespec_load_nsec(&st.st_mtim)) < 0)
+                return -ENOMEM;
+
+        r = mkdir_p_label(shared_dir, 0700);
+        if (r < 0)
+                return r;
+
+        /* Serialize against the processes of other units starting at the same time */
+        dir_fd = open(shared_dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (dir_fd < 0)
+                return -errno;
+
+        if (flock(dir_fd, LOCK_EX) < 0)
+                return -errno;
+
+        r = path_is_mount_point(path, NULL, 0);
+        if (r > 0) {
+                log_debug("Image %s is already mounted on %s, reusing.", root_image, path);
+                *ret_path = TAKE_PTR(path);
+                return 0;
+        }
+
+        r = loop_device_make_by_path(root_image,
+                                     dissect_image_flags & DISSECT_IMAGE_READ_ONLY ? O_RDONLY : O_RDWR,
+                                     &loop_device);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to create loop device for root image: %m");
+
+        r = root_hash_load(root_image, &root_hash, &root_hash_size);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to load root hash: %m");
+
+        r = dissect_image(loop_device->fd, root_hash, root_hash_size, dissect_image_flags, &dissected_image);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to dissect image: %m");
+
+        r = dissected_image_decrypt(dissected_image, NULL, root_hash, root_hash_size, dissect_image_flags, &decrypted_image);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to decrypt dissected image: %m");
+
+        r = mkdir_label(path, 0700);
+        if (r < 0 && r != -EEXIST)
+                return r;
+
+        r = dissected_image_mount(dissected_image, path, UID_INVALID, dissect_image_flags);
+        if (r < 0) {
+                (void) umount_recursive(path, 0);
+                (void) rmdir(path);
+                return log_debug_errno(r, "Failed to mount root image: %m");
+        }
+
+        if (decrypted_image) {
+                r = decrypted_image_relinquish(decrypted_image);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to relinquish decrypted image: %m");
+        }
+
+        loop_device_relinquish(loop_device);
+
+        *ret_path = TAKE_PTR(path);
+        return 1;
+}
+
 int setup_namespace(
                 const char* root_directory,
                 const char* root_image,
+                const char* root_image_shared_dir,
                 const NamespaceInfo *ns_info,
                 char** read_write_paths,
                 char** read_only_paths,
@@ -1155,6 +1251,7 @@ int setup_namespace(
         _cleanup_(loop_device_unrefp) LoopDevice *loop_device = NULL;
         _cleanup_(decrypted_image_unrefp) DecryptedImage *decrypted_image = NULL;
         _cleanup_(dissected_image_unrefp) DissectedImage *dissected_image = NULL;
+        _cleanup_free_ char *root_image_shared = NULL;
         _cleanup_free_ void *root_hash = NULL;
         MountEntry *m, *mounts = NULL;
         size_t n_mounts, root_hash_size = 0;
@@ -1174,7 +1271,14 @@ int setup_namespace(
                     protect_home != PROTECT_HOME_NO &&
                     strv_isempty(read_write_paths))
                         dissect_image_flags |= DISSECT_IMAGE_READ_ONLY;
+        }
 
+        if (root_image && root_image_shared_dir) {
+                r = setup_shared_root_image(root_image, root_image_shared_dir, dissect_image_flags, &root_image_shared);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to set up shared root image: %m");
+
+        } else if (root_image) {
                 r = loop_device_make_by_path(root_image,
                                              dissect_image_flags & DISSECT_IMAGE_READ_ONLY ? O_RDONLY : O_RDWR,
                                              &loop_device);
@@ -1332,7 +1436,14 @@ int setup_namespace(
                 goto finish;
         }
 
-        if (root_image) {
+        if (root_image_shared) {
+                /* The image is mounted in the host's namespace already, just bind mount it from there */
+                if (mount(root_image_shared, root, NULL, MS_BIND|MS_REC, NULL) < 0) {
+                        r = log_debug_errno(errno, "Failed to bind mount '%s' on '%s': %m", root_image_shared, root);
+                        goto finish;
+                }
+
+        } else if (root_image) {
                 /* A root image is specified, mount it to the right place */
                 r = dissected_image_mount(dissected_image, root, UID_INVALID, dissect_image_flags);
                 if (r < 0) {
@@ -70,6 +70,7 @@ struct TemporaryFileSystem {
 int setup_namespace(
                 const char *root_directory,
                 const char *root_image,
+                const char *root_image_shared_dir,
                 const NamespaceInfo *ns_info,
                 char **read_write_paths,
                 char **read_only_paths,
@@ -86,6 +87,12 @@ int setup_namespace(
                 unsigned long mount_flags,
                 DissectImageFlags dissected_image_flags);
 
+int setup_shared_root_image(
+                const char *root_image,
+                const char *shared_dir,
+                DissectImageFlags dissect_image_flags,
+                char **ret_path);
+
 int setup_tmp_dirs(
                 const char *id,
                 char **tmp_dir,
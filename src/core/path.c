@@ -30,9 +30,233 @@ static const UnitActiveState state_translation_table[_PATH_STATE_MAX] = {
         [PATH_FAILED] = UNIT_FAILED
 };
 
-static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata);
+static void path_dispatch_change(PathSpec *s, bool changed);
+
+/* All path specs share a single inotify instance of the manager, so that lots of path units don't need an inotify
+ * instance each, and watches on common parent directories are shared too. As inotify only keeps one watch per
+ * inode and instance, the mask of a watch is the union of what the specs using it are interested in, and events
+ * are filtered again by each spec's own mask when dispatched. */
+
+struct PathWatch {
+        Manager *manager;
+        unsigned n_ref;
+        int wd; /* -1 once the kernel dropped the watch */
+        Set *specs;
+};
+
+static PathWatch* path_watch_unref(PathWatch *w) {
+        if (!w)
+                return NULL;
+
+        assert(w->n_ref > 0);
+
+        if (--w->n_ref > 0)
+                return NULL;
+
+        assert(set_isempty(w->specs));
+
+        if (w->wd >= 0) {
+                (void) inotify_rm_watch(w->manager->path_inotify_fd, w->wd);
+                hashmap_remove(w->manager->path_watches, INT_TO_PTR(w->wd));
+        }
+
+        set_free(w->specs);
+        return mfree(w);
+}
+
+static void path_spec_enqueue(PathSpec *s, bool changed) {
+        Manager *m = s->unit->manager;
+
+        s->changed = s->changed || changed;
+
+        if (s->in_pending)
+                return;
+
+        LIST_PREPEND(pending, m->path_specs_pending, s);
+        s->in_pending = true;
+}
+
+static void manager_enqueue_all_path_specs(Manager *m) {
+        PathWatch *w;
+        PathSpec *s;
+        Iterator i, j;
+
+        assert(m);
+
+        HASHMAP_FOREACH(w, m->path_watches, i)
+                SET_FOREACH(s, w->specs, j)
+                        path_spec_enqueue(s, false);
+}
+
+static int manager_dispatch_path_inotify(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        union inotify_event_buffer buffer;
+        Manager *m = userdata;
+        struct inotify_event *e;
+        PathSpec *s;
+        ssize_t l;
+
+        assert(m);
+        assert(m->path_inotify_fd == fd);
+
+        l = read(fd, &buffer, sizeof(buffer));
+        if (l < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0;
+
+                /* Don't fail, that would disable the event source that all path units share. Events may have
+                 * been lost though, hence let everybody check again. */
+                log_warning_errno(errno, "Failed to read inotify event, rechecking all watched paths: %m");
+                manager_enqueue_all_path_specs(m);
+                l = 0;
+        }
+
+        FOREACH_INOTIFY_EVENT(e, buffer, l) {
+                PathWatch *w;
+                Iterator i;
+
+                if (e->mask & IN_Q_OVERFLOW) {
+                        /* We lost track, let everybody check again */
+                        manager_enqueue_all_path_specs(m);
+                        continue;
+                }
+
+                w = hashmap_get(m->path_watches, INT_TO_PTR(e->wd));
+                if (!w)
+                        continue;
+
+                SET_FOREACH(s, w->specs, i) {
+                        size_t k;
+
+                        for (k = 0; k < s->n_watches; k++)
+                                if (s->watches[k].watch == w)
+                                        break;
+                        assert(k < s->n_watches);
+
+                        /* These are sent regardless of the mask */
+                        if (!(e->mask & (s->watches[k].mask|IN_IGNORED|IN_UNMOUNT)))
+                                continue;
+
+                        path_spec_enqueue(s, IN_SET(s->type, PATH_CHANGED, PATH_MODIFIED) && s->primary_watch == w);
+                }
+
+                if (e->mask & IN_IGNORED) {
+                        /* The kernel dropped the watch, make sure the wd isn't used anymore, it might be
+                         * reused for something else */
+                        hashmap_remove(m->path_watches, INT_TO_PTR(w->wd));
+                        w->wd = -1;
+                }
+        }
+
+        /* Handlers may unwatch or watch again any spec, which takes it off the pending list */
+        while ((s = m->path_specs_pending)) {
+                bool changed = s->changed;
+
+                LIST_REMOVE(pending, m->path_specs_pending, s);
+                s->in_pending = false;
+                s->changed = false;
+
+                s->handler(s, changed);
+        }
+
+        return 0;
+}
+
+static int manager_setup_path_inotify(Manager *m) {
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(m);
+
+        if (m->path_inotify_fd >= 0)
+                return 0;
+
+        fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+        if (fd < 0)
+                return -errno;
+
+        r = sd_event_add_io(m->event, &m->path_inotify_event_source, fd, EPOLLIN, manager_dispatch_path_inotify, m);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(m->path_inotify_event_source, "path");
+
+        m->path_inotify_fd = TAKE_FD(fd);
+        return 0;
+}
+
+static int path_spec_add_watch(PathSpec *s, const char *path, uint32_t mask, PathWatch **ret) {
+        Manager *m = s->unit->manager;
+        PathWatch *w;
+        size_t k;
+        int wd, r;
 
-int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
+        wd = inotify_add_watch(m->path_inotify_fd, path, mask|IN_MASK_ADD);
+        if (wd < 0)
+                return -errno;
+
+        w = hashmap_get(m->path_watches, INT_TO_PTR(wd));
+        if (w) {
+                /* Watched already, possibly by us, in which case this is only about what we are interested in */
+                for (k = 0; k < s->n_watches; k++)
+                        if (s->watches[k].watch == w) {
+                                s->watches[k].mask = mask;
+                                goto finish;
+                        }
+        } else {
+                r = hashmap_ensure_allocated(&m->path_watches, NULL);
+                if (r < 0)
+                        goto fail;
+
+                w = new(PathWatch, 1);
+                if (!w) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                *w = (PathWatch) {
+                        .manager = m,
+                        .wd = wd,
+                };
+
+                r = hashmap_put(m->path_watches, INT_TO_PTR(wd), w);
+                if (r < 0) {
+                        free(w);
+                        goto fail;
+                }
+        }
+
+        w->n_ref++;
+
+        if (!GREEDY_REALLOC(s->watches, s->n_watches_allocated, s->n_watches + 1)) {
+                path_watch_unref(w);
+                return -ENOMEM;
+        }
+
+        r = set_ensure_allocated(&w->specs, NULL);
+        if (r >= 0)
+                r = set_put(w->specs, s);
+        if (r < 0) {
+                path_watch_unref(w);
+                return r;
+        }
+
+        s->watches[s->n_watches++] = (PathSpecWatch) {
+                .watch = w,
+                .mask = mask,
+        };
+
+finish:
+        if (ret)
+                *ret = w;
+
+        return 0;
+
+fail:
+        (void) inotify_rm_watch(m->path_inotify_fd, wd);
+        return r;
+}
+
+int path_spec_watch(PathSpec *s, PathSpecHandler handler) {
 
         static const int flags_table[_PATH_TYPE_MAX] = {
                 [PATH_EXISTS] = IN_DELETE_SELF|IN_MOVE_SELF|IN_ATTRIB,
@@ -44,6 +268,7 @@ int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
 
         bool exists = false;
         char *slash, *oldslash = NULL;
+        PathWatch *w;
         int r;
 
         assert(s);
@@ -52,17 +277,11 @@ int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
 
         path_spec_unwatch(s);
 
-        s->inotify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
-        if (s->inotify_fd < 0) {
-                r = -errno;
-                goto fail;
-        }
-
-        r = sd_event_add_io(s->unit->manager->event, &s->event_source, s->inotify_fd, EPOLLIN, handler, s);
+        r = manager_setup_path_inotify(s->unit->manager);
         if (r < 0)
                 goto fail;
 
-        (void) sd_event_source_set_description(s->event_source, "path");
+        s->handler = handler;
 
         /* This function assumes the path was passed through path_simplify()! */
         assert(!strstr(s->path, "//"));
@@ -81,15 +300,15 @@ int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
                 } else
                         flags = flags_table[s->type];
 
-                r = inotify_add_watch(s->inotify_fd, s->path, flags);
+                r = path_spec_add_watch(s, s->path, flags, &w);
                 if (r < 0) {
-                        if (IN_SET(errno, EACCES, ENOENT)) {
+                        if (IN_SET(r, -EACCES, -ENOENT)) {
                                 if (cut)
                                         *cut = tmp;
                                 break;
                         }
 
-                        r = log_warning_errno(errno, "Failed to add watch on %s: %s", s->path, errno == ENOSPC ? "too many watches" : strerror(-r));
+                        r = log_warning_errno(r, "Failed to add watch on %s: %s", s->path, r == -ENOSPC ? "too many watches" : strerror(-r));
                         if (cut)
                                 *cut = tmp;
                         goto fail;
@@ -102,7 +321,7 @@ int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
                                 char tmp2 = *cut2;
                                 *cut2 = '\0';
 
-                                (void) inotify_add_watch(s->inotify_fd, s->path, IN_MOVE_SELF);
+                                (void) path_spec_add_watch(s, s->path, IN_MOVE_SELF, NULL);
                                 /* Error is ignored, the worst can happen is we get spurious events. */
 
                                 *cut2 = tmp2;
@@ -116,13 +335,13 @@ int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler) {
                         oldslash = slash;
                 else {
                         /* whole path has been iterated over */
-                        s->primary_wd = r;
+                        s->primary_watch = w;
                         break;
                 }
         }
 
         if (!exists) {
-                r = log_error_errno(errno, "Failed to add watch on any of the components of %s: %m", s->path);
+                r = log_error_errno(r, "Failed to add watch on any of the components of %s: %m", s->path);
                 /* either EACCESS or ENOENT */
                 goto fail;
         }
@@ -135,37 +354,25 @@ fail:
 }
 
 void path_spec_unwatch(PathSpec *s) {
-        assert(s);
-
-        s->event_source = sd_event_source_unref(s->event_source);
-        s->inotify_fd = safe_close(s->inotify_fd);
-}
-
-int path_spec_fd_event(PathSpec *s, uint32_t revents) {
-        union inotify_event_buffer buffer;
-        struct inotify_event *e;
-        ssize_t l;
-        int r = 0;
-
-        if (revents != EPOLLIN)
-                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
-                                       "Got invalid poll event on inotify.");
+        size_t k;
 
-        l = read(s->inotify_fd, &buffer, sizeof(buffer));
-        if (l < 0) {
-                if (IN_SET(errno, EAGAIN, EINTR))
-                        return 0;
+        assert(s);
 
-                return log_error_errno(errno, "Failed to read inotify event: %m");
+        for (k = 0; k < s->n_watches; k++) {
+                set_remove(s->watches[k].watch->specs, s);
+                path_watch_unref(s->watches[k].watch);
         }
 
-        FOREACH_INOTIFY_EVENT(e, buffer, l) {
-                if (IN_SET(s->type, PATH_CHANGED, PATH_MODIFIED) &&
-                    s->primary_wd == e->wd)
-                        r = 1;
+        s->watches = mfree(s->watches);
+        s->n_watches = s->n_watches_allocated = 0;
+        s->primary_watch = NULL;
+
+        if (s->in_pending) {
+                LIST_REMOVE(pending, s->unit->manager->path_specs_pending, s);
+                s->in_pending = false;
         }
 
-        return r;
+        s->changed = false;
 }
 
 static bool path_spec_check_good(PathSpec *s, bool initial) {
@@ -227,7 +434,8 @@ static void path_spec_dump(PathSpec *s, FILE *f, const char *prefix) {
 
 void path_spec_done(PathSpec *s) {
         assert(s);
-        assert(s->inotify_fd == -1);
+        assert(s->n_watches == 0);
+        assert(!s->in_pending);
 
         free(s->path);
 }
@@ -318,7 +526,7 @@ static int path_add_trigger_dependencies(Path *p) {
 
         assert(p);
 
-        if (!hashmap_isempty(UNIT(p)->dependencies[UNIT_TRIGGERS]))
+        if (unit_dependency_count(UNIT(p), UNIT_TRIGGERS) > 0)
                 return 0;
 
         r = unit_load_related_unit(UNIT(p), ".service", &x);
@@ -399,7 +607,7 @@ static int path_watch(Path *p) {
         assert(p);
 
         LIST_FOREACH(spec, s, p->specs) {
-                r = path_spec_watch(s, path_dispatch_io);
+                r = path_spec_watch(s, path_dispatch_change);
                 if (r < 0)
                         return r;
         }
@@ -652,34 +860,16 @@ _pure_ static const char *path_sub_state_to_string(Unit *u) {
         return path_state_to_string(PATH(u)->state);
 }
 
-static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
-        PathSpec *s = userdata;
+static void path_dispatch_change(PathSpec *s, bool changed) {
         Path *p;
-        int changed;
 
         assert(s);
         assert(s->unit);
-        assert(fd >= 0);
 
         p = PATH(s->unit);
 
         if (!IN_SET(p->state, PATH_WAITING, PATH_RUNNING))
-                return 0;
-
-        /* log_debug("inotify wakeup on %s.", u->id); */
-
-        LIST_FOREACH(spec, s, p->specs)
-                if (path_spec_owns_inotify_fd(s, fd))
-                        break;
-
-        if (!s) {
-                log_error("Got event on unknown fd.");
-                goto fail;
-        }
-
-        changed = path_spec_fd_event(s, revents);
-        if (changed < 0)
-                goto fail;
+                return;
 
         /* If we are already running, then remember that one event was
          * dispatched so that we restart the service only if something
@@ -690,12 +880,6 @@ static int path_dispatch_io(sd_event_source *source, int fd, uint32_t revents, v
                 path_enter_running(p);
         else
                 path_enter_waiting(p, false, true);
-
-        return 0;
-
-fail:
-        path_enter_dead(p, PATH_FAILURE_RESOURCES);
-        return 0;
 }
 
 static void path_trigger_notify(Unit *u, Unit *other) {
@@ -16,31 +16,41 @@ typedef enum PathType {
         _PATH_TYPE_INVALID = -1
 } PathType;
 
+typedef struct PathWatch PathWatch;
+
+typedef void (*PathSpecHandler)(PathSpec *s, bool changed);
+
+typedef struct PathSpecWatch {
+        PathWatch *watch;
+        uint32_t mask; /* the events we are interested in, the watch might cover more for other specs */
+} PathSpecWatch;
+
 typedef struct PathSpec {
         Unit *unit;
 
         char *path;
 
-        sd_event_source *event_source;
+        /* The watches on the path and its parent directories, which are shared by all specs on the same
+         * inotify instance of the manager */
+        PathSpecHandler handler;
+        PathSpecWatch *watches;
+        size_t n_watches, n_watches_allocated;
+        PathWatch *primary_watch;
 
         LIST_FIELDS(struct PathSpec, spec);
+        LIST_FIELDS(struct PathSpec, pending);
 
         PathType type;
-        int inotify_fd;
-        int primary_wd;
 
         bool previous_exists;
+        bool in_pending;
+        bool changed;
 } PathSpec;
 
-int path_spec_watch(PathSpec *s, sd_event_io_handler_t handler);
+int path_spec_watch(PathSpec *s, PathSpecHandler handler);
 void path_spec_unwatch(PathSpec *s);
-int path_spec_fd_event(PathSpec *s, uint32_t events);
 void path_spec_done(PathSpec *s);
 
-static inline bool path_spec_owns_inotify_fd(PathSpec *s, int fd) {
-        return s->inotify_fd == fd;
-}
-
 typedef enum PathResult {
         PATH_SUCCESS,
         PATH_FAILURE_RESOURCES,
@@ -81,7 +81,7 @@ static const UnitActiveState state_translation_table_idle[_SERVICE_STATE_MAX] =
         [SERVICE_AUTO_RESTART] = UNIT_ACTIVATING
 };
 
-static int service_dispatch_inotify_io(sd_event_source *source, int fd, uint32_t events, void *userdata);
+static void service_dispatch_pid_file_change(PathSpec *p, bool changed);
 static int service_dispatch_timer(sd_event_source *source, usec_t usec, void *userdata);
 static int service_dispatch_watchdog(sd_event_source *source, usec_t usec, void *userdata);
 static int service_dispatch_exec_io(sd_event_source *source, int fd, uint32_t events, void *userdata);
@@ -110,6 +110,8 @@ static void service_init(Unit *u) {
                 EXEC_KEYRING_PRIVATE : EXEC_KEYRING_INHERIT;
 
         s->watchdog_original_usec = USEC_INFINITY;
+        s->watchdog_latency_usec = USEC_INFINITY;
+        s->watchdog_latency_max_usec = USEC_INFINITY;
 }
 
 static void service_unwatch_control_pid(Service *s) {
@@ -296,6 +298,15 @@ static void service_reset_watchdog(Service *s) {
         service_start_watchdog(s);
 }
 
+static void service_record_watchdog_latency(Service *s, usec_t latency_usec) {
+        assert(s);
+
+        s->watchdog_latency_usec = latency_usec;
+
+        if (s->watchdog_latency_max_usec == USEC_INFINITY || latency_usec > s->watchdog_latency_max_usec)
+                s->watchdog_latency_max_usec = latency_usec;
+}
+
 static void service_override_watchdog_timeout(Service *s, usec_t watchdog_override_usec) {
         assert(s);
 
@@ -828,6 +839,24 @@ static void service_dump(Unit *u, FILE *f, const char *prefix) {
                         prefix, yes_no(s->main_pid_known),
                         prefix, yes_no(s->main_pid_alien));
 
+        if (s->main_exec_timestamps[EXEC_TIMESTAMP_SPAWN] > 0) {
+                ExecTimestamp t;
+
+                fprintf(f, "%sMain Start-Up Timing:", prefix);
+                for (t = EXEC_TIMESTAMP_FORK; t < _EXEC_TIMESTAMP_MAX; t++) {
+                        char buf[FORMAT_TIMESPAN_MAX];
+
+                        if (s->main_exec_timestamps[t] == 0)
+                                continue;
+
+                        fprintf(f, " %s=+%s", exec_timestamp_to_string(t),
+                                format_timespan(buf, sizeof(buf),
+                                                usec_sub_unsigned(s->main_exec_timestamps[t], s->main_exec_timestamps[EXEC_TIMESTAMP_SPAWN]),
+                                                USEC_PER_MSEC / 10));
+                }
+                fputc('\n', f);
+        }
+
         if (s->pid_file)
                 fprintf(f,
                         "%sPIDFile: %s\n",
@@ -1087,7 +1116,9 @@ static void service_set_state(Service *s, ServiceState state) {
             !(state == SERVICE_DEAD && UNIT(s)->job))
                 service_close_socket_fd(s);
 
-        if (state != SERVICE_START)
+        /* Keep the exec_fd around for a bit longer than we need it for Type=exec, so that we also learn the start-up
+         * timing of services of other types, which enter the next state without waiting for execve(). */
+        if (!IN_SET(state, SERVICE_START, SERVICE_START_POST, SERVICE_RUNNING))
                 s->exec_fd_event_source = sd_event_source_unref(s->exec_fd_event_source);
 
         if (!IN_SET(state, SERVICE_START_POST, SERVICE_RUNNING, SERVICE_RELOAD))
@@ -1235,13 +1266,12 @@ static int service_collect_fds(
 
                 rn_socket_fds = 1;
         } else {
-                Iterator i;
-                void *v;
+                UnitDependencyIterator i;
                 Unit *u;
 
                 /* Pass all our configured sockets for singleton services */
 
-                HASHMAP_FOREACH_KEY(v, u, UNIT(s)->dependencies[UNIT_TRIGGERED_BY], i) {
+                UNIT_FOREACH_DEPENDENCY(u, UNIT(s), UNIT_TRIGGERED_BY, i) {
                         _cleanup_free_ int *cfds = NULL;
                         Socket *sock;
                         int cn_fds;
@@ -1415,6 +1445,7 @@ static int service_spawn(
         size_t n_socket_fds = 0, n_storage_fds = 0, n_env = 0;
         _cleanup_close_ int exec_fd = -1;
         _cleanup_free_ int *fds = NULL;
+        usec_t spawn_timestamp;
         pid_t pid;
         int r;
 
@@ -1422,6 +1453,8 @@ static int service_spawn(
         assert(c);
         assert(_pid);
 
+        spawn_timestamp = now(CLOCK_MONOTONIC);
+
         r = unit_prepare_exec(UNIT(s)); /* This realizes the cgroup, among other things */
         if (r < 0)
                 return r;
@@ -1446,8 +1479,9 @@ static int service_spawn(
                 log_unit_debug(UNIT(s), "Passing %zu fds to service", n_socket_fds + n_storage_fds);
         }
 
-        if (!FLAGS_SET(flags, EXEC_IS_CONTROL) && s->type == SERVICE_EXEC) {
-                assert(!s->exec_fd_event_source);
+        if (!FLAGS_SET(flags, EXEC_IS_CONTROL)) {
+                /* We use the exec_fd for all main processes, since it also tells us how long starting it took */
+                s->exec_fd_event_source = sd_event_source_unref(s->exec_fd_event_source);
 
                 r = service_allocate_exec_fd(s, &exec_fd_source, &exec_fd);
                 if (r < 0)
@@ -1563,8 +1597,13 @@ static int service_spawn(
         if (r < 0)
                 return r;
 
-        s->exec_fd_event_source = TAKE_PTR(exec_fd_source);
-        s->exec_fd_hot = false;
+        if (!FLAGS_SET(flags, EXEC_IS_CONTROL)) {
+                s->exec_fd_event_source = TAKE_PTR(exec_fd_source);
+                s->exec_fd_hot = false;
+
+                zero(s->main_exec_timestamps);
+                s->main_exec_timestamps[EXEC_TIMESTAMP_SPAWN] = spawn_timestamp;
+        }
 
         r = unit_watch_pid(UNIT(s), pid);
         if (r < 0) /* FIXME: we need to do something here */
@@ -2360,6 +2399,8 @@ static int service_start(Unit *u) {
         s->watchdog_original_usec = s->watchdog_usec;
         s->watchdog_override_enable = false;
         s->watchdog_override_usec = USEC_INFINITY;
+        s->watchdog_latency_usec = USEC_INFINITY;
+        s->watchdog_latency_max_usec = USEC_INFINITY;
 
         exec_command_reset_status_list_array(s->exec_command, _SERVICE_EXEC_COMMAND_MAX);
         exec_status_reset(&s->main_exec_status);
@@ -2504,6 +2545,7 @@ static int service_serialize_exec_command(Unit *u, FILE *f, ExecCommand *command
 static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
         Service *s = SERVICE(u);
         ServiceFDStore *fs;
+        ExecTimestamp t;
         int r;
 
         assert(u);
@@ -2588,6 +2630,11 @@ static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
                 }
         }
 
+        for (t = 0; t < _EXEC_TIMESTAMP_MAX; t++)
+                if (s->main_exec_timestamps[t] > 0)
+                        (void) serialize_item_format(f, "main-exec-timestamp", "%s " USEC_FMT,
+                                                     exec_timestamp_to_string(t), s->main_exec_timestamps[t]);
+
         (void) serialize_dual_timestamp(f, "watchdog-timestamp", &s->watchdog_timestamp);
         (void) serialize_bool(f, "forbid-restart", s->forbid_restart);
 
@@ -2597,6 +2644,11 @@ static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
         if (s->watchdog_original_usec != USEC_INFINITY)
                 (void) serialize_item_format(f, "watchdog-original-usec", USEC_FMT, s->watchdog_original_usec);
 
+        if (s->watchdog_latency_usec != USEC_INFINITY)
+                (void) serialize_item_format(f, "watchdog-latency-usec", USEC_FMT, s->watchdog_latency_usec);
+        if (s->watchdog_latency_max_usec != USEC_INFINITY)
+                (void) serialize_item_format(f, "watchdog-latency-max-usec", USEC_FMT, s->watchdog_latency_max_usec);
+
         return 0;
 }
 
@@ -2847,7 +2899,20 @@ static int service_deserialize_item(Unit *u, const char *key, const char *value,
                 deserialize_dual_timestamp(value, &s->main_exec_status.start_timestamp);
         else if (streq(key, "main-exec-status-exit"))
                 deserialize_dual_timestamp(value, &s->main_exec_status.exit_timestamp);
-        else if (streq(key, "watchdog-timestamp"))
+        else if (streq(key, "main-exec-timestamp")) {
+                _cleanup_free_ char *name = NULL;
+                const char *p = value;
+                ExecTimestamp t;
+                usec_t usec;
+
+                r = extract_first_word(&p, &name, NULL, 0);
+                if (r <= 0 || !p)
+                        log_unit_debug(u, "Failed to parse main-exec-timestamp value: %s", value);
+                else if ((t = exec_timestamp_from_string(name)) < 0)
+                        log_unit_debug(u, "Unknown main-exec-timestamp step, ignoring: %s", name);
+                else if (deserialize_usec(p, &usec) >= 0)
+                        s->main_exec_timestamps[t] = usec;
+        } else if (streq(key, "watchdog-timestamp"))
                 deserialize_dual_timestamp(value, &s->watchdog_timestamp);
         else if (streq(key, "forbid-restart")) {
                 int b;
@@ -2909,6 +2974,14 @@ static int service_deserialize_item(Unit *u, const char *key, const char *value,
                 if (deserialize_usec(value, &s->watchdog_original_usec) < 0)
                         log_unit_debug(u, "Failed to parse watchdog_original_usec value: %s", value);
 
+        } else if (streq(key, "watchdog-latency-usec")) {
+                if (deserialize_usec(value, &s->watchdog_latency_usec) < 0)
+                        log_unit_debug(u, "Failed to parse watchdog_latency_usec value: %s", value);
+
+        } else if (streq(key, "watchdog-latency-max-usec")) {
+                if (deserialize_usec(value, &s->watchdog_latency_max_usec) < 0)
+                        log_unit_debug(u, "Failed to parse watchdog_latency_max_usec value: %s", value);
+
         } else if (STR_IN_SET(key, "main-command", "control-command")) {
                 r = service_deserialize_exec_command(u, key, value);
                 if (r < 0)
@@ -2984,7 +3057,7 @@ static int service_watch_pid_file(Service *s) {
 
         log_unit_debug(UNIT(s), "Setting watch for PID file %s", s->pid_file_pathspec->path);
 
-        r = path_spec_watch(s->pid_file_pathspec, service_dispatch_inotify_io);
+        r = path_spec_watch(s->pid_file_pathspec, service_dispatch_pid_file_change);
         if (r < 0)
                 goto fail;
 
@@ -3021,15 +3094,13 @@ static int service_demand_pid_file(Service *s) {
         /* PATH_CHANGED would not be enough. There are daemons (sendmail) that
          * keep their PID file open all the time. */
         ps->type = PATH_MODIFIED;
-        ps->inotify_fd = -1;
 
         s->pid_file_pathspec = ps;
 
         return service_watch_pid_file(s);
 }
 
-static int service_dispatch_inotify_io(sd_event_source *source, int fd, uint32_t events, void *userdata) {
-        PathSpec *p = userdata;
+static void service_dispatch_pid_file_change(PathSpec *p, bool changed) {
         Service *s;
 
         assert(p);
@@ -3037,28 +3108,22 @@ static int service_dispatch_inotify_io(sd_event_source *source, int fd, uint32_t
         s = SERVICE(p->unit);
 
         assert(s);
-        assert(fd >= 0);
         assert(IN_SET(s->state, SERVICE_START, SERVICE_START_POST));
-        assert(s->pid_file_pathspec);
-        assert(path_spec_owns_inotify_fd(s->pid_file_pathspec, fd));
+        assert(s->pid_file_pathspec == p);
 
         log_unit_debug(UNIT(s), "inotify event");
 
-        if (path_spec_fd_event(p, events) < 0)
-                goto fail;
-
         if (service_retry_pid_file(s) == 0)
-                return 0;
+                return;
 
         if (service_watch_pid_file(s) < 0)
                 goto fail;
 
-        return 0;
+        return;
 
 fail:
         service_unwatch_pid_file(s);
         service_enter_signal(s, SERVICE_STOP_SIGTERM, SERVICE_FAILURE_RESOURCES);
-        return 0;
 }
 
 static int service_dispatch_exec_io(sd_event_source *source, int fd, uint32_t events, void *userdata) {
@@ -3075,13 +3140,18 @@ static int service_dispatch_exec_io(sd_event_source *source, int fd, uint32_t ev
          * the pipe to be closed (for example, a simple exit()). To deal with that we'll ignore EOFs on the pipe unless
          * the child signalled us first that it is about to call the execve(). It does so by sending us a simple
          * non-zero byte via the pipe. We also provide the child with a way to inform us in case execve() failed: if it
-         * sends a zero byte we'll ignore POLLHUP on the fd again. */
+         * sends a zero byte we'll ignore POLLHUP on the fd again.
+         *
+         * Along with that flag byte the child passes a list of timestamps for the steps of setting up the execution
+         * environment, see ExecFdMessage. A manager from before a reexecution might have forked the child, in which
+         * case we might only get the flag byte, hence handle short messages gracefully. */
 
         for (;;) {
-                uint8_t x;
+                ExecFdMessage message = {};
+                ExecTimestamp t;
                 ssize_t n;
 
-                n = read(fd, &x, sizeof(x));
+                n = read(fd, &message, sizeof(message));
                 if (n < 0) {
                         if (errno == EAGAIN) /* O_NONBLOCK in effect → everything queued has now been processed. */
                                 return 0;
@@ -3106,9 +3176,17 @@ static int service_dispatch_exec_io(sd_event_source *source, int fd, uint32_t ev
                         return 0;
                 }
 
-                /* A byte was read → this turns on/off the exec fd logic */
-                assert(n == sizeof(x));
-                s->exec_fd_hot = x;
+                if ((size_t) n < sizeof(message)) {
+                        /* Short message → only the last byte is relevant, it turns on/off the exec fd logic */
+                        s->exec_fd_hot = ((const uint8_t*) &message)[n - 1];
+                        continue;
+                }
+
+                s->exec_fd_hot = message.hot;
+
+                for (t = EXEC_TIMESTAMP_FORK; t < _EXEC_TIMESTAMP_MAX; t++)
+                        if (message.timestamps[t] > 0)
+                                s->main_exec_timestamps[t] = message.timestamps[t];
         }
 
         return 0;
@@ -3784,6 +3862,15 @@ static void service_notify_message(
                         service_override_watchdog_timeout(s, watchdog_override_usec);
         }
 
+        e = strv_find_startswith(tags, "WATCHDOG_LATENCY=");
+        if (e) {
+                usec_t watchdog_latency_usec;
+                if (safe_atou64(e, &watchdog_latency_usec) < 0 || watchdog_latency_usec == USEC_INFINITY)
+                        log_unit_warning(u, "Failed to parse WATCHDOG_LATENCY=%s", e);
+                else
+                        service_record_watchdog_latency(s, watchdog_latency_usec);
+        }
+
         /* Process FD store messages. Either FDSTOREREMOVE=1 for removal, or FDSTORE=1 for addition. In both cases,
          * process FDNAME= for picking the file descriptor name to use. Note that FDNAME= is required when removing
          * fds, but optional when pushing in new fds, for compatibility reasons. */
@@ -3813,6 +3900,22 @@ static void service_notify_message(
                 unit_add_to_dbus_queue(u);
 }
 
+static void service_notify_watchdog(Unit *u, const struct ucred *ucred) {
+        Service *s = SERVICE(u);
+
+        assert(u);
+        assert(ucred);
+
+        /* Shortcut for plain watchdog keep-alive pings, equivalent to service_notify_message() with WATCHDOG=1 as
+         * the only tag. */
+        if (!service_notify_message_authorized(s, ucred->pid, NULL, NULL))
+                return;
+
+        log_unit_debug(u, "Got notification message from PID "PID_FMT" (WATCHDOG=1)", ucred->pid);
+
+        service_reset_watchdog(s);
+}
+
 static int service_get_timeout(Unit *u, usec_t *timeout) {
         Service *s = SERVICE(u);
         uint64_t t;
@@ -4130,6 +4233,7 @@ const UnitVTable service_vtable = {
 
         .notify_cgroup_empty = service_notify_cgroup_empty_event,
         .notify_message = service_notify_message,
+        .notify_watchdog = service_notify_watchdog,
 
         .main_pid = service_main_pid,
         .control_pid = service_control_pid,
@@ -103,6 +103,8 @@ struct Service {
         usec_t watchdog_original_usec;   /* the watchdog timeout that was in effect when the unit was started, i.e. the timeout the forked off processes currently see */
         usec_t watchdog_override_usec;   /* the watchdog timeout requested by the service itself through sd_notify() */
         bool watchdog_override_enable;
+        usec_t watchdog_latency_usec;     /* how late the last watchdog ping was, as reported by the service itself through sd_notify() */
+        usec_t watchdog_latency_max_usec; /* … and the highest such latency since the unit was started */
         sd_event_source *watchdog_event_source;
 
         ExecCommand* exec_command[_SERVICE_EXEC_COMMAND_MAX];
@@ -116,6 +118,9 @@ struct Service {
         /* The exit status of the real main process */
         ExecStatus main_exec_status;
 
+        /* When the steps of starting the main process were completed, CLOCK_MONOTONIC, 0 if not (yet) known */
+        usec_t main_exec_timestamps[_EXEC_TIMESTAMP_MAX];
+
         /* The currently executed control process */
         ExecCommand *control_command;
 
@@ -680,6 +680,16 @@ static void socket_dump(Unit *u, FILE *f, const char *prefix) {
                         prefix, s->max_connections,
                         prefix, s->max_connections_per_source);
 
+        if (s->n_spawned > 0) {
+                char buf1[FORMAT_TIMESPAN_MAX], buf2[FORMAT_TIMESPAN_MAX];
+
+                fprintf(f,
+                        "%sAverage spawn latency: %s\n"
+                        "%sMaximum spawn latency: %s\n",
+                        prefix, format_timespan(buf1, sizeof(buf1), s->spawn_usec / s->n_spawned, 1),
+                        prefix, format_timespan(buf2, sizeof(buf2), s->spawn_max_usec, 1));
+        }
+
         if (s->priority >= 0)
                 fprintf(f,
                         "%sPriority: %i\n",
@@ -2248,12 +2258,11 @@ static void socket_enter_running(Socket *s, int cfd) {
         if (cfd < 0) {
                 bool pending = false;
                 Unit *other;
-                Iterator i;
-                void *v;
+                UnitDependencyIterator i;
 
                 /* If there's already a start pending don't bother to
                  * do anything */
-                HASHMAP_FOREACH_KEY(v, other, UNIT(s)->dependencies[UNIT_TRIGGERS], i)
+                UNIT_FOREACH_DEPENDENCY(other, UNIT(s), UNIT_TRIGGERS, i)
                         if (unit_active_or_pending(other)) {
                                 pending = true;
                                 break;
@@ -2276,6 +2285,9 @@ static void socket_enter_running(Socket *s, int cfd) {
                 _cleanup_free_ char *prefix = NULL, *instance = NULL, *name = NULL;
                 _cleanup_(socket_peer_unrefp) SocketPeer *p = NULL;
                 Service *service;
+                usec_t start, spawned;
+
+                start = now(CLOCK_MONOTONIC);
 
                 if (s->n_connections >= s->max_connections) {
                         log_unit_warning(UNIT(s), "Too many incoming connections (%u), dropping connection.",
@@ -2341,7 +2353,7 @@ static void socket_enter_running(Socket *s, int cfd) {
 
                 service->peer = TAKE_PTR(p); /* Pass ownership of the peer reference */
 
-                r = manager_add_job(UNIT(s)->manager, JOB_START, UNIT(service), JOB_REPLACE, &error, NULL);
+                r = manager_add_start_job(UNIT(s)->manager, UNIT(service), &error, NULL);
                 if (r < 0) {
                         /* We failed to activate the new service, but it still exists. Let's make sure the service
                          * closes and forgets the connection fd again, immediately. */
@@ -2349,6 +2361,11 @@ static void socket_enter_running(Socket *s, int cfd) {
                         goto fail;
                 }
 
+                spawned = now(CLOCK_MONOTONIC) - start;
+                s->n_spawned++;
+                s->spawn_usec += spawned;
+                s->spawn_max_usec = MAX(s->spawn_max_usec, spawned);
+
                 /* Notify clients about changed counters */
                 unit_add_to_dbus_queue(UNIT(s));
         }
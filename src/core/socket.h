@@ -71,6 +71,11 @@ struct Socket {
         unsigned max_connections;
         unsigned max_connections_per_source;
 
+        /* How long it took to get from an incoming connection to the start job of its service instance */
+        unsigned n_spawned;
+        usec_t spawn_usec;
+        usec_t spawn_max_usec;
+
         unsigned backlog;
         unsigned keep_alive_cnt;
         usec_t timeout_usec;
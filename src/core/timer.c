@@ -118,7 +118,7 @@ static int timer_add_trigger_dependencies(Timer *t) {
 
         assert(t);
 
-        if (!hashmap_isempty(UNIT(t)->dependencies[UNIT_TRIGGERS]))
+        if (unit_dependency_count(UNIT(t), UNIT_TRIGGERS) > 0)
                 return 0;
 
         r = unit_load_related_unit(UNIT(t), ".service", &x);
@@ -335,6 +335,69 @@ static void add_random(Timer *t, usec_t *v) {
         log_unit_debug(UNIT(t), "Adding %s random time.", format_timespan(s, sizeof(s), add, 0));
 }
 
+static bool calendar_spec_is_local(const CalendarSpec *c) {
+        assert(c);
+
+        return !c->utc && isempty(c->timezone);
+}
+
+static long gmtoff_at(usec_t usec) {
+        time_t sec = (time_t) (usec / USEC_PER_SEC);
+        struct tm tm;
+
+        if (!localtime_r(&sec, &tm))
+                return LONG_MIN;
+
+        return tm.tm_gmtoff;
+}
+
+static int timer_value_next_calendar(TimerValue *v, usec_t base) {
+        int r;
+
+        assert(v);
+        assert(v->calendar_spec);
+
+        /* The next elapse only depends on the spec, the base and the timezone, hence only compute it again if one
+         * of them changed. This is called for each timer on every time change and whenever the triggered unit
+         * changes state, and computing it is not cheap, in particular for specs with a timezone other than the
+         * local one, which requires forking off a child. */
+
+        if (v->calendar_cached && v->calendar_base == base)
+                return v->calendar_error;
+
+        r = calendar_spec_next_usec(v->calendar_spec, base, &v->next_elapse);
+
+        v->calendar_cached = true;
+        v->calendar_base = base;
+        v->calendar_error = MIN(r, 0);
+
+        if (r >= 0 && calendar_spec_is_local(v->calendar_spec)) {
+                v->calendar_gmtoff_base = gmtoff_at(base);
+                v->calendar_gmtoff_next = gmtoff_at(v->next_elapse);
+        }
+
+        return r;
+}
+
+static void timer_value_timezone_change(TimerValue *v) {
+        assert(v);
+
+        if (!v->calendar_cached || !calendar_spec_is_local(v->calendar_spec))
+                return;
+
+        /* If the UTC offset of the new timezone equals the old one at both ends of a range short enough to
+         * contain at most one transition, local time is the same in the whole range, and so is the next
+         * elapse. This is the common case, as the timezone is mostly "changed" to an equivalent one, and
+         * allows us to avoid computing everything again. */
+        if (v->calendar_error >= 0 &&
+            v->next_elapse - v->calendar_base <= USEC_PER_DAY &&
+            gmtoff_at(v->calendar_base) == v->calendar_gmtoff_base &&
+            gmtoff_at(v->next_elapse) == v->calendar_gmtoff_next)
+                return;
+
+        v->calendar_cached = false;
+}
+
 static void timer_enter_waiting(Timer *t, bool time_change) {
         bool found_monotonic = false, found_realtime = false;
         bool leave_around = false;
@@ -376,7 +439,7 @@ static void timer_enter_waiting(Timer *t, bool time_change) {
                                         b = ts.realtime;
                         }
 
-                        r = calendar_spec_next_usec(v->calendar_spec, b, &v->next_elapse);
+                        r = timer_value_next_calendar(v, b);
                         if (r < 0)
                                 continue;
 
@@ -813,9 +876,16 @@ static void timer_time_change(Unit *u) {
 
 static void timer_timezone_change(Unit *u) {
         Timer *t = TIMER(u);
+        TimerValue *v;
 
         assert(u);
 
+        /* Drop what is outdated now even if we aren't waiting, so that it isn't used when we start waiting
+         * again */
+        LIST_FOREACH(value, v, t->values)
+                if (v->base == TIMER_CALENDAR)
+                        timer_value_timezone_change(v);
+
         if (t->state != TIMER_WAITING)
                 return;
 
@@ -25,6 +25,13 @@ typedef struct TimerValue {
         CalendarSpec *calendar_spec; /* only for calendar events */
         usec_t next_elapse;
 
+        /* Calendar events are only computed again when the base they are computed from or the timezone changes */
+        bool calendar_cached;
+        int calendar_error;
+        usec_t calendar_base;
+        long calendar_gmtoff_base; /* UTC offsets at the base and at next_elapse, for local time events */
+        long calendar_gmtoff_next;
+
         LIST_FIELDS(struct TimerValue, value);
 } TimerValue;
 
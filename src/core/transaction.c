@@ -284,26 +284,31 @@ static void transaction_drop_redundant(Transaction *tr) {
 
         /* Goes through the transaction and removes all jobs of the units
          * whose jobs are all noops. If not all of a unit's jobs are
-         * redundant, they are kept. */
+         * redundant, they are kept. Whether a job is redundant does not
+         * depend on any other job in the transaction, hence a single pass
+         * is enough. */
 
         assert(tr);
 
-rescan:
         HASHMAP_FOREACH(j, tr->jobs, i) {
+                Unit *u = j->unit;
                 Job *k;
 
-                LIST_FOREACH(transaction, k, j) {
-
+                LIST_FOREACH(transaction, k, j)
                         if (tr->anchor_job == k ||
                             !job_type_is_redundant(k->type, unit_active_state(k->unit)) ||
                             (k->unit->job && job_type_is_conflicting(k->type, k->unit->job->type)))
-                                goto next_unit;
-                }
+                                break;
+                if (k)
+                        continue;
 
                 /* log_debug("Found redundant job %s/%s, dropping.", j->unit->id, job_type_to_string(j->type)); */
-                transaction_delete_job(tr, j, false);
-                goto rescan;
-        next_unit:;
+
+                /* Without deleting dependencies this only ever removes the
+                 * current entry from the hashmap, which is fine while
+                 * iterating. */
+                while ((k = hashmap_get(tr->jobs, u)))
+                        transaction_delete_job(tr, k, false);
         }
 }
 
@@ -341,9 +346,8 @@ static char* merge_unit_ids(const char* unit_log_field, char **pairs) {
 }
 
 static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
-        Iterator i;
+        UnitDependencyIterator i;
         Unit *u;
-        void *v;
         int r;
 
         assert(tr);
@@ -435,7 +439,7 @@ static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsi
 
         /* We assume that the dependencies are bidirectional, and
          * hence can ignore UNIT_AFTER */
-        HASHMAP_FOREACH_KEY(v, u, j->unit->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(u, j->unit, UNIT_BEFORE, i) {
                 Job *o;
 
                 /* Is there a job for this unit? */
@@ -484,27 +488,66 @@ static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bu
         return 0;
 }
 
+static void transaction_queue_garbage(Transaction *tr, Job *j, Job **queue) {
+        assert(tr);
+        assert(queue);
+
+        if (!j)
+                return;
+
+        if (tr->anchor_job == j || j->object_list) {
+                /* log_debug("Keeping job %s/%s because of %s/%s", */
+                /*           j->unit->id, job_type_to_string(j->type), */
+                /*           j->object_list->subject ? j->object_list->subject->unit->id : "root", */
+                /*           j->object_list->subject ? job_type_to_string(j->object_list->subject->type) : "root"); */
+                return;
+        }
+
+        /* Only the first job of each unit is considered */
+        if (hashmap_get(tr->jobs, j->unit) != j)
+                return;
+
+        /* A job can become garbage only once, hence it is never queued twice. The marker is not used for
+         * anything else at this point. */
+        j->marker = *queue;
+        *queue = j;
+}
+
 static void transaction_collect_garbage(Transaction *tr) {
+        Job *j, *queue = NULL;
         Iterator i;
-        Job *j;
 
         assert(tr);
 
-        /* Drop jobs that are not required by any other job */
+        /* Drop jobs that are not required by any other job. Dropping a job
+         * might make the jobs it pulled in unneeded too, hence queue those
+         * up as we go, instead of rescanning the whole transaction. */
 
-rescan:
-        HASHMAP_FOREACH(j, tr->jobs, i) {
-                if (tr->anchor_job == j || j->object_list) {
-                        /* log_debug("Keeping job %s/%s because of %s/%s", */
-                        /*           j->unit->id, job_type_to_string(j->type), */
-                        /*           j->object_list->subject ? j->object_list->subject->unit->id : "root", */
-                        /*           j->object_list->subject ? job_type_to_string(j->object_list->subject->type) : "root"); */
-                        continue;
-                }
+        HASHMAP_FOREACH(j, tr->jobs, i)
+                transaction_queue_garbage(tr, j, &queue);
+
+        while ((j = queue)) {
+                Unit *u = j->unit;
+
+                queue = j->marker;
 
                 /* log_debug("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type)); */
+
+                /* Unlink the jobs this one pulled in first, to see whether
+                 * anything still needs them afterwards */
+                while (j->subject_list) {
+                        Job *object = j->subject_list->object;
+
+                        job_dependency_free(j->subject_list);
+                        transaction_queue_garbage(tr, object, &queue);
+                }
+
+                /* Nothing pulls this job in, hence this never deletes any
+                 * other job */
                 transaction_delete_job(tr, j, true);
-                goto rescan;
+
+                /* Another job of the same unit might be first now */
+                transaction_queue_garbage(tr, hashmap_get(tr->jobs, u), &queue);
         }
 }
 
@@ -739,19 +782,9 @@ int transaction_activate(Transaction *tr, Manager *m, JobMode mode, sd_bus_error
 
         assert(hashmap_isempty(tr->jobs));
 
-        if (!hashmap_isempty(m->jobs)) {
-                /* Are there any jobs now? Then make sure we have the
-                 * idle pipe around. We don't really care too much
-                 * whether this works or not, as the idle pipe is a
-                 * feature for cosmetics, not actually useful for
-                 * anything beyond that. */
-
-                if (m->idle_pipe[0] < 0 && m->idle_pipe[1] < 0 &&
-                    m->idle_pipe[2] < 0 && m->idle_pipe[3] < 0) {
-                        (void) pipe2(m->idle_pipe, O_NONBLOCK|O_CLOEXEC);
-                        (void) pipe2(m->idle_pipe + 2, O_NONBLOCK|O_CLOEXEC);
-                }
-        }
+        /* Are there any jobs now? Then make sure we have the idle pipe around. */
+        if (!hashmap_isempty(m->jobs))
+                manager_open_idle_pipe(m);
 
         return 0;
 }
@@ -838,16 +871,15 @@ static void transaction_unlink_job(Transaction *tr, Job *j, bool delete_dependen
 }
 
 void transaction_add_propagate_reload_jobs(Transaction *tr, Unit *unit, Job *by, bool ignore_order, sd_bus_error *e) {
-        Iterator i;
+        UnitDependencyIterator i;
         JobType nt;
         Unit *dep;
-        void *v;
         int r;
 
         assert(tr);
         assert(unit);
 
-        HASHMAP_FOREACH_KEY(v, dep, unit->dependencies[UNIT_PROPAGATES_RELOAD_TO], i) {
+        UNIT_FOREACH_DEPENDENCY(dep, unit, UNIT_PROPAGATES_RELOAD_TO, i) {
                 nt = job_type_collapse(JOB_TRY_RELOAD, dep);
                 if (nt == JOB_NOP)
                         continue;
@@ -873,11 +905,11 @@ int transaction_add_job_and_dependencies(
                 bool ignore_order,
                 sd_bus_error *e) {
 
+        UnitDependencyIterator di;
         bool is_new;
         Iterator i;
         Unit *dep;
         Job *ret;
-        void *v;
         int r;
 
         assert(tr);
@@ -952,7 +984,7 @@ int transaction_add_job_and_dependencies(
 
                 /* Finally, recursively add in all dependencies. */
                 if (IN_SET(type, JOB_START, JOB_RESTART)) {
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_REQUIRES], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUIRES, di) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -962,7 +994,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_BINDS_TO], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_BINDS_TO, di) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -972,7 +1004,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_WANTS], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_WANTS, di) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         /* unit masked, job type not applicable and unit not found are not considered as errors. */
@@ -984,7 +1016,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_REQUISITE], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUISITE, di) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_VERIFY_ACTIVE, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -994,7 +1026,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_CONFLICTS], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONFLICTS, di) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, true, true, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1004,7 +1036,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_CONFLICTED_BY], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONFLICTED_BY, di) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_unit_warning(dep,
@@ -1033,7 +1065,7 @@ int transaction_add_job_and_dependencies(
                         ptype = type == JOB_RESTART ? JOB_TRY_RESTART : type;
 
                         for (j = 0; j < ELEMENTSOF(propagate_deps); j++)
-                                HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[propagate_deps[j]], i) {
+                                UNIT_FOREACH_DEPENDENCY(dep, ret->unit, propagate_deps[j], di) {
                                         JobType nt;
 
                                         nt = job_type_collapse(ptype, dep);
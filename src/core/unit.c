@@ -12,6 +12,8 @@
 
 #include "all-units.h"
 #include "alloc-util.h"
+#include "bpf-devices.h"
+#include "bpf-firewall.h"
 #include "bus-common-errors.h"
 #include "bus-util.h"
 #include "cgroup-util.h"
@@ -26,6 +28,7 @@
 #include "format-util.h"
 #include "fs-util.h"
 #include "id128-util.h"
+#include "intern.h"
 #include "io-util.h"
 #include "load-dropin.h"
 #include "load-fragment.h"
@@ -100,8 +103,7 @@ Unit *unit_new(Manager *m, size_t size) {
         u->cgroup_invalidated_mask |= CGROUP_MASK_BPF_FIREWALL;
         u->failure_action_exit_status = u->success_action_exit_status = -1;
 
-        u->ip_accounting_ingress_map_fd = -1;
-        u->ip_accounting_egress_map_fd = -1;
+        u->ip_accounting_map_fd = -1;
         u->ipv4_allow_map_fd = -1;
         u->ipv6_allow_map_fd = -1;
         u->ipv4_deny_map_fd = -1;
@@ -109,6 +111,8 @@ Unit *unit_new(Manager *m, size_t size) {
 
         u->last_section_private = -1;
 
+        u->exported_active_state = _UNIT_ACTIVE_STATE_INVALID;
+
         RATELIMIT_INIT(u->start_limit, m->default_start_limit_interval, m->default_start_limit_burst);
         RATELIMIT_INIT(u->auto_stop_ratelimit, 10 * USEC_PER_SEC, 16);
 
@@ -424,15 +428,25 @@ void unit_add_to_gc_queue(Unit *u) {
         u->in_gc_queue = true;
 }
 
+void unit_bump_generation(Unit *u) {
+        assert(u);
+
+        u->generation = ++u->manager->unit_generation;
+}
+
 void unit_add_to_dbus_queue(Unit *u) {
         assert(u);
         assert(u->type != _UNIT_TYPE_INVALID);
 
+        /* Whatever changed, ListUnitsChangedSince() should report it, even if nobody is subscribed */
+        unit_bump_generation(u);
+
         if (u->load_state == UNIT_STUB || u->in_dbus_queue)
                 return;
 
         /* Shortcut things if nobody cares */
         if (sd_bus_track_count(u->manager->subscribed) <= 0 &&
+            sd_bus_track_count(u->manager->subscribed_batched) <= 0 &&
             sd_bus_track_count(u->bus_track) <= 0 &&
             set_isempty(u->manager->private_buses)) {
                 u->sent_dbus_new_signal = true;
@@ -459,25 +473,437 @@ void unit_submit_to_stop_when_unneeded_queue(Unit *u) {
         u->in_stop_when_unneeded_queue = true;
 }
 
-static void bidi_set_free(Unit *u, Hashmap *h) {
-        Unit *other;
-        Iterator i;
-        void *v;
+/* Dependency entries are stored in chunks of at most this many entries, so that inserting or removing an entry never
+ * has to move more than that, however many dependencies a unit has. */
+#define UNIT_DEPENDENCY_CHUNK_MIN 4U
+#define UNIT_DEPENDENCY_CHUNK_MAX 64U
+
+static int dependency_entry_compare(const Unit *other, UnitDependency d, const UnitDependencyEntry *e) {
+        int r;
+
+        r = CMP(d, (UnitDependency) e->type);
+        if (r != 0)
+                return r;
+
+        return CMP((uintptr_t) other, (uintptr_t) e->other);
+}
+
+static UnitDependencyChunk* dependency_chunk_new(unsigned n_allocated) {
+        UnitDependencyChunk *c;
+
+        c = malloc(offsetof(UnitDependencyChunk, entries) + n_allocated * sizeof(UnitDependencyEntry));
+        if (!c)
+                return NULL;
+
+        c->n_entries = 0;
+        c->n_allocated = n_allocated;
+
+        return c;
+}
+
+static unsigned dependency_chunk_lower_bound(const UnitDependencyChunk *c, const Unit *other, UnitDependency d) {
+        unsigned lo = 0, hi = c->n_entries;
+
+        /* Returns the index of the first entry in the chunk that is not ordered before (other, d). */
+
+        while (lo < hi) {
+                unsigned mid = lo + (hi - lo) / 2;
+
+                if (dependency_entry_compare(other, d, c->entries + mid) > 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        return lo;
+}
+
+static size_t unit_dependency_find_chunk(Unit *u, const Unit *other, UnitDependency d) {
+        size_t lo = 0, hi;
 
         assert(u);
+        assert(u->n_dependency_chunks > 0);
 
-        /* Frees the hashmap and makes sure we are dropped from the inverse pointers */
+        /* Returns the index of the last chunk whose first entry is not ordered after (other, d), or of the first
+         * chunk if there is no such chunk. Chunks are never empty, hence they all have a first entry. */
 
-        HASHMAP_FOREACH_KEY(v, other, h, i) {
-                UnitDependency d;
+        hi = u->n_dependency_chunks;
+        while (hi - lo > 1) {
+                size_t mid = lo + (hi - lo) / 2;
 
-                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                        hashmap_remove(other->dependencies[d], u);
+                if (dependency_entry_compare(other, d, u->dependencies[mid]->entries) >= 0)
+                        lo = mid;
+                else
+                        hi = mid;
+        }
 
-                unit_add_to_gc_queue(other);
+        return lo;
+}
+
+static bool unit_dependency_seek(Unit *u, const Unit *other, UnitDependency d, size_t *ret_chunk, unsigned *ret_idx) {
+        size_t c;
+        unsigned k;
+
+        assert(u);
+        assert(ret_chunk);
+        assert(ret_idx);
+
+        /* Finds the position of the first entry that is not ordered before (other, d). Returns false if there is
+         * no such entry. */
+
+        if (u->n_dependency_chunks == 0)
+                return false;
+
+        c = unit_dependency_find_chunk(u, other, d);
+        k = dependency_chunk_lower_bound(u->dependencies[c], other, d);
+        if (k >= u->dependencies[c]->n_entries) {
+                /* All entries of this chunk are ordered before, hence it's the first one of the next chunk */
+                c++;
+                k = 0;
+
+                if (c >= u->n_dependency_chunks)
+                        return false;
+        }
+
+        *ret_chunk = c;
+        *ret_idx = k;
+        return true;
+}
+
+static UnitDependencyEntry* unit_dependency_find(Unit *u, UnitDependency d, Unit *other, size_t *ret_chunk, unsigned *ret_idx) {
+        UnitDependencyEntry *e;
+        size_t c;
+        unsigned k;
+
+        if (!unit_dependency_seek(u, other, d, &c, &k))
+                return NULL;
+
+        e = u->dependencies[c]->entries + k;
+        if (e->other != other || e->type != d)
+                return NULL;
+
+        if (ret_chunk)
+                *ret_chunk = c;
+        if (ret_idx)
+                *ret_idx = k;
+
+        return e;
+}
+
+static void unit_dependency_remove_at(Unit *u, size_t c, unsigned k) {
+        UnitDependencyChunk *chunk;
+
+        assert(u);
+        assert(c < u->n_dependency_chunks);
+
+        chunk = u->dependencies[c];
+        assert(k < chunk->n_entries);
+
+        memmove(chunk->entries + k, chunk->entries + k + 1, (chunk->n_entries - k - 1) * sizeof(UnitDependencyEntry));
+        chunk->n_entries--;
+
+        if (chunk->n_entries > 0)
+                return;
+
+        /* Drop the chunk once it's empty, so that every chunk has a first entry to compare with */
+        free(chunk);
+        memmove(u->dependencies + c, u->dependencies + c + 1, (u->n_dependency_chunks - c - 1) * sizeof(UnitDependencyChunk*));
+        u->n_dependency_chunks--;
+}
+
+static void unit_dependency_remove_all(Unit *u, Unit *other) {
+        UnitDependency d;
+
+        assert(u);
+        assert(other);
+
+        /* Drops all dependencies of any type on the specified unit */
+
+        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                size_t c;
+                unsigned k;
+
+                if (unit_dependency_find(u, d, other, &c, &k))
+                        unit_dependency_remove_at(u, c, k);
         }
+}
+
+static void unit_dependency_insert_chunk(Unit *u, size_t c, UnitDependencyChunk *chunk) {
+        assert(u);
+        assert(c <= u->n_dependency_chunks);
+        assert(u->n_dependency_chunks < u->n_dependency_chunks_allocated);
 
-        hashmap_free(h);
+        memmove(u->dependencies + c + 1, u->dependencies + c, (u->n_dependency_chunks - c) * sizeof(UnitDependencyChunk*));
+        u->dependencies[c] = chunk;
+        u->n_dependency_chunks++;
+}
+
+static int unit_dependency_add_entry(
+                Unit *u,
+                UnitDependency d,
+                Unit *other,
+                UnitDependencyMask origin_mask,
+                UnitDependencyMask destination_mask) {
+
+        UnitDependencyChunk *chunk = NULL;
+        UnitDependencyEntry *e;
+        size_t c = 0;
+        unsigned k = 0;
+
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(other);
+        assert(origin_mask < _UNIT_DEPENDENCY_MASK_FULL);
+        assert(destination_mask < _UNIT_DEPENDENCY_MASK_FULL);
+        assert(origin_mask > 0 || destination_mask > 0);
+
+        if (u->n_dependency_chunks > 0) {
+                c = unit_dependency_find_chunk(u, other, d);
+                chunk = u->dependencies[c];
+                k = dependency_chunk_lower_bound(chunk, other, d);
+
+                if (k < chunk->n_entries && chunk->entries[k].other == other && chunk->entries[k].type == d) {
+                        /* Entry already exists. Add in our mask. */
+                        e = chunk->entries + k;
+
+                        if (FLAGS_SET(e->origin_mask, origin_mask) &&
+                            FLAGS_SET(e->destination_mask, destination_mask))
+                                return 0; /* NOP */
+
+                        e->origin_mask |= origin_mask;
+                        e->destination_mask |= destination_mask;
+                        return 1;
+                }
+        }
+
+        /* Make sure we can add another chunk, in case we need one below */
+        if (!GREEDY_REALLOC(u->dependencies, u->n_dependency_chunks_allocated, u->n_dependency_chunks + 1))
+                return -ENOMEM;
+
+        if (u->n_dependency_chunks == 0) {
+                chunk = dependency_chunk_new(UNIT_DEPENDENCY_CHUNK_MIN);
+                if (!chunk)
+                        return -ENOMEM;
+
+                unit_dependency_insert_chunk(u, 0, chunk);
+
+        } else if (chunk->n_entries >= chunk->n_allocated) {
+                UnitDependencyChunk *n;
+
+                if (chunk->n_allocated < UNIT_DEPENDENCY_CHUNK_MAX) {
+                        /* Small chunks just grow, until they reached the maximum size */
+                        n = realloc(chunk, offsetof(UnitDependencyChunk, entries) +
+                                    MIN(chunk->n_allocated * 2, UNIT_DEPENDENCY_CHUNK_MAX) * sizeof(UnitDependencyEntry));
+                        if (!n)
+                                return -ENOMEM;
+
+                        n->n_allocated = MIN(n->n_allocated * 2, UNIT_DEPENDENCY_CHUNK_MAX);
+                        u->dependencies[c] = chunk = n;
+
+                } else if (k == chunk->n_entries &&
+                           c + 1 < u->n_dependency_chunks &&
+                           u->dependencies[c+1]->n_entries < u->dependencies[c+1]->n_allocated) {
+                        /* Ordered between this chunk and the next one, and there's still room in the next one */
+                        chunk = u->dependencies[++c];
+                        k = 0;
+
+                } else if (k == 0 && c == 0) {
+                        /* Ordered before everything else, start a new first chunk. */
+                        n = dependency_chunk_new(UNIT_DEPENDENCY_CHUNK_MAX);
+                        if (!n)
+                                return -ENOMEM;
+
+                        unit_dependency_insert_chunk(u, 0, n);
+                        chunk = n;
+
+                } else if (k == chunk->n_entries) {
+                        /* Ordered after everything in this chunk, start a new one right after it. This way chunks
+                         * stay full if dependencies are added in ascending or descending order, which is the
+                         * common case. */
+                        n = dependency_chunk_new(UNIT_DEPENDENCY_CHUNK_MAX);
+                        if (!n)
+                                return -ENOMEM;
+
+                        unit_dependency_insert_chunk(u, c + 1, n);
+                        chunk = n;
+                        c++;
+                        k = 0;
+
+                } else {
+                        unsigned half;
+
+                        /* Split the chunk in the middle */
+                        n = dependency_chunk_new(UNIT_DEPENDENCY_CHUNK_MAX);
+                        if (!n)
+                                return -ENOMEM;
+
+                        half = chunk->n_entries / 2;
+                        memcpy(n->entries, chunk->entries + half, (chunk->n_entries - half) * sizeof(UnitDependencyEntry));
+                        n->n_entries = chunk->n_entries - half;
+                        chunk->n_entries = half;
+
+                        unit_dependency_insert_chunk(u, c + 1, n);
+
+                        if (k > half) {
+                                chunk = n;
+                                c++;
+                                k -= half;
+                        }
+                }
+        }
+
+        e = chunk->entries + k;
+        memmove(e + 1, e, (chunk->n_entries - k) * sizeof(UnitDependencyEntry));
+        *e = (UnitDependencyEntry) {
+                .other = other,
+                .type = d,
+                .origin_mask = origin_mask,
+                .destination_mask = destination_mask,
+        };
+        chunk->n_entries++;
+
+        return 1;
+}
+
+bool unit_dependency_next(Unit *u, UnitDependency d, UnitDependencyIterator *i, Unit **ret, UnitDependencyInfo *ret_info) {
+        UnitDependencyEntry *e;
+        size_t c;
+        unsigned k;
+
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(i);
+        assert(ret);
+
+        if (i->chunk < u->n_dependency_chunks &&
+            i->idx < u->dependencies[i->chunk]->n_entries &&
+            u->dependencies[i->chunk]->entries[i->idx].other == i->last &&
+            u->dependencies[i->chunk]->entries[i->idx].type == d) {
+                /* The common case: the entry we returned last is still where it was */
+                c = i->chunk;
+                k = i->idx;
+        } else {
+                /* We just started, or entries got added or removed while iterating. Look for the position of the
+                 * entry we returned last, and continue after it. */
+                if (!unit_dependency_seek(u, i->last, d, &c, &k))
+                        return false;
+
+                e = u->dependencies[c]->entries + k;
+                if (!i->last || e->other != i->last || e->type != d)
+                        goto found;
+        }
+
+        if (++k >= u->dependencies[c]->n_entries) {
+                if (++c >= u->n_dependency_chunks)
+                        return false;
+                k = 0;
+        }
+
+        e = u->dependencies[c]->entries + k;
+
+found:
+        if (e->type != d)
+                return false;
+
+        i->chunk = c;
+        i->idx = k;
+        i->last = e->other;
+
+        *ret = e->other;
+        if (ret_info)
+                *ret_info = (UnitDependencyInfo) {
+                        .origin_mask = e->origin_mask,
+                        .destination_mask = e->destination_mask,
+                };
+
+        return true;
+}
+
+size_t unit_dependency_count(Unit *u, UnitDependency d) {
+        size_t c, n = 0;
+        unsigned k;
+
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+
+        if (!unit_dependency_seek(u, NULL, d, &c, &k))
+                return 0;
+
+        for (; c < u->n_dependency_chunks; c++, k = 0)
+                for (; k < u->dependencies[c]->n_entries; k++) {
+                        if (u->dependencies[c]->entries[k].type != d)
+                                return n;
+
+                        n++;
+                }
+
+        return n;
+}
+
+Unit* unit_first_dependency(Unit *u, UnitDependency d) {
+        UnitDependencyEntry *e;
+        size_t c;
+        unsigned k;
+
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+
+        if (!unit_dependency_seek(u, NULL, d, &c, &k))
+                return NULL;
+
+        e = u->dependencies[c]->entries + k;
+        if (e->type != d)
+                return NULL;
+
+        return e->other;
+}
+
+bool unit_has_dependency(Unit *u, UnitDependency d, Unit *other) {
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(other);
+
+        return unit_dependency_find(u, d, other, NULL, NULL);
+}
+
+UnitDependencyInfo unit_get_dependency_info(Unit *u, UnitDependency d, Unit *other) {
+        UnitDependencyEntry *e;
+
+        assert(u);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(other);
+
+        e = unit_dependency_find(u, d, other, NULL, NULL);
+        if (!e)
+                return (UnitDependencyInfo) {};
+
+        return (UnitDependencyInfo) {
+                .origin_mask = e->origin_mask,
+                .destination_mask = e->destination_mask,
+        };
+}
+
+static void unit_free_dependencies(Unit *u) {
+        size_t c;
+        unsigned k;
+
+        assert(u);
+
+        /* Frees the dependency chunks and makes sure we are dropped from the inverse entries */
+
+        for (c = 0; c < u->n_dependency_chunks; c++) {
+                for (k = 0; k < u->dependencies[c]->n_entries; k++) {
+                        Unit *other = u->dependencies[c]->entries[k].other;
+
+                        unit_dependency_remove_all(other, u);
+                        unit_add_to_gc_queue(other);
+                }
+
+                free(u->dependencies[c]);
+        }
+
+        u->dependencies = mfree(u->dependencies);
+        u->n_dependency_chunks = u->n_dependency_chunks_allocated = 0;
 }
 
 static void unit_remove_transient(Unit *u) {
@@ -567,7 +993,6 @@ static void unit_done(Unit *u) {
 }
 
 void unit_free(Unit *u) {
-        UnitDependency d;
         Iterator i;
         char *t;
 
@@ -583,12 +1008,16 @@ void unit_free(Unit *u) {
         }
 
         u->transient_file = safe_fclose(u->transient_file);
+        free(u->transient_contents);
 
         if (!MANAGER_IS_RELOADING(u->manager))
                 unit_remove_transient(u);
 
         bus_unit_send_removed_signal(u);
 
+        if (u->id)
+                manager_record_removed_unit(u->manager, u->id);
+
         unit_done(u);
 
         unit_dequeue_rewatch_pids(u);
@@ -617,16 +1046,17 @@ void unit_free(Unit *u) {
                 job_free(j);
         }
 
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                bidi_set_free(u, u->dependencies[d]);
+        unit_free_dependencies(u);
 
         if (u->on_console)
                 manager_unref_console(u->manager);
 
         unit_release_cgroup(u);
 
-        if (!MANAGER_IS_RELOADING(u->manager))
+        if (!MANAGER_IS_RELOADING(u->manager)) {
                 unit_unlink_state_files(u);
+                unit_unlink_active_state_file(u);
+        }
 
         unit_unref_uid_gid(u, false);
 
@@ -657,17 +1087,25 @@ void unit_free(Unit *u) {
         if (u->in_cgroup_empty_queue)
                 LIST_REMOVE(cgroup_empty_queue, u->manager->cgroup_empty_queue, u);
 
+        if (u->in_cgroup_empty_check_queue)
+                LIST_REMOVE(cgroup_empty_check_queue, u->manager->cgroup_empty_check_queue, u);
+
         if (u->in_cleanup_queue)
                 LIST_REMOVE(cleanup_queue, u->manager->cleanup_queue, u);
 
         if (u->in_target_deps_queue)
                 LIST_REMOVE(target_deps_queue, u->manager->target_deps_queue, u);
 
+        if (u->in_transient_write_queue)
+                LIST_REMOVE(transient_write_queue, u->manager->transient_write_queue, u);
+
+        if (u->in_units_changed_queue)
+                LIST_REMOVE(units_changed_queue, u->manager->units_changed_queue, u);
+
         if (u->in_stop_when_unneeded_queue)
                 LIST_REMOVE(stop_when_unneeded_queue, u->manager->stop_when_unneeded_queue, u);
 
-        safe_close(u->ip_accounting_ingress_map_fd);
-        safe_close(u->ip_accounting_egress_map_fd);
+        safe_close(u->ip_accounting_map_fd);
 
         safe_close(u->ipv4_allow_map_fd);
         safe_close(u->ipv6_allow_map_fd);
@@ -678,8 +1116,10 @@ void unit_free(Unit *u) {
         bpf_program_unref(u->ip_bpf_ingress_installed);
         bpf_program_unref(u->ip_bpf_egress);
         bpf_program_unref(u->ip_bpf_egress_installed);
+        bpf_firewall_shared_unref(u->ip_bpf_shared);
 
         bpf_program_unref(u->bpf_device_control_installed);
+        bpf_devices_shared_unref(u->bpf_device_control_shared);
 
         condition_free_list(u->conditions);
         condition_free_list(u->asserts);
@@ -688,7 +1128,8 @@ void unit_free(Unit *u) {
         strv_free(u->documentation);
         free(u->fragment_path);
         free(u->source_path);
-        strv_free(u->dropin_paths);
+        intern_strv_free(u->dropin_paths);
+        strv_free(u->dependency_dropin_paths);
         free(u->instance);
 
         free(u->job_timeout_reboot_arg);
@@ -771,93 +1212,78 @@ static int merge_names(Unit *u, Unit *other) {
         return 0;
 }
 
-static int reserve_dependencies(Unit *u, Unit *other, UnitDependency d) {
-        unsigned n_reserve;
-
-        assert(u);
-        assert(other);
-        assert(d < _UNIT_DEPENDENCY_MAX);
-
-        /*
-         * If u does not have this dependency set allocated, there is no need
-         * to reserve anything. In that case other's set will be transferred
-         * as a whole to u by complete_move().
-         */
-        if (!u->dependencies[d])
-                return 0;
-
-        /* merge_dependencies() will skip a u-on-u dependency */
-        n_reserve = hashmap_size(other->dependencies[d]) - !!hashmap_get(other->dependencies[d], u);
-
-        return hashmap_reserve(u->dependencies[d], n_reserve);
-}
-
-static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitDependency d) {
-        Iterator i;
-        Unit *back;
-        void *v;
+static int merge_dependencies(Unit *u, Unit *other, const char *other_id) {
+        size_t c;
+        unsigned k;
         int r;
 
-        /* Merges all dependencies of type 'd' of the unit 'other' into the deps of the unit 'u' */
+        /* Merges all dependencies of the unit 'other' into the deps of the unit 'u' */
 
         assert(u);
         assert(other);
-        assert(d < _UNIT_DEPENDENCY_MAX);
 
         /* Fix backwards pointers. Let's iterate through all dependendent units of the other unit. */
-        HASHMAP_FOREACH_KEY(v, back, other->dependencies[d], i) {
-                UnitDependency k;
-
-                /* Let's now iterate through the dependencies of that dependencies of the other units, looking for
-                 * pointers back, and let's fix them up, to instead point to 'u'. */
-
-                for (k = 0; k < _UNIT_DEPENDENCY_MAX; k++) {
-                        if (back == u) {
-                                /* Do not add dependencies between u and itself. */
-                                if (hashmap_remove(back->dependencies[k], other))
-                                        maybe_warn_about_dependency(u, other_id, k);
-                        } else {
-                                UnitDependencyInfo di_u, di_other, di_merged;
-
-                                /* Let's drop this dependency between "back" and "other", and let's create it between
-                                 * "back" and "u" instead. Let's merge the bit masks of the dependency we are moving,
-                                 * and any such dependency which might already exist */
-
-                                di_other.data = hashmap_get(back->dependencies[k], other);
-                                if (!di_other.data)
+        for (c = 0; c < other->n_dependency_chunks; c++)
+                for (k = 0; k < other->dependencies[c]->n_entries; k++) {
+                        Unit *back = other->dependencies[c]->entries[k].other;
+                        UnitDependency q;
+
+                        /* Let's now iterate through the dependencies of that dependencies of the other units,
+                         * looking for pointers back, and let's fix them up, to instead point to 'u'. */
+
+                        for (q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
+                                UnitDependencyMask origin_mask, destination_mask;
+                                UnitDependencyEntry *e;
+                                size_t bc;
+                                unsigned bk;
+
+                                e = unit_dependency_find(back, q, other, &bc, &bk);
+                                if (!e)
                                         continue; /* dependency isn't set, let's try the next one */
 
-                                di_u.data = hashmap_get(back->dependencies[k], u);
+                                origin_mask = e->origin_mask;
+                                destination_mask = e->destination_mask;
+                                unit_dependency_remove_at(back, bc, bk);
 
-                                di_merged = (UnitDependencyInfo) {
-                                        .origin_mask = di_u.origin_mask | di_other.origin_mask,
-                                        .destination_mask = di_u.destination_mask | di_other.destination_mask,
-                                };
+                                if (back == u) {
+                                        /* Do not add dependencies between u and itself. */
+                                        maybe_warn_about_dependency(u, other_id, q);
+                                        continue;
+                                }
 
-                                r = hashmap_remove_and_replace(back->dependencies[k], other, u, di_merged.data);
+                                /* We dropped this dependency between "back" and "other", let's create it between
+                                 * "back" and "u" instead, merging the bit masks with any such dependency which might
+                                 * already exist. */
+                                r = unit_dependency_add_entry(back, q, u, origin_mask, destination_mask);
                                 if (r < 0)
-                                        log_warning_errno(r, "Failed to remove/replace: back=%s other=%s u=%s: %m", back->id, other_id, u->id);
-                                assert(r >= 0);
-
-                                /* assert_se(hashmap_remove_and_replace(back->dependencies[k], other, u, di_merged.data) >= 0); */
+                                        return r;
                         }
                 }
 
-        }
+        for (c = 0; c < other->n_dependency_chunks; c++)
+                for (k = 0; k < other->dependencies[c]->n_entries; k++) {
+                        UnitDependencyEntry *e = other->dependencies[c]->entries + k;
+
+                        /* Also do not move dependencies on u to itself */
+                        if (e->other == u) {
+                                maybe_warn_about_dependency(u, other_id, e->type);
+                                continue;
+                        }
 
-        /* Also do not move dependencies on u to itself */
-        back = hashmap_remove(other->dependencies[d], u);
-        if (back)
-                maybe_warn_about_dependency(u, other_id, d);
+                        r = unit_dependency_add_entry(u, e->type, e->other, e->origin_mask, e->destination_mask);
+                        if (r < 0)
+                                return r;
+                }
 
-        /* The move cannot fail. The caller must have performed a reservation. */
-        assert_se(hashmap_complete_move(&u->dependencies[d], &other->dependencies[d]) == 0);
+        for (c = 0; c < other->n_dependency_chunks; c++)
+                free(other->dependencies[c]);
+        other->dependencies = mfree(other->dependencies);
+        other->n_dependency_chunks = other->n_dependency_chunks_allocated = 0;
 
-        other->dependencies[d] = hashmap_free(other->dependencies[d]);
+        return 0;
 }
 
 int unit_merge(Unit *u, Unit *other) {
-        UnitDependency d;
         const char *other_id = NULL;
         int r;
 
@@ -895,17 +1321,6 @@ int unit_merge(Unit *u, Unit *other) {
         if (other->id)
                 other_id = strdupa(other->id);
 
-        /* Make reservations to ensure merge_dependencies() won't fail */
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                r = reserve_dependencies(u, other, d);
-                /*
-                 * We don't rollback reservations if we fail. We don't have
-                 * a way to undo reservations. A reservation is not a leak.
-                 */
-                if (r < 0)
-                        return r;
-        }
-
         /* Merge names */
         r = merge_names(u, other);
         if (r < 0)
@@ -916,8 +1331,9 @@ int unit_merge(Unit *u, Unit *other) {
                 unit_ref_set(other->refs_by_target, other->refs_by_target->source, u);
 
         /* Merge dependencies */
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                merge_dependencies(u, other, other_id, d);
+        r = merge_dependencies(u, other, other_id);
+        if (r < 0)
+                return r;
 
         other->load_state = UNIT_MERGED;
         other->merged_into = u;
@@ -1101,6 +1517,7 @@ static void print_unit_dependency_mask(FILE *f, const char *kind, UnitDependency
 }
 
 void unit_dump(Unit *u, FILE *f, const char *prefix) {
+        UnitDependencyIterator k;
         char *t, **j;
         UnitDependency d;
         Iterator i;
@@ -1265,7 +1682,7 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
                 UnitDependencyInfo di;
                 Unit *other;
 
-                HASHMAP_FOREACH_KEY(di.data, other, u->dependencies[d], i) {
+                UNIT_FOREACH_DEPENDENCY_INFO(other, di, u, d, k) {
                         bool space = false;
 
                         fprintf(f, "%s\t%s: %s (", prefix, unit_dependency_to_string(d), other->id);
@@ -1403,7 +1820,7 @@ int unit_add_default_target_dependency(Unit *u, Unit *target) {
                 return 0;
 
         /* Don't create loops */
-        if (hashmap_get(target->dependencies[UNIT_BEFORE], u))
+        if (unit_has_dependency(target, UNIT_BEFORE, u))
                 return 0;
 
         return unit_add_dependency(target, UNIT_AFTER, u, true, UNIT_DEPENDENCY_DEFAULT);
@@ -1518,7 +1935,8 @@ int unit_load(Unit *u) {
 
         if (u->transient_file) {
                 /* Finalize transient file: if this is a transient unit file, as soon as we reach unit_load() the setup
-                 * is complete, hence let's synchronize the unit file we just wrote to disk. */
+                 * is complete. The settings have been applied already, and are not read back from the file, hence
+                 * writing it to disk can wait until the manager is done with the request that created the unit. */
 
                 r = fflush_and_check(u->transient_file);
                 if (r < 0)
@@ -1526,6 +1944,11 @@ int unit_load(Unit *u) {
 
                 u->transient_file = safe_fclose(u->transient_file);
                 u->fragment_mtime = now(CLOCK_REALTIME);
+
+                if (!u->in_transient_write_queue) {
+                        LIST_PREPEND(transient_write_queue, u->manager->transient_write_queue, u);
+                        u->in_transient_write_queue = true;
+                }
         }
 
         if (UNIT_VTABLE(u)->load) {
@@ -1554,7 +1977,7 @@ int unit_load(Unit *u) {
                 if (r < 0)
                         goto fail;
 
-                if (u->on_failure_job_mode == JOB_ISOLATE && hashmap_size(u->dependencies[UNIT_ON_FAILURE]) > 1) {
+                if (u->on_failure_job_mode == JOB_ISOLATE && unit_dependency_count(u, UNIT_ON_FAILURE) > 1) {
                         log_unit_error(u, "More than one OnFailure= dependencies specified but OnFailureJobMode=isolate set. Refusing.");
                         r = -ENOEXEC;
                         goto fail;
@@ -1701,8 +2124,7 @@ bool unit_shall_confirm_spawn(Unit *u) {
 
 static bool unit_verify_deps(Unit *u) {
         Unit *other;
-        Iterator j;
-        void *v;
+        UnitDependencyIterator j;
 
         assert(u);
 
@@ -1711,9 +2133,9 @@ static bool unit_verify_deps(Unit *u) {
          * processing, but do not have any effect afterwards. We don't check BindsTo= dependencies that are not used in
          * conjunction with After= as for them any such check would make things entirely racy. */
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], j) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO, j) {
 
-                if (!hashmap_contains(u->dependencies[UNIT_AFTER], other))
+                if (!unit_has_dependency(u, UNIT_AFTER, other))
                         continue;
 
                 if (!UNIT_IS_ACTIVE_OR_RELOADING(unit_active_state(other))) {
@@ -1925,7 +2347,7 @@ bool unit_can_reload(Unit *u) {
         if (UNIT_VTABLE(u)->can_reload)
                 return UNIT_VTABLE(u)->can_reload(u);
 
-        if (!hashmap_isempty(u->dependencies[UNIT_PROPAGATES_RELOAD_TO]))
+        if (unit_dependency_count(u, UNIT_PROPAGATES_RELOAD_TO) > 0)
                 return true;
 
         return UNIT_VTABLE(u)->reload;
@@ -1953,13 +2375,12 @@ bool unit_is_unneeded(Unit *u) {
 
         for (j = 0; j < ELEMENTSOF(deps); j++) {
                 Unit *other;
-                Iterator i;
-                void *v;
+                UnitDependencyIterator i;
 
                 /* If a dependent unit has a job queued, is active or transitioning, or is marked for
                  * restart, then don't clean this one up. */
 
-                HASHMAP_FOREACH_KEY(v, other, u->dependencies[deps[j]], i) {
+                UNIT_FOREACH_DEPENDENCY(other, u, deps[j], i) {
                         if (other->job)
                                 return false;
 
@@ -1990,10 +2411,9 @@ static void check_unneeded_dependencies(Unit *u) {
 
         for (j = 0; j < ELEMENTSOF(deps); j++) {
                 Unit *other;
-                Iterator i;
-                void *v;
+                UnitDependencyIterator i;
 
-                HASHMAP_FOREACH_KEY(v, other, u->dependencies[deps[j]], i)
+                UNIT_FOREACH_DEPENDENCY(other, u, deps[j], i)
                         unit_submit_to_stop_when_unneeded_queue(other);
         }
 }
@@ -2002,8 +2422,7 @@ static void unit_check_binds_to(Unit *u) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         bool stop = false;
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
         int r;
 
         assert(u);
@@ -2014,7 +2433,7 @@ static void unit_check_binds_to(Unit *u) {
         if (unit_active_state(u) != UNIT_ACTIVE)
                 return;
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO, i) {
                 if (other->job)
                         continue;
 
@@ -2050,65 +2469,62 @@ static void unit_check_binds_to(Unit *u) {
 }
 
 static void retroactively_start_dependencies(Unit *u) {
-        Iterator i;
+        UnitDependencyIterator i;
         Unit *other;
-        void *v;
 
         assert(u);
         assert(UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(u)));
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REQUIRES], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_WANTS], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTS, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_FAIL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_CONFLICTS], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTS, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_CONFLICTED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTED_BY, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL);
 }
 
 static void retroactively_stop_dependencies(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         assert(u);
         assert(UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(u)));
 
         /* Pull down units which are bound to us recursively if enabled */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BOUND_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BOUND_BY, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL);
 }
 
 void unit_start_on_failure(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
         int r;
 
         assert(u);
 
-        if (hashmap_size(u->dependencies[UNIT_ON_FAILURE]) <= 0)
+        if (unit_dependency_count(u, UNIT_ON_FAILURE) <= 0)
                 return;
 
         log_unit_info(u, "Triggering OnFailure= dependencies.");
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_ON_FAILURE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_ON_FAILURE, i) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
 
                 r = manager_add_job(u->manager, JOB_START, other, u->on_failure_job_mode, &error, NULL);
@@ -2119,12 +2535,11 @@ void unit_start_on_failure(Unit *u) {
 
 void unit_trigger_notify(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
 
         assert(u);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_TRIGGERED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_TRIGGERED_BY, i)
                 if (UNIT_VTABLE(other)->trigger_notify)
                         UNIT_VTABLE(other)->trigger_notify(other, u);
 }
@@ -2135,6 +2550,7 @@ static int unit_log_resources(Unit *u) {
         _cleanup_free_ char *igress = NULL, *egress = NULL;
         size_t n_message_parts = 0, n_iovec = 0;
         char* message_parts[3 + 1], *t;
+        uint64_t ip_accounting[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
         nsec_t nsec = NSEC_INFINITY;
         CGroupIPAccountingMetric m;
         size_t i;
@@ -2174,13 +2590,16 @@ static int unit_log_resources(Unit *u) {
                 message_parts[n_message_parts++] = t;
         }
 
+        if (unit_get_ip_accounting_all(u, ip_accounting) < 0)
+                for (m = 0; m < _CGROUP_IP_ACCOUNTING_METRIC_MAX; m++)
+                        ip_accounting[m] = UINT64_MAX;
+
         for (m = 0; m < _CGROUP_IP_ACCOUNTING_METRIC_MAX; m++) {
                 char buf[FORMAT_BYTES_MAX] = "";
-                uint64_t value = UINT64_MAX;
+                uint64_t value = ip_accounting[m];
 
                 assert(ip_fields[m]);
 
-                (void) unit_get_ip_accounting(u, m, &value);
                 if (value == UINT64_MAX)
                         continue;
 
@@ -2437,6 +2856,9 @@ void unit_notify(Unit *u, UnitActiveState os, UnitActiveState ns, UnitNotifyFlag
                 unit_unlink_state_files(u);
         }
 
+        /* The active state is kept exported for inactive and failed units too, as long as they are loaded */
+        (void) unit_export_active_state(u, ns);
+
         unit_update_on_console(u);
 
         if (!MANAGER_IS_RELOADING(m)) {
@@ -2756,53 +3178,6 @@ static void maybe_warn_about_dependency(Unit *u, const char *other, UnitDependen
                 log_unit_warning(u, "Dependency %s=%s dropped, merged into %s", unit_dependency_to_string(dependency), strna(other), u->id);
 }
 
-static int unit_add_dependency_hashmap(
-                Hashmap **h,
-                Unit *other,
-                UnitDependencyMask origin_mask,
-                UnitDependencyMask destination_mask) {
-
-        UnitDependencyInfo info;
-        int r;
-
-        assert(h);
-        assert(other);
-        assert(origin_mask < _UNIT_DEPENDENCY_MASK_FULL);
-        assert(destination_mask < _UNIT_DEPENDENCY_MASK_FULL);
-        assert(origin_mask > 0 || destination_mask > 0);
-
-        r = hashmap_ensure_allocated(h, NULL);
-        if (r < 0)
-                return r;
-
-        assert_cc(sizeof(void*) == sizeof(info));
-
-        info.data = hashmap_get(*h, other);
-        if (info.data) {
-                /* Entry already exists. Add in our mask. */
-
-                if (FLAGS_SET(origin_mask, info.origin_mask) &&
-                    FLAGS_SET(destination_mask, info.destination_mask))
-                        return 0; /* NOP */
-
-                info.origin_mask |= origin_mask;
-                info.destination_mask |= destination_mask;
-
-                r = hashmap_update(*h, other, info.data);
-        } else {
-                info = (UnitDependencyInfo) {
-                        .origin_mask = origin_mask,
-                        .destination_mask = destination_mask,
-                };
-
-                r = hashmap_put(*h, other, info.data);
-        }
-        if (r < 0)
-                return r;
-
-        return 1;
-}
-
 int unit_add_dependency(
                 Unit *u,
                 UnitDependency d,
@@ -2857,22 +3232,22 @@ int unit_add_dependency(
                 return 0;
         }
 
-        r = unit_add_dependency_hashmap(u->dependencies + d, other, mask, 0);
+        r = unit_dependency_add_entry(u, d, other, mask, 0);
         if (r < 0)
                 return r;
 
         if (inverse_table[d] != _UNIT_DEPENDENCY_INVALID && inverse_table[d] != d) {
-                r = unit_add_dependency_hashmap(other->dependencies + inverse_table[d], u, 0, mask);
+                r = unit_dependency_add_entry(other, inverse_table[d], u, 0, mask);
                 if (r < 0)
                         return r;
         }
 
         if (add_reference) {
-                r = unit_add_dependency_hashmap(u->dependencies + UNIT_REFERENCES, other, mask, 0);
+                r = unit_dependency_add_entry(u, UNIT_REFERENCES, other, mask, 0);
                 if (r < 0)
                         return r;
 
-                r = unit_add_dependency_hashmap(other->dependencies + UNIT_REFERENCED_BY, u, 0, mask);
+                r = unit_dependency_add_entry(other, UNIT_REFERENCED_BY, u, 0, mask);
                 if (r < 0)
                         return r;
         }
@@ -3206,6 +3581,7 @@ static const char *ip_accounting_metric_field[_CGROUP_IP_ACCOUNTING_METRIC_MAX]
 };
 
 int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
+        uint64_t ip_accounting[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
         CGroupIPAccountingMetric m;
         int r;
 
@@ -3226,6 +3602,9 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
         (void) serialize_dual_timestamp(f, "active-exit-timestamp", &u->active_exit_timestamp);
         (void) serialize_dual_timestamp(f, "inactive-enter-timestamp", &u->inactive_enter_timestamp);
 
+        (void) serialize_dual_timestamp(f, "job-install-timestamp", &u->job_install_timestamp);
+        (void) serialize_dual_timestamp(f, "job-run-timestamp", &u->job_run_timestamp);
+
         (void) serialize_dual_timestamp(f, "condition-timestamp", &u->condition_timestamp);
         (void) serialize_dual_timestamp(f, "assert-timestamp", &u->assert_timestamp);
 
@@ -3241,6 +3620,8 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
         (void) serialize_bool(f, "exported-invocation-id", u->exported_invocation_id);
         (void) serialize_bool(f, "exported-log-level-max", u->exported_log_level_max);
         (void) serialize_bool(f, "exported-log-extra-fields", u->exported_log_extra_fields);
+        if (u->exported_active_state >= 0)
+                (void) serialize_item(f, "exported-active-state", unit_active_state_to_string(u->exported_active_state));
         (void) serialize_bool(f, "exported-log-rate-limit-interval", u->exported_log_rate_limit_interval);
         (void) serialize_bool(f, "exported-log-rate-limit-burst", u->exported_log_rate_limit_burst);
 
@@ -3266,13 +3647,9 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
 
         bus_track_serialize(u->bus_track, f, "ref");
 
-        for (m = 0; m < _CGROUP_IP_ACCOUNTING_METRIC_MAX; m++) {
-                uint64_t v;
-
-                r = unit_get_ip_accounting(u, m, &v);
-                if (r >= 0)
-                        (void) serialize_item_format(f, ip_accounting_metric_field[m], "%" PRIu64, v);
-        }
+        if (unit_get_ip_accounting_all(u, ip_accounting) >= 0)
+                for (m = 0; m < _CGROUP_IP_ACCOUNTING_METRIC_MAX; m++)
+                        (void) serialize_item_format(f, ip_accounting_metric_field[m], "%" PRIu64, ip_accounting[m]);
 
         if (serialize_jobs) {
                 if (u->job) {
@@ -3369,6 +3746,12 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                 } else if (streq(l, "inactive-enter-timestamp")) {
                         (void) deserialize_dual_timestamp(v, &u->inactive_enter_timestamp);
                         continue;
+                } else if (streq(l, "job-install-timestamp")) {
+                        (void) deserialize_dual_timestamp(v, &u->job_install_timestamp);
+                        continue;
+                } else if (streq(l, "job-run-timestamp")) {
+                        (void) deserialize_dual_timestamp(v, &u->job_run_timestamp);
+                        continue;
                 } else if (streq(l, "condition-timestamp")) {
                         (void) deserialize_dual_timestamp(v, &u->condition_timestamp);
                         continue;
@@ -3465,6 +3848,17 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
 
                         continue;
 
+                } else if (streq(l, "exported-active-state")) {
+                        UnitActiveState state;
+
+                        state = unit_active_state_from_string(v);
+                        if (state < 0)
+                                log_unit_debug(u, "Failed to parse exported active state %s, ignoring.", v);
+                        else
+                                u->exported_active_state = state;
+
+                        continue;
+
                 } else if (STR_IN_SET(l, "cpu-usage-base", "cpuacct-usage-base")) {
 
                         r = safe_atou64(v, &u->cpu_usage_base);
@@ -3488,6 +3882,7 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                                 log_unit_debug_errno(u, r, "Failed to set cgroup path %s, ignoring: %m", v);
 
                         (void) unit_watch_cgroup(u);
+                        (void) unit_watch_pressure(u);
 
                         continue;
                 } else if (streq(l, "cgroup-realized")) {
@@ -3754,8 +4149,9 @@ bool unit_need_daemon_reload(Unit *u) {
 
         assert(u);
 
-        /* For unit files, we allow masking… */
-        if (fragment_mtime_newer(u->fragment_path, u->fragment_mtime,
+        /* For unit files, we allow masking… A transient unit file that we did not write yet cannot be outdated. */
+        if (!u->in_transient_write_queue &&
+            fragment_mtime_newer(u->fragment_path, u->fragment_mtime,
                                  u->load_state == UNIT_MASKED))
                 return true;
 
@@ -3776,6 +4172,40 @@ bool unit_need_daemon_reload(Unit *u) {
         return false;
 }
 
+bool unit_changed_on_disk(Unit *u) {
+        _cleanup_strv_free_ char **t = NULL;
+        _cleanup_free_ char *fragment = NULL;
+        int r;
+
+        assert(u);
+
+        /* Like unit_need_daemon_reload(), but also notices unit files that were added, masked or overridden in a
+         * directory of higher priority, and changes in the .wants/ and .requires/ directories. If in doubt, we
+         * say the unit changed. */
+
+        if (IN_SET(u->load_state, UNIT_STUB, UNIT_MERGED))
+                return false;
+
+        if (unit_need_daemon_reload(u))
+                return true;
+
+        r = unit_find_fragment(u, &fragment);
+        if (r < 0)
+                return true;
+        if (fragment && !path_equal_ptr(fragment, u->fragment_path))
+                return true;
+
+        if (IN_SET(u->load_state, UNIT_LOADED, UNIT_MASKED)) {
+                r = unit_find_dependency_dropin_paths(u, &t);
+                if (r < 0)
+                        return true;
+                if (!strv_equal(u->dependency_dropin_paths, t))
+                        return true;
+        }
+
+        return false;
+}
+
 void unit_reset_failed(Unit *u) {
         assert(u);
 
@@ -4348,12 +4778,9 @@ int unit_write_setting(Unit *u, UnitWriteFlags flags, const char *name, const ch
         if (r < 0)
                 return r;
 
-        r = strv_push(&u->dropin_paths, q);
+        r = intern_strv_extend(&u->dropin_paths, q);
         if (r < 0)
                 return r;
-        q = NULL;
-
-        strv_uniq(u->dropin_paths);
 
         u->dropin_mtime = now(CLOCK_REALTIME);
 
@@ -4391,28 +4818,34 @@ int unit_make_transient(Unit *u) {
         if (!UNIT_VTABLE(u)->can_transient)
                 return -EOPNOTSUPP;
 
-        (void) mkdir_p_label(u->manager->lookup_paths.transient, 0755);
-
         path = strjoin(u->manager->lookup_paths.transient, "/", u->id);
         if (!path)
                 return -ENOMEM;
 
-        /* Let's open the file we'll write the transient settings into. This file is kept open as long as we are
-         * creating the transient, and is closed in unit_load(), as soon as we start loading the file. */
+        /* Let's open the stream we'll write the transient settings into. This stream is kept open as long as we are
+         * creating the transient, and is closed in unit_load(), as soon as we start loading the unit. It is
+         * backed by memory only, the file is written to disk later by unit_write_transient_file(). */
 
-        RUN_WITH_UMASK(0022) {
-                f = fopen(path, "we");
-                if (!f)
-                        return -errno;
+        u->transient_file = safe_fclose(u->transient_file);
+        u->transient_contents = mfree(u->transient_contents);
+        u->transient_size = 0;
+
+        if (u->in_transient_write_queue) {
+                LIST_REMOVE(transient_write_queue, u->manager->transient_write_queue, u);
+                u->in_transient_write_queue = false;
         }
 
-        safe_fclose(u->transient_file);
+        f = open_memstream(&u->transient_contents, &u->transient_size);
+        if (!f)
+                return -ENOMEM;
+
         u->transient_file = f;
 
         free_and_replace(u->fragment_path, path);
 
         u->source_path = mfree(u->source_path);
-        u->dropin_paths = strv_free(u->dropin_paths);
+        u->dropin_paths = intern_strv_free(u->dropin_paths);
+        u->dependency_dropin_paths = strv_free(u->dependency_dropin_paths);
         u->fragment_mtime = u->source_mtime = u->dropin_mtime = 0;
 
         u->load_state = UNIT_STUB;
@@ -4428,6 +4861,38 @@ int unit_make_transient(Unit *u) {
         return 0;
 }
 
+int unit_write_transient_file(Unit *u) {
+        _cleanup_free_ char *contents = NULL;
+        int r = 0;
+
+        assert(u);
+
+        /* Writes out the transient unit file unit_make_transient() put together in memory, if that didn't happen
+         * yet. */
+
+        if (!u->in_transient_write_queue)
+                return 0;
+
+        LIST_REMOVE(transient_write_queue, u->manager->transient_write_queue, u);
+        u->in_transient_write_queue = false;
+
+        contents = TAKE_PTR(u->transient_contents);
+        u->transient_size = 0;
+
+        if (!contents || !u->fragment_path)
+                return 0;
+
+        (void) mkdir_p_label(u->manager->lookup_paths.transient, 0755);
+
+        RUN_WITH_UMASK(0022)
+                r = write_string_file(u->fragment_path, contents, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_AVOID_NEWLINE);
+        if (r < 0)
+                return log_unit_warning_errno(u, r, "Failed to write transient unit file %s: %m", u->fragment_path);
+
+        u->fragment_mtime = now(CLOCK_REALTIME);
+        return 0;
+}
+
 static void log_kill(pid_t pid, int sig, void *userdata) {
         _cleanup_free_ char *comm = NULL;
 
@@ -4664,8 +5129,7 @@ int unit_setup_exec_runtime(Unit *u) {
         ExecRuntime **rt;
         size_t offset;
         Unit *other;
-        Iterator i;
-        void *v;
+        UnitDependencyIterator i;
         int r;
 
         offset = UNIT_VTABLE(u)->exec_runtime_offset;
@@ -4677,10 +5141,16 @@ int unit_setup_exec_runtime(Unit *u) {
                 return 0;
 
         /* Try to get it from somebody else */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_JOINS_NAMESPACE_OF], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_JOINS_NAMESPACE_OF, i) {
                 r = exec_runtime_acquire(u->manager, NULL, other->id, false, rt);
-                if (r == 1)
+                if (r != 1)
+                        continue;
+
+                if (exec_runtime_has_namespaces(*rt))
                         return 1;
+
+                /* Only the other unit's root image is set up, there's nothing to join */
+                *rt = exec_runtime_unref(*rt, false);
         }
 
         return exec_runtime_acquire(u->manager, unit_get_exec_context(u), u->id, true, rt);
@@ -5053,23 +5523,25 @@ int unit_fork_helper_process(Unit *u, const char *name, pid_t *ret) {
         return 0;
 }
 
-static void unit_update_dependency_mask(Unit *u, UnitDependency d, Unit *other, UnitDependencyInfo di) {
+static bool unit_update_dependency_mask(Unit *u, size_t c, unsigned k) {
+        UnitDependencyEntry *e;
+
         assert(u);
-        assert(d >= 0);
-        assert(d < _UNIT_DEPENDENCY_MAX);
-        assert(other);
 
-        if (di.origin_mask == 0 && di.destination_mask == 0) {
-                /* No bit set anymore, let's drop the whole entry */
-                assert_se(hashmap_remove(u->dependencies[d], other));
-                log_unit_debug(u, "%s lost dependency %s=%s", u->id, unit_dependency_to_string(d), other->id);
-        } else
-                /* Mask was reduced, let's update the entry */
-                assert_se(hashmap_update(u->dependencies[d], other, di.data) == 0);
+        e = u->dependencies[c]->entries + k;
+        if (e->origin_mask != 0 || e->destination_mask != 0)
+                return false;
+
+        /* No bit set anymore, let's drop the whole entry */
+        log_unit_debug(u, "%s lost dependency %s=%s", u->id, unit_dependency_to_string(e->type), e->other->id);
+        unit_dependency_remove_at(u, c, k);
+
+        return true;
 }
 
 void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
-        UnitDependency d;
+        size_t c = 0;
+        unsigned k = 0;
 
         assert(u);
 
@@ -5078,47 +5550,49 @@ void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
         if (mask == 0)
                 return;
 
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                bool done;
-
-                do {
-                        UnitDependencyInfo di;
-                        Unit *other;
-                        Iterator i;
-
-                        done = true;
+        while (c < u->n_dependency_chunks) {
+                UnitDependencyEntry *e;
+                UnitDependency q;
+                Unit *other;
 
-                        HASHMAP_FOREACH_KEY(di.data, other, u->dependencies[d], i) {
-                                UnitDependency q;
+                if (k >= u->dependencies[c]->n_entries) {
+                        c++;
+                        k = 0;
+                        continue;
+                }
 
-                                if ((di.origin_mask & ~mask) == di.origin_mask)
-                                        continue;
-                                di.origin_mask &= ~mask;
-                                unit_update_dependency_mask(u, d, other, di);
+                e = u->dependencies[c]->entries + k;
+                other = e->other;
 
-                                /* We updated the dependency from our unit to the other unit now. But most dependencies
-                                 * imply a reverse dependency. Hence, let's delete that one too. For that we go through
-                                 * all dependency types on the other unit and delete all those which point to us and
-                                 * have the right mask set. */
+                if ((e->origin_mask & ~mask) == e->origin_mask) {
+                        k++;
+                        continue;
+                }
 
-                                for (q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
-                                        UnitDependencyInfo dj;
+                e->origin_mask &= ~mask;
+                if (!unit_update_dependency_mask(u, c, k))
+                        k++; /* Otherwise the entry was removed, and the next one took its place */
 
-                                        dj.data = hashmap_get(other->dependencies[q], u);
-                                        if ((dj.destination_mask & ~mask) == dj.destination_mask)
-                                                continue;
-                                        dj.destination_mask &= ~mask;
+                /* We updated the dependency from our unit to the other unit now. But most dependencies imply a reverse
+                 * dependency. Hence, let's delete that one too. For that we go through all dependency types on the
+                 * other unit and delete all those which point to us and have the right mask set. */
 
-                                        unit_update_dependency_mask(other, q, u, dj);
-                                }
+                for (q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
+                        UnitDependencyEntry *f;
+                        size_t fc;
+                        unsigned fk;
 
-                                unit_add_to_gc_queue(other);
+                        f = unit_dependency_find(other, q, u, &fc, &fk);
+                        if (!f)
+                                continue;
+                        if ((f->destination_mask & ~mask) == f->destination_mask)
+                                continue;
+                        f->destination_mask &= ~mask;
 
-                                done = false;
-                                break;
-                        }
+                        (void) unit_update_dependency_mask(other, fc, fk);
+                }
 
-                } while (!done);
+                unit_add_to_gc_queue(other);
         }
 }
 
@@ -5366,6 +5840,47 @@ void unit_unlink_state_files(Unit *u) {
         }
 }
 
+int unit_export_active_state(Unit *u, UnitActiveState state) {
+        int r;
+
+        assert(u);
+        assert(state >= 0 && state < _UNIT_ACTIVE_STATE_MAX);
+
+        if (!u->id)
+                return 0;
+
+        if (!MANAGER_IS_SYSTEM(u->manager))
+                return 0;
+
+        if (MANAGER_IS_TEST_RUN(u->manager))
+                return 0;
+
+        /* Unlike the other state files, this one is updated on every change of the high-level state, so that
+         * "systemctl is-active" and friends can read it in one system call, without connecting to us. Low-level
+         * state changes that map to the same high-level state are frequent, skip them cheaply. */
+
+        if (u->exported_active_state == state)
+                return 0;
+
+        r = unit_active_state_export(NULL, u->id, state);
+        if (r < 0)
+                return log_unit_debug_errno(u, r, "Failed to create active state symlink for %s: %m", u->id);
+
+        u->exported_active_state = state;
+        return 0;
+}
+
+void unit_unlink_active_state_file(Unit *u) {
+        assert(u);
+
+        if (u->exported_active_state < 0)
+                return;
+
+        (void) unit_active_state_unexport(NULL, u->id);
+
+        u->exported_active_state = _UNIT_ACTIVE_STATE_INVALID;
+}
+
 int unit_prepare_exec(Unit *u) {
         int r;
 
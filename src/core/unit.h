@@ -83,7 +83,8 @@ typedef enum UnitDependencyMask {
         _UNIT_DEPENDENCY_MASK_FULL         = (1 << 8) - 1,
 } UnitDependencyMask;
 
-/* The Unit's dependencies[] hashmaps use this structure as value. It has the same size as a void pointer, and thus can
+/* The masks of a dependency, as returned by unit_get_dependency_info() and UNIT_FOREACH_DEPENDENCY_INFO(). The
+ * requires_mounts_for hashmap uses this structure as value too. It has the same size as a void pointer, and thus can
  * be stored directly as hashmap value, without any indirection. Note that this stores two masks, as both the origin
  * and the destination of a dependency might have created it. */
 typedef union UnitDependencyInfo {
@@ -94,6 +95,32 @@ typedef union UnitDependencyInfo {
         } _packed_;
 } UnitDependencyInfo;
 
+/* A single edge of the dependency graph. Each unit keeps all its dependencies in one sequence of these, sorted by
+ * dependency type first and the other unit second, so that all dependencies of one type are next to each other and
+ * any edge can be found with a binary search. The sequence is split into chunks of limited size, so that adding and
+ * removing entries stays cheap even for units with a huge number of dependencies, such as slices. */
+typedef struct UnitDependencyEntry {
+        Unit *other;
+        UnitDependency type:8;
+        UnitDependencyMask origin_mask:16;
+        UnitDependencyMask destination_mask:16;
+} UnitDependencyEntry;
+
+typedef struct UnitDependencyChunk {
+        unsigned n_entries, n_allocated;
+        UnitDependencyEntry entries[];
+} UnitDependencyChunk;
+
+/* Remembers where we are while iterating through the dependencies of a unit. We keep the last unit returned, so that
+ * changes to the dependencies while iterating (for example removing the current entry) are handled gracefully. */
+typedef struct UnitDependencyIterator {
+        size_t chunk;
+        unsigned idx;
+        Unit *last;
+} UnitDependencyIterator;
+
+#define UNIT_DEPENDENCY_ITERATOR_FIRST ((UnitDependencyIterator) {})
+
 #include "job.h"
 
 struct UnitRef {
@@ -117,9 +144,9 @@ typedef struct Unit {
 
         Set *names;
 
-        /* For each dependency type we maintain a Hashmap whose key is the Unit* object, and the value encodes why the
-         * dependency exists, using the UnitDependencyInfo type */
-        Hashmap *dependencies[_UNIT_DEPENDENCY_MAX];
+        /* All dependencies of this unit on other units, see UnitDependencyEntry above */
+        UnitDependencyChunk **dependencies;
+        size_t n_dependency_chunks, n_dependency_chunks_allocated;
 
         /* Similar, for RequiresMountsFor= path dependencies. The key is the path, the value the UnitDependencyInfo type */
         Hashmap *requires_mounts_for;
@@ -130,13 +157,18 @@ typedef struct Unit {
         char *fragment_path; /* if loaded from a config file this is the primary path to it */
         char *source_path; /* if converted, the source file */
         char **dropin_paths;
+        char **dependency_dropin_paths; /* the .wants/ and .requires/ symlinks we loaded dependencies from */
 
         usec_t fragment_mtime;
         usec_t source_mtime;
         usec_t dropin_mtime;
 
-        /* If this is a transient unit we are currently writing, this is where we are writing it to */
+        /* If this is a transient unit we are currently writing, this is where we are writing it to. The unit file
+         * is put together in memory, and only written to disk later on, see unit_write_transient_file(). Until
+         * then the contents are stored here. */
         FILE *transient_file;
+        char *transient_contents;
+        size_t transient_size;
 
         /* If there is something to do with this unit, then this is the installed job for it */
         Job *job;
@@ -177,6 +209,10 @@ typedef struct Unit {
         dual_timestamp active_exit_timestamp;
         dual_timestamp inactive_enter_timestamp;
 
+        /* Updated when the most recent job of the unit was installed, and when it started to run */
+        dual_timestamp job_install_timestamp;
+        dual_timestamp job_run_timestamp;
+
         UnitRef slice;
 
         /* Per type list */
@@ -200,12 +236,21 @@ typedef struct Unit {
         /* cgroup empty queue */
         LIST_FIELDS(Unit, cgroup_empty_queue);
 
+        /* Units whose cgroup might have run empty, but which we haven't verified yet */
+        LIST_FIELDS(Unit, cgroup_empty_check_queue);
+
         /* Target dependencies queue */
         LIST_FIELDS(Unit, target_deps_queue);
 
         /* Queue of units with StopWhenUnneeded set that shell be checked for clean-up. */
         LIST_FIELDS(Unit, stop_when_unneeded_queue);
 
+        /* Units to include in the next UnitsChanged signal */
+        LIST_FIELDS(Unit, units_changed_queue);
+
+        /* Transient units whose unit file still needs to be written to disk */
+        LIST_FIELDS(Unit, transient_write_queue);
+
         /* PIDs we keep an eye on. Note that a unit might have many
          * more, but these are the ones we care enough about to
          * process SIGCHLD for */
@@ -246,6 +291,13 @@ typedef struct Unit {
         nsec_t cpu_usage_base;
         nsec_t cpu_usage_last; /* the most recently read value */
 
+        /* The values the accounting sampler read most recently, and when it did so (CLOCK_REALTIME) */
+        usec_t accounting_sample_timestamp;
+        nsec_t cpu_usage_sample;
+        uint64_t memory_current_sample;
+        uint64_t tasks_current_sample;
+        uint64_t ip_accounting_sample[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
+
         /* Counterparts in the cgroup filesystem */
         char *cgroup_path;
         CGroupMask cgroup_realized_mask;           /* In which hierarchies does this unit's cgroup exist? (only relevant on cgroup v1) */
@@ -253,13 +305,20 @@ typedef struct Unit {
         CGroupMask cgroup_invalidated_mask;        /* A mask specifiying controllers which shall be considered invalidated, and require re-realization */
         CGroupMask cgroup_members_mask;            /* A cache for the controllers required by all children of this cgroup (only relevant for slice units) */
         int cgroup_inotify_wd;
+        dual_timestamp cgroup_realize_timestamp;   /* When the cgroup was last (re-)realized, and how long that took */
+        usec_t cgroup_realize_usec;
+
+        /* PSI triggers on the cgroup, and the thresholds and window they were registered with */
+        sd_event_source *pressure_event_source[_CGROUP_PRESSURE_RESOURCE_MAX];
+        usec_t pressure_trigger_usec[_CGROUP_PRESSURE_RESOURCE_MAX];
+        usec_t pressure_trigger_window_usec;
 
         /* Device Controller BPF program */
         BPFProgram *bpf_device_control_installed;
+        struct BPFDevicesShared *bpf_device_control_shared; /* The loaded program the above was cloned from */
 
         /* IP BPF Firewalling/accounting */
-        int ip_accounting_ingress_map_fd;
-        int ip_accounting_egress_map_fd;
+        int ip_accounting_map_fd;
 
         int ipv4_allow_map_fd;
         int ipv6_allow_map_fd;
@@ -268,6 +327,7 @@ typedef struct Unit {
 
         BPFProgram *ip_bpf_ingress, *ip_bpf_ingress_installed;
         BPFProgram *ip_bpf_egress, *ip_bpf_egress_installed;
+        struct BPFFirewallShared *ip_bpf_shared; /* Set if the two programs above are shared with other units */
 
         uint64_t ip_accounting_extra[_CGROUP_IP_ACCOUNTING_METRIC_MAX];
 
@@ -313,6 +373,9 @@ typedef struct Unit {
         /* Is this a unit that is always running and cannot be stopped? */
         bool perpetual;
 
+        /* Manager's unit_generation when anything ListUnits() reports about this unit last changed */
+        uint64_t generation;
+
         /* Booleans indicating membership of this unit in the various queues */
         bool in_load_queue:1;
         bool in_dbus_queue:1;
@@ -320,8 +383,11 @@ typedef struct Unit {
         bool in_gc_queue:1;
         bool in_cgroup_realize_queue:1;
         bool in_cgroup_empty_queue:1;
+        bool in_cgroup_empty_check_queue:1;
         bool in_target_deps_queue:1;
         bool in_stop_when_unneeded_queue:1;
+        bool in_transient_write_queue:1;
+        bool in_units_changed_queue:1;
 
         bool sent_dbus_new_signal:1;
 
@@ -349,6 +415,9 @@ typedef struct Unit {
         bool exported_log_rate_limit_interval:1;
         bool exported_log_rate_limit_burst:1;
 
+        /* The active state we last exported to /run/systemd/units/, _UNIT_ACTIVE_STATE_INVALID if none */
+        UnitActiveState exported_active_state;
+
         /* When writing transient unit files, stores which section we stored last. If < 0, we didn't write any yet. If
          * == 0 we are in the [Unit] section, if > 0 we are in the unit type-specific section. */
         signed int last_section_private:2;
@@ -498,6 +567,9 @@ typedef struct UnitVTable {
         /* Called whenever a process of this unit sends us a message */
         void (*notify_message)(Unit *u, const struct ucred *ucred, char **tags, FDSet *fds);
 
+        /* Called instead of notify_message() for messages consisting of nothing but WATCHDOG=1 */
+        void (*notify_watchdog)(Unit *u, const struct ucred *ucred);
+
         /* Called whenever a name this Unit registered for comes or goes away. */
         void (*bus_name_owner_change)(Unit *u, const char *name, const char *old_owner, const char *new_owner);
 
@@ -603,8 +675,20 @@ static inline const UnitVTable* UNIT_VTABLE(Unit *u) {
 #define UNIT_HAS_CGROUP_CONTEXT(u) (UNIT_VTABLE(u)->cgroup_context_offset > 0)
 #define UNIT_HAS_KILL_CONTEXT(u) (UNIT_VTABLE(u)->kill_context_offset > 0)
 
+bool unit_dependency_next(Unit *u, UnitDependency d, UnitDependencyIterator *i, Unit **ret, UnitDependencyInfo *ret_info);
+size_t unit_dependency_count(Unit *u, UnitDependency d);
+Unit* unit_first_dependency(Unit *u, UnitDependency d);
+bool unit_has_dependency(Unit *u, UnitDependency d, Unit *other);
+UnitDependencyInfo unit_get_dependency_info(Unit *u, UnitDependency d, Unit *other);
+
+#define UNIT_FOREACH_DEPENDENCY(other, u, d, i)                         \
+        for ((i) = UNIT_DEPENDENCY_ITERATOR_FIRST; unit_dependency_next((u), (d), &(i), &(other), NULL); )
+
+#define UNIT_FOREACH_DEPENDENCY_INFO(other, info, u, d, i)              \
+        for ((i) = UNIT_DEPENDENCY_ITERATOR_FIRST; unit_dependency_next((u), (d), &(i), &(other), &(info)); )
+
 static inline Unit* UNIT_TRIGGER(Unit *u) {
-        return hashmap_first_key(u->dependencies[UNIT_TRIGGERS]);
+        return unit_first_dependency(u, UNIT_TRIGGERS);
 }
 
 Unit *unit_new(Manager *m, size_t size);
@@ -629,6 +713,7 @@ bool unit_may_gc(Unit *u);
 
 void unit_add_to_load_queue(Unit *u);
 void unit_add_to_dbus_queue(Unit *u);
+void unit_bump_generation(Unit *u);
 void unit_add_to_cleanup_queue(Unit *u);
 void unit_add_to_gc_queue(Unit *u);
 void unit_add_to_target_deps_queue(Unit *u);
@@ -709,6 +794,7 @@ void unit_catchup(Unit *u);
 void unit_status_printf(Unit *u, const char *status, const char *unit_status_msg_format) _printf_(3, 0);
 
 bool unit_need_daemon_reload(Unit *u);
+bool unit_changed_on_disk(Unit *u);
 
 void unit_reset_failed(Unit *u);
 
@@ -756,6 +842,7 @@ int unit_write_settingf(Unit *u, UnitWriteFlags mode, const char *name, const ch
 int unit_kill_context(Unit *u, KillContext *c, KillOperation k, pid_t main_pid, pid_t control_pid, bool main_pid_alien);
 
 int unit_make_transient(Unit *u);
+int unit_write_transient_file(Unit *u);
 
 int unit_require_mounts_for(Unit *u, const char *path, UnitDependencyMask mask);
 
@@ -802,6 +889,9 @@ void unit_remove_dependencies(Unit *u, UnitDependencyMask mask);
 void unit_export_state_files(Unit *u);
 void unit_unlink_state_files(Unit *u);
 
+int unit_export_active_state(Unit *u, UnitActiveState state);
+void unit_unlink_active_state_file(Unit *u);
+
 int unit_prepare_exec(Unit *u);
 
 void unit_warn_leftover_processes(Unit *u);
@@ -1,9 +1,12 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdio_ext.h>
+#include <sys/file.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/xattr.h>
 #include <unistd.h>
 
@@ -23,14 +26,15 @@
 #include "cgroup-util.h"
 #include "compress.h"
 #include "conf-parser.h"
-#include "copy.h"
 #include "coredump-vacuum.h"
 #include "dirent-util.h"
+#include "env-file.h"
 #include "escape.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
 #include "io-util.h"
+#include "ioprio.h"
 #include "journal-importer.h"
 #include "log.h"
 #include "macro.h"
@@ -56,6 +60,19 @@
 /* The maximum size up to which we leave the coredump around on disk */
 #define EXTERNAL_SIZE_MAX PROCESS_SIZE_MAX
 
+/* The number of cores processed at the same time, before further ones are only summarized */
+#define PROCESS_CONCURRENCY_MAX 4U
+
+/* How much of a core we store if it is only summarized. This covers the ELF headers and notes, i.e. the registers
+ * and the list of mappings, for all but the most heavily threaded processes. */
+#define SUMMARY_SIZE_MAX ((uint64_t) (1024LLU*1024LLU))
+
+/* Each concurrently processed core holds a lock on one byte of this file */
+#define COREDUMP_SLOTS_FILE "/var/lib/systemd/coredump/.slots"
+
+/* Counts the cores that were only summarized or truncated */
+#define COREDUMP_STATS_FILE "/var/lib/systemd/coredump/.stats"
+
 /* The maximum size up to which we store the coredump in the journal */
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 #define JOURNAL_SIZE_MAX ((size_t) (767LU*1024LU*1024LU))
@@ -122,6 +139,7 @@ static uint64_t arg_external_size_max = EXTERNAL_SIZE_MAX;
 static uint64_t arg_journal_size_max = JOURNAL_SIZE_MAX;
 static uint64_t arg_keep_free = (uint64_t) -1;
 static uint64_t arg_max_use = (uint64_t) -1;
+static unsigned arg_process_concurrency_max = PROCESS_CONCURRENCY_MAX;
 
 static int parse_config(void) {
         static const ConfigTableItem items[] = {
@@ -132,6 +150,7 @@ static int parse_config(void) {
                 { "Coredump", "JournalSizeMax",   config_parse_iec_size,          0, &arg_journal_size_max  },
                 { "Coredump", "KeepFree",         config_parse_iec_uint64,        0, &arg_keep_free         },
                 { "Coredump", "MaxUse",           config_parse_iec_uint64,        0, &arg_max_use           },
+                { "Coredump", "ProcessConcurrencyMax", config_parse_unsigned,    0, &arg_process_concurrency_max },
                 {}
         };
 
@@ -319,6 +338,158 @@ static int make_filename(const char *context[_CONTEXT_MAX], char **ret) {
         return 0;
 }
 
+/* Cores are read in blocks of this size */
+#define COPY_CORE_BLOCK_SIZE (128U*1024U)
+
+static int write_sparse(int fd, const uint8_t *buf, size_t n, bool *hole) {
+        size_t p = 0;
+        int r;
+
+        /* Writes out buf, but leaves holes where whole pages are zero, as much of a core usually is. Returns in
+         * hole whether the file ends in one now. */
+
+        while (p < n) {
+                size_t l = 0;
+                bool zero;
+
+                zero = memeqzero(buf + p, MIN(page_size(), n - p));
+                do
+                        l += MIN(page_size(), n - p - l);
+                while (p + l < n && memeqzero(buf + p + l, MIN(page_size(), n - p - l)) == zero);
+
+                if (zero) {
+                        if (lseek(fd, l, SEEK_CUR) == (off_t) -1)
+                                return -errno;
+                } else {
+                        r = loop_write(fd, buf + p, l, false);
+                        if (r < 0)
+                                return r;
+                }
+
+                *hole = zero;
+                p += l;
+        }
+
+        return 0;
+}
+
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+typedef struct CompressThread {
+        pthread_t thread;
+        int input_fd;
+        int output_fd;
+        int r;
+} CompressThread;
+
+static void *compress_thread(void *p) {
+        CompressThread *t = p;
+
+        t->r = compress_stream(t->input_fd, t->output_fd, (uint64_t) -1);
+
+        /* If we failed early, make sure the writer gets EPIPE instead of blocking on a full pipe */
+        t->input_fd = safe_close(t->input_fd);
+        return NULL;
+}
+#endif
+
+static int copy_core(int input_fd, int fd, int fd_compressed, uint64_t max_size, int *ret_compress_error) {
+        _cleanup_close_pair_ int pipefd[2] = { -1, -1 };
+        _cleanup_free_ uint8_t *buf = NULL;
+        int compress_r = 0, r = 0, k;
+        uint64_t total = 0;
+        bool hole = false;
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+        CompressThread t = {};
+        bool started = false;
+#endif
+
+        assert(input_fd >= 0);
+        assert(fd >= 0);
+        assert(ret_compress_error);
+
+        /* Reads the core from input_fd once, writing it to fd, and if fd_compressed is valid, compressing it into
+         * that at the same time, in a separate thread. Returns 1 if the core was truncated to max_size. If the
+         * compression failed, the error is returned in ret_compress_error, but the uncompressed copy is complete
+         * nonetheless. */
+
+        buf = malloc(COPY_CORE_BLOCK_SIZE);
+        if (!buf)
+                return -ENOMEM;
+
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+        if (fd_compressed >= 0) {
+                if (pipe2(pipefd, O_CLOEXEC) < 0)
+                        compress_r = -errno;
+                else {
+                        /* Give the compressor some slack, so that reading and compressing can overlap */
+                        (void) fcntl(pipefd[1], F_SETPIPE_SZ, 8 * COPY_CORE_BLOCK_SIZE);
+
+                        t.input_fd = TAKE_FD(pipefd[0]);
+                        t.output_fd = fd_compressed;
+
+                        k = pthread_create(&t.thread, NULL, compress_thread, &t);
+                        if (k != 0) {
+                                compress_r = -k;
+                                t.input_fd = safe_close(t.input_fd);
+                                pipefd[1] = safe_close(pipefd[1]);
+                        } else
+                                started = true;
+                }
+        }
+#endif
+
+        for (;;) {
+                ssize_t n;
+
+                if (max_size != (uint64_t) -1 && total >= max_size) {
+                        r = 1;
+                        break;
+                }
+
+                n = loop_read(input_fd, buf, (size_t) MIN((uint64_t) COPY_CORE_BLOCK_SIZE, max_size - total), true);
+                if (n < 0) {
+                        r = (int) n;
+                        goto finish;
+                }
+                if (n == 0)
+                        break;
+
+                r = write_sparse(fd, buf, n, &hole);
+                if (r < 0)
+                        goto finish;
+
+                if (pipefd[1] >= 0) {
+                        k = loop_write(pipefd[1], buf, n, false);
+                        if (k < 0) {
+                                /* If the compressor gave up, its own error is more interesting than EPIPE */
+                                compress_r = k;
+                                pipefd[1] = safe_close(pipefd[1]);
+                        }
+                }
+
+                total += n;
+        }
+
+        /* A hole at the end does not extend the file by itself */
+        if (hole && ftruncate(fd, total) < 0)
+                r = -errno;
+
+finish:
+        /* Signal EOF to the compressor, and wait for it to finish the stream */
+        pipefd[1] = safe_close(pipefd[1]);
+
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+        if (started) {
+                (void) pthread_join(t.thread, NULL);
+                if (t.r < 0)
+                        compress_r = t.r;
+        }
+#endif
+
+        *ret_compress_error = compress_r;
+        return r;
+}
+
 static int save_external_coredump(
                 const char *context[_CONTEXT_MAX],
                 int input_fd,
@@ -326,11 +497,13 @@ static int save_external_coredump(
                 int *ret_node_fd,
                 int *ret_data_fd,
                 uint64_t *ret_size,
-                bool *ret_truncated) {
+                bool *ret_truncated,
+                bool summary) {
 
-        _cleanup_free_ char *fn = NULL, *tmp = NULL;
-        _cleanup_close_ int fd = -1;
+        _cleanup_free_ char *fn = NULL, *tmp = NULL, *fn_compressed = NULL, *tmp_compressed = NULL;
+        _cleanup_close_ int fd = -1, fd_compressed = -1;
         uint64_t rlimit, process_limit, max_size;
+        int compress_r = 0;
         struct stat st;
         uid_t uid;
         int r;
@@ -365,6 +538,9 @@ static int save_external_coredump(
         /* Never store more than the process configured, or than we actually shall keep or process */
         max_size = MIN(rlimit, process_limit);
 
+        if (summary)
+                max_size = MIN(max_size, SUMMARY_SIZE_MAX);
+
         r = make_filename(context, &fn);
         if (r < 0)
                 return log_error_errno(r, "Failed to determine coredump file name: %m");
@@ -375,7 +551,22 @@ static int save_external_coredump(
         if (fd < 0)
                 return log_error_errno(fd, "Failed to create temporary file for coredump %s: %m", fn);
 
-        r = copy_bytes(input_fd, fd, max_size, 0);
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+        /* If we will remove the coredump anyway, do not compress. The final size is not known before the core has
+         * been read, so this is checked again below. */
+        if (arg_compress && !maybe_remove_external_coredump(NULL, 0)) {
+                fn_compressed = strappend(fn, COMPRESSED_EXT);
+                if (!fn_compressed)
+                        log_oom();
+                else {
+                        fd_compressed = open_tmpfile_linkable(fn_compressed, O_RDWR|O_CLOEXEC, &tmp_compressed);
+                        if (fd_compressed < 0)
+                                log_error_errno(fd_compressed, "Failed to create temporary file for coredump %s: %m", fn_compressed);
+                }
+        }
+#endif
+
+        r = copy_core(input_fd, fd, fd_compressed, max_size, &compress_r);
         if (r < 0) {
                 log_error_errno(r, "Cannot store coredump of %s (%s): %m", context[CONTEXT_PID], context[CONTEXT_COMM]);
                 goto fail;
@@ -397,34 +588,18 @@ static int save_external_coredump(
                 goto fail;
         }
 
-#if HAVE_XZ || HAVE_LZ4
-        /* If we will remove the coredump anyway, do not compress. */
-        if (arg_compress && !maybe_remove_external_coredump(NULL, st.st_size)) {
-
-                _cleanup_free_ char *fn_compressed = NULL, *tmp_compressed = NULL;
-                _cleanup_close_ int fd_compressed = -1;
-
-                fn_compressed = strappend(fn, COMPRESSED_EXT);
-                if (!fn_compressed) {
-                        log_oom();
+        if (fd_compressed >= 0) {
+                if (compress_r < 0) {
+                        log_error_errno(compress_r, "Failed to compress %s: %m", coredump_tmpfile_name(tmp_compressed));
                         goto uncompressed;
                 }
 
-                fd_compressed = open_tmpfile_linkable(fn_compressed, O_RDWR|O_CLOEXEC, &tmp_compressed);
-                if (fd_compressed < 0) {
-                        log_error_errno(fd_compressed, "Failed to create temporary file for coredump %s: %m", fn_compressed);
+                if (maybe_remove_external_coredump(NULL, st.st_size))
                         goto uncompressed;
-                }
-
-                r = compress_stream(fd, fd_compressed, -1);
-                if (r < 0) {
-                        log_error_errno(r, "Failed to compress %s: %m", coredump_tmpfile_name(tmp_compressed));
-                        goto fail_compressed;
-                }
 
                 r = fix_permissions(fd_compressed, tmp_compressed, fn_compressed, context, uid);
                 if (r < 0)
-                        goto fail_compressed;
+                        goto uncompressed;
 
                 /* OK, this worked, we can get rid of the uncompressed version now */
                 if (tmp)
@@ -436,14 +611,11 @@ static int save_external_coredump(
                 *ret_size = (uint64_t) st.st_size; /* uncompressed */
 
                 return 0;
-
-        fail_compressed:
-                if (tmp_compressed)
-                        (void) unlink(tmp_compressed);
         }
 
 uncompressed:
-#endif
+        if (tmp_compressed)
+                (void) unlink(tmp_compressed);
 
         r = fix_permissions(fd, tmp, fn, context, uid);
         if (r < 0)
@@ -459,6 +631,8 @@ uncompressed:
 fail:
         if (tmp)
                 (void) unlink(tmp);
+        if (tmp_compressed)
+                (void) unlink(tmp_compressed);
         return r;
 }
 
@@ -710,20 +884,123 @@ static bool is_pid1_crash(const char *context[_CONTEXT_MAX]) {
                 streq_ptr(context[CONTEXT_PID], "1");
 }
 
-#define SUBMIT_COREDUMP_FIELDS 4
+static int acquire_processing_slot(int *ret_fd) {
+        _cleanup_close_ int fd = -1;
+        unsigned i;
+
+        assert(ret_fd);
+
+        /* Returns 1 and an fd holding the lock on a free slot, or 0 if all slots are taken. The lock is released
+         * when the fd is closed, or when we exit, whichever comes first. */
+
+        if (arg_process_concurrency_max == 0) {
+                *ret_fd = -1;
+                return 1;
+        }
+
+        mkdir_p_label("/var/lib/systemd/coredump", 0755);
+
+        fd = open(COREDUMP_SLOTS_FILE, O_RDWR|O_CREAT|O_CLOEXEC|O_NOCTTY, 0600);
+        if (fd < 0)
+                return -errno;
+
+        for (i = 0; i < arg_process_concurrency_max; i++) {
+                struct flock fl = {
+                        .l_type = F_WRLCK,
+                        .l_whence = SEEK_SET,
+                        .l_start = i,
+                        .l_len = 1,
+                };
+
+                if (fcntl(fd, F_OFD_SETLK, &fl) >= 0) {
+                        *ret_fd = TAKE_FD(fd);
+                        return 1;
+                }
+
+                if (!IN_SET(errno, EAGAIN, EACCES))
+                        return -errno;
+        }
+
+        *ret_fd = -1;
+        return 0;
+}
+
+static int update_stats(bool summary, bool truncated, uint64_t *ret_n_summarized) {
+        _cleanup_free_ char *summarized_str = NULL, *truncated_str = NULL;
+        uint64_t n_summarized = 0, n_truncated = 0;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        /* Counts cores that were only summarized, and those that were truncated for any reason */
+
+        if (!summary && !truncated)
+                return 0;
+
+        fd = open(COREDUMP_STATS_FILE, O_RDWR|O_CREAT|O_CLOEXEC|O_NOCTTY, 0644);
+        if (fd < 0)
+                return -errno;
+
+        if (flock(fd, LOCK_EX) < 0)
+                return -errno;
+
+        f = fdopen(fd, "r+");
+        if (!f)
+                return -errno;
+        fd = -1;
+
+        r = parse_env_file(f, COREDUMP_STATS_FILE,
+                           "SUMMARIZED", &summarized_str,
+                           "TRUNCATED", &truncated_str);
+        if (r < 0)
+                return r;
+
+        /* Start from zero again if the file is garbled */
+        if (summarized_str)
+                (void) safe_atou64(summarized_str, &n_summarized);
+        if (truncated_str)
+                (void) safe_atou64(truncated_str, &n_truncated);
+
+        if (summary)
+                n_summarized++;
+        if (truncated)
+                n_truncated++;
+
+        rewind(f);
+        if (ftruncate(fileno(f), 0) < 0)
+                return -errno;
+
+        fprintf(f,
+                "SUMMARIZED=%" PRIu64 "\n"
+                "TRUNCATED=%" PRIu64 "\n",
+                n_summarized, n_truncated);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        if (ret_n_summarized)
+                *ret_n_summarized = n_summarized;
+
+        return 0;
+}
+
+#define SUBMIT_COREDUMP_FIELDS 5
 
 static int submit_coredump(
                 const char *context[_CONTEXT_MAX],
                 struct iovec *iovec,
                 size_t n_iovec_allocated,
                 size_t n_iovec,
-                int input_fd) {
+                int input_fd,
+                bool summary) {
 
-        _cleanup_close_ int coredump_fd = -1, coredump_node_fd = -1;
+        /* Takes ownership of input_fd */
+        _cleanup_close_ int coredump_fd = -1, coredump_node_fd = -1, input_fd_close = input_fd;
         _cleanup_free_ char *core_message = NULL, *filename = NULL, *coredump_data = NULL;
-        uint64_t coredump_size = UINT64_MAX;
+        uint64_t coredump_size = UINT64_MAX, n_summarized = 0;
         bool truncated = false, journald_crash;
-        int r;
+        int r, q;
 
         assert(context);
         assert(iovec);
@@ -737,7 +1014,24 @@ static int submit_coredump(
 
         /* Always stream the coredump to disk, if that's possible */
         r = save_external_coredump(context, input_fd,
-                                   &filename, &coredump_node_fd, &coredump_fd, &coredump_size, &truncated);
+                                   &filename, &coredump_node_fd, &coredump_fd, &coredump_size, &truncated, summary);
+
+        /* The kernel keeps the crashed process and its memory around until the pipe the core is read from is
+         * closed. Release it right away, instead of only after the stack trace has been generated. That part may
+         * take a while for large cores, so let's also not compete for CPU and IO with whatever is restarting the
+         * process. */
+        input_fd_close = safe_close(input_fd_close);
+        (void) setpriority(PRIO_PROCESS, 0, PRIO_MAX - 1);
+        (void) ioprio_set(IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+        q = update_stats(summary, truncated, &n_summarized);
+        if (q < 0)
+                log_debug_errno(q, "Failed to update " COREDUMP_STATS_FILE ", ignoring: %m");
+        if (summary)
+                log_notice("%u cores are being processed already, only stored a summary of the core of process %s (%s). "
+                           "%" PRIu64 " cores were summarized so far.",
+                           arg_process_concurrency_max, context[CONTEXT_PID], context[CONTEXT_COMM], n_summarized);
+
         if (r < 0)
                 /* Skip whole core dumping part */
                 goto log;
@@ -769,7 +1063,9 @@ static int submit_coredump(
 
 #if HAVE_ELFUTILS
         /* Try to get a strack trace if we can */
-        if (coredump_size <= arg_process_size_max) {
+        if (summary)
+                log_debug("Not generating stack trace: only a summary of the core was stored.");
+        else if (coredump_size <= arg_process_size_max) {
                 _cleanup_free_ char *stacktrace = NULL;
 
                 r = coredump_make_stack_trace(coredump_fd, context[CONTEXT_EXE], &stacktrace);
@@ -812,6 +1108,9 @@ log:
         if (truncated)
                 iovec[n_iovec++] = IOVEC_MAKE_STRING("COREDUMP_TRUNCATED=1");
 
+        if (summary)
+                iovec[n_iovec++] = IOVEC_MAKE_STRING("COREDUMP_SUMMARY=1");
+
         /* Optionally store the entire coredump in the journal */
         if (arg_storage == COREDUMP_STORAGE_JOURNAL) {
                 if (coredump_size <= arg_journal_size_max) {
@@ -875,7 +1174,7 @@ static void map_context_fields(const struct iovec *iovec, const char* context[])
 }
 
 static int process_socket(int fd) {
-        _cleanup_close_ int coredump_fd = -1;
+        _cleanup_close_ int coredump_fd = -1, slot_fd = -1;
         struct iovec *iovec = NULL;
         size_t n_iovec = 0, n_allocated = 0, i, k;
         const char *context[_CONTEXT_MAX] = {};
@@ -987,7 +1286,13 @@ static int process_socket(int fd) {
         if (k > 6)
                 context[CONTEXT_TIMESTAMP] = strndupa(context[CONTEXT_TIMESTAMP], k - 6);
 
-        r = submit_coredump(context, iovec, n_allocated, n_iovec, coredump_fd);
+        /* Cores beyond the concurrency limit are only summarized, so that a crash loop of a large process cannot
+         * exhaust memory and IO. The slot is held until we exit. */
+        r = acquire_processing_slot(&slot_fd);
+        if (r < 0)
+                log_warning_errno(r, "Failed to acquire coredump processing slot, ignoring: %m");
+
+        r = submit_coredump(context, iovec, n_allocated, n_iovec, TAKE_FD(coredump_fd), r == 0);
 
 finish:
         for (i = 0; i < n_iovec; i++)
@@ -1256,7 +1561,7 @@ static int process_kernel(int argc, char* argv[]) {
         if (is_journald_crash((const char**) context) || is_pid1_crash((const char**) context))
                 r = submit_coredump((const char**) context,
                                     iovec, ELEMENTSOF(iovec), n_iovec,
-                                    STDIN_FILENO);
+                                    STDIN_FILENO, false);
         else
                 r = send_iovec(iovec, n_iovec, STDIN_FILENO);
 
@@ -1378,6 +1683,9 @@ static int run(int argc, char *argv[]) {
         /* Make sure we never enter a loop */
         (void) prctl(PR_SET_DUMPABLE, 0);
 
+        /* The core is fed to the compressor through a pipe, and we handle EPIPE on it ourselves */
+        (void) ignore_signals(SIGPIPE, -1);
+
         /* Ignore all parse errors */
         (void) parse_config();
 
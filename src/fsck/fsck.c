@@ -16,6 +16,7 @@
 #include "sd-device.h"
 
 #include "alloc-util.h"
+#include "blockdev-util.h"
 #include "bus-common-errors.h"
 #include "bus-error.h"
 #include "bus-util.h"
@@ -23,6 +24,7 @@
 #include "fd-util.h"
 #include "fs-util.h"
 #include "main-func.h"
+#include "mkdir.h"
 #include "parse-util.h"
 #include "path-util.h"
 #include "proc-cmdline.h"
@@ -262,12 +264,108 @@ static int fsck_progress_socket(void) {
         return TAKE_FD(fd);
 }
 
+static int compare_devnum(const dev_t *a, const dev_t *b) {
+        return CMP(*a, *b);
+}
+
+static int lock_disks(sd_device *dev, dev_t devnum, int **ret_fds, size_t *ret_n_fds) {
+        _cleanup_free_ dev_t *disks = NULL;
+        int *fds = NULL;
+        size_t n_disks = 0, n_fds = 0, i;
+        int r;
+
+        assert(dev);
+        assert(ret_fds);
+        assert(ret_n_fds);
+
+        /* fsck -l only locks the whole disk a file system is directly on, and nothing at all for file systems on
+         * stacked devices such as LVM or MD. Instead, take the same /run/fsck/<disk>.lock locks for all rotating
+         * disks the file system ultimately resides on, so that checks that would make the heads seek back and
+         * forth are serialized, but everything else runs in parallel. Locks are taken in the order of the device
+         * numbers, so that instances which share several disks cannot deadlock each other. */
+
+        r = block_get_physical_disks(devnum, &disks, &n_disks);
+        if (r < 0)
+                return r;
+
+        typesafe_qsort(disks, n_disks, compare_devnum);
+
+        r = mkdir_p("/run/fsck", 0755);
+        if (r < 0)
+                return r;
+
+        fds = new(int, n_disks);
+        if (!fds)
+                return -ENOMEM;
+
+        for (i = 0; i < n_disks; i++) {
+                _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+                _cleanup_free_ char *p = NULL;
+                _cleanup_close_ int fd = -1;
+                const char *sysname, *rotational;
+
+                r = sd_device_new_from_devnum(&d, 'b', disks[i]);
+                if (r < 0)
+                        goto fail;
+
+                r = sd_device_get_sysname(d, &sysname);
+                if (r < 0)
+                        goto fail;
+
+                if (sd_device_get_sysattr_value(d, "queue/rotational", &rotational) >= 0 &&
+                    streq(rotational, "0")) {
+                        log_device_debug(dev, "%s is not a rotating disk, not serializing checks on it.", sysname);
+                        continue;
+                }
+
+                p = strjoin("/run/fsck/", sysname, ".lock");
+                if (!p) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                fd = open(p, O_RDONLY|O_CREAT|O_CLOEXEC|O_NOCTTY, 0600);
+                if (fd < 0) {
+                        r = -errno;
+                        goto fail;
+                }
+
+                if (flock(fd, LOCK_EX|LOCK_NB) < 0) {
+                        if (errno != EWOULDBLOCK) {
+                                r = -errno;
+                                goto fail;
+                        }
+
+                        log_device_info(dev, "Waiting for the check of another file system on %s to finish.", sysname);
+
+                        if (flock(fd, LOCK_EX) < 0) {
+                                r = -errno;
+                                goto fail;
+                        }
+                }
+
+                fds[n_fds++] = TAKE_FD(fd);
+        }
+
+        *ret_fds = fds;
+        *ret_n_fds = n_fds;
+        return 0;
+
+fail:
+        close_many(fds, n_fds);
+        free(fds);
+        return r;
+}
+
 static int run(int argc, char *argv[]) {
         _cleanup_close_pair_ int progress_pipe[2] = { -1, -1 };
         _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        _cleanup_free_ int *lock_fds = NULL;
+        size_t n_lock_fds = 0;
         const char *device, *type;
-        bool root_directory;
+        bool root_directory, fsck_lock = false;
         struct stat st;
+        dev_t devnum;
         int r, exit_status;
         pid_t pid;
 
@@ -300,7 +398,9 @@ static int run(int argc, char *argv[]) {
                         return -EINVAL;
                 }
 
-                r = sd_device_new_from_devnum(&dev, 'b', st.st_rdev);
+                devnum = st.st_rdev;
+
+                r = sd_device_new_from_devnum(&dev, 'b', devnum);
                 if (r < 0)
                         return log_error_errno(r, "Failed to detect device %s: %m", device);
 
@@ -328,7 +428,9 @@ static int run(int argc, char *argv[]) {
                         return 0;
                 }
 
-                r = sd_device_new_from_devnum(&dev, 'b', st.st_dev);
+                devnum = st.st_dev;
+
+                r = sd_device_new_from_devnum(&dev, 'b', devnum);
                 if (r < 0)
                         return log_error_errno(r, "Failed to detect root device: %m");
 
@@ -349,6 +451,12 @@ static int run(int argc, char *argv[]) {
                 }
         }
 
+        r = lock_disks(dev, devnum, &lock_fds, &n_lock_fds);
+        if (r < 0) {
+                log_device_debug_errno(dev, r, "Failed to lock the disks backing the file system, leaving it to fsck: %m");
+                fsck_lock = true;
+        }
+
         if (arg_show_progress &&
             pipe(progress_pipe) < 0)
                 return log_error_errno(errno, "pipe(): %m");
@@ -387,8 +495,12 @@ static int run(int argc, char *argv[]) {
                  * Since util-linux v2.25 fsck uses /run/fsck/<diskname>.lock files.
                  * The previous versions use flock for the device and conflict with
                  * udevd, see https://bugs.freedesktop.org/show_bug.cgi?id=79576#c5
+                 *
+                 * We normally hold these locks ourselves already, and fsck would
+                 * wait for us forever if it tried to take them too.
                  */
-                cmdline[i++] = "-l";
+                if (fsck_lock)
+                        cmdline[i++] = "-l";
 
                 if (!root_directory)
                         cmdline[i++] = "-M";
@@ -414,6 +526,10 @@ static int run(int argc, char *argv[]) {
         exit_status = wait_for_terminate_and_check("fsck", pid, WAIT_LOG_ABNORMAL);
         if (exit_status < 0)
                 return exit_status;
+
+        /* Let the checks of other file systems on the same disks proceed */
+        close_many(lock_fds, n_lock_fds);
+        n_lock_fds = 0;
         if ((exit_status & ~FSCK_ERROR_CORRECTED) != FSCK_SUCCESS) {
                 log_error("fsck failed with exit status %i.", exit_status);
 
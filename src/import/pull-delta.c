@@ -0,0 +1,562 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/stat.h>
+
+#include "alloc-util.h"
+#include "copy.h"
+#include "extract-word.h"
+#include "fd-util.h"
+#include "gcrypt-util.h"
+#include "hashmap.h"
+#include "hexdecoct.h"
+#include "import-compress.h"
+#include "io-util.h"
+#include "parse-util.h"
+#include "pull-delta.h"
+#include "siphash24.h"
+#include "string-util.h"
+#include "strv.h"
+
+#define DELTA_BLOCK_SIZE_MIN (4U * 1024U)
+#define DELTA_BLOCK_SIZE_MAX (64U * 1024U * 1024U)
+
+/* The index is a few MB at most even for large images, don't accept more */
+#define DELTA_INDEX_SIZE_MAX (64U * 1024U * 1024U)
+
+static void block_digest_hash_func(const uint8_t *p, struct siphash *state) {
+        siphash24_compress(p, PULL_DELTA_DIGEST_SIZE, state);
+}
+
+static int block_digest_compare_func(const uint8_t *a, const uint8_t *b) {
+        return memcmp(a, b, PULL_DELTA_DIGEST_SIZE);
+}
+
+DEFINE_PRIVATE_HASH_OPS(block_digest_hash_ops, uint8_t, block_digest_hash_func, block_digest_compare_func);
+
+PullDelta* pull_delta_unref(PullDelta *d) {
+        size_t k;
+
+        if (!d)
+                return NULL;
+
+        pull_job_unref(d->probe_job);
+        for (k = 0; k < PULL_DELTA_JOBS_MAX; k++)
+                pull_job_unref(d->jobs[k]);
+
+        sd_event_source_unref(d->defer);
+        safe_close(d->old_fd);
+
+        free(d->url);
+        free(d->blocks);
+        free(d->ranges);
+        free(d->etag);
+        free(d->checksum);
+
+        return mfree(d);
+}
+
+static int pull_delta_parse_index(PullDelta *d, const void *data, size_t size) {
+        _cleanup_free_ char *text = NULL, *a = NULL, *b = NULL;
+        _cleanup_strv_free_ char **l = NULL;
+        const char *p;
+        size_t k;
+        int r;
+
+        assert(d);
+        assert(data || size == 0);
+
+        if (size > DELTA_INDEX_SIZE_MAX || memchr(data, 0, size))
+                return -EBADMSG;
+
+        text = memdup_suffix0(data, size);
+        if (!text)
+                return -ENOMEM;
+
+        l = strv_split_newlines(text);
+        if (!l)
+                return -ENOMEM;
+        if (strv_isempty(l))
+                return -EBADMSG;
+
+        p = l[0];
+        r = extract_many_words(&p, NULL, 0, &a, &b, NULL);
+        if (r < 0)
+                return r;
+        if (r != 2 || !isempty(p))
+                return -EBADMSG;
+
+        r = safe_atou64(a, &d->block_size);
+        if (r < 0)
+                return r;
+        if (d->block_size < DELTA_BLOCK_SIZE_MIN || d->block_size > DELTA_BLOCK_SIZE_MAX)
+                return -EBADMSG;
+
+        r = safe_atou64(b, &d->size);
+        if (r < 0)
+                return r;
+
+        if (strv_length(l) - 1 != DIV_ROUND_UP(d->size, d->block_size))
+                return -EBADMSG;
+
+        d->n_blocks = strv_length(l) - 1;
+        d->blocks = malloc_multiply(sizeof(*d->blocks), d->n_blocks);
+        if (!d->blocks)
+                return -ENOMEM;
+
+        for (k = 0; k < d->n_blocks; k++) {
+                _cleanup_free_ void *m = NULL;
+                size_t n;
+
+                r = unhexmem(l[k + 1], strlen(l[k + 1]), &m, &n);
+                if (r < 0)
+                        return r;
+                if (n != PULL_DELTA_DIGEST_SIZE)
+                        return -EBADMSG;
+
+                memcpy(d->blocks[k], m, PULL_DELTA_DIGEST_SIZE);
+        }
+
+        return 0;
+}
+
+static int pull_delta_on_defer(sd_event_source *s, void *userdata);
+
+int pull_delta_new(
+                PullDelta **ret,
+                CurlGlue *glue,
+                const char *url,
+                const void *index,
+                size_t index_size,
+                PullDeltaFinished on_finished,
+                void *userdata) {
+
+        _cleanup_(pull_delta_unrefp) PullDelta *d = NULL;
+        int r;
+
+        assert(ret);
+        assert(glue);
+        assert(url);
+
+        d = new(PullDelta, 1);
+        if (!d)
+                return -ENOMEM;
+
+        *d = (PullDelta) {
+                .glue = glue,
+                .on_finished = on_finished,
+                .userdata = userdata,
+                .old_fd = -1,
+                .target_fd = -1,
+        };
+
+        d->url = strdup(url);
+        if (!d->url)
+                return -ENOMEM;
+
+        r = pull_delta_parse_index(d, index, index_size);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to parse block index of %s: %m", url);
+
+        /* Completed jobs are processed from a defer event source, so that they are never freed from within
+         * curl's callbacks */
+        r = sd_event_add_defer(glue->event, &d->defer, pull_delta_on_defer, d);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_enabled(d->defer, SD_EVENT_OFF);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(d);
+
+        return 0;
+}
+
+static void pull_delta_job_on_finished(PullJob *j) {
+        PullDelta *d;
+
+        assert(j);
+        assert(j->userdata);
+
+        d = j->userdata;
+
+        (void) sd_event_source_set_enabled(d->defer, SD_EVENT_ONESHOT);
+}
+
+static int pull_delta_add_range(PullDelta *d, uint64_t offset, uint64_t size) {
+        struct PullDeltaRange *last;
+
+        assert(d);
+
+        /* Fetching a block we already have is cheaper than an additional request, hence merge ranges that are at
+         * most one block apart */
+        last = d->n_ranges > 0 ? d->ranges + d->n_ranges - 1 : NULL;
+        if (last && last->offset + last->size + d->block_size >= offset) {
+                last->size = offset + size - last->offset;
+                return 0;
+        }
+
+        if (!GREEDY_REALLOC(d->ranges, d->n_ranges_allocated, d->n_ranges + 1))
+                return -ENOMEM;
+
+        d->ranges[d->n_ranges++] = (struct PullDeltaRange) {
+                .offset = offset,
+                .size = size,
+        };
+
+        return 0;
+}
+
+static int pull_delta_plan(PullDelta *d) {
+        _cleanup_free_ uint8_t (*old)[PULL_DELTA_DIGEST_SIZE] = NULL;
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        char a[FORMAT_BYTES_MAX], b[FORMAT_BYTES_MAX];
+        _cleanup_free_ uint8_t *buf = NULL;
+        uint64_t missing = 0;
+        size_t k, n_old;
+        struct stat st;
+        int r;
+
+        assert(d);
+        assert(d->old_fd >= 0);
+        assert(d->target_fd >= 0);
+
+        if (fstat(d->old_fd, &st) < 0)
+                return log_debug_errno(errno, "Failed to stat previous image: %m");
+
+        buf = malloc(d->block_size);
+        if (!buf)
+                return -ENOMEM;
+
+        /* Hash the previous image the same way the index was made, and remember where each block is */
+        n_old = DIV_ROUND_UP((uint64_t) st.st_size, d->block_size);
+        old = malloc_multiply(sizeof(*old), n_old);
+        if (!old)
+                return -ENOMEM;
+
+        h = hashmap_new(&block_digest_hash_ops);
+        if (!h)
+                return -ENOMEM;
+
+        initialize_libgcrypt(false);
+
+        if (lseek(d->old_fd, 0, SEEK_SET) == (off_t) -1)
+                return log_debug_errno(errno, "Failed to seek in previous image: %m");
+
+        for (k = 0; k < n_old; k++) {
+                ssize_t n;
+
+                n = loop_read(d->old_fd, buf, d->block_size, true);
+                if (n < 0)
+                        return log_debug_errno(n, "Failed to read previous image: %m");
+                if (n == 0) {
+                        n_old = k;
+                        break;
+                }
+
+                gcry_md_hash_buffer(GCRY_MD_SHA256, old[k], buf, n);
+
+                r = hashmap_put(h, old[k], SIZE_TO_PTR(k + 1));
+                if (r < 0 && r != -EEXIST)
+                        return r;
+        }
+
+        /* Start out with a copy of the previous image, which is cheap if the file system can share extents. Blocks
+         * that did not move are already in place then. */
+        if (lseek(d->old_fd, 0, SEEK_SET) == (off_t) -1 ||
+            lseek(d->target_fd, 0, SEEK_SET) == (off_t) -1)
+                return log_debug_errno(errno, "Failed to seek: %m");
+
+        r = copy_bytes(d->old_fd, d->target_fd, (uint64_t) -1, COPY_REFLINK);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to copy previous image: %m");
+
+        if (ftruncate(d->target_fd, d->size) < 0)
+                return log_debug_errno(errno, "Failed to truncate image: %m");
+
+        for (k = 0; k < d->n_blocks; k++) {
+                uint64_t offset, size;
+                void *p;
+
+                offset = k * d->block_size;
+                size = MIN(d->block_size, d->size - offset);
+
+                if (k < n_old && memcmp(old[k], d->blocks[k], PULL_DELTA_DIGEST_SIZE) == 0) {
+                        d->n_bytes_reused += size;
+                        continue;
+                }
+
+                p = hashmap_get(h, d->blocks[k]);
+                if (p) {
+                        ssize_t n;
+
+                        n = pread(d->old_fd, buf, size, (PTR_TO_SIZE(p) - 1) * d->block_size);
+                        if (n < 0)
+                                return log_debug_errno(errno, "Failed to read previous image: %m");
+                        if ((uint64_t) n != size)
+                                return log_debug_errno(SYNTHETIC_ERRNO(EIO), "Short read from previous image.");
+
+                        n = pwrite(d->target_fd, buf, size, offset);
+                        if (n < 0)
+                                return log_debug_errno(errno, "Failed to write image: %m");
+                        if ((uint64_t) n != size)
+                                return log_debug_errno(SYNTHETIC_ERRNO(EIO), "Short write to image.");
+
+                        d->n_bytes_reused += size;
+                        continue;
+                }
+
+                r = pull_delta_add_range(d, offset, size);
+                if (r < 0)
+                        return r;
+        }
+
+        for (k = 0; k < d->n_ranges; k++)
+                missing += d->ranges[k].size;
+
+        if (missing > d->size / 2)
+                return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
+                                       "More than half of %s changed, not worth fetching it in pieces.", d->url);
+
+        log_info("Reusing %s of %s from the previous image, fetching %s in %zu requests.",
+                 format_bytes(a, sizeof(a), d->n_bytes_reused), d->url,
+                 format_bytes(b, sizeof(b), missing), d->n_ranges);
+
+        return 0;
+}
+
+static int pull_delta_verify(PullDelta *d) {
+        _cleanup_(gcry_md_closep) gcry_md_hd_t md = NULL;
+        _cleanup_free_ uint8_t *buf = NULL;
+        size_t k;
+
+        assert(d);
+
+        /* Check the result against the index as a whole, this catches ranges a server answered with the wrong
+         * data, as well as changes to the previous image while we were reading it */
+
+        buf = malloc(d->block_size);
+        if (!buf)
+                return -ENOMEM;
+
+        if (gcry_md_open(&md, GCRY_MD_SHA256, 0) != 0)
+                return log_debug_errno(SYNTHETIC_ERRNO(EIO), "Failed to initialize hash context.");
+
+        if (lseek(d->target_fd, 0, SEEK_SET) == (off_t) -1)
+                return log_debug_errno(errno, "Failed to seek in image: %m");
+
+        for (k = 0; k < d->n_blocks; k++) {
+                uint8_t digest[PULL_DELTA_DIGEST_SIZE];
+                uint64_t size;
+                ssize_t n;
+
+                size = MIN(d->block_size, d->size - k * d->block_size);
+
+                n = loop_read(d->target_fd, buf, size, true);
+                if (n < 0)
+                        return log_debug_errno(n, "Failed to read image: %m");
+                if ((uint64_t) n != size)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EIO), "Short read from image.");
+
+                if (k == 0) {
+                        _cleanup_(import_compress_free) ImportCompress c = {};
+
+                        /* We only store images uncompressed, hence a compressed one can never be updated from
+                         * a previous one */
+                        if (import_uncompress_detect(&c, buf, n) > 0 && c.type != IMPORT_COMPRESS_UNCOMPRESSED)
+                                return log_debug_errno(SYNTHETIC_ERRNO(EPROTONOSUPPORT),
+                                                       "%s is compressed, cannot update it in pieces.", d->url);
+                }
+
+                gcry_md_hash_buffer(GCRY_MD_SHA256, digest, buf, n);
+                if (memcmp(digest, d->blocks[k], PULL_DELTA_DIGEST_SIZE) != 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Block %zu of %s does not match the index.", k, d->url);
+
+                gcry_md_write(md, buf, n);
+        }
+
+        d->checksum = hexmem(gcry_md_read(md, GCRY_MD_SHA256), PULL_DELTA_DIGEST_SIZE);
+        if (!d->checksum)
+                return -ENOMEM;
+
+        if (lseek(d->target_fd, 0, SEEK_SET) == (off_t) -1)
+                return log_debug_errno(errno, "Failed to seek in image: %m");
+
+        return 0;
+}
+
+static int pull_delta_start_range(PullDelta *d, PullJob **ret, const struct PullDeltaRange *range) {
+        _cleanup_(pull_job_unrefp) PullJob *j = NULL;
+        _cleanup_free_ char *h = NULL;
+        int r;
+
+        assert(d);
+        assert(ret);
+        assert(range);
+
+        r = pull_job_new(&j, d->url, d->glue, d);
+        if (r < 0)
+                return r;
+
+        j->on_finished = pull_delta_job_on_finished;
+        j->range_offset = range->offset;
+        j->range_size = range->size;
+        j->compressed_max = range->size;
+
+        /* Each job writes through its own file description, so that their file offsets are independent */
+        j->disk_fd = fd_reopen(d->target_fd, O_WRONLY|O_CLOEXEC);
+        if (j->disk_fd < 0)
+                return j->disk_fd;
+
+        /* Make sure we get a part of the very version of the image the index describes, and not one of an
+         * image that changed in the meantime */
+        h = strjoin("If-Range: ", d->etag);
+        if (!h)
+                return -ENOMEM;
+
+        j->request_header = curl_slist_new(h, NULL);
+        if (!j->request_header)
+                return -ENOMEM;
+
+        r = pull_job_begin(j);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(j);
+
+        return 0;
+}
+
+static int pull_delta_process(PullDelta *d) {
+        bool running = false;
+        size_t k;
+        int r;
+
+        assert(d);
+
+        if (!d->planned) {
+                PullJob *j = d->probe_job;
+
+                if (!PULL_JOB_IS_COMPLETE(j))
+                        return 0;
+
+                if (j->etag_exists) {
+                        /* We have this version already */
+                        if (j->etag) {
+                                d->etag = strdup(j->etag);
+                                if (!d->etag)
+                                        return -ENOMEM;
+                        }
+
+                        d->etag_exists = true;
+                        return 1;
+                }
+
+                if (j->error != 0)
+                        return j->error;
+
+                if (!j->etag)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EPROTO),
+                                               "Server did not send an ETag for %s, cannot fetch it in pieces.", d->url);
+
+                d->etag = strdup(j->etag);
+                if (!d->etag)
+                        return -ENOMEM;
+
+                d->mtime = j->mtime;
+                d->probe_job = pull_job_unref(d->probe_job);
+
+                r = pull_delta_plan(d);
+                if (r < 0)
+                        return r;
+
+                d->planned = true;
+        }
+
+        for (k = 0; k < PULL_DELTA_JOBS_MAX; k++) {
+                PullJob *j = d->jobs[k];
+
+                if (j && PULL_JOB_IS_COMPLETE(j)) {
+                        if (j->error != 0)
+                                return j->error;
+
+                        d->n_bytes_downloaded += j->written_compressed;
+                        d->jobs[k] = pull_job_unref(j);
+                }
+
+                if (!d->jobs[k] && d->next_range < d->n_ranges) {
+                        r = pull_delta_start_range(d, d->jobs + k, d->ranges + d->next_range);
+                        if (r < 0)
+                                return r;
+
+                        d->next_range++;
+                }
+
+                if (d->jobs[k])
+                        running = true;
+        }
+
+        if (running)
+                return 0;
+
+        r = pull_delta_verify(d);
+        if (r < 0)
+                return r;
+
+        return 1;
+}
+
+static int pull_delta_on_defer(sd_event_source *s, void *userdata) {
+        PullDelta *d = userdata;
+        int r;
+
+        assert(d);
+
+        if (d->done)
+                return 0;
+
+        r = pull_delta_process(d);
+        if (r == 0)
+                return 0;
+
+        d->done = true;
+
+        if (d->on_finished)
+                d->on_finished(d, r < 0 ? r : 0, d->userdata);
+
+        return 0;
+}
+
+int pull_delta_start(PullDelta *d, int old_fd, int target_fd, char **old_etags) {
+        _cleanup_close_ int fd = old_fd;
+        int r;
+
+        assert(d);
+        assert(old_fd >= 0);
+        assert(target_fd >= 0);
+
+        if (d->probe_job || d->planned)
+                return -EBUSY;
+
+        /* Ask for the first byte only, to learn the ETag of the current version, or that we have it already */
+        r = pull_job_new(&d->probe_job, d->url, d->glue, d);
+        if (r < 0)
+                return r;
+
+        d->probe_job->on_finished = pull_delta_job_on_finished;
+        d->probe_job->range_size = 1;
+
+        d->probe_job->old_etags = strv_copy(old_etags);
+        if (!d->probe_job->old_etags && old_etags)
+                return -ENOMEM;
+
+        r = pull_job_begin(d->probe_job);
+        if (r < 0)
+                return r;
+
+        d->old_fd = TAKE_FD(fd);
+        d->target_fd = target_fd;
+
+        return 0;
+}
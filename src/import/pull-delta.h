@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include "curl-util.h"
+#include "macro.h"
+#include "pull-job.h"
+
+/* Updates a raw image from a previously downloaded version of it, by fetching only the blocks that changed.
+ *
+ * The server publishes a block index next to the image, a text file whose first line carries the block size and
+ * the size of the image, followed by one line with the hex SHA256 of each block of the image, in order:
+ *
+ *     4194304 1073741824
+ *     5891b5b522d5df086d0ff0b110fbd9d21bb4fc7163af34d08286a2e846f6be03
+ *     …
+ *
+ * Blocks found anywhere in the old image are copied from there, the rest is fetched with HTTP range requests. */
+
+/* SHA256 */
+#define PULL_DELTA_DIGEST_SIZE 32U
+
+/* Number of range requests in flight at the same time */
+#define PULL_DELTA_JOBS_MAX 4U
+
+typedef struct PullDelta PullDelta;
+
+typedef void (*PullDeltaFinished)(PullDelta *d, int error, void *userdata);
+
+struct PullDelta {
+        CurlGlue *glue;
+        char *url;
+
+        PullDeltaFinished on_finished;
+        void *userdata;
+
+        uint64_t block_size;
+        uint64_t size;
+        uint8_t (*blocks)[PULL_DELTA_DIGEST_SIZE];
+        size_t n_blocks;
+
+        int old_fd;
+        int target_fd;
+
+        PullJob *probe_job;
+        PullJob *jobs[PULL_DELTA_JOBS_MAX];
+
+        struct PullDeltaRange {
+                uint64_t offset;
+                uint64_t size;
+        } *ranges;
+        size_t n_ranges, n_ranges_allocated;
+        size_t next_range;
+
+        sd_event_source *defer;
+        bool planned;
+        bool done;
+
+        uint64_t n_bytes_reused;
+        uint64_t n_bytes_downloaded;
+
+        /* Results, once finished successfully */
+        char *etag;
+        bool etag_exists;
+        usec_t mtime;
+        char *checksum;
+};
+
+int pull_delta_new(PullDelta **ret, CurlGlue *glue, const char *url, const void *index, size_t index_size, PullDeltaFinished on_finished, void *userdata);
+PullDelta* pull_delta_unref(PullDelta *d);
+
+int pull_delta_start(PullDelta *d, int old_fd, int target_fd, char **old_etags);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PullDelta*, pull_delta_unref);
@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <pthread.h>
 #include <sys/xattr.h>
 
 #include "alloc-util.h"
@@ -12,10 +13,189 @@
 #include "parse-util.h"
 #include "pull-common.h"
 #include "pull-job.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "xattr-util.h"
 
+/* The downloaded data is hashed in a separate thread, so that hashing it and decompressing and writing it out can
+ * run in parallel. The data is collected in one buffer while the other one is hashed. */
+#define HASHER_BUFFER_SIZE (1024U*1024U)
+
+struct PullJobHasher {
+        gcry_md_hd_t context;
+
+        pthread_t thread;
+        bool thread_started;
+
+        /* Only touched by the main thread */
+        uint8_t *buffers[2];
+        unsigned filling;
+        size_t filled;
+
+        /* Protected by the mutex */
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        const uint8_t *pending;
+        size_t pending_size;
+        bool shutdown;
+};
+
+static void *hasher_thread(void *userdata) {
+        PullJobHasher *h = userdata;
+
+        assert_se(pthread_mutex_lock(&h->mutex) == 0);
+
+        for (;;) {
+                const uint8_t *p;
+                size_t sz;
+
+                while (!h->pending && !h->shutdown)
+                        assert_se(pthread_cond_wait(&h->cond, &h->mutex) == 0);
+
+                if (!h->pending)
+                        break;
+
+                p = h->pending;
+                sz = h->pending_size;
+
+                assert_se(pthread_mutex_unlock(&h->mutex) == 0);
+                gcry_md_write(h->context, p, sz);
+                assert_se(pthread_mutex_lock(&h->mutex) == 0);
+
+                h->pending = NULL;
+                assert_se(pthread_cond_broadcast(&h->cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&h->mutex) == 0);
+        return NULL;
+}
+
+static void hasher_wait(PullJobHasher *h) {
+        assert(h);
+
+        if (!h->thread_started)
+                return;
+
+        assert_se(pthread_mutex_lock(&h->mutex) == 0);
+        while (h->pending)
+                assert_se(pthread_cond_wait(&h->cond, &h->mutex) == 0);
+        assert_se(pthread_mutex_unlock(&h->mutex) == 0);
+}
+
+static void hasher_submit(PullJobHasher *h) {
+        assert(h);
+
+        if (h->filled == 0)
+                return;
+
+        if (!h->thread_started) {
+                gcry_md_write(h->context, h->buffers[h->filling], h->filled);
+                h->filled = 0;
+                return;
+        }
+
+        /* Once the previous buffer is done, we may hand over this one and start filling the other one */
+        hasher_wait(h);
+
+        assert_se(pthread_mutex_lock(&h->mutex) == 0);
+        h->pending = h->buffers[h->filling];
+        h->pending_size = h->filled;
+        assert_se(pthread_cond_broadcast(&h->cond) == 0);
+        assert_se(pthread_mutex_unlock(&h->mutex) == 0);
+
+        h->filling ^= 1;
+        h->filled = 0;
+}
+
+static void hasher_write(PullJobHasher *h, const uint8_t *p, size_t sz) {
+        assert(h);
+        assert(p || sz == 0);
+
+        while (sz > 0) {
+                size_t n;
+
+                n = MIN(sz, HASHER_BUFFER_SIZE - h->filled);
+                memcpy(h->buffers[h->filling] + h->filled, p, n);
+                h->filled += n;
+                p += n;
+                sz -= n;
+
+                if (h->filled >= HASHER_BUFFER_SIZE)
+                        hasher_submit(h);
+        }
+}
+
+static const uint8_t *hasher_read(PullJobHasher *h) {
+        assert(h);
+
+        hasher_submit(h);
+        hasher_wait(h);
+
+        return gcry_md_read(h->context, GCRY_MD_SHA256);
+}
+
+static PullJobHasher *hasher_free(PullJobHasher *h) {
+        if (!h)
+                return NULL;
+
+        if (h->thread_started) {
+                assert_se(pthread_mutex_lock(&h->mutex) == 0);
+                h->shutdown = true;
+                assert_se(pthread_cond_broadcast(&h->cond) == 0);
+                assert_se(pthread_mutex_unlock(&h->mutex) == 0);
+
+                (void) pthread_join(h->thread, NULL);
+        }
+
+        (void) pthread_mutex_destroy(&h->mutex);
+        (void) pthread_cond_destroy(&h->cond);
+
+        if (h->context)
+                gcry_md_close(h->context);
+
+        free(h->buffers[0]);
+        free(h->buffers[1]);
+
+        return mfree(h);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PullJobHasher*, hasher_free);
+
+static int hasher_new(PullJobHasher **ret) {
+        _cleanup_(hasher_freep) PullJobHasher *h = NULL;
+        int r;
+
+        assert(ret);
+
+        h = new(PullJobHasher, 1);
+        if (!h)
+                return -ENOMEM;
+
+        *h = (PullJobHasher) {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+        };
+
+        h->buffers[0] = malloc(HASHER_BUFFER_SIZE);
+        h->buffers[1] = malloc(HASHER_BUFFER_SIZE);
+        if (!h->buffers[0] || !h->buffers[1])
+                return -ENOMEM;
+
+        if (gcry_md_open(&h->context, GCRY_MD_SHA256, 0) != 0)
+                return -EIO;
+
+        /* If we can't get a thread, just hash everything inline */
+        r = pthread_create(&h->thread, NULL, hasher_thread, h);
+        if (r != 0)
+                log_debug_errno(r, "Failed to start hashing thread, hashing inline: %m");
+        else
+                h->thread_started = true;
+
+        *ret = TAKE_PTR(h);
+        return 0;
+}
+
 PullJob* pull_job_unref(PullJob *j) {
         if (!j)
                 return NULL;
@@ -27,8 +207,7 @@ PullJob* pull_job_unref(PullJob *j) {
 
         import_compress_free(&j->compress);
 
-        if (j->checksum_context)
-                gcry_md_close(j->checksum_context);
+        hasher_free(j->hasher);
 
         free(j->url);
         free(j->etag);
@@ -39,7 +218,7 @@ PullJob* pull_job_unref(PullJob *j) {
         return mfree(j);
 }
 
-static void pull_job_finish(PullJob *j, int ret) {
+void pull_job_finish(PullJob *j, int ret) {
         assert(j);
 
         if (IN_SET(j->state, PULL_JOB_DONE, PULL_JOB_FAILED))
@@ -110,6 +289,10 @@ void pull_job_curl_on_finished(CurlGlue *g, CURL *curl, CURLcode result) {
                 j->etag_exists = true;
                 r = 0;
                 goto finish;
+        } else if (j->range_size > 0 && status != 206) {
+                log_debug("HTTP request to %s did not return the requested range, got code %li.", j->url, status);
+                r = -EPROTO;
+                goto finish;
         } else if (status >= 300) {
                 if (status == 404 && j->style == VERIFICATION_PER_FILE) {
 
@@ -153,10 +336,10 @@ void pull_job_curl_on_finished(CurlGlue *g, CURL *curl, CURLcode result) {
                 goto finish;
         }
 
-        if (j->checksum_context) {
-                uint8_t *k;
+        if (j->hasher) {
+                const uint8_t *k;
 
-                k = gcry_md_read(j->checksum_context, GCRY_MD_SHA256);
+                k = hasher_read(j->hasher);
                 if (!k) {
                         log_error("Failed to get checksum.");
                         r = -EIO;
@@ -268,8 +451,8 @@ static int pull_job_write_compressed(PullJob *j, void *p, size_t sz) {
                 return log_error_errno(SYNTHETIC_ERRNO(EFBIG),
                                        "Content length incorrect.");
 
-        if (j->checksum_context)
-                gcry_md_write(j->checksum_context, p, sz);
+        if (j->hasher)
+                hasher_write(j->hasher, p, sz);
 
         r = import_uncompress(&j->compress, p, sz, pull_job_write_uncompressed, j);
         if (r < 0)
@@ -291,7 +474,15 @@ static int pull_job_open_disk(PullJob *j) {
                         return r;
         }
 
-        if (j->disk_fd >= 0) {
+        if (j->disk_fd >= 0 && j->range_size > 0) {
+                /* Write the range to where it belongs, the rest of the file is filled in by someone else */
+
+                if (lseek(j->disk_fd, j->range_offset, SEEK_SET) == (off_t) -1)
+                        return log_error_errno(errno, "Failed to seek on file descriptor: %m");
+
+                j->allow_sparse = false;
+
+        } else if (j->disk_fd >= 0) {
                 /* Check if we can do sparse files */
 
                 if (lseek(j->disk_fd, SEEK_SET, 0) == 0)
@@ -307,9 +498,11 @@ static int pull_job_open_disk(PullJob *j) {
         if (j->calc_checksum) {
                 initialize_libgcrypt(false);
 
-                if (gcry_md_open(&j->checksum_context, GCRY_MD_SHA256, 0) != 0)
-                        return log_error_errno(SYNTHETIC_ERRNO(EIO),
-                                               "Failed to initialize hash context.");
+                r = hasher_new(&j->hasher);
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0)
+                        return log_error_errno(r, "Failed to initialize hash context.");
         }
 
         return 0;
@@ -323,6 +516,10 @@ static int pull_job_detect_compression(PullJob *j) {
 
         assert(j);
 
+        /* Parts of a file are never decompressed, they are only meaningful in the original file */
+        if (j->range_size > 0)
+                j->compress.type = IMPORT_COMPRESS_UNCOMPRESSED;
+
         r = import_uncompress_detect(&j->compress, j->payload, j->payload_size);
         if (r < 0)
                 return log_error_errno(r, "Failed to initialize compressor: %m");
@@ -537,7 +734,7 @@ int pull_job_new(PullJob **ret, const char *url, CurlGlue *glue, void *userdata)
         assert(ret);
 
         u = strdup(url);
-        if (u)
+        if (!u)
                 return -ENOMEM;
 
         j = new(PullJob, 1);
@@ -626,6 +823,15 @@ int pull_job_begin(PullJob *j) {
         if (curl_easy_setopt(j->curl, CURLOPT_NOPROGRESS, 0) != CURLE_OK)
                 return -EIO;
 
+        if (j->range_size > 0) {
+                char range[DECIMAL_STR_MAX(uint64_t) * 2 + 2];
+
+                xsprintf(range, "%" PRIu64 "-%" PRIu64, j->range_offset, j->range_offset + j->range_size - 1);
+
+                if (curl_easy_setopt(j->curl, CURLOPT_RANGE, range) != CURLE_OK)
+                        return -EIO;
+        }
+
         r = curl_glue_add(j->glue, j->curl);
         if (r < 0)
                 return r;
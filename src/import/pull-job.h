@@ -8,6 +8,7 @@
 #include "macro.h"
 
 typedef struct PullJob PullJob;
+typedef struct PullJobHasher PullJobHasher;
 
 typedef void (*PullJobFinished)(PullJob *job);
 typedef int (*PullJobOpenDisk)(PullJob *job);
@@ -59,6 +60,11 @@ struct PullJob {
         uint64_t uncompressed_max;
         uint64_t compressed_max;
 
+        /* If range_size is non-zero, only this part of the file is requested, and written to disk_fd at
+         * range_offset, as is */
+        uint64_t range_offset;
+        uint64_t range_size;
+
         uint8_t *payload;
         size_t payload_size;
         size_t payload_allocated;
@@ -76,7 +82,7 @@ struct PullJob {
         bool allow_sparse;
 
         bool calc_checksum;
-        gcry_md_hd_t checksum_context;
+        PullJobHasher *hasher;
 
         char *checksum;
 
@@ -87,6 +93,7 @@ int pull_job_new(PullJob **job, const char *url, CurlGlue *glue, void *userdata)
 PullJob* pull_job_unref(PullJob *job);
 
 int pull_job_begin(PullJob *j);
+void pull_job_finish(PullJob *j, int ret);
 
 void pull_job_curl_on_finished(CurlGlue *g, CURL *curl, CURLcode result);
 
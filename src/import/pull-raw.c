@@ -20,6 +20,7 @@
 #include "mkdir.h"
 #include "path-util.h"
 #include "pull-common.h"
+#include "pull-delta.h"
 #include "pull-job.h"
 #include "pull-raw.h"
 #include "qcow2-util.h"
@@ -50,6 +51,9 @@ struct RawPull {
         PullJob *settings_job;
         PullJob *checksum_job;
         PullJob *signature_job;
+        PullJob *index_job;
+
+        PullDelta *delta;
 
         RawPullFinished on_finished;
         void *userdata;
@@ -80,6 +84,9 @@ RawPull* raw_pull_unref(RawPull *i) {
         pull_job_unref(i->roothash_job);
         pull_job_unref(i->checksum_job);
         pull_job_unref(i->signature_job);
+        pull_job_unref(i->index_job);
+
+        pull_delta_unref(i->delta);
 
         curl_glue_unref(i->glue);
         sd_event_unref(i->event);
@@ -631,6 +638,184 @@ static int raw_pull_job_on_open_disk_settings(PullJob *j) {
         return raw_pull_job_on_open_disk_generic(i, j, "settings", &i->settings_temp_path);
 }
 
+static int raw_pull_open_previous(RawPull *i) {
+        _cleanup_close_ int newest_fd = -1;
+        usec_t newest = 0;
+        char **e;
+        int r;
+
+        assert(i);
+        assert(i->raw_job);
+
+        /* The most recent of the images we downloaded from the same URL earlier is most likely the one closest to
+         * the current version */
+        STRV_FOREACH(e, i->raw_job->old_etags) {
+                _cleanup_free_ char *p = NULL;
+                _cleanup_close_ int fd = -1;
+                struct stat st;
+
+                r = pull_make_path(i->raw_job->url, *e, i->image_root, ".raw-", ".raw", &p);
+                if (r < 0)
+                        return log_oom();
+
+                fd = open(p, O_RDONLY|O_NOCTTY|O_CLOEXEC);
+                if (fd < 0)
+                        continue;
+
+                if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+                        continue;
+
+                if (newest_fd < 0 || timespec_load(&st.st_mtim) > newest) {
+                        newest = timespec_load(&st.st_mtim);
+                        safe_close(newest_fd);
+                        newest_fd = TAKE_FD(fd);
+                }
+        }
+
+        if (newest_fd < 0)
+                return -ENOENT;
+
+        return TAKE_FD(newest_fd);
+}
+
+static int raw_pull_download_full(RawPull *i) {
+        assert(i);
+        assert(i->raw_job);
+
+        /* Throw away whatever we assembled from the previous image, and download the image as a whole */
+        i->delta = pull_delta_unref(i->delta);
+
+        i->raw_job->disk_fd = safe_close(i->raw_job->disk_fd);
+        if (i->temp_path) {
+                (void) unlink(i->temp_path);
+                i->temp_path = mfree(i->temp_path);
+        }
+
+        return pull_job_begin(i->raw_job);
+}
+
+static void raw_pull_delta_on_finished(PullDelta *d, int error, void *userdata) {
+        RawPull *i = userdata;
+        PullJob *j;
+        int r;
+
+        assert(d);
+        assert(i);
+        assert(i->raw_job);
+
+        j = i->raw_job;
+
+        if (error < 0) {
+                log_info_errno(error, "Failed to update image from previous version, downloading it in full: %m");
+
+                r = raw_pull_download_full(i);
+                if (r < 0)
+                        goto finish;
+
+                return;
+        }
+
+        r = free_and_strdup(&j->etag, d->etag);
+        if (r < 0) {
+                r = log_oom();
+                goto finish;
+        }
+
+        if (d->etag_exists) {
+                j->etag_exists = true;
+
+                j->disk_fd = safe_close(j->disk_fd);
+                (void) unlink(i->temp_path);
+                i->temp_path = mfree(i->temp_path);
+        } else {
+                if (j->calc_checksum) {
+                        r = free_and_strdup(&j->checksum, d->checksum);
+                        if (r < 0) {
+                                r = log_oom();
+                                goto finish;
+                        }
+                }
+
+                j->mtime = d->mtime;
+                j->written_compressed = d->n_bytes_downloaded;
+                j->written_uncompressed = d->size;
+
+                (void) fsetxattr(j->disk_fd, "user.source_etag", j->etag, strlen(j->etag), 0);
+                (void) fsetxattr(j->disk_fd, "user.source_url", j->url, strlen(j->url), 0);
+
+                if (j->mtime != 0) {
+                        struct timespec ut[2];
+
+                        timespec_store(&ut[0], j->mtime);
+                        ut[1] = ut[0];
+                        (void) futimens(j->disk_fd, ut);
+                }
+        }
+
+        i->delta = pull_delta_unref(i->delta);
+
+        /* Continue as if the image was downloaded normally */
+        pull_job_finish(j, 0);
+        return;
+
+finish:
+        if (i->on_finished)
+                i->on_finished(i, r, i->userdata);
+        else
+                sd_event_exit(i->event, r);
+}
+
+static int raw_pull_start_delta(RawPull *i) {
+        _cleanup_close_ int old_fd = -1;
+        int r;
+
+        assert(i);
+        assert(i->index_job);
+
+        if (i->index_job->error != 0)
+                return i->index_job->error;
+
+        old_fd = raw_pull_open_previous(i);
+        if (old_fd < 0)
+                return old_fd;
+
+        r = raw_pull_job_on_open_disk_raw(i->raw_job);
+        if (r < 0)
+                return r;
+
+        r = pull_delta_new(&i->delta, i->glue, i->raw_job->url,
+                           i->index_job->payload, i->index_job->payload_size,
+                           raw_pull_delta_on_finished, i);
+        if (r < 0)
+                return r;
+
+        return pull_delta_start(i->delta, TAKE_FD(old_fd), i->raw_job->disk_fd, i->raw_job->old_etags);
+}
+
+static void raw_pull_index_on_finished(PullJob *j) {
+        RawPull *i;
+        int r;
+
+        assert(j);
+        assert(j->userdata);
+
+        i = j->userdata;
+
+        r = raw_pull_start_delta(i);
+        if (r >= 0)
+                return;
+
+        log_info_errno(r, "Cannot update image from previous version, downloading it in full: %m");
+
+        r = raw_pull_download_full(i);
+        if (r < 0) {
+                if (i->on_finished)
+                        i->on_finished(i, r, i->userdata);
+                else
+                        sd_event_exit(i->event, r);
+        }
+}
+
 static void raw_pull_job_on_progress(PullJob *j) {
         RawPull *i;
 
@@ -713,7 +898,25 @@ int raw_pull_start(
         if (r < 0)
                 return r;
 
-        r = pull_job_begin(i->raw_job);
+        if (!strv_isempty(i->raw_job->old_etags)) {
+                _cleanup_free_ char *u = NULL;
+
+                /* We have an older version of the image, see if the server publishes a block index, so that we
+                 * can fetch only what changed. The image itself is only requested once we know. */
+                u = strjoin(url, ".blocks");
+                if (!u)
+                        return -ENOMEM;
+
+                r = pull_job_new(&i->index_job, u, i->glue, i);
+                if (r < 0)
+                        return r;
+
+                i->index_job->on_finished = raw_pull_index_on_finished;
+                i->index_job->uncompressed_max = i->index_job->compressed_max = 64ULL * 1024ULL * 1024ULL;
+
+                r = pull_job_begin(i->index_job);
+        } else
+                r = pull_job_begin(i->raw_job);
         if (r < 0)
                 return r;
 
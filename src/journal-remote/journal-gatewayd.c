@@ -16,6 +16,7 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "hostname-util.h"
+#include "journal-util.h"
 #include "log.h"
 #include "logs-show.h"
 #include "main-func.h"
@@ -58,6 +59,11 @@ typedef struct RequestMeta {
 
         uint64_t n_fields;
         bool n_fields_set;
+
+        /* In export mode the fields are copied only once, from the data returned by
+         * sd_journal_enumerate_data() straight into µhttpd's buffer. */
+        JournalExportStream export;
+        bool export_in_entry, export_done;
 } RequestMeta;
 
 static const char* const mime_types[_OUTPUT_MODE_MAX] = {
@@ -98,6 +104,7 @@ static void request_meta_free(
 
         safe_fclose(m->tmp);
 
+        journal_export_stream_done(&m->export);
         free(m->cursor);
         free(m);
 }
@@ -136,6 +143,59 @@ static int request_meta_ensure_tmp(RequestMeta *m) {
         return 0;
 }
 
+/* Moves to the next entry to serialize. Returns > 0 if there is one, 0 at the end of the stream,
+ * -EAGAIN if nothing new showed up within the timeout while following, and other negative errors
+ * (already logged) on failure. */
+static int request_meta_next_entry(RequestMeta *m) {
+        int r;
+
+        assert(m);
+
+        for (;;) {
+                if (m->n_entries_set &&
+                    m->n_entries <= 0)
+                        return 0;
+
+                if (m->n_skip < 0)
+                        r = sd_journal_previous_skip(m->journal, (uint64_t) -m->n_skip + 1);
+                else if (m->n_skip > 0)
+                        r = sd_journal_next_skip(m->journal, (uint64_t) m->n_skip + 1);
+                else
+                        r = sd_journal_next(m->journal);
+
+                if (r < 0)
+                        return log_error_errno(r, "Failed to advance journal pointer: %m");
+                if (r > 0)
+                        break;
+
+                if (!m->follow)
+                        return 0;
+
+                r = sd_journal_wait(m->journal, (uint64_t) JOURNAL_WAIT_TIMEOUT);
+                if (r < 0)
+                        return log_error_errno(r, "Couldn't wait for journal event: %m");
+                if (r == SD_JOURNAL_NOP)
+                        return -EAGAIN;
+        }
+
+        if (m->discrete) {
+                assert(m->cursor);
+
+                r = sd_journal_test_cursor(m->journal, m->cursor);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to test cursor: %m");
+                if (r == 0)
+                        return 0;
+        }
+
+        if (m->n_entries_set)
+                m->n_entries -= 1;
+
+        m->n_skip = 0;
+
+        return 1;
+}
+
 static ssize_t request_reader_entries(
                 void *cls,
                 uint64_t pos,
@@ -159,58 +219,17 @@ static ssize_t request_reader_entries(
                 /* End of this entry, so let's serialize the next
                  * one */
 
-                if (m->n_entries_set &&
-                    m->n_entries <= 0)
-                        return MHD_CONTENT_READER_END_OF_STREAM;
-
-                if (m->n_skip < 0)
-                        r = sd_journal_previous_skip(m->journal, (uint64_t) -m->n_skip + 1);
-                else if (m->n_skip > 0)
-                        r = sd_journal_next_skip(m->journal, (uint64_t) m->n_skip + 1);
-                else
-                        r = sd_journal_next(m->journal);
-
-                if (r < 0) {
-                        log_error_errno(r, "Failed to advance journal pointer: %m");
+                r = request_meta_next_entry(m);
+                if (r == -EAGAIN)
+                        break;
+                if (r < 0)
                         return MHD_CONTENT_READER_END_WITH_ERROR;
-                } else if (r == 0) {
-
-                        if (m->follow) {
-                                r = sd_journal_wait(m->journal, (uint64_t) JOURNAL_WAIT_TIMEOUT);
-                                if (r < 0) {
-                                        log_error_errno(r, "Couldn't wait for journal event: %m");
-                                        return MHD_CONTENT_READER_END_WITH_ERROR;
-                                }
-                                if (r == SD_JOURNAL_NOP)
-                                        break;
-
-                                continue;
-                        }
-
+                if (r == 0)
                         return MHD_CONTENT_READER_END_OF_STREAM;
-                }
-
-                if (m->discrete) {
-                        assert(m->cursor);
-
-                        r = sd_journal_test_cursor(m->journal, m->cursor);
-                        if (r < 0) {
-                                log_error_errno(r, "Failed to test cursor: %m");
-                                return MHD_CONTENT_READER_END_WITH_ERROR;
-                        }
-
-                        if (r == 0)
-                                return MHD_CONTENT_READER_END_OF_STREAM;
-                }
 
                 pos -= m->size;
                 m->delta += m->size;
 
-                if (m->n_entries_set)
-                        m->n_entries -= 1;
-
-                m->n_skip = 0;
-
                 r = request_meta_ensure_tmp(m);
                 if (r < 0) {
                         log_error_errno(r, "Failed to create temporary file: %m");
@@ -257,6 +276,53 @@ static ssize_t request_reader_entries(
         return (ssize_t) k;
 }
 
+static ssize_t request_reader_export(
+                void *cls,
+                uint64_t pos,
+                char *buf,
+                size_t max) {
+
+        RequestMeta *m = cls;
+        size_t n = 0, k;
+        int r;
+
+        assert(m);
+        assert(buf);
+        assert(max > 0);
+
+        if (m->export_done)
+                return MHD_CONTENT_READER_END_OF_STREAM;
+
+        while (n < max) {
+                if (!m->export_in_entry) {
+                        r = request_meta_next_entry(m);
+                        if (r == -EAGAIN)
+                                break;
+                        if (r < 0)
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        if (r == 0) {
+                                m->export_done = true;
+                                return n > 0 ? (ssize_t) n : MHD_CONTENT_READER_END_OF_STREAM;
+                        }
+
+                        r = journal_export_stream_begin(&m->export, m->journal);
+                        if (r < 0)
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+
+                        m->export_in_entry = true;
+                }
+
+                r = journal_export_stream_read(&m->export, m->journal, buf + n, max - n, &k);
+                if (r < 0)
+                        return MHD_CONTENT_READER_END_WITH_ERROR;
+
+                n += k;
+                m->export_in_entry = r > 0;
+        }
+
+        return (ssize_t) n;
+}
+
 static int request_parse_accept(
                 RequestMeta *m,
                 struct MHD_Connection *connection) {
@@ -498,7 +564,13 @@ static int request_handler_entries(
         if (r < 0)
                 return mhd_respond(connection, MHD_HTTP_BAD_REQUEST, "Failed to seek in journal.");
 
-        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4*1024, request_reader_entries, m, NULL);
+        if (m->mode == OUTPUT_EXPORT) {
+                /* Stream the raw export format without going through the temporary file */
+                sd_journal_set_data_threshold(m->journal, 0);
+
+                response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 64*1024, request_reader_export, m, NULL);
+        } else
+                response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4*1024, request_reader_entries, m, NULL);
         if (!response)
                 return respond_oom(connection);
 
@@ -13,6 +13,7 @@
 #include "journal-remote-write.h"
 #include "journal-remote.h"
 #include "main-func.h"
+#include "parse-util.h"
 #include "pretty-print.h"
 #include "process-util.h"
 #include "rlimit-util.h"
@@ -44,6 +45,7 @@ static char *arg_key = NULL;
 static char *arg_cert = NULL;
 static char *arg_trust = NULL;
 static bool arg_trust_all = false;
+static unsigned arg_threads = 0;
 
 STATIC_DESTRUCTOR_REGISTER(arg_gnutls_log, strv_freep);
 STATIC_DESTRUCTOR_REGISTER(arg_key, freep);
@@ -146,7 +148,7 @@ static int dispatch_http_event(sd_event_source *event,
                                uint32_t revents,
                                void *userdata);
 
-static int request_meta(void **connection_cls, int fd, char *hostname) {
+static int request_meta(void **connection_cls, int fd, char *hostname, bool references) {
         RemoteSource *source;
         Writer *writer;
         int r;
@@ -166,6 +168,8 @@ static int request_meta(void **connection_cls, int fd, char *hostname) {
                 return log_oom();
         }
 
+        source->importer.references = references;
+
         log_debug("Added RemoteSource as connection metadata %p", source);
 
         *connection_cls = source;
@@ -265,6 +269,7 @@ static int request_handler(
         const char *header;
         int r, code, fd;
         _cleanup_free_ char *hostname = NULL;
+        bool references;
         size_t len;
 
         assert(connection);
@@ -285,10 +290,12 @@ static int request_handler(
         if (!streq(url, "/upload"))
                 return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "Not found.");
 
+        /* The "+references" variant may refer back to fields sent earlier in the same upload */
         header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Content-Type");
-        if (!header || !streq(header, "application/vnd.fdo.journal"))
+        if (!header || !STR_IN_SET(header, "application/vnd.fdo.journal", "application/vnd.fdo.journal+references"))
                 return mhd_respond(connection, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE,
                                    "Content-Type: application/vnd.fdo.journal is required.");
+        references = streq(header, "application/vnd.fdo.journal+references");
 
         header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Content-Length");
         if (!header)
@@ -334,7 +341,7 @@ static int request_handler(
 
         assert(hostname);
 
-        r = request_meta(connection_cls, fd, hostname);
+        r = request_meta(connection_cls, fd, hostname, references);
         if (r == -ENOMEM)
                 return respond_oom(connection);
         else if (r < 0)
@@ -344,6 +351,48 @@ static int request_handler(
         return MHD_YES;
 }
 
+static int setup_microhttpd_events(RemoteServer *s, MHDDaemonWrapper *d) {
+        const union MHD_DaemonInfo *info;
+        int r, epoll_fd;
+
+        assert(s);
+        assert(d);
+
+        info = MHD_get_daemon_info(d->daemon, MHD_DAEMON_INFO_EPOLL_FD_LINUX_ONLY);
+        if (!info) {
+                log_error("µhttp returned NULL daemon info");
+                return -EOPNOTSUPP;
+        }
+
+        epoll_fd = info->listen_fd;
+        if (epoll_fd < 0) {
+                log_error("µhttp epoll fd is invalid");
+                return -EUCLEAN;
+        }
+
+        r = sd_event_add_io(s->events, &d->io_event,
+                            epoll_fd, EPOLLIN,
+                            dispatch_http_event, d);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add event callback: %m");
+
+        r = sd_event_source_set_description(d->io_event, "io_event");
+        if (r < 0)
+                return log_error_errno(r, "Failed to set source name: %m");
+
+        r = sd_event_add_time(s->events, &d->timer_event,
+                              CLOCK_MONOTONIC, (uint64_t) -1, 0,
+                              null_timer_event_handler, d);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add timer_event: %m");
+
+        r = sd_event_source_set_description(d->timer_event, "timer_event");
+        if (r < 0)
+                return log_error_errno(r, "Failed to set source name: %m");
+
+        return 0;
+}
+
 static int setup_microhttpd_server(RemoteServer *s,
                                    int fd,
                                    const char *key,
@@ -358,6 +407,7 @@ static int setup_microhttpd_server(RemoteServer *s,
                 { MHD_OPTION_END},
                 { MHD_OPTION_END},
                 { MHD_OPTION_END},
+                { MHD_OPTION_END},
                 { MHD_OPTION_END}};
         int opts_pos = 4;
         int flags =
@@ -366,9 +416,8 @@ static int setup_microhttpd_server(RemoteServer *s,
                 MHD_USE_EPOLL |
                 MHD_USE_ITC;
 
-        const union MHD_DaemonInfo *info;
-        int r, epoll_fd;
         MHDDaemonWrapper *d;
+        int r;
 
         assert(fd >= 0);
 
@@ -405,7 +454,18 @@ static int setup_microhttpd_server(RemoteServer *s,
                                 {MHD_OPTION_HTTPS_MEM_TRUST, 0, (char*) trust};
         }
 
-        d = new(MHDDaemonWrapper, 1);
+        /* With a thread pool, µhttpd accepts connections on the listening socket from each of the
+         * worker threads, and every connection is then served to completion by the thread that
+         * accepted it. Requests from different hosts are written to different files (with
+         * --split-mode=host), so the workers only contend when they append to the same one. */
+        if (arg_threads > 0) {
+                opts[opts_pos++] = (struct MHD_OptionItem)
+                        {MHD_OPTION_THREAD_POOL_SIZE, arg_threads};
+
+                flags |= MHD_USE_INTERNAL_POLLING_THREAD;
+        }
+
+        d = new0(MHDDaemonWrapper, 1);
         if (!d)
                 return log_oom();
 
@@ -422,49 +482,13 @@ static int setup_microhttpd_server(RemoteServer *s,
                 goto error;
         }
 
-        log_debug("Started MHD %s daemon on fd:%d (wrapper @ %p)",
-                  key ? "HTTPS" : "HTTP", fd, d);
-
-        info = MHD_get_daemon_info(d->daemon, MHD_DAEMON_INFO_EPOLL_FD_LINUX_ONLY);
-        if (!info) {
-                log_error("µhttp returned NULL daemon info");
-                r = -EOPNOTSUPP;
-                goto error;
-        }
-
-        epoll_fd = info->listen_fd;
-        if (epoll_fd < 0) {
-                log_error("µhttp epoll fd is invalid");
-                r = -EUCLEAN;
-                goto error;
-        }
-
-        r = sd_event_add_io(s->events, &d->io_event,
-                            epoll_fd, EPOLLIN,
-                            dispatch_http_event, d);
-        if (r < 0) {
-                log_error_errno(r, "Failed to add event callback: %m");
-                goto error;
-        }
+        log_debug("Started MHD %s daemon on fd:%d (wrapper @ %p, %u threads)",
+                  key ? "HTTPS" : "HTTP", fd, d, arg_threads);
 
-        r = sd_event_source_set_description(d->io_event, "io_event");
-        if (r < 0) {
-                log_error_errno(r, "Failed to set source name: %m");
-                goto error;
-        }
-
-        r = sd_event_add_time(s->events, &d->timer_event,
-                              CLOCK_MONOTONIC, (uint64_t) -1, 0,
-                              null_timer_event_handler, d);
-        if (r < 0) {
-                log_error_errno(r, "Failed to add timer_event: %m");
-                goto error;
-        }
-
-        r = sd_event_source_set_description(d->timer_event, "timer_event");
-        if (r < 0) {
-                log_error_errno(r, "Failed to set source name: %m");
-                goto error;
+        if (arg_threads == 0) {
+                r = setup_microhttpd_events(s, d);
+                if (r < 0)
+                        goto error;
         }
 
         r = hashmap_ensure_allocated(&s->daemons, &uint64_hash_ops);
@@ -483,6 +507,8 @@ static int setup_microhttpd_server(RemoteServer *s,
         return 0;
 
 error:
+        sd_event_source_unref(d->io_event);
+        sd_event_source_unref(d->timer_event);
         MHD_stop_daemon(d->daemon);
         free(d->daemon);
         free(d);
@@ -744,6 +770,7 @@ static int parse_config(void) {
                 { "Remote",  "ServerKeyFile",          config_parse_path,             0, &arg_key        },
                 { "Remote",  "ServerCertificateFile",  config_parse_path,             0, &arg_cert       },
                 { "Remote",  "TrustedCertificateFile", config_parse_path,             0, &arg_trust      },
+                { "Remote",  "Threads",                config_parse_unsigned,         0, &arg_threads    },
                 {}
         };
 
@@ -782,6 +809,7 @@ static int help(void) {
                "     --gnutls-log=CATEGORY...\n"
                "                            Specify a list of gnutls logging categories\n"
                "     --split-mode=none|host How many output files to create\n"
+               "     --threads=N            Serve HTTP connections from N worker threads\n"
                "\nNote: file descriptors from sd_listen_fds() will be consumed, too.\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
@@ -806,6 +834,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_CERT,
                 ARG_TRUST,
                 ARG_GNUTLS_LOG,
+                ARG_THREADS,
         };
 
         static const struct option options[] = {
@@ -824,6 +853,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "cert",         required_argument, NULL, ARG_CERT         },
                 { "trust",        required_argument, NULL, ARG_TRUST        },
                 { "gnutls-log",   required_argument, NULL, ARG_GNUTLS_LOG   },
+                { "threads",      required_argument, NULL, ARG_THREADS      },
                 {}
         };
 
@@ -998,6 +1028,13 @@ static int parse_argv(int argc, char *argv[]) {
 #endif
                 }
 
+                case ARG_THREADS:
+                        r = safe_atou(optarg, &arg_threads);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --threads= parameter: %s", optarg);
+
+                        break;
+
                 case '?':
                         return -EINVAL;
 
@@ -28,6 +28,8 @@ Writer* writer_new(RemoteServer *server) {
         if (!w->mmap)
                 return mfree(w);
 
+        assert_se(pthread_mutex_init(&w->lock, NULL) == 0);
+
         w->n_ref = 1;
         w->server = server;
 
@@ -51,12 +53,51 @@ static Writer* writer_free(Writer *w) {
         if (w->mmap)
                 mmap_cache_unref(w->mmap);
 
+        pthread_mutex_destroy(&w->lock);
+
         return mfree(w);
 }
 
-DEFINE_TRIVIAL_REF_UNREF_FUNC(Writer, writer, writer_free);
+/* The reference counter and the writers hashmap are protected by the server lock, so that a writer
+ * cannot be looked up by one thread while another one drops the last reference to it. */
 
-int writer_write(Writer *w,
+Writer* writer_ref(Writer *w) {
+        if (!w)
+                return NULL;
+
+        if (w->server)
+                assert_se(pthread_mutex_lock(&w->server->writers_lock) == 0);
+
+        assert(w->n_ref > 0);
+        w->n_ref++;
+
+        if (w->server)
+                assert_se(pthread_mutex_unlock(&w->server->writers_lock) == 0);
+
+        return w;
+}
+
+Writer* writer_unref(Writer *w) {
+        RemoteServer *s;
+
+        if (!w)
+                return NULL;
+
+        s = w->server;
+        if (s)
+                assert_se(pthread_mutex_lock(&s->writers_lock) == 0);
+
+        assert(w->n_ref > 0);
+        if (--w->n_ref == 0)
+                writer_free(w);
+
+        if (s)
+                assert_se(pthread_mutex_unlock(&s->writers_lock) == 0);
+
+        return NULL;
+}
+
+static int writer_write_locked(Writer *w,
                  struct iovec_wrapper *iovw,
                  dual_timestamp *ts,
                  bool compress,
@@ -80,7 +121,7 @@ int writer_write(Writer *w,
                                       &w->seqnum, NULL, NULL);
         if (r >= 0) {
                 if (w->server)
-                        w->server->event_count += 1;
+                        __sync_fetch_and_add(&w->server->event_count, 1);
                 return 0;
         } else if (r == -EBADMSG)
                 return r;
@@ -100,6 +141,22 @@ int writer_write(Writer *w,
                 return r;
 
         if (w->server)
-                w->server->event_count += 1;
+                __sync_fetch_and_add(&w->server->event_count, 1);
         return 0;
 }
+
+int writer_write(Writer *w,
+                 struct iovec_wrapper *iovw,
+                 dual_timestamp *ts,
+                 bool compress,
+                 bool seal) {
+        int r;
+
+        assert(w);
+
+        assert_se(pthread_mutex_lock(&w->lock) == 0);
+        r = writer_write_locked(w, iovw, ts, compress, seal);
+        assert_se(pthread_mutex_unlock(&w->lock) == 0);
+
+        return r;
+}
@@ -1,6 +1,8 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include <pthread.h>
+
 #include "journal-file.h"
 #include "journal-importer.h"
 
@@ -16,6 +18,9 @@ typedef struct Writer {
 
         uint64_t seqnum;
 
+        /* Serializes writes to this file when sources are served from several threads */
+        pthread_mutex_t lock;
+
         unsigned n_ref;
 } Writer;
 
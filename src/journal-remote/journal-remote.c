@@ -95,6 +95,38 @@ static int init_writer_hashmap(RemoteServer *s) {
         return 0;
 }
 
+static int get_writer_unlocked(RemoteServer *s, const void *key, const char *host, Writer **ret) {
+        Writer *w;
+        int r;
+
+        w = hashmap_get(s->writers, key);
+        if (w) {
+                w->n_ref++;
+                *ret = w;
+                return 0;
+        }
+
+        w = writer_new(s);
+        if (!w)
+                return log_oom();
+
+        /* Pass ownership to the caller right away, so that on failure the writer is released only
+         * after the lock has been dropped. */
+        *ret = w;
+
+        if (s->split_mode == JOURNAL_WRITE_SPLIT_HOST) {
+                w->hashmap_key = strdup(key);
+                if (!w->hashmap_key)
+                        return log_oom();
+        }
+
+        r = open_output(s, w, host);
+        if (r < 0)
+                return r;
+
+        return hashmap_put(s->writers, w->hashmap_key ?: key, w);
+}
+
 int journal_remote_get_writer(RemoteServer *s, const char *host, Writer **writer) {
         _cleanup_(writer_unrefp) Writer *w = NULL;
         const void *key;
@@ -114,28 +146,11 @@ int journal_remote_get_writer(RemoteServer *s, const char *host, Writer **writer
                 assert_not_reached("what split mode?");
         }
 
-        w = hashmap_get(s->writers, key);
-        if (w)
-                writer_ref(w);
-        else {
-                w = writer_new(s);
-                if (!w)
-                        return log_oom();
-
-                if (s->split_mode == JOURNAL_WRITE_SPLIT_HOST) {
-                        w->hashmap_key = strdup(key);
-                        if (!w->hashmap_key)
-                                return log_oom();
-                }
-
-                r = open_output(s, w, host);
-                if (r < 0)
-                        return r;
-
-                r = hashmap_put(s->writers, w->hashmap_key ?: key, w);
-                if (r < 0)
-                        return r;
-        }
+        assert_se(pthread_mutex_lock(&s->writers_lock) == 0);
+        r = get_writer_unlocked(s, key, host, &w);
+        assert_se(pthread_mutex_unlock(&s->writers_lock) == 0);
+        if (r < 0)
+                return r;
 
         *writer = TAKE_PTR(w);
 
@@ -330,6 +345,8 @@ int journal_remote_server_init(
         if (r < 0)
                 return log_error_errno(r, "Failed to allocate event loop: %m");
 
+        assert_se(pthread_mutex_init(&s->writers_lock, NULL) == 0);
+
         r = init_writer_hashmap(s);
         if (r < 0)
                 return r;
@@ -360,6 +377,7 @@ void journal_remote_server_destroy(RemoteServer *s) {
 
         writer_unref(s->_single_writer);
         hashmap_free(s->writers);
+        pthread_mutex_destroy(&s->writers_lock);
 
         sd_event_source_unref(s->sigterm_event);
         sd_event_source_unref(s->sigint_event);
@@ -1,6 +1,8 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include <pthread.h>
+
 #include "sd-event.h"
 
 #include "hashmap.h"
@@ -30,6 +32,7 @@ struct RemoteServer {
         sd_event_source *sigterm_event, *sigint_event, *listen_event;
 
         Hashmap *writers;
+        pthread_mutex_t writers_lock;          /* protects writers and Writer.n_ref */
         Writer *_single_writer;
         uint64_t event_count;
 
@@ -6,12 +6,68 @@
 #include "sd-daemon.h"
 
 #include "alloc-util.h"
+#include "journal-importer.h"
 #include "journal-upload.h"
 #include "log.h"
+#include "lookup3.h"
 #include "string-util.h"
 #include "utf8.h"
 #include "util.h"
 
+/* Larger fields are rarely repeated verbatim, don't bother keeping them around */
+#define DATA_REFERENCE_SIZE_MAX 512U
+
+void free_data_slots(Uploader *u) {
+        size_t i;
+
+        assert(u);
+
+        if (!u->data_slots)
+                return;
+
+        for (i = 0; i < DATA_REFERENCE_SLOTS; i++)
+                free(u->data_slots[i].iov_base);
+
+        u->data_slots = mfree(u->data_slots);
+}
+
+/* Returns > 0 if the current field was sent earlier in this upload and may be referred to, 0 if it has to be sent,
+ * in which case it is remembered for later entries. */
+static int lookup_data_slot(Uploader *u) {
+        struct iovec *s;
+        void *copy;
+
+        assert(u);
+
+        if (!u->data_slots) {
+                u->data_slots = new0(struct iovec, DATA_REFERENCE_SLOTS);
+                if (!u->data_slots)
+                        return log_oom();
+        }
+
+        u->field_slot = hash64(u->field_data, u->field_length) % DATA_REFERENCE_SLOTS;
+        s = u->data_slots + u->field_slot;
+
+        if (s->iov_base && s->iov_len == u->field_length && memcmp(s->iov_base, u->field_data, u->field_length) == 0)
+                return 1;
+
+        copy = memdup(u->field_data, u->field_length);
+        if (!copy)
+                return log_oom();
+
+        free_and_replace(s->iov_base, copy);
+        s->iov_len = u->field_length;
+
+        return 0;
+}
+
+static entry_state field_state(Uploader *u) {
+        assert(u);
+
+        return utf8_is_printable_newline(u->field_data, u->field_length, false) ?
+                ENTRY_TEXT_FIELD : ENTRY_BINARY_FIELD_START;
+}
+
 /**
  * Write up to size bytes to buf. Return negative on error, and number of
  * bytes written otherwise. The last case is a kind of an error too.
@@ -145,14 +201,35 @@ static ssize_t write_entry(char *buf, size_t size, Uploader *u) {
                         if (memory_startswith(u->field_data, u->field_length, "_BOOT_ID="))
                                 continue;
 
-                        if (!utf8_is_printable_newline(u->field_data, u->field_length, false)) {
-                                u->entry_state = ENTRY_BINARY_FIELD_START;
+                        if (u->deduplicate && u->field_length <= DATA_REFERENCE_SIZE_MAX) {
+                                r = lookup_data_slot(u);
+                                if (r < 0)
+                                        return r;
+
+                                u->entry_state = r > 0 ? ENTRY_FIELD_REFERENCE : ENTRY_FIELD_DEFINITION;
                                 continue;
                         }
 
-                        u->entry_state++;
+                        u->entry_state = field_state(u);
+                        continue;
                 }
-                        _fallthrough_;
+
+                case ENTRY_FIELD_REFERENCE:
+                case ENTRY_FIELD_DEFINITION:
+                        /* "*SLOT" refers to a field the receiver stored earlier, "&SLOT" asks it to store the
+                         * following one */
+                        r = snprintf(buf + pos, size - pos, "%c%u\n",
+                                     u->entry_state == ENTRY_FIELD_REFERENCE ? '*' : '&', u->field_slot);
+                        assert(r >= 0);
+                        if ((size_t) r >= size - pos)
+                                /* not enough space */
+                                return pos;
+
+                        pos += r;
+
+                        u->entry_state = u->entry_state == ENTRY_FIELD_REFERENCE ? ENTRY_NEW_FIELD : field_state(u);
+                        continue;
+
                 case ENTRY_TEXT_FIELD:
                 case ENTRY_BINARY_FIELD: {
                         bool done;
@@ -332,6 +409,10 @@ static int process_journal_input(Uploader *u, int skip) {
 
         /* have data */
         u->entry_state = ENTRY_CURSOR;
+
+        /* Every upload is a separate stream for the receiver, which doesn't know about earlier ones */
+        free_data_slots(u);
+
         return start_upload(u, journal_input_callback, u);
 }
 
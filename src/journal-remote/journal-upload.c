@@ -51,6 +51,7 @@ static const char *arg_machine = NULL;
 static bool arg_merge = false;
 static int arg_follow = -1;
 static const char *arg_save_state = NULL;
+static bool arg_deduplicate = false;
 
 static void close_fd_input(Uploader *u);
 
@@ -180,7 +181,9 @@ int start_upload(Uploader *u,
         if (!u->header) {
                 struct curl_slist *h;
 
-                h = curl_slist_append(NULL, "Content-Type: application/vnd.fdo.journal");
+                h = curl_slist_append(NULL, u->deduplicate ?
+                                      "Content-Type: application/vnd.fdo.journal+references" :
+                                      "Content-Type: application/vnd.fdo.journal");
                 if (!h)
                         return log_oom();
 
@@ -404,7 +407,7 @@ static int setup_signals(Uploader *u) {
         return 0;
 }
 
-static int setup_uploader(Uploader *u, const char *url, const char *state_file) {
+static int setup_uploader(Uploader *u, const char *url, const char *state_file, bool deduplicate) {
         int r;
         const char *host, *proto = "";
 
@@ -412,7 +415,8 @@ static int setup_uploader(Uploader *u, const char *url, const char *state_file)
         assert(url);
 
         *u = (Uploader) {
-                .input = -1
+                .input = -1,
+                .deduplicate = deduplicate,
         };
 
         host = STARTSWITH_SET(url, "http://", "https://");
@@ -464,6 +468,8 @@ static void destroy_uploader(Uploader *u) {
 
         free(u->url);
 
+        free_data_slots(u);
+
         u->input_event = sd_event_source_unref(u->input_event);
 
         close_fd_input(u);
@@ -521,6 +527,7 @@ static int parse_config(void) {
                 { "Upload",  "ServerKeyFile",          config_parse_path,   0, &arg_key    },
                 { "Upload",  "ServerCertificateFile",  config_parse_path,   0, &arg_cert   },
                 { "Upload",  "TrustedCertificateFile", config_parse_path,   0, &arg_trust  },
+                { "Upload",  "Deduplicate",            config_parse_bool,   0, &arg_deduplicate },
                 {}};
 
         return config_parse_many_nulstr(PKGSYSCONFDIR "/journal-upload.conf",
@@ -560,6 +567,8 @@ static int help(void) {
                "     --follow[=BOOL]        Do [not] wait for input\n"
                "     --save-state[=FILE]    Save uploaded cursors (default \n"
                "                            " STATE_FILE ")\n"
+               "     --deduplicate[=BOOL]   Send repeated fields as references to earlier\n"
+               "                            ones (requires a recent receiver)\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
                , link
@@ -581,6 +590,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_AFTER_CURSOR,
                 ARG_FOLLOW,
                 ARG_SAVE_STATE,
+                ARG_DEDUPLICATE,
         };
 
         static const struct option options[] = {
@@ -600,6 +610,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "after-cursor", required_argument, NULL, ARG_AFTER_CURSOR   },
                 { "follow",       optional_argument, NULL, ARG_FOLLOW         },
                 { "save-state",   optional_argument, NULL, ARG_SAVE_STATE     },
+                { "deduplicate",  optional_argument, NULL, ARG_DEDUPLICATE    },
                 {}
         };
 
@@ -718,6 +729,19 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_save_state = optarg ?: STATE_FILE;
                         break;
 
+                case ARG_DEDUPLICATE:
+                        if (optarg) {
+                                r = parse_boolean(optarg);
+                                if (r < 0)
+                                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                               "Failed to parse --deduplicate= parameter.");
+
+                                arg_deduplicate = r;
+                        } else
+                                arg_deduplicate = true;
+
+                        break;
+
                 case '?':
                         return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                "Unknown option %s.",
@@ -786,7 +810,7 @@ static int run(int argc, char **argv) {
 
         sigbus_install();
 
-        r = setup_uploader(&u, arg_url, arg_save_state);
+        r = setup_uploader(&u, arg_url, arg_save_state, arg_deduplicate);
         if (r < 0)
                 return r;
 
@@ -16,6 +16,8 @@ typedef enum {
         ENTRY_BINARY_FIELD_START,   /* Writing the name of a binary field. */
         ENTRY_BINARY_FIELD_SIZE,    /* Writing the size of a binary field. */
         ENTRY_BINARY_FIELD,         /* In the middle of a binary field. */
+        ENTRY_FIELD_REFERENCE,      /* Writing a reference to a field sent earlier. */
+        ENTRY_FIELD_DEFINITION,     /* Writing the slot for the following field. */
         ENTRY_OUTRO,                /* Writing '\n' */
         ENTRY_DONE,                 /* Need to move to a new field. */
 } entry_state;
@@ -44,6 +46,11 @@ typedef struct Uploader {
         const void *field_data;
         size_t field_pos, field_length;
 
+        /* Fields sent earlier in this upload, which later entries may refer to */
+        bool deduplicate;
+        struct iovec *data_slots;
+        unsigned field_slot;
+
         /* general metrics */
         const char *state_file;
 
@@ -69,3 +76,4 @@ int open_journal_for_upload(Uploader *u,
                             bool follow);
 void close_journal_input(Uploader *u);
 int check_journal_input(Uploader *u);
+void free_data_slots(Uploader *u);
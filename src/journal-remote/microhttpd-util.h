@@ -31,6 +31,11 @@
 #  define MHD_USE_POLL_INTERNAL_THREAD MHD_USE_POLL_INTERNALLY
 #endif
 
+/* Renamed in µhttpd 0.9.53 */
+#ifndef MHD_USE_SELECT_INTERNALLY
+#  define MHD_USE_INTERNAL_POLLING_THREAD MHD_USE_SELECT_INTERNALLY
+#endif
+
 /* Both the old and new names are defines, check for the new one. */
 
 /* Compatiblity with libmicrohttpd < 0.9.38 */
@@ -15,6 +15,10 @@
 #include <lz4frame.h>
 #endif
 
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "alloc-util.h"
 #include "compress.h"
 #include "fd-util.h"
@@ -31,11 +35,17 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(LZ4F_compressionContext_t, LZ4F_freeCompressionConte
 DEFINE_TRIVIAL_CLEANUP_FUNC(LZ4F_decompressionContext_t, LZ4F_freeDecompressionContext);
 #endif
 
+#if HAVE_ZSTD
+DEFINE_TRIVIAL_CLEANUP_FUNC(ZSTD_CStream*, ZSTD_freeCStream);
+DEFINE_TRIVIAL_CLEANUP_FUNC(ZSTD_DStream*, ZSTD_freeDStream);
+#endif
+
 #define ALIGN_8(l) ALIGN_TO(l, sizeof(size_t))
 
 static const char* const object_compressed_table[_OBJECT_COMPRESSED_MAX] = {
         [OBJECT_COMPRESSED_XZ] = "XZ",
         [OBJECT_COMPRESSED_LZ4] = "LZ4",
+        [OBJECT_COMPRESSED_ZSTD] = "ZSTD",
 };
 
 DEFINE_STRING_TABLE_LOOKUP(object_compressed, int);
@@ -108,6 +118,34 @@ int compress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+int compress_blob_zstd_full(const void *src, uint64_t src_size,
+                            void *dst, size_t dst_alloc_size, size_t *dst_size,
+                            int level) {
+#if HAVE_ZSTD
+        size_t k;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size > 0);
+        assert(dst_size);
+
+        /* Returns < 0 if we couldn't compress the data or the
+         * compressed result is longer than the original. The
+         * uncompressed size is stored in the frame header, hence
+         * there's no need to prefix it as we do for LZ4. */
+
+        k = ZSTD_compress(dst, dst_alloc_size, src, src_size, level);
+        if (ZSTD_isError(k))
+                return -ENOBUFS;
+
+        *dst_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_blob_xz(const void *src, uint64_t src_size,
                        void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
 
@@ -208,6 +246,92 @@ int decompress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+#if HAVE_ZSTD
+static int zstd_decompress_prefix(const void *src, uint64_t src_size,
+                                  void **dst, size_t *dst_alloc_size,
+                                  size_t size) {
+
+        _cleanup_(ZSTD_freeDStreamp) ZSTD_DStream *ds = NULL;
+        ZSTD_inBuffer input = {
+                .src = src,
+                .size = src_size,
+        };
+        ZSTD_outBuffer output = {};
+        size_t k;
+
+        /* Decompresses the first size bytes of the frame, or less if the frame ends earlier. Returns the number
+         * of bytes actually decompressed. */
+
+        if (!greedy_realloc(dst, dst_alloc_size, MAX(size, 1u), 1))
+                return -ENOMEM;
+
+        ds = ZSTD_createDStream();
+        if (!ds)
+                return -ENOMEM;
+
+        k = ZSTD_initDStream(ds);
+        if (ZSTD_isError(k))
+                return -ENOMEM;
+
+        output = (ZSTD_outBuffer) {
+                .dst = *dst,
+                .size = size,
+        };
+
+        while (output.pos < output.size) {
+                size_t pos = output.pos;
+
+                k = ZSTD_decompressStream(ds, &output, &input);
+                if (ZSTD_isError(k)) {
+                        log_debug("ZSTD decoder failed: %s", ZSTD_getErrorName(k));
+                        return -EBADMSG;
+                }
+                if (k == 0)
+                        break; /* End of frame */
+                if (output.pos == pos && input.pos == input.size)
+                        return -EBADMSG; /* Truncated frame */
+        }
+
+        return (int) MIN(output.pos, (size_t) INT_MAX);
+}
+#endif
+
+int decompress_blob_zstd(const void *src, uint64_t src_size,
+                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+
+#if HAVE_ZSTD
+        unsigned long long size;
+        int r;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size);
+        assert(dst_size);
+        assert(*dst_alloc_size == 0 || *dst);
+
+        size = ZSTD_getFrameContentSize(src, src_size);
+        if (IN_SET(size, ZSTD_CONTENTSIZE_ERROR, ZSTD_CONTENTSIZE_UNKNOWN))
+                return -EBADMSG;
+
+        if (dst_max > 0 && size > dst_max)
+                size = dst_max;
+        if (size > INT_MAX)
+                return -EFBIG;
+
+        r = zstd_decompress_prefix(src, src_size, dst, dst_alloc_size, size);
+        if (r < 0)
+                return r;
+        if ((size_t) r != size)
+                return -EBADMSG;
+
+        *dst_size = size;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_blob(int compression,
                     const void *src, uint64_t src_size,
                     void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
@@ -217,6 +341,9 @@ int decompress_blob(int compression,
         else if (compression == OBJECT_COMPRESSED_LZ4)
                 return decompress_blob_lz4(src, src_size,
                                            dst, dst_alloc_size, dst_size, dst_max);
+        else if (compression == OBJECT_COMPRESSED_ZSTD)
+                return decompress_blob_zstd(src, src_size,
+                                            dst, dst_alloc_size, dst_size, dst_max);
         else
                 return -EBADMSG;
 }
@@ -342,6 +469,46 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+int decompress_startswith_zstd(const void *src, uint64_t src_size,
+                               void **buffer, size_t *buffer_size,
+                               const void *prefix, size_t prefix_len,
+                               uint8_t extra) {
+#if HAVE_ZSTD
+        /* Checks whether the decompressed blob starts with the
+         * mentioned prefix. The byte extra needs to follow the
+         * prefix */
+
+        unsigned long long size;
+        int r;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(buffer);
+        assert(buffer_size);
+        assert(prefix);
+        assert(*buffer_size == 0 || *buffer);
+
+        size = ZSTD_getFrameContentSize(src, src_size);
+        if (IN_SET(size, ZSTD_CONTENTSIZE_ERROR, ZSTD_CONTENTSIZE_UNKNOWN))
+                return -EBADMSG;
+
+        /* Decompressed text too short to match the prefix and extra */
+        if (size < prefix_len + 1)
+                return 0;
+
+        r = zstd_decompress_prefix(src, src_size, buffer, buffer_size, ALIGN_8(prefix_len + 1));
+        if (r < 0)
+                return r;
+        if ((size_t) r < prefix_len + 1)
+                return -EBADMSG;
+
+        return memcmp(*buffer, prefix, prefix_len) == 0 &&
+                ((const uint8_t*) *buffer)[prefix_len] == extra;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_startswith(int compression,
                           const void *src, uint64_t src_size,
                           void **buffer, size_t *buffer_size,
@@ -357,6 +524,11 @@ int decompress_startswith(int compression,
                                                  buffer, buffer_size,
                                                  prefix, prefix_len,
                                                  extra);
+        else if (compression == OBJECT_COMPRESSED_ZSTD)
+                return decompress_startswith_zstd(src, src_size,
+                                                  buffer, buffer_size,
+                                                  prefix, prefix_len,
+                                                  extra);
         else
                 return -EBADMSG;
 }
@@ -530,6 +702,98 @@ int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes) {
 #endif
 }
 
+int compress_stream_zstd(int fdf, int fdt, uint64_t max_bytes) {
+#if HAVE_ZSTD
+        _cleanup_(ZSTD_freeCStreamp) ZSTD_CStream *cs = NULL;
+        _cleanup_free_ void *in_buff = NULL, *out_buff = NULL;
+        size_t in_allocsize, out_allocsize, k;
+        uint64_t total_in = 0, total_out = 0;
+        bool finished = false;
+
+        assert(fdf >= 0);
+        assert(fdt >= 0);
+
+        /* Create the context and buffers */
+        in_allocsize = ZSTD_CStreamInSize();
+        out_allocsize = ZSTD_CStreamOutSize();
+        in_buff = malloc(in_allocsize);
+        out_buff = malloc(out_allocsize);
+        cs = ZSTD_createCStream();
+        if (!cs || !out_buff || !in_buff)
+                return -ENOMEM;
+
+        /* No stream user configures a level, hence use the library's default */
+        k = ZSTD_initCStream(cs, 0);
+        if (ZSTD_isError(k)) {
+                log_debug("Failed to initialize ZSTD encoder: %s", ZSTD_getErrorName(k));
+                return -EINVAL;
+        }
+
+        while (!finished) {
+                size_t m = in_allocsize;
+                ssize_t n;
+
+                if (max_bytes != (uint64_t) -1 && (uint64_t) m > max_bytes)
+                        m = (size_t) max_bytes;
+
+                n = read(fdf, in_buff, m);
+                if (n < 0)
+                        return -errno;
+
+                if (max_bytes != (uint64_t) -1) {
+                        assert(max_bytes >= (uint64_t) n);
+                        max_bytes -= n;
+                }
+
+                finished = n == 0;
+                total_in += n;
+
+                ZSTD_inBuffer input = {
+                        .src = in_buff,
+                        .size = n,
+                };
+
+                /* Compress until the input is consumed, and flush the frame epilogue once we hit EOF */
+                for (;;) {
+                        ZSTD_outBuffer output = {
+                                .dst = out_buff,
+                                .size = out_allocsize,
+                        };
+                        ssize_t w;
+
+                        if (finished)
+                                k = ZSTD_endStream(cs, &output);
+                        else
+                                k = ZSTD_compressStream(cs, &output, &input);
+                        if (ZSTD_isError(k)) {
+                                log_debug("ZSTD encoder failed: %s", ZSTD_getErrorName(k));
+                                return -EBADMSG;
+                        }
+
+                        w = loop_write(fdt, output.dst, output.pos, false);
+                        if (w < 0)
+                                return w;
+
+                        total_out += output.pos;
+
+                        if (finished ? k == 0 : input.pos == input.size)
+                                break;
+                }
+        }
+
+        if (total_in == 0)
+                log_debug("ZSTD compression finished (no input data)");
+        else
+                log_debug("ZSTD compression finished (%"PRIu64" -> %"PRIu64" bytes, %.1f%%)",
+                          total_in, total_out,
+                          (double) total_out / total_in * 100);
+
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_stream_xz(int fdf, int fdt, uint64_t max_bytes) {
 
 #if HAVE_XZ
@@ -666,12 +930,102 @@ int decompress_stream_lz4(int in, int out, uint64_t max_bytes) {
 #endif
 }
 
+int decompress_stream_zstd(int fdf, int fdt, uint64_t max_bytes) {
+#if HAVE_ZSTD
+        _cleanup_(ZSTD_freeDStreamp) ZSTD_DStream *ds = NULL;
+        _cleanup_free_ void *in_buff = NULL, *out_buff = NULL;
+        size_t in_allocsize, out_allocsize, k, last_result = 0;
+        uint64_t total_in = 0, total_out = 0;
+
+        assert(fdf >= 0);
+        assert(fdt >= 0);
+
+        in_allocsize = ZSTD_DStreamInSize();
+        out_allocsize = ZSTD_DStreamOutSize();
+        in_buff = malloc(in_allocsize);
+        out_buff = malloc(out_allocsize);
+        ds = ZSTD_createDStream();
+        if (!ds || !out_buff || !in_buff)
+                return -ENOMEM;
+
+        k = ZSTD_initDStream(ds);
+        if (ZSTD_isError(k)) {
+                log_debug("Failed to initialize ZSTD decoder: %s", ZSTD_getErrorName(k));
+                return -ENOMEM;
+        }
+
+        for (;;) {
+                ssize_t n;
+
+                n = read(fdf, in_buff, in_allocsize);
+                if (n < 0)
+                        return -errno;
+                if (n == 0)
+                        break;
+
+                total_in += n;
+
+                ZSTD_inBuffer input = {
+                        .src = in_buff,
+                        .size = n,
+                };
+
+                while (input.pos < input.size) {
+                        ZSTD_outBuffer output = {
+                                .dst = out_buff,
+                                .size = out_allocsize,
+                        };
+                        ssize_t w;
+
+                        /* A return value of 0 indicates that a frame was fully decoded and flushed. The input
+                         * might contain several frames, hence we just continue. */
+                        last_result = k = ZSTD_decompressStream(ds, &output, &input);
+                        if (ZSTD_isError(k)) {
+                                log_debug("ZSTD decoder failed: %s", ZSTD_getErrorName(k));
+                                return -EBADMSG;
+                        }
+
+                        total_out += output.pos;
+
+                        if (max_bytes != (uint64_t) -1) {
+                                if (max_bytes < output.pos)
+                                        return -EFBIG;
+
+                                max_bytes -= output.pos;
+                        }
+
+                        w = loop_write(fdt, output.dst, output.pos, false);
+                        if (w < 0)
+                                return w;
+                }
+        }
+
+        if (last_result != 0) {
+                /* The last decompression result was not 0, which means that the stream ended before the
+                 * frame was finished. */
+                log_debug("ZSTD decoder failed: no more input data, but the frame is incomplete");
+                return -EBADMSG;
+        }
+
+        log_debug("ZSTD decompression finished (%"PRIu64" -> %"PRIu64" bytes, %.1f%%)",
+                  total_in, total_out,
+                  total_in > 0 ? (double) total_out / total_in * 100 : 0.0);
+
+        return 0;
+#else
+        log_debug("Cannot decompress file. Compiled without ZSTD support.");
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_stream(const char *filename, int fdf, int fdt, uint64_t max_bytes) {
 
         if (endswith(filename, ".lz4"))
                 return decompress_stream_lz4(fdf, fdt, max_bytes);
         else if (endswith(filename, ".xz"))
                 return decompress_stream_xz(fdf, fdt, max_bytes);
+        else if (endswith(filename, ".zst"))
+                return decompress_stream_zstd(fdf, fdt, max_bytes);
         else
                 return -EPROTONOSUPPORT;
 }
@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <linux/fs.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stddef.h>
 #include <sys/mman.h>
 #include <sys/statvfs.h>
@@ -18,12 +19,14 @@
 #include "compress.h"
 #include "fd-util.h"
 #include "fs-util.h"
+#include "ioprio.h"
 #include "journal-authenticate.h"
 #include "journal-def.h"
 #include "journal-file.h"
 #include "lookup3.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "prioq.h"
 #include "random-util.h"
 #include "set.h"
 #include "stat-util.h"
@@ -34,6 +37,9 @@
 #define DEFAULT_DATA_HASH_TABLE_SIZE (2047ULL*sizeof(HashItem))
 #define DEFAULT_FIELD_HASH_TABLE_SIZE (333ULL*sizeof(HashItem))
 
+/* How much of the file we replace needs to be used before we trust its fill level more than our estimate */
+#define HASH_TABLE_SIZING_MIN_USED (1ULL*1024ULL*1024ULL)
+
 #define DEFAULT_COMPRESS_THRESHOLD (512ULL)
 #define MIN_COMPRESS_THRESHOLD (8ULL)
 
@@ -68,7 +74,21 @@
 /* How many entries to keep in the entry array chain cache at max */
 #define CHAIN_CACHE_MAX 20
 
-/* How much to increase the journal file size at once each time we allocate something new. */
+/* How many data objects to remember in the writer's data object cache at max, and how large the payload of a
+ * data object may be to be considered for it. Values repeated on every entry (_HOSTNAME=, _BOOT_ID=, …) are
+ * short, while long payloads are typically unique messages, hence not worth caching. */
+#define DATA_CACHE_MAX 128
+#define DATA_CACHE_PAYLOAD_MAX 512
+
+/* Parameters of the Bloom filter in the summary object written when archiving: about 1% false positives */
+#define SUMMARY_BLOOM_BITS_PER_ITEM 10
+#define SUMMARY_BLOOM_N_HASHES 7
+#define SUMMARY_BLOOM_N_HASHES_MAX 32
+/* Space is reserved for this many boot IDs in the summary, files spanning more boots might not get one */
+#define SUMMARY_RESERVE_BOOT_IDS 16
+
+/* How much to increase the journal file size at once each time we allocate something new, unless configured
+ * otherwise. */
 #define FILE_SIZE_INCREASE (8ULL*1024ULL*1024ULL)              /* 8MB */
 
 /* Reread fstat() of the file for detecting deletions at least this often */
@@ -334,9 +354,58 @@ bool journal_file_is_offlining(JournalFile *f) {
         return true;
 }
 
+static void *journal_file_preallocate_thread(void *arg) {
+        JournalFile *f = arg;
+
+        (void) pthread_setname_np(pthread_self(), "journal-alloc");
+
+        /* Don't get in the way of anything else, including the writes to this very file */
+        (void) ioprio_set(IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+        /* Only reserve the blocks, but leave the file size alone: journal_file_post_change() truncates the file
+         * to the size it knows about, and the size is only ever changed by the thread writing the file. */
+        if (fallocate(f->fd, FALLOC_FL_KEEP_SIZE, f->preallocate_offset, f->preallocate_size) < 0)
+                f->preallocate_error = -errno;
+
+        __sync_synchronize();
+        f->preallocate_done = true;
+
+        return NULL;
+}
+
+static int journal_file_preallocate_join(JournalFile *f, bool wait) {
+        int r;
+
+        assert(f);
+
+        if (!f->preallocate_running)
+                return 0;
+
+        if (!wait && !f->preallocate_done)
+                return -EBUSY;
+
+        r = pthread_join(f->preallocate_thread, NULL);
+        if (r > 0)
+                return -r;
+
+        f->preallocate_running = false;
+
+        if (f->preallocate_error < 0) {
+                log_debug_errno(f->preallocate_error, "Failed to allocate space for %s in the background: %m", f->path);
+
+                /* Don't bother again if the file system can't do it */
+                if (IN_SET(f->preallocate_error, -EOPNOTSUPP, -ENOSYS))
+                        f->preallocate_disabled = true;
+        }
+
+        return 0;
+}
+
 JournalFile* journal_file_close(JournalFile *f) {
         assert(f);
 
+        (void) journal_file_preallocate_join(f, true);
+
 #if HAVE_GCRYPT
         /* Write the final tag */
         if (f->seal && f->writable) {
@@ -380,8 +449,9 @@ JournalFile* journal_file_close(JournalFile *f) {
         mmap_cache_unref(f->mmap);
 
         ordered_hashmap_free_free(f->chain_cache);
+        ordered_hashmap_free_free(f->data_cache);
 
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         free(f->compress_buffer);
 #endif
 
@@ -412,7 +482,8 @@ static int journal_file_init_header(JournalFile *f, JournalFile *template) {
 
         h.incompatible_flags |= htole32(
                 f->compress_xz * HEADER_INCOMPATIBLE_COMPRESSED_XZ |
-                f->compress_lz4 * HEADER_INCOMPATIBLE_COMPRESSED_LZ4);
+                f->compress_lz4 * HEADER_INCOMPATIBLE_COMPRESSED_LZ4 |
+                f->compress_zstd * HEADER_INCOMPATIBLE_COMPRESSED_ZSTD);
 
         h.compatible_flags = htole32(
                 f->seal * HEADER_COMPATIBLE_SEALED);
@@ -482,7 +553,7 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                   f->path, type, flags & ~any);
                 flags = (flags & any) & ~supported;
                 if (flags) {
-                        const char* strv[3];
+                        const char* strv[4];
                         unsigned n = 0;
                         _cleanup_free_ char *t = NULL;
 
@@ -492,6 +563,8 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                 strv[n++] = "xz-compressed";
                         if (!compatible && (flags & HEADER_INCOMPATIBLE_COMPRESSED_LZ4))
                                 strv[n++] = "lz4-compressed";
+                        if (!compatible && (flags & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD))
+                                strv[n++] = "zstd-compressed";
                         strv[n] = NULL;
                         assert(n < ELEMENTSOF(strv));
 
@@ -588,6 +661,7 @@ static int journal_file_verify_header(JournalFile *f) {
 
         f->compress_xz = JOURNAL_HEADER_COMPRESSED_XZ(f->header);
         f->compress_lz4 = JOURNAL_HEADER_COMPRESSED_LZ4(f->header);
+        f->compress_zstd = JOURNAL_HEADER_COMPRESSED_ZSTD(f->header);
 
         f->seal = JOURNAL_HEADER_SEALED(f->header);
 
@@ -617,8 +691,100 @@ static int journal_file_fstat(JournalFile *f) {
         return 0;
 }
 
+static uint64_t journal_file_size_increase(JournalFile *f) {
+        assert(f);
+
+        /* Not set for files opened without metrics */
+        return f->metrics.file_size_increase > 0 ? f->metrics.file_size_increase : FILE_SIZE_INCREASE;
+}
+
+static int journal_file_check_space(JournalFile *f, uint64_t old_size, uint64_t new_size) {
+        struct statvfs svfs;
+        uint64_t available;
+
+        assert(f);
+
+        if (f->metrics.max_size > 0 && new_size > f->metrics.max_size)
+                return -E2BIG;
+
+        if (new_size <= f->metrics.min_size || f->metrics.keep_free <= 0)
+                return 0;
+
+        if (fstatvfs(f->fd, &svfs) < 0)
+                return 0;
+
+        available = LESS_BY((uint64_t) svfs.f_bfree * (uint64_t) svfs.f_bsize, f->metrics.keep_free);
+        if (new_size - old_size > available)
+                return -E2BIG;
+
+        return 0;
+}
+
+static void journal_file_maybe_preallocate(JournalFile *f, uint64_t used, uint64_t old_size) {
+        uint64_t increase, new_size;
+        sigset_t ss, saved_ss;
+        int r;
+
+        assert(f);
+
+        /* Once the space allocated so far is getting scarce, the next chunk is reserved in the background, so
+         * that growing the file later on doesn't block on the file system allocating the blocks. */
+
+        if (f->preallocate_disabled)
+                return;
+
+        if (journal_file_preallocate_join(f, false) < 0)
+                return;
+
+        increase = journal_file_size_increase(f);
+        if (old_size - used > increase / 2)
+                return;
+
+        new_size = old_size + increase;
+        if (f->metrics.max_size > 0)
+                new_size = MIN(new_size, f->metrics.max_size);
+        if (new_size <= old_size)
+                return;
+
+        if (journal_file_check_space(f, old_size, new_size) < 0)
+                return;
+
+        f->preallocate_offset = old_size;
+        f->preallocate_size = new_size - old_size;
+        f->preallocate_error = 0;
+        f->preallocate_done = false;
+
+        assert_se(sigfillset(&ss) >= 0);
+        if (pthread_sigmask(SIG_BLOCK, &ss, &saved_ss) > 0)
+                return;
+
+        r = pthread_create(&f->preallocate_thread, NULL, journal_file_preallocate_thread, f);
+        if (r > 0)
+                log_debug_errno(r, "Failed to start thread to allocate space for %s, ignoring: %m", f->path);
+        else
+                f->preallocate_running = true;
+
+        assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+}
+
+static uint64_t journal_file_summary_size_max(JournalFile *f) {
+        uint64_t n_data;
+
+        assert(f);
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, summary_offset) || f->seal)
+                return 0;
+
+        /* Leave room for one more data object, the one the space is being allocated for */
+        n_data = le64toh(f->header->n_data) + 1;
+
+        return ALIGN64(offsetof(SummaryObject, payload) +
+                       SUMMARY_RESERVE_BOOT_IDS * sizeof(sd_id128_t) +
+                       ALIGN64(DIV_ROUND_UP(n_data * SUMMARY_BLOOM_BITS_PER_ITEM, 8)));
+}
+
 static int journal_file_allocate(JournalFile *f, uint64_t offset, uint64_t size) {
-        uint64_t old_size, new_size;
+        uint64_t old_size, new_size, increase;
         int r;
 
         assert(f);
@@ -639,8 +805,16 @@ static int journal_file_allocate(JournalFile *f, uint64_t offset, uint64_t size)
         if (new_size < le64toh(f->header->header_size))
                 new_size = le64toh(f->header->header_size);
 
+        /* The summary is written when the file is archived, which is usually because it is full. Hence keep
+         * room for it, also in space that was allocated already. */
+        if (f->metrics.max_size > 0 && !f->appending_summary &&
+            new_size + journal_file_summary_size_max(f) > f->metrics.max_size)
+                return -E2BIG;
+
         if (new_size <= old_size) {
 
+                journal_file_maybe_preallocate(f, new_size, old_size);
+
                 /* We already pre-allocated enough space, but before
                  * we write to it, let's check with fstat() if the
                  * file got deleted, in order make sure we don't throw
@@ -655,30 +829,20 @@ static int journal_file_allocate(JournalFile *f, uint64_t offset, uint64_t size)
 
         /* Allocate more space. */
 
-        if (f->metrics.max_size > 0 && new_size > f->metrics.max_size)
-                return -E2BIG;
-
-        if (new_size > f->metrics.min_size && f->metrics.keep_free > 0) {
-                struct statvfs svfs;
-
-                if (fstatvfs(f->fd, &svfs) >= 0) {
-                        uint64_t available;
-
-                        available = LESS_BY((uint64_t) svfs.f_bfree * (uint64_t) svfs.f_bsize, f->metrics.keep_free);
-
-                        if (new_size - old_size > available)
-                                return -E2BIG;
-                }
-        }
+        r = journal_file_check_space(f, old_size, new_size);
+        if (r < 0)
+                return r;
 
         /* Increase by larger blocks at once */
-        new_size = DIV_ROUND_UP(new_size, FILE_SIZE_INCREASE) * FILE_SIZE_INCREASE;
+        increase = journal_file_size_increase(f);
+        new_size = DIV_ROUND_UP(new_size, increase) * increase;
         if (f->metrics.max_size > 0 && new_size > f->metrics.max_size)
                 new_size = f->metrics.max_size;
 
         /* Note that the glibc fallocate() fallback is very
            inefficient, hence we try to minimize the allocation area
-           as we can. */
+           as we can. If the blocks were reserved in the background
+           already, this only has to update the file size. */
         r = posix_fallocate(f->fd, old_size, new_size - old_size);
         if (r != 0)
                 return -r;
@@ -730,6 +894,7 @@ static uint64_t minimum_header_size(Object *o) {
                 [OBJECT_FIELD_HASH_TABLE] = sizeof(HashTableObject),
                 [OBJECT_ENTRY_ARRAY] = sizeof(EntryArrayObject),
                 [OBJECT_TAG] = sizeof(TagObject),
+                [OBJECT_SUMMARY] = sizeof(SummaryObject),
         };
 
         if (o->object.type >= ELEMENTSOF(table) || table[o->object.type] <= 0)
@@ -867,6 +1032,30 @@ static int journal_file_check_object(JournalFile *f, uint64_t offset, Object *o)
                                                le64toh(o->tag.epoch), offset);
 
                 break;
+
+        case OBJECT_SUMMARY: {
+                uint64_t n_boot_ids, bloom_size;
+
+                n_boot_ids = le64toh(o->summary.n_boot_ids);
+                bloom_size = le64toh(o->summary.bloom_size);
+
+                if (n_boot_ids > (le64toh(o->object.size) - offsetof(SummaryObject, payload)) / sizeof(sd_id128_t) ||
+                    le64toh(o->object.size) != offsetof(SummaryObject, payload) + n_boot_ids * sizeof(sd_id128_t) + bloom_size)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object summary size: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->object.size),
+                                               offset);
+
+                if (bloom_size > 0 &&
+                    (le64toh(o->summary.bloom_n_hashes) <= 0 ||
+                     le64toh(o->summary.bloom_n_hashes) > SUMMARY_BLOOM_N_HASHES_MAX))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object summary hash count: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->summary.bloom_n_hashes),
+                                               offset);
+
+                break;
+        }
         }
 
         return 0;
@@ -1019,13 +1208,11 @@ int journal_file_append_object(JournalFile *f, ObjectType type, uint64_t size, O
         return 0;
 }
 
-static int journal_file_setup_data_hash_table(JournalFile *f) {
-        uint64_t s, p;
-        Object *o;
-        int r;
+static uint64_t journal_file_data_hash_table_size(JournalFile *f, JournalFile *template) {
+        uint64_t s, used, n, max_items;
+        Header *h;
 
         assert(f);
-        assert(f->header);
 
         /* We estimate that we need 1 hash table entry per 768 bytes
            of journal file and we want to make sure we never get
@@ -1033,8 +1220,41 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
            the maximum file size based on these metrics. */
 
         s = (f->metrics.max_size * 4 / 768 / 3) * sizeof(HashItem);
-        if (s < DEFAULT_DATA_HASH_TABLE_SIZE)
-                s = DEFAULT_DATA_HASH_TABLE_SIZE;
+
+        /* If we replace a file, we know better than that: extrapolate the number of data objects it had per byte to
+         * the maximum file size. Logs with unique values in every entry need a lot more entries than estimated
+         * above, and logs with only a few distinct values a lot less. */
+        h = template ? template->header : NULL;
+        if (h && f->metrics.max_size > 0 && JOURNAL_HEADER_CONTAINS(h, n_data)) {
+                /* Don't count the hash tables themselves */
+                used = LESS_BY(le64toh(h->tail_object_offset),
+                               le64toh(h->data_hash_table_size) + le64toh(h->field_hash_table_size));
+                n = le64toh(h->n_data);
+
+                if (used >= HASH_TABLE_SIZING_MIN_USED && n > 0) {
+                        /* There can't be more data objects than fit into the file */
+                        max_items = f->metrics.max_size / offsetof(Object, data.payload);
+
+                        n = MIN((uint64_t) ((double) n * f->metrics.max_size / used), max_items);
+                        s = n * 4 / 3 * sizeof(HashItem);
+
+                        log_debug("%s had %"PRIu64" data objects in %"PRIu64" bytes, sizing hash table for %"PRIu64" objects.",
+                                  template->path, le64toh(h->n_data), used, n);
+                }
+        }
+
+        return MAX(s, DEFAULT_DATA_HASH_TABLE_SIZE);
+}
+
+static int journal_file_setup_data_hash_table(JournalFile *f, JournalFile *template) {
+        uint64_t s, p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        s = journal_file_data_hash_table_size(f, template);
 
         log_debug("Reserving %"PRIu64" entries in hash table.", s / sizeof(HashItem));
 
@@ -1053,7 +1273,7 @@ static int journal_file_setup_data_hash_table(JournalFile *f) {
         return 0;
 }
 
-static int journal_file_setup_field_hash_table(JournalFile *f) {
+static int journal_file_setup_field_hash_table(JournalFile *f, JournalFile *template) {
         uint64_t s, p;
         Object *o;
         int r;
@@ -1061,10 +1281,12 @@ static int journal_file_setup_field_hash_table(JournalFile *f) {
         assert(f);
         assert(f->header);
 
-        /* We use a fixed size hash table for the fields as this
-         * number should grow very slowly only */
+        /* The number of fields should grow very slowly only, hence we use a fixed size hash table, unless the file
+         * we replace had more fields already. Then leave room for twice as many. */
 
         s = DEFAULT_FIELD_HASH_TABLE_SIZE;
+        if (template && template->header && JOURNAL_HEADER_CONTAINS(template->header, n_fields))
+                s = MAX(s, le64toh(template->header->n_fields) * 2 * sizeof(HashItem));
         r = journal_file_append_object(f,
                                        OBJECT_FIELD_HASH_TABLE,
                                        offsetof(Object, hash_table.items) + s,
@@ -1132,6 +1354,33 @@ int journal_file_map_field_hash_table(JournalFile *f) {
         return 0;
 }
 
+void journal_file_prefetch_data_hash_table(JournalFile *f) {
+        uint64_t p, s;
+
+        assert(f);
+        assert(f->header);
+
+        /* Asks the kernel to read the data hash table of this file into the page cache in the background. When
+         * matches are evaluated over many cold files this lets the reads for all of them proceed in parallel,
+         * instead of paying for the page faults one file after the other. This only needs to be done once per
+         * file, and failure is not fatal, it just means we'll fault the pages in when needed. */
+
+        if (f->data_hash_table_prefetched)
+                return;
+
+        f->data_hash_table_prefetched = true;
+
+        if (f->fd < 0 || f->data_hash_table)
+                return;
+
+        p = le64toh(f->header->data_hash_table_offset);
+        s = le64toh(f->header->data_hash_table_size);
+        if (p == 0 || s == 0)
+                return;
+
+        (void) posix_fadvise(f->fd, p, s, POSIX_FADV_WILLNEED);
+}
+
 static int journal_file_link_field(
                 JournalFile *f,
                 Object *o,
@@ -1300,6 +1549,30 @@ int journal_file_find_field_object(
                                                         ret, offset);
 }
 
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+int journal_file_decompress_blob(
+                JournalFile *f,
+                int compression,
+                const void *src, uint64_t src_size,
+                size_t *ret_size,
+                size_t dst_max) {
+
+        usec_t begin;
+        int r;
+
+        assert(f);
+        assert(ret_size);
+
+        /* Decompresses into the file's buffer, and keeps track of the time spent doing so */
+
+        begin = now(CLOCK_MONOTONIC);
+        r = decompress_blob(compression, src, src_size, &f->compress_buffer, &f->compress_buffer_size, ret_size, dst_max);
+        f->decompress_usec += usec_sub_unsigned(now(CLOCK_MONOTONIC), begin);
+
+        return r;
+}
+#endif
+
 int journal_file_find_data_object_with_hash(
                 JournalFile *f,
                 const void *data, uint64_t size, uint64_t hash,
@@ -1341,7 +1614,7 @@ int journal_file_find_data_object_with_hash(
                         goto next;
 
                 if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
                         uint64_t l;
                         size_t rsize = 0;
 
@@ -1351,8 +1624,8 @@ int journal_file_find_data_object_with_hash(
 
                         l -= offsetof(Object, data.payload);
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
-                                            o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
+                        r = journal_file_decompress_blob(f, o->object.flags & OBJECT_COMPRESSION_MASK,
+                                                         o->data.payload, l, &rsize, 0);
                         if (r < 0)
                                 return r;
 
@@ -1468,12 +1741,75 @@ static int journal_file_append_field(
         return 0;
 }
 
-static int journal_file_append_data(
+typedef struct DataCacheItem {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t size;
+        uint8_t payload[];
+} DataCacheItem;
+
+static uint64_t data_cache_get(JournalFile *f, const void *data, uint64_t size, uint64_t hash) {
+        DataCacheItem *i;
+
+        assert(f);
+
+        i = ordered_hashmap_get(f->data_cache, &hash);
+        if (!i)
+                return 0;
+
+        /* Verify that this is really the payload we are looking for, and not just a hash collision */
+        if (i->size != size || memcmp_safe(i->payload, data, size) != 0)
+                return 0;
+
+        /* Move the item to the end of the list, so that the least recently used item is always first */
+        assert_se(ordered_hashmap_remove(f->data_cache, &hash) == i);
+        if (ordered_hashmap_put(f->data_cache, &i->hash, i) < 0) {
+                free(i);
+                return 0;
+        }
+
+        return i->offset;
+}
+
+static void data_cache_put(JournalFile *f, const void *data, uint64_t size, uint64_t hash, uint64_t offset) {
+        DataCacheItem *i;
+
+        assert(f);
+        assert(offset > 0);
+
+        if (size > DATA_CACHE_PAYLOAD_MAX)
+                return;
+
+        if (ordered_hashmap_ensure_allocated(&f->data_cache, &uint64_hash_ops) < 0)
+                return;
+
+        /* A different payload with the same hash is already cached, keep the old one */
+        if (ordered_hashmap_contains(f->data_cache, &hash))
+                return;
+
+        if (ordered_hashmap_size(f->data_cache) >= DATA_CACHE_MAX)
+                free(ordered_hashmap_steal_first(f->data_cache));
+
+        i = malloc(offsetof(DataCacheItem, payload) + size);
+        if (!i)
+                return;
+
+        i->hash = hash;
+        i->offset = offset;
+        i->size = size;
+        memcpy_safe(i->payload, data, size);
+
+        if (ordered_hashmap_put(f->data_cache, &i->hash, i) < 0)
+                free(i);
+}
+
+static int journal_file_append_data_with_hash(
                 JournalFile *f,
                 const void *data, uint64_t size,
+                uint64_t hash,
                 Object **ret, uint64_t *offset) {
 
-        uint64_t hash, p;
+        uint64_t p;
         uint64_t osize;
         Object *o;
         int r, compression = 0;
@@ -1482,12 +1818,27 @@ static int journal_file_append_data(
         assert(f);
         assert(data || size == 0);
 
-        hash = hash64(data, size);
+        /* Data objects never move once written, hence if we already know where this payload is stored we can
+         * skip looking it up in the hash table. */
+        p = data_cache_get(f, data, size, hash);
+        if (p > 0) {
+                if (ret) {
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, ret);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (offset)
+                        *offset = p;
+
+                return 0;
+        }
 
         r = journal_file_find_data_object_with_hash(f, data, size, hash, &o, &p);
         if (r < 0)
                 return r;
         if (r > 0) {
+                data_cache_put(f, data, size, hash, p);
 
                 if (ret)
                         *ret = o;
@@ -1503,13 +1854,17 @@ static int journal_file_append_data(
         if (r < 0)
                 return r;
 
+        /* The summary describes the data objects that existed when the file was archived, it's out of date now */
+        if (JOURNAL_HEADER_CONTAINS(f->header, summary_offset))
+                f->header->summary_offset = 0;
+
         o->data.hash = htole64(hash);
 
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         if (JOURNAL_FILE_COMPRESS(f) && size >= f->compress_threshold_bytes) {
                 size_t rsize = 0;
 
-                compression = compress_blob(data, size, o->data.payload, size - 1, &rsize);
+                compression = compress_blob(data, size, o->data.payload, size - 1, &rsize, f->compress_level);
 
                 if (compression >= 0) {
                         o->object.size = htole64(offsetof(Object, data.payload) + rsize);
@@ -1560,6 +1915,8 @@ static int journal_file_append_data(
                 fo->field.head_data_offset = le64toh(p);
         }
 
+        data_cache_put(f, data, size, hash, p);
+
         if (ret)
                 *ret = o;
 
@@ -1569,6 +1926,17 @@ static int journal_file_append_data(
         return 0;
 }
 
+static int journal_file_append_data(
+                JournalFile *f,
+                const void *data, uint64_t size,
+                Object **ret, uint64_t *offset) {
+
+        assert(f);
+        assert(data || size == 0);
+
+        return journal_file_append_data_with_hash(f, data, size, hash64(data, size), ret, offset);
+}
+
 uint64_t journal_file_entry_n_items(Object *o) {
         assert(o);
 
@@ -1905,11 +2273,99 @@ static int entry_item_cmp(const EntryItem *a, const EntryItem *b) {
         return CMP(le64toh(a->object_offset), le64toh(b->object_offset));
 }
 
-int journal_file_append_entry(
+typedef struct BatchDataItem {
+        uint64_t hash;
+        const struct iovec *iovec;
+        uint64_t offset;
+} BatchDataItem;
+
+typedef struct EntryBatch {
+        /* Data objects already looked up or written while appending this batch, indexed by payload hash. This
+         * way payloads that repeat on every entry of the batch (_HOSTNAME=, _BOOT_ID=, …) are only looked up in
+         * the on-disk hash table once. */
+        Hashmap *data;
+        BatchDataItem *items;
+        size_t n_items, n_allocated;
+} EntryBatch;
+
+static void entry_batch_done(EntryBatch *b) {
+        assert(b);
+
+        b->data = hashmap_free(b->data);
+        b->items = mfree(b->items);
+        b->n_items = b->n_allocated = 0;
+}
+
+static bool entry_batch_find(EntryBatch *b, const struct iovec *iovec, uint64_t hash, uint64_t *ret) {
+        BatchDataItem *i;
+
+        assert(iovec);
+        assert(ret);
+
+        if (!b)
+                return false;
+
+        i = hashmap_get(b->data, &hash);
+        if (!i)
+                return false;
+
+        /* On a hash collision we simply don't use the batch, and go the slow path via the hash table. */
+        if (i->iovec->iov_len != iovec->iov_len ||
+            memcmp_safe(i->iovec->iov_base, iovec->iov_base, iovec->iov_len) != 0)
+                return false;
+
+        *ret = i->offset;
+        return true;
+}
+
+static void entry_batch_add(EntryBatch *b, const struct iovec *iovec, uint64_t hash, uint64_t offset) {
+        BatchDataItem *i;
+
+        assert(iovec);
+
+        if (!b)
+                return;
+
+        /* The batch is only a shortcut, hence failing to remember an item here is not fatal. Note that the
+         * items array is allocated in full before the batch is started, so that the hashmap keys never move. */
+        if (b->n_items >= b->n_allocated)
+                return;
+
+        if (hashmap_ensure_allocated(&b->data, &uint64_hash_ops) < 0)
+                return;
+
+        i = b->items + b->n_items;
+        *i = (BatchDataItem) {
+                .hash = hash,
+                .iovec = iovec,
+                .offset = offset,
+        };
+
+        if (hashmap_put(b->data, &i->hash, i) > 0)
+                b->n_items++;
+}
+
+static int journal_file_check_timestamp(const dual_timestamp *ts) {
+        assert(ts);
+
+        if (!VALID_REALTIME(ts->realtime))
+                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Invalid realtime timestamp %" PRIu64 ", refusing entry.",
+                                       ts->realtime);
+        if (!VALID_MONOTONIC(ts->monotonic))
+                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Invalid monotomic timestamp %" PRIu64 ", refusing entry.",
+                                       ts->monotonic);
+
+        return 0;
+}
+
+static int journal_file_append_entry_one(
                 JournalFile *f,
                 const dual_timestamp *ts,
                 const sd_id128_t *boot_id,
                 const struct iovec iovec[], unsigned n_iovec,
+                EntryBatch *batch,
                 uint64_t *seqnum,
                 Object **ret, uint64_t *offset) {
 
@@ -1917,26 +2373,12 @@ int journal_file_append_entry(
         EntryItem *items;
         int r;
         uint64_t xor_hash = 0;
-        struct dual_timestamp _ts;
 
         assert(f);
         assert(f->header);
+        assert(ts);
         assert(iovec || n_iovec == 0);
 
-        if (ts) {
-                if (!VALID_REALTIME(ts->realtime))
-                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
-                                               "Invalid realtime timestamp %" PRIu64 ", refusing entry.",
-                                               ts->realtime);
-                if (!VALID_MONOTONIC(ts->monotonic))
-                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
-                                               "Invalid monotomic timestamp %" PRIu64 ", refusing entry.",
-                                               ts->monotonic);
-        } else {
-                dual_timestamp_get(&_ts);
-                ts = &_ts;
-        }
-
 #if HAVE_GCRYPT
         r = journal_file_maybe_append_tag(f, ts->realtime);
         if (r < 0)
@@ -1947,23 +2389,32 @@ int journal_file_append_entry(
         items = newa(EntryItem, MAX(1u, n_iovec));
 
         for (i = 0; i < n_iovec; i++) {
-                uint64_t p;
-                Object *o;
+                uint64_t h, p;
 
-                r = journal_file_append_data(f, iovec[i].iov_base, iovec[i].iov_len, &o, &p);
-                if (r < 0)
-                        return r;
+                h = hash64(iovec[i].iov_base, iovec[i].iov_len);
+
+                if (!entry_batch_find(batch, iovec + i, h, &p)) {
+                        r = journal_file_append_data_with_hash(f, iovec[i].iov_base, iovec[i].iov_len, h, NULL, &p);
+                        if (r < 0)
+                                return r;
+
+                        entry_batch_add(batch, iovec + i, h, p);
+                }
 
-                xor_hash ^= le64toh(o->data.hash);
+                xor_hash ^= h;
                 items[i].object_offset = htole64(p);
-                items[i].hash = o->data.hash;
+                items[i].hash = htole64(h);
         }
 
         /* Order by the position on disk, in order to improve seek
          * times for rotating media. */
         typesafe_qsort(items, n_iovec, entry_item_cmp);
 
-        r = journal_file_append_entry_internal(f, ts, boot_id, xor_hash, items, n_iovec, seqnum, ret, offset);
+        return journal_file_append_entry_internal(f, ts, boot_id, xor_hash, items, n_iovec, seqnum, ret, offset);
+}
+
+static int journal_file_append_finish(JournalFile *f, int r) {
+        assert(f);
 
         /* If the memory mapping triggered a SIGBUS then we return an
          * IO error and ignore the error code passed down to us, since
@@ -1981,6 +2432,103 @@ int journal_file_append_entry(
         return r;
 }
 
+int journal_file_append_entry(
+                JournalFile *f,
+                const dual_timestamp *ts,
+                const sd_id128_t *boot_id,
+                const struct iovec iovec[], unsigned n_iovec,
+                uint64_t *seqnum,
+                Object **ret, uint64_t *offset) {
+
+        struct dual_timestamp _ts;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(iovec || n_iovec == 0);
+
+        if (ts) {
+                r = journal_file_check_timestamp(ts);
+                if (r < 0)
+                        return r;
+        } else {
+                dual_timestamp_get(&_ts);
+                ts = &_ts;
+        }
+
+        r = journal_file_append_entry_one(f, ts, boot_id, iovec, n_iovec, NULL, seqnum, ret, offset);
+
+        return journal_file_append_finish(f, r);
+}
+
+int journal_file_append_entries(
+                JournalFile *f,
+                const dual_timestamp ts[],
+                const sd_id128_t *boot_id,
+                const struct iovec *const iovecs[], const unsigned n_iovecs[], size_t n_entries,
+                uint64_t *seqnum,
+                uint64_t offsets[],
+                size_t *ret_n_appended) {
+
+        _cleanup_(entry_batch_done) EntryBatch batch = {};
+        struct dual_timestamp _ts;
+        size_t i, n = 0, n_items = 0;
+        int r = 0;
+
+        /* Appends n_entries entries in one go. If ts is non-NULL it must point to an array of n_entries
+         * timestamps, otherwise all entries are stamped with the current time. Data objects are shared across
+         * the whole batch, and change notification is done only once after the last entry has been
+         * written. If offsets is non-NULL, the offsets of the entry objects written are stored in it. Returns
+         * the number of entries actually written in ret_n_appended, also on failure. */
+
+        assert(f);
+        assert(f->header);
+        assert(iovecs || n_entries == 0);
+        assert(n_iovecs || n_entries == 0);
+
+        if (ret_n_appended)
+                *ret_n_appended = 0;
+
+        if (n_entries == 0)
+                return 0;
+
+        if (ts)
+                for (i = 0; i < n_entries; i++) {
+                        r = journal_file_check_timestamp(ts + i);
+                        if (r < 0)
+                                return r;
+                }
+        else
+                dual_timestamp_get(&_ts);
+
+        for (i = 0; i < n_entries; i++) {
+                assert(iovecs[i] || n_iovecs[i] == 0);
+                n_items += n_iovecs[i];
+        }
+
+        /* There's nothing to share for a single entry, hence don't bother with the batch in that case */
+        if (n_entries > 1 && n_items > 0) {
+                batch.items = new(BatchDataItem, n_items);
+                if (batch.items)
+                        batch.n_allocated = n_items;
+        }
+
+        for (i = 0; i < n_entries; i++) {
+                r = journal_file_append_entry_one(f, ts ? ts + i : &_ts, boot_id, iovecs[i], n_iovecs[i],
+                                                  batch.n_allocated > 0 ? &batch : NULL,
+                                                  seqnum, NULL, offsets ? offsets + i : NULL);
+                if (r < 0)
+                        break;
+
+                n++;
+        }
+
+        if (ret_n_appended)
+                *ret_n_appended = n;
+
+        return journal_file_append_finish(f, r);
+}
+
 typedef struct ChainCacheItem {
         uint64_t first; /* the array at the beginning of the chain */
         uint64_t array; /* the cached array */
@@ -3018,6 +3566,12 @@ void journal_file_dump(JournalFile *f) {
                                le64toh(o->tag.epoch));
                         break;
 
+                case OBJECT_SUMMARY:
+                        printf("Type: OBJECT_SUMMARY n_boot_ids=%"PRIu64" bloom_size=%"PRIu64"\n",
+                               le64toh(o->summary.n_boot_ids),
+                               le64toh(o->summary.bloom_size));
+                        break;
+
                 default:
                         printf("Type: unknown (%i)\n", o->object.type);
                         break;
@@ -3063,7 +3617,7 @@ void journal_file_print_header(JournalFile *f) {
                "Sequential Number ID: %s\n"
                "State: %s\n"
                "Compatible Flags:%s%s\n"
-               "Incompatible Flags:%s%s%s\n"
+               "Incompatible Flags:%s%s%s%s\n"
                "Header size: %"PRIu64"\n"
                "Arena size: %"PRIu64"\n"
                "Data Hash Table Size: %"PRIu64"\n"
@@ -3088,6 +3642,7 @@ void journal_file_print_header(JournalFile *f) {
                (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_ANY) ? " ???" : "",
                JOURNAL_HEADER_COMPRESSED_XZ(f->header) ? " COMPRESSED-XZ" : "",
                JOURNAL_HEADER_COMPRESSED_LZ4(f->header) ? " COMPRESSED-LZ4" : "",
+               JOURNAL_HEADER_COMPRESSED_ZSTD(f->header) ? " COMPRESSED-ZSTD" : "",
                (le32toh(f->header->incompatible_flags) & ~HEADER_INCOMPATIBLE_ANY) ? " ???" : "",
                le64toh(f->header->header_size),
                le64toh(f->header->arena_size),
@@ -3120,6 +3675,9 @@ void journal_file_print_header(JournalFile *f) {
         if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
                 printf("Entry Array Objects: %"PRIu64"\n",
                        le64toh(f->header->n_entry_arrays));
+        if (JOURNAL_HEADER_CONTAINS(f->header, summary_offset))
+                printf("Summary: %s\n",
+                       yes_no(f->header->summary_offset != 0));
 
         if (fstat(f->fd, &st) >= 0)
                 printf("Disk usage: %s\n", format_bytes(bytes, sizeof(bytes), (uint64_t) st.st_blocks * 512ULL));
@@ -3196,12 +3754,15 @@ int journal_file_open(
         *f = (JournalFile) {
                 .fd = fd,
                 .mode = mode,
+                .candidate_idx = PRIOQ_IDX_NULL,
 
                 .flags = flags,
                 .prot = prot_from_flags(flags),
                 .writable = (flags & O_ACCMODE) != O_RDONLY,
 
-#if HAVE_LZ4
+#if HAVE_ZSTD
+                .compress_zstd = compress,
+#elif HAVE_LZ4
                 .compress_lz4 = compress,
 #elif HAVE_XZ
                 .compress_xz = compress,
@@ -3209,6 +3770,7 @@ int journal_file_open(
                 .compress_threshold_bytes = compress_threshold_bytes == (uint64_t) -1 ?
                                             DEFAULT_COMPRESS_THRESHOLD :
                                             MAX(MIN_COMPRESS_THRESHOLD, compress_threshold_bytes),
+                .compress_level = template ? template->compress_level : 0,
 #if HAVE_GCRYPT
                 .seal = seal,
 #endif
@@ -3357,11 +3919,11 @@ int journal_file_open(
 #endif
 
         if (newly_created) {
-                r = journal_file_setup_field_hash_table(f);
+                r = journal_file_setup_field_hash_table(f, template);
                 if (r < 0)
                         goto fail;
 
-                r = journal_file_setup_data_hash_table(f);
+                r = journal_file_setup_data_hash_table(f, template);
                 if (r < 0)
                         goto fail;
 
@@ -3402,8 +3964,290 @@ fail:
         return r;
 }
 
+static void bloom_add(uint8_t *bloom, uint64_t size, unsigned n_hashes, uint64_t hash) {
+        uint64_t n_bits, a, b;
+        unsigned i;
+
+        /* Derives the bit positions from the two halves of the 64bit hash we already have for each data object,
+         * see Kirsch and Mitzenmacher, "Less Hashing, Same Performance: Building a Better Bloom Filter". */
+
+        n_bits = size * 8;
+        a = hash & UINT32_MAX;
+        b = (hash >> 32) | 1;
+
+        for (i = 0; i < n_hashes; i++) {
+                uint64_t k = (a + i * b) % n_bits;
+
+                bloom[k / 8] |= 1U << (k % 8);
+        }
+}
+
+static bool bloom_test(const uint8_t *bloom, uint64_t size, unsigned n_hashes, uint64_t hash) {
+        uint64_t n_bits, a, b;
+        unsigned i;
+
+        n_bits = size * 8;
+        a = hash & UINT32_MAX;
+        b = (hash >> 32) | 1;
+
+        for (i = 0; i < n_hashes; i++) {
+                uint64_t k = (a + i * b) % n_bits;
+
+                if (!(bloom[k / 8] & (1U << (k % 8))))
+                        return false;
+        }
+
+        return true;
+}
+
+static int journal_file_data_payload(JournalFile *f, Object *o, const void **ret, size_t *ret_size) {
+        uint64_t l;
+
+        assert(f);
+        assert(o);
+        assert(o->object.type == OBJECT_DATA);
+
+        l = le64toh(o->object.size);
+        if (l < offsetof(Object, data.payload))
+                return -EBADMSG;
+        l -= offsetof(Object, data.payload);
+
+        if (o->object.flags & OBJECT_COMPRESSION_MASK) {
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+                size_t rsize;
+                int r;
+
+                r = journal_file_decompress_blob(f, o->object.flags & OBJECT_COMPRESSION_MASK,
+                                                 o->data.payload, l, &rsize, 0);
+                if (r < 0)
+                        return r;
+
+                *ret = f->compress_buffer;
+                *ret_size = rsize;
+                return 0;
+#else
+                return -EPROTONOSUPPORT;
+#endif
+        }
+
+        *ret = o->data.payload;
+        *ret_size = l;
+        return 0;
+}
+
+static int journal_file_collect_boot_ids(JournalFile *f, sd_id128_t **ret, size_t *ret_n) {
+        _cleanup_free_ sd_id128_t *ids = NULL;
+        size_t n = 0, n_allocated = 0;
+        uint64_t p, n_data = 0;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(ret);
+        assert(ret_n);
+
+        r = journal_file_find_field_object(f, "_BOOT_ID", STRLEN("_BOOT_ID"), &o, NULL);
+        if (r < 0)
+                return r;
+
+        /* All data objects of a field are linked together from the field object */
+        for (p = r > 0 ? le64toh(o->field.head_data_offset) : 0; p != 0; p = le64toh(o->data.next_field_offset)) {
+                char s[SD_ID128_STRING_MAX];
+                const void *data;
+                size_t l;
+
+                /* Don't loop endlessly on corrupted files */
+                if (++n_data > le64toh(f->header->n_data))
+                        return -EBADMSG;
+
+                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                if (r < 0)
+                        return r;
+
+                r = journal_file_data_payload(f, o, &data, &l);
+                if (r < 0)
+                        return r;
+
+                if (l != STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX - 1 || !memory_startswith(data, l, "_BOOT_ID="))
+                        return -EBADMSG;
+
+                memcpy(s, (const char*) data + STRLEN("_BOOT_ID="), SD_ID128_STRING_MAX - 1);
+                char_array_0(s);
+
+                if (!GREEDY_REALLOC(ids, n_allocated, n + 1))
+                        return -ENOMEM;
+
+                r = sd_id128_from_string(s, ids + n);
+                if (r < 0)
+                        return r;
+
+                n++;
+
+                /* Decompression might have moved the window */
+                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(ids);
+        *ret_n = n;
+        return 0;
+}
+
+static int journal_file_fill_data_bloom(JournalFile *f, uint8_t *bloom, uint64_t bloom_size) {
+        uint64_t i, m, n = 0;
+        int r;
+
+        assert(f);
+        assert(bloom || bloom_size == 0);
+
+        if (bloom_size == 0)
+                return 0;
+
+        r = journal_file_map_data_hash_table(f);
+        if (r < 0)
+                return r;
+
+        /* Walk all hash chains, the hash of each data object is stored in the object itself, hence this doesn't
+         * require looking at any payload */
+        m = le64toh(f->header->data_hash_table_size) / sizeof(HashItem);
+        for (i = 0; i < m; i++) {
+                uint64_t p;
+
+                for (p = le64toh(f->data_hash_table[i].head_hash_offset); p != 0; ) {
+                        Object *o;
+
+                        /* Don't loop endlessly on corrupted files */
+                        if (++n > le64toh(f->header->n_data))
+                                return -EBADMSG;
+
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        bloom_add(bloom, bloom_size, SUMMARY_BLOOM_N_HASHES, le64toh(o->data.hash));
+
+                        p = le64toh(o->data.next_hash_offset);
+                }
+        }
+
+        return 0;
+}
+
+static int journal_file_append_summary(JournalFile *f) {
+        _cleanup_free_ sd_id128_t *boot_ids = NULL;
+        _cleanup_free_ uint8_t *bloom = NULL;
+        uint64_t bloom_size, n_data, p;
+        size_t n_boot_ids;
+        Object *o;
+        int r;
+
+        assert(f);
+
+        /* Summarizes what is in this file for readers, so that they can skip it without looking into the hash
+         * tables if it cannot match. We don't do this for sealed files, as verifiers that don't know the object
+         * type would refuse them. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, summary_offset) || f->seal)
+                return 0;
+
+        r = journal_file_collect_boot_ids(f, &boot_ids, &n_boot_ids);
+        if (r < 0)
+                return r;
+
+        n_data = le64toh(f->header->n_data);
+        bloom_size = n_data > 0 ? ALIGN64(DIV_ROUND_UP(n_data * SUMMARY_BLOOM_BITS_PER_ITEM, 8)) : 0;
+
+        if (bloom_size > 0) {
+                bloom = new0(uint8_t, bloom_size);
+                if (!bloom)
+                        return -ENOMEM;
+
+                r = journal_file_fill_data_bloom(f, bloom, bloom_size);
+                if (r < 0)
+                        return r;
+        }
+
+        f->appending_summary = true;
+        r = journal_file_append_object(f, OBJECT_SUMMARY,
+                                       offsetof(SummaryObject, payload) + n_boot_ids * sizeof(sd_id128_t) + bloom_size,
+                                       &o, &p);
+        f->appending_summary = false;
+        if (r < 0)
+                return r;
+
+        o->summary.n_boot_ids = htole64(n_boot_ids);
+        o->summary.bloom_size = htole64(bloom_size);
+        o->summary.bloom_n_hashes = htole64(bloom_size > 0 ? SUMMARY_BLOOM_N_HASHES : 0);
+
+        memcpy_safe(o->summary.payload, boot_ids, n_boot_ids * sizeof(sd_id128_t));
+        memcpy_safe(o->summary.payload + n_boot_ids * sizeof(sd_id128_t), bloom, bloom_size);
+
+        f->header->summary_offset = htole64(p);
+
+        log_debug("Added summary to %s (%zu boot IDs, %"PRIu64" data objects, %"PRIu64" bytes Bloom filter).",
+                  f->path, n_boot_ids, n_data, bloom_size);
+
+        return 0;
+}
+
+int journal_file_summary_may_contain(JournalFile *f, const void *data, uint64_t size, uint64_t hash) {
+        uint64_t p, n_boot_ids, bloom_size;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(data || size == 0);
+
+        /* Returns 0 if the file is known not to contain the specified data object, > 0 if it might */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, summary_offset))
+                return 1;
+
+        p = le64toh(f->header->summary_offset);
+        if (p == 0)
+                return 1;
+
+        r = journal_file_move_to_object(f, OBJECT_SUMMARY, p, &o);
+        if (r < 0)
+                return r;
+
+        n_boot_ids = le64toh(o->summary.n_boot_ids);
+        bloom_size = le64toh(o->summary.bloom_size);
+
+        if (size == STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX - 1 && memory_startswith(data, size, "_BOOT_ID=")) {
+                char s[SD_ID128_STRING_MAX];
+                sd_id128_t id;
+                uint64_t i;
+
+                memcpy(s, (const char*) data + STRLEN("_BOOT_ID="), SD_ID128_STRING_MAX - 1);
+                char_array_0(s);
+
+                if (sd_id128_from_string(s, &id) < 0)
+                        return 1;
+
+                for (i = 0; i < n_boot_ids; i++) {
+                        sd_id128_t k;
+
+                        memcpy(&k, o->summary.payload + i * sizeof(sd_id128_t), sizeof(k));
+                        if (sd_id128_equal(k, id))
+                                return 1;
+                }
+
+                return 0;
+        }
+
+        if (bloom_size == 0)
+                return 0;
+
+        return bloom_test(o->summary.payload + n_boot_ids * sizeof(sd_id128_t), bloom_size,
+                          le64toh(o->summary.bloom_n_hashes), hash);
+}
+
 int journal_file_archive(JournalFile *f) {
         _cleanup_free_ char *p = NULL;
+        int r;
 
         assert(f);
 
@@ -3418,6 +4262,10 @@ int journal_file_archive(JournalFile *f) {
         if (!endswith(f->path, ".journal"))
                 return -EINVAL;
 
+        r = journal_file_append_summary(f);
+        if (r < 0)
+                log_warning_errno(r, "Failed to add summary to %s, ignoring: %m", f->path);
+
         if (asprintf(&p, "%.*s@" SD_ID128_FORMAT_STR "-%016"PRIx64"-%016"PRIx64".journal",
                      (int) strlen(f->path) - 8, f->path,
                      SD_ID128_FORMAT_VAL(f->header->seqnum_id),
@@ -3639,11 +4487,11 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                         return -E2BIG;
 
                 if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
                         size_t rsize = 0;
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
-                                            o->data.payload, l, &from->compress_buffer, &from->compress_buffer_size, &rsize, 0);
+                        r = journal_file_decompress_blob(from, o->object.flags & OBJECT_COMPRESSION_MASK,
+                                                         o->data.payload, l, &rsize, 0);
                         if (r < 0)
                                 return r;
 
@@ -3689,11 +4537,12 @@ void journal_reset_metrics(JournalMetrics *m) {
                 .max_size = (uint64_t) -1,
                 .keep_free = (uint64_t) -1,
                 .n_max_files = (uint64_t) -1,
+                .file_size_increase = (uint64_t) -1,
         };
 }
 
 void journal_default_metrics(JournalMetrics *m, int fd) {
-        char a[FORMAT_BYTES_MAX], b[FORMAT_BYTES_MAX], c[FORMAT_BYTES_MAX], d[FORMAT_BYTES_MAX], e[FORMAT_BYTES_MAX];
+        char a[FORMAT_BYTES_MAX], b[FORMAT_BYTES_MAX], c[FORMAT_BYTES_MAX], d[FORMAT_BYTES_MAX], e[FORMAT_BYTES_MAX], g[FORMAT_BYTES_MAX];
         struct statvfs ss;
         uint64_t fs_size;
 
@@ -3775,13 +4624,19 @@ void journal_default_metrics(JournalMetrics *m, int fd) {
         if (m->n_max_files == (uint64_t) -1)
                 m->n_max_files = DEFAULT_N_MAX_FILES;
 
-        log_debug("Fixed min_use=%s max_use=%s max_size=%s min_size=%s keep_free=%s n_max_files=%" PRIu64,
+        if (IN_SET(m->file_size_increase, 0, (uint64_t) -1))
+                m->file_size_increase = FILE_SIZE_INCREASE;
+        else
+                m->file_size_increase = PAGE_ALIGN(m->file_size_increase);
+
+        log_debug("Fixed min_use=%s max_use=%s max_size=%s min_size=%s keep_free=%s n_max_files=%" PRIu64 " file_size_increase=%s",
                   format_bytes(a, sizeof(a), m->min_use),
                   format_bytes(b, sizeof(b), m->max_use),
                   format_bytes(c, sizeof(c), m->max_size),
                   format_bytes(d, sizeof(d), m->min_size),
                   format_bytes(e, sizeof(e), m->keep_free),
-                  m->n_max_files);
+                  m->n_max_files,
+                  format_bytes(g, sizeof(g), m->file_size_increase));
 }
 
 int journal_file_get_cutoff_realtime_usec(JournalFile *f, usec_t *from, usec_t *to) {
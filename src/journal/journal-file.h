@@ -24,6 +24,7 @@ typedef struct JournalMetrics {
         uint64_t min_use;      /* how much disk space to use in total at least, even if keep_free says not to */
         uint64_t keep_free;    /* how much to keep free on disk */
         uint64_t n_max_files;  /* how many files to keep around at max */
+        uint64_t file_size_increase; /* how much to grow journal files by at once */
 } JournalMetrics;
 
 typedef enum direction {
@@ -66,14 +67,18 @@ typedef struct JournalFile {
         bool writable:1;
         bool compress_xz:1;
         bool compress_lz4:1;
+        bool compress_zstd:1;
         bool seal:1;
         bool defrag_on_close:1;
+        bool data_hash_table_prefetched:1;
         bool close_fd:1;
         bool archive:1;
+        bool appending_summary:1;
 
         direction_t last_direction;
         LocationType location_type;
         uint64_t last_n_entries;
+        unsigned candidate_idx; /* index in sd_journal's prioq of files with a candidate entry */
 
         char *path;
         struct stat last_stat;
@@ -97,17 +102,30 @@ typedef struct JournalFile {
         usec_t post_change_timer_period;
 
         OrderedHashmap *chain_cache;
+        OrderedHashmap *data_cache;
 
         pthread_t offline_thread;
         volatile OfflineState offline_state;
 
+        /* Reserves the next chunk of the file in the background */
+        pthread_t preallocate_thread;
+        uint64_t preallocate_offset;
+        uint64_t preallocate_size;
+        int preallocate_error;
+        volatile bool preallocate_done;
+        bool preallocate_running:1;
+        bool preallocate_disabled:1;
+
         unsigned last_seen_generation;
+        uint64_t last_seen_n_entries; /* n_entries when sd_journal_process() last looked at the file */
 
         uint64_t compress_threshold_bytes;
-#if HAVE_XZ || HAVE_LZ4
+        int compress_level;
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         void *compress_buffer;
         size_t compress_buffer_size;
 #endif
+        usec_t decompress_usec;
 
 #if HAVE_GCRYPT
         gcry_md_hd_t hmac;
@@ -192,6 +210,9 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_COMPRESSED_LZ4(h) \
         (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_LZ4))
 
+#define JOURNAL_HEADER_COMPRESSED_ZSTD(h) \
+        (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD))
+
 int journal_file_move_to_object(JournalFile *f, ObjectType type, uint64_t offset, Object **ret);
 
 uint64_t journal_file_entry_n_items(Object *o) _pure_;
@@ -207,10 +228,22 @@ int journal_file_append_entry(
                 uint64_t *seqno,
                 Object **ret,
                 uint64_t *offset);
+int journal_file_append_entries(
+                JournalFile *f,
+                const dual_timestamp ts[],
+                const sd_id128_t *boot_id,
+                const struct iovec *const iovecs[], const unsigned n_iovecs[], size_t n_entries,
+                uint64_t *seqno,
+                uint64_t offsets[],
+                size_t *ret_n_appended);
 
 int journal_file_find_data_object(JournalFile *f, const void *data, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_find_data_object_with_hash(JournalFile *f, const void *data, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
 
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+int journal_file_decompress_blob(JournalFile *f, int compression, const void *src, uint64_t src_size, size_t *ret_size, size_t dst_max);
+#endif
+
 int journal_file_find_field_object(JournalFile *f, const void *field, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_find_field_object_with_hash(JournalFile *f, const void *field, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
 
@@ -235,6 +268,8 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
 void journal_file_dump(JournalFile *f);
 void journal_file_print_header(JournalFile *f);
 
+int journal_file_summary_may_contain(JournalFile *f, const void *data, uint64_t size, uint64_t hash);
+
 int journal_file_archive(JournalFile *f);
 JournalFile* journal_initiate_close(JournalFile *f, Set *deferred_closes);
 int journal_file_rotate(JournalFile **f, bool compress, uint64_t compress_threshold_bytes, bool seal, Set *deferred_closes);
@@ -254,8 +289,9 @@ bool journal_file_rotate_suggested(JournalFile *f, usec_t max_file_usec);
 
 int journal_file_map_data_hash_table(JournalFile *f);
 int journal_file_map_field_hash_table(JournalFile *f);
+void journal_file_prefetch_data_hash_table(JournalFile *f);
 
 static inline bool JOURNAL_FILE_COMPRESS(JournalFile *f) {
         assert(f);
-        return f->compress_xz || f->compress_lz4;
+        return f->compress_xz || f->compress_lz4 || f->compress_zstd;
 }
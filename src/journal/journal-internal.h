@@ -12,6 +12,7 @@
 #include "journal-def.h"
 #include "journal-file.h"
 #include "list.h"
+#include "prioq.h"
 #include "set.h"
 
 typedef struct Match Match;
@@ -81,6 +82,17 @@ struct sd_journal {
 
         Match *level0, *level1, *level2;
 
+        /* Files that currently point to a candidate entry for the next step, ordered by that entry, and the
+         * files that are not archived and hence might gain new entries after we hit their end */
+        Prioq *candidates;
+        direction_t candidates_direction;
+        JournalFile **live_files;
+        size_t n_live_files, n_live_files_allocated;
+
+        /* Archived files not looked at yet since the last seek, the one to look at next goes last */
+        JournalFile **pending_files;
+        size_t n_pending_files, n_pending_files_allocated;
+
         pid_t original_pid;
 
         int inotify_fd;
@@ -92,6 +104,7 @@ struct sd_journal {
         char *unique_field;
         JournalFile *unique_file;
         uint64_t unique_offset;
+        Set *unique_values; /* The values returned so far, to suppress them when we see them in later files */
 
         /* Iterating through known fields */
         JournalFile *fields_file;
@@ -112,9 +125,13 @@ struct sd_journal {
         bool fields_file_lost:1;
         bool has_runtime_files:1;
         bool has_persistent_files:1;
+        bool candidates_valid:1;
 
         size_t data_threshold;
 
+        /* Time spent decompressing objects of files that have been closed already */
+        usec_t decompress_usec;
+
         Hashmap *directories_by_path;
         Hashmap *directories_by_wd;
 
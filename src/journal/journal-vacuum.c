@@ -1,15 +1,19 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "sd-event.h"
 #include "sd-id128.h"
 
 #include "alloc-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
 #include "fs-util.h"
+#include "hashmap.h"
 #include "journal-def.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
@@ -19,18 +23,46 @@
 #include "util.h"
 #include "xattr-util.h"
 
-struct vacuum_info {
-        uint64_t usage;
+struct JournalDirectoryEntry {
         char *filename;
+        uint64_t usage;
 
         uint64_t realtime;
 
         sd_id128_t seqnum_id;
         uint64_t seqnum;
         bool have_seqnum;
+
+        bool archived;   /* archived or corrupted, hence a candidate for vacuuming */
+        bool empty;      /* contains no entries, always vacuumed */
+        bool unreadable; /* couldn't check whether it is empty, never vacuumed */
+        bool stale;      /* inotify told us the file changed, needs to be looked at again */
+};
+
+struct JournalDirectory {
+        char *path;
+
+        Hashmap *entries;
+        bool scanned;
+
+        sd_event_source *inotify_event_source;
 };
 
-static int vacuum_compare(const struct vacuum_info *a, const struct vacuum_info *b) {
+static JournalDirectoryEntry* journal_directory_entry_free(JournalDirectoryEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->filename);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalDirectoryEntry*, journal_directory_entry_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(journal_directory_entry_hash_ops, char, string_hash_func, string_compare_func,
+                                              JournalDirectoryEntry, journal_directory_entry_free);
+
+static int vacuum_compare(JournalDirectoryEntry * const *_a, JournalDirectoryEntry * const *_b) {
+        const JournalDirectoryEntry *a = *_a, *b = *_b;
         int r;
 
         if (a->have_seqnum && b->have_seqnum &&
@@ -51,7 +83,7 @@ static void patch_realtime(
                 int fd,
                 const char *fn,
                 const struct stat *st,
-                unsigned long long *realtime) {
+                uint64_t *realtime) {
 
         usec_t x, crtime = 0;
 
@@ -118,204 +150,531 @@ static int journal_file_empty(int dir_fd, const char *name) {
         return le64toh(n_entries) <= 0;
 }
 
-int journal_directory_vacuum(
-                const char *directory,
-                uint64_t max_use,
-                uint64_t n_max_files,
-                usec_t max_retention_usec,
-                usec_t *oldest_usec,
-                bool verbose) {
 
-        uint64_t sum = 0, freed = 0, n_active_files = 0;
-        size_t n_list = 0, n_allocated = 0, i;
-        _cleanup_closedir_ DIR *d = NULL;
-        struct vacuum_info *list = NULL;
-        usec_t retention_limit = 0;
-        char sbytes[FORMAT_BYTES_MAX];
-        struct dirent *de;
+static bool journal_directory_name_is_valid(const char *name) {
+        return endswith(name, ".journal") || endswith(name, ".journal~");
+}
+
+static void journal_directory_entry_parse(JournalDirectoryEntry *e) {
+        unsigned long long seqnum = 0, realtime, tmp;
+        const char *name;
+        size_t q;
+        char *c;
+
+        assert(e);
+
+        /* Figures out from the file name whether this is an archived (or corrupted) journal file, which are the
+         * ones we vacuum. Active files, and files whose names we cannot parse, are left around */
+
+        e->archived = false;
+
+        name = e->filename;
+        q = strlen(name);
+
+        if (endswith(name, ".journal")) {
+
+                if (q < 1 + 32 + 1 + 16 + 1 + 16 + 8)
+                        return;
+
+                if (name[q-8-16-1] != '-' ||
+                    name[q-8-16-1-16-1] != '-' ||
+                    name[q-8-16-1-16-1-32-1] != '@')
+                        return;
+
+                c = strndupa(name + q-8-16-1-16-1-32, 32);
+                if (sd_id128_from_string(c, &e->seqnum_id) < 0)
+                        return;
+
+                if (sscanf(name + q-8-16-1-16, "%16llx-%16llx.journal", &seqnum, &realtime) != 2)
+                        return;
+
+                e->have_seqnum = true;
+
+        } else if (endswith(name, ".journal~")) {
+
+                if (q < 1 + 16 + 1 + 16 + 8 + 1)
+                        return;
+
+                if (name[q-1-8-16-1] != '-' ||
+                    name[q-1-8-16-1-16-1] != '@')
+                        return;
+
+                if (sscanf(name + q-1-8-16-1-16, "%16llx-%16llx.journal~", &realtime, &tmp) != 2)
+                        return;
+
+                e->have_seqnum = false;
+        } else
+                return;
+
+        e->seqnum = seqnum;
+        e->realtime = realtime;
+        e->archived = true;
+}
+
+static int journal_directory_entry_update(int dir_fd, JournalDirectoryEntry *e) {
+        struct stat st;
         int r;
 
-        assert(directory);
+        assert(dir_fd >= 0);
+        assert(e);
 
-        if (max_use <= 0 && max_retention_usec <= 0 && n_max_files <= 0)
+        /* Returns > 0 if the entry should be kept in the index, 0 if it should be dropped */
+
+        if (fstatat(dir_fd, e->filename, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+                if (errno != ENOENT)
+                        log_debug_errno(errno, "Failed to stat file %s, ignoring: %m", e->filename);
                 return 0;
+        }
 
-        if (max_retention_usec > 0)
-                retention_limit = usec_sub_unsigned(now(CLOCK_REALTIME), max_retention_usec);
+        if (!S_ISREG(st.st_mode))
+                return 0;
 
-        d = opendir(directory);
-        if (!d)
-                return -errno;
+        journal_directory_entry_parse(e);
 
-        FOREACH_DIRENT_ALL(de, d, r = -errno; goto finish) {
+        e->usage = 512UL * (uint64_t) st.st_blocks;
+        e->empty = e->unreadable = e->stale = false;
 
-                unsigned long long seqnum = 0, realtime;
-                _cleanup_free_ char *p = NULL;
-                sd_id128_t seqnum_id;
-                bool have_seqnum;
-                uint64_t size;
-                struct stat st;
-                size_t q;
+        /* Active files change all the time, we only care about their size */
+        if (!e->archived)
+                return 1;
+
+        r = journal_file_empty(dir_fd, e->filename);
+        if (r < 0) {
+                log_debug_errno(r, "Failed check if %s is empty, ignoring: %m", e->filename);
+                e->unreadable = true;
+                return 1;
+        }
+
+        e->empty = r > 0;
+        if (!e->empty)
+                patch_realtime(dir_fd, e->filename, &st, &e->realtime);
+
+        return 1;
+}
+
+static int journal_directory_add_entry(JournalDirectory *d, int dir_fd, const char *filename) {
+        _cleanup_(journal_directory_entry_freep) JournalDirectoryEntry *e = NULL;
+        int r;
+
+        e = new0(JournalDirectoryEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->filename = strdup(filename);
+        if (!e->filename)
+                return -ENOMEM;
+
+        if (journal_directory_entry_update(dir_fd, e) <= 0)
+                return 0;
 
-                if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
-                        log_debug_errno(errno, "Failed to stat file %s while vacuuming, ignoring: %m", de->d_name);
+        r = hashmap_put(d->entries, e->filename, e);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(e);
+        return 1;
+}
+
+static int journal_directory_scan(JournalDirectory *d, DIR *dir) {
+        struct dirent *de;
+        int r;
+
+        assert(d);
+        assert(dir);
+
+        hashmap_clear(d->entries);
+        d->scanned = false;
+
+        FOREACH_DIRENT_ALL(de, dir, return -errno) {
+
+                if (!journal_directory_name_is_valid(de->d_name))
                         continue;
-                }
 
-                if (!S_ISREG(st.st_mode))
+                r = journal_directory_add_entry(d, dirfd(dir), de->d_name);
+                if (r < 0)
+                        return r;
+        }
+
+        /* Without an inotify watch we cannot trust the index to stay current, hence rescan next time again */
+        d->scanned = !!d->inotify_event_source;
+        return 0;
+}
+
+static int journal_directory_refresh_internal(JournalDirectory *d, DIR *dir) {
+        JournalDirectoryEntry *e;
+        Iterator i;
+
+        assert(d);
+        assert(dir);
+
+        if (!d->scanned)
+                return journal_directory_scan(d, dir);
+
+        HASHMAP_FOREACH(e, d->entries, i) {
+                if (e->archived && !e->stale)
                         continue;
 
-                q = strlen(de->d_name);
+                if (journal_directory_entry_update(dirfd(dir), e) <= 0)
+                        journal_directory_entry_free(hashmap_remove(d->entries, e->filename));
+        }
 
-                if (endswith(de->d_name, ".journal")) {
+        return 0;
+}
 
-                        /* Vacuum archived files. Active files are
-                         * left around */
+int journal_directory_refresh(JournalDirectory *d, uint64_t *ret_usage) {
+        _cleanup_closedir_ DIR *dir = NULL;
+        JournalDirectoryEntry *e;
+        uint64_t sum = 0;
+        Iterator i;
+        int r;
 
-                        if (q < 1 + 32 + 1 + 16 + 1 + 16 + 8) {
-                                n_active_files++;
-                                continue;
-                        }
+        assert(d);
 
-                        if (de->d_name[q-8-16-1] != '-' ||
-                            de->d_name[q-8-16-1-16-1] != '-' ||
-                            de->d_name[q-8-16-1-16-1-32-1] != '@') {
-                                n_active_files++;
-                                continue;
-                        }
+        dir = opendir(d->path);
+        if (!dir)
+                return -errno;
 
-                        p = strdup(de->d_name);
-                        if (!p) {
-                                r = -ENOMEM;
-                                goto finish;
-                        }
+        r = journal_directory_refresh_internal(d, dir);
+        if (r < 0)
+                return r;
 
-                        de->d_name[q-8-16-1-16-1] = 0;
-                        if (sd_id128_from_string(de->d_name + q-8-16-1-16-1-32, &seqnum_id) < 0) {
-                                n_active_files++;
-                                continue;
-                        }
+        HASHMAP_FOREACH(e, d->entries, i)
+                sum += e->usage;
 
-                        if (sscanf(de->d_name + q-8-16-1-16, "%16llx-%16llx.journal", &seqnum, &realtime) != 2) {
-                                n_active_files++;
-                                continue;
-                        }
+        if (ret_usage)
+                *ret_usage = sum;
 
-                        have_seqnum = true;
+        return 0;
+}
 
-                } else if (endswith(de->d_name, ".journal~")) {
-                        unsigned long long tmp;
+static int on_inotify(sd_event_source *s, const struct inotify_event *event, void *userdata) {
+        JournalDirectory *d = userdata;
+        JournalDirectoryEntry *e;
 
-                        /* Vacuum corrupted files */
+        assert(d);
+        assert(event);
 
-                        if (q < 1 + 16 + 1 + 16 + 8 + 1) {
-                                n_active_files++;
-                                continue;
-                        }
+        if (event->mask & (IN_Q_OVERFLOW|IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF)) {
+                log_debug("Lost track of %s, rescanning on next use.", d->path);
 
-                        if (de->d_name[q-1-8-16-1] != '-' ||
-                            de->d_name[q-1-8-16-1-16-1] != '@') {
-                                n_active_files++;
-                                continue;
-                        }
+                d->scanned = false;
 
-                        p = strdup(de->d_name);
-                        if (!p) {
-                                r = -ENOMEM;
-                                goto finish;
-                        }
+                /* The watch is gone for good if the directory went away, fall back to scanning every time */
+                if (event->mask & (IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF))
+                        d->inotify_event_source = sd_event_source_unref(d->inotify_event_source);
 
-                        if (sscanf(de->d_name + q-1-8-16-1-16, "%16llx-%16llx.journal~", &realtime, &tmp) != 2) {
-                                n_active_files++;
-                                continue;
-                        }
+                return 0;
+        }
 
-                        have_seqnum = false;
-                } else {
-                        /* We do not vacuum unknown files! */
-                        log_debug("Not vacuuming unknown file %s.", de->d_name);
-                        continue;
-                }
+        if (!d->scanned || event->len == 0 || !journal_directory_name_is_valid(event->name))
+                return 0;
 
-                size = 512UL * (uint64_t) st.st_blocks;
+        e = hashmap_get(d->entries, event->name);
 
-                r = journal_file_empty(dirfd(d), p);
-                if (r < 0) {
-                        log_debug_errno(r, "Failed check if %s is empty, ignoring: %m", p);
-                        continue;
+        if (event->mask & (IN_DELETE|IN_MOVED_FROM)) {
+                if (e)
+                        journal_directory_entry_free(hashmap_remove(d->entries, e->filename));
+                return 0;
+        }
+
+        if (e) {
+                e->stale = true;
+                return 0;
+        }
+
+        e = new0(JournalDirectoryEntry, 1);
+        if (!e)
+                goto fail;
+
+        e->filename = strdup(event->name);
+        if (!e->filename)
+                goto fail;
+
+        e->stale = true;
+
+        if (hashmap_put(d->entries, e->filename, e) < 0)
+                goto fail;
+
+        return 0;
+
+fail:
+        journal_directory_entry_free(e);
+        d->scanned = false;
+        return 0;
+}
+
+int journal_directory_new(const char *path, JournalDirectory **ret) {
+        _cleanup_(journal_directory_freep) JournalDirectory *d = NULL;
+
+        assert(path);
+        assert(ret);
+
+        d = new0(JournalDirectory, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->path = strdup(path);
+        if (!d->path)
+                return -ENOMEM;
+
+        d->entries = hashmap_new(&journal_directory_entry_hash_ops);
+        if (!d->entries)
+                return -ENOMEM;
+
+        *ret = TAKE_PTR(d);
+        return 0;
+}
+
+JournalDirectory* journal_directory_free(JournalDirectory *d) {
+        if (!d)
+                return NULL;
+
+        sd_event_source_unref(d->inotify_event_source);
+        hashmap_free(d->entries);
+        free(d->path);
+
+        return mfree(d);
+}
+
+int journal_directory_watch(JournalDirectory *d, sd_event *e) {
+        int r;
+
+        assert(d);
+        assert(e);
+
+        if (d->inotify_event_source)
+                return 0;
+
+        r = sd_event_add_inotify(e, &d->inotify_event_source, d->path,
+                                 IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_CLOSE_WRITE|IN_ATTRIB|
+                                 IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR,
+                                 on_inotify, d);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(d->inotify_event_source, "journal-directory-inotify");
+
+        /* Whatever we collected so far was collected without the watch in place */
+        d->scanned = false;
+        return 1;
+}
+
+void journal_directory_invalidate(JournalDirectory *d) {
+        if (!d)
+                return;
+
+        /* Forces a full rescan on next use, for example after we renamed files ourselves and don't want to wait
+         * for the inotify events to make it through the event loop. */
+        d->scanned = false;
+}
+
+typedef struct UnlinkContext {
+        int dir_fd;
+        JournalDirectoryEntry **list;
+        int *results;
+        size_t n;
+        size_t next;
+} UnlinkContext;
+
+static void *unlink_thread(void *p) {
+        UnlinkContext *c = p;
+        size_t k;
+
+        while ((k = __sync_fetch_and_add(&c->next, 1)) < c->n)
+                c->results[k] = unlinkat_deallocate(c->dir_fd, c->list[k]->filename, 0);
+
+        return NULL;
+}
+
+static void unlink_entries(int dir_fd, JournalDirectoryEntry **list, int *results, size_t n, unsigned n_threads) {
+        UnlinkContext c = {
+                .dir_fd = dir_fd,
+                .list = list,
+                .results = results,
+                .n = n,
+        };
+        pthread_t *threads = NULL;
+        size_t n_started = 0, k;
+
+        /* Deleting a journal file means deallocating its blocks, which can take a while on some file systems. Let's
+         * do that for multiple files at a time if we are asked to. If we fail to start some threads the calling
+         * thread simply picks up the slack. */
+
+        if (n_threads > n)
+                n_threads = n;
+
+        if (n_threads > 1) {
+                threads = newa(pthread_t, n_threads - 1);
+
+                for (n_started = 0; n_started < n_threads - 1; n_started++) {
+                        int r;
+
+                        r = pthread_create(threads + n_started, NULL, unlink_thread, &c);
+                        if (r != 0) {
+                                log_debug_errno(-r, "Failed to start unlink thread, continuing with %zu: %m", n_started + 1);
+                                break;
+                        }
                 }
-                if (r > 0) {
-                        /* Always vacuum empty non-online files. */
+        }
 
-                        r = unlinkat_deallocate(dirfd(d), p, 0);
-                        if (r >= 0) {
+        unlink_thread(&c);
 
-                                log_full(verbose ? LOG_INFO : LOG_DEBUG,
-                                         "Deleted empty archived journal %s/%s (%s).", directory, p, format_bytes(sbytes, sizeof(sbytes), size));
+        for (k = 0; k < n_started; k++)
+                assert_se(pthread_join(threads[k], NULL) == 0);
+}
 
-                                freed += size;
-                        } else if (r != -ENOENT)
-                                log_warning_errno(r, "Failed to delete empty archived journal %s/%s: %m", directory, p);
+int journal_directory_vacuum_index(
+                JournalDirectory *d,
+                uint64_t max_use,
+                uint64_t n_max_files,
+                usec_t max_retention_usec,
+                usec_t *oldest_usec,
+                unsigned n_threads,
+                bool verbose) {
+
+        uint64_t sum = 0, freed = 0, n_active_files = 0;
+        size_t n_list = 0, n_empty = 0, n_allocated = 0, i = 0, j, k;
+        _cleanup_free_ JournalDirectoryEntry **list = NULL;
+        _cleanup_free_ int *results = NULL;
+        _cleanup_closedir_ DIR *dir = NULL;
+        usec_t retention_limit = 0;
+        char sbytes[FORMAT_BYTES_MAX];
+        JournalDirectoryEntry *e;
+        Iterator it;
+        int r;
+
+        assert(d);
+
+        if (max_use <= 0 && max_retention_usec <= 0 && n_max_files <= 0)
+                return 0;
+
+        if (max_retention_usec > 0)
+                retention_limit = usec_sub_unsigned(now(CLOCK_REALTIME), max_retention_usec);
 
+        dir = opendir(d->path);
+        if (!dir)
+                return -errno;
+
+        r = journal_directory_refresh_internal(d, dir);
+        if (r < 0)
+                goto finish;
+
+        /* Empty files go first, they are always vacuumed. The rest is sorted oldest first. */
+        HASHMAP_FOREACH(e, d->entries, it) {
+                if (!e->archived) {
+                        n_active_files++;
                         continue;
                 }
 
-                patch_realtime(dirfd(d), p, &st, &realtime);
+                if (e->unreadable)
+                        continue;
 
                 if (!GREEDY_REALLOC(list, n_allocated, n_list + 1)) {
                         r = -ENOMEM;
                         goto finish;
                 }
 
-                list[n_list++] = (struct vacuum_info) {
-                        .filename = TAKE_PTR(p),
-                        .usage = size,
-                        .seqnum = seqnum,
-                        .realtime = realtime,
-                        .seqnum_id = seqnum_id,
-                        .have_seqnum = have_seqnum,
-                };
+                list[n_list++] = e;
+        }
+
+        for (k = 0; k < n_list; k++)
+                if (list[k]->empty) {
+                        SWAP_TWO(list[k], list[n_empty]);
+                        n_empty++;
+                } else
+                        sum += list[k]->usage;
+
+        if (n_list > n_empty) {
+                JournalDirectoryEntry **candidates = list + n_empty;
 
-                sum += size;
+                typesafe_qsort(candidates, n_list - n_empty, vacuum_compare);
         }
 
-        typesafe_qsort(list, n_list, vacuum_compare);
+        results = new(int, n_list);
+        if (!results) {
+                r = -ENOMEM;
+                goto finish;
+        }
+
+        for (;;) {
+                uint64_t projected = sum;
+
+                /* Pick the files to remove assuming that deleting them will succeed, then remove them in one go,
+                 * and go for another round with the actual numbers if some of them couldn't be removed. */
 
-        for (i = 0; i < n_list; i++) {
-                uint64_t left;
+                for (j = MAX(i, n_empty); j < n_list; j++) {
+                        uint64_t left;
 
-                left = n_active_files + n_list - i;
+                        left = n_active_files + n_list - j;
+
+                        if ((max_retention_usec <= 0 || list[j]->realtime >= retention_limit) &&
+                            (max_use <= 0 || projected <= max_use) &&
+                            (n_max_files <= 0 || left <= n_max_files))
+                                break;
+
+                        projected = LESS_BY(projected, list[j]->usage);
+                }
 
-                if ((max_retention_usec <= 0 || list[i].realtime >= retention_limit) &&
-                    (max_use <= 0 || sum <= max_use) &&
-                    (n_max_files <= 0 || left <= n_max_files))
+                if (j <= i)
                         break;
 
-                r = unlinkat_deallocate(dirfd(d), list[i].filename, 0);
-                if (r >= 0) {
-                        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Deleted archived journal %s/%s (%s).", directory, list[i].filename, format_bytes(sbytes, sizeof(sbytes), list[i].usage));
-                        freed += list[i].usage;
+                unlink_entries(dirfd(dir), list + i, results + i, j - i, n_threads);
 
-                        if (list[i].usage < sum)
-                                sum -= list[i].usage;
-                        else
-                                sum = 0;
+                for (k = i; k < j; k++) {
+                        bool empty = k < n_empty;
 
-                } else if (r != -ENOENT)
-                        log_warning_errno(r, "Failed to delete archived journal %s/%s: %m", directory, list[i].filename);
+                        if (results[k] >= 0) {
+                                log_full(verbose ? LOG_INFO : LOG_DEBUG,
+                                         "Deleted %sarchived journal %s/%s (%s).", empty ? "empty " : "",
+                                         d->path, list[k]->filename, format_bytes(sbytes, sizeof(sbytes), list[k]->usage));
+
+                                freed += list[k]->usage;
+                                if (!empty)
+                                        sum = LESS_BY(sum, list[k]->usage);
+
+                        } else if (results[k] != -ENOENT)
+                                log_warning_errno(results[k], "Failed to delete %sarchived journal %s/%s: %m", empty ? "empty " : "",
+                                                  d->path, list[k]->filename);
+                }
+
+                i = j;
         }
 
-        if (oldest_usec && i < n_list && (*oldest_usec == 0 || list[i].realtime < *oldest_usec))
-                *oldest_usec = list[i].realtime;
+        if (oldest_usec && i < n_list && (*oldest_usec == 0 || list[i]->realtime < *oldest_usec))
+                *oldest_usec = list[i]->realtime;
+
+        /* Drop whatever is gone now from the index, files we failed to delete stay around */
+        for (k = 0; k < i; k++)
+                if (results[k] >= 0 || results[k] == -ENOENT)
+                        journal_directory_entry_free(hashmap_remove(d->entries, list[k]->filename));
 
         r = 0;
 
 finish:
-        for (i = 0; i < n_list; i++)
-                free(list[i].filename);
-        free(list);
-
-        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Vacuuming done, freed %s of archived journals from %s.", format_bytes(sbytes, sizeof(sbytes), freed), directory);
+        log_full(verbose ? LOG_INFO : LOG_DEBUG, "Vacuuming done, freed %s of archived journals from %s.", format_bytes(sbytes, sizeof(sbytes), freed), d->path);
 
         return r;
 }
+
+int journal_directory_vacuum(
+                const char *directory,
+                uint64_t max_use,
+                uint64_t n_max_files,
+                usec_t max_retention_usec,
+                usec_t *oldest_usec,
+                bool verbose) {
+
+        _cleanup_(journal_directory_freep) JournalDirectory *d = NULL;
+        int r;
+
+        assert(directory);
+
+        if (max_use <= 0 && max_retention_usec <= 0 && n_max_files <= 0)
+                return 0;
+
+        r = journal_directory_new(directory, &d);
+        if (r < 0)
+                return r;
+
+        return journal_directory_vacuum_index(d, max_use, n_max_files, max_retention_usec, oldest_usec, 1, verbose);
+}
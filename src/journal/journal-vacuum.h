@@ -4,6 +4,24 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "sd-event.h"
+
+#include "macro.h"
 #include "time-util.h"
 
+/* An in-memory index of the journal files in a directory. If it is connected to an event loop it is kept current via
+ * inotify, so that size accounting and vacuuming do not need to rescan the directory each time. Without that it is
+ * rebuilt on every use. */
+typedef struct JournalDirectory JournalDirectory;
+typedef struct JournalDirectoryEntry JournalDirectoryEntry;
+
+int journal_directory_new(const char *path, JournalDirectory **ret);
+JournalDirectory* journal_directory_free(JournalDirectory *d);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalDirectory*, journal_directory_free);
+
+int journal_directory_watch(JournalDirectory *d, sd_event *e);
+void journal_directory_invalidate(JournalDirectory *d);
+int journal_directory_refresh(JournalDirectory *d, uint64_t *ret_usage);
+
+int journal_directory_vacuum_index(JournalDirectory *d, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, unsigned n_threads, bool verbose);
 int journal_directory_vacuum(const char *directory, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, bool verbose);
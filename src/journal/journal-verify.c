@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <stddef.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "alloc-util.h"
@@ -10,16 +11,51 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
+#include "gcrypt-util.h"
+#include "io-util.h"
 #include "journal-authenticate.h"
 #include "journal-def.h"
 #include "journal-file.h"
 #include "journal-verify.h"
 #include "lookup3.h"
 #include "macro.h"
+#include "mkdir.h"
+#include "string-util.h"
 #include "terminal-util.h"
 #include "tmpfile-util.h"
 #include "util.h"
 
+#define CHECKPOINT_SIGNATURE ((const uint8_t[]) { 'J', 'V', 'R', 'F', 'Y', 'C', 'P', '2' })
+
+/* The state of the first iteration of journal_file_verify() right after a verified object, which is enough
+ * to continue from there later on. This is stored in host byte order, checkpoints are not meant to be moved
+ * between machines. Checkpoints of sealed files carry a HMAC keyed with the verification key, so that they
+ * can't be forged by anybody who couldn't forge the tags in the journal file, too. */
+typedef struct VerifyCheckpoint {
+        uint8_t signature[8];
+        sd_id128_t file_id;
+
+        uint64_t offset;                /* first object not verified yet */
+        uint64_t last_object_offset;    /* the last verified object, i.e. the last tag for sealed files */
+        uint64_t last_object_size;
+        uint8_t tag[TAG_LENGTH];
+
+        uint64_t n_objects, n_entries, n_data, n_fields, n_data_hash_tables, n_field_hash_tables, n_entry_arrays, n_tags;
+        uint64_t entry_seqnum, entry_monotonic, entry_realtime, entry_offset;
+        sd_id128_t entry_boot_id;
+        uint64_t last_epoch, last_tag_realtime, last_sealed_realtime, last_tag;
+
+        bool entry_seqnum_set, entry_monotonic_set, entry_realtime_set;
+        bool found_main_entry_array, found_summary;
+        uint8_t reserved[3];
+
+        uint8_t hmac[TAG_LENGTH];       /* over everything above, zero for unsealed files */
+} VerifyCheckpoint;
+
+/* No padding, so that the HMAC covers every byte of the checkpoint that is read back */
+assert_cc(offsetof(VerifyCheckpoint, reserved) + 3 == offsetof(VerifyCheckpoint, hmac));
+assert_cc(offsetof(VerifyCheckpoint, hmac) + TAG_LENGTH == sizeof(VerifyCheckpoint));
+
 static void draw_progress(uint64_t p, usec_t *last_usec) {
         unsigned n, i, j, k;
         usec_t z, x;
@@ -119,7 +155,7 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
          * possible field values. It does not follow any references to
          * other objects. */
 
-        if ((o->object.flags & OBJECT_COMPRESSED_XZ) &&
+        if ((o->object.flags & OBJECT_COMPRESSION_MASK) &&
             o->object.type != OBJECT_DATA) {
                 error(offset, "Found compressed object that isn't of type DATA, which is not allowed.");
                 return -EBADMSG;
@@ -799,19 +835,17 @@ static int verify_entry_array(
         return 0;
 }
 
-int journal_file_verify(
+static int verify_journal_file(
                 JournalFile *f,
                 const char *key,
+                const VerifyCheckpoint *resume,
+                VerifyCheckpoint *ret_checkpoint,
                 usec_t *first_contained, usec_t *last_validated, usec_t *last_contained,
                 bool show_progress) {
+        VerifyCheckpoint s = {};
         int r;
         Object *o;
-        uint64_t p = 0, last_epoch = 0, last_tag_realtime = 0, last_sealed_realtime = 0;
-
-        uint64_t entry_seqnum = 0, entry_monotonic = 0, entry_realtime = 0;
-        sd_id128_t entry_boot_id;
-        bool entry_seqnum_set = false, entry_monotonic_set = false, entry_realtime_set = false, found_main_entry_array = false;
-        uint64_t n_weird = 0, n_objects = 0, n_entries = 0, n_data = 0, n_fields = 0, n_data_hash_tables = 0, n_field_hash_tables = 0, n_entry_arrays = 0, n_tags = 0;
+        uint64_t p = 0, n_weird = 0;
         usec_t last_usec = 0;
         int data_fd = -1, entry_fd = -1, entry_array_fd = -1;
         MMapFileDescriptor *cache_data_fd = NULL, *cache_entry_fd = NULL, *cache_entry_array_fd = NULL;
@@ -819,9 +853,6 @@ int journal_file_verify(
         bool found_last = false;
         const char *tmp_dir = NULL;
 
-#if HAVE_GCRYPT
-        uint64_t last_tag = 0;
-#endif
         assert(f);
 
         if (key) {
@@ -837,6 +868,12 @@ int journal_file_verify(
         } else if (f->seal)
                 return -ENOKEY;
 
+        /* When resuming from a checkpoint only the objects appended since are looked at, and the
+         * cross-references between all objects are not followed, so there's no need for the
+         * sorted offset lists below. */
+        if (resume)
+                goto skip_offset_files;
+
         r = var_tmp_dir(&tmp_dir);
         if (r < 0) {
                 log_error_errno(r, "Failed to determine temporary directory: %m");
@@ -880,6 +917,7 @@ int journal_file_verify(
                 goto fail;
         }
 
+skip_offset_files:
         if (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_SUPPORTED) {
                 log_error("Cannot verify file with unknown extensions.");
                 r = -EOPNOTSUPP;
@@ -896,8 +934,14 @@ int journal_file_verify(
         /* First iteration: we go through all objects, verify the
          * superficial structure, headers, hashes. */
 
-        p = le64toh(f->header->header_size);
-        for (;;) {
+        if (resume) {
+                s = *resume;
+                p = resume->offset;
+                found_last = resume->last_object_offset == le64toh(f->header->tail_object_offset);
+        } else
+                p = le64toh(f->header->header_size);
+
+        while (!found_last) {
                 /* Early exit if there are no objects in the file, at all */
                 if (le64toh(f->header->tail_object_offset) == 0)
                         break;
@@ -917,7 +961,7 @@ int journal_file_verify(
                         goto fail;
                 }
 
-                n_objects++;
+                s.n_objects++;
 
                 r = journal_file_object_verify(f, p, o);
                 if (r < 0) {
@@ -925,8 +969,8 @@ int journal_file_verify(
                         goto fail;
                 }
 
-                if ((o->object.flags & OBJECT_COMPRESSED_XZ) &&
-                    (o->object.flags & OBJECT_COMPRESSED_LZ4)) {
+                if (!IN_SET(o->object.flags & OBJECT_COMPRESSION_MASK,
+                            0, OBJECT_COMPRESSED_XZ, OBJECT_COMPRESSED_LZ4, OBJECT_COMPRESSED_ZSTD)) {
                         error(p, "Objected with double compression");
                         r = -EINVAL;
                         goto fail;
@@ -944,81 +988,92 @@ int journal_file_verify(
                         goto fail;
                 }
 
+                if ((o->object.flags & OBJECT_COMPRESSED_ZSTD) && !JOURNAL_HEADER_COMPRESSED_ZSTD(f->header)) {
+                        error(p, "ZSTD compressed object in file without ZSTD compression");
+                        r = -EBADMSG;
+                        goto fail;
+                }
+
                 switch (o->object.type) {
 
                 case OBJECT_DATA:
-                        r = write_uint64(data_fd, p);
-                        if (r < 0)
-                                goto fail;
+                        if (data_fd >= 0) {
+                                r = write_uint64(data_fd, p);
+                                if (r < 0)
+                                        goto fail;
+                        }
 
-                        n_data++;
+                        s.n_data++;
                         break;
 
                 case OBJECT_FIELD:
-                        n_fields++;
+                        s.n_fields++;
                         break;
 
                 case OBJECT_ENTRY:
-                        if (JOURNAL_HEADER_SEALED(f->header) && n_tags <= 0) {
+                        if (JOURNAL_HEADER_SEALED(f->header) && s.n_tags <= 0) {
                                 error(p, "First entry before first tag");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        r = write_uint64(entry_fd, p);
-                        if (r < 0)
-                                goto fail;
+                        if (entry_fd >= 0) {
+                                r = write_uint64(entry_fd, p);
+                                if (r < 0)
+                                        goto fail;
+                        }
 
-                        if (le64toh(o->entry.realtime) < last_tag_realtime) {
+                        if (le64toh(o->entry.realtime) < s.last_tag_realtime) {
                                 error(p, "Older entry after newer tag");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        if (!entry_seqnum_set &&
+                        if (!s.entry_seqnum_set &&
                             le64toh(o->entry.seqnum) != le64toh(f->header->head_entry_seqnum)) {
                                 error(p, "Head entry sequence number incorrect");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        if (entry_seqnum_set &&
-                            entry_seqnum >= le64toh(o->entry.seqnum)) {
+                        if (s.entry_seqnum_set &&
+                            s.entry_seqnum >= le64toh(o->entry.seqnum)) {
                                 error(p, "Entry sequence number out of synchronization");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        entry_seqnum = le64toh(o->entry.seqnum);
-                        entry_seqnum_set = true;
+                        s.entry_seqnum = le64toh(o->entry.seqnum);
+                        s.entry_seqnum_set = true;
 
-                        if (entry_monotonic_set &&
-                            sd_id128_equal(entry_boot_id, o->entry.boot_id) &&
-                            entry_monotonic > le64toh(o->entry.monotonic)) {
+                        if (s.entry_monotonic_set &&
+                            sd_id128_equal(s.entry_boot_id, o->entry.boot_id) &&
+                            s.entry_monotonic > le64toh(o->entry.monotonic)) {
                                 error(p, "Entry timestamp out of synchronization");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        entry_monotonic = le64toh(o->entry.monotonic);
-                        entry_boot_id = o->entry.boot_id;
-                        entry_monotonic_set = true;
+                        s.entry_monotonic = le64toh(o->entry.monotonic);
+                        s.entry_boot_id = o->entry.boot_id;
+                        s.entry_monotonic_set = true;
 
-                        if (!entry_realtime_set &&
+                        if (!s.entry_realtime_set &&
                             le64toh(o->entry.realtime) != le64toh(f->header->head_entry_realtime)) {
                                 error(p, "Head entry realtime timestamp incorrect");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        entry_realtime = le64toh(o->entry.realtime);
-                        entry_realtime_set = true;
+                        s.entry_realtime = le64toh(o->entry.realtime);
+                        s.entry_realtime_set = true;
+                        s.entry_offset = p;
 
-                        n_entries++;
+                        s.n_entries++;
                         break;
 
                 case OBJECT_DATA_HASH_TABLE:
-                        if (n_data_hash_tables > 1) {
+                        if (s.n_data_hash_tables > 1) {
                                 error(p, "More than one data hash table");
                                 r = -EBADMSG;
                                 goto fail;
@@ -1031,11 +1086,11 @@ int journal_file_verify(
                                 goto fail;
                         }
 
-                        n_data_hash_tables++;
+                        s.n_data_hash_tables++;
                         break;
 
                 case OBJECT_FIELD_HASH_TABLE:
-                        if (n_field_hash_tables > 1) {
+                        if (s.n_field_hash_tables > 1) {
                                 error(p, "More than one field hash table");
                                 r = -EBADMSG;
                                 goto fail;
@@ -1048,25 +1103,27 @@ int journal_file_verify(
                                 goto fail;
                         }
 
-                        n_field_hash_tables++;
+                        s.n_field_hash_tables++;
                         break;
 
                 case OBJECT_ENTRY_ARRAY:
-                        r = write_uint64(entry_array_fd, p);
-                        if (r < 0)
-                                goto fail;
+                        if (entry_array_fd >= 0) {
+                                r = write_uint64(entry_array_fd, p);
+                                if (r < 0)
+                                        goto fail;
+                        }
 
                         if (p == le64toh(f->header->entry_array_offset)) {
-                                if (found_main_entry_array) {
+                                if (s.found_main_entry_array) {
                                         error(p, "More than one main entry array");
                                         r = -EBADMSG;
                                         goto fail;
                                 }
 
-                                found_main_entry_array = true;
+                                s.found_main_entry_array = true;
                         }
 
-                        n_entry_arrays++;
+                        s.n_entry_arrays++;
                         break;
 
                 case OBJECT_TAG:
@@ -1076,13 +1133,13 @@ int journal_file_verify(
                                 goto fail;
                         }
 
-                        if (le64toh(o->tag.seqnum) != n_tags + 1) {
+                        if (le64toh(o->tag.seqnum) != s.n_tags + 1) {
                                 error(p, "Tag sequence number out of synchronization");
                                 r = -EBADMSG;
                                 goto fail;
                         }
 
-                        if (le64toh(o->tag.epoch) < last_epoch) {
+                        if (le64toh(o->tag.epoch) < s.last_epoch) {
                                 error(p, "Epoch sequence out of synchronization");
                                 r = -EBADMSG;
                                 goto fail;
@@ -1095,7 +1152,7 @@ int journal_file_verify(
                                 debug(p, "Checking tag %"PRIu64"...", le64toh(o->tag.seqnum));
 
                                 rt = f->fss_start_usec + le64toh(o->tag.epoch) * f->fss_interval_usec;
-                                if (entry_realtime_set && entry_realtime >= rt + f->fss_interval_usec) {
+                                if (s.entry_realtime_set && s.entry_realtime >= rt + f->fss_interval_usec) {
                                         error(p, "tag/entry realtime timestamp out of synchronization");
                                         r = -EBADMSG;
                                         goto fail;
@@ -1112,14 +1169,14 @@ int journal_file_verify(
                                 if (r < 0)
                                         goto fail;
 
-                                if (last_tag == 0) {
+                                if (s.last_tag == 0) {
                                         r = journal_file_hmac_put_header(f);
                                         if (r < 0)
                                                 goto fail;
 
                                         q = le64toh(f->header->header_size);
                                 } else
-                                        q = last_tag;
+                                        q = s.last_tag;
 
                                 while (q <= p) {
                                         r = journal_file_move_to_object(f, OBJECT_UNUSED, q, &o);
@@ -1145,16 +1202,32 @@ int journal_file_verify(
                                 }
 
                                 f->hmac_running = false;
-                                last_tag_realtime = rt;
-                                last_sealed_realtime = entry_realtime;
+                                s.last_tag_realtime = rt;
+                                s.last_sealed_realtime = s.entry_realtime;
                         }
 
-                        last_tag = p + ALIGN64(le64toh(o->object.size));
+                        s.last_tag = p + ALIGN64(le64toh(o->object.size));
 #endif
 
-                        last_epoch = le64toh(o->tag.epoch);
+                        s.last_epoch = le64toh(o->tag.epoch);
+
+                        s.n_tags++;
+
+                        /* In sealed files everything up to a verified tag can be skipped next time */
+                        if (ret_checkpoint && f->seal) {
+                                s.last_object_offset = p;
+                                s.last_object_size = le64toh(o->object.size);
+                                s.offset = p + ALIGN64(s.last_object_size);
+                                memcpy(s.tag, o->tag.tag, TAG_LENGTH);
+                                *ret_checkpoint = s;
+                        }
+                        break;
 
-                        n_tags++;
+                case OBJECT_SUMMARY:
+                        /* A summary that isn't referenced by the header is out of date, but not a problem */
+                        if (JOURNAL_HEADER_CONTAINS(f->header, summary_offset) &&
+                            p == le64toh(f->header->summary_offset))
+                                s.found_summary = true;
                         break;
 
                 default:
@@ -1163,6 +1236,13 @@ int journal_file_verify(
 
                 if (p == le64toh(f->header->tail_object_offset)) {
                         found_last = true;
+
+                        if (ret_checkpoint && !JOURNAL_HEADER_SEALED(f->header)) {
+                                s.last_object_offset = p;
+                                s.last_object_size = le64toh(o->object.size);
+                                s.offset = p + ALIGN64(s.last_object_size);
+                                *ret_checkpoint = s;
+                        }
                         break;
                 }
 
@@ -1175,68 +1255,76 @@ int journal_file_verify(
                 goto fail;
         }
 
-        if (n_objects != le64toh(f->header->n_objects)) {
+        if (s.n_objects != le64toh(f->header->n_objects)) {
                 error(offsetof(Header, n_objects), "Object number mismatch");
                 r = -EBADMSG;
                 goto fail;
         }
 
-        if (n_entries != le64toh(f->header->n_entries)) {
+        if (s.n_entries != le64toh(f->header->n_entries)) {
                 error(offsetof(Header, n_entries), "Entry number mismatch");
                 r = -EBADMSG;
                 goto fail;
         }
 
         if (JOURNAL_HEADER_CONTAINS(f->header, n_data) &&
-            n_data != le64toh(f->header->n_data)) {
+            s.n_data != le64toh(f->header->n_data)) {
                 error(offsetof(Header, n_data), "Data number mismatch");
                 r = -EBADMSG;
                 goto fail;
         }
 
         if (JOURNAL_HEADER_CONTAINS(f->header, n_fields) &&
-            n_fields != le64toh(f->header->n_fields)) {
+            s.n_fields != le64toh(f->header->n_fields)) {
                 error(offsetof(Header, n_fields), "Field number mismatch");
                 r = -EBADMSG;
                 goto fail;
         }
 
         if (JOURNAL_HEADER_CONTAINS(f->header, n_tags) &&
-            n_tags != le64toh(f->header->n_tags)) {
+            s.n_tags != le64toh(f->header->n_tags)) {
                 error(offsetof(Header, n_tags), "Tag number mismatch");
                 r = -EBADMSG;
                 goto fail;
         }
 
         if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays) &&
-            n_entry_arrays != le64toh(f->header->n_entry_arrays)) {
+            s.n_entry_arrays != le64toh(f->header->n_entry_arrays)) {
                 error(offsetof(Header, n_entry_arrays), "Entry array number mismatch");
                 r = -EBADMSG;
                 goto fail;
         }
 
-        if (!found_main_entry_array && le64toh(f->header->entry_array_offset) != 0) {
+        if (!s.found_main_entry_array && le64toh(f->header->entry_array_offset) != 0) {
                 error(0, "Missing entry array");
                 r = -EBADMSG;
                 goto fail;
         }
 
-        if (entry_seqnum_set &&
-            entry_seqnum != le64toh(f->header->tail_entry_seqnum)) {
+        if (!s.found_summary &&
+            JOURNAL_HEADER_CONTAINS(f->header, summary_offset) &&
+            le64toh(f->header->summary_offset) != 0) {
+                error(offsetof(Header, summary_offset), "Missing summary object");
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        if (s.entry_seqnum_set &&
+            s.entry_seqnum != le64toh(f->header->tail_entry_seqnum)) {
                 error(offsetof(Header, tail_entry_seqnum), "Invalid tail seqnum");
                 r = -EBADMSG;
                 goto fail;
         }
 
-        if (entry_monotonic_set &&
-            (sd_id128_equal(entry_boot_id, f->header->boot_id) &&
-             entry_monotonic != le64toh(f->header->tail_entry_monotonic))) {
+        if (s.entry_monotonic_set &&
+            (sd_id128_equal(s.entry_boot_id, f->header->boot_id) &&
+             s.entry_monotonic != le64toh(f->header->tail_entry_monotonic))) {
                 error(0, "Invalid tail monotonic timestamp");
                 r = -EBADMSG;
                 goto fail;
         }
 
-        if (entry_realtime_set && entry_realtime != le64toh(f->header->tail_entry_realtime)) {
+        if (s.entry_realtime_set && s.entry_realtime != le64toh(f->header->tail_entry_realtime)) {
                 error(0, "Invalid tail realtime timestamp");
                 r = -EBADMSG;
                 goto fail;
@@ -1250,30 +1338,35 @@ int journal_file_verify(
          * unreferenced objects. We only care that everything that is
          * referenced is consistent. */
 
-        r = verify_entry_array(f,
-                               cache_data_fd, n_data,
-                               cache_entry_fd, n_entries,
-                               cache_entry_array_fd, n_entry_arrays,
-                               &last_usec,
-                               show_progress);
-        if (r < 0)
-                goto fail;
+        if (!resume) {
+                r = verify_entry_array(f,
+                                       cache_data_fd, s.n_data,
+                                       cache_entry_fd, s.n_entries,
+                                       cache_entry_array_fd, s.n_entry_arrays,
+                                       &last_usec,
+                                       show_progress);
+                if (r < 0)
+                        goto fail;
 
-        r = verify_hash_table(f,
-                              cache_data_fd, n_data,
-                              cache_entry_fd, n_entries,
-                              cache_entry_array_fd, n_entry_arrays,
-                              &last_usec,
-                              show_progress);
-        if (r < 0)
-                goto fail;
+                r = verify_hash_table(f,
+                                      cache_data_fd, s.n_data,
+                                      cache_entry_fd, s.n_entries,
+                                      cache_entry_array_fd, s.n_entry_arrays,
+                                      &last_usec,
+                                      show_progress);
+                if (r < 0)
+                        goto fail;
+        }
 
         if (show_progress)
                 flush_progress();
 
-        mmap_cache_free_fd(f->mmap, cache_data_fd);
-        mmap_cache_free_fd(f->mmap, cache_entry_fd);
-        mmap_cache_free_fd(f->mmap, cache_entry_array_fd);
+        if (cache_data_fd)
+                mmap_cache_free_fd(f->mmap, cache_data_fd);
+        if (cache_entry_fd)
+                mmap_cache_free_fd(f->mmap, cache_entry_fd);
+        if (cache_entry_array_fd)
+                mmap_cache_free_fd(f->mmap, cache_entry_array_fd);
 
         safe_close(data_fd);
         safe_close(entry_fd);
@@ -1282,7 +1375,7 @@ int journal_file_verify(
         if (first_contained)
                 *first_contained = le64toh(f->header->head_entry_realtime);
         if (last_validated)
-                *last_validated = last_sealed_realtime;
+                *last_validated = s.last_sealed_realtime;
         if (last_contained)
                 *last_contained = le64toh(f->header->tail_entry_realtime);
 
@@ -1318,3 +1411,248 @@ fail:
 
         return r;
 }
+
+int journal_file_verify(
+                JournalFile *f,
+                const char *key,
+                usec_t *first_contained, usec_t *last_validated, usec_t *last_contained,
+                bool show_progress) {
+
+        return verify_journal_file(f, key, NULL, NULL, first_contained, last_validated, last_contained, show_progress);
+}
+
+static int checkpoint_hmac(const VerifyCheckpoint *c, const char *key, uint8_t ret[static TAG_LENGTH]) {
+#if HAVE_GCRYPT
+        _cleanup_(gcry_md_closep) gcry_md_hd_t md = NULL;
+        gcry_error_t e;
+
+        assert(c);
+        assert(key);
+
+        initialize_libgcrypt(true);
+
+        e = gcry_md_open(&md, GCRY_MD_SHA256, GCRY_MD_FLAG_HMAC);
+        if (e != 0)
+                return -EOPNOTSUPP;
+
+        e = gcry_md_setkey(md, key, strlen(key));
+        if (e != 0)
+                return -EIO;
+
+        gcry_md_write(md, c, offsetof(VerifyCheckpoint, hmac));
+        memcpy(ret, gcry_md_read(md, 0), TAG_LENGTH);
+
+        return 0;
+#else
+        return -EOPNOTSUPP;
+#endif
+}
+
+static int checkpoint_load(JournalFile *f, const char *fn, const char *key, VerifyCheckpoint *ret) {
+        _cleanup_close_ int fd = -1;
+        VerifyCheckpoint c;
+        struct stat st;
+        Object *o;
+        ssize_t n;
+        int r;
+
+        assert(f);
+        assert(fn);
+        assert(ret);
+
+        /* Everything before the checkpoint is skipped, hence only trust it if nobody but us could have
+         * put it there. */
+        fd = open(fn, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (!S_ISREG(st.st_mode) ||
+            st.st_uid != geteuid() ||
+            (st.st_mode & 0022) != 0)
+                return -EPERM;
+
+        n = loop_read(fd, &c, sizeof(c), true);
+        if (n < 0)
+                return (int) n;
+        if ((size_t) n != sizeof(c) || st.st_size != (off_t) sizeof(c))
+                return -EBADMSG;
+
+        if (memcmp(c.signature, CHECKPOINT_SIGNATURE, sizeof(c.signature)) != 0 ||
+            !sd_id128_equal(c.file_id, f->header->file_id))
+                return -EBADMSG;
+
+        if (JOURNAL_HEADER_SEALED(f->header)) {
+                uint8_t hmac[TAG_LENGTH];
+
+                /* Without the key there's nothing we could check the checkpoint against */
+                if (!key)
+                        return -ENOKEY;
+
+                r = checkpoint_hmac(&c, key, hmac);
+                if (r < 0)
+                        return r;
+
+                if (memcmp(hmac, c.hmac, TAG_LENGTH) != 0)
+                        return -ESTALE;
+        }
+
+        /* Make sure the file still looks like it did when the checkpoint was taken */
+        if (c.last_object_offset < le64toh(f->header->header_size) ||
+            c.last_object_offset > le64toh(f->header->tail_object_offset) ||
+            c.offset != c.last_object_offset + ALIGN64(c.last_object_size) ||
+            c.n_objects > le64toh(f->header->n_objects) ||
+            c.n_entries > le64toh(f->header->n_entries) ||
+            c.n_data > c.n_objects ||
+            c.n_fields > c.n_objects ||
+            c.n_entry_arrays > c.n_objects ||
+            c.n_tags > c.n_objects ||
+            c.n_entries + c.n_data + c.n_fields + c.n_entry_arrays + c.n_tags > c.n_objects)
+                return -ESTALE;
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_data) &&
+            c.n_data > le64toh(f->header->n_data))
+                return -ESTALE;
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_fields) &&
+            c.n_fields > le64toh(f->header->n_fields))
+                return -ESTALE;
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_tags) &&
+            c.n_tags > le64toh(f->header->n_tags))
+                return -ESTALE;
+        if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays) &&
+            c.n_entry_arrays > le64toh(f->header->n_entry_arrays))
+                return -ESTALE;
+
+        r = journal_file_move_to_object(f, OBJECT_UNUSED, c.last_object_offset, &o);
+        if (r < 0)
+                return r;
+
+        if (le64toh(o->object.size) != c.last_object_size)
+                return -ESTALE;
+
+        r = journal_file_object_verify(f, c.last_object_offset, o);
+        if (r < 0)
+                return -ESTALE;
+
+        if (JOURNAL_HEADER_SEALED(f->header) &&
+            (o->object.type != OBJECT_TAG ||
+             le64toh(o->tag.seqnum) != c.n_tags ||
+             memcmp(o->tag.tag, c.tag, TAG_LENGTH) != 0))
+                return -ESTALE;
+
+        /* The ordering checks of the following entries build on the last entry, hence it needs to be the
+         * one in the file */
+        if (c.entry_seqnum_set) {
+                if (c.entry_offset < le64toh(f->header->header_size) ||
+                    c.entry_offset > c.last_object_offset)
+                        return -ESTALE;
+
+                r = journal_file_move_to_object(f, OBJECT_ENTRY, c.entry_offset, &o);
+                if (r < 0)
+                        return -ESTALE;
+
+                if (le64toh(o->entry.seqnum) != c.entry_seqnum ||
+                    le64toh(o->entry.realtime) != c.entry_realtime ||
+                    le64toh(o->entry.monotonic) != c.entry_monotonic ||
+                    !sd_id128_equal(o->entry.boot_id, c.entry_boot_id))
+                        return -ESTALE;
+        }
+
+        *ret = c;
+        return 0;
+}
+
+static int checkpoint_save(JournalFile *f, const char *fn, const char *key, VerifyCheckpoint *c) {
+        _cleanup_fclose_ FILE *ff = NULL;
+        _cleanup_free_ char *p = NULL;
+        int r;
+
+        assert(f);
+        assert(fn);
+        assert(c);
+
+        if (JOURNAL_HEADER_SEALED(f->header)) {
+                assert(key);
+
+                r = checkpoint_hmac(c, key, c->hmac);
+                if (r < 0)
+                        return r;
+        } else
+                zero(c->hmac);
+
+        r = mkdir_parents(fn, 0700);
+        if (r < 0)
+                return r;
+
+        r = fopen_temporary(fn, &ff, &p);
+        if (r < 0)
+                return r;
+
+        if (fchmod(fileno(ff), 0600) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        fwrite(c, sizeof(*c), 1, ff);
+
+        r = fflush_and_check(ff);
+        if (r < 0)
+                goto fail;
+
+        if (rename(p, fn) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(p);
+        return r;
+}
+
+int journal_file_verify_incremental(
+                JournalFile *f,
+                const char *key,
+                const char *checkpoint_dir,
+                usec_t *first_contained, usec_t *last_validated, usec_t *last_contained,
+                bool show_progress) {
+
+        VerifyCheckpoint resume, checkpoint = {};
+        char fn_id[SD_ID128_STRING_MAX];
+        const char *fn;
+        bool resumed;
+        int r;
+
+        assert(f);
+        assert(checkpoint_dir);
+
+        fn = strjoina(checkpoint_dir, "/", sd_id128_to_string(f->header->file_id, fn_id));
+
+        r = checkpoint_load(f, fn, key, &resume);
+        if (r < 0 && r != -ENOENT)
+                log_debug_errno(r, "Ignoring verification checkpoint %s for %s: %m", fn, f->path);
+        resumed = r >= 0;
+
+        if (resumed)
+                log_debug("Verifying %s from offset %"PRIu64" on.", f->path, resume.offset);
+
+        r = verify_journal_file(f, key, resumed ? &resume : NULL, &checkpoint,
+                                first_contained, last_validated, last_contained, show_progress);
+        if (r < 0)
+                return r;
+
+        if (checkpoint.offset > 0) {
+                memcpy(checkpoint.signature, CHECKPOINT_SIGNATURE, sizeof(checkpoint.signature));
+                checkpoint.file_id = f->header->file_id;
+                zero(checkpoint.reserved);
+
+                r = checkpoint_save(f, fn, key, &checkpoint);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to save verification checkpoint %s for %s, ignoring: %m", fn, f->path);
+        }
+
+        return resumed;
+}
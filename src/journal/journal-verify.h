@@ -3,4 +3,7 @@
 
 #include "journal-file.h"
 
+#define JOURNAL_VERIFY_CHECKPOINT_DIR "/var/lib/systemd/journal-verify"
+
 int journal_file_verify(JournalFile *f, const char *key, usec_t *first_contained, usec_t *last_validated, usec_t *last_contained, bool show_progress);
+int journal_file_verify_incremental(JournalFile *f, const char *key, const char *checkpoint_dir, usec_t *first_contained, usec_t *last_validated, usec_t *last_contained, bool show_progress);
@@ -58,6 +58,7 @@
 #include "rlimit-util.h"
 #include "set.h"
 #include "sigbus.h"
+#include "socket-util.h"
 #include "string-table.h"
 #include "strv.h"
 #include "syslog-util.h"
@@ -121,11 +122,13 @@ static bool arg_no_hostname = false;
 static const char *arg_cursor = NULL;
 static const char *arg_after_cursor = NULL;
 static bool arg_show_cursor = false;
+static bool arg_stats = false;
 static const char *arg_directory = NULL;
 static char **arg_file = NULL;
 static bool arg_file_stdin = false;
 static int arg_priorities = 0xFF;
 static char *arg_verify_key = NULL;
+static bool arg_verify_incremental = false;
 #if HAVE_GCRYPT
 static usec_t arg_interval = DEFAULT_FSS_INTERVAL_USEC;
 static bool arg_force = false;
@@ -144,6 +147,7 @@ static const char *arg_machine = NULL;
 static uint64_t arg_vacuum_size = 0;
 static uint64_t arg_vacuum_n_files = 0;
 static usec_t arg_vacuum_time = 0;
+static unsigned arg_vacuum_threads = 1;
 static char **arg_output_fields = NULL;
 
 #if HAVE_PCRE2
@@ -315,6 +319,7 @@ static int help(void) {
                "  -c --cursor=CURSOR         Show entries starting at the specified cursor\n"
                "     --after-cursor=CURSOR   Show entries after the specified cursor\n"
                "     --show-cursor           Print the cursor after all the entries\n"
+               "     --stats                 Print journal access statistics on exit\n"
                "  -b --boot[=ID]             Show current boot or the specified boot\n"
                "     --list-boots            Show terse information about recorded boots\n"
                "  -k --dmesg                 Show kernel message log from the current boot\n"
@@ -358,7 +363,9 @@ static int help(void) {
                "     --vacuum-size=BYTES     Reduce disk usage below specified size\n"
                "     --vacuum-files=INT      Leave only the specified number of journal files\n"
                "     --vacuum-time=TIME      Remove journal files older than specified time\n"
+               "     --vacuum-threads=INT    Number of journal files to remove in parallel\n"
                "     --verify                Verify journal file consistency\n"
+               "     --verify-incremental    Verify only objects appended since the last check\n"
                "     --sync                  Synchronize unwritten journal messages to disk\n"
                "     --flush                 Flush all journal data from /run into /var\n"
                "     --rotate                Request immediate rotation of the journal files\n"
@@ -394,6 +401,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_INTERVAL,
                 ARG_VERIFY,
                 ARG_VERIFY_KEY,
+                ARG_VERIFY_INCREMENTAL,
                 ARG_DISK_USAGE,
                 ARG_AFTER_CURSOR,
                 ARG_SHOW_CURSOR,
@@ -410,8 +418,10 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_VACUUM_SIZE,
                 ARG_VACUUM_FILES,
                 ARG_VACUUM_TIME,
+                ARG_VACUUM_THREADS,
                 ARG_NO_HOSTNAME,
                 ARG_OUTPUT_FIELDS,
+                ARG_STATS,
         };
 
         static const struct option options[] = {
@@ -448,6 +458,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "interval",       required_argument, NULL, ARG_INTERVAL       },
                 { "verify",         no_argument,       NULL, ARG_VERIFY         },
                 { "verify-key",     required_argument, NULL, ARG_VERIFY_KEY     },
+                { "verify-incremental", no_argument,   NULL, ARG_VERIFY_INCREMENTAL },
                 { "disk-usage",     no_argument,       NULL, ARG_DISK_USAGE     },
                 { "cursor",         required_argument, NULL, 'c'                },
                 { "after-cursor",   required_argument, NULL, ARG_AFTER_CURSOR   },
@@ -471,8 +482,10 @@ static int parse_argv(int argc, char *argv[]) {
                 { "vacuum-size",    required_argument, NULL, ARG_VACUUM_SIZE    },
                 { "vacuum-files",   required_argument, NULL, ARG_VACUUM_FILES   },
                 { "vacuum-time",    required_argument, NULL, ARG_VACUUM_TIME    },
+                { "vacuum-threads", required_argument, NULL, ARG_VACUUM_THREADS },
                 { "no-hostname",    no_argument,       NULL, ARG_NO_HOSTNAME    },
                 { "output-fields",  required_argument, NULL, ARG_OUTPUT_FIELDS  },
+                { "stats",          no_argument,       NULL, ARG_STATS          },
                 {}
         };
 
@@ -669,6 +682,10 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_show_cursor = true;
                         break;
 
+                case ARG_STATS:
+                        arg_stats = true;
+                        break;
+
                 case ARG_HEADER:
                         arg_action = ACTION_PRINT_HEADER;
                         break;
@@ -677,6 +694,11 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = ACTION_VERIFY;
                         break;
 
+                case ARG_VERIFY_INCREMENTAL:
+                        arg_action = ACTION_VERIFY;
+                        arg_verify_incremental = true;
+                        break;
+
                 case ARG_DISK_USAGE:
                         arg_action = ACTION_DISK_USAGE;
                         break;
@@ -711,6 +733,15 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = arg_action == ACTION_ROTATE ? ACTION_ROTATE_AND_VACUUM : ACTION_VACUUM;
                         break;
 
+                case ARG_VACUUM_THREADS:
+                        r = safe_atou(optarg, &arg_vacuum_threads);
+                        if (r < 0 || arg_vacuum_threads <= 0) {
+                                log_error("Failed to parse vacuum threads: %s", optarg);
+                                return r < 0 ? r : -EINVAL;
+                        }
+
+                        break;
+
 #if HAVE_GCRYPT
                 case ARG_FORCE:
                         arg_force = true;
@@ -1854,7 +1885,11 @@ static int verify(sd_journal *j) {
                         log_notice("Journal file %s has sealing enabled but verification key has not been passed using --verify-key=.", f->path);
 #endif
 
-                k = journal_file_verify(f, arg_verify_key, &first, &validated, &last, true);
+                if (arg_verify_incremental)
+                        k = journal_file_verify_incremental(f, arg_verify_key, JOURNAL_VERIFY_CHECKPOINT_DIR,
+                                                            &first, &validated, &last, true);
+                else
+                        k = journal_file_verify(f, arg_verify_key, &first, &validated, &last, true);
                 if (k == -EINVAL) {
                         /* If the key was invalid give up right-away. */
                         return k;
@@ -1863,7 +1898,7 @@ static int verify(sd_journal *j) {
                         r = k;
                 } else {
                         char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX], c[FORMAT_TIMESPAN_MAX];
-                        log_info("PASS: %s", f->path);
+                        log_info("PASS: %s%s", f->path, k > 0 ? " (since last check)" : "");
 
                         if (arg_verify_key && JOURNAL_HEADER_SEALED(f->header)) {
                                 if (validated > 0) {
@@ -2036,6 +2071,30 @@ static int sync_journal(void) {
         return send_signal_and_wait(SIGRTMIN+1, "/run/systemd/journal/synced");
 }
 
+static void show_stats(sd_journal *j) {
+        char sbytes[FORMAT_BYTES_MAX], stime[FORMAT_TIMESPAN_MAX];
+        sd_journal_stats s;
+        int r;
+
+        assert(j);
+
+        r = sd_journal_get_stats(j, &s, sizeof(s));
+        if (r < 0) {
+                log_warning_errno(r, "Failed to get journal statistics, ignoring: %m");
+                return;
+        }
+
+        /* Goes to stderr, so that it doesn't get mixed up with the entries in machine readable output modes */
+        fprintf(stderr,
+                "-- mmap cache: %" PRIu64 " hit, %" PRIu64 " missed, %" PRIu64 " windows, %s mapped\n"
+                "-- SIGBUS: %" PRIu64 "\n"
+                "-- Decompression: %s\n",
+                s.mmap_hit, s.mmap_missed, s.mmap_windows,
+                format_bytes(sbytes, sizeof(sbytes), s.mmap_bytes),
+                s.sigbus,
+                format_timespan(stime, sizeof(stime), s.decompress_usec, 1));
+}
+
 static int wait_for_change(sd_journal *j, int poll_fd) {
         struct pollfd pollfds[] = {
                 { .fd = poll_fd, .events = POLLIN },
@@ -2075,11 +2134,179 @@ static int wait_for_change(sd_journal *j, int poll_fd) {
         return 0;
 }
 
+static bool follow_via_journald_supported(char **args) {
+        bool have_term = false;
+        char **i;
+
+        /* journald can stream new entries to us, after applying matches of the FIELD=VALUE kind itself. It
+         * knows only the entries of the local journal, and sends them in export format, which we simply pass
+         * on. For anything else, watch the journal files. */
+
+        if (arg_output != OUTPUT_EXPORT)
+                return false;
+
+        if (arg_directory || arg_file || arg_root || arg_machine || arg_merge || arg_journal_type != 0)
+                return false;
+
+        if (arg_until_set || arg_dmesg || arg_priorities != 0xFF || arg_output_fields)
+                return false;
+
+#if HAVE_PCRE2
+        if (arg_pattern)
+                return false;
+#endif
+
+        if (arg_boot && (arg_boot_offset != 0 || !sd_id128_is_null(arg_boot_id)))
+                return false;
+
+        if (arg_syslog_identifier || arg_system_units || arg_user_units)
+                return false;
+
+        /* journald only sends the entries of their own user to unprivileged clients, as it can't evaluate the
+         * ACLs of the journal files. Those who are granted access to more entries that way need to read the
+         * files themselves. */
+        if (geteuid() != 0 && in_group("systemd-journal") <= 0)
+                return false;
+
+        /* Leave anything add_matches() would refuse to it, so that it is reported as usual */
+        STRV_FOREACH(i, args) {
+                if (streq(*i, "+")) {
+                        if (!have_term)
+                                return false;
+                        have_term = false;
+                } else if (path_is_absolute(*i) || !strchr(*i, '=') || strchr(*i, '\n'))
+                        return false;
+                else
+                        have_term = true;
+        }
+
+        return strv_isempty(args) || have_term;
+}
+
+static int follow_via_journald_subscribe(char **args) {
+        static const union sockaddr_union sa = {
+                .un.sun_family = AF_UNIX,
+                .un.sun_path = "/run/systemd/journal/follow",
+        };
+        _cleanup_free_ char *request = NULL;
+        _cleanup_close_ int fd = -1;
+        char reply[3], **i;
+        int r;
+
+        /* Send the matches one per line, terminated by an empty line. follow_via_journald_supported() made
+         * sure they are all FIELD=VALUE matches, with "+" only between them, which journald applies the same
+         * way add_matches() does. journald confirms with "OK" once it is subscribed. */
+
+        STRV_FOREACH(i, args)
+                if (!strextend(&request, *i, "\n", NULL))
+                        return log_oom();
+
+        if (!strextend(&request, "\n", NULL))
+                return log_oom();
+
+        fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        if (fd < 0)
+                return -errno;
+
+        if (connect(fd, &sa.sa, SOCKADDR_UN_LEN(sa.un)) < 0)
+                return -errno;
+
+        r = loop_write(fd, request, strlen(request), false);
+        if (r < 0)
+                return r;
+
+        r = fd_wait_for_event(fd, POLLIN, 5 * USEC_PER_SEC);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -ETIMEDOUT;
+
+        r = loop_read_exact(fd, reply, sizeof(reply), false);
+        if (r < 0)
+                return r;
+
+        if (memcmp(reply, "OK\n", sizeof(reply)) != 0)
+                return -EPROTO;
+
+        return TAKE_FD(fd);
+}
+
+static int follow_via_journald(int fd, const char *last_cursor) {
+        struct pollfd pollfds[] = {
+                { .fd = fd, .events = POLLIN },
+                { .fd = STDOUT_FILENO },
+        };
+        sd_id128_t last_seqnum_id = SD_ID128_NULL;
+        _cleanup_free_ char *buffer = NULL;
+        size_t allocated = 0, length = 0;
+        uint64_t last_seqnum = 0;
+
+        assert(fd >= 0);
+
+        /* We subscribed before reading the journal files, hence the first entries we get might have been shown
+         * already. */
+        if (last_cursor && journal_cursor_get_seqnum(last_cursor, strlen(last_cursor), &last_seqnum_id, &last_seqnum) < 0)
+                last_seqnum_id = SD_ID128_NULL;
+
+        for (;;) {
+                ssize_t l;
+                size_t k;
+
+                while ((k = journal_export_entry_size(buffer, length)) > 0) {
+                        const char *cursor;
+                        sd_id128_t seqnum_id;
+                        uint64_t seqnum;
+
+                        cursor = memory_startswith(buffer, k, "__CURSOR=");
+                        if (!cursor ||
+                            sd_id128_is_null(last_seqnum_id) ||
+                            journal_cursor_get_seqnum(cursor, strcspn(cursor, "\n"), &seqnum_id, &seqnum) < 0 ||
+                            !sd_id128_equal(seqnum_id, last_seqnum_id) ||
+                            seqnum > last_seqnum)
+                                fwrite(buffer, 1, k, stdout);
+
+                        memmove(buffer, buffer + k, length - k);
+                        length -= k;
+                }
+
+                fflush(stdout);
+
+                if (ppoll(pollfds, ELEMENTSOF(pollfds), NULL, NULL) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return log_error_errno(errno, "Couldn't wait for journal entries: %m");
+                }
+
+                if (pollfds[1].revents & (POLLHUP|POLLERR)) /* STDOUT has been closed? */
+                        return log_debug_errno(SYNTHETIC_ERRNO(ECANCELED),
+                                               "Standard output has been closed.");
+
+                if (!GREEDY_REALLOC(buffer, allocated, length + 64 * 1024))
+                        return log_oom();
+
+                l = read(fd, buffer + length, allocated - length);
+                if (l < 0) {
+                        if (IN_SET(errno, EAGAIN, EINTR))
+                                continue;
+
+                        return log_error_errno(errno, "Failed to read journal entries from journald: %m");
+                }
+                if (l == 0)
+                        return log_error_errno(SYNTHETIC_ERRNO(ECONNRESET),
+                                               "journald closed the connection, not following anymore.");
+
+                length += l;
+        }
+}
+
 int main(int argc, char *argv[]) {
         bool previous_boot_id_valid = false, first_line = true, ellipsized = false, need_seek = false;
+        _cleanup_(journal_output_pipeline_freep) JournalOutputPipeline *pipeline = NULL;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_close_ int follow_fd = -1;
         sd_id128_t previous_boot_id;
-        int n_shown = 0, r, poll_fd = -1;
+        int n_shown = 0, r, poll_fd = -1, flags;
 
         setlocale(LC_ALL, "");
         log_parse_environment();
@@ -2286,12 +2513,16 @@ int main(int argc, char *argv[]) {
                 Iterator i;
 
                 HASHMAP_FOREACH(d, j->directories_by_path, i) {
+                        _cleanup_(journal_directory_freep) JournalDirectory *index = NULL;
                         int q;
 
                         if (d->is_root)
                                 continue;
 
-                        q = journal_directory_vacuum(d->path, arg_vacuum_size, arg_vacuum_n_files, arg_vacuum_time, NULL, !arg_quiet);
+                        q = journal_directory_new(d->path, &index);
+                        if (q >= 0)
+                                q = journal_directory_vacuum_index(index, arg_vacuum_size, arg_vacuum_n_files, arg_vacuum_time, NULL,
+                                                                   arg_vacuum_threads, !arg_quiet);
                         if (q < 0) {
                                 log_error_errno(q, "Failed to vacuum %s: %m", d->path);
                                 r = q;
@@ -2405,8 +2636,15 @@ int main(int argc, char *argv[]) {
                 goto finish;
         }
 
+        /* Subscribing now means we don't miss anything that is logged while we show what is there already */
+        if (arg_follow && follow_via_journald_supported(argv + optind)) {
+                follow_fd = follow_via_journald_subscribe(argv + optind);
+                if (follow_fd < 0)
+                        log_debug_errno(follow_fd, "Failed to subscribe to new entries at journald, watching the journal files instead: %m");
+        }
+
         /* Opening the fd now means the first sd_journal_wait() will actually wait */
-        if (arg_follow) {
+        if (arg_follow && follow_fd < 0) {
                 poll_fd = sd_journal_get_fd(j);
                 if (poll_fd == -EMFILE) {
                         log_warning_errno(poll_fd, "Insufficent watch descriptors available. Reverting to -n.");
@@ -2515,9 +2753,24 @@ int main(int argc, char *argv[]) {
                 }
         }
 
+        flags =
+                arg_all * OUTPUT_SHOW_ALL |
+                arg_full * OUTPUT_FULL_WIDTH |
+                colors_enabled() * OUTPUT_COLOR |
+                arg_catalog * OUTPUT_CATALOG |
+                arg_utc * OUTPUT_UTC |
+                arg_no_hostname * OUTPUT_NO_HOSTNAME;
+
+        /* When dumping a lot of entries, format them in parallel. Not when following though, as entries are then
+         * held back until a batch is full. */
+        if (!arg_follow && journal_output_pipeline_supported(arg_output, flags)) {
+                r = journal_output_pipeline_new(&pipeline, stdout, arg_output, 0, flags, arg_output_fields);
+                if (r < 0)
+                        goto finish;
+        }
+
         for (;;) {
                 while (arg_lines < 0 || n_shown < arg_lines || (arg_follow && !first_line)) {
-                        int flags;
                         size_t highlight[2] = {};
 
                         if (need_seek) {
@@ -2563,9 +2816,16 @@ int main(int argc, char *argv[]) {
                                 r = sd_journal_get_monotonic_usec(j, NULL, &boot_id);
                                 if (r >= 0) {
                                         if (previous_boot_id_valid &&
-                                            !sd_id128_equal(boot_id, previous_boot_id))
+                                            !sd_id128_equal(boot_id, previous_boot_id)) {
+                                                if (pipeline) {
+                                                        r = journal_output_pipeline_flush(pipeline, &ellipsized);
+                                                        if (r < 0)
+                                                                goto finish;
+                                                }
+
                                                 printf("%s-- Reboot --%s\n",
                                                        ansi_highlight(), ansi_normal());
+                                        }
 
                                         previous_boot_id = boot_id;
                                         previous_boot_id_valid = true;
@@ -2624,16 +2884,11 @@ int main(int argc, char *argv[]) {
                         }
 #endif
 
-                        flags =
-                                arg_all * OUTPUT_SHOW_ALL |
-                                arg_full * OUTPUT_FULL_WIDTH |
-                                colors_enabled() * OUTPUT_COLOR |
-                                arg_catalog * OUTPUT_CATALOG |
-                                arg_utc * OUTPUT_UTC |
-                                arg_no_hostname * OUTPUT_NO_HOSTNAME;
-
-                        r = show_journal_entry(stdout, j, arg_output, 0, flags,
-                                               arg_output_fields, highlight, &ellipsized);
+                        if (pipeline)
+                                r = journal_output_pipeline_add(pipeline, j, highlight);
+                        else
+                                r = show_journal_entry(stdout, j, arg_output, 0, flags,
+                                                       arg_output_fields, highlight, &ellipsized);
                         need_seek = true;
                         if (r == -EADDRNOTAVAIL)
                                 break;
@@ -2658,6 +2913,12 @@ int main(int argc, char *argv[]) {
                 }
 
                 if (!arg_follow) {
+                        if (pipeline) {
+                                r = journal_output_pipeline_flush(pipeline, &ellipsized);
+                                if (r < 0)
+                                        goto finish;
+                        }
+
                         if (n_shown == 0 && !arg_quiet)
                                 printf("-- No entries --\n");
 
@@ -2676,6 +2937,23 @@ int main(int argc, char *argv[]) {
 
                 fflush(stdout);
 
+                if (follow_fd >= 0) {
+                        _cleanup_free_ char *cursor = NULL;
+
+                        r = sd_journal_get_cursor(j, &cursor);
+                        if (r < 0 && r != -EADDRNOTAVAIL) {
+                                log_error_errno(r, "Failed to get cursor: %m");
+                                goto finish;
+                        }
+
+                        /* From now on journald passes us the new entries, we don't need the journal files anymore */
+                        sd_journal_close(j);
+                        j = NULL;
+
+                        r = follow_via_journald(follow_fd, cursor);
+                        goto finish;
+                }
+
                 r = wait_for_change(j, poll_fd);
                 if (r < 0)
                         goto finish;
@@ -2684,9 +2962,21 @@ int main(int argc, char *argv[]) {
         }
 
 finish:
+        if (pipeline) {
+                int k;
+
+                /* Entries might be pending if we stopped early */
+                k = journal_output_pipeline_flush(pipeline, &ellipsized);
+                if (k < 0 && r >= 0)
+                        r = k;
+        }
+
         fflush(stdout);
         pager_close();
 
+        if (arg_stats && j)
+                show_stats(j);
+
         strv_free(arg_file);
 
         strv_free(arg_syslog_identifier);
@@ -16,6 +16,7 @@
 #include "parse-util.h"
 #include "path-util.h"
 #include "process-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "syslog-util.h"
 #include "unaligned.h"
@@ -117,6 +118,18 @@ static int client_context_new(Server *s, pid_t pid, ClientContext **ret) {
         return 0;
 }
 
+static void client_context_flush_trusted_fields(ClientContext *c) {
+        assert(c);
+
+        c->trusted_fields_iovec = mfree(c->trusted_fields_iovec);
+        c->trusted_fields_n_iovec = 0;
+        c->trusted_fields_data = mfree(c->trusted_fields_data);
+
+        c->object_fields_iovec = mfree(c->object_fields_iovec);
+        c->object_fields_n_iovec = 0;
+        c->object_fields_data = mfree(c->object_fields_data);
+}
+
 static void client_context_reset(Server *s, ClientContext *c) {
         assert(s);
         assert(c);
@@ -156,6 +169,8 @@ static void client_context_reset(Server *s, ClientContext *c) {
 
         c->log_rate_limit_interval = s->rate_limit_interval;
         c->log_rate_limit_burst = s->rate_limit_burst;
+
+        client_context_flush_trusted_fields(c);
 }
 
 static ClientContext* client_context_free(Server *s, ClientContext *c) {
@@ -498,6 +513,9 @@ static void client_context_really_refresh(
 
         c->timestamp = timestamp;
 
+        /* Render the fields again with the new data on next use */
+        client_context_flush_trusted_fields(c);
+
         if (c->in_lru) {
                 assert(c->n_ref == 0);
                 assert_se(prioq_reshuffle(s->client_contexts_lru, c, &c->lru_index) >= 0);
@@ -673,6 +691,34 @@ int client_context_acquire(
         return client_context_get_internal(s, pid, ucred, label, label_len, unit_id, true, ret);
 };
 
+ClientContext *client_context_peek(Server *s, const struct ucred *ucred) {
+        ClientContext *c;
+
+        assert(s);
+
+        /* Returns the cached context for the sender of a message, without refreshing or creating it. Only
+         * returns data we'd use without refreshing anyway, hence is cheap enough to be called before doing
+         * any real work for a message. */
+
+        if (!ucred || !pid_is_valid(ucred->pid))
+                return NULL;
+
+        c = hashmap_get(s->client_contexts, PID_TO_PTR(ucred->pid));
+        if (!c || c->timestamp == USEC_INFINITY)
+                return NULL;
+
+        if (c->n_ref == 0 && c->timestamp + MAX_USEC < now(CLOCK_MONOTONIC))
+                return NULL;
+
+        if (uid_is_valid(ucred->uid) && c->uid != ucred->uid)
+                return NULL;
+
+        if (gid_is_valid(ucred->gid) && c->gid != ucred->gid)
+                return NULL;
+
+        return c;
+}
+
 ClientContext *client_context_release(Server *s, ClientContext *c) {
         assert(s);
 
@@ -697,6 +743,163 @@ ClientContext *client_context_release(Server *s, ClientContext *c) {
         return NULL;
 }
 
+typedef struct FieldsBuilder {
+        const char *prefix;
+        char *data;
+        size_t size, allocated;
+        size_t offset[N_IOVEC_OBJECT_FIELDS];
+        size_t length[N_IOVEC_OBJECT_FIELDS];
+        size_t n;
+        int error;
+} FieldsBuilder;
+
+static void fields_builder_add(FieldsBuilder *b, const char *field, const void *value, size_t value_size) {
+        size_t l;
+        char *p;
+
+        assert(b);
+        assert(field);
+
+        if (b->error < 0)
+                return;
+
+        assert(b->n < ELEMENTSOF(b->offset));
+
+        l = strlen(b->prefix) + strlen(field) + 1 + value_size;
+        if (!GREEDY_REALLOC(b->data, b->allocated, b->size + l)) {
+                b->error = -ENOMEM;
+                return;
+        }
+
+        p = stpcpy(stpcpy(b->data + b->size, b->prefix), field);
+        *(p++) = '=';
+        memcpy(p, value, value_size);
+
+        b->offset[b->n] = b->size;
+        b->length[b->n] = l;
+        b->n++;
+        b->size += l;
+}
+
+static void fields_builder_add_string(FieldsBuilder *b, const char *field, const char *value) {
+        if (!isempty(value))
+                fields_builder_add(b, field, value, strlen(value));
+}
+
+static void fields_builder_add_unsigned(FieldsBuilder *b, const char *field, uint64_t value) {
+        char t[DECIMAL_STR_MAX(uint64_t)];
+
+        xsprintf(t, "%" PRIu64, value);
+        fields_builder_add(b, field, t, strlen(t));
+}
+
+static int client_context_render_fields(
+                const ClientContext *c,
+                const char *prefix,
+                struct iovec **ret_iovec,
+                size_t *ret_n_iovec,
+                char **ret_data) {
+
+        FieldsBuilder b = {
+                .prefix = prefix,
+        };
+        struct iovec *iovec;
+        size_t i;
+
+        assert(c);
+        assert(prefix);
+
+        if (pid_is_valid(c->pid))
+                fields_builder_add_unsigned(&b, "PID", c->pid);
+        if (uid_is_valid(c->uid))
+                fields_builder_add_unsigned(&b, "UID", c->uid);
+        if (gid_is_valid(c->gid))
+                fields_builder_add_unsigned(&b, "GID", c->gid);
+
+        fields_builder_add_string(&b, "COMM", c->comm);
+        fields_builder_add_string(&b, "EXE", c->exe);
+        fields_builder_add_string(&b, "CMDLINE", c->cmdline);
+        fields_builder_add_string(&b, "CAP_EFFECTIVE", c->capeff);
+
+        if (c->label_size > 0)
+                fields_builder_add(&b, "SELINUX_CONTEXT", c->label, c->label_size);
+        if (audit_session_is_valid(c->auditid))
+                fields_builder_add_unsigned(&b, "AUDIT_SESSION", c->auditid);
+        if (uid_is_valid(c->loginuid))
+                fields_builder_add_unsigned(&b, "AUDIT_LOGINUID", c->loginuid);
+
+        fields_builder_add_string(&b, "SYSTEMD_CGROUP", c->cgroup);
+        fields_builder_add_string(&b, "SYSTEMD_SESSION", c->session);
+        if (uid_is_valid(c->owner_uid))
+                fields_builder_add_unsigned(&b, "SYSTEMD_OWNER_UID", c->owner_uid);
+        fields_builder_add_string(&b, "SYSTEMD_UNIT", c->unit);
+        fields_builder_add_string(&b, "SYSTEMD_USER_UNIT", c->user_unit);
+        fields_builder_add_string(&b, "SYSTEMD_SLICE", c->slice);
+        fields_builder_add_string(&b, "SYSTEMD_USER_SLICE", c->user_slice);
+
+        if (!sd_id128_is_null(c->invocation_id)) {
+                char t[SD_ID128_STRING_MAX];
+
+                fields_builder_add(&b, "SYSTEMD_INVOCATION_ID", sd_id128_to_string(c->invocation_id, t), SD_ID128_STRING_MAX - 1);
+        }
+
+        if (b.error < 0) {
+                free(b.data);
+                return b.error;
+        }
+
+        iovec = new(struct iovec, MAX(b.n, 1U));
+        if (!iovec) {
+                free(b.data);
+                return -ENOMEM;
+        }
+
+        for (i = 0; i < b.n; i++)
+                iovec[i] = IOVEC_MAKE(b.data + b.offset[i], b.length[i]);
+
+        *ret_iovec = iovec;
+        *ret_n_iovec = b.n;
+        *ret_data = b.data;
+
+        return 0;
+}
+
+int client_context_get_trusted_fields(ClientContext *c, bool object, const struct iovec **ret_iovec, size_t *ret_n_iovec) {
+        struct iovec **iovec;
+        size_t *n_iovec;
+        char **data;
+        int r;
+
+        assert(c);
+        assert(ret_iovec);
+        assert(ret_n_iovec);
+
+        /* Returns the trusted fields of the context, as iovecs ready to be added to a log message. If object is
+         * true they are named OBJECT_PID=, OBJECT_UID=, … for use in messages about this process, otherwise
+         * _PID=, _UID=, …. The iovecs remain valid until the context is refreshed or released. */
+
+        if (object) {
+                iovec = &c->object_fields_iovec;
+                n_iovec = &c->object_fields_n_iovec;
+                data = &c->object_fields_data;
+        } else {
+                iovec = &c->trusted_fields_iovec;
+                n_iovec = &c->trusted_fields_n_iovec;
+                data = &c->trusted_fields_data;
+        }
+
+        if (!*iovec) {
+                r = client_context_render_fields(c, object ? "OBJECT_" : "_", iovec, n_iovec, data);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret_iovec = *iovec;
+        *ret_n_iovec = *n_iovec;
+
+        return 0;
+}
+
 void client_context_acquire_default(Server *s) {
         int r;
 
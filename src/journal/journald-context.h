@@ -52,6 +52,16 @@ struct ClientContext {
 
         usec_t log_rate_limit_interval;
         unsigned log_rate_limit_burst;
+
+        /* The trusted fields (_PID=, _UID=, …), and the same fields for use as OBJECT_PID=, …, rendered on first use
+         * and reused for each message until the context is refreshed */
+        struct iovec *trusted_fields_iovec;
+        size_t trusted_fields_n_iovec;
+        char *trusted_fields_data;
+
+        struct iovec *object_fields_iovec;
+        size_t object_fields_n_iovec;
+        char *object_fields_data;
 };
 
 int client_context_get(
@@ -80,6 +90,9 @@ void client_context_maybe_refresh(
                 const char *unit_id,
                 usec_t tstamp);
 
+ClientContext *client_context_peek(Server *s, const struct ucred *ucred);
+int client_context_get_trusted_fields(ClientContext *c, bool object, const struct iovec **ret_iovec, size_t *ret_n_iovec);
+
 void client_context_acquire_default(Server *s);
 void client_context_flush_all(Server *s);
 
@@ -96,3 +109,8 @@ static inline bool client_context_test_priority(const ClientContext *c, int prio
 
         return LOG_PRI(priority) <= c->log_level_max;
 }
+
+static inline const char *client_context_rate_limit_id(const ClientContext *c) {
+        /* Rate limiting is applied per cgroup, or per unit if we don't know the cgroup */
+        return c ? c->cgroup ?: c->unit : NULL;
+}
@@ -0,0 +1,632 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "journal-util.h"
+#include "journald-follow.h"
+#include "journald-server.h"
+#include "socket-util.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "utf8.h"
+
+/* Maximum number of clients following the journal through the socket at the same time. Root may always connect. */
+#define FOLLOWERS_MAX 1024
+
+/* Maximum number of such clients per user */
+#define FOLLOWERS_PER_UID_MAX 16
+
+/* Maximum size of the list of matches a client may send */
+#define FOLLOW_REQUEST_MAX (64U*1024U)
+
+/* A client that doesn't keep up with the entries is disconnected once this much is queued for it, or when this
+ * much is queued for all clients together */
+#define FOLLOW_QUEUE_MAX (8U*1024U*1024U)
+#define FOLLOW_QUEUE_TOTAL_MAX (64U*1024U*1024U)
+
+static size_t follower_queued(Follower *f) {
+        assert(f);
+
+        return f->state == FOLLOWER_RUNNING ? f->length - f->offset : 0;
+}
+
+void follower_free(Follower *f) {
+        if (!f)
+                return;
+
+        if (f->server) {
+                assert(f->server->n_followers > 0);
+                f->server->n_followers--;
+                LIST_REMOVE(follower, f->server->followers, f);
+
+                assert(f->server->follow_queued >= follower_queued(f));
+                f->server->follow_queued -= follower_queued(f);
+        }
+
+        if (f->event_source) {
+                sd_event_source_set_enabled(f->event_source, SD_EVENT_OFF);
+                f->event_source = sd_event_source_unref(f->event_source);
+        }
+
+        safe_close(f->fd);
+        free(f->uid_field);
+        strv_free(f->matches);
+        free(f->buffer);
+
+        free(f);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(Follower*, follower_free);
+
+static bool iovec_contains(const struct iovec *iovec, size_t n, const char *field) {
+        size_t i, l;
+
+        l = strlen(field);
+
+        for (i = 0; i < n; i++)
+                if (iovec[i].iov_len == l && memcmp(iovec[i].iov_base, field, l) == 0)
+                        return true;
+
+        return false;
+}
+
+bool follower_matches(Follower *f, const struct iovec *iovec, size_t n) {
+        char **begin, **end, **i, **j;
+
+        assert(f);
+
+        if (f->uid_field && !iovec_contains(iovec, n, f->uid_field))
+                return false;
+
+        if (strv_isempty(f->matches))
+                return true;
+
+        /* Same semantics as sd_journal_add_match(): matches for different fields all need to be fulfilled,
+         * matches for the same field are alternatives, and so are the runs of matches separated by "+". */
+        for (begin = f->matches;; begin = end + 1) {
+                bool good = true;
+
+                for (end = begin; *end && !streq(*end, "+"); end++)
+                        ;
+
+                for (i = begin; good && i < end; i++) {
+                        size_t k = strchr(*i, '=') - *i + 1;
+
+                        /* Did we check this field already? */
+                        for (j = begin; j < i; j++)
+                                if (strneq(*j, *i, k))
+                                        break;
+                        if (j < i)
+                                continue;
+
+                        good = false;
+                        for (j = i; !good && j < end; j++)
+                                if (strneq(*j, *i, k))
+                                        good = iovec_contains(iovec, n, *j);
+                }
+
+                if (good)
+                        return true;
+                if (!*end)
+                        return false;
+        }
+}
+
+int follower_parse_request(Follower *f) {
+        bool have_term = false;
+
+        assert(f);
+
+        /* The request consists of one match per line, terminated by an empty line. Returns > 0 once it has
+         * been read completely. */
+
+        for (;;) {
+                char *p, *e, *eq;
+                size_t l;
+                int r;
+
+                p = f->buffer + f->offset;
+                e = memchr(p, '\n', f->length - f->offset);
+                if (!e)
+                        return 0;
+
+                l = e - p;
+                f->offset += l + 1;
+
+                if (l == 0) {
+                        if (!strv_isempty(f->matches) && !have_term)
+                                return -EINVAL;
+
+                        return 1;
+                }
+
+                if (l == 1 && p[0] == '+') {
+                        if (!have_term)
+                                return -EINVAL;
+
+                        have_term = false;
+                } else {
+                        eq = memchr(p, '=', l);
+                        if (!eq || !journal_field_valid(p, eq - p, true))
+                                return -EINVAL;
+
+                        have_term = true;
+                }
+
+                r = strv_consume(&f->matches, strndup(p, l));
+                if (r < 0)
+                        return r;
+        }
+}
+
+static int follower_update_io_events(Follower *f) {
+        assert(f);
+
+        return sd_event_source_set_io_events(f->event_source,
+                                             (f->eof ? 0 : EPOLLIN) | (follower_queued(f) > 0 ? EPOLLOUT : 0));
+}
+
+static int follower_flush(Follower *f) {
+        assert(f);
+
+        while (f->offset < f->length) {
+                ssize_t l;
+
+                l = send(f->fd, f->buffer + f->offset, f->length - f->offset, MSG_DONTWAIT|MSG_NOSIGNAL);
+                if (l < 0) {
+                        if (errno == EAGAIN)
+                                break;
+
+                        return -errno;
+                }
+
+                f->offset += l;
+                f->server->follow_queued -= l;
+        }
+
+        if (f->offset >= f->length)
+                f->offset = f->length = 0;
+
+        return follower_update_io_events(f);
+}
+
+static int follower_enqueue(Follower *f, const char *data, size_t size) {
+        bool was_empty;
+
+        assert(f);
+        assert(f->server);
+        assert(f->state == FOLLOWER_RUNNING);
+        assert(data);
+
+        was_empty = f->length == f->offset;
+
+        /* Clients that keep up usually get the data right away, without copying it around */
+        if (was_empty) {
+                ssize_t l;
+
+                l = send(f->fd, data, size, MSG_DONTWAIT|MSG_NOSIGNAL);
+                if (l < 0) {
+                        if (errno != EAGAIN)
+                                return -errno;
+                } else {
+                        data += l;
+                        size -= l;
+                }
+
+                if (size == 0)
+                        return 0;
+        }
+
+        if (f->length - f->offset + size > FOLLOW_QUEUE_MAX ||
+            f->server->follow_queued + size > FOLLOW_QUEUE_TOTAL_MAX)
+                return -ENOBUFS;
+
+        /* Drop what was sent already only once that is at least as much as what is left, so that every byte is
+         * moved at most once on average */
+        if (f->offset > 0 && f->offset >= f->length - f->offset) {
+                memmove(f->buffer, f->buffer + f->offset, f->length - f->offset);
+                f->length -= f->offset;
+                f->offset = 0;
+        }
+
+        if (!GREEDY_REALLOC(f->buffer, f->allocated, f->length + size))
+                return -ENOMEM;
+
+        memcpy(f->buffer + f->length, data, size);
+        f->length += size;
+        f->server->follow_queued += size;
+
+        return was_empty ? follower_update_io_events(f) : 0;
+}
+
+static int follower_read(Follower *f) {
+        char discard[256];
+        ssize_t l;
+        int r;
+
+        assert(f);
+
+        if (f->state == FOLLOWER_RUNNING) {
+                /* There's nothing more we expect from the client, but we need to notice when it goes away */
+                l = read(f->fd, discard, sizeof(discard));
+                if (l < 0)
+                        return errno == EAGAIN ? 0 : -errno;
+                if (l == 0) {
+                        f->eof = true;
+                        return follower_flush(f);
+                }
+
+                return 0;
+        }
+
+        if (!GREEDY_REALLOC(f->buffer, f->allocated, MIN(f->length + 1024, FOLLOW_REQUEST_MAX)))
+                return -ENOMEM;
+
+        if (f->length >= MIN(f->allocated, FOLLOW_REQUEST_MAX))
+                return -ENOBUFS;
+
+        l = read(f->fd, f->buffer + f->length, MIN(f->allocated, FOLLOW_REQUEST_MAX) - f->length);
+        if (l < 0)
+                return errno == EAGAIN ? 0 : -errno;
+        if (l == 0)
+                return -ECONNRESET;
+
+        f->length += l;
+
+        r = follower_parse_request(f);
+        if (r <= 0)
+                return r;
+
+        /* Anything the client sent after the request is ignored. Confirm the subscription, so that the client
+         * knows from which point on it gets all entries. */
+        f->state = FOLLOWER_RUNNING;
+        f->offset = f->length = 0;
+
+        return follower_enqueue(f, "OK\n", 3);
+}
+
+static int follower_process(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        Follower *f = userdata;
+        int r;
+
+        assert(f);
+
+        if (revents & (EPOLLERR|EPOLLHUP)) {
+                log_debug("Journal follower disconnected.");
+                goto terminate;
+        }
+
+        if (revents & EPOLLOUT) {
+                r = follower_flush(f);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to write to journal follower: %m");
+                        goto terminate;
+                }
+        }
+
+        if (revents & EPOLLIN) {
+                r = follower_read(f);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to read request of journal follower: %m");
+                        goto terminate;
+                }
+        }
+
+        return 0;
+
+terminate:
+        follower_free(f);
+        return 0;
+}
+
+static int follower_verify_privileged(int fd, const struct ucred *ucred) {
+        _cleanup_free_ gid_t *gids = NULL;
+        struct stat st;
+        int n, i;
+
+        assert(fd >= 0);
+        assert(ucred);
+
+        /* Whoever may read the system journal files may follow all entries. We don't want to resolve group
+         * names from within journald, hence let's check for membership in the group owning the runtime journal
+         * directory, i.e. "systemd-journal". Everybody else only gets to see the entries of their own user, much
+         * like with the per-user journal files. */
+
+        if (ucred->uid == 0)
+                return true;
+
+        if (stat("/run/log/journal", &st) < 0)
+                return false;
+
+        if (ucred->gid == st.st_gid)
+                return true;
+
+        n = getpeergroups(fd, &gids);
+        if (n == -ENOPROTOOPT)
+                return false;
+        if (n < 0)
+                return n;
+
+        for (i = 0; i < n; i++)
+                if (gids[i] == st.st_gid)
+                        return true;
+
+        return false;
+}
+
+static unsigned server_count_followers(Server *s, uid_t uid) {
+        unsigned n = 0;
+        Follower *i;
+
+        assert(s);
+
+        LIST_FOREACH(follower, i, s->followers)
+                if (i->uid == uid)
+                        n++;
+
+        return n;
+}
+
+static int follower_install(Server *s, int fd) {
+        _cleanup_(follower_freep) Follower *f = NULL;
+        struct ucred ucred;
+        int r;
+
+        assert(s);
+        assert(fd >= 0);
+
+        /* Takes possession of fd, also on failure */
+
+        f = new(Follower, 1);
+        if (!f) {
+                safe_close(fd);
+                return log_oom();
+        }
+
+        *f = (Follower) {
+                .fd = fd,
+                .state = FOLLOWER_REQUEST,
+        };
+
+        r = getpeercred(fd, &ucred);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to determine peer credentials of journal follower: %m");
+
+        /* Limit followers per user, so that nobody can use up all of them. Root may always connect. */
+        if (ucred.uid != 0) {
+                if (s->n_followers >= FOLLOWERS_MAX)
+                        return log_warning_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                                 "Too many journal followers, refusing connection.");
+
+                if (server_count_followers(s, ucred.uid) >= FOLLOWERS_PER_UID_MAX)
+                        return log_warning_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                                 "Too many journal followers of user " UID_FMT ", refusing connection.",
+                                                 ucred.uid);
+        }
+
+        f->uid = ucred.uid;
+
+        r = follower_verify_privileged(fd, &ucred);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to determine groups of journal follower: %m");
+        if (r == 0 && asprintf(&f->uid_field, "_UID=" UID_FMT, ucred.uid) < 0)
+                return log_oom();
+
+        r = sd_event_add_io(s->event, &f->event_source, fd, EPOLLIN, follower_process, f);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to add journal follower to event loop: %m");
+
+        r = sd_event_source_set_priority(f->event_source, SD_EVENT_PRIORITY_NORMAL+10);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to adjust priority of journal follower event source: %m");
+
+        f->server = s;
+        LIST_PREPEND(follower, s->followers, f);
+        s->n_followers++;
+
+        TAKE_PTR(f);
+        return 0;
+}
+
+static int follower_new(sd_event_source *es, int listen_fd, uint32_t revents, void *userdata) {
+        _cleanup_close_ int fd = -1;
+        Server *s = userdata;
+
+        assert(s);
+
+        if (revents != EPOLLIN)
+                return log_error_errno(SYNTHETIC_ERRNO(EIO),
+                                       "Got invalid event from epoll for follow server fd: %" PRIx32,
+                                       revents);
+
+        fd = accept4(s->follow_fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+        if (fd < 0) {
+                if (errno == EAGAIN)
+                        return 0;
+
+                /* Returning an error would turn off the socket for good, hence only do so if it is broken */
+                if (IN_SET(errno, EBADF, EINVAL, ENOTSOCK, EOPNOTSUPP))
+                        return log_error_errno(errno, "Failed to accept follow connection: %m");
+
+                log_warning_errno(errno, "Failed to accept follow connection, ignoring: %m");
+                return 0;
+        }
+
+        /* Failing to set up one client shouldn't affect the others, the error is logged already */
+        (void) follower_install(s, TAKE_FD(fd));
+        return 0;
+}
+
+int server_open_follow_socket(Server *s) {
+        static const union sockaddr_union sa = {
+                .un.sun_family = AF_UNIX,
+                .un.sun_path = "/run/systemd/journal/follow",
+        };
+        int r;
+
+        assert(s);
+
+        if (s->follow_fd < 0) {
+                s->follow_fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
+                if (s->follow_fd < 0)
+                        return log_error_errno(errno, "socket() failed: %m");
+
+                (void) sockaddr_un_unlink(&sa.un);
+
+                r = bind(s->follow_fd, &sa.sa, SOCKADDR_UN_LEN(sa.un));
+                if (r < 0)
+                        return log_error_errno(errno, "bind(%s) failed: %m", sa.un.sun_path);
+
+                /* Access to the entries is checked per connection */
+                (void) chmod(sa.un.sun_path, 0666);
+
+                if (listen(s->follow_fd, SOMAXCONN) < 0)
+                        return log_error_errno(errno, "listen(%s) failed: %m", sa.un.sun_path);
+        } else
+                (void) fd_nonblock(s->follow_fd, true);
+
+        r = sd_event_add_io(s->event, &s->follow_event_source, s->follow_fd, EPOLLIN, follower_new, s);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add follow server fd to event source: %m");
+
+        r = sd_event_source_set_priority(s->follow_event_source, SD_EVENT_PRIORITY_NORMAL+10);
+        if (r < 0)
+                return log_error_errno(r, "Failed to adjust priority of follow server event source: %m");
+
+        return 0;
+}
+
+static int buffer_append(char **buffer, size_t *allocated, size_t *size, const void *p, size_t l) {
+        if (!GREEDY_REALLOC(*buffer, *allocated, *size + l))
+                return -ENOMEM;
+
+        memcpy(*buffer + *size, p, l);
+        *size += l;
+
+        return 0;
+}
+
+int follow_export_entry(
+                JournalFile *f,
+                Object *o,
+                const struct iovec *iovec,
+                size_t n,
+                char **ret,
+                size_t *ret_size) {
+
+        char header[STRLEN("__CURSOR=s=;i=;b=;m=;t=;x=\n__REALTIME_TIMESTAMP=\n__MONOTONIC_TIMESTAMP=\n_BOOT_ID=\n") +
+                    3 * SD_ID128_STRING_MAX + 4 * 16 + 2 * DECIMAL_STR_MAX(uint64_t)];
+        char sid[SD_ID128_STRING_MAX], bid[SD_ID128_STRING_MAX];
+        _cleanup_free_ char *buffer = NULL;
+        size_t allocated = 0, size = 0, i;
+        int r;
+
+        assert(f);
+        assert(o);
+        assert(iovec || n == 0);
+        assert(ret);
+        assert(ret_size);
+
+        /* Serializes the entry in the Journal Export Format, like "journalctl -o export" does it, i.e. with the
+         * boot ID in the header rather than among the fields */
+
+        xsprintf(header,
+                 "__CURSOR=s=%s;i=%" PRIx64 ";b=%s;m=%" PRIx64 ";t=%" PRIx64 ";x=%" PRIx64 "\n"
+                 "__REALTIME_TIMESTAMP=%" PRIu64 "\n"
+                 "__MONOTONIC_TIMESTAMP=%" PRIu64 "\n"
+                 "_BOOT_ID=%s\n",
+                 sd_id128_to_string(f->header->seqnum_id, sid), le64toh(o->entry.seqnum),
+                 sd_id128_to_string(o->entry.boot_id, bid), le64toh(o->entry.monotonic),
+                 le64toh(o->entry.realtime), le64toh(o->entry.xor_hash),
+                 le64toh(o->entry.realtime),
+                 le64toh(o->entry.monotonic),
+                 bid);
+
+        r = buffer_append(&buffer, &allocated, &size, header, strlen(header));
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n; i++) {
+                const char *data = iovec[i].iov_base, *eq;
+                size_t length = iovec[i].iov_len;
+
+                if (memory_startswith(data, length, "_BOOT_ID="))
+                        continue;
+
+                if (utf8_is_printable_newline(data, length, false))
+                        r = buffer_append(&buffer, &allocated, &size, data, length);
+                else {
+                        uint64_t le64;
+
+                        eq = memchr(data, '=', length);
+                        if (!eq)
+                                continue;
+
+                        le64 = htole64(length - (eq - data) - 1);
+
+                        r = buffer_append(&buffer, &allocated, &size, data, eq - data);
+                        if (r >= 0)
+                                r = buffer_append(&buffer, &allocated, &size, "\n", 1);
+                        if (r >= 0)
+                                r = buffer_append(&buffer, &allocated, &size, &le64, sizeof(le64));
+                        if (r >= 0)
+                                r = buffer_append(&buffer, &allocated, &size, eq + 1, length - (eq - data) - 1);
+                }
+                if (r >= 0)
+                        r = buffer_append(&buffer, &allocated, &size, "\n", 1);
+                if (r < 0)
+                        return r;
+        }
+
+        r = buffer_append(&buffer, &allocated, &size, "\n", 1);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(buffer);
+        *ret_size = size;
+
+        return 0;
+}
+
+void server_follow_dispatch(Server *s, JournalFile *f, uint64_t offset, const struct iovec *iovec, size_t n) {
+        _cleanup_free_ char *data = NULL;
+        Follower *i, *next;
+        size_t size = 0;
+        Object *o;
+        int r;
+
+        assert(s);
+        assert(f);
+
+        LIST_FOREACH_SAFE(follower, i, next, s->followers) {
+
+                if (i->state != FOLLOWER_RUNNING)
+                        continue;
+
+                if (!follower_matches(i, iovec, n))
+                        continue;
+
+                /* The entry is serialized only once, and only if anybody is interested in it */
+                if (!data) {
+                        r = journal_file_move_to_object(f, OBJECT_ENTRY, offset, &o);
+                        if (r >= 0)
+                                r = follow_export_entry(f, o, iovec, n, &data, &size);
+                        if (r < 0) {
+                                log_warning_errno(r, "Failed to serialize entry for journal followers, ignoring: %m");
+                                return;
+                        }
+                }
+
+                r = follower_enqueue(i, data, size);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to queue entry for journal follower, disconnecting: %m");
+                        follower_free(i);
+                }
+        }
+}
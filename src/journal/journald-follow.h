@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <sys/uio.h>
+
+#include "sd-event.h"
+
+typedef struct Follower Follower;
+
+#include "journal-file.h"
+#include "journald-server.h"
+#include "list.h"
+
+typedef enum FollowerState {
+        FOLLOWER_REQUEST,   /* reading the list of matches */
+        FOLLOWER_RUNNING,   /* streaming entries */
+} FollowerState;
+
+struct Follower {
+        Server *server;
+        FollowerState state;
+
+        int fd;
+        sd_event_source *event_source;
+        bool eof:1;
+
+        uid_t uid;
+
+        /* Unprivileged clients only get to see the entries of their own user, this is their "_UID=" field then */
+        char *uid_field;
+
+        /* "FIELD=VALUE" matches, with "+" separating alternatives, like journalctl takes them */
+        char **matches;
+
+        /* The request while reading it, the data queued for the client afterwards. What was already sent
+         * is skipped with offset, and only dropped once it makes up at least half of the buffer. */
+        char *buffer;
+        size_t allocated, length, offset;
+
+        LIST_FIELDS(Follower, follower);
+};
+
+int server_open_follow_socket(Server *s);
+
+void follower_free(Follower *f);
+
+bool follower_matches(Follower *f, const struct iovec *iovec, size_t n);
+int follower_parse_request(Follower *f);
+
+int follow_export_entry(JournalFile *f, Object *o, const struct iovec *iovec, size_t n, char **ret, size_t *ret_size);
+
+void server_follow_dispatch(Server *s, JournalFile *f, uint64_t offset, const struct iovec *iovec, size_t n);
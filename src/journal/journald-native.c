@@ -11,7 +11,6 @@
 #include "fs-util.h"
 #include "io-util.h"
 #include "journal-importer.h"
-#include "journal-util.h"
 #include "journald-console.h"
 #include "journald-kmsg.h"
 #include "journald-native.h"
@@ -38,7 +37,8 @@ static void server_process_entry_meta(
                 int *priority,
                 char **identifier,
                 char **message,
-                pid_t *object_pid) {
+                pid_t *object_pid,
+                usec_t *source_realtime) {
 
         /* We need to determine the priority of this entry for the rate limiting logic */
 
@@ -88,9 +88,103 @@ static void server_process_entry_meta(
                 buf[l-STRLEN("OBJECT_PID=")] = '\0';
 
                 (void) parse_pid(buf, object_pid);
+
+        } else if (l > STRLEN("SOURCE_REALTIME_TIMESTAMP=") &&
+                   l < STRLEN("SOURCE_REALTIME_TIMESTAMP=") + DECIMAL_STR_MAX(usec_t) &&
+                   startswith(p, "SOURCE_REALTIME_TIMESTAMP=") &&
+                   allow_object_pid(ucred)) {
+                char buf[DECIMAL_STR_MAX(usec_t)];
+
+                /* Our own daemons pass the time a message was logged at along if they queued it for a while
+                 * before sending it. As with OBJECT_PID=, only trust privileged clients. */
+                memcpy(buf, p + STRLEN("SOURCE_REALTIME_TIMESTAMP="),
+                       l - STRLEN("SOURCE_REALTIME_TIMESTAMP="));
+                buf[l-STRLEN("SOURCE_REALTIME_TIMESTAMP=")] = '\0';
+
+                (void) safe_atou64(buf, source_realtime);
         }
 }
 
+static inline bool field_name_char(char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+NativeFieldType native_field_split(const char *p, size_t n, const char **ret_end, size_t *ret_name_len, bool *ret_valid) {
+        const char *e, *q;
+        size_t k = 0;
+
+        assert(p);
+        assert(ret_end);
+        assert(ret_name_len);
+        assert(ret_valid);
+
+        /* Splits off the next field of a native protocol message. This looks at each byte of the field name only
+         * once: the name is validated while looking for the '=' or '\n' that terminates it, and only the value is
+         * then scanned for the end of the line, using memchr(). Only if the name contains characters not permitted
+         * in field names we fall back to scanning the line for both separators.
+         *
+         * On return *ret_end points to the newline terminating the line (text fields) or the name (binary fields),
+         * *ret_name_len is the length of the field name and *ret_valid is true if the name is a valid field name
+         * that may be passed in from clients, in the sense of journal_field_valid(). */
+
+        *ret_end = NULL;
+        *ret_name_len = 0;
+        *ret_valid = false;
+
+        if (n == 0)
+                return NATIVE_FIELD_NOISE;
+
+        if (*p == '\n') {
+                *ret_end = p;
+                return NATIVE_FIELD_SEPARATOR;
+        }
+
+        if (IN_SET(*p, '.', '#')) {
+                e = memchr(p, '\n', n);
+                if (!e)
+                        return NATIVE_FIELD_NOISE;
+
+                *ret_end = e;
+                return NATIVE_FIELD_CONTROL;
+        }
+
+        while (k < n && field_name_char(p[k]))
+                k++;
+
+        if (k < n && IN_SET(p[k], '=', '\n')) {
+                bool text = p[k] == '=';
+
+                if (text) {
+                        e = memchr(p + k + 1, '\n', n - k - 1);
+                        if (!e)
+                                return NATIVE_FIELD_NOISE;
+                } else
+                        e = p + k;
+
+                *ret_end = e;
+                *ret_name_len = k;
+                *ret_valid = k > 0 && k <= 64 && p[0] != '_' && !(p[0] >= '0' && p[0] <= '9');
+                return text ? NATIVE_FIELD_TEXT : NATIVE_FIELD_BINARY;
+        }
+
+        /* The name contains characters that are not allowed, process the line the slow way then, so that we can
+         * skip over it properly. */
+        e = memchr(p + k, '\n', n - k);
+        if (!e)
+                return NATIVE_FIELD_NOISE;
+
+        *ret_end = e;
+
+        q = memchr(p + k, '=', e - p - k);
+        if (q) {
+                *ret_name_len = q - p;
+                return NATIVE_FIELD_TEXT;
+        }
+
+        *ret_name_len = e - p;
+        return NATIVE_FIELD_BINARY;
+}
+
 static int server_process_entry(
                 Server *s,
                 const void *buffer, size_t *remaining,
@@ -106,6 +200,8 @@ static int server_process_entry(
 
         size_t n = 0, j, tn = (size_t) -1, m = 0, entry_size = 0;
         char *identifier = NULL, *message = NULL;
+        usec_t source_realtime = USEC_INFINITY;
+        struct timeval source_tv;
         struct iovec *iovec = NULL;
         int priority = LOG_INFO;
         pid_t object_pid = 0;
@@ -115,23 +211,26 @@ static int server_process_entry(
         p = buffer;
 
         while (*remaining > 0) {
-                const char *e, *q;
+                NativeFieldType t;
+                size_t name_len;
+                const char *e;
+                bool valid;
 
-                e = memchr(p, '\n', *remaining);
+                t = native_field_split(p, *remaining, &e, &name_len, &valid);
 
-                if (!e) {
+                if (t == NATIVE_FIELD_NOISE) {
                         /* Trailing noise, let's ignore it, and flush what we collected */
                         log_debug("Received message with trailing noise, ignoring.");
                         break; /* finish processing of the message */
                 }
 
-                if (e == p) {
+                if (t == NATIVE_FIELD_SEPARATOR) {
                         /* Entry separator */
                         *remaining -= 1;
                         break;
                 }
 
-                if (IN_SET(*p, '.', '#')) {
+                if (t == NATIVE_FIELD_CONTROL) {
                         /* Ignore control commands for now, and comments too. */
                         *remaining -= (e - p) + 1;
                         p = e + 1;
@@ -153,9 +252,8 @@ static int server_process_entry(
                         goto finish;
                 }
 
-                q = memchr(p, '=', e - p);
-                if (q) {
-                        if (journal_field_valid(p, q - p, false)) {
+                if (t == NATIVE_FIELD_TEXT) {
+                        if (valid) {
                                 size_t l;
 
                                 l = e - p;
@@ -179,7 +277,8 @@ static int server_process_entry(
                                                           &priority,
                                                           &identifier,
                                                           &message,
-                                                          &object_pid);
+                                                          &object_pid,
+                                                          &source_realtime);
                         }
 
                         *remaining -= (e - p) + 1;
@@ -223,7 +322,7 @@ static int server_process_entry(
                         k[e - p] = '=';
                         memcpy(k + (e - p) + 1, e + 1 + sizeof(uint64_t), l);
 
-                        if (journal_field_valid(p, e - p, false)) {
+                        if (valid) {
                                 iovec[n] = IOVEC_MAKE(k, (e - p) + 1 + l);
                                 entry_size += iovec[n].iov_len;
                                 n++;
@@ -232,7 +331,8 @@ static int server_process_entry(
                                                           &priority,
                                                           &identifier,
                                                           &message,
-                                                          &object_pid);
+                                                          &object_pid,
+                                                          &source_realtime);
                         } else
                                 free(k);
 
@@ -255,6 +355,9 @@ static int server_process_entry(
 
         r = 0; /* Success, we read the message. */
 
+        if (source_realtime > 0 && source_realtime != USEC_INFINITY)
+                tv = timeval_store(&source_tv, source_realtime);
+
         if (!client_context_test_priority(context, priority))
                 goto finish;
 
@@ -305,6 +408,9 @@ void server_process_native_message(
         assert(s);
         assert(buffer || buffer_size == 0);
 
+        if (server_rate_limit_early_reject(s, ucred))
+                return;
+
         if (ucred && pid_is_valid(ucred->pid)) {
                 r = client_context_get(s, ucred->pid, ucred, label, label_len, NULL, &context);
                 if (r < 0)
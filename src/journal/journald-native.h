@@ -3,6 +3,16 @@
 
 #include "journald-server.h"
 
+typedef enum NativeFieldType {
+        NATIVE_FIELD_NOISE,     /* no terminating newline */
+        NATIVE_FIELD_SEPARATOR, /* empty line, terminates the entry */
+        NATIVE_FIELD_CONTROL,   /* control command or comment */
+        NATIVE_FIELD_TEXT,      /* NAME=value\n */
+        NATIVE_FIELD_BINARY,    /* NAME\n<64bit LE size><data>\n */
+} NativeFieldType;
+
+NativeFieldType native_field_split(const char *p, size_t n, const char **ret_end, size_t *ret_name_len, bool *ret_valid);
+
 void server_process_native_message(
                 Server *s,
                 const char *buffer,
@@ -29,10 +29,11 @@ static const int priority_map[] = {
 typedef struct JournalRateLimitPool JournalRateLimitPool;
 typedef struct JournalRateLimitGroup JournalRateLimitGroup;
 
+/* Each pool is a token bucket refilled at a rate of burst messages per interval, holding at most burst
+ * messages. To avoid rounding, tokens are counted in units of 1/interval messages, i.e. a message costs
+ * interval tokens and every microsecond burst tokens are added. */
 struct JournalRateLimitPool {
-        usec_t begin;
-        unsigned num;
-        unsigned suppressed;
+        uint64_t tokens;
 };
 
 struct JournalRateLimitGroup {
@@ -40,8 +41,15 @@ struct JournalRateLimitGroup {
 
         char *id;
 
-        /* Interval is stored to keep track of when the group expires */
+        /* Interval and burst are stored to refill the pools and to keep track of when the group expires */
         usec_t interval;
+        unsigned burst;
+
+        /* When the pools were last refilled */
+        usec_t timestamp;
+
+        /* Messages dropped since the last one that was let through */
+        unsigned suppressed;
 
         JournalRateLimitPool pools[POOLS_MAX];
         uint64_t hash;
@@ -57,6 +65,8 @@ struct JournalRateLimit {
 
         unsigned n_groups;
 
+        uint64_t n_suppressed;
+
         uint8_t hash_key[16];
 };
 
@@ -101,15 +111,10 @@ void journal_rate_limit_free(JournalRateLimit *r) {
 }
 
 _pure_ static bool journal_rate_limit_group_expired(JournalRateLimitGroup *g, usec_t ts) {
-        unsigned i;
-
         assert(g);
 
-        for (i = 0; i < POOLS_MAX; i++)
-                if (g->pools[i].begin + g->interval >= ts)
-                        return false;
-
-        return true;
+        /* After one interval without messages all pools are full again, and we can forget about the group */
+        return g->timestamp + g->interval < ts;
 }
 
 static void journal_rate_limit_vacuum(JournalRateLimit *r, usec_t ts) {
@@ -123,7 +128,8 @@ static void journal_rate_limit_vacuum(JournalRateLimit *r, usec_t ts) {
                 journal_rate_limit_group_free(r->lru_tail);
 }
 
-static JournalRateLimitGroup* journal_rate_limit_group_new(JournalRateLimit *r, const char *id, usec_t interval, usec_t ts) {
+static JournalRateLimitGroup* journal_rate_limit_group_new(JournalRateLimit *r, const char *id, usec_t interval, unsigned burst, usec_t ts) {
+        unsigned i;
         JournalRateLimitGroup *g;
 
         assert(r);
@@ -140,6 +146,11 @@ static JournalRateLimitGroup* journal_rate_limit_group_new(JournalRateLimit *r,
         g->hash = siphash24_string(g->id, r->hash_key);
 
         g->interval = interval;
+        g->burst = burst;
+        g->timestamp = ts;
+
+        for (i = 0; i < POOLS_MAX; i++)
+                g->pools[i].tokens = (uint64_t) burst * interval;
 
         journal_rate_limit_vacuum(r, ts);
 
@@ -185,11 +196,72 @@ static unsigned burst_modulate(unsigned burst, uint64_t available) {
         return burst;
 }
 
-int journal_rate_limit_test(JournalRateLimit *r, const char *id, usec_t rl_interval, unsigned rl_burst, int priority, uint64_t available) {
+static JournalRateLimitGroup* journal_rate_limit_find(JournalRateLimit *r, const char *id) {
+        JournalRateLimitGroup *g;
         uint64_t h;
+
+        assert(r);
+        assert(id);
+
+        h = siphash24_string(id, r->hash_key);
+
+        LIST_FOREACH(bucket, g, r->buckets[h % BUCKETS_MAX])
+                if (streq(g->id, id))
+                        return g;
+
+        return NULL;
+}
+
+static void journal_rate_limit_group_refill(JournalRateLimitGroup *g, usec_t ts) {
+        uint64_t max, add;
+        usec_t elapsed;
+        unsigned i;
+
+        assert(g);
+
+        max = (uint64_t) g->burst * g->interval;
+
+        /* Refilling for one interval fills up any pool, cap the time to avoid overflows */
+        elapsed = ts > g->timestamp ? MIN(ts - g->timestamp, g->interval) : 0;
+        add = (uint64_t) g->burst * elapsed;
+
+        for (i = 0; i < POOLS_MAX; i++)
+                g->pools[i].tokens = MIN(g->pools[i].tokens + add, max);
+
+        g->timestamp = ts;
+}
+
+static bool journal_rate_limit_group_take(JournalRateLimitGroup *g, int priority) {
+        unsigned i;
+
+        assert(g);
+
+        /* Takes a token from the pool of the specified priority. If that one is exhausted, messages of higher
+         * priority may use up what is left in the pools of lower priority, so that a flood of debug messages
+         * cannot starve errors, while an important message is still let through if less important ones left
+         * room for it. A negative priority just checks whether any pool has a token left. */
+
+        for (i = priority < 0 ? 0 : priority_map[priority]; i < POOLS_MAX; i++)
+                if (g->pools[i].tokens >= g->interval) {
+                        if (priority >= 0)
+                                g->pools[i].tokens -= g->interval;
+                        return true;
+                }
+
+        return false;
+}
+
+static void journal_rate_limit_group_suppress(JournalRateLimitGroup *g) {
+        assert(g);
+        assert(g->parent);
+
+        g->suppressed++;
+        g->parent->n_suppressed++;
+}
+
+int journal_rate_limit_test(JournalRateLimit *r, const char *id, usec_t rl_interval, unsigned rl_burst, int priority, uint64_t available) {
         JournalRateLimitGroup *g;
-        JournalRateLimitPool *p;
-        unsigned burst;
+        unsigned burst, s;
         usec_t ts;
 
         assert(id);
@@ -204,52 +276,62 @@ int journal_rate_limit_test(JournalRateLimit *r, const char *id, usec_t rl_inter
         if (!r)
                 return 1;
 
-        ts = now(CLOCK_MONOTONIC);
-
-        h = siphash24_string(id, r->hash_key);
-        g = r->buckets[h % BUCKETS_MAX];
+        if (rl_interval == 0 || rl_burst == 0)
+                return 1;
 
-        LIST_FOREACH(bucket, g, g)
-                if (streq(g->id, id))
-                        break;
+        ts = now(CLOCK_MONOTONIC);
+        burst = burst_modulate(rl_burst, available);
 
+        g = journal_rate_limit_find(r, id);
         if (!g) {
-                g = journal_rate_limit_group_new(r, id, rl_interval, ts);
+                g = journal_rate_limit_group_new(r, id, rl_interval, burst, ts);
                 if (!g)
                         return -ENOMEM;
-        } else
+        } else {
                 g->interval = rl_interval;
+                g->burst = burst;
+        }
 
-        if (rl_interval == 0 || rl_burst == 0)
-                return 1;
+        journal_rate_limit_group_refill(g, ts);
 
-        burst = burst_modulate(rl_burst, available);
+        if (!journal_rate_limit_group_take(g, priority)) {
+                journal_rate_limit_group_suppress(g);
+                return 0;
+        }
 
-        p = &g->pools[priority_map[priority]];
+        s = g->suppressed;
+        g->suppressed = 0;
 
-        if (p->begin <= 0) {
-                p->suppressed = 0;
-                p->num = 1;
-                p->begin = ts;
-                return 1;
-        }
+        return 1 + s;
+}
 
-        if (p->begin + rl_interval < ts) {
-                unsigned s;
+bool journal_rate_limit_early_reject(JournalRateLimit *r, const char *id) {
+        JournalRateLimitGroup *g;
 
-                s = p->suppressed;
-                p->suppressed = 0;
-                p->num = 1;
-                p->begin = ts;
+        assert(id);
 
-                return 1 + s;
-        }
+        /* A cheap check for a peer that is known to be rate limited right now, to be done before parsing a
+         * message or collecting metadata for it. Since the priority is not known yet, this only rejects the
+         * message if all pools of the group are exhausted, i.e. if it would be dropped whatever its priority
+         * is. The message is then counted as suppressed just like a message dropped by
+         * journal_rate_limit_test(). */
 
-        if (p->num < burst) {
-                p->num++;
-                return 1;
-        }
+        if (!r)
+                return false;
+
+        g = journal_rate_limit_find(r, id);
+        if (!g || g->interval == 0 || g->burst == 0)
+                return false;
+
+        journal_rate_limit_group_refill(g, now(CLOCK_MONOTONIC));
+
+        if (journal_rate_limit_group_take(g, -1))
+                return false;
+
+        journal_rate_limit_group_suppress(g);
+        return true;
+}
 
-        p->suppressed++;
-        return 0;
+uint64_t journal_rate_limit_get_suppressed(JournalRateLimit *r) {
+        return r ? r->n_suppressed : 0;
 }
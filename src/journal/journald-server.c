@@ -76,42 +76,52 @@
 
 #define DEFERRED_CLOSES_MAX (4096)
 
-static int determine_path_usage(Server *s, const char *path, uint64_t *ret_used, uint64_t *ret_free) {
-        _cleanup_closedir_ DIR *d = NULL;
-        struct dirent *de;
+/* The maximum number of datagrams to read with a single recvmmsg() call */
+#define RECEIVE_BATCH_SIZE_MAX 64U
+
+/* The largest datagram read in a batch. sd-journal clients raise their send buffer to 8M, hence larger ones only
+ * come from clients that force a larger buffer. Each datagram of a batch gets this much address space, of which only
+ * the pages the datagram takes up are ever touched. */
+#define RECEIVE_DATAGRAM_SIZE_MAX (8U*1024U*1024U)
+
+/* The maximum number of entries to collect before writing them out, for the messages read in one batch and any
+ * messages of our own about them */
+#define PENDING_ENTRIES_MAX (2 * RECEIVE_BATCH_SIZE_MAX)
+
+static int determine_path_usage(Server *s, JournalStorage *storage, uint64_t *ret_used, uint64_t *ret_free) {
         struct statvfs ss;
+        int r;
 
+        assert(s);
+        assert(storage);
         assert(ret_used);
         assert(ret_free);
 
-        d = opendir(path);
-        if (!d)
+        if (statvfs(storage->path, &ss) < 0)
                 return log_full_errno(errno == ENOENT ? LOG_DEBUG : LOG_ERR,
-                                      errno, "Failed to open %s: %m", path);
-
-        if (fstatvfs(dirfd(d), &ss) < 0)
-                return log_error_errno(errno, "Failed to fstatvfs(%s): %m", path);
+                                      errno, "Failed to statvfs(%s): %m", storage->path);
 
         *ret_free = ss.f_bsize * ss.f_bavail;
-        *ret_used = 0;
-        FOREACH_DIRENT_ALL(de, d, break) {
-                struct stat st;
 
-                if (!endswith(de->d_name, ".journal") &&
-                    !endswith(de->d_name, ".journal~"))
-                        continue;
-
-                if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
-                        log_debug_errno(errno, "Failed to stat %s/%s, ignoring: %m", path, de->d_name);
-                        continue;
-                }
-
-                if (!S_ISREG(st.st_mode))
-                        continue;
+        if (!storage->directory) {
+                r = journal_directory_new(storage->path, &storage->directory);
+                if (r < 0)
+                        return log_oom();
+        }
 
-                *ret_used += (uint64_t) st.st_blocks * 512UL;
+        /* Keep the index of the journal files current via inotify, so that we only need to look at active files
+         * when the cached data expires. If that doesn't work out, the index is simply rebuilt each time. */
+        if (s->event) {
+                r = journal_directory_watch(storage->directory, s->event);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to watch %s, will rescan it on every use: %m", storage->path);
         }
 
+        r = journal_directory_refresh(storage->directory, ret_used);
+        if (r < 0)
+                return log_full_errno(r == -ENOENT ? LOG_DEBUG : LOG_ERR,
+                                      r, "Failed to determine usage of %s: %m", storage->path);
+
         return 0;
 }
 
@@ -136,7 +146,7 @@ static int cache_space_refresh(Server *s, JournalStorage *storage) {
         if (space->timestamp != 0 && space->timestamp + RECHECK_SPACE_USEC > ts)
                 return 0;
 
-        r = determine_path_usage(s, storage->path, &vfs_used, &vfs_avail);
+        r = determine_path_usage(s, storage, &vfs_used, &vfs_avail);
         if (r < 0)
                 return r;
 
@@ -272,6 +282,8 @@ static int open_journal(
         if (r < 0)
                 return r;
 
+        f->compress_level = s->compress.level;
+
         r = journal_file_enable_post_change_timer(f, s->event, POST_CHANGE_TIMER_INTERVAL_USEC);
         if (r < 0) {
                 (void) journal_file_close(f);
@@ -638,6 +650,11 @@ void server_rotate(Server *s) {
         }
 
         server_process_deferred_closes(s);
+
+        /* We just renamed files behind the back of the directory indexes, and are likely to vacuum right away,
+         * before the inotify events are dispatched. */
+        journal_directory_invalidate(s->runtime_storage.directory);
+        journal_directory_invalidate(s->system_storage.directory);
 }
 
 void server_sync(Server *s) {
@@ -678,9 +695,14 @@ static void do_vacuum(Server *s, JournalStorage *storage, bool verbose) {
         if (verbose)
                 server_space_usage_message(s, storage);
 
-        r = journal_directory_vacuum(storage->path, storage->space.limit,
-                                     storage->metrics.n_max_files, s->max_retention_usec,
-                                     &s->oldest_file_usec, verbose);
+        if (storage->directory)
+                r = journal_directory_vacuum_index(storage->directory, storage->space.limit,
+                                                   storage->metrics.n_max_files, s->max_retention_usec,
+                                                   &s->oldest_file_usec, 1, verbose);
+        else
+                r = journal_directory_vacuum(storage->path, storage->space.limit,
+                                             storage->metrics.n_max_files, s->max_retention_usec,
+                                             &s->oldest_file_usec, verbose);
         if (r < 0 && r != -ENOENT)
                 log_warning_errno(r, "Failed to vacuum %s, ignoring: %m", storage->path);
 
@@ -791,23 +813,32 @@ static bool shall_try_append_again(JournalFile *f, int r) {
         }
 }
 
-static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
+struct PendingEntry {
+        uid_t uid;
+        int priority;
+        dual_timestamp ts;
+        struct iovec *iovec; /* points into the same allocation, after the iovec array itself */
+        size_t n;
+};
+
+static void write_entries_to_journal(Server *s, uid_t uid, const struct PendingEntry *entries, size_t n_entries) {
+        const struct iovec **iovecs;
         bool vacuumed = false, rotate = false;
-        struct dual_timestamp ts;
+        dual_timestamp *ts;
+        unsigned *n_iovecs;
+        uint64_t *offsets;
         JournalFile *f;
+        size_t i, j, k;
         int r;
 
         assert(s);
-        assert(iovec);
-        assert(n > 0);
-
-        /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
-         * the source time, and not even the time the event was originally seen, but instead simply the time we started
-         * processing it, as we want strictly linear ordering in what we write out.) */
-        assert_se(sd_event_now(s->event, CLOCK_REALTIME, &ts.realtime) >= 0);
-        assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &ts.monotonic) >= 0);
+        assert(entries);
+        assert(n_entries > 0);
+        assert(n_entries <= PENDING_ENTRIES_MAX);
 
-        if (ts.realtime < s->last_realtime_clock) {
+        /* All entries are stamped with the time we started processing them, which is the same for all entries
+         * collected during one event loop iteration. */
+        if (entries[0].ts.realtime < s->last_realtime_clock) {
                 /* When the time jumps backwards, let's immediately rotate. Of course, this should not happen during
                  * regular operation. However, when it does happen, then we should make sure that we start fresh files
                  * to ensure that the entries in the journal files are strictly ordered by time, in order to ensure
@@ -837,77 +868,162 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
                         return;
         }
 
-        s->last_realtime_clock = ts.realtime;
+        s->last_realtime_clock = entries[n_entries - 1].ts.realtime;
 
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
-        if (r >= 0) {
-                server_schedule_sync(s, priority);
-                return;
-        }
+        ts = newa(dual_timestamp, n_entries);
+        iovecs = newa(const struct iovec*, n_entries);
+        n_iovecs = newa(unsigned, n_entries);
+        offsets = newa(uint64_t, n_entries);
 
-        if (vacuumed || !shall_try_append_again(f, r)) {
-                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes), ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
-                return;
+        for (i = 0; i < n_entries; i++) {
+                ts[i] = entries[i].ts;
+                iovecs[i] = entries[i].iovec;
+                n_iovecs[i] = entries[i].n;
         }
 
-        server_rotate(s);
-        server_vacuum(s, false);
+        for (i = 0; i < n_entries;) {
+                int priority = LOG_DEBUG;
 
-        f = find_journal(s, uid);
-        if (!f)
-                return;
+                /* Data objects are shared between all entries written in one go, and the file header is updated
+                 * and other readers are notified only once at the end */
+                r = journal_file_append_entries(f, ts + i, NULL, iovecs + i, n_iovecs + i, n_entries - i,
+                                                &s->seqnum, offsets + i, &k);
 
-        log_debug("Retrying write.");
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
-        if (r < 0)
-                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes) despite vacuuming, ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
-        else
-                server_schedule_sync(s, priority);
-}
+                for (j = i; j < i + k; j++) {
+                        server_follow_dispatch(s, f, offsets[j], entries[j].iovec, entries[j].n);
+                        priority = MIN(priority, entries[j].priority);
+                }
+                if (k > 0)
+                        server_schedule_sync(s, priority);
+
+                i += k;
+                if (r >= 0)
+                        break;
+
+                if (!vacuumed && shall_try_append_again(f, r)) {
+                        server_rotate(s);
+                        server_vacuum(s, false);
+                        vacuumed = true;
+
+                        f = find_journal(s, uid);
+                        if (!f)
+                                return;
+
+                        log_debug("Retrying write.");
+                        continue;
+                }
 
-#define IOVEC_ADD_NUMERIC_FIELD(iovec, n, value, type, isset, format, field)  \
-        if (isset(value)) {                                             \
-                char *k;                                                \
-                k = newa(char, STRLEN(field "=") + DECIMAL_STR_MAX(type) + 1); \
-                sprintf(k, field "=" format, value);                    \
-                iovec[n++] = IOVEC_MAKE_STRING(k);                      \
+                /* Skip the entry that failed, and go on with the rest */
+                log_error_errno(r, "Failed to write entry (%zu items, %zu bytes)%s, ignoring: %m",
+                                entries[i].n, IOVEC_TOTAL_SIZE(entries[i].iovec, entries[i].n),
+                                vacuumed ? " despite vacuuming" : "");
+                i++;
         }
+}
+
+static void server_flush_pending_entries(Server *s) {
+        _cleanup_free_ struct PendingEntry *entries = NULL;
+        size_t n_entries, i, j;
+
+        assert(s);
 
-#define IOVEC_ADD_STRING_FIELD(iovec, n, value, field)                  \
-        if (!isempty(value)) {                                          \
-                char *k;                                                \
-                k = strjoina(field "=", value);                         \
-                iovec[n++] = IOVEC_MAKE_STRING(k);                      \
+        /* Writes out the entries collected while processing a batch of datagrams, each run of consecutive
+         * entries for the same journal file with a single call. The queue is taken over first, as rotating and
+         * vacuuming log messages of their own. */
+        entries = TAKE_PTR(s->pending_entries);
+        n_entries = s->n_pending_entries;
+        s->n_pending_entries = s->n_pending_entries_allocated = 0;
+
+        for (i = 0; i < n_entries; i = j) {
+                for (j = i + 1; j < n_entries; j++)
+                        if (entries[j].uid != entries[i].uid)
+                                break;
+
+                write_entries_to_journal(s, entries[i].uid, entries + i, j - i);
         }
 
-#define IOVEC_ADD_ID128_FIELD(iovec, n, value, field)                   \
-        if (!sd_id128_is_null(value)) {                                 \
-                char *k;                                                \
-                k = newa(char, STRLEN(field "=") + SD_ID128_STRING_MAX); \
-                sd_id128_to_string(value, stpcpy(k, field "="));        \
-                iovec[n++] = IOVEC_MAKE_STRING(k);                      \
+        for (i = 0; i < n_entries; i++)
+                free(entries[i].iovec);
+}
+
+static int server_queue_entry(Server *s, const struct PendingEntry *e) {
+        struct iovec *iovec;
+        size_t i;
+        char *p;
+
+        assert(s);
+        assert(e);
+
+        if (s->n_pending_entries >= PENDING_ENTRIES_MAX)
+                server_flush_pending_entries(s);
+
+        if (!GREEDY_REALLOC(s->pending_entries, s->n_pending_entries_allocated, s->n_pending_entries + 1))
+                return -ENOMEM;
+
+        /* The iovecs point into the datagram buffer and to fields on the stack of our caller, hence copy
+         * everything into one allocation */
+        iovec = malloc(sizeof(struct iovec) * e->n + IOVEC_TOTAL_SIZE(e->iovec, e->n));
+        if (!iovec)
+                return -ENOMEM;
+
+        p = (char*) (iovec + e->n);
+        for (i = 0; i < e->n; i++) {
+                iovec[i] = IOVEC_MAKE(p, e->iovec[i].iov_len);
+                p = mempcpy(p, e->iovec[i].iov_base, e->iovec[i].iov_len);
         }
 
-#define IOVEC_ADD_SIZED_FIELD(iovec, n, value, value_size, field)       \
-        if (value_size > 0) {                                           \
-                char *k;                                                \
-                k = newa(char, STRLEN(field "=") + value_size + 1);     \
-                *((char*) mempcpy(stpcpy(k, field "="), value, value_size)) = 0; \
-                iovec[n++] = IOVEC_MAKE_STRING(k);                      \
-        }                                                               \
+        s->pending_entries[s->n_pending_entries++] = (struct PendingEntry) {
+                .uid = e->uid,
+                .priority = e->priority,
+                .ts = e->ts,
+                .iovec = iovec,
+                .n = e->n,
+        };
+
+        return 0;
+}
+
+static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
+        struct PendingEntry e = {
+                .uid = uid,
+                .priority = priority,
+                .iovec = iovec,
+                .n = n,
+        };
+
+        assert(s);
+        assert(iovec);
+        assert(n > 0);
+
+        /* Get the closest, linearized time we have for this log event from the event loop. (Note that we do not use
+         * the source time, and not even the time the event was originally seen, but instead simply the time we started
+         * processing it, as we want strictly linear ordering in what we write out.) */
+        assert_se(sd_event_now(s->event, CLOCK_REALTIME, &e.ts.realtime) >= 0);
+        assert_se(sd_event_now(s->event, CLOCK_MONOTONIC, &e.ts.monotonic) >= 0);
+
+        /* While processing a batch of datagrams, collect the entries and write them out together at the end. If
+         * that doesn't work out, write the entry right away. */
+        if (s->queue_entries && server_queue_entry(s, &e) >= 0)
+                return;
+
+        /* Don't reorder this entry before any queued ones */
+        server_flush_pending_entries(s);
+
+        write_entries_to_journal(s, uid, &e, 1);
+}
 
 static void dispatch_message_real(
                 Server *s,
                 struct iovec *iovec, size_t n, size_t m,
-                const ClientContext *c,
+                ClientContext *c,
                 const struct timeval *tv,
                 int priority,
                 pid_t object_pid) {
 
         char source_time[sizeof("_SOURCE_REALTIME_TIMESTAMP=") + DECIMAL_STR_MAX(usec_t)];
-        _cleanup_free_ char *cmdline1 = NULL, *cmdline2 = NULL;
         uid_t journal_uid;
         ClientContext *o;
+        int r;
 
         assert(s);
         assert(iovec);
@@ -918,32 +1034,17 @@ static void dispatch_message_real(
                client_context_extra_fields_n_iovec(c) <= m);
 
         if (c) {
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, c->pid, pid_t, pid_is_valid, PID_FMT, "_PID");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, c->uid, uid_t, uid_is_valid, UID_FMT, "_UID");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, c->gid, gid_t, gid_is_valid, GID_FMT, "_GID");
+                const struct iovec *fields;
+                size_t n_fields;
 
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->comm, "_COMM"); /* At most TASK_COMM_LENGTH (16 bytes) */
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->exe, "_EXE"); /* A path, so at most PATH_MAX (4096 bytes) */
-
-                if (c->cmdline)
-                        /* At most _SC_ARG_MAX (2MB usually), which is too much to put on stack.
-                         * Let's use a heap allocation for this one. */
-                        cmdline1 = set_iovec_string_field(iovec, &n, "_CMDLINE=", c->cmdline);
-
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->capeff, "_CAP_EFFECTIVE"); /* Read from /proc/.../status */
-                IOVEC_ADD_SIZED_FIELD(iovec, n, c->label, c->label_size, "_SELINUX_CONTEXT");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, c->auditid, uint32_t, audit_session_is_valid, "%" PRIu32, "_AUDIT_SESSION");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, c->loginuid, uid_t, uid_is_valid, UID_FMT, "_AUDIT_LOGINUID");
-
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->cgroup, "_SYSTEMD_CGROUP"); /* A path */
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->session, "_SYSTEMD_SESSION");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, c->owner_uid, uid_t, uid_is_valid, UID_FMT, "_SYSTEMD_OWNER_UID");
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->unit, "_SYSTEMD_UNIT"); /* Unit names are bounded by UNIT_NAME_MAX */
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->user_unit, "_SYSTEMD_USER_UNIT");
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->slice, "_SYSTEMD_SLICE");
-                IOVEC_ADD_STRING_FIELD(iovec, n, c->user_slice, "_SYSTEMD_USER_SLICE");
-
-                IOVEC_ADD_ID128_FIELD(iovec, n, c->invocation_id, "_SYSTEMD_INVOCATION_ID");
+                /* The trusted fields are rendered once per context, and reused until it is refreshed */
+                r = client_context_get_trusted_fields(c, false, &fields, &n_fields);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to render trusted fields of client context, ignoring: %m");
+                else {
+                        memcpy(iovec + n, fields, n_fields * sizeof(struct iovec));
+                        n += n_fields;
+                }
 
                 if (c->extra_fields_n_iovec > 0) {
                         memcpy(iovec + n, c->extra_fields_iovec, c->extra_fields_n_iovec * sizeof(struct iovec));
@@ -954,31 +1055,16 @@ static void dispatch_message_real(
         assert(n <= m);
 
         if (pid_is_valid(object_pid) && client_context_get(s, object_pid, NULL, NULL, 0, NULL, &o) >= 0) {
+                const struct iovec *fields;
+                size_t n_fields;
 
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, o->pid, pid_t, pid_is_valid, PID_FMT, "OBJECT_PID");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, o->uid, uid_t, uid_is_valid, UID_FMT, "OBJECT_UID");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, o->gid, gid_t, gid_is_valid, GID_FMT, "OBJECT_GID");
-
-                /* See above for size limits, only ->cmdline may be large, so use a heap allocation for it. */
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->comm, "OBJECT_COMM");
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->exe, "OBJECT_EXE");
-                if (o->cmdline)
-                        cmdline2 = set_iovec_string_field(iovec, &n, "OBJECT_CMDLINE=", o->cmdline);
-
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->capeff, "OBJECT_CAP_EFFECTIVE");
-                IOVEC_ADD_SIZED_FIELD(iovec, n, o->label, o->label_size, "OBJECT_SELINUX_CONTEXT");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, o->auditid, uint32_t, audit_session_is_valid, "%" PRIu32, "OBJECT_AUDIT_SESSION");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, o->loginuid, uid_t, uid_is_valid, UID_FMT, "OBJECT_AUDIT_LOGINUID");
-
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->cgroup, "OBJECT_SYSTEMD_CGROUP");
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->session, "OBJECT_SYSTEMD_SESSION");
-                IOVEC_ADD_NUMERIC_FIELD(iovec, n, o->owner_uid, uid_t, uid_is_valid, UID_FMT, "OBJECT_SYSTEMD_OWNER_UID");
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->unit, "OBJECT_SYSTEMD_UNIT");
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->user_unit, "OBJECT_SYSTEMD_USER_UNIT");
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->slice, "OBJECT_SYSTEMD_SLICE");
-                IOVEC_ADD_STRING_FIELD(iovec, n, o->user_slice, "OBJECT_SYSTEMD_USER_SLICE");
-
-                IOVEC_ADD_ID128_FIELD(iovec, n, o->invocation_id, "OBJECT_SYSTEMD_INVOCATION_ID=");
+                r = client_context_get_trusted_fields(o, true, &fields, &n_fields);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to render object fields of client context, ignoring: %m");
+                else {
+                        memcpy(iovec + n, fields, n_fields * sizeof(struct iovec));
+                        n += n_fields;
+                }
         }
 
         assert(n <= m);
@@ -1076,6 +1162,7 @@ void server_dispatch_message(
                 pid_t object_pid) {
 
         uint64_t available = 0;
+        const char *id;
         int rl;
 
         assert(s);
@@ -1092,10 +1179,11 @@ void server_dispatch_message(
         if (s->storage == STORAGE_NONE)
                 return;
 
-        if (c && c->unit) {
+        id = client_context_rate_limit_id(c);
+        if (id) {
                 (void) determine_space(s, &available, NULL);
 
-                rl = journal_rate_limit_test(s->rate_limit, c->unit, c->log_rate_limit_interval, c->log_rate_limit_burst, priority & LOG_PRIMASK, available);
+                rl = journal_rate_limit_test(s->rate_limit, id, c->log_rate_limit_interval, c->log_rate_limit_burst, priority & LOG_PRIMASK, available);
                 if (rl == 0)
                         return;
 
@@ -1103,14 +1191,38 @@ void server_dispatch_message(
                 if (rl > 1)
                         server_driver_message(s, c->pid,
                                               "MESSAGE_ID=" SD_MESSAGE_JOURNAL_DROPPED_STR,
-                                              LOG_MESSAGE("Suppressed %i messages from %s", rl - 1, c->unit),
+                                              LOG_MESSAGE("Suppressed %i messages from %s", rl - 1, c->unit ?: id),
                                               "N_DROPPED=%i", rl - 1,
+                                              "N_DROPPED_TOTAL=%" PRIu64, journal_rate_limit_get_suppressed(s->rate_limit),
                                               NULL);
         }
 
         dispatch_message_real(s, iovec, n, m, c, tv, priority, object_pid);
 }
 
+bool server_rate_limit_early_reject(Server *s, const struct ucred *ucred) {
+        const char *id;
+        ClientContext *c;
+
+        assert(s);
+
+        /* Drops messages from peers that are currently rate limited before we spend any time on them. Only
+         * looks at what is already cached, so that this stays cheap. */
+
+        if (s->storage == STORAGE_NONE)
+                return false;
+
+        c = client_context_peek(s, ucred);
+        id = client_context_rate_limit_id(c);
+        if (!id)
+                return false;
+
+        if (c->log_rate_limit_interval == 0 || c->log_rate_limit_burst == 0)
+                return false;
+
+        return journal_rate_limit_early_reject(s->rate_limit, id);
+}
+
 int server_flush_to_var(Server *s, bool require_flag_file) {
         sd_id128_t machine;
         sd_journal *j = NULL;
@@ -1212,76 +1324,56 @@ finish:
         return r;
 }
 
-int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
-        Server *s = userdata;
+typedef union DatagramControl {
+        struct cmsghdr cmsghdr;
+
+        /* We use NAME_MAX space for the SELinux label
+         * here. The kernel currently enforces no
+         * limit, but according to suggestions from
+         * the SELinux people this will change and it
+         * will probably be identical to NAME_MAX. For
+         * now we use that, but this should be updated
+         * one day when the final limit is known. */
+        uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) +
+                    CMSG_SPACE(sizeof(struct timeval)) +
+                    CMSG_SPACE(sizeof(int)) + /* fd */
+                    CMSG_SPACE(NAME_MAX)]; /* selinux label */
+} DatagramControl;
+
+struct DatagramSlot {
+        struct iovec iovec;
+        DatagramControl control;
+        union sockaddr_union sa;
+};
+
+static size_t datagram_buffer_size(size_t next) {
+        /* Fix it up, if it is too small. We use the same fixed value as auditd here. Awful! */
+        return PAGE_ALIGN(MAX3(next + 1,
+                               (size_t) LINE_MAX,
+                               ALIGN(sizeof(struct nlmsghdr)) + ALIGN((size_t) MAX_AUDIT_MESSAGE_LENGTH)) + 1);
+}
+
+static void server_dispatch_datagram(
+                Server *s,
+                int fd,
+                char *buffer,
+                size_t n,
+                bool truncated,
+                struct msghdr *msghdr) {
+
         struct ucred *ucred = NULL;
         struct timeval *tv = NULL;
         struct cmsghdr *cmsg;
         char *label = NULL;
-        size_t label_len = 0, m;
-        struct iovec iovec;
-        ssize_t n;
-        int *fds = NULL, v = 0;
+        size_t label_len = 0;
+        int *fds = NULL;
         size_t n_fds = 0;
 
-        union {
-                struct cmsghdr cmsghdr;
-
-                /* We use NAME_MAX space for the SELinux label
-                 * here. The kernel currently enforces no
-                 * limit, but according to suggestions from
-                 * the SELinux people this will change and it
-                 * will probably be identical to NAME_MAX. For
-                 * now we use that, but this should be updated
-                 * one day when the final limit is known. */
-                uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) +
-                            CMSG_SPACE(sizeof(struct timeval)) +
-                            CMSG_SPACE(sizeof(int)) + /* fd */
-                            CMSG_SPACE(NAME_MAX)]; /* selinux label */
-        } control = {};
-
-        union sockaddr_union sa = {};
-
-        struct msghdr msghdr = {
-                .msg_iov = &iovec,
-                .msg_iovlen = 1,
-                .msg_control = &control,
-                .msg_controllen = sizeof(control),
-                .msg_name = &sa,
-                .msg_namelen = sizeof(sa),
-        };
-
         assert(s);
-        assert(fd == s->native_fd || fd == s->syslog_fd || fd == s->audit_fd);
-
-        if (revents != EPOLLIN)
-                return log_error_errno(SYNTHETIC_ERRNO(EIO),
-                                       "Got invalid event from epoll for datagram fd: %" PRIx32,
-                                       revents);
-
-        /* Try to get the right size, if we can. (Not all sockets support SIOCINQ, hence we just try, but don't rely on
-         * it.) */
-        (void) ioctl(fd, SIOCINQ, &v);
-
-        /* Fix it up, if it is too small. We use the same fixed value as auditd here. Awful! */
-        m = PAGE_ALIGN(MAX3((size_t) v + 1,
-                            (size_t) LINE_MAX,
-                            ALIGN(sizeof(struct nlmsghdr)) + ALIGN((size_t) MAX_AUDIT_MESSAGE_LENGTH)) + 1);
+        assert(buffer);
+        assert(msghdr);
 
-        if (!GREEDY_REALLOC(s->buffer, s->buffer_size, m))
-                return log_oom();
-
-        iovec = IOVEC_MAKE(s->buffer, s->buffer_size - 1); /* Leave room for trailing NUL we add later */
-
-        n = recvmsg(fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
-        if (n < 0) {
-                if (IN_SET(errno, EINTR, EAGAIN))
-                        return 0;
-
-                return log_error_errno(errno, "recvmsg() failed: %m");
-        }
-
-        CMSG_FOREACH(cmsg, &msghdr)
+        CMSG_FOREACH(cmsg, msghdr)
                 if (cmsg->cmsg_level == SOL_SOCKET &&
                     cmsg->cmsg_type == SCM_CREDENTIALS &&
                     cmsg->cmsg_len == CMSG_LEN(sizeof(struct ucred)))
@@ -1300,18 +1392,24 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
                         n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
                 }
 
+        if (truncated) {
+                /* This can only happen when reading in batches, for datagrams beyond RECEIVE_DATAGRAM_SIZE_MAX */
+                log_warning("Got datagram of %zu bytes in batch, larger than the receive buffer, ignoring.", n);
+                goto finish;
+        }
+
         /* And a trailing NUL, just in case */
-        s->buffer[n] = 0;
+        buffer[n] = 0;
 
         if (fd == s->syslog_fd) {
                 if (n > 0 && n_fds == 0)
-                        server_process_syslog_message(s, s->buffer, n, ucred, tv, label, label_len);
+                        server_process_syslog_message(s, buffer, n, ucred, tv, label, label_len);
                 else if (n_fds > 0)
                         log_warning("Got file descriptors via syslog socket. Ignoring.");
 
         } else if (fd == s->native_fd) {
                 if (n > 0 && n_fds == 0)
-                        server_process_native_message(s, s->buffer, n, ucred, tv, label, label_len);
+                        server_process_native_message(s, buffer, n, ucred, tv, label, label_len);
                 else if (n == 0 && n_fds == 1)
                         server_process_native_file(s, fds[0], ucred, tv, label, label_len);
                 else if (n_fds > 0)
@@ -1321,15 +1419,189 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
                 assert(fd == s->audit_fd);
 
                 if (n > 0 && n_fds == 0)
-                        server_process_audit_message(s, s->buffer, n, ucred, &sa, msghdr.msg_namelen);
+                        server_process_audit_message(s, buffer, n, ucred, msghdr->msg_name, msghdr->msg_namelen);
                 else if (n_fds > 0)
                         log_warning("Got file descriptors via audit socket. Ignoring.");
         }
 
+finish:
         close_many(fds, n_fds);
+}
+
+static int server_process_datagram_single(Server *s, int fd) {
+        DatagramControl control = {};
+        union sockaddr_union sa = {};
+        struct iovec iovec;
+        ssize_t n;
+        size_t m;
+        int v = 0;
+
+        struct msghdr msghdr = {
+                .msg_iov = &iovec,
+                .msg_iovlen = 1,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+                .msg_name = &sa,
+                .msg_namelen = sizeof(sa),
+        };
+
+        assert(s);
+
+        /* Try to get the right size, if we can. (Not all sockets support SIOCINQ, hence we just try, but don't rely on
+         * it.) */
+        (void) ioctl(fd, SIOCINQ, &v);
+
+        m = datagram_buffer_size((size_t) v);
+        if (!GREEDY_REALLOC(s->buffer, s->buffer_size, m))
+                return log_oom();
+
+        iovec = IOVEC_MAKE(s->buffer, s->buffer_size - 1); /* Leave room for trailing NUL we add later */
+
+        n = recvmsg(fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
+        if (n < 0) {
+                if (IN_SET(errno, EINTR, EAGAIN))
+                        return 0;
+
+                return log_error_errno(errno, "recvmsg() failed: %m");
+        }
+
+        server_dispatch_datagram(s, fd, s->buffer, n, false, &msghdr);
+        return 0;
+}
+
+int server_receive_datagram_batch(Server *s, int fd) {
+        size_t i;
+        int k;
+
+        assert(s);
+        assert(s->receive_batch_size > 1);
+        assert(s->receive_batch_size <= RECEIVE_BATCH_SIZE_MAX);
+
+        /* Receives up to receive_batch_size datagrams into s->receive_batch with a single recvmmsg() call, and
+         * returns how many it got. Each datagram is read into its own RECEIVE_DATAGRAM_SIZE_MAX sized part of one
+         * large mapping, which is reserved, but not backed by memory until written to. Hence even large native
+         * and syslog messages arrive in full, without peeking at the queue first, while the common small ones only
+         * touch a page or two. */
+
+        if (!s->receive_batch) {
+                s->receive_batch = new0(struct mmsghdr, s->receive_batch_size);
+                if (!s->receive_batch)
+                        return log_oom();
+        }
+
+        if (!s->receive_slots) {
+                s->receive_slots = new0(struct DatagramSlot, s->receive_batch_size);
+                if (!s->receive_slots)
+                        return log_oom();
+        }
+
+        if (!s->receive_buffer) {
+                void *p;
+
+                p = mmap(NULL, (size_t) RECEIVE_DATAGRAM_SIZE_MAX * s->receive_batch_size, PROT_READ|PROT_WRITE,
+                         MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+                if (p == MAP_FAILED)
+                        return log_debug_errno(errno, "Failed to reserve receive buffers: %m");
+
+                s->receive_buffer = p;
+                s->receive_buffer_size = (size_t) RECEIVE_DATAGRAM_SIZE_MAX * s->receive_batch_size;
+        }
+
+        for (i = 0; i < s->receive_batch_size; i++) {
+                struct DatagramSlot *slot = s->receive_slots + i;
+
+                /* Leave room for trailing NUL */
+                slot->iovec = IOVEC_MAKE(s->receive_buffer + i * RECEIVE_DATAGRAM_SIZE_MAX, RECEIVE_DATAGRAM_SIZE_MAX - 1);
+
+                s->receive_batch[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = &slot->iovec,
+                                .msg_iovlen = 1,
+                                .msg_control = &slot->control,
+                                .msg_controllen = sizeof(slot->control),
+                                .msg_name = &slot->sa,
+                                .msg_namelen = sizeof(slot->sa),
+                        },
+                };
+        }
+
+        /* With MSG_TRUNC, the full length of truncated datagrams is returned */
+        k = recvmmsg(fd, s->receive_batch, s->receive_batch_size, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC, NULL);
+        if (k < 0) {
+                if (IN_SET(errno, EINTR, EAGAIN))
+                        return 0;
+
+                return log_error_errno(errno, "recvmmsg() failed: %m");
+        }
+
+        return k;
+}
+
+static void server_release_datagram_batch(Server *s, size_t n) {
+        size_t m, i;
+
+        assert(s);
+
+        /* Give back the memory that large datagrams took up in their part of the mapping, beyond what common ones
+         * need. That is one syscall per large datagram, which is cheap next to reading and processing it. */
+
+        m = datagram_buffer_size(0);
+
+        for (i = 0; i < n; i++)
+                if (s->receive_batch[i].msg_len >= m)
+                        (void) madvise(s->receive_buffer + i * RECEIVE_DATAGRAM_SIZE_MAX + m,
+                                       RECEIVE_DATAGRAM_SIZE_MAX - m, MADV_DONTNEED);
+}
+
+static int server_process_datagram_batch(Server *s, int fd) {
+        size_t i;
+        int k;
+
+        assert(s);
+
+        k = server_receive_datagram_batch(s, fd);
+        if (k == -ENOMEM && !s->receive_buffer)
+                /* Without room for the batch, fall back to reading a single datagram */
+                return server_process_datagram_single(s, fd);
+        if (k < 0)
+                return k;
+
+        /* Write the entries for the whole batch to the journal in one go */
+        s->queue_entries = k > 1;
+
+        for (i = 0; i < (size_t) k; i++) {
+                struct mmsghdr *h = s->receive_batch + i;
+
+                server_dispatch_datagram(s, fd, h->msg_hdr.msg_iov->iov_base, h->msg_len,
+                                         FLAGS_SET(h->msg_hdr.msg_flags, MSG_TRUNC),
+                                         &h->msg_hdr);
+        }
+
+        s->queue_entries = false;
+        server_flush_pending_entries(s);
+
+        server_release_datagram_batch(s, k);
         return 0;
 }
 
+int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+        assert(fd == s->native_fd || fd == s->syslog_fd || fd == s->audit_fd);
+
+        if (revents != EPOLLIN)
+                return log_error_errno(SYNTHETIC_ERRNO(EIO),
+                                       "Got invalid event from epoll for datagram fd: %" PRIx32,
+                                       revents);
+
+        /* Read a batch of datagrams at once if so configured */
+        if (s->receive_batch_size > 1)
+                return server_process_datagram_batch(s, fd);
+
+        return server_process_datagram_single(s, fd);
+}
+
 static int dispatch_sigusr1(sd_event_source *es, const struct signalfd_siginfo *si, void *userdata) {
         Server *s = userdata;
         int r;
@@ -1821,7 +2093,7 @@ int server_init(Server *s) {
         assert(s);
 
         zero(*s);
-        s->syslog_fd = s->native_fd = s->stdout_fd = s->dev_kmsg_fd = s->audit_fd = s->hostname_fd = s->notify_fd = -1;
+        s->syslog_fd = s->native_fd = s->stdout_fd = s->dev_kmsg_fd = s->audit_fd = s->hostname_fd = s->notify_fd = s->follow_fd = -1;
         s->compress.enabled = true;
         s->compress.threshold_bytes = (uint64_t) -1;
         s->seal = true;
@@ -1846,6 +2118,7 @@ int server_init(Server *s) {
         s->max_level_wall = LOG_EMERG;
 
         s->line_max = DEFAULT_LINE_MAX;
+        s->receive_batch_size = 1;
 
         journal_reset_metrics(&s->system_storage.metrics);
         journal_reset_metrics(&s->runtime_storage.metrics);
@@ -1856,6 +2129,13 @@ int server_init(Server *s) {
         if (r < 0)
                 log_warning_errno(r, "Failed to parse kernel command line, ignoring: %m");
 
+        if (s->receive_batch_size == 0)
+                s->receive_batch_size = 1;
+        else if (s->receive_batch_size > RECEIVE_BATCH_SIZE_MAX) {
+                log_debug("Clamping ReceiveBatchSize= from %u to %u", s->receive_batch_size, RECEIVE_BATCH_SIZE_MAX);
+                s->receive_batch_size = RECEIVE_BATCH_SIZE_MAX;
+        }
+
         if (!!s->rate_limit_interval ^ !!s->rate_limit_burst) {
                 log_debug("Setting both rate limit interval and burst from "USEC_FMT",%u to 0,0",
                           s->rate_limit_interval, s->rate_limit_burst);
@@ -1902,6 +2182,14 @@ int server_init(Server *s) {
 
                         s->stdout_fd = fd;
 
+                } else if (sd_is_socket_unix(fd, SOCK_STREAM, 1, "/run/systemd/journal/follow", 0) > 0) {
+
+                        if (s->follow_fd >= 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Too many follow sockets passed.");
+
+                        s->follow_fd = fd;
+
                 } else if (sd_is_socket_unix(fd, SOCK_DGRAM, -1, "/dev/log", 0) > 0 ||
                            sd_is_socket_unix(fd, SOCK_DGRAM, -1, "/run/systemd/journal/dev-log", 0) > 0) {
 
@@ -1950,6 +2238,11 @@ int server_init(Server *s) {
         if (r < 0)
                 return r;
 
+        /* /run/systemd/journal/follow */
+        r = server_open_follow_socket(s);
+        if (r < 0)
+                return r;
+
         /* systemd-journald-dev-log.socket: /run/systemd/journal/dev-log */
         r = server_open_syslog_socket(s);
         if (r < 0)
@@ -2035,6 +2328,9 @@ void server_done(Server *s) {
         while (s->stdout_streams)
                 stdout_stream_free(s->stdout_streams);
 
+        while (s->followers)
+                follower_free(s->followers);
+
         client_context_flush_all(s);
 
         if (s->system_journal)
@@ -2059,6 +2355,7 @@ void server_done(Server *s) {
         sd_event_source_unref(s->hostname_event_source);
         sd_event_source_unref(s->notify_event_source);
         sd_event_source_unref(s->watchdog_event_source);
+        sd_event_source_unref(s->follow_event_source);
         sd_event_unref(s->event);
 
         safe_close(s->syslog_fd);
@@ -2068,6 +2365,7 @@ void server_done(Server *s) {
         safe_close(s->audit_fd);
         safe_close(s->hostname_fd);
         safe_close(s->notify_fd);
+        safe_close(s->follow_fd);
 
         if (s->rate_limit)
                 journal_rate_limit_free(s->rate_limit);
@@ -2076,11 +2374,18 @@ void server_done(Server *s) {
                 munmap(s->kernel_seqnum, sizeof(uint64_t));
 
         free(s->buffer);
+        free(s->receive_batch);
+        free(s->receive_slots);
+        if (s->receive_buffer)
+                munmap(s->receive_buffer, s->receive_buffer_size);
+        free(s->pending_entries);
         free(s->tty_path);
         free(s->cgroup_root);
         free(s->hostname_field);
         free(s->runtime_storage.path);
         free(s->system_storage.path);
+        journal_directory_free(s->runtime_storage.directory);
+        journal_directory_free(s->system_storage.directory);
 
         if (s->mmap)
                 mmap_cache_unref(s->mmap);
@@ -11,7 +11,9 @@ typedef struct Server Server;
 #include "conf-parser.h"
 #include "hashmap.h"
 #include "journal-file.h"
+#include "journal-vacuum.h"
 #include "journald-context.h"
+#include "journald-follow.h"
 #include "journald-rate-limit.h"
 #include "journald-stream.h"
 #include "list.h"
@@ -37,6 +39,7 @@ typedef enum SplitMode {
 typedef struct JournalCompressOptions {
         bool enabled;
         uint64_t threshold_bytes;
+        int level;
 } JournalCompressOptions;
 
 typedef struct JournalStorageSpace {
@@ -55,6 +58,8 @@ typedef struct JournalStorage {
 
         JournalMetrics metrics;
         JournalStorageSpace space;
+
+        JournalDirectory *directory; /* index of the journal files in path */
 } JournalStorage;
 
 struct Server {
@@ -65,6 +70,7 @@ struct Server {
         int audit_fd;
         int hostname_fd;
         int notify_fd;
+        int follow_fd;
 
         sd_event *event;
 
@@ -82,6 +88,7 @@ struct Server {
         sd_event_source *hostname_event_source;
         sd_event_source *notify_event_source;
         sd_event_source *watchdog_event_source;
+        sd_event_source *follow_event_source;
 
         JournalFile *runtime_journal;
         JournalFile *system_journal;
@@ -92,6 +99,18 @@ struct Server {
         char *buffer;
         size_t buffer_size;
 
+        /* Used when reading datagrams in batches, see ReceiveBatchSize= */
+        unsigned receive_batch_size;
+        struct mmsghdr *receive_batch;
+        struct DatagramSlot *receive_slots;
+        char *receive_buffer; /* mapped, receive_buffer_size bytes */
+        size_t receive_buffer_size;
+
+        /* Entries collected while processing a batch, written out together at its end */
+        bool queue_entries;
+        struct PendingEntry *pending_entries;
+        size_t n_pending_entries, n_pending_entries_allocated;
+
         JournalRateLimit *rate_limit;
         usec_t sync_interval_usec;
         usec_t rate_limit_interval;
@@ -122,6 +141,10 @@ struct Server {
         LIST_HEAD(StdoutStream, stdout_streams_notify_queue);
         unsigned n_stdout_streams;
 
+        LIST_HEAD(Follower, followers);
+        unsigned n_followers;
+        size_t follow_queued; /* bytes queued for all followers together */
+
         char *tty_path;
 
         int max_level_store;
@@ -183,6 +206,7 @@ struct Server {
 #define N_IOVEC_UDEV_FIELDS 32
 
 void server_dispatch_message(Server *s, struct iovec *iovec, size_t n, size_t m, ClientContext *c, const struct timeval *tv, int priority, pid_t object_pid);
+bool server_rate_limit_early_reject(Server *s, const struct ucred *ucred);
 void server_driver_message(Server *s, pid_t object_pid, const char *message_id, const char *format, ...) _sentinel_ _printf_(4,0);
 
 /* gperf lookup function */
@@ -209,4 +233,5 @@ int server_schedule_sync(Server *s, int priority);
 int server_flush_to_var(Server *s, bool require_flag_file);
 void server_maybe_append_tags(Server *s);
 int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata);
+int server_receive_datagram_batch(Server *s, int fd);
 void server_space_usage_message(Server *s, JournalStorage *storage);
@@ -37,6 +37,15 @@
 
 #define STDOUT_STREAMS_MAX 4096
 
+/* Streams that fill their buffer with a read() get a bigger one for the next, up to this (or LineMax=, if that's
+ * larger), so that services writing a lot to stdout are served with fewer wakeups. Quiet streams keep a small one. */
+#define STDOUT_STREAM_READ_MAX (256U*1024U)
+
+/* Every line in the buffer is preceded by this much scratch space: either room reserved at the beginning of the
+ * buffer, or the tail of the line before it, which has been processed already. This allows us to prepend the field
+ * name to the line in place instead of copying it. */
+#define STDOUT_STREAM_HEADROOM STRLEN("MESSAGE=")
+
 typedef enum StdoutStreamState {
         STDOUT_STREAM_IDENTIFIER,
         STDOUT_STREAM_UNIT_ID,
@@ -76,10 +85,14 @@ struct StdoutStream {
 
         bool fdstore:1;
         bool in_notify_queue:1;
+        bool context_refreshed:1;
+
+        char *syslog_identifier;
 
         char *buffer;
         size_t length;
         size_t allocated;
+        size_t read_size;
 
         sd_event_source *event_source;
 
@@ -118,6 +131,7 @@ void stdout_stream_free(StdoutStream *s) {
         safe_close(s->fd);
         free(s->label);
         free(s->identifier);
+        free(s->syslog_identifier);
         free(s->unit_id);
         free(s->state_file);
         free(s->buffer);
@@ -235,30 +249,37 @@ fail:
         return log_error_errno(r, "Failed to save stream data %s: %m", s->state_file);
 }
 
-static int stdout_stream_log(StdoutStream *s, const char *p, LineBreak line_break) {
+static int stdout_stream_log(StdoutStream *s, char *p, LineBreak line_break) {
         struct iovec *iovec;
         int priority;
         char syslog_priority[] = "PRIORITY=\0";
         char syslog_facility[STRLEN("SYSLOG_FACILITY=") + DECIMAL_STR_MAX(int) + 1];
-        _cleanup_free_ char *message = NULL, *syslog_identifier = NULL;
+        char *message;
         size_t n = 0, m;
         int r;
 
         assert(s);
         assert(p);
 
-        if (s->context)
-                (void) client_context_maybe_refresh(s->server, s->context, NULL, NULL, 0, NULL, USEC_INFINITY);
-        else if (pid_is_valid(s->ucred.pid)) {
-                r = client_context_acquire(s->server, s->ucred.pid, &s->ucred, s->label, strlen_ptr(s->label), s->unit_id, &s->context);
-                if (r < 0)
-                        log_warning_errno(r, "Failed to acquire client context, ignoring: %m");
+        /* Note that p must be preceded by STDOUT_STREAM_HEADROOM bytes we may overwrite. */
+
+        /* All lines from one read() share the same client context, hence only look at it once per batch */
+        if (!s->context_refreshed) {
+                if (s->context)
+                        (void) client_context_maybe_refresh(s->server, s->context, NULL, NULL, 0, NULL, USEC_INFINITY);
+                else if (pid_is_valid(s->ucred.pid)) {
+                        r = client_context_acquire(s->server, s->ucred.pid, &s->ucred, s->label, strlen_ptr(s->label), s->unit_id, &s->context);
+                        if (r < 0)
+                                log_warning_errno(r, "Failed to acquire client context, ignoring: %m");
+                }
+
+                s->context_refreshed = true;
         }
 
         priority = s->priority;
 
         if (s->level_prefix)
-                syslog_parse_priority(&p, &priority, false);
+                syslog_parse_priority((const char**) &p, &priority, false);
 
         if (!client_context_test_priority(s->context, priority))
                 return 0;
@@ -293,9 +314,10 @@ static int stdout_stream_log(StdoutStream *s, const char *p, LineBreak line_brea
         }
 
         if (s->identifier) {
-                syslog_identifier = strappend("SYSLOG_IDENTIFIER=", s->identifier);
-                if (syslog_identifier)
-                        iovec[n++] = IOVEC_MAKE_STRING(syslog_identifier);
+                if (!s->syslog_identifier)
+                        s->syslog_identifier = strappend("SYSLOG_IDENTIFIER=", s->identifier);
+                if (s->syslog_identifier)
+                        iovec[n++] = IOVEC_MAKE_STRING(s->syslog_identifier);
         }
 
         if (line_break != LINE_BREAK_NEWLINE) {
@@ -310,9 +332,8 @@ static int stdout_stream_log(StdoutStream *s, const char *p, LineBreak line_brea
                 iovec[n++] = IOVEC_MAKE_STRING(c);
         }
 
-        message = strappend("MESSAGE=", p);
-        if (message)
-                iovec[n++] = IOVEC_MAKE_STRING(message);
+        message = memcpy(p - STRLEN("MESSAGE="), "MESSAGE=", STRLEN("MESSAGE="));
+        iovec[n++] = IOVEC_MAKE_STRING(message);
 
         server_dispatch_message(s->server, iovec, n, m, s->context, NULL, priority, 0);
         return 0;
@@ -429,18 +450,23 @@ static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
 
         assert(s);
 
-        p = s->buffer;
+        p = s->buffer + STDOUT_STREAM_HEADROOM;
         remaining = s->length;
 
+        s->context_refreshed = false;
+
         /* XXX: This function does nothing if (s->length == 0) */
 
         for (;;) {
                 LineBreak line_break;
-                size_t skip;
-                char *end1, *end2;
+                size_t skip, n;
+                char *end1, *end2, saved = 0;
+
+                /* The buffer might hold more than the maximum line length, don't look further than that */
+                n = MIN(remaining, s->server->line_max);
 
-                end1 = memchr(p, '\n', remaining);
-                end2 = memchr(p, 0, end1 ? (size_t) (end1 - p) : remaining);
+                end1 = memchr(p, '\n', n);
+                end2 = memchr(p, 0, end1 ? (size_t) (end1 - p) : n);
 
                 if (end2) {
                         /* We found a NUL terminator */
@@ -452,14 +478,18 @@ static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
                         skip = end1 - p + 1;
                         line_break = LINE_BREAK_NEWLINE;
                 } else if (remaining >= s->server->line_max) {
-                        /* Force a line break after the maximum line length */
-                        *(p + s->server->line_max) = 0;
-                        skip = remaining;
+                        /* Force a line break after the maximum line length. Remember what we overwrite with the
+                         * terminating NUL, it's the beginning of the next line. */
+                        saved = p[s->server->line_max];
+                        p[s->server->line_max] = 0;
+                        skip = s->server->line_max;
                         line_break = LINE_BREAK_LINE_MAX;
                 } else
                         break;
 
                 r = stdout_stream_line(s, p, line_break);
+                if (line_break == LINE_BREAK_LINE_MAX)
+                        p[s->server->line_max] = saved;
                 if (r < 0)
                         return r;
 
@@ -477,17 +507,37 @@ static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
                 remaining = 0;
         }
 
-        if (p > s->buffer) {
-                memmove(s->buffer, p, remaining);
+        if (p > s->buffer + STDOUT_STREAM_HEADROOM) {
+                memmove(s->buffer + STDOUT_STREAM_HEADROOM, p, remaining);
                 s->length = remaining;
         }
 
         return 0;
 }
 
+static void stdout_stream_shrink_buffer(StdoutStream *s) {
+        size_t want;
+        char *b;
+
+        assert(s);
+
+        /* Don't hold on to a large buffer after a burst, there might be many streams. Give back memory once we
+         * use less than half of it, keeping room for what's left in it and what we expect to read next. */
+        want = STDOUT_STREAM_HEADROOM + MAX(s->length + 1024, s->read_size) + 1;
+        if (s->allocated <= want * 2)
+                return;
+
+        b = realloc(s->buffer, want);
+        if (!b)
+                return;
+
+        s->buffer = b;
+        s->allocated = want;
+}
+
 static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         StdoutStream *s = userdata;
-        size_t limit;
+        size_t limit, want, max;
         ssize_t l;
         int r;
 
@@ -498,19 +548,23 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
                 goto terminate;
         }
 
-        /* If the buffer is full already (discounting the extra NUL we need), add room for another 1K */
-        if (s->length + 1 >= s->allocated) {
-                if (!GREEDY_REALLOC(s->buffer, s->allocated, s->length + 1 + 1024)) {
+        max = MAX(s->server->line_max, STDOUT_STREAM_READ_MAX);
+
+        /* Make sure there's room for at least another 1K, or for as much as the previous read() suggested, in
+         * addition to the headroom and the extra NUL we need */
+        want = MIN(MAX(s->length + 1024, s->read_size), max);
+        if (STDOUT_STREAM_HEADROOM + want + 1 > s->allocated) {
+                if (!GREEDY_REALLOC(s->buffer, s->allocated, STDOUT_STREAM_HEADROOM + want + 1)) {
                         log_oom();
                         goto terminate;
                 }
         }
 
-        /* Try to make use of the allocated buffer in full, but never read more than the configured line size. Also,
-         * always leave room for a terminating NUL we might need to add. */
-        limit = MIN(s->allocated - 1, s->server->line_max);
+        /* Try to make use of the allocated buffer in full. Also, always leave room for a terminating NUL we might
+         * need to add. */
+        limit = MIN(s->allocated - STDOUT_STREAM_HEADROOM - 1, max);
 
-        l = read(s->fd, s->buffer + s->length, limit - s->length);
+        l = read(s->fd, s->buffer + STDOUT_STREAM_HEADROOM + s->length, limit - s->length);
         if (l < 0) {
                 if (errno == EAGAIN)
                         return 0;
@@ -524,11 +578,20 @@ static int stdout_stream_process(sd_event_source *es, int fd, uint32_t revents,
                 goto terminate;
         }
 
+        /* We filled the buffer, there's probably more where this came from. Read more at a time next time. If
+         * we didn't, the burst is over, and we go back to smaller reads step by step. */
+        if ((size_t) l == limit - s->length)
+                s->read_size = MIN(limit * 2, max);
+        else
+                s->read_size /= 2;
+
         s->length += l;
         r = stdout_stream_scan(s, false);
         if (r < 0)
                 goto terminate;
 
+        stdout_stream_shrink_buffer(s);
+
         return 1;
 
 terminate:
@@ -323,6 +323,9 @@ void server_process_syslog_message(
          * without the terminating NUL byte, the buffer is actually one bigger. */
         assert(buf[raw_len] == '\0');
 
+        if (server_rate_limit_early_reject(s, ucred))
+                return;
+
         if (ucred && pid_is_valid(ucred->pid)) {
                 r = client_context_get(s, ucred->pid, ucred, label, label_len, NULL, &context);
                 if (r < 0)
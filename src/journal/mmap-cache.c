@@ -29,6 +29,9 @@ struct Window {
         uint64_t offset;
         size_t size;
 
+        /* The context this window was mapped for, eviction is accounted to it */
+        unsigned context;
+
         MMapFileDescriptor *fd;
 
         LIST_FIELDS(Window, by_fd);
@@ -50,13 +53,22 @@ struct MMapFileDescriptor {
         int fd;
         bool sigbus;
         LIST_HEAD(Window, windows);
+
+        /* The last window mapped for each context on this file, used to detect sequential access. This is per
+         * file rather than per context, since readers use the same contexts for all their files. */
+        struct {
+                uint64_t offset;
+                uint64_t size;
+        } last_window[MMAP_CACHE_MAX_CONTEXTS];
 };
 
 struct MMapCache {
         unsigned n_ref;
         unsigned n_windows;
 
-        unsigned n_hit, n_missed;
+        unsigned n_hit, n_missed, n_sigbus;
+        uint64_t n_bytes_mapped;
+        MMapCacheStatistics statistics[MMAP_CACHE_MAX_CONTEXTS];
 
         Hashmap *fds;
         Context *contexts[MMAP_CACHE_MAX_CONTEXTS];
@@ -70,8 +82,11 @@ struct MMapCache {
 #if ENABLE_DEBUG_MMAP_CACHE
 /* Tiny windows increase mmap activity and the chance of exposing unsafe use. */
 # define WINDOW_SIZE (page_size())
+# define WINDOW_SIZE_MAX WINDOW_SIZE
 #else
 # define WINDOW_SIZE (8ULL*1024ULL*1024ULL)
+/* Windows grow up to this size while a context reads a file sequentially */
+# define WINDOW_SIZE_MAX (32ULL*1024ULL*1024ULL)
 #endif
 
 MMapCache* mmap_cache_new(void) {
@@ -90,8 +105,10 @@ static void window_unlink(Window *w) {
 
         assert(w);
 
-        if (w->ptr)
+        if (w->ptr) {
                 munmap(w->ptr, w->size);
+                w->cache->n_bytes_mapped -= w->size;
+        }
 
         if (w->fd)
                 LIST_REMOVE(by_fd, w->fd->windows, w);
@@ -152,7 +169,7 @@ _pure_ static bool window_matches_fd(Window *w, MMapFileDescriptor *f, int prot,
                 window_matches(w, prot, offset, size);
 }
 
-static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool keep_always, uint64_t offset, size_t size, void *ptr) {
+static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, unsigned context, bool keep_always, uint64_t offset, size_t size, void *ptr) {
         Window *w;
 
         assert(m);
@@ -169,6 +186,7 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
 
                 /* Reuse an existing one */
                 w = m->last_unused;
+                m->statistics[w->context].n_evicted++;
                 window_unlink(w);
                 zero(*w);
         }
@@ -176,11 +194,14 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
         w->cache = m;
         w->fd = f;
         w->prot = prot;
+        w->context = context;
         w->keep_always = keep_always;
         w->offset = offset;
         w->size = size;
         w->ptr = ptr;
 
+        m->n_bytes_mapped += size;
+
         LIST_PREPEND(by_fd, f->windows, w);
 
         return w;
@@ -295,6 +316,7 @@ static int make_room(MMapCache *m) {
         if (!m->last_unused)
                 return 0;
 
+        m->statistics[m->last_unused->context].n_evicted++;
         window_free(m->last_unused);
         return 1;
 }
@@ -428,7 +450,8 @@ static int add_mmap(
                 void **ret,
                 size_t *ret_size) {
 
-        uint64_t woffset, wsize;
+        uint64_t woffset, wsize, lsize;
+        bool sequential;
         Context *c;
         Window *w;
         void *d;
@@ -444,7 +467,24 @@ static int add_mmap(
         wsize = size + (offset - woffset);
         wsize = PAGE_ALIGN(wsize);
 
-        if (wsize < WINDOW_SIZE) {
+        /* If we ran past the second half of the last window of this context, but not much further, the file is
+         * most likely read front to back. In that case map only what's ahead of us, and double the window size
+         * each time, so that long sequential scans need fewer and fewer mmap() calls. Anything else, like the
+         * bisection in the entry arrays, gets the default window centered around the requested range. */
+        lsize = f->last_window[context].size;
+        sequential =
+                !keep_always &&
+                lsize > 0 &&
+                offset >= f->last_window[context].offset + lsize / 2 &&
+                offset < f->last_window[context].offset + lsize * 2;
+
+        if (sequential) {
+                m->statistics[context].n_sequential++;
+
+                if (wsize < MIN(lsize * 2, WINDOW_SIZE_MAX))
+                        wsize = MIN(lsize * 2, WINDOW_SIZE_MAX);
+
+        } else if (wsize < WINDOW_SIZE) {
                 uint64_t delta;
 
                 delta = PAGE_ALIGN((WINDOW_SIZE - wsize) / 2);
@@ -473,14 +513,23 @@ static int add_mmap(
         if (r < 0)
                 return r;
 
+        /* Let the kernel read ahead aggressively, we'll most likely touch all of this soon */
+        if (sequential) {
+                (void) madvise(d, wsize, MADV_SEQUENTIAL);
+                (void) madvise(d, wsize, MADV_WILLNEED);
+        }
+
         c = context_add(m, context);
         if (!c)
                 goto outofmem;
 
-        w = window_add(m, f, prot, keep_always, woffset, wsize, d);
+        w = window_add(m, f, prot, context, keep_always, woffset, wsize, d);
         if (!w)
                 goto outofmem;
 
+        f->last_window[context].offset = woffset;
+        f->last_window[context].size = wsize;
+
         context_attach_window(c, w);
 
         *ret = (uint8_t*) w->ptr + (offset - w->offset);
@@ -519,6 +568,7 @@ int mmap_cache_get(
         r = try_context(m, f, prot, context, keep_always, offset, size, ret, ret_size);
         if (r != 0) {
                 m->n_hit++;
+                m->statistics[context].n_hit++;
                 return r;
         }
 
@@ -526,10 +576,12 @@ int mmap_cache_get(
         r = find_mmap(m, f, prot, context, keep_always, offset, size, ret, ret_size);
         if (r != 0) {
                 m->n_hit++;
+                m->statistics[context].n_hit++;
                 return r;
         }
 
         m->n_missed++;
+        m->statistics[context].n_missed++;
 
         /* Create a new mmap */
         return add_mmap(m, f, prot, context, keep_always, offset, size, st, ret, ret_size);
@@ -547,6 +599,32 @@ unsigned mmap_cache_get_missed(MMapCache *m) {
         return m->n_missed;
 }
 
+unsigned mmap_cache_get_windows(MMapCache *m) {
+        assert(m);
+
+        return m->n_windows;
+}
+
+uint64_t mmap_cache_get_mapped_bytes(MMapCache *m) {
+        assert(m);
+
+        return m->n_bytes_mapped;
+}
+
+unsigned mmap_cache_get_sigbus(MMapCache *m) {
+        assert(m);
+
+        return m->n_sigbus;
+}
+
+void mmap_cache_get_statistics(MMapCache *m, unsigned context, MMapCacheStatistics *ret) {
+        assert(m);
+        assert(context < MMAP_CACHE_MAX_CONTEXTS);
+        assert(ret);
+
+        *ret = m->statistics[context];
+}
+
 static void mmap_cache_process_sigbus(MMapCache *m) {
         bool found = false;
         MMapFileDescriptor *f;
@@ -569,6 +647,8 @@ static void mmap_cache_process_sigbus(MMapCache *m) {
                         abort();
                 }
 
+                m->n_sigbus++;
+
                 ours = false;
                 HASHMAP_FOREACH(f, m->fds, i) {
                         Window *w;
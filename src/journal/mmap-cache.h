@@ -1,15 +1,23 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <sys/stat.h>
 
 /* One context per object type, plus one of the header, plus one "additional" one */
-#define MMAP_CACHE_MAX_CONTEXTS 9
+#define MMAP_CACHE_MAX_CONTEXTS 10
 
 typedef struct MMapCache MMapCache;
 typedef struct MMapFileDescriptor MMapFileDescriptor;
 
+typedef struct MMapCacheStatistics {
+        unsigned n_hit;
+        unsigned n_missed;
+        unsigned n_evicted;    /* unused windows of this context that were unmapped to make room */
+        unsigned n_sequential; /* misses that were detected as part of a sequential scan */
+} MMapCacheStatistics;
+
 MMapCache* mmap_cache_new(void);
 MMapCache* mmap_cache_ref(MMapCache *m);
 MMapCache* mmap_cache_unref(MMapCache *m);
@@ -30,5 +38,9 @@ void mmap_cache_free_fd(MMapCache *m, MMapFileDescriptor *f);
 
 unsigned mmap_cache_get_hit(MMapCache *m);
 unsigned mmap_cache_get_missed(MMapCache *m);
+unsigned mmap_cache_get_windows(MMapCache *m);
+uint64_t mmap_cache_get_mapped_bytes(MMapCache *m);
+unsigned mmap_cache_get_sigbus(MMapCache *m);
+void mmap_cache_get_statistics(MMapCache *m, unsigned context, MMapCacheStatistics *ret);
 
 bool mmap_cache_got_sigbus(MMapCache *m, MMapFileDescriptor *f);
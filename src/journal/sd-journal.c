@@ -33,6 +33,7 @@
 #include "lookup3.h"
 #include "missing.h"
 #include "path-util.h"
+#include "prioq.h"
 #include "process-util.h"
 #include "replace-var.h"
 #include "stat-util.h"
@@ -101,6 +102,29 @@ static int journal_put_error(sd_journal *j, int r, const char *path) {
         return 0;
 }
 
+static void candidates_remove(sd_journal *j, JournalFile *f) {
+        assert(j);
+        assert(f);
+
+        (void) prioq_remove(j->candidates, f, &f->candidate_idx);
+        f->candidate_idx = PRIOQ_IDX_NULL;
+}
+
+static void candidates_invalidate(sd_journal *j) {
+        JournalFile *f;
+
+        assert(j);
+
+        /* Forget which files point to candidates, so that the next step looks at all files again */
+
+        while ((f = prioq_pop(j->candidates)))
+                f->candidate_idx = PRIOQ_IDX_NULL;
+
+        j->n_live_files = 0;
+        j->n_pending_files = 0;
+        j->candidates_valid = false;
+}
+
 static void detach_location(sd_journal *j) {
         Iterator i;
         JournalFile *f;
@@ -110,6 +134,8 @@ static void detach_location(sd_journal *j) {
         j->current_file = NULL;
         j->current_field = 0;
 
+        candidates_invalidate(j);
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i)
                 journal_file_reset_location(f);
 }
@@ -502,6 +528,10 @@ static int next_for_match(
         if (m->type == MATCH_DISCRETE) {
                 uint64_t dp;
 
+                r = journal_file_summary_may_contain(f, m->data, m->size, le64toh(m->le_hash));
+                if (r == 0)
+                        return 0;
+
                 r = journal_file_find_data_object_with_hash(f, m->data, m->size, le64toh(m->le_hash), NULL, &dp);
                 if (r <= 0)
                         return r;
@@ -591,6 +621,11 @@ static int find_location_for_match(
         if (m->type == MATCH_DISCRETE) {
                 uint64_t dp;
 
+                /* Archived files tell us what they don't contain, which saves us the hash table lookup */
+                r = journal_file_summary_may_contain(f, m->data, m->size, le64toh(m->le_hash));
+                if (r == 0)
+                        return 0;
+
                 r = journal_file_find_data_object_with_hash(f, m->data, m->size, le64toh(m->le_hash), NULL, &dp);
                 if (r <= 0)
                         return r;
@@ -802,48 +837,268 @@ static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direc
         }
 }
 
-static int real_journal_next(sd_journal *j, direction_t direction) {
-        JournalFile *new_file = NULL;
+static int candidate_compare(const void *a, const void *b) {
+        JournalFile *x = (JournalFile*) a, *y = (JournalFile*) b;
+        int k;
+
+        /* All files in the queue were advanced in the same direction, order them so that the entry to be
+         * returned next is at the top */
+
+        k = journal_file_compare_locations(x, y);
+
+        return x->last_direction == DIRECTION_DOWN ? k : -k;
+}
+
+static int candidates_add(sd_journal *j, JournalFile *f, direction_t direction) {
+        int r;
+
+        assert(j);
+        assert(f);
+
+        /* Moves f to its next candidate entry, and queues it if it has one */
+
+        r = next_beyond_location(j, f, direction);
+        if (r < 0) {
+                log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
+                remove_file_real(j, f);
+                return 0;
+        } else if (r == 0) {
+                f->location_type = LOCATION_TAIL;
+                candidates_remove(j, f);
+                return 0;
+        }
+
+        if (f->candidate_idx != PRIOQ_IDX_NULL)
+                return prioq_reshuffle(j->candidates, f, &f->candidate_idx);
+
+        return prioq_put(j->candidates, f, &f->candidate_idx);
+}
+
+static bool file_may_precede(JournalFile *f, JournalFile *candidate, direction_t direction) {
+        assert(f);
+        assert(candidate);
+
+        /* Checks whether f might contain an entry that is to be returned before the candidate, going by the
+         * boundaries of f recorded in its header. This follows journal_file_compare_locations(): files of the
+         * same seqnum source are ordered by seqnum, which holds up even when the wall clock jumped. Otherwise
+         * entries of the same boot are ordered by monotonic time, and only foreign ones by wall clock. Entries
+         * with the same value are looked at too, they might be the same entry. */
+
+        if (sd_id128_equal(f->header->seqnum_id, candidate->header->seqnum_id)) {
+                if (direction == DIRECTION_DOWN)
+                        return le64toh(f->header->head_entry_seqnum) <= candidate->current_seqnum;
+
+                return le64toh(f->header->tail_entry_seqnum) >= candidate->current_seqnum;
+        }
+
+        if (sd_id128_equal(f->header->boot_id, candidate->current_boot_id)) {
+                /* The header only tells the monotonic time of the last entry, and entries of earlier boots
+                 * might precede it, hence going down we can't tell. */
+                if (direction == DIRECTION_DOWN)
+                        return true;
+
+                if (le64toh(f->header->tail_entry_monotonic) >= candidate->current_monotonic)
+                        return true;
+        }
+
+        if (direction == DIRECTION_DOWN)
+                return le64toh(f->header->head_entry_realtime) <= candidate->current_realtime;
+
+        return le64toh(f->header->tail_entry_realtime) >= candidate->current_realtime;
+}
+
+static int candidates_add_pending(sd_journal *j, direction_t direction) {
+        JournalFile *f, *top;
+        size_t i;
+        int r;
+
+        assert(j);
+
+        /* Moves a pending file to its candidate entry, if it might have one to return before the current top of
+         * the queue. Returns 1 if a file was looked at, 0 if none needs to be for now.
+         *
+         * The pending files are sorted by wall clock, so that usually the last one is the one to look at next.
+         * But files might be ordered by seqnum or monotonic time instead, see above, hence check them all. */
+
+        top = prioq_peek(j->candidates);
+
+        for (i = j->n_pending_files; i > 0; i--) {
+                f = j->pending_files[i - 1];
+
+                if (top && !file_may_precede(f, top, direction))
+                        continue;
+
+                memmove(j->pending_files + i - 1, j->pending_files + i, (j->n_pending_files - i) * sizeof(JournalFile*));
+                j->n_pending_files--;
+
+                r = candidates_add(j, f, direction);
+                if (r < 0)
+                        return r;
+
+                return 1;
+        }
+
+        return 0;
+}
+
+static int candidates_settle(sd_journal *j, direction_t direction) {
+        JournalFile *f;
+        int r;
+
+        assert(j);
+
+        /* Entries that exist in more than one file compare equal to the current location, and hence end up at
+         * the top of the queue. Advance the top file until it points beyond the current location and is still
+         * the top one. Pending files that might have an entry to return before it are looked at first. */
+        for (;;) {
+                uint64_t offset;
+
+                r = candidates_add_pending(j, direction);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        continue;
+
+                f = prioq_peek(j->candidates);
+                if (!f)
+                        return 0;
+
+                offset = f->current_offset;
+
+                r = candidates_add(j, f, direction);
+                if (r < 0)
+                        return r;
+
+                if (prioq_peek(j->candidates) == f && f->current_offset == offset)
+                        return 0;
+        }
+}
+
+static int pending_file_compare_down(JournalFile * const *a, JournalFile * const *b) {
+        /* The file with the oldest entries goes last, it is looked at first */
+        return CMP(le64toh((*b)->header->head_entry_realtime), le64toh((*a)->header->head_entry_realtime));
+}
+
+static int pending_file_compare_up(JournalFile * const *a, JournalFile * const *b) {
+        /* The file with the newest entries goes last, it is looked at first */
+        return CMP(le64toh((*a)->header->tail_entry_realtime), le64toh((*b)->header->tail_entry_realtime));
+}
+
+static int candidates_rebuild(sd_journal *j, direction_t direction) {
         unsigned i, n_files;
         const void **files;
-        Object *o;
         int r;
 
-        assert_return(j, -EINVAL);
-        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert(j);
+
+        candidates_invalidate(j);
+
+        r = prioq_ensure_allocated(&j->candidates, candidate_compare);
+        if (r < 0)
+                return r;
 
         r = iterated_cache_get(j->files_cache, NULL, &files, &n_files);
         if (r < 0)
                 return r;
 
+        /* If this is the first step after a seek and there are matches to evaluate, each file will have to look
+         * up the match terms in its data hash table. Kick off the reads for all of them first, so that the I/O
+         * for cold files is done concurrently by the kernel instead of file by file in the loop below. Archived
+         * files are only looked at when needed, see below. */
+        if (j->level0 && j->current_location.type != LOCATION_DISCRETE)
+                for (i = 0; i < n_files; i++)
+                        if (((JournalFile *) files[i])->header->state != STATE_ARCHIVED)
+                                journal_file_prefetch_data_hash_table((JournalFile *) files[i]);
+
+        if (n_files > 0 && !GREEDY_REALLOC(j->live_files, j->n_live_files_allocated, n_files))
+                return -ENOMEM;
+
+        if (n_files > 0 && !GREEDY_REALLOC(j->pending_files, j->n_pending_files_allocated, n_files))
+                return -ENOMEM;
+
         for (i = 0; i < n_files; i++) {
                 JournalFile *f = (JournalFile *)files[i];
-                bool found;
 
-                r = next_beyond_location(j, f, direction);
-                if (r < 0) {
-                        log_debug_errno(r, "Can't iterate through %s, ignoring: %m", f->path);
-                        remove_file_real(j, f);
-                        continue;
-                } else if (r == 0) {
-                        f->location_type = LOCATION_TAIL;
+                /* Archived files never change, hence once we reached their end we don't need to look at them
+                 * again. Everything else might be appended to while we iterate. */
+                if (f->header->state != STATE_ARCHIVED) {
+                        j->live_files[j->n_live_files++] = f;
+
+                        r = candidates_add(j, f, direction);
+                        if (r < 0)
+                                return r;
+
+                /* Looking for the first entry in a file might mean bisecting a lot of entry arrays. With many
+                 * archived files, most are usually not needed for the next few entries, e.g. for "journalctl -n",
+                 * hence they are looked at only once the entries returned get close to their time range. */
+                } else if (le64toh(f->header->n_entries) > 0)
+                        j->pending_files[j->n_pending_files++] = f;
+        }
+
+        if (direction == DIRECTION_DOWN)
+                typesafe_qsort(j->pending_files, j->n_pending_files, pending_file_compare_down);
+        else
+                typesafe_qsort(j->pending_files, j->n_pending_files, pending_file_compare_up);
+
+        j->candidates_direction = direction;
+        j->candidates_valid = true;
+
+        return candidates_settle(j, direction);
+}
+
+static int candidates_update(sd_journal *j, direction_t direction) {
+        JournalFile *f;
+        size_t i;
+        int r;
+
+        assert(j);
+
+        if (!j->candidates_valid || j->candidates_direction != direction)
+                return candidates_rebuild(j, direction);
+
+        /* Only the file whose entry was returned last needs to be moved, everything else still points to the
+         * same candidate as before. */
+        if (j->current_file && j->current_file->candidate_idx == PRIOQ_IDX_NULL) {
+                r = candidates_add(j, j->current_file, direction);
+                if (r < 0)
+                        return r;
+        }
+
+        r = candidates_settle(j, direction);
+        if (r < 0)
+                return r;
+
+        /* Files we hit the end of might have been appended to since. Walk backwards, as files that fail are
+         * removed from the array by replacing them with the last one. */
+        for (i = j->n_live_files; i > 0; i--) {
+                f = j->live_files[i - 1];
+
+                if (f->candidate_idx != PRIOQ_IDX_NULL)
                         continue;
-                }
 
-                if (!new_file)
-                        found = true;
-                else {
-                        int k;
+                r = candidates_add(j, f, direction);
+                if (r < 0)
+                        return r;
+        }
 
-                        k = journal_file_compare_locations(f, new_file);
+        return 0;
+}
 
-                        found = direction == DIRECTION_DOWN ? k < 0 : k > 0;
-                }
+static int real_journal_next(sd_journal *j, direction_t direction) {
+        JournalFile *new_file;
+        Object *o;
+        int r;
 
-                if (found)
-                        new_file = f;
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+
+        r = candidates_update(j, direction);
+        if (r < 0) {
+                candidates_invalidate(j);
+                return r;
         }
 
+        new_file = prioq_peek(j->candidates);
         if (!new_file)
                 return 0;
 
@@ -851,6 +1106,9 @@ static int real_journal_next(sd_journal *j, direction_t direction) {
         if (r < 0)
                 return r;
 
+        /* The file is queued again once it moved on to its next candidate */
+        candidates_remove(j, new_file);
+
         set_location(j, new_file, o);
 
         return 1;
@@ -1335,10 +1593,14 @@ static int add_any_file(
         close_fd = false; /* the fd is now owned by the JournalFile object */
 
         f->last_seen_generation = j->generation;
+        f->last_seen_n_entries = le64toh(f->header->n_entries);
 
         track_file_disposition(j, f);
         check_network(j, f->fd);
 
+        /* The new file needs to be looked at in the next step */
+        candidates_invalidate(j);
+
         j->current_invalidate_counter++;
 
         log_debug("File %s added.", f->path);
@@ -1379,6 +1641,42 @@ static int add_file_by_name(
         return add_any_file(j, -1, path);
 }
 
+static bool modify_file_by_name(
+                sd_journal *j,
+                const char *prefix,
+                const char *filename) {
+
+        const char *path;
+        JournalFile *f;
+        uint64_t n;
+
+        assert(j);
+        assert(prefix);
+        assert(filename);
+
+        /* IN_MODIFY for a file we already track. If it had been replaced we would have seen IN_CREATE or IN_MOVED_TO
+         * for it first, hence there's no need to open() and fstat() it again: the header we have mapped tells us
+         * whether the writer actually committed new entries. The writer triggers IN_MODIFY once per post-change
+         * cycle, but also for updates that don't add any entries, for example when setting the file offline. Let's
+         * not wake up followers for these. Returns true if the event is worth reporting. */
+
+        path = strjoina(prefix, "/", filename);
+        f = ordered_hashmap_get(j->files, path);
+        if (!f) {
+                (void) add_file_by_name(j, prefix, filename);
+                return true;
+        }
+
+        __sync_synchronize();
+
+        n = le64toh(f->header->n_entries);
+        if (n == f->last_seen_n_entries)
+                return false;
+
+        f->last_seen_n_entries = n;
+        return true;
+}
+
 static void remove_file_by_name(
                 sd_journal *j,
                 const char *prefix,
@@ -1400,6 +1698,8 @@ static void remove_file_by_name(
 }
 
 static void remove_file_real(sd_journal *j, JournalFile *f) {
+        size_t i;
+
         assert(j);
         assert(f);
 
@@ -1407,6 +1707,20 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
 
         log_debug("File %s removed.", f->path);
 
+        candidates_remove(j, f);
+        for (i = 0; i < j->n_live_files; i++)
+                if (j->live_files[i] == f) {
+                        j->live_files[i] = j->live_files[--j->n_live_files];
+                        break;
+                }
+        for (i = 0; i < j->n_pending_files; i++)
+                if (j->pending_files[i] == f) {
+                        memmove(j->pending_files + i, j->pending_files + i + 1,
+                                (j->n_pending_files - i - 1) * sizeof(JournalFile*));
+                        j->n_pending_files--;
+                        break;
+                }
+
         if (j->current_file == f) {
                 j->current_file = NULL;
                 j->current_field = 0;
@@ -1427,6 +1741,8 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
                         j->fields_file_lost = true;
         }
 
+        j->decompress_usec += f->decompress_usec;
+
         (void) journal_file_close(f);
 
         j->current_invalidate_counter++;
@@ -2059,6 +2375,10 @@ _public_ void sd_journal_close(sd_journal *j) {
 
         sd_journal_flush_matches(j);
 
+        prioq_free(j->candidates);
+        free(j->live_files);
+        free(j->pending_files);
+
         ordered_hashmap_free_with_destructor(j->files, journal_file_close);
         iterated_cache_free(j->files_cache);
 
@@ -2074,7 +2394,21 @@ _public_ void sd_journal_close(sd_journal *j) {
         safe_close(j->inotify_fd);
 
         if (j->mmap) {
+                unsigned c;
+
                 log_debug("mmap cache statistics: %u hit, %u miss", mmap_cache_get_hit(j->mmap), mmap_cache_get_missed(j->mmap));
+
+                for (c = 0; c < MMAP_CACHE_MAX_CONTEXTS; c++) {
+                        MMapCacheStatistics s;
+
+                        mmap_cache_get_statistics(j->mmap, c, &s);
+                        if (s.n_hit == 0 && s.n_missed == 0)
+                                continue;
+
+                        log_debug("mmap cache context %u: %u hit, %u miss, %u sequential, %u evicted",
+                                  c, s.n_hit, s.n_missed, s.n_sequential, s.n_evicted);
+                }
+
                 mmap_cache_unref(j->mmap);
         }
 
@@ -2083,6 +2417,7 @@ _public_ void sd_journal_close(sd_journal *j) {
         free(j->path);
         free(j->prefix);
         free(j->unique_field);
+        set_free(j->unique_values);
         free(j->fields_buffer);
         free(j);
 }
@@ -2223,11 +2558,15 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
 
                 compression = o->object.flags & OBJECT_COMPRESSION_MASK;
                 if (compression) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+                        usec_t begin;
+
+                        begin = now(CLOCK_MONOTONIC);
                         r = decompress_startswith(compression,
                                                   o->data.payload, l,
                                                   &f->compress_buffer, &f->compress_buffer_size,
                                                   field, field_length, '=');
+                        f->decompress_usec += usec_sub_unsigned(now(CLOCK_MONOTONIC), begin);
                         if (r < 0)
                                 log_debug_errno(r, "Cannot decompress %s object of length %"PRIu64" at offset "OFSfmt": %m",
                                                 object_compressed_to_string(compression), l, p);
@@ -2235,10 +2574,9 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
 
                                 size_t rsize;
 
-                                r = decompress_blob(compression,
-                                                    o->data.payload, l,
-                                                    &f->compress_buffer, &f->compress_buffer_size, &rsize,
-                                                    j->data_threshold);
+                                r = journal_file_decompress_blob(f, compression,
+                                                                 o->data.payload, l, &rsize,
+                                                                 j->data_threshold);
                                 if (r < 0)
                                         return r;
 
@@ -2287,13 +2625,12 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
 
         compression = o->object.flags & OBJECT_COMPRESSION_MASK;
         if (compression) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
                 size_t rsize;
                 int r;
 
-                r = decompress_blob(compression,
-                                    o->data.payload, l, &f->compress_buffer,
-                                    &f->compress_buffer_size, &rsize, j->data_threshold);
+                r = journal_file_decompress_blob(f, compression,
+                                                 o->data.payload, l, &rsize, j->data_threshold);
                 if (r < 0)
                         return r;
 
@@ -2483,15 +2820,17 @@ static void process_q_overflow(sd_journal *j) {
         log_debug("Reiteration complete.");
 }
 
-static void process_inotify_event(sd_journal *j, struct inotify_event *e) {
+static bool process_inotify_event(sd_journal *j, struct inotify_event *e) {
         Directory *d;
 
         assert(j);
         assert(e);
 
+        /* Returns false if the event didn't change anything a reader might care about */
+
         if (e->mask & IN_Q_OVERFLOW) {
                 process_q_overflow(j);
-                return;
+                return true;
         }
 
         /* Is this a subdirectory we watch? */
@@ -2503,8 +2842,10 @@ static void process_inotify_event(sd_journal *j, struct inotify_event *e) {
 
                         /* Event for a journal file */
 
-                        if (e->mask & (IN_CREATE|IN_MOVED_TO|IN_MODIFY|IN_ATTRIB))
+                        if (e->mask & (IN_CREATE|IN_MOVED_TO|IN_ATTRIB))
                                 (void) add_file_by_name(j, d->path, e->name);
+                        else if (e->mask & IN_MODIFY)
+                                return modify_file_by_name(j, d->path, e->name);
                         else if (e->mask & (IN_DELETE|IN_MOVED_FROM|IN_UNMOUNT))
                                 remove_file_by_name(j, d->path, e->name);
 
@@ -2523,13 +2864,14 @@ static void process_inotify_event(sd_journal *j, struct inotify_event *e) {
                                 (void) add_directory(j, d->path, e->name);
                 }
 
-                return;
+                return true;
         }
 
         if (e->mask & IN_IGNORED)
-                return;
+                return true;
 
         log_debug("Unexpected inotify event.");
+        return true;
 }
 
 static int determine_change(sd_journal *j) {
@@ -2568,10 +2910,9 @@ _public_ int sd_journal_process(sd_journal *j) {
                         return -errno;
                 }
 
-                got_something = true;
-
                 FOREACH_INOTIFY_EVENT(e, buffer, l)
-                        process_inotify_event(j, e);
+                        if (process_inotify_event(j, e))
+                                got_something = true;
         }
 }
 
@@ -2740,6 +3081,28 @@ _public_ int sd_journal_get_usage(sd_journal *j, uint64_t *bytes) {
         return 0;
 }
 
+typedef struct UniqueValue {
+        size_t size;
+        uint8_t data[];
+} UniqueValue;
+
+static void unique_value_hash_func(const UniqueValue *v, struct siphash *state) {
+        siphash24_compress(&v->size, sizeof(v->size), state);
+        siphash24_compress(v->data, v->size, state);
+}
+
+static int unique_value_compare_func(const UniqueValue *x, const UniqueValue *y) {
+        int r;
+
+        r = CMP(x->size, y->size);
+        if (r != 0)
+                return r;
+
+        return memcmp(x->data, y->data, x->size);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(unique_value_hash_ops, UniqueValue, unique_value_hash_func, unique_value_compare_func, free);
+
 _public_ int sd_journal_query_unique(sd_journal *j, const char *field) {
         char *f;
 
@@ -2757,6 +3120,7 @@ _public_ int sd_journal_query_unique(sd_journal *j, const char *field) {
         j->unique_file = NULL;
         j->unique_offset = 0;
         j->unique_file_lost = false;
+        set_clear(j->unique_values);
 
         return 0;
 }
@@ -2784,12 +3148,10 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
         }
 
         for (;;) {
-                JournalFile *of;
-                Iterator i;
+                _cleanup_free_ UniqueValue *v = NULL;
                 Object *o;
                 const void *odata;
                 size_t ol;
-                bool found;
                 int r;
 
                 /* Proceed to next data object in the field's linked list */
@@ -2849,30 +3211,28 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                                                j->unique_offset,
                                                j->unique_field);
 
-                /* OK, now let's see if we already returned this data
-                 * object by checking if it exists in the earlier
-                 * traversed files. */
-                found = false;
-                ORDERED_HASHMAP_FOREACH(of, j->files, i) {
-                        if (of == j->unique_file)
-                                break;
+                /* OK, now let's see if we already returned this data object, from one of the earlier traversed
+                 * files. We remember what we returned, instead of looking for it in each of those files, which gets
+                 * very slow with many files and many values. */
+                v = malloc(offsetof(UniqueValue, data) + ol);
+                if (!v)
+                        return -ENOMEM;
 
-                        /* Skip this file it didn't have any fields indexed */
-                        if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
-                                continue;
+                v->size = ol;
+                memcpy(v->data, odata, ol);
 
-                        r = journal_file_find_data_object_with_hash(of, odata, ol, le64toh(o->data.hash), NULL, NULL);
-                        if (r < 0)
-                                return r;
-                        if (r > 0) {
-                                found = true;
-                                break;
-                        }
-                }
+                r = set_ensure_allocated(&j->unique_values, &unique_value_hash_ops);
+                if (r < 0)
+                        return r;
 
-                if (found)
+                r = set_put(j->unique_values, v);
+                if (r < 0)
+                        return r;
+                if (r == 0)
                         continue;
 
+                TAKE_PTR(v);
+
                 r = return_data(j, j->unique_file, o, data, l);
                 if (r < 0)
                         return r;
@@ -2888,6 +3248,7 @@ _public_ void sd_journal_restart_unique(sd_journal *j) {
         j->unique_file = NULL;
         j->unique_offset = 0;
         j->unique_file_lost = false;
+        set_clear(j->unique_values);
 }
 
 _public_ int sd_journal_enumerate_fields(sd_journal *j, const char **field) {
@@ -3135,3 +3496,37 @@ _public_ int sd_journal_has_persistent_files(sd_journal *j) {
 
         return j->has_persistent_files;
 }
+
+_public_ int sd_journal_get_stats(sd_journal *j, sd_journal_stats *ret, size_t size) {
+        sd_journal_stats s;
+        JournalFile *f;
+        Iterator i;
+        usec_t t;
+
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert_return(ret, -EINVAL);
+        /* Callers built against an older version of the structure pass a smaller size, and get the fields they
+         * know about. Callers built against a newer version get the fields we don't know about zeroed. The
+         * first version ended with decompress_usec. */
+        assert_return(size >= offsetof(sd_journal_stats, decompress_usec) + sizeof(uint64_t), -EINVAL);
+
+        t = j->decompress_usec;
+        ORDERED_HASHMAP_FOREACH(f, j->files, i)
+                t += f->decompress_usec;
+
+        s = (sd_journal_stats) {
+                .mmap_hit = mmap_cache_get_hit(j->mmap),
+                .mmap_missed = mmap_cache_get_missed(j->mmap),
+                .mmap_windows = mmap_cache_get_windows(j->mmap),
+                .mmap_bytes = mmap_cache_get_mapped_bytes(j->mmap),
+                .sigbus = mmap_cache_get_sigbus(j->mmap),
+                .decompress_usec = t,
+        };
+
+        memcpy(ret, &s, MIN(size, sizeof(s)));
+        if (size > sizeof(s))
+                memzero((uint8_t*) ret + sizeof(s), size - sizeof(s));
+
+        return 0;
+}
@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "journal-util.h"
+#include "logs-show.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+#define N_ENTRIES 20
+
+static void append_entries(const char *fn) {
+        JournalFile *f = NULL;
+        struct iovec iovec[4];
+        dual_timestamp ts;
+        unsigned i;
+
+        assert_se(journal_file_open(-1, fn, O_RDWR|O_CREAT, 0644, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (i = 0; i < N_ENTRIES; i++) {
+                _cleanup_free_ char *message = NULL, *number = NULL;
+                size_t n = 0;
+
+                assert_se(asprintf(&message, "MESSAGE=entry %u", i) >= 0);
+                assert_se(asprintf(&number, "NUMBER=%u", i) >= 0);
+
+                iovec[n++] = IOVEC_MAKE_STRING(message);
+                iovec[n++] = IOVEC_MAKE_STRING(number);
+
+                /* Fields that are serialized in the binary format, and a long one that spans many buffers */
+                if (i % 3 == 0)
+                        iovec[n++] = IOVEC_MAKE_STRING("MULTI=line\nline");
+                if (i % 4 == 0)
+                        iovec[n++] = IOVEC_MAKE("BINARY=\001\000\002", STRLEN("BINARY=\001\000\002"));
+                else if (i % 5 == 0) {
+                        static char big[4096];
+
+                        memcpy(big, "BIG=", 4);
+                        memset(big + 4, 'x', sizeof(big) - 4);
+                        iovec[n++] = IOVEC_MAKE(big, sizeof(big));
+                }
+
+                dual_timestamp_get(&ts);
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, n, NULL, NULL, NULL) == 0);
+        }
+
+        (void) journal_file_close(f);
+}
+
+static void read_all(const char *fn, size_t max, char **ret, size_t *ret_size) {
+        _cleanup_(journal_export_stream_done) JournalExportStream s = {};
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_free_ char *buf = NULL, *data = NULL;
+        size_t size = 0, allocated = 0;
+        int r;
+
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        assert_se(buf = malloc(max));
+
+        while (sd_journal_next(j) > 0) {
+                assert_se(journal_export_stream_begin(&s, j) >= 0);
+
+                do {
+                        size_t k;
+
+                        r = journal_export_stream_read(&s, j, buf, max, &k);
+                        assert_se(r >= 0);
+                        assert_se(k <= max);
+                        /* The buffer is always filled, unless the entry is complete */
+                        assert_se(r == 0 || k == max);
+
+                        assert_se(GREEDY_REALLOC(data, allocated, size + k + 1));
+                        memcpy_safe(data + size, buf, k);
+                        size += k;
+                } while (r > 0);
+        }
+
+        *ret = TAKE_PTR(data);
+        *ret_size = size;
+}
+
+static void test_export_stream(void) {
+        static const size_t sizes[] = { 1, 2, 7, 8, 64, 4095, 4096, 65536 };
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_free_ char *expected = NULL;
+        _cleanup_fclose_ FILE *mf = NULL;
+        size_t expected_size = 0, i;
+        const char *fn;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp_malloc("/tmp/journal-export-XXXXXX", &t) >= 0);
+        fn = strjoina(t, "/test.journal");
+        append_entries(fn);
+
+        /* What journalctl -o export would show */
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        assert_se(mf = open_memstream(&expected, &expected_size));
+        while (sd_journal_next(j) > 0)
+                assert_se(show_journal_entry(mf, j, OUTPUT_EXPORT, 0, 0, NULL, NULL, NULL) >= 0);
+        assert_se(fflush_and_check(mf) >= 0);
+
+        /* The output is the same byte for byte, however the buffers split it */
+        for (i = 0; i < ELEMENTSOF(sizes); i++) {
+                _cleanup_free_ char *data = NULL;
+                size_t size;
+
+                read_all(fn, sizes[i], &data, &size);
+                assert_se(size == expected_size);
+                assert_se(memcmp(data, expected, size) == 0);
+        }
+}
+
+int main(int argc, char *argv[]) {
+        /* journal_file_open requires a valid machine id */
+        if (access("/etc/machine-id", F_OK) != 0)
+                return log_tests_skipped("/etc/machine-id not found");
+
+        test_setup_logging(LOG_DEBUG);
+
+        test_export_stream();
+
+        return 0;
+}
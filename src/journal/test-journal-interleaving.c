@@ -32,17 +32,21 @@ _noreturn_ static void log_assert_errno(const char *text, int error, const char
                         log_assert_errno(#expr, -_r_, __FILE__, __LINE__, __PRETTY_FUNCTION__); \
         } while (false)
 
-static JournalFile *test_open(const char *name) {
+static JournalFile *test_open_template(const char *name, JournalFile *template) {
         JournalFile *f;
-        assert_ret(journal_file_open(-1, name, O_RDWR|O_CREAT, 0644, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f));
+        assert_ret(journal_file_open(-1, name, O_RDWR|O_CREAT, 0644, true, (uint64_t) -1, false, NULL, NULL, NULL, template, &f));
         return f;
 }
 
+static JournalFile *test_open(const char *name) {
+        return test_open_template(name, NULL);
+}
+
 static void test_close(JournalFile *f) {
         (void) journal_file_close (f);
 }
 
-static void append_number(JournalFile *f, int n, uint64_t *seqnum) {
+static void append_number_at(JournalFile *f, int n, usec_t realtime, uint64_t *seqnum) {
         char *p;
         dual_timestamp ts;
         static dual_timestamp previous_ts = {};
@@ -53,7 +57,10 @@ static void append_number(JournalFile *f, int n, uint64_t *seqnum) {
         if (ts.monotonic <= previous_ts.monotonic)
                 ts.monotonic = previous_ts.monotonic + 1;
 
-        if (ts.realtime <= previous_ts.realtime)
+        /* Unless told otherwise, pretend the wall clock only moves forward */
+        if (realtime != USEC_INFINITY)
+                ts.realtime = realtime;
+        else if (ts.realtime <= previous_ts.realtime)
                 ts.realtime = previous_ts.realtime + 1;
 
         previous_ts = ts;
@@ -64,6 +71,10 @@ static void append_number(JournalFile *f, int n, uint64_t *seqnum) {
         free(p);
 }
 
+static void append_number(JournalFile *f, int n, uint64_t *seqnum) {
+        append_number_at(f, n, USEC_INFINITY, seqnum);
+}
+
 static void test_check_number (sd_journal *j, int n) {
         const void *d;
         _cleanup_free_ char *k;
@@ -130,6 +141,41 @@ static void setup_interleaved(void) {
         test_close(two);
 }
 
+static void setup_archived(void) {
+        JournalFile *one, *two, *three;
+        one = test_open("one.journal");
+        two = test_open("two.journal");
+        three = test_open("three.journal");
+        append_number(one, 1, NULL);
+        append_number(two, 2, NULL);
+        append_number(one, 3, NULL);
+        append_number(three, 4, NULL);
+        assert_ret(journal_file_archive(one));
+        assert_ret(journal_file_archive(two));
+        test_close(one);
+        test_close(two);
+        test_close(three);
+}
+
+static void setup_clock_jump(void) {
+        JournalFile *live, *archived;
+        uint64_t seqnum = 0;
+        usec_t t;
+
+        /* The wall clock jumped back by an hour after the first entry. The archived file shares the seqnum
+         * source with the live one, hence its entry is still ordered between the live ones. */
+        t = now(CLOCK_REALTIME);
+        live = test_open("live.journal");
+        archived = test_open_template("archived.journal", live);
+        append_number_at(live, 1, t, &seqnum);
+        append_number_at(archived, 2, t - USEC_PER_HOUR, &seqnum);
+        append_number_at(live, 3, t - USEC_PER_HOUR + USEC_PER_MINUTE, &seqnum);
+        append_number_at(live, 4, t - USEC_PER_HOUR + 2 * USEC_PER_MINUTE, &seqnum);
+        assert_ret(journal_file_archive(archived));
+        test_close(live);
+        test_close(archived);
+}
+
 static void test_skip(void (*setup)(void)) {
         char t[] = "/tmp/journal-skip-XXXXXX";
         sd_journal *j;
@@ -187,6 +233,106 @@ static void test_skip(void (*setup)(void)) {
         puts("------------------------------------------------------------");
 }
 
+static void test_append_after_end(void) {
+        char t[] = "/tmp/journal-append-XXXXXX";
+        JournalFile *one, *two;
+        sd_journal *j;
+        int r;
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        one = test_open("one.journal");
+        two = test_open("two.journal");
+        append_number(one, 1, NULL);
+        append_number(two, 2, NULL);
+        append_number(one, 3, NULL);
+        test_close(two);
+
+        /* Iterate to the end, then append to the file that is still online, and make sure the new entry shows
+         * up, even though we already hit the end of all files. */
+        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_seek_head(j));
+        assert_ret(sd_journal_next(j));
+        test_check_numbers_down(j, 3);
+
+        append_number(one, 4, NULL);
+        assert_ret(r = sd_journal_next(j));
+        assert_se(r == 1);
+        test_check_number(j, 4);
+        assert_ret(r = sd_journal_next(j));
+        assert_se(r == 0);
+
+        /* Going back visits all entries again */
+        test_check_numbers_up(j, 4);
+
+        sd_journal_close(j);
+        test_close(one);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else {
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+        }
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_process(void) {
+        char t[] = "/tmp/journal-process-XXXXXX";
+        JournalFile *one;
+        sd_journal *j;
+        int r;
+
+        /* Followers should only be woken up when entries actually got appended */
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        one = test_open("one.journal");
+        append_number(one, 1, NULL);
+
+        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_get_fd(j));
+        assert_ret(sd_journal_seek_head(j));
+        assert_ret(sd_journal_next(j));
+        test_check_number(j, 1);
+
+        assert_se(sd_journal_process(j) == SD_JOURNAL_NOP);
+
+        append_number(one, 2, NULL);
+        assert_se(sd_journal_process(j) == SD_JOURNAL_APPEND);
+        assert_ret(r = sd_journal_next(j));
+        assert_se(r == 1);
+        test_check_number(j, 2);
+
+        /* Poke the file without appending anything */
+        journal_file_post_change(one);
+        assert_se(sd_journal_process(j) == SD_JOURNAL_NOP);
+
+        append_number(one, 3, NULL);
+        journal_file_post_change(one);
+        assert_se(sd_journal_process(j) == SD_JOURNAL_APPEND);
+        assert_ret(r = sd_journal_next(j));
+        assert_se(r == 1);
+        test_check_number(j, 3);
+
+        sd_journal_close(j);
+        test_close(one);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else {
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+        }
+
+        puts("------------------------------------------------------------");
+}
+
 static void test_sequence_numbers(void) {
 
         char t[] = "/tmp/journal-seq-XXXXXX";
@@ -281,6 +427,12 @@ int main(int argc, char *argv[]) {
 
         test_skip(setup_sequential);
         test_skip(setup_interleaved);
+        test_skip(setup_archived);
+        test_skip(setup_clock_jump);
+
+        test_append_after_end();
+
+        test_process();
 
         test_sequence_numbers();
 
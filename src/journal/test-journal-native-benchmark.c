@@ -0,0 +1,237 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "journal-util.h"
+#include "journald-native.h"
+#include "macro.h"
+#include "parse-util.h"
+#include "random-util.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "unaligned.h"
+#include "util.h"
+
+static usec_t arg_duration;
+
+/* The way server_process_entry() used to split fields: find the end of the line, then the '=' in it, then validate
+ * the name, i.e. look at the name three times. */
+static NativeFieldType split_reference(const char *p, size_t n, const char **ret_end, size_t *ret_name_len, bool *ret_valid) {
+        const char *e, *q;
+
+        *ret_end = NULL;
+        *ret_name_len = 0;
+        *ret_valid = false;
+
+        e = memchr(p, '\n', n);
+        if (!e)
+                return NATIVE_FIELD_NOISE;
+
+        *ret_end = e;
+
+        if (e == p)
+                return NATIVE_FIELD_SEPARATOR;
+
+        if (IN_SET(*p, '.', '#'))
+                return NATIVE_FIELD_CONTROL;
+
+        q = memchr(p, '=', e - p);
+        if (q) {
+                *ret_name_len = q - p;
+                *ret_valid = journal_field_valid(p, q - p, false);
+                return NATIVE_FIELD_TEXT;
+        }
+
+        *ret_name_len = e - p;
+        *ret_valid = journal_field_valid(p, e - p, false);
+        return NATIVE_FIELD_BINARY;
+}
+
+typedef NativeFieldType (split_t)(const char *p, size_t n, const char **ret_end, size_t *ret_name_len, bool *ret_valid);
+
+static size_t parse_message(split_t split, const char *buf, size_t size) {
+        size_t n_valid = 0;
+        const char *p = buf;
+
+        /* Walks the fields of the message the same way server_process_entry() does */
+
+        while (p < buf + size) {
+                const char *e;
+                size_t name_len;
+                bool valid;
+
+                switch (split(p, buf + size - p, &e, &name_len, &valid)) {
+
+                case NATIVE_FIELD_NOISE:
+                        return n_valid;
+
+                case NATIVE_FIELD_SEPARATOR:
+                case NATIVE_FIELD_CONTROL:
+                case NATIVE_FIELD_TEXT:
+                        p = e + 1;
+                        break;
+
+                case NATIVE_FIELD_BINARY:
+                        if ((size_t) (buf + size - e) < 1 + sizeof(uint64_t))
+                                return n_valid;
+                        p = e + 1 + sizeof(uint64_t) + unaligned_read_le64(e + 1) + 1;
+                        break;
+                }
+
+                n_valid += valid;
+        }
+
+        return n_valid;
+}
+
+static char *make_message(size_t n_fields, size_t value_size, size_t *ret_size) {
+        _cleanup_free_ char *buf = NULL;
+        size_t allocated = 0, size = 0, i;
+
+        /* An entry like structured logging applications send them: a bunch of text fields, and a binary one */
+
+        for (i = 0; i < n_fields; i++) {
+                char name[32];
+                size_t l;
+
+                xsprintf(name, "APPLICATION_FIELD_%zu", i);
+                l = strlen(name);
+
+                assert_se(GREEDY_REALLOC(buf, allocated, size + l + 1 + sizeof(uint64_t) + value_size + 1));
+
+                memcpy(buf + size, name, l);
+                size += l;
+
+                if (i == n_fields / 2) {
+                        buf[size++] = '\n';
+                        unaligned_write_le64(buf + size, value_size);
+                        size += sizeof(uint64_t);
+                } else
+                        buf[size++] = '=';
+
+                memset(buf + size, 'v', value_size);
+                size += value_size;
+                buf[size++] = '\n';
+        }
+
+        *ret_size = size;
+        return TAKE_PTR(buf);
+}
+
+#define FIELD(s) { s, sizeof(s) - 1 }
+
+static void test_compare(void) {
+        static const struct {
+                const char *data;
+                size_t size;
+        } fields[] = {
+                FIELD("MESSAGE=foo\n"),
+                FIELD("PRIORITY=6\n"),
+                FIELD("_PID=1\n"),
+                FIELD("1FOO=bar\n"),
+                FIELD("foo=bar\n"),
+                FIELD("F-O=bar\n"),
+                FIELD("=bar\n"),
+                FIELD("FOO==\n"),
+                FIELD("FOO\n\003\0\0\0\0\0\0\0a=b\n"),
+                FIELD("foo\n\001\0\0\0\0\0\0\0x\n"),
+                FIELD("AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=too long by one\n"),
+                FIELD("AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=just fits\n"),
+                FIELD(".control\n"),
+                FIELD("#comment\n"),
+                FIELD("\n"),
+                FIELD("NOISE"),
+                FIELD("noise"),
+                FIELD("FOO=noise"),
+        };
+        size_t i, k;
+
+        /* Check the fast split against the straightforward one, for each field and for random garbage */
+
+        for (i = 0; i < ELEMENTSOF(fields); i++) {
+                const char *e1, *e2;
+                size_t l1, l2;
+                bool v1, v2;
+
+                assert_se(split_reference(fields[i].data, fields[i].size, &e1, &l1, &v1) ==
+                          native_field_split(fields[i].data, fields[i].size, &e2, &l2, &v2));
+                assert_se(e1 == e2);
+                assert_se(l1 == l2);
+                assert_se(v1 == v2);
+        }
+
+        for (k = 0; k < 10000; k++) {
+                char buf[64];
+                const char *e1, *e2;
+                size_t l1, l2, n;
+                bool v1, v2;
+
+                random_bytes(buf, sizeof(buf));
+                n = buf[0] & 63;
+
+                /* Make it look like a field name most of the time */
+                for (i = 0; i < n; i++)
+                        if ((uint8_t) buf[i] % 4 != 0)
+                                buf[i] = "ABC_0123=\n"[(uint8_t) buf[i] % 10];
+
+                assert_se(split_reference(buf, n, &e1, &l1, &v1) == native_field_split(buf, n, &e2, &l2, &v2));
+                assert_se(e1 == e2);
+                assert_se(l1 == l2);
+                assert_se(v1 == v2);
+        }
+}
+
+static void test_benchmark(const char *label, split_t split, size_t n_fields, size_t value_size) {
+        _cleanup_free_ char *buf = NULL;
+        size_t size, total = 0, n_messages = 0;
+        usec_t n, n2;
+        float dt;
+
+        buf = make_message(n_fields, value_size, &size);
+        assert_se(parse_message(split, buf, size) == n_fields);
+
+        n = n2 = now(CLOCK_MONOTONIC);
+
+        do {
+                unsigned i;
+
+                for (i = 0; i < 1000; i++)
+                        assert_se(parse_message(split, buf, size) == n_fields);
+
+                n_messages += i;
+                total += i * size;
+
+                n2 = now(CLOCK_MONOTONIC);
+        } while (n2 - n < arg_duration);
+
+        dt = (n2-n) / 1e6;
+
+        log_info("%s: %zu fields of %zu bytes: parsed %zu messages in %.2fs (%.2fMiB/s, %.0f messages/s)",
+                 label, n_fields, value_size, n_messages, dt,
+                 total / 1024. / 1024 / dt, n_messages / dt);
+}
+
+int main(int argc, char *argv[]) {
+        static const size_t value_sizes[] = { 8, 64, 1024 };
+        size_t i;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc >= 2) {
+                unsigned x;
+
+                assert_se(safe_atou(argv[1], &x) >= 0);
+                arg_duration = x * USEC_PER_SEC;
+        } else
+                arg_duration = slow_tests_enabled() ?
+                        USEC_PER_SEC : USEC_PER_SEC / 50;
+
+        test_compare();
+
+        for (i = 0; i < ELEMENTSOF(value_sizes); i++) {
+                test_benchmark("reference", split_reference, 40, value_sizes[i]);
+                test_benchmark("native_field_split", native_field_split, 40, value_sizes[i]);
+        }
+
+        return 0;
+}
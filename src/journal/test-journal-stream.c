@@ -60,12 +60,18 @@ static void verify_contents(sd_journal *j, unsigned skip) {
 int main(int argc, char *argv[]) {
         JournalFile *one, *two, *three;
         char t[] = "/tmp/journal-stream-XXXXXX";
-        unsigned i;
+        unsigned i, n_unique;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
         char *z;
         const void *data;
         size_t l;
         dual_timestamp previous_ts = DUAL_TIMESTAMP_NULL;
+        sd_journal_stats stats;
+        union {
+                sd_journal_stats stats;
+                uint8_t bytes[sizeof(sd_journal_stats) + 16];
+        } bigger;
+        size_t k;
 
         /* journal_file_open requires a valid machine id */
         if (access("/etc/machine-id", F_OK) != 0)
@@ -171,8 +177,36 @@ int main(int argc, char *argv[]) {
         verify_contents(j, 0);
 
         assert_se(sd_journal_query_unique(j, "NUMBER") >= 0);
-        SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
+        n_unique = 0;
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l) {
                 printf("%.*s\n", (int) l, (const char*) data);
+                n_unique++;
+        }
+        assert_se(n_unique == N_ENTRIES);
+
+        /* MAGIC= is in all three files, with the same two values */
+        assert_se(sd_journal_query_unique(j, "MAGIC") >= 0);
+        n_unique = 0;
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
+                n_unique++;
+        assert_se(n_unique == 2);
+
+        assert_se(sd_journal_get_stats(j, &stats, sizeof(stats)) >= 0);
+        log_info("mmap cache: %" PRIu64 " hit, %" PRIu64 " missed, %" PRIu64 " windows, %" PRIu64 " bytes",
+                 stats.mmap_hit, stats.mmap_missed, stats.mmap_windows, stats.mmap_bytes);
+        assert_se(stats.mmap_hit > 0);
+        assert_se(stats.mmap_missed > 0);
+        assert_se(stats.mmap_windows > 0);
+        assert_se(stats.mmap_bytes > 0);
+        assert_se(stats.sigbus == 0);
+
+        /* Callers built against a newer version of the structure get the fields we don't know about zeroed */
+        memset(&bigger, 0xff, sizeof(bigger));
+        assert_se(sd_journal_get_stats(j, &bigger.stats, sizeof(bigger)) >= 0);
+        assert_se(memcmp(&bigger.stats, &stats, sizeof(stats)) == 0);
+        for (k = sizeof(stats); k < sizeof(bigger); k++)
+                assert_se(bigger.bytes[k] == 0);
+        assert_se(sd_journal_get_stats(j, &stats, sizeof(stats) - 1) == -EINVAL);
 
         assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
 
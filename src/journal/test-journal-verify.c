@@ -2,14 +2,17 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
 #include "fd-util.h"
 #include "io-util.h"
 #include "journal-file.h"
 #include "journal-verify.h"
 #include "log.h"
 #include "rm-rf.h"
+#include "string-util.h"
 #include "terminal-util.h"
 #include "tests.h"
 #include "util.h"
@@ -50,6 +53,101 @@ static int raw_verify(const char *fn, const char *verification_key) {
         return r;
 }
 
+static void append_entries(JournalFile *f, unsigned n, uint64_t *ret_offset) {
+        unsigned i;
+
+        for (i = 0; i < n; i++) {
+                struct iovec iovec;
+                struct dual_timestamp ts;
+                char *test;
+
+                dual_timestamp_get(&ts);
+
+                assert_se(asprintf(&test, "RANDOM=%lu", random() % RANDOM_RANGE));
+
+                iovec = IOVEC_MAKE_STRING(test);
+
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, ret_offset) == 0);
+
+                free(test);
+        }
+}
+
+static int incremental_verify(const char *fn, const char *verification_key) {
+        JournalFile *f;
+        int r;
+
+        r = journal_file_open(-1, fn, O_RDONLY, 0666, true, (uint64_t) -1, !!verification_key, NULL, NULL, NULL, NULL, &f);
+        if (r < 0)
+                return r;
+
+        r = journal_file_verify_incremental(f, verification_key, "checkpoints", NULL, NULL, NULL, false);
+        (void) journal_file_close(f);
+
+        return r;
+}
+
+static void checkpoint_path(const char *fn, char **ret) {
+        char id[SD_ID128_STRING_MAX];
+        JournalFile *f;
+
+        assert_se(journal_file_open(-1, fn, O_RDONLY, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(*ret = strjoin("checkpoints/", sd_id128_to_string(f->header->file_id, id)));
+        (void) journal_file_close(f);
+}
+
+static void test_incremental(const char *verification_key) {
+        _cleanup_free_ char *cp = NULL;
+        JournalFile *f;
+        struct stat st;
+        uint64_t p;
+
+        log_info("Verifying incrementally...");
+
+        assert_se(journal_file_open(-1, "incremental.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, !!verification_key, NULL, NULL, NULL, NULL, &f) == 0);
+        append_entries(f, N_ENTRIES / 4, NULL);
+        (void) journal_file_close(f);
+
+        /* The first run has nothing to go by and checks everything, later ones pick up from the checkpoint */
+        assert_se(incremental_verify("incremental.journal", verification_key) == 0);
+        assert_se(incremental_verify("incremental.journal", verification_key) > 0);
+
+        assert_se(journal_file_open(-1, "incremental.journal", O_RDWR, 0666, true, (uint64_t) -1, !!verification_key, NULL, NULL, NULL, NULL, &f) == 0);
+        append_entries(f, N_ENTRIES / 4, &p);
+        (void) journal_file_close(f);
+
+        /* Corruption in the appended part is still caught */
+        bit_toggle("incremental.journal", (p + offsetof(EntryObject, seqnum)) * 8);
+        assert_se(incremental_verify("incremental.journal", verification_key) < 0);
+        bit_toggle("incremental.journal", (p + offsetof(EntryObject, seqnum)) * 8);
+
+        assert_se(incremental_verify("incremental.journal", verification_key) > 0);
+        assert_se(raw_verify("incremental.journal", verification_key) >= 0);
+
+        /* A checkpoint that was tampered with is not used, and everything is checked again */
+        checkpoint_path("incremental.journal", &cp);
+        assert_se(stat(cp, &st) >= 0);
+        assert_se((st.st_mode & 07777) == 0600);
+
+        bit_toggle(cp, 24 * 8); /* the offset to continue from */
+        assert_se(incremental_verify("incremental.journal", verification_key) == 0);
+        assert_se(incremental_verify("incremental.journal", verification_key) > 0);
+
+        /* … as is one somebody else could have written */
+        assert_se(chmod(cp, 0620) >= 0);
+        assert_se(incremental_verify("incremental.journal", verification_key) == 0);
+        assert_se(incremental_verify("incremental.journal", verification_key) > 0);
+
+        if (verification_key) {
+                /* The HMAC of checkpoints of sealed files needs to match, and a checkpoint is only used
+                 * when the key is there to check it against */
+                bit_toggle(cp, (st.st_size - 1) * 8);
+                assert_se(incremental_verify("incremental.journal", verification_key) == 0);
+                assert_se(incremental_verify("incremental.journal", verification_key) > 0);
+                assert_se(incremental_verify("incremental.journal", NULL) == 0);
+        }
+}
+
 int main(int argc, char *argv[]) {
         char t[] = "/tmp/journal-XXXXXX";
         unsigned n;
@@ -109,6 +207,8 @@ int main(int argc, char *argv[]) {
 
         (void) journal_file_close(f);
 
+        test_incremental(verification_key);
+
         if (verification_key) {
                 log_info("Toggling bits...");
 
@@ -1,14 +1,22 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "dirent-util.h"
+#include "fd-util.h"
 #include "io-util.h"
 #include "journal-authenticate.h"
 #include "journal-file.h"
 #include "journal-vacuum.h"
 #include "log.h"
+#include "lookup3.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "tests.h"
 
 static bool arg_keep = false;
@@ -107,6 +115,417 @@ static void test_non_empty(void) {
         puts("------------------------------------------------------------");
 }
 
+static void test_append_entries(void) {
+        dual_timestamp ts[3];
+        JournalFile *f;
+        static const char host[] = "_HOSTNAME=batch", a[] = "MESSAGE=a", b[] = "MESSAGE=b";
+        struct iovec e1[] = { IOVEC_MAKE_STRING(host), IOVEC_MAKE_STRING(a) },
+                     e2[] = { IOVEC_MAKE_STRING(host), IOVEC_MAKE_STRING(b) },
+                     e3[] = { IOVEC_MAKE_STRING(a), IOVEC_MAKE_STRING(host) };
+        const struct iovec *const iovecs[] = { e1, e2, e3 };
+        const unsigned n_iovecs[] = { ELEMENTSOF(e1), ELEMENTSOF(e2), ELEMENTSOF(e3) };
+        Object *o;
+        uint64_t p, seqnum = 0, offsets[ELEMENTSOF(iovecs)];
+        size_t n;
+        char t[] = "/tmp/journal-XXXXXX";
+        unsigned i;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, true, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (i = 0; i < ELEMENTSOF(ts); i++)
+                assert_se(dual_timestamp_get(ts + i));
+
+        assert_se(journal_file_append_entries(f, ts, NULL, iovecs, n_iovecs, ELEMENTSOF(iovecs), &seqnum, offsets, &n) == 0);
+        assert_se(n == 3);
+        assert_se(seqnum == 3);
+
+        for (i = 0; i < ELEMENTSOF(offsets); i++) {
+                assert_se(journal_file_move_to_object(f, OBJECT_ENTRY, offsets[i], &o) >= 0);
+                assert_se(le64toh(o->entry.seqnum) == i + 1);
+        }
+        assert_se(le64toh(f->header->n_entries) == 3);
+        assert_se(le64toh(f->header->n_data) == 3);
+
+        assert_se(journal_file_find_data_object(f, host, strlen(host), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 3);
+
+        assert_se(journal_file_find_data_object(f, a, strlen(a), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 2);
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, p, DIRECTION_UP, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 3);
+
+        assert_se(journal_file_find_data_object(f, b, strlen(b), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 1);
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, p, DIRECTION_DOWN, &o, NULL) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2);
+
+        /* Refuse the whole batch if any timestamp is invalid */
+        ts[1].realtime = 0;
+        assert_se(journal_file_append_entries(f, ts, NULL, iovecs, n_iovecs, ELEMENTSOF(iovecs), &seqnum, NULL, &n) == -EBADMSG);
+        assert_se(le64toh(f->header->n_entries) == 3);
+
+        assert_se(journal_file_append_entries(f, NULL, NULL, iovecs, n_iovecs, 0, &seqnum, NULL, &n) == 0);
+        assert_se(n == 0);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_data_cache(void) {
+        dual_timestamp ts;
+        JournalFile *f;
+        _cleanup_free_ char *large = NULL;
+        static const char host[] = "_HOSTNAME=cache";
+        struct iovec iovec[2];
+        Object *o;
+        uint64_t p;
+        char t[] = "/tmp/journal-XXXXXX";
+        unsigned i;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(large = malloc(4096 + 1));
+        memcpy(large, "LARGE=", 6);
+        memset(large + 6, 'x', 4096 - 6);
+        large[4096] = 0;
+
+        iovec[0] = IOVEC_MAKE_STRING(host);
+        iovec[1] = IOVEC_MAKE_STRING(large);
+
+        for (i = 0; i < 3; i++) {
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL) == 0);
+        }
+
+        assert_se(le64toh(f->header->n_entries) == 3);
+        assert_se(le64toh(f->header->n_data) == 2);
+
+        /* Only the short payload is worth caching */
+        assert_se(ordered_hashmap_size(f->data_cache) == 1);
+
+        assert_se(journal_file_find_data_object(f, host, strlen(host), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 3);
+        assert_se(journal_file_find_data_object(f, large, strlen(large), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 3);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_summary(void) {
+        static const char a[] = "_SYSTEMD_UNIT=a.service", b[] = "_SYSTEMD_UNIT=b.service", m[] = "MESSAGE=foo";
+        const char *units[] = { a, b };
+        char t[] = "/tmp/journal-XXXXXX";
+        sd_id128_t boot_ids[3];
+        struct iovec iovec;
+        dual_timestamp ts;
+        JournalFile *f;
+        unsigned i, n_false_positives = 0;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (i = 0; i < ELEMENTSOF(boot_ids); i++)
+                assert_se(sd_id128_randomize(boot_ids + i) >= 0);
+
+        /* Write entries from two boots and two units */
+        for (i = 0; i < 2; i++) {
+                char bid[STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX];
+                struct iovec iovecs[3];
+
+                xsprintf(bid, "_BOOT_ID=%s", sd_id128_to_string(boot_ids[i], (char[SD_ID128_STRING_MAX]) {}));
+
+                iovecs[0] = IOVEC_MAKE_STRING(bid);
+                iovecs[1] = IOVEC_MAKE_STRING(units[i]);
+                iovecs[2] = IOVEC_MAKE_STRING(m);
+
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, boot_ids + i, iovecs, ELEMENTSOF(iovecs), NULL, NULL, NULL) == 0);
+        }
+
+        /* Without a summary everything might be contained */
+        assert_se(journal_file_summary_may_contain(f, a, strlen(a), hash64(a, strlen(a))) > 0);
+        assert_se(journal_file_summary_may_contain(f, "_SYSTEMD_UNIT=c.service", 23, hash64("_SYSTEMD_UNIT=c.service", 23)) > 0);
+
+        assert_se(journal_file_archive(f) == 0);
+        assert_se(f->header->summary_offset != 0);
+
+        for (i = 0; i < ELEMENTSOF(boot_ids); i++) {
+                char bid[STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX];
+
+                xsprintf(bid, "_BOOT_ID=%s", sd_id128_to_string(boot_ids[i], (char[SD_ID128_STRING_MAX]) {}));
+                assert_se(journal_file_summary_may_contain(f, bid, strlen(bid), hash64(bid, strlen(bid))) == (i < 2));
+        }
+
+        assert_se(journal_file_summary_may_contain(f, a, strlen(a), hash64(a, strlen(a))) > 0);
+        assert_se(journal_file_summary_may_contain(f, b, strlen(b), hash64(b, strlen(b))) > 0);
+        assert_se(journal_file_summary_may_contain(f, m, strlen(m), hash64(m, strlen(m))) > 0);
+
+        /* A few false positives are expected from the Bloom filter, but not many. The filter covers all fields,
+         * not just the well-known ones. */
+        for (i = 0; i < 100; i++) {
+                char u[STRLEN("_SYSTEMD_UNIT=") + DECIMAL_STR_MAX(unsigned) + STRLEN(".service")];
+                int r;
+
+                if (i % 2 == 0)
+                        xsprintf(u, "_SYSTEMD_UNIT=%u.service", i);
+                else
+                        xsprintf(u, "MESSAGE=%u", i);
+                r = journal_file_summary_may_contain(f, u, strlen(u), hash64(u, strlen(u)));
+                assert_se(r >= 0);
+                if (r > 0)
+                        n_false_positives++;
+        }
+        log_info("Summary false positives: %u/100", n_false_positives);
+        assert_se(n_false_positives < 20);
+
+        /* New data invalidates the summary */
+        iovec = IOVEC_MAKE_STRING("_SYSTEMD_UNIT=c.service");
+        assert_se(dual_timestamp_get(&ts));
+        assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        assert_se(f->header->summary_offset == 0);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_summary_when_full(void) {
+        JournalMetrics metrics = {
+                .max_size = 512 * 1024,
+                .min_size = (uint64_t) -1,
+                .max_use = (uint64_t) -1,
+                .min_use = (uint64_t) -1,
+                .keep_free = (uint64_t) -1,
+                .n_max_files = (uint64_t) -1,
+        };
+        char t[] = "/tmp/journal-XXXXXX";
+        JournalFile *f;
+        unsigned i;
+        int r;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, (uint64_t) -1, false, &metrics, NULL, NULL, NULL, &f) == 0);
+
+        /* Fill the file with distinct values until it refuses more, as journald would before rotating it */
+        for (i = 0;; i++) {
+                char m[STRLEN("MESSAGE=") + DECIMAL_STR_MAX(unsigned)];
+                struct iovec iovec;
+                dual_timestamp ts;
+
+                xsprintf(m, "MESSAGE=%u", i);
+                iovec = IOVEC_MAKE_STRING(m);
+
+                assert_se(dual_timestamp_get(&ts));
+                r = journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL);
+                if (r == -E2BIG)
+                        break;
+                assert_se(r == 0);
+        }
+
+        log_info("File full after %u entries, %"PRIu64" data objects", i, le64toh(f->header->n_data));
+
+        /* There is still room for the summary */
+        assert_se(journal_file_archive(f) == 0);
+        assert_se(f->header->summary_offset != 0);
+        assert_se(le64toh(f->header->header_size) + le64toh(f->header->arena_size) <= metrics.max_size);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static uint64_t count_journal_files(const char *path, uint64_t *ret_usage) {
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        uint64_t n = 0;
+
+        assert_se(d = opendir(path));
+
+        *ret_usage = 0;
+        FOREACH_DIRENT(de, d, assert_not_reached("readdir failed")) {
+                struct stat st;
+
+                if (!endswith(de->d_name, ".journal"))
+                        continue;
+
+                assert_se(fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) >= 0);
+                *ret_usage += 512UL * (uint64_t) st.st_blocks;
+                n++;
+        }
+
+        return n;
+}
+
+static void test_directory_index(void) {
+        _cleanup_(journal_directory_freep) JournalDirectory *d = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        static const char test[] = "TEST1=1";
+        char t[] = "/tmp/journal-XXXXXX";
+        uint64_t usage, expected;
+        struct iovec iovec;
+        dual_timestamp ts;
+        JournalFile *f;
+        unsigned i;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(journal_directory_new(t, &d) >= 0);
+        assert_se(journal_directory_watch(d, e) > 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        iovec = IOVEC_MAKE_STRING(test);
+        for (i = 0; i < 4; i++) {
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+                assert_se(journal_file_rotate(&f, true, (uint64_t) -1, false, NULL) >= 0);
+        }
+
+        /* Pick up the renames and the new files via inotify */
+        while (sd_event_run(e, 0) > 0)
+                ;
+
+        assert_se(count_journal_files(t, &expected) == 5);
+        assert_se(journal_directory_refresh(d, &usage) >= 0);
+        assert_se(usage == expected);
+
+        /* Keep the active file and the newest archived one only */
+        assert_se(journal_directory_vacuum_index(d, 0, 2, 0, NULL, 4, true) >= 0);
+        assert_se(count_journal_files(t, &expected) == 2);
+        assert_se(journal_directory_refresh(d, &usage) >= 0);
+        assert_se(usage == expected);
+
+        /* And now rotate once more, without dispatching the events first */
+        assert_se(dual_timestamp_get(&ts));
+        assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        assert_se(journal_file_rotate(&f, true, (uint64_t) -1, false, NULL) >= 0);
+        journal_directory_invalidate(d);
+
+        assert_se(journal_directory_vacuum_index(d, 0, 1, 0, NULL, 4, true) >= 0);
+        assert_se(count_journal_files(t, &expected) == 1);
+
+        while (sd_event_run(e, 0) > 0)
+                ;
+
+        assert_se(journal_directory_refresh(d, &usage) >= 0);
+        assert_se(usage == expected);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static uint64_t fill_and_rotate(JournalFile **f, unsigned n, bool unique) {
+        char buf[STRLEN("ID=") + DECIMAL_STR_MAX(unsigned)];
+        struct iovec iovec;
+        dual_timestamp ts;
+        unsigned i;
+
+        for (i = 0; i < n; i++) {
+                xsprintf(buf, "ID=%u", unique ? i : i % 10);
+                iovec = IOVEC_MAKE_STRING(buf);
+
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(*f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        assert_se(journal_file_rotate(f, false, (uint64_t) -1, false, NULL) >= 0);
+
+        return le64toh((*f)->header->data_hash_table_size) / sizeof(HashItem);
+}
+
+static void test_hash_table_sizing(void) {
+        JournalMetrics metrics = {
+                .max_size = 8 * 1024 * 1024,
+                .min_size = (uint64_t) -1,
+                .max_use = (uint64_t) -1,
+                .min_use = (uint64_t) -1,
+                .keep_free = (uint64_t) -1,
+                .n_max_files = (uint64_t) -1,
+        };
+        char t[] = "/tmp/journal-XXXXXX";
+        uint64_t initial, n;
+        JournalFile *f;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, (uint64_t) -1, false, &metrics, NULL, NULL, NULL, &f) == 0);
+        initial = le64toh(f->header->data_hash_table_size) / sizeof(HashItem);
+
+        /* A new value in every entry: the next file needs a larger table than estimated from the file size */
+        n = fill_and_rotate(&f, 10000, true);
+        log_info("Data hash table: %"PRIu64" entries initially, %"PRIu64" after unique values", initial, n);
+        assert_se(n > initial);
+
+        /* Few distinct values: the table shrinks again, but not below the default */
+        n = fill_and_rotate(&f, 20000, false);
+        log_info("Data hash table: %"PRIu64" entries after repeated values", n);
+        assert_se(n < initial);
+        assert_se(n >= 2047);
+
+        (void) journal_file_close(f);
+
+        if (arg_keep)
+                log_info("Not removing %s", t);
+        else
+                assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
 static void test_empty(void) {
         JournalFile *f1, *f2, *f3, *f4;
         char t[] = "/tmp/journal-XXXXXX";
@@ -149,7 +568,7 @@ static void test_empty(void) {
         (void) journal_file_close(f4);
 }
 
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
 static bool check_compressed(uint64_t compress_threshold, uint64_t data_size) {
         dual_timestamp ts;
         JournalFile *f;
@@ -243,8 +662,14 @@ int main(int argc, char *argv[]) {
                 return log_tests_skipped("/etc/machine-id not found");
 
         test_non_empty();
+        test_append_entries();
+        test_data_cache();
+        test_summary();
+        test_summary_when_full();
+        test_directory_index();
+        test_hash_table_sizing();
         test_empty();
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         test_min_compress_size();
 #endif
 
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "journald-server.h"
+#include "socket-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+static void send_datagram(int fd, char c, size_t size) {
+        _cleanup_free_ char *buf = NULL;
+
+        assert_se(buf = malloc(size));
+        memset(buf, c, size);
+
+        assert_se(send(fd, buf, size, MSG_DONTWAIT) == (ssize_t) size);
+}
+
+static void check_datagram(const struct mmsghdr *h, char c, size_t size) {
+        const char *p = h->msg_hdr.msg_iov->iov_base;
+        size_t i;
+
+        assert_se(!FLAGS_SET(h->msg_hdr.msg_flags, MSG_TRUNC));
+        assert_se(h->msg_len == size);
+
+        for (i = 0; i < size; i++)
+                assert_se(p[i] == c);
+}
+
+static void server_free_batch(Server *s) {
+        s->receive_batch = mfree(s->receive_batch);
+        s->receive_slots = mfree(s->receive_slots);
+        assert_se(munmap(s->receive_buffer, s->receive_buffer_size) >= 0);
+        s->receive_buffer = NULL;
+        s->receive_buffer_size = 0;
+}
+
+static void test_batch_mixed_sizes(void) {
+        _cleanup_close_pair_ int fds[2] = { -1, -1 };
+        Server s = {
+                .receive_batch_size = 4,
+        };
+
+        log_info("/* %s */", __func__);
+
+        assert_se(socketpair(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0, fds) >= 0);
+        (void) setsockopt_int(fds[1], SOL_SOCKET, SO_SNDBUF, 1024 * 1024);
+
+        /* Small datagrams, with ones larger than what is commonly sent between them */
+        send_datagram(fds[1], 'a', 100);
+        send_datagram(fds[1], 'B', 64 * 1024);
+        send_datagram(fds[1], 'c', 200);
+        send_datagram(fds[1], 'd', 300);
+        send_datagram(fds[1], 'E', 32 * 1024);
+        send_datagram(fds[1], 'F', 256 * 1024);
+        send_datagram(fds[1], 'g', 500);
+        send_datagram(fds[1], 'h', 600);
+        send_datagram(fds[1], 'i', 700);
+        send_datagram(fds[1], 'j', 800);
+
+        /* All of them arrive in full, in full batches */
+        assert_se(server_receive_datagram_batch(&s, fds[0]) == 4);
+        check_datagram(s.receive_batch + 0, 'a', 100);
+        check_datagram(s.receive_batch + 1, 'B', 64 * 1024);
+        check_datagram(s.receive_batch + 2, 'c', 200);
+        check_datagram(s.receive_batch + 3, 'd', 300);
+
+        assert_se(server_receive_datagram_batch(&s, fds[0]) == 4);
+        check_datagram(s.receive_batch + 0, 'E', 32 * 1024);
+        check_datagram(s.receive_batch + 1, 'F', 256 * 1024);
+        check_datagram(s.receive_batch + 2, 'g', 500);
+        check_datagram(s.receive_batch + 3, 'h', 600);
+
+        /* … and the rest */
+        assert_se(server_receive_datagram_batch(&s, fds[0]) == 2);
+        check_datagram(s.receive_batch + 0, 'i', 700);
+        check_datagram(s.receive_batch + 1, 'j', 800);
+
+        assert_se(server_receive_datagram_batch(&s, fds[0]) == 0);
+
+        server_free_batch(&s);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_batch_mixed_sizes();
+
+        return 0;
+}
@@ -0,0 +1,241 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "io-util.h"
+#include "journal-util.h"
+#include "journald-follow.h"
+#include "logs-show.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+static bool matches(char **m, const char *uid_field, const char *fields) {
+        _cleanup_strv_free_ char **l = NULL;
+        struct iovec iovec[16];
+        Follower f = {
+                .fd = -1,
+                .matches = m,
+                .uid_field = (char*) uid_field,
+        };
+        size_t n = 0;
+        char **i;
+
+        assert_se(l = strv_split(fields, " "));
+        STRV_FOREACH(i, l) {
+                assert_se(n < ELEMENTSOF(iovec));
+                iovec[n++] = IOVEC_MAKE_STRING(*i);
+        }
+
+        return follower_matches(&f, iovec, n);
+}
+
+static void test_follower_matches(void) {
+        char **m;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(matches(NULL, NULL, "A=1"));
+        assert_se(matches(NULL, "_UID=1000", "A=1 _UID=1000"));
+        assert_se(!matches(NULL, "_UID=1000", "A=1 _UID=10000"));
+
+        /* Different fields all need to match, the same field any of its values */
+        m = STRV_MAKE("A=1", "B=2", "A=3");
+        assert_se(matches(m, NULL, "A=1 B=2"));
+        assert_se(matches(m, NULL, "A=3 B=2 C=4"));
+        assert_se(!matches(m, NULL, "A=1 B=3"));
+        assert_se(!matches(m, NULL, "A=2 B=2"));
+        assert_se(!matches(m, NULL, "B=2"));
+        assert_se(!matches(m, "_UID=1000", "A=1 B=2"));
+
+        /* "+" separates alternatives */
+        m = STRV_MAKE("A=1", "B=2", "+", "C=3");
+        assert_se(matches(m, NULL, "A=1 B=2"));
+        assert_se(matches(m, NULL, "C=3"));
+        assert_se(matches(m, NULL, "A=2 C=3"));
+        assert_se(!matches(m, NULL, "A=1"));
+        assert_se(!matches(m, NULL, "A=1 C=4"));
+        assert_se(!matches(m, "_UID=1000", "C=3"));
+        assert_se(matches(m, "_UID=1000", "_UID=1000 C=3"));
+}
+
+static int parse_request(const char *request, char ***ret) {
+        Follower f = {
+                .fd = -1,
+        };
+        int r;
+
+        assert_se(f.buffer = strdup(request));
+        f.length = strlen(request);
+
+        r = follower_parse_request(&f);
+
+        free(f.buffer);
+        if (ret)
+                *ret = TAKE_PTR(f.matches);
+        strv_free(f.matches);
+
+        return r;
+}
+
+static void test_follower_parse_request(void) {
+        _cleanup_strv_free_ char **m = NULL;
+        Follower f = {
+                .fd = -1,
+        };
+
+        log_info("/* %s */", __func__);
+
+        assert_se(parse_request("\n", &m) == 1);
+        assert_se(strv_isempty(m));
+
+        assert_se(parse_request("A=1\nB=2\n+\n_C=3\n\ntrailing garbage", &m) == 1);
+        assert_se(strv_equal(m, STRV_MAKE("A=1", "B=2", "+", "_C=3")));
+        m = strv_free(m);
+
+        /* Not complete yet */
+        assert_se(parse_request("", NULL) == 0);
+        assert_se(parse_request("A=1\n", NULL) == 0);
+        assert_se(parse_request("A=1\nB=", NULL) == 0);
+
+        /* "+" only goes between matches, and matches need a valid field name */
+        assert_se(parse_request("+\nA=1\n\n", NULL) == -EINVAL);
+        assert_se(parse_request("A=1\n+\n+\nB=2\n\n", NULL) == -EINVAL);
+        assert_se(parse_request("A=1\n+\n\n", NULL) == -EINVAL);
+        assert_se(parse_request("A\n\n", NULL) == -EINVAL);
+        assert_se(parse_request("a=1\n\n", NULL) == -EINVAL);
+        assert_se(parse_request("=1\n\n", NULL) == -EINVAL);
+
+        /* The request may arrive in pieces */
+        assert_se(f.buffer = strdup("A=1\nB"));
+        f.length = strlen(f.buffer);
+        assert_se(follower_parse_request(&f) == 0);
+        assert_se(strv_equal(f.matches, STRV_MAKE("A=1")));
+
+        free(f.buffer);
+        assert_se(f.buffer = strdup("A=1\nB=2\n\n"));
+        f.length = strlen(f.buffer);
+        assert_se(follower_parse_request(&f) == 1);
+        assert_se(strv_equal(f.matches, STRV_MAKE("A=1", "B=2")));
+        assert_se(f.offset == f.length);
+
+        free(f.buffer);
+        strv_free(f.matches);
+}
+
+static void test_follow_export_entry(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_free_ char *data = NULL, *expected = NULL, *both = NULL, *bid_field = NULL;
+        _cleanup_(sd_journal_closep) sd_journal *j = NULL;
+        _cleanup_fclose_ FILE *mf = NULL;
+        char bid[SD_ID128_STRING_MAX];
+        size_t size = 0, expected_size = 0;
+        const char *fn, *cursor;
+        uint64_t seqnum = 0, n;
+        sd_id128_t boot_id, seqnum_id, id;
+        JournalFile *f = NULL;
+        struct iovec iovec[4];
+        dual_timestamp ts;
+        Object *o;
+        uint64_t offset;
+
+        log_info("/* %s */", __func__);
+
+        if (sd_id128_get_boot(&boot_id) < 0) {
+                log_notice("Boot ID not available, skipping %s.", __func__);
+                return;
+        }
+
+        assert_se(mkdtemp_malloc("/tmp/journal-follow-XXXXXX", &t) >= 0);
+        fn = strjoina(t, "/test.journal");
+
+        assert_se(journal_file_open(-1, fn, O_RDWR|O_CREAT, 0644, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        /* journald passes on the _BOOT_ID= field like any other, the export format has it in the header */
+        assert_se(bid_field = strjoin("_BOOT_ID=", sd_id128_to_string(boot_id, bid)));
+        iovec[0] = IOVEC_MAKE_STRING("MESSAGE=hello");
+        iovec[1] = IOVEC_MAKE_STRING(bid_field);
+        iovec[2] = IOVEC_MAKE_STRING("MULTI=line\nline");
+        iovec[3] = IOVEC_MAKE_STRING("BINARY=\001\002");
+
+        dual_timestamp_get(&ts);
+        assert_se(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), &seqnum, NULL, &offset) == 0);
+        assert_se(journal_file_move_to_object(f, OBJECT_ENTRY, offset, &o) == 0);
+        assert_se(follow_export_entry(f, o, iovec, ELEMENTSOF(iovec), &data, &size) == 0);
+        seqnum_id = f->header->seqnum_id;
+
+        (void) journal_file_close(f);
+
+        /* What journalctl would show reading the file */
+        assert_se(sd_journal_open_files(&j, (const char**) STRV_MAKE(fn), 0) >= 0);
+        assert_se(sd_journal_next(j) == 1);
+
+        assert_se(mf = open_memstream(&expected, &expected_size));
+        assert_se(show_journal_entry(mf, j, OUTPUT_EXPORT, 0, 0, NULL, NULL, NULL) >= 0);
+        assert_se(fflush_and_check(mf) >= 0);
+
+        assert_se(size == expected_size);
+        assert_se(memcmp(data, expected, size) == 0);
+
+        /* The size of the entry is determined correctly, also with a binary field in it */
+        assert_se(journal_export_entry_size(data, size) == size);
+        assert_se(journal_export_entry_size(data, size - 1) == 0);
+        assert_se(journal_export_entry_size(data, 0) == 0);
+
+        assert_se(both = malloc(size * 2));
+        memcpy(both, data, size);
+        memcpy(both + size, data, size);
+        assert_se(journal_export_entry_size(both, size * 2) == size);
+        assert_se(journal_export_entry_size(both + size, size) == size);
+
+        /* A binary field that claims to be larger than what is there */
+        assert_se(journal_export_entry_size("A\n\377\0\0\0\0\0\0\0x\n\n", 13) == 0);
+
+        /* The cursor line yields the sequence number */
+        assert_se(cursor = startswith(data, "__CURSOR="));
+        assert_se(journal_cursor_get_seqnum(cursor, strcspn(cursor, "\n"), &id, &n) == 0);
+        assert_se(sd_id128_equal(id, seqnum_id));
+        assert_se(n == seqnum);
+}
+
+static void test_cursor_get_seqnum(void) {
+        sd_id128_t id;
+        uint64_t n;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(journal_cursor_get_seqnum("s=0123456789abcdef0123456789abcdef;i=2a;b=0123456789abcdef0123456789abcdef;m=1;t=2;x=3",
+                                            SIZE_MAX, &id, &n) == 0);
+        assert_se(sd_id128_equal(id, SD_ID128_MAKE(01,23,45,67,89,ab,cd,ef,01,23,45,67,89,ab,cd,ef)));
+        assert_se(n == 0x2a);
+
+        /* Only the first n bytes count */
+        assert_se(journal_cursor_get_seqnum("s=0123456789abcdef0123456789abcdef;b=0;i=2a", 37, &id, &n) == -EINVAL);
+        assert_se(journal_cursor_get_seqnum("i=2a;s=0123456789abcdef0123456789abcdef\nfoo", 39, &id, &n) == 0);
+        assert_se(n == 0x2a);
+
+        assert_se(journal_cursor_get_seqnum("i=2a", SIZE_MAX, &id, &n) == -EINVAL);
+        assert_se(journal_cursor_get_seqnum("s=0123456789abcdef0123456789abcdef", SIZE_MAX, &id, &n) == -EINVAL);
+        assert_se(journal_cursor_get_seqnum("s=foo;i=2a", SIZE_MAX, &id, &n) == -EINVAL);
+        assert_se(journal_cursor_get_seqnum("s=0123456789abcdef0123456789abcdef;i=zz", SIZE_MAX, &id, &n) == -EINVAL);
+        assert_se(journal_cursor_get_seqnum("", SIZE_MAX, &id, &n) == -EINVAL);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_follower_matches();
+        test_follower_parse_request();
+        test_follow_export_entry();
+        test_cursor_get_seqnum();
+
+        return 0;
+}
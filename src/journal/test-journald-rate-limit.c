@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <syslog.h>
+
+#include "journald-rate-limit.h"
+#include "macro.h"
+#include "time-util.h"
+
+static void test_rate_limit_burst(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new());
+
+        /* Without available disk space the burst is not modulated */
+        for (i = 0; i < 10; i++)
+                assert_se(journal_rate_limit_test(r, "/system.slice/a.service", USEC_PER_HOUR, 10, LOG_DEBUG, 0) == 1);
+
+        assert_se(journal_rate_limit_test(r, "/system.slice/a.service", USEC_PER_HOUR, 10, LOG_DEBUG, 0) == 0);
+        assert_se(journal_rate_limit_test(r, "/system.slice/a.service", USEC_PER_HOUR, 10, LOG_DEBUG, 0) == 0);
+        assert_se(journal_rate_limit_get_suppressed(r) == 2);
+
+        /* Other groups are not affected */
+        assert_se(journal_rate_limit_test(r, "/system.slice/b.service", USEC_PER_HOUR, 10, LOG_DEBUG, 0) == 1);
+
+        /* Errors have their own pool, and report what was dropped before */
+        assert_se(journal_rate_limit_test(r, "/system.slice/a.service", USEC_PER_HOUR, 10, LOG_ERR, 0) == 3);
+
+        /* Rate limiting may be turned off */
+        assert_se(journal_rate_limit_test(r, "/system.slice/a.service", 0, 10, LOG_DEBUG, 0) == 1);
+        assert_se(journal_rate_limit_test(r, "/system.slice/a.service", USEC_PER_HOUR, 0, LOG_DEBUG, 0) == 1);
+
+        journal_rate_limit_free(r);
+}
+
+static void test_rate_limit_priority(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new());
+
+        /* Errors may use up what debug messages left over, but not the other way round */
+        for (i = 0; i < 4 * 10; i++)
+                assert_se(journal_rate_limit_test(r, "x", USEC_PER_HOUR, 10, LOG_ERR, 0) == 1);
+        assert_se(journal_rate_limit_test(r, "x", USEC_PER_HOUR, 10, LOG_ERR, 0) == 0);
+        assert_se(journal_rate_limit_test(r, "x", USEC_PER_HOUR, 10, LOG_CRIT, 0) > 0);
+        assert_se(journal_rate_limit_test(r, "x", USEC_PER_HOUR, 10, LOG_DEBUG, 0) == 0);
+
+        journal_rate_limit_free(r);
+}
+
+static void test_rate_limit_early_reject(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new());
+
+        /* Unknown groups are never rejected early */
+        assert_se(!journal_rate_limit_early_reject(r, "x"));
+
+        for (i = 0; i < 10; i++)
+                assert_se(journal_rate_limit_test(r, "x", USEC_PER_HOUR, 10, LOG_DEBUG, 0) == 1);
+
+        /* Only the debug pool is exhausted, a message of different priority might still pass */
+        assert_se(!journal_rate_limit_early_reject(r, "x"));
+
+        for (i = 0; i < 4 * 10; i++)
+                assert_se(journal_rate_limit_test(r, "x", USEC_PER_HOUR, 10, LOG_EMERG, 0) == 1);
+
+        assert_se(journal_rate_limit_early_reject(r, "x"));
+        assert_se(journal_rate_limit_early_reject(r, "x"));
+        assert_se(journal_rate_limit_get_suppressed(r) == 2);
+
+        journal_rate_limit_free(r);
+}
+
+static void test_rate_limit_refill(void) {
+        JournalRateLimit *r;
+        unsigned i;
+
+        assert_se(r = journal_rate_limit_new());
+
+        for (i = 0; i < 5; i++)
+                assert_se(journal_rate_limit_test(r, "x", 100 * USEC_PER_MSEC, 5, LOG_DEBUG, 0) == 1);
+        assert_se(journal_rate_limit_test(r, "x", 100 * USEC_PER_MSEC, 5, LOG_DEBUG, 0) == 0);
+
+        /* After half the interval, about half the burst is available again */
+        usleep(50 * USEC_PER_MSEC);
+        assert_se(journal_rate_limit_test(r, "x", 100 * USEC_PER_MSEC, 5, LOG_DEBUG, 0) == 2);
+
+        journal_rate_limit_free(r);
+}
+
+int main(int argc, char *argv[]) {
+        test_rate_limit_burst();
+        test_rate_limit_priority();
+        test_rate_limit_early_reject();
+        test_rate_limit_refill();
+
+        return 0;
+}
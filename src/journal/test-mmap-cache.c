@@ -12,10 +12,13 @@
 #include "util.h"
 
 int main(int argc, char *argv[]) {
-        MMapFileDescriptor *fx;
+        MMapFileDescriptor *fx, *fy;
         int x, y, z, r;
         char px[] = "/tmp/testmmapXXXXXXX", py[] = "/tmp/testmmapYXXXXXX", pz[] = "/tmp/testmmapZXXXXXX";
+        MMapCacheStatistics s;
         MMapCache *m;
+        struct stat st;
+        size_t l, k;
         void *p, *q;
 
         assert_se(m = mmap_cache_new());
@@ -55,6 +58,35 @@ int main(int argc, char *argv[]) {
 
         assert_se((uint8_t*) p + 1 == (uint8_t*) q);
 
+        mmap_cache_get_statistics(m, 0, &s);
+        assert_se(s.n_hit == 1);
+        assert_se(s.n_missed == 2);
+        mmap_cache_get_statistics(m, 1, &s);
+        assert_se(s.n_hit == 2);
+        assert_se(s.n_missed == 0);
+
+        /* Reading a file front to back should make the windows grow */
+        assert_se(ftruncate(y, 256ULL*1024ULL*1024ULL) >= 0);
+        assert_se(fstat(y, &st) >= 0);
+        assert_se(fy = mmap_cache_add_fd(m, y));
+
+        r = mmap_cache_get(m, fy, PROT_READ, 2, false, 0, 2, &st, &p, &l);
+        assert_se(r >= 0);
+
+        r = mmap_cache_get(m, fy, PROT_READ, 2, false, l, 2, &st, &p, &k);
+        assert_se(r >= 0);
+
+        r = mmap_cache_get(m, fy, PROT_READ, 2, false, l + k, 2, &st, &p, NULL);
+        assert_se(r >= 0);
+
+        mmap_cache_get_statistics(m, 2, &s);
+        assert_se(s.n_missed == 3);
+        assert_se(s.n_sequential == 2);
+#if !ENABLE_DEBUG_MMAP_CACHE
+        assert_se(k > l);
+#endif
+
+        mmap_cache_free_fd(m, fy);
         mmap_cache_free_fd(m, fx);
         mmap_cache_unref(m);
 
@@ -50,6 +50,9 @@ struct sd_dhcp_lease {
         bool have_broadcast;
         be32_t broadcast;
 
+        /* the ACK was sent in reply to a DISCOVER (RFC 4039) */
+        bool rapid_commit;
+
         struct in_addr *dns;
         size_t dns_size;
 
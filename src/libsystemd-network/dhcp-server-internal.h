@@ -27,6 +27,23 @@ typedef struct DHCPLease {
         usec_t expiration;
 } DHCPLease;
 
+/* The maximum number of datagrams to read with a single recvmmsg() call, and the size of each read buffer.
+ * Larger datagrams are dropped, DHCP messages are normally no larger than 576 bytes. */
+#define DHCP_SERVER_RECEIVE_BATCH_MAX 16U
+#define DHCP_SERVER_RECEIVE_BUFFER_SIZE 4096U
+
+typedef struct DHCPReceiveSlot {
+        struct iovec iovec;
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+        } control;
+        union {
+                DHCPMessage message;
+                uint8_t buf[DHCP_SERVER_RECEIVE_BUFFER_SIZE];
+        } buffer;
+} DHCPReceiveSlot;
+
 struct sd_dhcp_server {
         unsigned n_ref;
 
@@ -52,8 +69,18 @@ struct sd_dhcp_server {
 
         Hashmap *leases_by_client_id;
         DHCPLease **bound_leases;
+        /* One bit per address of the pool, set when the address is bound, and for the padding at the end of
+         * the last word, so that free addresses are found a word at a time */
+        uint64_t *bound_bitmap;
+        uint32_t n_bound;
         DHCPLease invalid_lease;
 
+        struct mmsghdr *receive_batch;
+        DHCPReceiveSlot *receive_slots;
+
+        char *lease_file;
+        sd_event_source *save_leases;
+
         uint32_t max_lease_time, default_lease_time;
 };
 
@@ -7,6 +7,7 @@
 #include "hashmap.h"
 #include "log.h"
 #include "prioq.h"
+#include "set.h"
 
 struct sd_lldp {
         unsigned n_ref;
@@ -21,6 +22,8 @@ struct sd_lldp {
 
         Prioq *neighbor_by_expiry;
         Hashmap *neighbor_by_id;
+        /* The same neighbors, indexed by the raw datagram they were parsed from */
+        Set *neighbor_by_raw;
 
         uint64_t neighbors_max;
 
@@ -48,6 +48,7 @@ struct sd_dhcp_client {
         union sockaddr_union link;
         sd_event_source *receive_message;
         bool request_broadcast;
+        bool rapid_commit;
         uint8_t *req_opts;
         size_t req_opts_allocated;
         size_t req_opts_size;
@@ -166,6 +167,14 @@ int sd_dhcp_client_set_request_broadcast(sd_dhcp_client *client, int broadcast)
         return 0;
 }
 
+int sd_dhcp_client_set_rapid_commit(sd_dhcp_client *client, int rapid_commit) {
+        assert_return(client, -EINVAL);
+
+        client->rapid_commit = !!rapid_commit;
+
+        return 0;
+}
+
 int sd_dhcp_client_set_request_option(sd_dhcp_client *client, uint8_t option) {
         size_t i;
 
@@ -795,6 +804,14 @@ static int client_send_discover(sd_dhcp_client *client) {
                         return r;
         }
 
+        /* RFC 4039: servers supporting it may reply with an ACK right away, rather than with an OFFER */
+        if (client->rapid_commit) {
+                r = dhcp_option_append(&discover->dhcp, optlen, &optoffset, 0,
+                                       SD_DHCP_OPTION_RAPID_COMMIT, 0, NULL);
+                if (r < 0)
+                        return r;
+        }
+
         if (client->hostname) {
                 /* According to RFC 4702 "clients that send the Client FQDN option in
                    their messages MUST NOT also send the Host Name option". Just send
@@ -1083,6 +1100,9 @@ static int client_timeout_resend(
                                 goto error;
                 }
 
+                /* with rapid commit, the lease may be granted in reply to the DISCOVER already */
+                client->request_sent = time_now;
+
                 break;
 
         case DHCP_STATE_SELECTING:
@@ -1090,6 +1110,8 @@ static int client_timeout_resend(
                 if (r < 0 && client->attempt >= 64)
                         goto error;
 
+                client->request_sent = time_now;
+
                 break;
 
         case DHCP_STATE_INIT_REBOOT:
@@ -1364,6 +1386,12 @@ static int client_handle_ack(sd_dhcp_client *client, DHCPMessage *ack, size_t le
                 return -ENOMSG;
         }
 
+        /* RFC 4039 section 4: an ACK in reply to a DISCOVER must carry the rapid commit option */
+        if (client->state == DHCP_STATE_SELECTING && !lease->rapid_commit) {
+                log_dhcp_client(client, "received ACK without rapid commit option in reply to DISCOVER, ignoring");
+                return -ENOMSG;
+        }
+
         lease->next_server = ack->siaddr;
 
         lease->address = ack->yiaddr;
@@ -1549,6 +1577,11 @@ static int client_handle_message(sd_dhcp_client *client, DHCPMessage *message, i
         switch (client->state) {
         case DHCP_STATE_SELECTING:
 
+                /* a server supporting rapid commit replies to the DISCOVER with an ACK right away */
+                if (client->rapid_commit &&
+                    dhcp_option_parse(message, len, NULL, NULL, NULL) == DHCP_ACK)
+                        goto ack;
+
                 r = client_handle_offer(client, message, len);
                 if (r >= 0) {
 
@@ -1572,7 +1605,7 @@ static int client_handle_message(sd_dhcp_client *client, DHCPMessage *message, i
         case DHCP_STATE_REQUESTING:
         case DHCP_STATE_RENEWING:
         case DHCP_STATE_REBINDING:
-
+        ack:
                 r = client_handle_ack(client, message, len);
                 if (r >= 0) {
                         client->start_delay = 0;
@@ -1581,7 +1614,8 @@ static int client_handle_message(sd_dhcp_client *client, DHCPMessage *message, i
                                 sd_event_source_unref(client->receive_message);
                         client->fd = asynchronous_close(client->fd);
 
-                        if (IN_SET(client->state, DHCP_STATE_REQUESTING,
+                        if (IN_SET(client->state, DHCP_STATE_SELECTING,
+                                   DHCP_STATE_REQUESTING,
                                    DHCP_STATE_REBOOTING))
                                 notify_event = SD_DHCP_CLIENT_EVENT_IP_ACQUIRE;
                         else if (r != SD_DHCP_CLIENT_EVENT_IP_ACQUIRE)
@@ -679,6 +679,13 @@ int dhcp_lease_parse_options(uint8_t code, uint8_t len, const void *option, void
                 lease->vendor_specific_len = len;
                 break;
 
+        case SD_DHCP_OPTION_RAPID_COMMIT:
+                if (len != 0)
+                        log_debug("Rapid commit option has invalid length %"PRIu8", ignoring.", len);
+                else
+                        lease->rapid_commit = true;
+                break;
+
         case SD_DHCP_OPTION_PRIVATE_BASE ... SD_DHCP_OPTION_PRIVATE_LAST:
                 r = dhcp_lease_insert_private_option(lease, code, option, len);
                 if (r < 0)
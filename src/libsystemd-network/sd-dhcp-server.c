@@ -3,19 +3,27 @@
   Copyright © 2013 Intel Corporation. All rights reserved.
 ***/
 
+#include <stdio_ext.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 
 #include "sd-dhcp-server.h"
 
 #include "alloc-util.h"
 #include "dhcp-internal.h"
 #include "dhcp-server-internal.h"
+#include "extract-word.h"
 #include "fd-util.h"
+#include "fileio.h"
+#include "hexdecoct.h"
 #include "in-addr-util.h"
 #include "io-util.h"
+#include "parse-util.h"
+#include "path-util.h"
 #include "sd-id128.h"
 #include "siphash24.h"
 #include "string-util.h"
+#include "tmpfile-util.h"
 #include "unaligned.h"
 
 #define DHCP_DEFAULT_LEASE_TIME_USEC USEC_PER_HOUR
@@ -29,6 +37,184 @@ static DHCPLease *dhcp_lease_free(DHCPLease *lease) {
         return mfree(lease);
 }
 
+DEFINE_TRIVIAL_CLEANUP_FUNC(DHCPLease*, dhcp_lease_free);
+
+static void dhcp_server_bind(sd_dhcp_server *server, uint32_t pool_offset, DHCPLease *lease) {
+        assert(server);
+        assert(pool_offset < server->pool_size);
+        assert(lease);
+
+        if (!server->bound_leases[pool_offset]) {
+                server->bound_bitmap[pool_offset / 64] |= UINT64_C(1) << (pool_offset % 64);
+                server->n_bound++;
+        }
+
+        server->bound_leases[pool_offset] = lease;
+}
+
+static void dhcp_server_unbind(sd_dhcp_server *server, uint32_t pool_offset) {
+        assert(server);
+        assert(pool_offset < server->pool_size);
+
+        if (server->bound_leases[pool_offset]) {
+                server->bound_bitmap[pool_offset / 64] &= ~(UINT64_C(1) << (pool_offset % 64));
+                server->n_bound--;
+        }
+
+        server->bound_leases[pool_offset] = NULL;
+}
+
+/* Finds the first free address of the pool at or after the given offset, wrapping around at the end of the
+ * pool. As bound addresses are tracked in a bitmap this looks at 64 addresses at a time, and does not need
+ * to look at all when the pool is exhausted. */
+static int dhcp_server_find_free(sd_dhcp_server *server, uint32_t start, uint32_t *ret) {
+        size_t n_words, w, i;
+        uint64_t free_bits;
+
+        assert(server);
+        assert(start < server->pool_size);
+        assert(ret);
+
+        if (server->n_bound >= server->pool_size)
+                return -ENOSPC;
+
+        n_words = DIV_ROUND_UP(server->pool_size, 64);
+        w = start / 64;
+
+        /* First the addresses from the start in its word, then the following words, and finally the whole
+         * first word again, to cover the addresses before the start */
+        free_bits = ~server->bound_bitmap[w] & (UINT64_MAX << (start % 64));
+        for (i = 0; i <= n_words; i++) {
+                if (free_bits != 0) {
+                        *ret = w * 64 + __builtin_ctzll(free_bits);
+                        return 0;
+                }
+
+                w = (w + 1) % n_words;
+                free_bits = ~server->bound_bitmap[w];
+        }
+
+        return -ENOSPC;
+}
+
+static int dhcp_server_save_leases(sd_dhcp_server *server) {
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        DHCPLease *lease;
+        Iterator i;
+        int r;
+
+        assert(server);
+        assert(server->lease_file);
+
+        r = fopen_temporary(server->lease_file, &f, &temp_path);
+        if (r < 0)
+                goto fail;
+
+        (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
+        (void) fchmod(fileno(f), 0644);
+
+        fputs("# This is private data. Do not parse.\n", f);
+
+        HASHMAP_FOREACH(lease, server->leases_by_client_id, i) {
+                _cleanup_free_ char *address = NULL, *gateway = NULL, *chaddr = NULL, *client_id = NULL;
+
+                r = in_addr_to_string(AF_INET, &(union in_addr_union) { .in.s_addr = lease->address }, &address);
+                if (r < 0)
+                        goto fail;
+
+                r = in_addr_to_string(AF_INET, &(union in_addr_union) { .in.s_addr = lease->gateway }, &gateway);
+                if (r < 0)
+                        goto fail;
+
+                chaddr = hexmem(lease->chaddr, ETH_ALEN);
+                client_id = hexmem(lease->client_id.data, lease->client_id.length);
+                if (!chaddr || !client_id) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                fprintf(f, "%s %s %s " USEC_FMT " %s\n", address, gateway, chaddr, lease->expiration, client_id);
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp_path, server->lease_file) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        if (temp_path)
+                (void) unlink(temp_path);
+
+        return r;
+}
+
+static int dhcp_server_dispatch_save_leases(sd_event_source *s, void *userdata) {
+        sd_dhcp_server *server = userdata;
+        int r;
+
+        assert(server);
+
+        r = dhcp_server_save_leases(server);
+        if (r < 0)
+                log_dhcp_server_errno(server, r, "Failed to save leases to %s, ignoring: %m", server->lease_file);
+
+        return 0;
+}
+
+/* Schedules writing out the leases. This happens at idle priority, so that a burst of clients results in a
+ * single write once the burst has been processed, rather than one for each of them. */
+static void dhcp_server_leases_changed(sd_dhcp_server *server) {
+        int r;
+
+        assert(server);
+
+        if (!server->lease_file || !server->event)
+                return;
+
+        if (server->save_leases) {
+                r = sd_event_source_set_enabled(server->save_leases, SD_EVENT_ONESHOT);
+                if (r < 0)
+                        log_dhcp_server_errno(server, r, "Failed to enable event source for saving leases, ignoring: %m");
+                return;
+        }
+
+        r = sd_event_add_defer(server->event, &server->save_leases, dhcp_server_dispatch_save_leases, server);
+        if (r < 0) {
+                log_dhcp_server_errno(server, r, "Failed to add event source for saving leases, ignoring: %m");
+                return;
+        }
+
+        r = sd_event_source_set_priority(server->save_leases, SD_EVENT_PRIORITY_IDLE);
+        if (r < 0)
+                log_dhcp_server_errno(server, r, "Failed to set priority of event source for saving leases, ignoring: %m");
+
+        (void) sd_event_source_set_enabled(server->save_leases, SD_EVENT_ONESHOT);
+        (void) sd_event_source_set_description(server->save_leases, "dhcp-server-save-leases");
+}
+
+/* Writes out the leases right away if that is still pending, and releases the event source */
+static void dhcp_server_flush_leases(sd_dhcp_server *server) {
+        int enabled = SD_EVENT_OFF;
+
+        assert(server);
+
+        if (!server->save_leases)
+                return;
+
+        (void) sd_event_source_get_enabled(server->save_leases, &enabled);
+        if (enabled != SD_EVENT_OFF)
+                (void) dhcp_server_dispatch_save_leases(server->save_leases, server);
+
+        server->save_leases = sd_event_source_unref(server->save_leases);
+}
+
 /* configures the server's address and subnet, and optionally the pool's size and offset into the subnet
  * the whole pool must fit into the subnet, and may not contain the first (any) nor last (broadcast) address
  * moreover, the server's own address may be in the pool, and is in that case reserved in order not to
@@ -73,12 +259,26 @@ int sd_dhcp_server_configure_pool(sd_dhcp_server *server, struct in_addr *addres
                 size = size_max;
 
         if (server->address != address->s_addr || server->netmask != netmask || server->pool_size != size || server->pool_offset != offset) {
+                _cleanup_free_ DHCPLease **bound_leases = NULL;
+                _cleanup_free_ uint64_t *bound_bitmap = NULL;
+                size_t n_words;
+                uint32_t i;
+
+                n_words = DIV_ROUND_UP(size, 64);
 
-                free(server->bound_leases);
-                server->bound_leases = new0(DHCPLease*, size);
-                if (!server->bound_leases)
+                bound_leases = new0(DHCPLease*, size);
+                bound_bitmap = new0(uint64_t, n_words);
+                if (!bound_leases || !bound_bitmap)
                         return -ENOMEM;
 
+                /* Never hand out the addresses past the end of the pool in the last word */
+                for (i = size; i < n_words * 64; i++)
+                        bound_bitmap[i / 64] |= UINT64_C(1) << (i % 64);
+
+                free_and_replace(server->bound_leases, bound_leases);
+                free_and_replace(server->bound_bitmap, bound_bitmap);
+                server->n_bound = 0;
+
                 server->pool_offset = offset;
                 server->pool_size = size;
 
@@ -87,10 +287,13 @@ int sd_dhcp_server_configure_pool(sd_dhcp_server *server, struct in_addr *addres
                 server->subnet = address->s_addr & netmask;
 
                 if (server_off >= offset && server_off - offset < size)
-                        server->bound_leases[server_off - offset] = &server->invalid_lease;
+                        dhcp_server_bind(server, server_off - offset, &server->invalid_lease);
 
                 /* Drop any leases associated with the old address range */
-                hashmap_clear(server->leases_by_client_id);
+                if (!hashmap_isempty(server->leases_by_client_id)) {
+                        hashmap_clear(server->leases_by_client_id);
+                        dhcp_server_leases_changed(server);
+                }
         }
 
         return 0;
@@ -143,6 +346,12 @@ static sd_dhcp_server *dhcp_server_free(sd_dhcp_server *server) {
         hashmap_free(server->leases_by_client_id);
 
         free(server->bound_leases);
+        free(server->bound_bitmap);
+
+        free(server->receive_batch);
+        free(server->receive_slots);
+
+        free(server->lease_file);
         return mfree(server);
 }
 
@@ -199,6 +408,7 @@ int sd_dhcp_server_attach_event(sd_dhcp_server *server, sd_event *event, int64_t
 int sd_dhcp_server_detach_event(sd_dhcp_server *server) {
         assert_return(server, -EINVAL);
 
+        dhcp_server_flush_leases(server);
         server->event = sd_event_unref(server->event);
 
         return 0;
@@ -216,6 +426,8 @@ int sd_dhcp_server_stop(sd_dhcp_server *server) {
         server->receive_message =
                 sd_event_source_unref(server->receive_message);
 
+        dhcp_server_flush_leases(server);
+
         server->fd_raw = safe_close(server->fd_raw);
         server->fd = safe_close(server->fd);
 
@@ -665,6 +877,122 @@ static int get_pool_offset(sd_dhcp_server *server, be32_t requested_ip) {
         return be32toh(requested_ip & ~server->netmask) - server->pool_offset;
 }
 
+static int dhcp_server_parse_lease(sd_dhcp_server *server, const char *line, usec_t time_now) {
+        _cleanup_free_ char *address = NULL, *gateway = NULL, *chaddr = NULL, *expiration = NULL, *client_id = NULL;
+        _cleanup_(dhcp_lease_freep) DHCPLease *lease = NULL;
+        _cleanup_free_ void *chaddr_data = NULL;
+        union in_addr_union a, g;
+        size_t chaddr_len;
+        int pool_offset, r;
+
+        assert(server);
+        assert(line);
+
+        r = extract_many_words(&line, NULL, 0, &address, &gateway, &chaddr, &expiration, &client_id, NULL);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return 0;
+        if (r < 5)
+                return -EBADMSG;
+
+        lease = new0(DHCPLease, 1);
+        if (!lease)
+                return -ENOMEM;
+
+        r = in_addr_from_string(AF_INET, address, &a);
+        if (r < 0)
+                return r;
+
+        r = in_addr_from_string(AF_INET, gateway, &g);
+        if (r < 0)
+                return r;
+
+        r = safe_atou64(expiration, &lease->expiration);
+        if (r < 0)
+                return r;
+
+        r = unhexmem(chaddr, (size_t) -1, &chaddr_data, &chaddr_len);
+        if (r < 0)
+                return r;
+        if (chaddr_len != ETH_ALEN)
+                return -EBADMSG;
+
+        r = unhexmem(client_id, (size_t) -1, &lease->client_id.data, &lease->client_id.length);
+        if (r < 0)
+                return r;
+        if (lease->client_id.length == 0)
+                return -EBADMSG;
+
+        lease->address = a.in.s_addr;
+        lease->gateway = g.in.s_addr;
+        memcpy(lease->chaddr, chaddr_data, ETH_ALEN);
+
+        if (lease->expiration <= time_now)
+                return 0;
+
+        /* The pool might have been reconfigured in the meantime, or the client got another address since */
+        pool_offset = get_pool_offset(server, lease->address);
+        if (pool_offset < 0)
+                return 0;
+        if (server->bound_leases[pool_offset] ||
+            hashmap_contains(server->leases_by_client_id, &lease->client_id))
+                return 0;
+
+        r = hashmap_put(server->leases_by_client_id, &lease->client_id, lease);
+        if (r < 0)
+                return r;
+
+        dhcp_server_bind(server, pool_offset, TAKE_PTR(lease));
+        return 1;
+}
+
+/* Picks up the leases handed out before networkd was restarted, so that their addresses are not offered to
+ * other clients while they are still in use */
+static int dhcp_server_load_leases(sd_dhcp_server *server) {
+        _cleanup_fclose_ FILE *f = NULL;
+        unsigned n_leases = 0;
+        usec_t time_now;
+        int r;
+
+        assert(server);
+
+        if (!server->lease_file || !server->pool_size)
+                return 0;
+
+        f = fopen(server->lease_file, "re");
+        if (!f)
+                return errno == ENOENT ? 0 : -errno;
+
+        (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
+
+        r = sd_event_now(server->event, clock_boottime_or_monotonic(), &time_now);
+        if (r < 0)
+                return r;
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (IN_SET(line[0], '\0', '#'))
+                        continue;
+
+                r = dhcp_server_parse_lease(server, line, time_now);
+                if (r < 0)
+                        log_dhcp_server_errno(server, r, "Failed to parse lease \"%s\", ignoring: %m", line);
+                else if (r > 0)
+                        n_leases++;
+        }
+
+        log_dhcp_server(server, "Loaded %u leases from %s", n_leases, server->lease_file);
+        return 0;
+}
+
 #define HASH_KEY SD_ID128_MAKE(0d,1d,fe,bd,f1,24,bd,b3,47,f1,dd,6e,73,21,93,30)
 
 int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
@@ -702,7 +1030,6 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
 
         case DHCP_DISCOVER: {
                 be32_t address = INADDR_ANY;
-                unsigned i;
 
                 log_dhcp_server(server, "DISCOVER (0x%x)",
                                 be32toh(req->message->xid));
@@ -719,7 +1046,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                         uint64_t hash;
                         uint32_t next_offer;
 
-                        /* even with no persistence of leases, we try to offer the same client
+                        /* even when the client has no lease with us (anymore), we try to offer it
                            the same IP address. we do this by using the hash of the client id
                            as the offset into the pool of leases when finding the next free one */
 
@@ -728,14 +1055,8 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                         hash = htole64(siphash24_finalize(&state));
                         next_offer = hash % server->pool_size;
 
-                        for (i = 0; i < server->pool_size; i++) {
-                                if (!server->bound_leases[next_offer]) {
-                                        address = server->subnet | htobe32(server->pool_offset + next_offer);
-                                        break;
-                                }
-
-                                next_offer = (next_offer + 1) % server->pool_size;
-                        }
+                        if (dhcp_server_find_free(server, next_offer, &next_offer) >= 0)
+                                address = server->subnet | htobe32(server->pool_offset + next_offer);
                 }
 
                 if (address == INADDR_ANY)
@@ -858,9 +1179,10 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                                 log_dhcp_server(server, "ACK (0x%x)",
                                                 be32toh(req->message->xid));
 
-                                server->bound_leases[pool_offset] = lease;
+                                dhcp_server_bind(server, pool_offset, lease);
                                 hashmap_put(server->leases_by_client_id,
                                             &lease->client_id, lease);
+                                dhcp_server_leases_changed(server);
 
                                 return DHCP_ACK;
                         }
@@ -895,9 +1217,10 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                         return 0;
 
                 if (server->bound_leases[pool_offset] == existing_lease) {
-                        server->bound_leases[pool_offset] = NULL;
+                        dhcp_server_unbind(server, pool_offset);
                         hashmap_remove(server->leases_by_client_id, existing_lease);
                         dhcp_lease_free(existing_lease);
+                        dhcp_server_leases_changed(server);
                 }
 
                 return 0;
@@ -906,62 +1229,77 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
         return 0;
 }
 
-static int server_receive_message(sd_event_source *s, int fd,
-                                  uint32_t revents, void *userdata) {
-        _cleanup_free_ DHCPMessage *message = NULL;
-        uint8_t cmsgbuf[CMSG_LEN(sizeof(struct in_pktinfo))];
-        sd_dhcp_server *server = userdata;
-        struct iovec iov = {};
-        struct msghdr msg = {
-                .msg_iov = &iov,
-                .msg_iovlen = 1,
-                .msg_control = cmsgbuf,
-                .msg_controllen = sizeof(cmsgbuf),
-        };
+static bool server_message_for_us(sd_dhcp_server *server, struct msghdr *msg) {
         struct cmsghdr *cmsg;
-        ssize_t buflen, len;
-        int r;
 
-        assert(server);
+        CMSG_FOREACH(cmsg, msg) {
+                if (cmsg->cmsg_level == IPPROTO_IP &&
+                    cmsg->cmsg_type == IP_PKTINFO &&
+                    cmsg->cmsg_len == CMSG_LEN(sizeof(struct in_pktinfo))) {
+                        struct in_pktinfo *info = (struct in_pktinfo*)CMSG_DATA(cmsg);
+
+                        /* TODO figure out if this can be done as a filter on
+                         * the socket, like for IPv6 */
+                        return server->ifindex == info->ipi_ifindex;
+                }
+        }
 
-        buflen = next_datagram_size_fd(fd);
-        if (buflen < 0)
-                return buflen;
+        return true;
+}
 
-        message = malloc(buflen);
-        if (!message)
-                return -ENOMEM;
+static int server_receive_message(sd_event_source *s, int fd,
+                                  uint32_t revents, void *userdata) {
+        sd_dhcp_server *server = userdata;
+        size_t i;
+        int k, r;
 
-        iov = IOVEC_MAKE(message, buflen);
+        assert(server);
+        assert(server->receive_batch);
+        assert(server->receive_slots);
+
+        /* When a lot of clients boot at once, read as many of their messages as we can with a single call */
+        for (i = 0; i < DHCP_SERVER_RECEIVE_BATCH_MAX; i++) {
+                DHCPReceiveSlot *slot = server->receive_slots + i;
+
+                slot->iovec = IOVEC_MAKE(&slot->buffer, sizeof(slot->buffer));
+
+                server->receive_batch[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = &slot->iovec,
+                                .msg_iovlen = 1,
+                                .msg_control = &slot->control,
+                                .msg_controllen = sizeof(slot->control),
+                        },
+                };
+        }
 
-        len = recvmsg(fd, &msg, 0);
-        if (len < 0) {
+        k = recvmmsg(fd, server->receive_batch, DHCP_SERVER_RECEIVE_BATCH_MAX, MSG_DONTWAIT, NULL);
+        if (k < 0) {
                 if (IN_SET(errno, EAGAIN, EINTR))
                         return 0;
 
                 return -errno;
         }
-        if ((size_t)len < sizeof(DHCPMessage))
-                return 0;
 
-        CMSG_FOREACH(cmsg, &msg) {
-                if (cmsg->cmsg_level == IPPROTO_IP &&
-                    cmsg->cmsg_type == IP_PKTINFO &&
-                    cmsg->cmsg_len == CMSG_LEN(sizeof(struct in_pktinfo))) {
-                        struct in_pktinfo *info = (struct in_pktinfo*)CMSG_DATA(cmsg);
+        for (i = 0; i < (size_t) k; i++) {
+                struct msghdr *msg = &server->receive_batch[i].msg_hdr;
+                size_t len = server->receive_batch[i].msg_len;
 
-                        /* TODO figure out if this can be done as a filter on
-                         * the socket, like for IPv6 */
-                        if (server->ifindex != info->ipi_ifindex)
-                                return 0;
-
-                        break;
+                if (msg->msg_flags & MSG_TRUNC) {
+                        log_dhcp_server(server, "Ignoring oversized message");
+                        continue;
                 }
-        }
 
-        r = dhcp_server_handle_message(server, message, (size_t) len);
-        if (r < 0)
-                log_dhcp_server_errno(server, r, "Couldn't process incoming message: %m");
+                if (len < sizeof(DHCPMessage))
+                        continue;
+
+                if (!server_message_for_us(server, msg))
+                        continue;
+
+                r = dhcp_server_handle_message(server, &server->receive_slots[i].buffer.message, len);
+                if (r < 0)
+                        log_dhcp_server_errno(server, r, "Couldn't process incoming message: %m");
+        }
 
         return 0;
 }
@@ -976,6 +1314,22 @@ int sd_dhcp_server_start(sd_dhcp_server *server) {
         assert_return(server->fd < 0, -EBUSY);
         assert_return(server->address != htobe32(INADDR_ANY), -EUNATCH);
 
+        if (!server->receive_batch) {
+                server->receive_batch = new0(struct mmsghdr, DHCP_SERVER_RECEIVE_BATCH_MAX);
+                if (!server->receive_batch)
+                        return -ENOMEM;
+        }
+
+        if (!server->receive_slots) {
+                server->receive_slots = new0(DHCPReceiveSlot, DHCP_SERVER_RECEIVE_BATCH_MAX);
+                if (!server->receive_slots)
+                        return -ENOMEM;
+        }
+
+        r = dhcp_server_load_leases(server);
+        if (r < 0)
+                log_dhcp_server_errno(server, r, "Failed to load leases from %s, ignoring: %m", server->lease_file);
+
         r = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
         if (r < 0) {
                 r = -errno;
@@ -1052,6 +1406,16 @@ int sd_dhcp_server_set_timezone(sd_dhcp_server *server, const char *tz) {
         return 1;
 }
 
+int sd_dhcp_server_set_lease_file(sd_dhcp_server *server, const char *path) {
+        assert_return(server, -EINVAL);
+        assert_return(!path || path_is_absolute(path), -EINVAL);
+
+        if (streq_ptr(server->lease_file, path))
+                return 0;
+
+        return free_and_strdup(&server->lease_file, path);
+}
+
 int sd_dhcp_server_set_max_lease_time(sd_dhcp_server *server, uint32_t t) {
         assert_return(server, -EINVAL);
 
@@ -150,8 +150,15 @@ static int lldp_add_neighbor(sd_lldp *lldp, sd_lldp_neighbor *n) {
         if (r < 0)
                 goto finish;
 
+        r = set_put(lldp->neighbor_by_raw, n);
+        if (r < 0) {
+                assert_se(hashmap_remove(lldp->neighbor_by_id, &n->id) == n);
+                goto finish;
+        }
+
         r = prioq_put(lldp->neighbor_by_expiry, n, &n->prioq_idx);
         if (r < 0) {
+                assert_se(set_remove(lldp->neighbor_by_raw, n) == n);
                 assert_se(hashmap_remove(lldp->neighbor_by_id, &n->id) == n);
                 goto finish;
         }
@@ -171,11 +178,24 @@ finish:
 }
 
 static int lldp_handle_datagram(sd_lldp *lldp, sd_lldp_neighbor *n) {
+        sd_lldp_neighbor *old;
         int r;
 
         assert(lldp);
         assert(n);
 
+        /* Most datagrams merely repeat what a neighbor already told us. Recognize those by their raw bytes,
+         * without parsing them again, and only restart the TTL counter of the existing entry. As the raw data
+         * includes the TTL and the source address, this is exactly what lldp_add_neighbor() would do after
+         * parsing. */
+        old = set_get(lldp->neighbor_by_raw, n);
+        if (old) {
+                old->timestamp = n->timestamp;
+                lldp_start_timer(lldp, old);
+                lldp_callback(lldp, SD_LLDP_EVENT_REFRESHED, old);
+                return 0;
+        }
+
         r = lldp_neighbor_parse(n);
         if (r == -EBADMSG) /* Ignore bad messages */
                 return 0;
@@ -350,6 +370,7 @@ static sd_lldp* lldp_free(sd_lldp *lldp) {
         lldp_flush_neighbors(lldp);
 
         hashmap_free(lldp->neighbor_by_id);
+        set_free(lldp->neighbor_by_raw);
         prioq_free(lldp->neighbor_by_expiry);
         return mfree(lldp);
 }
@@ -377,6 +398,10 @@ _public_ int sd_lldp_new(sd_lldp **ret) {
         if (!lldp->neighbor_by_id)
                 return -ENOMEM;
 
+        lldp->neighbor_by_raw = set_new(&lldp_neighbor_raw_hash_ops);
+        if (!lldp->neighbor_by_raw)
+                return -ENOMEM;
+
         r = prioq_ensure_allocated(&lldp->neighbor_by_expiry, lldp_neighbor_prioq_compare_func);
         if (r < 0)
                 return r;
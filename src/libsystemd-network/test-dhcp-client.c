@@ -553,6 +553,92 @@ static void test_addr_acq(sd_event *e) {
         xid = 0;
 }
 
+static int test_rapid_commit_check_options(uint8_t code, uint8_t len, const void *option, void *userdata) {
+        if (code == SD_DHCP_OPTION_RAPID_COMMIT) {
+                assert_se(len == 0);
+                *(bool*) userdata = true;
+        }
+
+        return check_options(code, len, option, NULL);
+}
+
+static int test_rapid_commit_recv_discover(size_t size, DHCPMessage *discover) {
+        uint8_t ack[sizeof(test_addr_acq_ack)];
+        uint16_t udp_check = 0;
+        bool rapid_commit = false;
+        int res;
+
+        res = dhcp_option_parse(discover, size, test_rapid_commit_check_options, &rapid_commit, NULL);
+        assert_se(res == DHCP_DISCOVER);
+        assert_se(rapid_commit);
+
+        xid = discover->xid;
+
+        if (verbose)
+                printf("  recv DHCP Discover 0x%08x\n", be32toh(xid));
+
+        /* reply with the ACK right away, with the rapid commit option in place of the END option */
+        memcpy(ack, test_addr_acq_ack, sizeof(ack));
+        memcpy(&ack[26], &udp_check, sizeof(udp_check));
+        memcpy(&ack[32], &xid, sizeof(xid));
+        memcpy(&ack[56], &mac_addr, ETHER_ADDR_LEN);
+        ack[312] = SD_DHCP_OPTION_RAPID_COMMIT;
+        ack[313] = 0;
+        ack[314] = SD_DHCP_OPTION_END;
+
+        /* the client must not send a REQUEST anymore */
+        callback_recv = NULL;
+
+        res = write(test_fd[1], ack, sizeof(ack));
+        assert_se(res == sizeof(ack));
+
+        if (verbose)
+                printf("  send DHCP Ack\n");
+
+        return 0;
+}
+
+static void test_rapid_commit(sd_event *e) {
+        usec_t time_now = now(clock_boottime_or_monotonic());
+        sd_dhcp_client *client;
+        int res;
+
+        if (verbose)
+                printf("* %s\n", __FUNCTION__);
+
+        assert_se(sd_dhcp_client_new(&client, false) >= 0);
+        assert_se(sd_dhcp_client_attach_event(client, e, 0) >= 0);
+
+        assert_se(sd_dhcp_client_set_ifindex(client, 42) >= 0);
+        assert_se(sd_dhcp_client_set_mac(client, mac_addr, ETH_ALEN, ARPHRD_ETHER) >= 0);
+        assert_se(sd_dhcp_client_set_rapid_commit(client, true) >= 0);
+
+        assert_se(sd_dhcp_client_set_callback(client, test_addr_acq_acquired, e) >= 0);
+
+        callback_recv = test_rapid_commit_recv_discover;
+
+        assert_se(sd_event_add_time(e, &test_hangcheck,
+                                    clock_boottime_or_monotonic(),
+                                    time_now + 2 * USEC_PER_SEC, 0,
+                                    test_dhcp_hangcheck, NULL) >= 0);
+
+        res = sd_dhcp_client_start(client);
+        assert_se(IN_SET(res, 0, -EINPROGRESS));
+
+        assert_se(sd_event_loop(e) >= 0);
+
+        test_hangcheck = sd_event_source_unref(test_hangcheck);
+
+        assert_se(sd_dhcp_client_set_callback(client, NULL, NULL) >= 0);
+        assert_se(sd_dhcp_client_stop(client) >= 0);
+        sd_dhcp_client_unref(client);
+
+        test_fd[1] = safe_close(test_fd[1]);
+
+        callback_recv = NULL;
+        xid = 0;
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(sd_event_unrefp) sd_event *e;
 
@@ -567,6 +653,7 @@ int main(int argc, char *argv[]) {
 
         test_discover_message(e);
         test_addr_acq(e);
+        test_rapid_commit(e);
 
 #if VALGRIND
         /* Make sure the async_close thread has finished.
@@ -4,12 +4,16 @@
 ***/
 
 #include <errno.h>
+#include <unistd.h>
 
 #include "sd-dhcp-server.h"
 #include "sd-event.h"
 
 #include "dhcp-server-internal.h"
+#include "rm-rf.h"
+#include "string-util.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 
 static void test_pool(struct in_addr *address, unsigned size, int ret) {
         _cleanup_(sd_dhcp_server_unrefp) sd_dhcp_server *server = NULL;
@@ -180,6 +184,87 @@ static void test_message_handler(void) {
         assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == 0);
 }
 
+static void test_lease_file(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_(sd_dhcp_server_unrefp) sd_dhcp_server *server = NULL;
+        struct {
+                DHCPMessage message;
+                struct {
+                        uint8_t code;
+                        uint8_t length;
+                        uint8_t type;
+                } _packed_ option_type;
+                struct {
+                        uint8_t code;
+                        uint8_t length;
+                        be32_t address;
+                } _packed_ option_requested_ip;
+                struct {
+                        uint8_t code;
+                        uint8_t length;
+                        be32_t address;
+                } _packed_ option_server_id;
+                uint8_t end;
+        } _packed_ test = {
+                .message.op = BOOTREQUEST,
+                .message.htype = ARPHRD_ETHER,
+                .message.hlen = ETHER_ADDR_LEN,
+                .message.xid = htobe32(0x12345678),
+                .message.chaddr = { 'A', 'B', 'C', 'D', 'E', 'F' },
+                .option_type.code = SD_DHCP_OPTION_MESSAGE_TYPE,
+                .option_type.length = 1,
+                .option_type.type = DHCP_REQUEST,
+                .option_requested_ip.code = SD_DHCP_OPTION_REQUESTED_IP_ADDRESS,
+                .option_requested_ip.length = 4,
+                .option_requested_ip.address = htobe32(INADDR_LOOPBACK + 3),
+                .option_server_id.code = SD_DHCP_OPTION_SERVER_IDENTIFIER,
+                .option_server_id.length = 4,
+                .option_server_id.address = htobe32(INADDR_LOOPBACK),
+                .end = SD_DHCP_OPTION_END,
+        };
+        struct in_addr address_lo = {
+                .s_addr = htonl(INADDR_LOOPBACK),
+        };
+        DHCPLease *lease;
+        const char *path;
+
+        assert_se(mkdtemp_malloc(NULL, &t) >= 0);
+        path = strjoina(t, "/leases");
+
+        assert_se(sd_dhcp_server_new(&server, 1) >= 0);
+        assert_se(sd_dhcp_server_configure_pool(server, &address_lo, 8, 0, 0) >= 0);
+        assert_se(sd_dhcp_server_attach_event(server, NULL, 0) >= 0);
+        assert_se(sd_dhcp_server_set_lease_file(server, path) >= 0);
+        assert_se(sd_dhcp_server_start(server) >= 0);
+
+        assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == DHCP_ACK);
+        assert_se(hashmap_size(server->leases_by_client_id) == 1);
+
+        /* stopping the server writes out the leases that were not saved yet */
+        assert_se(sd_dhcp_server_stop(server) >= 0);
+        assert_se(access(path, F_OK) >= 0);
+        server = sd_dhcp_server_unref(server);
+
+        assert_se(sd_dhcp_server_new(&server, 1) >= 0);
+        assert_se(sd_dhcp_server_configure_pool(server, &address_lo, 8, 0, 0) >= 0);
+        assert_se(sd_dhcp_server_attach_event(server, NULL, 0) >= 0);
+        assert_se(sd_dhcp_server_set_lease_file(server, path) >= 0);
+        assert_se(sd_dhcp_server_start(server) >= 0);
+
+        assert_se(hashmap_size(server->leases_by_client_id) == 1);
+        lease = hashmap_first(server->leases_by_client_id);
+        assert_se(lease->address == htobe32(INADDR_LOOPBACK + 3));
+        assert_se(memcmp(lease->chaddr, test.message.chaddr, ETH_ALEN) == 0);
+
+        /* the address of the server and the one of the lease are not available to other clients */
+        assert_se(server->n_bound == 2);
+        assert_se(server->bound_leases[2] == lease);
+
+        /* the client may renew it */
+        assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == DHCP_ACK);
+        assert_se(server->n_bound == 2);
+}
+
 static uint64_t client_id_hash_helper(DHCPClientId *id, uint8_t key[HASH_KEY_SIZE]) {
         struct siphash state;
 
@@ -238,6 +323,7 @@ int main(int argc, char *argv[]) {
                 return log_tests_skipped("cannot start dhcp server");
 
         test_message_handler();
+        test_lease_file();
         test_client_id_hash();
 
         return 0;
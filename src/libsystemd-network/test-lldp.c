@@ -22,6 +22,7 @@
 
 static int test_fd[2] = { -1, -1 };
 static int lldp_handler_calls;
+static sd_lldp_event lldp_handler_last_event;
 
 int lldp_network_bind_raw_socket(int ifindex) {
         if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, test_fd) < 0)
@@ -32,6 +33,7 @@ int lldp_network_bind_raw_socket(int ifindex) {
 
 static void lldp_handler(sd_lldp *lldp, sd_lldp_event event, sd_lldp_neighbor *n, void *userdata) {
         lldp_handler_calls++;
+        lldp_handler_last_event = event;
 }
 
 static int start_lldp(sd_lldp **lldp, sd_event *e, sd_lldp_callback_t cb, void *cb_data) {
@@ -167,6 +169,62 @@ static void test_receive_incomplete_packet(sd_event *e) {
         assert_se(stop_lldp(lldp) == 0);
 }
 
+static void test_receive_repeated_packet(sd_event *e) {
+        sd_lldp *lldp;
+        sd_lldp_neighbor **neighbors;
+        const char *str;
+        uint8_t frame[] = {
+                /* Ethernet header */
+                0x01, 0x80, 0xc2, 0x00, 0x00, 0x03,     /* Destination MAC */
+                0x01, 0x02, 0x03, 0x04, 0x05, 0x06,     /* Source MAC */
+                0x88, 0xcc,                             /* Ethertype */
+                /* LLDP mandatory TLVs */
+                0x02, 0x07, 0x04, 0x00, 0x01, 0x02,     /* Chassis: MAC, 00:01:02:03:04:05 */
+                0x03, 0x04, 0x05,
+                0x04, 0x04, 0x05, 0x31, 0x2f, 0x33,     /* Port: interface name, "1/3" */
+                0x06, 0x02, 0x00, 0x78,                 /* TTL: 120 seconds */
+                /* LLDP optional TLVs */
+                0x0a, 0x03, 0x53, 0x59, 0x53,           /* System Name: "SYS" */
+                0x00, 0x00                              /* End Of LLDPDU */
+        };
+
+        lldp_handler_calls = 0;
+        assert_se(start_lldp(&lldp, e, lldp_handler, NULL) == 0);
+
+        assert_se(write(test_fd[1], frame, sizeof(frame)) == sizeof(frame));
+        sd_event_run(e, 0);
+        assert_se(lldp_handler_calls == 1);
+        assert_se(lldp_handler_last_event == SD_LLDP_EVENT_ADDED);
+
+        /* the same datagram again only refreshes the neighbor */
+        assert_se(write(test_fd[1], frame, sizeof(frame)) == sizeof(frame));
+        sd_event_run(e, 0);
+        assert_se(lldp_handler_calls == 2);
+        assert_se(lldp_handler_last_event == SD_LLDP_EVENT_REFRESHED);
+
+        /* a changed system name updates it */
+        frame[37] = 'Z';
+        assert_se(write(test_fd[1], frame, sizeof(frame)) == sizeof(frame));
+        sd_event_run(e, 0);
+        assert_se(lldp_handler_calls == 3);
+        assert_se(lldp_handler_last_event == SD_LLDP_EVENT_UPDATED);
+
+        assert_se(sd_lldp_get_neighbors(lldp, &neighbors) == 1);
+        assert_se(sd_lldp_neighbor_get_system_name(neighbors[0], &str) == 0);
+        assert_se(streq(str, "SYZ"));
+        sd_lldp_neighbor_unref(neighbors[0]);
+        free(neighbors);
+
+        /* and the old datagram is not taken for a mere refresh anymore */
+        frame[37] = 'S';
+        assert_se(write(test_fd[1], frame, sizeof(frame)) == sizeof(frame));
+        sd_event_run(e, 0);
+        assert_se(lldp_handler_calls == 4);
+        assert_se(lldp_handler_last_event == SD_LLDP_EVENT_UPDATED);
+
+        assert_se(stop_lldp(lldp) == 0);
+}
+
 static void test_receive_oui_packet(sd_event *e) {
         sd_lldp *lldp;
         sd_lldp_neighbor **neighbors;
@@ -371,6 +429,7 @@ int main(int argc, char *argv[]) {
         assert_se(sd_event_new(&e) == 0);
         test_receive_basic_packet(e);
         test_receive_incomplete_packet(e);
+        test_receive_repeated_packet(e);
         test_receive_oui_packet(e);
         test_multiple_neighbors_sorted(e);
 
@@ -591,3 +591,26 @@ int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
 
         return fflush_and_check(f);
 }
+
+void bus_pcap_frame_raw(const void *frame, size_t size, size_t snaplen, usec_t timestamp, FILE *f) {
+        pcaprec_hdr_t hdr = {};
+        struct timeval tv;
+
+        assert(frame);
+        assert(f);
+        assert(snaplen > 0);
+        assert((size_t) (uint32_t) snaplen == snaplen);
+
+        /* Like bus_message_pcap_frame(), but for a message as it came in from the wire, and without flushing
+         * the output for each frame */
+
+        timeval_store(&tv, timestamp);
+
+        hdr.ts_sec = tv.tv_sec;
+        hdr.ts_usec = tv.tv_usec;
+        hdr.orig_len = size;
+        hdr.incl_len = MIN(size, snaplen);
+
+        fwrite_unlocked(&hdr, 1, sizeof(hdr), f);
+        fwrite_unlocked(frame, 1, hdr.incl_len, f);
+}
@@ -6,6 +6,8 @@
 
 #include "sd-bus.h"
 
+#include "time-util.h"
+
 enum {
         BUS_MESSAGE_DUMP_WITH_HEADER  = 1 << 0,
         BUS_MESSAGE_DUMP_SUBTREE_ONLY = 1 << 1,
@@ -17,3 +19,4 @@ int bus_creds_dump(sd_bus_creds *c, FILE *f, bool terse);
 
 int bus_pcap_header(size_t snaplen, FILE *f);
 int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f);
+void bus_pcap_frame_raw(const void *frame, size_t size, size_t snaplen, usec_t timestamp, FILE *f);
@@ -170,6 +170,11 @@ enum bus_auth {
         BUS_AUTH_ANONYMOUS
 };
 
+/* How many released messages to keep around per bus for reuse, and how large their buffers may be to be kept
+ * with them */
+#define BUS_MESSAGE_POOL_MAX 16U
+#define BUS_MESSAGE_POOL_BUFFER_MAX (64U*1024U)
+
 struct sd_bus {
         /* We use atomic ref counting here since sd_bus_message
            objects retain references to their originating sd_bus but
@@ -209,15 +214,28 @@ struct sd_bus {
         bool watch_bind:1;
         bool is_monitor:1;
         bool accept_fd:1;
+        bool accept_memfd:1;
+        bool can_memfd:1;
+        bool accept_gvariant:1;
+        bool can_gvariant:1;
         bool attach_timestamp:1;
         bool connected_signal:1;
         bool close_on_exit:1;
+        bool track_match_installed:1;
 
         int use_memfd;
 
         void *rbuffer;
         size_t rbuffer_size;
 
+        /* Once running, rbuffer is a read-ahead buffer: the unprocessed data of rbuffer_size bytes starts at
+         * rbuffer_begin. If we hold fds, they were received with the read that ended at rbuffer_fds_end,
+         * relative to rbuffer_begin. */
+        size_t rbuffer_begin;
+        size_t rbuffer_allocated;
+        size_t rbuffer_ahead;
+        size_t rbuffer_fds_end;
+
         sd_bus_message **rqueue;
         unsigned rqueue_size;
         size_t rqueue_allocated;
@@ -227,6 +245,10 @@ struct sd_bus {
         size_t windex;
         size_t wqueue_allocated;
 
+        /* The memfd carrying the body of the message currently being written, if it is sent that way */
+        sd_bus_message *wpayload_message;
+        int wpayload_fd;
+
         uint64_t cookie;
 
         char *unique_name;
@@ -256,7 +278,7 @@ struct sd_bus {
 
         enum bus_auth auth;
         size_t auth_rbegin;
-        struct iovec auth_iovec[3];
+        struct iovec auth_iovec[2];
         unsigned auth_index;
         char *auth_buffer;
         usec_t auth_timeout;
@@ -286,6 +308,12 @@ struct sd_bus {
         struct memfd_cache memfd_cache[MEMFD_CACHE_MAX];
         unsigned n_memfd_cache;
 
+        /* Messages we allocated are put back here when released, for the same reason protected by a
+         * mutex */
+        pthread_mutex_t message_pool_mutex;
+        sd_bus_message *message_pool[BUS_MESSAGE_POOL_MAX];
+        unsigned n_message_pool;
+
         pid_t original_pid;
         pid_t busexec_pid;
 
@@ -312,6 +340,7 @@ struct sd_bus {
 
         LIST_HEAD(sd_bus_slot, slots);
         LIST_HEAD(sd_bus_track, tracks);
+        Hashmap *track_names; /* name → struct track_item chain, of all tracks of this bus */
 
         int *inotify_watches;
         size_t n_inotify_watches;
@@ -340,6 +369,14 @@ struct sd_bus {
 
 #define BUS_FDS_MAX 1024
 
+/* Bodies smaller than this are copied through the socket, even if the peer agreed to get them in a memfd, as
+ * setting it up and mapping it costs more than that */
+#define BUS_MEMFD_PAYLOAD_MIN (256U*1024U)
+
+/* Bounds for the adaptive amount of data we try to read from the socket in one go */
+#define BUS_READ_AHEAD_MIN (4U*1024U)
+#define BUS_READ_AHEAD_MAX (128U*1024U)
+
 #define BUS_EXEC_ARGV_MAX 256
 
 bool interface_name_is_valid(const char *p) _pure_;
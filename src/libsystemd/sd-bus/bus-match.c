@@ -59,6 +59,18 @@ static bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
                 (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST);
 }
 
+static bool BUS_MATCH_CAN_HASH_PREFIX(enum bus_match_node_type t) {
+        /* Prefix matches, which we index by the pattern string too, and look up by each prefix of the tested
+         * value that ends at a label boundary */
+        return t == BUS_MATCH_PATH_NAMESPACE ||
+                (t >= BUS_MATCH_ARG_PATH && t <= BUS_MATCH_ARG_PATH_LAST) ||
+                (t >= BUS_MATCH_ARG_NAMESPACE && t <= BUS_MATCH_ARG_NAMESPACE_LAST);
+}
+
+static bool BUS_MATCH_HAS_HASHMAP(enum bus_match_node_type t) {
+        return BUS_MATCH_CAN_HASH(t) || BUS_MATCH_CAN_HASH_PREFIX(t);
+}
+
 static void bus_match_node_free(struct bus_match_node *node) {
         assert(node);
         assert(node->parent);
@@ -87,7 +99,7 @@ static void bus_match_node_free(struct bus_match_node *node) {
 
                 if (node->parent->type == BUS_MATCH_MESSAGE_TYPE)
                         hashmap_remove(node->parent->compare.children, UINT_TO_PTR(node->value.u8));
-                else if (BUS_MATCH_CAN_HASH(node->parent->type) && node->value.str)
+                else if (BUS_MATCH_HAS_HASHMAP(node->parent->type) && node->value.str)
                         hashmap_remove(node->parent->compare.children, node->value.str);
 
                 free(node->value.str);
@@ -240,6 +252,12 @@ static bool value_node_same(
         }
 }
 
+static int bus_match_run_prefix(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *test_str,
+                sd_bus_message *m);
+
 int bus_match_run(
                 sd_bus *bus,
                 struct bus_match_node *node,
@@ -402,6 +420,10 @@ int bus_match_run(
                         if (r != 0)
                                 return r;
                 }
+        } else if (BUS_MATCH_CAN_HASH_PREFIX(node->type)) {
+                r = bus_match_run_prefix(bus, node, test_str, m);
+                if (r != 0)
+                        return r;
         } else {
                 struct bus_match_node *c;
 
@@ -427,6 +449,86 @@ int bus_match_run(
         return bus_match_run(bus, node->next, m);
 }
 
+static int bus_match_run_prefix(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *buf = NULL;
+        struct bus_match_node *found;
+        bool arg_path;
+        size_t n, l;
+        char sep;
+        int r;
+
+        assert(node);
+        assert(BUS_MATCH_CAN_HASH_PREFIX(node->type));
+        assert(m);
+
+        if (!test_str)
+                return 0;
+
+        /* path_namespace= and argNnamespace= match if the pattern equals the value, or is a prefix of it that
+         * ends in or is followed by a separator. argNpath= matches if the pattern equals the value, or one is
+         * a prefix of the other that ends in a separator. Hence, instead of testing every pattern, look up
+         * each prefix of the value that qualifies, so that the cost depends on the number of labels of the
+         * value, not on the number of matches. */
+
+        arg_path = node->type >= BUS_MATCH_ARG_PATH && node->type <= BUS_MATCH_ARG_PATH_LAST;
+        sep = node->type >= BUS_MATCH_ARG_NAMESPACE && node->type <= BUS_MATCH_ARG_NAMESPACE_LAST ? '.' : '/';
+
+        n = strlen(test_str);
+        buf = memdup(test_str, n + 1);
+        if (!buf)
+                return -ENOMEM;
+
+        for (l = 0; l <= n; l++) {
+                char c;
+
+                if (l < n &&
+                    !(l > 0 && test_str[l-1] == sep) &&
+                    !(!arg_path && test_str[l] == sep))
+                        continue;
+
+                c = buf[l];
+                buf[l] = 0;
+                found = hashmap_get(node->compare.children, buf);
+                buf[l] = c;
+
+                if (!found)
+                        continue;
+
+                r = bus_match_run(bus, found, m);
+                if (r != 0)
+                        return r;
+
+                if (bus && bus->match_callbacks_modified)
+                        return 0;
+        }
+
+        if (arg_path && n > 0 && test_str[n-1] == sep) {
+                Iterator i;
+
+                /* The value ends in a separator, so it matches all longer patterns it is a prefix of. These we
+                 * can only find by iterating. */
+
+                HASHMAP_FOREACH(found, node->compare.children, i) {
+                        if (strlen(found->value.str) <= n || !startswith(found->value.str, test_str))
+                                continue;
+
+                        r = bus_match_run(bus, found, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+        }
+
+        return 0;
+}
+
 static int bus_match_add_compare_value(
                 struct bus_match_node *where,
                 enum bus_match_node_type t,
@@ -451,7 +553,7 @@ static int bus_match_add_compare_value(
 
                 if (t == BUS_MATCH_MESSAGE_TYPE)
                         n = hashmap_get(c->compare.children, UINT_TO_PTR(value_u8));
-                else if (BUS_MATCH_CAN_HASH(t))
+                else if (BUS_MATCH_HAS_HASHMAP(t))
                         n = hashmap_get(c->compare.children, value_str);
                 else {
                         for (n = c->child; n && !value_node_same(n, t, value_u8, value_str); n = n->next)
@@ -485,7 +587,7 @@ static int bus_match_add_compare_value(
                                 r = -ENOMEM;
                                 goto fail;
                         }
-                } else if (BUS_MATCH_CAN_HASH(t)) {
+                } else if (BUS_MATCH_HAS_HASHMAP(t)) {
                         c->compare.children = hashmap_new(&string_hash_ops);
                         if (!c->compare.children) {
                                 r = -ENOMEM;
@@ -955,7 +1057,7 @@ void bus_match_free(struct bus_match_node *node) {
         if (!node)
                 return;
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_HAS_HASHMAP(node->type)) {
                 Iterator i;
 
                 HASHMAP_FOREACH(c, node->compare.children, i)
@@ -1048,7 +1150,7 @@ void bus_match_dump(struct bus_match_node *node, unsigned level) {
         else
                 putchar('\n');
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_HAS_HASHMAP(node->type)) {
                 Iterator i;
 
                 HASHMAP_FOREACH(c, node->compare.children, i)
@@ -110,9 +110,105 @@ static void message_reset_containers(sd_bus_message *m) {
         m->root_container.index = 0;
 }
 
+static void message_free_pooled(sd_bus_message *m) {
+        assert(m);
+
+        free(m->header_spare);
+        free(m->body_spare);
+        free(m->containers);
+        free(m);
+}
+
+static bool message_recycle(sd_bus_message *m) {
+        struct bus_container *containers;
+        size_t containers_allocated, body_spare_allocated;
+        void *header_spare, *body_spare;
+        sd_bus *bus;
+        bool pooled;
+
+        assert(m);
+
+        /* Puts a message we allocated ourselves back into the pool of its bus, after releasing everything
+         * but the buffers for the header, the first body part and the container stack, unless they grew
+         * large. Returns false if the message needs to be freed normally. */
+
+        bus = m->bus;
+        if (!bus || !m->recyclable || bus->n_message_pool >= BUS_MESSAGE_POOL_MAX)
+                return false;
+
+        header_spare = m->header_spare;
+        if (m->free_header) {
+                if (!header_spare && sizeof(struct bus_header) + m->fields_size <= BUS_MESSAGE_POOL_BUFFER_MAX)
+                        header_spare = m->header;
+                else
+                        free(m->header);
+        }
+
+        body_spare = m->body_spare;
+        body_spare_allocated = m->body_spare_allocated;
+        if (!body_spare &&
+            m->n_body_parts > 0 &&
+            m->body.free_this &&
+            m->body.allocated <= BUS_MESSAGE_POOL_BUFFER_MAX) {
+                body_spare = m->body.data;
+                body_spare_allocated = m->body.allocated;
+                m->body.free_this = false;
+        }
+
+        message_reset_parts(m);
+
+        if (m->free_fds) {
+                close_many(m->fds, m->n_fds);
+                free(m->fds);
+        }
+
+        if (m->iovec != m->iovec_fixed)
+                free(m->iovec);
+
+        while (m->n_containers > 0)
+                message_free_last_container(m);
+        message_free_last_container(m);
+        containers = m->containers;
+        containers_allocated = m->containers_allocated;
+
+        bus_creds_done(&m->creds);
+
+        memzero(m, ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header));
+        m->header_spare = header_spare;
+        m->body_spare = body_spare;
+        m->body_spare_allocated = body_spare_allocated;
+        m->containers = containers;
+        m->containers_allocated = containers_allocated;
+
+        assert_se(pthread_mutex_lock(&bus->message_pool_mutex) == 0);
+        pooled = bus->n_message_pool < BUS_MESSAGE_POOL_MAX;
+        if (pooled)
+                bus->message_pool[bus->n_message_pool++] = m;
+        assert_se(pthread_mutex_unlock(&bus->message_pool_mutex) == 0);
+
+        if (!pooled)
+                message_free_pooled(m);
+
+        /* This might free the bus, and the pool with it, hence do it last */
+        sd_bus_unref(bus);
+        return true;
+}
+
+void bus_message_pool_flush(sd_bus *bus) {
+        assert(bus);
+
+        assert_se(pthread_mutex_lock(&bus->message_pool_mutex) == 0);
+        while (bus->n_message_pool > 0)
+                message_free_pooled(bus->message_pool[--bus->n_message_pool]);
+        assert_se(pthread_mutex_unlock(&bus->message_pool_mutex) == 0);
+}
+
 static sd_bus_message* message_free(sd_bus_message *m) {
         assert(m);
 
+        if (message_recycle(m))
+                return NULL;
+
         if (m->free_header)
                 free(m->header);
 
@@ -133,6 +229,9 @@ static sd_bus_message* message_free(sd_bus_message *m) {
         message_free_last_container(m);
 
         bus_creds_done(&m->creds);
+
+        free(m->header_spare);
+        free(m->body_spare);
         return mfree(m);
 }
 
@@ -165,12 +264,15 @@ static void *message_extend_fields(sd_bus_message *m, size_t align, size_t sz, b
         } else {
                 /* Initially, the header is allocated as part of
                  * the sd_bus_message itself, let's replace it by
-                 * dynamic data */
+                 * dynamic data, reusing the buffer left over from
+                 * a previous use of the object, if there is one */
 
-                np = malloc(ALIGN8(new_size));
+                np = realloc(m->header_spare, ALIGN8(new_size));
                 if (!np)
                         goto poison;
 
+                m->header_spare = NULL;
+
                 memcpy(np, m->header, sizeof(struct bus_header));
         }
 
@@ -472,6 +574,9 @@ int bus_message_from_header(
                 if (h->dbus2.cookie == 0)
                         return -EBADMSG;
 
+                if (BUS_MESSAGE_BSWAP32(m, h->dbus2.message_size) != message_size)
+                        return -EBADMSG;
+
                 /* dbus2 derives the sizes from the message size and
                 the offset table at the end, since it is formatted as
                 gvariant "yyyyuta{tv}v". Since the message itself is a
@@ -568,6 +673,69 @@ int bus_message_from_malloc(
         return 0;
 }
 
+int bus_message_from_malloc_and_memfd(
+                sd_bus *bus,
+                void *buffer,
+                size_t length,
+                int memfd,
+                size_t memfd_size,
+                int *fds,
+                size_t n_fds,
+                const char *label,
+                sd_bus_message **ret) {
+
+        _cleanup_(message_freep) sd_bus_message *m = NULL;
+        struct bus_body_part body = {
+                .memfd = memfd,
+                .size = memfd_size,
+                .sealed = true,
+        };
+        int r;
+
+        assert(memfd >= 0);
+        assert(memfd_size > 0);
+
+        /* Like bus_message_from_malloc(), but the buffer only contains the header, and the body is mapped from
+         * a sealed memfd. On success we take possession of the memfd, too. The body is mapped first, since
+         * GVariant messages carry the offset to the end of the fields at the very end of it. */
+
+        r = bus_body_part_map(&body);
+        if (r < 0)
+                return r;
+
+        r = bus_message_from_header(
+                        bus,
+                        buffer, length,
+                        body.data, memfd_size,
+                        length + memfd_size,
+                        fds, n_fds,
+                        label,
+                        0, &m);
+        if (r >= 0 && length != BUS_MESSAGE_BODY_BEGIN(m))
+                r = -EBADMSG;
+        if (r < 0) {
+                bus_body_part_unmap(&body);
+                return r;
+        }
+
+        m->n_body_parts = 1;
+        m->body = body;
+
+        r = bus_message_parse_fields(m);
+        if (r < 0) {
+                /* Leave the memfd to the caller */
+                bus_body_part_unmap(&m->body);
+                m->body.memfd = -1;
+                return r;
+        }
+
+        m->free_header = true;
+        m->free_fds = true;
+
+        *ret = TAKE_PTR(m);
+        return 0;
+}
+
 _public_ int sd_bus_message_new(
                 sd_bus *bus,
                 sd_bus_message **m,
@@ -580,11 +748,18 @@ _public_ int sd_bus_message_new(
         assert_return(m, -EINVAL);
         assert_return(type < _SD_BUS_MESSAGE_TYPE_MAX, -EINVAL);
 
-        t = malloc0(ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header));
-        if (!t)
-                return -ENOMEM;
+        assert_se(pthread_mutex_lock(&bus->message_pool_mutex) == 0);
+        t = bus->n_message_pool > 0 ? bus->message_pool[--bus->n_message_pool] : NULL;
+        assert_se(pthread_mutex_unlock(&bus->message_pool_mutex) == 0);
+
+        if (!t) {
+                t = malloc0(ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header));
+                if (!t)
+                        return -ENOMEM;
+        }
 
         t->n_ref = 1;
+        t->recyclable = true;
         t->header = (struct bus_header*) ((uint8_t*) t + ALIGN(sizeof(struct sd_bus_message)));
         t->header->endian = BUS_NATIVE_ENDIAN;
         t->header->type = type;
@@ -1163,6 +1338,14 @@ static int part_make_space(
         if (m->poisoned)
                 return -ENOMEM;
 
+        if (part->allocated == 0 && part == &m->body && m->body_spare) {
+                /* Start out with the buffer left over from a previous use of the object */
+                part->data = TAKE_PTR(m->body_spare);
+                part->allocated = m->body_spare_allocated;
+                part->free_this = true;
+                m->body_spare_allocated = 0;
+        }
+
         if (part->allocated == 0 || sz > part->allocated) {
                 size_t new_allocated;
 
@@ -2800,6 +2983,8 @@ static int bus_message_close_header(sd_bus_message *m) {
 
                 m->footer = d;
                 m->footer_accessible = 1 + l + 2 + sz;
+
+                m->header->dbus2.message_size = (uint32_t) (sizeof(struct bus_header) + ALIGN8(m->fields_size) + m->body_size);
         } else {
                 m->header->dbus1.fields_size = m->fields_size;
                 m->header->dbus1.body_size = m->body_size;
@@ -5121,7 +5306,7 @@ int bus_message_parse_fields(sd_bus_message *m) {
                                 return r;
 
                         framing = bus_gvariant_read_word_le(q, sz);
-                        if (framing >= m->fields_size - sz)
+                        if (framing > m->fields_size - sz)
                                 return -EBADMSG;
                         if ((m->fields_size - framing) % sz != 0)
                                 return -EBADMSG;
@@ -76,6 +76,7 @@ struct sd_bus_message {
         bool free_header:1;
         bool free_fds:1;
         bool poisoned:1;
+        bool recyclable:1;
 
         /* The first and last bytes of the message */
         struct bus_header *header;
@@ -119,6 +120,12 @@ struct sd_bus_message {
 
         size_t header_offsets[_BUS_MESSAGE_HEADER_MAX];
         unsigned n_header_offsets;
+
+        /* Buffers left over from a previous use of this object, to be used for the header and the first body
+         * part once we need them */
+        void *header_spare;
+        void *body_spare;
+        size_t body_spare_allocated;
 };
 
 static inline bool BUS_MESSAGE_NEED_BSWAP(sd_bus_message *m) {
@@ -181,6 +188,8 @@ int bus_message_from_header(
                 size_t extra,
                 sd_bus_message **ret);
 
+void bus_message_pool_flush(sd_bus *bus);
+
 int bus_message_from_malloc(
                 sd_bus *bus,
                 void *buffer,
@@ -189,6 +198,16 @@ int bus_message_from_malloc(
                 size_t n_fds,
                 const char *label,
                 sd_bus_message **ret);
+int bus_message_from_malloc_and_memfd(
+                sd_bus *bus,
+                void *buffer,
+                size_t length,
+                int memfd,
+                size_t memfd_size,
+                int *fds,
+                size_t n_fds,
+                const char *label,
+                sd_bus_message **ret);
 
 int bus_message_get_arg(sd_bus_message *m, unsigned i, const char **str);
 int bus_message_get_arg_strv(sd_bus_message *m, unsigned i, char ***strv);
@@ -756,6 +756,127 @@ static int vtable_append_all_properties(
         return 1;
 }
 
+static int object_append_properties_on_node(
+                sd_bus *bus,
+                sd_bus_message *m,
+                const char *prefix,
+                const char *path,
+                bool require_fallback,
+                char **properties,
+                bool *found_object,
+                sd_bus_error *error) {
+
+        struct node_vtable *c;
+        struct node *n;
+        int r;
+
+        assert(bus);
+        assert(m);
+        assert(prefix);
+        assert(path);
+        assert(found_object);
+
+        n = hashmap_get(bus->nodes, prefix);
+        if (!n)
+                return 0;
+
+        LIST_FOREACH(vtables, c, n->vtables) {
+                const sd_bus_vtable *v;
+                void *u;
+
+                if (require_fallback && !c->is_fallback)
+                        continue;
+
+                r = node_vtable_get_userdata(bus, path, c, &u, error);
+                if (r < 0)
+                        return r;
+                if (bus->nodes_modified)
+                        return 0;
+                if (r == 0)
+                        continue;
+
+                *found_object = true;
+
+                if (strv_isempty(properties)) {
+                        r = vtable_append_all_properties(bus, m, path, c, u, error);
+                        if (r < 0)
+                                return r;
+                        if (bus->nodes_modified)
+                                return 0;
+
+                        continue;
+                }
+
+                if (c->vtable[0].flags & SD_BUS_VTABLE_HIDDEN)
+                        continue;
+
+                /* Properties that are explicitly asked for are included even if they are not part of
+                 * GetAll(), the same way Get() would return them. */
+                for (v = c->vtable+1; v->type != _SD_BUS_VTABLE_END; v++) {
+                        if (!IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
+                                continue;
+
+                        if (v->flags & SD_BUS_VTABLE_HIDDEN)
+                                continue;
+
+                        if (!strv_contains(properties, v->x.property.member))
+                                continue;
+
+                        r = vtable_append_one_property(bus, m, path, c, v, u, error);
+                        if (r < 0)
+                                return r;
+                        if (bus->nodes_modified)
+                                return 0;
+                }
+        }
+
+        return 0;
+}
+
+int bus_object_append_properties(
+                sd_bus *bus,
+                sd_bus_message *m,
+                const char *path,
+                char **properties,
+                sd_bus_error *error) {
+
+        bool found_object = false;
+        char *prefix;
+        int r;
+
+        assert(bus);
+        assert(m);
+        assert(path);
+
+        /* Appends the properties of the local object at the specified path to the "a{sv}" container that
+         * is currently open in the message, merged over all interfaces, the way GetAll() with an empty
+         * interface name reports them. If a list of property names is passed only those are included.
+         * Returns > 0 if the object exists, 0 if it doesn't. Returns -ESTALE if the registered objects changed
+         * while doing so, the caller has to build the message anew then. */
+
+        bus->nodes_modified = false;
+
+        r = object_append_properties_on_node(bus, m, path, path, false, properties, &found_object, error);
+        if (r < 0)
+                return r;
+
+        prefix = alloca(strlen(path) + 1);
+        OBJECT_PATH_FOREACH_PREFIX(prefix, path) {
+                if (found_object || bus->nodes_modified)
+                        break;
+
+                r = object_append_properties_on_node(bus, m, prefix, path, true, properties, &found_object, error);
+                if (r < 0)
+                        return r;
+        }
+
+        /* We might have appended half the properties already, hence the caller has to start over */
+        if (bus->nodes_modified)
+                return -ESTALE;
+
+        return found_object;
+}
+
 static int property_get_all_callbacks_run(
                 sd_bus *bus,
                 sd_bus_message *m,
@@ -1427,7 +1548,8 @@ static struct node *bus_node_allocate(sd_bus *bus, const char *path) {
         if (n)
                 return n;
 
-        r = hashmap_ensure_allocated(&bus->nodes, &string_hash_ops);
+        /* Only ever populated with paths registered locally, hence the faster hash is fine */
+        r = hashmap_ensure_allocated(&bus->nodes, &string_hash_ops_siphash13);
         if (r < 0)
                 return NULL;
 
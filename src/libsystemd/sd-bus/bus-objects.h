@@ -5,3 +5,5 @@
 
 int bus_process_object(sd_bus *bus, sd_bus_message *m);
 void bus_node_gc(sd_bus *b, struct node *n);
+
+int bus_object_append_properties(sd_bus *bus, sd_bus_message *m, const char *path, char **properties, sd_bus_error *error);
@@ -26,9 +26,11 @@ struct _packed_ bus_header {
                         uint32_t fields_size;
                 } dbus1;
 
-                /* dbus2: Used for kdbus connections */
+                /* dbus2: Used for AF_UNIX peer connections that negotiated GVariant encoding. The sizes of
+                 * the parts are derived from the offset table at the end, hence the header carries the total
+                 * message size so that stream transports know how much to read. */
                 struct _packed_ {
-                        uint32_t _reserved;
+                        uint32_t message_size;
                         uint64_t cookie;
                 } dbus2;
 
@@ -57,6 +59,11 @@ enum {
         BUS_MESSAGE_NO_REPLY_EXPECTED               = 1 << 0,
         BUS_MESSAGE_NO_AUTO_START                   = 1 << 1,
         BUS_MESSAGE_ALLOW_INTERACTIVE_AUTHORIZATION = 1 << 2,
+
+        /* Not part of the specification, and only used between peers that agreed on it with NEGOTIATE_MEMFD
+         * while authenticating: the body is not sent inline, but in a sealed memfd passed along as the last
+         * file descriptor, and the body size in the header is zero. */
+        BUS_MESSAGE_PAYLOAD_MEMFD                   = 1 << 7,
 };
 
 /* Header fields */
@@ -18,6 +18,7 @@
 #include "hexdecoct.h"
 #include "io-util.h"
 #include "macro.h"
+#include "memfd-util.h"
 #include "missing.h"
 #include "path-util.h"
 #include "process-util.h"
@@ -26,6 +27,7 @@
 #include "signal-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
+#include "unaligned.h"
 #include "user-util.h"
 #include "utf8.h"
 #include "util.h"
@@ -157,36 +159,43 @@ static int bus_socket_write_auth(sd_bus *b) {
         return 1;
 }
 
+static bool line_agrees(const char *s, const char *e, const char *line) {
+        size_t l;
+
+        assert(s);
+        assert(e);
+
+        l = strlen(line);
+        return (size_t) (e - s) == l && memcmp(s, line, l) == 0;
+}
+
 static int bus_socket_auth_verify_client(sd_bus *b) {
-        char *e, *f, *start;
+        char *lines[4], *start;
+        unsigned i, n_lines, k;
         sd_id128_t peer;
-        unsigned i;
         int r;
 
         assert(b);
 
-        /* We expect two response lines: "OK" and possibly
-         * "AGREE_UNIX_FD" */
+        /* We expect the "OK" line, followed by one response line for each of "NEGOTIATE_UNIX_FD",
+         * "NEGOTIATE_MEMFD" and "NEGOTIATE_GVARIANT" we sent, in that order */
 
-        e = memmem_safe(b->rbuffer, b->rbuffer_size, "\r\n", 2);
-        if (!e)
-                return 0;
+        n_lines = 1 + b->accept_fd + (b->accept_fd && b->accept_memfd) + b->accept_gvariant;
+        assert(n_lines <= ELEMENTSOF(lines));
 
-        if (b->accept_fd) {
-                f = memmem(e + 2, b->rbuffer_size - (e - (char*) b->rbuffer) - 2, "\r\n", 2);
-                if (!f)
+        start = b->rbuffer;
+        for (k = 0; k < n_lines; k++) {
+                lines[k] = memmem_safe(start, b->rbuffer_size - (start - (char*) b->rbuffer), "\r\n", 2);
+                if (!lines[k])
                         return 0;
 
-                start = f + 2;
-        } else {
-                f = NULL;
-                start = e + 2;
+                start = lines[k] + 2;
         }
 
         /* Nice! We got all the lines we need. First check the OK
          * line */
 
-        if (e - (char*) b->rbuffer != 3 + 32)
+        if (lines[0] - (char*) b->rbuffer != 3 + 32)
                 return -EPERM;
 
         if (memcmp(b->rbuffer, "OK ", 3))
@@ -212,13 +221,30 @@ static int bus_socket_auth_verify_client(sd_bus *b) {
 
         b->server_id = peer;
 
-        /* And possibly check the second line, too */
+        /* And then check the replies to what we negotiated, a peer that doesn't know about something
+         * answers with "ERROR" */
 
-        if (f)
-                b->can_fds =
-                        (f - e == STRLEN("\r\nAGREE_UNIX_FD")) &&
-                        memcmp(e + 2, "AGREE_UNIX_FD",
-                               STRLEN("AGREE_UNIX_FD")) == 0;
+        k = 1;
+        if (b->accept_fd) {
+                b->can_fds = line_agrees(lines[k-1] + 2, lines[k], "AGREE_UNIX_FD");
+                k++;
+
+                /* Passing bodies in memfds requires passing fds in the first place */
+                if (b->accept_memfd) {
+                        b->can_memfd = b->can_fds && line_agrees(lines[k-1] + 2, lines[k], "AGREE_MEMFD");
+                        k++;
+                }
+        }
+
+        if (b->accept_gvariant) {
+                b->can_gvariant = line_agrees(lines[k-1] + 2, lines[k], "AGREE_GVARIANT");
+                k++;
+        }
+
+        assert(k == n_lines);
+
+        if (b->can_gvariant)
+                b->message_version = 2;
 
         b->rbuffer_size -= (start - (char*) b->rbuffer);
         memmove(b->rbuffer, start, b->rbuffer_size);
@@ -429,6 +455,9 @@ static int bus_socket_auth_verify_server(sd_bus *b) {
                                 if (bus_socket_auth_needs_write(b))
                                         return 1;
 
+                                if (b->can_gvariant)
+                                        b->message_version = 2;
+
                                 b->rbuffer_size -= (e + 2 - (char*) b->rbuffer);
                                 memmove(b->rbuffer, e + 2, b->rbuffer_size);
                                 return bus_start_running(b);
@@ -459,6 +488,20 @@ static int bus_socket_auth_verify_server(sd_bus *b) {
                                 b->can_fds = true;
                                 r = bus_socket_auth_write(b, "AGREE_UNIX_FD\r\n");
                         }
+                } else if (line_equals(line, l, "NEGOTIATE_MEMFD")) {
+                        if (b->auth == _BUS_AUTH_INVALID || !b->can_fds || !b->accept_memfd)
+                                r = bus_socket_auth_write(b, "ERROR\r\n");
+                        else {
+                                b->can_memfd = true;
+                                r = bus_socket_auth_write(b, "AGREE_MEMFD\r\n");
+                        }
+                } else if (line_equals(line, l, "NEGOTIATE_GVARIANT")) {
+                        if (b->auth == _BUS_AUTH_INVALID || !b->accept_gvariant)
+                                r = bus_socket_auth_write(b, "ERROR\r\n");
+                        else {
+                                b->can_gvariant = true;
+                                r = bus_socket_auth_write(b, "AGREE_GVARIANT\r\n");
+                        }
                 } else
                         r = bus_socket_auth_write(b, "ERROR\r\n");
 
@@ -601,8 +644,8 @@ static void bus_get_peercred(sd_bus *b) {
 }
 
 static int bus_socket_start_auth_client(sd_bus *b) {
-        size_t l;
-        const char *auth_suffix, *auth_prefix;
+        _cleanup_free_ char *token = NULL;
+        const char *auth_prefix;
 
         assert(b);
 
@@ -610,8 +653,7 @@ static int bus_socket_start_auth_client(sd_bus *b) {
                 auth_prefix = "\0AUTH ANONYMOUS ";
 
                 /* For ANONYMOUS auth we send some arbitrary "trace" string */
-                l = 9;
-                b->auth_buffer = hexmem("anonymous", l);
+                token = hexmem("anonymous", 9);
         } else {
                 char text[DECIMAL_STR_MAX(uid_t) + 1];
 
@@ -619,21 +661,24 @@ static int bus_socket_start_auth_client(sd_bus *b) {
 
                 xsprintf(text, UID_FMT, geteuid());
 
-                l = strlen(text);
-                b->auth_buffer = hexmem(text, l);
+                token = hexmem(text, strlen(text));
         }
 
-        if (!b->auth_buffer)
+        if (!token)
                 return -ENOMEM;
 
-        if (b->accept_fd)
-                auth_suffix = "\r\nNEGOTIATE_UNIX_FD\r\nBEGIN\r\n";
-        else
-                auth_suffix = "\r\nBEGIN\r\n";
+        /* The token is followed by one line for each feature we'd like to negotiate, the server replies
+         * to them in order, see bus_socket_auth_verify_client() */
+        b->auth_buffer = strjoin(token, "\r\n",
+                                 b->accept_fd ? "NEGOTIATE_UNIX_FD\r\n" : "",
+                                 b->accept_fd && b->accept_memfd ? "NEGOTIATE_MEMFD\r\n" : "",
+                                 b->accept_gvariant ? "NEGOTIATE_GVARIANT\r\n" : "",
+                                 "BEGIN\r\n");
+        if (!b->auth_buffer)
+                return -ENOMEM;
 
         b->auth_iovec[0] = IOVEC_MAKE((void*) auth_prefix, 1 + strlen(auth_prefix + 1));
-        b->auth_iovec[1] = IOVEC_MAKE(b->auth_buffer, l * 2);
-        b->auth_iovec[2] = IOVEC_MAKE_STRING(auth_suffix);
+        b->auth_iovec[1] = IOVEC_MAKE_STRING(b->auth_buffer);
 
         return bus_socket_write_auth(b);
 }
@@ -653,6 +698,10 @@ int bus_socket_start_auth(sd_bus *b) {
                 if (sd_is_socket(b->output_fd, AF_UNIX, 0, 0) <= 0)
                         b->accept_fd = false;
 
+        /* The bus broker only speaks dbus1, GVariant encoding is for direct connections between sd-bus peers */
+        if (b->bus_client)
+                b->accept_gvariant = false;
+
         if (b->is_server)
                 return bus_socket_read_auth(b);
         else
@@ -961,6 +1010,119 @@ int bus_socket_take_fd(sd_bus *b) {
         return bus_socket_start_auth(b);
 }
 
+static bool bus_socket_use_memfd_payload(sd_bus *bus, sd_bus_message *m) {
+        assert(bus);
+        assert(m);
+
+        return bus->can_memfd &&
+                m->body_size >= BUS_MEMFD_PAYLOAD_MIN &&
+                m->n_fds < BUS_FDS_MAX;
+}
+
+static int bus_socket_make_payload_memfd(sd_bus_message *m) {
+        _cleanup_close_ int fd = -1;
+        struct bus_body_part *part;
+        unsigned i;
+        int r;
+
+        assert(m);
+
+        fd = memfd_new("sd-bus-payload");
+        if (fd < 0)
+                return fd;
+
+        MESSAGE_FOREACH_PART(part, i, m) {
+                r = bus_body_part_map(part);
+                if (r < 0)
+                        return r;
+
+                r = loop_write(fd, part->data, part->size, false);
+                if (r < 0)
+                        return r;
+        }
+
+        r = memfd_set_sealed(fd);
+        if (r < 0)
+                return r;
+
+        return TAKE_FD(fd);
+}
+
+static int bus_socket_write_message_memfd(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+        struct bus_header h;
+        struct iovec iov[2];
+        struct msghdr mh = {
+                .msg_iov = iov,
+                .msg_iovlen = ELEMENTSOF(iov),
+        };
+        size_t begin;
+        unsigned j = 0;
+        ssize_t k;
+
+        assert(bus);
+        assert(m);
+        assert(idx);
+
+        /* Only the header goes through the socket, with the body replaced by a sealed memfd that the peer
+         * maps. We keep the memfd around until the header was written completely, as we might get here
+         * again with the same message if the socket is full. */
+
+        begin = BUS_MESSAGE_BODY_BEGIN(m);
+        assert(*idx < begin);
+
+        if (bus->wpayload_message != m) {
+                int fd;
+
+                fd = bus_socket_make_payload_memfd(m);
+                if (fd < 0)
+                        return fd;
+
+                sd_bus_message_unref(bus->wpayload_message);
+                safe_close(bus->wpayload_fd);
+
+                bus->wpayload_message = sd_bus_message_ref(m);
+                bus->wpayload_fd = fd;
+        }
+
+        h = *m->header;
+        h.flags |= BUS_MESSAGE_PAYLOAD_MEMFD;
+        if (BUS_MESSAGE_IS_GVARIANT(m))
+                h.dbus2.message_size = BUS_MESSAGE_BSWAP32(m, (uint32_t) begin);
+        else
+                h.dbus1.body_size = 0;
+
+        iov[0] = IOVEC_MAKE(&h, sizeof(h));
+        iov[1] = IOVEC_MAKE((uint8_t*) m->header + sizeof(h), begin - sizeof(h));
+        iovec_advance(iov, &j, *idx);
+
+        if (*idx == 0) {
+                struct cmsghdr *control;
+
+                mh.msg_control = control = alloca(CMSG_SPACE(sizeof(int) * (m->n_fds + 1)));
+                mh.msg_controllen = control->cmsg_len = CMSG_LEN(sizeof(int) * (m->n_fds + 1));
+                control->cmsg_level = SOL_SOCKET;
+                control->cmsg_type = SCM_RIGHTS;
+                memcpy_safe(CMSG_DATA(control), m->fds, sizeof(int) * m->n_fds);
+                ((int*) CMSG_DATA(control))[m->n_fds] = bus->wpayload_fd;
+        }
+
+        k = sendmsg(bus->output_fd, &mh, MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (k < 0)
+                return errno == EAGAIN ? 0 : -errno;
+
+        *idx += (size_t) k;
+
+        if (*idx >= begin) {
+                /* The peer has its own reference to the memfd now, and the callers count the body as written */
+                bus->wpayload_message = sd_bus_message_unref(bus->wpayload_message);
+                bus->wpayload_fd = safe_close(bus->wpayload_fd);
+
+                *idx = BUS_MESSAGE_SIZE(m);
+        }
+
+        return 1;
+}
+
 int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         struct iovec *iov;
         ssize_t k;
@@ -976,6 +1138,9 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         if (*idx >= BUS_MESSAGE_SIZE(m))
                 return 0;
 
+        if (bus_socket_use_memfd_payload(bus, m))
+                return bus_socket_write_message_memfd(bus, m, idx);
+
         r = bus_message_setup_iovec(m);
         if (r < 0)
                 return r;
@@ -1019,7 +1184,14 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
         return 1;
 }
 
+static void *bus_socket_rbuffer_data(sd_bus *bus) {
+        assert(bus);
+
+        return (uint8_t*) bus->rbuffer + bus->rbuffer_begin;
+}
+
 static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
+        const uint8_t *p;
         uint32_t a, b;
         uint8_t e;
         uint64_t sum;
@@ -1050,10 +1222,12 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
                 return 0;
         }
 
-        a = ((const uint32_t*) bus->rbuffer)[1];
-        b = ((const uint32_t*) bus->rbuffer)[3];
+        p = bus_socket_rbuffer_data(bus);
 
-        e = ((const uint8_t*) bus->rbuffer)[0];
+        a = unaligned_read_ne32(p + 4);
+        b = unaligned_read_ne32(p + 12);
+
+        e = p[0];
         if (e == BUS_LITTLE_ENDIAN) {
                 a = le32toh(a);
                 b = le32toh(b);
@@ -1063,7 +1237,18 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         } else
                 return -EBADMSG;
 
-        sum = (uint64_t) sizeof(struct bus_header) + (uint64_t) ALIGN_TO(b, 8) + (uint64_t) a;
+        if (p[3] == 2) {
+                /* GVariant messages carry their total size in the header, but only peers that agreed on
+                 * the encoding may send them to us. */
+                if (!bus->can_gvariant)
+                        return -EBADMSG;
+
+                if (a < sizeof(struct bus_header) + 8)
+                        return -EBADMSG;
+
+                sum = (uint64_t) a;
+        } else
+                sum = (uint64_t) sizeof(struct bus_header) + (uint64_t) ALIGN_TO(b, 8) + (uint64_t) a;
         if (sum >= BUS_MESSAGE_SIZE_MAX)
                 return -ENOBUFS;
 
@@ -1071,8 +1256,79 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         return 0;
 }
 
+static uint32_t bus_header_to_host32(const struct bus_header *h, uint32_t u) {
+        assert(h);
+
+        /* Byte swapping is symmetric, hence this converts in both directions */
+        return h->endian == BUS_BIG_ENDIAN ? be32toh(u) : le32toh(u);
+}
+
+static int bus_socket_take_payload_memfd(
+                sd_bus *bus,
+                struct bus_header *h,
+                size_t size,
+                int *fds,
+                size_t *n_fds,
+                int *ret_fd,
+                size_t *ret_size) {
+
+        _cleanup_close_ int fd = -1;
+        uint64_t sz;
+        int r;
+
+        assert(bus);
+        assert(h);
+        assert(size >= sizeof(struct bus_header));
+        assert(n_fds);
+        assert(fds || *n_fds <= 0);
+        assert(ret_fd);
+        assert(ret_size);
+
+        if (!bus->can_memfd || !IN_SET(h->version, 1, 2) || !(h->flags & BUS_MESSAGE_PAYLOAD_MEMFD)) {
+                *ret_fd = -1;
+                *ret_size = 0;
+                return 0;
+        }
+
+        /* The body was passed in a memfd, as the last fd. Make sure nobody can modify it while we look at
+         * it, and turn the header into what it would have been if the body was sent inline. */
+
+        if (*n_fds <= 0)
+                return -EBADMSG;
+        if (h->version == 2 ? bus_header_to_host32(h, h->dbus2.message_size) != size : h->dbus1.body_size != 0)
+                return -EBADMSG;
+
+        fd = fds[--*n_fds];
+
+        r = memfd_get_sealed(fd);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EBADMSG;
+
+        r = memfd_get_size(fd, &sz);
+        if (r < 0)
+                return r;
+        if (sz == 0 || sz > BUS_MESSAGE_SIZE_MAX - size)
+                return -EBADMSG;
+
+        h->flags &= ~BUS_MESSAGE_PAYLOAD_MEMFD;
+        if (h->version == 2)
+                h->dbus2.message_size = bus_header_to_host32(h, (uint32_t) (size + sz));
+        else
+                h->dbus1.body_size = bus_header_to_host32(h, (uint32_t) sz);
+
+        *ret_fd = TAKE_FD(fd);
+        *ret_size = (size_t) sz;
+        return 1;
+}
+
 static int bus_socket_make_message(sd_bus *bus, size_t size) {
+        _cleanup_close_ int payload_fd = -1;
+        size_t payload_size, n_fds = 0;
+        bool take_buffer, take_fds;
         sd_bus_message *t;
+        int *fds = NULL;
         void *b;
         int r;
 
@@ -1084,42 +1340,127 @@ static int bus_socket_make_message(sd_bus *bus, size_t size) {
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size > size) {
-                b = memdup((const uint8_t*) bus->rbuffer + size,
-                           bus->rbuffer_size - size);
+        /* With read-ahead, the fds we received belong to the last message that started in the read that
+         * delivered them (the kernel never merges two batches of fds into one read). Hence, they are ours
+         * if the next message begins only after the end of that read. */
+        take_fds = bus->n_fds > 0 && size >= bus->rbuffer_fds_end;
+        if (take_fds) {
+                fds = bus->fds;
+                n_fds = bus->n_fds;
+        }
+
+        /* If the buffer contains just this message, and not much more space, hand it over. Otherwise copy the
+         * message out, so that the read-ahead buffer can be reused, and the message is properly aligned. */
+        take_buffer = bus->rbuffer_begin == 0 && bus->rbuffer_size == size && bus->rbuffer_allocated <= size * 2;
+        if (take_buffer)
+                b = bus->rbuffer;
+        else {
+                b = memdup(bus_socket_rbuffer_data(bus), size);
                 if (!b)
                         return -ENOMEM;
-        } else
-                b = NULL;
+        }
 
-        r = bus_message_from_malloc(bus,
-                                    bus->rbuffer, size,
-                                    bus->fds, bus->n_fds,
-                                    NULL,
-                                    &t);
+        r = bus_socket_take_payload_memfd(bus, b, size, fds, &n_fds, &payload_fd, &payload_size);
+        if (r >= 0) {
+                if (payload_fd >= 0)
+                        r = bus_message_from_malloc_and_memfd(bus,
+                                                              b, size,
+                                                              payload_fd, payload_size,
+                                                              fds, n_fds,
+                                                              NULL,
+                                                              &t);
+                else
+                        r = bus_message_from_malloc(bus,
+                                                    b, size,
+                                                    fds, n_fds,
+                                                    NULL,
+                                                    &t);
+        }
         if (r < 0) {
-                free(b);
+                if (!take_buffer)
+                        free(b);
                 return r;
         }
 
-        bus->rbuffer = b;
+        /* The message owns the memfd now */
+        TAKE_FD(payload_fd);
+
+        if (take_buffer) {
+                bus->rbuffer = NULL;
+                bus->rbuffer_allocated = 0;
+        }
+
         bus->rbuffer_size -= size;
+        bus->rbuffer_begin = bus->rbuffer_size > 0 ? bus->rbuffer_begin + size : 0;
 
-        bus->fds = NULL;
-        bus->n_fds = 0;
+        if (take_fds) {
+                bus->fds = NULL;
+                bus->n_fds = 0;
+                bus->rbuffer_fds_end = 0;
+        } else if (bus->n_fds > 0)
+                bus->rbuffer_fds_end -= size;
 
         bus->rqueue[bus->rqueue_size++] = t;
 
         return 1;
 }
 
+static int bus_socket_make_messages(sd_bus *bus) {
+        size_t need;
+        int r;
+
+        assert(bus);
+
+        /* Turn everything we have read completely into messages right-away, so that the rqueue tells
+         * everybody there's more to dispatch, and nobody waits for data that is already in our buffer. */
+
+        for (;;) {
+                r = bus_socket_read_message_need(bus, &need);
+                if (r < 0)
+                        return r;
+
+                if (bus->rbuffer_size < need)
+                        return 1;
+
+                r = bus_socket_make_message(bus, need);
+                if (r < 0)
+                        return r;
+
+                if (bus->rqueue_size >= BUS_RQUEUE_MAX)
+                        return 1;
+        }
+}
+
+int bus_socket_take_rbuffer(sd_bus *bus, void **ret, size_t *ret_size) {
+        assert(bus);
+        assert(ret);
+        assert(ret_size);
+
+        /* Hands the data that was read from the socket but not turned into messages yet over to the caller,
+         * who then reads from the socket on its own. Only works while no messages or fds are queued, as
+         * these would be lost otherwise. */
+
+        if (bus->state != BUS_RUNNING)
+                return -ENOTCONN;
+        if (bus->rqueue_size > 0 || bus->n_fds > 0)
+                return -EBUSY;
+
+        if (bus->rbuffer_begin > 0)
+                memmove(bus->rbuffer, bus_socket_rbuffer_data(bus), bus->rbuffer_size);
+
+        *ret = TAKE_PTR(bus->rbuffer);
+        *ret_size = bus->rbuffer_size;
+
+        bus->rbuffer_size = bus->rbuffer_begin = bus->rbuffer_allocated = 0;
+        return 0;
+}
+
 int bus_socket_read_message(sd_bus *bus) {
         struct msghdr mh;
         struct iovec iov = {};
         ssize_t k;
-        size_t need;
+        size_t need, want;
         int r;
-        void *b;
         union {
                 struct cmsghdr cmsghdr;
                 uint8_t buf[CMSG_SPACE(sizeof(int) * BUS_FDS_MAX)];
@@ -1136,13 +1477,33 @@ int bus_socket_read_message(sd_bus *bus) {
         if (bus->rbuffer_size >= need)
                 return bus_socket_make_message(bus, need);
 
-        b = realloc(bus->rbuffer, need);
-        if (!b)
-                return -ENOMEM;
+        /* Data left over from authentication is in a buffer of unknown size, but at least this big */
+        if (bus->rbuffer_allocated < bus->rbuffer_begin + bus->rbuffer_size)
+                bus->rbuffer_allocated = bus->rbuffer_begin + bus->rbuffer_size;
+
+        /* Pull in as many messages as we can with a single syscall, unless we are still holding fds for a
+         * message in the buffer: a second batch of fds could not be told apart from the first then. */
+        want = bus->n_fds > 0 ? need : MAX(need, bus->rbuffer_ahead);
+
+        if (bus->rbuffer_begin + want > bus->rbuffer_allocated) {
+                if (bus->rbuffer_begin > 0) {
+                        memmove(bus->rbuffer, bus_socket_rbuffer_data(bus), bus->rbuffer_size);
+                        bus->rbuffer_begin = 0;
+                }
 
-        bus->rbuffer = b;
+                if (want > bus->rbuffer_allocated) {
+                        void *b;
+
+                        b = realloc(bus->rbuffer, want);
+                        if (!b)
+                                return -ENOMEM;
+
+                        bus->rbuffer = b;
+                        bus->rbuffer_allocated = want;
+                }
+        }
 
-        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, need - bus->rbuffer_size);
+        iov = IOVEC_MAKE((uint8_t*) bus_socket_rbuffer_data(bus) + bus->rbuffer_size, want - bus->rbuffer_size);
 
         if (bus->prefer_readv)
                 k = readv(bus->input_fd, &iov, 1);
@@ -1167,6 +1528,15 @@ int bus_socket_read_message(sd_bus *bus) {
 
         bus->rbuffer_size += k;
 
+        /* Grow the read-ahead if the kernel had more for us than we asked for, shrink it if we keep asking
+         * for much more than there is */
+        if (want > need) {
+                if ((size_t) k >= iov.iov_len)
+                        bus->rbuffer_ahead = MIN(bus->rbuffer_ahead * 2, BUS_READ_AHEAD_MAX);
+                else if ((size_t) k < iov.iov_len / 4)
+                        bus->rbuffer_ahead = MAX(bus->rbuffer_ahead / 2, BUS_READ_AHEAD_MIN);
+        }
+
         if (handle_cmsg) {
                 struct cmsghdr *cmsg;
 
@@ -1195,19 +1565,14 @@ int bus_socket_read_message(sd_bus *bus) {
                                 for (i = 0; i < n; i++)
                                         f[bus->n_fds++] = fd_move_above_stdio(((int*) CMSG_DATA(cmsg))[i]);
                                 bus->fds = f;
+
+                                bus->rbuffer_fds_end = bus->rbuffer_size;
                         } else
                                 log_debug("Got unexpected auxiliary data with level=%d and type=%d",
                                           cmsg->cmsg_level, cmsg->cmsg_type);
         }
 
-        r = bus_socket_read_message_need(bus, &need);
-        if (r < 0)
-                return r;
-
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
-
-        return 1;
+        return bus_socket_make_messages(bus);
 }
 
 int bus_socket_process_opening(sd_bus *b) {
@@ -12,6 +12,7 @@ int bus_socket_start_auth(sd_bus *b);
 
 int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx);
 int bus_socket_read_message(sd_bus *bus);
+int bus_socket_take_rbuffer(sd_bus *bus, void **ret, size_t *ret_size);
 
 int bus_socket_process_opening(sd_bus *b);
 int bus_socket_process_authenticating(sd_bus *b);
@@ -10,7 +10,8 @@
 struct track_item {
         unsigned n_ref;
         char *name;
-        sd_bus_slot *slot;
+        sd_bus_track *track; /* set while linked into bus->track_names */
+        LIST_FIELDS(struct track_item, by_name);
 };
 
 struct sd_bus_track {
@@ -31,20 +32,69 @@ struct sd_bus_track {
         LIST_FIELDS(sd_bus_track, tracks);
 };
 
-#define MATCH_FOR_NAME(name)                            \
-        strjoina("type='signal',"                       \
-                 "sender='org.freedesktop.DBus',"       \
-                 "path='/org/freedesktop/DBus',"        \
-                 "interface='org.freedesktop.DBus',"    \
-                 "member='NameOwnerChanged',"           \
-                 "arg0='", name, "'")
+#define MATCH_NAME_OWNER_CHANGED                        \
+        "type='signal',"                                \
+        "sender='org.freedesktop.DBus',"                \
+        "path='/org/freedesktop/DBus',"                 \
+        "interface='org.freedesktop.DBus',"             \
+        "member='NameOwnerChanged'"
+
+static int track_item_link(struct track_item *i, sd_bus_track *track) {
+        struct track_item *head;
+        int r;
+
+        assert(i);
+        assert(track);
+        assert(!i->track);
+
+        /* All items of all tracks of a bus are indexed by name in bus->track_names, so that a NameOwnerChanged
+         * signal can be dispatched to everybody interested in it with a single lookup. Items for the same name
+         * are chained up, the hashmap points to the first of them. */
+
+        r = hashmap_ensure_allocated(&track->bus->track_names, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        head = hashmap_get(track->bus->track_names, i->name);
+        LIST_PREPEND(by_name, head, i);
+
+        r = hashmap_replace(track->bus->track_names, head->name, head);
+        if (r < 0) {
+                LIST_REMOVE(by_name, head, i);
+                return r;
+        }
+
+        i->track = track;
+        return 0;
+}
+
+static void track_item_unlink(struct track_item *i) {
+        struct track_item *head;
+        sd_bus *bus;
+
+        assert(i);
+
+        if (!i->track)
+                return;
+
+        bus = i->track->bus;
+        i->track = NULL;
+
+        head = hashmap_get(bus->track_names, i->name);
+        LIST_REMOVE(by_name, head, i);
+
+        if (head)
+                assert_se(hashmap_replace(bus->track_names, head->name, head) >= 0);
+        else
+                hashmap_remove(bus->track_names, i->name);
+}
 
 static struct track_item* track_item_free(struct track_item *i) {
 
         if (!i)
                 return NULL;
 
-        sd_bus_slot_unref(i->slot);
+        track_item_unlink(i);
         free(i->name);
         return mfree(i);
 }
@@ -164,25 +214,50 @@ static sd_bus_track *track_free(sd_bus_track *track) {
 DEFINE_PUBLIC_TRIVIAL_REF_UNREF_FUNC(sd_bus_track, sd_bus_track, track_free);
 
 static int on_name_owner_changed(sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        sd_bus_track *track = userdata;
         const char *name, *old, *new;
+        struct track_item *i;
+        sd_bus *bus;
         int r;
 
         assert(message);
-        assert(track);
+
+        bus = sd_bus_message_get_bus(message);
 
         r = sd_bus_message_read(message, "sss", &name, &old, &new);
         if (r < 0)
                 return 0;
 
-        bus_track_remove_name_fully(track, name);
+        /* Every track watching this name loses it. Removing the name from a track unlinks its item, hence
+         * this terminates. */
+        while ((i = hashmap_get(bus->track_names, name)))
+                bus_track_remove_name_fully(i->track, name);
+
+        return 0;
+}
+
+static int bus_track_install_match(sd_bus *bus) {
+        int r;
+
+        assert(bus);
+
+        /* Instead of one match per tracked name, which the broker would have to check each NameOwnerChanged
+         * signal against, we subscribe to all of them once per bus, and dispatch them through
+         * bus->track_names. The slot is floating, it hence stays around for as long as the bus does. */
+
+        if (bus->track_match_installed)
+                return 0;
+
+        r = sd_bus_add_match_async(bus, NULL, MATCH_NAME_OWNER_CHANGED, on_name_owner_changed, NULL, NULL);
+        if (r < 0)
+                return r;
+
+        bus->track_match_installed = true;
         return 0;
 }
 
 _public_ int sd_bus_track_add_name(sd_bus_track *track, const char *name) {
         _cleanup_(track_item_freep) struct track_item *n = NULL;
         struct track_item *i;
-        const char *match;
         int r;
 
         assert_return(track, -EINVAL);
@@ -214,12 +289,16 @@ _public_ int sd_bus_track_add_name(sd_bus_track *track, const char *name) {
         if (!n->name)
                 return -ENOMEM;
 
-        /* First, subscribe to this name */
-        match = MATCH_FOR_NAME(name);
-
+        /* First, make sure we are subscribed to name changes */
         bus_track_remove_from_queue(track); /* don't dispatch this while we work in it */
 
-        r = sd_bus_add_match_async(track->bus, &n->slot, match, on_name_owner_changed, NULL, track);
+        r = bus_track_install_match(track->bus);
+        if (r < 0) {
+                bus_track_add_to_queue(track);
+                return r;
+        }
+
+        r = track_item_link(n, track);
         if (r < 0) {
                 bus_track_add_to_queue(track);
                 return r;
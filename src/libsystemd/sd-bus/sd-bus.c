@@ -156,6 +156,9 @@ static void bus_reset_queues(sd_bus *b) {
 
         b->wqueue = mfree(b->wqueue);
         b->wqueue_allocated = 0;
+
+        b->wpayload_message = sd_bus_message_unref(b->wpayload_message);
+        b->wpayload_fd = safe_close(b->wpayload_fd);
 }
 
 static sd_bus* bus_free(sd_bus *b) {
@@ -164,6 +167,7 @@ static sd_bus* bus_free(sd_bus *b) {
         assert(b);
         assert(!b->track_queue);
         assert(!b->tracks);
+        assert(hashmap_isempty(b->track_names));
 
         b->state = BUS_CLOSED;
 
@@ -197,6 +201,8 @@ static sd_bus* bus_free(sd_bus *b) {
         free(b->description);
         free(b->patch_sender);
 
+        hashmap_free(b->track_names);
+
         free(b->exec_path);
         strv_free(b->exec_argv);
 
@@ -218,8 +224,10 @@ static sd_bus* bus_free(sd_bus *b) {
         hashmap_free(b->nodes);
 
         bus_flush_memfd(b);
+        bus_message_pool_flush(b);
 
         assert_se(pthread_mutex_destroy(&b->memfd_cache_mutex) == 0);
+        assert_se(pthread_mutex_destroy(&b->message_pool_mutex) == 0);
 
         return mfree(b);
 }
@@ -240,6 +248,8 @@ _public_ int sd_bus_new(sd_bus **ret) {
                 .input_fd = -1,
                 .output_fd = -1,
                 .inotify_fd = -1,
+                .wpayload_fd = -1,
+                .rbuffer_ahead = BUS_READ_AHEAD_MIN,
                 .message_version = 1,
                 .creds_mask = SD_BUS_CREDS_WELL_KNOWN_NAMES|SD_BUS_CREDS_UNIQUE_NAME,
                 .accept_fd = true,
@@ -249,6 +259,7 @@ _public_ int sd_bus_new(sd_bus **ret) {
         };
 
         assert_se(pthread_mutex_init(&b->memfd_cache_mutex, NULL) == 0);
+        assert_se(pthread_mutex_init(&b->message_pool_mutex, NULL) == 0);
 
         /* We guarantee that wqueue always has space for at least one entry */
         if (!GREEDY_REALLOC(b->wqueue, b->wqueue_allocated, 1))
@@ -334,6 +345,26 @@ _public_ int sd_bus_negotiate_fds(sd_bus *bus, int b) {
         return 0;
 }
 
+_public_ int sd_bus_negotiate_memfd(sd_bus *bus, int b) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(bus->state == BUS_UNSET, -EPERM);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        bus->accept_memfd = !!b;
+        return 0;
+}
+
+_public_ int sd_bus_negotiate_gvariant(sd_bus *bus, int b) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(bus->state == BUS_UNSET, -EPERM);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        bus->accept_gvariant = !!b;
+        return 0;
+}
+
 _public_ int sd_bus_negotiate_timestamp(sd_bus *bus, int b) {
         assert_return(bus, -EINVAL);
         assert_return(bus = bus_resolve(bus), -ENOPKG);
@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <sys/wait.h>
 
 #include "sd-bus.h"
@@ -7,20 +9,59 @@
 #include "alloc-util.h"
 #include "bus-internal.h"
 #include "bus-kernel.h"
+#include "bus-match.h"
+#include "bus-message.h"
 #include "bus-util.h"
 #include "def.h"
 #include "fd-util.h"
 #include "missing_resource.h"
+#include "stdio-util.h"
+#include "strv.h"
 #include "time-util.h"
 #include "util.h"
 
 #define MAX_SIZE (2*1024*1024)
 
+/* Upper bound for the latency samples of one suite benchmark, they are allocated up front so that the
+ * allocation counts are not disturbed */
+#define N_SAMPLES_MAX (256U*1024U)
+
 static usec_t arg_loop_usec = 100 * USEC_PER_MSEC;
 
+/* Allocations done by each thread, for the suite to report them per operation */
+static thread_local uint64_t n_allocations = 0;
+
+#if HAS_FEATURE_ADDRESS_SANITIZER || HAS_FEATURE_MEMORY_SANITIZER
+#  define COUNT_ALLOCATIONS 0
+#else
+#  define COUNT_ALLOCATIONS 1
+
+/* Interpose the allocator entry points, and forward to the implementations glibc exports under internal
+ * names. Sanitizers bring their own allocator, hence we don't count under them. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+        n_allocations++;
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+        n_allocations++;
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *p, size_t size) {
+        n_allocations++;
+        return __libc_realloc(p, size);
+}
+#endif
+
 typedef enum Type {
         TYPE_LEGACY,
         TYPE_DIRECT,
+        TYPE_GVARIANT,
 } Type;
 
 static void server(sd_bus *b, size_t *result) {
@@ -155,9 +196,12 @@ static void client_chart(Type type, const char *address, const char *server_name
         r = sd_bus_new(&b);
         assert_se(r >= 0);
 
-        if (type == TYPE_DIRECT) {
+        if (IN_SET(type, TYPE_DIRECT, TYPE_GVARIANT)) {
                 r = sd_bus_set_fd(b, fd, fd);
                 assert_se(r >= 0);
+
+                r = sd_bus_negotiate_gvariant(b, type == TYPE_GVARIANT);
+                assert_se(r >= 0);
         } else {
                 r = sd_bus_set_address(b, address);
                 assert_se(r >= 0);
@@ -179,6 +223,9 @@ static void client_chart(Type type, const char *address, const char *server_name
         case TYPE_DIRECT:
                 printf("SIZE\tDIRECT\n");
                 break;
+        case TYPE_GVARIANT:
+                printf("SIZE\tGVARIANT\n");
+                break;
         }
 
         for (csize = 1; csize <= MAX_SIZE; csize *= 2) {
@@ -205,11 +252,490 @@ static void client_chart(Type type, const char *address, const char *server_name
         sd_bus_unref(b);
 }
 
+/* The performance suite: message construction and parsing for typical signatures, match dispatch, property
+ * retrieval, large array replies and fd passing, over a direct connection to a server thread. Reports
+ * latency percentiles and allocations per operation, so that regressions can be tracked across releases. */
+
+typedef enum Payload {
+        PAYLOAD_SIMPLE,     /* a method call like GetUnit() */
+        PAYLOAD_PROPERTIES, /* a GetAll() reply */
+        PAYLOAD_UNITS,      /* a ListUnits() reply */
+        _PAYLOAD_MAX,
+} Payload;
+
+static const char* const payload_signature[_PAYLOAD_MAX] = {
+        [PAYLOAD_SIMPLE] = "s",
+        [PAYLOAD_PROPERTIES] = "a{sv}",
+        [PAYLOAD_UNITS] = "a(ssssssouso)",
+};
+
+static const char* const payload_name[_PAYLOAD_MAX] = {
+        [PAYLOAD_SIMPLE] = "simple",
+        [PAYLOAD_PROPERTIES] = "properties",
+        [PAYLOAD_UNITS] = "units",
+};
+
+typedef struct BenchUnit {
+        const char *id;
+        const char *description;
+        const char *load_state;
+        const char *active_state;
+        const char *sub_state;
+        const char *fragment_path;
+        const char *slice;
+        const char *control_group;
+        char **names;
+        char **wants;
+        char **after;
+        uint32_t main_pid;
+        uint32_t n_restarts;
+        uint64_t active_enter_timestamp;
+        uint64_t inactive_exit_timestamp;
+        uint64_t memory_current;
+} BenchUnit;
+
+static BenchUnit bench_unit = {
+        .id = "systemd-journald.service",
+        .description = "Journal Service",
+        .load_state = "loaded",
+        .active_state = "active",
+        .sub_state = "running",
+        .fragment_path = "/usr/lib/systemd/system/systemd-journald.service",
+        .slice = "system.slice",
+        .control_group = "/system.slice/systemd-journald.service",
+        .names = STRV_MAKE("systemd-journald.service"),
+        .wants = STRV_MAKE("systemd-journald.socket", "systemd-journald-dev-log.socket"),
+        .after = STRV_MAKE("systemd-journald.socket", "systemd-journald-dev-log.socket", "syslog.socket"),
+        .main_pid = 4711,
+        .n_restarts = 0,
+        .active_enter_timestamp = UINT64_C(1546300800000000),
+        .inactive_exit_timestamp = UINT64_C(1546300799000000),
+        .memory_current = UINT64_C(41943040),
+};
+
+static void append_properties(sd_bus_message *m) {
+        const BenchUnit *u = &bench_unit;
+
+        assert_se(sd_bus_message_open_container(m, 'a', "{sv}") >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "Id", "s", u->id) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "Description", "s", u->description) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "LoadState", "s", u->load_state) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "ActiveState", "s", u->active_state) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "SubState", "s", u->sub_state) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "FragmentPath", "s", u->fragment_path) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "Slice", "s", u->slice) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "ControlGroup", "s", u->control_group) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "Names", "as", 1, u->names[0]) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "Wants", "as", 2, u->wants[0], u->wants[1]) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "After", "as", 3, u->after[0], u->after[1], u->after[2]) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "MainPID", "u", u->main_pid) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "NRestarts", "u", u->n_restarts) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "ActiveEnterTimestamp", "t", u->active_enter_timestamp) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "InactiveExitTimestamp", "t", u->inactive_exit_timestamp) >= 0);
+        assert_se(sd_bus_message_append(m, "{sv}", "MemoryCurrent", "t", u->memory_current) >= 0);
+        assert_se(sd_bus_message_close_container(m) >= 0);
+}
+
+static void append_units(sd_bus_message *m, unsigned n) {
+        const BenchUnit *u = &bench_unit;
+        unsigned i;
+
+        assert_se(sd_bus_message_open_container(m, 'a', "(ssssssouso)") >= 0);
+        for (i = 0; i < n; i++)
+                assert_se(sd_bus_message_append(m, "(ssssssouso)",
+                                                u->id, u->description, u->load_state, u->active_state,
+                                                u->sub_state, "",
+                                                "/org/freedesktop/systemd1/unit/systemd_2djournald_2eservice",
+                                                (uint32_t) 0, "", "/") >= 0);
+        assert_se(sd_bus_message_close_container(m) >= 0);
+}
+
+static sd_bus_message *payload_build(sd_bus *bus, Payload p) {
+        sd_bus_message *m;
+
+        assert_se(sd_bus_message_new_method_call(bus, &m, NULL, "/org/freedesktop/systemd1",
+                                                 "org.freedesktop.systemd1.Manager", "GetUnit") >= 0);
+
+        switch (p) {
+        case PAYLOAD_SIMPLE:
+                assert_se(sd_bus_message_append(m, "s", "systemd-journald.service") >= 0);
+                break;
+        case PAYLOAD_PROPERTIES:
+                append_properties(m);
+                break;
+        case PAYLOAD_UNITS:
+                append_units(m, 64);
+                break;
+        default:
+                assert_not_reached("Unknown payload");
+        }
+
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+        return m;
+}
+
+static int property_get_strv(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        return sd_bus_message_append_strv(reply, *(char***) userdata);
+}
+
+static int method_ping(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int method_list_units(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        uint32_t n;
+        int r;
+
+        r = sd_bus_message_read(m, "u", &n);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(m, &reply);
+        if (r < 0)
+                return r;
+
+        append_units(reply, n);
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int method_take_fd(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        int fd, r;
+
+        r = sd_bus_message_read(m, "h", &fd);
+        if (r < 0)
+                return r;
+
+        assert_se(fd >= 0);
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int method_quit(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        bool *quit = userdata;
+
+        *quit = true;
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static const sd_bus_vtable suite_unit_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_PROPERTY("Id", "s", NULL, offsetof(BenchUnit, id), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Description", "s", NULL, offsetof(BenchUnit, description), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("LoadState", "s", NULL, offsetof(BenchUnit, load_state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("ActiveState", "s", NULL, offsetof(BenchUnit, active_state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("SubState", "s", NULL, offsetof(BenchUnit, sub_state), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("FragmentPath", "s", NULL, offsetof(BenchUnit, fragment_path), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Slice", "s", NULL, offsetof(BenchUnit, slice), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("ControlGroup", "s", NULL, offsetof(BenchUnit, control_group), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Names", "as", property_get_strv, offsetof(BenchUnit, names), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Wants", "as", property_get_strv, offsetof(BenchUnit, wants), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("After", "as", property_get_strv, offsetof(BenchUnit, after), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("MainPID", "u", NULL, offsetof(BenchUnit, main_pid), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("NRestarts", "u", NULL, offsetof(BenchUnit, n_restarts), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("ActiveEnterTimestamp", "t", NULL, offsetof(BenchUnit, active_enter_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("InactiveExitTimestamp", "t", NULL, offsetof(BenchUnit, inactive_exit_timestamp), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("MemoryCurrent", "t", NULL, offsetof(BenchUnit, memory_current), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable suite_server_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_METHOD("Ping", NULL, NULL, method_ping, 0),
+        SD_BUS_METHOD("ListUnits", "u", "a(ssssssouso)", method_list_units, 0),
+        SD_BUS_METHOD("TakeFd", "h", NULL, method_take_fd, 0),
+        SD_BUS_METHOD("Quit", NULL, NULL, method_quit, 0),
+        SD_BUS_VTABLE_END
+};
+
+typedef struct SuiteServer {
+        int fd;
+        bool gvariant;
+} SuiteServer;
+
+static void *suite_server(void *p) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *b = NULL;
+        SuiteServer *s = p;
+        bool quit = false;
+        sd_id128_t id;
+
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, s->fd, s->fd) >= 0);
+        assert_se(sd_bus_set_server(b, true, id) >= 0);
+        assert_se(sd_bus_negotiate_gvariant(b, s->gvariant) >= 0);
+
+        assert_se(sd_bus_add_object_vtable(b, NULL, "/bench", "benchmark.Server", suite_server_vtable, &quit) >= 0);
+        assert_se(sd_bus_add_object_vtable(b, NULL, "/bench/unit", "benchmark.Unit", suite_unit_vtable, &bench_unit) >= 0);
+
+        assert_se(sd_bus_start(b) >= 0);
+
+        while (!quit) {
+                int r;
+
+                r = sd_bus_process(b, NULL);
+                assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(sd_bus_wait(b, USEC_INFINITY) >= 0);
+        }
+
+        return NULL;
+}
+
+static int nsec_compare(const nsec_t *a, const nsec_t *b) {
+        return CMP(*a, *b);
+}
+
+static nsec_t *samples = NULL;
+
+static void suite_run(const char *name, void (*op)(sd_bus *b, void *userdata), sd_bus *b, void *userdata) {
+        uint64_t allocations;
+        usec_t begin, end;
+        size_t n = 0;
+
+        assert(samples);
+
+        /* Warm up caches and pools first */
+        op(b, userdata);
+
+        allocations = n_allocations;
+        begin = now(CLOCK_MONOTONIC);
+        end = usec_add(begin, arg_loop_usec);
+
+        do {
+                nsec_t t;
+
+                t = now_nsec(CLOCK_MONOTONIC);
+                op(b, userdata);
+                samples[n++] = now_nsec(CLOCK_MONOTONIC) - t;
+        } while (n < N_SAMPLES_MAX && now(CLOCK_MONOTONIC) < end);
+
+        allocations = n_allocations - allocations;
+        end = now(CLOCK_MONOTONIC);
+
+        typesafe_qsort(samples, n, nsec_compare);
+
+        printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t",
+               name,
+               (uint64_t) n * USEC_PER_SEC / MAX(end - begin, (usec_t) 1),
+               samples[n / 2], samples[n * 9 / 10], samples[n * 99 / 100], samples[n - 1]);
+
+        if (COUNT_ALLOCATIONS)
+                printf("%.1f\n", (double) allocations / n);
+        else
+                printf("n/a\n");
+}
+
+static void op_build(sd_bus *b, void *userdata) {
+        sd_bus_message_unref(payload_build(b, PTR_TO_INT(userdata)));
+}
+
+typedef struct ParseContext {
+        void *blob;
+        size_t size;
+        const char *signature;
+} ParseContext;
+
+static void op_parse(sd_bus *b, void *userdata) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        ParseContext *c = userdata;
+        void *buffer;
+
+        /* Like bus_socket_make_message() does it, the message takes possession of a copy of the buffer */
+        buffer = memdup(c->blob, c->size);
+        assert_se(buffer);
+
+        assert_se(bus_message_from_malloc(b, buffer, c->size, NULL, 0, NULL, &m) >= 0);
+        assert_se(sd_bus_message_skip(m, c->signature) >= 0);
+}
+
+static int match_handler(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        unsigned *n_matched = userdata;
+
+        (*n_matched)++;
+        return 0;
+}
+
+typedef struct MatchContext {
+        sd_bus_message *signal;
+        unsigned n_matched;
+} MatchContext;
+
+static void op_match(sd_bus *b, void *userdata) {
+        MatchContext *c = userdata;
+
+        /* Do what process_match() does, callbacks are only invoked once per iteration */
+        b->iteration_counter++;
+        b->match_callbacks_modified = false;
+
+        assert_se(bus_match_run(b, &b->match_callbacks, c->signal) >= 0);
+}
+
+static void op_call(sd_bus *b, const char *path, const char *interface, const char *member,
+                    const char *reply_signature, const char *types, ...) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        va_list ap;
+
+        assert_se(sd_bus_message_new_method_call(b, &m, NULL, path, interface, member) >= 0);
+
+        if (types) {
+                va_start(ap, types);
+                assert_se(sd_bus_message_appendv(m, types, ap) >= 0);
+                va_end(ap);
+        }
+
+        assert_se(sd_bus_call(b, m, 0, NULL, &reply) >= 0);
+
+        if (reply_signature)
+                assert_se(sd_bus_message_skip(reply, reply_signature) >= 0);
+}
+
+static void op_ping(sd_bus *b, void *userdata) {
+        op_call(b, "/bench", "benchmark.Server", "Ping", NULL, NULL);
+}
+
+static void op_get_all(sd_bus *b, void *userdata) {
+        op_call(b, userdata, "org.freedesktop.DBus.Properties", "GetAll", "a{sv}", "s", "benchmark.Unit");
+}
+
+static void op_list_units(sd_bus *b, void *userdata) {
+        op_call(b, "/bench", "benchmark.Server", "ListUnits", "a(ssssssouso)", "u", (uint32_t) 1000);
+}
+
+static void op_take_fd(sd_bus *b, void *userdata) {
+        op_call(b, "/bench", "benchmark.Server", "TakeFd", NULL, "h", PTR_TO_INT(userdata));
+}
+
+static void suite_match(sd_bus *b, unsigned n) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ sd_bus_slot **slots = NULL;
+        MatchContext c = {};
+        char name[64];
+        unsigned i;
+
+        /* Half of the matches filter on members, the other half on path namespaces, only one each of them is
+         * hit by the signal */
+
+        slots = new0(sd_bus_slot*, n);
+        assert_se(slots);
+
+        for (i = 0; i < n; i++) {
+                char match[128];
+
+                if (i % 2 == 0)
+                        xsprintf(match, "type='signal',interface='benchmark.Signal',member='Signal%u'", i / 2);
+                else
+                        xsprintf(match, "type='signal',path_namespace='/bench/%u'", i / 2);
+
+                assert_se(sd_bus_add_match(b, &slots[i], match, match_handler, &c.n_matched) >= 0);
+        }
+
+        assert_se(sd_bus_message_new_signal(b, &m, "/bench/0/object", "benchmark.Signal", "Signal0") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+        c.signal = m;
+
+        xsprintf(name, "match-dispatch-%u", n);
+        suite_run(name, op_match, b, &c);
+
+        assert_se(c.n_matched > 0);
+        assert_se(c.n_matched % MIN(n, 2U) == 0);
+
+        for (i = 0; i < n; i++)
+                sd_bus_slot_unref(slots[i]);
+}
+
+static void run_suite(bool gvariant) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *b = NULL;
+        _cleanup_close_ int fd = -1;
+        SuiteServer s = {};
+        int pair[2];
+        pthread_t t;
+        Payload p;
+
+        samples = new(nsec_t, N_SAMPLES_MAX);
+        assert_se(samples);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, pair) >= 0);
+
+        s = (SuiteServer) {
+                .fd = pair[0],
+                .gvariant = gvariant,
+        };
+        assert_se(pthread_create(&t, NULL, suite_server, &s) == 0);
+
+        assert_se(sd_bus_new(&b) >= 0);
+        assert_se(sd_bus_set_fd(b, pair[1], pair[1]) >= 0);
+        assert_se(sd_bus_negotiate_gvariant(b, gvariant) >= 0);
+        assert_se(sd_bus_start(b) >= 0);
+
+        /* Wait for the connection to be established */
+        op_ping(b, NULL);
+
+        printf("NAME\tOPS/S\tP50(ns)\tP90(ns)\tP99(ns)\tMAX(ns)\tALLOCS/OP\n");
+
+        for (p = 0; p < _PAYLOAD_MAX; p++) {
+                char name[64];
+
+                xsprintf(name, "build-%s", payload_name[p]);
+                suite_run(name, op_build, b, INT_TO_PTR(p));
+        }
+
+        for (p = 0; p < _PAYLOAD_MAX; p++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                _cleanup_free_ void *blob = NULL;
+                ParseContext c;
+                char name[64];
+
+                m = payload_build(b, p);
+
+                c = (ParseContext) {
+                        .signature = payload_signature[p],
+                };
+                assert_se(bus_message_get_blob(m, &blob, &c.size) >= 0);
+                c.blob = blob;
+
+                xsprintf(name, "parse-%s", payload_name[p]);
+                suite_run(name, op_parse, b, &c);
+        }
+
+        suite_match(b, 1);
+        suite_match(b, 64);
+        suite_match(b, 1024);
+
+        suite_run("call-ping", op_ping, b, NULL);
+        suite_run("call-get-all", op_get_all, b, (void*) "/bench/unit");
+        suite_run("call-list-units-1000", op_list_units, b, NULL);
+
+        if (sd_bus_can_send(b, 'h') > 0) {
+                fd = open("/dev/null", O_RDONLY|O_CLOEXEC);
+                assert_se(fd >= 0);
+
+                suite_run("call-fd", op_take_fd, b, INT_TO_PTR(fd));
+        }
+
+        op_call(b, "/bench", "benchmark.Server", "Quit", NULL, NULL);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        samples = mfree(samples);
+}
+
 int main(int argc, char *argv[]) {
         enum {
+                MODE_SUITE,
                 MODE_BISECT,
                 MODE_CHART,
-        } mode = MODE_BISECT;
+        } mode = MODE_SUITE;
         Type type = TYPE_LEGACY;
         int i, pair[2] = { -1, -1 };
         _cleanup_free_ char *address = NULL, *server_name = NULL;
@@ -222,7 +748,13 @@ int main(int argc, char *argv[]) {
         int r;
 
         for (i = 1; i < argc; i++) {
-                if (streq(argv[i], "chart")) {
+                if (streq(argv[i], "suite")) {
+                        mode = MODE_SUITE;
+                        continue;
+                } else if (streq(argv[i], "bisect")) {
+                        mode = MODE_BISECT;
+                        continue;
+                } else if (streq(argv[i], "chart")) {
                         mode = MODE_CHART;
                         continue;
                 } else if (streq(argv[i], "legacy")) {
@@ -231,6 +763,9 @@ int main(int argc, char *argv[]) {
                 } else if (streq(argv[i], "direct")) {
                         type = TYPE_DIRECT;
                         continue;
+                } else if (streq(argv[i], "gvariant")) {
+                        type = TYPE_GVARIANT;
+                        continue;
                 }
 
                 assert_se(parse_sec(argv[i], &arg_loop_usec) >= 0);
@@ -238,6 +773,11 @@ int main(int argc, char *argv[]) {
 
         assert_se(arg_loop_usec > 0);
 
+        if (mode == MODE_SUITE) {
+                run_suite(type == TYPE_GVARIANT);
+                return 0;
+        }
+
         if (type == TYPE_LEGACY) {
                 const char *e;
 
@@ -251,7 +791,7 @@ int main(int argc, char *argv[]) {
         r = sd_bus_new(&b);
         assert_se(r >= 0);
 
-        if (type == TYPE_DIRECT) {
+        if (IN_SET(type, TYPE_DIRECT, TYPE_GVARIANT)) {
                 assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) >= 0);
 
                 r = sd_bus_set_fd(b, pair[0], pair[0]);
@@ -259,6 +799,9 @@ int main(int argc, char *argv[]) {
 
                 r = sd_bus_set_server(b, true, SD_ID128_NULL);
                 assert_se(r >= 0);
+
+                r = sd_bus_negotiate_gvariant(b, type == TYPE_GVARIANT);
+                assert_se(r >= 0);
         } else {
                 r = sd_bus_set_address(b, address);
                 assert_se(r >= 0);
@@ -270,7 +813,7 @@ int main(int argc, char *argv[]) {
         r = sd_bus_start(b);
         assert_se(r >= 0);
 
-        if (type != TYPE_DIRECT) {
+        if (type == TYPE_LEGACY) {
                 r = sd_bus_get_unique_name(b, &unique);
                 assert_se(r >= 0);
 
@@ -300,6 +843,9 @@ int main(int argc, char *argv[]) {
                 case MODE_CHART:
                         client_chart(type, address, server_name, pair[1]);
                         break;
+
+                default:
+                        assert_not_reached("Unexpected mode");
                 }
 
                 _exit(EXIT_SUCCESS);
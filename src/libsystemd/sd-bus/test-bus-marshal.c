@@ -15,6 +15,7 @@
 
 #include "alloc-util.h"
 #include "bus-dump.h"
+#include "bus-internal.h"
 #include "bus-label.h"
 #include "bus-message.h"
 #include "bus-util.h"
@@ -104,6 +105,51 @@ static void test_bus_label_escape(void) {
         test_bus_label_escape_one(":1", "_3a1");
 }
 
+static void test_bus_message_pool(sd_bus *bus) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ char *big = NULL;
+        const char *x, *y;
+        sd_bus_message *p;
+        uint32_t i;
+
+        /* A released message is reused for the next one, and nothing of its previous life shows */
+
+        assert_se(big = strrep("waldo", 1000));
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo/bar", "foo.bar", "Waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "sas", big, 2, "a", "b") >= 0);
+        assert_se(sd_bus_message_seal(m, 4711, 0) >= 0);
+        p = m;
+        m = sd_bus_message_unref(m);
+
+        assert_se(bus->n_message_pool > 0);
+
+        assert_se(sd_bus_message_new_method_call(bus, &m, "foo.quux", "/", "foo.quux", "Quux") >= 0);
+        assert_se(m == p);
+        assert_se(streq(sd_bus_message_get_member(m), "Quux"));
+        assert_se(streq(sd_bus_message_get_path(m), "/"));
+        assert_se(!sd_bus_message_get_sender(m));
+        assert_se(sd_bus_message_is_empty(m) > 0);
+        assert_se(sd_bus_message_append(m, "su", "short", 42) >= 0);
+        assert_se(sd_bus_message_seal(m, 4712, 0) >= 0);
+        assert_se(sd_bus_message_rewind(m, true) >= 0);
+        assert_se(sd_bus_message_read(m, "su", &x, &i) > 0);
+        assert_se(streq(x, "short"));
+        assert_se(i == 42);
+        assert_se(sd_bus_message_at_end(m, true) > 0);
+        m = sd_bus_message_unref(m);
+
+        /* Also with a large body this time, growing the buffers kept around */
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo/bar", "foo.bar", "Waldo") >= 0);
+        assert_se(m == p);
+        assert_se(sd_bus_message_append(m, "ss", big, "end") >= 0);
+        assert_se(sd_bus_message_seal(m, 4713, 0) >= 0);
+        assert_se(sd_bus_message_rewind(m, true) >= 0);
+        assert_se(sd_bus_message_read(m, "ss", &x, &y) > 0);
+        assert_se(streq(x, big));
+        assert_se(streq(y, "end"));
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *copy = NULL;
         int r, boolean;
@@ -411,6 +457,7 @@ int main(int argc, char *argv[]) {
         assert_se(streq(c, "ccc"));
         assert_se(streq(d, "3"));
 
+        test_bus_message_pool(bus);
         test_bus_label_escape();
         test_bus_path_encode();
         test_bus_path_encode_unique();
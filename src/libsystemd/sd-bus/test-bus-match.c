@@ -1,12 +1,16 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include "alloc-util.h"
+#include "bus-internal.h"
 #include "bus-match.h"
 #include "bus-message.h"
 #include "bus-slot.h"
 #include "bus-util.h"
 #include "log.h"
 #include "macro.h"
+#include "strv.h"
 #include "tests.h"
+#include "time-util.h"
 
 static bool mask[32];
 
@@ -58,6 +62,136 @@ static int match_add(sd_bus_slot *slots, struct bus_match_node *root, const char
         return r;
 }
 
+static void test_match_prefix_one(
+                sd_bus *bus,
+                const char *key,
+                char **patterns,
+                char **values,
+                bool (*test)(const char *pattern, const char *value)) {
+
+        char **p, **v;
+        sd_bus_slot slots[ELEMENTSOF(mask)];
+
+        log_info("/* %s(%s) */", __func__, key);
+
+        /* Compare the indexed lookup with the reference implementation for every combination */
+
+        STRV_FOREACH(v, values) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                struct bus_match_node root = {
+                        .type = BUS_MATCH_ROOT,
+                };
+                unsigned k = 0;
+
+                if (streq(key, "path_namespace") && !object_path_is_valid(*v))
+                        continue;
+
+                STRV_FOREACH(p, patterns) {
+                        _cleanup_free_ char *match = NULL;
+
+                        assert_se(k < ELEMENTSOF(slots));
+                        assert_se(match = strjoin(key, "='", *p, "'"));
+                        assert_se(match_add(slots, &root, match, k++) >= 0);
+                }
+
+                assert_se(sd_bus_message_new_signal(bus, &m, streq(key, "path_namespace") ? *v : "/", "bar.x", "waldo") >= 0);
+                assert_se(sd_bus_message_append(m, "ss", *v, *v) >= 0);
+                assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+                zero(mask);
+                assert_se(bus_match_run(NULL, &root, m) == 0);
+
+                k = 0;
+                STRV_FOREACH(p, patterns) {
+                        log_debug("%s='%s' on '%s': %s", key, *p, *v, yes_no(mask[k]));
+                        assert_se(mask[k++] == test(*p, *v));
+                }
+
+                bus_match_free(&root);
+        }
+}
+
+static void test_match_prefix(sd_bus *bus) {
+        test_match_prefix_one(bus, "path_namespace",
+                              STRV_MAKE("/", "/foo", "/foo/", "/foo/bar", "/foo/ba", "/foobar", "/quux", "/foo/bar/baz"),
+                              STRV_MAKE("/", "/foo", "/foo/bar", "/foo/bar/baz", "/foob", "/foobar", "/quux/x", "/x"),
+                              path_simple_pattern);
+        test_match_prefix_one(bus, "arg0path",
+                              STRV_MAKE("/", "/foo", "/foo/", "/foo/bar", "/foo/bar/", "/foobar", "/quux", "/foo/bar/baz"),
+                              STRV_MAKE("/", "", "/foo", "/foo/", "/foo/bar", "/foo/bar/baz", "/foob", "/quux/", "x/"),
+                              path_complex_pattern);
+        test_match_prefix_one(bus, "arg1namespace",
+                              STRV_MAKE("a", "a.b", "a.", "ab", "a.b.c", "b"),
+                              STRV_MAKE("a", "a.b", "a.b.c", "a.", "ab", "", "b.a", ".a"),
+                              namespace_simple_pattern);
+}
+
+static unsigned n_benchmark_calls = 0;
+
+static int benchmark_filter(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        n_benchmark_calls++;
+        return 0;
+}
+
+static void test_match_benchmark(sd_bus *bus) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        bool slow = slow_tests_enabled();
+        unsigned n_matches = slow ? 100000 : 5000, n_runs = slow ? 100000 : 1000, i;
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        char b1[FORMAT_TIMESPAN_MAX], b2[FORMAT_TIMESPAN_MAX];
+        usec_t ts;
+
+        log_info("/* %s (%s) */", __func__, slow ? "slow" : "fast");
+
+        /* Install many prefix matches, like a process tracking lots of objects would, and check that
+         * dispatching doesn't degrade with their number */
+
+        assert_se(slots = new0(sd_bus_slot, n_matches * 2));
+
+        for (i = 0; i < n_matches; i++) {
+                struct bus_match_component *components = NULL;
+                unsigned n_components = 0;
+                _cleanup_free_ char *match = NULL;
+                unsigned j;
+
+                for (j = 0; j < 2; j++) {
+                        if (j == 0)
+                                assert_se(asprintf(&match, "type='signal',path_namespace='/org/freedesktop/test/u%u'", i) >= 0);
+                        else
+                                assert_se(asprintf(&match, "type='signal',arg0namespace='org.freedesktop.test.u%u'", i) >= 0);
+
+                        assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+                        slots[i*2+j].match_callback.callback = benchmark_filter;
+                        assert_se(bus_match_add(&root, components, n_components, &slots[i*2+j].match_callback) >= 0);
+                        bus_match_parse_free(components, n_components);
+                        match = mfree(match);
+                }
+        }
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/org/freedesktop/test/u17/x", "bar.x", "waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "s", "org.freedesktop.test.u17.x") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+        ts = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < n_runs; i++)
+                assert_se(bus_match_run(NULL, &root, m) == 0);
+
+        ts = now(CLOCK_MONOTONIC) - ts;
+
+        assert_se(n_benchmark_calls == n_runs * 2);
+
+        log_info("%u dispatches against %u matches took %s, %s per dispatch",
+                 n_runs, n_matches * 2,
+                 format_timespan(b1, sizeof b1, ts, 1),
+                 format_timespan(b2, sizeof b2, ts / n_runs, 1));
+
+        bus_match_free(&root);
+}
+
 static void test_match_scope(const char *match, enum bus_match_scope scope) {
         struct bus_match_component *components = NULL;
         unsigned n_components = 0;
@@ -136,6 +270,9 @@ int main(int argc, char *argv[]) {
 
         bus_match_free(&root);
 
+        test_match_prefix(bus);
+        test_match_benchmark(bus);
+
         test_match_scope("interface='foobar'", BUS_MATCH_GENERIC);
         test_match_scope("", BUS_MATCH_GENERIC);
         test_match_scope("interface='org.freedesktop.DBus.Local'", BUS_MATCH_LOCAL);
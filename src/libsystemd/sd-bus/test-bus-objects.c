@@ -9,6 +9,7 @@
 #include "bus-dump.h"
 #include "bus-internal.h"
 #include "bus-message.h"
+#include "bus-objects.h"
 #include "bus-util.h"
 #include "log.h"
 #include "macro.h"
@@ -177,6 +178,35 @@ static int emit_object_removed(sd_bus_message *m, void *userdata, sd_bus_error *
         return 1;
 }
 
+static int collect_properties(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **properties = NULL;
+        sd_bus *bus = sd_bus_message_get_bus(m);
+        const char *path;
+        int r;
+
+        r = sd_bus_message_read(m, "o", &path);
+        assert_se(r > 0);
+        r = sd_bus_message_read_strv(m, &properties);
+        assert_se(r >= 0);
+
+        r = sd_bus_message_new_method_return(m, &reply);
+        assert_se(r >= 0);
+
+        r = sd_bus_message_open_container(reply, 'a', "{sv}");
+        assert_se(r >= 0);
+
+        r = bus_object_append_properties(bus, reply, path, properties, error);
+        assert_se(r >= 0);
+        if (r == 0)
+                return sd_bus_error_setf(error, SD_BUS_ERROR_UNKNOWN_OBJECT, "No object %s", path);
+
+        r = sd_bus_message_close_container(reply);
+        assert_se(r >= 0);
+
+        return sd_bus_send(bus, reply, NULL);
+}
+
 static const sd_bus_vtable vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("AlterSomething", "s", "s", something_handler, 0),
@@ -189,6 +219,7 @@ static const sd_bus_vtable vtable[] = {
         SD_BUS_METHOD("EmitInterfacesRemoved", NULL, NULL, emit_interfaces_removed, 0),
         SD_BUS_METHOD("EmitObjectAdded", NULL, NULL, emit_object_added, 0),
         SD_BUS_METHOD("EmitObjectRemoved", NULL, NULL, emit_object_removed, 0),
+        SD_BUS_METHOD("CollectProperties", "oas", "a{sv}", collect_properties, 0),
         SD_BUS_VTABLE_END
 };
 
@@ -277,6 +308,45 @@ fail:
         return INT_TO_PTR(r);
 }
 
+static void collect_properties_one(sd_bus *bus, const char *path, char **properties, char **expected) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_strv_free_ char **names = NULL;
+        const char *name;
+        int r;
+
+        assert_se(sd_bus_message_new_method_call(bus, &m, "org.freedesktop.systemd.test", "/foo", "org.freedesktop.systemd.test", "CollectProperties") >= 0);
+        assert_se(sd_bus_message_append(m, "o", path) >= 0);
+        assert_se(sd_bus_message_append_strv(m, properties) >= 0);
+
+        r = sd_bus_call(bus, m, 0, &error, &reply);
+        if (!expected) {
+                assert_se(r < 0);
+                assert_se(sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_OBJECT));
+                return;
+        }
+        assert_se(r >= 0);
+
+        assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") > 0);
+        while ((r = sd_bus_message_enter_container(reply, 'e', "sv")) > 0) {
+                assert_se(sd_bus_message_read(reply, "s", &name) > 0);
+                assert_se(strv_extend(&names, name) >= 0);
+                assert_se(sd_bus_message_skip(reply, "v") > 0);
+                assert_se(sd_bus_message_exit_container(reply) > 0);
+        }
+        assert_se(r == 0);
+        assert_se(sd_bus_message_exit_container(reply) > 0);
+
+        assert_se(strv_equal(strv_sort(names), expected));
+}
+
+static void test_collect_properties(sd_bus *bus) {
+        collect_properties_one(bus, "/value/a", NULL, STRV_MAKE("Value", "Value2", "Value3", "Value4"));
+        collect_properties_one(bus, "/value/a", STRV_MAKE("Value4", "Value", "Nope"), STRV_MAKE("Value", "Value4"));
+        collect_properties_one(bus, "/foo", STRV_MAKE("AutomaticIntegerProperty"), STRV_MAKE("AutomaticIntegerProperty", "AutomaticIntegerProperty"));
+        collect_properties_one(bus, "/nope", NULL, NULL);
+}
+
 static int client(struct context *c) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
@@ -404,6 +474,8 @@ static int client(struct context *c) {
         sd_bus_message_unref(reply);
         reply = NULL;
 
+        test_collect_properties(bus);
+
         r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/value/a", "org.freedesktop.DBus.Properties", "GetAll", &error, &reply, "s", "org.freedesktop.systemd.ValueTest2");
         assert_se(r < 0);
         assert_se(sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_INTERFACE));
@@ -6,6 +6,7 @@
 #include "sd-bus.h"
 
 #include "bus-internal.h"
+#include "bus-message.h"
 #include "bus-util.h"
 #include "log.h"
 #include "macro.h"
@@ -19,13 +20,23 @@ struct context {
 
         bool client_anonymous_auth;
         bool server_anonymous_auth;
+
+        bool client_negotiate_memfd;
+        bool server_negotiate_memfd;
+
+        bool client_negotiate_gvariant;
+        bool server_negotiate_gvariant;
 };
 
+#define ECHO_SIZE (1024U*1024U)
+#define N_PINGS 256U
+
 static void *server(void *p) {
         struct context *c = p;
         sd_bus *bus = NULL;
         sd_id128_t id;
         bool quit = false;
+        unsigned n_pings = 0;
         int r;
 
         assert_se(sd_id128_randomize(&id) >= 0);
@@ -35,6 +46,8 @@ static void *server(void *p) {
         assert_se(sd_bus_set_server(bus, 1, id) >= 0);
         assert_se(sd_bus_set_anonymous(bus, c->server_anonymous_auth) >= 0);
         assert_se(sd_bus_negotiate_fds(bus, c->server_negotiate_unix_fds) >= 0);
+        assert_se(sd_bus_negotiate_memfd(bus, c->server_negotiate_memfd) >= 0);
+        assert_se(sd_bus_negotiate_gvariant(bus, c->server_negotiate_gvariant) >= 0);
         assert_se(sd_bus_start(bus) >= 0);
 
         while (!quit) {
@@ -65,6 +78,12 @@ static void *server(void *p) {
 
                         assert_se((sd_bus_can_send(bus, 'h') >= 1) ==
                                   (c->server_negotiate_unix_fds && c->client_negotiate_unix_fds));
+                        assert_se(bus->can_memfd ==
+                                  (c->server_negotiate_unix_fds && c->client_negotiate_unix_fds &&
+                                   c->server_negotiate_memfd && c->client_negotiate_memfd));
+                        assert_se(BUS_MESSAGE_IS_GVARIANT(m) ==
+                                  (c->server_negotiate_gvariant && c->client_negotiate_gvariant));
+                        assert_se(n_pings == N_PINGS);
 
                         r = sd_bus_message_new_method_return(m, &reply);
                         if (r < 0) {
@@ -74,6 +93,54 @@ static void *server(void *p) {
 
                         quit = true;
 
+                } else if (sd_bus_message_is_method_call(m, "org.freedesktop.systemd.test", "Ping")) {
+                        uint32_t i;
+
+                        r = sd_bus_message_read(m, "u", &i);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to read ping: %m");
+                                goto fail;
+                        }
+
+                        assert_se(i == n_pings);
+
+                        /* Every third ping carries an fd, if we can */
+                        if (i % 3 == 0 && sd_bus_can_send(bus, 'h') > 0) {
+                                int fd;
+
+                                r = sd_bus_message_read(m, "h", &fd);
+                                if (r < 0) {
+                                        log_error_errno(r, "Failed to read fd: %m");
+                                        goto fail;
+                                }
+
+                                assert_se(fd >= 0);
+                        }
+
+                        n_pings++;
+
+                } else if (sd_bus_message_is_method_call(m, "org.freedesktop.systemd.test", "Echo")) {
+                        const void *d;
+                        size_t sz;
+
+                        r = sd_bus_message_read_array(m, 'y', &d, &sz);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to read array: %m");
+                                goto fail;
+                        }
+
+                        r = sd_bus_message_new_method_return(m, &reply);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to allocate return: %m");
+                                goto fail;
+                        }
+
+                        r = sd_bus_message_append_array(reply, 'y', d, sz);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to append array: %m");
+                                goto fail;
+                        }
+
                 } else if (sd_bus_message_is_method_call(m, NULL, NULL)) {
                         r = sd_bus_message_new_method_error(
                                         m,
@@ -105,18 +172,110 @@ fail:
         return INT_TO_PTR(r);
 }
 
+static int client_echo(sd_bus *bus) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ uint8_t *buf = NULL;
+        const void *d;
+        size_t i, sz;
+        int r;
+
+        /* Large enough to be passed in a memfd, if that was negotiated */
+        buf = new(uint8_t, ECHO_SIZE);
+        assert_se(buf);
+        for (i = 0; i < ECHO_SIZE; i++)
+                buf[i] = (uint8_t) (i * 7);
+
+        r = sd_bus_message_new_method_call(
+                        bus,
+                        &m,
+                        "org.freedesktop.systemd.test",
+                        "/",
+                        "org.freedesktop.systemd.test",
+                        "Echo");
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate method call: %m");
+
+        r = sd_bus_message_append_array(m, 'y', buf, ECHO_SIZE);
+        if (r < 0)
+                return log_error_errno(r, "Failed to append array: %m");
+
+        r = sd_bus_call(bus, m, 0, &error, &reply);
+        if (r < 0)
+                return log_error_errno(r, "Failed to issue method call: %s", bus_error_message(&error, -r));
+
+        r = sd_bus_message_read_array(reply, 'y', &d, &sz);
+        if (r < 0)
+                return log_error_errno(r, "Failed to read array: %m");
+
+        assert_se(sz == ECHO_SIZE);
+        assert_se(memcmp(d, buf, ECHO_SIZE) == 0);
+
+        return 0;
+}
+
+static int client_ping(sd_bus *bus) {
+        uint32_t i;
+        int r;
+
+        /* Queue many small messages at once, so that the server reads them in batches */
+        for (i = 0; i < N_PINGS; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                r = sd_bus_message_new_method_call(
+                                bus,
+                                &m,
+                                "org.freedesktop.systemd.test",
+                                "/",
+                                "org.freedesktop.systemd.test",
+                                "Ping");
+                if (r < 0)
+                        return log_error_errno(r, "Failed to allocate method call: %m");
+
+                r = sd_bus_message_set_expect_reply(m, false);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to turn off reply: %m");
+
+                r = sd_bus_message_append(m, "u", i);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to append ping: %m");
+
+                if (i % 3 == 0 && sd_bus_can_send(bus, 'h') > 0) {
+                        r = sd_bus_message_append(m, "h", STDERR_FILENO);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to append fd: %m");
+                }
+
+                r = sd_bus_send(bus, m, NULL);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to send ping: %m");
+        }
+
+        return 0;
+}
+
 static int client(struct context *c) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
-        _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         sd_bus_error error = SD_BUS_ERROR_NULL;
         int r;
 
         assert_se(sd_bus_new(&bus) >= 0);
         assert_se(sd_bus_set_fd(bus, c->fds[1], c->fds[1]) >= 0);
         assert_se(sd_bus_negotiate_fds(bus, c->client_negotiate_unix_fds) >= 0);
+        assert_se(sd_bus_negotiate_memfd(bus, c->client_negotiate_memfd) >= 0);
+        assert_se(sd_bus_negotiate_gvariant(bus, c->client_negotiate_gvariant) >= 0);
         assert_se(sd_bus_set_anonymous(bus, c->client_anonymous_auth) >= 0);
         assert_se(sd_bus_start(bus) >= 0);
 
+        r = client_ping(bus);
+        if (r < 0)
+                return r;
+
+        r = client_echo(bus);
+        if (r < 0)
+                return r;
+
         r = sd_bus_message_new_method_call(
                         bus,
                         &m,
@@ -135,7 +294,9 @@ static int client(struct context *c) {
 }
 
 static int test_one(bool client_negotiate_unix_fds, bool server_negotiate_unix_fds,
-                    bool client_anonymous_auth, bool server_anonymous_auth) {
+                    bool client_anonymous_auth, bool server_anonymous_auth,
+                    bool client_negotiate_memfd, bool server_negotiate_memfd,
+                    bool client_negotiate_gvariant, bool server_negotiate_gvariant) {
 
         struct context c;
         pthread_t s;
@@ -150,6 +311,10 @@ static int test_one(bool client_negotiate_unix_fds, bool server_negotiate_unix_f
         c.server_negotiate_unix_fds = server_negotiate_unix_fds;
         c.client_anonymous_auth = client_anonymous_auth;
         c.server_anonymous_auth = server_anonymous_auth;
+        c.client_negotiate_memfd = client_negotiate_memfd;
+        c.server_negotiate_memfd = server_negotiate_memfd;
+        c.client_negotiate_gvariant = client_negotiate_gvariant;
+        c.server_negotiate_gvariant = server_negotiate_gvariant;
 
         r = pthread_create(&s, NULL, server, &c);
         if (r != 0)
@@ -173,26 +338,53 @@ static int test_one(bool client_negotiate_unix_fds, bool server_negotiate_unix_f
 int main(int argc, char *argv[]) {
         int r;
 
-        r = test_one(true, true, false, false);
+        r = test_one(true, true, false, false, false, false, false, false);
         assert_se(r >= 0);
 
-        r = test_one(true, false, false, false);
+        r = test_one(true, false, false, false, false, false, false, false);
         assert_se(r >= 0);
 
-        r = test_one(false, true, false, false);
+        r = test_one(false, true, false, false, false, false, false, false);
         assert_se(r >= 0);
 
-        r = test_one(false, false, false, false);
+        r = test_one(false, false, false, false, false, false, false, false);
         assert_se(r >= 0);
 
-        r = test_one(true, true, true, true);
+        r = test_one(true, true, true, true, false, false, false, false);
         assert_se(r >= 0);
 
-        r = test_one(true, true, false, true);
+        r = test_one(true, true, false, true, false, false, false, false);
         assert_se(r >= 0);
 
-        r = test_one(true, true, true, false);
+        r = test_one(true, true, true, false, false, false, false, false);
         assert_se(r == -EPERM);
 
+        r = test_one(true, true, false, false, true, true, false, false);
+        assert_se(r >= 0);
+
+        r = test_one(true, true, false, false, true, false, false, false);
+        assert_se(r >= 0);
+
+        r = test_one(true, true, false, false, false, true, false, false);
+        assert_se(r >= 0);
+
+        r = test_one(false, true, false, false, true, true, false, false);
+        assert_se(r >= 0);
+
+        r = test_one(true, true, false, false, false, false, true, true);
+        assert_se(r >= 0);
+
+        r = test_one(true, true, false, false, false, false, true, false);
+        assert_se(r >= 0);
+
+        r = test_one(true, true, false, false, false, false, false, true);
+        assert_se(r >= 0);
+
+        r = test_one(false, false, true, true, false, false, true, true);
+        assert_se(r >= 0);
+
+        r = test_one(true, true, false, false, true, true, true, true);
+        assert_se(r >= 0);
+
         return EXIT_SUCCESS;
 }
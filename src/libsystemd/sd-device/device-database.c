@@ -0,0 +1,642 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "device-database.h"
+#include "dirent-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "hashmap.h"
+#include "path-util.h"
+#include "set.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tmpfile-util.h"
+
+#define DEVICE_DATABASE_RECORD_MAGIC UINT32_C(0x31424455) /* "UDB1" */
+
+typedef enum DeviceDatabaseRecordFlags {
+        DEVICE_DATABASE_RECORD_REMOVED = 1 << 0,
+} DeviceDatabaseRecordFlags;
+
+/* The file is a plain sequence of these, each padded to a multiple of 8 bytes. It lives in /run only, hence
+ * host byte order is fine. */
+typedef struct DeviceDatabaseRecord {
+        uint32_t magic;
+        uint32_t size;          /* of the whole record, including the padding */
+        uint32_t flags;
+        uint32_t id_len;        /* including the trailing NUL */
+        uint32_t tags_len;      /* NUL terminated tags, one after the other */
+        uint32_t data_len;      /* the database entry, in the same format as the files in /run/udev/data/ */
+        char payload[];
+} DeviceDatabaseRecord;
+
+#define RECORD_FOREACH_TAG(tag, rec)                                                    \
+        for ((tag) = (rec)->payload + (rec)->id_len;                                    \
+             (tag) < (rec)->payload + (rec)->id_len + (rec)->tags_len;                  \
+             (tag) += strlen(tag) + 1)
+
+struct DeviceDatabase {
+        char *path;
+        int fd;
+        dev_t st_dev;
+        ino_t st_ino;
+
+        void *map;
+        size_t map_size;
+        size_t parsed;          /* records up to this offset are indexed */
+
+        Hashmap *records;       /* id → offset + 1 of the latest record of the device */
+        Hashmap *tags;          /* tag → Set of ids (the keys of 'records') */
+};
+
+static thread_local DeviceDatabase *default_database = NULL;
+
+static const DeviceDatabaseRecord *record_at(DeviceDatabase *db, size_t offset) {
+        const DeviceDatabaseRecord *rec;
+
+        assert(db);
+
+        if (offset > db->map_size || db->map_size - offset < sizeof(DeviceDatabaseRecord))
+                return NULL;
+
+        rec = (const DeviceDatabaseRecord*) ((const uint8_t*) db->map + offset);
+
+        /* A record which is not complete yet is just being appended, we'll pick it up next time */
+        if (rec->magic != DEVICE_DATABASE_RECORD_MAGIC ||
+            rec->size < sizeof(DeviceDatabaseRecord) ||
+            rec->size % 8 != 0 ||
+            rec->size > db->map_size - offset)
+                return NULL;
+
+        if (rec->id_len == 0 ||
+            (uint64_t) rec->id_len + rec->tags_len + rec->data_len > rec->size - sizeof(DeviceDatabaseRecord))
+                return NULL;
+
+        if (rec->payload[rec->id_len - 1] != '\0')
+                return NULL;
+
+        if (rec->tags_len > 0 && rec->payload[rec->id_len + rec->tags_len - 1] != '\0')
+                return NULL;
+
+        return rec;
+}
+
+static int record_new(
+                const char *id,
+                char **tags,
+                const char *data,
+                size_t data_len,
+                DeviceDatabaseRecordFlags flags,
+                DeviceDatabaseRecord **ret,
+                size_t *ret_size) {
+
+        DeviceDatabaseRecord *rec;
+        size_t id_len, tags_len = 0, size;
+        char **t, *p;
+
+        assert(id);
+        assert(data || data_len == 0);
+        assert(ret);
+        assert(ret_size);
+
+        id_len = strlen(id) + 1;
+        STRV_FOREACH(t, tags)
+                tags_len += strlen(*t) + 1;
+
+        size = ALIGN_TO(offsetof(DeviceDatabaseRecord, payload) + id_len + tags_len + data_len, 8);
+        if (size > UINT32_MAX)
+                return -E2BIG;
+
+        rec = malloc0(size);
+        if (!rec)
+                return -ENOMEM;
+
+        *rec = (DeviceDatabaseRecord) {
+                .magic = DEVICE_DATABASE_RECORD_MAGIC,
+                .size = size,
+                .flags = flags,
+                .id_len = id_len,
+                .tags_len = tags_len,
+                .data_len = data_len,
+        };
+
+        p = mempcpy(rec->payload, id, id_len);
+        STRV_FOREACH(t, tags)
+                p = mempcpy(p, *t, strlen(*t) + 1);
+        memcpy_safe(p, data, data_len);
+
+        *ret = rec;
+        *ret_size = size;
+        return 0;
+}
+
+static int database_index_record(DeviceDatabase *db, const DeviceDatabaseRecord *rec, size_t offset) {
+        const char *tag;
+        char *id = NULL;
+        void *v;
+        int r;
+
+        assert(db);
+        assert(rec);
+
+        v = hashmap_get2(db->records, rec->payload, (void**) &id);
+        if (id) {
+                const DeviceDatabaseRecord *old;
+
+                /* The device's previous record is superseded, drop it from the tag index */
+                old = record_at(db, PTR_TO_UINT(v) - 1);
+                if (old)
+                        RECORD_FOREACH_TAG(tag, old)
+                                (void) set_remove(hashmap_get(db->tags, tag), id);
+
+                r = hashmap_update(db->records, id, UINT_TO_PTR(offset + 1));
+                if (r < 0)
+                        return r;
+        } else {
+                _cleanup_free_ char *copy = NULL;
+
+                r = hashmap_ensure_allocated(&db->records, &string_hash_ops);
+                if (r < 0)
+                        return r;
+
+                copy = strdup(rec->payload);
+                if (!copy)
+                        return -ENOMEM;
+
+                r = hashmap_put(db->records, copy, UINT_TO_PTR(offset + 1));
+                if (r < 0)
+                        return r;
+
+                id = TAKE_PTR(copy);
+        }
+
+        if (rec->flags & DEVICE_DATABASE_RECORD_REMOVED)
+                return 0;
+
+        RECORD_FOREACH_TAG(tag, rec) {
+                Set *s;
+
+                s = hashmap_get(db->tags, tag);
+                if (!s) {
+                        _cleanup_free_ char *copy = NULL;
+
+                        r = hashmap_ensure_allocated(&db->tags, &string_hash_ops);
+                        if (r < 0)
+                                return r;
+
+                        copy = strdup(tag);
+                        if (!copy)
+                                return -ENOMEM;
+
+                        s = set_new(NULL);
+                        if (!s)
+                                return -ENOMEM;
+
+                        r = hashmap_put(db->tags, copy, s);
+                        if (r < 0) {
+                                set_free(s);
+                                return r;
+                        }
+
+                        TAKE_PTR(copy);
+                }
+
+                r = set_put(s, id);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int database_map_and_index(DeviceDatabase *db, uint64_t size) {
+        const DeviceDatabaseRecord *rec;
+        int r;
+
+        assert(db);
+
+        if (size > db->map_size) {
+                void *p;
+
+                /* offsets are stored as unsigned */
+                if (size >= UINT_MAX)
+                        return -EFBIG;
+
+                p = mmap(NULL, size, PROT_READ, MAP_SHARED, db->fd, 0);
+                if (p == MAP_FAILED)
+                        return -errno;
+
+                if (db->map)
+                        (void) munmap(db->map, db->map_size);
+
+                db->map = p;
+                db->map_size = size;
+        }
+
+        while ((rec = record_at(db, db->parsed))) {
+                r = database_index_record(db, rec, db->parsed);
+                if (r < 0)
+                        return r;
+
+                db->parsed += rec->size;
+        }
+
+        return 0;
+}
+
+static void database_reset(DeviceDatabase *db) {
+        char *key;
+        Set *s;
+
+        assert(db);
+
+        while ((s = hashmap_steal_first_key_and_value(db->tags, (void**) &key))) {
+                set_free(s);
+                free(key);
+        }
+        db->tags = hashmap_free(db->tags);
+        db->records = hashmap_free_free_key(db->records);
+
+        if (db->map)
+                (void) munmap(db->map, db->map_size);
+        db->map = NULL;
+        db->map_size = db->parsed = 0;
+
+        db->fd = safe_close(db->fd);
+}
+
+static int database_load(DeviceDatabase *db) {
+        struct stat st;
+
+        assert(db);
+        assert(db->fd < 0);
+
+        db->fd = open(db->path, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (db->fd < 0)
+                return -errno;
+
+        if (fstat(db->fd, &st) < 0)
+                return -errno;
+
+        db->st_dev = st.st_dev;
+        db->st_ino = st.st_ino;
+
+        return database_map_and_index(db, st.st_size);
+}
+
+int device_database_open(const char *path, DeviceDatabase **ret) {
+        _cleanup_(device_database_freep) DeviceDatabase *db = NULL;
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        db = new(DeviceDatabase, 1);
+        if (!db)
+                return -ENOMEM;
+
+        *db = (DeviceDatabase) {
+                .fd = -1,
+        };
+
+        db->path = strdup(path);
+        if (!db->path)
+                return -ENOMEM;
+
+        r = database_load(db);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(db);
+        return 0;
+}
+
+DeviceDatabase *device_database_free(DeviceDatabase *db) {
+        if (!db)
+                return NULL;
+
+        database_reset(db);
+        free(db->path);
+
+        return mfree(db);
+}
+
+int device_database_refresh(DeviceDatabase *db) {
+        struct stat st;
+
+        assert(db);
+
+        if (stat(db->path, &st) < 0)
+                return -errno;
+
+        if (st.st_dev != db->st_dev || st.st_ino != db->st_ino) {
+                /* Replaced by a compacted or newly imported version, start over */
+                database_reset(db);
+                return database_load(db);
+        }
+
+        return database_map_and_index(db, st.st_size);
+}
+
+int device_database_lookup(DeviceDatabase *db, const char *id, const char **ret_data, size_t *ret_len) {
+        const DeviceDatabaseRecord *rec;
+        void *v;
+
+        assert(db);
+        assert(id);
+        assert(ret_data);
+        assert(ret_len);
+
+        v = hashmap_get(db->records, id);
+        if (!v)
+                return -ENXIO;
+
+        rec = record_at(db, PTR_TO_UINT(v) - 1);
+        if (!rec)
+                return -EBADMSG;
+
+        if (rec->flags & DEVICE_DATABASE_RECORD_REMOVED)
+                return -ENOENT;
+
+        *ret_data = rec->payload + rec->id_len + rec->tags_len;
+        *ret_len = rec->data_len;
+        return 0;
+}
+
+int device_database_get_tagged(DeviceDatabase *db, const char *tag, char ***ret) {
+        _cleanup_strv_free_ char **l = NULL;
+        const char *id;
+        Iterator i;
+        int r;
+
+        assert(db);
+        assert(tag);
+        assert(ret);
+
+        /* Return a copy, looking up the devices may well refresh the index */
+        SET_FOREACH(id, hashmap_get(db->tags, tag), i) {
+                r = strv_extend(&l, id);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(l);
+        return 0;
+}
+
+int device_database_get_default(DeviceDatabase **ret) {
+        int r;
+
+        assert(ret);
+
+        if (default_database) {
+                r = device_database_refresh(default_database);
+                if (r < 0) {
+                        default_database = device_database_free(default_database);
+                        return r;
+                }
+        } else {
+                r = device_database_open(DEVICE_DATABASE_PATH, &default_database);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = default_database;
+        return 0;
+}
+
+int device_database_append(const char *path, const char *id, char **tags, const char *data, size_t data_len, bool removed) {
+        _cleanup_free_ DeviceDatabaseRecord *rec = NULL;
+        unsigned attempt;
+        size_t size;
+        int r;
+
+        assert(path);
+        assert(id);
+
+        r = record_new(id, removed ? NULL : tags, data, removed ? 0 : data_len,
+                       removed ? DEVICE_DATABASE_RECORD_REMOVED : 0, &rec, &size);
+        if (r < 0)
+                return r;
+
+        for (attempt = 0; attempt < 3; attempt++) {
+                _cleanup_close_ int fd = -1;
+                struct stat st;
+                ssize_t n;
+
+                /* Never create the file here, only udevd does that when it imports the per-device files. If it
+                 * does not exist, nobody reads it either. */
+                fd = open(path, O_WRONLY|O_APPEND|O_CLOEXEC|O_NOCTTY);
+                if (fd < 0)
+                        return -errno;
+
+                /* Appenders share the lock, compaction takes it exclusively */
+                if (flock(fd, LOCK_SH) < 0)
+                        return -errno;
+
+                if (fstat(fd, &st) < 0)
+                        return -errno;
+
+                if (st.st_nlink == 0)
+                        /* Replaced while we waited for the lock, try again with the new file */
+                        continue;
+
+                /* A single write, so that readers never see records of different writers interleaved */
+                n = write(fd, rec, size);
+                if (n < 0)
+                        return -errno;
+                if ((size_t) n != size)
+                        return -EIO;
+
+                return 0;
+        }
+
+        return -ESTALE;
+}
+
+static int data_get_tags(const char *data, char ***ret) {
+        _cleanup_strv_free_ char **tags = NULL;
+        const char *p, *e;
+        int r;
+
+        assert(data);
+        assert(ret);
+
+        for (p = data; *p; p = e + 1) {
+                e = strchrnul(p, '\n');
+
+                if (startswith(p, "G:") && e > p + 2) {
+                        char *t;
+
+                        t = strndup(p + 2, e - p - 2);
+                        if (!t)
+                                return -ENOMEM;
+
+                        r = strv_consume(&tags, t);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (*e == '\0')
+                        break;
+        }
+
+        *ret = TAKE_PTR(tags);
+        return 0;
+}
+
+int device_database_import(const char *path, const char *data_dir) {
+        _cleanup_free_ char *path_tmp = NULL;
+        _cleanup_closedir_ DIR *dir = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        struct dirent *de;
+        int r;
+
+        assert(path);
+        assert(data_dir);
+
+        r = fopen_temporary(path, &f, &path_tmp);
+        if (r < 0)
+                return r;
+
+        if (fchmod(fileno(f), 0644) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        dir = opendir(data_dir);
+        if (!dir && errno != ENOENT) {
+                r = -errno;
+                goto fail;
+        }
+
+        if (dir) {
+                FOREACH_DIRENT(de, dir, r = -errno; goto fail) {
+                        _cleanup_free_ DeviceDatabaseRecord *rec = NULL;
+                        _cleanup_strv_free_ char **tags = NULL;
+                        _cleanup_free_ char *data = NULL, *p = NULL;
+                        size_t data_len, size;
+
+                        if (!IN_SET(de->d_type, DT_REG, DT_UNKNOWN))
+                                continue;
+
+                        p = path_join(data_dir, de->d_name);
+                        if (!p) {
+                                r = -ENOMEM;
+                                goto fail;
+                        }
+
+                        r = read_full_file(p, &data, &data_len);
+                        if (r == -ENOENT)
+                                continue;
+                        if (r < 0)
+                                goto fail;
+
+                        r = data_get_tags(data, &tags);
+                        if (r < 0)
+                                goto fail;
+
+                        r = record_new(de->d_name, tags, data, data_len, 0, &rec, &size);
+                        if (r < 0)
+                                goto fail;
+
+                        if (fwrite(rec, size, 1, f) != 1) {
+                                r = -EIO;
+                                goto fail;
+                        }
+                }
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(path_tmp, path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(path_tmp);
+        return r;
+}
+
+int device_database_compact(const char *path, uint64_t *ret_size) {
+        _cleanup_(device_database_freep) DeviceDatabase *db = NULL;
+        _cleanup_free_ char *path_tmp = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        struct stat st;
+        Iterator i;
+        void *v;
+        int r;
+
+        assert(path);
+
+        r = device_database_open(path, &db);
+        if (r < 0)
+                return r;
+
+        /* Keep appenders out until the new file is in place. They notice the old one is gone when they get
+         * the lock, and append to the new one. */
+        if (flock(db->fd, LOCK_EX) < 0)
+                return -errno;
+
+        r = device_database_refresh(db);
+        if (r < 0)
+                return r;
+
+        r = fopen_temporary(path, &f, &path_tmp);
+        if (r < 0)
+                return r;
+
+        if (fchmod(fileno(f), 0644) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        HASHMAP_FOREACH(v, db->records, i) {
+                const DeviceDatabaseRecord *rec;
+
+                rec = record_at(db, PTR_TO_UINT(v) - 1);
+                if (!rec || (rec->flags & DEVICE_DATABASE_RECORD_REMOVED))
+                        continue;
+
+                if (fwrite(rec, rec->size, 1, f) != 1) {
+                        r = -EIO;
+                        goto fail;
+                }
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (fstat(fileno(f), &st) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        if (rename(path_tmp, path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        if (ret_size)
+                *ret_size = st.st_size;
+
+        return 0;
+
+fail:
+        (void) unlink(path_tmp);
+        return r;
+}
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "macro.h"
+
+/* All entries of the udev database in a single file. Records are only ever appended to it, the latest record
+ * of a device wins. Readers map the file and index it by device id and by tag, and pick up records appended
+ * later on the next lookup. The per-device files in /run/udev/data/ and /run/udev/tags/ are still written as
+ * before, but only udevd creates this file, by importing those, hence when it exists it is complete. */
+#define DEVICE_DATABASE_PATH "/run/udev/database"
+
+typedef struct DeviceDatabase DeviceDatabase;
+
+int device_database_open(const char *path, DeviceDatabase **ret);
+DeviceDatabase *device_database_free(DeviceDatabase *db);
+DEFINE_TRIVIAL_CLEANUP_FUNC(DeviceDatabase*, device_database_free);
+
+int device_database_refresh(DeviceDatabase *db);
+int device_database_lookup(DeviceDatabase *db, const char *id, const char **ret_data, size_t *ret_len);
+int device_database_get_tagged(DeviceDatabase *db, const char *tag, char ***ret);
+
+int device_database_get_default(DeviceDatabase **ret);
+
+int device_database_append(const char *path, const char *id, char **tags, const char *data, size_t data_len, bool removed);
+int device_database_import(const char *path, const char *data_dir);
+int device_database_compact(const char *path, uint64_t *ret_size);
@@ -3,10 +3,13 @@
 #include "sd-device.h"
 
 #include "alloc-util.h"
+#include "device-database.h"
 #include "device-enumerator-private.h"
 #include "device-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
+#include "glob-util.h"
+#include "path-util.h"
 #include "set.h"
 #include "string-util.h"
 #include "strv.h"
@@ -434,6 +437,74 @@ static bool match_sysname(sd_device_enumerator *enumerator, const char *sysname)
         return false;
 }
 
+/* Returns true if the matches in the set name exactly the entries we are interested in, so that we may look them up
+ * directly instead of reading the whole directory and matching each entry against them. Directories like
+ * /sys/class/block may have tens of thousands of entries. */
+static bool set_is_exact_names(Set *s) {
+        const char *name;
+        Iterator i;
+
+        if (set_isempty(s))
+                return false;
+
+        SET_FOREACH(name, s, i)
+                if (string_is_glob(name) || !filename_is_valid(name) || name[0] == '.')
+                        return false;
+
+        return true;
+}
+
+static int enumerator_add_device_by_syspath(sd_device_enumerator *enumerator, const char *syspath) {
+        _cleanup_(sd_device_unrefp) sd_device *device = NULL;
+        int r;
+
+        assert(enumerator);
+        assert(syspath);
+
+        r = sd_device_new_from_syspath(&device, syspath);
+        if (r == -ENODEV) /* this is necessarily racey, so ignore missing devices */
+                return 0;
+        if (r < 0)
+                return r;
+
+        /* Check the cheap matches first, the ones below need the uevent file or the udev database */
+        if (!match_parent(enumerator, device))
+                return 0;
+
+        /*
+         * All devices with a device node or network interfaces
+         * possibly need udev to adjust the device node permission
+         * or context, or rename the interface before it can be
+         * reliably used from other processes.
+         *
+         * For now, we can only check these types of devices, we
+         * might not store a database, and have no way to find out
+         * for all other types of devices.
+         */
+        if (!enumerator->match_allow_uninitialized &&
+            (sd_device_get_devnum(device, NULL) >= 0 ||
+             sd_device_get_ifindex(device, NULL) >= 0)) {
+                /* Only read the udev database here if we need to know. Otherwise the matches
+                 * below load it on demand, and only for the devices they look at. */
+                r = sd_device_get_is_initialized(device);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return 0;
+        }
+
+        if (!match_tag(enumerator, device))
+                return 0;
+
+        if (!match_property(enumerator, device))
+                return 0;
+
+        if (!match_sysattr(enumerator, device))
+                return 0;
+
+        return device_enumerator_add_device(enumerator, device);
+}
+
 static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator, const char *basedir, const char *subdir1, const char *subdir2) {
         _cleanup_closedir_ DIR *dir = NULL;
         char *path;
@@ -451,14 +522,28 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
         if (subdir2)
                 path = strjoina(path, subdir2, "/");
 
+        if (set_is_exact_names(enumerator->match_sysname)) {
+                const char *sysname;
+                Iterator i;
+
+                SET_FOREACH(sysname, enumerator->match_sysname, i) {
+                        int k;
+
+                        k = enumerator_add_device_by_syspath(enumerator, strjoina(path, sysname));
+                        if (k < 0)
+                                r = k;
+                }
+
+                return r;
+        }
+
         dir = opendir(path);
         if (!dir)
                 return -errno;
 
         FOREACH_DIRENT_ALL(dent, dir, return -errno) {
-                _cleanup_(sd_device_unrefp) sd_device *device = NULL;
                 char syspath[strlen(path) + 1 + strlen(dent->d_name) + 1];
-                int initialized, k;
+                int k;
 
                 if (dent->d_name[0] == '.')
                         continue;
@@ -468,50 +553,7 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
 
                 (void) sprintf(syspath, "%s%s", path, dent->d_name);
 
-                k = sd_device_new_from_syspath(&device, syspath);
-                if (k < 0) {
-                        if (k != -ENODEV)
-                                /* this is necessarily racey, so ignore missing devices */
-                                r = k;
-
-                        continue;
-                }
-
-                initialized = sd_device_get_is_initialized(device);
-                if (initialized < 0) {
-                        r = initialized;
-                        continue;
-                }
-
-                /*
-                 * All devices with a device node or network interfaces
-                 * possibly need udev to adjust the device node permission
-                 * or context, or rename the interface before it can be
-                 * reliably used from other processes.
-                 *
-                 * For now, we can only check these types of devices, we
-                 * might not store a database, and have no way to find out
-                 * for all other types of devices.
-                 */
-                if (!enumerator->match_allow_uninitialized &&
-                    !initialized &&
-                    (sd_device_get_devnum(device, NULL) >= 0 ||
-                     sd_device_get_ifindex(device, NULL) >= 0))
-                        continue;
-
-                if (!match_parent(enumerator, device))
-                        continue;
-
-                if (!match_tag(enumerator, device))
-                        continue;
-
-                if (!match_property(enumerator, device))
-                        continue;
-
-                if (!match_sysattr(enumerator, device))
-                        continue;
-
-                k = device_enumerator_add_device(enumerator, device);
+                k = enumerator_add_device_by_syspath(enumerator, syspath);
                 if (k < 0)
                         r = k;
         }
@@ -550,6 +592,26 @@ static int enumerator_scan_dir(sd_device_enumerator *enumerator, const char *bas
 
         path = strjoina("/sys/", basedir);
 
+        if (!subsystem && set_is_exact_names(enumerator->match_subsystem)) {
+                const char *name;
+                Iterator i;
+
+                log_debug("sd-device-enumerator: Scanning requested subsystems in %s", path);
+
+                SET_FOREACH(name, enumerator->match_subsystem, i) {
+                        int k;
+
+                        if (!match_subsystem(enumerator, name))
+                                continue;
+
+                        k = enumerator_scan_dir_and_add_devices(enumerator, basedir, name, subdir);
+                        if (k < 0 && k != -ENOENT) /* Not every subsystem is both a bus and a class */
+                                r = k;
+                }
+
+                return r;
+        }
+
         dir = opendir(path);
         if (!dir)
                 return -errno;
@@ -573,15 +635,75 @@ static int enumerator_scan_dir(sd_device_enumerator *enumerator, const char *bas
         return r;
 }
 
+static int enumerator_add_tagged_device(sd_device_enumerator *enumerator, const char *id) {
+        _cleanup_(sd_device_unrefp) sd_device *device = NULL;
+        const char *subsystem, *sysname;
+        int r;
+
+        assert(enumerator);
+        assert(id);
+
+        r = sd_device_new_from_device_id(&device, id);
+        if (r == -ENODEV)
+                /* this is necessarily racy, so ignore missing devices */
+                return 0;
+        if (r < 0)
+                return r;
+
+        r = sd_device_get_subsystem(device, &subsystem);
+        if (r < 0)
+                return r;
+
+        if (!match_subsystem(enumerator, subsystem))
+                return 0;
+
+        r = sd_device_get_sysname(device, &sysname);
+        if (r < 0)
+                return r;
+
+        if (!match_sysname(enumerator, sysname))
+                return 0;
+
+        if (!match_parent(enumerator, device))
+                return 0;
+
+        if (!match_property(enumerator, device))
+                return 0;
+
+        if (!match_sysattr(enumerator, device))
+                return 0;
+
+        return device_enumerator_add_device(enumerator, device);
+}
+
 static int enumerator_scan_devices_tag(sd_device_enumerator *enumerator, const char *tag) {
         _cleanup_closedir_ DIR *dir = NULL;
+        DeviceDatabase *database;
         char *path;
         struct dirent *dent;
-        int r = 0;
+        int r = 0, k;
 
         assert(enumerator);
         assert(tag);
 
+        /* The database file knows all tagged devices, if it exists */
+        if (device_database_get_default(&database) >= 0) {
+                _cleanup_strv_free_ char **ids = NULL;
+                char **id;
+
+                k = device_database_get_tagged(database, tag, &ids);
+                if (k < 0)
+                        return log_debug_errno(k, "sd-device-enumerator: Failed to look up devices tagged %s: %m", tag);
+
+                STRV_FOREACH(id, ids) {
+                        k = enumerator_add_tagged_device(enumerator, *id);
+                        if (k < 0)
+                                r = k;
+                }
+
+                return r;
+        }
+
         path = strjoina("/run/udev/tags/", tag);
 
         dir = opendir(path);
@@ -594,54 +716,12 @@ static int enumerator_scan_devices_tag(sd_device_enumerator *enumerator, const c
         /* TODO: filter away subsystems? */
 
         FOREACH_DIRENT_ALL(dent, dir, return -errno) {
-                _cleanup_(sd_device_unrefp) sd_device *device = NULL;
-                const char *subsystem, *sysname;
-                int k;
-
                 if (dent->d_name[0] == '.')
                         continue;
 
-                k = sd_device_new_from_device_id(&device, dent->d_name);
-                if (k < 0) {
-                        if (k != -ENODEV)
-                                /* this is necessarily racy, so ignore missing devices */
-                                r = k;
-
-                        continue;
-                }
-
-                k = sd_device_get_subsystem(device, &subsystem);
-                if (k < 0) {
-                        r = k;
-                        continue;
-                }
-
-                if (!match_subsystem(enumerator, subsystem))
-                        continue;
-
-                k = sd_device_get_sysname(device, &sysname);
-                if (k < 0) {
-                        r = k;
-                        continue;
-                }
-
-                if (!match_sysname(enumerator, sysname))
-                        continue;
-
-                if (!match_parent(enumerator, device))
-                        continue;
-
-                if (!match_property(enumerator, device))
-                        continue;
-
-                if (!match_sysattr(enumerator, device))
-                        continue;
-
-                k = device_enumerator_add_device(enumerator, device);
-                if (k < 0) {
+                k = enumerator_add_tagged_device(enumerator, dent->d_name);
+                if (k < 0)
                         r = k;
-                        continue;
-                }
         }
 
         return r;
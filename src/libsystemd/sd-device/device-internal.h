@@ -3,6 +3,7 @@
 
 #include "sd-device.h"
 
+#include "device-property-list.h"
 #include "hashmap.h"
 #include "set.h"
 #include "time-util.h"
@@ -14,13 +15,13 @@ struct sd_device {
 
         sd_device *parent;
 
-        OrderedHashmap *properties;
-        Iterator properties_iterator;
+        PropertyList properties;
+        size_t properties_iterator;
         uint64_t properties_generation; /* changes whenever the properties are changed */
         uint64_t properties_iterator_generation; /* generation when iteration was started */
 
         /* the subset of the properties that should be written to the db */
-        OrderedHashmap *properties_db;
+        PropertyList properties_db;
 
         Hashmap *sysattr_values; /* cached sysattr values */
 
@@ -43,8 +44,8 @@ struct sd_device {
         char *devname;
         dev_t devnum;
 
-        char **properties_strv; /* the properties hashmap as a strv */
-        uint8_t *properties_nulstr; /* the same as a nulstr */
+        uint8_t *properties_nulstr; /* the properties as a nulstr */
+        char **properties_strv; /* pointers into the nulstr, built only when asked for */
         size_t properties_nulstr_len;
 
         char *syspath;
@@ -68,7 +69,7 @@ struct sd_device {
         bool sysattrs_read:1; /* don't try to re-read sysattrs once read */
         bool property_tags_outdated:1; /* need to update TAGS= property */
         bool property_devlinks_outdated:1; /* need to update DEVLINKS= property */
-        bool properties_buf_outdated:1; /* need to reread hashmap */
+        bool properties_buf_outdated:1; /* need to rebuild nulstr and strv */
         bool sysname_set:1; /* don't reread sysname */
         bool subsystem_set:1; /* don't reread subsystem */
         bool driver_subsystem_set:1; /* don't reread subsystem */
@@ -98,6 +99,7 @@ int device_new_aux(sd_device **ret);
 int device_add_property_aux(sd_device *device, const char *key, const char *value, bool db);
 int device_add_property_internal(sd_device *device, const char *key, const char *value);
 int device_read_uevent_file(sd_device *device);
+int device_properties_prepare(sd_device *device);
 
 int device_set_syspath(sd_device *device, const char *_syspath, bool verify);
 int device_set_ifindex(sd_device *device, const char *ifindex);
@@ -39,7 +39,11 @@ struct sd_device_monitor {
         sd_event *event;
         sd_event_source *event_source;
         sd_device_monitor_handler_t callback;
+        sd_device_monitor_batch_handler_t batch_callback;
         void *userdata;
+
+        struct DeviceMonitorBatch *batch;
+        usec_t last_receive;
 };
 
 #define UDEV_MONITOR_MAGIC                0xfeedcafe
@@ -63,6 +67,27 @@ typedef struct monitor_netlink_header {
         unsigned filter_tag_bloom_lo;
 } monitor_netlink_header;
 
+typedef union MonitorMessageBuffer {
+        monitor_netlink_header nlh;
+        char raw[8192];
+} MonitorMessageBuffer;
+
+/* When woken up, we read as many messages as we can get with a single recvmmsg() call, so that a storm of
+ * uevents, e.g. during coldplug, does not cost a wakeup and a syscall for each of them. */
+#define DEVICE_MONITOR_BATCH_MAX          32
+
+/* The batch buffers take 256K, hence they are only used while uevents arrive in quick succession, and
+ * released again once the monitor was idle for this long. */
+#define DEVICE_MONITOR_BATCH_IDLE_USEC    (100 * USEC_PER_MSEC)
+
+typedef struct DeviceMonitorBatch {
+        struct mmsghdr msgs[DEVICE_MONITOR_BATCH_MAX];
+        struct iovec iovs[DEVICE_MONITOR_BATCH_MAX];
+        union sockaddr_union addrs[DEVICE_MONITOR_BATCH_MAX];
+        char cred_msgs[DEVICE_MONITOR_BATCH_MAX][CMSG_SPACE(sizeof(struct ucred))];
+        MonitorMessageBuffer bufs[DEVICE_MONITOR_BATCH_MAX];
+} DeviceMonitorBatch;
+
 static int monitor_set_nl_address(sd_device_monitor *m) {
         union sockaddr_union snl;
         socklen_t addrlen;
@@ -181,29 +206,70 @@ _public_ int sd_device_monitor_stop(sd_device_monitor *m) {
 
         m->event_source = sd_event_source_unref(m->event_source);
         (void) device_monitor_disconnect(m);
+        m->batch = mfree(m->batch);
+        m->last_receive = 0;
 
         return 0;
 }
 
+static int device_monitor_receive_batch(sd_device_monitor *m, sd_device **devices, size_t *ret_n);
+
 static int device_monitor_event_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
-        _cleanup_(sd_device_unrefp) sd_device *device = NULL;
-        sd_device_monitor *m = userdata;
+        _cleanup_(sd_device_monitor_unrefp) sd_device_monitor *m = NULL;
+        sd_device *devices[DEVICE_MONITOR_BATCH_MAX];
+        usec_t now_usec = 0;
+        bool busy;
+        size_t n = 0, i;
+        int r = 0;
 
-        assert(m);
+        assert(userdata);
 
-        if (device_monitor_receive_device(m, &device) <= 0)
-                return 0;
+        /* The callbacks may stop the monitor or drop the last reference to it */
+        m = sd_device_monitor_ref(userdata);
 
-        if (m->callback)
-                return m->callback(m, device, m->userdata);
+        (void) sd_event_now(m->event, CLOCK_MONOTONIC, &now_usec);
+        busy = m->last_receive > 0 && now_usec > 0 &&
+                now_usec < usec_add(m->last_receive, DEVICE_MONITOR_BATCH_IDLE_USEC);
+        m->last_receive = now_usec;
 
-        return 0;
+        if (!busy)
+                m->batch = mfree(m->batch);
+
+        if (!busy || device_monitor_receive_batch(m, devices, &n) < 0) {
+                /* When idle, or without memory for the batch buffers, read a single message */
+                if (device_monitor_receive_device(m, &devices[0]) <= 0)
+                        return 0;
+                n = 1;
+        }
+
+        if (m->batch_callback) {
+                if (n > 0)
+                        r = m->batch_callback(m, devices, n, m->userdata);
+        } else
+                for (i = 0; i < n && m->event_source; i++) {
+                        if (!m->callback)
+                                continue;
+
+                        r = m->callback(m, devices[i], m->userdata);
+                        if (r < 0)
+                                break;
+                }
+
+        for (i = 0; i < n; i++)
+                sd_device_unref(devices[i]);
+
+        return r;
 }
 
-_public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_handler_t callback, void *userdata) {
+static int device_monitor_start(
+                sd_device_monitor *m,
+                sd_device_monitor_handler_t callback,
+                sd_device_monitor_batch_handler_t batch_callback,
+                void *userdata) {
+
         int r;
 
-        assert_return(m, -EINVAL);
+        assert(m);
 
         if (!m->event) {
                 r = sd_device_monitor_attach_event(m, NULL);
@@ -216,6 +282,7 @@ _public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_han
                 return r;
 
         m->callback = callback;
+        m->batch_callback = batch_callback;
         m->userdata = userdata;
 
         r = sd_event_add_io(m->event, &m->event_source, m->sock, EPOLLIN, device_monitor_event_handler, m);
@@ -227,6 +294,19 @@ _public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_han
         return 0;
 }
 
+_public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_handler_t callback, void *userdata) {
+        assert_return(m, -EINVAL);
+
+        return device_monitor_start(m, callback, NULL, userdata);
+}
+
+_public_ int sd_device_monitor_start_batch(sd_device_monitor *m, sd_device_monitor_batch_handler_t callback, void *userdata) {
+        assert_return(m, -EINVAL);
+        assert_return(callback, -EINVAL);
+
+        return device_monitor_start(m, NULL, callback, userdata);
+}
+
 _public_ int sd_device_monitor_detach_event(sd_device_monitor *m) {
         assert_return(m, -EINVAL);
 
@@ -300,6 +380,7 @@ static sd_device_monitor *device_monitor_free(sd_device_monitor *m) {
 
         hashmap_free_free_free(m->subsystem_filter);
         set_free_free(m->tag_filter);
+        free(m->batch);
 
         return mfree(m);
 }
@@ -352,59 +433,41 @@ tag:
         return 0;
 }
 
-int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
+static int device_monitor_parse_message(sd_device_monitor *m, struct msghdr *smsg, ssize_t buflen, sd_device **ret) {
         _cleanup_(sd_device_unrefp) sd_device *device = NULL;
-        union {
-                monitor_netlink_header nlh;
-                char raw[8192];
-        } buf;
-        struct iovec iov = {
-                .iov_base = &buf,
-                .iov_len = sizeof(buf)
-        };
-        char cred_msg[CMSG_SPACE(sizeof(struct ucred))];
-        union sockaddr_union snl;
-        struct msghdr smsg = {
-                .msg_iov = &iov,
-                .msg_iovlen = 1,
-                .msg_control = cred_msg,
-                .msg_controllen = sizeof(cred_msg),
-                .msg_name = &snl,
-                .msg_namelen = sizeof(snl),
-        };
+        MonitorMessageBuffer *buf;
+        union sockaddr_union *snl;
         struct cmsghdr *cmsg;
         struct ucred *cred;
-        ssize_t buflen, bufpos;
+        ssize_t bufpos;
         bool is_initialized = false;
         int r;
 
+        assert(m);
+        assert(smsg);
         assert(ret);
 
-        buflen = recvmsg(m->sock, &smsg, 0);
-        if (buflen < 0) {
-                if (errno != EINTR)
-                        log_debug_errno(errno, "sd-device-monitor: Failed to receive message: %m");
-                return -errno;
-        }
+        buf = smsg->msg_iov[0].iov_base;
+        snl = smsg->msg_name;
 
-        if (buflen < 32 || (smsg.msg_flags & MSG_TRUNC))
+        if (buflen < 32 || (smsg->msg_flags & MSG_TRUNC))
                 return log_debug_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "sd-device-monitor: Invalid message length.");
 
-        if (snl.nl.nl_groups == MONITOR_GROUP_NONE) {
+        if (snl->nl.nl_groups == MONITOR_GROUP_NONE) {
                 /* unicast message, check if we trust the sender */
                 if (m->snl_trusted_sender.nl.nl_pid == 0 ||
-                    snl.nl.nl_pid != m->snl_trusted_sender.nl.nl_pid)
+                    snl->nl.nl_pid != m->snl_trusted_sender.nl.nl_pid)
                         return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                                "sd-device-monitor: Unicast netlink message ignored.");
 
-        } else if (snl.nl.nl_groups == MONITOR_GROUP_KERNEL) {
-                if (snl.nl.nl_pid > 0)
+        } else if (snl->nl.nl_groups == MONITOR_GROUP_KERNEL) {
+                if (snl->nl.nl_pid > 0)
                         return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
-                                               "sd-device-monitor: Multicast kernel netlink message from PID %"PRIu32" ignored.", snl.nl.nl_pid);
+                                               "sd-device-monitor: Multicast kernel netlink message from PID %"PRIu32" ignored.", snl->nl.nl_pid);
         }
 
-        cmsg = CMSG_FIRSTHDR(&smsg);
+        cmsg = CMSG_FIRSTHDR(smsg);
         if (!cmsg || cmsg->cmsg_type != SCM_CREDENTIALS)
                 return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                        "sd-device-monitor: No sender credentials received, message ignored.");
@@ -414,37 +477,37 @@ int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
                 return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                        "sd-device-monitor: Sender uid="UID_FMT", message ignored.", cred->uid);
 
-        if (streq(buf.raw, "libudev")) {
+        if (streq(buf->raw, "libudev")) {
                 /* udev message needs proper version magic */
-                if (buf.nlh.magic != htobe32(UDEV_MONITOR_MAGIC))
+                if (buf->nlh.magic != htobe32(UDEV_MONITOR_MAGIC))
                         return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                                "sd-device-monitor: Invalid message signature (%x != %x)",
-                                               buf.nlh.magic, htobe32(UDEV_MONITOR_MAGIC));
+                                               buf->nlh.magic, htobe32(UDEV_MONITOR_MAGIC));
 
-                if (buf.nlh.properties_off+32 > (size_t) buflen)
+                if (buf->nlh.properties_off+32 > (size_t) buflen)
                         return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                                "sd-device-monitor: Invalid message length (%u > %zd)",
-                                               buf.nlh.properties_off+32, buflen);
+                                               buf->nlh.properties_off+32, buflen);
 
-                bufpos = buf.nlh.properties_off;
+                bufpos = buf->nlh.properties_off;
 
                 /* devices received from udev are always initialized */
                 is_initialized = true;
 
         } else {
                 /* kernel message with header */
-                bufpos = strlen(buf.raw) + 1;
+                bufpos = strlen(buf->raw) + 1;
                 if ((size_t) bufpos < sizeof("a@/d") || bufpos >= buflen)
                         return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                                "sd-device-monitor: Invalid message length");
 
                 /* check message header */
-                if (!strstr(buf.raw, "@/"))
+                if (!strstr(buf->raw, "@/"))
                         return log_debug_errno(SYNTHETIC_ERRNO(EAGAIN),
                                                "sd-device-monitor: Invalid message header");
         }
 
-        r = device_new_from_nulstr(&device, (uint8_t*) &buf.raw[bufpos], buflen - bufpos);
+        r = device_new_from_nulstr(&device, (uint8_t*) &buf->raw[bufpos], buflen - bufpos);
         if (r < 0)
                 return log_debug_errno(r, "sd-device-monitor: Failed to create device from received message: %m");
 
@@ -463,6 +526,82 @@ int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
         return r;
 }
 
+int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
+        MonitorMessageBuffer buf;
+        struct iovec iov = {
+                .iov_base = &buf,
+                .iov_len = sizeof(buf)
+        };
+        char cred_msg[CMSG_SPACE(sizeof(struct ucred))];
+        union sockaddr_union snl;
+        struct msghdr smsg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = cred_msg,
+                .msg_controllen = sizeof(cred_msg),
+                .msg_name = &snl,
+                .msg_namelen = sizeof(snl),
+        };
+        ssize_t buflen;
+
+        assert(ret);
+
+        buflen = recvmsg(m->sock, &smsg, 0);
+        if (buflen < 0) {
+                if (errno != EINTR)
+                        log_debug_errno(errno, "sd-device-monitor: Failed to receive message: %m");
+                return -errno;
+        }
+
+        return device_monitor_parse_message(m, &smsg, buflen, ret);
+}
+
+static int device_monitor_receive_batch(sd_device_monitor *m, sd_device **devices, size_t *ret_n) {
+        DeviceMonitorBatch *b;
+        size_t n = 0;
+        int k, i;
+
+        assert(m);
+        assert(devices);
+        assert(ret_n);
+
+        if (!m->batch) {
+                m->batch = new(DeviceMonitorBatch, 1);
+                if (!m->batch)
+                        return -ENOMEM;
+        }
+
+        b = m->batch;
+        for (i = 0; i < DEVICE_MONITOR_BATCH_MAX; i++) {
+                b->iovs[i] = IOVEC_MAKE(&b->bufs[i], sizeof(b->bufs[i]));
+                b->msgs[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = &b->iovs[i],
+                                .msg_iovlen = 1,
+                                .msg_control = b->cred_msgs[i],
+                                .msg_controllen = sizeof(b->cred_msgs[i]),
+                                .msg_name = &b->addrs[i],
+                                .msg_namelen = sizeof(b->addrs[i]),
+                        },
+                };
+        }
+
+        k = recvmmsg(m->sock, b->msgs, DEVICE_MONITOR_BATCH_MAX, MSG_DONTWAIT, NULL);
+        if (k < 0) {
+                if (!IN_SET(errno, EINTR, EAGAIN))
+                        log_debug_errno(errno, "sd-device-monitor: Failed to receive messages: %m");
+                *ret_n = 0;
+                return 0;
+        }
+
+        for (i = 0; i < k; i++)
+                if (device_monitor_parse_message(m, &b->msgs[i].msg_hdr, b->msgs[i].msg_len, &devices[n]) > 0)
+                        n++;
+
+        *ret_n = n;
+        return k;
+}
+
 static uint32_t string_hash32(const char *str) {
         return MurmurHash2(str, strlen(str), 0);
 }
@@ -7,6 +7,7 @@
 #include "sd-device.h"
 
 #include "alloc-util.h"
+#include "device-database.h"
 #include "device-internal.h"
 #include "device-private.h"
 #include "device-util.h"
@@ -374,7 +375,7 @@ static int device_verify(sd_device *device, DeviceAction action, uint64_t seqnum
         return 0;
 }
 
-int device_new_from_strv(sd_device **ret, char **strv) {
+static int device_new_from_strv_internal(sd_device **ret, char **strv, bool verify) {
         _cleanup_(sd_device_unrefp) sd_device *device = NULL;
         char **key;
         const char *major = NULL, *minor = NULL;
@@ -401,15 +402,33 @@ int device_new_from_strv(sd_device **ret, char **strv) {
                         return log_device_debug_errno(device, r, "sd-device: Failed to set devnum %s:%s: %m", major, minor);
         }
 
-        r = device_verify(device, action, seqnum);
-        if (r < 0)
-                return r;
+        if (verify) {
+                r = device_verify(device, action, seqnum);
+                if (r < 0)
+                        return r;
+        } else {
+                if (!device->devpath)
+                        return log_device_debug_errno(device, SYNTHETIC_ERRNO(EINVAL),
+                                                      "sd-device: Device created from strv lacks devpath.");
+
+                device_seal(device);
+        }
 
         *ret = TAKE_PTR(device);
 
         return 0;
 }
 
+int device_new_from_strv(sd_device **ret, char **strv) {
+        return device_new_from_strv_internal(ret, strv, true);
+}
+
+/* Like device_new_from_strv(), but the properties need not describe a uevent, i.e. only DEVPATH= is
+ * required. Used to recreate recorded devices, including parents without subsystem. */
+int device_new_from_strv_unverified(sd_device **ret, char **strv) {
+        return device_new_from_strv_internal(ret, strv, false);
+}
+
 int device_new_from_nulstr(sd_device **ret, uint8_t *nulstr, size_t len) {
         _cleanup_(sd_device_unrefp) sd_device *device = NULL;
         const char *major = NULL, *minor = NULL;
@@ -459,45 +478,29 @@ int device_new_from_nulstr(sd_device **ret, uint8_t *nulstr, size_t len) {
 }
 
 static int device_update_properties_bufs(sd_device *device) {
-        const char *val, *prop;
-        _cleanup_free_ char **buf_strv = NULL;
-        _cleanup_free_ uint8_t *buf_nulstr = NULL;
-        size_t allocated_nulstr = 0;
-        size_t nulstr_len = 0, num = 0, i = 0;
+        _cleanup_free_ char *buf_nulstr = NULL;
+        size_t nulstr_len;
+        int r;
 
         assert(device);
 
+        r = device_properties_prepare(device);
+        if (r < 0)
+                return r;
+
         if (!device->properties_buf_outdated)
                 return 0;
 
-        FOREACH_DEVICE_PROPERTY(device, prop, val) {
-                size_t len = 0;
-
-                len = strlen(prop) + 1 + strlen(val);
-
-                buf_nulstr = GREEDY_REALLOC0(buf_nulstr, allocated_nulstr, nulstr_len + len + 2);
-                if (!buf_nulstr)
-                        return -ENOMEM;
-
-                strscpyl((char *)buf_nulstr + nulstr_len, len + 1, prop, "=", val, NULL);
-                nulstr_len += len + 1;
-                ++num;
-        }
-
-        /* build buf_strv from buf_nulstr */
-        buf_strv = new0(char *, num + 1);
-        if (!buf_strv)
-                return -ENOMEM;
-
-        NULSTR_FOREACH(val, (char*) buf_nulstr) {
-                buf_strv[i] = (char *) val;
-                assert(i < num);
-                i++;
-        }
+        r = property_list_to_nulstr(&device->properties, &buf_nulstr, &nulstr_len);
+        if (r < 0)
+                return r;
 
-        free_and_replace(device->properties_nulstr, buf_nulstr);
+        free(device->properties_nulstr);
+        device->properties_nulstr = (uint8_t*) TAKE_PTR(buf_nulstr);
         device->properties_nulstr_len = nulstr_len;
-        free_and_replace(device->properties_strv, buf_strv);
+
+        /* Most users only want the nulstr, hence build the strv only on request */
+        device->properties_strv = mfree(device->properties_strv);
 
         device->properties_buf_outdated = false;
 
@@ -531,6 +534,24 @@ int device_get_properties_strv(sd_device *device, char ***strv) {
         if (r < 0)
                 return r;
 
+        if (!device->properties_strv) {
+                _cleanup_free_ char **buf_strv = NULL;
+                const char *p;
+                size_t i = 0;
+
+                buf_strv = new(char*, property_list_size(&device->properties) + 1);
+                if (!buf_strv)
+                        return -ENOMEM;
+
+                NULSTR_FOREACH(p, (const char*) device->properties_nulstr) {
+                        assert(i < property_list_size(&device->properties));
+                        buf_strv[i++] = (char*) p;
+                }
+                buf_strv[i] = NULL;
+
+                device->properties_strv = TAKE_PTR(buf_strv);
+        }
+
         *strv = device->properties_strv;
 
         return 0;
@@ -803,7 +824,7 @@ static bool device_has_info(sd_device *device) {
         if (device->devlink_priority != 0)
                 return true;
 
-        if (!ordered_hashmap_isempty(device->properties_db))
+        if (!property_list_isempty(&device->properties_db))
                 return true;
 
         if (!set_isempty(device->tags))
@@ -815,6 +836,84 @@ static bool device_has_info(sd_device *device) {
         return false;
 }
 
+static void device_append_db(sd_device *device, const char *id, const char *data, size_t data_len, bool removed) {
+        _cleanup_free_ char **tags = NULL;
+        int r;
+
+        assert(device);
+        assert(id);
+
+        if (!removed && !set_isempty(device->tags)) {
+                tags = set_get_strv(device->tags);
+                if (!tags) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+        }
+
+        r = device_database_append(DEVICE_DATABASE_PATH, id, tags, data, data_len, removed);
+        if (r == -ENOENT)
+                return;
+        if (r < 0)
+                goto fail;
+
+        return;
+
+fail:
+        /* Readers must not find an outdated entry in there. Without the file they fall back to the per-device
+         * files, until udevd imports them again. */
+        log_device_debug_errno(device, r, "sd-device: Failed to append to %s, removing it: %m", DEVICE_DATABASE_PATH);
+        (void) unlink(DEVICE_DATABASE_PATH);
+}
+
+static int device_format_db(sd_device *device, char **ret, size_t *ret_len) {
+        _cleanup_free_ char *data = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        const char *property, *value, *tag;
+        size_t data_len = 0, j;
+        int r;
+
+        assert(device);
+        assert(ret);
+        assert(ret_len);
+
+        f = open_memstream(&data, &data_len);
+        if (!f)
+                return -ENOMEM;
+
+        if (major(device->devnum) > 0) {
+                const char *devlink;
+
+                FOREACH_DEVICE_DEVLINK(device, devlink)
+                        fprintf(f, "S:%s\n", devlink + STRLEN("/dev/"));
+
+                if (device->devlink_priority != 0)
+                        fprintf(f, "L:%i\n", device->devlink_priority);
+
+                if (device->watch_handle >= 0)
+                        fprintf(f, "W:%i\n", device->watch_handle);
+        }
+
+        if (device->usec_initialized > 0)
+                fprintf(f, "I:"USEC_FMT"\n", device->usec_initialized);
+
+        PROPERTY_LIST_FOREACH(&device->properties_db, j, property, value)
+                fprintf(f, "E:%s=%s\n", property, value);
+
+        FOREACH_DEVICE_TAG(device, tag)
+                fprintf(f, "G:%s\n", tag);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        f = safe_fclose(f);
+
+        *ret = TAKE_PTR(data);
+        *ret_len = data_len;
+        return 0;
+}
+
 void device_set_db_persist(sd_device *device) {
         assert(device);
 
@@ -825,7 +924,8 @@ int device_update_db(sd_device *device) {
         const char *id;
         char *path;
         _cleanup_fclose_ FILE *f = NULL;
-        _cleanup_free_ char *path_tmp = NULL;
+        _cleanup_free_ char *path_tmp = NULL, *data = NULL;
+        size_t data_len = 0;
         bool has_info;
         int r;
 
@@ -845,9 +945,16 @@ int device_update_db(sd_device *device) {
                 if (r < 0 && errno != ENOENT)
                         return -errno;
 
+                device_append_db(device, id, NULL, 0, true);
                 return 0;
         }
 
+        if (has_info) {
+                r = device_format_db(device, &data, &data_len);
+                if (r < 0)
+                        return r;
+        }
+
         /* write a database file */
         r = mkdir_parents(path, 0755);
         if (r < 0)
@@ -875,32 +982,8 @@ int device_update_db(sd_device *device) {
                 }
         }
 
-        if (has_info) {
-                const char *property, *value, *tag;
-                Iterator i;
-
-                if (major(device->devnum) > 0) {
-                        const char *devlink;
-
-                        FOREACH_DEVICE_DEVLINK(device, devlink)
-                                fprintf(f, "S:%s\n", devlink + STRLEN("/dev/"));
-
-                        if (device->devlink_priority != 0)
-                                fprintf(f, "L:%i\n", device->devlink_priority);
-
-                        if (device->watch_handle >= 0)
-                                fprintf(f, "W:%i\n", device->watch_handle);
-                }
-
-                if (device->usec_initialized > 0)
-                        fprintf(f, "I:"USEC_FMT"\n", device->usec_initialized);
-
-                ORDERED_HASHMAP_FOREACH_KEY(value, property, device->properties_db, i)
-                        fprintf(f, "E:%s=%s\n", property, value);
-
-                FOREACH_DEVICE_TAG(device, tag)
-                        fprintf(f, "G:%s\n", tag);
-        }
+        if (data_len > 0)
+                fwrite(data, 1, data_len, f);
 
         r = fflush_and_check(f);
         if (r < 0)
@@ -915,6 +998,8 @@ int device_update_db(sd_device *device) {
         log_device_debug(device, "sd-device: Created %s file '%s' for '%s'", has_info ? "db" : "empty",
                          path, device->devpath);
 
+        device_append_db(device, id, data, data_len, false);
+
         return 0;
 
 fail:
@@ -941,5 +1026,7 @@ int device_delete_db(sd_device *device) {
         if (r < 0 && errno != ENOENT)
                 return -errno;
 
+        device_append_db(device, id, NULL, 0, true);
+
         return 0;
 }
@@ -10,6 +10,7 @@
 
 int device_new_from_nulstr(sd_device **ret, uint8_t *nulstr, size_t len);
 int device_new_from_strv(sd_device **ret, char **strv);
+int device_new_from_strv_unverified(sd_device **ret, char **strv);
 int device_new_from_stat_rdev(sd_device **ret, const struct stat *st);
 
 int device_get_id_filename(sd_device *device, const char **ret);
@@ -21,6 +22,8 @@ int device_get_devnode_uid(sd_device *device, uid_t *uid);
 int device_get_devnode_gid(sd_device *device, gid_t *gid);
 
 void device_seal(sd_device *device);
+void device_set_parent(sd_device *device, sd_device *parent);
+int device_cache_sysattr_value(sd_device *device, const char *key, const char *value);
 void device_set_is_initialized(sd_device *device);
 void device_set_watch_handle(sd_device *device, int fd);
 void device_set_db_persist(sd_device *device);
@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "alloc-util.h"
+#include "device-property-list.h"
+
+struct PropertyListEntry {
+        size_t key_len;
+        size_t value_len;
+        char data[]; /* the key, NUL, the value, NUL */
+};
+
+static size_t entry_nulstr_size(const PropertyListEntry *e) {
+        return e->key_len + 1 + e->value_len + 1;
+}
+
+static const char *entry_value(const PropertyListEntry *e) {
+        return e->data + e->key_len + 1;
+}
+
+void property_list_done(PropertyList *l) {
+        size_t i;
+
+        assert(l);
+
+        for (i = 0; i < l->n_entries; i++)
+                free(l->entries[i]);
+
+        l->entries = mfree(l->entries);
+        l->sorted = mfree(l->sorted);
+        l->n_entries = l->n_entries_allocated = l->n_sorted_allocated = 0;
+        l->nulstr_size = 0;
+}
+
+/* Returns true and the index in l->sorted if the key exists, false and the index to insert it at otherwise */
+static bool property_list_find(const PropertyList *l, const char *key, size_t *ret) {
+        size_t lo = 0, hi = l->n_entries;
+
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                int c;
+
+                c = strcmp(key, l->sorted[mid]->data);
+                if (c == 0) {
+                        *ret = mid;
+                        return true;
+                }
+                if (c < 0)
+                        hi = mid;
+                else
+                        lo = mid + 1;
+        }
+
+        *ret = lo;
+        return false;
+}
+
+static size_t property_list_index_of(const PropertyList *l, const PropertyListEntry *e) {
+        size_t i;
+
+        for (i = 0; i < l->n_entries; i++)
+                if (l->entries[i] == e)
+                        return i;
+
+        assert_not_reached("Property not in list");
+}
+
+int property_list_set(PropertyList *l, const char *key, const char *value) {
+        PropertyListEntry *e;
+        size_t key_len, value_len, idx;
+
+        assert(l);
+        assert(key);
+        assert(value);
+
+        key_len = strlen(key);
+        value_len = strlen(value);
+
+        e = malloc(offsetof(PropertyListEntry, data) + key_len + 1 + value_len + 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->key_len = key_len;
+        e->value_len = value_len;
+        memcpy(mempcpy(e->data, key, key_len + 1), value, value_len + 1);
+
+        if (property_list_find(l, key, &idx)) {
+                PropertyListEntry *old = l->sorted[idx];
+
+                /* Replace the value, but keep the position of the property */
+                l->entries[property_list_index_of(l, old)] = e;
+                l->sorted[idx] = e;
+                l->nulstr_size = l->nulstr_size - old->value_len + value_len;
+
+                free(old);
+                return 0;
+        }
+
+        if (!GREEDY_REALLOC(l->entries, l->n_entries_allocated, l->n_entries + 1) ||
+            !GREEDY_REALLOC(l->sorted, l->n_sorted_allocated, l->n_entries + 1)) {
+                free(e);
+                return -ENOMEM;
+        }
+
+        memmove(l->sorted + idx + 1, l->sorted + idx, (l->n_entries - idx) * sizeof(PropertyListEntry*));
+        l->sorted[idx] = e;
+        l->entries[l->n_entries++] = e;
+        l->nulstr_size += entry_nulstr_size(e);
+
+        return 0;
+}
+
+void property_list_remove(PropertyList *l, const char *key) {
+        PropertyListEntry *e;
+        size_t idx, i;
+
+        assert(l);
+        assert(key);
+
+        if (!property_list_find(l, key, &idx))
+                return;
+
+        e = l->sorted[idx];
+        i = property_list_index_of(l, e);
+
+        memmove(l->sorted + idx, l->sorted + idx + 1, (l->n_entries - idx - 1) * sizeof(PropertyListEntry*));
+        memmove(l->entries + i, l->entries + i + 1, (l->n_entries - i - 1) * sizeof(PropertyListEntry*));
+        l->n_entries--;
+        l->nulstr_size -= entry_nulstr_size(e);
+
+        free(e);
+}
+
+const char *property_list_get(const PropertyList *l, const char *key) {
+        size_t idx;
+
+        assert(l);
+        assert(key);
+
+        if (!property_list_find(l, key, &idx))
+                return NULL;
+
+        return entry_value(l->sorted[idx]);
+}
+
+const char *property_list_iterate(const PropertyList *l, size_t *i, const char **ret_value) {
+        const PropertyListEntry *e;
+
+        assert(l);
+        assert(i);
+
+        if (*i >= l->n_entries) {
+                if (ret_value)
+                        *ret_value = NULL;
+                return NULL;
+        }
+
+        e = l->entries[(*i)++];
+
+        if (ret_value)
+                *ret_value = entry_value(e);
+        return e->data;
+}
+
+int property_list_to_nulstr(const PropertyList *l, char **ret, size_t *ret_len) {
+        char *buf, *p;
+        size_t i;
+
+        assert(l);
+        assert(ret);
+        assert(ret_len);
+
+        /* Formats all properties as "KEY=VALUE", in the order they were added, each terminated by a NUL byte.
+         * The buffer is terminated by an additional NUL byte, which is not included in the returned size. */
+
+        buf = new(char, l->nulstr_size + 1);
+        if (!buf)
+                return -ENOMEM;
+
+        for (i = 0, p = buf; i < l->n_entries; i++) {
+                const PropertyListEntry *e = l->entries[i];
+
+                memcpy(p, e->data, entry_nulstr_size(e));
+                p[e->key_len] = '=';
+                p += entry_nulstr_size(e);
+        }
+
+        assert(p == buf + l->nulstr_size);
+        *p = 0;
+
+        *ret = buf;
+        *ret_len = l->nulstr_size;
+        return 0;
+}
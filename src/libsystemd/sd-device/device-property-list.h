@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "macro.h"
+
+typedef struct PropertyListEntry PropertyListEntry;
+
+/* The properties of a device. Each property is a single allocation holding both key and value, and the list
+ * keeps them in the order they were added, as well as sorted by key, so that lookups can bisect. Devices have a
+ * few dozen properties at most, hence the memmove()s on insertion and removal are cheaper than maintaining a
+ * hashmap, and formatting all of them as nulstr is a single allocation of known size. */
+typedef struct PropertyList {
+        PropertyListEntry **entries; /* in the order the properties were added */
+        PropertyListEntry **sorted;  /* the same, sorted by key */
+        size_t n_entries;
+        size_t n_entries_allocated, n_sorted_allocated;
+        size_t nulstr_size; /* the size of all properties formatted as "KEY=VALUE\0" */
+} PropertyList;
+
+void property_list_done(PropertyList *l);
+
+int property_list_set(PropertyList *l, const char *key, const char *value);
+void property_list_remove(PropertyList *l, const char *key);
+
+const char *property_list_get(const PropertyList *l, const char *key);
+const char *property_list_iterate(const PropertyList *l, size_t *i, const char **ret_value);
+
+int property_list_to_nulstr(const PropertyList *l, char **ret, size_t *ret_len);
+
+static inline size_t property_list_size(const PropertyList *l) {
+        return l->n_entries;
+}
+
+static inline bool property_list_isempty(const PropertyList *l) {
+        return l->n_entries == 0;
+}
+
+#define PROPERTY_LIST_FOREACH(l, i, key, value)                         \
+        for ((i) = 0; ((key) = property_list_iterate((l), &(i), &(value))); )
@@ -8,6 +8,7 @@
 #include "sd-device.h"
 
 #include "alloc-util.h"
+#include "device-database.h"
 #include "device-internal.h"
 #include "device-private.h"
 #include "device-util.h"
@@ -64,8 +65,8 @@ static sd_device *device_free(sd_device *device) {
         free(device->properties_strv);
         free(device->properties_nulstr);
 
-        ordered_hashmap_free_free_free(device->properties);
-        ordered_hashmap_free_free_free(device->properties_db);
+        property_list_done(&device->properties);
+        property_list_done(&device->properties_db);
         hashmap_free_free_free(device->sysattr_values);
         set_free_free(device->sysattrs);
         set_free_free(device->tags);
@@ -76,47 +77,24 @@ static sd_device *device_free(sd_device *device) {
 
 DEFINE_PUBLIC_TRIVIAL_REF_UNREF_FUNC(sd_device, sd_device, device_free);
 
-int device_add_property_aux(sd_device *device, const char *_key, const char *_value, bool db) {
-        OrderedHashmap **properties;
+int device_add_property_aux(sd_device *device, const char *key, const char *value, bool db) {
+        PropertyList *properties;
+        int r;
 
         assert(device);
-        assert(_key);
+        assert(key);
 
         if (db)
                 properties = &device->properties_db;
         else
                 properties = &device->properties;
 
-        if (_value) {
-                _cleanup_free_ char *key = NULL, *value = NULL, *old_key = NULL, *old_value = NULL;
-                int r;
-
-                r = ordered_hashmap_ensure_allocated(properties, &string_hash_ops);
+        if (value) {
+                r = property_list_set(properties, key, value);
                 if (r < 0)
                         return r;
-
-                key = strdup(_key);
-                if (!key)
-                        return -ENOMEM;
-
-                value = strdup(_value);
-                if (!value)
-                        return -ENOMEM;
-
-                old_value = ordered_hashmap_get2(*properties, key, (void**) &old_key);
-
-                r = ordered_hashmap_replace(*properties, key, value);
-                if (r < 0)
-                        return r;
-
-                key = NULL;
-                value = NULL;
-        } else {
-                _cleanup_free_ char *key = NULL;
-                _cleanup_free_ char *value = NULL;
-
-                value = ordered_hashmap_remove2(*properties, _key, (void**) &key);
-        }
+        } else
+                property_list_remove(properties, key);
 
         if (!db) {
                 device->properties_generation++;
@@ -727,6 +705,15 @@ _public_ int sd_device_get_parent(sd_device *child, sd_device **ret) {
         return 0;
 }
 
+void device_set_parent(sd_device *device, sd_device *parent) {
+        assert(device);
+
+        /* A NULL parent means the device has none, without looking at sysfs */
+        sd_device_unref(device->parent);
+        device->parent = sd_device_ref(parent);
+        device->parent_set = true;
+}
+
 int device_set_subsystem(sd_device *device, const char *_subsystem) {
         _cleanup_free_ char *subsystem = NULL;
         int r;
@@ -1266,9 +1253,45 @@ int device_get_id_filename(sd_device *device, const char **ret) {
         return 0;
 }
 
+static int device_read_db_data(sd_device *device, const char *id, char **ret, size_t *ret_len) {
+        DeviceDatabase *database;
+        const char *data;
+        char *path;
+        size_t len;
+        int r;
+
+        assert(device);
+        assert(id);
+        assert(ret);
+        assert(ret_len);
+
+        /* Prefer the single database file, and fall back to the per-device file for devices it does not know
+         * about, or if it does not exist */
+        if (device_database_get_default(&database) >= 0) {
+                r = device_database_lookup(database, id, &data, &len);
+                if (r == -ENOENT)
+                        return r;
+                if (r >= 0) {
+                        *ret = memdup_suffix0(data, len);
+                        if (!*ret)
+                                return -ENOMEM;
+
+                        *ret_len = len;
+                        return 0;
+                }
+        }
+
+        path = strjoina("/run/udev/data/", id);
+
+        r = read_full_file(path, ret, ret_len);
+        if (r < 0 && r != -ENOENT)
+                return log_device_debug_errno(device, r, "sd-device: Failed to read db '%s': %m", path);
+
+        return r;
+}
+
 int device_read_db_internal(sd_device *device, bool force) {
         _cleanup_free_ char *db = NULL;
-        char *path;
         const char *id, *value;
         char key;
         size_t db_len;
@@ -1292,15 +1315,11 @@ int device_read_db_internal(sd_device *device, bool force) {
         if (r < 0)
                 return r;
 
-        path = strjoina("/run/udev/data/", id);
-
-        r = read_full_file(path, &db, &db_len);
-        if (r < 0) {
-                if (r == -ENOENT)
-                        return 0;
-                else
-                        return log_device_debug_errno(device, r, "sd-device: Failed to read db '%s': %m", path);
-        }
+        r = device_read_db_data(device, id, &db, &db_len);
+        if (r == -ENOENT)
+                return 0;
+        if (r < 0)
+                return r;
 
         /* devices with a database entry are initialized */
         device->is_initialized = true;
@@ -1453,7 +1472,7 @@ _public_ const char *sd_device_get_devlink_next(sd_device *device) {
         return v;
 }
 
-static int device_properties_prepare(sd_device *device) {
+int device_properties_prepare(sd_device *device) {
         int r;
 
         assert(device);
@@ -1530,9 +1549,9 @@ _public_ const char *sd_device_get_property_first(sd_device *device, const char
                 return NULL;
 
         device->properties_iterator_generation = device->properties_generation;
-        device->properties_iterator = ITERATOR_FIRST;
+        device->properties_iterator = 0;
 
-        ordered_hashmap_iterate(device->properties, &device->properties_iterator, (void**)&value, (const void**)&key);
+        key = property_list_iterate(&device->properties, &device->properties_iterator, &value);
 
         if (_value)
                 *_value = value;
@@ -1553,7 +1572,7 @@ _public_ const char *sd_device_get_property_next(sd_device *device, const char *
         if (device->properties_iterator_generation != device->properties_generation)
                 return NULL;
 
-        ordered_hashmap_iterate(device->properties, &device->properties_iterator, (void**)&value, (const void**)&key);
+        key = property_list_iterate(&device->properties, &device->properties_iterator, &value);
 
         if (_value)
                 *_value = value;
@@ -1651,7 +1670,7 @@ _public_ int sd_device_has_tag(sd_device *device, const char *tag) {
 }
 
 _public_ int sd_device_get_property_value(sd_device *device, const char *key, const char **_value) {
-        char *value;
+        const char *value;
         int r;
 
         assert_return(device, -EINVAL);
@@ -1661,7 +1680,7 @@ _public_ int sd_device_get_property_value(sd_device *device, const char *key, co
         if (r < 0)
                 return r;
 
-        value = ordered_hashmap_get(device->properties, key);
+        value = property_list_get(&device->properties, key);
         if (!value)
                 return -ENOENT;
 
@@ -1698,6 +1717,28 @@ static int device_add_sysattr_value(sd_device *device, const char *_key, char *v
         return 0;
 }
 
+int device_cache_sysattr_value(sd_device *device, const char *key, const char *value) {
+        _cleanup_free_ char *v = NULL;
+        int r;
+
+        assert(device);
+        assert(key);
+
+        /* A NULL value caches that the attribute does not exist */
+        if (value) {
+                v = strdup(value);
+                if (!v)
+                        return -ENOMEM;
+        }
+
+        r = device_add_sysattr_value(device, key, v);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(v);
+        return 0;
+}
+
 static int device_get_sysattr_value(sd_device *device, const char *_key, const char **_value) {
         const char *key = NULL, *value;
 
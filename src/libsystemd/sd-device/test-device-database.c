@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "device-database.h"
+#include "fileio.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+static void check_entry(DeviceDatabase *db, const char *id, const char *expected) {
+        const char *data;
+        size_t len;
+        int r;
+
+        r = device_database_lookup(db, id, &data, &len);
+        if (!expected) {
+                assert_se(r == -ENOENT);
+                return;
+        }
+
+        assert_se(r >= 0);
+        assert_se(len == strlen(expected));
+        assert_se(memcmp(data, expected, len) == 0);
+}
+
+static void check_tagged(DeviceDatabase *db, const char *tag, char **expected) {
+        _cleanup_strv_free_ char **ids = NULL;
+
+        assert_se(device_database_get_tagged(db, tag, &ids) >= 0);
+        strv_sort(ids);
+        assert_se(strv_equal(ids, expected));
+}
+
+static void test_device_database(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_(device_database_freep) DeviceDatabase *db = NULL;
+        const char *data_dir, *path, *p;
+        uint64_t size;
+        size_t len;
+        struct stat st;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp_malloc(NULL, &t) >= 0);
+
+        data_dir = strjoina(t, "/data");
+        path = strjoina(t, "/database");
+        assert_se(mkdir(data_dir, 0755) >= 0);
+
+        /* nothing to append to before the per-device files were imported */
+        assert_se(device_database_append(path, "b8:0", NULL, "", 0, false) == -ENOENT);
+
+        p = strjoina(data_dir, "/b8:0");
+        assert_se(write_string_file(p, "S:disk/by-id/foo\nG:systemd\nG:uaccess", WRITE_STRING_FILE_CREATE) >= 0);
+        p = strjoina(data_dir, "/n1");
+        assert_se(write_string_file(p, "I:1234\nE:ID_NET_NAME=lo", WRITE_STRING_FILE_CREATE) >= 0);
+
+        assert_se(device_database_import(path, data_dir) >= 0);
+        assert_se(device_database_open(path, &db) >= 0);
+
+        check_entry(db, "b8:0", "S:disk/by-id/foo\nG:systemd\nG:uaccess\n");
+        check_entry(db, "n1", "I:1234\nE:ID_NET_NAME=lo\n");
+        assert_se(device_database_lookup(db, "c1:3", &p, &len) == -ENXIO);
+        check_tagged(db, "systemd", STRV_MAKE("b8:0"));
+        check_tagged(db, "seat", NULL);
+
+        /* later records supersede earlier ones, and are picked up on refresh */
+        assert_se(device_database_append(path, "n1", STRV_MAKE("systemd"), "G:systemd\n", 10, false) >= 0);
+        assert_se(device_database_append(path, "b8:0", NULL, NULL, 0, true) >= 0);
+        assert_se(device_database_append(path, "c1:3", STRV_MAKE("seat", "uaccess"), "G:seat\nG:uaccess\n", 18, false) >= 0);
+
+        check_entry(db, "b8:0", "S:disk/by-id/foo\nG:systemd\nG:uaccess\n");
+        assert_se(device_database_refresh(db) >= 0);
+        check_entry(db, "b8:0", NULL);
+        check_entry(db, "n1", "G:systemd\n");
+        check_entry(db, "c1:3", "G:seat\nG:uaccess\n");
+        check_tagged(db, "systemd", STRV_MAKE("n1"));
+        check_tagged(db, "uaccess", STRV_MAKE("c1:3"));
+
+        /* compaction drops superseded and removed records, and readers notice the new file */
+        assert_se(stat(path, &st) >= 0);
+        assert_se(device_database_compact(path, &size) >= 0);
+        assert_se(size < (uint64_t) st.st_size);
+
+        assert_se(device_database_refresh(db) >= 0);
+        assert_se(device_database_lookup(db, "b8:0", &p, &len) == -ENXIO);
+        check_entry(db, "n1", "G:systemd\n");
+        check_entry(db, "c1:3", "G:seat\nG:uaccess\n");
+        check_tagged(db, "seat", STRV_MAKE("c1:3"));
+
+        assert_se(device_database_append(path, "b8:0", STRV_MAKE("systemd"), "G:systemd\n", 10, false) >= 0);
+        assert_se(device_database_refresh(db) >= 0);
+        check_tagged(db, "systemd", STRV_MAKE("b8:0", "n1"));
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_device_database();
+
+        return 0;
+}
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "device-property-list.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+static void check_order(const PropertyList *l, const char *expected) {
+        _cleanup_free_ char *joined = NULL;
+        const char *key, *value;
+        size_t i;
+
+        PROPERTY_LIST_FOREACH(l, i, key, value) {
+                assert_se(streq_ptr(property_list_get(l, key), value));
+                assert_se(strextend_with_separator(&joined, " ", key, NULL));
+        }
+
+        assert_se(streq_ptr(joined, expected));
+}
+
+static void test_set_get_remove(void) {
+        PropertyList l = {};
+
+        log_info("/* %s */", __func__);
+
+        assert_se(property_list_isempty(&l));
+        assert_se(!property_list_get(&l, "FOO"));
+
+        assert_se(property_list_set(&l, "SUBSYSTEM", "block") >= 0);
+        assert_se(property_list_set(&l, "DEVNAME", "/dev/sda") >= 0);
+        assert_se(property_list_set(&l, "ACTION", "add") >= 0);
+        assert_se(property_list_set(&l, "ID_SERIAL", "") >= 0);
+        assert_se(property_list_size(&l) == 4);
+
+        assert_se(streq_ptr(property_list_get(&l, "SUBSYSTEM"), "block"));
+        assert_se(streq_ptr(property_list_get(&l, "DEVNAME"), "/dev/sda"));
+        assert_se(streq_ptr(property_list_get(&l, "ACTION"), "add"));
+        assert_se(streq_ptr(property_list_get(&l, "ID_SERIAL"), ""));
+        assert_se(!property_list_get(&l, "DEVTYPE"));
+        check_order(&l, "SUBSYSTEM DEVNAME ACTION ID_SERIAL");
+
+        /* Replacing a value keeps the position */
+        assert_se(property_list_set(&l, "DEVNAME", "/dev/sdb") >= 0);
+        assert_se(property_list_size(&l) == 4);
+        assert_se(streq_ptr(property_list_get(&l, "DEVNAME"), "/dev/sdb"));
+        check_order(&l, "SUBSYSTEM DEVNAME ACTION ID_SERIAL");
+
+        property_list_remove(&l, "DEVTYPE");
+        property_list_remove(&l, "SUBSYSTEM");
+        assert_se(property_list_size(&l) == 3);
+        assert_se(!property_list_get(&l, "SUBSYSTEM"));
+        check_order(&l, "DEVNAME ACTION ID_SERIAL");
+
+        assert_se(property_list_set(&l, "SUBSYSTEM", "block") >= 0);
+        check_order(&l, "DEVNAME ACTION ID_SERIAL SUBSYSTEM");
+
+        property_list_done(&l);
+        assert_se(property_list_isempty(&l));
+        assert_se(!property_list_get(&l, "DEVNAME"));
+}
+
+static void test_to_nulstr(void) {
+        PropertyList l = {};
+        _cleanup_free_ char *nulstr = NULL;
+        size_t len;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(property_list_to_nulstr(&l, &nulstr, &len) >= 0);
+        assert_se(len == 0);
+        assert_se(nulstr[0] == 0);
+        nulstr = mfree(nulstr);
+
+        assert_se(property_list_set(&l, "ACTION", "add") >= 0);
+        assert_se(property_list_set(&l, "DEVPATH", "/devices/virtual/mem/null") >= 0);
+        assert_se(property_list_set(&l, "MAJOR", "1") >= 0);
+        assert_se(property_list_set(&l, "ACTION", "change") >= 0);
+        property_list_remove(&l, "MAJOR");
+        assert_se(property_list_set(&l, "MINOR", "3") >= 0);
+
+        assert_se(property_list_to_nulstr(&l, &nulstr, &len) >= 0);
+        assert_se(len == STRLEN("ACTION=change") + 1 + STRLEN("DEVPATH=/devices/virtual/mem/null") + 1 + STRLEN("MINOR=3") + 1);
+        assert_se(memcmp(nulstr, "ACTION=change\0DEVPATH=/devices/virtual/mem/null\0MINOR=3\0", len + 1) == 0);
+
+        property_list_done(&l);
+}
+
+static void test_many(void) {
+        PropertyList l = {};
+        char key[16], value[16];
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        /* Insert in an order that is neither sorted nor reverse sorted */
+        for (i = 0; i < 256; i++) {
+                xsprintf(key, "KEY%03u", (i * 7) % 256);
+                xsprintf(value, "%u", i);
+                assert_se(property_list_set(&l, key, value) >= 0);
+        }
+
+        assert_se(property_list_size(&l) == 256);
+
+        for (i = 0; i < 256; i++) {
+                xsprintf(key, "KEY%03u", (i * 7) % 256);
+                xsprintf(value, "%u", i);
+                assert_se(streq_ptr(property_list_get(&l, key), value));
+        }
+
+        for (i = 0; i < 256; i += 2) {
+                xsprintf(key, "KEY%03u", i);
+                property_list_remove(&l, key);
+        }
+
+        assert_se(property_list_size(&l) == 128);
+
+        for (i = 0; i < 256; i++) {
+                xsprintf(key, "KEY%03u", i);
+                assert_se(!property_list_get(&l, key) == (i % 2 == 0));
+        }
+
+        property_list_done(&l);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_set_get_remove();
+        test_to_nulstr();
+        test_many();
+
+        return 0;
+}
@@ -128,6 +128,47 @@ static void test_subsystem_filter(sd_device *device) {
         assert_se(sd_event_loop(sd_device_monitor_get_event(monitor_client)) == 0);
 }
 
+static int monitor_batch_handler(sd_device_monitor *m, sd_device **devices, size_t n_devices, void *userdata) {
+        size_t *n_received = userdata, i;
+        const char *s;
+
+        assert_se(n_devices > 0);
+
+        for (i = 0; i < n_devices; i++) {
+                assert_se(sd_device_get_syspath(devices[i], &s) >= 0);
+                log_info("Received device %s in batch of %zu", s, n_devices);
+        }
+
+        *n_received += n_devices;
+        if (*n_received >= 3)
+                return sd_event_exit(sd_device_monitor_get_event(m), 0);
+
+        return 0;
+}
+
+static void test_receive_batch(sd_device *device) {
+        _cleanup_(sd_device_monitor_unrefp) sd_device_monitor *monitor_server = NULL, *monitor_client = NULL;
+        size_t n_received = 0;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(device_monitor_new_full(&monitor_server, MONITOR_GROUP_NONE, -1) >= 0);
+        assert_se(sd_device_monitor_start(monitor_server, NULL, NULL) >= 0);
+        assert_se(sd_event_source_set_description(sd_device_monitor_get_event_source(monitor_server), "sender") >= 0);
+
+        assert_se(device_monitor_new_full(&monitor_client, MONITOR_GROUP_NONE, -1) >= 0);
+        assert_se(device_monitor_allow_unicast_sender(monitor_client, monitor_server) >= 0);
+        assert_se(sd_device_monitor_start_batch(monitor_client, monitor_batch_handler, &n_received) >= 0);
+        assert_se(sd_event_source_set_description(sd_device_monitor_get_event_source(monitor_client), "receiver") >= 0);
+
+        for (i = 0; i < 3; i++)
+                assert_se(device_monitor_send_device(monitor_server, monitor_client, device) >= 0);
+
+        assert_se(sd_event_loop(sd_device_monitor_get_event(monitor_client)) == 0);
+        assert_se(n_received == 3);
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(sd_device_unrefp) sd_device *loopback = NULL, *sda = NULL;
         int r;
@@ -156,6 +197,7 @@ int main(int argc, char *argv[]) {
         test_send_receive_one(loopback,  true,  true,  true);
 
         test_subsystem_filter(loopback);
+        test_receive_batch(loopback);
 
         r = sd_device_new_from_subsystem_sysname(&sda, "block", "sda");
         if (r < 0) {
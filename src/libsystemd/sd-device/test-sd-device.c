@@ -145,12 +145,57 @@ static void test_sd_device_enumerator_filter_subsystem(void) {
         }
 }
 
+static void test_sd_device_enumerator_filter_sysname(void) {
+        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+        unsigned n = 0;
+        sd_device *d;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_device_enumerator_new(&e) >= 0);
+        assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+
+        FOREACH_DEVICE(e, d) {
+                _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *f = NULL;
+                const char *syspath, *subsystem, *sysname, *s;
+                bool found = false;
+                sd_device *t;
+
+                if (sd_device_get_subsystem(d, &subsystem) < 0)
+                        continue;
+
+                assert_se(sd_device_get_syspath(d, &syspath) >= 0);
+                assert_se(sd_device_get_sysname(d, &sysname) >= 0);
+
+                /* Exact names are looked up directly, without reading the directories */
+                assert_se(sd_device_enumerator_new(&f) >= 0);
+                assert_se(sd_device_enumerator_allow_uninitialized(f) >= 0);
+                assert_se(sd_device_enumerator_add_match_subsystem(f, subsystem, true) >= 0);
+                assert_se(sd_device_enumerator_add_match_sysname(f, sysname) >= 0);
+
+                FOREACH_DEVICE(f, t) {
+                        assert_se(sd_device_get_sysname(t, &s) >= 0);
+                        assert_se(streq(s, sysname));
+
+                        assert_se(sd_device_get_syspath(t, &s) >= 0);
+                        if (streq(s, syspath))
+                                found = true;
+                }
+
+                assert_se(found);
+
+                if (++n >= 16)
+                        break;
+        }
+}
+
 int main(int argc, char **argv) {
         test_setup_logging(LOG_INFO);
 
         test_sd_device_enumerator_devices();
         test_sd_device_enumerator_subsystems();
         test_sd_device_enumerator_filter_subsystem();
+        test_sd_device_enumerator_filter_sysname();
 
         return 0;
 }
@@ -1,6 +1,7 @@
 #pragma once
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <pthread.h>
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 #include <sys/wait.h>
@@ -10,7 +11,9 @@
 #include "fs-util.h"
 #include "hashmap.h"
 #include "list.h"
+#include "mempool.h"
 #include "prioq.h"
+#include "ratelimit.h"
 
 typedef enum EventSourceType {
         SOURCE_IO,
@@ -26,6 +29,7 @@ typedef enum EventSourceType {
         SOURCE_EXIT,
         SOURCE_WATCHDOG,
         SOURCE_INOTIFY,
+        SOURCE_WORK,
         _SOURCE_EVENT_SOURCE_TYPE_MAX,
         _SOURCE_EVENT_SOURCE_TYPE_INVALID = -1
 } EventSourceType;
@@ -38,18 +42,32 @@ typedef enum WakeupType {
         WAKEUP_CLOCK_DATA,
         WAKEUP_SIGNAL_DATA,
         WAKEUP_INOTIFY_DATA,
+        WAKEUP_WORK_POOL,
         _WAKEUP_TYPE_MAX,
         _WAKEUP_TYPE_INVALID = -1,
 } WakeupType;
 
+#define WORK_THREADS_MAX 16U
+
+/* Where the work of a work event source currently is. Only changed with the mutex of the work pool held. */
+typedef enum WorkState {
+        WORK_IDLE,    /* not queued, or completed and picked up by the event loop */
+        WORK_QUEUED,  /* waiting in the queue of the work pool for a thread */
+        WORK_RUNNING, /* executed by a thread right now */
+        WORK_DONE,    /* completed, but not picked up by the event loop yet */
+} WorkState;
+
 struct inode_data;
 
+struct source_pool;
+
 struct sd_event_source {
         WakeupType wakeup;
 
         unsigned n_ref;
 
         sd_event *event;
+        struct source_pool *pool; /* The pool we were allocated from, or NULL if allocated with malloc() */
         void *userdata;
         sd_event_handler_t prepare;
 
@@ -60,6 +78,7 @@ struct sd_event_source {
         bool pending:1;
         bool dispatching:1;
         bool floating:1;
+        bool ratelimited:1;
 
         int64_t priority;
         unsigned pending_index;
@@ -69,6 +88,16 @@ struct sd_event_source {
 
         sd_event_destroy_t destroy_callback;
 
+        /* When the source was last marked pending, and what dispatching it took so far */
+        usec_t pending_timestamp;
+        sd_event_source_stats stats;
+
+        /* When dispatched more often than this, the source is taken offline until the interval is over, and
+         * then switched back to the state it had, or that was requested meanwhile. */
+        RateLimit rate_limit;
+        sd_event_source *ratelimit_timer;
+        signed int ratelimit_enabled:3;
+
         LIST_FIELDS(sd_event_source, sources);
 
         union {
@@ -85,6 +114,8 @@ struct sd_event_source {
                         usec_t next, accuracy;
                         unsigned earliest_index;
                         unsigned latest_index;
+                        struct time_bucket *bucket;
+                        LIST_FIELDS(sd_event_source, by_bucket);
                 } time;
                 struct {
                         sd_event_signal_handler_t callback;
@@ -96,6 +127,9 @@ struct sd_event_source {
                         siginfo_t siginfo;
                         pid_t pid;
                         int options;
+                        int pidfd; /* if we wait for the process to exit via epoll rather than SIGCHLD */
+                        bool registered:1;
+                        bool exited:1;
                 } child;
                 struct {
                         sd_event_handler_t callback;
@@ -112,10 +146,40 @@ struct sd_event_source {
                         uint32_t mask;
                         struct inode_data *inode_data;
                         LIST_FIELDS(sd_event_source, by_inode_data);
+
+                        /* If non-zero, events are collected for this long, and dispatched as one */
+                        uint64_t coalesce_usec;
+                        sd_event_source *coalesce_timer;
+                        uint32_t coalesced_mask;
+                        int coalesced_wd;
+                        unsigned n_coalesced;
+                        unsigned n_dispatched; /* how many events the event currently dispatched stands for */
                 } inotify;
+                struct {
+                        sd_event_work_t work;
+                        sd_event_work_handler_t callback;
+
+                        /* Everything below is protected by the mutex of the work pool */
+                        WorkState state;
+                        void *userdata;
+                        int64_t priority;
+                        uint64_t seqnum;
+                        unsigned prioq_index;
+                        int result;
+                        LIST_FIELDS(sd_event_source, done);
+                } work;
         };
 };
 
+/* Time sources with a coarse accuracy are not kept in the two priority queues of their clock, but grouped by the
+ * time we'd wake up for them, as chosen by sleep_between(). Since that time is aligned to shared boundaries, many
+ * sources end up in the same bucket, and (re)scheduling them is mostly a hashmap lookup. */
+struct time_bucket {
+        usec_t target;
+        unsigned prioq_index;
+        LIST_HEAD(sd_event_source, sources);
+};
+
 struct clock_data {
         WakeupType wakeup;
         int fd;
@@ -131,7 +195,12 @@ struct clock_data {
         Prioq *latest;
         usec_t next;
 
+        /* The buckets of coarse time sources, indexed by their target time, and ordered by it */
+        Hashmap *buckets;
+        Prioq *bucket_prioq;
+
         bool needs_rearm:1;
+        bool elapsed:1;
 };
 
 struct signal_data {
@@ -204,3 +273,35 @@ struct inotify_data {
          * to make it efficient to figure out what inotify objects to process data on next. */
         LIST_FIELDS(struct inotify_data, buffered);
 };
+
+/* The threads work event sources are executed in. Created the first time a work event source is added. */
+struct work_pool {
+        WakeupType wakeup;
+
+        /* An eventfd the threads signal when the list of completed work becomes non-empty */
+        int fd;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t queued_cond; /* signalled when work is queued, or the threads shall exit */
+        pthread_cond_t done_cond;   /* signalled when a thread finished running some work */
+
+        pthread_t threads[WORK_THREADS_MAX];
+        unsigned n_threads, n_threads_max, n_idle;
+        bool shutdown;
+
+        /* The work sources waiting for a thread, ordered by priority, and those with completed work */
+        Prioq *queue;
+        uint64_t seqnum;
+        LIST_HEAD(sd_event_source, done);
+};
+
+/* Event sources are allocated from a pool private to their event loop. Event sources may be referenced
+ * beyond the lifetime of their loop, hence the pool is only released once the last of them is gone. */
+struct source_pool {
+        struct mempool mempool;
+
+        unsigned n_used, n_used_max;
+        uint64_t n_allocated;
+
+        bool orphaned; /* the event loop is gone */
+};
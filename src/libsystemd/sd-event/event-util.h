@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include "sd-event.h"
@@ -11,3 +12,9 @@ int event_reset_time(sd_event *e, sd_event_source **s,
                      int64_t priority, const char *description, bool force_reset);
 int event_source_disable(sd_event_source *s);
 int event_source_is_enabled(sd_event_source *s);
+
+typedef int (*event_source_handler_t)(sd_event_source *s, void *userdata);
+int event_foreach_source(sd_event *e, event_source_handler_t callback, void *userdata);
+const char *event_source_get_type_name(sd_event_source *s);
+
+int event_get_source_pool_stats(sd_event *e, unsigned *ret_n_used, unsigned *ret_n_used_max, uint64_t *ret_n_allocated);
@@ -1,6 +1,8 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <pthread.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/timerfd.h>
 #include <sys/wait.h>
 
@@ -9,7 +11,9 @@
 #include "sd-id128.h"
 
 #include "alloc-util.h"
+#include "env-util.h"
 #include "event-source.h"
+#include "event-util.h"
 #include "fd-util.h"
 #include "fs-util.h"
 #include "hashmap.h"
@@ -41,12 +45,22 @@ static const char* const event_source_type_table[_SOURCE_EVENT_SOURCE_TYPE_MAX]
         [SOURCE_EXIT] = "exit",
         [SOURCE_WATCHDOG] = "watchdog",
         [SOURCE_INOTIFY] = "inotify",
+        [SOURCE_WORK] = "work",
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(event_source_type, int);
 
+/* The watchdog latency histogram has four buckets per power of two, and covers latencies up to 2^40µs (~12d).
+ * Latencies below 4µs get a bucket each. */
+#define WATCHDOG_LATENCY_SUB_BUCKETS 4U
+#define WATCHDOG_LATENCY_BUCKETS (WATCHDOG_LATENCY_SUB_BUCKETS * 40U)
+
 #define EVENT_SOURCE_IS_TIME(t) IN_SET((t), SOURCE_TIME_REALTIME, SOURCE_TIME_BOOTTIME, SOURCE_TIME_MONOTONIC, SOURCE_TIME_REALTIME_ALARM, SOURCE_TIME_BOOTTIME_ALARM)
 
+/* Child sources need to be reaped, and inotify and work sources share their state with other sources, hence those
+ * are not rate limited, and neither are post and exit sources. */
+#define EVENT_SOURCE_CAN_RATE_LIMIT(t) (IN_SET((t), SOURCE_IO, SOURCE_SIGNAL, SOURCE_DEFER) || EVENT_SOURCE_IS_TIME(t))
+
 struct sd_event {
         unsigned n_ref;
 
@@ -79,6 +93,10 @@ struct sd_event {
 
         Hashmap *inotify_data; /* indexed by priority */
 
+        struct work_pool *work_pool;
+
+        struct source_pool *source_pool;
+
         /* A list of inode structures that still have an fd open, that we need to close before the next loop iteration */
         LIST_HEAD(struct inode_data, inode_data_to_close);
 
@@ -94,7 +112,9 @@ struct sd_event {
         bool exit_requested:1;
         bool need_process_child:1;
         bool watchdog:1;
+        bool watchdog_notify_latency:1;
         bool profile_delays:1;
+        bool source_stats:1;
 
         int exit_code;
 
@@ -103,6 +123,16 @@ struct sd_event {
 
         usec_t watchdog_last, watchdog_period;
 
+        /* When the watchdog timer was armed for, and how late we were pinging the service manager compared
+         * to that */
+        usec_t watchdog_next;
+        unsigned watchdog_latency[WATCHDOG_LATENCY_BUCKETS];
+        unsigned n_watchdog_latency;
+        usec_t watchdog_latency_max;
+
+        /* How many pending sources of the same priority to dispatch per iteration at most */
+        unsigned dispatch_batch;
+
         unsigned n_sources;
 
         LIST_HEAD(sd_event_source, sources);
@@ -115,6 +145,7 @@ static thread_local sd_event *default_event = NULL;
 
 static void source_disconnect(sd_event_source *s);
 static void event_gc_inode_data(sd_event *e, struct inode_data *d);
+static usec_t sleep_between(sd_event *e, usec_t a, usec_t b);
 
 static sd_event *event_resolve(sd_event *e) {
         return e == SD_EVENT_DEFAULT ? default_event : e;
@@ -214,6 +245,12 @@ static int latest_time_prioq_compare(const void *a, const void *b) {
         return CMP(time_event_source_latest(x), time_event_source_latest(y));
 }
 
+static int time_bucket_prioq_compare(const void *a, const void *b) {
+        const struct time_bucket *x = a, *y = b;
+
+        return CMP(x->target, y->target);
+}
+
 static int exit_prioq_compare(const void *a, const void *b) {
         const sd_event_source *x = a, *y = b;
 
@@ -230,6 +267,14 @@ static int exit_prioq_compare(const void *a, const void *b) {
         return CMP(x->priority, y->priority);
 }
 
+static struct source_pool *source_pool_free(struct source_pool *p) {
+        if (!p)
+                return NULL;
+
+        mempool_drop(&p->mempool);
+        return mfree(p);
+}
+
 static void free_clock_data(struct clock_data *d) {
         assert(d);
         assert(d->wakeup == WAKEUP_CLOCK_DATA);
@@ -237,6 +282,199 @@ static void free_clock_data(struct clock_data *d) {
         safe_close(d->fd);
         prioq_free(d->earliest);
         prioq_free(d->latest);
+
+        /* Buckets are released with their last source, hence only the containers are left */
+        assert(hashmap_isempty(d->buckets));
+        hashmap_free(d->buckets);
+        prioq_free(d->bucket_prioq);
+}
+
+static int work_prioq_compare(const void *a, const void *b) {
+        const sd_event_source *x = a, *y = b;
+        int r;
+
+        assert(x->type == SOURCE_WORK);
+        assert(y->type == SOURCE_WORK);
+
+        /* Lower priority values first */
+        r = CMP(x->work.priority, y->work.priority);
+        if (r != 0)
+                return r;
+
+        /* Older entries first */
+        return CMP(x->work.seqnum, y->work.seqnum);
+}
+
+static void *work_thread(void *p) {
+        struct work_pool *w = p;
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+        for (;;) {
+                sd_event_source *s;
+                sd_event_work_t work;
+                void *userdata;
+                int r;
+
+                while (!w->shutdown && prioq_isempty(w->queue)) {
+                        w->n_idle++;
+                        assert_se(pthread_cond_wait(&w->queued_cond, &w->mutex) == 0);
+                        w->n_idle--;
+                }
+
+                if (w->shutdown)
+                        break;
+
+                assert_se(s = prioq_pop(w->queue));
+                s->work.prioq_index = PRIOQ_IDX_NULL;
+                s->work.state = WORK_RUNNING;
+                work = s->work.work;
+                userdata = s->work.userdata;
+
+                /* The event source can't go away while we run its work without the lock held, as
+                 * work_source_cancel() waits for us. */
+                assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+                r = work(userdata);
+                assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+                s->work.result = r;
+                s->work.state = WORK_DONE;
+
+                /* Only wake up the event loop if it doesn't have to process anything else yet */
+                if (!w->done)
+                        (void) eventfd_write(w->fd, 1);
+
+                LIST_PREPEND(work.done, w->done, s);
+                assert_se(pthread_cond_broadcast(&w->done_cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        return NULL;
+}
+
+static int work_pool_start_thread(struct work_pool *w) {
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(w);
+
+        /* Called with the mutex held. Only start another thread if all running ones are busy. */
+        if (prioq_size(w->queue) <= w->n_idle || w->n_threads >= w->n_threads_max)
+                return 0;
+
+        assert_se(sigfillset(&ss) >= 0);
+
+        /* No signals in the worker threads please, just like sd-resolve does it */
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        r = pthread_create(&w->threads[w->n_threads], NULL, work_thread, w);
+        if (r > 0)
+                r = -r;
+        else
+                w->n_threads++;
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (k > 0 && r >= 0)
+                r = -k;
+
+        return r;
+}
+
+static struct work_pool *work_pool_free(sd_event *e, struct work_pool *w) {
+        unsigned i;
+
+        assert(e);
+
+        if (!w)
+                return NULL;
+
+        assert(w->wakeup == WAKEUP_WORK_POOL);
+
+        /* After fork() the threads are gone, and the mutex might have been taken by one of them, hence leave
+         * everything but the memory we own alone. */
+        if (e->original_pid == getpid_cached()) {
+                assert_se(pthread_mutex_lock(&w->mutex) == 0);
+                w->shutdown = true;
+                assert_se(pthread_cond_broadcast(&w->queued_cond) == 0);
+                assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+                for (i = 0; i < w->n_threads; i++)
+                        (void) pthread_join(w->threads[i], NULL);
+
+                /* All work sources have been disconnected before, which took them out of both lists */
+                assert(prioq_isempty(w->queue));
+                assert(!w->done);
+
+                (void) pthread_cond_destroy(&w->queued_cond);
+                (void) pthread_cond_destroy(&w->done_cond);
+                (void) pthread_mutex_destroy(&w->mutex);
+        }
+
+        safe_close(w->fd);
+        prioq_free(w->queue);
+
+        return mfree(w);
+}
+
+static int event_make_work_pool(sd_event *e) {
+        struct epoll_event ev;
+        struct work_pool *w;
+        long n;
+        int r;
+
+        assert(e);
+
+        if (e->work_pool)
+                return 0;
+
+        w = new(struct work_pool, 1);
+        if (!w)
+                return -ENOMEM;
+
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+
+        *w = (struct work_pool) {
+                .wakeup = WAKEUP_WORK_POOL,
+                .fd = -1,
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .queued_cond = PTHREAD_COND_INITIALIZER,
+                .done_cond = PTHREAD_COND_INITIALIZER,
+                .n_threads_max = n > 0 ? MIN((unsigned) n, WORK_THREADS_MAX) : 1,
+        };
+
+        w->queue = prioq_new(work_prioq_compare);
+        if (!w->queue) {
+                free(w);
+                return -ENOMEM;
+        }
+
+        w->fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (w->fd < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        ev = (struct epoll_event) {
+                .events = EPOLLIN,
+                .data.ptr = w,
+        };
+
+        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, w->fd, &ev) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        e->work_pool = w;
+        return 0;
+
+fail:
+        safe_close(w->fd);
+        prioq_free(w->queue);
+        free(w);
+        return r;
 }
 
 static sd_event *event_free(sd_event *e) {
@@ -273,6 +511,19 @@ static sd_event *event_free(sd_event *e) {
 
         hashmap_free(e->inotify_data);
 
+        work_pool_free(e, e->work_pool);
+
+        if (e->source_pool) {
+                log_debug("Event loop allocated %" PRIu64 " event sources from its pool, at most %u at a time.",
+                          e->source_pool->n_allocated, e->source_pool->n_used_max);
+
+                /* Sources that are still referenced release the pool when they are freed */
+                if (e->source_pool->n_used > 0)
+                        e->source_pool->orphaned = true;
+                else
+                        source_pool_free(e->source_pool);
+        }
+
         hashmap_free(e->child_sources);
         set_free(e->post_sources);
 
@@ -293,6 +544,7 @@ _public_ int sd_event_new(sd_event** ret) {
                 .n_ref = 1,
                 .epoll_fd = -1,
                 .watchdog_fd = -1,
+                .watchdog_notify_latency = true,
                 .realtime.wakeup = WAKEUP_CLOCK_DATA,
                 .realtime.fd = -1,
                 .realtime.next = USEC_INFINITY,
@@ -397,6 +649,50 @@ static int source_io_register(
         return 0;
 }
 
+static void source_child_pidfd_unregister(sd_event_source *s) {
+        int r;
+
+        assert(s);
+        assert(s->type == SOURCE_CHILD);
+
+        if (event_pid_changed(s->event))
+                return;
+
+        if (!s->child.registered)
+                return;
+
+        r = epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->child.pidfd, NULL);
+        if (r < 0)
+                log_debug_errno(errno, "Failed to remove source %s (type %s) from epoll: %m",
+                                strna(s->description), event_source_type_to_string(s->type));
+
+        s->child.registered = false;
+}
+
+static int source_child_pidfd_register(sd_event_source *s) {
+        struct epoll_event ev;
+
+        assert(s);
+        assert(s->type == SOURCE_CHILD);
+        assert(s->child.pidfd >= 0);
+
+        /* Once the process is reaped the pidfd stays readable forever, there's nothing to wait for anymore */
+        if (s->child.registered || s->child.exited)
+                return 0;
+
+        ev = (struct epoll_event) {
+                .events = EPOLLIN,
+                .data.ptr = s,
+        };
+
+        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_ADD, s->child.pidfd, &ev) < 0)
+                return -errno;
+
+        s->child.registered = true;
+
+        return 0;
+}
+
 static clockid_t event_source_type_to_clock(EventSourceType t) {
 
         switch (t) {
@@ -642,6 +938,288 @@ static void event_gc_signal_data(sd_event *e, const int64_t *priority, int sig)
                 event_unmask_signal_data(e, d, sig);
 }
 
+static bool time_source_is_coarse(const sd_event_source *s) {
+        /* With an accuracy of at least the finest step of sleep_between(), the time we wake up for a source lies
+         * on a grid shared by all other such sources, which makes it worth grouping them by that */
+        return s->time.accuracy >= 250 * USEC_PER_MSEC;
+}
+
+static void time_bucket_remove(struct clock_data *d, sd_event_source *s) {
+        struct time_bucket *b;
+
+        assert(d);
+        assert(s);
+
+        b = s->time.bucket;
+        if (!b)
+                return;
+
+        LIST_REMOVE(time.by_bucket, b->sources, s);
+        s->time.bucket = NULL;
+
+        if (b->sources)
+                return;
+
+        assert_se(hashmap_remove(d->buckets, &b->target) == b);
+        assert_se(prioq_remove(d->bucket_prioq, b, &b->prioq_index) > 0);
+        free(b);
+}
+
+static int time_bucket_add(struct clock_data *d, sd_event_source *s, usec_t target) {
+        struct time_bucket *b;
+        int r;
+
+        assert(d);
+        assert(s);
+        assert(!s->time.bucket);
+
+        b = hashmap_get(d->buckets, &target);
+        if (!b) {
+                r = hashmap_ensure_allocated(&d->buckets, &uint64_hash_ops);
+                if (r < 0)
+                        return r;
+
+                r = prioq_ensure_allocated(&d->bucket_prioq, time_bucket_prioq_compare);
+                if (r < 0)
+                        return r;
+
+                b = new0(struct time_bucket, 1);
+                if (!b)
+                        return -ENOMEM;
+
+                b->target = target;
+                b->prioq_index = PRIOQ_IDX_NULL;
+
+                r = hashmap_put(d->buckets, &b->target, b);
+                if (r < 0) {
+                        free(b);
+                        return r;
+                }
+
+                r = prioq_put(d->bucket_prioq, b, &b->prioq_index);
+                if (r < 0) {
+                        hashmap_remove(d->buckets, &b->target);
+                        free(b);
+                        return r;
+                }
+        }
+
+        LIST_PREPEND(time.by_bucket, b->sources, s);
+        s->time.bucket = b;
+
+        return 0;
+}
+
+static int time_source_prioq_put(struct clock_data *d, sd_event_source *s) {
+        int r;
+
+        assert(d);
+        assert(s);
+
+        if (s->time.earliest_index != PRIOQ_IDX_NULL) {
+                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
+                prioq_reshuffle(d->latest, s, &s->time.latest_index);
+                return 0;
+        }
+
+        r = prioq_put(d->earliest, s, &s->time.earliest_index);
+        if (r < 0)
+                return r;
+
+        r = prioq_put(d->latest, s, &s->time.latest_index);
+        if (r < 0) {
+                assert_se(prioq_remove(d->earliest, s, &s->time.earliest_index) > 0);
+                s->time.earliest_index = PRIOQ_IDX_NULL;
+                return r;
+        }
+
+        return 0;
+}
+
+static void time_source_prioq_remove(struct clock_data *d, sd_event_source *s) {
+        assert(d);
+        assert(s);
+
+        if (s->time.earliest_index == PRIOQ_IDX_NULL)
+                return;
+
+        prioq_remove(d->earliest, s, &s->time.earliest_index);
+        prioq_remove(d->latest, s, &s->time.latest_index);
+        s->time.earliest_index = s->time.latest_index = PRIOQ_IDX_NULL;
+}
+
+static void time_source_unlink(struct clock_data *d, sd_event_source *s) {
+        assert(d);
+        assert(s);
+
+        time_bucket_remove(d, s);
+        time_source_prioq_remove(d, s);
+        d->needs_rearm = true;
+}
+
+static int time_source_reshuffle(sd_event_source *s) {
+        struct clock_data *d;
+        int r;
+
+        assert(s);
+        assert(EVENT_SOURCE_IS_TIME(s->type));
+
+        /* Updates the position of a time source after its time, accuracy, enabled or pending state changed */
+
+        d = event_get_clock_data(s->event, s->type);
+        assert(d);
+
+        d->needs_rearm = true;
+
+        time_bucket_remove(d, s);
+
+        if (time_source_is_coarse(s)) {
+                /* Coarse sources are only bucketed while they may be dispatched, i.e. are not kept anywhere if
+                 * disabled, pending already or set to never elapse */
+                time_source_prioq_remove(d, s);
+
+                if (s->enabled == SD_EVENT_OFF || s->pending || s->time.next == USEC_INFINITY)
+                        return 0;
+
+                r = time_bucket_add(d, s, sleep_between(s->event, s->time.next, time_event_source_latest(s)));
+                if (r >= 0)
+                        return 0;
+
+                /* If we can't allocate a bucket, the priority queues will do too */
+        }
+
+        return time_source_prioq_put(d, s);
+}
+
+static int work_source_update(sd_event_source *s) {
+        struct work_pool *w;
+        int r = 0;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+        assert_se(w = s->event->work_pool);
+
+        /* Queues the work of enabled sources that neither have it queued or running, nor a completion
+         * pending, and takes the work of disabled sources out of the queue again. Work that is already
+         * running can't be stopped, its completion is dropped if the source is still disabled by then. */
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+        if (s->enabled == SD_EVENT_OFF) {
+                if (s->work.state == WORK_QUEUED) {
+                        assert_se(prioq_remove(w->queue, s, &s->work.prioq_index));
+                        s->work.prioq_index = PRIOQ_IDX_NULL;
+                        s->work.state = WORK_IDLE;
+                }
+
+        } else if (s->work.state == WORK_IDLE && !s->pending) {
+                s->work.userdata = s->userdata;
+                s->work.priority = s->priority;
+                s->work.seqnum = w->seqnum++;
+
+                r = prioq_put(w->queue, s, &s->work.prioq_index);
+                if (r >= 0) {
+                        s->work.state = WORK_QUEUED;
+
+                        r = work_pool_start_thread(w);
+                        if (r < 0 && w->n_threads > 0)
+                                r = 0; /* Not fatal, the threads we have will get to it eventually */
+                        if (r < 0) {
+                                assert_se(prioq_remove(w->queue, s, &s->work.prioq_index));
+                                s->work.prioq_index = PRIOQ_IDX_NULL;
+                                s->work.state = WORK_IDLE;
+                        } else
+                                assert_se(pthread_cond_signal(&w->queued_cond) == 0);
+                }
+        }
+
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        return r;
+}
+
+static void work_source_reshuffle(sd_event_source *s) {
+        struct work_pool *w;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+        assert_se(w = s->event->work_pool);
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+        s->work.priority = s->priority;
+        if (s->work.state == WORK_QUEUED)
+                prioq_reshuffle(w->queue, s, &s->work.prioq_index);
+
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+}
+
+static void work_source_cancel(sd_event_source *s) {
+        struct work_pool *w;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+        assert_se(w = s->event->work_pool);
+
+        /* See work_pool_free() */
+        if (event_pid_changed(s->event))
+                return;
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+        /* Work that is running already can't be interrupted, hence wait for it to finish, as the thread still
+         * references the event source and the userdata */
+        while (s->work.state == WORK_RUNNING)
+                assert_se(pthread_cond_wait(&w->done_cond, &w->mutex) == 0);
+
+        if (s->work.state == WORK_QUEUED) {
+                assert_se(prioq_remove(w->queue, s, &s->work.prioq_index));
+                s->work.prioq_index = PRIOQ_IDX_NULL;
+        } else if (s->work.state == WORK_DONE)
+                LIST_REMOVE(work.done, w->done, s);
+
+        s->work.state = WORK_IDLE;
+
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+}
+
+static void source_internal_timer_free(sd_event_source **timer) {
+        sd_event_source *t;
+
+        assert(timer);
+
+        t = TAKE_PTR(*timer);
+        if (!t)
+                return;
+
+        /* Internal timers are floating, so that they don't keep the event loop alive, hence as long as they
+         * are still connected, the event loop holds a reference to them, too. */
+        if (t->event) {
+                source_disconnect(t);
+                sd_event_source_unref(t);
+        }
+
+        sd_event_source_unref(t);
+}
+
+static void source_inotify_coalesce_timer_free(sd_event_source *s) {
+        assert(s);
+        assert(s->type == SOURCE_INOTIFY);
+
+        source_internal_timer_free(&s->inotify.coalesce_timer);
+}
+
+static void source_inotify_coalesce_reset(sd_event_source *s) {
+        assert(s);
+        assert(s->type == SOURCE_INOTIFY);
+
+        s->inotify.coalesced_mask = 0;
+        s->inotify.n_coalesced = 0;
+
+        if (s->inotify.coalesce_timer)
+                (void) sd_event_source_set_enabled(s->inotify.coalesce_timer, SD_EVENT_OFF);
+}
+
 static void source_disconnect(sd_event_source *s) {
         sd_event *event;
 
@@ -670,9 +1248,7 @@ static void source_disconnect(sd_event_source *s) {
                 d = event_get_clock_data(s->event, s->type);
                 assert(d);
 
-                prioq_remove(d->earliest, s, &s->time.earliest_index);
-                prioq_remove(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
+                time_source_unlink(d, s);
                 break;
         }
 
@@ -689,7 +1265,10 @@ static void source_disconnect(sd_event_source *s) {
 
         case SOURCE_CHILD:
                 if (s->child.pid > 0) {
-                        if (s->enabled != SD_EVENT_OFF) {
+                        if (s->child.pidfd >= 0) {
+                                source_child_pidfd_unregister(s);
+                                s->child.pidfd = safe_close(s->child.pidfd);
+                        } else if (s->enabled != SD_EVENT_OFF) {
                                 assert(s->event->n_enabled_child_sources > 0);
                                 s->event->n_enabled_child_sources--;
                         }
@@ -724,7 +1303,8 @@ static void source_disconnect(sd_event_source *s) {
                         LIST_REMOVE(inotify.by_inode_data, inode_data->event_sources, s);
                         s->inotify.inode_data = NULL;
 
-                        if (s->pending) {
+                        /* Coalesced events were dropped from the buffer already, see source_inotify_coalesce() */
+                        if (s->pending && s->inotify.coalesce_usec == 0) {
                                 assert(inotify_data->n_pending > 0);
                                 inotify_data->n_pending--;
                         }
@@ -744,13 +1324,21 @@ static void source_disconnect(sd_event_source *s) {
                         event_gc_inode_data(s->event, inode_data);
                 }
 
+                source_inotify_coalesce_timer_free(s);
                 break;
         }
 
+        case SOURCE_WORK:
+                work_source_cancel(s);
+                break;
+
         default:
                 assert_not_reached("Wut? I shouldn't exist.");
         }
 
+        source_internal_timer_free(&s->ratelimit_timer);
+        s->ratelimited = false;
+
         if (s->pending)
                 prioq_remove(s->event->pending, s, &s->pending_index);
 
@@ -780,7 +1368,19 @@ static void source_free(sd_event_source *s) {
                 s->destroy_callback(s->userdata);
 
         free(s->description);
-        free(s);
+
+        if (s->pool) {
+                struct source_pool *p = s->pool;
+
+                mempool_free_tile(&p->mempool, s);
+
+                assert(p->n_used > 0);
+                p->n_used--;
+
+                if (p->orphaned && p->n_used == 0)
+                        source_pool_free(p);
+        } else
+                free(s);
 }
 DEFINE_TRIVIAL_CLEANUP_FUNC(sd_event_source*, source_free);
 
@@ -798,6 +1398,10 @@ static int source_set_pending(sd_event_source *s, bool b) {
         if (b) {
                 s->pending_iteration = s->event->iteration;
 
+                /* Reading the clock on every state change of every source isn't free, hence only do so when
+                 * somebody asked for the statistics */
+                s->pending_timestamp = s->event->source_stats ? now(CLOCK_MONOTONIC) : 0;
+
                 r = prioq_put(s->event->pending, s, &s->pending_index);
                 if (r < 0) {
                         s->pending = false;
@@ -807,14 +1411,9 @@ static int source_set_pending(sd_event_source *s, bool b) {
                 assert_se(prioq_remove(s->event->pending, s, &s->pending_index));
 
         if (EVENT_SOURCE_IS_TIME(s->type)) {
-                struct clock_data *d;
-
-                d = event_get_clock_data(s->event, s->type);
-                assert(d);
-
-                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
+                r = time_source_reshuffle(s);
+                if (r < 0)
+                        return r;
         }
 
         if (s->type == SOURCE_SIGNAL && !b) {
@@ -825,7 +1424,7 @@ static int source_set_pending(sd_event_source *s, bool b) {
                         d->current = NULL;
         }
 
-        if (s->type == SOURCE_INOTIFY) {
+        if (s->type == SOURCE_INOTIFY && s->inotify.coalesce_usec == 0) {
 
                 assert(s->inotify.inode_data);
                 assert(s->inotify.inode_data->inotify_data);
@@ -841,18 +1440,67 @@ static int source_set_pending(sd_event_source *s, bool b) {
         return 0;
 }
 
+static bool source_pool_enabled(void) {
+        static int b = -1;
+
+        /* Unlike the global mempool used by hashmaps, each pool is private to an event loop, and hence
+         * safe to use from any thread and in libsystemd, too. It may still be turned off, to make
+         * debugging allocations with valgrind easier. */
+
+        if (b < 0)
+                b = getenv_bool("SYSTEMD_MEMPOOL") != 0;
+
+        return b;
+}
+
+static struct source_pool *event_get_source_pool(sd_event *e) {
+        struct source_pool *p;
+
+        assert(e);
+
+        if (e->source_pool)
+                return e->source_pool;
+
+        if (!source_pool_enabled())
+                return NULL;
+
+        p = new(struct source_pool, 1);
+        if (!p)
+                return NULL; /* Fall back to malloc() for this source */
+
+        *p = (struct source_pool) {
+                .mempool.tile_size = sizeof(sd_event_source),
+                .mempool.at_least = 16,
+        };
+
+        return (e->source_pool = p);
+}
+
 static sd_event_source *source_new(sd_event *e, bool floating, EventSourceType type) {
+        struct source_pool *p;
         sd_event_source *s;
 
         assert(e);
 
-        s = new(sd_event_source, 1);
-        if (!s)
-                return NULL;
+        p = event_get_source_pool(e);
+        if (p) {
+                s = mempool_alloc_tile(&p->mempool);
+                if (!s)
+                        return NULL;
+
+                p->n_allocated++;
+                p->n_used++;
+                p->n_used_max = MAX(p->n_used_max, p->n_used);
+        } else {
+                s = new(sd_event_source, 1);
+                if (!s)
+                        return NULL;
+        }
 
         *s = (struct sd_event_source) {
                 .n_ref = 1,
                 .event = e,
+                .pool = p,
                 .floating = floating,
                 .type = type,
                 .pending_index = PRIOQ_IDX_NULL,
@@ -1027,13 +1675,7 @@ _public_ int sd_event_add_time(
         s->userdata = userdata;
         s->enabled = SD_EVENT_ONESHOT;
 
-        d->needs_rearm = true;
-
-        r = prioq_put(d->earliest, s, &s->time.earliest_index);
-        if (r < 0)
-                return r;
-
-        r = prioq_put(d->latest, s, &s->time.latest_index);
+        r = time_source_reshuffle(s);
         if (r < 0)
                 return r;
 
@@ -1141,9 +1783,11 @@ _public_ int sd_event_add_child(
         if (!s)
                 return -ENOMEM;
 
+        s->wakeup = WAKEUP_EVENT_SOURCE;
         s->child.pid = pid;
         s->child.options = options;
         s->child.callback = callback;
+        s->child.pidfd = -1;
         s->userdata = userdata;
         s->enabled = SD_EVENT_ONESHOT;
 
@@ -1151,6 +1795,24 @@ _public_ int sd_event_add_child(
         if (r < 0)
                 return r;
 
+        /* A pidfd only becomes readable when the process exited, hence don't bother if the caller is
+         * interested in other state changes, too. If the kernel doesn't know pidfds, or the process doesn't
+         * exist (anymore), fall back to checking on the process each time SIGCHLD is seen. */
+        if (options == WEXITED) {
+                s->child.pidfd = pidfd_open(pid, 0);
+                if (s->child.pidfd >= 0) {
+                        r = source_child_pidfd_register(s);
+                        if (r < 0)
+                                return r;
+
+                        if (ret)
+                                *ret = s;
+                        TAKE_PTR(s);
+
+                        return 0;
+                }
+        }
+
         e->n_enabled_child_sources++;
 
         r = event_make_signal_data(e, SIGCHLD, NULL);
@@ -1279,6 +1941,48 @@ _public_ int sd_event_add_exit(
         return 0;
 }
 
+_public_ int sd_event_add_work(
+                sd_event *e,
+                sd_event_source **ret,
+                sd_event_work_t work,
+                sd_event_work_handler_t callback,
+                void *userdata) {
+
+        _cleanup_(source_freep) sd_event_source *s = NULL;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(work, -EINVAL);
+        assert_return(callback, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        r = event_make_work_pool(e);
+        if (r < 0)
+                return r;
+
+        s = source_new(e, !ret, SOURCE_WORK);
+        if (!s)
+                return -ENOMEM;
+
+        s->work.work = work;
+        s->work.callback = callback;
+        s->work.prioq_index = PRIOQ_IDX_NULL;
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ONESHOT;
+
+        r = work_source_update(s);
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = s;
+        TAKE_PTR(s);
+
+        return 0;
+}
+
 static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
         assert(e);
 
@@ -1686,6 +2390,60 @@ _public_ int sd_event_source_set_description(sd_event_source *s, const char *des
         return free_and_strdup(&s->description, description);
 }
 
+_public_ int sd_event_source_get_stats(sd_event_source *s, sd_event_source_stats *ret, size_t size) {
+        assert_return(s, -EINVAL);
+        assert_return(ret, -EINVAL);
+        /* Callers built against an older version of the structure pass a smaller size, and get the fields they
+         * know about. Callers built against a newer version get the fields we don't know about zeroed. The
+         * first version ended with pending_max_usec. */
+        assert_return(size >= offsetof(sd_event_source_stats, pending_max_usec) + sizeof(uint64_t), -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        memcpy(ret, &s->stats, MIN(size, sizeof(s->stats)));
+        if (size > sizeof(s->stats))
+                memzero((uint8_t*) ret + sizeof(s->stats), size - sizeof(s->stats));
+
+        return 0;
+}
+
+int event_foreach_source(sd_event *e, event_source_handler_t callback, void *userdata) {
+        sd_event_source *s;
+        int r;
+
+        assert(e);
+        assert(callback);
+
+        LIST_FOREACH(sources, s, e->sources) {
+                r = callback(s, userdata);
+                if (r != 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+const char *event_source_get_type_name(sd_event_source *s) {
+        assert(s);
+
+        return event_source_type_to_string(s->type);
+}
+
+int event_get_source_pool_stats(sd_event *e, unsigned *ret_n_used, unsigned *ret_n_used_max, uint64_t *ret_n_allocated) {
+        assert(e);
+
+        if (!e->source_pool)
+                return -ENODATA;
+
+        if (ret_n_used)
+                *ret_n_used = e->source_pool->n_used;
+        if (ret_n_used_max)
+                *ret_n_used_max = e->source_pool->n_used_max;
+        if (ret_n_allocated)
+                *ret_n_allocated = e->source_pool->n_allocated;
+
+        return 0;
+}
+
 _public_ int sd_event_source_get_description(sd_event_source *s, const char **description) {
         assert_return(s, -EINVAL);
         assert_return(description, -EINVAL);
@@ -1931,6 +2689,9 @@ _public_ int sd_event_source_set_priority(sd_event_source *s, int64_t priority)
         if (s->type == SOURCE_EXIT)
                 prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
 
+        if (s->type == SOURCE_WORK)
+                work_source_reshuffle(s);
+
         return 0;
 
 fail:
@@ -1947,22 +2708,21 @@ _public_ int sd_event_source_get_enabled(sd_event_source *s, int *m) {
         assert_return(s, -EINVAL);
         assert_return(!event_pid_changed(s->event), -ECHILD);
 
+        if (s->ratelimited) {
+                if (m)
+                        *m = s->ratelimit_enabled;
+                return s->ratelimit_enabled != SD_EVENT_OFF;
+        }
+
         if (m)
                 *m = s->enabled;
         return s->enabled != SD_EVENT_OFF;
 }
 
-_public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
+static int source_set_enabled(sd_event_source *s, int m, bool keep_pending) {
         int r;
 
-        assert_return(s, -EINVAL);
-        assert_return(IN_SET(m, SD_EVENT_OFF, SD_EVENT_ON, SD_EVENT_ONESHOT), -EINVAL);
-        assert_return(!event_pid_changed(s->event), -ECHILD);
-
-        /* If we are dead anyway, we are fine with turning off
-         * sources, but everything else needs to fail. */
-        if (s->event->state == SD_EVENT_FINISHED)
-                return m == SD_EVENT_OFF ? 0 : -ESTALE;
+        assert(s);
 
         if (s->enabled == m)
                 return 0;
@@ -1970,7 +2730,7 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
         if (m == SD_EVENT_OFF) {
 
                 /* Unset the pending flag when this event source is disabled */
-                if (!IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
+                if (!keep_pending && !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
                         r = source_set_pending(s, false);
                         if (r < 0)
                                 return r;
@@ -1987,18 +2747,13 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_TIME_BOOTTIME:
                 case SOURCE_TIME_MONOTONIC:
                 case SOURCE_TIME_REALTIME_ALARM:
-                case SOURCE_TIME_BOOTTIME_ALARM: {
-                        struct clock_data *d;
-
+                case SOURCE_TIME_BOOTTIME_ALARM:
                         s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
 
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
+                        r = time_source_reshuffle(s);
+                        if (r < 0)
+                                return r;
                         break;
-                }
 
                 case SOURCE_SIGNAL:
                         s->enabled = m;
@@ -2009,6 +2764,11 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_CHILD:
                         s->enabled = m;
 
+                        if (s->child.pidfd >= 0) {
+                                source_child_pidfd_unregister(s);
+                                break;
+                        }
+
                         assert(s->event->n_enabled_child_sources > 0);
                         s->event->n_enabled_child_sources--;
 
@@ -2022,8 +2782,22 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
 
                 case SOURCE_DEFER:
                 case SOURCE_POST:
+                        s->enabled = m;
+                        break;
+
                 case SOURCE_INOTIFY:
                         s->enabled = m;
+
+                        if (s->inotify.coalesce_timer)
+                                (void) sd_event_source_set_enabled(s->inotify.coalesce_timer, SD_EVENT_OFF);
+                        break;
+
+                case SOURCE_WORK:
+                        s->enabled = m;
+
+                        r = work_source_update(s);
+                        if (r < 0)
+                                return r;
                         break;
 
                 default:
@@ -2033,7 +2807,7 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
         } else {
 
                 /* Unset the pending flag when this event source is enabled */
-                if (s->enabled == SD_EVENT_OFF && !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
+                if (!keep_pending && s->enabled == SD_EVENT_OFF && !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
                         r = source_set_pending(s, false);
                         if (r < 0)
                                 return r;
@@ -2053,18 +2827,13 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_TIME_BOOTTIME:
                 case SOURCE_TIME_MONOTONIC:
                 case SOURCE_TIME_REALTIME_ALARM:
-                case SOURCE_TIME_BOOTTIME_ALARM: {
-                        struct clock_data *d;
-
+                case SOURCE_TIME_BOOTTIME_ALARM:
                         s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
 
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
+                        r = time_source_reshuffle(s);
+                        if (r < 0)
+                                return r;
                         break;
-                }
 
                 case SOURCE_SIGNAL:
 
@@ -2081,6 +2850,15 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
 
                 case SOURCE_CHILD:
 
+                        if (s->child.pidfd >= 0) {
+                                r = source_child_pidfd_register(s);
+                                if (r < 0)
+                                        return r;
+
+                                s->enabled = m;
+                                break;
+                        }
+
                         if (s->enabled == SD_EVENT_OFF)
                                 s->event->n_enabled_child_sources++;
 
@@ -2103,10 +2881,32 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
 
                 case SOURCE_DEFER:
                 case SOURCE_POST:
+                        s->enabled = m;
+                        break;
+
                 case SOURCE_INOTIFY:
+                        /* Forget about events collected before the source was disabled, like we do for those
+                         * that were pending already */
+                        if (s->enabled == SD_EVENT_OFF)
+                                source_inotify_coalesce_reset(s);
+
                         s->enabled = m;
                         break;
 
+                case SOURCE_WORK: {
+                        int old = s->enabled;
+
+                        s->enabled = m;
+
+                        r = work_source_update(s);
+                        if (r < 0) {
+                                s->enabled = old;
+                                return r;
+                        }
+
+                        break;
+                }
+
                 default:
                         assert_not_reached("Wut? I shouldn't exist.");
                 }
@@ -2121,6 +2921,34 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
         return 0;
 }
 
+_public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
+        int r;
+
+        assert_return(s, -EINVAL);
+        assert_return(IN_SET(m, SD_EVENT_OFF, SD_EVENT_ON, SD_EVENT_ONESHOT), -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        /* If we are dead anyway, we are fine with turning off
+         * sources, but everything else needs to fail. */
+        if (s->event->state == SD_EVENT_FINISHED)
+                return m == SD_EVENT_OFF ? 0 : -ESTALE;
+
+        if (s->ratelimited) {
+                /* The source is offline until the rate limit interval is over, just remember what to
+                 * switch to then. If it is disabled, whatever was pending is dropped, as usual. */
+                if (m == SD_EVENT_OFF && !IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
+                        r = source_set_pending(s, false);
+                        if (r < 0)
+                                return r;
+                }
+
+                s->ratelimit_enabled = m;
+                return 0;
+        }
+
+        return source_set_enabled(s, m, false);
+}
+
 _public_ int sd_event_source_get_time(sd_event_source *s, uint64_t *usec) {
         assert_return(s, -EINVAL);
         assert_return(usec, -EINVAL);
@@ -2132,7 +2960,6 @@ _public_ int sd_event_source_get_time(sd_event_source *s, uint64_t *usec) {
 }
 
 _public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
-        struct clock_data *d;
         int r;
 
         assert_return(s, -EINVAL);
@@ -2146,14 +2973,7 @@ _public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
 
         s->time.next = usec;
 
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
-
-        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
-
-        return 0;
+        return time_source_reshuffle(s);
 }
 
 _public_ int sd_event_source_get_time_accuracy(sd_event_source *s, uint64_t *usec) {
@@ -2167,7 +2987,6 @@ _public_ int sd_event_source_get_time_accuracy(sd_event_source *s, uint64_t *use
 }
 
 _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec) {
-        struct clock_data *d;
         int r;
 
         assert_return(s, -EINVAL);
@@ -2185,13 +3004,7 @@ _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec
 
         s->time.accuracy = usec;
 
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
-
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
-
-        return 0;
+        return time_source_reshuffle(s);
 }
 
 _public_ int sd_event_source_get_time_clock(sd_event_source *s, clockid_t *clock) {
@@ -2224,6 +3037,49 @@ _public_ int sd_event_source_get_inotify_mask(sd_event_source *s, uint32_t *mask
         return 0;
 }
 
+_public_ int sd_event_source_set_inotify_coalesce(sd_event_source *s, uint64_t usec) {
+        assert_return(s, -EINVAL);
+        assert_return(s->type == SOURCE_INOTIFY, -EDOM);
+        assert_return(s->event->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        if (s->inotify.coalesce_usec == usec)
+                return 0;
+
+        /* Whether the event of a pending source is in the buffer of the inotify object or was collected
+         * depends on this, hence don't allow changing it while events are around. */
+        if (s->pending || (s->enabled != SD_EVENT_OFF && s->inotify.n_coalesced > 0))
+                return -EBUSY;
+
+        source_inotify_coalesce_reset(s);
+        s->inotify.coalesce_usec = usec;
+        if (usec == 0)
+                source_inotify_coalesce_timer_free(s);
+
+        return 0;
+}
+
+_public_ int sd_event_source_get_inotify_coalesce(sd_event_source *s, uint64_t *ret) {
+        assert_return(s, -EINVAL);
+        assert_return(ret, -EINVAL);
+        assert_return(s->type == SOURCE_INOTIFY, -EDOM);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        *ret = s->inotify.coalesce_usec;
+        return 0;
+}
+
+_public_ int sd_event_source_get_inotify_count(sd_event_source *s, unsigned *ret) {
+        assert_return(s, -EINVAL);
+        assert_return(ret, -EINVAL);
+        assert_return(s->type == SOURCE_INOTIFY, -EDOM);
+        assert_return(s->dispatching, -ENODATA);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        *ret = s->inotify.n_dispatched;
+        return 0;
+}
+
 _public_ int sd_event_source_set_prepare(sd_event_source *s, sd_event_handler_t callback) {
         int r;
 
@@ -2358,6 +3214,7 @@ static int event_arm_timer(
                 struct clock_data *d) {
 
         struct itimerspec its = {};
+        struct time_bucket *bucket;
         sd_event_source *a, *b;
         usec_t t;
         int r;
@@ -2370,13 +3227,37 @@ static int event_arm_timer(
         else
                 d->needs_rearm = false;
 
+        bucket = prioq_peek(d->bucket_prioq);
+
         a = prioq_peek(d->earliest);
-        if (!a || a->enabled == SD_EVENT_OFF || a->time.next == USEC_INFINITY) {
+        if (!a || a->enabled == SD_EVENT_OFF || a->time.next == USEC_INFINITY)
+                /* Only coarse sources, if any. Their target time was chosen by sleep_between() already. */
+                t = bucket ? bucket->target : USEC_INFINITY;
+        else {
+                usec_t latest;
+
+                b = prioq_peek(d->latest);
+                assert_se(b && b->enabled != SD_EVENT_OFF);
+
+                latest = time_event_source_latest(b);
+
+                /* If we wake up for coarse sources anyway within the window of the others, let's dispatch them
+                 * together, otherwise wake up for whatever comes first */
+                if (bucket && bucket->target >= a->time.next && bucket->target <= latest)
+                        t = bucket->target;
+                else {
+                        t = sleep_between(e, a->time.next, latest);
+                        if (bucket)
+                                t = MIN(t, bucket->target);
+                }
+        }
+
+        if (t == USEC_INFINITY) {
 
                 if (d->fd < 0)
                         return 0;
 
-                if (d->next == USEC_INFINITY)
+                if (d->next == USEC_INFINITY && !d->elapsed)
                         return 0;
 
                 /* disarm */
@@ -2385,14 +3266,11 @@ static int event_arm_timer(
                         return r;
 
                 d->next = USEC_INFINITY;
+                d->elapsed = false;
                 return 0;
         }
 
-        b = prioq_peek(d->latest);
-        assert_se(b && b->enabled != SD_EVENT_OFF);
-
-        t = sleep_between(e, a->time.next, time_event_source_latest(b));
-        if (d->next == t)
+        if (d->next == t && !d->elapsed)
                 return 0;
 
         assert_se(d->fd >= 0);
@@ -2409,6 +3287,7 @@ static int event_arm_timer(
                 return -errno;
 
         d->next = t;
+        d->elapsed = false;
         return 0;
 }
 
@@ -2431,7 +3310,7 @@ static int process_io(sd_event *e, sd_event_source *s, uint32_t revents) {
         return source_set_pending(s, true);
 }
 
-static int flush_timer(sd_event *e, int fd, uint32_t events, usec_t *next) {
+static int flush_timer(sd_event *e, int fd, uint32_t events) {
         uint64_t x;
         ssize_t ss;
 
@@ -2451,8 +3330,22 @@ static int flush_timer(sd_event *e, int fd, uint32_t events, usec_t *next) {
         if (_unlikely_(ss != sizeof(x)))
                 return -EIO;
 
-        if (next)
-                *next = USEC_INFINITY;
+        return 0;
+}
+
+static int process_clock(sd_event *e, struct clock_data *d, uint32_t events) {
+        assert(e);
+        assert(d);
+
+        assert_return(events == EPOLLIN, -EIO);
+
+        /* The timerfd elapsed. We don't read it here: timerfd_settime() resets the expiration counter, and
+         * since elapsed timers are dispatched based on the timestamp taken after waking up, the next
+         * event_arm_timer() re-arms or disarms the timerfd anyway. This saves one syscall per timer
+         * wakeup. */
+
+        d->elapsed = true;
+        d->needs_rearm = true;
 
         return 0;
 }
@@ -2485,6 +3378,22 @@ static int process_timer(
                 d->needs_rearm = true;
         }
 
+        /* Dispatch all coarse sources of elapsed buckets. Marking a source pending removes it from its
+         * bucket, and the bucket itself is released with its last source. */
+        for (;;) {
+                struct time_bucket *b;
+
+                b = prioq_peek(d->bucket_prioq);
+                if (!b || b->target > n)
+                        break;
+
+                assert(b->sources);
+
+                r = source_set_pending(b->sources, true);
+                if (r < 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -2518,6 +3427,10 @@ static int process_child(sd_event *e) {
         HASHMAP_FOREACH(s, e->child_sources, i) {
                 assert(s->type == SOURCE_CHILD);
 
+                /* These are woken up individually through their pidfd */
+                if (s->child.pidfd >= 0)
+                        continue;
+
                 if (s->pending)
                         continue;
 
@@ -2539,17 +3452,43 @@ static int process_child(sd_event *e) {
                                  * from the queue, since there's no
                                  * benefit in leaving it queued */
 
-                                assert(s->child.options & (WSTOPPED|WCONTINUED));
-                                waitid(P_PID, s->child.pid, &s->child.siginfo, WNOHANG|(s->child.options & (WSTOPPED|WCONTINUED)));
-                        }
+                                assert(s->child.options & (WSTOPPED|WCONTINUED));
+                                waitid(P_PID, s->child.pid, &s->child.siginfo, WNOHANG|(s->child.options & (WSTOPPED|WCONTINUED)));
+                        }
+
+                        r = source_set_pending(s, true);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+static int process_pidfd(sd_event *e, sd_event_source *s, uint32_t revents) {
+        assert(e);
+        assert(s);
+        assert(s->type == SOURCE_CHILD);
+        assert(s->child.pidfd >= 0);
+
+        if (s->pending)
+                return 0;
+
+        if (s->enabled == SD_EVENT_OFF)
+                return 0;
+
+        /* The pidfd is readable once the process exited. As with process_child() we don't reap it here. */
+        zero(s->child.siginfo);
+        if (waitid(P_PID, s->child.pid, &s->child.siginfo, WNOHANG|WNOWAIT|WEXITED) < 0)
+                return -errno;
+
+        if (s->child.siginfo.si_pid == 0)
+                return 0;
 
-                        r = source_set_pending(s, true);
-                        if (r < 0)
-                                return r;
-                }
-        }
+        /* The pidfd would stay readable until the process is reaped, don't wake up for it again */
+        source_child_pidfd_unregister(s);
 
-        return 0;
+        return source_set_pending(s, true);
 }
 
 static int process_signal(sd_event *e, struct signal_data *d, uint32_t events) {
@@ -2645,6 +3584,60 @@ static int event_inotify_data_read(sd_event *e, struct inotify_data *d, uint32_t
         return 1;
 }
 
+static int inotify_coalesce_handler(sd_event_source *t, uint64_t usec, void *userdata) {
+        sd_event_source *s = userdata;
+
+        assert(s);
+        assert(s->type == SOURCE_INOTIFY);
+
+        if (s->enabled == SD_EVENT_OFF || s->inotify.n_coalesced == 0)
+                return 0;
+
+        return source_set_pending(s, true);
+}
+
+static int source_inotify_coalesce(sd_event_source *s, const struct inotify_event *ev) {
+        usec_t until;
+        int r;
+
+        assert(s);
+        assert(s->type == SOURCE_INOTIFY);
+        assert(s->inotify.coalesce_usec > 0);
+        assert(ev);
+
+        /* Instead of making the source pending for each event, collect the events in the first place. They are
+         * dispatched together once the window started by the first of them is over. Since we only keep the
+         * combined mask, the event doesn't need to stay in the buffer, so that more can be read meanwhile. */
+
+        s->inotify.coalesced_mask |= ev->mask;
+        s->inotify.coalesced_wd = ev->wd;
+        if (s->inotify.n_coalesced++ > 0)
+                return 0;
+
+        until = usec_add(now(CLOCK_MONOTONIC), s->inotify.coalesce_usec);
+
+        if (s->inotify.coalesce_timer) {
+                r = sd_event_source_set_time(s->inotify.coalesce_timer, until);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_enabled(s->inotify.coalesce_timer, SD_EVENT_ONESHOT);
+        } else {
+                r = sd_event_add_time(s->event, &s->inotify.coalesce_timer, CLOCK_MONOTONIC, until, 1,
+                                      inotify_coalesce_handler, s);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(s->inotify.coalesce_timer, "inotify-coalesce");
+
+                r = sd_event_source_set_floating(s->inotify.coalesce_timer, true);
+        }
+        if (r < 0)
+                return r;
+
+        return sd_event_source_set_priority(s->inotify.coalesce_timer, s->priority);
+}
+
 static void event_inotify_data_drop(sd_event *e, struct inotify_data *d, size_t sz) {
         assert(e);
         assert(d);
@@ -2697,7 +3690,10 @@ static int event_inotify_data_process(sd_event *e, struct inotify_data *d) {
                                         if (s->enabled == SD_EVENT_OFF)
                                                 continue;
 
-                                        r = source_set_pending(s, true);
+                                        if (s->inotify.coalesce_usec > 0)
+                                                r = source_inotify_coalesce(s, &d->buffer.ev);
+                                        else
+                                                r = source_set_pending(s, true);
                                         if (r < 0)
                                                 return r;
                                 }
@@ -2737,7 +3733,10 @@ static int event_inotify_data_process(sd_event *e, struct inotify_data *d) {
                                     (s->inotify.mask & d->buffer.ev.mask & IN_ALL_EVENTS) == 0)
                                         continue;
 
-                                r = source_set_pending(s, true);
+                                if (s->inotify.coalesce_usec > 0)
+                                        r = source_inotify_coalesce(s, &d->buffer.ev);
+                                else
+                                        r = source_set_pending(s, true);
                                 if (r < 0)
                                         return r;
                         }
@@ -2746,6 +3745,9 @@ static int event_inotify_data_process(sd_event *e, struct inotify_data *d) {
                 /* Something pending now? If so, let's finish, otherwise let's read more. */
                 if (d->n_pending > 0)
                         return 1;
+
+                /* Nobody needs the event in the buffer anymore */
+                event_inotify_data_drop(e, d, sz);
         }
 
         return 0;
@@ -2768,8 +3770,150 @@ static int process_inotify(sd_event *e) {
         return done;
 }
 
+static int process_work(sd_event *e, struct work_pool *w, uint32_t revents) {
+        sd_event_source *s;
+        eventfd_t x;
+        int r = 0;
+
+        assert(e);
+        assert(w);
+
+        assert_return(revents == EPOLLIN, -EIO);
+
+        /* Reset the eventfd before looking at the list of completed work, so that we don't miss a wake-up for
+         * work that completes in between */
+        if (eventfd_read(w->fd, &x) < 0 && !IN_SET(errno, EAGAIN, EINTR))
+                return -errno;
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+        while ((s = w->done)) {
+                assert(s->work.state == WORK_DONE);
+
+                LIST_REMOVE(work.done, w->done, s);
+                s->work.state = WORK_IDLE;
+
+                /* The source was disabled while its work was running, drop the result */
+                if (s->enabled == SD_EVENT_OFF)
+                        continue;
+
+                r = source_set_pending(s, true);
+                if (r < 0)
+                        break;
+        }
+
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        return r;
+}
+
+static void source_account_dispatch(sd_event_source *s, usec_t begin, usec_t end) {
+        usec_t t;
+
+        assert(s);
+
+        s->stats.n_dispatched++;
+
+        t = usec_sub_unsigned(end, begin);
+        s->stats.dispatch_usec += t;
+        s->stats.dispatch_max_usec = MAX(s->stats.dispatch_max_usec, t);
+
+        /* Exit sources are never marked pending, and sources that became pending before statistics were
+         * turned on don't know when that happened */
+        if (s->pending_timestamp > 0) {
+                t = usec_sub_unsigned(begin, s->pending_timestamp);
+                s->stats.pending_usec += t;
+                s->stats.pending_max_usec = MAX(s->stats.pending_max_usec, t);
+
+                /* Defer sources stay pending, count the time until the next dispatch from now */
+                s->pending_timestamp = s->pending ? end : 0;
+        }
+}
+
+static int source_leave_ratelimit(sd_event_source *s) {
+        int r;
+
+        assert(s);
+
+        if (!s->ratelimited)
+                return 0;
+
+        s->ratelimited = false;
+        RATELIMIT_RESET(s->rate_limit);
+
+        if (s->ratelimit_timer)
+                (void) sd_event_source_set_enabled(s->ratelimit_timer, SD_EVENT_OFF);
+
+        r = source_set_enabled(s, s->ratelimit_enabled, true);
+        if (r < 0)
+                return r;
+
+        log_debug("Event source %p (%s) is no longer rate limited.", s, strna(s->description));
+        return 0;
+}
+
+static int ratelimit_handler(sd_event_source *t, uint64_t usec, void *userdata) {
+        sd_event_source *s = userdata;
+
+        assert(s);
+
+        return source_leave_ratelimit(s);
+}
+
+static int source_enter_ratelimit(sd_event_source *s) {
+        char buf[FORMAT_TIMESPAN_MAX];
+        usec_t until;
+        int r;
+
+        assert(s);
+        assert(!s->ratelimited);
+
+        /* The source is dispatched too often. Take it offline until the current rate limit interval is over,
+         * but leave it pending, so that whatever triggered it is dispatched then. */
+
+        until = usec_add(s->rate_limit.begin, s->rate_limit.interval);
+
+        if (s->ratelimit_timer) {
+                r = sd_event_source_set_time(s->ratelimit_timer, until);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_enabled(s->ratelimit_timer, SD_EVENT_ONESHOT);
+        } else {
+                r = sd_event_add_time(s->event, &s->ratelimit_timer, CLOCK_MONOTONIC, until, 1,
+                                      ratelimit_handler, s);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(s->ratelimit_timer, "ratelimit");
+
+                r = sd_event_source_set_floating(s->ratelimit_timer, true);
+        }
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_priority(s->ratelimit_timer, s->priority);
+        if (r < 0)
+                return r;
+
+        s->ratelimit_enabled = s->enabled;
+
+        r = source_set_enabled(s, SD_EVENT_OFF, true);
+        if (r < 0)
+                return r;
+
+        s->ratelimited = true;
+
+        log_debug("Event source %p (%s) dispatched more than %u times within %s, suspending it.",
+                  s, strna(s->description), s->rate_limit.burst,
+                  format_timespan(buf, sizeof(buf), s->rate_limit.interval, 0));
+
+        return 0;
+}
+
 static int source_dispatch(sd_event_source *s) {
         EventSourceType saved_type;
+        usec_t begin;
         int r = 0;
 
         assert(s);
@@ -2779,6 +3923,14 @@ static int source_dispatch(sd_event_source *s) {
          * the event. */
         saved_type = s->type;
 
+        if (EVENT_SOURCE_CAN_RATE_LIMIT(s->type) && !ratelimit_below(&s->rate_limit)) {
+                r = source_enter_ratelimit(s);
+                if (r < 0)
+                        return r;
+
+                return 1;
+        }
+
         if (!IN_SET(s->type, SOURCE_DEFER, SOURCE_EXIT)) {
                 r = source_set_pending(s, false);
                 if (r < 0)
@@ -2809,6 +3961,7 @@ static int source_dispatch(sd_event_source *s) {
         }
 
         s->dispatching = true;
+        begin = s->event->source_stats ? now(CLOCK_MONOTONIC) : 0;
 
         switch (s->type) {
 
@@ -2836,8 +3989,10 @@ static int source_dispatch(sd_event_source *s) {
                 r = s->child.callback(s, &s->child.siginfo, s->userdata);
 
                 /* Now, reap the PID for good. */
-                if (zombie)
+                if (zombie) {
                         (void) waitid(P_PID, s->child.pid, &s->child.siginfo, WNOHANG|WEXITED);
+                        s->child.exited = true;
+                }
 
                 break;
         }
@@ -2862,10 +4017,25 @@ static int source_dispatch(sd_event_source *s) {
                 assert(s->inotify.inode_data);
                 assert_se(d = s->inotify.inode_data->inotify_data);
 
+                if (s->inotify.coalesce_usec > 0) {
+                        struct inotify_event ev = {
+                                .wd = s->inotify.coalesced_wd,
+                                .mask = s->inotify.coalesced_mask,
+                        };
+
+                        s->inotify.n_dispatched = s->inotify.n_coalesced;
+                        s->inotify.coalesced_mask = 0;
+                        s->inotify.n_coalesced = 0;
+
+                        r = s->inotify.callback(s, &ev, s->userdata);
+                        break;
+                }
+
                 assert(d->buffer_filled >= offsetof(struct inotify_event, name));
                 sz = offsetof(struct inotify_event, name) + d->buffer.ev.len;
                 assert(d->buffer_filled >= sz);
 
+                s->inotify.n_dispatched = 1;
                 r = s->inotify.callback(s, &d->buffer.ev, s->userdata);
 
                 /* When no event is pending anymore on this inotify object, then let's drop the event from the
@@ -2876,6 +4046,10 @@ static int source_dispatch(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                r = s->work.callback(s, s->work.result, s->userdata);
+                break;
+
         case SOURCE_WATCHDOG:
         case _SOURCE_EVENT_SOURCE_TYPE_MAX:
         case _SOURCE_EVENT_SOURCE_TYPE_INVALID:
@@ -2883,6 +4057,8 @@ static int source_dispatch(sd_event_source *s) {
         }
 
         s->dispatching = false;
+        if (begin > 0)
+                source_account_dispatch(s, begin, now(CLOCK_MONOTONIC));
 
         if (r < 0)
                 log_debug_errno(r, "Event source %s (type %s) returned error, disabling: %m",
@@ -2892,6 +4068,15 @@ static int source_dispatch(sd_event_source *s) {
                 source_free(s);
         else if (r < 0)
                 sd_event_source_set_enabled(s, SD_EVENT_OFF);
+        else if (s->type == SOURCE_WORK) {
+                /* Run the work again, if the source is still enabled */
+                r = work_source_update(s);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to queue work of event source %s, disabling: %m",
+                                        strna(s->description));
+                        sd_event_source_set_enabled(s, SD_EVENT_OFF);
+                }
+        }
 
         return 1;
 }
@@ -2981,6 +4166,7 @@ static int arm_watchdog(sd_event *e) {
                           e->watchdog_last + (e->watchdog_period * 3 / 4));
 
         timespec_store(&its.it_value, t);
+        e->watchdog_next = t;
 
         /* Make sure we never set the watchdog to 0, which tells the
          * kernel to disable it. */
@@ -2994,7 +4180,33 @@ static int arm_watchdog(sd_event *e) {
         return 0;
 }
 
+static unsigned watchdog_latency_bucket(usec_t latency) {
+        unsigned k;
+
+        if (latency < WATCHDOG_LATENCY_SUB_BUCKETS)
+                return (unsigned) latency;
+
+        /* The most significant bit selects the power of two, the two bits after it the bucket within it */
+        k = log2u64(latency);
+        return MIN(WATCHDOG_LATENCY_SUB_BUCKETS * (k - 1) + (unsigned) ((latency >> (k - 2)) & 3),
+                   WATCHDOG_LATENCY_BUCKETS - 1);
+}
+
+static usec_t watchdog_latency_bucket_max(unsigned b) {
+        unsigned k;
+
+        assert(b < WATCHDOG_LATENCY_BUCKETS);
+
+        if (b < WATCHDOG_LATENCY_SUB_BUCKETS)
+                return b;
+
+        k = b / WATCHDOG_LATENCY_SUB_BUCKETS + 1;
+        return (((usec_t) (WATCHDOG_LATENCY_SUB_BUCKETS + b % WATCHDOG_LATENCY_SUB_BUCKETS + 1)) << (k - 2)) - 1;
+}
+
 static int process_watchdog(sd_event *e) {
+        usec_t latency;
+
         assert(e);
 
         if (!e->watchdog)
@@ -3004,7 +4216,20 @@ static int process_watchdog(sd_event *e) {
         if (e->watchdog_last + e->watchdog_period / 4 > e->timestamp.monotonic)
                 return 0;
 
-        sd_notify(false, "WATCHDOG=1");
+        /* We are woken up early if other events are processed anyway, only count how late we are */
+        latency = e->timestamp.monotonic > e->watchdog_next ? e->timestamp.monotonic - e->watchdog_next : 0;
+
+        e->watchdog_latency[watchdog_latency_bucket(latency)]++;
+        e->n_watchdog_latency++;
+        e->watchdog_latency_max = MAX(e->watchdog_latency_max, latency);
+
+        if (e->watchdog_notify_latency)
+                (void) sd_notifyf(false,
+                                  "WATCHDOG=1\n"
+                                  "WATCHDOG_LATENCY=" USEC_FMT, latency);
+        else
+                sd_notify(false, "WATCHDOG=1");
+
         e->watchdog_last = e->timestamp.monotonic;
 
         return arm_watchdog(e);
@@ -3127,22 +4352,26 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
         for (i = 0; i < m; i++) {
 
                 if (ev_queue[i].data.ptr == INT_TO_PTR(SOURCE_WATCHDOG))
-                        r = flush_timer(e, e->watchdog_fd, ev_queue[i].events, NULL);
+                        r = flush_timer(e, e->watchdog_fd, ev_queue[i].events);
                 else {
                         WakeupType *t = ev_queue[i].data.ptr;
 
                         switch (*t) {
 
-                        case WAKEUP_EVENT_SOURCE:
-                                r = process_io(e, ev_queue[i].data.ptr, ev_queue[i].events);
-                                break;
+                        case WAKEUP_EVENT_SOURCE: {
+                                sd_event_source *s = ev_queue[i].data.ptr;
 
-                        case WAKEUP_CLOCK_DATA: {
-                                struct clock_data *d = ev_queue[i].data.ptr;
-                                r = flush_timer(e, d->fd, ev_queue[i].events, &d->next);
+                                if (s->type == SOURCE_CHILD)
+                                        r = process_pidfd(e, s, ev_queue[i].events);
+                                else
+                                        r = process_io(e, s, ev_queue[i].events);
                                 break;
                         }
 
+                        case WAKEUP_CLOCK_DATA:
+                                r = process_clock(e, ev_queue[i].data.ptr, ev_queue[i].events);
+                                break;
+
                         case WAKEUP_SIGNAL_DATA:
                                 r = process_signal(e, ev_queue[i].data.ptr, ev_queue[i].events);
                                 break;
@@ -3151,6 +4380,10 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                                 r = event_inotify_data_read(e, ev_queue[i].data.ptr, ev_queue[i].events);
                                 break;
 
+                        case WAKEUP_WORK_POOL:
+                                r = process_work(e, ev_queue[i].data.ptr, ev_queue[i].events);
+                                break;
+
                         default:
                                 assert_not_reached("Invalid wake-up pointer");
                         }
@@ -3223,10 +4456,26 @@ _public_ int sd_event_dispatch(sd_event *e) {
         p = event_next_pending(e);
         if (p) {
                 _cleanup_(sd_event_unrefp) sd_event *ref = NULL;
+                int64_t priority;
+                unsigned n;
 
                 ref = sd_event_ref(e);
                 e->state = SD_EVENT_RUNNING;
-                r = source_dispatch(p);
+
+                /* If batching is enabled, continue with further sources that were already pending at the
+                 * same priority, before we poll again. Defer sources stay pending after being dispatched, and
+                 * are hence dispatched only once per iteration, as the first source of a batch. */
+                priority = p->priority;
+                for (n = 1;; n++) {
+                        r = source_dispatch(p);
+                        if (r < 0 || e->exit_requested || n >= e->dispatch_batch)
+                                break;
+
+                        p = event_next_pending(e);
+                        if (!p || p->priority != priority || p->type == SOURCE_DEFER)
+                                break;
+                }
+
                 e->state = SD_EVENT_INITIAL;
                 return r;
         }
@@ -3482,6 +4731,99 @@ _public_ int sd_event_get_watchdog(sd_event *e) {
         return e->watchdog;
 }
 
+_public_ int sd_event_set_watchdog_notify_latency(sd_event *e, int b) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        e->watchdog_notify_latency = b;
+        return 0;
+}
+
+_public_ int sd_event_get_watchdog_notify_latency(sd_event *e) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        return e->watchdog_notify_latency;
+}
+
+_public_ int sd_event_set_source_stats(sd_event *e, int b) {
+        sd_event_source *s;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        if (e->source_stats == !!b)
+                return e->source_stats;
+
+        /* Whatever became pending while the statistics were off is not accounted */
+        LIST_FOREACH(sources, s, e->sources)
+                s->pending_timestamp = 0;
+
+        e->source_stats = b;
+        return e->source_stats;
+}
+
+_public_ int sd_event_get_source_stats(sd_event *e) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        return e->source_stats;
+}
+
+_public_ int sd_event_get_watchdog_latency(sd_event *e, unsigned percentile, uint64_t *ret) {
+        unsigned b, n = 0, rank;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(percentile <= 100, -EINVAL);
+        assert_return(ret, -EINVAL);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        if (e->n_watchdog_latency == 0)
+                return -ENODATA;
+
+        /* The smallest latency that at least the requested share of watchdog pings was faster than, rounded
+         * up to the end of its bucket */
+        rank = MAX(DIV_ROUND_UP((uint64_t) e->n_watchdog_latency * percentile, 100U), 1U);
+
+        for (b = 0; b < WATCHDOG_LATENCY_BUCKETS; b++) {
+                n += e->watchdog_latency[b];
+                if (n >= rank)
+                        break;
+        }
+
+        assert(b < WATCHDOG_LATENCY_BUCKETS);
+
+        /* The last bucket also takes everything beyond the range of the histogram */
+        *ret = b == WATCHDOG_LATENCY_BUCKETS - 1 ? e->watchdog_latency_max :
+                MIN(watchdog_latency_bucket_max(b), e->watchdog_latency_max);
+        return 0;
+}
+
+_public_ int sd_event_set_dispatch_batch(sd_event *e, unsigned n) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        e->dispatch_batch = n;
+        return 0;
+}
+
+_public_ int sd_event_get_dispatch_batch(sd_event *e, unsigned *ret) {
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(ret, -EINVAL);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        *ret = MAX(e->dispatch_batch, 1U);
+        return 0;
+}
+
 _public_ int sd_event_get_iteration(sd_event *e, uint64_t *ret) {
         assert_return(e, -EINVAL);
         assert_return(e = event_resolve(e), -ENOPKG);
@@ -3534,3 +4876,41 @@ _public_ int sd_event_source_set_floating(sd_event_source *s, int b) {
 
         return 1;
 }
+
+_public_ int sd_event_source_set_ratelimit(sd_event_source *s, uint64_t interval, unsigned burst) {
+        int r;
+
+        assert_return(s, -EINVAL);
+        assert_return(EVENT_SOURCE_CAN_RATE_LIMIT(s->type), -EDOM);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        /* A new rate limit starts with a fresh interval, hence if we were rate limited, we're not anymore.
+         * Setting either of the two to zero turns rate limiting off. */
+        r = source_leave_ratelimit(s);
+        if (r < 0)
+                return r;
+
+        RATELIMIT_INIT(s->rate_limit, interval, burst);
+        return 0;
+}
+
+_public_ int sd_event_source_get_ratelimit(sd_event_source *s, uint64_t *ret_interval, unsigned *ret_burst) {
+        assert_return(s, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        if (s->rate_limit.interval == 0 || s->rate_limit.burst == 0)
+                return -ENOEXEC;
+
+        if (ret_interval)
+                *ret_interval = s->rate_limit.interval;
+        if (ret_burst)
+                *ret_burst = s->rate_limit.burst;
+
+        return 0;
+}
+
+_public_ int sd_event_source_is_ratelimited(sd_event_source *s) {
+        assert_return(s, -EINVAL);
+
+        return s->ratelimited;
+}
@@ -1,10 +1,12 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <pthread.h>
 #include <sys/wait.h>
 
 #include "sd-event.h"
 
 #include "alloc-util.h"
+#include "event-util.h"
 #include "fd-util.h"
 #include "fs-util.h"
 #include "log.h"
@@ -481,15 +483,585 @@ static void test_inotify(unsigned n_create_events) {
         sd_event_unref(e);
 }
 
+static unsigned n_coalesced_dispatched = 0, n_coalesced_events = 0;
+
+static int inotify_coalesce_handler(sd_event_source *s, const struct inotify_event *ev, void *userdata) {
+        unsigned n;
+
+        assert_se(ev->mask & IN_CREATE);
+        assert_se(ev->len == 0);
+        assert_se(sd_event_source_get_inotify_count(s, &n) >= 0);
+
+        log_info("coalesced inotify event with mask %x standing for %u events", ev->mask, n);
+
+        n_coalesced_dispatched++;
+        n_coalesced_events += n;
+        return 0;
+}
+
+static void test_inotify_coalesce(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *p = NULL;
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        uint64_t usec;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(mkdtemp_malloc("/tmp/test-inotify-XXXXXX", &p) >= 0);
+
+        assert_se(sd_event_add_inotify(e, &s, p, IN_CREATE|IN_ONLYDIR, inotify_coalesce_handler, NULL) >= 0);
+        assert_se(sd_event_source_set_inotify_coalesce(s, 200 * USEC_PER_MSEC) >= 0);
+        assert_se(sd_event_source_get_inotify_coalesce(s, &usec) >= 0);
+        assert_se(usec == 200 * USEC_PER_MSEC);
+
+        for (i = 0; i < 50; i++) {
+                char buf[DECIMAL_STR_MAX(unsigned)+1];
+                _cleanup_free_ char *z;
+
+                xsprintf(buf, "%u", i);
+                assert_se(z = strjoin(p, "/", buf));
+
+                assert_se(touch(z) >= 0);
+        }
+
+        /* All events happened well within the window, hence they are dispatched as one */
+        while (n_coalesced_dispatched == 0)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        assert_se(n_coalesced_dispatched == 1);
+        assert_se(n_coalesced_events == 50);
+
+        /* After the window passed, a new one is started with the next event */
+        assert_se(touch(strjoina(p, "/last")) >= 0);
+        while (n_coalesced_dispatched == 1)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        assert_se(n_coalesced_events == 51);
+}
+
+static unsigned n_time_fired;
+static bool time_rescheduled;
+
+static int time_bucket_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        uint64_t next, accuracy, n;
+
+        assert_se(sd_event_source_get_time(s, &next) >= 0);
+        assert_se(sd_event_source_get_time_accuracy(s, &accuracy) >= 0);
+        assert_se(sd_event_now(sd_event_source_get_event(s), CLOCK_MONOTONIC, &n) >= 0);
+
+        log_info("timer %c elapsed at %" PRIu64 ", window %" PRIu64 "…%" PRIu64,
+                 PTR_TO_INT(userdata), n, next, next + accuracy);
+
+        /* Never early, and the window we wake up in is always within the accuracy */
+        assert_se(usec == next);
+        assert_se(n >= next);
+
+        if (PTR_TO_INT(userdata) == 'r' && !time_rescheduled) {
+                /* Reschedule once from within the callback */
+                time_rescheduled = true;
+                assert_se(sd_event_source_set_time(s, n + 10 * USEC_PER_MSEC) >= 0);
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_ONESHOT) >= 0);
+        }
+
+        if (++n_time_fired >= 6)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        return 0;
+}
+
+static void test_time_buckets(void) {
+        sd_event_source *x = NULL, *y = NULL, *z = NULL, *f = NULL, *r = NULL, *o = NULL;
+        sd_event *e = NULL;
+        usec_t start;
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(sd_event_now(e, CLOCK_MONOTONIC, &start) >= 0);
+
+        /* Coarse ones, two of which share their target */
+        assert_se(sd_event_add_time(e, &x, CLOCK_MONOTONIC, start + 20 * USEC_PER_MSEC, 0, time_bucket_handler, INT_TO_PTR('x')) >= 0);
+        assert_se(sd_event_add_time(e, &y, CLOCK_MONOTONIC, start + 20 * USEC_PER_MSEC, 0, time_bucket_handler, INT_TO_PTR('y')) >= 0);
+        assert_se(sd_event_add_time(e, &z, CLOCK_MONOTONIC, start + 30 * USEC_PER_MSEC, USEC_PER_SEC, time_bucket_handler, INT_TO_PTR('z')) >= 0);
+        assert_se(sd_event_add_time(e, &r, CLOCK_MONOTONIC, start, 0, time_bucket_handler, INT_TO_PTR('r')) >= 0);
+
+        /* A fine one */
+        assert_se(sd_event_add_time(e, &f, CLOCK_MONOTONIC, start + 10 * USEC_PER_MSEC, 1, time_bucket_handler, INT_TO_PTR('f')) >= 0);
+
+        /* One that is turned off, and one that becomes fine later on */
+        assert_se(sd_event_add_time(e, &o, CLOCK_MONOTONIC, start, 0, time_bucket_handler, INT_TO_PTR('o')) >= 0);
+        assert_se(sd_event_source_set_enabled(o, SD_EVENT_OFF) >= 0);
+        assert_se(sd_event_source_set_time_accuracy(z, 1) >= 0);
+
+        n_time_fired = 0;
+        time_rescheduled = false;
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(n_time_fired == 6);
+
+        sd_event_source_unref(x);
+        sd_event_source_unref(y);
+        sd_event_source_unref(z);
+        sd_event_source_unref(f);
+        sd_event_source_unref(r);
+        sd_event_source_unref(o);
+        sd_event_unref(e);
+}
+
+static uint64_t batch_iterations[6];
+
+static int batch_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        assert_se(sd_event_get_iteration(sd_event_source_get_event(s), &batch_iterations[PTR_TO_INT(userdata)]) >= 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_OFF) >= 0);
+        return 1;
+}
+
+static void test_dispatch_batch_one(unsigned batch) {
+        sd_event_source *sources[ELEMENTSOF(batch_iterations)] = {};
+        int pipes[ELEMENTSOF(batch_iterations)][2];
+        sd_event *e = NULL;
+        unsigned i, n;
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(sd_event_set_dispatch_batch(e, batch) >= 0);
+        assert_se(sd_event_get_dispatch_batch(e, &n) >= 0);
+        assert_se(n == MAX(batch, 1U));
+
+        zero(batch_iterations);
+
+        for (i = 0; i < ELEMENTSOF(batch_iterations); i++) {
+                assert_se(pipe2(pipes[i], O_CLOEXEC|O_NONBLOCK) >= 0);
+                assert_se(write(pipes[i][1], "x", 1) == 1);
+                assert_se(sd_event_add_io(e, &sources[i], pipes[i][0], EPOLLIN, batch_handler, INT_TO_PTR(i)) >= 0);
+        }
+
+        /* The last one is less important, and should not be part of the batch */
+        assert_se(sd_event_source_set_priority(sources[ELEMENTSOF(sources) - 1], SD_EVENT_PRIORITY_IDLE) >= 0);
+
+        while (batch_iterations[ELEMENTSOF(batch_iterations) - 1] == 0)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 1);
+
+        for (i = 0; i < ELEMENTSOF(batch_iterations); i++)
+                assert_se(batch_iterations[i] > 0);
+
+        /* The first five are dispatched in batches of the requested size, in any order, the last one after them */
+        for (i = 0; i < ELEMENTSOF(batch_iterations) - 1; i++) {
+                unsigned j, k = 0;
+
+                for (j = 0; j < ELEMENTSOF(batch_iterations) - 1; j++)
+                        if (batch_iterations[j] == batch_iterations[i])
+                                k++;
+
+                assert_se(k <= MAX(batch, 1U));
+                assert_se(batch_iterations[ELEMENTSOF(batch_iterations) - 1] > batch_iterations[i]);
+        }
+
+        if (batch >= ELEMENTSOF(batch_iterations) - 1)
+                for (i = 1; i < ELEMENTSOF(batch_iterations) - 1; i++)
+                        assert_se(batch_iterations[i] == batch_iterations[0]);
+
+        for (i = 0; i < ELEMENTSOF(batch_iterations); i++) {
+                sd_event_source_unref(sources[i]);
+                safe_close_pair(pipes[i]);
+        }
+
+        sd_event_unref(e);
+}
+
+static void test_dispatch_batch(void) {
+        test_dispatch_batch_one(0);
+        test_dispatch_batch_one(3);
+        test_dispatch_batch_one(100);
+}
+
+static int stats_handler(sd_event_source *s, void *userdata) {
+        unsigned *n = userdata;
+
+        usleep(10 * USEC_PER_MSEC);
+
+        if (++(*n) >= 4)
+                return sd_event_source_set_enabled(s, SD_EVENT_OFF);
+
+        return 0;
+}
+
+static void test_source_stats(void) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source_stats stats;
+        union {
+                sd_event_source_stats stats;
+                uint8_t bytes[sizeof(sd_event_source_stats) + 16];
+        } bigger;
+        unsigned n = 0;
+        size_t k;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(sd_event_add_defer(e, &s, stats_handler, &n) >= 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+
+        /* Nothing is collected unless asked for */
+        assert_se(sd_event_get_source_stats(e) == 0);
+        assert_se(sd_event_run(e, 0) >= 0);
+        assert_se(n == 1);
+        assert_se(sd_event_source_get_stats(s, &stats, sizeof(stats)) >= 0);
+        assert_se(stats.n_dispatched == 0);
+        assert_se(stats.dispatch_usec == 0);
+
+        assert_se(sd_event_set_source_stats(e, true) > 0);
+        assert_se(sd_event_get_source_stats(e) > 0);
+
+        while (n < 4)
+                assert_se(sd_event_run(e, 0) >= 0);
+
+        assert_se(sd_event_source_get_stats(s, &stats, sizeof(stats)) >= 0);
+        assert_se(stats.n_dispatched == 3);
+        assert_se(stats.dispatch_usec >= 30 * USEC_PER_MSEC);
+        assert_se(stats.dispatch_max_usec >= 10 * USEC_PER_MSEC);
+        assert_se(stats.dispatch_max_usec <= stats.dispatch_usec);
+        assert_se(stats.pending_max_usec <= stats.pending_usec);
+
+        /* Callers built against a newer version of the structure get the fields we don't know about zeroed */
+        memset(&bigger, 0xff, sizeof(bigger));
+        assert_se(sd_event_source_get_stats(s, &bigger.stats, sizeof(bigger)) >= 0);
+        assert_se(memcmp(&bigger.stats, &stats, sizeof(stats)) == 0);
+        for (k = sizeof(stats); k < sizeof(bigger); k++)
+                assert_se(bigger.bytes[k] == 0);
+        assert_se(sd_event_source_get_stats(s, &stats, sizeof(stats) - 1) == -EINVAL);
+
+        assert_se(sd_event_set_source_stats(e, false) == 0);
+}
+
+static void test_source_pool(void) {
+        sd_event_source *s[3], *t;
+        sd_event *e = NULL;
+        unsigned n_used, n_used_max;
+        uint64_t n_allocated;
+        size_t i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(s); i++)
+                assert_se(sd_event_add_defer(e, &s[i], defer_handler, NULL) >= 0);
+
+        if (event_get_source_pool_stats(e, &n_used, &n_used_max, &n_allocated) == -ENODATA) {
+                log_info("Event source pool is disabled, skipping.");
+                for (i = 0; i < ELEMENTSOF(s); i++)
+                        sd_event_source_unref(s[i]);
+                sd_event_unref(e);
+                return;
+        }
+
+        assert_se(n_used == 3);
+        assert_se(n_used_max == 3);
+        assert_se(n_allocated == 3);
+
+        /* Freed sources end up on the free list, and are handed out again first */
+        t = s[1];
+        s[1] = sd_event_source_unref(s[1]);
+        assert_se(event_get_source_pool_stats(e, &n_used, NULL, NULL) >= 0);
+        assert_se(n_used == 2);
+
+        assert_se(sd_event_add_defer(e, &s[1], defer_handler, NULL) >= 0);
+        assert_se(s[1] == t);
+
+        assert_se(event_get_source_pool_stats(e, &n_used, &n_used_max, &n_allocated) >= 0);
+        assert_se(n_used == 3);
+        assert_se(n_used_max == 3);
+        assert_se(n_allocated == 4);
+
+        /* A floating source we still hold a reference to outlives its loop, and so does the pool */
+        assert_se(sd_event_source_set_floating(s[2], true) >= 0);
+        sd_event_source_unref(s[0]);
+        sd_event_source_unref(s[1]);
+        e = sd_event_unref(e);
+
+        assert_se(sd_event_source_set_floating(s[2], false) == -ESTALE);
+        sd_event_source_unref(s[2]);
+}
+
+static int ratelimit_io_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        unsigned *n = userdata;
+
+        (*n)++;
+        return 0;
+}
+
+static void test_ratelimit(void) {
+        _cleanup_close_pair_ int p[2] = { -1, -1 };
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        uint64_t interval;
+        unsigned n = 0, burst;
+        usec_t begin;
+        int m;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(pipe2(p, O_CLOEXEC|O_NONBLOCK) >= 0);
+        assert_se(write(p[1], "x", 1) == 1);
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(sd_event_add_io(e, &s, p[0], EPOLLIN, ratelimit_io_handler, &n) >= 0);
+
+        assert_se(sd_event_source_get_ratelimit(s, NULL, NULL) == -ENOEXEC);
+        assert_se(sd_event_source_set_ratelimit(s, 200 * USEC_PER_MSEC, 5) >= 0);
+        assert_se(sd_event_source_get_ratelimit(s, &interval, &burst) >= 0);
+        assert_se(interval == 200 * USEC_PER_MSEC);
+        assert_se(burst == 5);
+
+        /* The pipe stays readable, so the source is dispatched on every iteration, until the rate limit hits */
+        begin = now(CLOCK_MONOTONIC);
+        while (n < 5)
+                assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+        assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+        assert_se(n == 5);
+        assert_se(sd_event_source_is_ratelimited(s) > 0);
+
+        /* The state it is switched back to is reported meanwhile */
+        assert_se(sd_event_source_get_enabled(s, &m) > 0);
+        assert_se(m == SD_EVENT_ON);
+
+        while (n < 6)
+                assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+
+        assert_se(now(CLOCK_MONOTONIC) >= begin + 200 * USEC_PER_MSEC);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+
+        /* Disabling a rate limited source sticks, and turning off the rate limit brings it back online */
+        while (sd_event_source_is_ratelimited(s) == 0)
+                assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+        assert_se(n == 10);
+
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_OFF) >= 0);
+        assert_se(sd_event_source_get_enabled(s, NULL) == 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ONESHOT) >= 0);
+
+        assert_se(sd_event_source_set_ratelimit(s, 0, 0) >= 0);
+        assert_se(sd_event_source_is_ratelimited(s) == 0);
+        assert_se(sd_event_source_get_ratelimit(s, NULL, NULL) == -ENOEXEC);
+
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n == 11);
+        assert_se(sd_event_source_get_enabled(s, &m) == 0);
+        assert_se(m == SD_EVENT_OFF);
+}
+
+static void test_watchdog_latency(void) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        uint64_t p50, p100;
+
+        log_info("/* %s */", __func__);
+
+        /* Pretend the service manager asked for a watchdog, but has no socket to send the pings to */
+        assert_se(setenv("WATCHDOG_USEC", "100000", 1) >= 0);
+        assert_se(unsetenv("WATCHDOG_PID") >= 0);
+        assert_se(unsetenv("NOTIFY_SOCKET") >= 0);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_get_watchdog_notify_latency(e) > 0);
+        assert_se(sd_event_set_watchdog(e, true) > 0);
+        assert_se(sd_event_get_watchdog_latency(e, 100, &p100) == -ENODATA);
+
+        while (sd_event_get_watchdog_latency(e, 100, &p100) == -ENODATA)
+                assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+
+        /* The deadline is at most ¾ of the watchdog period after the last ping, hence this ping is late */
+        assert_se(usleep(150 * USEC_PER_MSEC) >= 0);
+        assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+
+        assert_se(sd_event_get_watchdog_latency(e, 50, &p50) >= 0);
+        assert_se(sd_event_get_watchdog_latency(e, 100, &p100) >= 0);
+        assert_se(p100 >= 75 * USEC_PER_MSEC);
+        assert_se(p50 <= p100);
+        assert_se(sd_event_get_watchdog_latency(e, 101, &p100) == -EINVAL);
+
+        assert_se(sd_event_set_watchdog(e, false) == 0);
+        assert_se(unsetenv("WATCHDOG_USEC") >= 0);
+}
+
+struct work {
+        unsigned x;
+        pthread_t thread;
+        unsigned n_done;
+};
+
+static unsigned n_work_pending = 0;
+
+static int work_square(void *userdata) {
+        struct work *w = userdata;
+
+        w->thread = pthread_self();
+        usleep(USEC_PER_MSEC);
+
+        return (int) (w->x * w->x);
+}
+
+static int work_square_done(sd_event_source *s, int result, void *userdata) {
+        struct work *w = userdata;
+
+        /* The work ran on a thread of the pool, but the completion is dispatched on ours */
+        assert_se(!pthread_equal(w->thread, pthread_self()));
+        assert_se(result == (int) (w->x * w->x));
+        assert_se(w->n_done == 0);
+
+        w->n_done++;
+        n_work_pending--;
+        return 0;
+}
+
+static int work_count(void *userdata) {
+        struct work *w = userdata;
+
+        return (int) ++w->x;
+}
+
+static int work_count_done(sd_event_source *s, int result, void *userdata) {
+        struct work *w = userdata;
+
+        assert_se(result == (int) w->x);
+        w->n_done++;
+
+        /* The source is enabled permanently, hence the work is queued again until we turn it off */
+        if (result >= 3) {
+                assert_se(sd_event_source_set_enabled(s, SD_EVENT_OFF) >= 0);
+                n_work_pending--;
+        }
+
+        return 0;
+}
+
+static bool work_slow_finished = false;
+
+static int work_slow(void *userdata) {
+        int *fd = userdata;
+
+        assert_se(write(*fd, "x", 1) == 1);
+        usleep(100 * USEC_PER_MSEC);
+        work_slow_finished = true;
+
+        return 0;
+}
+
+static int work_slow_done(sd_event_source *s, int result, void *userdata) {
+        assert_not_reached("Completion of cancelled work dispatched");
+}
+
+static void test_work(void) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *counter = NULL, *slow = NULL;
+        sd_event_source *sources[20] = {};
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        struct work works[ELEMENTSOF(sources)] = {}, count = {};
+        _cleanup_close_pair_ int fds[2] = { -1, -1 };
+        unsigned i;
+        char c;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(sources); i++) {
+                works[i].x = i;
+                assert_se(sd_event_add_work(e, &sources[i], work_square, work_square_done, &works[i]) >= 0);
+                assert_se(sd_event_source_set_priority(sources[i], i % 3) >= 0);
+                n_work_pending++;
+        }
+
+        assert_se(sd_event_add_work(e, &counter, work_count, work_count_done, &count) >= 0);
+        assert_se(sd_event_source_set_enabled(counter, SD_EVENT_ON) >= 0);
+        n_work_pending++;
+
+        while (n_work_pending > 0)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(sources); i++) {
+                assert_se(works[i].n_done == 1);
+                assert_se(sd_event_source_get_enabled(sources[i], NULL) == 0);
+                sources[i] = sd_event_source_unref(sources[i]);
+        }
+
+        assert_se(count.x == 3);
+        assert_se(count.n_done == 3);
+
+        /* Dropping a source waits for its work if it is running, and its completion is never dispatched */
+        assert_se(pipe2(fds, O_CLOEXEC) >= 0);
+        assert_se(sd_event_add_work(e, &slow, work_slow, work_slow_done, &fds[1]) >= 0);
+        assert_se(read(fds[0], &c, 1) == 1);
+        slow = sd_event_source_unref(slow);
+        assert_se(work_slow_finished);
+
+        assert_se(sd_event_run(e, 200 * USEC_PER_MSEC) == 0);
+}
+
+static unsigned n_children_exited = 0;
+
+static int children_handler(sd_event_source *s, const siginfo_t *si, void *userdata) {
+        assert_se(si->si_code == CLD_EXITED);
+        assert_se(si->si_status == PTR_TO_INT(userdata));
+
+        n_children_exited++;
+        return 0;
+}
+
+static void test_children(void) {
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        sd_event_source *sources[10] = {};
+        sigset_t ss;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sigprocmask_many(SIG_BLOCK, &ss, SIGCHLD, -1) >= 0);
+
+        /* Children we wait for to exit only are watched through a pidfd if the kernel supports it, the
+         * others through SIGCHLD, make sure both kinds work side by side */
+        for (i = 0; i < ELEMENTSOF(sources); i++) {
+                pid_t pid;
+
+                pid = fork();
+                assert_se(pid >= 0);
+                if (pid == 0) {
+                        usleep(i * 10 * USEC_PER_MSEC);
+                        _exit(i);
+                }
+
+                assert_se(sd_event_add_child(e, &sources[i], pid, i % 2 == 0 ? WEXITED : WEXITED|WSTOPPED,
+                                             children_handler, INT_TO_PTR(i)) >= 0);
+        }
+
+        while (n_children_exited < ELEMENTSOF(sources))
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(sources); i++)
+                sources[i] = sd_event_source_unref(sources[i]);
+
+        assert_se(sigprocmask(SIG_SETMASK, &ss, NULL) >= 0);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
         test_basic();
         test_sd_event_now();
         test_rtqueue();
+        test_dispatch_batch();
+        test_time_buckets();
+        test_source_stats();
+        test_source_pool();
+        test_ratelimit();
+        test_watchdog_latency();
+        test_work();
+        test_children();
 
         test_inotify(100); /* should work without overflow */
         test_inotify(33000); /* should trigger a q overflow */
+        test_inotify_coalesce();
 
         return 0;
 }
@@ -20,6 +20,7 @@
 #include "hwdb-util.h"
 #include "refcnt.h"
 #include "string-util.h"
+#include "strv.h"
 #include "util.h"
 
 struct sd_hwdb {
@@ -35,6 +36,11 @@ struct sd_hwdb {
         OrderedHashmap *properties;
         Iterator properties_iterator;
         bool properties_modified;
+
+        /* if set, a lookup only looks for this property, and stores the best match in properties_key_entry
+         * rather than in properties */
+        const char *properties_key;
+        const struct trie_value_entry_f *properties_key_entry;
 };
 
 struct linebuf {
@@ -123,7 +129,52 @@ static const struct trie_node_f *node_lookup_f(sd_hwdb *hwdb, const struct trie_
         return NULL;
 }
 
+static bool hwdb_entry_is_lower(sd_hwdb *hwdb, const struct trie_value_entry_f *entry, const struct trie_value_entry_f *old) {
+        const struct trie_value_entry2_f *entry2, *old2;
+
+        assert(hwdb);
+        assert(entry);
+        assert(old);
+
+        if (le64toh(hwdb->head->value_entry_size) < sizeof(struct trie_value_entry2_f))
+                return false;
+
+        /* On duplicates, we order by filename priority and line-number.
+         *
+         * v2 of the format had 64 bits for the line number.
+         * v3 reuses top 32 bits of line_number to store the priority.
+         * We check the top bits — if they are zero we have v2 format.
+         * This means that v2 clients will print wrong line numbers with
+         * v3 data.
+         *
+         * For v3 data: we compare the priority (of the source file)
+         * and the line number.
+         *
+         * For v2 data: we rely on the fact that the filenames in the hwdb
+         * are added in the order of priority (higher later), because they
+         * are *processed* in the order of priority. So we compare the
+         * indices to determine which file had higher priority. Comparing
+         * the strings alphabetically would be useless, because those are
+         * full paths, and e.g. /usr/lib would sort after /etc, even
+         * though it has lower priority. This is not reliable because of
+         * suffix compression, but should work for the most common case of
+         * /usr/lib/udev/hwbd.d and /etc/udev/hwdb.d, and is better than
+         * not doing the comparison at all.
+         */
+
+        entry2 = (const struct trie_value_entry2_f *)entry;
+        old2 = (const struct trie_value_entry2_f *)old;
+
+        if (entry2->file_priority == 0)
+                return entry2->filename_off < old2->filename_off ||
+                        (entry2->filename_off == old2->filename_off && entry2->line_number < old2->line_number);
+
+        return entry2->file_priority < old2->file_priority ||
+                (entry2->file_priority == old2->file_priority && entry2->line_number < old2->line_number);
+}
+
 static int hwdb_add_property(sd_hwdb *hwdb, const struct trie_value_entry_f *entry) {
+        const struct trie_value_entry_f *old;
         const char *key;
         int r;
 
@@ -140,47 +191,20 @@ static int hwdb_add_property(sd_hwdb *hwdb, const struct trie_value_entry_f *ent
 
         key++;
 
-        if (le64toh(hwdb->head->value_entry_size) >= sizeof(struct trie_value_entry2_f)) {
-                const struct trie_value_entry2_f *old, *entry2;
-
-                entry2 = (const struct trie_value_entry2_f *)entry;
-                old = ordered_hashmap_get(hwdb->properties, key);
-                if (old) {
-                        /* On duplicates, we order by filename priority and line-number.
-                         *
-                         * v2 of the format had 64 bits for the line number.
-                         * v3 reuses top 32 bits of line_number to store the priority.
-                         * We check the top bits — if they are zero we have v2 format.
-                         * This means that v2 clients will print wrong line numbers with
-                         * v3 data.
-                         *
-                         * For v3 data: we compare the priority (of the source file)
-                         * and the line number.
-                         *
-                         * For v2 data: we rely on the fact that the filenames in the hwdb
-                         * are added in the order of priority (higher later), because they
-                         * are *processed* in the order of priority. So we compare the
-                         * indices to determine which file had higher priority. Comparing
-                         * the strings alphabetically would be useless, because those are
-                         * full paths, and e.g. /usr/lib would sort after /etc, even
-                         * though it has lower priority. This is not reliable because of
-                         * suffix compression, but should work for the most common case of
-                         * /usr/lib/udev/hwbd.d and /etc/udev/hwdb.d, and is better than
-                         * not doing the comparison at all.
-                         */
-                        bool lower;
-
-                        if (entry2->file_priority == 0)
-                                lower = entry2->filename_off < old->filename_off ||
-                                        (entry2->filename_off == old->filename_off && entry2->line_number < old->line_number);
-                        else
-                                lower = entry2->file_priority < old->file_priority ||
-                                        (entry2->file_priority == old->file_priority && entry2->line_number < old->line_number);
-                        if (lower)
-                                return 0;
-                }
+        if (hwdb->properties_key) {
+                if (!streq(key, hwdb->properties_key))
+                        return 0;
+
+                if (!hwdb->properties_key_entry || !hwdb_entry_is_lower(hwdb, entry, hwdb->properties_key_entry))
+                        hwdb->properties_key_entry = entry;
+
+                return 0;
         }
 
+        old = ordered_hashmap_get(hwdb->properties, key);
+        if (old && hwdb_entry_is_lower(hwdb, entry, old))
+                return 0;
+
         r = ordered_hashmap_ensure_allocated(&hwdb->properties, &string_hash_ops);
         if (r < 0)
                 return r;
@@ -194,8 +218,66 @@ static int hwdb_add_property(sd_hwdb *hwdb, const struct trie_value_entry_f *ent
         return 0;
 }
 
+/* Matching the globs in the trie against the search string is done incrementally while descending: for
+ * the pattern read so far we track the set of positions in the search string it can match up to, one bit
+ * each. A subtree is skipped as soon as that set becomes empty, and a value matches if the end of the search
+ * string is in the set, so neither the pattern needs to be reconstructed nor fnmatch() called for most
+ * nodes. Bracket expressions and escapes are left to fnmatch(), as are search strings it might treat as
+ * multibyte. */
+struct trie_glob {
+        const char *search;
+        size_t len;
+        size_t words;
+};
+
+static bool glob_state_get(const uint64_t *state, size_t i) {
+        return state[i / 64] & (UINT64_C(1) << (i % 64));
+}
+
+static void glob_state_set(uint64_t *state, size_t i, bool b) {
+        if (b)
+                state[i / 64] |= UINT64_C(1) << (i % 64);
+        else
+                state[i / 64] &= ~(UINT64_C(1) << (i % 64));
+}
+
+/* Returns false if the pattern cannot match anymore, or if the character needs to be handled by fnmatch(). */
+static bool glob_state_step(const struct trie_glob *g, uint64_t *state, char c, bool *ret_fallback) {
+        bool any = false;
+        size_t i;
+
+        if (IN_SET(c, '[', '\\')) {
+                *ret_fallback = true;
+                return false;
+        }
+
+        if (c == '*') {
+                for (i = 0; i <= g->len; i++)
+                        if (glob_state_get(state, i))
+                                break;
+                for (; i <= g->len; i++) {
+                        glob_state_set(state, i, true);
+                        any = true;
+                }
+                return any;
+        }
+
+        for (i = g->len; i > 0; i--) {
+                bool b;
+
+                b = glob_state_get(state, i - 1) && (c == '?' || g->search[i - 1] == c);
+                glob_state_set(state, i, b);
+                any = any || b;
+        }
+        glob_state_set(state, 0, false);
+
+        return any;
+}
+
 static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t p,
-                          struct linebuf *buf, const char *search) {
+                          struct linebuf *buf, const struct trie_glob *g, const uint64_t *state) {
+        uint64_t *node_state = NULL, *child_state = NULL;
+        bool fallback = !state;
         size_t len;
         size_t i;
         const char *prefix;
@@ -205,17 +287,45 @@ static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t
         len = strlen(prefix + p);
         linebuf_add(buf, prefix + p, len);
 
+        if (!fallback) {
+                node_state = newa(uint64_t, g->words);
+                memcpy(node_state, state, g->words * sizeof(uint64_t));
+
+                for (i = 0; i < len; i++)
+                        if (!glob_state_step(g, node_state, prefix[p + i], &fallback)) {
+                                if (fallback)
+                                        break;
+
+                                linebuf_rem(buf, len);
+                                return 0;
+                        }
+
+                if (fallback)
+                        node_state = NULL;
+                else
+                        child_state = newa(uint64_t, g->words);
+        }
+
         for (i = 0; i < node->children_count; i++) {
                 const struct trie_child_entry_f *child = trie_node_child(hwdb, node, i);
+                bool child_fallback = false;
+
+                if (node_state) {
+                        memcpy(child_state, node_state, g->words * sizeof(uint64_t));
+                        if (!glob_state_step(g, child_state, child->c, &child_fallback) && !child_fallback)
+                                continue;
+                }
 
                 linebuf_add_char(buf, child->c);
-                err = trie_fnmatch_f(hwdb, trie_node_from_off(hwdb, child->child_off), 0, buf, search);
+                err = trie_fnmatch_f(hwdb, trie_node_from_off(hwdb, child->child_off), 0, buf, g,
+                                     child_fallback ? NULL : child_state);
                 if (err < 0)
                         return err;
                 linebuf_rem_char(buf);
         }
 
-        if (le64toh(node->values_count) && fnmatch(linebuf_get(buf), search, 0) == 0)
+        if (le64toh(node->values_count) > 0 &&
+            (node_state ? glob_state_get(node_state, g->len) : fnmatch(linebuf_get(buf), g->search, 0) == 0))
                 for (i = 0; i < le64toh(node->values_count); i++) {
                         err = hwdb_add_property(hwdb, trie_node_value(hwdb, node, i));
                         if (err < 0)
@@ -226,6 +336,46 @@ static int trie_fnmatch_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t
         return 0;
 }
 
+static int trie_glob_f(sd_hwdb *hwdb, const struct trie_node_f *node, size_t p, char c,
+                       struct linebuf *buf, const char *search) {
+        struct trie_glob g = {
+                .search = search,
+                .len = strlen(search),
+        };
+        uint64_t *state = NULL;
+        bool fallback = false;
+        const char *s;
+        int err;
+
+        for (s = search; *s; s++)
+                if ((uint8_t) *s >= 0x80) {
+                        fallback = true;
+                        break;
+                }
+
+        if (!fallback && g.len < LINE_MAX) {
+                g.words = (g.len + 1 + 63) / 64;
+                state = newa0(uint64_t, g.words);
+                glob_state_set(state, 0, true);
+
+                if (c != 0 && !glob_state_step(&g, state, c, &fallback)) {
+                        if (!fallback)
+                                return 0;
+                        state = NULL;
+                }
+        }
+
+        if (c != 0)
+                linebuf_add_char(buf, c);
+        err = trie_fnmatch_f(hwdb, node, p, buf, &g, state);
+        if (err < 0)
+                return err;
+        if (c != 0)
+                linebuf_rem_char(buf);
+
+        return 0;
+}
+
 static int trie_search_f(sd_hwdb *hwdb, const char *search) {
         struct linebuf buf;
         const struct trie_node_f *node;
@@ -238,44 +388,28 @@ static int trie_search_f(sd_hwdb *hwdb, const char *search) {
         while (node) {
                 const struct trie_node_f *child;
                 size_t p = 0;
+                const char *c;
 
                 if (node->prefix_off) {
-                        uint8_t c;
+                        uint8_t ch;
 
-                        for (; (c = trie_string(hwdb, node->prefix_off)[p]); p++) {
-                                if (IN_SET(c, '*', '?', '['))
-                                        return trie_fnmatch_f(hwdb, node, p, &buf, search + i + p);
-                                if (c != search[i + p])
+                        for (; (ch = trie_string(hwdb, node->prefix_off)[p]); p++) {
+                                if (IN_SET(ch, '*', '?', '['))
+                                        return trie_glob_f(hwdb, node, p, 0, &buf, search + i + p);
+                                if (ch != search[i + p])
                                         return 0;
                         }
                         i += p;
                 }
 
-                child = node_lookup_f(hwdb, node, '*');
-                if (child) {
-                        linebuf_add_char(&buf, '*');
-                        err = trie_fnmatch_f(hwdb, child, 0, &buf, search + i);
-                        if (err < 0)
-                                return err;
-                        linebuf_rem_char(&buf);
-                }
+                for (c = "*?["; *c; c++) {
+                        child = node_lookup_f(hwdb, node, *c);
+                        if (!child)
+                                continue;
 
-                child = node_lookup_f(hwdb, node, '?');
-                if (child) {
-                        linebuf_add_char(&buf, '?');
-                        err = trie_fnmatch_f(hwdb, child, 0, &buf, search + i);
+                        err = trie_glob_f(hwdb, child, 0, *c, &buf, search + i);
                         if (err < 0)
                                 return err;
-                        linebuf_rem_char(&buf);
-                }
-
-                child = node_lookup_f(hwdb, node, '[');
-                if (child) {
-                        linebuf_add_char(&buf, '[');
-                        err = trie_fnmatch_f(hwdb, child, 0, &buf, search + i);
-                        if (err < 0)
-                                return err;
-                        linebuf_rem_char(&buf);
                 }
 
                 if (search[i] == '\0') {
@@ -407,26 +541,68 @@ static int properties_prepare(sd_hwdb *hwdb, const char *modalias) {
         return trie_search_f(hwdb, modalias);
 }
 
-_public_ int sd_hwdb_get(sd_hwdb *hwdb, const char *modalias, const char *key, const char **_value) {
+static int hwdb_lookup_key(sd_hwdb *hwdb, const char *modalias, const char *key, const char **ret) {
         const struct trie_value_entry_f *entry;
         int r;
 
+        assert(hwdb);
+        assert(modalias);
+        assert(key);
+        assert(ret);
+
+        /* Looks for a single property, without touching the set of properties sd_hwdb_seek() collected */
+
+        hwdb->properties_key = key;
+        hwdb->properties_key_entry = NULL;
+
+        r = trie_search_f(hwdb, modalias);
+        entry = hwdb->properties_key_entry;
+
+        hwdb->properties_key = NULL;
+        hwdb->properties_key_entry = NULL;
+
+        if (r < 0)
+                return r;
+        if (!entry)
+                return -ENOENT;
+
+        *ret = trie_string(hwdb, entry->value_off);
+        return 0;
+}
+
+_public_ int sd_hwdb_get(sd_hwdb *hwdb, const char *modalias, const char *key, const char **_value) {
         assert_return(hwdb, -EINVAL);
         assert_return(hwdb->f, -EINVAL);
         assert_return(modalias, -EINVAL);
+        assert_return(key, -EINVAL);
         assert_return(_value, -EINVAL);
 
-        r = properties_prepare(hwdb, modalias);
-        if (r < 0)
-                return r;
+        return hwdb_lookup_key(hwdb, modalias, key, _value);
+}
 
-        entry = ordered_hashmap_get(hwdb->properties, key);
-        if (!entry)
-                return -ENOENT;
+_public_ int sd_hwdb_get_many(sd_hwdb *hwdb, char **modaliases, const char *key, const char **values) {
+        char **m;
+        size_t i = 0;
+        int r, n = 0;
 
-        *_value = trie_string(hwdb, entry->value_off);
+        assert_return(hwdb, -EINVAL);
+        assert_return(hwdb->f, -EINVAL);
+        assert_return(key, -EINVAL);
+        assert_return(values, -EINVAL);
+
+        STRV_FOREACH(m, modaliases) {
+                r = hwdb_lookup_key(hwdb, *m, key, values + i);
+                if (r == -ENOENT)
+                        values[i] = NULL;
+                else if (r < 0)
+                        return r;
+                else
+                        n++;
 
-        return 0;
+                i++;
+        }
+
+        return n;
 }
 
 _public_ int sd_hwdb_seek(sd_hwdb *hwdb, const char *modalias) {
@@ -2,8 +2,11 @@
 
 #include <errno.h>
 #include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <string.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "sd-login.h"
@@ -246,6 +249,130 @@ _public_ int sd_peer_get_cgroup(int fd, char **cgroup) {
         return sd_pid_get_cgroup(ucred.pid, cgroup);
 }
 
+/* polkit and PAM modules ask for many fields of the same few sessions, users and seats, often several times per
+ * authorization. Hence keep the most recently parsed state files around, and parse them again only when they were
+ * replaced in the meantime. logind and machined always write these files atomically, so a changed inode or mtime
+ * tells us. The cache is shared by all threads, so that it doesn't need to be released when one of them exits. */
+#define STATE_FILE_CACHE_MAX 8U
+
+static pthread_mutex_t state_file_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct StateFileCache {
+        char *path;
+        dev_t dev;
+        ino_t ino;
+        struct timespec mtime;
+        char **pairs;
+        uint64_t last_used;
+} state_file_cache[STATE_FILE_CACHE_MAX] = {};
+
+static uint64_t state_file_cache_counter = 0;
+
+/* Needs to be called with state_file_cache_mutex held, the returned pairs are valid only as long as it is. */
+static int state_file_get_pairs(const char *path, char ***ret) {
+        struct StateFileCache *c = NULL, *oldest = state_file_cache;
+        _cleanup_strv_free_ char **pairs = NULL;
+        struct stat st;
+        size_t i;
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        if (stat(path, &st) < 0)
+                return -errno;
+
+        for (i = 0; i < STATE_FILE_CACHE_MAX; i++) {
+                if (streq_ptr(state_file_cache[i].path, path)) {
+                        c = state_file_cache + i;
+                        break;
+                }
+
+                if (state_file_cache[i].last_used < oldest->last_used)
+                        oldest = state_file_cache + i;
+        }
+
+        if (!c ||
+            c->dev != st.st_dev ||
+            c->ino != st.st_ino ||
+            c->mtime.tv_sec != st.st_mtim.tv_sec ||
+            c->mtime.tv_nsec != st.st_mtim.tv_nsec) {
+
+                r = load_env_file_pairs(NULL, path, &pairs);
+                if (r < 0)
+                        return r;
+
+                if (!c) {
+                        char *copy;
+
+                        copy = strdup(path);
+                        if (!copy)
+                                return -ENOMEM;
+
+                        c = oldest;
+                        free_and_replace(c->path, copy);
+                }
+
+                strv_free_and_replace(c->pairs, pairs);
+                c->dev = st.st_dev;
+                c->ino = st.st_ino;
+                c->mtime = st.st_mtim;
+        }
+
+        c->last_used = ++state_file_cache_counter;
+
+        *ret = c->pairs;
+        return 0;
+}
+
+static int parse_state_filev(const char *path, va_list ap) {
+        const char *key;
+        char **pairs;
+        int r, n = 0;
+
+        r = state_file_get_pairs(path, &pairs);
+        if (r < 0)
+                return r;
+
+        while ((key = va_arg(ap, const char*))) {
+                char **v = va_arg(ap, char**), **pk, **pv, *s;
+                const char *value = NULL;
+
+                /* Like parse_env_file(), the last assignment wins */
+                STRV_FOREACH_PAIR(pk, pv, pairs)
+                        if (streq(*pk, key))
+                                value = *pv;
+                if (!value)
+                        continue;
+
+                s = strdup(value);
+                if (!s)
+                        return -ENOMEM;
+
+                free_and_replace(*v, s);
+                n++;
+        }
+
+        return n;
+}
+
+/* Like parse_env_file(), but goes through the cache above */
+static int parse_state_file_sentinel(const char *path, ...) {
+        va_list ap;
+        int r;
+
+        assert_se(pthread_mutex_lock(&state_file_cache_mutex) == 0);
+
+        va_start(ap, path);
+        r = parse_state_filev(path, ap);
+        va_end(ap);
+
+        assert_se(pthread_mutex_unlock(&state_file_cache_mutex) == 0);
+
+        return r;
+}
+
+#define parse_state_file(path, ...) parse_state_file_sentinel(path, __VA_ARGS__, NULL)
+
 static int file_of_uid(uid_t uid, char **p) {
 
         assert_return(uid_is_valid(uid), -EINVAL);
@@ -267,7 +394,7 @@ _public_ int sd_uid_get_state(uid_t uid, char**state) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, "STATE", &s);
+        r = parse_state_file(p, "STATE", &s);
         if (r == -ENOENT) {
                 r = free_and_strdup(&s, "offline");
                 if (r < 0)
@@ -291,7 +418,7 @@ _public_ int sd_uid_get_display(uid_t uid, char **session) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, "DISPLAY", &s);
+        r = parse_state_file(p, "DISPLAY", &s);
         if (r == -ENOENT)
                 return -ENODATA;
         if (r < 0)
@@ -346,7 +473,7 @@ _public_ int sd_uid_is_on_seat(uid_t uid, int require_active, const char *seat)
 
         variable = require_active ? "ACTIVE_UID" : "UIDS";
 
-        r = parse_env_file(NULL, p, variable, &s);
+        r = parse_state_file(p, variable, &s);
         if (r == -ENOENT)
                 return 0;
         if (r < 0)
@@ -375,7 +502,7 @@ static int uid_get_array(uid_t uid, const char *variable, char ***array) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, variable, &s);
+        r = parse_state_file(p, variable, &s);
         if (r == -ENOENT || (r >= 0 && isempty(s))) {
                 if (array)
                         *array = NULL;
@@ -453,7 +580,7 @@ _public_ int sd_session_is_active(const char *session) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, "ACTIVE", &s);
+        r = parse_state_file(p, "ACTIVE", &s);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -472,7 +599,7 @@ _public_ int sd_session_is_remote(const char *session) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, "REMOTE", &s);
+        r = parse_state_file(p, "REMOTE", &s);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -493,7 +620,7 @@ _public_ int sd_session_get_state(const char *session, char **state) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, "STATE", &s);
+        r = parse_state_file(p, "STATE", &s);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -516,7 +643,7 @@ _public_ int sd_session_get_uid(const char *session, uid_t *uid) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, "UID", &s);
+        r = parse_state_file(p, "UID", &s);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -538,7 +665,7 @@ static int session_get_string(const char *session, const char *field, char **val
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p, field, &s);
+        r = parse_state_file(p, field, &s);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -630,9 +757,9 @@ _public_ int sd_seat_get_active(const char *seat, char **session, uid_t *uid) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p,
-                           "ACTIVE", &s,
-                           "ACTIVE_UID", &t);
+        r = parse_state_file(p,
+                             "ACTIVE", &s,
+                             "ACTIVE_UID", &t);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -667,9 +794,9 @@ _public_ int sd_seat_get_sessions(const char *seat, char ***sessions, uid_t **ui
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p,
-                           "SESSIONS", &s,
-                           "UIDS", &t);
+        r = parse_state_file(p,
+                             "SESSIONS", &s,
+                             "UIDS", &t);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -735,8 +862,8 @@ static int seat_get_can(const char *seat, const char *variable) {
         if (r < 0)
                 return r;
 
-        r = parse_env_file(NULL, p,
-                           variable, &s);
+        r = parse_state_file(p,
+                             variable, &s);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -890,7 +1017,7 @@ _public_ int sd_machine_get_class(const char *machine, char **class) {
                         return -EINVAL;
 
                 p = strjoina("/run/systemd/machines/", machine);
-                r = parse_env_file(NULL, p, "CLASS", &c);
+                r = parse_state_file(p, "CLASS", &c);
                 if (r == -ENOENT)
                         return -ENXIO;
                 if (r < 0)
@@ -914,7 +1041,7 @@ _public_ int sd_machine_get_ifindices(const char *machine, int **ifindices) {
         assert_return(ifindices, -EINVAL);
 
         p = strjoina("/run/systemd/machines/", machine);
-        r = parse_env_file(NULL, p, "NETIF", &netif);
+        r = parse_state_file(p, "NETIF", &netif);
         if (r == -ENOENT)
                 return -ENXIO;
         if (r < 0)
@@ -1,14 +1,20 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <poll.h>
+#include <pthread.h>
 #include <string.h>
+#include <sys/mount.h>
 
 #include "sd-login.h"
 
 #include "alloc-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "format-util.h"
 #include "log.h"
+#include "mkdir.h"
+#include "process-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "util.h"
@@ -272,6 +278,75 @@ static void test_monitor(void) {
         sd_login_monitor_unref(m);
 }
 
+static void write_user(uid_t uid, const char *state) {
+        char path[STRLEN("/run/systemd/users/") + DECIMAL_STR_MAX(uid_t) + 1];
+        const char *contents;
+
+        /* logind replaces the files atomically, too */
+        xsprintf(path, "/run/systemd/users/" UID_FMT, uid);
+        contents = strjoina("STATE=", state, "\n");
+        assert_se(write_string_file(path, contents, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC) >= 0);
+}
+
+static void check_user(uid_t uid, const char *expected) {
+        _cleanup_free_ char *state = NULL;
+
+        assert_se(sd_uid_get_state(uid, &state) >= 0);
+        assert_se(streq(state, expected));
+}
+
+static void *thread_check_user(void *p) {
+        check_user(1, "active");
+        return NULL;
+}
+
+static void test_state_file_cache(void) {
+        pthread_t t;
+        uid_t uid;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        if (geteuid() != 0) {
+                log_info("Not root, skipping.");
+                return;
+        }
+
+        r = safe_fork("(state-files)", FORK_DEATHSIG|FORK_LOG|FORK_WAIT|FORK_NEW_MOUNTNS|FORK_MOUNTNS_SLAVE, NULL);
+        assert_se(r >= 0);
+        if (r == 0) {
+                /* Set up fake user state files in our own mount namespace */
+                assert_se(mkdir_p("/run/systemd/users", 0755) >= 0);
+                assert_se(mount("tmpfs", "/run/systemd/users", "tmpfs", 0, NULL) >= 0);
+
+                write_user(1, "online");
+                check_user(1, "online");
+                check_user(1, "online");
+
+                /* A replaced file is read again */
+                write_user(1, "active");
+                check_user(1, "active");
+
+                /* Other threads share the cache, and leave nothing behind when they exit */
+                assert_se(pthread_create(&t, NULL, thread_check_user, NULL) == 0);
+                assert_se(pthread_join(t, NULL) == 0);
+
+                /* More files than the cache holds, the oldest ones are evicted and read again later */
+                for (uid = 2; uid < 20; uid++) {
+                        write_user(uid, "lingering");
+                        check_user(uid, "lingering");
+                }
+                check_user(1, "active");
+                write_user(2, "closing");
+                check_user(2, "closing");
+
+                assert_se(unlink("/run/systemd/users/1") >= 0);
+                check_user(1, "offline");
+
+                _exit(EXIT_SUCCESS);
+        }
+}
+
 int main(int argc, char* argv[]) {
         log_parse_environment();
         log_open();
@@ -279,6 +354,7 @@ int main(int argc, char* argv[]) {
         log_info("/* Information printed is from the live system */");
 
         test_login();
+        test_state_file_cache();
 
         if (streq_ptr(argv[1], "-m"))
                 test_monitor();
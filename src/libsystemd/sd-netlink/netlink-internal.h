@@ -13,10 +13,17 @@
 #define RTNL_DEFAULT_TIMEOUT ((usec_t) (25 * USEC_PER_SEC))
 
 #define RTNL_WQUEUE_MAX 1024
+/* Stay well below the default socket send buffer size, the kernel refuses larger writes */
+#define RTNL_WQUEUE_BATCH_SIZE (64U*1024U)
 #define RTNL_RQUEUE_MAX 64*1024
 
 #define RTNL_CONTAINER_DEPTH 32
 
+/* Datagrams are read into this many buffers at once. Dumps are split into datagrams of at most 32K, which
+ * covers nearly everything the kernel sends. Larger datagrams are read on their own. */
+#define RTNL_RBUFFER_SLOTS 8
+#define RTNL_RBUFFER_SIZE (32U*1024U)
+
 struct reply_callback {
         sd_netlink_message_handler_t callback;
         usec_t timeout;
@@ -78,8 +85,13 @@ struct sd_netlink {
         unsigned rqueue_partial_size;
         size_t rqueue_partial_allocated;
 
-        struct nlmsghdr *rbuffer;
-        size_t rbuffer_allocated;
+        uint8_t *rbuffer; /* RTNL_RBUFFER_SLOTS buffers of RTNL_RBUFFER_SIZE each, allocated on first use */
+
+        /* Sealed messages queued while batching, written out together by sd_netlink_batch_end() */
+        sd_netlink_message **wqueue;
+        unsigned wqueue_size;
+        size_t wqueue_allocated;
+        unsigned n_batch;
 
         bool processing:1;
 
@@ -139,6 +151,7 @@ int socket_bind(sd_netlink *nl);
 int socket_broadcast_group_ref(sd_netlink *nl, unsigned group);
 int socket_broadcast_group_unref(sd_netlink *nl, unsigned group);
 int socket_write_message(sd_netlink *nl, sd_netlink_message *m);
+int socket_writev_message(sd_netlink *nl, sd_netlink_message **m, size_t msgcount);
 int socket_read_message(sd_netlink *nl);
 
 int rtnl_rqueue_make_room(sd_netlink *rtnl);
@@ -240,127 +240,76 @@ int socket_write_message(sd_netlink *nl, sd_netlink_message *m) {
         return k;
 }
 
-static int socket_recv_message(int fd, struct iovec *iov, uint32_t *_group, bool peek) {
-        union sockaddr_union sender;
-        uint8_t cmsg_buffer[CMSG_SPACE(sizeof(struct nl_pktinfo))];
+/* Writes the given messages with a single sendmsg(). The kernel processes them in order, and acknowledges
+ * each one individually, hence replies are still matched up by their sequence numbers. Returns the number
+ * of bytes sent, or a negative error code. */
+int socket_writev_message(sd_netlink *nl, sd_netlink_message **m, size_t msgcount) {
+        _cleanup_free_ struct iovec *iovs = NULL;
+        union {
+                struct sockaddr sa;
+                struct sockaddr_nl nl;
+        } addr = {
+                .nl.nl_family = AF_NETLINK,
+        };
         struct msghdr msg = {
-                .msg_iov = iov,
-                .msg_iovlen = 1,
-                .msg_name = &sender,
-                .msg_namelen = sizeof(sender),
-                .msg_control = cmsg_buffer,
-                .msg_controllen = sizeof(cmsg_buffer),
+                .msg_name = &addr.sa,
+                .msg_namelen = sizeof(addr),
         };
-        struct cmsghdr *cmsg;
-        uint32_t group = 0;
-        ssize_t n;
-
-        assert(fd >= 0);
-        assert(iov);
-
-        n = recvmsg(fd, &msg, MSG_TRUNC | (peek ? MSG_PEEK : 0));
-        if (n < 0) {
-                /* no data */
-                if (errno == ENOBUFS)
-                        log_debug("rtnl: kernel receive buffer overrun");
-                else if (errno == EAGAIN)
-                        log_debug("rtnl: no data in socket");
-
-                return IN_SET(errno, EAGAIN, EINTR) ? 0 : -errno;
-        }
+        ssize_t k;
+        size_t i;
 
-        if (sender.nl.nl_pid != 0) {
-                /* not from the kernel, ignore */
-                log_debug("rtnl: ignoring message from portid %"PRIu32, sender.nl.nl_pid);
+        assert(nl);
+        assert(m);
+        assert(msgcount > 0);
 
-                if (peek) {
-                        /* drop the message */
-                        n = recvmsg(fd, &msg, 0);
-                        if (n < 0)
-                                return IN_SET(errno, EAGAIN, EINTR) ? 0 : -errno;
-                }
+        iovs = new(struct iovec, msgcount);
+        if (!iovs)
+                return -ENOMEM;
 
-                return 0;
+        for (i = 0; i < msgcount; i++) {
+                assert(m[i]->hdr);
+                iovs[i] = IOVEC_MAKE(m[i]->hdr, m[i]->hdr->nlmsg_len);
         }
 
-        CMSG_FOREACH(cmsg, &msg) {
-                if (cmsg->cmsg_level == SOL_NETLINK &&
-                    cmsg->cmsg_type == NETLINK_PKTINFO &&
-                    cmsg->cmsg_len == CMSG_LEN(sizeof(struct nl_pktinfo))) {
-                        struct nl_pktinfo *pktinfo = (void *)CMSG_DATA(cmsg);
-
-                        /* multi-cast group */
-                        group = pktinfo->group;
-                }
-        }
+        msg.msg_iov = iovs;
+        msg.msg_iovlen = msgcount;
 
-        if (_group)
-                *_group = group;
+        k = sendmsg(nl->fd, &msg, 0);
+        if (k < 0)
+                return -errno;
 
-        return (int) n;
+        return k;
 }
 
-/* On success, the number of bytes received is returned and *ret points to the received message
- * which has a valid header and the correct size.
- * If nothing useful was received 0 is returned.
- * On failure, a negative error code is returned.
- */
-int socket_read_message(sd_netlink *rtnl) {
+/* Parses one datagram, and queues the messages in it. Returns 1 if a complete message was queued, 0 if not. */
+static int socket_parse_datagram(sd_netlink *rtnl, void *buf, size_t len, uint32_t group) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *first = NULL;
-        struct iovec iov = {};
-        uint32_t group = 0;
         bool multi_part = false, done = false;
         struct nlmsghdr *new_msg;
-        size_t len;
-        int r;
         unsigned i = 0;
         const NLTypeSystem *type_system_root;
+        int r;
 
         assert(rtnl);
-        assert(rtnl->rbuffer);
-        assert(rtnl->rbuffer_allocated >= sizeof(struct nlmsghdr));
+        assert(buf);
 
         type_system_root = type_system_get_root(rtnl->protocol);
 
-        /* read nothing, just get the pending message size */
-        r = socket_recv_message(rtnl->fd, &iov, NULL, true);
-        if (r <= 0)
-                return r;
-        else
-                len = (size_t) r;
+        new_msg = buf;
 
-        /* make room for the pending message */
-        if (!greedy_realloc((void **)&rtnl->rbuffer,
-                            &rtnl->rbuffer_allocated,
-                            len, sizeof(uint8_t)))
-                return -ENOMEM;
-
-        iov = IOVEC_MAKE(rtnl->rbuffer, rtnl->rbuffer_allocated);
-
-        /* read the pending message */
-        r = socket_recv_message(rtnl->fd, &iov, &group, false);
-        if (r <= 0)
-                return r;
-        else
-                len = (size_t) r;
-
-        if (len > rtnl->rbuffer_allocated)
-                /* message did not fit in read buffer */
-                return -EIO;
-
-        if (NLMSG_OK(rtnl->rbuffer, len) && rtnl->rbuffer->nlmsg_flags & NLM_F_MULTI) {
+        if (NLMSG_OK(new_msg, len) && new_msg->nlmsg_flags & NLM_F_MULTI) {
                 multi_part = true;
 
                 for (i = 0; i < rtnl->rqueue_partial_size; i++) {
                         if (rtnl_message_get_serial(rtnl->rqueue_partial[i]) ==
-                            rtnl->rbuffer->nlmsg_seq) {
+                            new_msg->nlmsg_seq) {
                                 first = rtnl->rqueue_partial[i];
                                 break;
                         }
                 }
         }
 
-        for (new_msg = rtnl->rbuffer; NLMSG_OK(new_msg, len) && !done; new_msg = NLMSG_NEXT(new_msg, len)) {
+        for (; NLMSG_OK(new_msg, len) && !done; new_msg = NLMSG_NEXT(new_msg, len)) {
                 _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
                 const NLType *nl_type;
 
@@ -403,6 +352,7 @@ int socket_read_message(sd_netlink *rtnl) {
 
                 m->broadcast = !!group;
 
+                /* the read buffer is reused, hence copy the message, to exactly its size */
                 m->hdr = memdup(new_msg, new_msg->nlmsg_len);
                 if (!m->hdr)
                         return -ENOMEM;
@@ -456,3 +406,148 @@ int socket_read_message(sd_netlink *rtnl) {
                 return 0;
         }
 }
+
+static uint32_t socket_get_group(struct msghdr *msg) {
+        struct cmsghdr *cmsg;
+        uint32_t group = 0;
+
+        CMSG_FOREACH(cmsg, msg) {
+                if (cmsg->cmsg_level == SOL_NETLINK &&
+                    cmsg->cmsg_type == NETLINK_PKTINFO &&
+                    cmsg->cmsg_len == CMSG_LEN(sizeof(struct nl_pktinfo))) {
+                        struct nl_pktinfo *pktinfo = (void *)CMSG_DATA(cmsg);
+
+                        /* multi-cast group */
+                        group = pktinfo->group;
+                }
+        }
+
+        return group;
+}
+
+static int socket_read_large_message(sd_netlink *rtnl, size_t size) {
+        _cleanup_free_ void *buf = NULL;
+        union sockaddr_union sender;
+        uint8_t cmsg_buffer[CMSG_SPACE(sizeof(struct nl_pktinfo))];
+        struct iovec iov;
+        struct msghdr msg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_name = &sender,
+                .msg_namelen = sizeof(sender),
+                .msg_control = cmsg_buffer,
+                .msg_controllen = sizeof(cmsg_buffer),
+        };
+        ssize_t n;
+
+        assert(rtnl);
+
+        /* Reads a datagram that doesn't fit into the read buffers on its own, into one of its size */
+
+        buf = malloc(size);
+        if (!buf)
+                return -ENOMEM;
+
+        iov = IOVEC_MAKE(buf, size);
+
+        n = recvmsg(rtnl->fd, &msg, 0);
+        if (n < 0)
+                return IN_SET(errno, EAGAIN, EINTR) ? 0 : -errno;
+
+        if (sender.nl.nl_pid != 0) {
+                /* not from the kernel, ignore */
+                log_debug("rtnl: ignoring message from portid %"PRIu32, sender.nl.nl_pid);
+                return 0;
+        }
+
+        if (msg.msg_flags & MSG_TRUNC) {
+                log_debug("rtnl: ignoring truncated message of %zi bytes", n);
+                return 0;
+        }
+
+        return socket_parse_datagram(rtnl, buf, n, socket_get_group(&msg));
+}
+
+/* Reads as many pending datagrams as there are read buffers with a single recvmmsg(), and queues the
+ * messages in them.
+ * Returns 1 if at least one complete message was queued, 0 if nothing useful was received, and a negative
+ * error code on failure.
+ */
+int socket_read_message(sd_netlink *rtnl) {
+        union sockaddr_union senders[RTNL_RBUFFER_SLOTS];
+        uint8_t cmsg_buffers[RTNL_RBUFFER_SLOTS][CMSG_SPACE(sizeof(struct nl_pktinfo))];
+        struct iovec iovs[RTNL_RBUFFER_SLOTS];
+        struct mmsghdr msgs[RTNL_RBUFFER_SLOTS];
+        bool queued = false;
+        unsigned i;
+        ssize_t l;
+        int n, r;
+
+        assert(rtnl);
+
+        /* Learn the size of the next datagram without reading it, so that one larger than the read buffers
+         * isn't cut off, but read into a buffer of its own. */
+        l = recv(rtnl->fd, NULL, 0, MSG_PEEK|MSG_TRUNC);
+        if (l < 0) {
+                /* no data */
+                if (errno == ENOBUFS)
+                        log_debug("rtnl: kernel receive buffer overrun");
+                else if (errno == EAGAIN)
+                        log_debug("rtnl: no data in socket");
+
+                return IN_SET(errno, EAGAIN, EINTR) ? 0 : -errno;
+        }
+
+        if ((size_t) l > RTNL_RBUFFER_SIZE)
+                return socket_read_large_message(rtnl, l);
+
+        if (!rtnl->rbuffer) {
+                rtnl->rbuffer = malloc(RTNL_RBUFFER_SLOTS * RTNL_RBUFFER_SIZE);
+                if (!rtnl->rbuffer)
+                        return -ENOMEM;
+        }
+
+        for (i = 0; i < RTNL_RBUFFER_SLOTS; i++) {
+                iovs[i] = IOVEC_MAKE(rtnl->rbuffer + i * RTNL_RBUFFER_SIZE, RTNL_RBUFFER_SIZE);
+                msgs[i] = (struct mmsghdr) {
+                        .msg_hdr = {
+                                .msg_iov = iovs + i,
+                                .msg_iovlen = 1,
+                                .msg_name = senders + i,
+                                .msg_namelen = sizeof(senders[i]),
+                                .msg_control = cmsg_buffers[i],
+                                .msg_controllen = sizeof(cmsg_buffers[i]),
+                        },
+                };
+        }
+
+        n = recvmmsg(rtnl->fd, msgs, RTNL_RBUFFER_SLOTS, 0, NULL);
+        if (n < 0)
+                return IN_SET(errno, EAGAIN, EINTR) ? 0 : -errno;
+
+        for (i = 0; i < (unsigned) n; i++) {
+                struct msghdr *msg = &msgs[i].msg_hdr;
+
+                if (senders[i].nl.nl_pid != 0) {
+                        /* not from the kernel, ignore */
+                        log_debug("rtnl: ignoring message from portid %"PRIu32, senders[i].nl.nl_pid);
+                        continue;
+                }
+
+                /* Only the size of the first datagram is known beforehand. A later one may turn out to be
+                 * larger than the read buffers, which is rare enough not to peek at each one. */
+                if (msg->msg_flags & MSG_TRUNC) {
+                        log_warning("rtnl: dropping message of %u bytes that did not fit into the read buffer", msgs[i].msg_len);
+                        continue;
+                }
+
+                r = socket_parse_datagram(rtnl, rtnl->rbuffer + i * RTNL_RBUFFER_SIZE, msgs[i].msg_len,
+                                          socket_get_group(msg));
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        queued = true;
+        }
+
+        return queued;
+}
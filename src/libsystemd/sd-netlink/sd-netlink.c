@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <linux/filter.h>
 #include <poll.h>
 #include <sys/socket.h>
 
@@ -41,12 +42,6 @@ static int sd_netlink_new(sd_netlink **ret) {
 
         };
 
-        /* We guarantee that the read buffer has at least space for
-         * a message header */
-        if (!greedy_realloc((void**)&rtnl->rbuffer, &rtnl->rbuffer_allocated,
-                            sizeof(struct nlmsghdr), sizeof(uint8_t)))
-                return -ENOMEM;
-
         *ret = TAKE_PTR(rtnl);
 
         return 0;
@@ -149,6 +144,27 @@ int sd_netlink_inc_rcvbuf(sd_netlink *rtnl, size_t size) {
         return fd_inc_rcvbuf(rtnl->fd, size);
 }
 
+int sd_netlink_attach_filter(sd_netlink *rtnl, size_t len, struct sock_filter *filter) {
+        struct sock_fprog fprog = {
+                .len = len,
+                .filter = filter,
+        };
+
+        assert_return(rtnl, -EINVAL);
+        assert_return(len == 0 || filter, -EINVAL);
+        assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+
+        /* Drops messages in the kernel already, before they are queued on the socket. Note that the kernel
+         * applies the filter to notifications and unicast replies only, not to the parts of dumps. */
+
+        if (setsockopt(rtnl->fd, SOL_SOCKET,
+                       len == 0 ? SO_DETACH_FILTER : SO_ATTACH_FILTER,
+                       &fprog, sizeof(fprog)) < 0)
+                return -errno;
+
+        return 0;
+}
+
 static sd_netlink *netlink_free(sd_netlink *rtnl) {
         sd_netlink_slot *s;
         unsigned i;
@@ -165,6 +181,10 @@ static sd_netlink *netlink_free(sd_netlink *rtnl) {
 
         free(rtnl->rbuffer);
 
+        for (i = 0; i < rtnl->wqueue_size; i++)
+                sd_netlink_message_unref(rtnl->wqueue[i]);
+        free(rtnl->wqueue);
+
         while ((s = rtnl->slots)) {
                 assert(s->floating);
                 netlink_slot_disconnect(s, true);
@@ -199,6 +219,70 @@ static void rtnl_seal_message(sd_netlink *rtnl, sd_netlink_message *m) {
         return;
 }
 
+static void rtnl_fail_message(sd_netlink *rtnl, sd_netlink_message *m, int error) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *reply = NULL;
+        uint64_t serial;
+        int r;
+
+        assert(rtnl);
+        assert(m);
+        assert(error < 0);
+
+        /* Nobody would ever learn that the message was not sent otherwise, hence answer it with a synthetic
+         * error, the same way as if it timed out. */
+        serial = rtnl_message_get_serial(m);
+        if (!hashmap_get(rtnl->reply_callbacks, &serial))
+                return;
+
+        r = rtnl_message_new_synthetic_error(rtnl, error, serial, &reply);
+        if (r >= 0)
+                r = rtnl_rqueue_make_room(rtnl);
+        if (r < 0) {
+                log_debug_errno(r, "sd-netlink: failed to queue error reply for unsent message, ignoring: %m");
+                return;
+        }
+
+        rtnl->rqueue[rtnl->rqueue_size++] = TAKE_PTR(reply);
+}
+
+static int rtnl_flush_wqueue(sd_netlink *rtnl) {
+        unsigned i = 0;
+        int r = 0;
+
+        assert(rtnl);
+
+        while (i < rtnl->wqueue_size) {
+                size_t n, size = 0;
+                ssize_t k;
+
+                for (n = 0; i + n < rtnl->wqueue_size; n++) {
+                        size_t len = rtnl->wqueue[i + n]->hdr->nlmsg_len;
+
+                        if (n > 0 && size + len > RTNL_WQUEUE_BATCH_SIZE)
+                                break;
+
+                        size += len;
+                }
+
+                k = socket_writev_message(rtnl, rtnl->wqueue + i, n);
+                if (k < 0) {
+                        r = log_debug_errno(k, "sd-netlink: failed to write %u queued messages: %m", rtnl->wqueue_size - i);
+                        break;
+                }
+
+                i += n;
+        }
+
+        for (; i < rtnl->wqueue_size; i++)
+                rtnl_fail_message(rtnl, rtnl->wqueue[i], r);
+
+        for (i = 0; i < rtnl->wqueue_size; i++)
+                sd_netlink_message_unref(rtnl->wqueue[i]);
+        rtnl->wqueue_size = 0;
+
+        return r;
+}
+
 int sd_netlink_send(sd_netlink *nl,
                     sd_netlink_message *message,
                     uint32_t *serial) {
@@ -211,9 +295,23 @@ int sd_netlink_send(sd_netlink *nl,
 
         rtnl_seal_message(nl, message);
 
-        r = socket_write_message(nl, message);
-        if (r < 0)
-                return r;
+        if (nl->n_batch > 0) {
+                /* Write the queued messages out early if the queue is full, rather than failing */
+                if (nl->wqueue_size >= RTNL_WQUEUE_MAX) {
+                        r = rtnl_flush_wqueue(nl);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (!GREEDY_REALLOC(nl->wqueue, nl->wqueue_allocated, nl->wqueue_size + 1))
+                        return -ENOMEM;
+
+                nl->wqueue[nl->wqueue_size++] = sd_netlink_message_ref(message);
+        } else {
+                r = socket_write_message(nl, message);
+                if (r < 0)
+                        return r;
+        }
 
         if (serial)
                 *serial = rtnl_message_get_serial(message);
@@ -221,6 +319,26 @@ int sd_netlink_send(sd_netlink *nl,
         return 1;
 }
 
+int sd_netlink_batch_begin(sd_netlink *nl) {
+        assert_return(nl, -EINVAL);
+        assert_return(!rtnl_pid_changed(nl), -ECHILD);
+
+        nl->n_batch++;
+
+        return 0;
+}
+
+int sd_netlink_batch_end(sd_netlink *nl) {
+        assert_return(nl, -EINVAL);
+        assert_return(!rtnl_pid_changed(nl), -ECHILD);
+        assert_return(nl->n_batch > 0, -EPERM);
+
+        if (--nl->n_batch > 0)
+                return 0;
+
+        return rtnl_flush_wqueue(nl);
+}
+
 int rtnl_rqueue_make_room(sd_netlink *rtnl) {
         assert(rtnl);
 
@@ -602,6 +720,11 @@ int sd_netlink_call(sd_netlink *rtnl,
         if (r < 0)
                 return r;
 
+        /* We are going to wait for the reply, hence there is no point in holding back the message */
+        r = rtnl_flush_wqueue(rtnl);
+        if (r < 0)
+                return r;
+
         timeout = calc_elapse(usec);
 
         for (;;) {
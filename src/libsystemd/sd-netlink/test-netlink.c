@@ -9,6 +9,7 @@
 #include "ether-addr-util.h"
 #include "macro.h"
 #include "missing.h"
+#include "netlink-internal.h"
 #include "netlink-util.h"
 #include "socket-util.h"
 #include "string-util.h"
@@ -248,6 +249,73 @@ static void test_async(int ifindex) {
         assert_se((rtnl = sd_netlink_unref(rtnl)) == NULL);
 }
 
+static int batch_handler(sd_netlink *rtnl, sd_netlink_message *m, void *userdata) {
+        unsigned *counter = userdata;
+        const char *data;
+
+        assert_se(rtnl);
+        assert_se(m);
+        assert_se(counter);
+
+        assert_se(sd_netlink_message_get_errno(m) >= 0);
+        assert_se(sd_netlink_message_read_string(m, IFLA_IFNAME, &data) >= 0);
+        assert_se(streq(data, "lo"));
+
+        (*counter)--;
+
+        return 1;
+}
+
+static void test_batch(int ifindex) {
+        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        unsigned i, counter = 0;
+
+        assert_se(sd_netlink_open(&rtnl) >= 0);
+
+        assert_se(sd_netlink_batch_end(rtnl) == -EPERM);
+
+        assert_se(sd_netlink_batch_begin(rtnl) >= 0);
+        assert_se(sd_netlink_batch_begin(rtnl) >= 0);
+
+        for (i = 0; i < 10; i++) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
+
+                assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK, ifindex) >= 0);
+                assert_se(sd_netlink_call_async(rtnl, NULL, m, batch_handler, NULL, &counter, 0, NULL) >= 0);
+                counter++;
+        }
+
+        /* nothing is written before the outermost batch ends */
+        assert_se(sd_netlink_batch_end(rtnl) >= 0);
+        assert_se(sd_netlink_wait(rtnl, 0) == 0);
+        assert_se(sd_netlink_batch_end(rtnl) >= 0);
+
+        while (counter > 0) {
+                assert_se(sd_netlink_wait(rtnl, (uint64_t) -1) >= 0);
+                assert_se(sd_netlink_process(rtnl, NULL) >= 0);
+        }
+}
+
+static void test_read_buffer_reuse(sd_netlink *rtnl, int ifindex) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *first = NULL;
+        const char *str_data;
+        unsigned i;
+
+        /* a reply that is kept around must stay intact while later replies are read */
+        for (i = 0; i < 3 * RTNL_RBUFFER_SLOTS; i++) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL, *r = NULL;
+
+                assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK, ifindex) >= 0);
+                assert_se(sd_netlink_call(rtnl, m, 0, &r) == 1);
+
+                if (!first)
+                        first = TAKE_PTR(r);
+        }
+
+        assert_se(sd_netlink_message_read_string(first, IFLA_IFNAME, &str_data) >= 0);
+        assert_se(streq(str_data, "lo"));
+}
+
 static void test_slot_set(int ifindex) {
         _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL, *r = NULL;
@@ -414,7 +482,7 @@ static void test_pipe(int ifindex) {
         assert_se(sd_netlink_call_async(rtnl, NULL, m2, pipe_handler, NULL, &counter, 0, NULL) >= 0);
 
         while (counter > 0) {
-                assert_se(sd_netlink_wait(rtnl, 0) >= 0);
+                assert_se(sd_netlink_wait(rtnl, (uint64_t) -1) >= 0);
                 assert_se(sd_netlink_process(rtnl, NULL) >= 0);
         }
 
@@ -529,6 +597,8 @@ int main(void) {
         assert_se(if_loopback > 0);
 
         test_async(if_loopback);
+        test_batch(if_loopback);
+        test_read_buffer_reuse(rtnl, if_loopback);
         test_slot_set(if_loopback);
         test_async_destroy_callback(if_loopback);
         test_pipe(if_loopback);
@@ -2,8 +2,11 @@
 
 #include <errno.h>
 #include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <string.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 
 #include "sd-network.h"
 
@@ -82,21 +85,122 @@ _public_ int sd_network_get_route_domains(char ***ret) {
         return network_get_strv("ROUTE_DOMAINS", ret);
 }
 
-static int network_link_get_string(int ifindex, const char *field, char **ret) {
+/* Callers tend to query many fields of the same link in a row, networkctl even does so for all links. Hence
+ * keep the most recently parsed link state file around, and parse it again only when networkd replaced it in
+ * the meantime. networkd always writes these files atomically, so a changed inode or mtime tells us. The cache
+ * is shared by all threads, so that it doesn't need to be released when one of them exits. */
+static pthread_mutex_t link_state_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+        int ifindex;
+        dev_t dev;
+        ino_t ino;
+        struct timespec mtime;
+        char **pairs;
+} link_state_cache = {};
+
+static int link_state_cache_update(int ifindex) {
         char path[STRLEN("/run/systemd/netif/links/") + DECIMAL_STR_MAX(ifindex) + 1];
-        _cleanup_free_ char *s = NULL;
+        _cleanup_strv_free_ char **pairs = NULL;
+        struct stat st;
         int r;
 
-        assert_return(ifindex > 0, -EINVAL);
-        assert_return(ret, -EINVAL);
+        assert(ifindex > 0);
 
         xsprintf(path, "/run/systemd/netif/links/%i", ifindex);
 
-        r = parse_env_file(NULL, path, field, &s);
+        if (stat(path, &st) < 0)
+                return errno == ENOENT ? -ENODATA : -errno;
+
+        if (link_state_cache.ifindex == ifindex &&
+            link_state_cache.dev == st.st_dev &&
+            link_state_cache.ino == st.st_ino &&
+            link_state_cache.mtime.tv_sec == st.st_mtim.tv_sec &&
+            link_state_cache.mtime.tv_nsec == st.st_mtim.tv_nsec)
+                return 0;
+
+        link_state_cache.ifindex = 0;
+
+        r = load_env_file_pairs(NULL, path, &pairs);
         if (r == -ENOENT)
                 return -ENODATA;
         if (r < 0)
                 return r;
+
+        strv_free_and_replace(link_state_cache.pairs, pairs);
+        link_state_cache.ifindex = ifindex;
+        link_state_cache.dev = st.st_dev;
+        link_state_cache.ino = st.st_ino;
+        link_state_cache.mtime = st.st_mtim;
+
+        return 0;
+}
+
+static int network_link_get_fieldsv(int ifindex, va_list ap) {
+        const char *field;
+        int r;
+
+        assert(ifindex > 0);
+
+        r = link_state_cache_update(ifindex);
+        if (r < 0)
+                return r;
+
+        while ((field = va_arg(ap, const char*))) {
+                char **ret = va_arg(ap, char**), **k, **v;
+                const char *value = NULL;
+
+                /* Like parse_env_file(), the last assignment wins */
+                STRV_FOREACH_PAIR(k, v, link_state_cache.pairs)
+                        if (streq(*k, field))
+                                value = *v;
+
+                if (value) {
+                        *ret = strdup(value);
+                        if (!*ret)
+                                return -ENOMEM;
+                } else
+                        *ret = NULL;
+        }
+
+        return 0;
+}
+
+/* Takes pairs of field names and return parameters, terminated by NULL. All fields are read from the same version
+ * of the file. On failure, some of the return parameters may have been set already. */
+static int network_link_get_fields(int ifindex, ...) {
+        va_list ap;
+        int r;
+
+        assert(ifindex > 0);
+
+        assert_se(pthread_mutex_lock(&link_state_cache_mutex) == 0);
+
+        va_start(ap, ifindex);
+        r = network_link_get_fieldsv(ifindex, ap);
+        va_end(ap);
+
+        assert_se(pthread_mutex_unlock(&link_state_cache_mutex) == 0);
+
+        return r;
+}
+
+static int network_link_get_field(int ifindex, const char *field, char **ret) {
+        assert(field);
+        assert(ret);
+
+        return network_link_get_fields(ifindex, field, ret, NULL);
+}
+
+static int network_link_get_string(int ifindex, const char *field, char **ret) {
+        _cleanup_free_ char *s = NULL;
+        int r;
+
+        assert_return(ifindex > 0, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        r = network_link_get_field(ifindex, field, &s);
+        if (r < 0)
+                return r;
         if (isempty(s))
                 return -ENODATA;
 
@@ -106,7 +210,6 @@ static int network_link_get_string(int ifindex, const char *field, char **ret) {
 }
 
 static int network_link_get_strv(int ifindex, const char *key, char ***ret) {
-        char path[STRLEN("/run/systemd/netif/links/") + DECIMAL_STR_MAX(ifindex) + 1];
         _cleanup_strv_free_ char **a = NULL;
         _cleanup_free_ char *s = NULL;
         int r;
@@ -114,10 +217,7 @@ static int network_link_get_strv(int ifindex, const char *key, char ***ret) {
         assert_return(ifindex > 0, -EINVAL);
         assert_return(ret, -EINVAL);
 
-        xsprintf(path, "/run/systemd/netif/links/%i", ifindex);
-        r = parse_env_file(NULL, path, key, &s);
-        if (r == -ENOENT)
-                return -ENODATA;
+        r = network_link_get_field(ifindex, key, &s);
         if (r < 0)
                 return r;
         if (isempty(s)) {
@@ -205,17 +305,12 @@ _public_ int sd_network_link_get_route_domains(int ifindex, char ***ret) {
 }
 
 _public_ int sd_network_link_get_dns_default_route(int ifindex) {
-        char path[STRLEN("/run/systemd/netif/links/") + DECIMAL_STR_MAX(ifindex) + 1];
         _cleanup_free_ char *s = NULL;
         int r;
 
         assert_return(ifindex > 0, -EINVAL);
 
-        xsprintf(path, "/run/systemd/netif/links/%i", ifindex);
-
-        r = parse_env_file(NULL, path, "DNS_DEFAULT_ROUTE", &s);
-        if (r == -ENOENT)
-                return -ENODATA;
+        r = network_link_get_field(ifindex, "DNS_DEFAULT_ROUTE", &s);
         if (r < 0)
                 return r;
         if (isempty(s))
@@ -223,8 +318,52 @@ _public_ int sd_network_link_get_dns_default_route(int ifindex) {
         return parse_boolean(s);
 }
 
+_public_ int sd_network_link_get_setup_times(int ifindex, uint64_t *ret_started, uint64_t *ret_finished, uint64_t *ret_queued) {
+        _cleanup_free_ char *started = NULL, *finished = NULL, *queued = NULL;
+        uint64_t f = 0, q = 0;
+        usec_t s;
+        int r;
+
+        assert_return(ifindex > 0, -EINVAL);
+
+        r = network_link_get_fields(ifindex,
+                                    "SETUP_STARTED_USEC", &started,
+                                    "SETUP_FINISHED_USEC", &finished,
+                                    "SETUP_QUEUED_USEC", &queued,
+                                    NULL);
+        if (r < 0)
+                return r;
+        if (isempty(started))
+                return -ENODATA;
+
+        r = safe_atou64(started, &s);
+        if (r < 0)
+                return r;
+
+        /* Not set while the link is still being configured */
+        if (!isempty(finished)) {
+                r = safe_atou64(finished, &f);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!isempty(queued)) {
+                r = safe_atou64(queued, &q);
+                if (r < 0)
+                        return r;
+        }
+
+        if (ret_started)
+                *ret_started = s;
+        if (ret_finished)
+                *ret_finished = f;
+        if (ret_queued)
+                *ret_queued = q;
+
+        return 0;
+}
+
 static int network_link_get_ifindexes(int ifindex, const char *key, int **ret) {
-        char path[STRLEN("/run/systemd/netif/links/") + DECIMAL_STR_MAX(ifindex) + 1];
         _cleanup_free_ int *ifis = NULL;
         _cleanup_free_ char *s = NULL;
         size_t allocated = 0, c = 0;
@@ -234,10 +373,7 @@ static int network_link_get_ifindexes(int ifindex, const char *key, int **ret) {
         assert_return(ifindex > 0, -EINVAL);
         assert_return(ret, -EINVAL);
 
-        xsprintf(path, "/run/systemd/netif/links/%i", ifindex);
-        r = parse_env_file(NULL, path, key, &s);
-        if (r == -ENOENT)
-                return -ENODATA;
+        r = network_link_get_field(ifindex, key, &s);
         if (r < 0)
                 return r;
 
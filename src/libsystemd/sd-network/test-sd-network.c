@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <pthread.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-network.h"
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "mkdir.h"
+#include "process-util.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+static void write_link(int ifindex, const char *contents) {
+        char path[STRLEN("/run/systemd/netif/links/") + DECIMAL_STR_MAX(int) + 1];
+
+        /* networkd replaces the files atomically, too */
+        xsprintf(path, "/run/systemd/netif/links/%i", ifindex);
+        assert_se(write_string_file(path, contents, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC) >= 0);
+}
+
+static void check_state(int ifindex, const char *expected) {
+        _cleanup_free_ char *state = NULL;
+
+        if (!expected) {
+                assert_se(sd_network_link_get_operational_state(ifindex, &state) == -ENODATA);
+                return;
+        }
+
+        assert_se(sd_network_link_get_operational_state(ifindex, &state) >= 0);
+        assert_se(streq(state, expected));
+}
+
+static void *thread_check_state(void *p) {
+        check_state(1, "routable");
+        return NULL;
+}
+
+static void test_link_state_cache(void) {
+        uint64_t started, finished, queued;
+        pthread_t t;
+
+        write_link(1, "OPER_STATE=carrier\n");
+        write_link(2, "OPER_STATE=degraded\n");
+
+        check_state(1, "carrier");
+        check_state(2, "degraded");
+        check_state(1, "carrier");
+        check_state(3, NULL);
+
+        /* A replaced file is read again, the last assignment wins */
+        write_link(1, "OPER_STATE=carrier\nOPER_STATE=routable\n"
+                      "SETUP_STARTED_USEC=10\nSETUP_QUEUED_USEC=5\n");
+        check_state(1, "routable");
+
+        /* Other threads share the cache, and leave nothing behind when they exit */
+        assert_se(pthread_create(&t, NULL, thread_check_state, NULL) == 0);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        /* Configuration not finished yet */
+        assert_se(sd_network_link_get_setup_times(1, &started, &finished, &queued) >= 0);
+        assert_se(started == 10);
+        assert_se(finished == 0);
+        assert_se(queued == 5);
+
+        write_link(1, "OPER_STATE=routable\nSETUP_STARTED_USEC=10\nSETUP_FINISHED_USEC=20\nSETUP_QUEUED_USEC=7\n");
+        assert_se(sd_network_link_get_setup_times(1, &started, &finished, &queued) >= 0);
+        assert_se(started == 10);
+        assert_se(finished == 20);
+        assert_se(queued == 7);
+
+        assert_se(sd_network_link_get_setup_times(2, &started, &finished, &queued) == -ENODATA);
+
+        assert_se(unlink("/run/systemd/netif/links/1") >= 0);
+        check_state(1, NULL);
+        check_state(2, "degraded");
+}
+
+int main(int argc, char *argv[]) {
+        int r;
+
+        test_setup_logging(LOG_DEBUG);
+
+        if (geteuid() != 0)
+                return log_tests_skipped("not root");
+
+        /* Set up fake link state files in our own mount namespace */
+        r = safe_fork("(link-state)", FORK_DEATHSIG|FORK_LOG|FORK_WAIT|FORK_NEW_MOUNTNS|FORK_MOUNTNS_SLAVE, NULL);
+        assert_se(r >= 0);
+        if (r == 0) {
+                assert_se(mkdir_p("/run/systemd/netif", 0755) >= 0);
+                assert_se(mount("tmpfs", "/run/systemd/netif", "tmpfs", 0, NULL) >= 0);
+                assert_se(mkdir("/run/systemd/netif/links", 0755) >= 0);
+
+                test_link_state_cache();
+                _exit(EXIT_SUCCESS);
+        }
+
+        return 0;
+}
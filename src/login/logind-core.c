@@ -823,6 +823,11 @@ void manager_connect_utmp(Manager *m) {
                 if (r < 0)
                         log_warning_errno(r, "Failed to adjust utmp event source priority, ignoring: %m");
 
+                /* We reread the whole file on each event anyway, hence collapse bursts of writes to it */
+                r = sd_event_source_set_inotify_coalesce(s, 100 * USEC_PER_MSEC);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to enable coalescing of utmp inotify events, ignoring: %m");
+
                 (void) sd_event_source_set_description(s, "utmp");
         }
 
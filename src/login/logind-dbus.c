@@ -275,12 +275,22 @@ static int property_get_scheduled_shutdown(
         return sd_bus_message_close_container(reply);
 }
 
+static usec_t manager_session_create_average_usec(Manager *m) {
+        assert(m);
+
+        if (m->n_sessions_created == 0)
+                return 0;
+
+        return m->session_create_usec_total / m->n_sessions_created;
+}
+
 static BUS_DEFINE_PROPERTY_GET_ENUM(property_get_handle_action, handle_action, HandleAction);
 static BUS_DEFINE_PROPERTY_GET(property_get_docked, "b", Manager, manager_is_docked_or_external_displays);
 static BUS_DEFINE_PROPERTY_GET(property_get_lid_closed, "b", Manager, manager_is_lid_closed);
 static BUS_DEFINE_PROPERTY_GET_GLOBAL(property_get_on_external_power, "b", manager_is_on_external_power);
 static BUS_DEFINE_PROPERTY_GET_GLOBAL(property_get_compat_user_tasks_max, "t", CGROUP_LIMIT_MAX);
 static BUS_DEFINE_PROPERTY_GET_REF(property_get_hashmap_size, "t", Hashmap *, (uint64_t) hashmap_size);
+static BUS_DEFINE_PROPERTY_GET(property_get_session_create_average_usec, "t", Manager, manager_session_create_average_usec);
 
 static int method_get_session(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         _cleanup_free_ char *p = NULL;
@@ -608,11 +618,14 @@ static int method_create_session(sd_bus_message *message, void *userdata, sd_bus
         uint32_t vtnr = 0;
         SessionType t;
         SessionClass c;
+        usec_t start;
         int r;
 
         assert(message);
         assert(m);
 
+        start = now(CLOCK_MONOTONIC);
+
         assert_cc(sizeof(pid_t) == sizeof(uint32_t));
         assert_cc(sizeof(uid_t) == sizeof(uint32_t));
 
@@ -792,6 +805,7 @@ static int method_create_session(sd_bus_message *message, void *userdata, sd_bus
         session_set_user(session, user);
         session_set_leader(session, leader);
 
+        session->create_usec = start;
         session->type = t;
         session->class = c;
         session->remote = remote;
@@ -857,7 +871,7 @@ static int method_create_session(sd_bus_message *message, void *userdata, sd_bus
         if (r < 0)
                 goto fail;
 
-        r = session_start(session, message, error);
+        r = session_start(session, message);
         if (r < 0)
                 goto fail;
 
@@ -2666,6 +2680,9 @@ const sd_bus_vtable manager_vtable[] = {
         SD_BUS_PROPERTY("NCurrentInhibitors", "t", property_get_hashmap_size, offsetof(Manager, inhibitors), 0),
         SD_BUS_PROPERTY("SessionsMax", "t", NULL, offsetof(Manager, sessions_max), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("NCurrentSessions", "t", property_get_hashmap_size, offsetof(Manager, sessions), 0),
+        SD_BUS_PROPERTY("NSessionsCreated", "t", NULL, offsetof(Manager, n_sessions_created), 0),
+        SD_BUS_PROPERTY("SessionCreateAverageUSec", "t", property_get_session_create_average_usec, 0, 0),
+        SD_BUS_PROPERTY("SessionCreateMaxUSec", "t", NULL, offsetof(Manager, session_create_usec_max), 0),
         SD_BUS_PROPERTY("UserTasksMax", "t", property_get_compat_user_tasks_max, 0, SD_BUS_VTABLE_PROPERTY_CONST|SD_BUS_VTABLE_HIDDEN),
 
         SD_BUS_METHOD("GetSession", "s", "o", method_get_session, SD_BUS_VTABLE_UNPRIVILEGED),
@@ -2778,8 +2795,8 @@ int match_job_removed(sd_bus_message *message, void *userdata, sd_bus_error *err
                         session->scope_job = mfree(session->scope_job);
                         (void) session_jobs_reply(session, unit, result);
 
-                        session_save(session);
-                        user_save(session->user);
+                        session_save_later(session);
+                        user_save_later(session->user);
                 }
 
                 session_add_to_gc_queue(session);
@@ -2793,7 +2810,7 @@ int match_job_removed(sd_bus_message *message, void *userdata, sd_bus_error *err
                         LIST_FOREACH(sessions_by_user, session, user->sessions)
                                 (void) session_jobs_reply(session, unit, NULL /* don't propagate user service failures to the client */);
 
-                        user_save(user);
+                        user_save_later(user);
                 }
 
                 user_add_to_gc_queue(user);
@@ -2931,17 +2948,19 @@ int manager_start_scope(
                 char **after,
                 const char *requires_mounts_for,
                 sd_bus_message *more_properties,
-                sd_bus_error *error,
-                char **job) {
+                sd_bus_message_handler_t callback,
+                void *userdata,
+                sd_bus_slot **ret_slot) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
         char **i;
         int r;
 
         assert(manager);
         assert(scope);
         assert(pid > 1);
-        assert(job);
+        assert(callback);
+        assert(ret_slot);
 
         r = sd_bus_message_new_method_call(
                         manager->bus,
@@ -3021,11 +3040,8 @@ int manager_start_scope(
         if (r < 0)
                 return r;
 
-        r = sd_bus_call(manager->bus, m, 0, error, &reply);
-        if (r < 0)
-                return r;
-
-        return strdup_job(reply, job);
+        /* The reply, carrying the job or an error, is passed to the callback */
+        return sd_bus_call_async(manager->bus, ret_slot, m, callback, userdata, 0);
 }
 
 int manager_start_unit(Manager *manager, const char *unit, sd_bus_error *error, char **job) {
@@ -5,6 +5,7 @@
 
 #include "alloc-util.h"
 #include "bus-common-errors.h"
+#include "bus-error.h"
 #include "bus-label.h"
 #include "bus-util.h"
 #include "fd-util.h"
@@ -15,6 +16,7 @@
 #include "signal-util.h"
 #include "stat-util.h"
 #include "strv.h"
+#include "time-util.h"
 #include "util.h"
 
 static int property_get_user(
@@ -705,14 +707,16 @@ static bool session_ready(Session *s) {
 
         /* Returns true when the session is ready, i.e. all jobs we enqueued for it are done (regardless if successful or not) */
 
-        return !s->scope_job &&
+        return !s->start_scope_slot &&
+                !s->scope_job &&
                 !s->user->service_job;
 }
 
-int session_send_create_reply(Session *s, sd_bus_error *error) {
+int session_send_create_reply(Session *s, const sd_bus_error *error) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *c = NULL;
         _cleanup_close_ int fifo_fd = -1;
         _cleanup_free_ char *p = NULL;
+        usec_t latency;
 
         assert(s);
 
@@ -726,23 +730,40 @@ int session_send_create_reply(Session *s, sd_bus_error *error) {
                 return 0;
 
         c = TAKE_PTR(s->create_message);
-        if (error)
+
+        if (s->create_usec > 0) {
+                latency = usec_sub_unsigned(now(CLOCK_MONOTONIC), s->create_usec);
+
+                s->manager->n_sessions_created++;
+                s->manager->session_create_usec_total += latency;
+                s->manager->session_create_usec_max = MAX(s->manager->session_create_usec_max, latency);
+        } else
+                latency = USEC_INFINITY;
+
+        if (error) {
+                log_debug("Session %s could not be created after %s: %s",
+                          s->id, format_timespan((char[FORMAT_TIMESPAN_MAX]) {}, FORMAT_TIMESPAN_MAX, latency, USEC_PER_MSEC), bus_error_message(error, 0));
                 return sd_bus_reply_method_error(c, error);
+        }
 
         fifo_fd = session_create_fifo(s);
         if (fifo_fd < 0)
                 return fifo_fd;
 
-        /* Update the session state file before we notify the client about the result. */
+        /* Update the session state file before we notify the client about the result. pam_systemd reads the
+         * user's state file too, so write out pending changes to it as well. */
         session_save(s);
+        if (s->user->in_save_queue)
+                user_save(s->user);
 
         p = session_bus_path(s);
         if (!p)
                 return -ENOMEM;
 
-        log_debug("Sending reply about created session: "
+        log_debug("Sending reply about created session after %s: "
                   "id=%s object_path=%s uid=%u runtime_path=%s "
                   "session_fd=%d seat=%s vtnr=%u",
+                  format_timespan((char[FORMAT_TIMESPAN_MAX]) {}, FORMAT_TIMESPAN_MAX, latency, USEC_PER_MSEC),
                   s->id,
                   p,
                   (uint32_t) s->user->uid,
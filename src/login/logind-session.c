@@ -90,6 +90,9 @@ Session* session_free(Session *s) {
         if (s->in_gc_queue)
                 LIST_REMOVE(gc_queue, s->manager->session_gc_queue, s);
 
+        if (s->in_save_queue)
+                LIST_REMOVE(save_queue, s->manager->session_save_queue, s);
+
         s->timer_event_source = sd_event_source_unref(s->timer_event_source);
 
         session_remove_fifo(s);
@@ -129,6 +132,7 @@ Session* session_free(Session *s) {
                 (void) hashmap_remove_value(s->manager->sessions_by_leader, PID_TO_PTR(s->leader), s);
 
         free(s->scope_job);
+        sd_bus_slot_unref(s->start_scope_slot);
 
         sd_bus_message_unref(s->create_message);
 
@@ -199,6 +203,12 @@ int session_save(Session *s) {
 
         assert(s);
 
+        /* We are writing the file right now, a queued write would only repeat this */
+        if (s->in_save_queue) {
+                LIST_REMOVE(save_queue, s->manager->session_save_queue, s);
+                s->in_save_queue = false;
+        }
+
         if (!s->user)
                 return -ESTALE;
 
@@ -349,6 +359,19 @@ fail:
         return log_error_errno(r, "Failed to save session data %s: %m", s->state_file);
 }
 
+void session_save_later(Session *s) {
+        assert(s);
+
+        /* Many state changes come in bursts (a session is started, its user elects a new display, its scope job
+         * finishes, …), write the state file only once for all of them, see manager_save_queued(). */
+
+        if (s->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, s->manager->session_save_queue, s);
+        s->in_save_queue = true;
+}
+
 static int session_load_devices(Session *s, const char *devices) {
         const char *p;
         int r = 0;
@@ -619,7 +642,51 @@ int session_activate(Session *s) {
         return 0;
 }
 
-static int session_start_scope(Session *s, sd_bus_message *properties, sd_bus_error *error) {
+static void session_start_scope_failed(Session *s, const sd_bus_error *error) {
+        assert(s);
+
+        /* Forget about the scope, so that the session is dropped by the GC once the client got the error */
+        (void) hashmap_remove_value(s->manager->session_units, s->scope, s);
+        s->scope = mfree(s->scope);
+
+        (void) session_send_create_reply(s, error);
+        session_add_to_gc_queue(s);
+}
+
+static int session_start_scope_handler(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        Session *s = userdata;
+        const char *job;
+        int r;
+
+        assert(m);
+        assert(s);
+
+        s->start_scope_slot = sd_bus_slot_unref(s->start_scope_slot);
+
+        if (sd_bus_message_is_method_error(m, NULL)) {
+                const sd_bus_error *e = sd_bus_message_get_error(m);
+
+                log_error_errno(sd_bus_error_get_errno(e), "Failed to start session scope %s: %s", s->scope, bus_error_message(e, 0));
+                session_start_scope_failed(s, e);
+                return 0;
+        }
+
+        r = sd_bus_message_read(m, "o", &job);
+        if (r >= 0 && !s->stopping) /* If the session is stopped already, scope_job refers to the stop job */
+                r = free_and_strdup(&s->scope_job, job);
+        if (r < 0) {
+                log_error_errno(r, "Failed to process reply to starting session scope %s: %m", s->scope);
+                (void) sd_bus_error_set_errno(&error, r);
+                session_start_scope_failed(s, &error);
+                return 0;
+        }
+
+        session_save_later(s);
+        return 0;
+}
+
+static int session_start_scope(Session *s, sd_bus_message *properties) {
         int r;
 
         assert(s);
@@ -637,6 +704,8 @@ static int session_start_scope(Session *s, sd_bus_message *properties, sd_bus_er
 
                 description = strjoina("Session ", s->id, " of user ", s->user->name);
 
+                /* Don't wait for the reply here: with thousands of sessions logging in at the same time we would
+                 * otherwise handle them one after the other, see session_start_scope_handler() for the rest. */
                 r = manager_start_scope(
                                 s->manager,
                                 scope,
@@ -647,10 +716,11 @@ static int session_start_scope(Session *s, sd_bus_message *properties, sd_bus_er
                                 STRV_MAKE("systemd-logind.service", "systemd-user-sessions.service", s->user->runtime_dir_service, s->user->service), /* And order us after some more */
                                 s->user->home,
                                 properties,
-                                error,
-                                &s->scope_job);
+                                session_start_scope_handler,
+                                s,
+                                &s->start_scope_slot);
                 if (r < 0)
-                        return log_error_errno(r, "Failed to start session scope %s: %s", scope, bus_error_message(error, r));
+                        return log_error_errno(r, "Failed to start session scope %s: %m", scope);
 
                 s->scope = TAKE_PTR(scope);
         }
@@ -661,7 +731,7 @@ static int session_start_scope(Session *s, sd_bus_message *properties, sd_bus_er
         return 0;
 }
 
-int session_start(Session *s, sd_bus_message *properties, sd_bus_error *error) {
+int session_start(Session *s, sd_bus_message *properties) {
         int r;
 
         assert(s);
@@ -679,7 +749,7 @@ int session_start(Session *s, sd_bus_message *properties, sd_bus_error *error) {
         if (r < 0)
                 return r;
 
-        r = session_start_scope(s, properties, error);
+        r = session_start_scope(s, properties);
         if (r < 0)
                 return r;
 
@@ -701,8 +771,8 @@ int session_start(Session *s, sd_bus_message *properties, sd_bus_error *error) {
         user_elect_display(s->user);
 
         /* Save data */
-        session_save(s);
-        user_save(s->user);
+        session_save_later(s);
+        user_save_later(s->user);
         if (s->seat)
                 seat_save(s->seat);
 
@@ -794,8 +864,8 @@ int session_stop(Session *s, bool force) {
 
         user_elect_display(s->user);
 
-        session_save(s);
-        user_save(s->user);
+        session_save_later(s);
+        user_save_later(s->user);
 
         return r;
 }
@@ -841,7 +911,7 @@ int session_finalize(Session *s) {
                 seat_save(s->seat);
         }
 
-        user_save(s->user);
+        user_save_later(s->user);
         user_send_changed(s->user, "Display", NULL);
 
         return 0;
@@ -1095,6 +1165,9 @@ bool session_may_gc(Session *s, bool drop_not_started) {
                         return false;
         }
 
+        if (s->start_scope_slot)
+                return false;
+
         if (s->scope_job) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
 
@@ -80,6 +80,7 @@ struct Session {
 
         char *scope;
         char *scope_job;
+        sd_bus_slot *start_scope_slot;
 
         Seat *seat;
         unsigned vtnr;
@@ -99,12 +100,14 @@ struct Session {
         bool locked_hint;
 
         bool in_gc_queue:1;
+        bool in_save_queue:1;
         bool started:1;
         bool stopping:1;
 
         bool was_active:1;
 
         sd_bus_message *create_message;
+        usec_t create_usec; /* When CreateSession() was called, in CLOCK_MONOTONIC */
 
         /* Set up when a client requested to release the session via the bus */
         sd_event_source *timer_event_source;
@@ -117,6 +120,7 @@ struct Session {
         LIST_FIELDS(Session, sessions_by_seat);
 
         LIST_FIELDS(Session, gc_queue);
+        LIST_FIELDS(Session, save_queue);
 };
 
 int session_new(Session **ret, Manager *m, const char *id);
@@ -135,11 +139,12 @@ void session_set_idle_hint(Session *s, bool b);
 int session_get_locked_hint(Session *s);
 void session_set_locked_hint(Session *s, bool b);
 int session_create_fifo(Session *s);
-int session_start(Session *s, sd_bus_message *properties, sd_bus_error *error);
+int session_start(Session *s, sd_bus_message *properties);
 int session_stop(Session *s, bool force);
 int session_finalize(Session *s);
 int session_release(Session *s);
 int session_save(Session *s);
+void session_save_later(Session *s);
 int session_load(Session *s);
 int session_kill(Session *s, KillWho who, int signo);
 
@@ -155,7 +160,7 @@ int session_send_changed(Session *s, const char *properties, ...) _sentinel_;
 int session_send_lock(Session *s, bool lock);
 int session_send_lock_all(Manager *m, bool lock);
 
-int session_send_create_reply(Session *s, sd_bus_error *error);
+int session_send_create_reply(Session *s, const sd_bus_error *error);
 
 const char* session_state_to_string(SessionState t) _const_;
 SessionState session_state_from_string(const char *s) _pure_;
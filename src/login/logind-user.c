@@ -114,6 +114,9 @@ User *user_free(User *u) {
         if (u->in_gc_queue)
                 LIST_REMOVE(gc_queue, u->manager->user_gc_queue, u);
 
+        if (u->in_save_queue)
+                LIST_REMOVE(save_queue, u->manager->user_save_queue, u);
+
         while (u->sessions)
                 session_free(u->sessions);
 
@@ -302,12 +305,31 @@ fail:
 int user_save(User *u) {
         assert(u);
 
+        /* We are writing the file right now, a queued write would only repeat this */
+        if (u->in_save_queue) {
+                LIST_REMOVE(save_queue, u->manager->user_save_queue, u);
+                u->in_save_queue = false;
+        }
+
         if (!u->started)
                 return 0;
 
         return user_save_internal(u);
 }
 
+void user_save_later(User *u) {
+        assert(u);
+
+        /* The state file lists all sessions of the user, don't rewrite it for each of them when many sessions of
+         * the same user come and go at once, see manager_save_queued(). */
+
+        if (u->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, u->manager->user_save_queue, u);
+        u->in_save_queue = true;
+}
+
 int user_load(User *u) {
         _cleanup_free_ char *realtime = NULL, *monotonic = NULL, *stopping = NULL, *last_session_timestamp = NULL;
         int r;
@@ -390,7 +412,7 @@ int user_start(User *u) {
         }
 
         /* Save new user data */
-        user_save(u);
+        user_save_later(u);
 
         return 0;
 }
@@ -426,7 +448,7 @@ int user_stop(User *u, bool force) {
                 return 0;
 
         if (u->stopping) { /* Stop jobs have already been queued */
-                user_save(u);
+                user_save_later(u);
                 return 0;
         }
 
@@ -442,7 +464,7 @@ int user_stop(User *u, bool force) {
 
         u->stopping = true;
 
-        user_save(u);
+        user_save_later(u);
 
         return r;
 }
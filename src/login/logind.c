@@ -993,6 +993,21 @@ static void manager_gc(Manager *m, bool drop_not_started) {
         }
 }
 
+static void manager_save_queued(Manager *m) {
+        Session *session;
+        User *user;
+
+        assert(m);
+
+        /* Writes out the state files of everything that changed since the last iteration of the event loop */
+
+        while ((session = m->session_save_queue))
+                (void) session_save(session);
+
+        while ((user = m->user_save_queue))
+                (void) user_save(user);
+}
+
 static int manager_dispatch_idle_action(sd_event_source *s, uint64_t t, void *userdata) {
         Manager *m = userdata;
         struct dual_timestamp since;
@@ -1151,7 +1166,7 @@ static int manager_startup(Manager *m) {
                 (void) user_start(user);
 
         HASHMAP_FOREACH(session, m->sessions, i)
-                (void) session_start(session, NULL, NULL);
+                (void) session_start(session, NULL);
 
         HASHMAP_FOREACH(inhibitor, m->inhibitors, i)
                 inhibitor_start(inhibitor);
@@ -1173,8 +1188,10 @@ static int manager_run(Manager *m) {
                 r = sd_event_get_state(m->event);
                 if (r < 0)
                         return r;
-                if (r == SD_EVENT_FINISHED)
+                if (r == SD_EVENT_FINISHED) {
+                        manager_save_queued(m);
                         return 0;
+                }
 
                 manager_gc(m, true);
 
@@ -1184,6 +1201,8 @@ static int manager_run(Manager *m) {
                 if (r > 0)
                         continue;
 
+                manager_save_queued(m);
+
                 r = sd_event_run(m->event, (uint64_t) -1);
                 if (r < 0)
                         return r;
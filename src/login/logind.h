@@ -35,6 +35,10 @@ struct Manager {
         LIST_HEAD(Session, session_gc_queue);
         LIST_HEAD(User, user_gc_queue);
 
+        /* Sessions and users whose state files need to be rewritten, flushed once per event loop iteration */
+        LIST_HEAD(Session, session_save_queue);
+        LIST_HEAD(User, user_save_queue);
+
         sd_device_monitor *device_seat_monitor, *device_monitor, *device_vcsa_monitor, *device_button_monitor;
 
         sd_event_source *console_active_event_source;
@@ -120,6 +124,11 @@ struct Manager {
         uint64_t user_tasks_max;
         uint64_t sessions_max;
         uint64_t inhibitors_max;
+
+        /* How long it took to reply to CreateSession() calls */
+        uint64_t n_sessions_created;
+        usec_t session_create_usec_total;
+        usec_t session_create_usec_max;
 };
 
 void manager_reset_config(Manager *m);
@@ -167,7 +176,7 @@ int bus_manager_shutdown_or_sleep_now_or_later(Manager *m, const char *unit_name
 
 int manager_send_changed(Manager *manager, const char *property, ...) _sentinel_;
 
-int manager_start_scope(Manager *manager, const char *scope, pid_t pid, const char *slice, const char *description, char **wants, char **after, const char *requires_mounts_for, sd_bus_message *more_properties, sd_bus_error *error, char **job);
+int manager_start_scope(Manager *manager, const char *scope, pid_t pid, const char *slice, const char *description, char **wants, char **after, const char *requires_mounts_for, sd_bus_message *more_properties, sd_bus_message_handler_t callback, void *userdata, sd_bus_slot **ret_slot);
 int manager_start_unit(Manager *manager, const char *unit, sd_bus_error *error, char **job);
 int manager_stop_unit(Manager *manager, const char *unit, sd_bus_error *error, char **job);
 int manager_abandon_scope(Manager *manager, const char *scope, sd_bus_error *error);
@@ -231,6 +231,9 @@ int bus_image_method_mark_read_only(
         if (r < 0)
                 return r;
 
+        /* Changing the read-only flag of a subvolume does not generate an inotify event */
+        manager_image_changed(m, image->name);
+
         return sd_bus_reply_method_return(message, NULL);
 }
 
@@ -270,6 +273,8 @@ int bus_image_method_set_limit(
         if (r < 0)
                 return r;
 
+        manager_image_changed(m, image->name);
+
         return sd_bus_reply_method_return(message, NULL);
 }
 
@@ -462,8 +467,9 @@ char *image_bus_path(const char *name) {
 }
 
 int image_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
-        _cleanup_hashmap_free_ Hashmap *images = NULL;
         _cleanup_strv_free_ char **l = NULL;
+        Manager *m = userdata;
+        Hashmap *images;
         Image *image;
         Iterator i;
         int r;
@@ -471,12 +477,9 @@ int image_node_enumerator(sd_bus *bus, const char *path, void *userdata, char **
         assert(bus);
         assert(path);
         assert(nodes);
+        assert(m);
 
-        images = hashmap_new(&image_hash_ops);
-        if (!images)
-                return -ENOMEM;
-
-        r = image_discover(IMAGE_MACHINE, images);
+        r = manager_get_images(m, &images);
         if (r < 0)
                 return r;
 
@@ -1,7 +1,12 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "machine-image.h"
 #include "machined.h"
 #include "nscd-flush.h"
+#include "string-util.h"
 #include "strv.h"
 
 static int on_nscd_cache_flush_event(sd_event_source *s, void *userdata) {
@@ -34,3 +39,200 @@ int manager_enqueue_nscd_cache_flush(Manager *m) {
 
         return 0;
 }
+
+static void manager_image_index_invalidate(Manager *m) {
+        assert(m);
+
+        m->image_index = hashmap_free(m->image_index);
+        set_clear_free(m->image_index_dirty);
+}
+
+static int on_image_dir_event(sd_event_source *s, const struct inotify_event *event, void *userdata) {
+        Manager *m = userdata;
+        const char *e;
+
+        assert(m);
+        assert(event);
+
+        if (event->mask & (IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT)) {
+                const void *path;
+                sd_event_source *i;
+                Iterator j;
+
+                /* The directory itself went away, forget about the watch, and read everything anew next time */
+                HASHMAP_FOREACH_KEY(i, path, m->image_watches, j)
+                        if (i == s) {
+                                hashmap_remove(m->image_watches, path);
+                                sd_event_source_unref(i);
+                                break;
+                        }
+
+                manager_image_index_invalidate(m);
+                return 0;
+        }
+
+        if (FLAGS_SET(event->mask, IN_Q_OVERFLOW) || event->len == 0) {
+                manager_image_index_invalidate(m);
+                return 0;
+        }
+
+        e = endswith(event->name, ".raw");
+        if (e) {
+                _cleanup_free_ char *name = NULL;
+
+                name = strndup(event->name, e - event->name);
+                if (!name)
+                        return log_oom();
+
+                manager_image_changed(m, name);
+        } else
+                manager_image_changed(m, event->name);
+
+        return 0;
+}
+
+static int manager_watch_image_dirs(Manager *m) {
+        const char *path;
+        bool added = false;
+        int r;
+
+        assert(m);
+
+        if (m->image_index_unwatched)
+                return 0;
+
+        r = hashmap_ensure_allocated(&m->image_watches, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        /* Directories in the search path may show up at any time, hence check for the ones we don't watch yet on
+         * every call. That's a few syscalls, rather than a full rescan. */
+        NULSTR_FOREACH(path, image_search_path_nulstr(IMAGE_MACHINE)) {
+                _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+
+                if (hashmap_contains(m->image_watches, path))
+                        continue;
+
+                if (access(path, F_OK) < 0)
+                        continue;
+
+                r = sd_event_add_inotify(m->event, &s, path,
+                                         IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_CLOSE_WRITE|IN_ATTRIB|
+                                         IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR,
+                                         on_image_dir_event, m);
+                if (r < 0) {
+                        /* Without change notifications there's no point in keeping an index */
+                        log_debug_errno(r, "Failed to watch %s for changes, enumerating images on every request: %m", path);
+                        m->image_index_unwatched = true;
+                        manager_images_flush(m);
+                        return 0;
+                }
+
+                (void) sd_event_source_set_description(s, "image-dir-inotify");
+
+                r = hashmap_put(m->image_watches, path, s);
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(s);
+                added = true;
+        }
+
+        /* Images in the new directory might take precedence over ones we know already, start over */
+        if (added)
+                manager_image_index_invalidate(m);
+
+        return 0;
+}
+
+int manager_get_images(Manager *m, Hashmap **ret) {
+        _cleanup_hashmap_free_ Hashmap *images = NULL;
+        char *name;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        /* Returns the images in the search path. Listing them on every request gets slow with a lot of images,
+         * as we look at each one, hence this is answered from the index, and only what changed since the last
+         * call is looked at again. The returned hashmap is owned by the manager and valid until we return to
+         * the event loop. */
+
+        r = manager_watch_image_dirs(m);
+        if (r < 0)
+                return r;
+
+        /* We wouldn't learn about changes, hence start over each time */
+        if (m->image_index_unwatched)
+                manager_image_index_invalidate(m);
+
+        if (!m->image_index) {
+                images = hashmap_new(&image_hash_ops);
+                if (!images)
+                        return -ENOMEM;
+
+                r = image_discover(IMAGE_MACHINE, images);
+                if (r < 0)
+                        return r;
+
+                set_clear_free(m->image_index_dirty);
+                m->image_index = TAKE_PTR(images);
+        }
+
+        while ((name = set_steal_first(m->image_index_dirty))) {
+                _cleanup_(image_unrefp) Image *image = NULL;
+                _cleanup_free_ char *n = name;
+
+                image_unref(hashmap_remove(m->image_index, n));
+
+                r = image_find(IMAGE_MACHINE, n, &image);
+                if (r == -ENOENT)
+                        continue;
+                if (r < 0) {
+                        manager_image_index_invalidate(m);
+                        return r;
+                }
+
+                r = hashmap_put(m->image_index, image->name, image);
+                if (r < 0) {
+                        manager_image_index_invalidate(m);
+                        return r;
+                }
+
+                TAKE_PTR(image);
+        }
+
+        *ret = m->image_index;
+        return 0;
+}
+
+void manager_image_changed(Manager *m, const char *name) {
+        assert(m);
+        assert(name);
+
+        /* Makes sure the image is looked at again on the next request, for changes we are not told about via
+         * inotify, such as the limits or the read-only flag of btrfs subvolumes */
+
+        if (!m->image_index)
+                return;
+
+        if (!image_name_is_valid(name))
+                return;
+
+        if (set_ensure_allocated(&m->image_index_dirty, &string_hash_ops) < 0 ||
+            set_put_strdup(m->image_index_dirty, name) < 0)
+                manager_image_index_invalidate(m);
+}
+
+void manager_images_flush(Manager *m) {
+        sd_event_source *s;
+
+        assert(m);
+
+        manager_image_index_invalidate(m);
+        m->image_index_dirty = set_free_free(m->image_index_dirty);
+
+        while ((s = hashmap_steal_first(m->image_watches)))
+                sd_event_source_unref(s);
+        m->image_watches = hashmap_free(m->image_watches);
+}
@@ -8,6 +8,7 @@
 
 #include "hashmap.h"
 #include "list.h"
+#include "set.h"
 
 typedef struct Manager Manager;
 
@@ -29,6 +30,13 @@ struct Manager {
         Hashmap *image_cache;
         sd_event_source *image_cache_defer_event;
 
+        /* All images in the search path, kept up-to-date through inotify and refreshed lazily when asked for.
+         * NULL if not read yet. */
+        Hashmap *image_index;
+        Set *image_index_dirty;
+        Hashmap *image_watches;
+        bool image_index_unwatched;
+
         LIST_HEAD(Machine, machine_gc_queue);
 
         Machine *host_machine;
@@ -57,3 +65,7 @@ int manager_unit_is_active(Manager *manager, const char *unit);
 int manager_job_is_active(Manager *manager, const char *path);
 
 int manager_enqueue_nscd_cache_flush(Manager *m);
+
+int manager_get_images(Manager *m, Hashmap **ret);
+void manager_image_changed(Manager *m, const char *name);
+void manager_images_flush(Manager *m);
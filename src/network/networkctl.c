@@ -740,6 +740,7 @@ static int link_status_one(
         const char *on_color_operational, *off_color_operational,
                    *on_color_setup, *off_color_setup;
         _cleanup_free_ int *carrier_bound_to = NULL, *carrier_bound_by = NULL;
+        uint64_t setup_started, setup_finished, setup_queued;
         int r;
 
         assert(rtnl);
@@ -833,6 +834,19 @@ static int link_status_one(
         if (tz)
                 printf("       Time Zone: %s\n", tz);
 
+        if (sd_network_link_get_setup_times(info->ifindex, &setup_started, &setup_finished, &setup_queued) >= 0) {
+                char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX];
+
+                if (setup_finished >= setup_started)
+                        printf("      Setup Time: %s (%s waiting for netlink)\n",
+                               format_timespan(a, sizeof(a), setup_finished - setup_started, USEC_PER_MSEC),
+                               format_timespan(b, sizeof(b), setup_queued, USEC_PER_MSEC));
+                else
+                        printf("      Setup Time: configuring since %s after boot (%s waiting for netlink)\n",
+                               format_timespan(a, sizeof(a), setup_started, USEC_PER_MSEC),
+                               format_timespan(b, sizeof(b), setup_queued, USEC_PER_MSEC));
+        }
+
         (void) dump_lldp_neighbors("    Connected To: ", info->ifindex);
 
         return 0;
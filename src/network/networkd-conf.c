@@ -11,7 +11,11 @@
 #include "extract-word.h"
 #include "hexdecoct.h"
 #include "networkd-conf.h"
+#include "networkd-manager.h"
 #include "networkd-network.h"
+#include "networkd-route.h"
+#include "parse-util.h"
+#include "set.h"
 #include "string-table.h"
 
 int manager_parse_config_file(Manager *m) {
@@ -19,7 +23,8 @@ int manager_parse_config_file(Manager *m) {
 
         return config_parse_many_nulstr(PKGSYSCONFDIR "/networkd.conf",
                                         CONF_PATHS_NULSTR("systemd/networkd.conf.d"),
-                                        "DHCP\0",
+                                        "DHCP\0"
+                                        "Network\0",
                                         config_item_perf_lookup, networkd_gperf_lookup,
                                         CONFIG_PARSE_WARN, m);
 }
@@ -164,3 +169,115 @@ int config_parse_duid_rawdata(
         ret->raw_data_len = count;
         return 0;
 }
+
+int config_parse_ignore_foreign_route_protocols(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        Set **protocols = data;
+        const char *p = rvalue;
+        int r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(protocols);
+
+        if (isempty(rvalue)) {
+                *protocols = set_free(*protocols);
+                return 0;
+        }
+
+        for (;;) {
+                _cleanup_free_ char *word = NULL;
+                int protocol;
+
+                r = extract_first_word(&p, &word, NULL, 0);
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, r, "Invalid syntax, ignoring: %s", rvalue);
+                        return 0;
+                }
+                if (r == 0)
+                        return 0;
+
+                protocol = route_protocol_from_string(word);
+                if (protocol <= 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, 0, "Failed to parse route protocol '%s', ignoring.", word);
+                        continue;
+                }
+
+                r = set_ensure_allocated(protocols, NULL);
+                if (r < 0)
+                        return log_oom();
+
+                r = set_put(*protocols, INT_TO_PTR(protocol));
+                if (r < 0)
+                        return log_oom();
+        }
+}
+
+int config_parse_ignore_foreign_route_tables(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        Set **tables = data;
+        const char *p = rvalue;
+        int r;
+
+        assert(filename);
+        assert(lvalue);
+        assert(rvalue);
+        assert(tables);
+
+        if (isempty(rvalue)) {
+                *tables = set_free(*tables);
+                return 0;
+        }
+
+        for (;;) {
+                _cleanup_free_ char *word = NULL;
+                uint32_t table;
+
+                r = extract_first_word(&p, &word, NULL, 0);
+                if (r == -ENOMEM)
+                        return log_oom();
+                if (r < 0) {
+                        log_syntax(unit, LOG_WARNING, filename, line, r, "Invalid syntax, ignoring: %s", rvalue);
+                        return 0;
+                }
+                if (r == 0)
+                        return 0;
+
+                r = safe_atou32(word, &table);
+                if (r < 0 || table == RT_TABLE_UNSPEC) {
+                        log_syntax(unit, LOG_WARNING, filename, line, r, "Failed to parse route table '%s', ignoring.", word);
+                        continue;
+                }
+
+                r = set_ensure_allocated(tables, NULL);
+                if (r < 0)
+                        return log_oom();
+
+                r = set_put(*tables, UINT32_TO_PTR(table));
+                if (r < 0)
+                        return log_oom();
+        }
+}
@@ -15,3 +15,5 @@ const struct ConfigPerfItem* networkd_gperf_lookup(const char *key, GPERF_LEN_TY
 
 CONFIG_PARSER_PROTOTYPE(config_parse_duid_type);
 CONFIG_PARSER_PROTOTYPE(config_parse_duid_rawdata);
+CONFIG_PARSER_PROTOTYPE(config_parse_ignore_foreign_route_protocols);
+CONFIG_PARSER_PROTOTYPE(config_parse_ignore_foreign_route_tables);
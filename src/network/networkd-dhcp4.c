@@ -4,7 +4,11 @@
 #include <linux/if.h>
 
 #include "alloc-util.h"
+#include "env-file.h"
+#include "ether-addr-util.h"
+#include "fileio.h"
 #include "hostname-util.h"
+#include "mkdir.h"
 #include "parse-util.h"
 #include "netdev/vrf.h"
 #include "network-internal.h"
@@ -398,6 +402,76 @@ static int dhcp_lease_renew(sd_dhcp_client *client, Link *link) {
         return 0;
 }
 
+/* The address of the last lease is kept in persistent storage, keyed by the hardware address of the link,
+ * so that after a reboot the client can ask for it again right away (INIT-REBOOT), rather than going
+ * through DISCOVER and OFFER first. */
+static int dhcp4_persistent_lease_path(Link *link, char **ret) {
+        char buf[ETHER_ADDR_TO_STRING_MAX];
+        char *p;
+
+        assert(link);
+        assert(ret);
+
+        if (ether_addr_is_null(&link->mac))
+                return -ENODATA;
+
+        p = strjoin("/var/lib/systemd/network/dhcp4-leases/", ether_addr_to_string(&link->mac, buf));
+        if (!p)
+                return -ENOMEM;
+
+        *ret = p;
+        return 0;
+}
+
+static int dhcp4_save_persistent_lease(Link *link, const struct in_addr *address) {
+        _cleanup_free_ char *path = NULL;
+        const char *contents;
+        int r;
+
+        assert(link);
+        assert(address);
+
+        r = dhcp4_persistent_lease_path(link, &path);
+        if (r < 0)
+                return r;
+
+        (void) mkdir_parents(path, 0755);
+
+        contents = strjoina("ADDRESS=", inet_ntoa(*address), "\n");
+        return write_string_file(path, contents,
+                                 WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC|WRITE_STRING_FILE_AVOID_NEWLINE);
+}
+
+static int dhcp4_load_persistent_lease(Link *link) {
+        _cleanup_free_ char *path = NULL, *address_string = NULL;
+        union in_addr_union address;
+        int r;
+
+        assert(link);
+        assert(link->dhcp_client);
+
+        r = dhcp4_persistent_lease_path(link, &path);
+        if (r < 0)
+                return r;
+
+        r = parse_env_file(NULL, path, "ADDRESS", &address_string);
+        if (r < 0)
+                return r;
+        if (!address_string)
+                return -ENODATA;
+
+        r = in_addr_from_string(AF_INET, address_string, &address);
+        if (r < 0)
+                return r;
+
+        r = sd_dhcp_client_set_request_address(link->dhcp_client, &address.in);
+        if (r < 0)
+                return r;
+
+        log_link_debug(link, "DHCP4 CLIENT: Requesting previously leased address %s", address_string);
+        return 0;
+}
+
 static int dhcp_lease_acquired(sd_dhcp_client *client, Link *link) {
         sd_dhcp_lease *lease;
         struct in_addr address;
@@ -450,6 +524,12 @@ static int dhcp_lease_acquired(sd_dhcp_client *client, Link *link) {
         link->dhcp_lease = sd_dhcp_lease_ref(lease);
         link_dirty(link);
 
+        if (link->network->dhcp_persist_lease && !link->network->dhcp_anonymize) {
+                r = dhcp4_save_persistent_lease(link, &address);
+                if (r < 0 && r != -ENODATA)
+                        log_link_warning_errno(link, r, "DHCP error: Could not save address of lease, ignoring: %m");
+        }
+
         if (link->network->dhcp_use_mtu) {
                 uint16_t mtu;
 
@@ -728,6 +808,12 @@ int dhcp4_configure(Link *link) {
                         return log_oom();
                 if (r < 0)
                         return log_link_error_errno(link, r, "DHCP4 CLIENT: Failed to create DHCP4 client: %m");
+
+                if (link->network->dhcp_persist_lease && !link->network->dhcp_anonymize) {
+                        r = dhcp4_load_persistent_lease(link);
+                        if (r < 0 && !IN_SET(r, -ENOENT, -ENODATA))
+                                log_link_warning_errno(link, r, "DHCP4 CLIENT: Failed to load address of previous lease, ignoring: %m");
+                }
         }
 
         r = sd_dhcp_client_attach_event(link->dhcp_client, NULL, 0);
@@ -753,6 +839,10 @@ int dhcp4_configure(Link *link) {
         if (r < 0)
                 return log_link_error_errno(link, r, "DHCP4 CLIENT: Failed to set request flag for broadcast: %m");
 
+        r = sd_dhcp_client_set_rapid_commit(link->dhcp_client, link->network->rapid_commit);
+        if (r < 0)
+                return log_link_error_errno(link, r, "DHCP4 CLIENT: Failed to set rapid commit: %m");
+
         if (link->mtu) {
                 r = sd_dhcp_client_set_mtu(link->dhcp_client, link->mtu);
                 if (r < 0)
@@ -721,6 +721,8 @@ static void link_enter_configured(Link *link) {
         if (link->state != LINK_STATE_CONFIGURING)
                 return;
 
+        link->setup_finished_usec = now(CLOCK_MONOTONIC);
+
         log_link_info(link, "Configured");
 
         link_set_state(link, LINK_STATE_CONFIGURED);
@@ -872,6 +874,12 @@ static int link_request_set_routes(Link *link) {
         if (r < 0)
                 return r;
 
+        /* Write all routes out together, rather than with one write per route. The kernel still processes
+         * them in order, hence the phases below are kept. */
+        r = sd_netlink_batch_begin(link->manager->rtnl);
+        if (r < 0)
+                return r;
+
         /* First add the routes that enable us to talk to gateways, then add in the others that need a gateway. */
         for (phase = 0; phase < _PHASE_MAX; phase++)
                 LIST_FOREACH(routes, rt, link->network->static_routes) {
@@ -881,6 +889,7 @@ static int link_request_set_routes(Link *link) {
 
                         r = route_configure(rt, link, route_handler);
                         if (r < 0) {
+                                (void) sd_netlink_batch_end(link->manager->rtnl);
                                 log_link_warning_errno(link, r, "Could not set routes: %m");
                                 link_enter_failed(link);
                                 return r;
@@ -889,6 +898,13 @@ static int link_request_set_routes(Link *link) {
                         link->route_messages++;
                 }
 
+        r = sd_netlink_batch_end(link->manager->rtnl);
+        if (r < 0) {
+                log_link_warning_errno(link, r, "Could not send routes: %m");
+                link_enter_failed(link);
+                return r;
+        }
+
         if (link->route_messages == 0) {
                 link->static_routes_configured = true;
                 link_check_ready(link);
@@ -1094,9 +1110,14 @@ static int link_request_set_addresses(Link *link) {
         if (r < 0)
                 return r;
 
+        r = sd_netlink_batch_begin(link->manager->rtnl);
+        if (r < 0)
+                return r;
+
         LIST_FOREACH(addresses, ad, link->network->static_addresses) {
                 r = address_configure(ad, link, address_handler, false);
                 if (r < 0) {
+                        (void) sd_netlink_batch_end(link->manager->rtnl);
                         log_link_warning_errno(link, r, "Could not set addresses: %m");
                         link_enter_failed(link);
                         return r;
@@ -1105,6 +1126,13 @@ static int link_request_set_addresses(Link *link) {
                 link->address_messages++;
         }
 
+        r = sd_netlink_batch_end(link->manager->rtnl);
+        if (r < 0) {
+                log_link_warning_errno(link, r, "Could not send addresses: %m");
+                link_enter_failed(link);
+                return r;
+        }
+
         LIST_FOREACH(labels, label, link->network->address_labels) {
                 r = address_label_configure(label, link, NULL, false);
                 if (r < 0) {
@@ -1640,7 +1668,10 @@ static void lldp_handler(sd_lldp *lldp, sd_lldp_event event, sd_lldp_neighbor *n
 
         assert(link);
 
-        (void) link_lldp_save(link);
+        /* The file only contains the raw datagrams, which did not change when a neighbor was merely
+         * refreshed. Most datagrams just refresh a neighbor, hence don't rewrite the file for each of them. */
+        if (event != SD_LLDP_EVENT_REFRESHED)
+                (void) link_lldp_save(link);
 
         if (link_lldp_emit_enabled(link) && event == SD_LLDP_EVENT_ADDED) {
                 /* If we received information about a new neighbor, restart the LLDP "fast" logic */
@@ -2797,6 +2828,10 @@ static int link_configure(Link *link) {
         assert(link->network);
         assert(link->state == LINK_STATE_PENDING);
 
+        link->setup_started_usec = now(CLOCK_MONOTONIC);
+        link->setup_finished_usec = 0;
+        link->setup_queued_usec = 0;
+
         if (STRPTR_IN_SET(link->kind, "can", "vcan"))
                 return link_configure_can(link);
 
@@ -2865,6 +2900,8 @@ static int link_configure(Link *link) {
         }
 
         if (link_dhcp4_server_enabled(link)) {
+                char lease_file[STRLEN("/run/systemd/netif/dhcp-server-leases/") + DECIMAL_STR_MAX(int)];
+
                 r = sd_dhcp_server_new(&link->dhcp_server, link->ifindex);
                 if (r < 0)
                         return r;
@@ -2872,6 +2909,11 @@ static int link_configure(Link *link) {
                 r = sd_dhcp_server_attach_event(link->dhcp_server, NULL, 0);
                 if (r < 0)
                         return r;
+
+                xsprintf(lease_file, "/run/systemd/netif/dhcp-server-leases/%i", link->ifindex);
+                r = sd_dhcp_server_set_lease_file(link->dhcp_server, lease_file);
+                if (r < 0)
+                        return r;
         }
 
         if (link_dhcp6_enabled(link) ||
@@ -3734,8 +3776,9 @@ static void print_link_hashmap(FILE *f, const char *prefix, Hashmap* h) {
 }
 
 int link_save(Link *link) {
-        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_free_ char *contents = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        size_t size;
         const char *admin_state, *oper_state;
         Address *a;
         Route *route;
@@ -3749,6 +3792,7 @@ int link_save(Link *link) {
 
         if (link->state == LINK_STATE_LINGER) {
                 unlink(link->state_file);
+                link->state_file_hash = 0;
                 return 0;
         }
 
@@ -3760,12 +3804,14 @@ int link_save(Link *link) {
         oper_state = link_operstate_to_string(link->operstate);
         assert(oper_state);
 
-        r = fopen_temporary(link->state_file, &f, &temp_path);
-        if (r < 0)
+        /* Render the file in memory first, it is only written out if it changed since the last time */
+        f = open_memstream(&contents, &size);
+        if (!f) {
+                r = -ENOMEM;
                 goto fail;
+        }
 
         (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
-        (void) fchmod(fileno(f), 0644);
 
         fprintf(f,
                 "# This is private data. Do not parse.\n"
@@ -3773,6 +3819,16 @@ int link_save(Link *link) {
                 "OPER_STATE=%s\n",
                 admin_state, oper_state);
 
+        if (link->setup_started_usec > 0) {
+                fprintf(f,
+                        "SETUP_STARTED_USEC="USEC_FMT"\n"
+                        "SETUP_QUEUED_USEC="USEC_FMT"\n",
+                        link->setup_started_usec, link->setup_queued_usec);
+
+                if (link->setup_finished_usec > 0)
+                        fprintf(f, "SETUP_FINISHED_USEC="USEC_FMT"\n", link->setup_finished_usec);
+        }
+
         if (link->network) {
                 bool space;
                 sd_dhcp6_lease *dhcp6_lease = NULL;
@@ -4041,17 +4097,16 @@ int link_save(Link *link) {
         if (r < 0)
                 goto fail;
 
-        if (rename(temp_path, link->state_file) < 0) {
-                r = -errno;
+        r = network_save_state_file(link->state_file, contents, size,
+                                    link->manager->state_file_hash_key, &link->state_file_hash);
+        if (r < 0)
                 goto fail;
-        }
 
         return 0;
 
 fail:
         (void) unlink(link->state_file);
-        if (temp_path)
-                (void) unlink(temp_path);
+        link->state_file_hash = 0;
 
         return log_link_error_errno(link, r, "Failed to save link data to %s: %m", link->state_file);
 }
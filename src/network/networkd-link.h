@@ -43,6 +43,7 @@ typedef struct Manager Manager;
 typedef struct Network Network;
 typedef struct Address Address;
 typedef struct DUID DUID;
+typedef struct Request Request;
 
 typedef struct Link {
         Manager *manager;
@@ -55,6 +56,7 @@ typedef struct Link {
         char *kind;
         unsigned short iftype;
         char *state_file;
+        uint64_t state_file_hash; /* of the contents written last, 0 if unknown */
         struct ether_addr mac;
         struct in6_addr ipv6ll_address;
         uint32_t mtu;
@@ -127,6 +129,16 @@ typedef struct Link {
 
         Hashmap *bound_by_links;
         Hashmap *bound_to_links;
+
+        /* Requests waiting for their turn, see link_call_async() */
+        LIST_HEAD(Request, queued_requests);
+        LIST_FIELDS(struct Link, queued_requests_links);
+
+        /* CLOCK_MONOTONIC timestamps of when configuring the link started and finished, and how long its
+         * requests waited for their turn in total */
+        usec_t setup_started_usec;
+        usec_t setup_finished_usec;
+        usec_t setup_queued_usec;
 } Link;
 
 typedef int (*link_netlink_message_handler_t)(sd_netlink*, sd_netlink_message*, Link*);
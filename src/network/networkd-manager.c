@@ -3,6 +3,7 @@
 #include <sys/socket.h>
 #include <linux/if.h>
 #include <linux/fib_rules.h>
+#include <linux/filter.h>
 #include <stdio_ext.h>
 
 #include "sd-daemon.h"
@@ -19,11 +20,12 @@
 #include "local-addresses.h"
 #include "netlink-util.h"
 #include "networkd-manager.h"
+#include "networkd-queue.h"
 #include "ordered-set.h"
 #include "path-util.h"
+#include "random-util.h"
 #include "set.h"
 #include "strv.h"
-#include "tmpfile-util.h"
 #include "virt.h"
 
 /* use 8 MB for receive socket kernel queue. */
@@ -252,6 +254,82 @@ static int manager_connect_udev(Manager *m) {
         return 0;
 }
 
+static bool manager_ignore_route(Manager *m, sd_netlink_message *message) {
+        unsigned char protocol, table8;
+        uint32_t table;
+        int r;
+
+        assert(m);
+        assert(message);
+
+        if (set_isempty(m->ignore_foreign_route_protocols) && set_isempty(m->ignore_foreign_route_tables))
+                return false;
+
+        r = sd_rtnl_message_route_get_protocol(message, &protocol);
+        if (r >= 0 && set_contains(m->ignore_foreign_route_protocols, INT_TO_PTR(protocol)))
+                return true;
+
+        /* Tables above 255 are only carried in the attribute */
+        r = sd_netlink_message_read_u32(message, RTA_TABLE, &table);
+        if (r == -ENODATA) {
+                r = sd_rtnl_message_route_get_table(message, &table8);
+                table = table8;
+        }
+        if (r >= 0 && set_contains(m->ignore_foreign_route_tables, UINT32_TO_PTR(table)))
+                return true;
+
+        return false;
+}
+
+int manager_setup_route_filter(Manager *m) {
+        _cleanup_free_ struct sock_filter *filter = NULL;
+        size_t n = 0;
+        Iterator i;
+        void *p;
+
+        assert(m);
+        assert(m->rtnl);
+
+        /* Drop notifications about routes we are told to ignore in the kernel already, so that we don't even
+         * get woken up for them. This can't cover the initial dump, nor tables above 255, hence
+         * manager_ignore_route() checks all of this again. */
+
+        if (set_isempty(m->ignore_foreign_route_protocols) && set_isempty(m->ignore_foreign_route_tables))
+                return sd_netlink_attach_filter(m->rtnl, 0, NULL);
+
+        filter = new(struct sock_filter, 7 + 2 * (set_size(m->ignore_foreign_route_protocols) + set_size(m->ignore_foreign_route_tables)));
+        if (!filter)
+                return -ENOMEM;
+
+        /* Let everything but route messages pass. Netlink headers are in host byte order, while BPF loads
+         * words in network byte order. */
+        filter[n++] = (struct sock_filter) BPF_STMT(BPF_LD + BPF_H + BPF_ABS, offsetof(struct nlmsghdr, nlmsg_type));
+        filter[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, htobe16(RTM_NEWROUTE), 2, 0);
+        filter[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, htobe16(RTM_DELROUTE), 1, 0);
+        filter[n++] = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, UINT32_MAX);
+
+        /* Drop the message if the protocol matches */
+        filter[n++] = (struct sock_filter) BPF_STMT(BPF_LD + BPF_B + BPF_ABS, NLMSG_LENGTH(0) + offsetof(struct rtmsg, rtm_protocol));
+        SET_FOREACH(p, m->ignore_foreign_route_protocols, i) {
+                filter[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, PTR_TO_INT(p), 0, 1);
+                filter[n++] = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, 0);
+        }
+
+        /* Same for the table, as far as it fits into the header */
+        filter[n++] = (struct sock_filter) BPF_STMT(BPF_LD + BPF_B + BPF_ABS, NLMSG_LENGTH(0) + offsetof(struct rtmsg, rtm_table));
+        SET_FOREACH(p, m->ignore_foreign_route_tables, i) {
+                if (PTR_TO_UINT32(p) > UINT8_MAX || PTR_TO_UINT32(p) == RT_TABLE_COMPAT)
+                        continue;
+
+                filter[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, PTR_TO_UINT32(p), 0, 1);
+                filter[n++] = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, 0);
+        }
+
+        filter[n++] = (struct sock_filter) BPF_STMT(BPF_RET + BPF_K, UINT32_MAX);
+
+        return sd_netlink_attach_filter(m->rtnl, n, filter);
+}
+
 int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, void *userdata) {
         Manager *m = userdata;
         Link *link = NULL;
@@ -285,6 +363,9 @@ int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, vo
                 return 0;
         }
 
+        if (manager_ignore_route(m, message))
+                return 0;
+
         r = sd_netlink_message_read_u32(message, RTA_OIF, &ifindex);
         if (r == -ENODATA) {
                 log_debug("rtnl: received route without ifindex, ignoring");
@@ -1060,8 +1141,9 @@ static int manager_save(Manager *m) {
         _cleanup_ordered_set_free_free_ OrderedSet *dns = NULL, *ntp = NULL, *search_domains = NULL, *route_domains = NULL;
         Link *link;
         Iterator i;
-        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_free_ char *contents = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        size_t size;
         LinkOperationalState operstate = LINK_OPERSTATE_OFF;
         const char *operstate_str;
         int r;
@@ -1167,12 +1249,11 @@ static int manager_save(Manager *m) {
         operstate_str = link_operstate_to_string(operstate);
         assert(operstate_str);
 
-        r = fopen_temporary(m->state_file, &f, &temp_path);
-        if (r < 0)
-                return r;
+        f = open_memstream(&contents, &size);
+        if (!f)
+                return -ENOMEM;
 
         (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
-        (void) fchmod(fileno(f), 0644);
 
         fprintf(f,
                 "# This is private data. Do not parse.\n"
@@ -1191,10 +1272,9 @@ static int manager_save(Manager *m) {
         if (r < 0)
                 goto fail;
 
-        if (rename(temp_path, m->state_file) < 0) {
-                r = -errno;
+        r = network_save_state_file(m->state_file, contents, size, m->state_file_hash_key, &m->state_file_hash);
+        if (r < 0)
                 goto fail;
-        }
 
         if (m->operational_state != operstate) {
                 m->operational_state = operstate;
@@ -1209,7 +1289,7 @@ static int manager_save(Manager *m) {
 
 fail:
         (void) unlink(m->state_file);
-        (void) unlink(temp_path);
+        m->state_file_hash = 0;
 
         return log_error_errno(r, "Failed to save network state to %s: %m", m->state_file);
 }
@@ -1360,6 +1440,8 @@ int manager_new(Manager **ret) {
         if (!m->state_file)
                 return -ENOMEM;
 
+        random_bytes(m->state_file_hash_key, sizeof(m->state_file_hash_key));
+
         r = sd_event_default(&m->event);
         if (r < 0)
                 return r;
@@ -1417,12 +1499,15 @@ void manager_free(Manager *m) {
 
         free(m->state_file);
 
+        manager_drop_requests(m);
+
         sd_netlink_unref(m->rtnl);
         sd_netlink_unref(m->genl);
         sd_resolve_unref(m->resolve);
 
         while ((network = m->networks))
                 network_free(network);
+        network_drop_index(m);
 
         while ((link = hashmap_first(m->dhcp6_prefixes)))
                 manager_dhcp6_prefix_remove_all(m, link);
@@ -1452,6 +1537,9 @@ void manager_free(Manager *m) {
         m->rules_foreign = set_free_with_destructor(m->rules_foreign, routing_policy_rule_free);
         set_free_with_destructor(m->rules_saved, routing_policy_rule_free);
 
+        set_free(m->ignore_foreign_route_protocols);
+        set_free(m->ignore_foreign_route_tables);
+
         sd_event_unref(m->event);
 
         sd_device_monitor_unref(m->device_monitor);
@@ -34,12 +34,28 @@ struct Manager {
 
         Set *dirty_links;
 
+        /* Links with requests waiting for their turn, see link_call_async() */
+        LIST_HEAD(Link, queued_requests_links);
+        unsigned n_requests_in_flight;
+        sd_event_source *request_event_source;
+
         char *state_file;
+        uint64_t state_file_hash; /* of the contents written last, 0 if unknown */
+        uint8_t state_file_hash_key[16]; /* shared with the per-link state files */
         LinkOperationalState operational_state;
 
         Hashmap *links;
         Hashmap *netdevs;
         Hashmap *networks_by_name;
+
+        /* Networks by the interface names and MAC addresses they match on, and the ones that match on neither
+         * or on patterns, see network_get(). Built on first use. */
+        Hashmap *networks_by_match_name;
+        Hashmap *networks_by_match_mac;
+        Network **networks_unindexed;
+        size_t n_networks_unindexed;
+        size_t networks_unindexed_allocated;
+        bool networks_indexed;
         Hashmap *dhcp6_prefixes;
         LIST_HEAD(Network, networks);
         LIST_HEAD(AddressPool, address_pools);
@@ -58,6 +74,10 @@ struct Manager {
         Set *rules;
         Set *rules_foreign;
         Set *rules_saved;
+
+        /* Routes not configured by us with these protocols or in these tables are not tracked at all */
+        Set *ignore_foreign_route_protocols;
+        Set *ignore_foreign_route_tables;
 };
 
 extern const sd_bus_vtable manager_vtable[];
@@ -80,6 +100,8 @@ int manager_rtnl_process_address(sd_netlink *nl, sd_netlink_message *message, vo
 int manager_rtnl_process_route(sd_netlink *nl, sd_netlink_message *message, void *userdata);
 int manager_rtnl_process_rule(sd_netlink *nl, sd_netlink_message *message, void *userdata);
 
+int manager_setup_route_filter(Manager *m);
+
 int manager_send_changed(Manager *m, const char *property, ...) _sentinel_;
 void manager_dirty(Manager *m);
 
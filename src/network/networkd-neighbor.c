@@ -11,6 +11,7 @@
 #include "networkd-link.h"
 #include "networkd-manager.h"
 #include "networkd-neighbor.h"
+#include "networkd-queue.h"
 
 void neighbor_free(Neighbor *neighbor) {
         if (!neighbor)
@@ -152,8 +153,7 @@ int neighbor_configure(Neighbor *neighbor, Link *link, link_netlink_message_hand
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Neighbor with invalid address family");
         }
 
-        r = netlink_call_async(link->manager->rtnl, NULL, req, callback ?: neighbor_handler,
-                               link_netlink_destroy_callback, link);
+        r = link_call_async(link, req, callback ?: neighbor_handler);
         if (r < 0)
                 return log_error_errno(r, "Could not send rtnetlink message: %m");
 
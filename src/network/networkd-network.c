@@ -7,7 +7,9 @@
 #include "conf-files.h"
 #include "conf-parser.h"
 #include "dns-domain.h"
+#include "ether-addr-util.h"
 #include "fd-util.h"
+#include "glob-util.h"
 #include "hostname-util.h"
 #include "in-addr-util.h"
 #include "missing_network.h"
@@ -244,6 +246,7 @@ int network_load_one(Manager *manager, const char *filename) {
         }
 
         LIST_PREPEND(networks, manager->networks, network);
+        network_drop_index(manager);
 
         r = hashmap_ensure_allocated(&manager->networks_by_name, &string_hash_ops);
         if (r < 0)
@@ -377,6 +380,8 @@ void network_free(Network *network) {
                 if (network->manager->networks)
                         LIST_REMOVE(networks, network->manager->networks, network);
 
+                network_drop_index(network->manager);
+
                 if (network->manager->networks_by_name && network->name)
                         hashmap_remove(network->manager->networks_by_name, network->name);
 
@@ -417,12 +422,159 @@ int network_get_by_name(Manager *manager, const char *name, Network **ret) {
         return 0;
 }
 
+void network_drop_index(Manager *manager) {
+        assert(manager);
+
+        manager->networks_by_match_name = hashmap_free_free(manager->networks_by_match_name);
+        manager->networks_by_match_mac = hashmap_free_free(manager->networks_by_match_mac);
+        manager->networks_unindexed = mfree(manager->networks_unindexed);
+        manager->n_networks_unindexed = manager->networks_unindexed_allocated = 0;
+        manager->networks_indexed = false;
+}
+
+static int network_index_add(Hashmap **h, const struct hash_ops *hash_ops, const void *key, Network *network) {
+        Network **list, **l;
+        size_t n = 0;
+        int r;
+
+        assert(h);
+        assert(key);
+        assert(network);
+
+        /* The values are NULL terminated arrays of networks, in the order they were added */
+
+        list = hashmap_get(*h, key);
+        for (; list && list[n]; n++)
+                if (list[n] == network)
+                        return 0;
+
+        l = reallocarray(list, n + 2, sizeof(Network*));
+        if (!l)
+                return -ENOMEM;
+
+        l[n] = network;
+        l[n + 1] = NULL;
+
+        if (list) {
+                /* Only the pointer might have changed, which cannot fail */
+                assert_se(hashmap_update(*h, key, l) >= 0);
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(h, hash_ops);
+        if (r >= 0)
+                r = hashmap_put(*h, key, l);
+        if (r < 0) {
+                free(l);
+                return r;
+        }
+
+        return 0;
+}
+
+static bool network_match_name_is_literal(Network *network) {
+        char **n;
+
+        assert(network);
+
+        if (strv_isempty(network->match_name) || network->match_name[0][0] == '!')
+                return false;
+
+        STRV_FOREACH(n, network->match_name)
+                if (string_is_glob(*n))
+                        return false;
+
+        return true;
+}
+
+static int network_build_index(Manager *manager) {
+        Network *network;
+        unsigned order = 0;
+        int r;
+
+        assert(manager);
+
+        /* A network that matches on literal interface names can only ever match links with one of them, and
+         * one that matches on MAC addresses only links with one of those. All other conditions still need to
+         * be checked, but only for these candidates. Everything else is tried in order. */
+
+        LIST_FOREACH(networks, network, manager->networks) {
+                network->match_order = order++;
+
+                if (network_match_name_is_literal(network)) {
+                        char **n;
+
+                        STRV_FOREACH(n, network->match_name) {
+                                r = network_index_add(&manager->networks_by_match_name, &string_hash_ops, *n, network);
+                                if (r < 0)
+                                        return r;
+                        }
+
+                } else if (!set_isempty(network->match_mac)) {
+                        struct ether_addr *mac;
+                        Iterator i;
+
+                        SET_FOREACH(mac, network->match_mac, i) {
+                                r = network_index_add(&manager->networks_by_match_mac, &ether_addr_hash_ops, mac, network);
+                                if (r < 0)
+                                        return r;
+                        }
+
+                } else {
+                        /* Keep it NULL terminated, like the arrays in the hashmaps */
+                        if (!GREEDY_REALLOC(manager->networks_unindexed, manager->networks_unindexed_allocated,
+                                            manager->n_networks_unindexed + 2))
+                                return -ENOMEM;
+
+                        manager->networks_unindexed[manager->n_networks_unindexed++] = network;
+                        manager->networks_unindexed[manager->n_networks_unindexed] = NULL;
+                }
+        }
+
+        manager->networks_indexed = true;
+
+        return 0;
+}
+
+static bool network_matches(Network *network,
+                            const struct ether_addr *address, const char *path, const char *parent_driver,
+                            const char *driver, const char *devtype, const char *ifname) {
+        assert(network);
+
+        return net_match_config(network->match_mac, network->match_path,
+                                network->match_driver, network->match_type,
+                                network->match_name, network->match_host,
+                                network->match_virt, network->match_kernel_cmdline,
+                                network->match_kernel_version, network->match_arch,
+                                address, path, parent_driver, driver,
+                                devtype, ifname);
+}
+
+static Network *network_find_candidate(Network **list, Network *best,
+                                       const struct ether_addr *address, const char *path, const char *parent_driver,
+                                       const char *driver, const char *devtype, const char *ifname) {
+        Network **n;
+
+        /* Returns the first network in the list that matches, if it comes before best */
+
+        for (n = list; n && *n; n++) {
+                if (best && (*n)->match_order >= best->match_order)
+                        break;
+
+                if (network_matches(*n, address, path, parent_driver, driver, devtype, ifname))
+                        return *n;
+        }
+
+        return best;
+}
+
 int network_get(Manager *manager, sd_device *device,
                 const char *ifname, const struct ether_addr *address,
                 Network **ret) {
         const char *path = NULL, *parent_driver = NULL, *driver = NULL, *devtype = NULL;
+        Network *network = NULL;
         sd_device *parent;
-        Network *network;
+        int r;
 
         assert(manager);
         assert(ret);
@@ -438,37 +590,51 @@ int network_get(Manager *manager, sd_device *device,
                 (void) sd_device_get_devtype(device, &devtype);
         }
 
-        LIST_FOREACH(networks, network, manager->networks) {
-                if (net_match_config(network->match_mac, network->match_path,
-                                     network->match_driver, network->match_type,
-                                     network->match_name, network->match_host,
-                                     network->match_virt, network->match_kernel_cmdline,
-                                     network->match_kernel_version, network->match_arch,
-                                     address, path, parent_driver, driver,
-                                     devtype, ifname)) {
-                        if (network->match_name && device) {
-                                const char *attr;
-                                uint8_t name_assign_type = NET_NAME_UNKNOWN;
-
-                                if (sd_device_get_sysattr_value(device, "name_assign_type", &attr) >= 0)
-                                        (void) safe_atou8(attr, &name_assign_type);
-
-                                if (name_assign_type == NET_NAME_ENUM)
-                                        log_warning("%s: found matching network '%s', based on potentially unpredictable ifname",
-                                                    ifname, network->filename);
-                                else
-                                        log_debug("%s: found matching network '%s'", ifname, network->filename);
-                        } else
-                                log_debug("%s: found matching network '%s'", ifname, network->filename);
-
-                        *ret = network;
-                        return 0;
+        if (!manager->networks_indexed) {
+                r = network_build_index(manager);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to index networks, trying all of them: %m");
+                        network_drop_index(manager);
                 }
         }
 
-        *ret = NULL;
+        if (manager->networks_indexed) {
+                if (ifname)
+                        network = network_find_candidate(hashmap_get(manager->networks_by_match_name, ifname), network,
+                                                         address, path, parent_driver, driver, devtype, ifname);
+                if (address)
+                        network = network_find_candidate(hashmap_get(manager->networks_by_match_mac, address), network,
+                                                         address, path, parent_driver, driver, devtype, ifname);
+
+                network = network_find_candidate(manager->networks_unindexed, network,
+                                                 address, path, parent_driver, driver, devtype, ifname);
+        } else
+                LIST_FOREACH(networks, network, manager->networks)
+                        if (network_matches(network, address, path, parent_driver, driver, devtype, ifname))
+                                break;
+
+        if (!network) {
+                *ret = NULL;
+                return -ENOENT;
+        }
+
+        if (network->match_name && device) {
+                const char *attr;
+                uint8_t name_assign_type = NET_NAME_UNKNOWN;
 
-        return -ENOENT;
+                if (sd_device_get_sysattr_value(device, "name_assign_type", &attr) >= 0)
+                        (void) safe_atou8(attr, &name_assign_type);
+
+                if (name_assign_type == NET_NAME_ENUM)
+                        log_warning("%s: found matching network '%s', based on potentially unpredictable ifname",
+                                    ifname, network->filename);
+                else
+                        log_debug("%s: found matching network '%s'", ifname, network->filename);
+        } else
+                log_debug("%s: found matching network '%s'", ifname, network->filename);
+
+        *ret = network;
+        return 0;
 }
 
 int network_apply(Network *network, Link *link) {
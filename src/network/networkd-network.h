@@ -106,6 +106,7 @@ struct Network {
         char **match_driver;
         char **match_type;
         char **match_name;
+        unsigned match_order; /* position among all networks, the first matching one wins */
 
         Condition *match_host;
         Condition *match_virt;
@@ -139,6 +140,7 @@ struct Network {
         bool dhcp_use_routes;
         bool dhcp_use_timezone;
         bool rapid_commit;
+        bool dhcp_persist_lease;
         bool dhcp_use_hostname;
         bool dhcp_route_table_set;
         DHCPUseDomains dhcp_use_domains;
@@ -286,6 +288,7 @@ int network_load_one(Manager *manager, const char *filename);
 
 int network_get_by_name(Manager *manager, const char *name, Network **ret);
 int network_get(Manager *manager, sd_device *device, const char *ifname, const struct ether_addr *mac, Network **ret);
+void network_drop_index(Manager *manager);
 int network_apply(Network *network, Link *link);
 void network_apply_anonymize_if_set(Network *network);
 
@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "netlink-util.h"
+#include "networkd-manager.h"
+#include "networkd-queue.h"
+
+static Request *request_free(Request *req) {
+        Manager *m;
+
+        if (!req)
+                return NULL;
+
+        m = req->link->manager;
+
+        if (req->in_flight) {
+                assert(m->n_requests_in_flight > 0);
+                m->n_requests_in_flight--;
+
+                /* A slot got free, let the next queued request have it */
+                if (m->queued_requests_links && m->request_event_source)
+                        (void) sd_event_source_set_enabled(m->request_event_source, SD_EVENT_ONESHOT);
+        }
+
+        sd_netlink_message_unref(req->message);
+
+        /* This drops the reference the caller took on the link after link_call_async() succeeded. */
+        link_unref(req->link);
+
+        return mfree(req);
+}
+
+static void request_destroy_callback(Request *req) {
+        request_free(req);
+}
+
+static int request_handler(sd_netlink *rtnl, sd_netlink_message *m, Request *req) {
+        assert(req);
+
+        return req->callback(rtnl, m, req->link);
+}
+
+static int request_send(Request *req) {
+        Manager *m;
+        int r;
+
+        assert(req);
+        assert(!req->in_flight);
+
+        m = req->link->manager;
+
+        r = netlink_call_async(m->rtnl, NULL, req->message, request_handler, request_destroy_callback, req);
+        if (r < 0)
+                return r;
+
+        req->in_flight = true;
+        req->message = sd_netlink_message_unref(req->message);
+        m->n_requests_in_flight++;
+
+        return 0;
+}
+
+static int manager_dispatch_requests(sd_event_source *s, void *userdata) {
+        Manager *m = userdata;
+        int r;
+
+        assert(m);
+
+        /* Send all requests we have room for together */
+        r = sd_netlink_batch_begin(m->rtnl);
+        if (r < 0)
+                return r;
+
+        while (m->queued_requests_links && m->n_requests_in_flight < REQUESTS_IN_FLIGHT_MAX) {
+                Link *link = m->queued_requests_links;
+                Request *req = link->queued_requests;
+                usec_t n;
+
+                /* Serve one request of the link, then let the others take their turn */
+                LIST_REMOVE(requests, link->queued_requests, req);
+                LIST_REMOVE(queued_requests_links, m->queued_requests_links, link);
+                if (link->queued_requests)
+                        LIST_APPEND(queued_requests_links, m->queued_requests_links, link);
+
+                n = now(CLOCK_MONOTONIC);
+                link->setup_queued_usec += usec_sub_unsigned(n, req->queued_usec);
+
+                r = request_send(req);
+                if (r < 0) {
+                        log_link_warning_errno(link, r, "Could not send rtnetlink message: %m");
+
+                        /* Nobody is going to call the callback anymore, fail the link rather than have it
+                         * wait forever. Freeing the request might drop the last reference to the link. */
+                        link_enter_failed(link);
+                        request_free(req);
+                }
+        }
+
+        r = sd_netlink_batch_end(m->rtnl);
+        if (r < 0)
+                log_warning_errno(r, "Failed to send queued rtnetlink messages, ignoring: %m");
+
+        return 0;
+}
+
+/* Like netlink_call_async(), with the link as userdata and link_netlink_destroy_callback() as destroy callback,
+ * but the message is only sent once there is room for it. Requests of the same link are sent in order. */
+int link_call_async(Link *link, sd_netlink_message *m, link_netlink_message_handler_t callback) {
+        _cleanup_free_ Request *req = NULL;
+        Manager *manager;
+        int r;
+
+        assert(link);
+        assert(link->manager);
+        assert(m);
+        assert(callback);
+
+        manager = link->manager;
+
+        req = new(Request, 1);
+        if (!req)
+                return -ENOMEM;
+
+        *req = (Request) {
+                .link = link,
+                .message = sd_netlink_message_ref(m),
+                .callback = callback,
+        };
+
+        if (!manager->queued_requests_links && manager->n_requests_in_flight < REQUESTS_IN_FLIGHT_MAX) {
+                r = request_send(req);
+                if (r < 0) {
+                        sd_netlink_message_unref(req->message);
+                        return r;
+                }
+
+                TAKE_PTR(req);
+                return 0;
+        }
+
+        if (!manager->request_event_source) {
+                r = sd_event_add_defer(manager->event, &manager->request_event_source, manager_dispatch_requests, manager);
+                if (r < 0) {
+                        sd_netlink_message_unref(req->message);
+                        return r;
+                }
+
+                (void) sd_event_source_set_description(manager->request_event_source, "networkd-requests");
+        }
+
+        req->queued_usec = now(CLOCK_MONOTONIC);
+
+        if (!link->queued_requests)
+                LIST_APPEND(queued_requests_links, manager->queued_requests_links, link);
+        LIST_APPEND(requests, link->queued_requests, req);
+        TAKE_PTR(req);
+
+        if (manager->n_requests_in_flight < REQUESTS_IN_FLIGHT_MAX)
+                (void) sd_event_source_set_enabled(manager->request_event_source, SD_EVENT_ONESHOT);
+
+        return 0;
+}
+
+static void link_drop_requests(Link *link) {
+        Request *req;
+
+        assert(link);
+
+        if (!link->queued_requests)
+                return;
+
+        LIST_REMOVE(queued_requests_links, link->manager->queued_requests_links, link);
+
+        /* Each request holds a reference to the link, do not let it go away underneath us */
+        link_ref(link);
+
+        while ((req = link->queued_requests)) {
+                LIST_REMOVE(requests, link->queued_requests, req);
+                request_free(req);
+        }
+
+        link_unref(link);
+}
+
+void manager_drop_requests(Manager *m) {
+        assert(m);
+
+        m->request_event_source = sd_event_source_unref(m->request_event_source);
+
+        while (m->queued_requests_links)
+                link_drop_requests(m->queued_requests_links);
+}
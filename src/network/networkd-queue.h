@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include "sd-event.h"
+#include "sd-netlink.h"
+
+#include "list.h"
+#include "time-util.h"
+
+#include "networkd-link.h"
+
+/* At most this many requests sent with link_call_async() are waiting for their reply at any time. The rest is
+ * queued per link, and the links take turns in sending theirs. */
+#define REQUESTS_IN_FLIGHT_MAX 128U
+
+struct Request {
+        Link *link;
+        sd_netlink_message *message;
+        link_netlink_message_handler_t callback;
+        usec_t queued_usec;
+        bool in_flight;
+
+        LIST_FIELDS(Request, requests);
+};
+
+int link_call_async(Link *link, sd_netlink_message *m, link_netlink_message_handler_t callback);
+
+void manager_drop_requests(Manager *m);
@@ -8,9 +8,11 @@
 #include "missing_network.h"
 #include "netlink-util.h"
 #include "networkd-manager.h"
+#include "networkd-queue.h"
 #include "networkd-route.h"
 #include "parse-util.h"
 #include "set.h"
+#include "string-table.h"
 #include "string-util.h"
 #include "sysctl-util.h"
 #include "util.h"
@@ -649,8 +651,7 @@ int route_configure(
         if (r < 0)
                 return log_error_errno(r, "Could not append RTA_METRICS attribute: %m");
 
-        r = netlink_call_async(link->manager->rtnl, NULL, req, callback,
-                               link_netlink_destroy_callback, link);
+        r = link_call_async(link, req, callback);
         if (r < 0)
                 return log_error_errno(r, "Could not send rtnetlink message: %m");
 
@@ -996,6 +997,18 @@ int config_parse_ipv6_route_preference(
         return 0;
 }
 
+static const char * const route_protocol_table[] = {
+        [RTPROT_KERNEL] = "kernel",
+        [RTPROT_BOOT]   = "boot",
+        [RTPROT_STATIC] = "static",
+        [RTPROT_RA]     = "ra",
+        [RTPROT_ZEBRA]  = "zebra",
+        [RTPROT_BIRD]   = "bird",
+        [RTPROT_DHCP]   = "dhcp",
+};
+
+DEFINE_STRING_TABLE_LOOKUP_FROM_STRING_FALLBACK(route_protocol, int, UINT8_MAX);
+
 int config_parse_route_protocol(
                 const char *unit,
                 const char *filename,
@@ -1010,26 +1023,20 @@ int config_parse_route_protocol(
 
         Network *network = userdata;
         _cleanup_(route_freep) Route *n = NULL;
-        int r;
+        int r, protocol;
 
         r = route_new_static(network, filename, section_line, &n);
         if (r < 0)
                 return r;
 
-        if (streq(rvalue, "kernel"))
-                n->protocol = RTPROT_KERNEL;
-        else if (streq(rvalue, "boot"))
-                n->protocol = RTPROT_BOOT;
-        else if (streq(rvalue, "static"))
-                n->protocol = RTPROT_STATIC;
-        else {
-                r = safe_atou8(rvalue , &n->protocol);
-                if (r < 0) {
-                        log_syntax(unit, LOG_ERR, filename, line, r, "Could not parse route protocol \"%s\", ignoring assignment: %m", rvalue);
-                        return 0;
-                }
+        protocol = route_protocol_from_string(rvalue);
+        if (protocol < 0) {
+                log_syntax(unit, LOG_ERR, filename, line, 0, "Could not parse route protocol \"%s\", ignoring assignment.", rvalue);
+                return 0;
         }
 
+        n->protocol = protocol;
+
         TAKE_PTR(n);
         return 0;
 }
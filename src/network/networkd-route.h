@@ -56,6 +56,8 @@ bool route_equal(Route *r1, Route *r2);
 
 int route_expire_handler(sd_event_source *s, uint64_t usec, void *userdata);
 
+int route_protocol_from_string(const char *s);
+
 DEFINE_TRIVIAL_CLEANUP_FUNC(Route*, route_free);
 
 CONFIG_PARSER_PROTOTYPE(config_parse_gateway);
@@ -2,8 +2,10 @@
 
 #include "condition.h"
 #include "conf-parser.h"
+#include "fileio.h"
 #include "networkd-util.h"
 #include "parse-util.h"
+#include "siphash24.h"
 #include "string-table.h"
 #include "string-util.h"
 #include "util.h"
@@ -102,3 +104,30 @@ int kernel_route_expiration_supported(void) {
         }
         return cached;
 }
+
+/* Writes a state file atomically, unless its contents are the same as when it was written the last time.
+ * *last_hash is the hash of the contents written last, and is updated. Returns 1 if the file was written,
+ * 0 if it was left as it is. */
+int network_save_state_file(const char *path, const char *contents, size_t size,
+                            const uint8_t hash_key[static 16], uint64_t *last_hash) {
+        uint64_t h;
+        int r;
+
+        assert(path);
+        assert(contents);
+        assert(last_hash);
+
+        h = siphash24(contents, size, hash_key);
+        if (*last_hash != 0 && h == *last_hash)
+                return 0;
+
+        r = write_string_file(path, contents,
+                              WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC|WRITE_STRING_FILE_AVOID_NEWLINE);
+        if (r < 0) {
+                *last_hash = 0;
+                return r;
+        }
+
+        *last_hash = h;
+        return 1;
+}
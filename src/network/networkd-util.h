@@ -21,3 +21,6 @@ const char *address_family_boolean_to_string(AddressFamilyBoolean b) _const_;
 AddressFamilyBoolean address_family_boolean_from_string(const char *s) _const_;
 
 int kernel_route_expiration_supported(void);
+
+int network_save_state_file(const char *path, const char *contents, size_t size,
+                            const uint8_t hash_key[static 16], uint64_t *last_hash);
@@ -65,6 +65,10 @@ static int run(int argc, char *argv[]) {
         if (r < 0)
                 log_warning_errno(r, "Could not create runtime directory 'lldp': %m");
 
+        r = mkdir_safe_label("/run/systemd/netif/dhcp-server-leases", 0755, uid, gid, MKDIR_WARN_MODE);
+        if (r < 0)
+                log_warning_errno(r, "Could not create runtime directory 'dhcp-server-leases': %m");
+
         assert_se(sigprocmask_many(SIG_BLOCK, NULL, SIGTERM, SIGINT, -1) >= 0);
 
         r = manager_new(&m);
@@ -79,6 +83,10 @@ static int run(int argc, char *argv[]) {
         if (r < 0)
                 log_warning_errno(r, "Failed to parse configuration file: %m");
 
+        r = manager_setup_route_filter(m);
+        if (r < 0)
+                log_warning_errno(r, "Could not install netlink filter for ignored routes, ignoring: %m");
+
         r = manager_load_config(m);
         if (r < 0)
                 return log_error_errno(r, "Could not load configuration files: %m");
@@ -6,11 +6,14 @@
 
 #include "alloc-util.h"
 #include "dhcp-lease-internal.h"
+#include "fileio.h"
 #include "hostname-util.h"
 #include "network-internal.h"
 #include "networkd-manager.h"
+#include "rm-rf.h"
 #include "string-util.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 
 static void test_deserialize_in_addr(void) {
         _cleanup_free_ struct in_addr *addresses = NULL;
@@ -129,6 +132,58 @@ static void test_network_get(Manager *manager, sd_device *loopback) {
         assert_se(!network);
 }
 
+static void test_network_get_index(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_(manager_freep) Manager *manager = NULL;
+        const struct ether_addr mac = { .ether_addr_octet = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 } },
+                                other = {};
+        static const struct {
+                const char *name;
+                const char *contents;
+        } files[] = {
+                /* in the order they are loaded in by network_load(), i.e. the last one takes precedence */
+                { "40-mac.network",   "[Match]\nMACAddress=00:11:22:33:44:55\n" },
+                { "30-exact.network", "[Match]\nName=veth1\n" },
+                { "20-glob.network",  "[Match]\nName=veth*\n" },
+                { "10-exact.network", "[Match]\nName=eth1 eth2\n" },
+        };
+        Network *network;
+        unsigned i;
+
+        assert_se(manager_new(&manager) >= 0);
+        assert_se(mkdtemp_malloc(NULL, &t) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(files); i++) {
+                const char *p;
+
+                p = strjoina(t, "/", files[i].name);
+                assert_se(write_string_file(p, files[i].contents, WRITE_STRING_FILE_CREATE) >= 0);
+                assert_se(network_load_one(manager, p) >= 0);
+        }
+
+        assert_se(network_get(manager, NULL, "eth2", &other, &network) >= 0);
+        assert_se(streq(network->name, "10-exact"));
+
+        /* an earlier glob match takes precedence over a later exact one */
+        assert_se(network_get(manager, NULL, "veth1", &other, &network) >= 0);
+        assert_se(streq(network->name, "20-glob"));
+        assert_se(network_get(manager, NULL, "veth7", &mac, &network) >= 0);
+        assert_se(streq(network->name, "20-glob"));
+
+        assert_se(network_get(manager, NULL, "eth3", &mac, &network) >= 0);
+        assert_se(streq(network->name, "40-mac"));
+        assert_se(network_get(manager, NULL, "eth3", &other, &network) == -ENOENT);
+        assert_se(!network);
+
+        /* removing a network drops the index, and it is rebuilt on the next lookup */
+        assert_se(manager->networks_indexed);
+        network_free(manager->networks);
+        assert_se(!manager->networks_indexed);
+        assert_se(network_get(manager, NULL, "eth2", &other, &network) == -ENOENT);
+        assert_se(network_get(manager, NULL, "veth1", &other, &network) >= 0);
+        assert_se(streq(network->name, "20-glob"));
+}
+
 static void test_address_equality(void) {
         _cleanup_(address_freep) Address *a1 = NULL, *a2 = NULL;
 
@@ -230,6 +285,7 @@ int main(void) {
         test_deserialize_dhcp_routes();
         test_address_equality();
         test_dhcp_hostname_shorten_overlong();
+        test_network_get_index();
 
         assert_se(manager_new(&manager) >= 0);
 
@@ -210,6 +210,23 @@ static void test_config_parse_address(void) {
         test_config_parse_address_one("::1/-1", AF_INET6, 0, NULL, 0);
 }
 
+static void test_config_parse_ignore_foreign_routes(void) {
+        _cleanup_set_free_ Set *protocols = NULL, *tables = NULL;
+
+        assert_se(config_parse_ignore_foreign_route_protocols("network", "filename", 1, "section", 1, "lvalue", 0, "zebra 186 foo 0 256", &protocols, NULL) == 0);
+        assert_se(set_size(protocols) == 2);
+        assert_se(set_contains(protocols, INT_TO_PTR(RTPROT_ZEBRA)));
+        assert_se(set_contains(protocols, INT_TO_PTR(186)));
+
+        assert_se(config_parse_ignore_foreign_route_protocols("network", "filename", 1, "section", 1, "lvalue", 0, "", &protocols, NULL) == 0);
+        assert_se(set_isempty(protocols));
+
+        assert_se(config_parse_ignore_foreign_route_tables("network", "filename", 1, "section", 1, "lvalue", 0, "254 1000 0 main", &tables, NULL) == 0);
+        assert_se(set_size(tables) == 2);
+        assert_se(set_contains(tables, UINT32_TO_PTR(254)));
+        assert_se(set_contains(tables, UINT32_TO_PTR(1000)));
+}
+
 int main(int argc, char **argv) {
         log_parse_environment();
         log_open();
@@ -218,6 +235,7 @@ int main(int argc, char **argv) {
         test_config_parse_duid_rawdata();
         test_config_parse_hwaddr();
         test_config_parse_address();
+        test_config_parse_ignore_foreign_routes();
 
         return 0;
 }
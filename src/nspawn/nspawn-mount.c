@@ -1,22 +1,30 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sched.h>
+#include <signal.h>
 #include <sys/mount.h>
 #include <linux/magic.h>
 
 #include "alloc-util.h"
 #include "escape.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "label.h"
+#include "missing.h"
 #include "mkdir.h"
 #include "mount-util.h"
 #include "mountpoint-util.h"
+#include "nspawn-def.h"
 #include "nspawn-mount.h"
 #include "parse-util.h"
 #include "path-util.h"
+#include "process-util.h"
+#include "raw-clone.h"
 #include "rm-rf.h"
 #include "set.h"
 #include "stat-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tmpfile-util.h"
@@ -1073,3 +1081,88 @@ done:
 
         return r;
 }
+
+static int userns_acquire(uid_t from, uid_t to, uid_t range) {
+        char path[STRLEN("/proc//uid_map") + DECIMAL_STR_MAX(pid_t) + 1], line[DECIMAL_STR_MAX(uid_t)*3+3+1];
+        _cleanup_(sigkill_waitp) pid_t pid = 0;
+        int fd, r;
+
+        /* Creates a user namespace mapping the specified range, and returns an fd referring to it. The namespace
+         * is created by a child that does nothing but wait to be killed, we only need it to exist long enough to
+         * open its namespace file. */
+
+        pid = raw_clone(SIGCHLD|CLONE_NEWUSER);
+        if (pid < 0)
+                return -errno;
+        if (pid == 0)
+                freeze();
+
+        xsprintf(line, UID_FMT " " UID_FMT " " UID_FMT "\n", from, to, range);
+
+        xsprintf(path, "/proc/" PID_FMT "/uid_map", pid);
+        r = write_string_file(path, line, WRITE_STRING_FILE_DISABLE_BUFFER);
+        if (r < 0)
+                return r;
+
+        xsprintf(path, "/proc/" PID_FMT "/gid_map", pid);
+        r = write_string_file(path, line, WRITE_STRING_FILE_DISABLE_BUFFER);
+        if (r < 0)
+                return r;
+
+        xsprintf(path, "/proc/" PID_FMT "/ns/user", pid);
+        fd = open(path, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        return fd;
+}
+
+int remount_idmap(const char *p, uid_t uid_shift, uid_t uid_range) {
+        _cleanup_close_ int userns_fd = -1, mount_fd = -1;
+        struct stat st;
+        uid_t base;
+
+        assert(p);
+
+        /* Instead of chown()ing the whole tree, place an ID-mapped mount of it on top of itself, so that the files
+         * owned by the UID range of the image appear to be owned by the UID range of the container. This requires
+         * kernel 5.12 and a file system that supports it, returns -EOPNOTSUPP, -ENOSYS or -EINVAL otherwise, in
+         * which case the caller should fall back to patching the tree. */
+
+        if ((uid_shift & 0xFFFF) != 0 || uid_range != 0x10000)
+                return -EOPNOTSUPP;
+
+        if (stat(p, &st) < 0)
+                return -errno;
+
+        if ((uint32_t) st.st_uid >> 16 != (uint32_t) st.st_gid >> 16)
+                return -EBADE;
+
+        /* A tree that is still marked busy by an interrupted chown needs to be finished by the chown logic */
+        if ((st.st_uid & UID_BUSY_MASK) == UID_BUSY_BASE)
+                return -EBUSY;
+
+        base = st.st_uid & UINT32_C(0xFFFF0000);
+        if (base == uid_shift)
+                return 0;
+
+        userns_fd = userns_acquire(base, uid_shift, uid_range);
+        if (userns_fd < 0)
+                return userns_fd;
+
+        mount_fd = open_tree(AT_FDCWD, p, OPEN_TREE_CLONE|OPEN_TREE_CLOEXEC|AT_RECURSIVE);
+        if (mount_fd < 0)
+                return -errno;
+
+        if (mount_setattr(mount_fd, "", AT_EMPTY_PATH|AT_RECURSIVE,
+                          &(struct mount_attr) {
+                                  .attr_set = MOUNT_ATTR_IDMAP,
+                                  .userns_fd = userns_fd,
+                          }, sizeof(struct mount_attr)) < 0)
+                return -errno;
+
+        if (move_mount(mount_fd, "", AT_FDCWD, p, MOVE_MOUNT_F_EMPTY_PATH) < 0)
+                return -errno;
+
+        return 1;
+}
@@ -55,4 +55,6 @@ int setup_volatile_state(const char *directory, VolatileMode mode, bool userns,
 int pivot_root_parse(char **pivot_root_new, char **pivot_root_old, const char *s);
 int setup_pivot_root(const char *directory, const char *pivot_root_new, const char *pivot_root_old);
 
+int remount_idmap(const char *p, uid_t uid_shift, uid_t uid_range);
+
 int tmpfs_patch_options(const char *options,uid_t uid_shift, const char *selinux_apifs_context, char **ret);
@@ -2,6 +2,7 @@
 
 #include <fcntl.h>
 #include <linux/magic.h>
+#include <pthread.h>
 #if HAVE_ACL
 #include <sys/acl.h>
 #endif
@@ -11,6 +12,7 @@
 #include <unistd.h>
 
 #include "acl-util.h"
+#include "alloc-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
 #include "fs-util.h"
@@ -22,6 +24,7 @@
 #include "string-util.h"
 #include "strv.h"
 #include "user-util.h"
+#include "worker-pool.h"
 
 #if HAVE_ACL
 
@@ -239,6 +242,14 @@ static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift
         if (!uid_is_valid(new_uid) || !gid_is_valid(new_gid))
                 return -EINVAL;
 
+        /* Patch the ACLs first, so that the ownership of directories, which is adjusted last, tells whether an
+         * object has been fully processed already. */
+        r = patch_acls(fd, name, st, shift);
+        if (r < 0)
+                return r;
+        if (r > 0)
+                changed = true;
+
         if (st->st_uid != new_uid || st->st_gid != new_gid) {
                 if (name)
                         r = fchownat(fd, name, new_uid, new_gid, AT_SYMLINK_NOFOLLOW);
@@ -261,11 +272,7 @@ static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift
                 changed = true;
         }
 
-        r = patch_acls(fd, name, st, shift);
-        if (r < 0)
-                return r;
-
-        return r > 0 || changed;
+        return changed;
 }
 
 /*
@@ -296,124 +303,248 @@ static int is_fs_fully_userns_compatible(const struct statfs *sfs) {
                F_TYPE_EQUAL(sfs->f_type, SYSFS_MAGIC);
 }
 
-static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, bool is_toplevel) {
-        _cleanup_closedir_ DIR *d = NULL;
+typedef struct PatchContext {
+        uid_t shift;
+        WorkerPool *pool;
+
+        pthread_mutex_t mutex;
+        int error;
+        bool changed;
+} PatchContext;
+
+/* A directory in the tree. It is patched itself only after everything below it has been, i.e. when the listing of
+ * its contents and all the subdirectories found there are done, which might happen in different threads. */
+typedef struct PatchDir {
+        PatchContext *context;
+        struct PatchDir *parent;
+
+        int fd;
+        struct stat st;
+
+        /* The listing of the directory itself, and the subdirectories not done yet. Protected by the mutex of the
+         * context. */
+        unsigned n_pending;
+
+        /* Whether to leave the directory itself alone */
+        bool skip;
+} PatchDir;
+
+static void patch_context_update(PatchContext *c, int r, bool changed) {
+        assert(c);
+
+        assert_se(pthread_mutex_lock(&c->mutex) == 0);
+        if (r < 0 && c->error == 0)
+                c->error = r;
+        if (changed)
+                c->changed = true;
+        assert_se(pthread_mutex_unlock(&c->mutex) == 0);
+}
+
+static bool patch_context_failed(PatchContext *c) {
+        bool failed;
+
+        assert(c);
+
+        assert_se(pthread_mutex_lock(&c->mutex) == 0);
+        failed = c->error < 0;
+        assert_se(pthread_mutex_unlock(&c->mutex) == 0);
+
+        return failed;
+}
+
+static PatchDir *patch_dir_new(PatchContext *c, PatchDir *parent, int fd, const struct stat *st) {
+        PatchDir *d;
+
+        assert(c);
+        assert(fd >= 0);
+        assert(st);
+
+        d = new(PatchDir, 1);
+        if (!d)
+                return NULL;
+
+        *d = (PatchDir) {
+                .context = c,
+                .parent = parent,
+                .fd = fd,
+                .st = *st,
+                .n_pending = 1,
+        };
+
+        if (parent) {
+                assert_se(pthread_mutex_lock(&c->mutex) == 0);
+                parent->n_pending++;
+                assert_se(pthread_mutex_unlock(&c->mutex) == 0);
+        }
+
+        return d;
+}
+
+static void patch_dir_log_read_only(PatchDir *d) {
+        _cleanup_free_ char *name = NULL;
+
+        assert(d);
+
+        /* When we hit a ready-only subtree we simply skip it, but log about it. */
+        (void) fd_get_path(d->fd, &name);
+        log_debug("Skippping read-only file or directory %s.", strna(name));
+}
+
+static void patch_dir_release(void *userdata) {
+        PatchDir *d = userdata;
+
+        /* Drops one pending reference of the directory. Once there are none left, the directory itself is patched
+         * and freed, and the same is done for its parent. */
+
+        while (d) {
+                PatchContext *c = d->context;
+                PatchDir *parent;
+                bool done;
+                int r;
+
+                assert_se(pthread_mutex_lock(&c->mutex) == 0);
+                assert(d->n_pending > 0);
+                done = --d->n_pending == 0;
+                assert_se(pthread_mutex_unlock(&c->mutex) == 0);
+
+                if (!done)
+                        return;
+
+                if (!d->skip && !patch_context_failed(c)) {
+                        r = patch_fd(d->fd, NULL, &d->st, c->shift);
+                        if (r == -EROFS && d->parent)
+                                patch_dir_log_read_only(d);
+                        else
+                                patch_context_update(c, r, r > 0);
+                }
+
+                parent = d->parent;
+                safe_close(d->fd);
+                free(d);
+                d = parent;
+        }
+}
+
+static int patch_dir_process(void *job, void *userdata) {
+        PatchDir *d = job;
+        PatchContext *c = userdata;
+        _cleanup_closedir_ DIR *dir = NULL;
+        struct dirent *de;
         bool changed = false;
         struct statfs sfs;
-        int r;
+        int copy, r;
 
-        assert(fd >= 0);
+        assert(d);
+        assert(c);
 
-        if (fstatfs(fd, &sfs) < 0)
-                return -errno;
+        /* Lists the directory and patches everything in it, except for subdirectories, which are queued or
+         * processed recursively. The directory itself is patched later, by patch_dir_release(). */
+
+        if (patch_context_failed(c))
+                return 0;
+
+        if (fstatfs(d->fd, &sfs) < 0) {
+                r = -errno;
+                goto finish;
+        }
 
         /* We generally want to permit crossing of mount boundaries when patching the UIDs/GIDs. However, we probably
          * shouldn't do this for /proc and /sys if that is already mounted into place. Hence, let's stop the recursion
          * when we hit procfs, sysfs or some other special file systems. */
-
-        r = is_fs_fully_userns_compatible(&sfs);
-        if (r < 0)
-                goto finish;
-        if (r > 0) {
-                r = 0; /* don't recurse */
-                goto finish;
+        if (is_fs_fully_userns_compatible(&sfs)) {
+                d->skip = true;
+                return 0;
         }
 
         /* Also, if we hit a read-only file system, then don't bother, skip the whole subtree */
         if ((sfs.f_flags & ST_RDONLY) ||
-            access_fd(fd, W_OK) == -EROFS)
-                goto read_only;
+            access_fd(d->fd, W_OK) == -EROFS) {
+                if (d->parent)
+                        patch_dir_log_read_only(d);
 
-        if (S_ISDIR(st->st_mode)) {
-                struct dirent *de;
+                d->skip = true;
+                return 0;
+        }
+
+        copy = fcntl(d->fd, F_DUPFD_CLOEXEC, 3);
+        if (copy < 0) {
+                r = -errno;
+                goto finish;
+        }
 
-                if (!donate_fd) {
-                        int copy;
+        dir = fdopendir(copy);
+        if (!dir) {
+                r = -errno;
+                safe_close(copy);
+                goto finish;
+        }
 
-                        copy = fcntl(fd, F_DUPFD_CLOEXEC, 3);
-                        if (copy < 0) {
-                                r = -errno;
-                                goto finish;
-                        }
+        FOREACH_DIRENT_ALL(de, dir, r = -errno; goto finish) {
+                struct stat fst;
 
-                        fd = copy;
-                        donate_fd = true;
-                }
+                if (dot_or_dot_dot(de->d_name))
+                        continue;
 
-                d = fdopendir(fd);
-                if (!d) {
+                if (fstatat(dirfd(dir), de->d_name, &fst, AT_SYMLINK_NOFOLLOW) < 0) {
                         r = -errno;
                         goto finish;
                 }
-                fd = -1;
 
-                FOREACH_DIRENT_ALL(de, d, r = -errno; goto finish) {
-                        struct stat fst;
+                if (S_ISDIR(fst.st_mode)) {
+                        PatchDir *sub;
+                        int subdir_fd;
 
-                        if (dot_or_dot_dot(de->d_name))
+                        /* Directories are patched after everything below them, hence one that is owned by the
+                         * right range already has been fully processed before, by an earlier, interrupted run. */
+                        if (((uint32_t) (fst.st_uid ^ c->shift) >> 16) == 0 &&
+                            ((uint32_t) (fst.st_gid ^ c->shift) >> 16) == 0)
                                 continue;
 
-                        if (fstatat(dirfd(d), de->d_name, &fst, AT_SYMLINK_NOFOLLOW) < 0) {
+                        subdir_fd = openat(dirfd(dir), de->d_name, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW|O_NOATIME);
+                        if (subdir_fd < 0) {
                                 r = -errno;
                                 goto finish;
                         }
 
-                        if (S_ISDIR(fst.st_mode)) {
-                                int subdir_fd;
-
-                                subdir_fd = openat(dirfd(d), de->d_name, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW|O_NOATIME);
-                                if (subdir_fd < 0) {
-                                        r = -errno;
-                                        goto finish;
+                        sub = patch_dir_new(c, d, subdir_fd, &fst);
+                        if (!sub) {
+                                safe_close(subdir_fd);
+                                r = -ENOMEM;
+                                goto finish;
+                        }
 
-                                }
+                        /* Hand the subdirectory to the worker threads if there's room, and walk it ourselves
+                         * otherwise. */
+                        if (c->pool && worker_pool_try_add(c->pool, sub))
+                                continue;
 
-                                r = recurse_fd(subdir_fd, true, &fst, shift, false);
-                                if (r < 0)
-                                        goto finish;
-                                if (r > 0)
-                                        changed = true;
+                        r = patch_dir_process(sub, c);
+                        patch_dir_release(sub);
+                        if (r < 0)
+                                goto finish;
 
-                        } else {
-                                r = patch_fd(dirfd(d), de->d_name, &fst, shift);
-                                if (r < 0)
-                                        goto finish;
-                                if (r > 0)
-                                        changed = true;
-                        }
+                } else {
+                        r = patch_fd(dirfd(dir), de->d_name, &fst, c->shift);
+                        if (r < 0)
+                                goto finish;
+                        if (r > 0)
+                                changed = true;
                 }
         }
 
-        /* After we descended, also patch the directory itself. It's key to do this in this order so that the top-level
-         * directory is patched as very last object in the tree, so that we can use it as quick indicator whether the
-         * tree is properly chown()ed already. */
-        r = patch_fd(d ? dirfd(d) : fd, NULL, st, shift);
-        if (r == -EROFS)
-                goto read_only;
-        if (r > 0)
-                changed = true;
-
-        r = changed;
-        goto finish;
-
-read_only:
-        if (!is_toplevel) {
-                _cleanup_free_ char *name = NULL;
-
-                /* When we hit a ready-only subtree we simply skip it, but log about it. */
-                (void) fd_get_path(fd, &name);
-                log_debug("Skippping read-only file or directory %s.", strna(name));
-                r = changed;
-        }
+        r = 0;
 
 finish:
-        if (donate_fd)
-                safe_close(fd);
-
+        patch_context_update(c, r, changed);
         return r;
 }
 
 static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t range) {
+        PatchContext context = {
+                .shift = shift,
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+        };
+        PatchDir *root;
         struct stat st;
         int r;
 
@@ -454,12 +585,15 @@ static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t rang
 
         /* Try to detect if the range is already right. Of course, this a pretty drastic optimization, as we assume
          * that if the top-level dir has the right upper 16bit assigned, then everything below will have too... */
-        if (((uint32_t) (st.st_uid ^ shift) >> 16) == 0)
-                return 0;
+        if (((uint32_t) (st.st_uid ^ shift) >> 16) == 0) {
+                r = 0;
+                goto finish;
+        }
 
         /* Before we start recursively chowning, mark the top-level dir as "busy" by chowning it to the "busy"
          * range. Should we be interrupted in the middle of our work, we'll see it owned by this user and will start
-         * chown()ing it again, unconditionally, as the busy UID is not a valid UID we'd everpick for ourselves. */
+         * chown()ing it again, unconditionally, as the busy UID is not a valid UID we'd everpick for ourselves. The
+         * subdirectories that were completed already are recognized by their owner, and skipped. */
 
         if ((st.st_uid & UID_BUSY_MASK) != UID_BUSY_BASE) {
                 if (fchown(fd,
@@ -470,7 +604,34 @@ static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t rang
                 }
         }
 
-        return recurse_fd(fd, donate_fd, &st, shift, true);
+        if (!donate_fd) {
+                int copy;
+
+                copy = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+                if (copy < 0)
+                        return -errno;
+
+                fd = copy;
+                donate_fd = true;
+        }
+
+        root = patch_dir_new(&context, NULL, fd, &st);
+        if (!root) {
+                r = -ENOMEM;
+                goto finish;
+        }
+        fd = -1; /* root owns the fd now */
+
+        /* If no threads can be started, everything is done right here */
+        context.pool = worker_pool_new(patch_dir_process, patch_dir_release, &context);
+
+        (void) patch_dir_process(root, &context);
+        patch_dir_release(root);
+
+        (void) worker_pool_finish(context.pool);
+        pthread_mutex_destroy(&context.mutex);
+
+        return context.error < 0 ? context.error : context.changed;
 
 finish:
         if (donate_fd)
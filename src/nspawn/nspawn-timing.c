@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/mman.h>
+
+#include "alloc-util.h"
+#include "log.h"
+#include "nspawn-timing.h"
+#include "string-table.h"
+#include "string-util.h"
+
+static const char *const startup_phase_table[_STARTUP_PHASE_MAX] = {
+        [STARTUP_PHASE_IMAGE] = "image",
+        [STARTUP_PHASE_OUTER] = "outer-setup",
+        [STARTUP_PHASE_CHOWN] = "chown",
+        [STARTUP_PHASE_UID_MAP] = "uid-map",
+        [STARTUP_PHASE_INNER_MOUNTS] = "inner-mounts",
+        [STARTUP_PHASE_NETWORK] = "network",
+        [STARTUP_PHASE_REGISTER] = "register",
+        [STARTUP_PHASE_CGROUP] = "cgroup",
+        [STARTUP_PHASE_INNER_SETUP] = "inner-setup",
+};
+
+DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(startup_phase, StartupPhase);
+
+StartupTiming* startup_timing_new(void) {
+        StartupTiming *t;
+
+        /* Shared, so that it stays shared with the children we fork off */
+        t = mmap(NULL, sizeof(StartupTiming), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (t == MAP_FAILED)
+                return NULL;
+
+        startup_timing_reset(t);
+
+        return t;
+}
+
+StartupTiming* startup_timing_free(StartupTiming *t) {
+        if (!t)
+                return NULL;
+
+        (void) munmap(t, sizeof(StartupTiming));
+        return NULL;
+}
+
+void startup_timing_reset(StartupTiming *t) {
+        if (!t)
+                return;
+
+        *t = (StartupTiming) {
+                .start = now(CLOCK_MONOTONIC),
+        };
+}
+
+void startup_timing_begin(StartupTiming *t, StartupPhase p) {
+        assert(p >= 0 && p < _STARTUP_PHASE_MAX);
+
+        if (!t)
+                return;
+
+        t->begin[p] = now(CLOCK_MONOTONIC);
+        t->end[p] = 0;
+}
+
+void startup_timing_end(StartupTiming *t, StartupPhase p) {
+        assert(p >= 0 && p < _STARTUP_PHASE_MAX);
+
+        if (!t || t->begin[p] == 0)
+                return;
+
+        t->end[p] = now(CLOCK_MONOTONIC);
+}
+
+void startup_timing_log(const StartupTiming *t) {
+        _cleanup_free_ char *s = NULL;
+        char total[FORMAT_TIMESPAN_MAX];
+        StartupPhase p;
+
+        if (!t || !DEBUG_LOGGING)
+                return;
+
+        for (p = 0; p < _STARTUP_PHASE_MAX; p++) {
+                char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX];
+
+                if (t->begin[p] == 0 || t->end[p] < t->begin[p])
+                        continue;
+
+                if (!strextend(&s,
+                               s ? ", " : "",
+                               startup_phase_to_string(p), " ",
+                               format_timespan(a, sizeof(a), t->end[p] - t->begin[p], USEC_PER_MSEC / 10), " at +",
+                               format_timespan(b, sizeof(b), t->begin[p] - t->start, USEC_PER_MSEC / 10),
+                               NULL)) {
+                        log_oom();
+                        return;
+                }
+        }
+
+        log_debug("Container started up in %s: %s.",
+                  format_timespan(total, sizeof(total), now(CLOCK_MONOTONIC) - t->start, USEC_PER_MSEC / 10),
+                  strna(s));
+}
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include "time-util.h"
+
+/* Wall-clock time spent in the individual steps of bringing up a container. The steps are spread over the container
+ * manager and its two children, hence the table lives in memory shared between all three, and is logged by the
+ * container manager once the container is up. Steps may overlap. */
+
+typedef enum StartupPhase {
+        STARTUP_PHASE_IMAGE,          /* Setting up the loop device and dissecting the image */
+        STARTUP_PHASE_OUTER,          /* Outer child: mounting the image and preparing the tree */
+        STARTUP_PHASE_CHOWN,          /* Outer child: adjusting ownership of the tree to the UID shift */
+        STARTUP_PHASE_UID_MAP,        /* Container manager: writing the UID/GID maps */
+        STARTUP_PHASE_INNER_MOUNTS,   /* Inner child: mounting the API file systems */
+        STARTUP_PHASE_NETWORK,        /* Container manager: moving and creating network interfaces */
+        STARTUP_PHASE_REGISTER,       /* Container manager: registering with machined or allocating the scope */
+        STARTUP_PHASE_CGROUP,         /* Container manager: setting up the cgroup */
+        STARTUP_PHASE_INNER_SETUP,    /* Inner child: everything else before the payload is executed */
+        _STARTUP_PHASE_MAX,
+        _STARTUP_PHASE_INVALID = -1,
+} StartupPhase;
+
+typedef struct StartupTiming {
+        usec_t start;
+        usec_t begin[_STARTUP_PHASE_MAX];
+        usec_t end[_STARTUP_PHASE_MAX];
+} StartupTiming;
+
+StartupTiming* startup_timing_new(void);
+StartupTiming* startup_timing_free(StartupTiming *t);
+
+void startup_timing_reset(StartupTiming *t);
+void startup_timing_begin(StartupTiming *t, StartupPhase p);
+void startup_timing_end(StartupTiming *t, StartupPhase p);
+
+void startup_timing_log(const StartupTiming *t);
@@ -73,6 +73,7 @@
 #include "nspawn-settings.h"
 #include "nspawn-setuid.h"
 #include "nspawn-stub-pid1.h"
+#include "nspawn-timing.h"
 #include "os-util.h"
 #include "pager.h"
 #include "parse-util.h"
@@ -206,6 +207,8 @@ static unsigned arg_cpuset_ncpus = 0;
 static ResolvConfMode arg_resolv_conf = RESOLV_CONF_AUTO;
 static TimezoneMode arg_timezone = TIMEZONE_AUTO;
 
+static StartupTiming *startup_timing = NULL;
+
 static int help(void) {
         _cleanup_free_ char *link = NULL;
         int r;
@@ -2541,32 +2544,39 @@ static int inner_child(
         if (r < 0)
                 return log_error_errno(r, "Couldn't become new root: %m");
 
-        r = mount_all(NULL,
-                      arg_mount_settings | MOUNT_IN_USERNS,
-                      arg_uid_shift,
-                      arg_selinux_apifs_context);
-        if (r < 0)
-                return r;
-
         if (!arg_network_namespace_path && arg_private_network) {
                 r = unshare(CLONE_NEWNET);
                 if (r < 0)
                         return log_error_errno(errno, "Failed to unshare network namespace: %m");
 
-                /* Tell the parent that it can setup network interfaces. */
+                /* Tell the parent that it can setup network interfaces. It does so while we mount the API file
+                 * systems below, only sysfs needs to wait for the network namespace. */
                 (void) barrier_place(barrier); /* #3 */
         }
 
+        startup_timing_begin(startup_timing, STARTUP_PHASE_INNER_MOUNTS);
+
+        r = mount_all(NULL,
+                      arg_mount_settings | MOUNT_IN_USERNS,
+                      arg_uid_shift,
+                      arg_selinux_apifs_context);
+        if (r < 0)
+                return r;
+
         r = mount_sysfs(NULL, arg_mount_settings);
         if (r < 0)
                 return r;
 
+        startup_timing_end(startup_timing, STARTUP_PHASE_INNER_MOUNTS);
+
         /* Wait until we are cgroup-ified, so that we
          * can mount the right cgroup path writable */
         if (!barrier_place_and_sync(barrier)) /* #4 */
                 return log_error_errno(SYNTHETIC_ERRNO(ESRCH),
                                        "Parent died too early");
 
+        startup_timing_begin(startup_timing, STARTUP_PHASE_INNER_SETUP);
+
         if (arg_use_cgns) {
                 r = unshare(CLONE_NEWCGROUP);
                 if (r < 0)
@@ -2682,6 +2692,8 @@ static int inner_child(
         if (!env_use)
                 return log_oom();
 
+        startup_timing_end(startup_timing, STARTUP_PHASE_INNER_SETUP);
+
         /* Let the parent know that we are ready and
          * wait until the parent is ready with the
          * setup, too... */
@@ -2804,6 +2816,7 @@ static int outer_child(
                 int netns_fd) {
 
         _cleanup_close_ int fd = -1;
+        bool idmapped = false;
         int r, which_failed;
         pid_t pid;
         ssize_t l;
@@ -2824,6 +2837,8 @@ static int outer_child(
         if (prctl(PR_SET_PDEATHSIG, SIGKILL) < 0)
                 return log_error_errno(errno, "PR_SET_PDEATHSIG failed: %m");
 
+        startup_timing_begin(startup_timing, STARTUP_PHASE_OUTER);
+
         if (interactive) {
                 int terminal;
 
@@ -2926,6 +2941,16 @@ static int outer_child(
         if (r < 0)
                 return r;
 
+        if (arg_userns_mode != USER_NAMESPACE_NO && arg_userns_chown) {
+                /* Prefer an ID-mapped mount over chown()ing the whole tree. If the kernel or the file system
+                 * don't support that, recursive_chown() below takes care of it. */
+                r = remount_idmap(directory, arg_uid_shift, arg_uid_range);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to set up ID-mapped mount of the OS tree, falling back to adjusting file ownership: %m");
+                else
+                        idmapped = true;
+        }
+
         r = setup_pivot_root(
                         directory,
                         arg_pivot_root_new,
@@ -2963,9 +2988,15 @@ static int outer_child(
         if (r < 0)
                 return r;
 
-        r = recursive_chown(directory, arg_uid_shift, arg_uid_range);
-        if (r < 0)
-                return r;
+        startup_timing_begin(startup_timing, STARTUP_PHASE_CHOWN);
+
+        if (!idmapped) {
+                r = recursive_chown(directory, arg_uid_shift, arg_uid_range);
+                if (r < 0)
+                        return r;
+        }
+
+        startup_timing_end(startup_timing, STARTUP_PHASE_CHOWN);
 
         r = base_filesystem_create(directory, arg_uid_shift, (gid_t) arg_uid_shift);
         if (r < 0)
@@ -3062,6 +3093,8 @@ static int outer_child(
         if (r < 0)
                 return log_error_errno(r, "Failed to apply resource limit RLIMIT_%s: %m", rlimit_to_string(which_failed));
 
+        startup_timing_end(startup_timing, STARTUP_PHASE_OUTER);
+
         pid = raw_clone(SIGCHLD|CLONE_NEWNS|
                         arg_clone_ns_flags |
                         (arg_userns_mode != USER_NAMESPACE_NO ? CLONE_NEWUSER : 0));
@@ -3757,6 +3790,18 @@ static int run(int master,
         uid_shift_socket_pair[1] = safe_close(uid_shift_socket_pair[1]);
         unified_cgroup_hierarchy_socket_pair[1] = safe_close(unified_cgroup_hierarchy_socket_pair[1]);
 
+        /* Connect to the bus now, while the outer child is busy setting up the file system tree, rather than
+         * afterwards */
+        if (arg_register || !arg_keep_unit) {
+                r = sd_bus_default_system(&bus);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to open system bus: %m");
+
+                r = sd_bus_set_close_on_exit(bus, false);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to disable close-on-exit behaviour: %m");
+        }
+
         if (arg_userns_mode != USER_NAMESPACE_NO) {
                 /* The child just let us know the UID shift it might have read from the image. */
                 l = recv(uid_shift_socket_pair[0], &arg_uid_shift, sizeof arg_uid_shift, 0);
@@ -3837,10 +3882,14 @@ static int run(int master,
                         return -ESRCH;
                 }
 
+                startup_timing_begin(startup_timing, STARTUP_PHASE_UID_MAP);
+
                 r = setup_uid_map(*pid);
                 if (r < 0)
                         return r;
 
+                startup_timing_end(startup_timing, STARTUP_PHASE_UID_MAP);
+
                 (void) barrier_place(&barrier); /* #2 */
         }
 
@@ -3853,6 +3902,8 @@ static int run(int master,
                         }
                 }
 
+                startup_timing_begin(startup_timing, STARTUP_PHASE_NETWORK);
+
                 r = move_network_interfaces(*pid, arg_network_interfaces);
                 if (r < 0)
                         return r;
@@ -3899,18 +3950,12 @@ static int run(int master,
                 r = setup_ipvlan(arg_machine, *pid, arg_network_ipvlan);
                 if (r < 0)
                         return r;
-        }
 
-        if (arg_register || !arg_keep_unit) {
-                r = sd_bus_default_system(&bus);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to open system bus: %m");
-
-                r = sd_bus_set_close_on_exit(bus, false);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to disable close-on-exit behaviour: %m");
+                startup_timing_end(startup_timing, STARTUP_PHASE_NETWORK);
         }
 
+        startup_timing_begin(startup_timing, STARTUP_PHASE_REGISTER);
+
         if (!arg_keep_unit) {
                 /* When a new scope is created for this container, then we'll be registered as its controller, in which
                  * case PID 1 will send us a friendly RequestStop signal, when it is asked to terminate the
@@ -3960,6 +4005,9 @@ static int run(int master,
         } else if (arg_slice || arg_property)
                 log_notice("Machine and scope registration turned off, --slice= and --property= settings will have no effect.");
 
+        startup_timing_end(startup_timing, STARTUP_PHASE_REGISTER);
+        startup_timing_begin(startup_timing, STARTUP_PHASE_CGROUP);
+
         r = sync_cgroup(*pid, arg_unified_cgroup_hierarchy, arg_uid_shift);
         if (r < 0)
                 return r;
@@ -3972,6 +4020,8 @@ static int run(int master,
         if (r < 0)
                 return r;
 
+        startup_timing_end(startup_timing, STARTUP_PHASE_CGROUP);
+
         /* Notify the child that the parent is ready with all
          * its setup (including cgroup-ification), and that
          * the child can now hand over control to the code to
@@ -4009,6 +4059,8 @@ static int run(int master,
                 return -ESRCH;
         }
 
+        startup_timing_log(startup_timing);
+
         /* At this point we have made use of the UID we picked, and thus nss-mymachines
          * will make them appear in getpwuid(), thus we can release the /etc/passwd lock. */
         etc_passwd_lock = safe_close(etc_passwd_lock);
@@ -4198,6 +4250,9 @@ int main(int argc, char *argv[]) {
         if (r <= 0)
                 goto finish;
 
+        /* Not having timing information is not a reason to fail */
+        startup_timing = startup_timing_new();
+
         r = must_be_root();
         if (r < 0)
                 goto finish;
@@ -4435,6 +4490,8 @@ int main(int argc, char *argv[]) {
                         goto finish;
                 }
 
+                startup_timing_begin(startup_timing, STARTUP_PHASE_IMAGE);
+
                 r = loop_device_make_by_path(arg_image, arg_read_only ? O_RDONLY : O_RDWR, &loop);
                 if (r < 0) {
                         log_error_errno(r, "Failed to set up loopback block device: %m");
@@ -4467,6 +4524,8 @@ int main(int argc, char *argv[]) {
                 if (r < 0)
                         goto finish;
 
+                startup_timing_end(startup_timing, STARTUP_PHASE_IMAGE);
+
                 /* Now that we mounted the image, let's try to remove it again, if it is ephemeral */
                 if (remove_image && unlink(arg_image) >= 0)
                         remove_image = false;
@@ -4525,6 +4584,8 @@ int main(int argc, char *argv[]) {
                         &pid, &ret);
                 if (r <= 0)
                         break;
+
+                startup_timing_reset(startup_timing);
         }
 
 finish:
@@ -4603,6 +4664,7 @@ finish:
         strv_free(arg_syscall_whitelist);
         strv_free(arg_syscall_blacklist);
         arg_cpuset = cpu_set_mfree(arg_cpuset);
+        startup_timing = startup_timing_free(startup_timing);
 
         return r < 0 ? EXIT_FAILURE : ret;
 }
@@ -3,8 +3,10 @@
 #include <errno.h>
 #include <netdb.h>
 #include <nss.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "sd-bus.h"
 
@@ -12,6 +14,7 @@
 #include "in-addr-util.h"
 #include "macro.h"
 #include "nss-util.h"
+#include "process-util.h"
 #include "resolved-def.h"
 #include "string-util.h"
 #include "util.h"
@@ -27,6 +30,218 @@ static bool bus_error_shall_fallback(sd_bus_error *e) {
                sd_bus_error_has_name(e, SD_BUS_ERROR_ACCESS_DENIED);
 }
 
+/* The connection to systemd-resolved is kept around for later lookups of the same process. Only one thread uses it
+ * at a time, others open a connection of their own while it is busy. */
+static pthread_mutex_t cached_bus_mutex = PTHREAD_MUTEX_INITIALIZER;
+static sd_bus *cached_bus = NULL;
+static pid_t cached_bus_pid = 0;
+static int cached_bus_fd = -1;
+static dev_t cached_bus_dev = 0;
+static ino_t cached_bus_ino = 0;
+
+typedef struct ResolveBus {
+        sd_bus *bus;
+        bool cached;
+} ResolveBus;
+
+static int bus_open_resolved(sd_bus **ret) {
+        _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
+        int r;
+
+        assert(ret);
+
+        /* Preferably talk to systemd-resolved directly, which saves the detour through the bus broker. Fall back
+         * to the system bus if that's not possible, for example because systemd-resolved is too old. */
+
+        r = sd_bus_new(&bus);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_set_address(bus, "unix:path=" SD_RESOLVED_PRIVATE_BUS_PATH);
+        if (r < 0)
+                return r;
+
+        if (sd_bus_start(bus) >= 0) {
+                *ret = TAKE_PTR(bus);
+                return 0;
+        }
+
+        return sd_bus_open_system(ret);
+}
+
+static int cached_bus_remember(void) {
+        struct stat st;
+        int fd;
+
+        /* Remember which socket the connection uses, see cached_bus_owns_fd(). Note that we keep the fd number
+         * ourselves, as sd_bus_get_fd() refuses to tell it to a forked off child. */
+        fd = sd_bus_get_fd(cached_bus);
+        if (fd < 0)
+                return fd;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        cached_bus_pid = getpid_cached();
+        cached_bus_fd = fd;
+        cached_bus_dev = st.st_dev;
+        cached_bus_ino = st.st_ino;
+        return 0;
+}
+
+static bool cached_bus_owns_fd(void) {
+        struct stat st;
+
+        /* The program might have closed all fds it doesn't know about, e.g. after forking, and the fd number
+         * might have been reused for something else since. */
+        if (cached_bus_fd < 0)
+                return false;
+
+        if (fstat(cached_bus_fd, &st) < 0)
+                return false;
+
+        return st.st_dev == cached_bus_dev && st.st_ino == cached_bus_ino;
+}
+
+static void cached_bus_forget(void) {
+        /* If the fd isn't ours anymore, we must neither write to it, nor close it. Freeing the connection object
+         * would do the latter, hence leak it in that case. The same applies to a connection inherited from our
+         * parent process: the fd is shared with the parent, and the program might have reused the number. */
+        if (cached_bus_pid != getpid_cached() || !cached_bus_owns_fd())
+                cached_bus = NULL;
+        else
+                cached_bus = sd_bus_unref(cached_bus);
+
+        cached_bus_fd = -1;
+}
+
+static int resolve_bus_acquire(ResolveBus *b) {
+        int r;
+
+        assert(b);
+
+        if (pthread_mutex_trylock(&cached_bus_mutex) != 0) {
+                b->cached = false;
+                return bus_open_resolved(&b->bus);
+        }
+
+        /* Don't reuse connections inherited from our parent process, ones that broke meanwhile, or ones whose fd
+         * was closed behind our back */
+        if (cached_bus &&
+            (cached_bus_pid != getpid_cached() || !cached_bus_owns_fd() || sd_bus_is_open(cached_bus) <= 0))
+                cached_bus_forget();
+
+        if (!cached_bus) {
+                r = bus_open_resolved(&cached_bus);
+                if (r >= 0)
+                        r = cached_bus_remember();
+                if (r < 0) {
+                        cached_bus = sd_bus_unref(cached_bus);
+                        assert_se(pthread_mutex_unlock(&cached_bus_mutex) == 0);
+                        return r;
+                }
+        }
+
+        b->bus = cached_bus;
+        b->cached = true;
+        return 0;
+}
+
+static int resolve_bus_reopen(ResolveBus *b) {
+        int r;
+
+        assert(b);
+
+        if (!b->cached) {
+                b->bus = sd_bus_flush_close_unref(b->bus);
+                return bus_open_resolved(&b->bus);
+        }
+
+        cached_bus_forget();
+
+        r = bus_open_resolved(&cached_bus);
+        if (r >= 0)
+                r = cached_bus_remember();
+        if (r < 0)
+                cached_bus = sd_bus_unref(cached_bus);
+
+        b->bus = cached_bus;
+        return r;
+}
+
+static void resolve_bus_release(ResolveBus *b) {
+        assert(b);
+
+        if (b->cached)
+                assert_se(pthread_mutex_unlock(&cached_bus_mutex) == 0);
+        else
+                sd_bus_flush_close_unref(b->bus);
+
+        *b = (ResolveBus) {};
+}
+
+static int resolve_call(
+                ResolveBus *b,
+                const char *method,
+                const char *name,
+                int af,
+                const void *addr, size_t len,
+                sd_bus_error *error,
+                sd_bus_message **ret_reply) {
+
+        unsigned attempt;
+        int r;
+
+        assert(b);
+        assert(method);
+
+        for (attempt = 0;; attempt++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL;
+
+                r = sd_bus_message_new_method_call(
+                                b->bus,
+                                &req,
+                                "org.freedesktop.resolve1",
+                                "/org/freedesktop/resolve1",
+                                "org.freedesktop.resolve1.Manager",
+                                method);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_set_auto_start(req, false);
+                if (r < 0)
+                        return r;
+
+                if (name)
+                        r = sd_bus_message_append(req, "isit", 0, name, af, (uint64_t) 0);
+                else {
+                        r = sd_bus_message_append(req, "ii", 0, af);
+                        if (r < 0)
+                                return r;
+
+                        r = sd_bus_message_append_array(req, 'y', addr, len);
+                        if (r < 0)
+                                return r;
+
+                        r = sd_bus_message_append(req, "t", (uint64_t) 0);
+                }
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_call(b->bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, error, ret_reply);
+                if (r >= 0 || attempt > 0 || sd_bus_is_open(b->bus) > 0)
+                        return r;
+
+                /* The connection broke, most likely because systemd-resolved was restarted since we opened it.
+                 * Try once more with a new one. */
+                sd_bus_error_free(error);
+
+                r = resolve_bus_reopen(b);
+                if (r < 0)
+                        return r;
+        }
+}
+
 static int count_addresses(sd_bus_message *m, int af, const char **canonical) {
         int c = 0, r;
 
@@ -112,10 +327,10 @@ enum nss_status _nss_resolve_gethostbyname4_r(
                 int *errnop, int *h_errnop,
                 int32_t *ttlp) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL, *reply = NULL;
+        _cleanup_(resolve_bus_release) ResolveBus bus = {};
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         struct gaih_addrtuple *r_tuple, *r_tuple_first = NULL;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         enum nss_status ret = NSS_STATUS_UNAVAIL;
         const char *canonical = NULL;
         size_t l, ms, idx;
@@ -136,29 +351,11 @@ enum nss_status _nss_resolve_gethostbyname4_r(
                 goto fail;
         }
 
-        r = sd_bus_open_system(&bus);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &req,
-                        "org.freedesktop.resolve1",
-                        "/org/freedesktop/resolve1",
-                        "org.freedesktop.resolve1.Manager",
-                        "ResolveHostname");
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_set_auto_start(req, false);
+        r = resolve_bus_acquire(&bus);
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_message_append(req, "isit", 0, name, AF_UNSPEC, (uint64_t) 0);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_call(bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, &error, &reply);
+        r = resolve_call(&bus, "ResolveHostname", name, AF_UNSPEC, NULL, 0, &error, &reply);
         if (r < 0) {
                 if (sd_bus_error_has_name(&error, _BUS_ERROR_DNS "NXDOMAIN") ||
                     !bus_error_shall_fallback(&error))
@@ -285,10 +482,10 @@ enum nss_status _nss_resolve_gethostbyname3_r(
                 int32_t *ttlp,
                 char **canonp) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL, *reply = NULL;
+        _cleanup_(resolve_bus_release) ResolveBus bus = {};
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         char *r_name, *r_aliases, *r_addr, *r_addr_list;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         enum nss_status ret = NSS_STATUS_UNAVAIL;
         size_t l, idx, ms, alen;
         const char *canonical;
@@ -316,29 +513,11 @@ enum nss_status _nss_resolve_gethostbyname3_r(
                 goto fail;
         }
 
-        r = sd_bus_open_system(&bus);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &req,
-                        "org.freedesktop.resolve1",
-                        "/org/freedesktop/resolve1",
-                        "org.freedesktop.resolve1.Manager",
-                        "ResolveHostname");
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_set_auto_start(req, false);
+        r = resolve_bus_acquire(&bus);
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_message_append(req, "isit", 0, name, af, (uint64_t) 0);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_call(bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, &error, &reply);
+        r = resolve_call(&bus, "ResolveHostname", name, af, NULL, 0, &error, &reply);
         if (r < 0) {
                 if (sd_bus_error_has_name(&error, _BUS_ERROR_DNS "NXDOMAIN") ||
                     !bus_error_shall_fallback(&error))
@@ -472,10 +651,10 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
                 int *errnop, int *h_errnop,
                 int32_t *ttlp) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL, *reply = NULL;
+        _cleanup_(resolve_bus_release) ResolveBus bus = {};
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         char *r_name, *r_aliases, *r_addr, *r_addr_list;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         enum nss_status ret = NSS_STATUS_UNAVAIL;
         unsigned c = 0, i = 0;
         size_t ms = 0, idx;
@@ -508,37 +687,11 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
                 goto fail;
         }
 
-        r = sd_bus_open_system(&bus);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &req,
-                        "org.freedesktop.resolve1",
-                        "/org/freedesktop/resolve1",
-                        "org.freedesktop.resolve1.Manager",
-                        "ResolveAddress");
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_set_auto_start(req, false);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_append(req, "ii", 0, af);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_append_array(req, 'y', addr, len);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_append(req, "t", (uint64_t) 0);
+        r = resolve_bus_acquire(&bus);
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_call(bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, &error, &reply);
+        r = resolve_call(&bus, "ResolveAddress", NULL, af, addr, len, &error, &reply);
         if (r < 0) {
                 if (sd_bus_error_has_name(&error, _BUS_ERROR_DNS "NXDOMAIN") ||
                     !bus_error_shall_fallback(&error))
@@ -344,7 +344,7 @@ static int extract_now(
         return 0;
 }
 
-static int portable_extract_by_path(
+static int extract_image(
                 const char *path,
                 char **matches,
                 PortableMetadata **ret_os_release,
@@ -474,6 +474,196 @@ static int portable_extract_by_path(
                 child = 0;
         }
 
+        *ret_os_release = TAKE_PTR(os_release);
+        *ret_unit_files = TAKE_PTR(unit_files);
+
+        return 0;
+}
+
+/* What was extracted from a raw image, remembered as long as the image doesn't change */
+typedef struct PortableCacheEntry {
+        char *path;
+        struct stat st;
+
+        PortableMetadata *os_release;
+        Hashmap *unit_files; /* all of them, regardless of the matches */
+} PortableCacheEntry;
+
+/* The fds of the cached entries keep the images busy, hence don't keep too many of them */
+#define PORTABLE_CACHE_ENTRIES_MAX 64U
+
+static PortableCacheEntry *portable_cache_entry_free(PortableCacheEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->path);
+        portable_metadata_unref(e->os_release);
+        hashmap_free(e->unit_files);
+
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PortableCacheEntry*, portable_cache_entry_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(portable_cache_hash_ops, char, string_hash_func, string_compare_func,
+                                              PortableCacheEntry, portable_cache_entry_free);
+
+static bool portable_cache_entry_is_current(const PortableCacheEntry *e, const struct stat *st) {
+        assert(e);
+        assert(st);
+
+        return e->st.st_dev == st->st_dev &&
+                e->st.st_ino == st->st_ino &&
+                e->st.st_size == st->st_size &&
+                timespec_load_nsec(&e->st.st_mtim) == timespec_load_nsec(&st->st_mtim);
+}
+
+static int portable_metadata_clone(const PortableMetadata *m, PortableMetadata **ret) {
+        _cleanup_(portable_metadata_unrefp) PortableMetadata *c = NULL;
+        _cleanup_close_ int fd = -1;
+
+        assert(m);
+        assert(ret);
+
+        /* Every user of the metadata reads the file from the beginning, hence give out a separate file
+         * description each time rather than a duplicate of the same one */
+        fd = fd_reopen(m->fd, O_RDONLY|O_CLOEXEC);
+        if (fd < 0)
+                return fd;
+
+        c = portable_metadata_new(m->name, fd);
+        if (!c)
+                return -ENOMEM;
+        fd = -1;
+
+        if (m->source) {
+                c->source = strdup(m->source);
+                if (!c->source)
+                        return -ENOMEM;
+        }
+
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
+static int extract_image_cached(
+                Hashmap **cache,
+                const char *path,
+                const struct stat *st,
+                char **matches,
+                PortableMetadata **ret_os_release,
+                Hashmap **ret_unit_files,
+                sd_bus_error *error) {
+
+        _cleanup_(portable_metadata_unrefp) PortableMetadata *os_release = NULL;
+        _cleanup_hashmap_free_ Hashmap *unit_files = NULL;
+        PortableCacheEntry *e;
+        PortableMetadata *i;
+        Iterator j;
+        int r;
+
+        assert(cache);
+        assert(path);
+        assert(st);
+
+        /* Setting up a raw image, i.e. dissecting, mounting it in a child process and passing the files back to us,
+         * is not cheap, and inspecting or attaching an image usually happens more than once. Hence remember the
+         * files, and hand out new fds of them as long as the image is unchanged. */
+
+        e = hashmap_get(*cache, path);
+        if (e && !portable_cache_entry_is_current(e, st)) {
+                portable_cache_entry_free(hashmap_remove(*cache, path));
+                e = NULL;
+        }
+
+        if (!e) {
+                _cleanup_(portable_cache_entry_freep) PortableCacheEntry *n = NULL;
+
+                r = hashmap_ensure_allocated(cache, &portable_cache_hash_ops);
+                if (r < 0)
+                        return r;
+
+                n = new0(PortableCacheEntry, 1);
+                if (!n)
+                        return -ENOMEM;
+
+                n->path = strdup(path);
+                if (!n->path)
+                        return -ENOMEM;
+
+                n->st = *st;
+
+                r = extract_image(path, NULL, &n->os_release, &n->unit_files, error);
+                if (r < 0)
+                        return r;
+
+                if (hashmap_size(*cache) >= PORTABLE_CACHE_ENTRIES_MAX)
+                        hashmap_clear(*cache);
+
+                r = hashmap_put(*cache, n->path, n);
+                if (r < 0)
+                        return r;
+
+                e = TAKE_PTR(n);
+        } else
+                log_debug("Using cached metadata of image '%s'.", path);
+
+        if (e->os_release) {
+                r = portable_metadata_clone(e->os_release, &os_release);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to reopen os-release file: %m");
+        }
+
+        unit_files = hashmap_new(&portable_metadata_hash_ops);
+        if (!unit_files)
+                return -ENOMEM;
+
+        HASHMAP_FOREACH(i, e->unit_files, j) {
+                _cleanup_(portable_metadata_unrefp) PortableMetadata *c = NULL;
+
+                if (!unit_match(i->name, matches))
+                        continue;
+
+                r = portable_metadata_clone(i, &c);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to reopen unit file '%s': %m", i->name);
+
+                r = hashmap_put(unit_files, c->name, c);
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(c);
+        }
+
+        *ret_os_release = TAKE_PTR(os_release);
+        *ret_unit_files = TAKE_PTR(unit_files);
+
+        return 0;
+}
+
+static int portable_extract_by_path(
+                const char *path,
+                char **matches,
+                Hashmap **cache,
+                PortableMetadata **ret_os_release,
+                Hashmap **ret_unit_files,
+                sd_bus_error *error) {
+
+        _cleanup_hashmap_free_ Hashmap *unit_files = NULL;
+        _cleanup_(portable_metadata_unrefp) PortableMetadata* os_release = NULL;
+        struct stat st;
+        int r;
+
+        assert(path);
+
+        /* Directory trees are cheap to look at directly, and changes deep down in them wouldn't be noticed */
+        if (cache && stat(path, &st) >= 0 && !S_ISDIR(st.st_mode))
+                r = extract_image_cached(cache, path, &st, matches, &os_release, &unit_files, error);
+        else
+                r = extract_image(path, matches, &os_release, &unit_files, error);
+        if (r < 0)
+                return r;
+
         if (!os_release)
                 return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Image '%s' lacks os-release data, refusing.", path);
 
@@ -492,6 +682,7 @@ static int portable_extract_by_path(
 int portable_extract(
                 const char *name_or_path,
                 char **matches,
+                Hashmap **cache,
                 PortableMetadata **ret_os_release,
                 Hashmap **ret_unit_files,
                 sd_bus_error *error) {
@@ -505,7 +696,7 @@ int portable_extract(
         if (r < 0)
                 return r;
 
-        return portable_extract_by_path(image->path, matches, ret_os_release, ret_unit_files, error);
+        return portable_extract_by_path(image->path, matches, cache, ret_os_release, ret_unit_files, error);
 }
 
 static int unit_file_is_active(
@@ -971,6 +1162,7 @@ int portable_attach(
                 char **matches,
                 const char *profile,
                 PortableFlags flags,
+                Hashmap **cache,
                 PortableChange **changes,
                 size_t *n_changes,
                 sd_bus_error *error) {
@@ -988,7 +1180,7 @@ int portable_attach(
         if (r < 0)
                 return r;
 
-        r = portable_extract_by_path(image->path, matches, NULL, &unit_files, error);
+        r = portable_extract_by_path(image->path, matches, cache, NULL, &unit_files, error);
         if (r < 0)
                 return r;
 
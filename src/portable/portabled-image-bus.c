@@ -129,6 +129,7 @@ int bus_image_common_get_metadata(
         r = portable_extract(
                         image->path,
                         matches,
+                        &m->metadata_cache,
                         &os_release,
                         &unit_files,
                         error);
@@ -268,6 +269,7 @@ int bus_image_common_attach(
                         matches,
                         profile,
                         flags,
+                        &m->metadata_cache,
                         &changes,
                         &n_changes,
                         error);
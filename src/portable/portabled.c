@@ -48,6 +48,7 @@ static Manager* manager_unref(Manager *m) {
         assert(m);
 
         hashmap_free(m->image_cache);
+        hashmap_free(m->metadata_cache);
 
         sd_event_source_unref(m->image_cache_defer_event);
 
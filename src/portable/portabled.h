@@ -20,6 +20,9 @@ struct Manager {
         Hashmap *image_cache;
         sd_event_source *image_cache_defer_event;
 
+        /* Unit files and os-release extracted from raw images, see portable_extract() */
+        Hashmap *metadata_cache;
+
         LIST_HEAD(Operation, operations);
         unsigned n_operations;
 };
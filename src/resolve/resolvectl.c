@@ -25,6 +25,7 @@
 #include "resolvectl.h"
 #include "resolved-def.h"
 #include "resolved-dns-packet.h"
+#include "resolved-latency.h"
 #include "string-table.h"
 #include "strv.h"
 #include "terminal-util.h"
@@ -996,13 +997,169 @@ static int verb_tlsa(int argc, char **argv, void *userdata) {
         return r;
 }
 
+static int show_cache_statistics_by_type(sd_bus *bus) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        uint64_t n_hit, n_miss;
+        const char *type;
+        bool header = false;
+        int r;
+
+        assert(bus);
+
+        r = sd_bus_get_property(bus,
+                                "org.freedesktop.resolve1",
+                                "/org/freedesktop/resolve1",
+                                "org.freedesktop.resolve1.Manager",
+                                "CacheStatisticsByType",
+                                &error,
+                                &reply,
+                                "a(stt)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cache statistics by type: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, 'a', "(stt)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(stt)", &type, &n_hit, &n_miss)) > 0) {
+                if (n_hit + n_miss == 0)
+                        continue;
+
+                if (!header) {
+                        printf("\n%sCache Hit Ratio by Type%s\n", ansi_highlight(), ansi_normal());
+                        header = true;
+                }
+
+                printf("%20s: %" PRIu64 "%% (%" PRIu64 " of %" PRIu64 ")\n",
+                       type, n_hit * 100 / (n_hit + n_miss), n_hit, n_hit + n_miss);
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        return 0;
+}
+
+static int show_latency_statistics(sd_bus *bus) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        uint64_t histograms[_DNS_PROTOCOL_MAX][LATENCY_HISTOGRAM_BUCKETS] = {}, n_timeouts[_DNS_PROTOCOL_MAX] = {};
+        const uint64_t *buckets;
+        size_t sz, i;
+        DnsProtocol p;
+        int r;
+
+        assert(bus);
+
+        r = sd_bus_get_property(bus,
+                                "org.freedesktop.resolve1",
+                                "/org/freedesktop/resolve1",
+                                "org.freedesktop.resolve1.Manager",
+                                "ScopeLatencyStatistics",
+                                &error,
+                                &reply,
+                                "a(siiatt)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get latency statistics: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, 'a', "(siiatt)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        /* Sum up the histograms of all scopes of the same protocol */
+        while ((r = sd_bus_message_enter_container(reply, 'r', "siiatt")) > 0) {
+                const char *protocol;
+                uint64_t n;
+                int ifindex, family;
+
+                r = sd_bus_message_read(reply, "sii", &protocol, &ifindex, &family);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_read_array(reply, 't', (const void**) &buckets, &sz);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_read(reply, "t", &n);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                p = dns_protocol_from_string(protocol);
+                if (p < 0)
+                        continue;
+
+                for (i = 0; i < MIN(sz / sizeof(uint64_t), (size_t) LATENCY_HISTOGRAM_BUCKETS); i++)
+                        histograms[p][i] += buckets[i];
+                n_timeouts[p] += n;
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        reply = sd_bus_message_unref(reply);
+
+        r = sd_bus_get_property(bus,
+                                "org.freedesktop.resolve1",
+                                "/org/freedesktop/resolve1",
+                                "org.freedesktop.resolve1.Manager",
+                                "LatencyHistogramBuckets",
+                                &error,
+                                &reply,
+                                "at");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get latency histogram buckets: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_read_array(reply, 't', (const void**) &buckets, &sz);
+        if (r < 0)
+                return bus_log_parse_error(r);
+        sz = MIN(sz / sizeof(uint64_t), (size_t) LATENCY_HISTOGRAM_BUCKETS);
+
+        for (p = 0; p < _DNS_PROTOCOL_MAX; p++) {
+                uint64_t total = n_timeouts[p];
+
+                for (i = 0; i < sz; i++)
+                        total += histograms[p][i];
+                if (total == 0)
+                        continue;
+
+                printf("\n%sResponse Times (%s)%s\n", ansi_highlight(), dns_protocol_to_string(p), ansi_normal());
+
+                for (i = 0; i < sz; i++) {
+                        char ts[FORMAT_TIMESPAN_MAX];
+
+                        if (buckets[i] == USEC_INFINITY)
+                                printf("%20s: %" PRIu64 "\n", "slower", histograms[p][i]);
+                        else
+                                printf("%14s %5s: %" PRIu64 "\n", "up to",
+                                       format_timespan(ts, sizeof ts, buckets[i], USEC_PER_MSEC),
+                                       histograms[p][i]);
+                }
+
+                printf("%20s: %" PRIu64 "\n", "Timeouts", n_timeouts[p]);
+        }
+
+        return 0;
+}
+
 static int show_statistics(int argc, char **argv, void *userdata) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         sd_bus *bus = userdata;
         uint64_t n_current_transactions, n_total_transactions,
-                cache_size, n_cache_hit, n_cache_miss,
+                cache_size, n_cache_hit, n_cache_miss, cache_memory, n_cache_evicted,
                 n_dnssec_secure, n_dnssec_insecure, n_dnssec_bogus, n_dnssec_indeterminate;
+        char buf[FORMAT_BYTES_MAX];
         int r, dnssec_supported;
 
         assert(bus);
@@ -1068,18 +1225,45 @@ static int show_statistics(int argc, char **argv, void *userdata) {
         if (r < 0)
                 return bus_log_parse_error(r);
 
+        reply = sd_bus_message_unref(reply);
+
+        r = sd_bus_get_property(bus,
+                                "org.freedesktop.resolve1",
+                                "/org/freedesktop/resolve1",
+                                "org.freedesktop.resolve1.Manager",
+                                "CacheMemoryStatistics",
+                                &error,
+                                &reply,
+                                "(tt)");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cache memory statistics: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_read(reply, "(tt)",
+                                &cache_memory,
+                                &n_cache_evicted);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
         printf("\n%sCache%s\n"
                "  Current Cache Size: %" PRIu64 "\n"
+               "Current Cache Memory: %s\n"
                "          Cache Hits: %" PRIu64 "\n"
-               "        Cache Misses: %" PRIu64 "\n",
+               "        Cache Misses: %" PRIu64 "\n"
+               "     Cache Evictions: %" PRIu64 "\n",
                ansi_highlight(),
                ansi_normal(),
                cache_size,
+               format_bytes(buf, sizeof buf, cache_memory),
                n_cache_hit,
-               n_cache_miss);
+               n_cache_miss,
+               n_cache_evicted);
 
         reply = sd_bus_message_unref(reply);
 
+        r = show_cache_statistics_by_type(bus);
+        if (r < 0)
+                return r;
+
         r = sd_bus_get_property(bus,
                                 "org.freedesktop.resolve1",
                                 "/org/freedesktop/resolve1",
@@ -1111,7 +1295,7 @@ static int show_statistics(int argc, char **argv, void *userdata) {
                n_dnssec_bogus,
                n_dnssec_indeterminate);
 
-        return 0;
+        return show_latency_statistics(bus);
 }
 
 static int reset_statistics(int argc, char **argv, void *userdata) {
@@ -1,9 +1,14 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "alloc-util.h"
 #include "bus-common-errors.h"
 #include "bus-util.h"
 #include "dns-domain.h"
+#include "event-util.h"
+#include "fd-util.h"
 #include "missing_capability.h"
 #include "resolved-bus.h"
 #include "resolved-def.h"
@@ -11,9 +16,15 @@
 #include "resolved-dnssd.h"
 #include "resolved-dnssd-bus.h"
 #include "resolved-link-bus.h"
+#include "socket-util.h"
+#include "stdio-util.h"
 #include "user-util.h"
 #include "utf8.h"
 
+/* How many direct connections from nss-resolve to keep open at most per user, and in total */
+#define PRIVATE_BUS_CONNECTIONS_PER_UID_MAX 128
+#define PRIVATE_BUS_CONNECTIONS_MAX 4096
+
 BUS_DEFINE_PROPERTY_GET_ENUM(bus_property_get_resolve_support, resolve_support, ResolveSupport);
 
 static int reply_query_state(DnsQuery *q) {
@@ -205,7 +216,7 @@ static void bus_method_resolve_hostname_complete(DnsQuery *q) {
         if (r < 0)
                 goto finish;
 
-        r = sd_bus_send(q->manager->bus, reply, NULL);
+        r = sd_bus_send(NULL, reply, NULL);
 
 finish:
         if (r < 0) {
@@ -433,7 +444,7 @@ static void bus_method_resolve_address_complete(DnsQuery *q) {
         if (r < 0)
                 goto finish;
 
-        r = sd_bus_send(q->manager->bus, reply, NULL);
+        r = sd_bus_send(NULL, reply, NULL);
 
 finish:
         if (r < 0) {
@@ -599,7 +610,7 @@ static void bus_method_resolve_record_complete(DnsQuery *q) {
         if (r < 0)
                 goto finish;
 
-        r = sd_bus_send(q->manager->bus, reply, NULL);
+        r = sd_bus_send(NULL, reply, NULL);
 
 finish:
         if (r < 0) {
@@ -973,7 +984,7 @@ static void resolve_service_all_complete(DnsQuery *q) {
         if (r < 0)
                 goto finish;
 
-        r = sd_bus_send(q->manager->bus, reply, NULL);
+        r = sd_bus_send(NULL, reply, NULL);
 
 finish:
         if (r < 0) {
@@ -1283,6 +1294,93 @@ static int bus_property_get_dns_servers(
         return sd_bus_message_close_container(reply);
 }
 
+static int bus_latency_histogram_append(sd_bus_message *reply, const LatencyHistogram *h) {
+        int r;
+
+        assert(reply);
+        assert(h);
+
+        r = sd_bus_message_append_array(reply, 't', h->buckets, sizeof(h->buckets));
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_append(reply, "t", h->n_timeouts);
+}
+
+static int bus_dns_server_statistics_append(sd_bus_message *reply, DnsServer *s) {
+        int r;
+
+        assert(reply);
+        assert(s);
+
+        r = sd_bus_message_open_container(reply, 'r', "iiaytttatt");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append(reply, "ii", dns_server_ifindex(s), s->family);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append_array(reply, 'y', &s->address, FAMILY_ADDRESS_SIZE(s->family));
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_append(reply, "ttt", (uint64_t) s->rtt_usec, s->n_received, s->n_lost);
+        if (r < 0)
+                return r;
+
+        r = bus_latency_histogram_append(reply, &s->latency);
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int bus_property_get_dns_server_statistics(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+        DnsServer *s;
+        Iterator i;
+        Link *l;
+        int r;
+
+        assert(reply);
+        assert(m);
+
+        r = sd_bus_message_open_container(reply, 'a', "(iiaytttatt)");
+        if (r < 0)
+                return r;
+
+        LIST_FOREACH(servers, s, m->dns_servers) {
+                r = bus_dns_server_statistics_append(reply, s);
+                if (r < 0)
+                        return r;
+        }
+
+        LIST_FOREACH(servers, s, m->fallback_dns_servers) {
+                r = bus_dns_server_statistics_append(reply, s);
+                if (r < 0)
+                        return r;
+        }
+
+        HASHMAP_FOREACH(l, m->links, i) {
+                LIST_FOREACH(servers, s, l->dns_servers) {
+                        r = bus_dns_server_statistics_append(reply, s);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
 static int bus_property_get_fallback_dns_servers(
                 sd_bus *bus,
                 const char *path,
@@ -1413,6 +1511,160 @@ static int bus_property_get_cache_statistics(
         return sd_bus_message_append(reply, "(ttt)", size, hit, miss);
 }
 
+static int bus_property_get_cache_statistics_by_type(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        _cleanup_hashmap_free_free_ Hashmap *by_type = NULL;
+        DnsCacheTypeStatistics *st, *sum;
+        Manager *m = userdata;
+        Iterator i;
+        DnsScope *s;
+        void *type;
+        int r;
+
+        assert(reply);
+        assert(m);
+
+        /* Sum up the numbers of all scopes */
+        by_type = hashmap_new(NULL);
+        if (!by_type)
+                return -ENOMEM;
+
+        LIST_FOREACH(scopes, s, m->dns_scopes)
+                HASHMAP_FOREACH_KEY(st, type, s->cache.statistics_by_type, i) {
+                        sum = hashmap_get(by_type, type);
+                        if (!sum) {
+                                sum = new0(DnsCacheTypeStatistics, 1);
+                                if (!sum)
+                                        return -ENOMEM;
+
+                                r = hashmap_put(by_type, type, sum);
+                                if (r < 0) {
+                                        free(sum);
+                                        return r;
+                                }
+                        }
+
+                        sum->n_hit += st->n_hit;
+                        sum->n_miss += st->n_miss;
+                }
+
+        r = sd_bus_message_open_container(reply, 'a', "(stt)");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(sum, type, by_type, i) {
+                char buf[DECIMAL_STR_MAX(uint16_t)];
+                const char *t;
+
+                t = dns_type_to_string(PTR_TO_UINT(type));
+                if (!t) {
+                        xsprintf(buf, "%u", PTR_TO_UINT(type));
+                        t = buf;
+                }
+
+                r = sd_bus_message_append(reply, "(stt)", t, sum->n_hit, sum->n_miss);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int bus_property_get_latency_histogram_buckets(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        uint64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+        unsigned i;
+
+        assert(reply);
+
+        for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+                buckets[i] = latency_histogram_bucket_max(i);
+
+        return sd_bus_message_append_array(reply, 't', buckets, sizeof(buckets));
+}
+
+static int bus_property_get_scope_latency_statistics(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+        DnsScope *s;
+        int r;
+
+        assert(reply);
+        assert(m);
+
+        r = sd_bus_message_open_container(reply, 'a', "(siiatt)");
+        if (r < 0)
+                return r;
+
+        LIST_FOREACH(scopes, s, m->dns_scopes) {
+                r = sd_bus_message_open_container(reply, 'r', "siiatt");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "sii",
+                                          dns_protocol_to_string(s->protocol),
+                                          s->link ? s->link->ifindex : 0,
+                                          s->family);
+                if (r < 0)
+                        return r;
+
+                r = bus_latency_histogram_append(reply, &s->latency);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int bus_property_get_cache_memory_statistics(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        uint64_t size = 0, evicted = 0;
+        Manager *m = userdata;
+        DnsScope *s;
+
+        assert(reply);
+        assert(m);
+
+        LIST_FOREACH(scopes, s, m->dns_scopes) {
+                size += s->cache.size;
+                evicted += s->cache.n_evicted;
+        }
+
+        return sd_bus_message_append(reply, "(tt)", size, evicted);
+}
+
 static int bus_property_get_dnssec_statistics(
                 sd_bus *bus,
                 const char *path,
@@ -1471,16 +1723,30 @@ static BUS_DEFINE_PROPERTY_GET2(bus_property_get_dns_over_tls_mode, "s", Manager
 
 static int bus_method_reset_statistics(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         Manager *m = userdata;
+        DnsServer *server;
         DnsScope *s;
+        Iterator i;
+        Link *l;
 
         assert(message);
         assert(m);
 
-        LIST_FOREACH(scopes, s, m->dns_scopes)
-                s->cache.n_hit = s->cache.n_miss = 0;
+        LIST_FOREACH(scopes, s, m->dns_scopes) {
+                dns_cache_reset_statistics(&s->cache);
+                zero(s->latency);
+        }
+
+        LIST_FOREACH(servers, server, m->dns_servers)
+                dns_server_reset_statistics(server);
+        LIST_FOREACH(servers, server, m->fallback_dns_servers)
+                dns_server_reset_statistics(server);
+        HASHMAP_FOREACH(l, m->links, i)
+                LIST_FOREACH(servers, server, l->dns_servers)
+                        dns_server_reset_statistics(server);
 
         m->n_transactions_total = 0;
         zero(m->n_dnssec_verdict);
+        manager_reset_slow_queries(m);
 
         return sd_bus_reply_method_return(message, NULL);
 }
@@ -1605,6 +1871,56 @@ static int bus_method_reset_server_features(sd_bus_message *message, void *userd
         return sd_bus_reply_method_return(message, NULL);
 }
 
+static int bus_method_get_slow_queries(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        Manager *m = userdata;
+        unsigned i, n;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ssisstt)");
+        if (r < 0)
+                return r;
+
+        /* Oldest first */
+        n = MIN(m->n_slow_queries, SLOW_QUERIES_MAX);
+        for (i = m->n_slow_queries - n; i < m->n_slow_queries; i++) {
+                SlowQuery *q = m->slow_queries + (i % SLOW_QUERIES_MAX);
+
+                r = sd_bus_message_append(reply, "(ssisstt)",
+                                          q->key,
+                                          dns_protocol_to_string(q->protocol),
+                                          q->ifindex,
+                                          strempty(q->server),
+                                          q->result,
+                                          (uint64_t) q->duration,
+                                          (uint64_t) q->timestamp);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int bus_method_list_event_sources(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        Manager *m = userdata;
+
+        assert(message);
+        assert(m);
+
+        return bus_reply_event_source_stats(message, m->event);
+}
+
 static int on_bus_track(sd_bus_track *t, void *userdata) {
         DnssdService *s = userdata;
 
@@ -1831,6 +2147,15 @@ static int bus_method_unregister_service(sd_bus_message *message, void *userdata
         return call_dnssd_method(m, message, bus_dnssd_method_unregister, error);
 }
 
+/* The subset offered on direct connections from nss-resolve. Everybody may connect there, hence only
+ * unprivileged lookups are available. */
+static const sd_bus_vtable resolve_private_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_METHOD("ResolveHostname", "isit", "a(iiay)st", bus_method_resolve_hostname, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ResolveAddress", "iiayt", "a(is)t", bus_method_resolve_address, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_VTABLE_END,
+};
+
 static const sd_bus_vtable resolve_vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_PROPERTY("LLMNRHostname", "s", NULL, offsetof(Manager, llmnr_hostname), 0),
@@ -1839,10 +2164,15 @@ static const sd_bus_vtable resolve_vtable[] = {
         SD_BUS_PROPERTY("DNSOverTLS", "s", bus_property_get_dns_over_tls_mode, 0, 0),
         SD_BUS_PROPERTY("DNS", "a(iiay)", bus_property_get_dns_servers, 0, 0),
         SD_BUS_PROPERTY("FallbackDNS", "a(iiay)", bus_property_get_fallback_dns_servers, offsetof(Manager, fallback_dns_servers), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("DNSServerStatistics", "a(iiaytttatt)", bus_property_get_dns_server_statistics, 0, 0),
         SD_BUS_PROPERTY("CurrentDNSServer", "(iiay)", bus_property_get_current_dns_server, offsetof(Manager, current_dns_server), 0),
         SD_BUS_PROPERTY("Domains", "a(isb)", bus_property_get_domains, 0, 0),
         SD_BUS_PROPERTY("TransactionStatistics", "(tt)", bus_property_get_transaction_statistics, 0, 0),
         SD_BUS_PROPERTY("CacheStatistics", "(ttt)", bus_property_get_cache_statistics, 0, 0),
+        SD_BUS_PROPERTY("CacheStatisticsByType", "a(stt)", bus_property_get_cache_statistics_by_type, 0, 0),
+        SD_BUS_PROPERTY("CacheMemoryStatistics", "(tt)", bus_property_get_cache_memory_statistics, 0, 0),
+        SD_BUS_PROPERTY("LatencyHistogramBuckets", "at", bus_property_get_latency_histogram_buckets, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("ScopeLatencyStatistics", "a(siiatt)", bus_property_get_scope_latency_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSEC", "s", bus_property_get_dnssec_mode, 0, 0),
         SD_BUS_PROPERTY("DNSSECStatistics", "(tttt)", bus_property_get_dnssec_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSECSupported", "b", bus_property_get_dnssec_supported, 0, 0),
@@ -1856,6 +2186,8 @@ static const sd_bus_vtable resolve_vtable[] = {
         SD_BUS_METHOD("ResetStatistics", NULL, NULL, bus_method_reset_statistics, 0),
         SD_BUS_METHOD("FlushCaches", NULL, NULL, bus_method_flush_caches, 0),
         SD_BUS_METHOD("ResetServerFeatures", NULL, NULL, bus_method_reset_server_features, 0),
+        SD_BUS_METHOD("ListEventSources", NULL, "a(ssttttt)", bus_method_list_event_sources, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("GetSlowQueries", NULL, "a(ssisstt)", bus_method_get_slow_queries, 0),
         SD_BUS_METHOD("GetLink", "i", "o", bus_method_get_link, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("SetLinkDNS", "ia(iay)", NULL, bus_method_set_link_dns_servers, 0),
         SD_BUS_METHOD("SetLinkDomains", "ia(sb)", NULL, bus_method_set_link_domains, 0),
@@ -1949,3 +2281,286 @@ int manager_connect_bus(Manager *m) {
 
         return 0;
 }
+
+static void manager_private_bus_drop(Manager *m, sd_bus *bus) {
+        OrderedSet *buses;
+        void *uid;
+
+        assert(m);
+        assert(bus);
+
+        uid = hashmap_remove(m->private_buses, bus);
+        if (!uid)
+                return;
+
+        buses = hashmap_get(m->private_buses_by_uid, uid);
+        (void) ordered_set_remove(buses, bus);
+        if (ordered_set_isempty(buses))
+                ordered_set_free(hashmap_remove(m->private_buses_by_uid, uid));
+
+        sd_bus_flush_close_unref(bus);
+
+        /* If we stopped accepting connections because we ran out of fds, try again now that one is free */
+        if (m->private_bus_event_source)
+                (void) sd_event_source_set_enabled(m->private_bus_event_source, SD_EVENT_ON);
+}
+
+static int manager_private_bus_add(Manager *m, sd_bus *bus, uid_t uid) {
+        _cleanup_(ordered_set_freep) OrderedSet *new_buses = NULL;
+        OrderedSet *buses;
+        int r;
+
+        assert(m);
+        assert(bus);
+
+        r = hashmap_ensure_allocated(&m->private_buses, NULL);
+        if (r < 0)
+                return r;
+
+        r = hashmap_ensure_allocated(&m->private_buses_by_uid, NULL);
+        if (r < 0)
+                return r;
+
+        buses = hashmap_get(m->private_buses_by_uid, UID_TO_PTR(uid));
+        if (!buses) {
+                new_buses = ordered_set_new(NULL);
+                if (!new_buses)
+                        return -ENOMEM;
+
+                r = hashmap_put(m->private_buses_by_uid, UID_TO_PTR(uid), new_buses);
+                if (r < 0)
+                        return r;
+
+                buses = TAKE_PTR(new_buses);
+        }
+
+        r = ordered_set_put(buses, bus);
+        if (r < 0)
+                goto fail;
+
+        r = hashmap_put(m->private_buses, bus, UID_TO_PTR(uid));
+        if (r < 0) {
+                (void) ordered_set_remove(buses, bus);
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        if (ordered_set_isempty(buses))
+                ordered_set_free(hashmap_remove(m->private_buses_by_uid, UID_TO_PTR(uid)));
+
+        return r;
+}
+
+static int on_private_bus_disconnected(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        Manager *m = userdata;
+        sd_bus *bus;
+
+        assert(message);
+        assert(m);
+        assert_se(bus = sd_bus_message_get_bus(message));
+
+        log_debug("Direct bus connection terminated.");
+
+        manager_private_bus_drop(m, bus);
+
+        return 0;
+}
+
+static int on_private_bus_retry(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        if (m->private_bus_event_source)
+                (void) sd_event_source_set_enabled(m->private_bus_event_source, SD_EVENT_ON);
+
+        return 0;
+}
+
+static int on_private_bus_connection(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
+        _cleanup_close_ int nfd = -1;
+        Manager *m = userdata;
+        OrderedSet *buses;
+        struct ucred ucred;
+        sd_id128_t id;
+        int r;
+
+        assert(s);
+        assert(m);
+
+        nfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+        if (nfd < 0) {
+                if (IN_SET(errno, EAGAIN, EINTR))
+                        return 0;
+
+                /* The listening socket stays readable as long as the connection isn't accepted, hence stop
+                 * watching it when we are out of fds, until one of our connections is closed, or a bit of
+                 * time passed, in case the fds are used up by something else. */
+                if (IN_SET(errno, EMFILE, ENFILE)) {
+                        log_warning_errno(errno, "Failed to accept direct bus connection, pausing: %m");
+                        (void) sd_event_source_set_enabled(s, SD_EVENT_OFF);
+                        (void) event_reset_time(m->event, &m->private_bus_retry_event_source,
+                                                clock_boottime_or_monotonic(), now(clock_boottime_or_monotonic()) + USEC_PER_SEC, 0,
+                                                on_private_bus_retry, m, 0, "bus-private-retry", true);
+                        return 0;
+                }
+
+                log_warning_errno(errno, "Failed to accept direct bus connection, ignoring: %m");
+                return 0;
+        }
+
+        r = getpeercred(nfd, &ucred);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to determine peer of direct bus connection, ignoring: %m");
+                return 0;
+        }
+
+        /* Clients keep their connection around for later lookups. If a user has too many of them, drop the
+         * user's oldest one, its client will simply reconnect when it needs to. Connections of other users are
+         * left alone. */
+        buses = hashmap_get(m->private_buses_by_uid, UID_TO_PTR(ucred.uid));
+        if (ordered_set_size(buses) >= PRIVATE_BUS_CONNECTIONS_PER_UID_MAX)
+                manager_private_bus_drop(m, ordered_set_steal_first(buses));
+        else if (hashmap_size(m->private_buses) >= PRIVATE_BUS_CONNECTIONS_MAX) {
+                /* Too many connections overall. Refuse the new one, the client falls back to the system bus. */
+                log_debug("Too many direct bus connections, refusing new one.");
+                return 0;
+        }
+
+        r = sd_bus_new(&bus);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to allocate direct bus connection: %m");
+                return 0;
+        }
+
+        (void) sd_bus_set_description(bus, "bus-private-resolve");
+
+        r = sd_bus_set_fd(bus, nfd, nfd);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to set fd on direct bus connection: %m");
+                return 0;
+        }
+
+        nfd = -1;
+
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        r = sd_bus_set_server(bus, 1, id);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to enable server support for direct bus connection: %m");
+                return 0;
+        }
+
+        r = sd_bus_set_sender(bus, "org.freedesktop.resolve1");
+        if (r < 0) {
+                log_warning_errno(r, "Failed to set sender of direct bus connection: %m");
+                return 0;
+        }
+
+        r = sd_bus_add_object_vtable(bus, NULL, "/org/freedesktop/resolve1", "org.freedesktop.resolve1.Manager", resolve_private_vtable, m);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to register object on direct bus connection: %m");
+                return 0;
+        }
+
+        r = sd_bus_match_signal_async(
+                        bus,
+                        NULL,
+                        "org.freedesktop.DBus.Local",
+                        "/org/freedesktop/DBus/Local",
+                        "org.freedesktop.DBus.Local",
+                        "Disconnected",
+                        on_private_bus_disconnected, NULL, m);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to request match for Disconnected message: %m");
+                return 0;
+        }
+
+        r = sd_bus_start(bus);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to start direct bus connection: %m");
+                return 0;
+        }
+
+        r = sd_bus_attach_event(bus, m->event, 0);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to attach direct bus connection to event loop: %m");
+                return 0;
+        }
+
+        r = manager_private_bus_add(m, bus, ucred.uid);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to add direct bus connection to set: %m");
+                return 0;
+        }
+
+        TAKE_PTR(bus);
+
+        log_debug("Accepted direct bus connection.");
+        return 0;
+}
+
+int manager_private_bus_start(Manager *m) {
+        union sockaddr_union sa = {};
+        _cleanup_close_ int fd = -1;
+        int r, salen;
+
+        assert(m);
+
+        if (m->private_bus_fd >= 0)
+                return 0;
+
+        salen = sockaddr_un_set_path(&sa.un, SD_RESOLVED_PRIVATE_BUS_PATH);
+        if (salen < 0)
+                return log_error_errno(salen, "Can't set path for AF_UNIX socket to bind to: %m");
+
+        (void) sockaddr_un_unlink(&sa.un);
+
+        fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
+        if (fd < 0)
+                return log_warning_errno(errno, "Failed to allocate direct bus socket, ignoring: %m");
+
+        if (bind(fd, &sa.sa, salen) < 0)
+                return log_warning_errno(errno, "Failed to bind direct bus socket, ignoring: %m");
+
+        /* Everybody may resolve host names */
+        if (chmod(SD_RESOLVED_PRIVATE_BUS_PATH, 0666) < 0)
+                return log_warning_errno(errno, "Failed to adjust access mode of direct bus socket, ignoring: %m");
+
+        if (listen(fd, SOMAXCONN) < 0)
+                return log_warning_errno(errno, "Failed to listen on direct bus socket, ignoring: %m");
+
+        r = sd_event_add_io(m->event, &m->private_bus_event_source, fd, EPOLLIN, on_private_bus_connection, m);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to watch direct bus socket, ignoring: %m");
+
+        (void) sd_event_source_set_description(m->private_bus_event_source, "bus-private-connection");
+
+        m->private_bus_fd = TAKE_FD(fd);
+
+        log_debug("Listening for direct bus connections on %s.", SD_RESOLVED_PRIVATE_BUS_PATH);
+        return 1;
+}
+
+void manager_private_bus_stop(Manager *m) {
+        sd_bus *bus;
+
+        assert(m);
+
+        while ((bus = hashmap_first_key(m->private_buses)))
+                manager_private_bus_drop(m, bus);
+
+        m->private_buses = hashmap_free(m->private_buses);
+        m->private_buses_by_uid = hashmap_free(m->private_buses_by_uid);
+
+        m->private_bus_event_source = sd_event_source_unref(m->private_bus_event_source);
+        m->private_bus_retry_event_source = sd_event_source_unref(m->private_bus_retry_event_source);
+
+        if (m->private_bus_fd >= 0) {
+                m->private_bus_fd = safe_close(m->private_bus_fd);
+                (void) unlink(SD_RESOLVED_PRIVATE_BUS_PATH);
+        }
+}
@@ -23,5 +23,9 @@
 
 #define SD_RESOLVED_QUERY_TIMEOUT_USEC (120 * USEC_PER_SEC)
 
+/* Direct D-Bus connections to systemd-resolved, bypassing the bus broker. Only offers the lookup methods used by
+ * nss-resolve. */
+#define SD_RESOLVED_PRIVATE_BUS_PATH "/run/systemd/resolve/private"
+
 /* 127.0.0.53 in native endian */
 #define INADDR_DNS_STUB ((in_addr_t) 0x7f000035U)
@@ -10,9 +10,9 @@
 #include "resolved-dns-packet.h"
 #include "string-util.h"
 
-/* Never cache more than 4K entries. RFC 1536, Section 5 suggests to
- * leave DNS caches unbounded, but that's crazy. */
-#define CACHE_MAX 4096
+/* What we assume an RR's data takes up if we don't know its wire format size. RFC 1536, Section 5 suggests
+ * to leave DNS caches unbounded, but that's crazy, hence we limit the (approximate) memory they use. */
+#define CACHE_RDATA_SIZE_GUESS 64
 
 /* We never keep any item longer than 2h in our cache */
 #define CACHE_TTL_MAX_USEC (2 * USEC_PER_HOUR)
@@ -21,6 +21,12 @@
  * now) */
 #define CACHE_TTL_STRANGE_RCODE_USEC (30 * USEC_PER_SEC)
 
+/* The TTL of stale records we serve, as recommended by RFC 8767, Section 4 */
+#define CACHE_STALE_TTL 30
+
+/* Do not ask for another refresh of an entry before this much time passed since the last one */
+#define CACHE_REFRESH_RETRY_USEC (30 * USEC_PER_SEC)
+
 typedef enum DnsCacheItemType DnsCacheItemType;
 typedef struct DnsCacheItem DnsCacheItem;
 
@@ -38,6 +44,11 @@ struct DnsCacheItem {
         int rcode;
 
         usec_t until;
+        usec_t prefetch_after; /* when a lookup should trigger a refresh of a hot entry */
+        usec_t refresh_usec;   /* when a refresh was requested the last time */
+        unsigned n_hit;
+        uint64_t frequency;    /* eviction rank, see DnsCache.frequency_base */
+        size_t size;
         bool authenticated:1;
         bool shared_owner:1;
 
@@ -46,6 +57,7 @@ struct DnsCacheItem {
         union in_addr_union owner_address;
 
         unsigned prioq_idx;
+        unsigned frequency_idx;
         LIST_FIELDS(DnsCacheItem, by_key);
 };
 
@@ -81,6 +93,32 @@ static void dns_cache_item_free(DnsCacheItem *i) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(DnsCacheItem*, dns_cache_item_free);
 
+static size_t dns_cache_item_size(DnsResourceKey *key, DnsResourceRecord *rr) {
+        size_t size;
+
+        assert(key);
+
+        /* Estimates the memory an entry takes up. Keys and RRs are reference counted and partly shared
+         * between entries, hence this is only approximate. */
+
+        size = sizeof(DnsCacheItem) + sizeof(DnsResourceKey) + strlen(dns_resource_key_name(key)) + 1;
+        if (rr)
+                size += sizeof(DnsResourceRecord) + (rr->wire_format ? rr->wire_format_size : CACHE_RDATA_SIZE_GUESS);
+
+        return size;
+}
+
+static void dns_cache_item_unqueue(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        prioq_remove(c->by_expiry, i, &i->prioq_idx);
+        prioq_remove(c->by_frequency, i, &i->frequency_idx);
+
+        assert(c->size >= i->size);
+        c->size -= i->size;
+}
+
 static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
         DnsCacheItem *first;
 
@@ -97,8 +135,7 @@ static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
         else
                 hashmap_remove(c->by_key, i->key);
 
-        prioq_remove(c->by_expiry, i, &i->prioq_idx);
-
+        dns_cache_item_unqueue(c, i);
         dns_cache_item_free(i);
 }
 
@@ -131,7 +168,7 @@ static bool dns_cache_remove_by_key(DnsCache *c, DnsResourceKey *key) {
                 return false;
 
         LIST_FOREACH_SAFE(by_key, i, n, first) {
-                prioq_remove(c->by_expiry, i, &i->prioq_idx);
+                dns_cache_item_unqueue(c, i);
                 dns_cache_item_free(i);
         }
 
@@ -148,39 +185,64 @@ void dns_cache_flush(DnsCache *c) {
 
         assert(hashmap_size(c->by_key) == 0);
         assert(prioq_size(c->by_expiry) == 0);
+        assert(prioq_size(c->by_frequency) == 0);
+        assert(c->size == 0);
 
         c->by_key = hashmap_free(c->by_key);
         c->by_expiry = prioq_free(c->by_expiry);
+        c->by_frequency = prioq_free(c->by_frequency);
+        c->frequency_base = 0;
 }
 
-static void dns_cache_make_space(DnsCache *c, unsigned add) {
+void dns_cache_reset_statistics(DnsCache *c) {
+        assert(c);
+
+        c->n_hit = c->n_miss = c->n_evicted = 0;
+        c->statistics_by_type = hashmap_free_free(c->statistics_by_type);
+}
+
+static void dns_cache_make_space(DnsCache *c, size_t add) {
         assert(c);
 
         if (add <= 0)
                 return;
 
-        /* Makes space for n new entries. Note that we actually allow
-         * the cache to grow beyond CACHE_MAX, but only when we shall
-         * add more RRs to the cache than CACHE_MAX at once. In that
-         * case the cache will be emptied completely otherwise. */
+        /* Makes space for new entries of the specified size. Entries past their TTL go first, then the
+         * least frequently used ones. Note that we actually allow the cache to grow beyond its limit, but
+         * only when we shall add more RRs to the cache than fit into it at once. In that case the cache will
+         * be emptied completely otherwise. */
+
+        if (c->size + add <= c->size_max)
+                return;
+
+        dns_cache_prune(c);
 
         for (;;) {
                 _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+                char key_str[DNS_RESOURCE_KEY_STRING_MAX];
+                unsigned n;
                 DnsCacheItem *i;
 
-                if (prioq_size(c->by_expiry) <= 0)
+                if (c->size + add <= c->size_max)
                         break;
 
-                if (prioq_size(c->by_expiry) + add < CACHE_MAX)
+                i = prioq_peek(c->by_frequency);
+                if (!i)
                         break;
 
-                i = prioq_peek(c->by_expiry);
-                assert(i);
+                log_debug("Evicting cache entry for %s (%u hits) to make space",
+                          dns_resource_key_to_string(i->key, key_str, sizeof key_str),
+                          i->n_hit);
+
+                c->frequency_base = MAX(c->frequency_base, i->frequency);
 
                 /* Take an extra reference to the key so that it
                  * doesn't go away in the middle of the remove call */
                 key = dns_resource_key_ref(i->key);
+
+                n = prioq_size(c->by_expiry);
                 dns_cache_remove_by_key(c, key);
+                c->n_evicted += n - prioq_size(c->by_expiry);
         }
 }
 
@@ -189,7 +251,7 @@ void dns_cache_prune(DnsCache *c) {
 
         assert(c);
 
-        /* Remove all entries that are past their TTL */
+        /* Remove all entries that are past their TTL, and past the time we may serve them stale */
 
         for (;;) {
                 DnsCacheItem *i;
@@ -202,7 +264,7 @@ void dns_cache_prune(DnsCache *c) {
                 if (t <= 0)
                         t = now(clock_boottime_or_monotonic());
 
-                if (i->until > t)
+                if (usec_add(i->until, c->stale_retention_usec) > t)
                         break;
 
                 /* Depending whether this is an mDNS shared entry
@@ -225,8 +287,13 @@ void dns_cache_prune(DnsCache *c) {
         }
 }
 
-static int dns_cache_item_prioq_compare_func(const void *a, const void *b) {
+static int dns_cache_item_frequency_compare_func(const void *a, const void *b) {
         const DnsCacheItem *x = a, *y = b;
+        int r;
+
+        r = CMP(x->frequency, y->frequency);
+        if (r != 0)
+                return r;
 
         return CMP(x->until, y->until);
 }
@@ -236,7 +303,12 @@ static int dns_cache_init(DnsCache *c) {
 
         assert(c);
 
-        r = prioq_ensure_allocated(&c->by_expiry, dns_cache_item_prioq_compare_func);
+        /* Ordered by the item's expiry time, passed as key */
+        r = prioq_ensure_allocated(&c->by_expiry, NULL);
+        if (r < 0)
+                return r;
+
+        r = prioq_ensure_allocated(&c->by_frequency, dns_cache_item_frequency_compare_func);
         if (r < 0)
                 return r;
 
@@ -254,10 +326,21 @@ static int dns_cache_link_item(DnsCache *c, DnsCacheItem *i) {
         assert(c);
         assert(i);
 
-        r = prioq_put(c->by_expiry, i, &i->prioq_idx);
+        i->frequency = c->frequency_base + i->n_hit + 1;
+
+        r = prioq_put_key(c->by_expiry, i, &i->prioq_idx, i->until);
         if (r < 0)
                 return r;
 
+        r = prioq_put(c->by_frequency, i, &i->frequency_idx);
+        if (r < 0) {
+                prioq_remove(c->by_expiry, i, &i->prioq_idx);
+                return r;
+        }
+
+        i->size = dns_cache_item_size(i->key, i->rr);
+        c->size += i->size;
+
         first = hashmap_get(c->by_key, i->key);
         if (first) {
                 _cleanup_(dns_resource_key_unrefp) DnsResourceKey *k = NULL;
@@ -278,7 +361,7 @@ static int dns_cache_link_item(DnsCache *c, DnsCacheItem *i) {
         } else {
                 r = hashmap_put(c->by_key, i->key, i);
                 if (r < 0) {
-                        prioq_remove(c->by_expiry, i, &i->prioq_idx);
+                        dns_cache_item_unqueue(c, i);
                         return r;
                 }
         }
@@ -335,6 +418,15 @@ static usec_t calculate_until(DnsResourceRecord *rr, uint32_t nsec_ttl, usec_t t
         return timestamp + u;
 }
 
+static usec_t calculate_prefetch_after(DnsCache *c, usec_t until, usec_t timestamp) {
+        assert(c);
+
+        if (c->prefetch_threshold <= 0 || until <= timestamp)
+                return USEC_INFINITY;
+
+        return timestamp + (until - timestamp) / 100 * c->prefetch_threshold;
+}
+
 static void dns_cache_item_update_positive(
                 DnsCache *c,
                 DnsCacheItem *i,
@@ -367,6 +459,8 @@ static void dns_cache_item_update_positive(
         i->key = dns_resource_key_ref(rr->key);
 
         i->until = calculate_until(rr, (uint32_t) -1, timestamp, false);
+        i->prefetch_after = calculate_prefetch_after(c, i->until, timestamp);
+        i->refresh_usec = 0;
         i->authenticated = authenticated;
         i->shared_owner = shared_owner;
 
@@ -375,7 +469,11 @@ static void dns_cache_item_update_positive(
         i->owner_family = owner_family;
         i->owner_address = *owner_address;
 
-        prioq_reshuffle(c->by_expiry, i, &i->prioq_idx);
+        c->size -= i->size;
+        i->size = dns_cache_item_size(i->key, i->rr);
+        c->size += i->size;
+
+        prioq_reshuffle_key(c->by_expiry, i, &i->prioq_idx, i->until);
 }
 
 static int dns_cache_put_positive(
@@ -383,6 +481,7 @@ static int dns_cache_put_positive(
                 DnsResourceRecord *rr,
                 bool authenticated,
                 bool shared_owner,
+                unsigned n_hit,
                 usec_t timestamp,
                 int ifindex,
                 int owner_family,
@@ -433,7 +532,7 @@ static int dns_cache_put_positive(
         if (r < 0)
                 return r;
 
-        dns_cache_make_space(c, 1);
+        dns_cache_make_space(c, dns_cache_item_size(rr->key, rr));
 
         i = new0(DnsCacheItem, 1);
         if (!i)
@@ -443,12 +542,15 @@ static int dns_cache_put_positive(
         i->key = dns_resource_key_ref(rr->key);
         i->rr = dns_resource_record_ref(rr);
         i->until = calculate_until(rr, (uint32_t) -1, timestamp, false);
+        i->prefetch_after = calculate_prefetch_after(c, i->until, timestamp);
+        i->n_hit = n_hit;
         i->authenticated = authenticated;
         i->shared_owner = shared_owner;
         i->ifindex = ifindex;
         i->owner_family = owner_family;
         i->owner_address = *owner_address;
         i->prioq_idx = PRIOQ_IDX_NULL;
+        i->frequency_idx = PRIOQ_IDX_NULL;
 
         r = dns_cache_link_item(c, i);
         if (r < 0)
@@ -479,6 +581,7 @@ static int dns_cache_put_negative(
                 int rcode,
                 bool authenticated,
                 uint32_t nsec_ttl,
+                unsigned n_hit,
                 usec_t timestamp,
                 DnsResourceRecord *soa,
                 int owner_family,
@@ -517,7 +620,7 @@ static int dns_cache_put_negative(
         if (r < 0)
                 return r;
 
-        dns_cache_make_space(c, 1);
+        dns_cache_make_space(c, dns_cache_item_size(key, NULL));
 
         i = new0(DnsCacheItem, 1);
         if (!i)
@@ -529,10 +632,15 @@ static int dns_cache_put_negative(
         i->until =
                 i->type == DNS_CACHE_RCODE ? timestamp + CACHE_TTL_STRANGE_RCODE_USEC :
                 calculate_until(soa, nsec_ttl, timestamp, true);
+        i->prefetch_after =
+                i->type == DNS_CACHE_RCODE ? USEC_INFINITY :
+                calculate_prefetch_after(c, i->until, timestamp);
+        i->n_hit = n_hit;
         i->authenticated = authenticated;
         i->owner_family = owner_family;
         i->owner_address = *owner_address;
         i->prioq_idx = PRIOQ_IDX_NULL;
+        i->frequency_idx = PRIOQ_IDX_NULL;
         i->rcode = rcode;
 
         if (i->type == DNS_CACHE_NXDOMAIN) {
@@ -631,12 +739,21 @@ int dns_cache_put(
         DnsResourceRecord *soa = NULL, *rr;
         bool weird_rcode = false;
         DnsAnswerFlags flags;
-        unsigned cache_keys;
+        DnsCacheItem *previous;
+        unsigned n_hit = 0;
+        size_t cache_size;
         int r, ifindex;
 
         assert(c);
         assert(owner_address);
 
+        /* Let entries keep their popularity when they are refreshed */
+        if (key) {
+                previous = hashmap_get(c->by_key, key);
+                if (previous)
+                        n_hit = previous->n_hit;
+        }
+
         dns_cache_remove_previous(c, key, answer);
 
         /* We only care for positive replies and NXDOMAINs, on all other replies we will simply flush the respective
@@ -664,12 +781,14 @@ int dns_cache_put(
                 weird_rcode = true;
         }
 
-        cache_keys = dns_answer_size(answer);
+        cache_size = 0;
+        DNS_ANSWER_FOREACH(rr, answer)
+                cache_size += dns_cache_item_size(rr->key, rr);
         if (key)
-                cache_keys++;
+                cache_size += dns_cache_item_size(key, NULL);
 
         /* Make some space for our new entries */
-        dns_cache_make_space(c, cache_keys);
+        dns_cache_make_space(c, cache_size);
 
         if (timestamp <= 0)
                 timestamp = now(clock_boottime_or_monotonic());
@@ -685,6 +804,7 @@ int dns_cache_put(
                                 rr,
                                 flags & DNS_ANSWER_AUTHENTICATED,
                                 flags & DNS_ANSWER_SHARED_OWNER,
+                                n_hit,
                                 timestamp,
                                 ifindex,
                                 owner_family, owner_address);
@@ -732,6 +852,7 @@ int dns_cache_put(
                         rcode,
                         authenticated,
                         nsec_ttl,
+                        n_hit,
                         timestamp,
                         soa,
                         owner_family, owner_address);
@@ -812,15 +933,48 @@ static DnsCacheItem *dns_cache_get_by_key_follow_cname_dname_nsec(DnsCache *c, D
         return NULL;
 }
 
-int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **ret, bool *authenticated) {
+static void dns_cache_count(DnsCache *c, const DnsResourceKey *key, bool hit) {
+        DnsCacheTypeStatistics *st;
+
+        assert(c);
+        assert(key);
+
+        if (hit)
+                c->n_hit++;
+        else
+                c->n_miss++;
+
+        /* The per-type numbers are for debugging only, hence don't fail the lookup if we can't allocate them */
+        st = hashmap_get(c->statistics_by_type, UINT_TO_PTR(key->type));
+        if (!st) {
+                if (hashmap_ensure_allocated(&c->statistics_by_type, NULL) < 0)
+                        return;
+
+                st = new0(DnsCacheTypeStatistics, 1);
+                if (!st)
+                        return;
+
+                if (hashmap_put(c->statistics_by_type, UINT_TO_PTR(key->type), st) < 0) {
+                        free(st);
+                        return;
+                }
+        }
+
+        if (hit)
+                st->n_hit++;
+        else
+                st->n_miss++;
+}
+
+int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **ret, bool *authenticated, bool *ret_refresh) {
         _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
         char key_str[DNS_RESOURCE_KEY_STRING_MAX];
         unsigned n = 0;
         int r;
-        bool nxdomain = false;
+        bool nxdomain = false, stale;
         DnsCacheItem *j, *first, *nsec = NULL;
         bool have_authenticated = false, have_non_authenticated = false;
-        usec_t current;
+        usec_t current, until = USEC_INFINITY, prefetch_after = USEC_INFINITY;
         int found_rcode = -1;
 
         assert(c);
@@ -829,6 +983,9 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
         assert(ret);
         assert(authenticated);
 
+        if (ret_refresh)
+                *ret_refresh = false;
+
         if (key->type == DNS_TYPE_ANY || key->class == DNS_CLASS_ANY) {
                 /* If we have ANY lookups we don't use the cache, so
                  * that the caller refreshes via the network. */
@@ -836,7 +993,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 log_debug("Ignoring cache for ANY lookup: %s",
                           dns_resource_key_to_string(key, key_str, sizeof key_str));
 
-                c->n_miss++;
+                dns_cache_count(c, key, false);
 
                 *ret = NULL;
                 *rcode = DNS_RCODE_SUCCESS;
@@ -852,7 +1009,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 log_debug("Cache miss for %s",
                           dns_resource_key_to_string(key, key_str, sizeof key_str));
 
-                c->n_miss++;
+                dns_cache_count(c, key, false);
 
                 *ret = NULL;
                 *rcode = DNS_RCODE_SUCCESS;
@@ -876,6 +1033,43 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                         have_authenticated = true;
                 else
                         have_non_authenticated = true;
+
+                until = MIN(until, j->until);
+                prefetch_after = MIN(prefetch_after, j->prefetch_after);
+        }
+
+        current = now(clock_boottime_or_monotonic());
+
+        /* Entries past their TTL are only still around if we may serve them stale, while they are refreshed.
+         * That's not worth it for errors though. */
+        stale = until <= current;
+        if (stale && found_rcode >= 0) {
+                log_debug("Ignoring stale RCODE %s cache entry for %s",
+                          dns_rcode_to_string(found_rcode),
+                          dns_resource_key_to_string(key, key_str, sizeof(key_str)));
+
+                dns_cache_count(c, key, false);
+
+                *ret = NULL;
+                *rcode = DNS_RCODE_SUCCESS;
+                *authenticated = false;
+
+                return 0;
+        }
+
+        /* Refresh stale entries, and entries that are looked up repeatedly once they got close to their expiry,
+         * so that popular names do not all expire at once. */
+        if (ret_refresh &&
+            (stale || (first->n_hit > 0 && current >= prefetch_after)) &&
+            (first->refresh_usec == 0 || current >= usec_add(first->refresh_usec, CACHE_REFRESH_RETRY_USEC))) {
+                first->refresh_usec = current;
+                *ret_refresh = true;
+        }
+
+        LIST_FOREACH(by_key, j, first) {
+                j->n_hit++;
+                j->frequency = c->frequency_base + j->n_hit + 1;
+                prioq_reshuffle(c->by_frequency, j, &j->frequency_idx);
         }
 
         if (found_rcode >= 0) {
@@ -887,7 +1081,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 *rcode = found_rcode;
                 *authenticated = false;
 
-                c->n_hit++;
+                dns_cache_count(c, key, true);
                 return 1;
         }
 
@@ -909,21 +1103,22 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 if (!bitmap_isset(nsec->rr->nsec.types, key->type) &&
                     !bitmap_isset(nsec->rr->nsec.types, DNS_TYPE_CNAME) &&
                     !bitmap_isset(nsec->rr->nsec.types, DNS_TYPE_DNAME)) {
-                        c->n_hit++;
+                        dns_cache_count(c, key, true);
                         return 1;
                 }
 
-                c->n_miss++;
+                dns_cache_count(c, key, false);
                 return 0;
         }
 
-        log_debug("%s cache hit for %s",
+        log_debug("%s%s cache hit for %s",
+                  stale ? "Stale " : "",
                   n > 0    ? "Positive" :
                   nxdomain ? "NXDOMAIN" : "NODATA",
                   dns_resource_key_to_string(key, key_str, sizeof key_str));
 
         if (n <= 0) {
-                c->n_hit++;
+                dns_cache_count(c, key, true);
 
                 *ret = NULL;
                 *rcode = nxdomain ? DNS_RCODE_NXDOMAIN : DNS_RCODE_SUCCESS;
@@ -935,19 +1130,16 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
         if (!answer)
                 return -ENOMEM;
 
-        if (clamp_ttl)
-                current = now(clock_boottime_or_monotonic());
-
         LIST_FOREACH(by_key, j, first) {
                 _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
 
                 if (!j->rr)
                         continue;
 
-                if (clamp_ttl) {
+                if (clamp_ttl || stale) {
                         rr = dns_resource_record_ref(j->rr);
 
-                        r = dns_resource_record_clamp_ttl(&rr, LESS_BY(j->until, current) / USEC_PER_SEC);
+                        r = dns_resource_record_clamp_ttl(&rr, stale ? CACHE_STALE_TTL : LESS_BY(j->until, current) / USEC_PER_SEC);
                         if (r < 0)
                                 return r;
                 }
@@ -957,7 +1149,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                         return r;
         }
 
-        c->n_hit++;
+        dns_cache_count(c, key, true);
 
         *ret = answer;
         *rcode = DNS_RCODE_SUCCESS;
@@ -1003,26 +1195,44 @@ int dns_cache_check_conflicts(DnsCache *cache, DnsResourceRecord *rr, int owner_
         return 1;
 }
 
-int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p) {
+int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p, Set *keys) {
         unsigned ancount = 0;
+        DnsResourceKey *key;
         Iterator iterator;
-        DnsCacheItem *i;
+        usec_t t;
         int r;
 
         assert(cache);
         assert(p);
 
-        HASHMAP_FOREACH(i, cache->by_key, iterator) {
-                DnsCacheItem *j;
+        /* Only list the records that actually answer one of the questions, and only those that won't expire
+         * soon, since responders will send those anyway. See RFC 6762, Section 7.1. */
 
+        t = now(clock_boottime_or_monotonic());
+
+        SET_FOREACH(key, keys, iterator) {
+                DnsCacheItem *i, *j;
+
+                i = hashmap_get(cache->by_key, key);
                 LIST_FOREACH(by_key, j, i) {
+                        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+
                         if (!j->rr)
                                 continue;
 
                         if (!j->shared_owner)
                                 continue;
 
-                        r = dns_packet_append_rr(p, j->rr, 0, NULL, NULL);
+                        if (j->until <= t || (j->until - t) * 2 < j->rr->ttl * USEC_PER_SEC)
+                                continue;
+
+                        /* Tell the responders how long we are going to keep the record */
+                        rr = dns_resource_record_ref(j->rr);
+                        r = dns_resource_record_clamp_ttl(&rr, (j->until - t) / USEC_PER_SEC);
+                        if (r < 0)
+                                return r;
+
+                        r = dns_packet_append_rr(p, rr, 0, NULL, NULL);
                         if (r == -EMSGSIZE && p->protocol == DNS_PROTOCOL_MDNS) {
                                 /* For mDNS, if we're unable to stuff all known answers into the given packet,
                                  * allocate a new one, push the RR into that one and link it to the current one.
@@ -1037,7 +1247,7 @@ int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p) {
 
                                 /* continue with new packet */
                                 p = p->more;
-                                r = dns_packet_append_rr(p, j->rr, 0, NULL, NULL);
+                                r = dns_packet_append_rr(p, rr, 0, NULL, NULL);
                         }
 
                         if (r < 0)
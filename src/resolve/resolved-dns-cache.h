@@ -4,13 +4,38 @@
 #include "hashmap.h"
 #include "list.h"
 #include "prioq.h"
+#include "set.h"
 #include "time-util.h"
 
+typedef struct DnsCacheTypeStatistics {
+        uint64_t n_hit;
+        uint64_t n_miss;
+} DnsCacheTypeStatistics;
+
 typedef struct DnsCache {
         Hashmap *by_key;
         Prioq *by_expiry;
+        Prioq *by_frequency;
         unsigned n_hit;
         unsigned n_miss;
+        unsigned n_evicted;
+
+        /* Hits and misses by RR type: DnsCacheTypeStatistics objects, keyed by the type */
+        Hashmap *statistics_by_type;
+
+        /* Approximate memory used by the cache entries, and the limit for it */
+        size_t size;
+        size_t size_max;
+
+        /* The frequency of the last evicted entry. Entries are ranked by their hits on top of it, so that
+         * entries that were popular long ago eventually make room for new ones (LFU with dynamic aging). */
+        uint64_t frequency_base;
+
+        /* Percentage of the TTL after which entries that are looked up repeatedly are refreshed ahead of
+         * their expiry, 0 to turn prefetching off */
+        unsigned prefetch_threshold;
+        /* How long expired entries are kept around, to be served while they are refreshed (RFC 8767) */
+        usec_t stale_retention_usec;
 } DnsCache;
 
 #include "resolved-dns-answer.h"
@@ -20,9 +45,10 @@ typedef struct DnsCache {
 
 void dns_cache_flush(DnsCache *c);
 void dns_cache_prune(DnsCache *c);
+void dns_cache_reset_statistics(DnsCache *c);
 
 int dns_cache_put(DnsCache *c, DnsResourceKey *key, int rcode, DnsAnswer *answer, bool authenticated, uint32_t nsec_ttl, usec_t timestamp, int owner_family, const union in_addr_union *owner_address);
-int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **answer, bool *authenticated);
+int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **answer, bool *authenticated, bool *ret_refresh);
 
 int dns_cache_check_conflicts(DnsCache *cache, DnsResourceRecord *rr, int owner_family, const union in_addr_union *owner_address);
 
@@ -31,4 +57,4 @@ bool dns_cache_is_empty(DnsCache *cache);
 
 unsigned dns_cache_size(DnsCache *cache);
 
-int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p);
+int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p, Set *keys);
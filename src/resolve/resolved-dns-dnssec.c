@@ -14,6 +14,8 @@
 #include "hexdecoct.h"
 #include "resolved-dns-dnssec.h"
 #include "resolved-dns-packet.h"
+#include "set.h"
+#include "siphash24.h"
 #include "string-table.h"
 
 #define VERIFY_RRS_MAX 256
@@ -25,6 +27,10 @@
 /* Maximum number of NSEC3 iterations we'll do. RFC5155 says 2500 shall be the maximum useful value */
 #define NSEC3_ITERATIONS_MAX 2500
 
+/* Maximum number of successful signature verifications we remember */
+#define VERIFIED_SIGNATURES_MAX 4096
+#define VERIFIED_DIGEST_SIZE 32
+
 /*
  * The DNSSEC Chain of trust:
  *
@@ -680,6 +686,78 @@ static void dnssec_fix_rrset_ttl(
         rrsig->expiry = rrsig->rrsig.expiration * USEC_PER_SEC;
 }
 
+/* Signatures that verified successfully, identified by a SHA-256 digest of the signed data, the signature and
+ * the key. The same RRsets are signed with the same keys over and over again, in particular DNSKEY and DS RRsets
+ * of popular zones, which are needed for every chain of trust. Checking a signature is expensive, looking it up
+ * here is not. Whether the signature is still within its validity period is checked on each use anyway, hence
+ * entries never become stale and are only dropped when we run out of room. */
+static Set *verified_signatures = NULL;
+
+static void verified_digest_hash_func(const uint8_t *p, struct siphash *state) {
+        siphash24_compress(p, VERIFIED_DIGEST_SIZE, state);
+}
+
+static int verified_digest_compare_func(const uint8_t *a, const uint8_t *b) {
+        return memcmp(a, b, VERIFIED_DIGEST_SIZE);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(verified_digest_hash_ops, uint8_t, verified_digest_hash_func, verified_digest_compare_func, free);
+
+static int dnssec_verified_digest(
+                const void *sig_data,
+                size_t sig_size,
+                DnsResourceRecord *rrsig,
+                DnsResourceRecord *dnskey,
+                uint8_t ret[static VERIFIED_DIGEST_SIZE]) {
+
+        _cleanup_(gcry_md_closep) gcry_md_hd_t md = NULL;
+        void *result;
+
+        assert(sig_data);
+        assert(rrsig);
+        assert(dnskey);
+
+        gcry_md_open(&md, GCRY_MD_SHA256, 0);
+        if (!md)
+                return -EIO;
+
+        gcry_md_write(md, sig_data, sig_size);
+        md_add_uint16(md, rrsig->rrsig.signature_size);
+        gcry_md_write(md, rrsig->rrsig.signature, rrsig->rrsig.signature_size);
+        md_add_uint16(md, dnskey->dnskey.flags);
+        md_add_uint8(md, dnskey->dnskey.protocol);
+        md_add_uint8(md, dnskey->dnskey.algorithm);
+        gcry_md_write(md, dnskey->dnskey.key, dnskey->dnskey.key_size);
+
+        result = gcry_md_read(md, 0);
+        if (!result)
+                return -EIO;
+
+        memcpy(ret, result, VERIFIED_DIGEST_SIZE);
+        return 0;
+}
+
+static void dnssec_verified_add(const uint8_t digest[static VERIFIED_DIGEST_SIZE]) {
+        _cleanup_free_ uint8_t *copy = NULL;
+
+        if (set_size(verified_signatures) >= VERIFIED_SIGNATURES_MAX)
+                free(set_steal_first(verified_signatures));
+
+        if (set_ensure_allocated(&verified_signatures, &verified_digest_hash_ops) < 0)
+                return;
+
+        copy = memdup(digest, VERIFIED_DIGEST_SIZE);
+        if (!copy)
+                return;
+
+        if (set_put(verified_signatures, copy) > 0)
+                TAKE_PTR(copy);
+}
+
+void dnssec_flush_verified(void) {
+        verified_signatures = set_free(verified_signatures);
+}
+
 int dnssec_verify_rrset(
                 DnsAnswer *a,
                 const DnsResourceKey *key,
@@ -688,7 +766,7 @@ int dnssec_verify_rrset(
                 usec_t realtime,
                 DnssecResult *result) {
 
-        uint8_t wire_format_name[DNS_WIRE_FORMAT_HOSTNAME_MAX];
+        uint8_t wire_format_name[DNS_WIRE_FORMAT_HOSTNAME_MAX], digest[VERIFIED_DIGEST_SIZE];
         DnsResourceRecord **list, *rr;
         const char *source, *name;
         _cleanup_(gcry_md_closep) gcry_md_hd_t md = NULL;
@@ -885,6 +963,15 @@ int dnssec_verify_rrset(
                         return -EIO;
         }
 
+        r = dnssec_verified_digest(sig_data, sig_size, rrsig, dnskey, digest);
+        if (r < 0)
+                return r;
+
+        if (set_contains(verified_signatures, digest)) {
+                r = 1;
+                goto finish;
+        }
+
         switch (rrsig->rrsig.algorithm) {
 
         case DNSSEC_ALGORITHM_RSASHA1:
@@ -919,7 +1006,10 @@ int dnssec_verify_rrset(
         }
         if (r < 0)
                 return r;
+        if (r > 0)
+                dnssec_verified_add(digest);
 
+finish:
         /* Now, fix the ttl, expiry, and remember the synthesizing source and the signer */
         if (r > 0)
                 dnssec_fix_rrset_ttl(list, n, rrsig, realtime);
@@ -2273,6 +2363,9 @@ int dnssec_test_positive_wildcard(
         return -EOPNOTSUPP;
 }
 
+void dnssec_flush_verified(void) {
+}
+
 #endif
 
 static const char* const dnssec_result_table[_DNSSEC_RESULT_MAX] = {
@@ -56,6 +56,8 @@ int dnssec_verify_dnskey_by_ds_search(DnsResourceRecord *dnskey, DnsAnswer *vali
 
 int dnssec_has_rrsig(DnsAnswer *a, const DnsResourceKey *key);
 
+void dnssec_flush_verified(void);
+
 uint16_t dnssec_keytag(DnsResourceRecord *dnskey, bool mask_revoke);
 
 int dnssec_canonicalize(const char *n, char *buffer, size_t buffer_max);
@@ -15,6 +15,10 @@
 
 #define EDNS0_OPT_DO (1<<15)
 
+/* Every byte of a name in wire format expands to at most four characters when escaped, including the length
+ * bytes which turn into dots */
+#define DNS_NAME_ESCAPED_MAX (DNS_WIRE_FORMAT_HOSTNAME_MAX*4+1)
+
 assert_cc(DNS_PACKET_SIZE_START > DNS_PACKET_HEADER_SIZE)
 
 typedef struct DnsPacketRewinder {
@@ -1380,10 +1384,11 @@ int dns_packet_read_name(
                 size_t *start) {
 
         _cleanup_(rewind_dns_packet) DnsPacketRewinder rewinder;
-        size_t after_rindex = 0, jump_barrier;
-        _cleanup_free_ char *ret = NULL;
-        size_t n = 0, allocated = 0;
+        size_t after_rindex = 0, jump_barrier, wire_size = 0;
+        char buf[DNS_NAME_ESCAPED_MAX];
+        size_t n = 0;
         bool first = true;
+        char *ret;
         int r;
 
         assert(p);
@@ -1412,15 +1417,18 @@ int dns_packet_read_name(
                         if (r < 0)
                                 return r;
 
-                        if (!GREEDY_REALLOC(ret, allocated, n + !first + DNS_LABEL_ESCAPED_MAX))
-                                return -ENOMEM;
+                        /* Refuse names longer than permitted, including the final root label. This also ensures
+                         * the escaped name fits into our buffer, so that we only need a single allocation. */
+                        wire_size += 1 + c;
+                        if (wire_size + 1 > DNS_WIRE_FORMAT_HOSTNAME_MAX)
+                                return -EBADMSG;
 
                         if (first)
                                 first = false;
                         else
-                                ret[n++] = '.';
+                                buf[n++] = '.';
 
-                        r = dns_label_escape(label, c, ret + n, DNS_LABEL_ESCAPED_MAX);
+                        r = dns_label_escape(label, c, buf + n, sizeof(buf) - n);
                         if (r < 0)
                                 return r;
 
@@ -1448,15 +1456,14 @@ int dns_packet_read_name(
                         return -EBADMSG;
         }
 
-        if (!GREEDY_REALLOC(ret, allocated, n + 1))
+        ret = memdup_suffix0(buf, n);
+        if (!ret)
                 return -ENOMEM;
 
-        ret[n] = 0;
-
         if (after_rindex != 0)
                 p->rindex= after_rindex;
 
-        *_ret = TAKE_PTR(ret);
+        *_ret = ret;
 
         if (start)
                 *start = rewinder.saved_rindex;
@@ -1050,6 +1050,10 @@ int dns_query_bus_track(DnsQuery *q, sd_bus_message *m) {
         assert(q);
         assert(m);
 
+        /* Direct connections have no unique names we could track, but the client is gone when the connection is */
+        if (!sd_bus_message_get_sender(m))
+                return 0;
+
         if (!q->bus_track) {
                 r = sd_bus_track_new(sd_bus_message_get_bus(m), &q->bus_track, on_bus_track, q);
                 if (r < 0)
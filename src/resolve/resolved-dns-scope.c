@@ -40,6 +40,7 @@ int dns_scope_new(Manager *m, DnsScope **ret, Link *l, DnsProtocol protocol, int
                 .protocol = protocol,
                 .family = family,
                 .resend_timeout = MULTICAST_RESEND_TIMEOUT_MIN_USEC,
+                .cache.size_max = m->cache_size_max,
         };
 
         if (protocol == DNS_PROTOCOL_DNS) {
@@ -57,6 +58,11 @@ int dns_scope_new(Manager *m, DnsScope **ret, Link *l, DnsProtocol protocol, int
                         s->dns_over_tls_mode = manager_get_dns_over_tls_mode(m);
                 }
 
+                /* Prefetching and serving stale entries only make sense for unicast DNS, the multicast
+                 * protocols get announcements for changed entries anyway. */
+                s->cache.prefetch_threshold = m->cache_prefetch;
+                s->cache.stale_retention_usec = m->stale_retention_usec;
+
         } else {
                 s->dnssec_mode = DNSSEC_NO;
                 s->dns_over_tls_mode = DNS_OVER_TLS_NO;
@@ -114,7 +120,10 @@ DnsScope* dns_scope_free(DnsScope *s) {
 
         sd_event_source_unref(s->announce_event_source);
 
+        mdns_scope_drop_announcements(s);
+
         dns_cache_flush(&s->cache);
+        dns_cache_reset_statistics(&s->cache);
         dns_zone_flush(&s->zone);
 
         LIST_REMOVE(scopes, s->manager->dns_scopes, s);
@@ -13,6 +13,7 @@ typedef struct DnsScope DnsScope;
 #include "resolved-dns-server.h"
 #include "resolved-dns-stream.h"
 #include "resolved-dns-zone.h"
+#include "resolved-latency.h"
 #include "resolved-link.h"
 
 typedef enum DnsScopeMatch {
@@ -50,6 +51,14 @@ struct DnsScope {
         usec_t resend_timeout;
         usec_t max_rtt;
 
+        /* Response times of all transactions on this scope, and how many attempts timed out */
+        LatencyHistogram latency;
+
+        /* mDNS announcements not answering any of our questions are collected by sender for a moment, and
+         * only then added to the cache, all at once */
+        Hashmap *mdns_announcements;
+        sd_event_source *mdns_announcements_event_source;
+
         LIST_HEAD(DnsQueryCandidate, query_candidates);
 
         /* Note that we keep track of ongoing transactions in two
@@ -17,6 +17,11 @@
 /* The number of times we will attempt a certain feature set before degrading */
 #define DNS_SERVER_FEATURE_RETRY_ATTEMPTS 3
 
+/* Switch to another server if its round-trip time is less than half of the current one's, and at least this much
+ * shorter */
+#define DNS_SERVER_RTT_SWITCH_FACTOR 2
+#define DNS_SERVER_RTT_SWITCH_MIN_USEC (10 * USEC_PER_MSEC)
+
 int dns_server_new(
                 Manager *m,
                 DnsServer **ret,
@@ -246,6 +251,8 @@ static void dns_server_reset_counters(DnsServer *s) {
 void dns_server_packet_received(DnsServer *s, int protocol, DnsServerFeatureLevel level, size_t size) {
         assert(s);
 
+        s->n_received++;
+
         if (protocol == IPPROTO_UDP) {
                 if (s->possible_feature_level == level)
                         s->n_failed_udp = 0;
@@ -288,6 +295,8 @@ void dns_server_packet_lost(DnsServer *s, int protocol, DnsServerFeatureLevel le
         assert(s);
         assert(s->manager);
 
+        s->n_lost++;
+
         if (s->possible_feature_level == level) {
                 if (protocol == IPPROTO_UDP)
                         s->n_failed_udp++;
@@ -300,6 +309,76 @@ void dns_server_packet_lost(DnsServer *s, int protocol, DnsServerFeatureLevel le
         }
 }
 
+static DnsServer *dns_server_find_faster(DnsServer *current) {
+        DnsServer *first, *i, *best = NULL;
+
+        assert(current);
+
+        if (current->rtt_usec == 0)
+                return NULL;
+
+        first = current->link ? current->link->dns_servers : manager_get_first_dns_server(current->manager, current->type);
+
+        /* Only consider servers that worked recently, and that are not less capable than the current one */
+        LIST_FOREACH(servers, i, first) {
+                if (i == current || i->rtt_usec == 0)
+                        continue;
+                if (i->n_failed_udp > 0 || i->possible_feature_level < current->possible_feature_level)
+                        continue;
+
+                if (!best || i->rtt_usec < best->rtt_usec)
+                        best = i;
+        }
+
+        /* Require a clear difference, so that we don't switch back and forth between similar servers */
+        if (!best ||
+            best->rtt_usec * DNS_SERVER_RTT_SWITCH_FACTOR > current->rtt_usec ||
+            best->rtt_usec + DNS_SERVER_RTT_SWITCH_MIN_USEC > current->rtt_usec)
+                return NULL;
+
+        return best;
+}
+
+void dns_server_packet_rtt(DnsServer *s, usec_t rtt) {
+        char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX];
+        DnsServer *current, *faster;
+
+        assert(s);
+
+        /* Smooth like TCP does it, see RFC 6298 */
+        s->rtt_usec = s->rtt_usec == 0 ? rtt : (7 * s->rtt_usec + rtt) / 8;
+
+        /* Switch over if the current server is considerably slower than another one we know. This deviates from
+         * the order the servers are configured in, hence only do so if asked to make use of all of them. */
+        if (!s->manager->race_dns_servers)
+                return;
+
+        current = s->link ? s->link->current_dns_server : s->manager->current_dns_server;
+        if (!current || current->type != s->type)
+                return;
+
+        faster = dns_server_find_faster(current);
+        if (!faster)
+                return;
+
+        log_debug("DNS server %s responds faster than %s (%s vs. %s).",
+                  dns_server_string(faster), dns_server_string(current),
+                  format_timespan(a, sizeof a, faster->rtt_usec, USEC_PER_MSEC),
+                  format_timespan(b, sizeof b, current->rtt_usec, USEC_PER_MSEC));
+
+        if (s->link)
+                link_set_dns_server(s->link, faster);
+        else
+                manager_set_dns_server(s->manager, faster);
+}
+
+void dns_server_reset_statistics(DnsServer *s) {
+        assert(s);
+
+        s->n_received = s->n_lost = 0;
+        zero(s->latency);
+}
+
 void dns_server_packet_truncated(DnsServer *s, DnsServerFeatureLevel level) {
         assert(s);
 
@@ -684,6 +763,7 @@ DnsServer *manager_set_dns_server(Manager *m, DnsServer *s) {
 
         if (m->unicast_scope)
                 dns_cache_flush(&m->unicast_scope->cache);
+        manager_dns_stub_flush_replies(m);
 
         return s;
 }
@@ -791,6 +871,7 @@ void dns_server_flush_cache(DnsServer *s) {
                 return;
 
         dns_cache_flush(&scope->cache);
+        manager_dns_stub_flush_replies(s->manager);
 }
 
 void dns_server_reset_features(DnsServer *s) {
@@ -35,6 +35,7 @@ typedef enum DnsServerFeatureLevel {
 const char* dns_server_feature_level_to_string(int i) _const_;
 int dns_server_feature_level_from_string(const char *s) _pure_;
 
+#include "resolved-latency.h"
 #include "resolved-link.h"
 #include "resolved-manager.h"
 #if ENABLE_DNS_OVER_TLS
@@ -71,6 +72,14 @@ struct DnsServer {
         unsigned n_failed_tcp;
         unsigned n_failed_tls;
 
+        /* Smoothed round-trip time of UDP queries, 0 if not known yet */
+        usec_t rtt_usec;
+
+        /* Statistics */
+        uint64_t n_received;
+        uint64_t n_lost;
+        LatencyHistogram latency;
+
         bool packet_truncated:1;
         bool packet_bad_opt:1;
         bool packet_rrsig_missing:1;
@@ -106,6 +115,8 @@ void dns_server_move_back_and_unmark(DnsServer *s);
 
 void dns_server_packet_received(DnsServer *s, int protocol, DnsServerFeatureLevel level, size_t size);
 void dns_server_packet_lost(DnsServer *s, int protocol, DnsServerFeatureLevel level);
+void dns_server_packet_rtt(DnsServer *s, usec_t rtt);
+void dns_server_reset_statistics(DnsServer *s);
 void dns_server_packet_truncated(DnsServer *s, DnsServerFeatureLevel level);
 void dns_server_packet_rrsig_missing(DnsServer *s, DnsServerFeatureLevel level);
 void dns_server_packet_bad_opt(DnsServer *s, DnsServerFeatureLevel level);
@@ -8,6 +8,9 @@
 #include "missing.h"
 #include "resolved-dns-stream.h"
 
+/* Streams are closed after this long without any traffic. Since the timeout is extended on each read and write,
+ * the long-lived streams towards servers are kept open as long as they are in use, and are shared by all
+ * transactions in the meantime, rather than being reconnected (and for TLS, renegotiated) regularly. */
 #define DNS_STREAM_TIMEOUT_USEC (10 * USEC_PER_SEC)
 #define DNS_STREAMS_MAX 128
 
@@ -48,6 +51,16 @@ static int dns_stream_update_io(DnsStream *s) {
         return sd_event_source_set_io_events(s->io_event_source, f);
 }
 
+static int dns_stream_extend_timeout(DnsStream *s) {
+        assert(s);
+
+        if (!s->timeout_event_source)
+                return 0;
+
+        return sd_event_source_set_time(s->timeout_event_source,
+                                        usec_add(now(clock_boottime_or_monotonic()), DNS_STREAM_TIMEOUT_USEC));
+}
+
 static int dns_stream_complete(DnsStream *s, int error) {
         _cleanup_(dns_stream_unrefp) _unused_ DnsStream *ref = dns_stream_ref(s); /* Protect stream while we process it */
 
@@ -324,8 +337,10 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                 if (ss < 0) {
                         if (!IN_SET(-ss, EINTR, EAGAIN))
                                 return dns_stream_complete(s, -ss);
-                } else
+                } else {
                         s->n_written += ss;
+                        (void) dns_stream_extend_timeout(s);
+                }
 
                 /* Are we done? If so, disable the event source for EPOLLOUT */
                 if (s->n_written >= sizeof(s->write_size) + s->write_packet->size) {
@@ -348,8 +363,10 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                                         return dns_stream_complete(s, -ss);
                         } else if (ss == 0)
                                 return dns_stream_complete(s, ECONNRESET);
-                        else
+                        else {
                                 s->n_read += ss;
+                                (void) dns_stream_extend_timeout(s);
+                        }
                 }
 
                 if (s->n_read >= sizeof(s->read_size)) {
@@ -398,8 +415,10 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                                                 return dns_stream_complete(s, -ss);
                                 } else if (ss == 0)
                                         return dns_stream_complete(s, ECONNRESET);
-                                else
+                                else {
                                         s->n_read += ss;
+                                        (void) dns_stream_extend_timeout(s);
+                                }
                         }
 
                         /* Are we done? If so, disable the event source for EPOLLIN */
@@ -535,6 +554,9 @@ int dns_stream_write_packet(DnsStream *s, DnsPacket *p) {
 
         dns_packet_ref(p);
 
+        /* A stream that was idle for a while gets the full timeout for the new packet */
+        (void) dns_stream_extend_timeout(s);
+
         return dns_stream_update_io(s);
 }
 
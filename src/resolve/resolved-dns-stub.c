@@ -1,17 +1,280 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include "alloc-util.h"
 #include "fd-util.h"
+#include "io-util.h"
 #include "missing_network.h"
 #include "resolved-dns-stub.h"
+#include "siphash24.h"
 #include "socket-util.h"
+#include "unaligned.h"
 
 /* The MTU of the loopback device is 64K on Linux, advertise that as maximum datagram size, but subtract the Ethernet,
  * IP and UDP header sizes */
 #define ADVERTISE_DATAGRAM_SIZE_MAX (65536U-14U-20U-8U)
 
+/* Replies to UDP queries are kept in wire format, and reused for queries that are byte-for-byte identical apart from
+ * the ID. Local clients tend to look up the same few names over and over, and this way they are answered without
+ * going through the query and cache logic, and without serializing the records again: only the ID and the TTLs are
+ * patched. Replies are kept until their first record expires, but not longer than the maximum, so that changes in
+ * the configuration propagate quickly. Replies without records are kept for the minimum time only. */
+#define STUB_REPLY_CACHE_MIN_USEC (1 * USEC_PER_SEC)
+#define STUB_REPLY_CACHE_MAX_USEC (5 * USEC_PER_SEC)
+#define STUB_REPLY_CACHE_MAX 4096U
+#define STUB_REPLY_SIZE_MAX 4096U
+
+/* How many UDP queries to process per wakeup at most, so that TCP clients and everything else get their turn too */
+#define STUB_UDP_BURST_MAX 64U
+
+typedef struct DnsStubReplyTTL {
+        size_t offset;
+        uint32_t ttl;
+} DnsStubReplyTTL;
+
+typedef struct DnsStubReply {
+        struct iovec request; /* The request packet without its ID */
+        DnsPacket *reply;
+        usec_t timestamp;
+        usec_t until;
+
+        /* The TTL fields in the reply, and their original values */
+        DnsStubReplyTTL *ttls;
+        size_t n_ttls;
+} DnsStubReply;
+
 static int manager_dns_stub_udp_fd(Manager *m);
 static int manager_dns_stub_tcp_fd(Manager *m);
 
+static void iovec_hash_func(const struct iovec *iov, struct siphash *state) {
+        siphash24_compress(iov->iov_base, iov->iov_len, state);
+}
+
+static int iovec_compare_func(const struct iovec *a, const struct iovec *b) {
+        int r;
+
+        r = CMP(a->iov_len, b->iov_len);
+        if (r != 0)
+                return r;
+
+        return memcmp(a->iov_base, b->iov_base, a->iov_len);
+}
+
+DEFINE_PRIVATE_HASH_OPS(dns_stub_reply_hash_ops, struct iovec, iovec_hash_func, iovec_compare_func);
+
+static DnsStubReply *dns_stub_reply_free(DnsStubReply *r) {
+        if (!r)
+                return NULL;
+
+        dns_packet_unref(r->reply);
+        free(r->request.iov_base);
+        free(r->ttls);
+        return mfree(r);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(DnsStubReply*, dns_stub_reply_free);
+
+void manager_dns_stub_flush_replies(Manager *m) {
+        DnsStubReply *r;
+
+        assert(m);
+
+        while ((r = hashmap_steal_first(m->dns_stub_replies)))
+                dns_stub_reply_free(r);
+
+        m->dns_stub_replies = hashmap_free(m->dns_stub_replies);
+}
+
+static int dns_stub_skip_name(DnsPacket *p, size_t *offset) {
+        const uint8_t *d;
+        size_t i;
+
+        assert(p);
+        assert(offset);
+
+        d = DNS_PACKET_DATA(p);
+
+        for (i = *offset;;) {
+                uint8_t c;
+
+                if (i >= p->size)
+                        return -EBADMSG;
+
+                c = d[i];
+                if (c == 0) {
+                        *offset = i + 1;
+                        return 0;
+                }
+
+                if ((c & 0xc0) == 0xc0) {
+                        /* Compression pointer, which terminates the name */
+                        if (i + 2 > p->size)
+                                return -EBADMSG;
+
+                        *offset = i + 2;
+                        return 0;
+                }
+
+                if ((c & 0xc0) != 0)
+                        return -EBADMSG;
+
+                i += 1 + c;
+        }
+}
+
+static int dns_stub_find_ttls(DnsPacket *p, DnsStubReplyTTL **ret, size_t *ret_n, uint32_t *ret_min_ttl) {
+        _cleanup_free_ DnsStubReplyTTL *ttls = NULL;
+        size_t offset = DNS_PACKET_HEADER_SIZE, n = 0;
+        uint32_t min_ttl = UINT32_MAX;
+        const uint8_t *d;
+        unsigned i, n_rrs;
+        int r;
+
+        assert(p);
+        assert(ret);
+        assert(ret_n);
+        assert(ret_min_ttl);
+
+        /* Finds the TTL fields of all RRs in a reply packet we generated, so that they can be adjusted when the
+         * reply is sent again later on. */
+
+        d = DNS_PACKET_DATA(p);
+
+        for (i = 0; i < DNS_PACKET_QDCOUNT(p); i++) {
+                r = dns_stub_skip_name(p, &offset);
+                if (r < 0)
+                        return r;
+
+                offset += 4; /* type and class */
+                if (offset > p->size)
+                        return -EBADMSG;
+        }
+
+        n_rrs = DNS_PACKET_RRCOUNT(p);
+        if (n_rrs > 0) {
+                ttls = new(DnsStubReplyTTL, n_rrs);
+                if (!ttls)
+                        return -ENOMEM;
+        }
+
+        for (i = 0; i < n_rrs; i++) {
+                uint16_t type, rdlength;
+                uint32_t ttl;
+
+                r = dns_stub_skip_name(p, &offset);
+                if (r < 0)
+                        return r;
+
+                if (offset + 10 > p->size)
+                        return -EBADMSG;
+
+                type = unaligned_read_be16(d + offset);
+                ttl = unaligned_read_be32(d + offset + 4);
+                rdlength = unaligned_read_be16(d + offset + 8);
+
+                /* The TTL field of the OPT pseudo-RR carries flags, leave it alone */
+                if (type != DNS_TYPE_OPT) {
+                        ttls[n++] = (DnsStubReplyTTL) {
+                                .offset = offset + 4,
+                                .ttl = ttl,
+                        };
+
+                        min_ttl = MIN(min_ttl, ttl);
+                }
+
+                offset += 10 + rdlength;
+                if (offset > p->size)
+                        return -EBADMSG;
+        }
+
+        *ret = TAKE_PTR(ttls);
+        *ret_n = n;
+        *ret_min_ttl = min_ttl;
+        return 0;
+}
+
+static void dns_stub_cache_reply(Manager *m, DnsPacket *p, DnsPacket *reply) {
+        _cleanup_(dns_stub_reply_freep) DnsStubReply *r = NULL;
+        uint32_t min_ttl;
+        int k;
+
+        assert(m);
+        assert(p);
+        assert(reply);
+
+        if (reply->size > STUB_REPLY_SIZE_MAX)
+                return;
+
+        /* Entries are short-lived anyway, hence just start over when we have too many */
+        if (hashmap_size(m->dns_stub_replies) >= STUB_REPLY_CACHE_MAX)
+                manager_dns_stub_flush_replies(m);
+
+        k = hashmap_ensure_allocated(&m->dns_stub_replies, &dns_stub_reply_hash_ops);
+        if (k < 0)
+                return;
+
+        r = new0(DnsStubReply, 1);
+        if (!r)
+                return;
+
+        k = dns_stub_find_ttls(reply, &r->ttls, &r->n_ttls, &min_ttl);
+        if (k < 0) {
+                log_debug_errno(k, "Failed to find TTLs in reply packet, not keeping it: %m");
+                return;
+        }
+
+        /* Records with a zero TTL shall not be cached, not even briefly */
+        if (min_ttl <= 0)
+                return;
+
+        r->request.iov_base = memdup((uint8_t*) DNS_PACKET_DATA(p) + sizeof(uint16_t), p->size - sizeof(uint16_t));
+        if (!r->request.iov_base)
+                return;
+        r->request.iov_len = p->size - sizeof(uint16_t);
+        r->reply = dns_packet_ref(reply);
+        r->timestamp = now(clock_boottime_or_monotonic());
+        r->until = usec_add(r->timestamp,
+                            r->n_ttls > 0 ? MIN(min_ttl * USEC_PER_SEC, STUB_REPLY_CACHE_MAX_USEC) : STUB_REPLY_CACHE_MIN_USEC);
+
+        k = hashmap_put(m->dns_stub_replies, &r->request, r);
+        if (k < 0)
+                return;
+
+        TAKE_PTR(r);
+}
+
+static DnsPacket *dns_stub_get_cached_reply(Manager *m, DnsPacket *p) {
+        DnsStubReply *r;
+        struct iovec key;
+        uint32_t elapsed;
+        usec_t n;
+        size_t i;
+
+        assert(m);
+        assert(p);
+
+        key = IOVEC_MAKE((uint8_t*) DNS_PACKET_DATA(p) + sizeof(uint16_t), p->size - sizeof(uint16_t));
+
+        r = hashmap_get(m->dns_stub_replies, &key);
+        if (!r)
+                return NULL;
+
+        n = now(clock_boottime_or_monotonic());
+        if (r->until <= n) {
+                hashmap_remove(m->dns_stub_replies, &r->request);
+                dns_stub_reply_free(r);
+                return NULL;
+        }
+
+        /* Count down the TTLs by the time that passed since the reply was generated */
+        elapsed = (uint32_t) ((n - r->timestamp) / USEC_PER_SEC);
+        for (i = 0; i < r->n_ttls; i++)
+                unaligned_write_be32((uint8_t*) DNS_PACKET_DATA(r->reply) + r->ttls[i].offset,
+                                     LESS_BY(r->ttls[i].ttl, elapsed));
+
+        DNS_PACKET_HEADER(r->reply)->id = DNS_PACKET_ID(p);
+        return r->reply;
+}
+
 static int dns_stub_make_reply_packet(
                 DnsPacket **p,
                 size_t max_size,
@@ -222,7 +485,9 @@ static void dns_stub_query_complete(DnsQuery *q) {
                         break;
                 }
 
-                (void) dns_stub_send(q->manager, q->request_dns_stream, q->request_dns_packet, q->reply_dns_packet);
+                r = dns_stub_send(q->manager, q->request_dns_stream, q->request_dns_packet, q->reply_dns_packet);
+                if (r >= 0 && !q->request_dns_stream && !truncated)
+                        dns_stub_cache_reply(q->manager, q->request_dns_packet, q->reply_dns_packet);
                 break;
         }
 
@@ -282,6 +547,7 @@ static int dns_stub_stream_complete(DnsStream *s, int error) {
 }
 
 static void dns_stub_process_query(Manager *m, DnsStream *s, DnsPacket *p) {
+        DnsPacket *reply;
         DnsQuery *q = NULL;
         int r;
 
@@ -298,6 +564,15 @@ static void dns_stub_process_query(Manager *m, DnsStream *s, DnsPacket *p) {
                 goto fail;
         }
 
+        if (!s) {
+                reply = dns_stub_get_cached_reply(m, p);
+                if (reply) {
+                        log_debug("Answering from recent reply.");
+                        (void) dns_stub_send(m, NULL, p, reply);
+                        return;
+                }
+        }
+
         r = dns_packet_extract(p);
         if (r < 0) {
                 log_debug_errno(r, "Failed to extract resources from incoming packet, ignoring packet: %m");
@@ -374,20 +649,28 @@ fail:
 }
 
 static int on_dns_stub_packet(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
-        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
         Manager *m = userdata;
+        unsigned n;
         int r;
 
-        r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
-        if (r <= 0)
-                return r;
+        /* Process queued queries in a row, rather than return to the event loop after each of them */
 
-        if (dns_packet_validate_query(p) > 0) {
-                log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+        for (n = 0; n < STUB_UDP_BURST_MAX; n++) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
 
-                dns_stub_process_query(m, NULL, p);
-        } else
-                log_debug("Invalid DNS stub UDP packet, ignoring.");
+                r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
+                if (n > 0 && r == -EAGAIN)
+                        break;
+                if (r <= 0)
+                        return r;
+
+                if (dns_packet_validate_query(p) > 0) {
+                        log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+
+                        dns_stub_process_query(m, NULL, p);
+                } else
+                        log_debug("Invalid DNS stub UDP packet, ignoring.");
+        }
 
         return 0;
 }
@@ -578,6 +861,8 @@ int manager_dns_stub_start(Manager *m) {
 void manager_dns_stub_stop(Manager *m) {
         assert(m);
 
+        manager_dns_stub_flush_replies(m);
+
         m->dns_stub_udp_event_source = sd_event_source_unref(m->dns_stub_udp_event_source);
         m->dns_stub_tcp_event_source = sd_event_source_unref(m->dns_stub_tcp_event_source);
 
@@ -22,6 +22,11 @@
 /* After how much time to repeat classic DNS requests */
 #define DNS_TIMEOUT_USEC (SD_RESOLVED_QUERY_TIMEOUT_USEC / DNS_TRANSACTION_ATTEMPTS_MAX)
 
+/* When to race a classic DNS request against another server, if enabled */
+#define DNS_TRANSACTION_RACE_DEFAULT_USEC (200U*USEC_PER_MSEC)
+#define DNS_TRANSACTION_RACE_MIN_USEC (20U*USEC_PER_MSEC)
+#define DNS_TRANSACTION_RACE_MAX_USEC (1U*USEC_PER_SEC)
+
 static void dns_transaction_reset_answer(DnsTransaction *t) {
         assert(t);
 
@@ -47,6 +52,15 @@ static void dns_transaction_flush_dnssec_transactions(DnsTransaction *t) {
         }
 }
 
+static void dns_transaction_stop_race(DnsTransaction *t) {
+        assert(t);
+
+        t->race_timeout_event_source = sd_event_source_unref(t->race_timeout_event_source);
+        t->race_udp_event_source = sd_event_source_unref(t->race_udp_event_source);
+        t->race_udp_fd = safe_close(t->race_udp_fd);
+        t->race_server = dns_server_unref(t->race_server);
+}
+
 static void dns_transaction_close_connection(DnsTransaction *t) {
         assert(t);
 
@@ -62,6 +76,8 @@ static void dns_transaction_close_connection(DnsTransaction *t) {
 
         t->dns_udp_event_source = sd_event_source_unref(t->dns_udp_event_source);
         t->dns_udp_fd = safe_close(t->dns_udp_fd);
+
+        dns_transaction_stop_race(t);
 }
 
 static void dns_transaction_stop_timeout(DnsTransaction *t) {
@@ -137,6 +153,10 @@ bool dns_transaction_gc(DnsTransaction *t) {
         if (t->block_gc > 0)
                 return true;
 
+        /* Background refreshes stay around until they are done */
+        if (t->prefetch && DNS_TRANSACTION_IS_LIVE(t->state))
+                return true;
+
         if (set_isempty(t->notify_query_candidates) &&
             set_isempty(t->notify_query_candidates_done) &&
             set_isempty(t->notify_zone_items) &&
@@ -200,6 +220,7 @@ int dns_transaction_new(DnsTransaction **ret, DnsScope *s, DnsResourceKey *key)
                 return -ENOMEM;
 
         t->dns_udp_fd = -1;
+        t->race_udp_fd = -1;
         t->answer_source = _DNS_TRANSACTION_SOURCE_INVALID;
         t->answer_dnssec_result = _DNSSEC_RESULT_INVALID;
         t->answer_nsec_ttl = (uint32_t) -1;
@@ -338,6 +359,16 @@ void dns_transaction_complete(DnsTransaction *t, DnsTransactionState state) {
                   t->answer_source < 0 ? "none" : dns_transaction_source_to_string(t->answer_source),
                   t->answer_authenticated ? "authenticated" : "unsigned");
 
+        if (t->first_attempt_usec > 0) {
+                usec_t ts;
+
+                assert_se(sd_event_now(t->scope->manager->event, clock_boottime_or_monotonic(), &ts) >= 0);
+                manager_slow_query(t->scope->manager, t->key, t->scope->protocol,
+                                   t->scope->link ? t->scope->link->ifindex : 0,
+                                   t->server ? dns_server_string(t->server) : NULL,
+                                   strna(st), ts - t->first_attempt_usec);
+        }
+
         t->state = state;
 
         dns_transaction_close_connection(t);
@@ -684,6 +715,10 @@ static void dns_transaction_cache_answer(DnsTransaction *t) {
         if (!DNS_PACKET_SHALL_CACHE(t->received))
                 return;
 
+        /* A failed refresh should not replace the entries we might still serve stale */
+        if (t->prefetch && !IN_SET(t->answer_rcode, DNS_RCODE_SUCCESS, DNS_RCODE_NXDOMAIN))
+                return;
+
         dns_cache_put(&t->scope->cache,
                       t->key,
                       t->answer_rcode,
@@ -974,6 +1009,10 @@ void dns_transaction_process_reply(DnsTransaction *t, DnsPacket *p) {
 
         assert_se(sd_event_now(t->scope->manager->event, clock_boottime_or_monotonic(), &ts) >= 0);
 
+        latency_histogram_add(&t->scope->latency, ts - t->start_usec);
+        if (t->server)
+                latency_histogram_add(&t->server->latency, ts - t->start_usec);
+
         switch (t->scope->protocol) {
 
         case DNS_PROTOCOL_DNS:
@@ -1101,6 +1140,8 @@ void dns_transaction_process_reply(DnsTransaction *t, DnsPacket *p) {
 
                 /* Report that we successfully received a packet */
                 dns_server_packet_received(t->server, p->ipproto, t->current_feature_level, p->size);
+                if (p->ipproto == IPPROTO_UDP)
+                        dns_server_packet_rtt(t->server, ts - t->start_usec);
         }
 
         /* See if we know things we didn't know before that indicate we better restart the lookup immediately. */
@@ -1172,6 +1213,34 @@ fail:
         dns_transaction_complete(t, DNS_TRANSACTION_ERRNO);
 }
 
+static void dns_transaction_adopt_race(DnsTransaction *t) {
+        usec_t usec;
+
+        assert(t);
+        assert(t->race_server);
+
+        /* The raced server answered first. The original server took at least this long, so tell it about that,
+         * and then continue with the raced server as if we had asked it in the first place. */
+        assert_se(sd_event_now(t->scope->manager->event, clock_boottime_or_monotonic(), &usec) >= 0);
+        dns_server_packet_rtt(t->server, usec - t->start_usec);
+
+        log_debug("Raced DNS server %s responded first on transaction %" PRIu16 ".", dns_server_string(t->race_server), t->id);
+
+        t->dns_udp_event_source = sd_event_source_unref(t->dns_udp_event_source);
+        safe_close(t->dns_udp_fd);
+
+        t->dns_udp_event_source = TAKE_PTR(t->race_udp_event_source);
+        t->dns_udp_fd = TAKE_FD(t->race_udp_fd);
+
+        dns_server_unref(t->server);
+        t->server = TAKE_PTR(t->race_server);
+
+        t->start_usec = t->race_usec;
+        t->n_picked_servers++;
+
+        dns_transaction_stop_race(t);
+}
+
 static int on_dns_packet(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
         DnsTransaction *t = userdata;
@@ -1181,6 +1250,12 @@ static int on_dns_packet(sd_event_source *s, int fd, uint32_t revents, void *use
         assert(t->scope);
 
         r = manager_recv(t->scope->manager, fd, DNS_PROTOCOL_DNS, &p);
+        if (r < 0 && fd == t->race_udp_fd) {
+                /* The raced query failed, let's just wait for the original one */
+                log_debug_errno(r, "Raced DNS query failed, ignoring: %m");
+                dns_transaction_stop_race(t);
+                return 0;
+        }
         if (ERRNO_IS_DISCONNECT(-r)) {
                 usec_t usec;
 
@@ -1215,10 +1290,116 @@ static int on_dns_packet(sd_event_source *s, int fd, uint32_t revents, void *use
                 return 0;
         }
 
+        if (fd == t->race_udp_fd)
+                dns_transaction_adopt_race(t);
+
         dns_transaction_process_reply(t, p);
         return 0;
 }
 
+static DnsServer *dns_transaction_race_pick_server(DnsTransaction *t) {
+        DnsServer *first, *i;
+
+        assert(t);
+        assert(t->server);
+
+        if (!t->server->linked)
+                return NULL;
+
+        first = t->server->link ? t->server->link->dns_servers : manager_get_first_dns_server(t->scope->manager, t->server->type);
+
+        /* Pick the next server in the list that is known to support the same features as the current one, so
+         * that the query we already prepared can be sent to it unchanged */
+        for (i = t->server->servers_next ?: first; i && i != t->server; i = i->servers_next ?: first)
+                if (i->possible_feature_level == t->current_feature_level)
+                        return i;
+
+        return NULL;
+}
+
+static int on_transaction_race_timeout(sd_event_source *s, usec_t usec, void *userdata) {
+        DnsTransaction *t = userdata;
+        DnsServer *server;
+        int fd, r;
+
+        assert(s);
+        assert(t);
+
+        t->race_timeout_event_source = sd_event_source_unref(t->race_timeout_event_source);
+
+        if (t->state != DNS_TRANSACTION_PENDING || t->stream || t->dns_udp_fd < 0)
+                return 0;
+
+        server = dns_transaction_race_pick_server(t);
+        if (!server)
+                return 0;
+
+        fd = dns_scope_socket_udp(t->scope, server, 53);
+        if (fd < 0) {
+                log_debug_errno(fd, "Failed to open socket for raced DNS query, ignoring: %m");
+                return 0;
+        }
+
+        r = sd_event_add_io(t->scope->manager->event, &t->race_udp_event_source, fd, EPOLLIN, on_dns_packet, t);
+        if (r < 0) {
+                safe_close(fd);
+                log_debug_errno(r, "Failed to listen for raced DNS reply, ignoring: %m");
+                return 0;
+        }
+
+        (void) sd_event_source_set_description(t->race_udp_event_source, "dns-transaction-race-udp");
+        t->race_udp_fd = fd;
+
+        r = dns_scope_emit_udp(t->scope, t->race_udp_fd, t->sent);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to send raced DNS query, ignoring: %m");
+                dns_transaction_stop_race(t);
+                return 0;
+        }
+
+        log_debug("Racing transaction %" PRIu16 " on DNS server %s.", t->id, dns_server_string(server));
+
+        t->race_server = dns_server_ref(server);
+        t->race_usec = usec;
+        return 0;
+}
+
+static int dns_transaction_arm_race(DnsTransaction *t, usec_t ts) {
+        usec_t delay;
+        int r;
+
+        assert(t);
+
+        /* If enabled, query a second server in parallel when the first one does not respond within roughly
+         * twice its usual round-trip time. Only done for the first attempt of UDP queries, retries follow
+         * the usual logic. */
+        if (t->scope->protocol != DNS_PROTOCOL_DNS ||
+            !t->scope->manager->race_dns_servers ||
+            t->n_attempts != 1 ||
+            !t->server ||
+            t->stream ||
+            t->dns_udp_fd < 0 ||
+            t->race_timeout_event_source ||
+            t->race_server)
+                return 0;
+
+        delay = t->server->rtt_usec > 0 ?
+                CLAMP(2 * t->server->rtt_usec, DNS_TRANSACTION_RACE_MIN_USEC, DNS_TRANSACTION_RACE_MAX_USEC) :
+                DNS_TRANSACTION_RACE_DEFAULT_USEC;
+
+        r = sd_event_add_time(
+                        t->scope->manager->event,
+                        &t->race_timeout_event_source,
+                        clock_boottime_or_monotonic(),
+                        ts + delay, 0,
+                        on_transaction_race_timeout, t);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(t->race_timeout_event_source, "dns-transaction-race-timeout");
+        return 1;
+}
+
 static int dns_transaction_emit_udp(DnsTransaction *t) {
         int r;
 
@@ -1278,10 +1459,13 @@ static int on_transaction_timeout(sd_event_source *s, usec_t usec, void *userdat
 
         if (!t->initial_jitter_scheduled || t->initial_jitter_elapsed) {
                 /* Timeout reached? Increase the timeout for the server used */
+                latency_histogram_add_timeout(&t->scope->latency);
+
                 switch (t->scope->protocol) {
 
                 case DNS_PROTOCOL_DNS:
                         assert(t->server);
+                        latency_histogram_add_timeout(&t->server->latency);
                         dns_server_packet_lost(t->server, t->stream ? IPPROTO_TCP : IPPROTO_UDP, t->current_feature_level);
                         break;
 
@@ -1335,6 +1519,35 @@ static usec_t transaction_get_resend_timeout(DnsTransaction *t) {
         }
 }
 
+static void dns_transaction_prefetch(DnsTransaction *t) {
+        DnsTransaction *p;
+        int r;
+
+        assert(t);
+
+        /* Starts a transaction that refreshes the cache entries we are about to answer from, in the
+         * background. */
+
+        r = dns_transaction_new(&p, t->scope, t->key);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to create transaction for refreshing cache entries, ignoring: %m");
+                return;
+        }
+
+        p->prefetch = true;
+
+        /* Further lookups of the key shall be answered from the cache too, rather than wait for the refresh */
+        assert_se(hashmap_replace(t->scope->transactions_by_key, t->key, t) >= 0);
+
+        log_debug("Refreshing cache entries in transaction %" PRIu16 ".", p->id);
+
+        r = dns_transaction_go(p);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to start transaction for refreshing cache entries, ignoring: %m");
+                dns_transaction_free(p);
+        }
+}
+
 static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
         int r;
 
@@ -1361,6 +1574,8 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
 
         t->n_attempts++;
         t->start_usec = ts;
+        if (t->first_attempt_usec == 0)
+                t->first_attempt_usec = ts;
 
         dns_transaction_reset_answer(t);
         dns_transaction_flush_dnssec_transactions(t);
@@ -1430,8 +1645,10 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
         }
 
         /* Check the cache, but only if this transaction is not used
-         * for probing or verifying a zone item. */
-        if (set_isempty(t->notify_zone_items)) {
+         * for probing or verifying a zone item, or for refreshing the
+         * cache itself. */
+        if (set_isempty(t->notify_zone_items) && !t->prefetch) {
+                bool refresh;
 
                 /* Before trying the cache, let's make sure we figured out a
                  * server to use. Should this cause a change of server this
@@ -1441,10 +1658,13 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
                 /* Let's then prune all outdated entries */
                 dns_cache_prune(&t->scope->cache);
 
-                r = dns_cache_lookup(&t->scope->cache, t->key, t->clamp_ttl, &t->answer_rcode, &t->answer, &t->answer_authenticated);
+                r = dns_cache_lookup(&t->scope->cache, t->key, t->clamp_ttl, &t->answer_rcode, &t->answer, &t->answer_authenticated, &refresh);
                 if (r < 0)
                         return r;
                 if (r > 0) {
+                        if (refresh)
+                                dns_transaction_prefetch(t);
+
                         t->answer_source = DNS_TRANSACTION_CACHE;
                         if (t->answer_rcode == DNS_RCODE_SUCCESS)
                                 dns_transaction_complete(t, DNS_TRANSACTION_SUCCESS);
@@ -1460,11 +1680,10 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
 static int dns_transaction_make_packet_mdns(DnsTransaction *t) {
 
         _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
-        bool add_known_answers = false;
         DnsTransaction *other;
         Iterator i;
         DnsResourceKey *tkey;
-        _cleanup_set_free_ Set *keys = NULL;
+        _cleanup_set_free_ Set *keys = NULL, *known_answer_keys = NULL;
         unsigned qdcount;
         unsigned nscount = 0;
         usec_t ts;
@@ -1486,8 +1705,15 @@ static int dns_transaction_make_packet_mdns(DnsTransaction *t) {
 
         qdcount = 1;
 
-        if (dns_key_is_shared(t->key))
-                add_known_answers = true;
+        if (dns_key_is_shared(t->key)) {
+                r = set_ensure_allocated(&known_answer_keys, &dns_resource_key_hash_ops);
+                if (r < 0)
+                        return r;
+
+                r = set_put(known_answer_keys, t->key);
+                if (r < 0)
+                        return r;
+        }
 
         if (t->key->type == DNS_TYPE_ANY) {
                 r = set_ensure_allocated(&keys, &dns_resource_key_hash_ops);
@@ -1556,8 +1782,15 @@ static int dns_transaction_make_packet_mdns(DnsTransaction *t) {
 
                 qdcount++;
 
-                if (dns_key_is_shared(other->key))
-                        add_known_answers = true;
+                if (dns_key_is_shared(other->key)) {
+                        r = set_ensure_allocated(&known_answer_keys, &dns_resource_key_hash_ops);
+                        if (r < 0)
+                                return r;
+
+                        r = set_put(known_answer_keys, other->key);
+                        if (r < 0)
+                                return r;
+                }
 
                 if (other->key->type == DNS_TYPE_ANY) {
                         r = set_ensure_allocated(&keys, &dns_resource_key_hash_ops);
@@ -1573,8 +1806,8 @@ static int dns_transaction_make_packet_mdns(DnsTransaction *t) {
         DNS_PACKET_HEADER(p)->qdcount = htobe16(qdcount);
 
         /* Append known answer section if we're asking for any shared record */
-        if (add_known_answers) {
-                r = dns_cache_export_shared_to_packet(&t->scope->cache, p);
+        if (!set_isempty(known_answer_keys)) {
+                r = dns_cache_export_shared_to_packet(&t->scope->cache, p, known_answer_keys);
                 if (r < 0)
                         return r;
         }
@@ -1747,6 +1980,10 @@ int dns_transaction_go(DnsTransaction *t) {
                 return dns_transaction_go(t);
         }
 
+        r = dns_transaction_arm_race(t, ts);
+        if (r < 0)
+                log_debug_errno(r, "Failed to schedule racing DNS query, ignoring: %m");
+
         ts += transaction_get_resend_timeout(t);
 
         r = sd_event_add_time(
@@ -62,6 +62,9 @@ struct DnsTransaction {
 
         bool probing:1;
 
+        /* Refreshes cache entries in the background, nobody waits for it */
+        bool prefetch:1;
+
         DnsPacket *sent, *received;
 
         DnsAnswer *answer;
@@ -85,6 +88,7 @@ struct DnsTransaction {
          * to authenticate this reply */
         DnsAnswer *validated_keys;
 
+        usec_t first_attempt_usec;
         usec_t start_usec;
         usec_t next_attempt_after;
         sd_event_source *timeout_event_source;
@@ -96,6 +100,13 @@ struct DnsTransaction {
         int dns_udp_fd;
         sd_event_source *dns_udp_event_source;
 
+        /* A second UDP query to another server, raced against the first one if it is slow to respond */
+        DnsServer *race_server;
+        int race_udp_fd;
+        sd_event_source *race_udp_event_source;
+        sd_event_source *race_timeout_event_source;
+        usec_t race_usec;
+
         /* TCP connection logic, if we need it */
         DnsStream *stream;
 
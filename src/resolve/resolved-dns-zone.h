@@ -39,6 +39,9 @@ struct DnsZoneItem {
 
         bool probing_enabled;
 
+        /* When we last multicast this RR in a response, for rate limiting (mDNS only) */
+        usec_t multicast_usec;
+
         LIST_FIELDS(DnsZoneItem, by_key);
         LIST_FIELDS(DnsZoneItem, by_name);
 
@@ -1,5 +1,8 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
 #include "fd-util.h"
 #include "fileio.h"
 #include "hostname-util.h"
@@ -12,6 +15,9 @@
 /* Recheck /etc/hosts at most once every 2s */
 #define ETC_HOSTS_RECHECK_USEC (2*USEC_PER_SEC)
 
+/* How many lines of /etc/hosts to parse per event loop iteration when reloading it */
+#define ETC_HOSTS_RELOAD_LINES 1000
+
 static void etc_hosts_item_free(EtcHostsItem *item) {
         strv_free(item->names);
         free(item);
@@ -160,6 +166,23 @@ static int parse_line(EtcHosts *hosts, unsigned nr, const char *line) {
         return 0;
 }
 
+static int parse_raw_line(EtcHosts *hosts, unsigned nr, char *line) {
+        char *l;
+
+        assert(hosts);
+        assert(line);
+
+        l = strchr(line, '#');
+        if (l)
+                *l = '\0';
+
+        l = strstrip(line);
+        if (isempty(l))
+                return 0;
+
+        return parse_line(hosts, nr, l);
+}
+
 int etc_hosts_parse(EtcHosts *hosts, FILE *f) {
         _cleanup_(etc_hosts_free) EtcHosts t = {};
         unsigned nr = 0;
@@ -167,7 +190,6 @@ int etc_hosts_parse(EtcHosts *hosts, FILE *f) {
 
         for (;;) {
                 _cleanup_free_ char *line = NULL;
-                char *l;
 
                 r = read_line(f, LONG_LINE_MAX, &line);
                 if (r < 0)
@@ -175,17 +197,7 @@ int etc_hosts_parse(EtcHosts *hosts, FILE *f) {
                 if (r == 0)
                         break;
 
-                nr++;
-
-                l = strchr(line, '#');
-                if (l)
-                        *l = '\0';
-
-                l = strstrip(line);
-                if (isempty(l))
-                        continue;
-
-                r = parse_line(&t, nr, l);
+                r = parse_raw_line(&t, ++nr, line);
                 if (r < 0)
                         return r;
         }
@@ -196,12 +208,157 @@ int etc_hosts_parse(EtcHosts *hosts, FILE *f) {
         return 0;
 }
 
+static void manager_etc_hosts_reload_stop(Manager *m) {
+        assert(m);
+
+        m->etc_hosts_reload_event_source = sd_event_source_unref(m->etc_hosts_reload_event_source);
+        m->etc_hosts_reload_file = safe_fclose(m->etc_hosts_reload_file);
+        etc_hosts_free(&m->etc_hosts_reload);
+        m->etc_hosts_reload_line = 0;
+}
+
+static int on_etc_hosts_reload(sd_event_source *s, void *userdata) {
+        Manager *m = userdata;
+        unsigned n;
+        int r;
+
+        assert(m);
+        assert(m->etc_hosts_reload_file);
+
+        for (n = 0; n < ETC_HOSTS_RELOAD_LINES; n++) {
+                _cleanup_free_ char *line = NULL;
+
+                r = read_line(m->etc_hosts_reload_file, LONG_LINE_MAX, &line);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to read /etc/hosts, keeping previous contents: %m");
+                        manager_etc_hosts_reload_stop(m);
+                        return 0;
+                }
+                if (r == 0) {
+                        /* Complete, replace what we have been using so far in one go */
+                        etc_hosts_free(&m->etc_hosts);
+                        m->etc_hosts = m->etc_hosts_reload;
+                        m->etc_hosts_reload = (EtcHosts) {};
+                        m->etc_hosts_mtime = m->etc_hosts_reload_mtime;
+
+                        log_debug("Reloaded /etc/hosts, %u lines.", m->etc_hosts_reload_line);
+                        manager_etc_hosts_reload_stop(m);
+                        return 0;
+                }
+
+                r = parse_raw_line(&m->etc_hosts_reload, ++m->etc_hosts_reload_line, line);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to parse /etc/hosts, keeping previous contents: %m");
+                        manager_etc_hosts_reload_stop(m);
+                        return 0;
+                }
+        }
+
+        /* More to do, continue on the next event loop iteration, after queries that came in meanwhile */
+        return 0;
+}
+
+static int manager_etc_hosts_reload_start(Manager *m) {
+        _cleanup_fclose_ FILE *f = NULL;
+        struct stat st;
+        int r;
+
+        assert(m);
+
+        manager_etc_hosts_reload_stop(m);
+
+        f = fopen("/etc/hosts", "re");
+        if (!f) {
+                if (errno != ENOENT)
+                        return log_error_errno(errno, "Failed to open /etc/hosts: %m");
+
+                manager_etc_hosts_flush(m);
+                return 0;
+        }
+
+        r = fstat(fileno(f), &st);
+        if (r < 0)
+                return log_error_errno(errno, "Failed to fstat() /etc/hosts: %m");
+
+        /* Parse the file piecemeal at idle priority, and keep answering lookups from the old contents until
+         * we are done, so that large files don't stall queries. */
+        r = sd_event_add_defer(m->event, &m->etc_hosts_reload_event_source, on_etc_hosts_reload, m);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add event source for reloading /etc/hosts: %m");
+
+        r = sd_event_source_set_priority(m->etc_hosts_reload_event_source, SD_EVENT_PRIORITY_IDLE);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set priority of /etc/hosts reload event source: %m");
+
+        r = sd_event_source_set_enabled(m->etc_hosts_reload_event_source, SD_EVENT_ON);
+        if (r < 0)
+                return log_error_errno(r, "Failed to enable /etc/hosts reload event source: %m");
+
+        (void) sd_event_source_set_description(m->etc_hosts_reload_event_source, "etc-hosts-reload");
+
+        m->etc_hosts_reload_file = TAKE_PTR(f);
+        m->etc_hosts_reload_mtime = timespec_load(&st.st_mtim);
+
+        return 1;
+}
+
+static int on_etc_hosts_changed(sd_event_source *s, const struct inotify_event *event, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+        assert(event);
+
+        if (!FLAGS_SET(event->mask, IN_Q_OVERFLOW) &&
+            (event->len == 0 || !streq(event->name, "hosts")))
+                return 0;
+
+        log_debug("/etc/hosts changed, reloading.");
+
+        (void) manager_etc_hosts_reload_start(m);
+        return 0;
+}
+
+static int manager_etc_hosts_watch(Manager *m) {
+        struct stat st;
+        int r;
+
+        assert(m);
+
+        /* Watch the directory rather than the file, since the latter is usually replaced rather than modified
+         * in place. If /etc/hosts is a symlink we would not notice changes of its target this way though, in
+         * that case keep checking the timestamp on lookups. */
+        if (lstat("/etc/hosts", &st) >= 0 && S_ISLNK(st.st_mode))
+                return 0;
+
+        r = sd_event_add_inotify(m->event, &m->etc_hosts_inotify_event_source, "/etc",
+                                 IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE|IN_ONLYDIR,
+                                 on_etc_hosts_changed, m);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to watch /etc for changes, checking /etc/hosts on lookups: %m");
+
+        (void) sd_event_source_set_description(m->etc_hosts_inotify_event_source, "etc-hosts-inotify");
+
+        return 1;
+}
+
+void manager_etc_hosts_stop(Manager *m) {
+        assert(m);
+
+        manager_etc_hosts_reload_stop(m);
+        m->etc_hosts_inotify_event_source = sd_event_source_unref(m->etc_hosts_inotify_event_source);
+        manager_etc_hosts_flush(m);
+}
+
 static int manager_etc_hosts_read(Manager *m) {
         _cleanup_fclose_ FILE *f = NULL;
         struct stat st;
         usec_t ts;
         int r;
 
+        /* If we are told about changes, there's no need to look at the file here once we read it */
+        if (m->etc_hosts_inotify_event_source && m->etc_hosts_mtime != USEC_INFINITY)
+                return 0;
+
         assert_se(sd_event_now(m->event, clock_boottime_or_monotonic(), &ts) >= 0);
 
         /* See if we checked /etc/hosts recently already */
@@ -210,6 +367,9 @@ static int manager_etc_hosts_read(Manager *m) {
 
         m->etc_hosts_last = ts;
 
+        if (!m->etc_hosts_inotify_event_source)
+                (void) manager_etc_hosts_watch(m);
+
         if (m->etc_hosts_mtime != USEC_INFINITY) {
                 if (stat("/etc/hosts", &st) < 0) {
                         if (errno != ENOENT)
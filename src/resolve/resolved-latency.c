@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "macro.h"
+#include "resolved-latency.h"
+
+usec_t latency_histogram_bucket_max(unsigned i) {
+        assert(i < LATENCY_HISTOGRAM_BUCKETS);
+
+        /* The last bucket has no upper bound */
+        if (i == LATENCY_HISTOGRAM_BUCKETS - 1)
+                return USEC_INFINITY;
+
+        return USEC_PER_MSEC << i;
+}
+
+void latency_histogram_add(LatencyHistogram *h, usec_t usec) {
+        unsigned i;
+
+        assert(h);
+
+        for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; i++)
+                if (usec <= latency_histogram_bucket_max(i))
+                        break;
+
+        h->buckets[i]++;
+}
+
+void latency_histogram_add_timeout(LatencyHistogram *h) {
+        assert(h);
+
+        h->n_timeouts++;
+}
+
+void latency_histogram_merge(LatencyHistogram *h, const LatencyHistogram *other) {
+        unsigned i;
+
+        assert(h);
+        assert(other);
+
+        for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+                h->buckets[i] += other->buckets[i];
+
+        h->n_timeouts += other->n_timeouts;
+}
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+
+#include "time-util.h"
+
+/* Response times are counted in power-of-two buckets: up to 1ms, up to 2ms, … up to 1024ms, and one final
+ * bucket for everything slower than that. */
+#define LATENCY_HISTOGRAM_BUCKETS 12
+
+typedef struct LatencyHistogram {
+        uint64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+        uint64_t n_timeouts;
+} LatencyHistogram;
+
+void latency_histogram_add(LatencyHistogram *h, usec_t usec);
+void latency_histogram_add_timeout(LatencyHistogram *h);
+void latency_histogram_merge(LatencyHistogram *h, const LatencyHistogram *other);
+
+usec_t latency_histogram_bucket_max(unsigned i);
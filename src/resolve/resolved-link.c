@@ -12,6 +12,7 @@
 #include "missing.h"
 #include "mkdir.h"
 #include "parse-util.h"
+#include "resolved-dns-stub.h"
 #include "resolved-link.h"
 #include "resolved-llmnr.h"
 #include "resolved-mdns.h"
@@ -123,6 +124,7 @@ void link_allocate_scopes(Link *l) {
                  * interface reveals different DNS zones than through others. */
                 if (l->manager->unicast_scope)
                         dns_cache_flush(&l->manager->unicast_scope->cache);
+                manager_dns_stub_flush_replies(l->manager);
         }
 
         /* And now, allocate all scopes that makes sense now if we didn't have them yet, and drop those which we don't
@@ -437,6 +439,7 @@ void link_set_dnssec_mode(Link *l, DnssecMode mode) {
                  * allow-downgrade mode to full DNSSEC mode, flush it too. */
                 if (l->unicast_scope)
                         dns_cache_flush(&l->unicast_scope->cache);
+                manager_dns_stub_flush_replies(l->manager);
         }
 
         l->dnssec_mode = mode;
@@ -735,6 +738,7 @@ DnsServer* link_set_dns_server(Link *l, DnsServer *s) {
 
         if (l->unicast_scope)
                 dns_cache_flush(&l->unicast_scope->cache);
+        manager_dns_stub_flush_replies(l->manager);
 
         return s;
 }
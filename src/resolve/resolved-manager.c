@@ -25,6 +25,7 @@
 #include "random-util.h"
 #include "resolved-bus.h"
 #include "resolved-conf.h"
+#include "resolved-dns-dnssec.h"
 #include "resolved-dns-stub.h"
 #include "resolved-dnssd.h"
 #include "resolved-etc-hosts.h"
@@ -574,12 +575,15 @@ int manager_new(Manager **ret) {
                 .dns_stub_udp_fd = -1,
                 .dns_stub_tcp_fd = -1,
                 .hostname_fd = -1,
+                .private_bus_fd = -1,
 
                 .llmnr_support = RESOLVE_SUPPORT_YES,
                 .mdns_support = RESOLVE_SUPPORT_YES,
                 .dnssec_mode = DEFAULT_DNSSEC_MODE,
                 .dns_over_tls_mode = DEFAULT_DNS_OVER_TLS_MODE,
                 .enable_cache = true,
+                .cache_size_max = DEFAULT_CACHE_SIZE,
+                .cache_prefetch = DEFAULT_CACHE_PREFETCH,
                 .dns_stub_listener_mode = DNS_STUB_LISTENER_YES,
                 .read_resolv_conf = true,
                 .need_builtin_fallbacks = true,
@@ -649,6 +653,8 @@ int manager_start(Manager *m) {
         if (r < 0)
                 return r;
 
+        (void) manager_private_bus_start(m);
+
         return 0;
 }
 
@@ -688,6 +694,7 @@ Manager *manager_free(Manager *m) {
         manager_llmnr_stop(m);
         manager_mdns_stop(m);
         manager_dns_stub_stop(m);
+        manager_private_bus_stop(m);
 
         sd_bus_unref(m->bus);
 
@@ -714,7 +721,9 @@ Manager *manager_free(Manager *m) {
         hashmap_free(m->dnssd_services);
 
         dns_trust_anchor_flush(&m->trust_anchor);
-        manager_etc_hosts_flush(m);
+        dnssec_flush_verified();
+        manager_etc_hosts_stop(m);
+        manager_reset_slow_queries(m);
 
         return mfree(m);
 }
@@ -1405,6 +1414,60 @@ void manager_dnssec_verdict(Manager *m, DnssecVerdict verdict, const DnsResource
         m->n_dnssec_verdict[verdict]++;
 }
 
+void manager_slow_query(Manager *m, const DnsResourceKey *key, DnsProtocol protocol, int ifindex, const char *server, const char *result, usec_t duration) {
+        char key_str[DNS_RESOURCE_KEY_STRING_MAX];
+        _cleanup_free_ char *k = NULL, *sv = NULL;
+        SlowQuery *q;
+
+        assert(m);
+        assert(key);
+        assert(result);
+
+        if (duration < SLOW_QUERY_THRESHOLD_USEC)
+                return;
+
+        k = strdup(dns_resource_key_to_string(key, key_str, sizeof key_str));
+        if (!k)
+                return;
+
+        if (server) {
+                sv = strdup(server);
+                if (!sv)
+                        return;
+        }
+
+        /* Overwrite the oldest entry once the buffer is full */
+        q = m->slow_queries + (m->n_slow_queries % SLOW_QUERIES_MAX);
+        free(q->key);
+        free(q->server);
+
+        *q = (SlowQuery) {
+                .key = TAKE_PTR(k),
+                .protocol = protocol,
+                .ifindex = ifindex,
+                .server = TAKE_PTR(sv),
+                .result = result,
+                .duration = duration,
+                .timestamp = now(CLOCK_REALTIME),
+        };
+
+        m->n_slow_queries++;
+}
+
+void manager_reset_slow_queries(Manager *m) {
+        unsigned i;
+
+        assert(m);
+
+        for (i = 0; i < SLOW_QUERIES_MAX; i++) {
+                free(m->slow_queries[i].key);
+                free(m->slow_queries[i].server);
+        }
+
+        zero(m->slow_queries);
+        m->n_slow_queries = 0;
+}
+
 bool manager_routable(Manager *m, int family) {
         Iterator i;
         Link *l;
@@ -1428,6 +1491,9 @@ void manager_flush_caches(Manager *m) {
         LIST_FOREACH(scopes, scope, m->dns_scopes)
                 dns_cache_flush(&scope->cache);
 
+        manager_dns_stub_flush_replies(m);
+        dnssec_flush_verified();
+
         log_info("Flushed all caches.");
 }
 
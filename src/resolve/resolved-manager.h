@@ -23,6 +23,26 @@ typedef struct Manager Manager;
 #define MANAGER_SEARCH_DOMAINS_MAX 256
 #define MANAGER_DNS_SERVERS_MAX 256
 
+/* Percentage of the TTL after which popular cache entries are refreshed */
+#define DEFAULT_CACHE_PREFETCH 90U
+
+/* Approximate memory each scope's cache may use */
+#define DEFAULT_CACHE_SIZE (4U * 1024U * 1024U)
+
+/* Transactions that took longer than this are remembered, the most recent ones only */
+#define SLOW_QUERY_THRESHOLD_USEC (500 * USEC_PER_MSEC)
+#define SLOW_QUERIES_MAX 32U
+
+typedef struct SlowQuery {
+        char *key;
+        DnsProtocol protocol;
+        int ifindex;
+        char *server;
+        const char *result;
+        usec_t duration;
+        usec_t timestamp;
+} SlowQuery;
+
 typedef struct EtcHosts {
         Hashmap *by_address;
         Hashmap *by_name;
@@ -37,6 +57,10 @@ struct Manager {
         DnssecMode dnssec_mode;
         DnsOverTlsMode dns_over_tls_mode;
         bool enable_cache;
+        size_t cache_size_max;
+        unsigned cache_prefetch;
+        usec_t stale_retention_usec;
+        bool race_dns_servers;
         DnsStubListenerMode dns_stub_listener_mode;
 
         /* Network */
@@ -99,6 +123,14 @@ struct Manager {
         /* dbus */
         sd_bus *bus;
 
+        /* Direct connections from nss-resolve, mapped to the UID of the peer, and the connections of each UID in
+         * the order they were accepted */
+        int private_bus_fd;
+        sd_event_source *private_bus_event_source;
+        sd_event_source *private_bus_retry_event_source;
+        Hashmap *private_buses;
+        Hashmap *private_buses_by_uid;
+
         /* The hostname we publish on LLMNR and mDNS */
         char *full_hostname;
         char *llmnr_hostname;
@@ -119,11 +151,24 @@ struct Manager {
         unsigned n_transactions_total;
         unsigned n_dnssec_verdict[_DNSSEC_VERDICT_MAX];
 
+        /* Ring buffer of the most recent slow transactions */
+        SlowQuery slow_queries[SLOW_QUERIES_MAX];
+        unsigned n_slow_queries;
+
         /* Data from /etc/hosts */
         EtcHosts etc_hosts;
         usec_t etc_hosts_last, etc_hosts_mtime;
         bool read_etc_hosts;
 
+        /* Changes to /etc/hosts are noticed via inotify, the new contents are then parsed a bit at a time into
+         * etc_hosts_reload, which replaces etc_hosts once complete */
+        sd_event_source *etc_hosts_inotify_event_source;
+        sd_event_source *etc_hosts_reload_event_source;
+        FILE *etc_hosts_reload_file;
+        EtcHosts etc_hosts_reload;
+        unsigned etc_hosts_reload_line;
+        usec_t etc_hosts_reload_mtime;
+
         /* Local DNS stub on 127.0.0.53:53 */
         int dns_stub_udp_fd;
         int dns_stub_tcp_fd;
@@ -131,6 +176,9 @@ struct Manager {
         sd_event_source *dns_stub_udp_event_source;
         sd_event_source *dns_stub_tcp_event_source;
 
+        /* Recent replies of the stub, by request */
+        Hashmap *dns_stub_replies;
+
         Hashmap *polkit_registry;
 };
 
@@ -174,6 +222,9 @@ DnsOverTlsMode manager_get_dns_over_tls_mode(Manager *m);
 
 void manager_dnssec_verdict(Manager *m, DnssecVerdict verdict, const DnsResourceKey *key);
 
+void manager_slow_query(Manager *m, const DnsResourceKey *key, DnsProtocol protocol, int ifindex, const char *server, const char *result, usec_t duration);
+void manager_reset_slow_queries(Manager *m);
+
 bool manager_routable(Manager *m, int family);
 
 void manager_flush_caches(Manager *m);
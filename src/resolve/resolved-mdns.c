@@ -172,13 +172,32 @@ static int mdns_do_tiebreak(DnsResourceKey *key, DnsAnswer *answer, DnsPacket *p
         return 0;
 }
 
+static bool mdns_known_answer(DnsPacket *p, DnsResourceRecord *rr) {
+        DnsResourceRecord *known;
+
+        assert(p);
+        assert(rr);
+
+        /* Checks whether the querier told us it already knows this RR, with at least half of its TTL left, in
+         * which case we shouldn't bother answering. See RFC 6762, Section 7.1. */
+
+        DNS_ANSWER_FOREACH(known, p->answer)
+                if (dns_resource_record_equal(known, rr) > 0 &&
+                    (uint64_t) known->ttl * 2 >= rr->ttl)
+                        return true;
+
+        return false;
+}
+
 static int mdns_scope_process_query(DnsScope *s, DnsPacket *p) {
         _cleanup_(dns_answer_unrefp) DnsAnswer *full_answer = NULL;
         _cleanup_(dns_packet_unrefp) DnsPacket *reply = NULL;
         DnsResourceKey *key = NULL;
         DnsResourceRecord *rr;
-        bool tentative = false;
-        int r;
+        DnsAnswerFlags flags;
+        bool tentative = false, probe;
+        usec_t ts, interval;
+        int ifindex, r;
 
         assert(s);
         assert(p);
@@ -189,6 +208,11 @@ static int mdns_scope_process_query(DnsScope *s, DnsPacket *p) {
 
         assert_return((dns_question_size(p->question) > 0), -EINVAL);
 
+        /* Queries with proposed records in the authority section are probes */
+        probe = DNS_PACKET_NSCOUNT(p) > 0;
+        interval = probe ? MDNS_PROBE_DEFENSE_INTERVAL_USEC : MDNS_MULTICAST_INTERVAL_USEC;
+        ts = now(clock_boottime_or_monotonic());
+
         DNS_QUESTION_FOREACH(key, p->question) {
                 _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL, *soa = NULL;
 
@@ -221,9 +245,21 @@ static int mdns_scope_process_query(DnsScope *s, DnsPacket *p) {
                         }
                 }
 
-                r = dns_answer_extend(&full_answer, answer);
-                if (r < 0)
-                        return log_debug_errno(r, "Failed to extend answer: %m");
+                DNS_ANSWER_FOREACH_FULL(rr, ifindex, flags, answer) {
+                        DnsZoneItem *i;
+
+                        if (!probe && mdns_known_answer(p, rr))
+                                continue;
+
+                        /* Don't flood the link with the same record over and over again */
+                        i = dns_zone_get(&s->zone, rr);
+                        if (i && i->multicast_usec > 0 && ts < usec_add(i->multicast_usec, interval))
+                                continue;
+
+                        r = dns_answer_add_extend(&full_answer, rr, ifindex, flags);
+                        if (r < 0)
+                                return log_debug_errno(r, "Failed to extend answer: %m");
+                }
         }
 
         if (dns_answer_isempty(full_answer))
@@ -240,6 +276,137 @@ static int mdns_scope_process_query(DnsScope *s, DnsPacket *p) {
         if (r < 0)
                 return log_debug_errno(r, "Failed to send reply packet: %m");
 
+        DNS_ANSWER_FOREACH(rr, full_answer) {
+                DnsZoneItem *i;
+
+                i = dns_zone_get(&s->zone, rr);
+                if (i)
+                        i->multicast_usec = ts;
+        }
+
+        return 0;
+}
+
+typedef struct MDnsAnnouncement {
+        struct in_addr_data sender;
+        DnsAnswer *answer;
+} MDnsAnnouncement;
+
+static MDnsAnnouncement *mdns_announcement_free(MDnsAnnouncement *a) {
+        if (!a)
+                return NULL;
+
+        dns_answer_unref(a->answer);
+        return mfree(a);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(MDnsAnnouncement*, mdns_announcement_free);
+
+void mdns_scope_drop_announcements(DnsScope *s) {
+        MDnsAnnouncement *a;
+
+        assert(s);
+
+        s->mdns_announcements_event_source = sd_event_source_unref(s->mdns_announcements_event_source);
+
+        while ((a = hashmap_steal_first(s->mdns_announcements)))
+                mdns_announcement_free(a);
+
+        s->mdns_announcements = hashmap_free(s->mdns_announcements);
+}
+
+void mdns_scope_flush_announcements(DnsScope *s) {
+        MDnsAnnouncement *a;
+
+        assert(s);
+
+        s->mdns_announcements_event_source = sd_event_source_unref(s->mdns_announcements_event_source);
+
+        while ((a = hashmap_steal_first(s->mdns_announcements))) {
+                dns_cache_put(&s->cache, NULL, DNS_RCODE_SUCCESS, a->answer, false, (uint32_t) -1, 0, a->sender.family, &a->sender.address);
+                mdns_announcement_free(a);
+        }
+}
+
+static int on_mdns_announcements_timeout(sd_event_source *es, usec_t usec, void *userdata) {
+        DnsScope *s = userdata;
+
+        assert(s);
+
+        mdns_scope_flush_announcements(s);
+        return 0;
+}
+
+static int mdns_scope_queue_announcement(DnsScope *s, DnsPacket *p) {
+        _cleanup_(mdns_announcement_freep) MDnsAnnouncement *n = NULL;
+        struct in_addr_data sender;
+        MDnsAnnouncement *a;
+        DnsResourceRecord *rr;
+        DnsAnswerFlags flags;
+        int r;
+
+        assert(s);
+        assert(p);
+
+        sender = (struct in_addr_data) {
+                .family = p->family,
+                .address = p->sender,
+        };
+
+        a = hashmap_get(s->mdns_announcements, &sender);
+        if (a) {
+                /* Let the records of this packet replace what we got from the same sender earlier, the same
+                 * way the cache would do it */
+                DNS_ANSWER_FOREACH_FLAGS(rr, flags, p->answer) {
+                        if (flags & DNS_ANSWER_SHARED_OWNER)
+                                r = dns_answer_remove_by_rr(&a->answer, rr);
+                        else
+                                r = dns_answer_remove_by_key(&a->answer, rr->key);
+                        if (r < 0)
+                                return r;
+                }
+
+                return dns_answer_extend(&a->answer, p->answer);
+        }
+
+        r = hashmap_ensure_allocated(&s->mdns_announcements, &in_addr_data_hash_ops);
+        if (r < 0)
+                return r;
+
+        n = new(MDnsAnnouncement, 1);
+        if (!n)
+                return -ENOMEM;
+
+        *n = (MDnsAnnouncement) {
+                .sender = sender,
+                .answer = dns_answer_ref(p->answer),
+        };
+
+        r = hashmap_put(s->mdns_announcements, &n->sender, n);
+        if (r < 0)
+                return r;
+        TAKE_PTR(n);
+
+        if (hashmap_size(s->mdns_announcements) >= MDNS_ANNOUNCEMENTS_MAX) {
+                mdns_scope_flush_announcements(s);
+                return 0;
+        }
+
+        if (s->mdns_announcements_event_source)
+                return 0;
+
+        r = sd_event_add_time(s->manager->event,
+                              &s->mdns_announcements_event_source,
+                              clock_boottime_or_monotonic(),
+                              now(clock_boottime_or_monotonic()) + MDNS_ANNOUNCEMENTS_BATCH_USEC, 0,
+                              on_mdns_announcements_timeout, s);
+        if (r < 0) {
+                mdns_scope_flush_announcements(s);
+                return r;
+        }
+
+        (void) sd_event_source_set_description(s->mdns_announcements_event_source, "mdns-announcements");
+
         return 0;
 }
 
@@ -264,6 +431,7 @@ static int on_mdns_packet(sd_event_source *s, int fd, uint32_t revents, void *us
 
         if (dns_packet_validate_reply(p) > 0) {
                 DnsResourceRecord *rr;
+                bool answered = false;
 
                 log_debug("Got mDNS reply packet");
 
@@ -301,24 +469,43 @@ static int on_mdns_packet(sd_event_source *s, int fd, uint32_t revents, void *us
                         }
 
                         t = dns_scope_find_transaction(scope, rr->key, false);
-                        if (t)
+                        if (t) {
                                 dns_transaction_process_reply(t, p);
+                                answered = true;
+                        }
 
                         /* Also look for the various types of ANY transactions */
                         t = dns_scope_find_transaction(scope, &DNS_RESOURCE_KEY_CONST(rr->key->class, DNS_TYPE_ANY, dns_resource_key_name(rr->key)), false);
-                        if (t)
+                        if (t) {
                                 dns_transaction_process_reply(t, p);
+                                answered = true;
+                        }
 
                         t = dns_scope_find_transaction(scope, &DNS_RESOURCE_KEY_CONST(DNS_CLASS_ANY, rr->key->type, dns_resource_key_name(rr->key)), false);
-                        if (t)
+                        if (t) {
                                 dns_transaction_process_reply(t, p);
+                                answered = true;
+                        }
 
                         t = dns_scope_find_transaction(scope, &DNS_RESOURCE_KEY_CONST(DNS_CLASS_ANY, DNS_TYPE_ANY, dns_resource_key_name(rr->key)), false);
-                        if (t)
+                        if (t) {
                                 dns_transaction_process_reply(t, p);
+                                answered = true;
+                        }
                 }
 
-                dns_cache_put(&scope->cache, NULL, DNS_PACKET_RCODE(p), p->answer, false, (uint32_t) -1, 0, p->family, &p->sender);
+                /* Unsolicited announcements are batched up before they go into the cache, as busy networks
+                 * generate a lot of them, often repeating the same records. Replies to our own questions go
+                 * into the cache right away though, together with everything collected so far, to keep the
+                 * order. */
+                if (DNS_PACKET_RCODE(p) == DNS_RCODE_SUCCESS &&
+                    mdns_scope_queue_announcement(scope, p) >= 0) {
+                        if (answered)
+                                mdns_scope_flush_announcements(scope);
+                } else {
+                        mdns_scope_flush_announcements(scope);
+                        dns_cache_put(&scope->cache, NULL, DNS_PACKET_RCODE(p), p->answer, false, (uint32_t) -1, 0, p->family, &p->sender);
+                }
 
         } else if (dns_packet_validate_query(p) > 0)  {
                 log_debug("Got mDNS query packet for id %u", DNS_PACKET_ID(p));
@@ -6,8 +6,21 @@
 #define MDNS_PORT 5353
 #define MDNS_ANNOUNCE_DELAY (1 * USEC_PER_SEC)
 
+/* RFC 6762 Section 6: the same record is multicast at most once per second, or four times per second when
+ * defending it against a probe */
+#define MDNS_MULTICAST_INTERVAL_USEC (1 * USEC_PER_SEC)
+#define MDNS_PROBE_DEFENSE_INTERVAL_USEC (250 * USEC_PER_MSEC)
+
+/* How long to collect incoming announcements before they are added to the cache, and for how many
+ * senders at most */
+#define MDNS_ANNOUNCEMENTS_BATCH_USEC (100 * USEC_PER_MSEC)
+#define MDNS_ANNOUNCEMENTS_MAX 1024U
+
 int manager_mdns_ipv4_fd(Manager *m);
 int manager_mdns_ipv6_fd(Manager *m);
 
 void manager_mdns_stop(Manager *m);
 int manager_mdns_start(Manager *m);
+
+void mdns_scope_flush_announcements(DnsScope *s);
+void mdns_scope_drop_announcements(DnsScope *s);
@@ -10,6 +10,7 @@
 #include "ordered-set.h"
 #include "resolved-conf.h"
 #include "resolved-dns-server.h"
+#include "resolved-dns-stub.h"
 #include "resolved-resolv-conf.h"
 #include "string-util.h"
 #include "strv.h"
@@ -202,6 +203,7 @@ int manager_read_resolv_conf(Manager *m) {
          * enough to flush the global unicast DNS cache. */
         if (m->unicast_scope)
                 dns_cache_flush(&m->unicast_scope->cache);
+        manager_dns_stub_flush_replies(m);
 
         /* If /etc/resolv.conf changed, make sure to forget everything we learned about the DNS servers. After all we
          * might now talk to a very different DNS server that just happens to have the same IP address as an old one
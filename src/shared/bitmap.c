@@ -10,6 +10,7 @@
 #include "bitmap.h"
 #include "hashmap.h"
 #include "macro.h"
+#include "util.h"
 
 struct Bitmap {
         uint64_t *bitmaps;
@@ -156,8 +157,61 @@ void bitmap_clear(Bitmap *b) {
         b->bitmaps_allocated = 0;
 }
 
+unsigned bitmap_count(Bitmap *b) {
+        unsigned n = 0;
+        size_t i;
+
+        if (!b)
+                return 0;
+
+        for (i = 0; i < b->n_bitmaps; i++)
+                n += __builtin_popcountll(b->bitmaps[i]);
+
+        return n;
+}
+
+int bitmap_union(Bitmap *a, Bitmap *b) {
+        size_t i;
+
+        assert(a);
+
+        /* Sets all bits in a that are set in b. The loops over the words below are kept simple, so that the
+         * compiler can vectorize them. */
+
+        if (!b)
+                return 0;
+
+        if (b->n_bitmaps > a->n_bitmaps) {
+                if (!GREEDY_REALLOC0(a->bitmaps, a->bitmaps_allocated, b->n_bitmaps))
+                        return -ENOMEM;
+
+                a->n_bitmaps = b->n_bitmaps;
+        }
+
+        for (i = 0; i < b->n_bitmaps; i++)
+                a->bitmaps[i] |= b->bitmaps[i];
+
+        return 0;
+}
+
+void bitmap_intersect(Bitmap *a, Bitmap *b) {
+        size_t n, i;
+
+        assert(a);
+
+        /* Clears all bits in a that are not set in b. Words beyond n_bitmaps are always kept zeroed, since
+         * bitmap_set() and bitmap_union() rely on that when growing the bitmap again. */
+
+        n = b ? MIN(a->n_bitmaps, b->n_bitmaps) : 0;
+
+        for (i = 0; i < n; i++)
+                a->bitmaps[i] &= b->bitmaps[i];
+
+        memzero(a->bitmaps + n, (a->n_bitmaps - n) * sizeof(uint64_t));
+        a->n_bitmaps = n;
+}
+
 bool bitmap_iterate(Bitmap *b, Iterator *i, unsigned *n) {
-        uint64_t bitmask;
         unsigned offset, rem;
 
         assert(i);
@@ -168,22 +222,32 @@ bool bitmap_iterate(Bitmap *b, Iterator *i, unsigned *n) {
 
         offset = BITMAP_NUM_TO_OFFSET(i->idx);
         rem = BITMAP_NUM_TO_REM(i->idx);
-        bitmask = UINT64_C(1) << rem;
 
-        for (; offset < b->n_bitmaps; offset ++) {
-                if (b->bitmaps[offset]) {
-                        for (; bitmask; bitmask <<= 1, rem ++) {
-                                if (b->bitmaps[offset] & bitmask) {
-                                        *n = BITMAP_OFFSET_TO_NUM(offset, rem);
-                                        i->idx = *n + 1;
+        if (offset < b->n_bitmaps) {
+                uint64_t bits;
 
-                                        return true;
-                                }
-                        }
+                /* Look at the rest of the current word first, then skip over empty words, and use the lowest set
+                 * bit of the first non-empty one. In dense bitmaps the next bit is usually set, so check that
+                 * before counting zeros. */
+                bits = b->bitmaps[offset] >> rem;
+                if (bits & 1) {
+                        *n = i->idx++;
+                        return true;
                 }
+                if (bits != 0) {
+                        *n = i->idx + __builtin_ctzll(bits);
+                        i->idx = *n + 1;
 
-                rem = 0;
-                bitmask = 1;
+                        return true;
+                }
+
+                for (offset++; offset < b->n_bitmaps; offset++)
+                        if (b->bitmaps[offset] != 0) {
+                                *n = BITMAP_OFFSET_TO_NUM(offset, __builtin_ctzll(b->bitmaps[offset]));
+                                i->idx = *n + 1;
+
+                                return true;
+                        }
         }
 
         i->idx = BITMAP_END;
@@ -19,6 +19,10 @@ bool bitmap_isset(Bitmap *b, unsigned n);
 bool bitmap_isclear(Bitmap *b);
 void bitmap_clear(Bitmap *b);
 
+unsigned bitmap_count(Bitmap *b);
+int bitmap_union(Bitmap *a, Bitmap *b);
+void bitmap_intersect(Bitmap *a, Bitmap *b);
+
 bool bitmap_iterate(Bitmap *b, Iterator *i, unsigned *n);
 
 bool bitmap_equal(Bitmap *a, Bitmap *b);
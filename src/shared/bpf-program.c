@@ -94,6 +94,32 @@ int bpf_program_load_kernel(BPFProgram *p, char *log_buf, size_t log_size) {
         return 0;
 }
 
+int bpf_program_clone(BPFProgram *p, BPFProgram **ret) {
+        _cleanup_(bpf_program_unrefp) BPFProgram *c = NULL;
+        int r;
+
+        assert(p);
+        assert(ret);
+
+        /* Returns a new program object referring to the same program in the kernel as the specified one. The kernel
+         * allows attaching a single program to any number of cgroups, but we track only one attachment per object,
+         * hence this is useful for sharing one program between multiple cgroups. */
+
+        if (p->kernel_fd < 0)
+                return -EBADF;
+
+        r = bpf_program_new(p->prog_type, &c);
+        if (r < 0)
+                return r;
+
+        c->kernel_fd = fcntl(p->kernel_fd, F_DUPFD_CLOEXEC, 3);
+        if (c->kernel_fd < 0)
+                return -errno;
+
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
 int bpf_program_cgroup_attach(BPFProgram *p, int type, const char *path, uint32_t flags) {
         _cleanup_free_ char *copy = NULL;
         _cleanup_close_ int fd = -1;
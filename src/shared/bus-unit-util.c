@@ -21,6 +21,7 @@
 #include "missing_fs.h"
 #include "mountpoint-util.h"
 #include "nsflags.h"
+#include "numa-util.h"
 #include "parse-util.h"
 #include "path-util.h"
 #include "process-util.h"
@@ -100,6 +101,7 @@ DEFINE_BUS_APPEND_PARSE("i", ioprio_class_from_string);
 DEFINE_BUS_APPEND_PARSE("i", ip_tos_from_string);
 DEFINE_BUS_APPEND_PARSE("i", log_facility_unshifted_from_string);
 DEFINE_BUS_APPEND_PARSE("i", log_level_from_string);
+DEFINE_BUS_APPEND_PARSE("i", mpol_from_string);
 DEFINE_BUS_APPEND_PARSE("i", parse_errno);
 DEFINE_BUS_APPEND_PARSE("i", sched_policy_from_string);
 DEFINE_BUS_APPEND_PARSE("i", secure_bits_from_string);
@@ -377,7 +379,7 @@ static int bus_append_ip_address_access(sd_bus_message *m, int family, const uni
 static int bus_append_cgroup_property(sd_bus_message *m, const char *field, const char *eq) {
         int r;
 
-        if (STR_IN_SET(field, "DevicePolicy", "Slice"))
+        if (STR_IN_SET(field, "DevicePolicy", "Slice", "PressureAction"))
 
                 return bus_append_string(m, field, eq);
 
@@ -387,6 +389,10 @@ static int bus_append_cgroup_property(sd_bus_message *m, const char *field, cons
 
                 return bus_append_parse_boolean(m, field, eq);
 
+        if (STR_IN_SET(field, "CPUPressureThresholdSec", "IOPressureThresholdSec", "MemoryPressureThresholdSec", "PressureWindowSec"))
+
+                return bus_append_parse_sec_rename(m, field, eq);
+
         if (STR_IN_SET(field, "CPUWeight", "StartupCPUWeight", "IOWeight", "StartupIOWeight"))
 
                 return bus_append_cg_weight_parse(m, field, eq);
@@ -443,6 +449,16 @@ static int bus_append_cgroup_property(sd_bus_message *m, const char *field, cons
                 return bus_append_parse_size(m, field, eq, 1024);
         }
 
+        if (STR_IN_SET(field, "AllowedCPUs", "AllowedMemoryNodes")) {
+                _cleanup_cpu_free_ cpu_set_t *cpuset = NULL;
+
+                r = parse_cpu_set(eq, &cpuset);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to parse %s value: %s", field, eq);
+
+                return bus_append_byte_array(m, field, cpuset, CPU_ALLOC_SIZE(r));
+        }
+
         if (streq(field, "CPUQuota")) {
 
                 if (isempty(eq))
@@ -768,6 +784,10 @@ static int bus_append_execute_property(sd_bus_message *m, const char *field, con
 
                 return bus_append_sched_policy_from_string(m, field, eq);
 
+        if (streq(field, "NUMAPolicy"))
+
+                return bus_append_mpol_from_string(m, field, eq);
+
         if (STR_IN_SET(field, "CPUSchedulingPriority", "OOMScoreAdjust"))
 
                 return bus_append_safe_atoi(m, field, eq);
@@ -976,7 +996,7 @@ static int bus_append_execute_property(sd_bus_message *m, const char *field, con
                 return 1;
         }
 
-        if (streq(field, "CPUAffinity")) {
+        if (STR_IN_SET(field, "CPUAffinity", "NUMAMask")) {
                 _cleanup_cpu_free_ cpu_set_t *cpuset = NULL;
 
                 r = parse_cpu_set(eq, &cpuset);
@@ -1762,8 +1782,8 @@ typedef struct BusWaitForJobs {
         sd_bus *bus;
         Set *jobs;
 
-        char *name;
-        char *result;
+        /* Unit name and result of every job that was removed but not checked yet, as pairs */
+        char **removed;
 
         sd_bus_slot *slot_job_removed;
         sd_bus_slot *slot_disconnected;
@@ -1800,11 +1820,14 @@ static int match_job_removed(sd_bus_message *m, void *userdata, sd_bus_error *er
 
         free(found);
 
-        if (!isempty(result))
-                d->result = strdup(result);
+        if (isempty(result))
+                return 0;
 
-        if (!isempty(unit))
-                d->name = strdup(unit);
+        /* Callers may still be busy enqueuing further jobs while the first ones already finish, hence
+         * remember every result until bus_wait_for_jobs() gets to look at them. */
+        if (strv_extend(&d->removed, strempty(unit)) < 0 ||
+            strv_extend(&d->removed, result) < 0)
+                log_oom();
 
         return 0;
 }
@@ -1820,8 +1843,7 @@ void bus_wait_for_jobs_free(BusWaitForJobs *d) {
 
         sd_bus_unref(d->bus);
 
-        free(d->name);
-        free(d->result);
+        strv_free(d->removed);
 
         free(d);
 }
@@ -1885,17 +1907,17 @@ static int bus_process_wait(sd_bus *bus) {
         }
 }
 
-static int bus_job_get_service_result(BusWaitForJobs *d, char **result) {
+static int bus_job_get_service_result(BusWaitForJobs *d, const char *name, char **result) {
         _cleanup_free_ char *dbus_path = NULL;
 
         assert(d);
-        assert(d->name);
+        assert(name);
         assert(result);
 
-        if (!endswith(d->name, ".service"))
+        if (!endswith(name, ".service"))
                 return -EINVAL;
 
-        dbus_path = unit_dbus_path_from_name(d->name);
+        dbus_path = unit_dbus_path_from_name(name);
         if (!dbus_path)
                 return -ENOMEM;
 
@@ -1972,60 +1994,61 @@ finish:
                          service_shell_quoted ?: "<service>");
 }
 
-static int check_wait_response(BusWaitForJobs *d, bool quiet, const char* const* extra_args) {
-        assert(d->result);
+static int check_wait_response(BusWaitForJobs *d, const char *name, const char *result, bool quiet, const char* const* extra_args) {
+        assert(d);
+        assert(result);
 
         if (!quiet) {
-                if (streq(d->result, "canceled"))
-                        log_error("Job for %s canceled.", strna(d->name));
-                else if (streq(d->result, "timeout"))
-                        log_error("Job for %s timed out.", strna(d->name));
-                else if (streq(d->result, "dependency"))
-                        log_error("A dependency job for %s failed. See 'journalctl -xe' for details.", strna(d->name));
-                else if (streq(d->result, "invalid"))
-                        log_error("%s is not active, cannot reload.", strna(d->name));
-                else if (streq(d->result, "assert"))
-                        log_error("Assertion failed on job for %s.", strna(d->name));
-                else if (streq(d->result, "unsupported"))
-                        log_error("Operation on or unit type of %s not supported on this system.", strna(d->name));
-                else if (streq(d->result, "collected"))
-                        log_error("Queued job for %s was garbage collected.", strna(d->name));
-                else if (streq(d->result, "once"))
-                        log_error("Unit %s was started already once and can't be started again.", strna(d->name));
-                else if (!STR_IN_SET(d->result, "done", "skipped")) {
-                        if (d->name) {
-                                _cleanup_free_ char *result = NULL;
+                if (streq(result, "canceled"))
+                        log_error("Job for %s canceled.", strna(name));
+                else if (streq(result, "timeout"))
+                        log_error("Job for %s timed out.", strna(name));
+                else if (streq(result, "dependency"))
+                        log_error("A dependency job for %s failed. See 'journalctl -xe' for details.", strna(name));
+                else if (streq(result, "invalid"))
+                        log_error("%s is not active, cannot reload.", strna(name));
+                else if (streq(result, "assert"))
+                        log_error("Assertion failed on job for %s.", strna(name));
+                else if (streq(result, "unsupported"))
+                        log_error("Operation on or unit type of %s not supported on this system.", strna(name));
+                else if (streq(result, "collected"))
+                        log_error("Queued job for %s was garbage collected.", strna(name));
+                else if (streq(result, "once"))
+                        log_error("Unit %s was started already once and can't be started again.", strna(name));
+                else if (!STR_IN_SET(result, "done", "skipped")) {
+                        if (name) {
+                                _cleanup_free_ char *service_result = NULL;
                                 int q;
 
-                                q = bus_job_get_service_result(d, &result);
+                                q = bus_job_get_service_result(d, name, &service_result);
                                 if (q < 0)
-                                        log_debug_errno(q, "Failed to get Result property of unit %s: %m", d->name);
+                                        log_debug_errno(q, "Failed to get Result property of unit %s: %m", name);
 
-                                log_job_error_with_service_result(d->name, result, extra_args);
+                                log_job_error_with_service_result(name, service_result, extra_args);
                         } else
                                 log_error("Job failed. See \"journalctl -xe\" for details.");
                 }
         }
 
-        if (STR_IN_SET(d->result, "canceled", "collected"))
+        if (STR_IN_SET(result, "canceled", "collected"))
                 return -ECANCELED;
-        else if (streq(d->result, "timeout"))
+        else if (streq(result, "timeout"))
                 return -ETIME;
-        else if (streq(d->result, "dependency"))
+        else if (streq(result, "dependency"))
                 return -EIO;
-        else if (streq(d->result, "invalid"))
+        else if (streq(result, "invalid"))
                 return -ENOEXEC;
-        else if (streq(d->result, "assert"))
+        else if (streq(result, "assert"))
                 return -EPROTO;
-        else if (streq(d->result, "unsupported"))
+        else if (streq(result, "unsupported"))
                 return -EOPNOTSUPP;
-        else if (streq(d->result, "once"))
+        else if (streq(result, "once"))
                 return -ESTALE;
-        else if (STR_IN_SET(d->result, "done", "skipped"))
+        else if (STR_IN_SET(result, "done", "skipped"))
                 return 0;
 
         return log_debug_errno(SYNTHETIC_ERRNO(EIO),
-                               "Unexpected job result, assuming server side newer than us: %s", d->result);
+                               "Unexpected job result, assuming server side newer than us: %s", result);
 }
 
 int bus_wait_for_jobs(BusWaitForJobs *d, bool quiet, const char* const* extra_args) {
@@ -2033,25 +2056,28 @@ int bus_wait_for_jobs(BusWaitForJobs *d, bool quiet, const char* const* extra_ar
 
         assert(d);
 
-        while (!set_isempty(d->jobs)) {
+        for (;;) {
+                char **name, **result;
                 int q;
 
-                q = bus_process_wait(d->bus);
-                if (q < 0)
-                        return log_error_errno(q, "Failed to wait for response: %m");
-
-                if (d->result) {
-                        q = check_wait_response(d, quiet, extra_args);
+                STRV_FOREACH_PAIR(name, result, d->removed) {
+                        q = check_wait_response(d, empty_to_null(*name), *result, quiet, extra_args);
                         /* Return the first error as it is most likely to be
                          * meaningful. */
                         if (q < 0 && r == 0)
                                 r = q;
 
-                        log_debug_errno(q, "Got result %s/%m for job %s", strna(d->result), strna(d->name));
+                        log_debug_errno(q, "Got result %s/%m for job %s", *result, strna(empty_to_null(*name)));
                 }
 
-                d->name = mfree(d->name);
-                d->result = mfree(d->result);
+                d->removed = strv_free(d->removed);
+
+                if (set_isempty(d->jobs))
+                        break;
+
+                q = bus_process_wait(d->bus);
+                if (q < 0)
+                        return log_error_errno(q, "Failed to wait for response: %m");
         }
 
         return r;
@@ -26,6 +26,7 @@
 #include "cgroup-util.h"
 #include "def.h"
 #include "escape.h"
+#include "event-util.h"
 #include "fd-util.h"
 #include "missing.h"
 #include "mountpoint-util.h"
@@ -578,6 +579,11 @@ int bus_connect_system_systemd(sd_bus **_bus) {
         if (r < 0)
                 return r;
 
+        /* Large replies (e.g. unit lists) may be passed in a memfd on this direct connection */
+        r = sd_bus_negotiate_memfd(bus, true);
+        if (r < 0)
+                return r;
+
         r = sd_bus_start(bus);
         if (r < 0)
                 return sd_bus_default_system(_bus);
@@ -615,6 +621,10 @@ int bus_connect_user_systemd(sd_bus **_bus) {
         if (!bus->address)
                 return -ENOMEM;
 
+        r = sd_bus_negotiate_memfd(bus, true);
+        if (r < 0)
+                return r;
+
         r = sd_bus_start(bus);
         if (r < 0)
                 return sd_bus_default_user(_bus);
@@ -1751,3 +1761,59 @@ int bus_reply_pair_array(sd_bus_message *m, char **l) {
 
         return sd_bus_send(NULL, reply, NULL);
 }
+
+static int append_event_source_stats(sd_event_source *s, void *userdata) {
+        sd_bus_message *reply = userdata;
+        sd_event_source_stats stats;
+        const char *description = NULL;
+        int r;
+
+        r = sd_event_source_get_stats(s, &stats, sizeof(stats));
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_get_description(s, &description);
+
+        return sd_bus_message_append(reply, "(ssttttt)",
+                                     strna(description),
+                                     event_source_get_type_name(s),
+                                     stats.n_dispatched,
+                                     stats.dispatch_usec,
+                                     stats.dispatch_max_usec,
+                                     stats.pending_usec,
+                                     stats.pending_max_usec);
+}
+
+int bus_reply_event_source_stats(sd_bus_message *m, sd_event *e) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        int r;
+
+        assert(m);
+        assert(e);
+
+        /* Reply to the specified message with the dispatch statistics of all event sources of the specified
+         * event loop. Collecting them costs a clock read per dispatch, hence it is only turned on when somebody
+         * asks for the first time, and everything before is not accounted. */
+
+        r = sd_event_set_source_stats(e, true);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(m, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(ssttttt)");
+        if (r < 0)
+                return r;
+
+        r = event_foreach_source(e, append_event_source_stats, reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
@@ -177,3 +177,4 @@ static inline int bus_open_system_watch_bind(sd_bus **ret) {
 }
 
 int bus_reply_pair_array(sd_bus_message *m, char **l);
+int bus_reply_event_source_stats(sd_bus_message *m, sd_event *e);
@@ -277,9 +277,10 @@ int config_parse(const char *unit,
                  ConfigParseFlags flags,
                  void *userdata) {
 
-        _cleanup_free_ char *section = NULL, *continuation = NULL;
+        _cleanup_free_ char *section = NULL, *continuation = NULL, *buf = NULL;
         _cleanup_fclose_ FILE *ours = NULL;
         unsigned line = 0, section_line = 0;
+        size_t buf_allocated = 0;
         bool section_ignored = false;
         int r;
 
@@ -301,11 +302,11 @@ int config_parse(const char *unit,
         fd_warn_permissions(filename, fileno(f));
 
         for (;;) {
-                _cleanup_free_ char *buf = NULL;
                 bool escaped = false;
                 char *l, *p, *e;
 
-                r = read_line(f, LONG_LINE_MAX, &buf);
+                /* All lines are read into the same buffer, which is hence only valid until the next line is read */
+                r = read_line_reuse(f, LONG_LINE_MAX, &buf, &buf_allocated);
                 if (r == 0)
                         break;
                 if (r == -ENOBUFS) {
@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <syslog.h>
 
 #include "alloc-util.h"
@@ -41,6 +42,76 @@ cpu_set_t* cpu_set_malloc(unsigned *ncpus) {
         }
 }
 
+char *cpu_set_to_range_string(const cpu_set_t *set, unsigned ncpus) {
+        _cleanup_free_ char *str = NULL;
+        size_t allocated = 0, len = 0;
+        unsigned i = 0, j;
+
+        /* Formats the set in the "0-3,8" syntax the kernel uses for cpuset.cpus and friends */
+
+        while (i < ncpus) {
+                int k;
+
+                if (!set || !CPU_ISSET_S(i, CPU_ALLOC_SIZE(ncpus), set)) {
+                        i++;
+                        continue;
+                }
+
+                for (j = i; j + 1 < ncpus && CPU_ISSET_S(j + 1, CPU_ALLOC_SIZE(ncpus), set); j++)
+                        ;
+
+                if (!GREEDY_REALLOC(str, allocated, len + 1 + 2 * DECIMAL_STR_MAX(unsigned) + 1))
+                        return NULL;
+
+                if (i == j)
+                        k = sprintf(str + len, len > 0 ? ",%u" : "%u", i);
+                else
+                        k = sprintf(str + len, len > 0 ? ",%u-%u" : "%u-%u", i, j);
+                len += k;
+
+                i = j + 1;
+        }
+
+        if (!str)
+                return strdup("");
+
+        return TAKE_PTR(str);
+}
+
+int cpu_set_merge_array(cpu_set_t **set, unsigned *ncpus, const void *array, size_t size) {
+        unsigned n;
+        size_t i;
+
+        assert(set);
+        assert(ncpus);
+        assert(array || size == 0);
+
+        /* ORs a raw bit array, as we pass it around on the bus, into the set, growing the set as needed */
+
+        n = (unsigned) (size * 8);
+        if (!*set || *ncpus < n) {
+                cpu_set_t *c;
+
+                c = CPU_ALLOC(n);
+                if (!c)
+                        return -ENOMEM;
+
+                CPU_ZERO_S(CPU_ALLOC_SIZE(n), c);
+                if (*set) {
+                        memcpy(c, *set, CPU_ALLOC_SIZE(*ncpus));
+                        CPU_FREE(*set);
+                }
+
+                *set = c;
+                *ncpus = (unsigned) (CPU_ALLOC_SIZE(n) * 8);
+        }
+
+        for (i = 0; i < size; i++)
+                ((uint8_t*) *set)[i] |= ((const uint8_t*) array)[i];
+
+        return 0;
+}
+
 int parse_cpu_set_internal(
                 const char *rvalue,
                 cpu_set_t **cpu_set,
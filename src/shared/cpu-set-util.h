@@ -22,6 +22,9 @@ static inline cpu_set_t* cpu_set_mfree(cpu_set_t *p) {
 
 cpu_set_t* cpu_set_malloc(unsigned *ncpus);
 
+char *cpu_set_to_range_string(const cpu_set_t *set, unsigned ncpus);
+int cpu_set_merge_array(cpu_set_t **set, unsigned *ncpus, const void *array, size_t size);
+
 int parse_cpu_set_internal(const char *rvalue, cpu_set_t **cpu_set, bool warn, const char *unit, const char *filename, unsigned line, const char *lvalue);
 
 static inline int parse_cpu_set_and_warn(const char *rvalue, cpu_set_t **cpu_set, const char *unit, const char *filename, unsigned line, const char *lvalue) {
@@ -18,6 +18,7 @@
 #include "device-util.h"
 #include "dissect-image.h"
 #include "env-file.h"
+#include "env-util.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
@@ -27,6 +28,7 @@
 #include "id128-util.h"
 #include "linux-3.13/dm-ioctl.h"
 #include "missing.h"
+#include "mkdir.h"
 #include "mount-util.h"
 #include "mountpoint-util.h"
 #include "os-util.h"
@@ -42,6 +44,7 @@
 #include "tmpfile-util.h"
 #include "udev-util.h"
 #include "user-util.h"
+#include "worker-pool.h"
 #include "xattr-util.h"
 
 int probe_filesystem(const char *node, char **ret_fstype) {
@@ -266,6 +269,56 @@ static int loop_wait_for_partitions_to_appear(
                                N_DEVICE_NODE_LIST_ATTEMPTS);
 }
 
+/* Probing the file system types means opening every partition and reading its superblock, and the same image is
+ * usually dissected over and over again, for example by every service that has it as RootImage=. Hence for images on
+ * loop devices we remember the types in a small file below /run, named after the identity, modification time and
+ * mapped range of the backing file. */
+#define DISSECT_CACHE_DIR "/run/systemd/dissect"
+
+static int dissect_cache_path(int fd, sd_device *d, char **ret) {
+        struct loop_info64 info;
+        const char *backing;
+        struct stat st;
+        char *p;
+
+        assert(fd >= 0);
+        assert(d);
+        assert(ret);
+
+        if (ioctl(fd, LOOP_GET_STATUS64, &info) < 0)
+                return -errno;
+
+        if (sd_device_get_sysattr_value(d, "loop/backing_file", &backing) < 0)
+                return -ENXIO;
+
+        if (stat(backing, &st) < 0)
+                return -errno;
+
+        /* Make sure the path still refers to the file the loop device was set up for */
+        if (st.st_dev != (dev_t) info.lo_device || st.st_ino != (ino_t) info.lo_inode)
+                return -ESTALE;
+
+        if (asprintf(&p, DISSECT_CACHE_DIR "/%" PRIx64 "-%" PRIx64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64 "-%" PRIu64,
+                     (uint64_t) st.st_dev, (uint64_t) st.st_ino, (uint64_t) timespec_load_nsec(&st.st_mtim),
+                     (uint64_t) st.st_size, (uint64_t) info.lo_offset, (uint64_t) info.lo_sizelimit) < 0)
+                return -ENOMEM;
+
+        *ret = p;
+        return 0;
+}
+
+static int dissect_cache_save(const char *path, char **l) {
+        int r;
+
+        assert(path);
+
+        r = mkdir_p(DISSECT_CACHE_DIR, 0755);
+        if (r < 0)
+                return r;
+
+        return write_env_file(path, l);
+}
+
 #endif
 
 int dissect_image(
@@ -282,8 +335,10 @@ int dissect_image(
         _cleanup_(sd_device_unrefp) sd_device *d = NULL;
         _cleanup_(dissected_image_unrefp) DissectedImage *m = NULL;
         _cleanup_(blkid_free_probep) blkid_probe b = NULL;
-        _cleanup_free_ char *generic_node = NULL;
+        _cleanup_free_ char *generic_node = NULL, *cache_path = NULL;
         sd_id128_t generic_uuid = SD_ID128_NULL;
+        _cleanup_strv_free_ char **cache = NULL;
+        bool cache_dirty = false;
         const char *pttype = NULL;
         blkid_partlist pl;
         int r, generic_nr;
@@ -690,6 +745,9 @@ int dissect_image(
         blkid_free_probe(b);
         b = NULL;
 
+        if (dissect_cache_path(fd, d, &cache_path) >= 0)
+                (void) load_env_file(NULL, cache_path, &cache);
+
         /* Fill in file system types if we don't know them yet. */
         for (i = 0; i < _PARTITION_DESIGNATOR_MAX; i++) {
                 DissectedPartition *p = m->partitions + i;
@@ -698,9 +756,31 @@ int dissect_image(
                         continue;
 
                 if (!p->fstype && p->node) {
-                        r = probe_filesystem(p->node, &p->fstype);
-                        if (r < 0 && r != -EUCLEAN)
-                                return r;
+                        char key[STRLEN("PARTITION") + DECIMAL_STR_MAX(int)];
+                        const char *cached;
+
+                        xsprintf(key, "PARTITION%i", p->partno);
+
+                        cached = strv_env_get(cache, key);
+                        if (cached) {
+                                /* An empty value means nothing was found on the partition the last time */
+                                if (!isempty(cached)) {
+                                        p->fstype = strdup(cached);
+                                        if (!p->fstype)
+                                                return -ENOMEM;
+                                }
+                        } else {
+                                r = probe_filesystem(p->node, &p->fstype);
+                                if (r < 0 && r != -EUCLEAN)
+                                        return r;
+
+                                if (r >= 0 && cache_path) {
+                                        if (strv_extendf(&cache, "%s=%s", key, strempty(p->fstype)) < 0)
+                                                return -ENOMEM;
+
+                                        cache_dirty = true;
+                                }
+                        }
                 }
 
                 if (streq_ptr(p->fstype, "crypto_LUKS"))
@@ -710,6 +790,12 @@ int dissect_image(
                         p->rw = false;
         }
 
+        if (cache_dirty) {
+                r = dissect_cache_save(cache_path, cache);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to write dissection cache %s, ignoring: %m", cache_path);
+        }
+
         *ret = TAKE_PTR(m);
 
         return 0;
@@ -885,12 +971,13 @@ typedef struct DecryptedPartition {
         struct crypt_device *device;
         char *name;
         bool relinquished;
+        bool reused;       /* set up by somebody else, who is responsible for removing it */
 } DecryptedPartition;
 
 struct DecryptedImage {
-        DecryptedPartition *decrypted;
-        size_t n_decrypted;
-        size_t n_allocated;
+        /* Two slots for each partition, one for dm-crypt and one for dm-verity, so that partitions may be set up in
+         * parallel. Slots not in use have no name. */
+        DecryptedPartition decrypted[_PARTITION_DESIGNATOR_MAX * 2];
 };
 #endif
 
@@ -902,10 +989,10 @@ DecryptedImage* decrypted_image_unref(DecryptedImage* d) {
         if (!d)
                 return NULL;
 
-        for (i = 0; i < d->n_decrypted; i++) {
+        for (i = 0; i < ELEMENTSOF(d->decrypted); i++) {
                 DecryptedPartition *p = d->decrypted + i;
 
-                if (p->device && p->name && !p->relinquished) {
+                if (p->device && p->name && !p->relinquished && !p->reused) {
                         r = crypt_deactivate(p->device, p->name);
                         if (r < 0)
                                 log_debug_errno(r, "Failed to deactivate encrypted partition %s", p->name);
@@ -955,11 +1042,41 @@ static int make_dm_name_and_node(const void *original_node, const char *suffix,
         return 0;
 }
 
+static int make_verity_name_and_node(const void *root_hash, size_t root_hash_size, char **ret_name, char **ret_node) {
+        _cleanup_free_ char *hex = NULL, *name = NULL, *node = NULL;
+
+        assert(root_hash);
+        assert(ret_name);
+        assert(ret_node);
+
+        /* The verity device is named after the root hash rather than after the loop device, so that everybody
+         * who sets up the same image finds the device somebody else set up before, and can share it. */
+
+        hex = hexmem(root_hash, root_hash_size);
+        if (!hex)
+                return -ENOMEM;
+
+        name = strjoin(hex, "-verity");
+        if (!name)
+                return -ENOMEM;
+        if (strlen(name) >= DM_NAME_LEN || !filename_is_valid(name))
+                return -EINVAL;
+
+        node = strjoin(crypt_get_dir(), "/", name);
+        if (!node)
+                return -ENOMEM;
+
+        *ret_name = TAKE_PTR(name);
+        *ret_node = TAKE_PTR(node);
+
+        return 0;
+}
+
 static int decrypt_partition(
                 DissectedPartition *m,
                 const char *passphrase,
                 DissectImageFlags flags,
-                DecryptedImage *d) {
+                DecryptedPartition *d) {
 
         _cleanup_free_ char *node = NULL, *name = NULL;
         _cleanup_(crypt_freep) struct crypt_device *cd = NULL;
@@ -981,9 +1098,6 @@ static int decrypt_partition(
         if (r < 0)
                 return r;
 
-        if (!GREEDY_REALLOC0(d->decrypted, d->n_allocated, d->n_decrypted + 1))
-                return -ENOMEM;
-
         r = crypt_init(&cd, m->node);
         if (r < 0)
                 return log_debug_errno(r, "Failed to initialize dm-crypt: %m");
@@ -1000,9 +1114,8 @@ static int decrypt_partition(
                 return r == -EPERM ? -EKEYREJECTED : r;
         }
 
-        d->decrypted[d->n_decrypted].name = TAKE_PTR(name);
-        d->decrypted[d->n_decrypted].device = TAKE_PTR(cd);
-        d->n_decrypted++;
+        d->name = TAKE_PTR(name);
+        d->device = TAKE_PTR(cd);
 
         m->decrypted_node = TAKE_PTR(node);
 
@@ -1015,14 +1128,16 @@ static int verity_partition(
                 const void *root_hash,
                 size_t root_hash_size,
                 DissectImageFlags flags,
-                DecryptedImage *d) {
+                DecryptedPartition *d) {
 
         _cleanup_free_ char *node = NULL, *name = NULL;
         _cleanup_(crypt_freep) struct crypt_device *cd = NULL;
+        bool reused = false;
         int r;
 
         assert(m);
         assert(v);
+        assert(d);
 
         if (!root_hash)
                 return 0;
@@ -1035,13 +1150,10 @@ static int verity_partition(
         if (!streq(v->fstype, "DM_verity_hash"))
                 return 0;
 
-        r = make_dm_name_and_node(m->node, "-verity", &name, &node);
+        r = make_verity_name_and_node(root_hash, root_hash_size, &name, &node);
         if (r < 0)
                 return r;
 
-        if (!GREEDY_REALLOC0(d->decrypted, d->n_allocated, d->n_decrypted + 1))
-                return -ENOMEM;
-
         r = crypt_init(&cd, v->node);
         if (r < 0)
                 return r;
@@ -1055,17 +1167,81 @@ static int verity_partition(
                 return r;
 
         r = crypt_activate_by_volume_key(cd, name, root_hash, root_hash_size, CRYPT_ACTIVATE_READONLY);
-        if (r < 0)
+        if (r == -EEXIST) {
+                _cleanup_(crypt_freep) struct crypt_device *existing = NULL;
+
+                /* Another user of the same image got here first. The name covers the full root hash, hence if
+                 * the existing device is a verity device it provides the very same data, and we can use it. */
+
+                r = crypt_init_by_name(&existing, name);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to open existing verity device %s: %m", name);
+
+                if (!streq_ptr(crypt_get_type(existing), CRYPT_VERITY))
+                        return log_debug_errno(SYNTHETIC_ERRNO(EEXIST),
+                                               "Device %s exists already, but is not a verity device.", name);
+
+                log_debug("Reusing existing verity device %s.", name);
+
+                crypt_free(cd);
+                cd = TAKE_PTR(existing);
+                reused = true;
+        } else if (r < 0)
                 return r;
 
-        d->decrypted[d->n_decrypted].name = TAKE_PTR(name);
-        d->decrypted[d->n_decrypted].device = TAKE_PTR(cd);
-        d->n_decrypted++;
+        d->name = TAKE_PTR(name);
+        d->device = TAKE_PTR(cd);
+        d->reused = reused;
 
         m->decrypted_node = TAKE_PTR(node);
 
         return 0;
 }
+
+typedef struct DecryptContext {
+        const char *passphrase;
+        const void *root_hash;
+        size_t root_hash_size;
+        DissectImageFlags flags;
+} DecryptContext;
+
+typedef struct DecryptJob {
+        DissectedPartition *partition;
+        DissectedPartition *verity;
+        DecryptedPartition *slots; /* two of them */
+} DecryptJob;
+
+static int decrypt_job_run(void *userdata, void *context) {
+        DecryptJob *j = userdata;
+        DecryptContext *c = context;
+        DissectedPartition *p;
+        int r;
+
+        assert(j);
+        assert(c);
+
+        /* Each job only touches its own partition and its own slots, hence no locking is needed */
+
+        p = j->partition;
+
+        r = decrypt_partition(p, c->passphrase, c->flags, j->slots);
+        if (r < 0)
+                return r;
+
+        if (j->verity) {
+                r = verity_partition(p, j->verity, c->root_hash, c->root_hash_size, c->flags, j->slots + 1);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!p->decrypted_fstype && p->decrypted_node) {
+                r = probe_filesystem(p->decrypted_node, &p->decrypted_fstype);
+                if (r < 0 && r != -EUCLEAN)
+                        return r;
+        }
+
+        return 0;
+}
 #endif
 
 int dissected_image_decrypt(
@@ -1078,8 +1254,16 @@ int dissected_image_decrypt(
 
 #if HAVE_LIBCRYPTSETUP
         _cleanup_(decrypted_image_unrefp) DecryptedImage *d = NULL;
-        unsigned i;
-        int r;
+        DecryptJob *jobs[_PARTITION_DESIGNATOR_MAX];
+        DecryptContext context = {
+                .passphrase = passphrase,
+                .root_hash = root_hash,
+                .root_hash_size = root_hash_size,
+                .flags = flags,
+        };
+        unsigned i, n_jobs = 0;
+        WorkerPool *pool = NULL;
+        int r = 0;
 #endif
 
         assert(m);
@@ -1110,27 +1294,52 @@ int dissected_image_decrypt(
                 DissectedPartition *p = m->partitions + i;
                 int k;
 
-                if (!p->found)
+                if (!p->found || !p->node || !p->fstype)
                         continue;
 
-                r = decrypt_partition(p, passphrase, flags, d);
-                if (r < 0)
-                        return r;
-
                 k = PARTITION_VERITY_OF(i);
-                if (k >= 0) {
-                        r = verity_partition(p, m->partitions + k, root_hash, root_hash_size, flags, d);
-                        if (r < 0)
-                                return r;
+
+                /* Only bother with partitions that actually have something to set up */
+                if (!streq(p->fstype, "crypto_LUKS") &&
+                    !(root_hash && k >= 0 && streq_ptr(m->partitions[k].fstype, "DM_verity_hash")))
+                        continue;
+
+                jobs[n_jobs] = new(DecryptJob, 1);
+                if (!jobs[n_jobs]) {
+                        r = -ENOMEM;
+                        goto finish;
                 }
 
-                if (!p->decrypted_fstype && p->decrypted_node) {
-                        r = probe_filesystem(p->decrypted_node, &p->decrypted_fstype);
-                        if (r < 0 && r != -EUCLEAN)
-                                return r;
+                *jobs[n_jobs++] = (DecryptJob) {
+                        .partition = p,
+                        .verity = k >= 0 ? m->partitions + k : NULL,
+                        .slots = d->decrypted + i * 2,
+                };
+        }
+
+        /* Setting up a device means waiting for the key derivation, for the device mapper and for udev, hence if
+         * there's more than one, set them up in parallel. */
+        if (n_jobs > 1)
+                pool = worker_pool_new(decrypt_job_run, free, &context);
+
+        for (i = 0; i < n_jobs; i++) {
+                if (pool) {
+                        worker_pool_add(pool, TAKE_PTR(jobs[i]));
+                        continue;
                 }
+
+                if (r >= 0)
+                        r = decrypt_job_run(jobs[i], &context);
         }
 
+finish:
+        if (pool)
+                r = worker_pool_finish(pool);
+        for (i = 0; i < n_jobs; i++)
+                free(jobs[i]);
+        if (r < 0)
+                return r;
+
         *ret = TAKE_PTR(d);
 
         return 1;
@@ -1221,10 +1430,10 @@ int decrypted_image_relinquish(DecryptedImage *d) {
          * that we don't clean it up ourselves either anymore */
 
 #if HAVE_LIBCRYPTSETUP
-        for (i = 0; i < d->n_decrypted; i++) {
+        for (i = 0; i < ELEMENTSOF(d->decrypted); i++) {
                 DecryptedPartition *p = d->decrypted + i;
 
-                if (p->relinquished)
+                if (!p->name || p->relinquished)
                         continue;
 
                 r = deferred_remove(p);
@@ -3,7 +3,9 @@
 #include <dirent.h>
 #include <errno.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <stdio.h>
 
@@ -31,6 +33,29 @@
 /* Put this test here for a lack of better place */
 assert_cc(EAGAIN == EWOULDBLOCK);
 
+typedef struct ExecChild {
+        char *path;
+        pid_t pid;
+        usec_t start;
+        bool timed_out;
+} ExecChild;
+
+static ExecChild *exec_child_free(ExecChild *c) {
+        if (!c)
+                return NULL;
+
+        free(c->path);
+        return mfree(c);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ExecChild*, exec_child_free);
+
+static Hashmap *exec_children_free(Hashmap *h) {
+        return hashmap_free_with_destructor(h, exec_child_free);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(Hashmap*, exec_children_free);
+
 static int do_spawn(const char *path, char *argv[], int stdout_fd, pid_t *pid) {
 
         pid_t _pid;
@@ -41,7 +66,8 @@ static int do_spawn(const char *path, char *argv[], int stdout_fd, pid_t *pid) {
                 return 0;
         }
 
-        r = safe_fork("(direxec)", FORK_DEATHSIG|FORK_LOG, &_pid);
+        /* SIGCHLD is blocked in the executor while it waits for the children, make sure it isn't inherited */
+        r = safe_fork("(direxec)", FORK_RESET_SIGNALS|FORK_DEATHSIG|FORK_LOG, &_pid);
         if (r < 0)
                 return r;
         if (r == 0) {
@@ -71,18 +97,123 @@ static int do_spawn(const char *path, char *argv[], int stdout_fd, pid_t *pid) {
         return 1;
 }
 
+static void exec_child_done(ExecChild *c, int status, const struct rusage *ru, FILE *timings) {
+        usec_t wall;
+        int code;
+
+        assert(c);
+        assert(ru);
+
+        wall = usec_sub_unsigned(now(CLOCK_MONOTONIC), c->start);
+
+        if (WIFEXITED(status)) {
+                code = CLD_EXITED;
+                status = WEXITSTATUS(status);
+
+                if (status != EXIT_SUCCESS)
+                        log_error("%s failed with exit status %i.", c->path, status);
+                else
+                        log_debug("%s succeeded.", c->path);
+        } else {
+                code = WCOREDUMP(status) ? CLD_DUMPED : CLD_KILLED;
+                status = WTERMSIG(status);
+
+                if (!c->timed_out)
+                        log_error("%s terminated by signal %s.", c->path, signal_to_string(status));
+        }
+
+        if (timings)
+                fprintf(timings, USEC_FMT " " USEC_FMT " " USEC_FMT " %i %i %i %s\n",
+                        c->start, wall,
+                        timeval_load(&ru->ru_utime) + timeval_load(&ru->ru_stime),
+                        code, status, c->timed_out, c->path);
+}
+
+static int wait_for_children(Hashmap *pids, usec_t timeout_each, FILE *timings) {
+        sigset_t mask;
+
+        /* Waits until all processes in pids are gone, and kills those which run longer than timeout_each. SIGCHLD
+         * needs to be blocked already when they are forked off, so that we don't miss any of them exiting. */
+
+        assert_se(sigemptyset(&mask) >= 0);
+        assert_se(sigaddset(&mask, SIGCHLD) >= 0);
+
+        for (;;) {
+                struct timespec ts;
+                usec_t n, next = USEC_INFINITY;
+                ExecChild *c;
+                Iterator i;
+
+                for (;;) {
+                        _cleanup_(exec_child_freep) ExecChild *done = NULL;
+                        struct rusage ru;
+                        int status;
+                        pid_t pid;
+
+                        pid = wait4(-1, &status, WNOHANG, &ru);
+                        if (pid < 0) {
+                                if (errno == EINTR)
+                                        continue;
+                                if (errno == ECHILD)
+                                        break;
+
+                                return log_error_errno(errno, "Failed to wait for children: %m");
+                        }
+                        if (pid == 0)
+                                break;
+
+                        done = hashmap_remove(pids, PID_TO_PTR(pid));
+                        if (done)
+                                exec_child_done(done, status, &ru, timings);
+                }
+
+                if (hashmap_isempty(pids))
+                        return 0;
+
+                if (timeout_each != USEC_INFINITY) {
+                        n = now(CLOCK_MONOTONIC);
+
+                        HASHMAP_FOREACH(c, pids, i) {
+                                usec_t deadline;
+
+                                if (c->timed_out)
+                                        continue;
+
+                                deadline = usec_add(c->start, timeout_each);
+                                if (deadline <= n) {
+                                        log_warning("%s is taking too long, killing.", c->path);
+                                        (void) kill(c->pid, SIGKILL);
+                                        c->timed_out = true;
+                                } else
+                                        next = MIN(next, deadline);
+                        }
+
+                        if (next != USEC_INFINITY)
+                                timespec_store(&ts, next - n);
+                }
+
+                if (sigtimedwait(&mask, NULL, next != USEC_INFINITY ? &ts : NULL) < 0 &&
+                    !IN_SET(errno, EAGAIN, EINTR))
+                        return log_error_errno(errno, "Failed to wait for SIGCHLD: %m");
+        }
+}
+
 static int do_execute(
                 char **directories,
                 usec_t timeout,
+                usec_t timeout_each,
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 int output_fd,
+                int timings_fd,
                 char *argv[],
                 char *envp[]) {
 
-        _cleanup_hashmap_free_free_ Hashmap *pids = NULL;
+        _cleanup_(exec_children_freep) Hashmap *pids = NULL;
         _cleanup_strv_free_ char **paths = NULL;
+        _cleanup_fclose_ FILE *timings = NULL;
         char **path, **e;
+        sigset_t mask;
         int r;
 
         /* We fork this all off from a child process so that we can somewhat cleanly make
@@ -95,10 +226,16 @@ static int do_execute(
         if (r < 0)
                 return log_error_errno(r, "Failed to enumerate executables: %m");
 
-        if (!callbacks) {
-                pids = hashmap_new(NULL);
-                if (!pids)
-                        return log_oom();
+        pids = hashmap_new(NULL);
+        if (!pids)
+                return log_oom();
+
+        if (timings_fd >= 0) {
+                timings = fdopen(timings_fd, "w");
+                if (!timings)
+                        return log_error_errno(errno, "Failed to open timings file: %m");
+
+                setvbuf(timings, NULL, _IOLBF, 0);
         }
 
         /* Abort execution of this process after the timout. We simply rely on SIGALRM as
@@ -107,17 +244,25 @@ static int do_execute(
         if (timeout != USEC_INFINITY)
                 alarm(DIV_ROUND_UP(timeout, USEC_PER_SEC));
 
+        assert_se(sigemptyset(&mask) >= 0);
+        assert_se(sigaddset(&mask, SIGCHLD) >= 0);
+        if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+                return log_error_errno(errno, "Failed to block SIGCHLD: %m");
+
         STRV_FOREACH(e, envp)
                 if (putenv(*e) != 0)
                         return log_error_errno(errno, "Failed to set environment variable: %m");
 
         STRV_FOREACH(path, paths) {
-                _cleanup_free_ char *t = NULL;
+                _cleanup_(exec_child_freep) ExecChild *c = NULL;
                 _cleanup_close_ int fd = -1;
-                pid_t pid;
 
-                t = strdup(*path);
-                if (!t)
+                c = new0(ExecChild, 1);
+                if (!c)
+                        return log_oom();
+
+                c->path = strdup(*path);
+                if (!c->path)
                         return log_oom();
 
                 if (callbacks) {
@@ -126,19 +271,21 @@ static int do_execute(
                                 return log_error_errno(fd, "Failed to open serialization file: %m");
                 }
 
-                r = do_spawn(t, argv, fd, &pid);
+                c->start = now(CLOCK_MONOTONIC);
+
+                r = do_spawn(c->path, argv, fd, &c->pid);
                 if (r <= 0)
                         continue;
 
-                if (pids) {
-                        r = hashmap_put(pids, PID_TO_PTR(pid), t);
-                        if (r < 0)
-                                return log_oom();
-                        t = NULL;
-                } else {
-                        r = wait_for_terminate_and_check(t, pid, WAIT_LOG);
+                r = hashmap_put(pids, PID_TO_PTR(c->pid), c);
+                if (r < 0)
+                        return log_oom();
+                c = NULL;
+
+                if (callbacks) {
+                        r = wait_for_children(pids, timeout_each, timings);
                         if (r < 0)
-                                continue;
+                                return r;
 
                         if (lseek(fd, 0, SEEK_SET) < 0)
                                 return log_error_errno(errno, "Failed to seek on serialization fd: %m");
@@ -156,36 +303,81 @@ static int do_execute(
                         return log_error_errno(r, "Callback two failed: %m");
         }
 
-        while (!hashmap_isempty(pids)) {
-                _cleanup_free_ char *t = NULL;
-                pid_t pid;
+        return wait_for_children(pids, timeout_each, timings);
+}
+
+static int read_timings(int fd, ExecTiming **ret, size_t *ret_n) {
+        _cleanup_fclose_ FILE *f = NULL;
+        ExecTiming *timings = NULL;
+        size_t n = 0, allocated = 0;
+        int r;
 
-                pid = PTR_TO_PID(hashmap_first_key(pids));
-                assert(pid > 0);
+        f = fdopen(fd, "r");
+        if (!f) {
+                safe_close(fd);
+                return -errno;
+        }
 
-                t = hashmap_remove(pids, PID_TO_PTR(pid));
-                assert(t);
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+                ExecTiming t = {};
+                int timed_out, k = 0;
 
-                (void) wait_for_terminate_and_check(t, pid, WAIT_LOG);
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        goto fail;
+                if (r == 0)
+                        break;
+
+                if (sscanf(line, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %i %i %i %n",
+                           &t.start, &t.wall, &t.cpu, &t.code, &t.status, &timed_out, &k) != 6 || k <= 0) {
+                        log_debug("Invalid timing line \"%s\", ignoring.", line);
+                        continue;
+                }
+
+                t.timed_out = timed_out;
+                t.path = strdup(line + k);
+                if (!t.path) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                if (!GREEDY_REALLOC(timings, allocated, n + 1)) {
+                        free(t.path);
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                timings[n++] = t;
         }
 
+        *ret = timings;
+        *ret_n = n;
         return 0;
+
+fail:
+        exec_timing_free_many(timings, n);
+        return r;
 }
 
-int execute_directories(
+int execute_directories_full(
                 const char* const* directories,
                 usec_t timeout,
+                usec_t timeout_each,
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 char *argv[],
-                char *envp[]) {
+                char *envp[],
+                ExecTiming **ret_timings,
+                size_t *ret_n_timings) {
 
         char **dirs = (char**) directories;
-        _cleanup_close_ int fd = -1;
+        _cleanup_close_ int fd = -1, timings_fd = -1;
         char *name;
         int r;
 
         assert(!strv_isempty(dirs));
+        assert(!ret_timings == !ret_n_timings);
 
         name = basename(dirs[0]);
         assert(!isempty(name));
@@ -201,18 +393,35 @@ int execute_directories(
                         return log_error_errno(fd, "Failed to open serialization file: %m");
         }
 
+        /* The executor reports how long each binary ran through this file, one line per binary */
+        if (ret_timings) {
+                timings_fd = open_serialization_fd("timings");
+                if (timings_fd < 0)
+                        return log_error_errno(timings_fd, "Failed to open serialization file: %m");
+        }
+
         /* Executes all binaries in the directories serially or in parallel and waits for
-         * them to finish. Optionally a timeout is applied. If a file with the same name
-         * exists in more than one directory, the earliest one wins. */
+         * them to finish. Optionally a timeout is applied, to all of them together and to
+         * each of them. If a file with the same name exists in more than one directory,
+         * the earliest one wins. */
 
         r = safe_fork("(sd-executor)", FORK_RESET_SIGNALS|FORK_DEATHSIG|FORK_LOG|FORK_WAIT, NULL);
         if (r < 0)
                 return r;
         if (r == 0) {
-                r = do_execute(dirs, timeout, callbacks, callback_args, fd, argv, envp);
+                r = do_execute(dirs, timeout, timeout_each, callbacks, callback_args, fd, timings_fd, argv, envp);
                 _exit(r < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
         }
 
+        if (ret_timings) {
+                if (lseek(timings_fd, 0, SEEK_SET) < 0)
+                        return log_error_errno(errno, "Failed to rewind timings fd: %m");
+
+                r = read_timings(TAKE_FD(timings_fd), ret_timings, ret_n_timings);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read timings: %m");
+        }
+
         if (!callbacks)
                 return 0;
 
@@ -226,6 +435,26 @@ int execute_directories(
         return 0;
 }
 
+int execute_directories(
+                const char* const* directories,
+                usec_t timeout,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[]) {
+
+        return execute_directories_full(directories, timeout, USEC_INFINITY, callbacks, callback_args, argv, envp, NULL, NULL);
+}
+
+void exec_timing_free_many(ExecTiming *t, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                free(t[i].path);
+
+        free(t);
+}
+
 static int gather_environment_generate(int fd, void *arg) {
         char ***env = arg, **x, **y;
         _cleanup_fclose_ FILE *f = NULL;
@@ -14,6 +14,30 @@ enum {
         _STDOUT_CONSUME_MAX,
 };
 
+/* How long one binary run by execute_directories_full() took */
+typedef struct ExecTiming {
+        char *path;
+        usec_t start;           /* CLOCK_MONOTONIC */
+        usec_t wall;
+        usec_t cpu;             /* user and system time, including children it waited for */
+        int code;               /* CLD_EXITED, CLD_KILLED or CLD_DUMPED */
+        int status;             /* exit status or signal */
+        bool timed_out;         /* killed because it took longer than timeout_each */
+} ExecTiming;
+
+void exec_timing_free_many(ExecTiming *t, size_t n);
+
+int execute_directories_full(
+                const char* const* directories,
+                usec_t timeout,
+                usec_t timeout_each,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecTiming **ret_timings,
+                size_t *ret_n_timings);
+
 int execute_directories(
                 const char* const* directories,
                 usec_t timeout,
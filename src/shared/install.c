@@ -23,6 +23,7 @@
 #include "hashmap.h"
 #include "install-printf.h"
 #include "install.h"
+#include "list.h"
 #include "locale-util.h"
 #include "log.h"
 #include "macro.h"
@@ -49,8 +50,22 @@ typedef enum SearchFlags {
 typedef struct {
         OrderedHashmap *will_process;
         OrderedHashmap *have_processed;
+
+        /* Template unit files already looked up for instances, indexed by template name */
+        Hashmap *templates;
 } InstallContext;
 
+/* What we found out about a template unit file while loading one of its instances, so that further instances of
+ * the same template neither need to search the unit path for it nor read it again. */
+typedef struct InstallTemplate {
+        char *name;
+        char *path;             /* NULL if the template is not in the search path */
+        UnitFileType type;
+        char *symlink_target;
+        char *contents;         /* The template file itself, if regular and not empty */
+        size_t size;
+} InstallTemplate;
+
 typedef enum {
         PRESET_UNKNOWN,
         PRESET_ENABLE,
@@ -451,9 +466,14 @@ static int create_symlink(
          * the right place, or negative on error.
          */
 
-        mkdir_parents_label(new_path, 0755);
-
-        if (symlink(old_path, new_path) >= 0) {
+        /* Most of the time we create many symlinks in few .wants/ directories, hence only create the parent
+         * directories if the first attempt tells us they are missing. */
+        r = symlink(old_path, new_path);
+        if (r < 0 && errno == ENOENT) {
+                mkdir_parents_label(new_path, 0755);
+                r = symlink(old_path, new_path);
+        }
+        if (r >= 0) {
                 unit_file_changes_add(changes, n_changes, UNIT_FILE_SYMLINK, new_path, old_path);
                 return 1;
         }
@@ -711,47 +731,112 @@ static int is_symlink_with_known_name(const UnitFileInstallInfo *i, const char *
         return false;
 }
 
-static int find_symlinks_fd(
-                const char *root_dir,
-                const UnitFileInstallInfo *i,
-                bool match_aliases,
-                bool ignore_same_name,
-                int fd,
-                const char *path,
-                const char *config_path,
-                bool *same_name_link) {
+/* Finding out whether a unit is enabled means looking for symlinks to it in all config directories. Instead of
+ * walking the directories again for each unit, they are read once and indexed by the name of the symlinks and by
+ * the name of what they point to, which is what we are matching against. */
 
-        _cleanup_closedir_ DIR *d = NULL;
+typedef struct SymlinkIndexEntry {
+        char *path; /* the symlink */
+        char *dest; /* what it points to, made absolute */
+
+        LIST_FIELDS(struct SymlinkIndexEntry, all);
+        LIST_FIELDS(struct SymlinkIndexEntry, by_name);
+        LIST_FIELDS(struct SymlinkIndexEntry, by_dest);
+} SymlinkIndexEntry;
+
+typedef struct SymlinkIndexDir {
+        char *config_path;
+        int error; /* the first error we ran into while reading the directory tree */
+
+        LIST_HEAD(SymlinkIndexEntry, entries);
+        Hashmap *by_name; /* symlink name → entries */
+        Hashmap *by_dest; /* name of the destination → entries */
+} SymlinkIndexDir;
+
+static SymlinkIndexDir* symlink_index_dir_free(SymlinkIndexDir *d) {
+        SymlinkIndexEntry *e;
+
+        if (!d)
+                return NULL;
+
+        while ((e = d->entries)) {
+                LIST_REMOVE(all, d->entries, e);
+                free(e->path);
+                free(e->dest);
+                free(e);
+        }
+
+        hashmap_free(d->by_name);
+        hashmap_free(d->by_dest);
+        free(d->config_path);
+        return mfree(d);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(SymlinkIndexDir*, symlink_index_dir_free);
+
+void symlink_index_free(SymlinkIndex *index) {
+        hashmap_free_with_destructor(index, symlink_index_dir_free);
+}
+
+static int symlink_index_dir_add(SymlinkIndexDir *d, char *path, char *dest) {
+        SymlinkIndexEntry *e, *head;
+        int r;
+
+        /* Takes possession of path and dest */
+
+        e = new(SymlinkIndexEntry, 1);
+        if (!e) {
+                free(path);
+                free(dest);
+                return -ENOMEM;
+        }
+
+        *e = (SymlinkIndexEntry) {
+                .path = path,
+                .dest = dest,
+        };
+
+        LIST_PREPEND(all, d->entries, e);
+
+        head = hashmap_get(d->by_name, basename(e->path));
+        LIST_PREPEND(by_name, head, e);
+        r = hashmap_replace(d->by_name, basename(e->path), head);
+        if (r < 0)
+                return r;
+
+        head = hashmap_get(d->by_dest, basename(e->dest));
+        LIST_PREPEND(by_dest, head, e);
+        return hashmap_replace(d->by_dest, basename(e->dest), head);
+}
+
+static int symlink_index_dir_read(SymlinkIndexDir *d, const char *root_dir, int fd, const char *path) {
+        _cleanup_closedir_ DIR *dir = NULL;
         struct dirent *de;
-        int r = 0;
+        int r;
 
-        assert(i);
-        assert(fd >= 0);
-        assert(path);
-        assert(config_path);
-        assert(same_name_link);
+        /* This takes possession of fd and closes it */
 
-        d = fdopendir(fd);
-        if (!d) {
+        dir = fdopendir(fd);
+        if (!dir) {
                 safe_close(fd);
                 return -errno;
         }
 
-        FOREACH_DIRENT(de, d, return -errno) {
+        FOREACH_DIRENT(de, dir, return -errno) {
 
-                dirent_ensure_type(d, de);
+                dirent_ensure_type(dir, de);
 
                 if (de->d_type == DT_DIR) {
                         _cleanup_free_ char *p = NULL;
-                        int nfd, q;
+                        int nfd;
 
                         nfd = openat(fd, de->d_name, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW);
                         if (nfd < 0) {
                                 if (errno == ENOENT)
                                         continue;
 
-                                if (r == 0)
-                                        r = -errno;
+                                if (d->error == 0)
+                                        d->error = -errno;
                                 continue;
                         }
 
@@ -761,18 +846,14 @@ static int find_symlinks_fd(
                                 return -ENOMEM;
                         }
 
-                        /* This will close nfd, regardless whether it succeeds or not */
-                        q = find_symlinks_fd(root_dir, i, match_aliases, ignore_same_name, nfd,
-                                             p, config_path, same_name_link);
-                        if (q > 0)
-                                return 1;
-                        if (r == 0)
-                                r = q;
+                        r = symlink_index_dir_read(d, root_dir, nfd, p);
+                        if (r == -ENOMEM)
+                                return r;
+                        if (r < 0 && d->error == 0)
+                                d->error = r;
 
                 } else if (de->d_type == DT_LNK) {
                         _cleanup_free_ char *p = NULL, *dest = NULL;
-                        bool found_path = false, found_dest, b = false;
-                        int q;
 
                         /* Acquire symlink name */
                         p = path_make_absolute(de->d_name, path);
@@ -780,12 +861,14 @@ static int find_symlinks_fd(
                                 return -ENOMEM;
 
                         /* Acquire symlink destination */
-                        q = readlink_malloc(p, &dest);
-                        if (q == -ENOENT)
+                        r = readlink_malloc(p, &dest);
+                        if (r == -ENOENT)
                                 continue;
-                        if (q < 0) {
-                                if (r == 0)
-                                        r = q;
+                        if (r == -ENOMEM)
+                                return r;
+                        if (r < 0) {
+                                if (d->error == 0)
+                                        d->error = r;
                                 continue;
                         }
 
@@ -800,47 +883,106 @@ static int find_symlinks_fd(
                                 free_and_replace(dest, x);
                         }
 
-                        assert(unit_name_is_valid(i->name, UNIT_NAME_ANY));
-                        if (!ignore_same_name)
-                                /* Check if the symlink itself matches what we are looking for.
-                                 *
-                                 * If ignore_same_name is specified, we are in one of the directories which
-                                 * have lower priority than the unit file, and even if a file or symlink with
-                                 * this name was found, we should ignore it. */
-                                 found_path = streq(de->d_name, i->name);
-
-                        /* Check if what the symlink points to matches what we are looking for */
-                        found_dest = streq(basename(dest), i->name);
-
-                        if (found_path && found_dest) {
-                                _cleanup_free_ char *t = NULL;
-
-                                /* Filter out same name links in the main
-                                 * config path */
-                                t = path_make_absolute(i->name, config_path);
-                                if (!t)
-                                        return -ENOMEM;
+                        r = symlink_index_dir_add(d, TAKE_PTR(p), TAKE_PTR(dest));
+                        if (r < 0)
+                                return r;
+                }
+        }
 
-                                b = path_equal(t, p);
-                        }
+        return 0;
+}
 
-                        if (b)
-                                *same_name_link = true;
-                        else if (found_path || found_dest) {
-                                if (!match_aliases)
-                                        return 1;
-
-                                /* Check if symlink name is in the set of names used by [Install] */
-                                q = is_symlink_with_known_name(i, de->d_name);
-                                if (q < 0)
-                                        return q;
-                                if (q > 0)
-                                        return 1;
-                        }
-                }
+static int symlink_index_get(SymlinkIndex **index, const char *root_dir, const char *config_path, SymlinkIndexDir **ret) {
+        _cleanup_(symlink_index_dir_freep) SymlinkIndexDir *d = NULL;
+        SymlinkIndexDir *found;
+        int fd, r;
+
+        assert(index);
+        assert(config_path);
+        assert(ret);
+
+        found = hashmap_get(*index, config_path);
+        if (found) {
+                *ret = found;
+                return 0;
         }
 
-        return r;
+        d = new0(SymlinkIndexDir, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->config_path = strdup(config_path);
+        if (!d->config_path)
+                return -ENOMEM;
+
+        d->by_name = hashmap_new(&string_hash_ops);
+        d->by_dest = hashmap_new(&string_hash_ops);
+        if (!d->by_name || !d->by_dest)
+                return -ENOMEM;
+
+        fd = open(config_path, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC);
+        if (fd < 0) {
+                if (!IN_SET(errno, ENOENT, ENOTDIR, EACCES))
+                        d->error = -errno;
+        } else {
+                r = symlink_index_dir_read(d, root_dir, fd, config_path);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0 && d->error == 0)
+                        d->error = r;
+        }
+
+        r = hashmap_ensure_allocated(index, &path_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(*index, d->config_path, d);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(d);
+        return 0;
+}
+
+static int find_symlinks_match(
+                const UnitFileInstallInfo *i,
+                const SymlinkIndexEntry *e,
+                bool match_aliases,
+                bool found_path,
+                const char *config_path,
+                bool *same_name_link) {
+
+        bool found_dest, b = false;
+        int r;
+
+        /* Check if what the symlink points to matches what we are looking for */
+        found_dest = streq(basename(e->dest), i->name);
+
+        if (found_path && found_dest) {
+                _cleanup_free_ char *t = NULL;
+
+                /* Filter out same name links in the main
+                 * config path */
+                t = path_make_absolute(i->name, config_path);
+                if (!t)
+                        return -ENOMEM;
+
+                b = path_equal(t, e->path);
+        }
+
+        if (b)
+                *same_name_link = true;
+        else if (found_path || found_dest) {
+                if (!match_aliases)
+                        return 1;
+
+                /* Check if symlink name is in the set of names used by [Install] */
+                r = is_symlink_with_known_name(i, basename(e->path));
+                if (r != 0)
+                        return r;
+        }
+
+        return 0;
 }
 
 static int find_symlinks(
@@ -849,24 +991,45 @@ static int find_symlinks(
                 bool match_name,
                 bool ignore_same_name,
                 const char *config_path,
+                SymlinkIndex **index,
                 bool *same_name_link) {
 
-        int fd;
+        SymlinkIndexDir *d;
+        SymlinkIndexEntry *e;
+        int r;
 
         assert(i);
         assert(config_path);
+        assert(index);
         assert(same_name_link);
 
-        fd = open(config_path, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC);
-        if (fd < 0) {
-                if (IN_SET(errno, ENOENT, ENOTDIR, EACCES))
-                        return 0;
-                return -errno;
+        assert(unit_name_is_valid(i->name, UNIT_NAME_ANY));
+
+        r = symlink_index_get(index, root_dir, config_path, &d);
+        if (r < 0)
+                return r;
+
+        /* Symlinks with the name we are looking for. If ignore_same_name is specified, we are in one of the
+         * directories which have lower priority than the unit file, and even if a file or symlink with this name
+         * was found, we should ignore it. */
+        LIST_FOREACH(by_name, e, (SymlinkIndexEntry*) hashmap_get(d->by_name, i->name)) {
+                r = find_symlinks_match(i, e, match_name, !ignore_same_name, config_path, same_name_link);
+                if (r != 0)
+                        return r;
         }
 
-        /* This takes possession of fd and closes it */
-        return find_symlinks_fd(root_dir, i, match_name, ignore_same_name, fd,
-                                config_path, config_path, same_name_link);
+        /* Symlinks pointing to something with the name we are looking for, the ones which also carry the name
+         * were looked at above already */
+        LIST_FOREACH(by_dest, e, (SymlinkIndexEntry*) hashmap_get(d->by_dest, i->name)) {
+                if (streq(basename(e->path), i->name))
+                        continue;
+
+                r = find_symlinks_match(i, e, match_name, false, config_path, same_name_link);
+                if (r != 0)
+                        return r;
+        }
+
+        return d->error;
 }
 
 static int find_symlinks_in_scope(
@@ -874,6 +1037,7 @@ static int find_symlinks_in_scope(
                 const LookupPaths *paths,
                 const UnitFileInstallInfo *i,
                 bool match_name,
+                SymlinkIndex **index,
                 UnitFileState *state) {
 
         bool same_name_link_runtime = false, same_name_link_config = false;
@@ -892,7 +1056,7 @@ static int find_symlinks_in_scope(
         STRV_FOREACH(p, paths->search_path)  {
                 bool same_name_link = false;
 
-                r = find_symlinks(paths->root_dir, i, match_name, ignore_same_name, *p, &same_name_link);
+                r = find_symlinks(paths->root_dir, i, match_name, ignore_same_name, *p, index, &same_name_link);
                 if (r < 0)
                         return r;
                 if (r > 0) {
@@ -980,11 +1144,25 @@ static void install_info_free(UnitFileInstallInfo *i) {
         free(i);
 }
 
+static InstallTemplate *install_template_free(InstallTemplate *t) {
+        if (!t)
+                return NULL;
+
+        free(t->name);
+        free(t->path);
+        free(t->symlink_target);
+        free(t->contents);
+        return mfree(t);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(InstallTemplate*, install_template_free);
+
 static void install_context_done(InstallContext *c) {
         assert(c);
 
         c->will_process = ordered_hashmap_free_with_destructor(c->will_process, install_info_free);
         c->have_processed = ordered_hashmap_free_with_destructor(c->have_processed, install_info_free);
+        c->templates = hashmap_free_with_destructor(c->templates, install_template_free);
 }
 
 static UnitFileInstallInfo *install_info_find(InstallContext *c, const char *name) {
@@ -1215,11 +1393,11 @@ static int config_parse_default_instance(
         return free_and_replace(i->default_instance, printed);
 }
 
-static int unit_file_load(
+static int unit_file_parse(
                 InstallContext *c,
                 UnitFileInstallInfo *info,
                 const char *path,
-                const char *root_dir,
+                FILE *f,
                 SearchFlags flags) {
 
         const ConfigTableItem items[] = {
@@ -1231,6 +1409,36 @@ static int unit_file_load(
                 {}
         };
 
+        int r;
+
+        assert(c);
+        assert(info);
+        assert(path);
+        assert(f);
+
+        r = config_parse(info->name, path, f,
+                         NULL,
+                         config_item_table_lookup, items,
+                         CONFIG_PARSE_RELAXED|CONFIG_PARSE_ALLOW_INCLUDE, info);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to parse %s: %m", info->name);
+
+        if ((flags & SEARCH_DROPIN) == 0)
+                info->type = UNIT_FILE_TYPE_REGULAR;
+
+        return
+                (int) strv_length(info->aliases) +
+                (int) strv_length(info->wanted_by) +
+                (int) strv_length(info->required_by);
+}
+
+static int unit_file_load(
+                InstallContext *c,
+                UnitFileInstallInfo *info,
+                const char *path,
+                const char *root_dir,
+                SearchFlags flags) {
+
         UnitType type;
         _cleanup_fclose_ FILE *f = NULL;
         _cleanup_close_ int fd = -1;
@@ -1303,22 +1511,7 @@ static int unit_file_load(
         fd = -1;
 
         /* c is only needed if we actually load the file (it's referenced from items[] btw, in case you wonder.) */
-        assert(c);
-
-        r = config_parse(info->name, path, f,
-                         NULL,
-                         config_item_table_lookup, items,
-                         CONFIG_PARSE_RELAXED|CONFIG_PARSE_ALLOW_INCLUDE, info);
-        if (r < 0)
-                return log_debug_errno(r, "Failed to parse %s: %m", info->name);
-
-        if ((flags & SEARCH_DROPIN) == 0)
-                info->type = UNIT_FILE_TYPE_REGULAR;
-
-        return
-                (int) strv_length(info->aliases) +
-                (int) strv_length(info->wanted_by) +
-                (int) strv_length(info->required_by);
+        return unit_file_parse(c, info, path, f, flags);
 }
 
 static int unit_file_load_or_readlink(
@@ -1389,6 +1582,139 @@ static int unit_file_load_or_readlink(
         return 0;
 }
 
+static int install_template_load(
+                InstallContext *c,
+                UnitFileInstallInfo *info,
+                const InstallTemplate *t) {
+
+        _cleanup_fclose_ FILE *f = NULL;
+
+        assert(c);
+        assert(info);
+        assert(t);
+
+        if (!t->path)
+                return -ENOENT;
+
+        info->path = strdup(t->path);
+        if (!info->path)
+                return -ENOMEM;
+
+        switch (t->type) {
+
+        case UNIT_FILE_TYPE_SYMLINK:
+                info->symlink_target = strdup(t->symlink_target);
+                if (!info->symlink_target)
+                        return -ENOMEM;
+
+                _fallthrough_;
+        case UNIT_FILE_TYPE_MASKED:
+                info->type = t->type;
+                return 0;
+
+        case UNIT_FILE_TYPE_REGULAR:
+                f = fmemopen(t->contents, t->size, "re");
+                if (!f)
+                        return -errno;
+
+                return unit_file_parse(c, info, t->path, f, 0);
+
+        default:
+                assert_not_reached("Unexpected unit file type");
+        }
+}
+
+static int install_template_search(
+                InstallContext *c,
+                UnitFileInstallInfo *info,
+                const char *template,
+                const LookupPaths *paths,
+                SearchFlags flags) {
+
+        _cleanup_(install_template_freep) InstallTemplate *t = NULL;
+        InstallTemplate *cached;
+        char **p;
+        int r, result = -ENOENT;
+
+        assert(info);
+        assert(template);
+        assert(paths);
+
+        /* When many instances of the same template are enabled at once, the template is searched for and read only
+         * for the first one. Its [Install] section is still parsed for each instance, as specifiers in it expand
+         * differently. */
+
+        if (flags & SEARCH_LOAD) {
+                cached = hashmap_get(c->templates, template);
+                if (cached)
+                        return install_template_load(c, info, cached);
+        }
+
+        STRV_FOREACH(p, paths->search_path) {
+                _cleanup_free_ char *path = NULL;
+
+                path = strjoin(*p, "/", template);
+                if (!path)
+                        return -ENOMEM;
+
+                r = unit_file_load_or_readlink(c, info, path, paths->root_dir, flags);
+                if (r >= 0) {
+                        info->path = TAKE_PTR(path);
+                        result = r;
+                        break;
+                } else if (!IN_SET(r, -ENOENT, -ENOTDIR, -EACCES))
+                        return r;
+        }
+
+        /* c is only around if we actually load the file, and only then there is anything to remember */
+        if (!(flags & SEARCH_LOAD))
+                return result;
+
+        assert(c);
+
+        t = new0(InstallTemplate, 1);
+        if (!t)
+                return -ENOMEM;
+
+        t->name = strdup(template);
+        if (!t->name)
+                return -ENOMEM;
+
+        if (result >= 0) {
+                t->path = strdup(info->path);
+                if (!t->path)
+                        return -ENOMEM;
+
+                t->type = info->type;
+
+                if (info->symlink_target) {
+                        t->symlink_target = strdup(info->symlink_target);
+                        if (!t->symlink_target)
+                                return -ENOMEM;
+                }
+
+                if (t->type == UNIT_FILE_TYPE_REGULAR) {
+                        r = read_full_file(t->path, &t->contents, &t->size);
+                        if (r < 0) {
+                                /* Don't fail the operation just because we can't cache the file */
+                                log_debug_errno(r, "Failed to read %s again, not caching it: %m", t->path);
+                                return result;
+                        }
+                }
+        }
+
+        r = hashmap_ensure_allocated(&c->templates, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(c->templates, t->name, t);
+        if (r < 0)
+                return r;
+        TAKE_PTR(t);
+
+        return result;
+}
+
 static int unit_file_search(
                 InstallContext *c,
                 UnitFileInstallInfo *info,
@@ -1443,22 +1769,12 @@ static int unit_file_search(
                  * enablement was requested.  We will check if it is
                  * possible to load template unit file. */
 
-                STRV_FOREACH(p, paths->search_path) {
-                        _cleanup_free_ char *path = NULL;
-
-                        path = strjoin(*p, "/", template);
-                        if (!path)
-                                return -ENOMEM;
-
-                        r = unit_file_load_or_readlink(c, info, path, paths->root_dir, flags);
-                        if (r >= 0) {
-                                info->path = TAKE_PTR(path);
-                                result = r;
-                                found_unit = true;
-                                break;
-                        } else if (!IN_SET(r, -ENOENT, -ENOTDIR, -EACCES))
-                                return r;
-                }
+                r = install_template_search(c, info, template, paths, flags);
+                if (r >= 0) {
+                        result = r;
+                        found_unit = true;
+                } else if (r != -ENOENT)
+                        return r;
         }
 
         if (!found_unit)
@@ -2656,10 +2972,11 @@ int unit_file_get_default(
         return 0;
 }
 
-int unit_file_lookup_state(
+static int unit_file_lookup_state_internal(
                 UnitFileScope scope,
                 const LookupPaths *paths,
                 const char *name,
+                SymlinkIndex **index,
                 UnitFileState *ret) {
 
         _cleanup_(install_context_done) InstallContext c = {};
@@ -2716,7 +3033,7 @@ int unit_file_lookup_state(
                 /* Check if any of the Alias= symlinks have been created.
                  * We ignore other aliases, and only check those that would
                  * be created by systemctl enable for this unit. */
-                r = find_symlinks_in_scope(scope, paths, i, true, &state);
+                r = find_symlinks_in_scope(scope, paths, i, true, index, &state);
                 if (r < 0)
                         return r;
                 if (r > 0)
@@ -2724,7 +3041,7 @@ int unit_file_lookup_state(
 
                 /* Check if the file is known under other names. If it is,
                  * it might be in use. Report that as UNIT_FILE_INDIRECT. */
-                r = find_symlinks_in_scope(scope, paths, i, false, &state);
+                r = find_symlinks_in_scope(scope, paths, i, false, index, &state);
                 if (r < 0)
                         return r;
                 if (r > 0)
@@ -2748,6 +3065,32 @@ int unit_file_lookup_state(
         return 0;
 }
 
+int unit_file_lookup_state(
+                UnitFileScope scope,
+                const LookupPaths *paths,
+                const char *name,
+                UnitFileState *ret) {
+
+        _cleanup_(symlink_index_freep) SymlinkIndex *index = NULL;
+
+        return unit_file_lookup_state_internal(scope, paths, name, &index, ret);
+}
+
+int unit_file_lookup_state_indexed(
+                UnitFileScope scope,
+                const LookupPaths *paths,
+                const char *name,
+                SymlinkIndex **index,
+                UnitFileState *ret) {
+
+        assert(index);
+
+        /* Like unit_file_lookup_state(), but keeps the symlinks read from the config directories in *index, to be
+         * reused for the next unit. */
+
+        return unit_file_lookup_state_internal(scope, paths, name, index, ret);
+}
+
 int unit_file_get_state(
                 UnitFileScope scope,
                 const char *root_dir,
@@ -3277,6 +3620,7 @@ int unit_file_get_list(
                 char **patterns) {
 
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
+        _cleanup_(symlink_index_freep) SymlinkIndex *index = NULL;
         char **i;
         int r;
 
@@ -3329,7 +3673,7 @@ int unit_file_get_list(
                         if (!f->path)
                                 return -ENOMEM;
 
-                        r = unit_file_lookup_state(scope, &paths, de->d_name, &f->state);
+                        r = unit_file_lookup_state_indexed(scope, &paths, de->d_name, &index, &f->state);
                         if (r < 0)
                                 f->state = UNIT_FILE_BAD;
 
@@ -207,6 +207,19 @@ int unit_file_lookup_state(
                 const char *name,
                 UnitFileState *ret);
 
+/* The symlinks found in config directories while looking up unit file states, by config directory */
+typedef Hashmap SymlinkIndex;
+
+void symlink_index_free(SymlinkIndex *index);
+DEFINE_TRIVIAL_CLEANUP_FUNC(SymlinkIndex*, symlink_index_free);
+
+int unit_file_lookup_state_indexed(
+                UnitFileScope scope,
+                const LookupPaths *paths,
+                const char *name,
+                SymlinkIndex **index,
+                UnitFileState *ret);
+
 int unit_file_get_state(UnitFileScope scope, const char *root_dir, const char *filename, UnitFileState *ret);
 int unit_file_exists(UnitFileScope scope, const LookupPaths *paths, const char *name);
 
@@ -38,11 +38,27 @@ static void iovw_free_contents(struct iovec_wrapper *iovw) {
         iovw->size_bytes = iovw->count = 0;
 }
 
-static void iovw_rebase(struct iovec_wrapper *iovw, char *old, char *new) {
+static void iovw_rebase(struct iovec_wrapper *iovw, char *old, size_t old_size, char *new) {
         size_t i;
 
-        for (i = 0; i < iovw->count; i++)
+        for (i = 0; i < iovw->count; i++) {
+                uintptr_t p = (uintptr_t) iovw->iovec[i].iov_base;
+
+                /* Fields referenced from a slot don't live in the buffer */
+                if (p < (uintptr_t) old || p >= (uintptr_t) old + old_size)
+                        continue;
+
                 iovw->iovec[i].iov_base = (char*) iovw->iovec[i].iov_base - old + new;
+        }
+}
+
+static void iovw_free_contents_and_data(struct iovec_wrapper *iovw) {
+        size_t i;
+
+        for (i = 0; i < iovw->count; i++)
+                free(iovw->iovec[i].iov_base);
+
+        iovw_free_contents(iovw);
 }
 
 size_t iovw_size(struct iovec_wrapper *iovw) {
@@ -63,16 +79,26 @@ void journal_importer_cleanup(JournalImporter *imp) {
         free(imp->name);
         free(imp->buf);
         iovw_free_contents(&imp->iovw);
+
+        if (imp->slots) {
+                size_t i;
+
+                for (i = 0; i < DATA_REFERENCE_SLOTS; i++)
+                        free(imp->slots[i].iov_base);
+                imp->slots = mfree(imp->slots);
+        }
+        iovw_free_contents_and_data(&imp->retired);
 }
 
 static char* realloc_buffer(JournalImporter *imp, size_t size) {
         char *b, *old = imp->buf;
+        size_t old_size = imp->size;
 
         b = GREEDY_REALLOC(imp->buf, imp->size, size);
         if (!b)
                 return NULL;
 
-        iovw_rebase(&imp->iovw, old, imp->buf);
+        iovw_rebase(&imp->iovw, old, old_size, imp->buf);
 
         return b;
 }
@@ -311,6 +337,69 @@ static int process_special_field(JournalImporter *imp, char *line) {
         return 0;
 }
 
+static int store_slot(JournalImporter *imp, unsigned slot, const void *data, size_t size) {
+        char *copy;
+        int r;
+
+        assert(imp);
+        assert(slot < DATA_REFERENCE_SLOTS);
+
+        if (!imp->slots) {
+                imp->slots = new0(struct iovec, DATA_REFERENCE_SLOTS);
+                if (!imp->slots)
+                        return log_oom();
+        }
+
+        /* Keep a trailing NUL, so that text fields can be passed to process_special_field() */
+        copy = memdup_suffix0(data, size);
+        if (!copy)
+                return log_oom();
+
+        /* The entry being assembled might still refer to the old contents, hence free them only once the entry
+         * has been dropped */
+        if (imp->slots[slot].iov_base) {
+                r = iovw_put(&imp->retired, imp->slots[slot].iov_base, imp->slots[slot].iov_len);
+                if (r < 0) {
+                        free(copy);
+                        return r;
+                }
+        }
+
+        imp->slots[slot] = IOVEC_MAKE(copy, size);
+        return 0;
+}
+
+static int process_reference_line(JournalImporter *imp, char *line) {
+        unsigned slot;
+        int r;
+
+        assert(imp);
+        assert(line);
+        assert(IN_SET(line[0], '&', '*'));
+
+        r = safe_atou(line + 1, &slot);
+        if (r < 0 || slot >= DATA_REFERENCE_SLOTS)
+                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Invalid data reference slot '%s'.", line + 1);
+
+        if (line[0] == '&') {
+                /* The next field is to be stored in the slot */
+                imp->slot_pending = true;
+                imp->slot = slot;
+                return 0;
+        }
+
+        if (!imp->slots || !imp->slots[slot].iov_base)
+                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Reference to undefined data slot %u.", slot);
+
+        r = process_special_field(imp, imp->slots[slot].iov_base);
+        if (r != 0)
+                return r < 0 ? r : 0;
+
+        return iovw_put(&imp->iovw, imp->slots[slot].iov_base, imp->slots[slot].iov_len);
+}
+
 int journal_importer_process_data(JournalImporter *imp) {
         int r;
 
@@ -340,9 +429,23 @@ int journal_importer_process_data(JournalImporter *imp) {
                    or
                    COREDUMP\n
                    LLLLLLLL0011223344...\n
+                   or, in streams with back-references,
+                   &SLOT\n
+                   MESSAGE=xxx\n
+                   or
+                   *SLOT\n
                 */
                 sep = memchr(line, '=', n);
+                if (!sep && imp->references && IN_SET(line[0], '&', '*')) {
+                        line[n-1] = '\0';
+                        return process_reference_line(imp, line);
+                }
+
                 if (sep) {
+                        bool store = imp->slot_pending;
+
+                        imp->slot_pending = false;
+
                         /* chomp newline */
                         n--;
 
@@ -364,6 +467,12 @@ int journal_importer_process_data(JournalImporter *imp) {
                         r = iovw_put(&imp->iovw, line, n);
                         if (r < 0)
                                 return r;
+
+                        if (store) {
+                                r = store_slot(imp, imp->slot, line, n);
+                                if (r < 0)
+                                        return r;
+                        }
                 } else {
                         /* replace \n with = */
                         line[n-1] = '=';
@@ -420,6 +529,14 @@ int journal_importer_process_data(JournalImporter *imp) {
                 if (r < 0)
                         return r;
 
+                if (imp->slot_pending) {
+                        imp->slot_pending = false;
+
+                        r = store_slot(imp, imp->slot, field + sizeof(uint64_t), imp->field_len + imp->data_size);
+                        if (r < 0)
+                                return r;
+                }
+
                 imp->state = IMPORTER_STATE_DATA_FINISH;
 
                 return 0; /* continue */
@@ -436,6 +553,7 @@ int journal_importer_process_data(JournalImporter *imp) {
                 }
 
                 imp->data_size = 0;
+                imp->slot_pending = false;
                 imp->state = IMPORTER_STATE_LINE;
 
                 return 0; /* continue */
@@ -467,6 +585,7 @@ void journal_importer_drop_iovw(JournalImporter *imp) {
         /* This function drops processed data that along with the iovw that points at it */
 
         iovw_free_contents(&imp->iovw);
+        iovw_free_contents_and_data(&imp->retired);
 
         /* possibly reset buffer position */
         remain = imp->filled - imp->offset;
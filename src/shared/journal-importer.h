@@ -24,6 +24,9 @@
 /* The maximum number of fields in an entry */
 #define ENTRY_FIELD_COUNT_MAX 1024
 
+/* The number of slots for fields that later entries of a stream with back-references may refer to */
+#define DATA_REFERENCE_SLOTS 1024
+
 struct iovec_wrapper {
         struct iovec *iovec;
         size_t size_bytes;
@@ -48,6 +51,14 @@ typedef struct JournalImporter {
 
         struct iovec_wrapper iovw;
 
+        /* Streams with back-references may store fields in numbered slots, and refer to them in later entries
+         * instead of sending them again */
+        bool references;
+        bool slot_pending; /* store the field being read in the slot below */
+        unsigned slot;
+        struct iovec *slots;
+        struct iovec_wrapper retired; /* replaced slot contents the current entry might still point to */
+
         int state;
         dual_timestamp ts;
         sd_id128_t boot_id;
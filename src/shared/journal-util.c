@@ -1,13 +1,20 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <endian.h>
+#include <stdio.h>
+
 #include "acl-util.h"
+#include "alloc-util.h"
 #include "fs-util.h"
 #include "hashmap.h"
+#include "io-util.h"
 #include "journal-internal.h"
 #include "journal-util.h"
 #include "log.h"
+#include "string-util.h"
 #include "strv.h"
 #include "user-util.h"
+#include "utf8.h"
 
 static int access_check_var_log_journal(sd_journal *j, bool want_other_users) {
 #if HAVE_ACL
@@ -172,3 +179,244 @@ bool journal_field_valid(const char *p, size_t l, bool allow_protected) {
 
         return true;
 }
+
+int journal_cursor_get_seqnum(const char *cursor, size_t n, sd_id128_t *ret_seqnum_id, uint64_t *ret_seqnum) {
+        bool have_seqnum_id = false, have_seqnum = false;
+        _cleanup_free_ char *c = NULL;
+        const char *word, *state;
+        size_t l;
+
+        assert(cursor);
+        assert(ret_seqnum_id);
+        assert(ret_seqnum);
+
+        /* Extracts the sequence number and its ID from the first n bytes of a cursor string */
+
+        c = strndup(cursor, n);
+        if (!c)
+                return -ENOMEM;
+
+        FOREACH_WORD_SEPARATOR(word, l, c, ";", state) {
+                _cleanup_free_ char *item = NULL;
+                unsigned long long seqnum;
+
+                item = strndup(word, l);
+                if (!item)
+                        return -ENOMEM;
+
+                if (startswith(item, "s=")) {
+                        if (sd_id128_from_string(item + 2, ret_seqnum_id) < 0)
+                                return -EINVAL;
+                        have_seqnum_id = true;
+
+                } else if (startswith(item, "i=")) {
+                        if (sscanf(item + 2, "%llx", &seqnum) != 1)
+                                return -EINVAL;
+                        *ret_seqnum = seqnum;
+                        have_seqnum = true;
+                }
+        }
+
+        return have_seqnum_id && have_seqnum ? 0 : -EINVAL;
+}
+
+size_t journal_export_entry_size(const char *p, size_t n) {
+        size_t i = 0;
+
+        assert(p || n == 0);
+
+        /* Returns the size of the first complete entry in Journal Export Format in the buffer, or 0 if there is
+         * none yet. */
+
+        for (;;) {
+                const char *e;
+                uint64_t le64;
+                size_t l;
+
+                e = memchr(p + i, '\n', n - i);
+                if (!e)
+                        return 0;
+
+                l = e - (p + i);
+                if (l == 0)
+                        return i + 1;
+
+                if (memchr(p + i, '=', l)) {
+                        i += l + 1;
+                        continue;
+                }
+
+                /* A binary field: the name, the little-endian size, the data, and a newline */
+                i += l + 1;
+                if (n - i < sizeof(le64))
+                        return 0;
+
+                memcpy(&le64, p + i, sizeof(le64));
+                i += sizeof(le64);
+
+                if (le64toh(le64) >= n - i)
+                        return 0;
+
+                i += le64toh(le64) + 1;
+        }
+}
+
+void journal_export_stream_done(JournalExportStream *s) {
+        assert(s);
+
+        s->header = mfree(s->header);
+        s->in_entry = false;
+        s->n_iov = s->iov_idx = s->iov_pos = 0;
+}
+
+/* Starts serializing the current entry of the journal. */
+int journal_export_stream_begin(JournalExportStream *s, sd_journal *j) {
+        _cleanup_free_ char *cursor = NULL;
+        usec_t realtime, monotonic;
+        sd_id128_t boot_id;
+        char sid[SD_ID128_STRING_MAX];
+        int r;
+
+        assert(s);
+        assert(j);
+
+        /* Same as output_export() */
+        sd_journal_set_data_threshold(j, 0);
+
+        r = sd_journal_get_realtime_usec(j, &realtime);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+
+        r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+        r = sd_journal_get_cursor(j, &cursor);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cursor: %m");
+
+        s->header = mfree(s->header);
+        if (asprintf(&s->header,
+                     "__CURSOR=%s\n"
+                     "__REALTIME_TIMESTAMP="USEC_FMT"\n"
+                     "__MONOTONIC_TIMESTAMP="USEC_FMT"\n"
+                     "_BOOT_ID=%s\n",
+                     cursor,
+                     realtime,
+                     monotonic,
+                     sd_id128_to_string(boot_id, sid)) < 0) {
+                s->header = NULL;
+                return log_oom();
+        }
+
+        sd_journal_restart_data(j);
+
+        s->iov[0] = IOVEC_MAKE_STRING(s->header);
+        s->n_iov = 1;
+        s->iov_idx = s->iov_pos = 0;
+        s->in_entry = true;
+
+        return 0;
+}
+
+/* Sets up the iovecs for the next field of the entry, or for the empty line terminating it */
+static int journal_export_stream_next(JournalExportStream *s, sd_journal *j) {
+        const void *data;
+        size_t length;
+        int r;
+
+        assert(s);
+        assert(j);
+        assert(s->in_entry);
+
+        s->n_iov = s->iov_idx = s->iov_pos = 0;
+
+        for (;;) {
+                const char *c;
+                size_t l;
+
+                r = sd_journal_enumerate_data(j, &data, &length);
+                if (r == -EBADMSG) {
+                        /* Like output_export(), end the entry without the empty line */
+                        log_debug_errno(r, "Skipping message we can't read: %m");
+                        s->in_entry = false;
+                        return 0;
+                }
+                if (r < 0)
+                        return log_error_errno(r, "Failed to move to next field in entry: %m");
+                if (r == 0) {
+                        s->iov[s->n_iov++] = IOVEC_MAKE_STRING("\n");
+                        s->in_entry = false;
+                        return 0;
+                }
+
+                /* We already sent the boot id from the data in the header, hence let's suppress it here */
+                if (memory_startswith(data, length, "_BOOT_ID="))
+                        continue;
+
+                c = memchr(data, '=', length);
+                if (!c)
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Invalid field.");
+
+                if (utf8_is_printable_newline(data, length, false))
+                        s->iov[s->n_iov++] = IOVEC_MAKE((void*) data, length);
+                else {
+                        l = c - (const char*) data;
+                        s->le64 = htole64(length - l - 1);
+
+                        s->iov[s->n_iov++] = IOVEC_MAKE((void*) data, l);
+                        s->iov[s->n_iov++] = IOVEC_MAKE_STRING("\n");
+                        s->iov[s->n_iov++] = IOVEC_MAKE(&s->le64, sizeof(s->le64));
+                        s->iov[s->n_iov++] = IOVEC_MAKE((char*) c + 1, length - l - 1);
+                }
+
+                s->iov[s->n_iov++] = IOVEC_MAKE_STRING("\n");
+                return 0;
+        }
+}
+
+/* Copies as much of the entry as fits into the buffer. Returns > 0 if some of it is left, 0 if it was read
+ * completely. */
+int journal_export_stream_read(JournalExportStream *s, sd_journal *j, void *buf, size_t max, size_t *ret) {
+        size_t n = 0;
+        int r;
+
+        assert(s);
+        assert(j);
+        assert(buf || max == 0);
+        assert(ret);
+
+        for (;;) {
+                struct iovec *v;
+                size_t k;
+
+                if (s->iov_idx >= s->n_iov) {
+                        if (!s->in_entry)
+                                break;
+
+                        r = journal_export_stream_next(s, j);
+                        if (r < 0)
+                                return r;
+
+                        continue;
+                }
+
+                if (n >= max)
+                        break;
+
+                v = s->iov + s->iov_idx;
+
+                k = MIN(v->iov_len - s->iov_pos, max - n);
+                memcpy((uint8_t*) buf + n, (const uint8_t*) v->iov_base + s->iov_pos, k);
+                n += k;
+                s->iov_pos += k;
+
+                if (s->iov_pos >= v->iov_len) {
+                        s->iov_idx++;
+                        s->iov_pos = 0;
+                }
+        }
+
+        *ret = n;
+        return s->in_entry || s->iov_idx < s->n_iov;
+}
@@ -2,10 +2,32 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
+#include "sd-id128.h"
 #include "sd-journal.h"
 
 bool journal_field_valid(const char *p, size_t l, bool allow_protected);
 
 int journal_access_check_and_warn(sd_journal *j, bool quiet, bool want_other_users);
+
+int journal_cursor_get_seqnum(const char *cursor, size_t n, sd_id128_t *ret_seqnum_id, uint64_t *ret_seqnum);
+
+size_t journal_export_entry_size(const char *p, size_t n);
+
+/* Serializes journal entries in the export format into buffers supplied by the caller, piece by piece. The data of
+ * the fields is referenced, not copied, hence an entry needs to be read completely before the journal is moved on
+ * or anything else is enumerated. */
+typedef struct JournalExportStream {
+        bool in_entry;
+        char *header;
+        uint64_t le64;
+        struct iovec iov[5];
+        size_t n_iov, iov_idx, iov_pos;
+} JournalExportStream;
+
+void journal_export_stream_done(JournalExportStream *s);
+int journal_export_stream_begin(JournalExportStream *s, sd_journal *j);
+int journal_export_stream_read(JournalExportStream *s, sd_journal *j, void *buf, size_t max, size_t *ret);
@@ -70,6 +70,9 @@ struct JsonVariant {
         /* While comparing two arrays, we use this for marking what we already have seen */
         bool is_marked:1;
 
+        /* Whether this object is followed by a sorted index of its keys, see OBJECT_KEY_INDEX_MIN below */
+        bool has_key_index:1;
+
         /* The current 'depth' of the JsonVariant, i.e. how many levels of member variants this has */
         uint16_t depth;
 
@@ -109,6 +112,10 @@ assert_cc(sizeof(JsonVariant) == 48U);
 assert_cc(INLINE_STRING_MAX == 15U);
 #endif
 
+/* Objects with at least this many keys get an index of their keys, sorted by name, appended after their elements, so
+ * that json_variant_by_key() can do a binary search instead of a linear scan. */
+#define OBJECT_KEY_INDEX_MIN 16U
+
 static JsonSource* json_source_new(const char *name) {
         JsonSource *s;
 
@@ -596,8 +603,28 @@ int json_variant_new_array_strv(JsonVariant **ret, char **l) {
         return 0;
 }
 
+static size_t *json_variant_key_index(JsonVariant *v) {
+        return (size_t*) (v + 1 + v->n_elements);
+}
+
+static const char *object_key_at(JsonVariant *v, size_t idx) {
+        return json_variant_string(json_variant_dereference(v + 1 + idx));
+}
+
+static int object_key_index_compare(const size_t *a, const size_t *b, JsonVariant *v) {
+        int r;
+
+        r = strcmp(object_key_at(v, *a), object_key_at(v, *b));
+        if (r != 0)
+                return r;
+
+        /* Keep duplicate keys in their original order, so that the first one is found, as with the linear scan */
+        return CMP(*a, *b);
+}
+
 int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        bool with_index;
 
         assert_return(ret, -EINVAL);
         if (n == 0) {
@@ -607,7 +634,12 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
         assert_return(array, -EINVAL);
         assert_return(n % 2 == 0, -EINVAL);
 
-        v = new(JsonVariant, n + 1);
+        with_index = n / 2 >= OBJECT_KEY_INDEX_MIN;
+
+        if (n >= (SIZE_MAX - sizeof(JsonVariant)) / (sizeof(JsonVariant) + sizeof(size_t)))
+                return -ENOMEM;
+
+        v = malloc(sizeof(JsonVariant) * (n + 1) + (with_index ? sizeof(size_t) * (n / 2) : 0));
         if (!v)
                 return -ENOMEM;
 
@@ -640,6 +672,16 @@ int json_variant_new_object(JsonVariant **ret, JsonVariant **array, size_t n) {
                 json_variant_copy_source(w, c);
         }
 
+        if (with_index) {
+                size_t *index = json_variant_key_index(v), i;
+
+                for (i = 0; i < n / 2; i++)
+                        index[i] = i * 2;
+
+                typesafe_qsort_r(index, n / 2, object_key_index_compare, v);
+                v->has_key_index = true;
+        }
+
         *ret = TAKE_PTR(v);
         return 0;
 }
@@ -1083,7 +1125,29 @@ JsonVariant *json_variant_by_key_full(JsonVariant *v, const char *key, JsonVaria
         if (v->type != JSON_VARIANT_OBJECT)
                 goto mismatch;
         if (v->is_reference)
-                return json_variant_by_key(v->reference, key);
+                return json_variant_by_key_full(v->reference, key, ret_key);
+
+        if (v->has_key_index) {
+                size_t *index = json_variant_key_index(v), lo = 0, hi = v->n_elements / 2;
+
+                /* Find the first entry not sorting before the key */
+                while (lo < hi) {
+                        size_t mid = lo + (hi - lo) / 2;
+
+                        if (strcmp(object_key_at(v, index[mid]), key) < 0)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+
+                if (lo >= v->n_elements / 2 || !streq(object_key_at(v, index[lo]), key))
+                        goto not_found;
+
+                if (ret_key)
+                        *ret_key = json_variant_conservative_normalize(v + 1 + index[lo]);
+
+                return json_variant_conservative_normalize(v + 1 + index[lo] + 1);
+        }
 
         for (i = 0; i < v->n_elements; i += 2) {
                 JsonVariant *p;
@@ -1291,133 +1355,141 @@ static int print_source(FILE *f, JsonVariant *v, JsonFormatFlags flags, bool whi
         return 0;
 }
 
-static int json_format(FILE *f, JsonVariant *v, JsonFormatFlags flags, const char *prefix) {
-        int r;
+static int json_format_real(FILE *f, long double d, JsonFormatFlags flags) {
+        locale_t loc;
 
-        assert(f);
-        assert(v);
+        loc = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+        if (loc == (locale_t) 0)
+                return -errno;
 
-        switch (json_variant_type(v)) {
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_HIGHLIGHT_BLUE, f);
 
-        case JSON_VARIANT_REAL: {
-                locale_t loc;
+        fprintf(f, "%.*Le", DECIMAL_DIG, d);
 
-                loc = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
-                if (loc == (locale_t) 0)
-                        return -errno;
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT_BLUE, f);
+        freelocale(loc);
+        return 0;
+}
 
-                fprintf(f, "%.*Le", DECIMAL_DIG, json_variant_real(v));
+static void json_format_integer(FILE *f, intmax_t i, JsonFormatFlags flags) {
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_HIGHLIGHT_BLUE, f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
+        fprintf(f, "%" PRIdMAX, i);
 
-                freelocale(loc);
-                break;
-        }
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
 
-        case JSON_VARIANT_INTEGER:
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT_BLUE, f);
+static void json_format_unsigned(FILE *f, uintmax_t u, JsonFormatFlags flags) {
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_HIGHLIGHT_BLUE, f);
 
-                fprintf(f, "%" PRIdMAX, json_variant_integer(v));
+        fprintf(f, "%" PRIuMAX, u);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
-                break;
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
 
-        case JSON_VARIANT_UNSIGNED:
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT_BLUE, f);
+static void json_format_literal(FILE *f, const char *literal, JsonFormatFlags flags) {
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_HIGHLIGHT, f);
 
-                fprintf(f, "%" PRIuMAX, json_variant_unsigned(v));
+        fputs(literal, f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
-                break;
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
 
-        case JSON_VARIANT_BOOLEAN:
+static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
+        fputc('"', f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT, f);
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_GREEN, f);
 
-                if (json_variant_boolean(v))
-                        fputs("true", f);
-                else
-                        fputs("false", f);
+        for (; *q; q++) {
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
+                switch (*q) {
 
-                break;
+                case '"':
+                        fputs("\\\"", f);
+                        break;
 
-        case JSON_VARIANT_NULL:
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT, f);
+                case '\\':
+                        fputs("\\\\", f);
+                        break;
 
-                fputs("null", f);
+                case '\b':
+                        fputs("\\b", f);
+                        break;
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
-                break;
+                case '\f':
+                        fputs("\\f", f);
+                        break;
 
-        case JSON_VARIANT_STRING: {
-                const char *q;
+                case '\n':
+                        fputs("\\n", f);
+                        break;
 
-                fputc('"', f);
+                case '\r':
+                        fputs("\\r", f);
+                        break;
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_GREEN, f);
+                case '\t':
+                        fputs("\\t", f);
+                        break;
 
-                for (q = json_variant_string(v); *q; q++) {
+                default:
+                        if ((signed char) *q >= 0 && *q < ' ')
+                                fprintf(f, "\\u%04x", *q);
+                        else
+                                fputc(*q, f);
+                        break;
+                }
+        }
 
-                        switch (*q) {
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
 
-                        case '"':
-                                fputs("\\\"", f);
-                                break;
+        fputc('"', f);
+}
 
-                        case '\\':
-                                fputs("\\\\", f);
-                                break;
+static int json_format(FILE *f, JsonVariant *v, JsonFormatFlags flags, const char *prefix) {
+        int r;
 
-                        case '\b':
-                                fputs("\\b", f);
-                                break;
+        assert(f);
+        assert(v);
 
-                        case '\f':
-                                fputs("\\f", f);
-                                break;
+        switch (json_variant_type(v)) {
 
-                        case '\n':
-                                fputs("\\n", f);
-                                break;
+        case JSON_VARIANT_REAL:
+                r = json_format_real(f, json_variant_real(v), flags);
+                if (r < 0)
+                        return r;
+                break;
 
-                        case '\r':
-                                fputs("\\r", f);
-                                break;
+        case JSON_VARIANT_INTEGER:
+                json_format_integer(f, json_variant_integer(v), flags);
+                break;
 
-                        case '\t':
-                                fputs("\\t", f);
-                                break;
+        case JSON_VARIANT_UNSIGNED:
+                json_format_unsigned(f, json_variant_unsigned(v), flags);
+                break;
 
-                        default:
-                                if ((signed char) *q >= 0 && *q < ' ')
-                                        fprintf(f, "\\u%04x", *q);
-                                else
-                                        fputc(*q, f);
-                                break;
-                        }
-                }
+        case JSON_VARIANT_BOOLEAN:
+                json_format_literal(f, json_variant_boolean(v) ? "true" : "false", flags);
+                break;
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
+        case JSON_VARIANT_NULL:
+                json_format_literal(f, "null", flags);
+                break;
 
-                fputc('"', f);
+        case JSON_VARIANT_STRING:
+                json_format_string(f, json_variant_string(v), flags);
                 break;
-        }
 
         case JSON_VARIANT_ARRAY: {
                 size_t i, n;
@@ -1599,6 +1671,293 @@ void json_variant_dump(JsonVariant *v, JsonFormatFlags flags, FILE *f, const cha
                 fputc('\n', f); /* In case of SSE add a second newline */
 }
 
+typedef struct JsonWriterLevel {
+        bool object;
+        bool after_key;
+        size_t n_items;
+} JsonWriterLevel;
+
+struct JsonWriter {
+        FILE *f;
+        JsonFormatFlags flags;
+
+        JsonWriterLevel *stack;
+        size_t n_stack, n_stack_allocated;
+
+        /* Indentation for JSON_FORMAT_PRETTY, one tab per level */
+        char *prefix;
+        size_t prefix_allocated;
+
+        bool done;
+};
+
+int json_writer_new(JsonWriter **ret, FILE *f, JsonFormatFlags flags) {
+        JsonWriter *w;
+
+        assert_return(ret, -EINVAL);
+
+        if (((flags & (JSON_FORMAT_COLOR_AUTO|JSON_FORMAT_COLOR)) == JSON_FORMAT_COLOR_AUTO) && colors_enabled())
+                flags |= JSON_FORMAT_COLOR;
+
+        w = new(JsonWriter, 1);
+        if (!w)
+                return -ENOMEM;
+
+        *w = (JsonWriter) {
+                .f = f ?: stdout,
+                .flags = flags,
+        };
+
+        *ret = w;
+        return 0;
+}
+
+JsonWriter *json_writer_free(JsonWriter *w) {
+        if (!w)
+                return NULL;
+
+        free(w->stack);
+        free(w->prefix);
+        return mfree(w);
+}
+
+static int json_writer_set_prefix(JsonWriter *w) {
+        if (!(w->flags & JSON_FORMAT_PRETTY))
+                return 0;
+
+        if (!GREEDY_REALLOC(w->prefix, w->prefix_allocated, w->n_stack + 1))
+                return -ENOMEM;
+
+        memset(w->prefix, '\t', w->n_stack);
+        w->prefix[w->n_stack] = 0;
+        return 0;
+}
+
+/* Writes whatever needs to go before the next item at the current level: the comma and, when pretty printing, the
+ * line break and indentation. */
+static int json_writer_begin_item(JsonWriter *w, bool key) {
+        JsonWriterLevel *l;
+
+        if (w->n_stack == 0) {
+                if (key || w->done)
+                        return -EINVAL;
+
+                w->done = true;
+                return 0;
+        }
+
+        l = w->stack + w->n_stack - 1;
+
+        if (l->object) {
+                /* Keys and values need to alternate */
+                if (key == l->after_key)
+                        return -EINVAL;
+                if (!key) {
+                        l->after_key = false;
+                        fputs(w->flags & JSON_FORMAT_PRETTY ? " : " : ":", w->f);
+                        return 0;
+                }
+
+                l->after_key = true;
+        } else if (key)
+                return -EINVAL;
+
+        if (l->n_items++ > 0)
+                fputc(',', w->f);
+
+        if (w->flags & JSON_FORMAT_PRETTY) {
+                fputc('\n', w->f);
+                fputs(w->prefix, w->f);
+        }
+
+        return 0;
+}
+
+static int json_writer_open(JsonWriter *w, bool object) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        if (w->n_stack >= DEPTH_MAX)
+                return -ELNRNG;
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        if (!GREEDY_REALLOC(w->stack, w->n_stack_allocated, w->n_stack + 1))
+                return -ENOMEM;
+
+        w->stack[w->n_stack++] = (JsonWriterLevel) {
+                .object = object,
+        };
+
+        fputc(object ? '{' : '[', w->f);
+
+        return json_writer_set_prefix(w);
+}
+
+static int json_writer_close(JsonWriter *w, bool object) {
+        JsonWriterLevel *l;
+
+        assert_return(w, -EINVAL);
+
+        if (w->n_stack == 0)
+                return -EINVAL;
+
+        l = w->stack + w->n_stack - 1;
+        if (l->object != object || l->after_key)
+                return -EINVAL;
+
+        w->n_stack--;
+        (void) json_writer_set_prefix(w); /* only ever shrinks, hence cannot fail */
+
+        if ((w->flags & JSON_FORMAT_PRETTY) && l->n_items > 0) {
+                fputc('\n', w->f);
+                fputs(w->prefix, w->f);
+        }
+
+        fputc(object ? '}' : ']', w->f);
+        return 0;
+}
+
+int json_writer_object_begin(JsonWriter *w) {
+        return json_writer_open(w, true);
+}
+
+int json_writer_object_end(JsonWriter *w) {
+        return json_writer_close(w, true);
+}
+
+int json_writer_array_begin(JsonWriter *w) {
+        return json_writer_open(w, false);
+}
+
+int json_writer_array_end(JsonWriter *w) {
+        return json_writer_close(w, false);
+}
+
+int json_writer_key(JsonWriter *w, const char *key) {
+        int r;
+
+        assert_return(w, -EINVAL);
+        assert_return(key, -EINVAL);
+
+        r = json_writer_begin_item(w, true);
+        if (r < 0)
+                return r;
+
+        json_format_string(w->f, key, w->flags);
+        return 0;
+}
+
+int json_writer_string(JsonWriter *w, const char *s) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        if (!s)
+                return json_writer_null(w);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        json_format_string(w->f, s, w->flags);
+        return 0;
+}
+
+int json_writer_integer(JsonWriter *w, intmax_t i) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        json_format_integer(w->f, i, w->flags);
+        return 0;
+}
+
+int json_writer_unsigned(JsonWriter *w, uintmax_t u) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        json_format_unsigned(w->f, u, w->flags);
+        return 0;
+}
+
+int json_writer_real(JsonWriter *w, long double d) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        return json_format_real(w->f, d, w->flags);
+}
+
+int json_writer_boolean(JsonWriter *w, bool b) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        json_format_literal(w->f, b ? "true" : "false", w->flags);
+        return 0;
+}
+
+int json_writer_null(JsonWriter *w) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        json_format_literal(w->f, "null", w->flags);
+        return 0;
+}
+
+int json_writer_variant(JsonWriter *w, JsonVariant *v) {
+        int r;
+
+        assert_return(w, -EINVAL);
+
+        if (!v)
+                return json_writer_null(w);
+
+        r = json_writer_begin_item(w, false);
+        if (r < 0)
+                return r;
+
+        return json_format(w->f, v, w->flags, w->prefix);
+}
+
+int json_writer_finish(JsonWriter *w) {
+        assert_return(w, -EINVAL);
+
+        if (w->n_stack > 0 || !w->done)
+                return -EINVAL;
+
+        if (w->flags & (JSON_FORMAT_PRETTY|JSON_FORMAT_NEWLINE))
+                fputc('\n', w->f);
+
+        return fflush_and_check(w->f);
+}
+
 static int json_variant_copy(JsonVariant **nv, JsonVariant *v) {
         JsonVariantType t;
         JsonVariant *c;
@@ -2642,6 +3001,184 @@ int json_parse_file(FILE *f, const char *path, JsonVariant **ret, unsigned *ret_
         return json_parse_internal(&p, source, ret, ret_line, ret_column, false);
 }
 
+static int json_parse_events_value(JsonExpect *expect) {
+
+        /* Moves on after a complete value, returns false if that value is not allowed here */
+
+        if (*expect == EXPECT_TOPLEVEL)
+                *expect = EXPECT_END;
+        else if (*expect == EXPECT_OBJECT_VALUE)
+                *expect = EXPECT_OBJECT_COMMA;
+        else if (IN_SET(*expect, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_NEXT_ELEMENT))
+                *expect = EXPECT_ARRAY_COMMA;
+        else
+                return false;
+
+        return true;
+}
+
+int json_parse_events(
+                const char *input,
+                const JsonParseCallbacks *cb,
+                void *userdata,
+                unsigned *ret_line,
+                unsigned *ret_column) {
+
+        _cleanup_free_ JsonExpect *stack = NULL;
+        size_t n_stack = 1, n_stack_allocated = 0;
+        unsigned line_buffer = 0, column_buffer = 0;
+        void *tokenizer_state = NULL;
+        const char *p;
+        int r;
+
+        assert_return(input, -EINVAL);
+        assert_return(cb, -EINVAL);
+
+        /* Same grammar as json_parse(), but instead of building a tree of JsonVariant objects, calls back for each
+         * element as it is encountered, hence memory use does not grow with the size of the input. */
+
+        if (!GREEDY_REALLOC(stack, n_stack_allocated, n_stack))
+                return -ENOMEM;
+
+        stack[0] = EXPECT_TOPLEVEL;
+
+        if (!ret_line)
+                ret_line = &line_buffer;
+        if (!ret_column)
+                ret_column = &column_buffer;
+
+        p = input;
+
+        for (;;) {
+                _cleanup_free_ char *string = NULL;
+                unsigned line_token, column_token;
+                JsonExpect *current;
+                JsonValue value;
+                int token;
+
+                current = stack + n_stack - 1;
+
+                token = json_tokenize(&p, &string, &value, &line_token, &column_token, &tokenizer_state, ret_line, ret_column);
+                if (token < 0)
+                        return token;
+
+                switch (token) {
+
+                case JSON_TOKEN_END:
+                        if (*current != EXPECT_END)
+                                return -EINVAL;
+
+                        assert(n_stack == 1);
+                        return 0;
+
+                case JSON_TOKEN_COLON:
+                        if (*current != EXPECT_OBJECT_COLON)
+                                return -EINVAL;
+
+                        *current = EXPECT_OBJECT_VALUE;
+                        break;
+
+                case JSON_TOKEN_COMMA:
+                        if (*current == EXPECT_OBJECT_COMMA)
+                                *current = EXPECT_OBJECT_NEXT_KEY;
+                        else if (*current == EXPECT_ARRAY_COMMA)
+                                *current = EXPECT_ARRAY_NEXT_ELEMENT;
+                        else
+                                return -EINVAL;
+
+                        break;
+
+                case JSON_TOKEN_OBJECT_OPEN:
+                case JSON_TOKEN_ARRAY_OPEN:
+                        if (!json_parse_events_value(current))
+                                return -EINVAL;
+
+                        if (n_stack > DEPTH_MAX)
+                                return -ELNRNG;
+
+                        if (!GREEDY_REALLOC(stack, n_stack_allocated, n_stack + 1))
+                                return -ENOMEM;
+
+                        if (token == JSON_TOKEN_OBJECT_OPEN) {
+                                stack[n_stack++] = EXPECT_OBJECT_FIRST_KEY;
+                                r = cb->object_begin ? cb->object_begin(userdata) : 0;
+                        } else {
+                                stack[n_stack++] = EXPECT_ARRAY_FIRST_ELEMENT;
+                                r = cb->array_begin ? cb->array_begin(userdata) : 0;
+                        }
+                        if (r < 0)
+                                return r;
+
+                        break;
+
+                case JSON_TOKEN_OBJECT_CLOSE:
+                        if (!IN_SET(*current, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_COMMA))
+                                return -EINVAL;
+
+                        assert(n_stack > 1);
+                        n_stack--;
+
+                        r = cb->object_end ? cb->object_end(userdata) : 0;
+                        if (r < 0)
+                                return r;
+
+                        break;
+
+                case JSON_TOKEN_ARRAY_CLOSE:
+                        if (!IN_SET(*current, EXPECT_ARRAY_FIRST_ELEMENT, EXPECT_ARRAY_COMMA))
+                                return -EINVAL;
+
+                        assert(n_stack > 1);
+                        n_stack--;
+
+                        r = cb->array_end ? cb->array_end(userdata) : 0;
+                        if (r < 0)
+                                return r;
+
+                        break;
+
+                case JSON_TOKEN_STRING:
+                        if (IN_SET(*current, EXPECT_OBJECT_FIRST_KEY, EXPECT_OBJECT_NEXT_KEY)) {
+                                *current = EXPECT_OBJECT_COLON;
+                                r = cb->key ? cb->key(string, userdata) : 0;
+                        } else if (json_parse_events_value(current))
+                                r = cb->string ? cb->string(string, userdata) : 0;
+                        else
+                                return -EINVAL;
+                        if (r < 0)
+                                return r;
+
+                        break;
+
+                case JSON_TOKEN_REAL:
+                case JSON_TOKEN_INTEGER:
+                case JSON_TOKEN_UNSIGNED:
+                case JSON_TOKEN_BOOLEAN:
+                case JSON_TOKEN_NULL:
+                        if (!json_parse_events_value(current))
+                                return -EINVAL;
+
+                        if (token == JSON_TOKEN_REAL)
+                                r = cb->real ? cb->real(value.real, userdata) : 0;
+                        else if (token == JSON_TOKEN_INTEGER)
+                                r = cb->integer ? cb->integer(value.integer, userdata) : 0;
+                        else if (token == JSON_TOKEN_UNSIGNED)
+                                r = cb->unsig ? cb->unsig(value.unsig, userdata) : 0;
+                        else if (token == JSON_TOKEN_BOOLEAN)
+                                r = cb->boolean ? cb->boolean(value.boolean, userdata) : 0;
+                        else
+                                r = cb->null ? cb->null(userdata) : 0;
+                        if (r < 0)
+                                return r;
+
+                        break;
+
+                default:
+                        assert_not_reached("Unexpected token");
+                }
+        }
+}
+
 int json_buildv(JsonVariant **ret, va_list ap) {
         JsonStack *stack = NULL;
         size_t n_stack = 1, n_stack_allocated = 0, i;
@@ -162,10 +162,52 @@ typedef enum JsonFormatFlags {
 int json_variant_format(JsonVariant *v, JsonFormatFlags flags, char **ret);
 void json_variant_dump(JsonVariant *v, JsonFormatFlags flags, FILE *f, const char *prefix);
 
+/* Incremental writer: writes JSON straight to a FILE as it is generated, without building JsonVariant objects or the
+ * output string in memory first. Calls out of order (e.g. a value where an object key is expected) fail with
+ * -EINVAL. json_writer_finish() checks that exactly one complete value was written, and flushes. */
+typedef struct JsonWriter JsonWriter;
+
+int json_writer_new(JsonWriter **ret, FILE *f, JsonFormatFlags flags);
+JsonWriter *json_writer_free(JsonWriter *w);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JsonWriter *, json_writer_free);
+
+int json_writer_object_begin(JsonWriter *w);
+int json_writer_object_end(JsonWriter *w);
+int json_writer_array_begin(JsonWriter *w);
+int json_writer_array_end(JsonWriter *w);
+int json_writer_key(JsonWriter *w, const char *key);
+int json_writer_string(JsonWriter *w, const char *s);
+int json_writer_integer(JsonWriter *w, intmax_t i);
+int json_writer_unsigned(JsonWriter *w, uintmax_t u);
+int json_writer_real(JsonWriter *w, long double d);
+int json_writer_boolean(JsonWriter *w, bool b);
+int json_writer_null(JsonWriter *w);
+int json_writer_variant(JsonWriter *w, JsonVariant *v);
+int json_writer_finish(JsonWriter *w);
+
 int json_parse(const char *string, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
 int json_parse_continue(const char **p, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
 int json_parse_file(FILE *f, const char *path, JsonVariant **ret, unsigned *ret_line, unsigned *ret_column);
 
+/* Streaming parser: calls back for each element of the input as it is parsed, instead of building a JsonVariant
+ * tree. Callbacks may be left NULL. Strings passed are only valid during the call. A callback returning < 0 aborts
+ * parsing with that error. */
+typedef struct JsonParseCallbacks {
+        int (*object_begin)(void *userdata);
+        int (*object_end)(void *userdata);
+        int (*array_begin)(void *userdata);
+        int (*array_end)(void *userdata);
+        int (*key)(const char *key, void *userdata);
+        int (*string)(const char *s, void *userdata);
+        int (*integer)(intmax_t i, void *userdata);
+        int (*unsig)(uintmax_t u, void *userdata);
+        int (*real)(long double d, void *userdata);
+        int (*boolean)(bool b, void *userdata);
+        int (*null)(void *userdata);
+} JsonParseCallbacks;
+
+int json_parse_events(const char *input, const JsonParseCallbacks *cb, void *userdata, unsigned *ret_line, unsigned *ret_column);
+
 enum {
         _JSON_BUILD_STRING,
         _JSON_BUILD_INTEGER,
@@ -2,7 +2,9 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdio_ext.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +18,7 @@
 
 #include "alloc-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "format-util.h"
 #include "hashmap.h"
 #include "hostname-util.h"
@@ -37,6 +40,7 @@
 #include "time-util.h"
 #include "utf8.h"
 #include "util.h"
+#include "worker-pool.h"
 
 /* up to three lines (each up to 100 characters) or 300 characters, whichever is less */
 #define PRINT_LINE_THRESHOLD 3
@@ -262,19 +266,92 @@ static bool print_multiline(
         return ellipsized;
 }
 
-static int output_timestamp_monotonic(FILE *f, sd_journal *j, const char *monotonic) {
+/* A copy of what output_short() and output_json() need to know about an entry, so that it may be formatted
+ * without access to the sd_journal object, i.e. in another thread. The fields are stored one after the other in
+ * 'data', each prefixed by its size. */
+typedef struct EntrySnapshot {
+        uint64_t realtime;
+        uint64_t monotonic;
+        sd_id128_t boot_id;
+        char *cursor;
+
+        char *data;
+        size_t size, allocated;
+
+        /* Error encountered while enumerating the fields, returned after the ones read successfully */
+        int error;
+
+        size_t highlight[2];
+        bool has_highlight;
+} EntrySnapshot;
+
+static void entry_snapshot_done(EntrySnapshot *s) {
+        assert(s);
+
+        s->cursor = mfree(s->cursor);
+        s->data = mfree(s->data);
+        s->size = s->allocated = 0;
+}
+
+static int entry_get_realtime(sd_journal *j, const EntrySnapshot *s, uint64_t *ret) {
+        assert(!j != !s);
+
+        if (j)
+                return sd_journal_get_realtime_usec(j, ret);
+
+        *ret = s->realtime;
+        return 0;
+}
+
+static int entry_get_monotonic(sd_journal *j, const EntrySnapshot *s, uint64_t *ret, sd_id128_t *ret_boot_id) {
+        assert(!j != !s);
+
+        if (j)
+                return sd_journal_get_monotonic_usec(j, ret, ret_boot_id);
+
+        *ret = s->monotonic;
+        *ret_boot_id = s->boot_id;
+        return 0;
+}
+
+/* Like sd_journal_enumerate_data(), idx must be initialized to 0 before the first call */
+static int entry_enumerate_data(sd_journal *j, const EntrySnapshot *s, size_t *idx, const void **ret, size_t *ret_size) {
+        size_t l;
+
+        assert(!j != !s);
+        assert(idx);
+
+        if (j) {
+                if (*idx == 0)
+                        sd_journal_restart_data(j);
+                (*idx)++;
+
+                return sd_journal_enumerate_data(j, ret, ret_size);
+        }
+
+        if (*idx >= s->size)
+                return s->error;
+
+        memcpy(&l, s->data + *idx, sizeof(l));
+        *ret = s->data + *idx + sizeof(l);
+        *ret_size = l;
+        *idx += sizeof(l) + l;
+
+        return 1;
+}
+
+static int output_timestamp_monotonic(FILE *f, sd_journal *j, const EntrySnapshot *s, const char *monotonic) {
         sd_id128_t boot_id;
         uint64_t t;
         int r;
 
         assert(f);
-        assert(j);
 
         r = -ENXIO;
         if (monotonic)
                 r = safe_atou64(monotonic, &t);
         if (r < 0)
-                r = sd_journal_get_monotonic_usec(j, &t, &boot_id);
+                r = entry_get_monotonic(j, s, &t, &boot_id);
         if (r < 0)
                 return log_error_errno(r, "Failed to get monotonic timestamp: %m");
 
@@ -282,7 +359,7 @@ static int output_timestamp_monotonic(FILE *f, sd_journal *j, const char *monoto
         return 1 + 5 + 1 + 6 + 1;
 }
 
-static int output_timestamp_realtime(FILE *f, sd_journal *j, OutputMode mode, OutputFlags flags, const char *realtime) {
+static int output_timestamp_realtime(FILE *f, sd_journal *j, const EntrySnapshot *s, OutputMode mode, OutputFlags flags, const char *realtime) {
         char buf[MAX(FORMAT_TIMESTAMP_MAX, 64)];
         struct tm *(*gettime_r)(const time_t *, struct tm *);
         struct tm tm;
@@ -291,12 +368,11 @@ static int output_timestamp_realtime(FILE *f, sd_journal *j, OutputMode mode, Ou
         int r;
 
         assert(f);
-        assert(j);
 
         if (realtime)
                 r = safe_atou64(realtime, &x);
         if (!realtime || r < 0 || !VALID_REALTIME(x))
-                r = sd_journal_get_realtime_usec(j, &x);
+                r = entry_get_realtime(j, s, &x);
         if (r < 0)
                 return log_error_errno(r, "Failed to get realtime timestamp: %m");
 
@@ -367,18 +443,32 @@ static int output_timestamp_realtime(FILE *f, sd_journal *j, OutputMode mode, Ou
         return (int) strlen(buf);
 }
 
-static int output_short(
+static size_t output_data_threshold(OutputMode mode, OutputFlags flags) {
+
+        if (IN_SET(mode, OUTPUT_JSON, OUTPUT_JSON_PRETTY, OUTPUT_JSON_SSE, OUTPUT_JSON_SEQ))
+                return flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD;
+
+        /* Set the threshold to one bigger than the actual print
+         * threshold, so that if the line is actually longer than what
+         * we're willing to print, ellipsization will occur. This way
+         * we won't output a misleading line without any indication of
+         * truncation.
+         */
+        return flags & (OUTPUT_SHOW_ALL|OUTPUT_FULL_WIDTH) ? 0 : PRINT_CHAR_THRESHOLD + 1;
+}
+
+static int output_short_entry(
                 FILE *f,
                 sd_journal *j,
+                const EntrySnapshot *s,
                 OutputMode mode,
                 unsigned n_columns,
                 OutputFlags flags,
-                Set *output_fields,
                 const size_t highlight[2]) {
 
         int r;
         const void *data;
-        size_t length;
+        size_t length, idx = 0;
         size_t n = 0;
         _cleanup_free_ char *hostname = NULL, *identifier = NULL, *comm = NULL, *pid = NULL, *fake_pid = NULL, *message = NULL, *realtime = NULL, *monotonic = NULL, *priority = NULL, *unit = NULL, *user_unit = NULL;
         size_t hostname_len = 0, identifier_len = 0, comm_len = 0, pid_len = 0, fake_pid_len = 0, message_len = 0, realtime_len = 0, monotonic_len = 0, priority_len = 0, unit_len = 0, user_unit_len = 0;
@@ -400,17 +490,12 @@ static int output_short(
         size_t highlight_shifted[] = {highlight ? highlight[0] : 0, highlight ? highlight[1] : 0};
 
         assert(f);
-        assert(j);
+        assert(!j != !s);
 
-        /* Set the threshold to one bigger than the actual print
-         * threshold, so that if the line is actually longer than what
-         * we're willing to print, ellipsization will occur. This way
-         * we won't output a misleading line without any indication of
-         * truncation.
-         */
-        sd_journal_set_data_threshold(j, flags & (OUTPUT_SHOW_ALL|OUTPUT_FULL_WIDTH) ? 0 : PRINT_CHAR_THRESHOLD + 1);
+        if (j)
+                sd_journal_set_data_threshold(j, output_data_threshold(mode, flags));
 
-        JOURNAL_FOREACH_DATA_RETVAL(j, data, length, r) {
+        while ((r = entry_enumerate_data(j, s, &idx, &data, &length)) > 0) {
                 r = parse_fieldv(data, length, fields, ELEMENTSOF(fields));
                 if (r < 0)
                         return r;
@@ -434,9 +519,9 @@ static int output_short(
                 p = *priority - '0';
 
         if (mode == OUTPUT_SHORT_MONOTONIC)
-                r = output_timestamp_monotonic(f, j, monotonic);
+                r = output_timestamp_monotonic(f, j, s, monotonic);
         else
-                r = output_timestamp_realtime(f, j, mode, flags, realtime);
+                r = output_timestamp_realtime(f, j, s, mode, flags, realtime);
         if (r < 0)
                 return r;
         n += r;
@@ -492,12 +577,26 @@ static int output_short(
                                         highlight_shifted);
         }
 
-        if (flags & OUTPUT_CATALOG)
+        if (j && (flags & OUTPUT_CATALOG))
                 print_catalog(f, j);
 
         return ellipsized;
 }
 
+static int output_short(
+                FILE *f,
+                sd_journal *j,
+                OutputMode mode,
+                unsigned n_columns,
+                OutputFlags flags,
+                Set *output_fields,
+                const size_t highlight[2]) {
+
+        assert(j);
+
+        return output_short_entry(f, j, NULL, mode, n_columns, flags, highlight);
+}
+
 static int output_verbose(
                 FILE *f,
                 sd_journal *j,
@@ -835,42 +934,48 @@ static int update_json_data_split(
         return update_json_data(h, flags, name, eq + 1, size - (eq - (const char*) data) - 1);
 }
 
-static int output_json(
+static int output_json_entry(
                 FILE *f,
                 sd_journal *j,
+                const EntrySnapshot *s,
                 OutputMode mode,
-                unsigned n_columns,
                 OutputFlags flags,
-                Set *output_fields,
-                const size_t highlight[2]) {
+                Set *output_fields) {
 
         char sid[SD_ID128_STRING_MAX], usecbuf[DECIMAL_STR_MAX(usec_t)];
         _cleanup_(json_variant_unrefp) JsonVariant *object = NULL;
-        _cleanup_free_ char *cursor = NULL;
+        _cleanup_free_ char *cursor_buf = NULL;
         uint64_t realtime, monotonic;
         JsonVariant **array = NULL;
         struct json_data *d;
+        const char *cursor;
         sd_id128_t boot_id;
         Hashmap *h = NULL;
-        size_t n = 0;
+        size_t n = 0, idx = 0;
         Iterator i;
         int r;
 
-        assert(j);
+        assert(!j != !s);
 
-        (void) sd_journal_set_data_threshold(j, flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
+        if (j)
+                (void) sd_journal_set_data_threshold(j, output_data_threshold(mode, flags));
 
-        r = sd_journal_get_realtime_usec(j, &realtime);
+        r = entry_get_realtime(j, s, &realtime);
         if (r < 0)
                 return log_error_errno(r, "Failed to get realtime timestamp: %m");
 
-        r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
+        r = entry_get_monotonic(j, s, &monotonic, &boot_id);
         if (r < 0)
                 return log_error_errno(r, "Failed to get monotonic timestamp: %m");
 
-        r = sd_journal_get_cursor(j, &cursor);
-        if (r < 0)
-                return log_error_errno(r, "Failed to get cursor: %m");
+        if (j) {
+                r = sd_journal_get_cursor(j, &cursor_buf);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to get cursor: %m");
+
+                cursor = cursor_buf;
+        } else
+                cursor = s->cursor;
 
         h = hashmap_new(&string_hash_ops);
         if (!h)
@@ -899,7 +1004,7 @@ static int output_json(
                 const void *data;
                 size_t size;
 
-                r = sd_journal_enumerate_data(j, &data, &size);
+                r = entry_enumerate_data(j, s, &idx, &data, &size);
                 if (r == -EBADMSG) {
                         log_debug_errno(r, "Skipping message we can't read: %m");
                         r = 0;
@@ -975,6 +1080,20 @@ finish:
         return r;
 }
 
+static int output_json(
+                FILE *f,
+                sd_journal *j,
+                OutputMode mode,
+                unsigned n_columns,
+                OutputFlags flags,
+                Set *output_fields,
+                const size_t highlight[2]) {
+
+        assert(j);
+
+        return output_json_entry(f, j, NULL, mode, flags, output_fields);
+}
+
 static int output_cat(
                 FILE *f,
                 sd_journal *j,
@@ -1092,6 +1211,358 @@ int show_journal_entry(
         return ret;
 }
 
+bool journal_output_pipeline_supported(OutputMode mode, OutputFlags flags) {
+        assert(mode >= 0);
+        assert(mode < _OUTPUT_MODE_MAX);
+
+        /* The catalog is looked up through the sd_journal object, and can hence only be shown by the thread
+         * iterating through the journal */
+        if (flags & OUTPUT_CATALOG)
+                return false;
+
+        return output_funcs[mode] == output_short || output_funcs[mode] == output_json;
+}
+
+/* Entries are copied in batches, each of which is formatted into a buffer by one of the threads while the following
+ * ones are read. The buffers are then written out in order, with a single write() each. */
+#define OUTPUT_BATCH_ENTRIES 256U
+#define OUTPUT_BATCHES_MAX 16U
+
+typedef struct OutputBatch {
+        EntrySnapshot entries[OUTPUT_BATCH_ENTRIES];
+        size_t n_entries;
+
+        char *buf;
+        size_t size;
+        bool ellipsized;
+
+        /* Protected by the mutex of the pipeline */
+        bool done;
+        int error;
+} OutputBatch;
+
+struct JournalOutputPipeline {
+        FILE *f;
+        OutputMode mode;
+        unsigned n_columns;
+        OutputFlags flags;
+        Set *output_fields;
+
+        WorkerPool *pool;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        /* The batches being formatted or waiting to be written, oldest first */
+        OutputBatch *queue[OUTPUT_BATCHES_MAX];
+        size_t queue_start, n_queued;
+
+        OutputBatch *current, *spare;
+        bool ellipsized;
+};
+
+static int entry_snapshot_take(
+                EntrySnapshot *s,
+                sd_journal *j,
+                OutputMode mode,
+                OutputFlags flags,
+                const size_t highlight[2]) {
+
+        const void *data;
+        size_t l;
+        int r;
+
+        assert(s);
+        assert(j);
+
+        r = sd_journal_get_realtime_usec(j, &s->realtime);
+        if (r < 0)
+                return log_full_errno(r == -EADDRNOTAVAIL ? LOG_DEBUG : LOG_ERR, r, "Failed to get realtime timestamp: %m");
+
+        r = sd_journal_get_monotonic_usec(j, &s->monotonic, &s->boot_id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+        s->cursor = mfree(s->cursor);
+        if (output_funcs[mode] == output_json) {
+                r = sd_journal_get_cursor(j, &s->cursor);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to get cursor: %m");
+        }
+
+        (void) sd_journal_set_data_threshold(j, output_data_threshold(mode, flags));
+
+        s->size = 0;
+        JOURNAL_FOREACH_DATA_RETVAL(j, data, l, r) {
+                if (!GREEDY_REALLOC(s->data, s->allocated, s->size + sizeof(l) + l))
+                        return log_oom();
+
+                memcpy(s->data + s->size, &l, sizeof(l));
+                memcpy(s->data + s->size + sizeof(l), data, l);
+                s->size += sizeof(l) + l;
+        }
+
+        /* Errors are reported when the entry is formatted, the same way as if it was read directly */
+        s->error = r;
+
+        s->has_highlight = highlight;
+        if (highlight)
+                memcpy(s->highlight, highlight, sizeof(s->highlight));
+
+        return 0;
+}
+
+static OutputBatch *output_batch_free(OutputBatch *b) {
+        size_t k;
+
+        if (!b)
+                return NULL;
+
+        for (k = 0; k < OUTPUT_BATCH_ENTRIES; k++)
+                entry_snapshot_done(b->entries + k);
+
+        free(b->buf);
+        return mfree(b);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(OutputBatch*, output_batch_free);
+
+static void output_batch_release(void *b) {
+        /* Batches are owned by the pipeline, not by the worker pool */
+}
+
+static int output_batch_format(void *job, void *userdata) {
+        JournalOutputPipeline *p = userdata;
+        _cleanup_fclose_ FILE *f = NULL;
+        OutputBatch *b = job;
+        size_t k;
+        int r = 0;
+
+        assert(b);
+        assert(p);
+
+        f = open_memstream(&b->buf, &b->size);
+        if (!f)
+                r = log_oom();
+        else {
+                (void) __fsetlocking(f, FSETLOCKING_BYCALLER);
+
+                for (k = 0; k < b->n_entries; k++) {
+                        const EntrySnapshot *s = b->entries + k;
+
+                        if (output_funcs[p->mode] == output_json)
+                                r = output_json_entry(f, NULL, s, p->mode, p->flags, p->output_fields);
+                        else
+                                r = output_short_entry(f, NULL, s, p->mode, p->n_columns, p->flags,
+                                                       s->has_highlight ? s->highlight : NULL);
+                        if (r < 0)
+                                break;
+                        if (r > 0)
+                                b->ellipsized = true;
+                }
+
+                if (r >= 0)
+                        r = fflush_and_check(f);
+
+                /* Only now the buffer is final */
+                f = safe_fclose(f);
+        }
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        b->error = MIN(r, 0);
+        b->done = true;
+        assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return 0;
+}
+
+static int journal_output_pipeline_write_one(JournalOutputPipeline *p) {
+        _cleanup_(output_batch_freep) OutputBatch *b = NULL;
+        int r;
+
+        assert(p);
+        assert(p->n_queued > 0);
+
+        b = p->queue[p->queue_start];
+        p->queue_start = (p->queue_start + 1) % OUTPUT_BATCHES_MAX;
+        p->n_queued--;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        while (!b->done)
+                assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+        r = b->error;
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+        if (r < 0)
+                return r;
+
+        if (b->ellipsized)
+                p->ellipsized = true;
+
+        /* Whatever was written through the stream so far goes first */
+        r = fflush_and_check(p->f);
+        if (r >= 0 && b->size > 0)
+                r = loop_write(fileno(p->f), b->buf, b->size, false);
+        if (r < 0)
+                return log_error_errno(r, "Failed to write journal entries: %m");
+
+        /* Keep the batch around, so that the allocations for the entries are reused */
+        if (!p->spare) {
+                b->n_entries = 0;
+                b->buf = mfree(b->buf);
+                b->size = 0;
+                b->ellipsized = b->done = false;
+                b->error = 0;
+
+                p->spare = TAKE_PTR(b);
+        }
+
+        return 0;
+}
+
+static int journal_output_pipeline_submit(JournalOutputPipeline *p) {
+        _cleanup_(output_batch_freep) OutputBatch *b = NULL;
+        int r;
+
+        assert(p);
+
+        b = TAKE_PTR(p->current);
+        if (!b)
+                return 0;
+
+        if (p->n_queued >= OUTPUT_BATCHES_MAX) {
+                r = journal_output_pipeline_write_one(p);
+                if (r < 0)
+                        return r;
+        }
+
+        p->queue[(p->queue_start + p->n_queued) % OUTPUT_BATCHES_MAX] = b;
+        p->n_queued++;
+
+        if (p->pool)
+                worker_pool_add(p->pool, TAKE_PTR(b));
+        else
+                (void) output_batch_format(TAKE_PTR(b), p);
+
+        return 0;
+}
+
+int journal_output_pipeline_new(
+                JournalOutputPipeline **ret,
+                FILE *f,
+                OutputMode mode,
+                unsigned n_columns,
+                OutputFlags flags,
+                char **output_fields) {
+
+        _cleanup_(journal_output_pipeline_freep) JournalOutputPipeline *p = NULL;
+        int r;
+
+        assert(ret);
+        assert(f);
+        assert(journal_output_pipeline_supported(mode, flags));
+
+        p = new(JournalOutputPipeline, 1);
+        if (!p)
+                return log_oom();
+
+        *p = (JournalOutputPipeline) {
+                .f = f,
+                .mode = mode,
+                .n_columns = n_columns > 0 ? n_columns : columns(),
+                .flags = flags,
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+        };
+
+        if (output_fields) {
+                p->output_fields = set_new(&string_hash_ops);
+                if (!p->output_fields)
+                        return log_oom();
+
+                r = set_put_strdupv(p->output_fields, output_fields);
+                if (r < 0)
+                        return r;
+        }
+
+        /* If no thread could be started, the batches are formatted in the calling thread */
+        p->pool = worker_pool_new(output_batch_format, output_batch_release, p);
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+int journal_output_pipeline_add(JournalOutputPipeline *p, sd_journal *j, const size_t highlight[2]) {
+        OutputBatch *b;
+        int r;
+
+        assert(p);
+        assert(j);
+
+        if (!p->current) {
+                p->current = TAKE_PTR(p->spare);
+                if (!p->current) {
+                        p->current = new0(OutputBatch, 1);
+                        if (!p->current)
+                                return log_oom();
+                }
+        }
+
+        b = p->current;
+
+        r = entry_snapshot_take(b->entries + b->n_entries, j, p->mode, p->flags, highlight);
+        if (r < 0)
+                return r;
+
+        if (++b->n_entries >= OUTPUT_BATCH_ENTRIES)
+                return journal_output_pipeline_submit(p);
+
+        return 0;
+}
+
+int journal_output_pipeline_flush(JournalOutputPipeline *p, bool *ellipsized) {
+        int r;
+
+        assert(p);
+
+        r = journal_output_pipeline_submit(p);
+        if (r < 0)
+                return r;
+
+        while (p->n_queued > 0) {
+                r = journal_output_pipeline_write_one(p);
+                if (r < 0)
+                        return r;
+        }
+
+        if (ellipsized && p->ellipsized)
+                *ellipsized = true;
+
+        return 0;
+}
+
+JournalOutputPipeline *journal_output_pipeline_free(JournalOutputPipeline *p) {
+        if (!p)
+                return NULL;
+
+        /* Waits for the batches still being formatted */
+        (void) worker_pool_finish(p->pool);
+
+        for (; p->n_queued > 0; p->n_queued--) {
+                output_batch_free(p->queue[p->queue_start]);
+                p->queue_start = (p->queue_start + 1) % OUTPUT_BATCHES_MAX;
+        }
+
+        output_batch_free(p->current);
+        output_batch_free(p->spare);
+
+        set_free_free(p->output_fields);
+
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+
+        return mfree(p);
+}
+
 static int maybe_print_begin_newline(FILE *f, OutputFlags *flags) {
         assert(f);
         assert(flags);
@@ -22,6 +22,25 @@ int show_journal_entry(
                 char **output_fields,
                 const size_t highlight[2],
                 bool *ellipsized);
+/* Formats entries in a pool of threads and writes them out in order, in large chunks. Entries are copied out of the
+ * journal when added, and written at the latest when the pipeline is flushed. Only available for the output modes
+ * and flags for which journal_output_pipeline_supported() returns true. */
+typedef struct JournalOutputPipeline JournalOutputPipeline;
+
+bool journal_output_pipeline_supported(OutputMode mode, OutputFlags flags);
+int journal_output_pipeline_new(
+                JournalOutputPipeline **ret,
+                FILE *f,
+                OutputMode mode,
+                unsigned n_columns,
+                OutputFlags flags,
+                char **output_fields);
+int journal_output_pipeline_add(JournalOutputPipeline *p, sd_journal *j, const size_t highlight[2]);
+int journal_output_pipeline_flush(JournalOutputPipeline *p, bool *ellipsized);
+JournalOutputPipeline *journal_output_pipeline_free(JournalOutputPipeline *p);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalOutputPipeline*, journal_output_pipeline_free);
+
 int show_journal(
                 FILE *f,
                 sd_journal *j,
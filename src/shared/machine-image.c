@@ -192,12 +192,54 @@ static int extract_pretty(const char *path, const char *suffix, char **ret) {
         return 0;
 }
 
+/* The quota data of all qgroups of a btrfs file system, read at once when enumerating images, as looking at each
+ * subvolume separately gets slow with many of them */
+typedef struct QuotaTable {
+        bool loaded;
+        sd_id128_t fsid;
+        BtrfsQgroupQuota *items;
+        size_t n_items;
+} QuotaTable;
+
+static void quota_table_done(QuotaTable *t) {
+        assert(t);
+
+        t->items = mfree(t->items);
+        t->n_items = 0;
+        t->loaded = false;
+}
+
+static const BtrfsQuotaInfo* quota_table_find(QuotaTable *t, int fd, uint64_t subvol_id) {
+        sd_id128_t fsid;
+
+        assert(t);
+        assert(fd >= 0);
+
+        /* Images might live on different file systems, make sure we look at the right one */
+        if (btrfs_get_fsid_fd(fd, &fsid) < 0)
+                return NULL;
+
+        if (!t->loaded || !sd_id128_equal(t->fsid, fsid)) {
+                quota_table_done(t);
+
+                t->loaded = true;
+                t->fsid = fsid;
+
+                /* On failure, leave the table empty, callers fall back to querying each subvolume */
+                if (btrfs_qgroup_get_quota_all_fd(fd, &t->items, &t->n_items) < 0)
+                        return NULL;
+        }
+
+        return btrfs_qgroup_quota_find_subtree(t->items, t->n_items, subvol_id);
+}
+
 static int image_make(
                 const char *pretty,
                 int dfd,
                 const char *path,
                 const char *filename,
                 const struct stat *st,
+                QuotaTable *quotas,
                 Image **ret) {
 
         _cleanup_free_ char *pretty_buffer = NULL;
@@ -271,15 +313,19 @@ static int image_make(
                                         return r;
 
                                 if (btrfs_quota_scan_ongoing(fd) == 0) {
+                                        const BtrfsQuotaInfo *q = NULL;
                                         BtrfsQuotaInfo quota;
 
-                                        r = btrfs_subvol_get_subtree_quota_fd(fd, 0, &quota);
-                                        if (r >= 0) {
-                                                (*ret)->usage = quota.referenced;
-                                                (*ret)->usage_exclusive = quota.exclusive;
+                                        if (quotas)
+                                                q = quota_table_find(quotas, fd, info.subvol_id);
+                                        if (!q && btrfs_subvol_get_subtree_quota_fd(fd, 0, &quota) >= 0)
+                                                q = &quota;
+                                        if (q) {
+                                                (*ret)->usage = q->referenced;
+                                                (*ret)->usage_exclusive = q->exclusive;
 
-                                                (*ret)->limit = quota.referenced_max;
-                                                (*ret)->limit_exclusive = quota.exclusive_max;
+                                                (*ret)->limit = q->referenced_max;
+                                                (*ret)->limit_exclusive = q->exclusive_max;
                                         }
                                 }
 
@@ -451,13 +497,13 @@ int image_find(ImageClass class, const char *name, Image **ret) {
                         if (!S_ISREG(st.st_mode))
                                 continue;
 
-                        r = image_make(name, dirfd(d), path, raw, &st, ret);
+                        r = image_make(name, dirfd(d), path, raw, &st, NULL, ret);
 
                 } else {
                         if (!S_ISDIR(st.st_mode) && !S_ISBLK(st.st_mode))
                                 continue;
 
-                        r = image_make(name, dirfd(d), path, name, &st, ret);
+                        r = image_make(name, dirfd(d), path, name, &st, NULL, ret);
                 }
                 if (IN_SET(r, -ENOENT, -EMEDIUMTYPE))
                         continue;
@@ -471,7 +517,7 @@ int image_find(ImageClass class, const char *name, Image **ret) {
         }
 
         if (class == IMAGE_MACHINE && streq(name, ".host")) {
-                r = image_make(".host", AT_FDCWD, NULL, "/", NULL, ret);
+                r = image_make(".host", AT_FDCWD, NULL, "/", NULL, NULL, ret);
                 if (r < 0)
                         return r;
 
@@ -491,9 +537,9 @@ int image_from_path(const char *path, Image **ret) {
          * overridden by another, different image earlier in the search path */
 
         if (path_equal(path, "/"))
-                return image_make(".host", AT_FDCWD, NULL, "/", NULL, ret);
+                return image_make(".host", AT_FDCWD, NULL, "/", NULL, NULL, ret);
 
-        return image_make(NULL, AT_FDCWD, NULL, path, NULL, ret);
+        return image_make(NULL, AT_FDCWD, NULL, path, NULL, NULL, ret);
 }
 
 int image_find_harder(ImageClass class, const char *name_or_path, Image **ret) {
@@ -503,7 +549,15 @@ int image_find_harder(ImageClass class, const char *name_or_path, Image **ret) {
         return image_from_path(name_or_path, ret);
 }
 
+const char* image_search_path_nulstr(ImageClass class) {
+        assert(class >= 0);
+        assert(class < _IMAGE_CLASS_MAX);
+
+        return image_search_path[class];
+}
+
 int image_discover(ImageClass class, Hashmap *h) {
+        _cleanup_(quota_table_done) QuotaTable quotas = {};
         const char *path;
         int r;
 
@@ -564,7 +618,7 @@ int image_discover(ImageClass class, Hashmap *h) {
                         if (hashmap_contains(h, pretty))
                                 continue;
 
-                        r = image_make(pretty, dirfd(d), path, de->d_name, &st, &image);
+                        r = image_make(pretty, dirfd(d), path, de->d_name, &st, &quotas, &image);
                         if (IN_SET(r, -ENOENT, -EMEDIUMTYPE))
                                 continue;
                         if (r < 0)
@@ -583,7 +637,7 @@ int image_discover(ImageClass class, Hashmap *h) {
         if (class == IMAGE_MACHINE && !hashmap_contains(h, ".host")) {
                 _cleanup_(image_unrefp) Image *image = NULL;
 
-                r = image_make(".host", AT_FDCWD, NULL, "/", NULL, &image);
+                r = image_make(".host", AT_FDCWD, NULL, "/", NULL, NULL, &image);
                 if (r < 0)
                         return r;
 
@@ -66,6 +66,9 @@ int image_from_path(const char *path, Image **ret);
 int image_find_harder(ImageClass class, const char *name_or_path, Image **ret);
 int image_discover(ImageClass class, Hashmap *map);
 
+/* The directories images of the class are looked for in, in order of precedence, as NULSTR */
+const char* image_search_path_nulstr(ImageClass class);
+
 int image_remove(Image *i);
 int image_rename(Image *i, const char *new_name);
 int image_clone(Image *i, const char *new_name, bool read_only);
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <sched.h>
+
+#include "missing_syscall.h"
+#include "numa-util.h"
+#include "string-table.h"
+
+static bool numa_policy_has_nodes(const NUMAPolicy *p) {
+        assert(p);
+
+        return p->nodes && CPU_COUNT_S(CPU_ALLOC_SIZE(p->n_nodes), p->nodes) > 0;
+}
+
+bool numa_policy_is_valid(const NUMAPolicy *p) {
+        assert(p);
+
+        if (!mpol_is_valid(p->type))
+                return false;
+
+        /* "bind" and "interleave" need to know where to put things, "preferred" with an empty mask means "local" */
+        if (IN_SET(p->type, MPOL_BIND, MPOL_INTERLEAVE) && !numa_policy_has_nodes(p))
+                return false;
+
+        return true;
+}
+
+int apply_numa_policy(const NUMAPolicy *p) {
+        const unsigned long *nodes = NULL;
+        unsigned long maxnode = 0;
+
+        assert(p);
+
+        if (get_mempolicy(NULL, NULL, 0, NULL, 0) < 0 && errno == ENOSYS)
+                return -EOPNOTSUPP;
+
+        if (!numa_policy_is_valid(p))
+                return -EINVAL;
+
+        /* The kernel refuses a node mask for these two */
+        if (!IN_SET(p->type, MPOL_DEFAULT, MPOL_LOCAL) && numa_policy_has_nodes(p)) {
+                nodes = (const unsigned long*) p->nodes;
+
+                /* The kernel treats maxnode off by one, and only looks at the first maxnode - 1 bits */
+                maxnode = p->n_nodes + 1;
+        }
+
+        if (set_mempolicy(p->type, nodes, maxnode) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static const char* const mpol_table[] = {
+        [MPOL_DEFAULT]    = "default",
+        [MPOL_PREFERRED]  = "preferred",
+        [MPOL_BIND]       = "bind",
+        [MPOL_INTERLEAVE] = "interleave",
+        [MPOL_LOCAL]      = "local",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(mpol, int);
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <stdbool.h>
+
+#include "cpu-set-util.h"
+#include "macro.h"
+
+typedef struct NUMAPolicy {
+        /* One of MPOL_DEFAULT, MPOL_PREFERRED, MPOL_BIND, MPOL_INTERLEAVE, MPOL_LOCAL, or -1 if unset */
+        int type;
+
+        /* The node mask. The kernel's nodemask_t uses the same bit layout as cpu_set_t, hence let's reuse the cpu
+         * set helpers for parsing it. NULL for the empty mask. */
+        cpu_set_t *nodes;
+        unsigned n_nodes;
+} NUMAPolicy;
+
+static inline bool mpol_is_valid(int t) {
+        return t >= MPOL_DEFAULT && t <= MPOL_LOCAL;
+}
+
+static inline void numa_policy_reset(NUMAPolicy *p) {
+        assert(p);
+
+        p->nodes = cpu_set_mfree(p->nodes);
+        p->n_nodes = 0;
+        p->type = -1;
+}
+
+bool numa_policy_is_valid(const NUMAPolicy *p);
+int apply_numa_policy(const NUMAPolicy *p);
+
+const char* mpol_to_string(int i) _const_;
+int mpol_from_string(const char *s) _pure_;
@@ -1,16 +1,22 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <errno.h>
+#include <linux/filter.h>
 #include <linux/seccomp.h>
 #include <seccomp.h>
 #include <stddef.h>
 #include <sys/mman.h>
 #include <sys/prctl.h>
 #include <sys/shm.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "af-list.h"
 #include "alloc-util.h"
+#include "bitmap.h"
+#include "fd-util.h"
 #include "macro.h"
+#include "memfd-util.h"
 #include "nsflags.h"
 #include "process-util.h"
 #include "seccomp-util.h"
@@ -859,6 +865,95 @@ const SyscallFilterSet *syscall_filter_set_find(const char *name) {
         return NULL;
 }
 
+/* libseccomp uses negative numbers for system calls that do not exist on the native architecture, hence they are
+ * stored with this bias in a Bitmap. If a number does not fit even so, resolving a set fails with -ERANGE, and the
+ * set is added name by name instead. */
+#define SYSCALL_BITMAP_BIAS 0x4000
+
+static int seccomp_add_syscall_rule(scmp_filter_ctx seccomp, uint32_t action, int id, bool log_missing) {
+        int r;
+
+        assert(seccomp);
+
+        r = seccomp_rule_add_exact(seccomp, action, id, 0);
+        if (r < 0) {
+                /* If the system call is not known on this architecture, then that's fine, let's ignore it */
+                _cleanup_free_ char *n = NULL;
+                bool ignore;
+
+                n = seccomp_syscall_resolve_num_arch(SCMP_ARCH_NATIVE, id);
+                ignore = r == -EDOM;
+                if (!ignore || log_missing)
+                        log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
+                                        strna(n), id, ignore ? ", ignoring" : "");
+                if (!ignore)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int syscall_filter_set_resolve(const SyscallFilterSet *set, char **exclude, bool log_missing, Bitmap *b) {
+        const char *sys;
+        int r;
+
+        assert(set);
+        assert(b);
+
+        /* Collects the system calls of the set and of all sets it includes, so that each one is resolved once and
+         * added only once, however often it is listed. */
+
+        NULSTR_FOREACH(sys, set->value) {
+
+                if (strv_contains(exclude, sys))
+                        continue;
+
+                if (sys[0] == '@') {
+                        const SyscallFilterSet *other;
+
+                        other = syscall_filter_set_find(sys);
+                        if (!other)
+                                return log_debug_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Filter set %s is not known!",
+                                                       sys);
+
+                        r = syscall_filter_set_resolve(other, exclude, log_missing, b);
+                } else {
+                        int id;
+
+                        id = seccomp_syscall_resolve_name(sys);
+                        if (id == __NR_SCMP_ERROR) {
+                                if (log_missing)
+                                        log_debug("System call %s is not known, ignoring.", sys);
+                                continue;
+                        }
+
+                        if (id < -SYSCALL_BITMAP_BIAS)
+                                return -ERANGE;
+
+                        r = bitmap_set(b, id + SYSCALL_BITMAP_BIAS);
+                }
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int seccomp_add_syscall_bitmap(scmp_filter_ctx seccomp, Bitmap *b, uint32_t action, bool log_missing) {
+        Iterator i;
+        unsigned n;
+        int r;
+
+        BITMAP_FOREACH(n, b, i) {
+                r = seccomp_add_syscall_rule(seccomp, action, (int) n - SYSCALL_BITMAP_BIAS, log_missing);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 static int seccomp_add_syscall_filter_set(scmp_filter_ctx seccomp, const SyscallFilterSet *set, uint32_t action, char **exclude, bool log_missing);
 
 int seccomp_add_syscall_filter_item(scmp_filter_ctx *seccomp, const char *name, uint32_t action, char **exclude, bool log_missing) {
@@ -869,7 +964,9 @@ int seccomp_add_syscall_filter_item(scmp_filter_ctx *seccomp, const char *name,
                 return 0;
 
         if (name[0] == '@') {
+                _cleanup_bitmap_free_ Bitmap *b = NULL;
                 const SyscallFilterSet *other;
+                int r;
 
                 other = syscall_filter_set_find(name);
                 if (!other)
@@ -877,10 +974,20 @@ int seccomp_add_syscall_filter_item(scmp_filter_ctx *seccomp, const char *name,
                                                "Filter set %s is not known!",
                                                name);
 
-                return seccomp_add_syscall_filter_set(seccomp, other, action, exclude, log_missing);
+                b = bitmap_new();
+                if (!b)
+                        return -ENOMEM;
+
+                r = syscall_filter_set_resolve(other, exclude, log_missing, b);
+                if (r == -ERANGE)
+                        return seccomp_add_syscall_filter_set(seccomp, other, action, exclude, log_missing);
+                if (r < 0)
+                        return r;
+
+                return seccomp_add_syscall_bitmap(seccomp, b, action, log_missing);
 
         } else {
-                int id, r;
+                int id;
 
                 id = seccomp_syscall_resolve_name(name);
                 if (id == __NR_SCMP_ERROR) {
@@ -889,19 +996,7 @@ int seccomp_add_syscall_filter_item(scmp_filter_ctx *seccomp, const char *name,
                         return 0;
                 }
 
-                r = seccomp_rule_add_exact(seccomp, action, id, 0);
-                if (r < 0) {
-                        /* If the system call is not known on this architecture, then that's fine, let's ignore it */
-                        bool ignore = r == -EDOM;
-
-                        if (!ignore || log_missing)
-                                log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
-                                                name, id, ignore ? ", ignoring" : "");
-                        if (!ignore)
-                                return r;
-                }
-
-                return 0;
+                return seccomp_add_syscall_rule(seccomp, action, id, log_missing);
         }
 }
 
@@ -928,13 +1023,25 @@ static int seccomp_add_syscall_filter_set(
 }
 
 int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilterSet *set, uint32_t action, bool log_missing) {
+        _cleanup_bitmap_free_ Bitmap *b = NULL;
         uint32_t arch;
         int r;
 
         assert(set);
 
         /* The one-stop solution: allocate a seccomp object, add the specified filter to it, and apply it. Once for
-         * each local arch. */
+         * each local arch. The system calls in the set are looked up only once, for all archs. */
+
+        b = bitmap_new();
+        if (!b)
+                return -ENOMEM;
+
+        r = syscall_filter_set_resolve(set, NULL, log_missing, b);
+        if (r == -ERANGE) {
+                bitmap_free(b);
+                b = NULL;
+        } else if (r < 0)
+                return log_debug_errno(r, "Failed to add filter set: %m");
 
         SECCOMP_FOREACH_LOCAL_ARCH(arch) {
                 _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
@@ -945,7 +1052,10 @@ int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilter
                 if (r < 0)
                         return r;
 
-                r = seccomp_add_syscall_filter_set(seccomp, set, action, NULL, log_missing);
+                if (b)
+                        r = seccomp_add_syscall_bitmap(seccomp, b, action, log_missing);
+                else
+                        r = seccomp_add_syscall_filter_set(seccomp, set, action, NULL, log_missing);
                 if (r < 0)
                         return log_debug_errno(r, "Failed to add filter set: %m");
 
@@ -959,6 +1069,42 @@ int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilter
         return 0;
 }
 
+static int seccomp_build_syscall_filter_set_raw(
+                scmp_filter_ctx *ret,
+                uint32_t arch,
+                uint32_t default_action,
+                Hashmap* set,
+                uint32_t action,
+                bool log_missing) {
+
+        _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
+        Iterator i;
+        void *syscall_id, *val;
+        int r;
+
+        assert(ret);
+
+        r = seccomp_init_for_arch(&seccomp, arch, default_action);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(val, syscall_id, set, i) {
+                uint32_t a = action;
+                int id = PTR_TO_INT(syscall_id) - 1;
+                int error = PTR_TO_INT(val);
+
+                if (action != SCMP_ACT_ALLOW && error >= 0)
+                        a = SCMP_ACT_ERRNO(error);
+
+                r = seccomp_add_syscall_rule(seccomp, a, id, log_missing);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(seccomp);
+        return 0;
+}
+
 int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, uint32_t action, bool log_missing) {
         uint32_t arch;
         int r;
@@ -971,39 +1117,13 @@ int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, u
 
         SECCOMP_FOREACH_LOCAL_ARCH(arch) {
                 _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
-                Iterator i;
-                void *syscall_id, *val;
 
                 log_debug("Operating on architecture: %s", seccomp_arch_to_string(arch));
 
-                r = seccomp_init_for_arch(&seccomp, arch, default_action);
+                r = seccomp_build_syscall_filter_set_raw(&seccomp, arch, default_action, set, action, log_missing);
                 if (r < 0)
                         return r;
 
-                HASHMAP_FOREACH_KEY(val, syscall_id, set, i) {
-                        uint32_t a = action;
-                        int id = PTR_TO_INT(syscall_id) - 1;
-                        int error = PTR_TO_INT(val);
-
-                        if (action != SCMP_ACT_ALLOW && error >= 0)
-                                a = SCMP_ACT_ERRNO(error);
-
-                        r = seccomp_rule_add_exact(seccomp, a, id, 0);
-                        if (r < 0) {
-                                /* If the system call is not known on this architecture, then that's fine, let's ignore it */
-                                _cleanup_free_ char *n = NULL;
-                                bool ignore;
-
-                                n = seccomp_syscall_resolve_num_arch(SCMP_ARCH_NATIVE, id);
-                                ignore = r == -EDOM;
-                                if (!ignore || log_missing)
-                                        log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
-                                                        strna(n), id, ignore ? ", ignoring" : "");
-                                if (!ignore)
-                                        return r;
-                        }
-                }
-
                 r = seccomp_load(seccomp);
                 if (IN_SET(r, -EPERM, -EACCES))
                         return r;
@@ -1014,6 +1134,148 @@ int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, u
         return 0;
 }
 
+typedef struct SeccompArchProgram {
+        uint32_t arch;
+        struct sock_filter *insns;
+        size_t n_insns;
+} SeccompArchProgram;
+
+struct SeccompProgram {
+        SeccompArchProgram *archs;
+        size_t n_archs;
+        size_t n_allocated;
+};
+
+SeccompProgram* seccomp_program_free(SeccompProgram *p) {
+        size_t k;
+
+        if (!p)
+                return NULL;
+
+        for (k = 0; k < p->n_archs; k++)
+                free(p->archs[k].insns);
+
+        free(p->archs);
+        return mfree(p);
+}
+
+static int seccomp_export(scmp_filter_ctx seccomp, struct sock_filter **ret, size_t *ret_n) {
+        _cleanup_free_ struct sock_filter *insns = NULL;
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+        ssize_t n;
+        int r;
+
+        assert(seccomp);
+        assert(ret);
+        assert(ret_n);
+
+        fd = memfd_new("seccomp-filter");
+        if (fd < 0)
+                return fd;
+
+        r = seccomp_export_bpf(seccomp, fd);
+        if (r < 0)
+                return r;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (st.st_size <= 0 || st.st_size % sizeof(struct sock_filter) != 0)
+                return -EBADMSG;
+        if ((size_t) st.st_size / sizeof(struct sock_filter) > USHRT_MAX) /* sock_fprog.len is 16bit */
+                return -E2BIG;
+
+        insns = malloc(st.st_size);
+        if (!insns)
+                return -ENOMEM;
+
+        n = pread(fd, insns, st.st_size, 0);
+        if (n < 0)
+                return -errno;
+        if (n != st.st_size)
+                return -EIO;
+
+        *ret = TAKE_PTR(insns);
+        *ret_n = (size_t) st.st_size / sizeof(struct sock_filter);
+        return 0;
+}
+
+int seccomp_compile_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, uint32_t action, bool log_missing, SeccompProgram **ret) {
+        _cleanup_(seccomp_program_freep) SeccompProgram *p = NULL;
+        uint32_t arch;
+        int r;
+
+        /* Like seccomp_load_syscall_filter_set_raw(), but instead of applying the filters right away, generates the
+         * BPF programs for all local archs, so that seccomp_program_load() can install them, possibly many times,
+         * without going through libseccomp again. Returns 0 and NULL if there is nothing to install. */
+
+        assert(ret);
+
+        if (hashmap_isempty(set) && default_action == SCMP_ACT_ALLOW) {
+                *ret = NULL;
+                return 0;
+        }
+
+        p = new0(SeccompProgram, 1);
+        if (!p)
+                return -ENOMEM;
+
+        SECCOMP_FOREACH_LOCAL_ARCH(arch) {
+                _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
+                SeccompArchProgram *a;
+
+                r = seccomp_build_syscall_filter_set_raw(&seccomp, arch, default_action, set, action, log_missing);
+                if (r < 0)
+                        return r;
+
+                if (!GREEDY_REALLOC(p->archs, p->n_allocated, p->n_archs + 1))
+                        return -ENOMEM;
+
+                a = p->archs + p->n_archs;
+                *a = (SeccompArchProgram) {
+                        .arch = arch,
+                };
+
+                r = seccomp_export(seccomp, &a->insns, &a->n_insns);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to generate filter for architecture %s: %m", seccomp_arch_to_string(arch));
+
+                p->n_archs++;
+        }
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+int seccomp_program_load(const SeccompProgram *p) {
+        size_t k;
+        int r;
+
+        /* Installs the filters generated by seccomp_compile_syscall_filter_set_raw(). Follows the error handling of
+         * seccomp_load_syscall_filter_set_raw(): only a failure due to missing privileges is fatal. */
+
+        if (!p)
+                return 0;
+
+        for (k = 0; k < p->n_archs; k++) {
+                struct sock_fprog fprog = {
+                        .len = (unsigned short) p->archs[k].n_insns,
+                        .filter = p->archs[k].insns,
+                };
+
+                if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog, 0, 0) < 0) {
+                        r = -errno;
+                        if (IN_SET(r, -EPERM, -EACCES))
+                                return r;
+
+                        log_debug_errno(r, "Failed to install filter set for architecture %s, skipping: %m", seccomp_arch_to_string(p->archs[k].arch));
+                }
+        }
+
+        return 0;
+}
+
 int seccomp_parse_syscall_filter_full(
                 const char *name,
                 int errno_num,
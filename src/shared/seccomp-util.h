@@ -63,6 +63,13 @@ int seccomp_add_syscall_filter_item(scmp_filter_ctx *ctx, const char *name, uint
 int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilterSet *set, uint32_t action, bool log_missing);
 int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, uint32_t action, bool log_missing);
 
+typedef struct SeccompProgram SeccompProgram;
+
+int seccomp_compile_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, uint32_t action, bool log_missing, SeccompProgram **ret);
+int seccomp_program_load(const SeccompProgram *p);
+SeccompProgram* seccomp_program_free(SeccompProgram *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(SeccompProgram*, seccomp_program_free);
+
 typedef enum SeccompParseFlags {
         SECCOMP_PARSE_INVERT     = 1 << 0,
         SECCOMP_PARSE_WHITELIST  = 1 << 1,
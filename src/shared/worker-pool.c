@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <pthread.h>
+#include <signal.h>
+
+#include "alloc-util.h"
+#include "log.h"
+#include "macro.h"
+#include "worker-pool.h"
+
+#define WORKER_THREADS_MAX 8U
+#define WORKER_QUEUE_MAX 256U
+
+struct WorkerPool {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        void *queue[WORKER_QUEUE_MAX];
+        size_t queue_start, n_queued;
+        unsigned n_busy;
+        bool shutdown;
+
+        /* The first error returned for any of the jobs */
+        int error;
+
+        pthread_t threads[WORKER_THREADS_MAX];
+        unsigned n_threads;
+
+        worker_func_t func;
+        free_func_t free_job;
+        void *userdata;
+};
+
+static void *worker_pool_thread(void *userdata) {
+        WorkerPool *p = userdata;
+
+        (void) pthread_setname_np(pthread_self(), "sd-worker");
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        for (;;) {
+                void *j;
+                int r;
+
+                if (p->n_queued == 0) {
+                        /* Busy threads might still add jobs */
+                        if (p->shutdown && p->n_busy == 0)
+                                break;
+
+                        assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+                        continue;
+                }
+
+                j = p->queue[p->queue_start];
+                p->queue_start = (p->queue_start + 1) % WORKER_QUEUE_MAX;
+                p->n_queued--;
+                p->n_busy++;
+
+                /* There's room in the queue again */
+                assert_se(pthread_cond_broadcast(&p->cond) == 0);
+
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+                r = p->func(j, p->userdata);
+                p->free_job(j);
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                if (r < 0 && p->error == 0)
+                        p->error = r;
+
+                p->n_busy--;
+
+                /* Others might be waiting for us to finish */
+                assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return NULL;
+}
+
+WorkerPool *worker_pool_new(worker_func_t func, free_func_t free_job, void *userdata) {
+        _cleanup_free_ WorkerPool *p = NULL;
+        sigset_t ss, saved_ss;
+        int r;
+
+        assert(func);
+        assert(free_job);
+
+        p = new(WorkerPool, 1);
+        if (!p)
+                return NULL;
+
+        *p = (WorkerPool) {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+                .func = func,
+                .free_job = free_job,
+                .userdata = userdata,
+        };
+
+        /* Start the threads with all signals blocked, so that they do not affect signal handling in the calling
+         * thread, see asynchronous_job() */
+        assert_se(sigfillset(&ss) >= 0);
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return NULL;
+
+        /* The work is bound by I/O, not by CPU, hence the number of CPUs is not taken into account */
+        for (; p->n_threads < WORKER_THREADS_MAX; p->n_threads++) {
+                r = pthread_create(p->threads + p->n_threads, NULL, worker_pool_thread, p);
+                if (r > 0) {
+                        log_debug_errno(r, "Failed to start worker thread: %m");
+                        break;
+                }
+        }
+
+        assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+
+        if (p->n_threads == 0) {
+                pthread_cond_destroy(&p->cond);
+                pthread_mutex_destroy(&p->mutex);
+                return NULL;
+        }
+
+        return TAKE_PTR(p);
+}
+
+static bool worker_pool_add_internal(WorkerPool *p, void *job, bool wait) {
+        bool added = false;
+
+        assert(p);
+        assert(job);
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        while (wait && p->n_queued >= WORKER_QUEUE_MAX)
+                assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+
+        if (p->n_queued < WORKER_QUEUE_MAX) {
+                p->queue[(p->queue_start + p->n_queued) % WORKER_QUEUE_MAX] = job;
+                p->n_queued++;
+                added = true;
+
+                assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return added;
+}
+
+void worker_pool_add(WorkerPool *p, void *job) {
+        assert_se(worker_pool_add_internal(p, job, true));
+}
+
+bool worker_pool_try_add(WorkerPool *p, void *job) {
+        return worker_pool_add_internal(p, job, false);
+}
+
+int worker_pool_finish(WorkerPool *p) {
+        unsigned i;
+        int r;
+
+        if (!p)
+                return 0;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        p->shutdown = true;
+        assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        for (i = 0; i < p->n_threads; i++)
+                assert_se(pthread_join(p->threads[i], NULL) == 0);
+
+        assert(p->n_queued == 0);
+        r = p->error;
+
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+        free(p);
+
+        return r;
+}
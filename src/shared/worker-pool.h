@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "alloc-util.h"
+
+/* Huge directory trees take a long time to walk, mostly waiting for metadata I/O. Hence parts of them are handed to
+ * a pool of threads, so that many requests are in flight at the same time. The queue of pending jobs is bounded. Jobs
+ * may be added by the threads themselves too, but only if there's room, as they'd wait for each other otherwise.
+ * Callers then simply do the work on their own. */
+
+typedef struct WorkerPool WorkerPool;
+
+typedef int (*worker_func_t)(void *job, void *userdata);
+
+/* Returns NULL if not a single thread could be started, callers should then do the work serially */
+WorkerPool *worker_pool_new(worker_func_t func, free_func_t free_job, void *userdata);
+
+/* Takes possession of job, waits for room in the queue if needed. Must not be called from the pool's threads. */
+void worker_pool_add(WorkerPool *p, void *job);
+
+/* Takes possession of job only if there's room in the queue right now, and returns true if so */
+bool worker_pool_try_add(WorkerPool *p, void *job);
+
+/* Waits for all jobs to be done, including the ones added in the meantime, frees the pool, and returns the first
+ * error any job returned */
+int worker_pool_finish(WorkerPool *p);
@@ -168,6 +168,7 @@ static OutputMode arg_output = OUTPUT_SHORT;
 static bool arg_plain = false;
 static bool arg_firmware_setup = false;
 static bool arg_now = false;
+static bool arg_incremental = false;
 static bool arg_jobs_before = false;
 static bool arg_jobs_after = false;
 
@@ -2887,111 +2888,263 @@ static int on_properties_changed(sd_bus_message *m, void *userdata, sd_bus_error
         return 0;
 }
 
-static int start_unit_one(
-                sd_bus *bus,
-                const char *method,
-                const char *name,
-                const char *mode,
-                sd_bus_error *error,
-                BusWaitForJobs *w,
-                WaitContext *wait_context) {
+/* How many StartUnit() and friends calls we keep in flight at the same time */
+#define START_UNIT_CALLS_MAX 64U
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
-        const char *path;
-        int r;
+typedef struct StartUnitCall StartUnitCall;
 
-        assert(method);
-        assert(name);
-        assert(mode);
-        assert(error);
+typedef struct {
+        sd_bus *bus;
+        const char *method;
+        const char *mode;
+        BusWaitForJobs *w;
 
-        if (wait_context) {
-                _cleanup_free_ char *unit_path = NULL;
+        StartUnitCall *calls;
+        size_t n_calls;
+        unsigned n_pending;
+        unsigned n_replies;
 
-                log_debug("Watching for property changes of %s", name);
-                r = sd_bus_call_method(
-                                bus,
-                                "org.freedesktop.systemd1",
-                                "/org/freedesktop/systemd1",
-                                "org.freedesktop.systemd1.Manager",
-                                "RefUnit",
-                                error,
-                                NULL,
-                                "s", name);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to RefUnit %s: %s", name, bus_error_message(error, r));
+        char **stopped_units; /* Do not use _cleanup_strv_free_ */
+        int ret;
+} StartUnitContext;
 
-                unit_path = unit_dbus_path_from_name(name);
-                if (!unit_path)
-                        return log_oom();
+struct StartUnitCall {
+        StartUnitContext *context;
+        const char *name;
+        bool skip;
+
+        sd_bus_slot *slot;
+        sd_bus_slot *reload_slot;
+};
 
-                r = set_put_strdup(wait_context->unit_paths, unit_path);
+static void start_unit_context_free(StartUnitContext *c) {
+        size_t i;
+
+        for (i = 0; i < c->n_calls; i++) {
+                sd_bus_slot_unref(c->calls[i].slot);
+                sd_bus_slot_unref(c->calls[i].reload_slot);
+        }
+
+        c->calls = mfree(c->calls);
+        c->n_calls = 0;
+        c->stopped_units = mfree(c->stopped_units);
+}
+
+static int start_unit_context_wait(StartUnitContext *c, unsigned max_pending) {
+        int r;
+
+        assert(c);
+
+        while (c->n_pending > max_pending) {
+                r = sd_bus_process(c->bus, NULL);
                 if (r < 0)
-                        return log_error_errno(r, "Failed to add unit path %s to set: %m", unit_path);
-
-                r = sd_bus_match_signal_async(bus,
-                                              &wait_context->match,
-                                              NULL,
-                                              unit_path,
-                                              "org.freedesktop.DBus.Properties",
-                                              "PropertiesChanged",
-                                              on_properties_changed, NULL, wait_context);
+                        return log_error_errno(r, "Failed to process bus: %m");
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(c->bus, (uint64_t) -1);
                 if (r < 0)
-                        return log_error_errno(r, "Failed to request match for PropertiesChanged signal: %m");
+                        return log_error_errno(r, "Failed to wait for bus: %m");
         }
 
-        log_debug("%s dbus call org.freedesktop.systemd1.Manager %s(%s, %s)",
-                  arg_dry_run ? "Would execute" : "Executing",
-                  method, name, mode);
-        if (arg_dry_run)
-                return 0;
+        return 0;
+}
+
+static void start_unit_context_fail(StartUnitContext *c, int r, const sd_bus_error *error) {
+        assert(c);
+        assert(error);
 
+        if (c->ret == EXIT_SUCCESS)
+                c->ret = translate_bus_error_to_exit_status(r, error);
+}
+
+static int start_unit_watch_one(sd_bus *bus, const char *name, WaitContext *wait_context) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ char *unit_path = NULL;
+        int r;
+
+        assert(bus);
+        assert(name);
+        assert(wait_context);
+
+        log_debug("Watching for property changes of %s", name);
         r = sd_bus_call_method(
                         bus,
                         "org.freedesktop.systemd1",
                         "/org/freedesktop/systemd1",
                         "org.freedesktop.systemd1.Manager",
-                        method,
-                        error,
-                        &reply,
-                        "ss", name, mode);
+                        "RefUnit",
+                        &error,
+                        NULL,
+                        "s", name);
         if (r < 0) {
+                log_error_errno(r, "Failed to RefUnit %s: %s", name, bus_error_message(&error, r));
+                return translate_bus_error_to_exit_status(r, &error);
+        }
+
+        unit_path = unit_dbus_path_from_name(name);
+        if (!unit_path)
+                return log_oom();
+
+        r = set_put_strdup(wait_context->unit_paths, unit_path);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add unit path %s to set: %m", unit_path);
+
+        r = sd_bus_match_signal_async(bus,
+                                      &wait_context->match,
+                                      NULL,
+                                      unit_path,
+                                      "org.freedesktop.DBus.Properties",
+                                      "PropertiesChanged",
+                                      on_properties_changed, NULL, wait_context);
+        if (r < 0)
+                return log_error_errno(r, "Failed to request match for PropertiesChanged signal: %m");
+
+        return 0;
+}
+
+static int on_need_daemon_reload_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        StartUnitCall *call = userdata;
+        int b, r;
+
+        assert(call);
+        assert(call->context->n_pending > 0);
+
+        call->context->n_pending--;
+
+        /* We ignore all errors here, since this is used to show a
+         * warning only */
+
+        if (sd_bus_message_is_method_error(m, NULL))
+                return 0;
+
+        r = sd_bus_message_read(m, "v", "b", &b);
+        if (r < 0)
+                return 0;
+
+        if (b)
+                warn_unit_file_changed(call->name);
+
+        return 0;
+}
+
+static int on_start_unit_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        _cleanup_free_ char *unit_path = NULL;
+        StartUnitCall *call = userdata;
+        StartUnitContext *c;
+        const sd_bus_error *error;
+        const char *path;
+        int r;
+
+        assert(call);
+
+        c = call->context;
+        assert(c->n_pending > 0);
+
+        c->n_pending--;
+        c->n_replies++;
+
+        error = sd_bus_message_get_error(m);
+        if (error) {
                 const char *verb;
 
+                r = -sd_bus_error_get_errno(error);
+
                 /* There's always a fallback possible for legacy actions. */
-                if (arg_action != ACTION_SYSTEMCTL)
-                        return r;
+                if (arg_action == ACTION_SYSTEMCTL) {
+                        verb = method_to_verb(c->method);
+
+                        log_error("Failed to %s %s: %s", verb, call->name, bus_error_message(error, r));
+
+                        if (!sd_bus_error_has_name(error, BUS_ERROR_NO_SUCH_UNIT) &&
+                            !sd_bus_error_has_name(error, BUS_ERROR_UNIT_MASKED) &&
+                            !sd_bus_error_has_name(error, BUS_ERROR_JOB_TYPE_NOT_APPLICABLE))
+                                log_error("See %s logs and 'systemctl%s status%s %s' for details.",
+                                           arg_scope == UNIT_FILE_SYSTEM ? "system" : "user",
+                                           arg_scope == UNIT_FILE_SYSTEM ? "" : " --user",
+                                           call->name[0] == '-' ? " --" : "",
+                                           call->name);
+                }
 
-                verb = method_to_verb(method);
+                start_unit_context_fail(c, r, error);
+                return 0;
+        }
 
-                log_error("Failed to %s %s: %s", verb, name, bus_error_message(error, r));
+        r = sd_bus_message_read(m, "o", &path);
+        if (r < 0) {
+                start_unit_context_fail(c, bus_log_parse_error(r), &SD_BUS_ERROR_NULL);
+                return 0;
+        }
 
-                if (!sd_bus_error_has_name(error, BUS_ERROR_NO_SUCH_UNIT) &&
-                    !sd_bus_error_has_name(error, BUS_ERROR_UNIT_MASKED) &&
-                    !sd_bus_error_has_name(error, BUS_ERROR_JOB_TYPE_NOT_APPLICABLE))
-                        log_error("See %s logs and 'systemctl%s status%s %s' for details.",
-                                   arg_scope == UNIT_FILE_SYSTEM ? "system" : "user",
-                                   arg_scope == UNIT_FILE_SYSTEM ? "" : " --user",
-                                   name[0] == '-' ? " --" : "",
-                                   name);
+        /* The unit is loaded now that a job was enqueued for it, hence we can ask it directly whether its
+         * configuration changed, instead of going through GetUnit() as need_daemon_reload() does. */
+        unit_path = unit_dbus_path_from_name(call->name);
+        if (!unit_path) {
+                start_unit_context_fail(c, log_oom(), &SD_BUS_ERROR_NULL);
+                return 0;
+        }
 
-                return r;
+        r = sd_bus_call_method_async(
+                        c->bus,
+                        &call->reload_slot,
+                        "org.freedesktop.systemd1",
+                        unit_path,
+                        "org.freedesktop.DBus.Properties",
+                        "Get",
+                        on_need_daemon_reload_reply,
+                        call,
+                        "ss", "org.freedesktop.systemd1.Unit", "NeedDaemonReload");
+        if (r >= 0)
+                c->n_pending++;
+
+        if (c->w) {
+                log_debug("Adding %s to the set", path);
+                r = bus_wait_for_jobs_add(c->w, path);
+                if (r < 0) {
+                        start_unit_context_fail(c, log_oom(), &SD_BUS_ERROR_NULL);
+                        return 0;
+                }
         }
 
-        r = sd_bus_message_read(reply, "o", &path);
-        if (r < 0)
-                return bus_log_parse_error(r);
+        if (streq(c->method, "StopUnit") && strv_push(&c->stopped_units, (char*) call->name) < 0)
+                start_unit_context_fail(c, log_oom(), &SD_BUS_ERROR_NULL);
 
-        if (need_daemon_reload(bus, name) > 0)
-                warn_unit_file_changed(name);
+        return 0;
+}
 
-        if (w) {
-                log_debug("Adding %s to the set", path);
-                r = bus_wait_for_jobs_add(w, path);
-                if (r < 0)
+static int start_unit_one(StartUnitContext *c, StartUnitCall *call) {
+        int r;
+
+        assert(c);
+        assert(call);
+
+        log_debug("%s dbus call org.freedesktop.systemd1.Manager %s(%s, %s)",
+                  arg_dry_run ? "Would execute" : "Executing",
+                  c->method, call->name, c->mode);
+        if (arg_dry_run) {
+                if (streq(c->method, "StopUnit") && strv_push(&c->stopped_units, (char*) call->name) < 0)
                         return log_oom();
+
+                return 0;
         }
 
+        r = sd_bus_call_method_async(
+                        c->bus,
+                        &call->slot,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        c->method,
+                        on_start_unit_reply,
+                        call,
+                        "ss", call->name, c->mode);
+        if (r < 0) {
+                log_error_errno(r, "Failed to %s %s: %m", method_to_verb(c->method), call->name);
+                start_unit_context_fail(c, r, &SD_BUS_ERROR_NULL);
+                return 0;
+        }
+
+        c->n_pending++;
         return 0;
 }
 
@@ -3089,12 +3242,13 @@ static enum action verb_to_action(const char *verb) {
 static int start_unit(int argc, char *argv[], void *userdata) {
         _cleanup_(bus_wait_for_jobs_freep) BusWaitForJobs *w = NULL;
         _cleanup_(wait_context_free) WaitContext wait_context = {};
+        _cleanup_(start_unit_context_free) StartUnitContext context = {};
         const char *method, *mode, *one_name, *suffix = NULL;
-        _cleanup_free_ char **stopped_units = NULL; /* Do not use _cleanup_strv_free_ */
         _cleanup_strv_free_ char **names = NULL;
-        int r, ret = EXIT_SUCCESS;
         sd_bus *bus;
         char **name;
+        size_t i;
+        int r;
 
         if (arg_wait && !STR_IN_SET(argv[0], "start", "restart")) {
                 log_error("--wait may only be used with the 'start' or 'restart' commands.");
@@ -3181,20 +3335,57 @@ static int start_unit(int argc, char *argv[], void *userdata) {
                         return log_error_errno(r, "Failed to attach bus to event loop: %m");
         }
 
-        STRV_FOREACH(name, names) {
-                _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        context = (StartUnitContext) {
+                .bus = bus,
+                .method = method,
+                .mode = mode,
+                .w = w,
+                .n_calls = strv_length(names),
+                .ret = EXIT_SUCCESS,
+        };
 
-                r = start_unit_one(bus, method, *name, mode, &error, w, arg_wait ? &wait_context : NULL);
-                if (ret == EXIT_SUCCESS && r < 0)
-                        ret = translate_bus_error_to_exit_status(r, &error);
+        context.calls = new0(StartUnitCall, context.n_calls);
+        if (!context.calls && context.n_calls > 0)
+                return log_oom();
 
-                if (r >= 0 && streq(method, "StopUnit")) {
-                        r = strv_push(&stopped_units, *name);
-                        if (r < 0)
-                                return log_oom();
+        for (i = 0; i < context.n_calls; i++) {
+                context.calls[i].context = &context;
+                context.calls[i].name = names[i];
+        }
+
+        /* Register all the units we wait for before the first job is enqueued, so that the event loop
+         * doesn't consider itself done just because the first units already finished. */
+        if (arg_wait)
+                for (i = 0; i < context.n_calls; i++) {
+                        r = start_unit_watch_one(bus, names[i], &wait_context);
+                        if (r != 0) {
+                                if (context.ret == EXIT_SUCCESS)
+                                        context.ret = r;
+
+                                context.calls[i].skip = true;
+                        }
                 }
+
+        /* Enqueue the jobs asynchronously, so that we don't pay a full round trip for each unit. Until
+         * the first reply arrived we keep only a single call in flight though, so that the user is asked
+         * for authorization only once, should that be necessary. */
+        for (i = 0; i < context.n_calls; i++) {
+                if (context.calls[i].skip)
+                        continue;
+
+                r = start_unit_context_wait(&context, context.n_replies > 0 ? START_UNIT_CALLS_MAX - 1 : 0);
+                if (r < 0)
+                        return r;
+
+                r = start_unit_one(&context, context.calls + i);
+                if (r < 0)
+                        return r;
         }
 
+        r = start_unit_context_wait(&context, 0);
+        if (r < 0)
+                return r;
+
         if (!arg_no_block) {
                 const char* extra_args[4] = {};
                 int arg_count = 0;
@@ -3218,19 +3409,19 @@ static int start_unit(int argc, char *argv[], void *userdata) {
                 /* When stopping units, warn if they can still be triggered by
                  * another active unit (socket, path, timer) */
                 if (!arg_quiet)
-                        STRV_FOREACH(name, stopped_units)
+                        STRV_FOREACH(name, context.stopped_units)
                                 (void) check_triggering_units(bus, *name);
         }
 
-        if (ret == EXIT_SUCCESS && arg_wait && !set_isempty(wait_context.unit_paths)) {
+        if (context.ret == EXIT_SUCCESS && arg_wait && !set_isempty(wait_context.unit_paths)) {
                 r = sd_event_loop(wait_context.event);
                 if (r < 0)
                         return log_error_errno(r, "Failed to run event loop: %m");
                 if (wait_context.any_failed)
-                        ret = EXIT_FAILURE;
+                        context.ret = EXIT_FAILURE;
         }
 
-        return ret;
+        return context.ret;
 }
 
 #if ENABLE_LOGIND
@@ -3721,7 +3912,59 @@ static int start_system_special(int argc, char *argv[], void *userdata) {
         return start_special(argc, argv, userdata);
 }
 
+static int get_state_exported(char **args, UnitActiveState **ret) {
+        _cleanup_free_ UnitActiveState *states = NULL;
+        size_t n = 0;
+        char **name;
+        int r;
+
+        assert(ret);
+
+        /* PID 1 exports the active state of the units it has loaded to /run/systemd/units/, which allows us to
+         * answer the common case of checking a couple of units of the local system manager without connecting
+         * to it. Returns -EOPNOTSUPP if that's not possible, and the caller should ask PID 1 instead: for globs,
+         * aliases, units that are not loaded or a PID 1 that doesn't export the states. */
+
+        if (arg_transport != BUS_TRANSPORT_LOCAL || arg_scope != UNIT_FILE_SYSTEM)
+                return -EOPNOTSUPP;
+
+        states = new(UnitActiveState, strv_length(args));
+        if (!states)
+                return log_oom();
+
+        STRV_FOREACH(name, args) {
+                _cleanup_free_ char *mangled = NULL;
+
+                r = unit_name_mangle(*name, UNIT_NAME_MANGLE_GLOB, &mangled);
+                if (r < 0 || string_is_glob(mangled))
+                        return -EOPNOTSUPP;
+
+                r = unit_active_state_read_exported(NULL, mangled, states + n);
+                if (r < 0)
+                        return -EOPNOTSUPP;
+
+                n++;
+        }
+
+        *ret = TAKE_PTR(states);
+        return (int) n;
+}
+
+static bool check_unit_state(UnitActiveState active_state, const UnitActiveState good_states[], int nb_states) {
+        int i;
+
+        if (!arg_quiet)
+                puts(unit_active_state_to_string(active_state));
+
+        for (i = 0; i < nb_states; ++i)
+                if (good_states[i] == active_state)
+                        return true;
+
+        return false;
+}
+
 static int check_unit_generic(int code, const UnitActiveState good_states[], int nb_states, char **args) {
+        _cleanup_free_ UnitActiveState *exported = NULL;
         _cleanup_strv_free_ char **names = NULL;
         UnitActiveState active_state;
         sd_bus *bus;
@@ -3729,6 +3972,17 @@ static int check_unit_generic(int code, const UnitActiveState good_states[], int
         int r, i;
         bool found = false;
 
+        r = get_state_exported(args, &exported);
+        if (r >= 0) {
+                for (i = 0; i < r; i++)
+                        if (check_unit_state(exported[i], good_states, nb_states))
+                                found = true;
+
+                return found ? 0 : code;
+        }
+        if (r != -EOPNOTSUPP)
+                return r;
+
         r = acquire_bus(BUS_MANAGER, &bus);
         if (r < 0)
                 return r;
@@ -3742,12 +3996,8 @@ static int check_unit_generic(int code, const UnitActiveState good_states[], int
                 if (r < 0)
                         return r;
 
-                if (!arg_quiet)
-                        puts(unit_active_state_to_string(active_state));
-
-                for (i = 0; i < nb_states; ++i)
-                        if (good_states[i] == active_state)
-                                found = true;
+                if (check_unit_state(active_state, good_states, nb_states))
+                        found = true;
         }
 
         /* use the given return code for the case that we won't find
@@ -5575,29 +5825,47 @@ static int daemon_reload(int argc, char *argv[], void *userdata) {
                 break;
 
         case ACTION_SYSTEMCTL:
-                method = streq(argv[0], "daemon-reexec") ? "Reexecute" :
-                                     /* "daemon-reload" */ "Reload";
+                if (streq(argv[0], "daemon-reexec"))
+                        method = "Reexecute";
+                else /* "daemon-reload" */
+                        method = arg_incremental ? "ReloadIncremental" : "Reload";
                 break;
 
         default:
                 assert_not_reached("Unexpected action");
         }
 
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &m,
-                        "org.freedesktop.systemd1",
-                        "/org/freedesktop/systemd1",
-                        "org.freedesktop.systemd1.Manager",
-                        method);
-        if (r < 0)
-                return bus_log_create_error(r);
+        for (;;) {
+                r = sd_bus_message_new_method_call(
+                                bus,
+                                &m,
+                                "org.freedesktop.systemd1",
+                                "/org/freedesktop/systemd1",
+                                "org.freedesktop.systemd1.Manager",
+                                method);
+                if (r < 0)
+                        return bus_log_create_error(r);
 
-        /* Note we use an extra-long timeout here. This is because a reload or reexec means generators are rerun which
-         * are timed out after DEFAULT_TIMEOUT_USEC. Let's use twice that time here, so that the generators can have
-         * their timeout, and for everything else there's the same time budget in place. */
+                /* Note we use an extra-long timeout here. This is because a reload or reexec means generators are
+                 * rerun which are timed out after DEFAULT_TIMEOUT_USEC. Let's use twice that time here, so that the
+                 * generators can have their timeout, and for everything else there's the same time budget in
+                 * place. */
 
-        r = sd_bus_call(bus, m, DEFAULT_TIMEOUT_USEC * 2, &error, NULL);
+                r = sd_bus_call(bus, m, DEFAULT_TIMEOUT_USEC * 2, &error, NULL);
+
+                /* Older managers don't know incremental reloads, let's do a full one then */
+                if (r < 0 && streq(method, "ReloadIncremental") &&
+                    sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+                        log_debug("Manager does not support incremental reloads, doing a full reload.");
+
+                        m = sd_bus_message_unref(m);
+                        sd_bus_error_free(&error);
+                        method = "Reload";
+                        continue;
+                }
+
+                break;
+        }
 
         /* On reexecution, we expect a disconnect, not a reply */
         if (IN_SET(r, -ETIMEDOUT, -ECONNRESET) && streq(method, "Reexecute"))
@@ -7216,6 +7484,7 @@ static int systemctl_help(void) {
                "     --no-block       Do not wait until operation finished\n"
                "     --no-wall        Don't send wall message before halt/power-off/reboot\n"
                "     --no-reload      Don't reload daemon after en-/dis-abling unit files\n"
+               "     --incremental    Only reload unit files that changed on disk\n"
                "     --no-legend      Do not print a legend (column headers and hints)\n"
                "     --no-pager       Do not pipe output into a pager\n"
                "     --no-ask-password\n"
@@ -7521,6 +7790,7 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                 ARG_NOW,
                 ARG_MESSAGE,
                 ARG_WAIT,
+                ARG_INCREMENTAL,
         };
 
         static const struct option options[] = {
@@ -7554,6 +7824,7 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                 { "root",                required_argument, NULL, ARG_ROOT                },
                 { "force",               no_argument,       NULL, 'f'                     },
                 { "no-reload",           no_argument,       NULL, ARG_NO_RELOAD           },
+                { "incremental",         no_argument,       NULL, ARG_INCREMENTAL         },
                 { "kill-who",            required_argument, NULL, ARG_KILL_WHO            },
                 { "signal",              required_argument, NULL, 's'                     },
                 { "no-ask-password",     no_argument,       NULL, ARG_NO_ASK_PASSWORD     },
@@ -7892,6 +8163,10 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                         arg_now = true;
                         break;
 
+                case ARG_INCREMENTAL:
+                        arg_incremental = true;
+                        break;
+
                 case ARG_MESSAGE:
                         if (strv_extend(&arg_wall, optarg) < 0)
                                 return log_oom();
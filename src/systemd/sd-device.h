@@ -34,6 +34,7 @@ typedef struct sd_device_monitor sd_device_monitor;
 /* callback */
 
 typedef int (*sd_device_monitor_handler_t)(sd_device_monitor *m, sd_device *device, void *userdata);
+typedef int (*sd_device_monitor_batch_handler_t)(sd_device_monitor *m, sd_device **devices, size_t n_devices, void *userdata);
 
 /* device */
 
@@ -108,6 +109,7 @@ int sd_device_monitor_detach_event(sd_device_monitor *m);
 sd_event *sd_device_monitor_get_event(sd_device_monitor *m);
 sd_event_source *sd_device_monitor_get_event_source(sd_device_monitor *m);
 int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_handler_t callback, void *userdata);
+int sd_device_monitor_start_batch(sd_device_monitor *m, sd_device_monitor_batch_handler_t callback, void *userdata);
 int sd_device_monitor_stop(sd_device_monitor *m);
 
 int sd_device_monitor_filter_add_match_subsystem_devtype(sd_device_monitor *m, const char *subsystem, const char *devtype);
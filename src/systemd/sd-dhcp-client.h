@@ -82,6 +82,7 @@ enum {
         SD_DHCP_OPTION_VENDOR_CLASS_IDENTIFIER     = 60,
         SD_DHCP_OPTION_CLIENT_IDENTIFIER           = 61,
         SD_DHCP_OPTION_USER_CLASS                  = 77,
+        SD_DHCP_OPTION_RAPID_COMMIT                = 80,
         SD_DHCP_OPTION_FQDN                        = 81,
         SD_DHCP_OPTION_NEW_POSIX_TIMEZONE          = 100,
         SD_DHCP_OPTION_NEW_TZDB_TIMEZONE           = 101,
@@ -113,6 +114,9 @@ int sd_dhcp_client_set_request_address(
 int sd_dhcp_client_set_request_broadcast(
                 sd_dhcp_client *client,
                 int broadcast);
+int sd_dhcp_client_set_rapid_commit(
+                sd_dhcp_client *client,
+                int rapid_commit);
 int sd_dhcp_client_set_ifindex(
                 sd_dhcp_client *client,
                 int interface_index);
@@ -50,6 +50,7 @@ int sd_dhcp_server_set_dns(sd_dhcp_server *server, const struct in_addr ntp[], u
 int sd_dhcp_server_set_ntp(sd_dhcp_server *server, const struct in_addr dns[], unsigned n);
 int sd_dhcp_server_set_emit_router(sd_dhcp_server *server, int enabled);
 
+int sd_dhcp_server_set_lease_file(sd_dhcp_server *server, const char *path);
 int sd_dhcp_server_set_max_lease_time(sd_dhcp_server *server, uint32_t t);
 int sd_dhcp_server_set_default_lease_time(sd_dhcp_server *server, uint32_t t);
 
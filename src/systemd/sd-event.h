@@ -44,6 +44,17 @@ _SD_BEGIN_DECLARATIONS;
 typedef struct sd_event sd_event;
 typedef struct sd_event_source sd_event_source;
 
+/* Counters describing how much time dispatching an event source took so far, collected only after
+ * sd_event_set_source_stats() was turned on. Fields may be appended in later versions, hence pass
+ * sizeof(sd_event_source_stats) as size to sd_event_source_get_stats(). */
+typedef struct sd_event_source_stats {
+        uint64_t n_dispatched;      /* number of times the callback was invoked */
+        uint64_t dispatch_usec;     /* time spent in the callback in total */
+        uint64_t dispatch_max_usec; /* longest time spent in the callback at once */
+        uint64_t pending_usec;      /* time spent pending before being dispatched in total */
+        uint64_t pending_max_usec;  /* longest time spent pending before being dispatched at once */
+} sd_event_source_stats;
+
 enum {
         SD_EVENT_OFF = 0,
         SD_EVENT_ON = 1,
@@ -77,6 +88,8 @@ typedef int (*sd_event_child_handler_t)(sd_event_source *s, const siginfo_t *si,
 typedef void* sd_event_child_handler_t;
 #endif
 typedef int (*sd_event_inotify_handler_t)(sd_event_source *s, const struct inotify_event *event, void *userdata);
+typedef int (*sd_event_work_t)(void *userdata);
+typedef int (*sd_event_work_handler_t)(sd_event_source *s, int result, void *userdata);
 typedef _sd_destroy_t sd_event_destroy_t;
 
 int sd_event_default(sd_event **e);
@@ -93,6 +106,7 @@ int sd_event_add_inotify(sd_event *e, sd_event_source **s, const char *path, uin
 int sd_event_add_defer(sd_event *e, sd_event_source **s, sd_event_handler_t callback, void *userdata);
 int sd_event_add_post(sd_event *e, sd_event_source **s, sd_event_handler_t callback, void *userdata);
 int sd_event_add_exit(sd_event *e, sd_event_source **s, sd_event_handler_t callback, void *userdata);
+int sd_event_add_work(sd_event *e, sd_event_source **s, sd_event_work_t work, sd_event_work_handler_t callback, void *userdata);
 
 int sd_event_prepare(sd_event *e);
 int sd_event_wait(sd_event *e, uint64_t usec);
@@ -109,7 +123,14 @@ int sd_event_get_tid(sd_event *e, pid_t *tid);
 int sd_event_get_exit_code(sd_event *e, int *code);
 int sd_event_set_watchdog(sd_event *e, int b);
 int sd_event_get_watchdog(sd_event *e);
+int sd_event_set_watchdog_notify_latency(sd_event *e, int b);
+int sd_event_get_watchdog_notify_latency(sd_event *e);
+int sd_event_get_watchdog_latency(sd_event *e, unsigned percentile, uint64_t *ret);
 int sd_event_get_iteration(sd_event *e, uint64_t *ret);
+int sd_event_set_dispatch_batch(sd_event *e, unsigned n);
+int sd_event_get_dispatch_batch(sd_event *e, unsigned *ret);
+int sd_event_set_source_stats(sd_event *e, int b);
+int sd_event_get_source_stats(sd_event *e);
 
 sd_event_source* sd_event_source_ref(sd_event_source *s);
 sd_event_source* sd_event_source_unref(sd_event_source *s);
@@ -141,10 +162,17 @@ int sd_event_source_get_time_clock(sd_event_source *s, clockid_t *clock);
 int sd_event_source_get_signal(sd_event_source *s);
 int sd_event_source_get_child_pid(sd_event_source *s, pid_t *pid);
 int sd_event_source_get_inotify_mask(sd_event_source *s, uint32_t *ret);
+int sd_event_source_set_inotify_coalesce(sd_event_source *s, uint64_t usec);
+int sd_event_source_get_inotify_coalesce(sd_event_source *s, uint64_t *ret);
+int sd_event_source_get_inotify_count(sd_event_source *s, unsigned *ret);
 int sd_event_source_set_destroy_callback(sd_event_source *s, sd_event_destroy_t callback);
 int sd_event_source_get_destroy_callback(sd_event_source *s, sd_event_destroy_t *ret);
 int sd_event_source_get_floating(sd_event_source *s);
 int sd_event_source_set_floating(sd_event_source *s, int b);
+int sd_event_source_get_stats(sd_event_source *s, sd_event_source_stats *ret, size_t size);
+int sd_event_source_set_ratelimit(sd_event_source *s, uint64_t interval_usec, unsigned burst);
+int sd_event_source_get_ratelimit(sd_event_source *s, uint64_t *ret_interval_usec, unsigned *ret_burst);
+int sd_event_source_is_ratelimited(sd_event_source *s);
 
 /* Define helpers so that __attribute__((cleanup(sd_event_unrefp))) and similar may be used. */
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_event, sd_event_unref);
@@ -29,6 +29,7 @@ sd_hwdb *sd_hwdb_unref(sd_hwdb *hwdb);
 int sd_hwdb_new(sd_hwdb **ret);
 
 int sd_hwdb_get(sd_hwdb *hwdb, const char *modalias, const char *key, const char **value);
+int sd_hwdb_get_many(sd_hwdb *hwdb, char **modaliases, const char *key, const char **values);
 
 int sd_hwdb_seek(sd_hwdb *hwdb, const char *modalias);
 int sd_hwdb_enumerate(sd_hwdb *hwdb, const char **key, const char **value);
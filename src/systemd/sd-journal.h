@@ -143,6 +143,19 @@ int sd_journal_get_catalog_for_message_id(sd_id128_t id, char **text);
 int sd_journal_has_runtime_files(sd_journal *j);
 int sd_journal_has_persistent_files(sd_journal *j);
 
+/* Counters describing how much work reading the journal took so far. Fields may be appended in later versions,
+ * hence pass sizeof(sd_journal_stats) as size to sd_journal_get_stats(). */
+typedef struct sd_journal_stats {
+        uint64_t mmap_hit;        /* lookups served from an existing memory map */
+        uint64_t mmap_missed;     /* lookups that required a new memory map */
+        uint64_t mmap_windows;    /* memory maps currently established */
+        uint64_t mmap_bytes;      /* bytes currently mapped */
+        uint64_t sigbus;          /* SIGBUS events caught, e.g. on truncated files */
+        uint64_t decompress_usec; /* time spent decompressing objects */
+} sd_journal_stats;
+
+int sd_journal_get_stats(sd_journal *j, sd_journal_stats *ret, size_t size);
+
 /* The inverse condition avoids ambiguity of dangling 'else' after the macro */
 #define SD_JOURNAL_FOREACH(j)                                           \
         if (sd_journal_seek_head(j) < 0) { }                            \
@@ -163,6 +163,10 @@ int sd_network_link_get_carrier_bound_by(int ifindex, int **ifindexes);
 /* Get the timezone that was learnt on a specific link. */
 int sd_network_link_get_timezone(int ifindex, char **timezone);
 
+/* Get the CLOCK_MONOTONIC timestamps of when configuring the link started and finished (0 if it did not yet),
+ * and how long its netlink requests waited to be sent in total. */
+int sd_network_link_get_setup_times(int ifindex, uint64_t *started, uint64_t *finished, uint64_t *queued);
+
 /* Monitor object */
 typedef struct sd_network_monitor sd_network_monitor;
 
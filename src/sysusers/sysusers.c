@@ -4,6 +4,7 @@
 #include <utmp.h>
 
 #include "alloc-util.h"
+#include "bitmap.h"
 #include "conf-files.h"
 #include "copy.h"
 #include "def.h"
@@ -75,6 +76,13 @@ static Hashmap *database_by_uid = NULL, *database_by_username = NULL;
 static Hashmap *database_by_gid = NULL, *database_by_groupname = NULL;
 static Set *database_users = NULL, *database_groups = NULL;
 
+/* Names of users and groups as returned by NSS, keyed by ID, or "" if there is no such entry, so that each ID is
+ * looked up at most once, however often it is checked */
+static Hashmap *nss_user_names = NULL, *nss_group_names = NULL;
+
+/* IDs known to be taken by any user or group, which the search for a free ID skips without checking them again */
+static Bitmap *ids_taken = NULL;
+
 static uid_t search_uid = UID_INVALID;
 static UidRange *uid_range = NULL;
 static unsigned n_uid_range = 0;
@@ -90,6 +98,9 @@ STATIC_DESTRUCTOR_REGISTER(database_users, set_free_freep);
 STATIC_DESTRUCTOR_REGISTER(database_by_gid, hashmap_freep);
 STATIC_DESTRUCTOR_REGISTER(database_by_groupname, hashmap_freep);
 STATIC_DESTRUCTOR_REGISTER(database_groups, set_free_freep);
+STATIC_DESTRUCTOR_REGISTER(nss_user_names, hashmap_free_freep);
+STATIC_DESTRUCTOR_REGISTER(nss_group_names, hashmap_free_freep);
+STATIC_DESTRUCTOR_REGISTER(ids_taken, bitmap_freep);
 STATIC_DESTRUCTOR_REGISTER(uid_range, freep);
 STATIC_DESTRUCTOR_REGISTER(arg_root, freep);
 
@@ -189,6 +200,104 @@ static int load_group_database(void) {
         return r;
 }
 
+static void mark_id_taken(uid_t id) {
+        /* The index is only an optimization: IDs too large for a bitmap, or failing to allocate, simply mean the
+         * ID is checked in full again */
+        if (ids_taken)
+                (void) bitmap_set(ids_taken, id);
+}
+
+static int build_id_index(void) {
+        Iterator iterator;
+        void *k;
+        char *n;
+        int r;
+
+        r = bitmap_ensure_allocated(&ids_taken);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(n, k, database_by_uid, iterator)
+                mark_id_taken(PTR_TO_UID(k));
+
+        HASHMAP_FOREACH_KEY(n, k, database_by_gid, iterator)
+                mark_id_taken((uid_t) PTR_TO_GID(k));
+
+        return 0;
+}
+
+static int search_next_id(void) {
+        int r;
+
+        /* Moves search_uid to the next lower ID in the range that is not known to be taken already */
+        do {
+                r = uid_range_next_lower(uid_range, n_uid_range, &search_uid);
+                if (r < 0)
+                        return r;
+        } while (bitmap_isset(ids_taken, search_uid));
+
+        return r;
+}
+
+static int nss_cache_lookup(Hashmap **cache, uid_t id, bool group, const char **ret_name) {
+        char *n;
+        int r;
+
+        assert(cache);
+
+        n = hashmap_get(*cache, UID_TO_PTR(id));
+        if (!n) {
+                const char *found = NULL;
+
+                errno = 0;
+                if (group) {
+                        struct group *g;
+
+                        g = getgrgid((gid_t) id);
+                        if (g)
+                                found = g->gr_name;
+                } else {
+                        struct passwd *p;
+
+                        p = getpwuid(id);
+                        if (p)
+                                found = p->pw_name;
+                }
+                if (!found && !IN_SET(errno, 0, ENOENT))
+                        return -errno;
+
+                r = hashmap_ensure_allocated(cache, NULL);
+                if (r < 0)
+                        return r;
+
+                n = strdup(strempty(found));
+                if (!n)
+                        return -ENOMEM;
+
+                r = hashmap_put(*cache, UID_TO_PTR(id), n);
+                if (r < 0) {
+                        free(n);
+                        return r;
+                }
+        }
+
+        if (isempty(n))
+                return 0;
+
+        if (ret_name)
+                *ret_name = n;
+
+        return 1;
+}
+
+static int nss_user_by_uid(uid_t uid, const char **ret_name) {
+        return nss_cache_lookup(&nss_user_names, uid, false, ret_name);
+}
+
+static int nss_group_by_gid(gid_t gid, const char **ret_name) {
+        return nss_cache_lookup(&nss_group_names, (uid_t) gid, true, ret_name);
+}
+
 static int make_backup(const char *target, const char *x) {
         _cleanup_close_ int src = -1;
         _cleanup_fclose_ FILE *dst = NULL;
@@ -820,10 +929,9 @@ static int write_files(void) {
 }
 
 static int uid_is_ok(uid_t uid, const char *name, bool check_with_gid) {
-        struct passwd *p;
-        struct group *g;
         const char *n;
         Item *i;
+        int r;
 
         /* Let's see if we already have assigned the UID a second time */
         if (ordered_hashmap_get(todo_uids, UID_TO_PTR(uid)))
@@ -849,21 +957,16 @@ static int uid_is_ok(uid_t uid, const char *name, bool check_with_gid) {
 
         /* Let's also check via NSS, to avoid UID clashes over LDAP and such, just in case */
         if (!arg_root) {
-                errno = 0;
-                p = getpwuid(uid);
-                if (p)
-                        return 0;
-                if (!IN_SET(errno, 0, ENOENT))
-                        return -errno;
+                r = nss_user_by_uid(uid, NULL);
+                if (r != 0)
+                        return r < 0 ? r : 0;
 
                 if (check_with_gid) {
-                        errno = 0;
-                        g = getgrgid((gid_t) uid);
-                        if (g) {
-                                if (!streq(g->gr_name, name))
-                                        return 0;
-                        } else if (!IN_SET(errno, 0, ENOENT))
-                                return -errno;
+                        r = nss_group_by_gid((gid_t) uid, &n);
+                        if (r < 0)
+                                return r;
+                        if (r > 0 && !streq(n, name))
+                                return 0;
                 }
         }
 
@@ -1020,7 +1123,7 @@ static int add_user(Item *i) {
         /* And if that didn't work either, let's try to find a free one */
         if (!i->uid_set) {
                 for (;;) {
-                        r = uid_range_next_lower(uid_range, n_uid_range, &search_uid);
+                        r = search_next_id();
                         if (r < 0) {
                                 log_error("No free user ID available for %s.", i->name);
                                 return r;
@@ -1031,12 +1134,16 @@ static int add_user(Item *i) {
                                 return log_error_errno(r, "Failed to verify uid " UID_FMT ": %m", i->uid);
                         else if (r > 0)
                                 break;
+
+                        mark_id_taken(search_uid);
                 }
 
                 i->uid_set = true;
                 i->uid = search_uid;
         }
 
+        mark_id_taken(i->uid);
+
         r = ordered_hashmap_ensure_allocated(&todo_uids, NULL);
         if (r < 0)
                 return log_oom();
@@ -1052,8 +1159,7 @@ static int add_user(Item *i) {
 }
 
 static int gid_is_ok(gid_t gid) {
-        struct group *g;
-        struct passwd *p;
+        int r;
 
         if (ordered_hashmap_get(todo_gids, GID_TO_PTR(gid)))
                 return 0;
@@ -1069,19 +1175,13 @@ static int gid_is_ok(gid_t gid) {
                 return 0;
 
         if (!arg_root) {
-                errno = 0;
-                g = getgrgid(gid);
-                if (g)
-                        return 0;
-                if (!IN_SET(errno, 0, ENOENT))
-                        return -errno;
+                r = nss_group_by_gid(gid, NULL);
+                if (r != 0)
+                        return r < 0 ? r : 0;
 
-                errno = 0;
-                p = getpwuid((uid_t) gid);
-                if (p)
-                        return 0;
-                if (!IN_SET(errno, 0, ENOENT))
-                        return -errno;
+                r = nss_user_by_uid((uid_t) gid, NULL);
+                if (r != 0)
+                        return r < 0 ? r : 0;
         }
 
         return 1;
@@ -1177,7 +1277,7 @@ static int add_group(Item *i) {
         if (!i->gid_set) {
                 for (;;) {
                         /* We look for new GIDs in the UID pool! */
-                        r = uid_range_next_lower(uid_range, n_uid_range, &search_uid);
+                        r = search_next_id();
                         if (r < 0) {
                                 log_error("No free group ID available for %s.", i->name);
                                 return r;
@@ -1188,12 +1288,16 @@ static int add_group(Item *i) {
                                 return log_error_errno(r, "Failed to verify gid " GID_FMT ": %m", i->gid);
                         else if (r > 0)
                                 break;
+
+                        mark_id_taken(search_uid);
                 }
 
                 i->gid_set = true;
                 i->gid = search_uid;
         }
 
+        mark_id_taken((uid_t) i->gid);
+
         r = ordered_hashmap_ensure_allocated(&todo_gids, NULL);
         if (r < 0)
                 return log_oom();
@@ -1981,6 +2085,10 @@ static int run(int argc, char *argv[]) {
         if (r < 0)
                 return log_error_errno(r, "Failed to read group database: %m");
 
+        r = build_id_index();
+        if (r < 0)
+                return log_oom();
+
         ORDERED_HASHMAP_FOREACH(i, groups, iterator)
                 (void) process_item(i);
 
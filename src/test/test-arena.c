@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "extract-word.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+
+static void test_arena_alloc(void) {
+        _cleanup_arena_ Arena a = ARENA_NULL;
+        unsigned i;
+        char *s;
+
+        log_info("/* %s */", __func__);
+
+        for (i = 0; i < 10000; i++) {
+                uint64_t *p;
+
+                assert_se(p = arena_alloc(&a, sizeof(uint64_t) + i % 7));
+                assert_se(((uintptr_t) p & (__alignof(long double) - 1)) == 0);
+                *p = i;
+        }
+
+        /* Larger than any block */
+        assert_se(s = arena_alloc0(&a, 1024 * 1024));
+        assert_se(s[0] == 0 && s[1024 * 1024 - 1] == 0);
+
+        assert_se(s = arena_strdup(&a, "foo"));
+        assert_se(streq(s, "foo"));
+        assert_se(s = arena_strndup(&a, "foobar", 4));
+        assert_se(streq(s, "foob"));
+}
+
+static void test_arena_strv_extend(void) {
+        _cleanup_arena_ Arena a = ARENA_NULL;
+        char **l = NULL;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(arena_strv_extend(&a, &l, NULL) == 0);
+        assert_se(!l);
+
+        for (i = 0; i < 100; i++) {
+                char buf[DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(buf, "%u", i);
+                assert_se(arena_strv_extend(&a, &l, buf) >= 0);
+                assert_se(strv_length(l) == i + 1);
+        }
+
+        assert_se(streq(l[0], "0"));
+        assert_se(streq(l[42], "42"));
+        assert_se(streq(l[99], "99"));
+        assert_se(!l[100]);
+}
+
+static void test_extract_first_word_arena(void) {
+        _cleanup_arena_ Arena a = ARENA_NULL;
+        const char *p = "foo 'bar baz' \"wal\\tdo\"  ";
+        char *w, *first;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(extract_first_word_arena(&a, &p, &first, NULL, EXTRACT_QUOTES) == 1);
+        assert_se(streq(first, "foo"));
+        assert_se(extract_first_word_arena(&a, &p, &w, NULL, EXTRACT_QUOTES) == 1);
+        assert_se(streq(w, "bar baz"));
+        assert_se(extract_first_word_arena(&a, &p, &w, NULL, EXTRACT_QUOTES|EXTRACT_CUNESCAPE) == 1);
+        assert_se(streq(w, "wal\tdo"));
+        assert_se(extract_first_word_arena(&a, &p, &w, NULL, EXTRACT_QUOTES) == 0);
+        assert_se(!w);
+        assert_se(!p);
+
+        /* Earlier words stay valid */
+        assert_se(streq(first, "foo"));
+
+        p = "'unbalanced";
+        assert_se(extract_first_word_arena(&a, &p, &w, NULL, EXTRACT_QUOTES) == -EINVAL);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_arena_alloc();
+        test_arena_strv_extend();
+        test_extract_first_word_arena();
+
+        return 0;
+}
@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+
+#include "bitmap.h"
+#include "log.h"
+#include "parse-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Times setting, counting, iterating, union and intersection of bitmaps with different densities, with all bits
+ * within the supported range. Prints the average time per operation. Pass the number of rounds as the first argument,
+ * by default it is 1000, or 10000 with slow tests enabled. */
+
+#define BENCHMARK_BITS 0x10000U
+
+static double nsec_per_op(usec_t start, unsigned n) {
+        return (double) (now(CLOCK_MONOTONIC) - start) * NSEC_PER_USEC / n;
+}
+
+static void benchmark(unsigned stride, unsigned rounds) {
+        _cleanup_bitmap_free_ Bitmap *a = NULL, *b = NULL;
+        double set, count, iterate, set_ops;
+        unsigned k, r, n, bit;
+        Iterator i;
+        usec_t t;
+
+        assert_se(a = bitmap_new());
+        assert_se(b = bitmap_new());
+
+        t = now(CLOCK_MONOTONIC);
+        for (r = 0; r < rounds; r++) {
+                bitmap_clear(a);
+                for (k = 0; k < BENCHMARK_BITS; k += stride)
+                        assert_se(bitmap_set(a, k) == 0);
+        }
+        set = nsec_per_op(t, rounds);
+
+        for (k = stride / 2; k < BENCHMARK_BITS; k += stride + 1)
+                assert_se(bitmap_set(b, k) == 0);
+
+        t = now(CLOCK_MONOTONIC);
+        for (r = 0, n = 0; r < rounds; r++)
+                n += bitmap_count(a);
+        count = nsec_per_op(t, rounds);
+        assert_se(n == rounds * ((BENCHMARK_BITS + stride - 1) / stride));
+
+        t = now(CLOCK_MONOTONIC);
+        for (r = 0, n = 0; r < rounds; r++)
+                BITMAP_FOREACH(bit, a, i)
+                        n++;
+        iterate = nsec_per_op(t, rounds);
+        assert_se(n == rounds * ((BENCHMARK_BITS + stride - 1) / stride));
+
+        t = now(CLOCK_MONOTONIC);
+        for (r = 0; r < rounds; r++) {
+                _cleanup_bitmap_free_ Bitmap *c = NULL;
+
+                assert_se(c = bitmap_copy(a));
+                assert_se(bitmap_union(c, b) == 0);
+                bitmap_intersect(c, a);
+                assert_se(bitmap_equal(c, a));
+        }
+        set_ops = nsec_per_op(t, rounds);
+
+        printf("1/%-5u bits set: set %9.1f ns, count %7.1f ns, iterate %9.1f ns, copy+union+intersect %7.1f ns\n",
+               stride, set, count, iterate, set_ops);
+}
+
+int main(int argc, char *argv[]) {
+        unsigned rounds, stride;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &rounds) >= 0);
+        else
+                rounds = slow_tests_enabled() ? 10000U : 1000U;
+
+        for (stride = 1; stride <= 4096; stride *= 8)
+                benchmark(stride, rounds);
+
+        return 0;
+}
@@ -113,5 +113,53 @@ int main(int argc, const char *argv[]) {
         assert_se(bitmap_set(b2, 0) == 0);
         assert_se(bitmap_equal(b, b2));
 
+        /* Set operations */
+        bitmap_clear(b);
+        bitmap_clear(b2);
+        assert_se(bitmap_count(b) == 0);
+        assert_se(bitmap_count(NULL) == 0);
+
+        for (i = 0; i < 1000; i += 3)
+                assert_se(bitmap_set(b, i) == 0);
+        for (i = 0; i < 500; i += 5)
+                assert_se(bitmap_set(b2, i) == 0);
+        assert_se(bitmap_count(b) == 334);
+        assert_se(bitmap_count(b2) == 100);
+
+        assert_se(bitmap_union(b2, b) == 0);
+        assert_se(bitmap_count(b2) == 334 + 100 - 34);
+        assert_se(bitmap_isset(b2, 999));
+        assert_se(bitmap_isset(b2, 5));
+        assert_se(!bitmap_isset(b2, 7));
+
+        assert_se(bitmap_set(b, 4000) == 0);
+        bitmap_intersect(b2, b);
+        assert_se(bitmap_count(b2) == 334);
+        bitmap_unset(b, 4000);
+        assert_se(bitmap_equal(b, b2));
+
+        /* Words dropped by the intersection must not come back when the bitmap grows again */
+        bitmap_clear(b);
+        assert_se(bitmap_set(b, 3) == 0);
+        bitmap_intersect(b2, b);
+        assert_se(bitmap_count(b2) == 1);
+        assert_se(bitmap_set(b2, 1000) == 0);
+        assert_se(bitmap_count(b2) == 2);
+
+        bitmap_intersect(b2, NULL);
+        assert_se(bitmap_isclear(b2));
+        assert_se(bitmap_union(b2, NULL) == 0);
+        assert_se(bitmap_isclear(b2));
+
+        i = 0;
+        assert_se(bitmap_set(b, 63) == 0);
+        assert_se(bitmap_set(b, 64) == 0);
+        assert_se(bitmap_set(b, 65535) == 0);
+        BITMAP_FOREACH(n, b, it) {
+                assert_se(n == (i == 0 ? 3 : i == 1 ? 63 : i == 2 ? 64 : 65535));
+                i++;
+        }
+        assert_se(i == 4);
+
         return 0;
 }
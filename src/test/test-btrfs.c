@@ -2,6 +2,7 @@
 
 #include <fcntl.h>
 
+#include "alloc-util.h"
 #include "btrfs-util.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -169,6 +170,26 @@ int main(int argc, char *argv[]) {
 
         assert_se(quota.referenced_max == 5ULL * 1024 * 1024 * 1024);
 
+        {
+                _cleanup_free_ BtrfsQgroupQuota *all = NULL;
+                _cleanup_close_ int qfd = -1;
+                const BtrfsQuotaInfo *q;
+                uint64_t id;
+                size_t n;
+
+                /* The bulk query has to agree with the ones above */
+                assert_se((qfd = open("/xxxquotatest2", O_RDONLY|O_CLOEXEC|O_DIRECTORY)) >= 0);
+                assert_se(btrfs_subvol_get_id_fd(qfd, &id) >= 0);
+
+                r = btrfs_qgroup_get_quota_all_fd(qfd, &all, &n);
+                if (r < 0)
+                        log_error_errno(r, "Failed to query all quotas: %m");
+                else {
+                        assert_se(q = btrfs_qgroup_quota_find_subtree(all, n, id));
+                        assert_se(q->referenced_max == 5ULL * 1024 * 1024 * 1024);
+                }
+        }
+
         r = btrfs_subvol_remove("/xxxquotatest", BTRFS_REMOVE_QUOTA|BTRFS_REMOVE_RECURSIVE);
         if (r < 0)
                 log_error_errno(r, "Failed remove subvolume: %m");
@@ -1,5 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "alloc-util.h"
 #include "build.h"
 #include "cgroup-util.h"
@@ -7,8 +11,10 @@
 #include "fd-util.h"
 #include "format-util.h"
 #include "parse-util.h"
+#include "path-util.h"
 #include "proc-cmdline.h"
 #include "process-util.h"
+#include "set.h"
 #include "special.h"
 #include "stat-util.h"
 #include "string-util.h"
@@ -458,6 +464,70 @@ static void test_cg_get_keyed_attribute(void) {
         }
 }
 
+static pid_t fork_into(const char *path) {
+        pid_t pid;
+
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0) {
+                for (;;)
+                        pause();
+        }
+
+        assert_se(cg_attach(SYSTEMD_CGROUP_CONTROLLER, path, pid) >= 0);
+        return pid;
+}
+
+static void test_cg_kill_exclude(void) {
+        _cleanup_free_ char *own = NULL, *path = NULL, *sub = NULL;
+        _cleanup_set_free_ Set *s = NULL;
+        pid_t killed, spared, killed_sub;
+        siginfo_t si;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        if (geteuid() != 0) {
+                log_notice("Not root, skipping %s", __func__);
+                return;
+        }
+
+        assert_se(cg_pid_get_path(SYSTEMD_CGROUP_CONTROLLER, 0, &own) >= 0);
+        assert_se(path = path_join(own, "test-kill-exclude"));
+        assert_se(sub = path_join(path, "sub"));
+
+        r = cg_create(SYSTEMD_CGROUP_CONTROLLER, sub);
+        if (r < 0) {
+                log_notice_errno(r, "Failed to create cgroup, skipping %s: %m", __func__);
+                return;
+        }
+
+        killed = fork_into(path);
+        spared = fork_into(path);
+        killed_sub = fork_into(sub);
+
+        /* Processes in the set must survive, also when the whole subtree could be killed in one go */
+        assert_se(s = set_new(NULL));
+        assert_se(set_put(s, PID_TO_PTR(spared)) >= 0);
+        assert_se(cg_kill_recursive(SYSTEMD_CGROUP_CONTROLLER, path, SIGKILL, CGROUP_IGNORE_SELF, s, NULL, NULL) > 0);
+
+        assert_se(wait_for_terminate(killed, &si) >= 0);
+        assert_se(si.si_code == CLD_KILLED && si.si_status == SIGKILL);
+        assert_se(wait_for_terminate(killed_sub, &si) >= 0);
+        assert_se(si.si_code == CLD_KILLED && si.si_status == SIGKILL);
+
+        /* Give the signal a moment to arrive, if it was sent */
+        (void) usleep(100 * USEC_PER_MSEC);
+        zero(si);
+        assert_se(waitid(P_PID, spared, &si, WEXITED|WNOHANG|WNOWAIT) >= 0);
+        assert_se(si.si_pid == 0);
+
+        assert_se(kill(spared, SIGKILL) >= 0);
+        assert_se(wait_for_terminate(spared, &si) >= 0);
+
+        assert_se(cg_trim(SYSTEMD_CGROUP_CONTROLLER, path, true) >= 0);
+}
+
 int main(void) {
         test_setup_logging(LOG_DEBUG);
 
@@ -482,6 +552,7 @@ int main(void) {
         test_is_wanted();
         test_cg_tests();
         test_cg_get_keyed_attribute();
+        TEST_REQ_RUNNING_SYSTEMD(test_cg_kill_exclude());
 
         return 0;
 }
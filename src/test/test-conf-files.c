@@ -3,8 +3,10 @@
   Copyright © 2014 Michael Marineau
 ***/
 
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #include "alloc-util.h"
 #include "conf-files.h"
@@ -94,6 +96,45 @@ static void test_conf_files_list(bool use_root) {
         assert_se(rm_rf(tmp_dir, REMOVE_ROOT|REMOVE_PHYSICAL) == 0);
 }
 
+static void test_conf_files_list_cache(void) {
+        char tmp_dir[] = "/tmp/test-conf-files-XXXXXX";
+        _cleanup_strv_free_ char **l = NULL;
+        struct timespec ts[2] = {
+                { .tv_sec = 1000000000 },
+                { .tv_sec = 1000000000 },
+        };
+        const char *dir;
+
+        log_info("/* %s */", __func__);
+
+        setup_test_dir(tmp_dir, "/dir/a.conf", NULL);
+        dir = strjoina(tmp_dir, "/dir");
+
+        /* Make the directory look old, so that its listing is cached */
+        assert_se(utimensat(AT_FDCWD, dir, ts, 0) >= 0);
+
+        assert_se(conf_files_list(&l, ".conf", NULL, CONF_FILES_BASENAME, dir, NULL) == 0);
+        assert_se(strv_equal(l, STRV_MAKE("a.conf")));
+        l = strv_free(l);
+
+        assert_se(conf_files_list(&l, ".conf", NULL, CONF_FILES_BASENAME, dir, NULL) == 0);
+        assert_se(strv_equal(l, STRV_MAKE("a.conf")));
+        l = strv_free(l);
+
+        /* Adding a file changes the modification time, hence the cached listing must not be used anymore */
+        assert_se(touch(strjoina(dir, "/b.conf")) >= 0);
+        assert_se(conf_files_list(&l, ".conf", NULL, CONF_FILES_BASENAME, dir, NULL) == 0);
+        assert_se(strv_equal(l, STRV_MAKE("a.conf", "b.conf")));
+        l = strv_free(l);
+
+        /* Same for a removal right after that, within the same timestamp tick */
+        assert_se(unlink(strjoina(dir, "/a.conf")) >= 0);
+        assert_se(conf_files_list(&l, ".conf", NULL, CONF_FILES_BASENAME, dir, NULL) == 0);
+        assert_se(strv_equal(l, STRV_MAKE("b.conf")));
+
+        assert_se(rm_rf(tmp_dir, REMOVE_ROOT|REMOVE_PHYSICAL) == 0);
+}
+
 static void test_conf_files_insert(const char *root) {
         _cleanup_strv_free_ char **s = NULL;
 
@@ -153,6 +194,7 @@ int main(int argc, char **argv) {
 
         test_conf_files_list(false);
         test_conf_files_list(true);
+        test_conf_files_list_cache();
         test_conf_files_insert(NULL);
         test_conf_files_insert("/root");
         test_conf_files_insert("/root/");
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "conf-files.h"
+#include "conf-parser.h"
+#include "fileio.h"
+#include "log.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+
+/* Times config_parse() on a directory of generated .network files, and on any directories passed as arguments, for
+ * example the units/ directory of the source tree. Assignments are only counted, not parsed, so this measures the
+ * reading and splitting of lines. Set $BENCHMARK_NETWORK_FILES to change the number of generated files, by default it
+ * is 1000, or 10000 with slow tests enabled. */
+
+static int count_assignment(
+                const void *table,
+                const char *section,
+                const char *lvalue,
+                ConfigParserCallback *func,
+                int *ltype,
+                void **data,
+                void *userdata) {
+
+        unsigned *n = userdata;
+
+        (*n)++;
+
+        *func = NULL;
+        return 1;
+}
+
+static void write_network_files(const char *dir, unsigned n_files) {
+        unsigned k, l;
+
+        for (k = 0; k < n_files; k++) {
+                _cleanup_free_ char *contents = NULL, *p = NULL;
+                char name[STRLEN("10-.network") + DECIMAL_STR_MAX(unsigned)];
+
+                assert_se(asprintf(&contents,
+                                   "# Generated for benchmarking\n"
+                                   "[Match]\n"
+                                   "Name=veth%u\n"
+                                   "MACAddress=00:11:22:33:%02x:%02x\n"
+                                   "\n"
+                                   "[Link]\n"
+                                   "MTUBytes=1500\n"
+                                   "RequiredForOnline=no\n"
+                                   "\n"
+                                   "[Network]\n"
+                                   "Description=Generated network %u\n"
+                                   "DHCP=no\n"
+                                   "IPv6AcceptRA=no\n"
+                                   "LinkLocalAddressing=no\n"
+                                   "DNS=10.%u.%u.1 \\\n"
+                                   "    10.%u.%u.2\n"
+                                   "Domains=example%u.com ~.\n",
+                                   k, (k >> 8) & 0xff, k & 0xff, k,
+                                   (k >> 8) & 0xff, k & 0xff, (k >> 8) & 0xff, k & 0xff, k) >= 0);
+
+                for (l = 0; l < 8; l++) {
+                        char section[256];
+
+                        xsprintf(section,
+                                 "\n[Address]\nAddress=10.%u.%u.%u/32\nPeer=10.%u.%u.%u/32\n"
+                                 "\n[Route]\nGateway=10.%u.%u.1\nDestination=192.168.%u.0/24\nMetric=%u\n",
+                                 (k >> 8) & 0xff, k & 0xff, l + 10, (k >> 8) & 0xff, k & 0xff, l + 100,
+                                 (k >> 8) & 0xff, k & 0xff, l, 100 + l);
+
+                        assert_se(strextend(&contents, section, NULL));
+                }
+
+                xsprintf(name, "10-%u.network", k);
+                assert_se(p = path_join(dir, name));
+                assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+        }
+}
+
+static void benchmark(const char *dir) {
+        _cleanup_strv_free_ char **files = NULL;
+        unsigned n_assignments = 0;
+        char **f;
+        usec_t t;
+
+        assert_se(conf_files_list(&files, NULL, NULL, 0, dir, NULL) >= 0);
+        if (strv_isempty(files)) {
+                log_notice("No files in %s, skipping.", dir);
+                return;
+        }
+
+        t = now(CLOCK_MONOTONIC);
+        STRV_FOREACH(f, files)
+                /* Templates in the source tree might not parse, that is fine here */
+                (void) config_parse(NULL, *f, NULL, NULL, count_assignment, NULL, CONFIG_PARSE_RELAXED, &n_assignments);
+        t = now(CLOCK_MONOTONIC) - t;
+
+        printf("%-40s %6zu files, %7u assignments: %6.2f us per file, %6.1f ns per assignment\n",
+               dir, strv_length(files), n_assignments,
+               (double) t / strv_length(files),
+               (double) t * NSEC_PER_USEC / MAX(n_assignments, 1U));
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        unsigned n_files;
+        const char *e;
+        int i;
+
+        test_setup_logging(LOG_INFO);
+
+        e = getenv("BENCHMARK_NETWORK_FILES");
+        if (e)
+                assert_se(safe_atou(e, &n_files) >= 0);
+        else
+                n_files = slow_tests_enabled() ? 10000U : 1000U;
+
+        assert_se(mkdtemp_malloc("/tmp/test-conf-parser-benchmark-XXXXXX", &dir) >= 0);
+        write_network_files(dir, n_files);
+
+        benchmark(dir);
+
+        for (i = 1; i < argc; i++)
+                benchmark(argv[i]);
+
+        return 0;
+}
@@ -145,6 +145,110 @@ static void test_copy_tree(void) {
         (void) rm_rf(original_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
 }
 
+static int count_bytes(uint64_t n_bytes, void *userdata) {
+        uint64_t *total = userdata;
+
+        *total += n_bytes;
+        return 0;
+}
+
+static void test_copy_tree_parallel(void) {
+        char original_dir[] = "/tmp/test-copy_tree_parallel/";
+        char copy_dir[] = "/tmp/test-copy_tree_parallel-copy/";
+        uint64_t total = 0, expected = 0;
+        struct stat st, st2;
+        const char *d;
+        unsigned i;
+
+        log_info("%s", __func__);
+
+        (void) rm_rf(copy_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+        (void) rm_rf(original_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+
+        /* More files than fit into the queue at once */
+        for (i = 0; i < 500; i++) {
+                _cleanup_free_ char *f = NULL, *c = NULL;
+
+                assert_se(asprintf(&f, "%sdir%u/file%u", original_dir, i % 7, i) >= 0);
+                assert_se(asprintf(&c, "contents of file %u", i) >= 0);
+
+                assert_se(mkdir_parents(f, 0755) >= 0);
+                assert_se(write_string_file(f, c, WRITE_STRING_FILE_CREATE) == 0);
+                assert_se(chmod(f, 0600 + i % 2 * 040) >= 0);
+                expected += strlen(c) + 1;
+        }
+
+        d = strjoina(original_dir, "dir3");
+        assert_se(utimensat(AT_FDCWD, d, (struct timespec[2]) { { .tv_sec = 4711 }, { .tv_sec = 4711 } }, 0) >= 0);
+
+        assert_se(copy_tree_at_full(AT_FDCWD, original_dir, AT_FDCWD, copy_dir, UID_INVALID, GID_INVALID, COPY_PARALLEL, NULL, count_bytes, &total) == 0);
+        assert_se(total == expected);
+
+        for (i = 0; i < 500; i++) {
+                _cleanup_free_ char *f = NULL, *g = NULL, *c = NULL, *buf = NULL;
+
+                assert_se(asprintf(&f, "%sdir%u/file%u", original_dir, i % 7, i) >= 0);
+                assert_se(asprintf(&g, "%sdir%u/file%u", copy_dir, i % 7, i) >= 0);
+                assert_se(asprintf(&c, "contents of file %u\n", i) >= 0);
+
+                assert_se(read_full_file(g, &buf, NULL) == 0);
+                assert_se(streq(buf, c));
+
+                assert_se(stat(f, &st) >= 0);
+                assert_se(stat(g, &st2) >= 0);
+                assert_se(st.st_mode == st2.st_mode);
+                assert_se(st.st_mtim.tv_sec == st2.st_mtim.tv_sec);
+                assert_se(st.st_mtim.tv_nsec == st2.st_mtim.tv_nsec);
+        }
+
+        /* Files are created before the directory timestamps are restored */
+        d = strjoina(copy_dir, "dir3");
+        assert_se(stat(d, &st) >= 0);
+        assert_se(st.st_mtim.tv_sec == 4711);
+
+        (void) rm_rf(copy_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+        (void) rm_rf(original_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+}
+
+static int fail_bytes(uint64_t n_bytes, void *userdata) {
+        return -EIO;
+}
+
+static void test_copy_tree_parallel_fail(void) {
+        char original_dir[] = "/tmp/test-copy_tree_parallel_fail/";
+        char copy_dir[] = "/tmp/test-copy_tree_parallel_fail-copy/";
+        unsigned i, n = 0;
+
+        log_info("%s", __func__);
+
+        (void) rm_rf(copy_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+        (void) rm_rf(original_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+
+        for (i = 0; i < 500; i++) {
+                _cleanup_free_ char *f = NULL;
+
+                assert_se(asprintf(&f, "%sfile%u", original_dir, i) >= 0);
+                assert_se(mkdir_parents(f, 0755) >= 0);
+                assert_se(write_string_file(f, "contents", WRITE_STRING_FILE_CREATE) == 0);
+        }
+
+        /* The first file that fails to copy stops the walk, and no file is left behind half copied */
+        assert_se(copy_tree_at_full(AT_FDCWD, original_dir, AT_FDCWD, copy_dir, UID_INVALID, GID_INVALID, COPY_PARALLEL, NULL, fail_bytes, NULL) == -EIO);
+
+        for (i = 0; i < 500; i++) {
+                _cleanup_free_ char *g = NULL;
+
+                assert_se(asprintf(&g, "%sfile%u", copy_dir, i) >= 0);
+                if (access(g, F_OK) >= 0)
+                        n++;
+        }
+
+        assert_se(n == 0);
+
+        (void) rm_rf(copy_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+        (void) rm_rf(original_dir, REMOVE_ROOT|REMOVE_PHYSICAL);
+}
+
 static void test_copy_bytes(void) {
         _cleanup_close_pair_ int pipefd[2] = {-1, -1};
         _cleanup_close_ int infd = -1;
@@ -261,6 +365,8 @@ int main(int argc, char *argv[]) {
         test_copy_file();
         test_copy_file_fd();
         test_copy_tree();
+        test_copy_tree_parallel();
+        test_copy_tree_parallel_fail();
         test_copy_bytes();
         test_copy_bytes_regular_file(argv[0], false, (uint64_t) -1);
         test_copy_bytes_regular_file(argv[0], true, (uint64_t) -1);
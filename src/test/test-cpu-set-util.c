@@ -3,6 +3,7 @@
 #include "alloc-util.h"
 #include "cpu-set-util.h"
 #include "macro.h"
+#include "string-util.h"
 
 static void test_parse_cpu_set(void) {
         cpu_set_t *c = NULL;
@@ -119,8 +120,29 @@ static void test_parse_cpu_set(void) {
         assert_se(!c);
 }
 
+static void test_cpu_set_to_range_string_one(const char *rvalue, const char *expected) {
+        _cleanup_cpu_free_ cpu_set_t *c = NULL;
+        _cleanup_free_ char *s = NULL;
+        int ncpus;
+
+        ncpus = parse_cpu_set(rvalue, &c);
+        assert_se(ncpus >= 0);
+        assert_se(s = cpu_set_to_range_string(c, ncpus));
+        assert_se(streq(s, expected));
+}
+
+static void test_cpu_set_to_range_string(void) {
+        test_cpu_set_to_range_string_one("", "");
+        test_cpu_set_to_range_string_one("5", "5");
+        test_cpu_set_to_range_string_one("0 1 2 3", "0-3");
+        test_cpu_set_to_range_string_one("0-3 8 10,11", "0-3,8,10-11");
+        test_cpu_set_to_range_string_one("1 3 5", "1,3,5");
+        test_cpu_set_to_range_string_one("1023", "1023");
+}
+
 int main(int argc, char *argv[]) {
         test_parse_cpu_set();
+        test_cpu_set_to_range_string();
 
         return 0;
 }
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "sd-bus.h"
+
+#include "bus-common-errors.h"
+#include "bus-util.h"
+#include "dbus-manager.h"
+#include "dbus-unit.h"
+#include "manager.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "test-helper.h"
+#include "tests.h"
+
+static void process_both(sd_bus *server, sd_bus *client) {
+        int r, k;
+
+        /* Both ends live in this process, hence dispatch both until neither has anything to do, and then
+         * wait a bit for the broker to pass on what we sent */
+        do {
+                r = sd_bus_process(server, NULL);
+                assert_se(r >= 0);
+
+                k = sd_bus_process(client, NULL);
+                assert_se(k >= 0);
+        } while (r > 0 || k > 0);
+
+        assert_se(sd_bus_wait(client, 10 * USEC_PER_MSEC) >= 0);
+}
+
+static int method_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        sd_bus_message **reply = userdata;
+
+        *reply = sd_bus_message_ref(m);
+        return 0;
+}
+
+static int call_manager(sd_bus *server, sd_bus *client, const char *member, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
+        const char *unique;
+
+        assert_se(sd_bus_get_unique_name(server, &unique) >= 0);
+        assert_se(sd_bus_message_new_method_call(client, &m, unique,
+                                                 "/org/freedesktop/systemd1",
+                                                 "org.freedesktop.systemd1.Manager",
+                                                 member) >= 0);
+        assert_se(sd_bus_call_async(client, NULL, m, method_reply, &reply, 0) >= 0);
+
+        while (!reply)
+                process_both(server, client);
+
+        if (sd_bus_message_is_method_error(reply, NULL))
+                return sd_bus_error_copy(error, sd_bus_message_get_error(reply));
+
+        return 0;
+}
+
+static int on_units_changed(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        unsigned *n_signals = userdata;
+        const char *id, *load, *active, *sub, *path;
+
+        assert_se(sd_bus_message_enter_container(m, 'a', "(sosss)") > 0);
+        assert_se(sd_bus_message_read(m, "(sosss)", &id, &path, &load, &active, &sub) > 0);
+        assert_se(streq(id, "a.service"));
+        assert_se(streq(load, "loaded"));
+        assert_se(sd_bus_message_read(m, "(sosss)", &id, &path, &load, &active, &sub) == 0);
+        assert_se(sd_bus_message_exit_container(m) >= 0);
+
+        (*n_signals)++;
+        return 0;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *server = NULL, *client = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        unsigned n_signals = 0;
+        Unit *a = NULL;
+        int r;
+
+        test_setup_logging(LOG_DEBUG);
+
+        r = enter_cgroup_subroot();
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        if (sd_bus_open_user(&server) < 0 && sd_bus_open_system(&server) < 0)
+                return log_tests_skipped("Failed to connect to bus");
+        assert_se(sd_bus_open_user(&client) >= 0 || sd_bus_open_system(&client) >= 0);
+
+        assert_se(set_unit_path(get_testdata_dir()) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (MANAGER_SKIP_TEST(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+        assert_se(manager_load_startable_unit_or_warn(m, "a.service", NULL, &a) >= 0);
+
+        /* Pretend our server connection is the API bus of the manager */
+        assert_se(sd_bus_add_object_vtable(server, NULL, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager",
+                                           bus_manager_vtable, m) >= 0);
+        m->api_bus = sd_bus_ref(server);
+
+        assert_se(sd_bus_match_signal(client, NULL, NULL, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager",
+                                      "UnitsChanged", on_units_changed, &n_signals) >= 0);
+
+        log_info("/* batched subscription */");
+        assert_se(call_manager(server, client, "SubscribeBatched", &error) == 0);
+        assert_se(sd_bus_track_count(m->subscribed_batched) == 1);
+        assert_se(call_manager(server, client, "SubscribeBatched", &error) < 0);
+        assert_se(sd_bus_error_has_name(&error, BUS_ERROR_ALREADY_SUBSCRIBED));
+        sd_bus_error_free(&error);
+
+        /* A change of the unit is queued for the next UnitsChanged signal, which then drains the queue */
+        bus_unit_send_change_signal(a);
+        assert_se(a->in_units_changed_queue);
+        assert_se(m->units_changed_queue == a);
+        bus_unit_send_change_signal(a);
+        assert_se(m->units_changed_queue == a && !a->units_changed_queue_next);
+
+        bus_manager_send_units_changed(m);
+        assert_se(!a->in_units_changed_queue);
+        assert_se(!m->units_changed_queue);
+
+        while (n_signals == 0)
+                process_both(server, client);
+        assert_se(n_signals == 1);
+
+        log_info("/* unsubscribing drops both subscriptions */");
+        assert_se(call_manager(server, client, "Subscribe", &error) == 0);
+        assert_se(sd_bus_track_count(m->subscribed) == 1);
+
+        assert_se(call_manager(server, client, "Unsubscribe", &error) == 0);
+        assert_se(sd_bus_track_count(m->subscribed) == 0);
+        assert_se(sd_bus_track_count(m->subscribed_batched) == 0);
+
+        assert_se(call_manager(server, client, "Unsubscribe", &error) < 0);
+        assert_se(sd_bus_error_has_name(&error, BUS_ERROR_NOT_SUBSCRIBED));
+        sd_bus_error_free(&error);
+
+        /* Nobody is interested in batched signals anymore, hence nothing is queued */
+        bus_unit_send_change_signal(a);
+        assert_se(!a->in_units_changed_queue);
+        assert_se(!m->units_changed_queue);
+
+        log_info("/* batched subscription only */");
+        assert_se(call_manager(server, client, "SubscribeBatched", &error) == 0);
+        assert_se(call_manager(server, client, "Unsubscribe", &error) == 0);
+        assert_se(sd_bus_track_count(m->subscribed_batched) == 0);
+
+        return 0;
+}
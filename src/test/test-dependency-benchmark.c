@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "manager.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "test-helper.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+
+/* Loads a large number of generated units with a lot of dependencies between them, and prints how much memory that
+ * takes and how long loading them and building a transaction for all of them takes. Useful for comparing changes to
+ * how dependencies are stored. */
+
+static uint64_t get_rss(void) {
+        _cleanup_free_ char *field = NULL;
+        uint64_t v;
+
+        assert_se(get_proc_field("/proc/self/status", "VmRSS", WHITESPACE, &field) >= 0);
+        assert_se(safe_atou64(field, &v) >= 0);
+
+        return v * 1024;
+}
+
+static void write_units(const char *dir, unsigned n_units, unsigned fanout) {
+        _cleanup_free_ char *target = NULL, *p = NULL;
+        unsigned k, l;
+
+        assert_se(target = strdup("[Unit]\nWants="));
+
+        for (k = 0; k < n_units; k++) {
+                _cleanup_free_ char *contents = NULL, *wants = NULL, *after = NULL;
+                char name[STRLEN("u.service") + DECIMAL_STR_MAX(unsigned)];
+
+                for (l = 1; l <= fanout; l++) {
+                        char other[sizeof(name) + 1];
+                        unsigned idx;
+
+                        /* Spread the dependencies over all units, but deterministically, and only order after units
+                         * with a lower index, so that there are no ordering cycles */
+                        idx = (k * 7 + l * 13) % n_units;
+                        if (idx == k)
+                                continue;
+
+                        xsprintf(other, " u%u.service", idx);
+
+                        assert_se(strextend(&wants, other, NULL));
+                        if (idx < k)
+                                assert_se(strextend(&after, other, NULL));
+                }
+
+                assert_se(asprintf(&contents,
+                                   "[Unit]\n"
+                                   "Wants=%s\n"
+                                   "After=%s\n"
+                                   "[Service]\n"
+                                   "ExecStart=/bin/true\n", strempty(wants), strempty(after)) >= 0);
+
+                xsprintf(name, "u%u.service", k);
+                assert_se(p = path_join(dir, name));
+                assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+                p = mfree(p);
+
+                assert_se(strextend(&target, " ", name, NULL));
+        }
+
+        assert_se(p = path_join(dir, "benchmark.target"));
+        assert_se(write_string_file(p, target, WRITE_STRING_FILE_CREATE) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        char buf1[FORMAT_TIMESPAN_MAX], buf2[FORMAT_TIMESPAN_MAX];
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *unit_dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        unsigned n_units = 8000, fanout = 4, k;
+        size_t n_dependencies = 0;
+        uint64_t rss_before, rss_after;
+        usec_t t, load_time, transaction_time;
+        Iterator i;
+        Unit *u;
+        char *key;
+        int r;
+
+        test_setup_logging(LOG_WARNING);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n_units) >= 0 && n_units > 0);
+        if (argc > 2)
+                assert_se(safe_atou(argv[2], &fanout) >= 0);
+
+        r = enter_cgroup_subroot();
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        assert_se(mkdtemp_malloc("/tmp/test-dependency-benchmark-XXXXXX", &unit_dir) >= 0);
+        write_units(unit_dir, n_units, fanout);
+
+        assert_se(set_unit_path(unit_dir) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (MANAGER_SKIP_TEST(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        rss_before = get_rss();
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(manager_load_unit(m, "benchmark.target", NULL, NULL, &u) >= 0);
+        load_time = now(CLOCK_MONOTONIC) - t;
+
+        rss_after = get_rss();
+
+        HASHMAP_FOREACH_KEY(u, key, m->units, i) {
+                UnitDependency d;
+
+                if (u->id != key)
+                        continue;
+
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
+                        n_dependencies += unit_dependency_count(u, d);
+        }
+
+        assert_se(u = manager_get_unit(m, "benchmark.target"));
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < 10; k++) {
+                assert_se(manager_add_job(m, JOB_START, u, JOB_REPLACE, NULL, NULL) >= 0);
+                manager_clear_jobs(m);
+        }
+        transaction_time = (now(CLOCK_MONOTONIC) - t) / 10;
+
+        printf("units\t%u\n"
+               "dependencies\t%zu\n"
+               "rss-growth\t%" PRIu64 " KiB\n"
+               "rss-per-unit\t%" PRIu64 " B\n"
+               "load-time\t%s\n"
+               "transaction-time\t%s\n",
+               hashmap_size(m->units),
+               n_dependencies,
+               (rss_after - rss_before) / 1024,
+               (rss_after - rss_before) / n_units,
+               format_timespan(buf1, sizeof(buf1), load_time, 1),
+               format_timespan(buf2, sizeof(buf2), transaction_time, 1));
+
+        return 0;
+}
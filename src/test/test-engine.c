@@ -14,8 +14,9 @@ int main(int argc, char *argv[]) {
         _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error err = SD_BUS_ERROR_NULL;
         _cleanup_(manager_freep) Manager *m = NULL;
-        Unit *a = NULL, *b = NULL, *c = NULL, *d = NULL, *e = NULL, *g = NULL, *h = NULL, *unit_with_multiple_dashes = NULL;
-        Job *j;
+        Unit *a = NULL, *b = NULL, *c = NULL, *d = NULL, *e = NULL, *g = NULL, *h = NULL, *unit_with_multiple_dashes = NULL,
+                *hello = NULL, *sleep_service = NULL, *hello_socket = NULL;
+        Job *j, *k;
         int r;
 
         test_setup_logging(LOG_DEBUG);
@@ -94,37 +95,72 @@ int main(int argc, char *argv[]) {
         assert_se(manager_add_job(m, JOB_START, h, JOB_FAIL, NULL, &j) == 0);
         manager_dump_jobs(m, stdout, "\t");
 
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(!hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(!hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(!unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b, true, UNIT_DEPENDENCY_UDEV) == 0);
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c, true, UNIT_DEPENDENCY_PROC_SWAP) == 0);
 
-        assert_se(hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         unit_remove_dependencies(a, UNIT_DEPENDENCY_UDEV);
 
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(!hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         unit_remove_dependencies(a, UNIT_DEPENDENCY_PROC_SWAP);
 
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(!hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(!hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(!unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         assert_se(manager_load_unit(m, "unit-with-multiple-dashes.service", NULL, NULL, &unit_with_multiple_dashes) >= 0);
 
         assert_se(strv_equal(unit_with_multiple_dashes->documentation, STRV_MAKE("man:test", "man:override2", "man:override3")));
         assert_se(streq_ptr(unit_with_multiple_dashes->description, "override4"));
 
+        printf("Test11: (Start concurrency)\n");
+        manager_clear_jobs(m);
+        assert_se(manager_load_startable_unit_or_warn(m, "hello.service", NULL, &hello) >= 0);
+        assert_se(manager_load_startable_unit_or_warn(m, "sleep.service", NULL, &sleep_service) >= 0);
+        assert_se(manager_load_unit(m, "hello.socket", NULL, NULL, &hello_socket) >= 0);
+
+        assert_se(manager_add_job(m, JOB_START, hello, JOB_REPLACE, NULL, &j) == 0);
+        assert_se(!job_needs_start_slot(j));
+
+        m->default_start_concurrency = 1;
+        assert_se(job_needs_start_slot(j));
+
+        /* Socket activated services don't wait for a slot, their clients might hold it */
+        assert_se(unit_add_dependency(hello_socket, UNIT_TRIGGERS, hello, true, UNIT_DEPENDENCY_UDEV) == 0);
+        assert_se(!job_needs_start_slot(j));
+        unit_remove_dependencies(hello_socket, UNIT_DEPENDENCY_UDEV);
+        assert_se(job_needs_start_slot(j));
+
+        /* Neither do services that units holding a slot are ordered after */
+        assert_se(unit_add_dependency(hello, UNIT_BEFORE, sleep_service, true, UNIT_DEPENDENCY_UDEV) == 0);
+        assert_se(manager_add_job(m, JOB_START, sleep_service, JOB_REPLACE, NULL, &k) == 0);
+        assert_se(job_needs_start_slot(j));
+
+        k->start_slot = true;
+        m->n_starting_jobs++;
+        assert_se(!job_needs_start_slot(j));
+        assert_se(job_needs_start_slot(k));
+
+        k->start_slot = false;
+        m->n_starting_jobs--;
+        assert_se(job_needs_start_slot(j));
+
+        unit_remove_dependencies(hello, UNIT_DEPENDENCY_UDEV);
+        manager_clear_jobs(m);
+
         return 0;
 }
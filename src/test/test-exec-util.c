@@ -17,6 +17,7 @@
 #include "log.h"
 #include "macro.h"
 #include "path-util.h"
+#include "process-util.h"
 #include "rm-rf.h"
 #include "string-util.h"
 #include "strv.h"
@@ -364,6 +365,61 @@ static void test_environment_gathering(void) {
         (void) setenv("PATH", old, 1);
 }
 
+static void test_timings(bool gather_stdout) {
+        char template[] = "/tmp/test-exec-util.XXXXXXX";
+        const char *dirs[] = {template, NULL};
+        const char *fast, *failing, *slow;
+        ExecTiming *timings = NULL;
+        size_t n_timings = 0, i;
+
+        log_info("/* %s (%s) */", __func__, gather_stdout ? "gathering stdout" : "asynchronous");
+
+        assert_se(mkdtemp(template));
+
+        fast = strjoina(template, "/10-fast");
+        failing = strjoina(template, "/20-failing");
+        slow = strjoina(template, "/30-slow");
+
+        assert_se(write_string_file(fast, "#!/bin/sh\ntrue", WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(failing, "#!/bin/sh\nexit 3", WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(slow, "#!/bin/sh\nexec sleep 60", WRITE_STRING_FILE_CREATE) == 0);
+
+        assert_se(chmod(fast, 0755) == 0);
+        assert_se(chmod(failing, 0755) == 0);
+        assert_se(chmod(slow, 0755) == 0);
+
+        assert_se(execute_directories_full(dirs, DEFAULT_TIMEOUT_USEC, USEC_PER_SEC,
+                                           gather_stdout ? ignore_stdout : NULL,
+                                           gather_stdout ? ignore_stdout_args : NULL,
+                                           NULL, NULL, &timings, &n_timings) >= 0);
+
+        assert_se(n_timings == 3);
+
+        for (i = 0; i < n_timings; i++) {
+                ExecTiming *t = timings + i;
+
+                log_info("%s: wall " USEC_FMT "us, cpu " USEC_FMT "us, code %s, status %i%s",
+                         t->path, t->wall, t->cpu, sigchld_code_to_string(t->code), t->status,
+                         t->timed_out ? ", timed out" : "");
+
+                assert_se(t->start > 0);
+
+                if (streq(t->path, fast))
+                        assert_se(t->code == CLD_EXITED && t->status == 0 && !t->timed_out);
+                else if (streq(t->path, failing))
+                        assert_se(t->code == CLD_EXITED && t->status == 3 && !t->timed_out);
+                else {
+                        assert_se(streq(t->path, slow));
+                        assert_se(t->code == CLD_KILLED && t->status == SIGKILL && t->timed_out);
+                        assert_se(t->wall >= USEC_PER_SEC);
+                }
+        }
+
+        exec_timing_free_many(timings, n_timings);
+
+        (void) rm_rf(template, REMOVE_ROOT|REMOVE_PHYSICAL);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -372,6 +428,8 @@ int main(int argc, char *argv[]) {
         test_execution_order();
         test_stdout_gathering();
         test_environment_gathering();
+        test_timings(true);
+        test_timings(false);
 
         return 0;
 }
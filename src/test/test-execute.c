@@ -14,6 +14,7 @@
 #include "macro.h"
 #include "manager.h"
 #include "missing_prctl.h"
+#include "missing_syscall.h"
 #include "mkdir.h"
 #include "path-util.h"
 #include "rm-rf.h"
@@ -192,6 +193,18 @@ static void test_exec_cpuaffinity(Manager *m) {
         test(m, "exec-cpuaffinity3.service", 0, CLD_EXITED);
 }
 
+static void test_exec_numapolicy(Manager *m) {
+        if (access("/proc/self/numa_maps", F_OK) < 0 ||
+            (get_mempolicy(NULL, NULL, 0, NULL, 0) < 0 && errno == ENOSYS)) {
+                log_notice("NUMA support not available, skipping %s", __func__);
+                return;
+        }
+
+        test(m, "exec-numapolicy-bind.service", 0, CLD_EXITED);
+        test(m, "exec-numapolicy-local.service", 0, CLD_EXITED);
+        test(m, "exec-numapolicy-bind-nomask.service", EXIT_NUMA_POLICY, CLD_EXITED);
+}
+
 static void test_exec_workingdirectory(Manager *m) {
         assert_se(mkdir_p("/tmp/test-exec_workingdirectory", 0755) >= 0);
 
@@ -726,6 +739,7 @@ int main(int argc, char *argv[]) {
                 test_exec_ignoresigpipe,
                 test_exec_inaccessiblepaths,
                 test_exec_ioschedulingclass,
+                test_exec_numapolicy,
                 test_exec_oomscoreadjust,
                 test_exec_passenvironment,
                 test_exec_personality,
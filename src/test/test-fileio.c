@@ -2,6 +2,7 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "alloc-util.h"
@@ -14,6 +15,7 @@
 #include "io-util.h"
 #include "parse-util.h"
 #include "process-util.h"
+#include "rm-rf.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
@@ -776,6 +778,72 @@ static void test_read_line4(void) {
         }
 }
 
+static void test_read_one_line_file(void) {
+        _cleanup_(unlink_tempfilep) char name[] = "/tmp/test-fileio-one-line.XXXXXX";
+        _cleanup_free_ char *line = NULL, *long_line = NULL;
+        _cleanup_close_ int fd = -1;
+
+        fd = mkostemp_safe(name);
+        assert_se(fd >= 0);
+
+        assert_se(write_string_file(name, "first\r\nsecond", WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_AVOID_NEWLINE) >= 0);
+        assert_se(read_one_line_file(name, &line) >= 0);
+        assert_se(streq(line, "first"));
+        line = mfree(line);
+
+        assert_se(write_string_file(name, "", WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_AVOID_NEWLINE) >= 0);
+        assert_se(read_one_line_file(name, &line) >= 0);
+        assert_se(streq(line, ""));
+        line = mfree(line);
+
+        /* A first line longer than what is read in one go */
+        assert_se(long_line = malloc(3 * LINE_MAX + 1));
+        memset(long_line, 'x', 3 * LINE_MAX);
+        long_line[3 * LINE_MAX] = 0;
+        assert_se(write_string_file(name, long_line, WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(read_one_line_file(name, &line) >= 0);
+        assert_se(streq(line, long_line));
+}
+
+static void test_read_one_line_file_fifo(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_free_ char *line = NULL;
+        _cleanup_close_ int fd = -1;
+        const char *fn;
+
+        assert_se(mkdtemp_malloc("/tmp/test-fileio-fifo-XXXXXX", &t) >= 0);
+        fn = strjoina(t, "/fifo");
+        assert_se(mkfifo(fn, 0600) >= 0);
+
+        /* The writer stays around, hence this would block if more than the first line was waited for */
+        fd = open(fn, O_RDWR|O_CLOEXEC);
+        assert_se(fd >= 0);
+        assert_se(write(fd, "first\nsecond", 12) == 12);
+
+        assert_se(read_one_line_file(fn, &line) >= 0);
+        assert_se(streq(line, "first"));
+}
+
+static void test_read_full_file_virtual(void) {
+        _cleanup_free_ char *a = NULL, *b = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t sa, sb;
+
+        /* Files in /proc report a size of 0, hence take the path through the per-thread buffer */
+        assert_se(read_full_file("/proc/self/cmdline", &a, &sa) >= 0);
+
+        assert_se(f = fopen("/proc/self/cmdline", "re"));
+        assert_se(read_full_stream(f, &b, &sb) >= 0);
+
+        assert_se(sa == sb);
+        assert_se(memcmp(a, b, sa) == 0);
+        assert_se(a[sa] == 0);
+
+        /* Embedded NUL bytes are refused, if the caller does not ask for the size */
+        a = mfree(a);
+        assert_se(read_full_file("/proc/self/cmdline", &a, NULL) == -EBADMSG);
+}
+
 static void test_read_nul_string(void) {
         static const char test[] = "string nr. 1\0"
                 "string nr. 2\n\0"
@@ -835,6 +903,9 @@ int main(int argc, char *argv[]) {
         test_read_line3();
         test_read_line4();
         test_read_nul_string();
+        test_read_one_line_file();
+        test_read_one_line_file_fifo();
+        test_read_full_file_virtual();
 
         return 0;
 }
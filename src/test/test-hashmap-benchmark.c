@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "hashmap.h"
+#include "log.h"
+#include "parse-util.h"
+#include "set.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Times put, get, iteration and removal for the plain, ordered and set variants, with string and pointer keys, at
+ * different sizes. Prints the average time per operation. Pass the largest number of entries to try as the first
+ * argument, by default it is 10^6, or 10^7 with slow tests enabled. Useful for comparing changes to the hash table
+ * implementation, for example building with and without -Dhashmap-simd-probing. Keys are hashed with both SipHash-2-4
+ * and SipHash-1-3 ("-1-3"). */
+
+typedef enum BenchmarkType {
+        BENCHMARK_PLAIN,
+        BENCHMARK_ORDERED,
+        BENCHMARK_SET,
+        _BENCHMARK_TYPE_MAX,
+} BenchmarkType;
+
+static const char* const benchmark_type_table[_BENCHMARK_TYPE_MAX] = {
+        [BENCHMARK_PLAIN] = "plain",
+        [BENCHMARK_ORDERED] = "ordered",
+        [BENCHMARK_SET] = "set",
+};
+
+static void *benchmark_new(BenchmarkType type, const struct hash_ops *ops) {
+        switch (type) {
+
+        case BENCHMARK_PLAIN:
+                return hashmap_new(ops);
+
+        case BENCHMARK_ORDERED:
+                return ordered_hashmap_new(ops);
+
+        case BENCHMARK_SET:
+                return set_new(ops);
+
+        default:
+                assert_not_reached("Unknown benchmark type");
+        }
+}
+
+static int benchmark_put(BenchmarkType type, void *h, const void *key) {
+        switch (type) {
+
+        case BENCHMARK_PLAIN:
+                return hashmap_put(h, key, (void*) key);
+
+        case BENCHMARK_ORDERED:
+                return ordered_hashmap_put(h, key, (void*) key);
+
+        case BENCHMARK_SET:
+                return set_put(h, key);
+
+        default:
+                assert_not_reached("Unknown benchmark type");
+        }
+}
+
+static void *benchmark_get(BenchmarkType type, void *h, const void *key) {
+        switch (type) {
+
+        case BENCHMARK_PLAIN:
+                return hashmap_get(h, key);
+
+        case BENCHMARK_ORDERED:
+                return ordered_hashmap_get(h, key);
+
+        case BENCHMARK_SET:
+                return set_get(h, (void*) key);
+
+        default:
+                assert_not_reached("Unknown benchmark type");
+        }
+}
+
+static unsigned benchmark_iterate(BenchmarkType type, void *h) {
+        Iterator i;
+        unsigned n = 0;
+        void *v;
+
+        switch (type) {
+
+        case BENCHMARK_PLAIN:
+                HASHMAP_FOREACH(v, h, i)
+                        n++;
+                break;
+
+        case BENCHMARK_ORDERED:
+                ORDERED_HASHMAP_FOREACH(v, h, i)
+                        n++;
+                break;
+
+        case BENCHMARK_SET:
+                SET_FOREACH(v, h, i)
+                        n++;
+                break;
+
+        default:
+                assert_not_reached("Unknown benchmark type");
+        }
+
+        return n;
+}
+
+static void *benchmark_remove(BenchmarkType type, void *h, const void *key) {
+        switch (type) {
+
+        case BENCHMARK_PLAIN:
+                return hashmap_remove(h, key);
+
+        case BENCHMARK_ORDERED:
+                return ordered_hashmap_remove(h, key);
+
+        case BENCHMARK_SET:
+                return set_remove(h, key);
+
+        default:
+                assert_not_reached("Unknown benchmark type");
+        }
+}
+
+static void *benchmark_free(BenchmarkType type, void *h) {
+        switch (type) {
+
+        case BENCHMARK_PLAIN:
+                return hashmap_free(h);
+
+        case BENCHMARK_ORDERED:
+                return ordered_hashmap_free(h);
+
+        case BENCHMARK_SET:
+                return set_free(h);
+
+        default:
+                assert_not_reached("Unknown benchmark type");
+        }
+}
+
+static double nsec_per_op(usec_t start, unsigned n) {
+        return (double) (now(CLOCK_MONOTONIC) - start) * NSEC_PER_USEC / n;
+}
+
+static void benchmark(BenchmarkType type, const char *key_type, const struct hash_ops *ops, void **keys, unsigned n) {
+        double put, get, iterate, remove;
+        unsigned k;
+        usec_t t;
+        void *h;
+
+        assert_se(h = benchmark_new(type, ops));
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n; k++)
+                assert_se(benchmark_put(type, h, keys[k]) == 1);
+        put = nsec_per_op(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n; k++)
+                assert_se(benchmark_get(type, h, keys[k]) == keys[k]);
+        get = nsec_per_op(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(benchmark_iterate(type, h) == n);
+        iterate = nsec_per_op(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n; k++)
+                assert_se(benchmark_remove(type, h, keys[k]) == keys[k]);
+        remove = nsec_per_op(t, n);
+
+        benchmark_free(type, h);
+
+        printf("%-7s %-7s %8u: put %7.1f ns, get %7.1f ns, iterate %7.1f ns, remove %7.1f ns\n",
+               benchmark_type_table[type], key_type, n, put, get, iterate, remove);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_free_ void **strings = NULL, **pointers = NULL;
+        unsigned n_max, n, k;
+        BenchmarkType type;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n_max) >= 0);
+        else
+                n_max = slow_tests_enabled() ? 10000000U : 1000000U;
+
+        assert_se(strings = new(void*, n_max));
+        assert_se(pointers = new(void*, n_max));
+
+        for (k = 0; k < n_max; k++) {
+                assert_se(asprintf((char**) &strings[k], "benchmark-key-%u", k) >= 0);
+                pointers[k] = UINT_TO_PTR(k + 1);
+        }
+
+        for (n = 1000; n <= n_max; n *= 10)
+                for (type = 0; type < _BENCHMARK_TYPE_MAX; type++) {
+                        benchmark(type, "string", &string_hash_ops, strings, n);
+                        benchmark(type, "str-1-3", &string_hash_ops_siphash13, strings, n);
+                        benchmark(type, "pointer", NULL, pointers, n);
+                        benchmark(type, "ptr-1-3", &trivial_hash_ops_siphash13, pointers, n);
+                }
+
+        for (k = 0; k < n_max; k++)
+                free(strings[k]);
+
+        return 0;
+}
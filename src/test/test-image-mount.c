@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "image-mount.h"
+#include "path-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+static void test_image_mount_acquire(void) {
+        _cleanup_free_ char *directory = NULL;
+        ImageMount *a, *b, *c;
+        Manager m = {};
+
+        log_info("/* %s */", __func__);
+
+        assert_se(image_mount_acquire(&m, "/var/lib/images/foo.raw", &a) == 1);
+        assert_se(a->n_ref == 1);
+        assert_se(path_equal(a->image, "/var/lib/images/foo.raw"));
+        assert_se(path_startswith(a->directory, "/run/systemd/image-mounts/"));
+
+        /* The same image, even if spelled differently, is shared */
+        assert_se(image_mount_acquire(&m, "/var/lib/images//foo.raw", &b) == 0);
+        assert_se(a == b);
+        assert_se(a->n_ref == 2);
+
+        assert_se(image_mount_acquire(&m, "/var/lib/images/bar.raw", &c) == 1);
+        assert_se(c != a);
+        assert_se(!streq(c->directory, a->directory));
+        assert_se(hashmap_size(m.image_mounts) == 2);
+
+        assert_se(!image_mount_unref(b, false));
+        assert_se(a->n_ref == 1);
+        assert_se(hashmap_get(m.image_mounts, "/var/lib/images/foo.raw") == a);
+
+        assert_se(directory = strdup(a->directory));
+        assert_se(!image_mount_unref(a, false));
+        assert_se(!hashmap_get(m.image_mounts, "/var/lib/images/foo.raw"));
+        assert_se(hashmap_size(m.image_mounts) == 1);
+
+        /* The directory is derived from the path alone, hence stays the same across daemon reloads */
+        assert_se(image_mount_acquire(&m, "/var/lib/images/foo.raw", &a) == 1);
+        assert_se(streq(a->directory, directory));
+
+        assert_se(!image_mount_unref(a, false));
+        assert_se(!image_mount_unref(c, false));
+        assert_se(hashmap_isempty(m.image_mounts));
+
+        hashmap_free(m.image_mounts);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_image_mount_acquire();
+
+        return 0;
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "intern.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+
+static void test_intern(void) {
+        _cleanup_free_ char *copy = NULL;
+        const char *a, *b, *c;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(intern_size() == 0);
+        assert_se(!intern_lookup("foo.service"));
+
+        assert_se(a = intern("foo.service"));
+        assert_se(streq(a, "foo.service"));
+        assert_se(intern_lookup("foo.service") == a);
+
+        /* The same string, stored elsewhere, gives the same pointer */
+        assert_se(copy = strdup("foo.service"));
+        assert_se(b = intern(copy));
+        assert_se(a == b);
+        assert_se(intern_size() == 1);
+
+        assert_se(c = intern("bar.service"));
+        assert_se(c != a);
+        assert_se(intern_size() == 2);
+
+        assert_se(!intern_unref(b));
+        assert_se(intern_lookup("foo.service") == a);
+        assert_se(!intern_unref(a));
+        assert_se(!intern_lookup("foo.service"));
+        assert_se(intern_size() == 1);
+
+        assert_se(intern_ref(c) == c);
+        intern_unref(c);
+        intern_unref(c);
+        assert_se(intern_size() == 0);
+
+        assert_se(!intern_ref(NULL));
+        assert_se(!intern_unref(NULL));
+}
+
+static void test_intern_strv(void) {
+        _cleanup_(intern_strv_freep) char **l = NULL, **m = NULL;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(intern_strv_extend(&l, "/etc/systemd/system/service.d/50-foo.conf") == 1);
+        assert_se(intern_strv_extend(&l, "/run/systemd/system/foo.service.d/override.conf") == 1);
+        assert_se(intern_strv_extend(&l, "/etc/systemd/system/service.d/50-foo.conf") == 0);
+        assert_se(strv_length(l) == 2);
+
+        assert_se(intern_strv_extend(&m, "/etc/systemd/system/service.d/50-foo.conf") == 1);
+        assert_se(m[0] == l[0]);
+
+        /* Two arrays, three entries, two distinct strings */
+        assert_se(intern_size() == 2);
+
+        l = intern_strv_free(l);
+        assert_se(intern_size() == 1);
+        m = intern_strv_free(m);
+        assert_se(intern_size() == 0);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_intern();
+        test_intern_strv();
+
+        return 0;
+}
@@ -3,13 +3,17 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "alloc-util.h"
+#include "fd-util.h"
+#include "io-util.h"
 #include "log.h"
 #include "journal-importer.h"
 #include "path-util.h"
 #include "string-util.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 
 static void assert_iovec_entry(const struct iovec *iovec, const char* content) {
         assert_se(strlen(content) == iovec->iov_len);
@@ -68,11 +72,74 @@ static void test_bad_input(void) {
         assert_se(journal_importer_eof(&imp));
 }
 
+static int read_entry(JournalImporter *imp) {
+        int r;
+
+        journal_importer_drop_iovw(imp);
+
+        do
+                r = journal_importer_process_data(imp);
+        while (r == 0 && !journal_importer_eof(imp));
+
+        return r;
+}
+
+static void test_references(void) {
+        _cleanup_(journal_importer_cleanup) JournalImporter imp = {
+                .references = true,
+        };
+        char p[] = "/tmp/test-journal-importer-XXXXXX";
+        static const char data[] =
+                "&1\n"
+                "_HOSTNAME=foo\n"
+                "&2\n"
+                "BINARY\n"
+                "\003\0\0\0\0\0\0\0" "a\nb\n"
+                "MESSAGE=one\n"
+                "\n"
+                "*1\n"
+                "*2\n"
+                "&1\n"
+                "_HOSTNAME=bar\n"
+                "MESSAGE=two\n"
+                "\n"
+                "*1\n"
+                "*5\n"
+                "\n";
+
+        imp.fd = mkostemp_safe(p);
+        assert_se(imp.fd >= 0);
+        (void) unlink(p);
+
+        assert_se(loop_write(imp.fd, data, sizeof(data) - 1, false) >= 0);
+        assert_se(lseek(imp.fd, 0, SEEK_SET) == 0);
+
+        assert_se(read_entry(&imp) == 1);
+        assert_se(imp.iovw.count == 3);
+        assert_iovec_entry(&imp.iovw.iovec[0], "_HOSTNAME=foo");
+        assert_iovec_entry(&imp.iovw.iovec[1], "BINARY=a\nb");
+        assert_iovec_entry(&imp.iovw.iovec[2], "MESSAGE=one");
+
+        /* The second entry refers to both fields of the first one, and then replaces one of them */
+        assert_se(read_entry(&imp) == 1);
+        assert_se(imp.iovw.count == 4);
+        assert_iovec_entry(&imp.iovw.iovec[0], "_HOSTNAME=foo");
+        assert_iovec_entry(&imp.iovw.iovec[1], "BINARY=a\nb");
+        assert_iovec_entry(&imp.iovw.iovec[2], "_HOSTNAME=bar");
+        assert_iovec_entry(&imp.iovw.iovec[3], "MESSAGE=two");
+
+        /* Slot 5 was never defined */
+        assert_se(read_entry(&imp) == -EBADMSG);
+        assert_se(imp.iovw.count == 1);
+        assert_iovec_entry(&imp.iovw.iovec[0], "_HOSTNAME=bar");
+}
+
 int main(int argc, char **argv) {
         test_setup_logging(LOG_DEBUG);
 
         test_basic_parsing();
         test_bad_input();
+        test_references();
 
         return 0;
 }
@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "json.h"
+#include "log.h"
+#include "parse-util.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Compares building a JsonVariant tree and formatting it with parsing through callbacks and writing through a
+ * JsonWriter, on a journal-like array of objects, and times key lookups in objects of different sizes. Pass the
+ * number of records to use as the first argument, by default it is 10^4, or 10^5 with slow tests enabled. */
+
+static const char *const fields[] = {
+        "__CURSOR", "__REALTIME_TIMESTAMP", "__MONOTONIC_TIMESTAMP", "_BOOT_ID", "PRIORITY", "SYSLOG_FACILITY",
+        "SYSLOG_IDENTIFIER", "_PID", "_UID", "_GID", "_COMM", "_EXE", "_CMDLINE", "_CAP_EFFECTIVE",
+        "_SYSTEMD_CGROUP", "_SYSTEMD_UNIT", "_SYSTEMD_SLICE", "_MACHINE_ID", "_HOSTNAME", "_TRANSPORT", "MESSAGE",
+};
+
+static char *generate(unsigned n) {
+        _cleanup_fclose_ FILE *f = NULL;
+        char *buf = NULL;
+        size_t sz = 0, i;
+        unsigned k;
+
+        assert_se(f = open_memstream(&buf, &sz));
+
+        fputc('[', f);
+        for (k = 0; k < n; k++) {
+                fputs(k > 0 ? ",{" : "{", f);
+
+                for (i = 0; i < ELEMENTSOF(fields); i++)
+                        fprintf(f, "%s\"%s\":\"value-%u-%zu\"", i > 0 ? "," : "", fields[i], k, i);
+
+                fprintf(f, ",\"n\":%u,\"x\":-%u.5,\"b\":%s,\"z\":null,\"a\":[1,2,3]}", k, k, k % 2 ? "true" : "false");
+        }
+        fputc(']', f);
+
+        assert_se(fflush_and_check(f) >= 0);
+        f = safe_fclose(f);
+
+        return buf;
+}
+
+static double usec_per_record(usec_t start, unsigned n) {
+        return (double) (now(CLOCK_MONOTONIC) - start) / n;
+}
+
+static int on_object_begin(void *userdata) {
+        return json_writer_object_begin(userdata);
+}
+
+static int on_object_end(void *userdata) {
+        return json_writer_object_end(userdata);
+}
+
+static int on_array_begin(void *userdata) {
+        return json_writer_array_begin(userdata);
+}
+
+static int on_array_end(void *userdata) {
+        return json_writer_array_end(userdata);
+}
+
+static int on_key(const char *key, void *userdata) {
+        return json_writer_key(userdata, key);
+}
+
+static int on_string(const char *s, void *userdata) {
+        return json_writer_string(userdata, s);
+}
+
+static int on_integer(intmax_t i, void *userdata) {
+        return json_writer_integer(userdata, i);
+}
+
+static int on_unsigned(uintmax_t u, void *userdata) {
+        return json_writer_unsigned(userdata, u);
+}
+
+static int on_real(long double d, void *userdata) {
+        return json_writer_real(userdata, d);
+}
+
+static int on_boolean(bool b, void *userdata) {
+        return json_writer_boolean(userdata, b);
+}
+
+static int on_null(void *userdata) {
+        return json_writer_null(userdata);
+}
+
+static const JsonParseCallbacks copy_callbacks = {
+        .object_begin = on_object_begin,
+        .object_end = on_object_end,
+        .array_begin = on_array_begin,
+        .array_end = on_array_end,
+        .key = on_key,
+        .string = on_string,
+        .integer = on_integer,
+        .unsig = on_unsigned,
+        .real = on_real,
+        .boolean = on_boolean,
+        .null = on_null,
+};
+
+static void benchmark_roundtrip(const char *input, unsigned n) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_free_ char *formatted = NULL;
+        _cleanup_fclose_ FILE *null = NULL;
+        double tree_parse, tree_format, events;
+        usec_t t;
+
+        assert_se(null = fopen("/dev/null", "we"));
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(json_parse(input, &v, NULL, NULL) >= 0);
+        tree_parse = usec_per_record(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(json_variant_format(v, 0, &formatted) >= 0);
+        fputs(formatted, null);
+        tree_format = usec_per_record(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        {
+                _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+
+                assert_se(json_writer_new(&w, null, 0) >= 0);
+                assert_se(json_parse_events(input, &copy_callbacks, w, NULL, NULL) >= 0);
+                assert_se(json_writer_finish(w) >= 0);
+        }
+        events = usec_per_record(t, n);
+
+        printf("%8u records: tree parse %6.2f us, tree format %6.2f us, events+writer %6.2f us per record\n",
+               n, tree_parse, tree_format, events);
+}
+
+static void benchmark_lookup(unsigned n_keys, unsigned n_lookups) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_free_ JsonVariant **array = NULL;
+        unsigned k;
+        usec_t t;
+
+        assert_se(array = new0(JsonVariant*, n_keys * 2));
+
+        for (k = 0; k < n_keys; k++) {
+                char key[STRLEN("key-") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(key, "key-%u", k);
+                assert_se(json_variant_new_string(array + k * 2, key) >= 0);
+                assert_se(json_variant_new_unsigned(array + k * 2 + 1, k) >= 0);
+        }
+
+        assert_se(json_variant_new_object(&v, array, n_keys * 2) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n_lookups; k++) {
+                char key[STRLEN("key-") + DECIMAL_STR_MAX(unsigned)];
+                JsonVariant *e;
+
+                xsprintf(key, "key-%u", k % n_keys);
+                assert_se(e = json_variant_by_key(v, key));
+                assert_se(json_variant_unsigned(e) == k % n_keys);
+        }
+
+        printf("%8u keys: %7.1f ns per lookup\n", n_keys, (double) (now(CLOCK_MONOTONIC) - t) * NSEC_PER_USEC / n_lookups);
+
+        for (k = 0; k < n_keys * 2; k++)
+                json_variant_unref(array[k]);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_free_ char *input = NULL;
+        unsigned n, n_keys;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n) >= 0);
+        else
+                n = slow_tests_enabled() ? 100000U : 10000U;
+
+        assert_se(input = generate(n));
+        benchmark_roundtrip(input, n);
+
+        for (n_keys = 4; n_keys <= 4096; n_keys *= 4)
+                benchmark_lookup(n_keys, 1000000U);
+
+        return 0;
+}
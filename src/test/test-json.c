@@ -6,6 +6,7 @@
 #include "fd-util.h"
 #include "json-internal.h"
 #include "json.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "util.h"
@@ -400,6 +401,230 @@ static void test_depth(void) {
         fputs("\n", stdout);
 }
 
+static void test_key_index(void) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *s = NULL;
+        JsonVariant *k, *e;
+        size_t sz = 0;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        /* Large enough for the object to get a sorted key index */
+        assert_se(f = open_memstream(&s, &sz));
+        fputs("{ \"dup\" : 1000", f);
+        for (i = 0; i < 40; i++)
+                fprintf(f, ", \"key%u\" : %u", (i * 7) % 40, i);
+        fputs(", \"dup\" : 2000 }", f);
+        f = safe_fclose(f);
+
+        assert_se(json_parse(s, &v, NULL, NULL) >= 0);
+        assert_se(json_variant_elements(v) == 2 * 42);
+
+        for (i = 0; i < 40; i++) {
+                char key[STRLEN("key") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(key, "key%u", (i * 7) % 40);
+                assert_se(e = json_variant_by_key_full(v, key, &k));
+                assert_se(json_variant_unsigned(e) == i);
+                assert_se(streq(json_variant_string(k), key));
+        }
+
+        /* The first of duplicate keys wins, like for small objects */
+        assert_se(e = json_variant_by_key(v, "dup"));
+        assert_se(json_variant_unsigned(e) == 1000);
+
+        assert_se(!json_variant_by_key(v, "key40"));
+        assert_se(!json_variant_by_key(v, "aaa"));
+        assert_se(!json_variant_by_key(v, "zzz"));
+}
+
+static void test_writer(JsonFormatFlags flags) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+        _cleanup_free_ char *expected = NULL, *buf = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t sz = 0;
+
+        log_info("/* %s(%s) */", __func__, flags & JSON_FORMAT_PRETTY ? "pretty" : "plain");
+
+        assert_se(json_parse("{ \"foo\" : [ 1, -2, 3.5, true, null, \"b\\\"ar\" ], \"empty\" : {}, \"e2\" : [],"
+                             "  \"nested\" : { \"x\" : [ [ false ] ] } }", &v, NULL, NULL) >= 0);
+        assert_se(json_variant_format(v, flags, &expected) >= 0);
+
+        assert_se(f = open_memstream(&buf, &sz));
+        assert_se(json_writer_new(&w, f, flags) >= 0);
+
+        assert_se(json_writer_object_begin(w) >= 0);
+        assert_se(json_writer_key(w, "foo") >= 0);
+        assert_se(json_writer_array_begin(w) >= 0);
+        assert_se(json_writer_unsigned(w, 1) >= 0);
+        assert_se(json_writer_integer(w, -2) >= 0);
+        assert_se(json_writer_real(w, 3.5) >= 0);
+        assert_se(json_writer_boolean(w, true) >= 0);
+        assert_se(json_writer_null(w) >= 0);
+        assert_se(json_writer_string(w, "b\"ar") >= 0);
+        assert_se(json_writer_array_end(w) >= 0);
+        assert_se(json_writer_key(w, "empty") >= 0);
+        assert_se(json_writer_object_begin(w) >= 0);
+        assert_se(json_writer_object_end(w) >= 0);
+        assert_se(json_writer_key(w, "e2") >= 0);
+        assert_se(json_writer_array_begin(w) >= 0);
+        assert_se(json_writer_array_end(w) >= 0);
+
+        /* A value where a key is expected is refused */
+        assert_se(json_writer_null(w) == -EINVAL);
+
+        assert_se(json_writer_key(w, "nested") >= 0);
+        assert_se(json_writer_variant(w, json_variant_by_key(v, "nested")) >= 0);
+        assert_se(json_writer_finish(w) == -EINVAL);
+        assert_se(json_writer_object_end(w) >= 0);
+        assert_se(json_writer_finish(w) >= 0);
+
+        /* Only a single value at the top level */
+        assert_se(json_writer_null(w) == -EINVAL);
+
+        f = safe_fclose(f);
+
+        assert_se(streq(buf, expected));
+}
+
+typedef struct EventsState {
+        JsonWriter *writer;
+} EventsState;
+
+static int events_object_begin(void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_object_begin(s->writer);
+}
+
+static int events_object_end(void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_object_end(s->writer);
+}
+
+static int events_array_begin(void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_array_begin(s->writer);
+}
+
+static int events_array_end(void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_array_end(s->writer);
+}
+
+static int events_key(const char *key, void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_key(s->writer, key);
+}
+
+static int events_string(const char *str, void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_string(s->writer, str);
+}
+
+static int events_integer(intmax_t i, void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_integer(s->writer, i);
+}
+
+static int events_unsigned(uintmax_t u, void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_unsigned(s->writer, u);
+}
+
+static int events_real(long double d, void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_real(s->writer, d);
+}
+
+static int events_boolean(bool b, void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_boolean(s->writer, b);
+}
+
+static int events_null(void *userdata) {
+        EventsState *s = userdata;
+        return json_writer_null(s->writer);
+}
+
+static const JsonParseCallbacks events_callbacks = {
+        .object_begin = events_object_begin,
+        .object_end = events_object_end,
+        .array_begin = events_array_begin,
+        .array_end = events_array_end,
+        .key = events_key,
+        .string = events_string,
+        .integer = events_integer,
+        .unsig = events_unsigned,
+        .real = events_real,
+        .boolean = events_boolean,
+        .null = events_null,
+};
+
+static void test_parse_events_one(const char *data, int expected) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_(json_writer_freep) JsonWriter *w = NULL;
+        _cleanup_free_ char *formatted = NULL, *buf = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        EventsState s = {};
+        size_t sz = 0;
+        int r;
+
+        log_info("/* %s(%s) */", __func__, data);
+
+        assert_se(f = open_memstream(&buf, &sz));
+        assert_se(json_writer_new(&w, f, 0) >= 0);
+        s.writer = w;
+
+        r = json_parse_events(data, &events_callbacks, &s, NULL, NULL);
+        assert_se(r == expected);
+
+        /* The tree parser must agree on what is valid */
+        assert_se((json_parse(data, &v, NULL, NULL) >= 0) == (expected >= 0));
+        if (expected < 0)
+                return;
+
+        assert_se(json_writer_finish(w) >= 0);
+        f = safe_fclose(f);
+
+        assert_se(json_variant_format(v, 0, &formatted) >= 0);
+        assert_se(streq(buf, formatted));
+}
+
+static int events_fail_second_key(const char *key, void *userdata) {
+        unsigned *n = userdata;
+
+        if (++*n == 2)
+                return -ENOANO;
+
+        return 0;
+}
+
+static void test_parse_events(void) {
+        static const JsonParseCallbacks nothing = {};
+        unsigned n = 0;
+
+        test_parse_events_one("{\"k\": \"v\", \"foo\": [1, 2, -3, 4.25], \"bar\": {\"zap\": null, \"t\": true}}", 0);
+        test_parse_events_one("[]", 0);
+        test_parse_events_one("\"foo\"", 0);
+        test_parse_events_one("[ [ [ {} ] ], false ]", 0);
+        test_parse_events_one("", -EINVAL);
+        test_parse_events_one("[ 1, ]", -EINVAL);
+        test_parse_events_one("{ \"a\" : 1, \"b\" }", -EINVAL);
+        test_parse_events_one("{ \"a\" : 1 ] ", -EINVAL);
+        test_parse_events_one("1 2", -EINVAL);
+
+        /* No callbacks at all is fine too */
+        assert_se(json_parse_events("{ \"a\" : [ 1, 2 ] }", &nothing, NULL, NULL, NULL) == 0);
+
+        /* Errors from callbacks are propagated */
+        assert_se(json_parse_events("{ \"a\" : 1, \"b\" : 2, \"c\" : 3 }",
+                                    &(JsonParseCallbacks) { .key = events_fail_second_key }, &n, NULL, NULL) == -ENOANO);
+        assert_se(n == 2);
+}
+
 int main(int argc, char *argv[]) {
 
         log_set_max_level(LOG_DEBUG);
@@ -455,5 +680,13 @@ int main(int argc, char *argv[]) {
 
         test_depth();
 
+        test_key_index();
+
+        test_writer(0);
+        test_writer(JSON_FORMAT_PRETTY);
+        test_writer(JSON_FORMAT_PRETTY|JSON_FORMAT_COLOR);
+
+        test_parse_events();
+
         return 0;
 }
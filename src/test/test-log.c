@@ -1,11 +1,22 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <stddef.h>
+#include <sys/mount.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
 #include "format-util.h"
+#include "fs-util.h"
 #include "log.h"
+#include "mkdir.h"
 #include "process-util.h"
+#include "socket-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tmpfile-util.h"
 #include "util.h"
 
 assert_cc(LOG_REALM_REMOVE_LEVEL(LOG_REALM_PLUS_LEVEL(LOG_REALM_SYSTEMD, LOG_FTP | LOG_DEBUG))
@@ -59,6 +70,179 @@ static void test_long_lines(void) {
                             "asdfasdf %s asdfasdfa", "foobar");
 }
 
+static void test_log_queue(void) {
+        unsigned i;
+
+        assert_se(log_queue_enable(16) >= 0);
+
+        /* More than fit into the queue */
+        for (i = 0; i < 100; i++)
+                log_info("Queued message %u", i);
+
+        test_log_struct();
+        test_long_lines();
+        log_error("Not queued");
+
+        (void) log_queue_flush();
+        log_queue_disable();
+}
+
+static unsigned read_journal(int fd, unsigned next, unsigned n_max, bool timestamped) {
+        char buf[LINE_MAX];
+        ssize_t l;
+
+        /* Reads up to n_max datagrams from the fake journal socket, and checks that they carry the messages
+         * numbered from next on, in order. Returns the number of the next message expected. */
+
+        for (; n_max > 0; n_max--) {
+                const char *m;
+                unsigned k;
+
+                l = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+                if (l < 0) {
+                        assert_se(errno == EAGAIN);
+                        break;
+                }
+
+                buf[l] = 0;
+
+                m = strstr(buf, "\nMESSAGE=Message ");
+                if (!m)
+                        continue;
+
+                assert_se(sscanf(m, "\nMESSAGE=Message %u", &k) == 1);
+                assert_se(k == next);
+                assert_se(!!strstr(buf, "\nSOURCE_REALTIME_TIMESTAMP=") == timestamped);
+                next++;
+        }
+
+        return next;
+}
+
+static unsigned read_kmsg(const char *path, size_t *offset, unsigned next) {
+        _cleanup_free_ char *contents = NULL;
+        _cleanup_strv_free_ char **lines = NULL;
+        char **line;
+        size_t size;
+
+        /* Same for the messages written to our fake /dev/kmsg since the last call */
+
+        assert_se(read_full_file(path, &contents, &size) >= 0);
+        assert_se(lines = strv_split_newlines(contents + *offset));
+        *offset = size;
+
+        STRV_FOREACH(line, lines) {
+                const char *m;
+                unsigned k;
+
+                m = strstr(*line, ": Message ");
+                if (!m)
+                        continue;
+
+                assert_se(sscanf(m, ": Message %u", &k) == 1);
+                assert_se(k == next);
+                next++;
+        }
+
+        return next;
+}
+
+static void shorten_journal_send_timeout(void) {
+        int fd;
+
+        /* Unless we are PID 1, log.c waits for up to 10s for the journal to take a message. Don't, when the
+         * fake journal doesn't read anything. */
+
+        for (fd = 3; fd < 64; fd++) {
+                union sockaddr_union sa = {};
+                socklen_t salen = sizeof(sa);
+
+                if (getpeername(fd, &sa.sa, &salen) < 0 || sa.sa.sa_family != AF_UNIX)
+                        continue;
+
+                if (streq(sa.un.sun_path, "/run/systemd/journal/socket"))
+                        assert_se(setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,
+                                             &(struct timeval) { .tv_usec = 1000 }, sizeof(struct timeval)) >= 0);
+        }
+}
+
+static void test_log_queue_journal(void) {
+        _cleanup_(unlink_tempfilep) char kmsg[] = "/tmp/test-log-kmsg.XXXXXX";
+        _cleanup_close_ int kmsg_fd = -1;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        if (geteuid() != 0) {
+                log_info("Not root, skipping.");
+                return;
+        }
+
+        assert_se((kmsg_fd = mkostemp_safe(kmsg)) >= 0);
+
+        r = safe_fork("(log-queue)", FORK_DEATHSIG|FORK_LOG|FORK_WAIT|FORK_NEW_MOUNTNS|FORK_MOUNTNS_SLAVE, NULL);
+        assert_se(r >= 0);
+        if (r == 0) {
+                union sockaddr_union sa = {
+                        .un.sun_family = AF_UNIX,
+                        .un.sun_path = "/run/systemd/journal/socket",
+                };
+                _cleanup_close_ int fd = -1;
+                unsigned i, next;
+                size_t offset = 0;
+
+                /* Set up a fake journal socket and /dev/kmsg in our own mount namespace */
+                assert_se(mkdir_p("/run/systemd/journal", 0755) >= 0);
+                assert_se(mount("tmpfs", "/run/systemd/journal", "tmpfs", 0, NULL) >= 0);
+                assert_se(mount(kmsg, "/dev/kmsg", NULL, MS_BIND, NULL) >= 0);
+
+                assert_se((fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0)) >= 0);
+                assert_se(bind(fd, &sa.sa, SOCKADDR_UN_LEN(sa.un)) >= 0);
+
+                log_set_target(LOG_TARGET_JOURNAL_OR_KMSG);
+                log_set_max_level(LOG_DEBUG);
+                assert_se(log_open() >= 0);
+                shorten_journal_send_timeout();
+
+                assert_se(log_queue_enable(4) >= 0);
+
+                /* Queued messages carry the time they were logged at, and are sent before an error, which
+                 * itself is sent right away */
+                for (i = 0; i < 3; i++)
+                        log_info("Message %u", i);
+                assert_se(read_journal(fd, 0, UINT_MAX, true) == 0);
+
+                log_error("Message %u", i++);
+                assert_se(read_journal(fd, 0, 3, true) == 3);
+                assert_se(read_journal(fd, 3, UINT_MAX, false) == 4);
+                assert_se(log_queue_get_dropped() == 0);
+
+                /* More messages than the socket takes without us reading. The ones that neither fit into the
+                 * socket nor into the queue go to kmsg instead and are counted. */
+                for (; i < 200; i++)
+                        log_info("Message %u", i);
+
+                next = read_journal(fd, 4, UINT_MAX, true);
+                assert_se(log_queue_flush() >= 0);
+                next = read_journal(fd, next, UINT_MAX, true);
+                assert_se(next < 200);
+
+                assert_se(read_kmsg(kmsg, &offset, next) == 200);
+                assert_se(log_queue_get_dropped() == 200 - next);
+
+                /* Once the journal is gone, what is queued goes to kmsg, in order, and is not counted */
+                for (i = 0; i < 3; i++)
+                        log_info("Message %u", i);
+                fd = safe_close(fd);
+                assert_se(log_queue_flush() < 0);
+                assert_se(read_kmsg(kmsg, &offset, 0) == 3);
+                assert_se(log_queue_get_dropped() == 200 - next);
+
+                log_queue_disable();
+                _exit(EXIT_SUCCESS);
+        }
+}
+
 int main(int argc, char* argv[]) {
         int target;
 
@@ -68,9 +252,12 @@ int main(int argc, char* argv[]) {
 
                 test_log_struct();
                 test_long_lines();
+                test_log_queue();
         }
 
         assert_se(log_info_errno(SYNTHETIC_ERRNO(EUCLEAN), "foo") == -EUCLEAN);
 
+        test_log_queue_journal();
+
         return 0;
 }
@@ -1,13 +1,20 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sys/mount.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
 #include "alloc-util.h"
 #include "fd-util.h"
+#include "fileio.h"
+#include "mkdir.h"
 #include "namespace.h"
+#include "path-util.h"
 #include "process-util.h"
+#include "rm-rf.h"
 #include "string-util.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 #include "util.h"
 
 static void test_tmpdir(const char *id, const char *A, const char *B) {
@@ -104,6 +111,53 @@ static int test_netns(void) {
         return EXIT_SUCCESS;
 }
 
+static void test_shared_root_image(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_free_ char *path = NULL, *expected = NULL;
+        const char *image, *replacement, *shared;
+        struct stat st;
+
+        log_info("/* %s */", __func__);
+
+        if (geteuid() > 0) {
+                log_info("Not root, skipping.");
+                return;
+        }
+
+        assert_se(mkdtemp_malloc("/tmp/test-namespace-XXXXXX", &t) >= 0);
+        image = strjoina(t, "/image.raw");
+        shared = strjoina(t, "/shared");
+
+        assert_se(write_string_file(image, "not an image", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(stat(image, &st) >= 0);
+
+        /* Pretend the process of another unit mounted the image already, which we must reuse then */
+        assert_se(asprintf(&expected, "%s/ro-%" PRIx64 "-%" PRIx64 "-%" PRIx64, shared,
+                           (uint64_t) st.st_dev, (uint64_t) st.st_ino, (uint64_t) timespec_load_nsec(&st.st_mtim)) >= 0);
+        assert_se(mkdir_p(expected, 0700) >= 0);
+        if (mount("tmpfs", expected, "tmpfs", 0, NULL) < 0) {
+                log_info_errno(errno, "Failed to mount tmpfs, skipping: %m");
+                return;
+        }
+
+        assert_se(setup_shared_root_image(image, shared, DISSECT_IMAGE_READ_ONLY, &path) == 0);
+        assert_se(path_equal(path, expected));
+        path = mfree(path);
+
+        /* A writable mount of the same image is a different one, and it's not an image we can set up */
+        assert_se(setup_shared_root_image(image, shared, 0, &path) < 0);
+        assert_se(!path);
+
+        /* Once the image file is replaced, it is set up anew, rather than reusing the old mount */
+        replacement = strjoina(t, "/image.raw.new");
+        assert_se(write_string_file(replacement, "still not an image", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(rename(replacement, image) >= 0);
+        assert_se(setup_shared_root_image(image, shared, DISSECT_IMAGE_READ_ONLY, &path) < 0);
+        assert_se(!path);
+
+        assert_se(umount(expected) >= 0);
+}
+
 int main(int argc, char *argv[]) {
         sd_id128_t bid;
         char boot_id[SD_ID128_STRING_MAX];
@@ -132,5 +186,7 @@ int main(int argc, char *argv[]) {
 
         test_tmpdir("sys-devices-pci0000:00-0000:00:1a.0-usb3-3\\x2d1-3\\x2d1:1.0-bluetooth-hci0.device", z, zz);
 
+        test_shared_root_image();
+
         return test_netns();
 }
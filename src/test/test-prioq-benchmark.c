@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc-util.h"
+#include "log.h"
+#include "parse-util.h"
+#include "prioq.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Times filling a queue one by one and in bulk, changing the priority of random items, as sd-event does for timers,
+ * and draining the queue, both with a compare function and with keys stored in the queue. Prints the average time
+ * per operation. Pass the largest queue size to try as the first argument, by default it is 10^6, or 10^7 with slow
+ * tests enabled. */
+
+typedef struct Item {
+        uint64_t value;
+        unsigned idx;
+} Item;
+
+static int item_compare(const Item *x, const Item *y) {
+        return CMP(x->value, y->value);
+}
+
+static double nsec_per_op(usec_t start, unsigned n) {
+        return (double) (now(CLOCK_MONOTONIC) - start) * NSEC_PER_USEC / n;
+}
+
+static void benchmark(Item *items, void **data, unsigned **idx, uint64_t *keys, unsigned n, bool keyed) {
+        _cleanup_(prioq_freep) Prioq *q = NULL;
+        double put, put_many, reshuffle, pop;
+        uint64_t previous = 0;
+        unsigned k;
+        usec_t t;
+
+        assert_se(q = prioq_new(keyed ? NULL : (compare_func_t) item_compare));
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n; k++)
+                assert_se(prioq_put_key(q, items + k, &items[k].idx, items[k].value) >= 0);
+        put = nsec_per_op(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n; k++) {
+                Item *i = items + (unsigned) rand() % n;
+
+                i->value += (unsigned) rand() % 1000000U;
+                if (keyed)
+                        assert_se(prioq_reshuffle_key(q, i, &i->idx, i->value) == 1);
+                else
+                        assert_se(prioq_reshuffle(q, i, &i->idx) == 1);
+        }
+        reshuffle = nsec_per_op(t, n);
+
+        t = now(CLOCK_MONOTONIC);
+        for (k = 0; k < n; k++) {
+                Item *i;
+
+                assert_se(i = prioq_pop(q));
+                assert_se(i->value >= previous);
+                previous = i->value;
+        }
+        pop = nsec_per_op(t, n);
+
+        for (k = 0; k < n; k++)
+                keys[k] = items[k].value;
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(prioq_put_many(q, data, idx, keys, n) >= 0);
+        put_many = nsec_per_op(t, n);
+
+        assert_se(prioq_size(q) == n);
+
+        printf("%-7s %8u: put %6.1f ns, put_many %6.1f ns, reshuffle %6.1f ns, pop %6.1f ns\n",
+               keyed ? "key" : "compare", n, put, put_many, reshuffle, pop);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_free_ Item *items = NULL;
+        _cleanup_free_ unsigned **idx = NULL;
+        _cleanup_free_ uint64_t *keys = NULL;
+        _cleanup_free_ void **data = NULL;
+        unsigned n_max, n, k;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n_max) >= 0);
+        else
+                n_max = slow_tests_enabled() ? 10000000U : 1000000U;
+
+        assert_se(items = new(Item, n_max));
+        assert_se(data = new(void*, n_max));
+        assert_se(idx = new(unsigned*, n_max));
+        assert_se(keys = new(uint64_t, n_max));
+
+        for (k = 0; k < n_max; k++) {
+                data[k] = items + k;
+                idx[k] = &items[k].idx;
+        }
+
+        for (n = 1000; n <= n_max; n *= 10) {
+                srand(0);
+                for (k = 0; k < n; k++)
+                        items[k].value = (unsigned) rand();
+                benchmark(items, data, idx, keys, n, false);
+
+                srand(0);
+                for (k = 0; k < n; k++)
+                        items[k].value = (unsigned) rand();
+                benchmark(items, data, idx, keys, n, true);
+        }
+
+        return 0;
+}
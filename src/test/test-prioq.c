@@ -103,10 +103,89 @@ static void test_struct(void) {
         assert_se(set_isempty(s));
 }
 
+static void test_key(void) {
+        _cleanup_(prioq_freep) Prioq *q = NULL;
+        _cleanup_free_ struct test *t = NULL;
+        unsigned previous = 0, i;
+
+        srand(0);
+
+        assert_se(q = prioq_new(NULL));
+        assert_se(t = new0(struct test, SET_SIZE));
+
+        for (i = 0; i < SET_SIZE; i++) {
+                t[i].value = (unsigned) rand();
+                assert_se(prioq_put_key(q, t + i, &t[i].idx, t[i].value) >= 0);
+        }
+
+        /* Move some items up and some down */
+        for (i = 0; i < SET_SIZE; i += 3) {
+                t[i].value = i % 2 ? t[i].value / 2 : t[i].value / 2 + UINT_MAX / 2;
+                assert_se(prioq_reshuffle_key(q, t + i, &t[i].idx, t[i].value) == 1);
+        }
+
+        for (i = 0; i < SET_SIZE; i++) {
+                struct test *x;
+
+                assert_se(x = prioq_pop(q));
+                assert_se(previous <= x->value);
+                assert_se(prioq_reshuffle_key(q, x, &x->idx, 0) == 0);
+
+                previous = x->value;
+        }
+
+        assert_se(prioq_isempty(q));
+}
+
+static void test_put_many(void) {
+        _cleanup_(prioq_freep) Prioq *q = NULL;
+        _cleanup_free_ struct test *t = NULL;
+        _cleanup_free_ unsigned **idx = NULL;
+        _cleanup_free_ void **data = NULL;
+        unsigned previous = 0, i;
+
+        srand(0);
+
+        assert_se(q = prioq_new((compare_func_t) test_compare));
+        assert_se(t = new0(struct test, SET_SIZE));
+        assert_se(data = new(void*, SET_SIZE));
+        assert_se(idx = new(unsigned*, SET_SIZE));
+
+        for (i = 0; i < SET_SIZE; i++) {
+                t[i].value = (unsigned) rand();
+                data[i] = t + i;
+                idx[i] = &t[i].idx;
+        }
+
+        /* A large batch into an empty queue, then a few more into the filled queue */
+        assert_se(prioq_put_many(q, data, idx, NULL, SET_SIZE - 10) >= 0);
+        assert_se(prioq_put_many(q, data + SET_SIZE - 10, idx + SET_SIZE - 10, NULL, 10) >= 0);
+        assert_se(prioq_size(q) == SET_SIZE);
+
+        for (i = 0; i < SET_SIZE; i++)
+                assert_se(t[i].idx < SET_SIZE);
+
+        for (i = 0; i < SET_SIZE; i += 2)
+                assert_se(prioq_remove(q, t + i, &t[i].idx) == 1);
+
+        for (i = 0; i < SET_SIZE / 2; i++) {
+                struct test *x;
+
+                assert_se(x = prioq_pop(q));
+                assert_se(previous <= x->value);
+
+                previous = x->value;
+        }
+
+        assert_se(prioq_isempty(q));
+}
+
 int main(int argc, char* argv[]) {
 
         test_unsigned();
         test_struct();
+        test_key();
+        test_put_many();
 
         return 0;
 }
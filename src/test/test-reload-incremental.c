@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "fileio.h"
+#include "fs-util.h"
+#include "manager.h"
+#include "mkdir.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "test-helper.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+#include "user-util.h"
+
+static usec_t stamp = 0;
+
+static void write_unit(const char *dir, const char *name, const char *contents) {
+        _cleanup_free_ char *p = NULL;
+
+        assert_se(p = path_join(dir, name));
+        assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+
+        /* Make sure the change is noticed even if it happens within the timestamp granularity */
+        stamp += USEC_PER_SEC;
+        assert_se(touch_file(p, false, stamp, UID_INVALID, GID_INVALID, MODE_INVALID) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *unit_dir = NULL;
+        _cleanup_free_ char *vendor = NULL, *admin = NULL, *search = NULL, *p = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        Unit *a, *b, *c, *d, *t;
+        int r;
+
+        test_setup_logging(LOG_DEBUG);
+
+        r = enter_cgroup_subroot();
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        assert_se(mkdtemp_malloc("/tmp/test-reload-incremental-XXXXXX", &unit_dir) >= 0);
+        assert_se(admin = path_join(unit_dir, "admin"));
+        assert_se(vendor = path_join(unit_dir, "vendor"));
+        assert_se(mkdir(admin, 0755) >= 0);
+        assert_se(mkdir(vendor, 0755) >= 0);
+        assert_se(search = strjoin(admin, ":", vendor));
+
+        stamp = now(CLOCK_REALTIME);
+
+        write_unit(vendor, "a.service", "[Unit]\nDescription=A\n[Service]\nExecStart=/bin/true\n");
+        write_unit(vendor, "b.service", "[Unit]\nDescription=B\nAfter=a.service\nWants=d.service\n[Service]\nExecStart=/bin/true\n");
+        write_unit(vendor, "c.service", "[Service]\nExecStart=/bin/true\n");
+        write_unit(vendor, "t.target", "[Unit]\nDescription=T\n");
+
+        assert_se(set_unit_path(search) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (MANAGER_SKIP_TEST(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        assert_se(manager_load_unit(m, "b.service", NULL, NULL, &b) >= 0);
+        assert_se(manager_load_unit(m, "c.service", NULL, NULL, &c) >= 0);
+        assert_se(manager_load_unit(m, "t.target", NULL, NULL, &t) >= 0);
+        assert_se(a = manager_get_unit(m, "a.service"));
+        assert_se(d = manager_get_unit(m, "d.service"));
+        assert_se(d->load_state == UNIT_NOT_FOUND);
+        assert_se(unit_has_dependency(b, UNIT_AFTER, a));
+
+        /* A dependency that is not backed by any file: it is lost if b.service is ever reloaded */
+        assert_se(unit_add_dependency(b, UNIT_WANTS, c, false, UNIT_DEPENDENCY_UDEV) >= 0);
+
+        log_info("/* nothing changed */");
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(m->objective == MANAGER_OK);
+        assert_se(manager_get_unit(m, "a.service") == a);
+        assert_se(manager_get_unit(m, "t.target") == t);
+
+        log_info("/* unit file changed */");
+        write_unit(vendor, "a.service", "[Unit]\nDescription=Changed A\n[Service]\nExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(a = manager_get_unit(m, "a.service"));
+        assert_se(streq(a->description, "Changed A"));
+        assert_se(manager_get_unit(m, "b.service") == b);
+        assert_se(unit_has_dependency(b, UNIT_WANTS, c));
+        assert_se(unit_has_dependency(b, UNIT_AFTER, a));
+        assert_se(unit_has_dependency(a, UNIT_BEFORE, b));
+
+        log_info("/* .wants/ symlink added */");
+        assert_se(p = path_join(vendor, "t.target.wants/b.service"));
+        assert_se(mkdir_parents(p, 0755) >= 0);
+        assert_se(symlink("../b.service", p) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(t = manager_get_unit(m, "t.target"));
+        assert_se(unit_has_dependency(t, UNIT_WANTS, b));
+        assert_se(unit_has_dependency(b, UNIT_WANTED_BY, t));
+        assert_se(unit_has_dependency(b, UNIT_WANTS, c));
+
+        log_info("/* .wants/ symlink removed */");
+        assert_se(unlink(p) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(t = manager_get_unit(m, "t.target"));
+        assert_se(!unit_has_dependency(t, UNIT_WANTS, b));
+        assert_se(!unit_has_dependency(b, UNIT_WANTED_BY, t));
+
+        log_info("/* unit masked */");
+        p = mfree(p);
+        assert_se(p = path_join(admin, "a.service"));
+        assert_se(symlink("/dev/null", p) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(a = manager_get_unit(m, "a.service"));
+        assert_se(a->load_state == UNIT_MASKED);
+        assert_se(unit_has_dependency(b, UNIT_AFTER, a));
+        assert_se(manager_get_unit(m, "b.service") == b);
+
+        log_info("/* unit unmasked */");
+        assert_se(unlink(p) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(a = manager_get_unit(m, "a.service"));
+        assert_se(a->load_state == UNIT_LOADED);
+        assert_se(streq(a->description, "Changed A"));
+
+        log_info("/* missing unit installed */");
+        write_unit(vendor, "d.service", "[Unit]\nDescription=D\n[Service]\nExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(d = manager_get_unit(m, "d.service"));
+        assert_se(d->load_state == UNIT_LOADED);
+        assert_se(unit_has_dependency(b, UNIT_WANTS, d));
+        assert_se(unit_has_dependency(d, UNIT_WANTED_BY, b));
+        assert_se(manager_get_unit(m, "b.service") == b);
+
+        return 0;
+}
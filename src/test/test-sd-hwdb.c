@@ -2,7 +2,9 @@
 
 #include "alloc-util.h"
 #include "errno.h"
+#include "strv.h"
 #include "tests.h"
+#include "time-util.h"
 
 static int test_failed_enumerate(void) {
         _cleanup_(sd_hwdb_unrefp) sd_hwdb *hwdb = NULL;
@@ -59,6 +61,130 @@ static void test_basic_enumerate(void) {
         assert_se(len1 == len2);
 }
 
+static void test_get_keeps_enumeration(void) {
+        _cleanup_(sd_hwdb_unrefp) sd_hwdb *hwdb = NULL;
+        _cleanup_strv_free_ char **properties = NULL;
+        const char *key, *value, *first_key = NULL;
+        unsigned n = 0;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_hwdb_new(&hwdb) == 0);
+
+        SD_HWDB_FOREACH_PROPERTY(hwdb, DELL_MODALIAS, key, value)
+                assert_se(strv_extend(&properties, key) >= 0);
+
+        /* Looking up single keys in between doesn't affect what sd_hwdb_seek() found */
+        assert_se(sd_hwdb_seek(hwdb, DELL_MODALIAS) == 0);
+
+        for (;;) {
+                r = sd_hwdb_enumerate(hwdb, &key, &value);
+                assert_se(IN_SET(r, 0, 1));
+                if (r == 0)
+                        break;
+
+                assert_se(streq_ptr(properties[n], key));
+                n++;
+
+                if (!first_key)
+                        first_key = key;
+
+                assert_se(sd_hwdb_get(hwdb, DELL_MODALIAS, first_key, &value) == 0);
+                assert_se(sd_hwdb_get(hwdb, "no-such-modalias-should-exist", first_key, &value) == -ENOENT);
+        }
+
+        assert_se(n == strv_length(properties));
+}
+
+/* a mix of lookups hitting literal and glob-bearing nodes, as done by the hwdb builtin during coldplug */
+static char **lookups = STRV_MAKE(
+        DELL_MODALIAS,
+        "usb:v1D6Bp0002d0419dc09dsc00dp03ic09isc00ip00in00",
+        "usb:v046DpC52Bd1211dc00dsc00dp00ic03isc01ip01in00",
+        "pci:v00008086d00001C3Asv00001028sd000004AAbc07sc80i00",
+        "input:b0003v046Dp4024e0111-e0,1,2,3,4,k71,72,73,r0,1,6,8,a20,m4,l0,1,2,3,4,sfw",
+        "acpi:PNP0C0A:",
+        "no-such-modalias-should-exist");
+
+static void test_get_many(void) {
+        _cleanup_(sd_hwdb_unrefp) sd_hwdb *hwdb = NULL;
+        const char *values[strv_length(lookups)];
+        char **m;
+        size_t i = 0;
+        int n = 0;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_hwdb_new(&hwdb) == 0);
+
+        STRV_FOREACH(m, lookups) {
+                _cleanup_strv_free_ char **properties = NULL;
+                const char *key, *value;
+                char **k, **v;
+
+                /* every property the full lookup finds has to be found by a lookup of the key alone */
+                SD_HWDB_FOREACH_PROPERTY(hwdb, *m, key, value) {
+                        assert_se(strv_extend(&properties, key) >= 0);
+                        assert_se(strv_extend(&properties, value) >= 0);
+                }
+
+                STRV_FOREACH_PAIR(k, v, properties) {
+                        assert_se(sd_hwdb_get(hwdb, *m, *k, &value) == 0);
+                        assert_se(streq(value, *v));
+                }
+        }
+
+        assert_se(sd_hwdb_get_many(hwdb, lookups, "ID_VENDOR_FROM_DATABASE", values) >= 0);
+
+        STRV_FOREACH(m, lookups) {
+                const char *v;
+
+                if (sd_hwdb_get(hwdb, *m, "ID_VENDOR_FROM_DATABASE", &v) >= 0) {
+                        log_debug("%s → %s", *m, v);
+                        assert_se(streq_ptr(values[i], v));
+                        n++;
+                } else
+                        assert_se(!values[i]);
+                i++;
+        }
+
+        assert_se(sd_hwdb_get_many(hwdb, lookups, "ID_VENDOR_FROM_DATABASE", values) == n);
+}
+
+static void test_benchmark(void) {
+        _cleanup_(sd_hwdb_unrefp) sd_hwdb *hwdb = NULL;
+        const char *values[strv_length(lookups)];
+        char b[FORMAT_TIMESPAN_MAX];
+        unsigned i, n_rounds = slow_tests_enabled() ? 10000 : 100;
+        usec_t ts;
+        char **m;
+
+        log_info("/* %s (%u rounds) */", __func__, n_rounds);
+
+        assert_se(sd_hwdb_new(&hwdb) == 0);
+
+        ts = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n_rounds; i++)
+                STRV_FOREACH(m, lookups)
+                        assert_se(sd_hwdb_seek(hwdb, *m) == 0);
+        log_info("sd_hwdb_seek(): %s", format_timespan(b, sizeof b, now(CLOCK_MONOTONIC) - ts, 1));
+
+        ts = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n_rounds; i++)
+                STRV_FOREACH(m, lookups) {
+                        const char *v;
+
+                        (void) sd_hwdb_get(hwdb, *m, "ID_VENDOR_FROM_DATABASE", &v);
+                }
+        log_info("sd_hwdb_get(): %s", format_timespan(b, sizeof b, now(CLOCK_MONOTONIC) - ts, 1));
+
+        ts = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n_rounds; i++)
+                assert_se(sd_hwdb_get_many(hwdb, lookups, "ID_VENDOR_FROM_DATABASE", values) >= 0);
+        log_info("sd_hwdb_get_many(): %s", format_timespan(b, sizeof b, now(CLOCK_MONOTONIC) - ts, 1));
+}
+
 int main(int argc, char *argv[]) {
         int r;
 
@@ -69,6 +195,9 @@ int main(int argc, char *argv[]) {
                 return log_tests_skipped_errno(r, "cannot open hwdb");
 
         test_basic_enumerate();
+        test_get_keeps_enumeration();
+        test_get_many();
+        test_benchmark();
 
         return 0;
 }
@@ -693,6 +693,80 @@ static void test_load_syscall_filter_set_raw(void) {
         assert_se(wait_for_terminate_and_check("syscallrawseccomp", pid, WAIT_LOG) == EXIT_SUCCESS);
 }
 
+static void test_compile_syscall_filter_set_raw(void) {
+        _cleanup_(seccomp_program_freep) SeccompProgram *none = NULL, *p = NULL, *q = NULL;
+        _cleanup_hashmap_free_ Hashmap *s = NULL;
+        pid_t pid;
+
+        log_info("/* %s */", __func__);
+
+        if (!is_seccomp_available()) {
+                log_notice("Seccomp not available, skipping %s", __func__);
+                return;
+        }
+        if (geteuid() != 0) {
+                log_notice("Not root, skipping %s", __func__);
+                return;
+        }
+
+        /* Nothing to filter, nothing to install */
+        assert_se(seccomp_compile_syscall_filter_set_raw(SCMP_ACT_ALLOW, NULL, SCMP_ACT_KILL, true, &none) >= 0);
+        assert_se(!none);
+        assert_se(seccomp_program_load(none) >= 0);
+
+        assert_se(s = hashmap_new(NULL));
+#if SCMP_SYS(access) >= 0
+        assert_se(hashmap_put(s, UINT32_TO_PTR(__NR_access + 1), INT_TO_PTR(-1)) >= 0);
+#else
+        assert_se(hashmap_put(s, UINT32_TO_PTR(__NR_faccessat + 1), INT_TO_PTR(-1)) >= 0);
+#endif
+        assert_se(seccomp_compile_syscall_filter_set_raw(SCMP_ACT_ALLOW, s, SCMP_ACT_ERRNO(EUCLEAN), true, &p) >= 0);
+        assert_se(p);
+
+        s = hashmap_free(s);
+
+        assert_se(s = hashmap_new(NULL));
+#if SCMP_SYS(poll) >= 0
+        assert_se(hashmap_put(s, UINT32_TO_PTR(__NR_poll + 1), INT_TO_PTR(EILSEQ)) >= 0);
+#else
+        assert_se(hashmap_put(s, UINT32_TO_PTR(__NR_ppoll + 1), INT_TO_PTR(EILSEQ)) >= 0);
+#endif
+        assert_se(seccomp_compile_syscall_filter_set_raw(SCMP_ACT_ALLOW, s, SCMP_ACT_ERRNO(EUNATCH), true, &q) >= 0);
+        assert_se(q);
+
+        /* Compiling doesn't install anything */
+        assert_se(access("/", F_OK) >= 0);
+        assert_se(poll(NULL, 0, 0) == 0);
+
+        pid = fork();
+        assert_se(pid >= 0);
+
+        if (pid == 0) {
+                assert_se(seccomp_program_load(p) >= 0);
+
+                assert_se(access("/", F_OK) < 0);
+                assert_se(errno == EUCLEAN);
+                assert_se(poll(NULL, 0, 0) == 0);
+
+                /* Programs may be installed any number of times, and stack like the ones libseccomp loads */
+                assert_se(seccomp_program_load(p) >= 0);
+                assert_se(seccomp_program_load(q) >= 0);
+
+                assert_se(access("/", F_OK) < 0);
+                assert_se(errno == EUCLEAN);
+                assert_se(poll(NULL, 0, 0) < 0);
+                assert_se(errno == EILSEQ);
+
+                _exit(EXIT_SUCCESS);
+        }
+
+        assert_se(wait_for_terminate_and_check("syscallcompiledseccomp", pid, WAIT_LOG) == EXIT_SUCCESS);
+
+        /* Still nothing installed here */
+        assert_se(access("/", F_OK) >= 0);
+        assert_se(poll(NULL, 0, 0) == 0);
+}
+
 static void test_lock_personality(void) {
         unsigned long current;
         pid_t pid;
@@ -762,6 +836,7 @@ int main(int argc, char *argv[]) {
         test_memory_deny_write_execute_shmat();
         test_restrict_archs();
         test_load_syscall_filter_set_raw();
+        test_compile_syscall_filter_set_raw();
         test_lock_personality();
 
         return 0;
@@ -45,6 +45,26 @@ static void do_test(const uint8_t *in, size_t len, const uint8_t *key) {
         }
 }
 
+static void test_siphash13(const uint8_t *in, size_t len, const uint8_t *key) {
+        struct siphash state = {};
+        uint64_t out;
+        unsigned i, j;
+
+        out = siphash13(in, len, key);
+        assert_se(out == 0xd320d86d2a519956);
+
+        for (i = 0; i < len; i++) {
+                for (j = i; j < len; j++) {
+                        siphash13_init(&state, key);
+                        siphash24_compress(in, i, &state);
+                        siphash24_compress(&in[i], j - i, &state);
+                        siphash24_compress(&in[j], len - j, &state);
+                        out = siphash24_finalize(&state);
+                        assert_se(out == 0xd320d86d2a519956);
+                }
+        }
+}
+
 static void test_short_hashes(void) {
         const uint8_t one[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
                                 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16 };
@@ -103,5 +123,7 @@ int main(int argc, char *argv[]) {
         memcpy(in_buf + 4, in, sizeof(in));
         do_test(in_buf + 4, sizeof(in), key);
 
+        test_siphash13(in, sizeof(in), key);
+
         test_short_hashes();
 }
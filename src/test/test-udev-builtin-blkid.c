@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <linux/loop.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-device.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "loop-util.h"
+#include "mkdir.h"
+#include "process-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+#include "udev-builtin.h"
+
+static void probe(dev_t devnum, const char *expected_type) {
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        const char *type;
+
+        /* A new device object each time, so that no properties are left over from the last run */
+        assert_se(sd_device_new_from_devnum(&dev, 'b', devnum) >= 0);
+        assert_se(udev_builtin_run(dev, UDEV_BUILTIN_BLKID, "blkid", false) >= 0);
+
+        if (expected_type) {
+                assert_se(sd_device_get_property_value(dev, "ID_FS_TYPE", &type) >= 0);
+                assert_se(streq(type, expected_type));
+        } else
+                assert_se(sd_device_get_property_value(dev, "ID_FS_TYPE", &type) == -ENOENT);
+}
+
+static void fake_entry(const char *path) {
+        _cleanup_free_ char *key = NULL, *contents = NULL;
+
+        /* Keep the key, so that the entry is used as long as the device looks the same */
+        assert_se(read_one_line_file(path, &key) >= 0);
+        assert_se(contents = strjoin(key, "\nTYPE=fake\n"));
+        assert_se(write_string_file(path, contents, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC|WRITE_STRING_FILE_AVOID_NEWLINE) >= 0);
+}
+
+static void test_blkid_cache(void) {
+        _cleanup_(loop_device_unrefp) LoopDevice *d = NULL;
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        _cleanup_free_ char *key = NULL, *new_key = NULL, *path = NULL;
+        _cleanup_close_ int fd = -1;
+        char tmp[] = "/var/tmp/test-udev-builtin-blkid-XXXXXX";
+        struct stat st;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        fd = mkostemp_safe(tmp);
+        assert_se(fd >= 0);
+        (void) unlink(tmp);
+        assert_se(ftruncate(fd, 16 * 1024 * 1024) >= 0);
+
+        r = loop_device_make(fd, O_RDWR, &d);
+        if (r < 0) {
+                log_notice_errno(r, "Failed to set up loop device, skipping %s: %m", __func__);
+                return;
+        }
+
+        assert_se(fstat(d->fd, &st) >= 0);
+        assert_se(asprintf(&path, "/run/udev/blkid/b%u:%u", major(st.st_rdev), minor(st.st_rdev)) >= 0);
+
+        /* The first run probes and stores the result, a later one with the same key uses it */
+        probe(st.st_rdev, NULL);
+        assert_se(read_one_line_file(path, &key) >= 0);
+
+        fake_entry(path);
+        probe(st.st_rdev, "fake");
+
+        /* A device of a different size is probed again */
+        assert_se(ftruncate(fd, 32 * 1024 * 1024) >= 0);
+        assert_se(ioctl(d->fd, LOOP_SET_CAPACITY, 0) >= 0);
+        probe(st.st_rdev, NULL);
+        assert_se(read_one_line_file(path, &new_key) >= 0);
+        assert_se(!streq(key, new_key));
+
+        /* … as is one whose entry was dropped, e.g. because it was written to */
+        fake_entry(path);
+        probe(st.st_rdev, "fake");
+
+        assert_se(sd_device_new_from_devnum(&dev, 'b', st.st_rdev) >= 0);
+        assert_se(udev_builtin_blkid_cache_remove(dev) >= 0);
+        assert_se(access(path, F_OK) < 0 && errno == ENOENT);
+        probe(st.st_rdev, NULL);
+}
+
+int main(int argc, char *argv[]) {
+        int r;
+
+        test_setup_logging(LOG_DEBUG);
+
+        if (geteuid() != 0)
+                return log_tests_skipped("not root");
+
+        /* Keep the cache entries in our own mount namespace */
+        r = safe_fork("(blkid-cache)", FORK_DEATHSIG|FORK_LOG|FORK_WAIT|FORK_NEW_MOUNTNS|FORK_MOUNTNS_SLAVE, NULL);
+        assert_se(r >= 0);
+        if (r == 0) {
+                assert_se(mkdir_p("/run/udev", 0755) >= 0);
+                assert_se(mount("tmpfs", "/run/udev", "tmpfs", 0, NULL) >= 0);
+
+                test_blkid_cache();
+                _exit(EXIT_SUCCESS);
+        }
+
+        return 0;
+}
@@ -7,6 +7,7 @@
 
 #include "alloc-util.h"
 #include "all-units.h"
+#include "fs-util.h"
 #include "glob-util.h"
 #include "hostname-util.h"
 #include "macro.h"
@@ -18,6 +19,7 @@
 #include "string-util.h"
 #include "test-helper.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 #include "unit-def.h"
 #include "unit-name.h"
 #include "unit-printf.h"
@@ -811,6 +813,44 @@ static void test_unit_name_from_dbus_path(void) {
         test_unit_name_from_dbus_path_one("/org/freedesktop/systemd1/unit/wpa_5fsupplicant_2eservice", 0, "wpa_supplicant.service");
 }
 
+static void test_unit_active_state_export(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_free_ char *s = NULL;
+        UnitActiveState state;
+        const char *p;
+
+        puts("-------------------------------------------------");
+
+        assert_se(mkdtemp_malloc(NULL, &t) >= 0);
+
+        assert_se(unit_active_state_read_exported(t, "foo.service", &state) == -ENOENT);
+
+        assert_se(unit_active_state_export(t, "foo.service", UNIT_ACTIVATING) >= 0);
+        assert_se(unit_active_state_read_exported(t, "foo.service", &state) >= 0);
+        assert_se(state == UNIT_ACTIVATING);
+
+        /* The link is replaced in place, and points to the plain state string */
+        assert_se(unit_active_state_export(t, "foo.service", UNIT_FAILED) >= 0);
+        assert_se(unit_active_state_read_exported(t, "foo.service", &state) >= 0);
+        assert_se(state == UNIT_FAILED);
+        p = strjoina(t, "/active-state:foo.service");
+        assert_se(readlink_malloc(p, &s) >= 0);
+        assert_se(streq(s, "failed"));
+
+        assert_se(unit_active_state_export(t, "bar@a\\x2db.service", UNIT_ACTIVE) >= 0);
+        assert_se(unit_active_state_read_exported(t, "bar@a\\x2db.service", &state) >= 0);
+        assert_se(state == UNIT_ACTIVE);
+
+        /* Links we don't understand are refused, so that callers ask PID 1 instead */
+        p = strjoina(t, "/active-state:baz.service");
+        assert_se(symlink("maintenance", p) >= 0);
+        assert_se(unit_active_state_read_exported(t, "baz.service", &state) == -EBADMSG);
+
+        assert_se(unit_active_state_unexport(t, "foo.service") >= 0);
+        assert_se(unit_active_state_read_exported(t, "foo.service", &state) == -ENOENT);
+        assert_se(unit_active_state_unexport(t, "foo.service") == -ENOENT);
+}
+
 int main(int argc, char* argv[]) {
         _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL;
         int r, rc = 0;
@@ -843,6 +883,7 @@ int main(int argc, char* argv[]) {
         test_unit_name_path_unescape();
         test_unit_name_to_prefix();
         test_unit_name_from_dbus_path();
+        test_unit_active_state_export();
 
         return rc;
 }
@@ -2,9 +2,13 @@
 
 /* Some unit tests for the helper functions in timesyncd. */
 
+#include <math.h>
+
 #include "log.h"
 #include "macro.h"
 #include "timesyncd-conf.h"
+#include "timesyncd-select.h"
+#include "timesyncd-server.h"
 #include "tests.h"
 
 static void test_manager_parse_string(void) {
@@ -25,10 +29,83 @@ static void test_manager_parse_string(void) {
         assert_se(manager_parse_server_string(m, SERVER_LINK, "time1.foobar.com time2.foobar.com axrfav.,avf..ra 12345..123") == 0);
 }
 
+static void test_server_address_filter(void) {
+        _cleanup_(manager_freep) Manager *m = NULL;
+        union sockaddr_union sa = {
+                .in.sin_family = AF_INET,
+        };
+        ServerSample s;
+        ServerName *n;
+        ServerAddress *a;
+        double jitter;
+        usec_t t;
+
+        assert_se(manager_new(&m) == 0);
+        assert_se(server_name_new(m, &n, SERVER_SYSTEM, "192.0.2.1") == 0);
+        assert_se(server_address_new(n, &a, &sa, sizeof(sa.in)) == 0);
+
+        assert_se(server_address_filter(a, 0, &s, &jitter) == -ENODATA);
+
+        /* The sample with the lowest delay wins */
+        server_address_add_sample(a, 0.010, 0.050, 0.001, 1);
+        server_address_add_sample(a, 0.002, 0.020, 0.001, 2);
+        server_address_add_sample(a, 0.030, 0.090, 0.001, 3);
+        assert_se(server_address_filter(a, 0, &s, &jitter) == 0);
+        assert_se(s.offset == 0.002 && s.time == 2);
+        assert_se(jitter > 0);
+
+        /* … unless it was already used */
+        assert_se(server_address_filter(a, 2, &s, &jitter) == 0);
+        assert_se(s.time == 3);
+        assert_se(server_address_filter(a, 3, &s, &jitter) == -ENODATA);
+
+        /* Older samples are overwritten */
+        for (t = 10; t < 10 + NTP_FILTER_SAMPLES; t++)
+                server_address_add_sample(a, 0.1, 0.1, 0.001, t);
+        assert_se(a->n_samples == NTP_FILTER_SAMPLES);
+        assert_se(server_address_filter(a, 0, &s, &jitter) == 0);
+        assert_se(s.offset == 0.1 && jitter == 0);
+
+        server_address_flush_samples(a);
+        assert_se(server_address_filter(a, 0, &s, &jitter) == -ENODATA);
+}
+
+static void test_ntp_select(void) {
+        NtpCandidate c[5];
+        double offset, jitter;
+        size_t best;
+
+        assert_se(ntp_select(c, 0, &offset, &jitter, &best) == 0);
+
+        /* A single server is always believed */
+        c[0] = (NtpCandidate) { .offset = 1.5, .jitter = 0.001, .root_distance = 0.02 };
+        assert_se(ntp_select(c, 1, &offset, &jitter, &best) == 1);
+        assert_se(best == 0 && c[0].survivor);
+        assert_se(fabs(offset - 1.5) < 1e-9);
+
+        /* Two servers that disagree, nobody can tell which one is right */
+        c[1] = (NtpCandidate) { .offset = -3.0, .jitter = 0.001, .root_distance = 0.02 };
+        assert_se(ntp_select(c, 2, &offset, &jitter, &best) == 0);
+
+        /* Three agree, one is off, one has a huge root distance that still overlaps */
+        c[0] = (NtpCandidate) { .offset = 0.010, .jitter = 0.002, .root_distance = 0.030 };
+        c[1] = (NtpCandidate) { .offset = 0.012, .jitter = 0.002, .root_distance = 0.020 };
+        c[2] = (NtpCandidate) { .offset = 0.008, .jitter = 0.002, .root_distance = 0.040 };
+        c[3] = (NtpCandidate) { .offset = 5.000, .jitter = 0.002, .root_distance = 0.030 };
+        c[4] = (NtpCandidate) { .offset = 0.300, .jitter = 0.002, .root_distance = 1.000 };
+        assert_se(ntp_select(c, 5, &offset, &jitter, &best) == 3);
+        assert_se(c[0].survivor && c[1].survivor && c[2].survivor && !c[3].survivor && !c[4].survivor);
+        assert_se(best == 1);
+        assert_se(offset > 0.008 && offset < 0.012);
+        assert_se(jitter >= 0.002 && jitter < 0.01);
+}
+
 int main(int argc, char **argv) {
         test_setup_logging(LOG_DEBUG);
 
         test_manager_parse_string();
+        test_server_address_filter();
+        test_ntp_select();
 
         return 0;
 }
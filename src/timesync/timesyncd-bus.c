@@ -99,6 +99,55 @@ static int property_get_current_server_address(
         return sd_bus_message_close_container(reply);
 }
 
+static int property_get_peers(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+        ServerAddress *a;
+        int r;
+
+        assert(m);
+        assert(reply);
+
+        r = sd_bus_message_open_container(reply, 'a', "(siaytttt)");
+        if (r < 0)
+                return r;
+
+        LIST_FOREACH(peers, a, m->peers) {
+                assert(IN_SET(a->sockaddr.sa.sa_family, AF_INET, AF_INET6));
+
+                r = sd_bus_message_open_container(reply, 'r', "siaytttt");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "si", a->name->string, a->sockaddr.sa.sa_family);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append_array(reply, 'y',
+                                                a->sockaddr.sa.sa_family == AF_INET ? (void*) &a->sockaddr.in.sin_addr : (void*) &a->sockaddr.in6.sin6_addr,
+                                                FAMILY_ADDRESS_SIZE(a->sockaddr.sa.sa_family));
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "tttt", a->n_requests, a->n_replies, a->n_invalid, a->n_selected);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
 static usec_t ntp_ts_short_to_usec(const struct ntp_ts_short *ts) {
         return be16toh(ts->sec) * USEC_PER_SEC + (be16toh(ts->frac) * USEC_PER_SEC) / (usec_t) 0x10000ULL;
 }
@@ -167,6 +216,8 @@ static const sd_bus_vtable manager_vtable[] = {
         SD_BUS_PROPERTY("PollIntervalMinUSec", "t", bus_property_get_usec, offsetof(Manager, poll_interval_min_usec), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("PollIntervalMaxUSec", "t", bus_property_get_usec, offsetof(Manager, poll_interval_max_usec), SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("PollIntervalUSec", "t", bus_property_get_usec, offsetof(Manager, poll_interval_usec), 0),
+        SD_BUS_PROPERTY("PollServers", "u", bus_property_get_unsigned, offsetof(Manager, poll_servers), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("PolledServers", "a(siaytttt)", property_get_peers, 0, 0),
         SD_BUS_PROPERTY("NTPMessage", "(uuuuittayttttbtt)", property_get_ntp_message, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
         SD_BUS_PROPERTY("Frequency", "x", NULL, offsetof(Manager, drift_freq), 0),
 
@@ -120,5 +120,10 @@ int manager_parse_config_file(Manager *m) {
                 m->poll_interval_max_usec = MAX(NTP_POLL_INTERVAL_MAX_USEC, m->poll_interval_min_usec * 32);
         }
 
+        if (m->poll_servers < 1 || m->poll_servers > NTP_POLL_SERVERS_MAX) {
+                log_warning("PollServers= must be between 1 and %u. Using default value.", NTP_POLL_SERVERS_MAX);
+                m->poll_servers = 1;
+        }
+
         return r;
 }
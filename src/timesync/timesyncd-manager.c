@@ -30,6 +30,7 @@
 #include "time-util.h"
 #include "timesyncd-conf.h"
 #include "timesyncd-manager.h"
+#include "timesyncd-select.h"
 #include "util.h"
 
 #ifndef ADJ_SETOFFSET
@@ -58,10 +59,16 @@
 
 #define TIMEOUT_USEC (10*USEC_PER_SEC)
 
+/* How long to wait for the replies of all servers polled together */
+#define NTP_ROUND_USEC (2*USEC_PER_SEC)
+
 static int manager_arm_timer(Manager *m, usec_t next);
 static int manager_clock_watch_setup(Manager *m);
-static int manager_listen_setup(Manager *m);
-static void manager_listen_stop(Manager *m);
+static int manager_listen_setup(Manager *m, ServerAddress *a);
+static void manager_listen_stop(ServerAddress *a);
+static int manager_fill_peers(Manager *m);
+static int manager_check_round(Manager *m);
+static int manager_complete_round(Manager *m);
 
 static double ntp_ts_short_to_d(const struct ntp_ts_short *ts) {
         return be16toh(ts->sec) + (be16toh(ts->frac) / 65536.0);
@@ -89,8 +96,167 @@ static int manager_timeout(sd_event_source *source, usec_t usec, void *userdata)
         return manager_connect(m);
 }
 
-static int manager_send_request(Manager *m) {
+static void manager_add_peer(Manager *m, ServerAddress *a) {
+        ServerAddress *tail;
+
+        assert(m);
+        assert(a);
+
+        if (a->peer)
+                return;
+
+        a->peer = true;
+        a->pending = false;
+
+        if (a == m->current_server_address) {
+                a->missed_replies = NTP_MAX_MISSED_REPLIES;
+                LIST_PREPEND(peers, m->peers, a);
+        } else {
+                a->missed_replies = 0;
+                LIST_FIND_TAIL(peers, m->peers, tail);
+                LIST_INSERT_AFTER(peers, m->peers, tail, a);
+        }
+
+        m->n_peers++;
+}
+
+void manager_remove_peer(Manager *m, ServerAddress *a) {
+        assert(m);
+        assert(a);
+
+        if (!a->peer)
+                return;
+
+        manager_listen_stop(a);
+
+        LIST_REMOVE(peers, m->peers, a);
+        m->n_peers--;
+
+        a->peer = false;
+        a->pending = false;
+}
+
+static void manager_drop_peer(Manager *m, ServerAddress *a) {
         _cleanup_free_ char *pretty = NULL;
+
+        assert(m);
+        assert(a);
+        assert(a != m->current_server_address);
+
+        server_address_pretty(a, &pretty);
+        log_debug("Not polling %s (%s) any more.", strna(pretty), a->name->string);
+
+        /* Don't pick up another address of the same name right away, unless it is the current one */
+        if (a->name != m->current_server_name)
+                a->name->failed = true;
+
+        server_address_free(a);
+}
+
+static void manager_reset_failed(Manager *m) {
+        ServerName *n;
+
+        assert(m);
+
+        LIST_FOREACH(names, n, m->system_servers)
+                n->failed = false;
+        LIST_FOREACH(names, n, m->link_servers)
+                n->failed = false;
+        LIST_FOREACH(names, n, m->fallback_servers)
+                n->failed = false;
+}
+
+static int manager_peer_resolve_handler(sd_resolve_query *q, int ret, const struct addrinfo *ai, Manager *m) {
+        ServerName *n;
+        int r;
+
+        assert(q);
+        assert(m);
+        assert(m->peer_resolve_name);
+
+        n = TAKE_PTR(m->peer_resolve_name);
+        m->peer_resolve_query = sd_resolve_query_unref(m->peer_resolve_query);
+
+        if (ret != 0)
+                log_debug("Failed to resolve %s: %s", n->string, gai_strerror(ret));
+
+        for (; ai; ai = ai->ai_next) {
+                assert(ai->ai_addr);
+                assert(ai->ai_addrlen >= offsetof(struct sockaddr, sa_data));
+
+                if (!IN_SET(ai->ai_addr->sa_family, AF_INET, AF_INET6))
+                        continue;
+
+                r = server_address_new(n, NULL, (const union sockaddr_union*) ai->ai_addr, ai->ai_addrlen);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add server address: %m");
+        }
+
+        if (!n->addresses)
+                n->failed = true;
+
+        return manager_fill_peers(m);
+}
+
+static int manager_fill_peers(Manager *m) {
+        struct addrinfo hints = {
+                .ai_flags = AI_NUMERICSERV|AI_ADDRCONFIG,
+                .ai_socktype = SOCK_DGRAM,
+        };
+        ServerAddress *a;
+        ServerName *n;
+        int r;
+
+        assert(m);
+
+        if (!m->current_server_address)
+                return 0;
+
+        manager_add_peer(m, m->current_server_address);
+
+        /* Find more servers to poll: the other addresses of the current server first, then the servers following
+         * it in the same list. Their names are resolved one at a time, in the background. */
+        for (n = m->current_server_name; n && m->n_peers < m->poll_servers; n = n->names_next) {
+
+                if (n != m->current_server_name) {
+                        if (n->failed)
+                                continue;
+
+                        if (!n->addresses) {
+                                if (m->peer_resolve_query)
+                                        return 0;
+
+                                log_debug("Resolving %s...", n->string);
+
+                                r = resolve_getaddrinfo(m->resolve, &m->peer_resolve_query, n->string, "123", &hints, manager_peer_resolve_handler, NULL, m);
+                                if (r < 0)
+                                        return log_error_errno(r, "Failed to create resolver: %m");
+
+                                m->peer_resolve_name = n;
+                                return 0;
+                        }
+                }
+
+                LIST_FOREACH(addresses, a, n->addresses) {
+                        if (m->n_peers >= m->poll_servers)
+                                break;
+
+                        manager_add_peer(m, a);
+                }
+        }
+
+        return 0;
+}
+
+static int manager_round_timeout(sd_event_source *source, usec_t usec, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        return manager_complete_round(m);
+}
+
+static int manager_send_request(Manager *m) {
         struct ntp_msg ntpmsg = {
                 /*
                  * "The client initializes the NTP message header, sends the request
@@ -101,6 +267,7 @@ static int manager_send_request(Manager *m) {
                  */
                 .field = NTP_FIELD(0, 4, NTP_MODE_CLIENT),
         };
+        ServerAddress *a, *a_next;
         ssize_t len;
         int r;
 
@@ -109,33 +276,57 @@ static int manager_send_request(Manager *m) {
         assert(m->current_server_address);
 
         m->event_timeout = sd_event_source_unref(m->event_timeout);
+        m->event_round = sd_event_source_unref(m->event_round);
+        m->round_replies = 0;
 
-        r = manager_listen_setup(m);
-        if (r < 0)
-                return log_warning_errno(r, "Failed to setup connection socket: %m");
+        /* Replace the additional servers that stopped answering */
+        LIST_FOREACH_SAFE(peers, a, a_next, m->peers)
+                if (a != m->current_server_address && a->missed_replies > NTP_MAX_MISSED_REPLIES)
+                        manager_drop_peer(m, a);
 
-        /*
-         * Set transmit timestamp, remember it; the server will send that back
-         * as the origin timestamp and we have an indication that this is the
-         * matching answer to our request.
-         *
-         * The actual value does not matter, We do not care about the correct
-         * NTP UINT_MAX fraction; we just pass the plain nanosecond value.
-         */
-        assert_se(clock_gettime(clock_boottime_or_monotonic(), &m->trans_time_mon) >= 0);
-        assert_se(clock_gettime(CLOCK_REALTIME, &m->trans_time) >= 0);
-        ntpmsg.trans_time.sec = htobe32(m->trans_time.tv_sec + OFFSET_1900_1970);
-        ntpmsg.trans_time.frac = htobe32(m->trans_time.tv_nsec);
+        (void) manager_fill_peers(m);
 
-        server_address_pretty(m->current_server_address, &pretty);
+        LIST_FOREACH_SAFE(peers, a, a_next, m->peers) {
+                _cleanup_free_ char *pretty = NULL;
 
-        len = sendto(m->server_socket, &ntpmsg, sizeof(ntpmsg), MSG_DONTWAIT, &m->current_server_address->sockaddr.sa, m->current_server_address->socklen);
-        if (len == sizeof(ntpmsg)) {
-                m->pending = true;
-                log_debug("Sent NTP request to %s (%s).", strna(pretty), m->current_server_name->string);
-        } else {
-                log_debug_errno(errno, "Sending NTP request to %s (%s) failed: %m", strna(pretty), m->current_server_name->string);
-                return manager_connect(m);
+                r = manager_listen_setup(m, a);
+                if (r < 0) {
+                        if (a == m->current_server_address)
+                                return log_warning_errno(r, "Failed to setup connection socket: %m");
+
+                        log_debug_errno(r, "Failed to setup connection socket: %m");
+                        manager_drop_peer(m, a);
+                        continue;
+                }
+
+                /*
+                 * Set transmit timestamp, remember it; the server will send that back
+                 * as the origin timestamp and we have an indication that this is the
+                 * matching answer to our request.
+                 *
+                 * The actual value does not matter, We do not care about the correct
+                 * NTP UINT_MAX fraction; we just pass the plain nanosecond value.
+                 */
+                assert_se(clock_gettime(CLOCK_REALTIME, &a->trans_time) >= 0);
+                ntpmsg.trans_time.sec = htobe32(a->trans_time.tv_sec + OFFSET_1900_1970);
+                ntpmsg.trans_time.frac = htobe32(a->trans_time.tv_nsec);
+
+                server_address_pretty(a, &pretty);
+
+                len = sendto(a->socket, &ntpmsg, sizeof(ntpmsg), MSG_DONTWAIT, &a->sockaddr.sa, a->socklen);
+                if (len == sizeof(ntpmsg)) {
+                        a->pending = true;
+                        a->missed_replies++;
+                        a->n_requests++;
+                        log_debug("Sent NTP request to %s (%s).", strna(pretty), a->name->string);
+                } else {
+                        log_debug_errno(errno, "Sending NTP request to %s (%s) failed: %m", strna(pretty), a->name->string);
+
+                        if (a == m->current_server_address)
+                                return manager_connect(m);
+
+                        manager_drop_peer(m, a);
+                }
         }
 
         /* re-arm timer with increasing timeout, in case the packets never arrive back */
@@ -149,8 +340,19 @@ static int manager_send_request(Manager *m) {
         if (r < 0)
                 return log_error_errno(r, "Failed to rearm timer: %m");
 
-        m->missed_replies++;
-        if (m->missed_replies > NTP_MAX_MISSED_REPLIES) {
+        /* Don't wait for the slowest of several servers for too long */
+        if (m->n_peers > 1) {
+                r = sd_event_add_time(
+                                m->event,
+                                &m->event_round,
+                                clock_boottime_or_monotonic(),
+                                now(clock_boottime_or_monotonic()) + NTP_ROUND_USEC, 0,
+                                manager_round_timeout, m);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to arm round timer: %m");
+        }
+
+        if (m->current_server_address->missed_replies > NTP_MAX_MISSED_REPLIES) {
                 r = sd_event_add_time(
                                 m->event,
                                 &m->event_timeout,
@@ -200,6 +402,7 @@ static int manager_arm_timer(Manager *m, usec_t next) {
 
 static int manager_clock_watch(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
         Manager *m = userdata;
+        ServerAddress *a;
 
         assert(m);
 
@@ -212,10 +415,13 @@ static int manager_clock_watch(sd_event_source *source, int fd, uint32_t revents
                 return 0;
         }
 
-        /* resync */
+        /* resync, what was measured before the change is of no use anymore */
         log_debug("System time changed. Resyncing.");
         m->poll_resync = true;
 
+        LIST_FOREACH(peers, a, m->peers)
+                server_address_flush_samples(a);
+
         return manager_send_request(m);
 }
 
@@ -401,8 +607,156 @@ static void manager_adjust_poll(Manager *m, double offset, bool spike) {
         }
 }
 
+static int manager_peer_failed(Manager *m, ServerAddress *a) {
+        assert(m);
+        assert(a);
+
+        a->n_invalid++;
+
+        if (a == m->current_server_address)
+                return manager_connect(m);
+
+        manager_drop_peer(m, a);
+        return manager_check_round(m);
+}
+
+static int manager_check_round(Manager *m) {
+        ServerAddress *a;
+
+        assert(m);
+
+        LIST_FOREACH(peers, a, m->peers)
+                if (a->pending)
+                        return 0;
+
+        return manager_complete_round(m);
+}
+
+static int manager_complete_round(Manager *m) {
+        ServerAddress *a, **p, *best;
+        NtpCandidate *c;
+        double *delays, offset, jitter;
+        size_t n = 0, i, best_idx;
+        int r, n_survivors;
+        bool spike;
+
+        assert(m);
+
+        m->event_round = sd_event_source_unref(m->event_round);
+
+        /* Nobody answered, the retry timer will send another round of requests */
+        if (m->round_replies == 0)
+                return 0;
+
+        m->round_replies = 0;
+
+        c = newa(NtpCandidate, m->n_peers);
+        p = newa(ServerAddress*, m->n_peers);
+        delays = newa(double, m->n_peers);
+
+        LIST_FOREACH(peers, a, m->peers) {
+                ServerSample sample;
+                double j;
+
+                /* Late replies would start a round of their own, ignore them */
+                if (a->pending) {
+                        a->pending = false;
+                        manager_listen_stop(a);
+                }
+
+                /* Only use what was measured since the clock was last adjusted */
+                r = server_address_filter(a, m->last_update_usec, &sample, &j);
+                if (r < 0)
+                        continue;
+
+                c[n] = (NtpCandidate) {
+                        .offset = sample.offset,
+                        .jitter = j,
+                        .root_distance = sample.root_distance + sample.delay / 2 + j,
+                };
+                p[n] = a;
+                delays[n] = sample.delay;
+                n++;
+        }
+
+        n_survivors = ntp_select(c, n, &offset, &jitter, &best_idx);
+        if (n_survivors < 0)
+                return log_error_errno(n_survivors, "Failed to select time servers: %m");
+        if (n_survivors == 0) {
+                log_notice("No majority of %zu time servers agrees on the time, not adjusting the clock.", n);
+
+                r = manager_arm_timer(m, m->poll_interval_usec);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to rearm timer: %m");
+
+                return 0;
+        }
+
+        for (i = 0; i < n; i++) {
+                _cleanup_free_ char *pretty = NULL;
+
+                if (c[i].survivor)
+                        p[i]->n_selected++;
+
+                server_address_pretty(p[i], &pretty);
+                log_debug("  %-40s offset %+.3f sec, jitter %.3f sec, distance %.3f sec%s",
+                          strna(pretty), c[i].offset, c[i].jitter, c[i].root_distance,
+                          i == best_idx ? " (best)" : c[i].survivor ? "" : " (discarded)");
+        }
+
+        best = p[best_idx];
+
+        m->retry_interval = 0;
+
+        spike = manager_sample_spike_detection(m, offset, delays[best_idx]);
+
+        manager_adjust_poll(m, offset, spike);
+
+        if (!spike) {
+                m->sync = true;
+                r = manager_adjust_clock(m, offset, best->leap_sec);
+                if (r < 0)
+                        log_error_errno(r, "Failed to call clock_adjtime(): %m");
+        }
+
+        m->last_update_usec = now(clock_boottime_or_monotonic());
+
+        /* After a jump, the offsets measured earlier are meaningless */
+        if (m->jumped)
+                LIST_FOREACH(peers, a, m->peers)
+                        server_address_flush_samples(a);
+
+        /* Save NTP response */
+        m->ntpmsg = best->ntpmsg;
+        m->origin_time = best->origin_time;
+        m->dest_time = best->dest_time;
+        m->spike = spike;
+
+        log_debug("interval/delta/delay/jitter/drift " USEC_FMT "s/%+.3fs/%.3fs/%.3fs/%+"PRIi64"ppm%s, %i of %zu servers agree within %.3fs",
+                  m->poll_interval_usec / USEC_PER_SEC, offset, delays[best_idx], m->samples_jitter, m->drift_freq / 65536,
+                  spike ? " (ignored)" : "", n_survivors, n, jitter);
+
+        (void) sd_bus_emit_properties_changed(m->bus, "/org/freedesktop/timesync1", "org.freedesktop.timesync1.Manager", "NTPMessage", NULL);
+
+        if (!m->good) {
+                _cleanup_free_ char *pretty = NULL;
+
+                m->good = true;
+
+                server_address_pretty(best, &pretty);
+                log_info("Synchronized to time server %s (%s).", strna(pretty), best->name->string);
+                sd_notifyf(false, "STATUS=Synchronized to time server %s (%s).", strna(pretty), best->name->string);
+        }
+
+        r = manager_arm_timer(m, m->poll_interval_usec);
+        if (r < 0)
+                return log_error_errno(r, "Failed to rearm timer: %m");
+
+        return 0;
+}
+
 static int manager_receive_response(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
-        Manager *m = userdata;
+        ServerAddress *a = userdata;
         struct ntp_msg ntpmsg;
 
         struct iovec iov = {
@@ -428,16 +782,16 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
         double origin, receive, trans, dest;
         double delay, offset;
         double root_distance;
-        bool spike;
-        int leap_sec;
-        int r;
+        Manager *m;
 
         assert(source);
-        assert(m);
+        assert(a);
+        assert(a->name);
+        assert_se(m = a->name->manager);
 
         if (revents & (EPOLLHUP|EPOLLERR)) {
                 log_warning("Server connection returned error.");
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         len = recvmsg(fd, &msghdr, MSG_DONTWAIT);
@@ -446,18 +800,16 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
                         return 0;
 
                 log_warning("Error receiving message. Disconnecting.");
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         /* Too short or too long packet? */
         if (iov.iov_len < sizeof(struct ntp_msg) || (msghdr.msg_flags & MSG_TRUNC)) {
                 log_warning("Invalid response from server. Disconnecting.");
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
-        if (!m->current_server_name ||
-            !m->current_server_address ||
-            !sockaddr_equal(&server_addr, &m->current_server_address->sockaddr)) {
+        if (!sockaddr_equal(&server_addr, &a->sockaddr)) {
                 log_debug("Response from unknown server.");
                 return 0;
         }
@@ -476,64 +828,66 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Invalid packet timestamp.");
 
-        if (!m->pending) {
+        if (!a->pending) {
                 log_debug("Unexpected reply. Ignoring.");
                 return 0;
         }
 
-        m->missed_replies = 0;
+        a->missed_replies = 0;
 
         /* check our "time cookie" (we just stored nanoseconds in the fraction field) */
-        if (be32toh(ntpmsg.origin_time.sec) != m->trans_time.tv_sec + OFFSET_1900_1970 ||
-            be32toh(ntpmsg.origin_time.frac) != (unsigned long) m->trans_time.tv_nsec) {
+        if (be32toh(ntpmsg.origin_time.sec) != a->trans_time.tv_sec + OFFSET_1900_1970 ||
+            be32toh(ntpmsg.origin_time.frac) != (unsigned long) a->trans_time.tv_nsec) {
                 log_debug("Invalid reply; not our transmit time. Ignoring.");
                 return 0;
         }
 
-        m->event_timeout = sd_event_source_unref(m->event_timeout);
+        if (a == m->current_server_address)
+                m->event_timeout = sd_event_source_unref(m->event_timeout);
 
         if (be32toh(ntpmsg.recv_time.sec) < TIME_EPOCH + OFFSET_1900_1970 ||
             be32toh(ntpmsg.trans_time.sec) < TIME_EPOCH + OFFSET_1900_1970) {
                 log_debug("Invalid reply, returned times before epoch. Ignoring.");
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         if (NTP_FIELD_LEAP(ntpmsg.field) == NTP_LEAP_NOTINSYNC ||
             ntpmsg.stratum == 0 || ntpmsg.stratum >= 16) {
                 log_debug("Server is not synchronized. Disconnecting.");
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         if (!IN_SET(NTP_FIELD_VERSION(ntpmsg.field), 3, 4)) {
                 log_debug("Response NTPv%d. Disconnecting.", NTP_FIELD_VERSION(ntpmsg.field));
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         if (NTP_FIELD_MODE(ntpmsg.field) != NTP_MODE_SERVER) {
                 log_debug("Unsupported mode %d. Disconnecting.", NTP_FIELD_MODE(ntpmsg.field));
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         root_distance = ntp_ts_short_to_d(&ntpmsg.root_delay) / 2 + ntp_ts_short_to_d(&ntpmsg.root_dispersion);
         if (root_distance > (double) m->max_root_distance_usec / (double) USEC_PER_SEC) {
                 log_debug("Server has too large root distance. Disconnecting.");
-                return manager_connect(m);
+                return manager_peer_failed(m, a);
         }
 
         /* valid packet */
-        m->pending = false;
-        m->retry_interval = 0;
+        a->pending = false;
+        a->n_replies++;
+        m->round_replies++;
 
         /* Stop listening */
-        manager_listen_stop(m);
+        manager_listen_stop(a);
 
         /* announce leap seconds */
         if (NTP_FIELD_LEAP(ntpmsg.field) & NTP_LEAP_PLUSSEC)
-                leap_sec = 1;
+                a->leap_sec = 1;
         else if (NTP_FIELD_LEAP(ntpmsg.field) & NTP_LEAP_MINUSSEC)
-                leap_sec = -1;
+                a->leap_sec = -1;
         else
-                leap_sec = 0;
+                a->leap_sec = 0;
 
         /*
          * "Timestamp Name          ID   When Generated
@@ -546,7 +900,7 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
          *  The round-trip delay, d, and system clock offset, t, are defined as:
          *  d = (T4 - T1) - (T3 - T2)     t = ((T2 - T1) + (T3 - T4)) / 2"
          */
-        origin = ts_to_d(&m->trans_time) + OFFSET_1900_1970;
+        origin = ts_to_d(&a->trans_time) + OFFSET_1900_1970;
         receive = ntp_ts_to_d(&ntpmsg.recv_time);
         trans = ntp_ts_to_d(&ntpmsg.trans_time);
         dest = ts_to_d(recv_time) + OFFSET_1900_1970;
@@ -554,11 +908,9 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
         offset = ((receive - origin) + (trans - dest)) / 2;
         delay = (dest - origin) - (trans - receive);
 
-        spike = manager_sample_spike_detection(m, offset, delay);
-
-        manager_adjust_poll(m, offset, spike);
+        server_address_add_sample(a, offset, delay, root_distance, now(clock_boottime_or_monotonic()));
 
-        log_debug("NTP response:\n"
+        log_debug("NTP response from %s:\n"
                   "  leap         : %u\n"
                   "  version      : %u\n"
                   "  mode         : %u\n"
@@ -571,10 +923,8 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
                   "  transmit     : %.3f\n"
                   "  dest         : %.3f\n"
                   "  offset       : %+.3f sec\n"
-                  "  delay        : %+.3f sec\n"
-                  "  packet count : %"PRIu64"\n"
-                  "  jitter       : %.3f%s\n"
-                  "  poll interval: " USEC_FMT "\n",
+                  "  delay        : %+.3f sec\n",
+                  a->name->string,
                   NTP_FIELD_LEAP(ntpmsg.field),
                   NTP_FIELD_VERSION(ntpmsg.field),
                   NTP_FIELD_MODE(ntpmsg.field),
@@ -586,83 +936,52 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
                   receive - OFFSET_1900_1970,
                   trans - OFFSET_1900_1970,
                   dest - OFFSET_1900_1970,
-                  offset, delay,
-                  m->packet_count,
-                  m->samples_jitter, spike ? " spike" : "",
-                  m->poll_interval_usec / USEC_PER_SEC);
-
-        if (!spike) {
-                m->sync = true;
-                r = manager_adjust_clock(m, offset, leap_sec);
-                if (r < 0)
-                        log_error_errno(r, "Failed to call clock_adjtime(): %m");
-        }
+                  offset, delay);
 
         /* Save NTP response */
-        m->ntpmsg = ntpmsg;
-        m->origin_time = m->trans_time;
-        m->dest_time = *recv_time;
-        m->spike = spike;
-
-        log_debug("interval/delta/delay/jitter/drift " USEC_FMT "s/%+.3fs/%.3fs/%.3fs/%+"PRIi64"ppm%s",
-                  m->poll_interval_usec / USEC_PER_SEC, offset, delay, m->samples_jitter, m->drift_freq / 65536,
-                  spike ? " (ignored)" : "");
-
-        (void) sd_bus_emit_properties_changed(m->bus, "/org/freedesktop/timesync1", "org.freedesktop.timesync1.Manager", "NTPMessage", NULL);
-
-        if (!m->good) {
-                _cleanup_free_ char *pretty = NULL;
-
-                m->good = true;
+        a->ntpmsg = ntpmsg;
+        a->origin_time = a->trans_time;
+        a->dest_time = *recv_time;
 
-                server_address_pretty(m->current_server_address, &pretty);
-                log_info("Synchronized to time server %s (%s).", strna(pretty), m->current_server_name->string);
-                sd_notifyf(false, "STATUS=Synchronized to time server %s (%s).", strna(pretty), m->current_server_name->string);
-        }
-
-        r = manager_arm_timer(m, m->poll_interval_usec);
-        if (r < 0)
-                return log_error_errno(r, "Failed to rearm timer: %m");
-
-        return 0;
+        return manager_check_round(m);
 }
 
-static int manager_listen_setup(Manager *m) {
+static int manager_listen_setup(Manager *m, ServerAddress *a) {
         union sockaddr_union addr = {};
         int r;
 
         assert(m);
+        assert(a);
 
-        if (m->server_socket >= 0)
+        if (a->socket >= 0)
                 return 0;
 
-        assert(!m->event_receive);
-        assert(m->current_server_address);
+        assert(!a->event_receive);
 
-        addr.sa.sa_family = m->current_server_address->sockaddr.sa.sa_family;
+        addr.sa.sa_family = a->sockaddr.sa.sa_family;
 
-        m->server_socket = socket(addr.sa.sa_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
-        if (m->server_socket < 0)
+        a->socket = socket(addr.sa.sa_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (a->socket < 0)
                 return -errno;
 
-        r = bind(m->server_socket, &addr.sa, m->current_server_address->socklen);
+        r = bind(a->socket, &addr.sa, a->socklen);
         if (r < 0)
                 return -errno;
 
-        r = setsockopt_int(m->server_socket, SOL_SOCKET, SO_TIMESTAMPNS, true);
+        r = setsockopt_int(a->socket, SOL_SOCKET, SO_TIMESTAMPNS, true);
         if (r < 0)
                 return r;
 
-        (void) setsockopt_int(m->server_socket, IPPROTO_IP, IP_TOS, IPTOS_LOWDELAY);
+        (void) setsockopt_int(a->socket, IPPROTO_IP, IP_TOS, IPTOS_LOWDELAY);
 
-        return sd_event_add_io(m->event, &m->event_receive, m->server_socket, EPOLLIN, manager_receive_response, m);
+        return sd_event_add_io(m->event, &a->event_receive, a->socket, EPOLLIN, manager_receive_response, a);
 }
 
-static void manager_listen_stop(Manager *m) {
-        assert(m);
+static void manager_listen_stop(ServerAddress *a) {
+        assert(a);
 
-        m->event_receive = sd_event_source_unref(m->event_receive);
-        m->server_socket = safe_close(m->server_socket);
+        a->event_receive = sd_event_source_unref(a->event_receive);
+        a->socket = safe_close(a->socket);
 }
 
 static int manager_begin(Manager *m) {
@@ -674,7 +993,6 @@ static int manager_begin(Manager *m) {
         assert_return(m->current_server_address, -EHOSTUNREACH);
 
         m->good = false;
-        m->missed_replies = NTP_MAX_MISSED_REPLIES;
         if (m->poll_interval_usec == 0)
                 m->poll_interval_usec = m->poll_interval_min_usec;
 
@@ -686,6 +1004,12 @@ static int manager_begin(Manager *m) {
         if (r < 0)
                 return r;
 
+        manager_reset_failed(m);
+
+        r = manager_fill_peers(m);
+        if (r < 0)
+                return r;
+
         return manager_send_request(m);
 }
 
@@ -891,10 +1215,14 @@ void manager_disconnect(Manager *m) {
         assert(m);
 
         m->resolve_query = sd_resolve_query_unref(m->resolve_query);
+        m->peer_resolve_query = sd_resolve_query_unref(m->peer_resolve_query);
+        m->peer_resolve_name = NULL;
 
         m->event_timer = sd_event_source_unref(m->event_timer);
+        m->event_round = sd_event_source_unref(m->event_round);
 
-        manager_listen_stop(m);
+        while (m->peers)
+                manager_remove_peer(m, m->peers);
 
         m->event_clock_watch = sd_event_source_unref(m->event_clock_watch);
         m->clock_watch_fd = safe_close(m->clock_watch_fd);
@@ -1009,7 +1337,7 @@ clear:
 static bool manager_is_connected(Manager *m) {
         /* Return true when the manager is sending a request, resolving a server name, or
          * in a poll interval. */
-        return m->server_socket >= 0 || m->resolve_query || m->event_timer;
+        return m->peers || m->resolve_query || m->event_timer;
 }
 
 static int manager_network_event_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
@@ -1090,7 +1418,9 @@ int manager_new(Manager **ret) {
         m->poll_interval_min_usec = NTP_POLL_INTERVAL_MIN_USEC;
         m->poll_interval_max_usec = NTP_POLL_INTERVAL_MAX_USEC;
 
-        m->server_socket = m->clock_watch_fd = -1;
+        m->poll_servers = 1;
+
+        m->clock_watch_fd = -1;
 
         RATELIMIT_INIT(m->ratelimit, RATELIMIT_INTERVAL_USEC, RATELIMIT_BURST);
 
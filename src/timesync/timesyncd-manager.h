@@ -24,6 +24,8 @@ typedef struct Manager Manager;
 #define NTP_POLL_INTERVAL_MIN_USEC      (32 * USEC_PER_SEC)
 #define NTP_POLL_INTERVAL_MAX_USEC      (2048 * USEC_PER_SEC)
 
+#define NTP_POLL_SERVERS_MAX            16U
+
 struct Manager {
         sd_bus *bus;
         sd_event *event;
@@ -44,20 +46,24 @@ struct Manager {
 
         /* peer */
         sd_resolve_query *resolve_query;
-        sd_event_source *event_receive;
         ServerName *current_server_name;
         ServerAddress *current_server_address;
-        int server_socket;
-        int missed_replies;
         uint64_t packet_count;
         sd_event_source *event_timeout;
         bool good;
 
-        /* last sent packet */
-        struct timespec trans_time_mon;
-        struct timespec trans_time;
+        /* Servers polled together, the current server address always comes first */
+        LIST_HEAD(ServerAddress, peers);
+        unsigned n_peers;
+        unsigned poll_servers;
+        sd_resolve_query *peer_resolve_query;
+        ServerName *peer_resolve_name;
+
+        /* current round of requests */
+        sd_event_source *event_round;
+        unsigned round_replies;
         usec_t retry_interval;
-        bool pending;
+        usec_t last_update_usec;
 
         /* poll timer */
         sd_event_source *event_timer;
@@ -105,5 +111,7 @@ void manager_set_server_name(Manager *m, ServerName *n);
 void manager_set_server_address(Manager *m, ServerAddress *a);
 void manager_flush_server_names(Manager *m, ServerType t);
 
+void manager_remove_peer(Manager *m, ServerAddress *a);
+
 int manager_connect(Manager *m);
 void manager_disconnect(Manager *m);
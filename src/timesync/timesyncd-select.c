@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <math.h>
+
+#include "alloc-util.h"
+#include "macro.h"
+#include "timesyncd-select.h"
+#include "util.h"
+
+/* Never prune the survivors below this number, RFC 5905 calls it NMIN */
+#define NTP_MIN_CLUSTER 3U
+
+typedef struct Endpoint {
+        double value;
+        int type;       /* -1 lower end of an interval, 0 midpoint, +1 upper end */
+} Endpoint;
+
+static int endpoint_compare(const Endpoint *x, const Endpoint *y) {
+        int r;
+
+        r = CMP(x->value, y->value);
+        if (r != 0)
+                return r;
+
+        return CMP(x->type, y->type);
+}
+
+static int ntp_intersect(const NtpCandidate *c, size_t n, double *ret_low, double *ret_high) {
+        _cleanup_free_ Endpoint *e = NULL;
+        size_t i, allow;
+
+        /* Marzullo's algorithm as used by RFC 5905: find the smallest interval that contains the midpoints of a
+         * majority of the candidates, and in which the correctness intervals [offset - root distance, offset +
+         * root distance] of that majority all overlap. Start by requiring all candidates to agree, and allow
+         * for one more falseticker in each round. */
+
+        e = new(Endpoint, n * 3);
+        if (!e)
+                return -ENOMEM;
+
+        for (i = 0; i < n; i++) {
+                e[i * 3 + 0] = (Endpoint) { c[i].offset - c[i].root_distance, -1 };
+                e[i * 3 + 1] = (Endpoint) { c[i].offset, 0 };
+                e[i * 3 + 2] = (Endpoint) { c[i].offset + c[i].root_distance, +1 };
+        }
+
+        typesafe_qsort(e, n * 3, endpoint_compare);
+
+        for (allow = 0; allow * 2 < n; allow++) {
+                bool have_low = false, have_high = false;
+                double low = 0, high = 0;
+                size_t found = 0, k;
+                int chime = 0;
+
+                for (k = 0; k < n * 3; k++) {
+                        chime -= e[k].type;
+                        if (chime >= (int) (n - allow)) {
+                                low = e[k].value;
+                                have_low = true;
+                                break;
+                        }
+                        if (e[k].type == 0)
+                                found++;
+                }
+
+                chime = 0;
+                for (k = n * 3; k > 0; k--) {
+                        chime += e[k - 1].type;
+                        if (chime >= (int) (n - allow)) {
+                                high = e[k - 1].value;
+                                have_high = true;
+                                break;
+                        }
+                        if (e[k - 1].type == 0)
+                                found++;
+                }
+
+                if (found > allow)
+                        continue;
+
+                if (have_low && have_high && low <= high) {
+                        *ret_low = low;
+                        *ret_high = high;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+static double selection_jitter(const NtpCandidate *c, size_t n, size_t i, size_t n_survivors) {
+        double j = 0;
+        size_t k;
+
+        for (k = 0; k < n; k++)
+                if (c[k].survivor)
+                        j += pow(c[k].offset - c[i].offset, 2);
+
+        return sqrt(j / (n_survivors - 1));
+}
+
+int ntp_select(NtpCandidate *c, size_t n, double *ret_offset, double *ret_jitter, size_t *ret_best) {
+        double low, high, w, sum_w = 0, sum_offset = 0, sum_phi = 0;
+        size_t i, n_survivors = 0, best = (size_t) -1;
+        int r;
+
+        assert(c || n == 0);
+        assert(ret_offset);
+        assert(ret_jitter);
+        assert(ret_best);
+
+        /* Selection, clustering and combining as described in RFC 5905, somewhat simplified. Returns the number of
+         * candidates that survived, with their 'survivor' field set, or 0 if no majority of the candidates agrees
+         * on the time, in which case the clock should be left alone. */
+
+        for (i = 0; i < n; i++)
+                c[i].survivor = false;
+
+        if (n == 0)
+                return 0;
+
+        r = ntp_intersect(c, n, &low, &high);
+        if (r <= 0)
+                return r;
+
+        /* Those whose midpoint lies outside of the intersection are falsetickers */
+        for (i = 0; i < n; i++)
+                if (c[i].offset >= low && c[i].offset <= high) {
+                        c[i].survivor = true;
+                        n_survivors++;
+                }
+
+        if (n_survivors == 0)
+                return 0;
+
+        /* Clustering: as long as the spread of the survivors is larger than the jitter of the individual servers,
+         * drop the outlier that contributes most to the spread. */
+        while (n_survivors > NTP_MIN_CLUSTER) {
+                double max_phi = -1, min_jitter = INFINITY;
+                size_t max_i = 0;
+
+                for (i = 0; i < n; i++) {
+                        double phi;
+
+                        if (!c[i].survivor)
+                                continue;
+
+                        phi = selection_jitter(c, n, i, n_survivors);
+                        if (phi > max_phi) {
+                                max_phi = phi;
+                                max_i = i;
+                        }
+
+                        min_jitter = MIN(min_jitter, c[i].jitter);
+                }
+
+                if (max_phi <= min_jitter)
+                        break;
+
+                c[max_i].survivor = false;
+                n_survivors--;
+        }
+
+        /* Combining: average the offsets of the survivors, weighted by the inverse of their root distance. The
+         * survivor with the smallest root distance is the system peer. */
+        for (i = 0; i < n; i++) {
+                if (!c[i].survivor)
+                        continue;
+
+                w = 1.0 / MAX(c[i].root_distance, 1e-6);
+                sum_w += w;
+                sum_offset += w * c[i].offset;
+
+                if (best == (size_t) -1 || c[i].root_distance < c[best].root_distance)
+                        best = i;
+        }
+
+        for (i = 0; i < n; i++) {
+                if (!c[i].survivor)
+                        continue;
+
+                w = 1.0 / MAX(c[i].root_distance, 1e-6);
+                sum_phi += w * pow(c[i].offset - c[best].offset, 2);
+        }
+
+        *ret_offset = sum_offset / sum_w;
+        *ret_jitter = sqrt(pow(c[best].jitter, 2) + sum_phi / sum_w);
+        *ret_best = best;
+
+        return (int) n_survivors;
+}
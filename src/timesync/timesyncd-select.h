@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The output of the clock filter of one server, in seconds */
+typedef struct NtpCandidate {
+        double offset;
+        double jitter;
+        double root_distance;   /* including the delay to the server and its jitter */
+        bool survivor;          /* set by ntp_select() */
+} NtpCandidate;
+
+int ntp_select(NtpCandidate *c, size_t n, double *ret_offset, double *ret_jitter, size_t *ret_best);
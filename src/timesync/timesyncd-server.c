@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <math.h>
+
 #include "alloc-util.h"
 #include "timesyncd-server.h"
 
@@ -22,6 +24,7 @@ int server_address_new(
 
         memcpy(&a->sockaddr, sockaddr, socklen);
         a->socklen = socklen;
+        a->socket = -1;
 
         LIST_FIND_TAIL(addresses, n->addresses, tail);
         LIST_INSERT_AFTER(addresses, n->addresses, tail, a);
@@ -42,11 +45,71 @@ ServerAddress* server_address_free(ServerAddress *a) {
 
                 if (a->name->manager && a->name->manager->current_server_address == a)
                         manager_set_server_address(a->name->manager, NULL);
+
+                if (a->name->manager && a->peer)
+                        manager_remove_peer(a->name->manager, a);
         }
 
         return mfree(a);
 }
 
+void server_address_add_sample(ServerAddress *a, double offset, double delay, double root_distance, usec_t t) {
+        assert(a);
+
+        a->samples[a->samples_idx] = (ServerSample) {
+                .offset = offset,
+                .delay = delay,
+                .root_distance = root_distance,
+                .time = t,
+        };
+        a->samples_idx = (a->samples_idx + 1) % NTP_FILTER_SAMPLES;
+
+        if (a->n_samples < NTP_FILTER_SAMPLES)
+                a->n_samples++;
+}
+
+void server_address_flush_samples(ServerAddress *a) {
+        assert(a);
+
+        a->n_samples = a->samples_idx = 0;
+}
+
+int server_address_filter(ServerAddress *a, usec_t since, ServerSample *ret, double *ret_jitter) {
+        const ServerSample *best = NULL;
+        double j = 0;
+        unsigned i;
+
+        assert(a);
+        assert(ret);
+        assert(ret_jitter);
+
+        /* The clock filter of RFC 5905: out of the samples taken after 'since', the one with the lowest round-trip
+         * delay is the least affected by queuing on the way, so use that one. Samples taken before 'since' were
+         * already applied to the clock, and must not be applied a second time. The jitter is the RMS difference of
+         * the offsets of all samples to the chosen one. */
+
+        for (i = 0; i < a->n_samples; i++) {
+                const ServerSample *s = a->samples + i;
+
+                if (s->time <= since)
+                        continue;
+
+                if (!best || s->delay < best->delay)
+                        best = s;
+        }
+
+        if (!best)
+                return -ENODATA;
+
+        for (i = 0; i < a->n_samples; i++)
+                j += pow(a->samples[i].offset - best->offset, 2);
+
+        *ret = *best;
+        *ret_jitter = a->n_samples > 1 ? sqrt(j / (a->n_samples - 1)) : 0;
+
+        return 0;
+}
+
 int server_name_new(
                 Manager *m,
                 ServerName **ret,
@@ -114,6 +177,11 @@ ServerName *server_name_free(ServerName *n) {
 
                 if (n->manager->current_server_name == n)
                         manager_set_server_name(n->manager, NULL);
+
+                if (n->manager->peer_resolve_name == n) {
+                        n->manager->peer_resolve_query = sd_resolve_query_unref(n->manager->peer_resolve_query);
+                        n->manager->peer_resolve_name = NULL;
+                }
         }
 
         log_debug("Removed server %s.", n->string);
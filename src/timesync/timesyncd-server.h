@@ -1,8 +1,11 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include "sd-event.h"
+
 #include "list.h"
 #include "socket-util.h"
+#include "time-util.h"
 
 typedef struct ServerAddress ServerAddress;
 typedef struct ServerName ServerName;
@@ -14,6 +17,17 @@ typedef enum ServerType {
 } ServerType;
 
 #include "timesyncd-manager.h"
+#include "timesyncd-ntp-message.h"
+
+/* Number of samples kept per server for the clock filter, as suggested by RFC 5905 */
+#define NTP_FILTER_SAMPLES 8U
+
+typedef struct ServerSample {
+        double offset;
+        double delay;
+        double root_distance;   /* as announced by the server, without our own delay */
+        usec_t time;            /* when the reply arrived, in clock_boottime_or_monotonic() */
+} ServerSample;
 
 struct ServerAddress {
         ServerName *name;
@@ -21,7 +35,31 @@ struct ServerAddress {
         union sockaddr_union sockaddr;
         socklen_t socklen;
 
+        /* While polling this server */
+        bool peer:1;
+        bool pending:1;
+        int socket;
+        sd_event_source *event_receive;
+        struct timespec trans_time;
+        int missed_replies;
+
+        /* Last valid reply */
+        struct ntp_msg ntpmsg;
+        struct timespec origin_time, dest_time;
+        int leap_sec;
+
+        /* Clock filter, a ring buffer of the last samples */
+        ServerSample samples[NTP_FILTER_SAMPLES];
+        unsigned n_samples, samples_idx;
+
+        /* Statistics */
+        uint64_t n_requests;
+        uint64_t n_replies;
+        uint64_t n_invalid;
+        uint64_t n_selected;
+
         LIST_FIELDS(ServerAddress, addresses);
+        LIST_FIELDS(ServerAddress, peers);
 };
 
 struct ServerName {
@@ -31,6 +69,7 @@ struct ServerName {
         char *string;
 
         bool marked:1;
+        bool failed:1;          /* skipped when looking for additional peers, until we reconnect */
 
         LIST_HEAD(ServerAddress, addresses);
         LIST_FIELDS(ServerName, names);
@@ -42,6 +81,10 @@ static inline int server_address_pretty(ServerAddress *a, char **pretty) {
         return sockaddr_pretty(&a->sockaddr.sa, a->socklen, true, true, pretty);
 }
 
+void server_address_add_sample(ServerAddress *a, double offset, double delay, double root_distance, usec_t t);
+void server_address_flush_samples(ServerAddress *a);
+int server_address_filter(ServerAddress *a, usec_t since, ServerSample *ret, double *ret_jitter);
+
 int server_name_new(Manager *m, ServerName **ret, ServerType type,const char *string);
 ServerName *server_name_free(ServerName *n);
 void server_name_flush_addresses(ServerName *n);
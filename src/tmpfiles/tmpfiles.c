@@ -7,12 +7,15 @@
 #include <glob.h>
 #include <limits.h>
 #include <linux/fs.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/xattr.h>
 #include <sysexits.h>
 #include <time.h>
@@ -60,6 +63,8 @@
 #include "umask-util.h"
 #include "user-util.h"
 #include "util.h"
+#include "worker-pool.h"
+#include "xattr-util.h"
 
 /* This reads all files listed in /etc/tmpfiles.d/?*.conf and creates
  * them in the file system. This is intended to be used to create
@@ -173,6 +178,15 @@ static char *arg_replace = NULL;
 static OrderedHashmap *items = NULL, *globs = NULL;
 static Set *unix_sockets = NULL;
 
+/* The number of modifications made while creating, for telling whether an item was in place already */
+static unsigned n_changes = 0;
+static unsigned n_items_changed = 0, n_items_unchanged = 0;
+
+static void note_change(void) {
+        /* Recursive items are applied by several threads */
+        __sync_fetch_and_add(&n_changes, 1);
+}
+
 STATIC_DESTRUCTOR_REGISTER(items, ordered_hashmap_freep);
 STATIC_DESTRUCTOR_REGISTER(globs, ordered_hashmap_freep);
 STATIC_DESTRUCTOR_REGISTER(unix_sockets, set_free_freep);
@@ -451,9 +465,16 @@ static int load_unix_sockets(void) {
 }
 
 static bool unix_socket_alive(const char *fn) {
+        static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        int r;
+
         assert(fn);
 
-        if (load_unix_sockets() < 0)
+        /* Called from the cleanup threads too, make sure the list is only loaded once */
+        assert_se(pthread_mutex_lock(&mutex) == 0);
+        r = load_unix_sockets();
+        assert_se(pthread_mutex_unlock(&mutex) == 0);
+        if (r < 0)
                 return true;     /* We don't know, so assume yes */
 
         return !!set_get(unix_sockets, (char*) fn);
@@ -513,6 +534,66 @@ static DIR* opendir_nomod(const char *path) {
         return xopendirat_nomod(AT_FDCWD, path);
 }
 
+/* Statistics about a cleanup run, for logging */
+typedef struct CleanupStats {
+        uint64_t n_scanned;
+        uint64_t n_removed;
+        uint64_t n_bytes;
+} CleanupStats;
+
+static void cleanup_stats_add(CleanupStats *a, const CleanupStats *b) {
+        a->n_scanned += b->n_scanned;
+        a->n_removed += b->n_removed;
+        a->n_bytes += b->n_bytes;
+}
+
+#define CLEANUP_STATX_MASK                                              \
+        (STATX_TYPE|STATX_MODE|STATX_NLINK|STATX_UID|STATX_ATIME|STATX_MTIME|STATX_CTIME|STATX_BLOCKS)
+
+static int stat_entry(DIR *d, const char *name, struct stat *ret) {
+        static bool statx_unsupported = false;
+        struct_statx sx;
+
+        /* Only asks for the fields we actually look at, which might save the file system some work, and fills in
+         * a struct stat with them. Falls back to fstatat() if statx() is not available or did not return all of
+         * them. */
+
+        if (!statx_unsupported) {
+                if (statx(dirfd(d), name, AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT, CLEANUP_STATX_MASK, &sx) < 0) {
+                        if (!IN_SET(errno, ENOSYS, EOPNOTSUPP, EPERM))
+                                return -errno;
+
+                        /* Not implemented, or blocked by a seccomp filter */
+                        statx_unsupported = true;
+
+                } else if ((sx.stx_mask & CLEANUP_STATX_MASK) == CLEANUP_STATX_MASK) {
+                        *ret = (struct stat) {
+                                .st_dev = makedev(sx.stx_dev_major, sx.stx_dev_minor),
+                                .st_ino = sx.stx_ino,
+                                .st_mode = sx.stx_mode,
+                                .st_nlink = sx.stx_nlink,
+                                .st_uid = sx.stx_uid,
+                                .st_gid = sx.stx_gid,
+                                .st_size = sx.stx_size,
+                                .st_blocks = sx.stx_blocks,
+                                .st_atim.tv_sec = sx.stx_atime.tv_sec,
+                                .st_atim.tv_nsec = sx.stx_atime.tv_nsec,
+                                .st_mtim.tv_sec = sx.stx_mtime.tv_sec,
+                                .st_mtim.tv_nsec = sx.stx_mtime.tv_nsec,
+                                .st_ctim.tv_sec = sx.stx_ctime.tv_sec,
+                                .st_ctim.tv_nsec = sx.stx_ctime.tv_nsec,
+                        };
+
+                        return 0;
+                }
+        }
+
+        if (fstatat(dirfd(d), name, ret, AT_SYMLINK_NOFOLLOW) < 0)
+                return -errno;
+
+        return 0;
+}
+
 static int dir_cleanup(
                 Item *i,
                 const char *p,
@@ -522,12 +603,161 @@ static int dir_cleanup(
                 dev_t rootdev,
                 bool mountpoint,
                 int maxdepth,
-                bool keep_this_level) {
+                bool keep_this_level,
+                bool parallel,
+                CleanupStats *stats);
+
+static int dir_cleanup_subdir(
+                Item *i,
+                DIR *d,
+                const char *name,
+                const char *sub_path,
+                const struct stat *s,
+                usec_t cutoff,
+                dev_t rootdev,
+                int maxdepth,
+                bool keep_this_level,
+                CleanupStats *stats) {
+
+        usec_t age;
+        int r = 0;
+
+        /* Cleans up the subdirectory name of d, and removes it if it is empty and old enough */
+
+        if (maxdepth <= 0)
+                log_warning("Reached max depth on \"%s\".", sub_path);
+        else {
+                _cleanup_closedir_ DIR *sub_dir;
+
+                sub_dir = xopendirat_nomod(dirfd(d), name);
+                if (!sub_dir) {
+                        if (errno != ENOENT)
+                                return log_error_errno(errno, "opendir(%s) failed: %m", sub_path);
+
+                        return 0;
+                }
 
+                r = dir_cleanup(i, sub_path, sub_dir, s, cutoff, rootdev, false, maxdepth-1, false, false, stats);
+        }
+
+        /* Note: if you are wondering why we don't
+         * support the sticky bit for excluding
+         * directories from cleaning like we do it for
+         * other file system objects: well, the sticky
+         * bit already has a meaning for directories,
+         * so we don't want to overload that. */
+
+        if (keep_this_level) {
+                log_debug("Keeping \"%s\".", sub_path);
+                return r;
+        }
+
+        /* Ignore ctime, we change it when deleting */
+        age = timespec_load(&s->st_mtim);
+        if (age >= cutoff) {
+                char a[FORMAT_TIMESTAMP_MAX];
+                /* Follows spelling in stat(1). */
+                log_debug("Directory \"%s\": modify time %s is too new.",
+                          sub_path,
+                          format_timestamp_us(a, sizeof(a), age));
+                return r;
+        }
+
+        age = timespec_load(&s->st_atim);
+        if (age >= cutoff) {
+                char a[FORMAT_TIMESTAMP_MAX];
+                log_debug("Directory \"%s\": access time %s is too new.",
+                          sub_path,
+                          format_timestamp_us(a, sizeof(a), age));
+                return r;
+        }
+
+        log_debug("Removing directory \"%s\".", sub_path);
+        if (unlinkat(dirfd(d), name, AT_REMOVEDIR) < 0) {
+                if (!IN_SET(errno, ENOENT, ENOTEMPTY))
+                        r = log_error_errno(errno, "rmdir(%s): %m", sub_path);
+        } else
+                stats->n_removed++;
+
+        return r;
+}
+
+/* Subdirectories of the top level of a cleaned up item are handed to a worker pool. The threads open them relative to
+ * the top-level directory only once they pick them up, hence pending jobs need no fds. The top level itself is
+ * still enumerated by the calling thread, which also still handles the files on the top level. */
+
+typedef struct CleanupContext {
+        Item *item;
+        DIR *dir;
+        usec_t cutoff;
+        dev_t rootdev;
+        int maxdepth;
+        bool keep_this_level;
+
+        pthread_mutex_t mutex;
+        CleanupStats stats;
+} CleanupContext;
+
+typedef struct CleanupJob {
+        char *name;
+        char *sub_path;
+        struct stat st;
+} CleanupJob;
+
+static void cleanup_job_free(void *p) {
+        CleanupJob *j = p;
+
+        if (!j)
+                return;
+
+        free(j->name);
+        free(j->sub_path);
+        free(j);
+}
+
+static int cleanup_job_run(void *job, void *userdata) {
+        CleanupContext *c = userdata;
+        CleanupJob *j = job;
+        CleanupStats stats = {};
+        int r;
+
+        r = dir_cleanup_subdir(c->item, c->dir, j->name, j->sub_path, &j->st,
+                               c->cutoff, c->rootdev, c->maxdepth, c->keep_this_level, &stats);
+
+        assert_se(pthread_mutex_lock(&c->mutex) == 0);
+        cleanup_stats_add(&c->stats, &stats);
+        assert_se(pthread_mutex_unlock(&c->mutex) == 0);
+
+        return r;
+}
+
+static int dir_cleanup(
+                Item *i,
+                const char *p,
+                DIR *d,
+                const struct stat *ds,
+                usec_t cutoff,
+                dev_t rootdev,
+                bool mountpoint,
+                int maxdepth,
+                bool keep_this_level,
+                bool parallel,
+                CleanupStats *stats) {
+
+        CleanupContext context = {
+                .item = i,
+                .dir = d,
+                .cutoff = cutoff,
+                .rootdev = rootdev,
+                .maxdepth = maxdepth,
+                .keep_this_level = keep_this_level,
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+        };
+        WorkerPool *pool = NULL;
         struct dirent *dent;
         struct timespec times[2];
         bool deleted = false;
-        int r = 0;
+        int r = 0, q;
 
         FOREACH_DIRENT_ALL(dent, d, break) {
                 struct stat s;
@@ -537,16 +767,19 @@ static int dir_cleanup(
                 if (dot_or_dot_dot(dent->d_name))
                         continue;
 
-                if (fstatat(dirfd(d), dent->d_name, &s, AT_SYMLINK_NOFOLLOW) < 0) {
-                        if (errno == ENOENT)
+                q = stat_entry(d, dent->d_name, &s);
+                if (q < 0) {
+                        if (q == -ENOENT)
                                 continue;
 
                         /* FUSE, NFS mounts, SELinux might return EACCES */
-                        r = log_full_errno(errno == EACCES ? LOG_DEBUG : LOG_ERR, errno,
+                        r = log_full_errno(q == -EACCES ? LOG_DEBUG : LOG_ERR, q,
                                            "stat(%s/%s) failed: %m", p, dent->d_name);
                         continue;
                 }
 
+                stats->n_scanned++;
+
                 /* Stay on the same filesystem */
                 if (s.st_dev != rootdev) {
                         log_debug("Ignoring \"%s/%s\": different filesystem.", p, dent->d_name);
@@ -588,61 +821,42 @@ static int dir_cleanup(
                                 continue;
                         }
 
-                        if (maxdepth <= 0)
-                                log_warning("Reached max depth on \"%s\".", sub_path);
-                        else {
-                                _cleanup_closedir_ DIR *sub_dir;
-                                int q;
-
-                                sub_dir = xopendirat_nomod(dirfd(d), dent->d_name);
-                                if (!sub_dir) {
-                                        if (errno != ENOENT)
-                                                r = log_error_errno(errno, "opendir(%s) failed: %m", sub_path);
-
-                                        continue;
-                                }
-
-                                q = dir_cleanup(i, sub_path, sub_dir, &s, cutoff, rootdev, false, maxdepth-1, false);
-                                if (q < 0)
-                                        r = q;
+                        /* Subdirectories of the top level are cleaned up by a pool of threads, started once
+                         * the first one is found. If that fails, just continue serially. */
+                        if (parallel && maxdepth > 0) {
+                                if (!pool)
+                                        pool = worker_pool_new(cleanup_job_run, cleanup_job_free, &context);
+                                if (!pool)
+                                        parallel = false;
                         }
 
-                        /* Note: if you are wondering why we don't
-                         * support the sticky bit for excluding
-                         * directories from cleaning like we do it for
-                         * other file system objects: well, the sticky
-                         * bit already has a meaning for directories,
-                         * so we don't want to overload that. */
+                        if (pool) {
+                                CleanupJob *j;
 
-                        if (keep_this_level) {
-                                log_debug("Keeping \"%s\".", sub_path);
-                                continue;
-                        }
+                                j = new(CleanupJob, 1);
+                                if (!j) {
+                                        r = log_oom();
+                                        goto finish;
+                                }
 
-                        /* Ignore ctime, we change it when deleting */
-                        age = timespec_load(&s.st_mtim);
-                        if (age >= cutoff) {
-                                char a[FORMAT_TIMESTAMP_MAX];
-                                /* Follows spelling in stat(1). */
-                                log_debug("Directory \"%s\": modify time %s is too new.",
-                                          sub_path,
-                                          format_timestamp_us(a, sizeof(a), age));
-                                continue;
-                        }
+                                *j = (CleanupJob) {
+                                        .name = strdup(dent->d_name),
+                                        .sub_path = TAKE_PTR(sub_path),
+                                        .st = s,
+                                };
+                                if (!j->name) {
+                                        cleanup_job_free(j);
+                                        r = log_oom();
+                                        goto finish;
+                                }
 
-                        age = timespec_load(&s.st_atim);
-                        if (age >= cutoff) {
-                                char a[FORMAT_TIMESTAMP_MAX];
-                                log_debug("Directory \"%s\": access time %s is too new.",
-                                          sub_path,
-                                          format_timestamp_us(a, sizeof(a), age));
+                                worker_pool_add(pool, j);
                                 continue;
                         }
 
-                        log_debug("Removing directory \"%s\".", sub_path);
-                        if (unlinkat(dirfd(d), dent->d_name, AT_REMOVEDIR) < 0)
-                                if (!IN_SET(errno, ENOENT, ENOTEMPTY))
-                                        r = log_error_errno(errno, "rmdir(%s): %m", sub_path);
+                        q = dir_cleanup_subdir(i, d, dent->d_name, sub_path, &s, cutoff, rootdev, maxdepth, keep_this_level, stats);
+                        if (q < 0)
+                                r = q;
 
                 } else {
                         /* Skip files for which the sticky bit is
@@ -712,15 +926,32 @@ static int dir_cleanup(
 
                         log_debug("unlink \"%s\"", sub_path);
 
-                        if (unlinkat(dirfd(d), dent->d_name, 0) < 0)
+                        if (unlinkat(dirfd(d), dent->d_name, 0) < 0) {
                                 if (errno != ENOENT)
                                         r = log_error_errno(errno, "unlink(%s): %m", sub_path);
+                        } else {
+                                stats->n_removed++;
+
+                                /* Only the last link frees the space */
+                                if (s.st_nlink <= 1)
+                                        stats->n_bytes += (uint64_t) s.st_blocks * 512U;
+                        }
 
                         deleted = true;
                 }
         }
 
 finish:
+        /* Wait for the subdirectories, before restoring the timestamps below */
+        if (pool) {
+                q = worker_pool_finish(pool);
+                if (q < 0)
+                        r = q;
+
+                cleanup_stats_add(stats, &context.stats);
+        }
+        pthread_mutex_destroy(&context.mutex);
+
         if (deleted) {
                 usec_t age1, age2;
                 char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX];
@@ -819,6 +1050,7 @@ static int fd_set_perms(Item *i, int fd, const char *path, const struct stat *st
                                 log_debug("Changing \"%s\" to mode %o.", path, m);
                                 if (fchmod_opath(fd, m) < 0)
                                         return log_error_errno(errno, "fchmod() of %s failed: %m", path);
+                                note_change();
                         }
                 }
         }
@@ -836,6 +1068,7 @@ static int fd_set_perms(Item *i, int fd, const char *path, const struct stat *st
                              i->gid_set ? i->gid : GID_INVALID,
                              AT_EMPTY_PATH) < 0)
                         return log_error_errno(errno, "fchownat() of %s failed: %m", path);
+                note_change();
         }
 
 shortcut:
@@ -945,10 +1178,23 @@ static int fd_set_xattrs(Item *i, int fd, const char *path, const struct stat *s
         xsprintf(procfs_path, "/proc/self/fd/%i", fd);
 
         STRV_FOREACH_PAIR(name, value, i->xattrs) {
+                _cleanup_free_ char *old = NULL;
+                size_t n;
+                int r;
+
+                n = strlen(*value);
+
+                r = getxattr_malloc(procfs_path, *name, &old, false);
+                if (r >= 0 && (size_t) r == n && memcmp(old, *value, n) == 0) {
+                        log_debug("Extended attribute '%s=%s' is set on %s already.", *name, *value, path);
+                        continue;
+                }
+
                 log_debug("Setting extended attribute '%s=%s' on %s.", *name, *value, path);
-                if (setxattr(procfs_path, *name, *value, strlen(*value), 0) < 0)
+                if (setxattr(procfs_path, *name, *value, n, 0) < 0)
                         return log_error_errno(errno, "Setting extended attribute %s=%s on %s failed: %m",
                                                *name, *value, path);
+                note_change();
         }
         return 0;
 }
@@ -988,7 +1234,7 @@ static int parse_acls_from_arg(Item *item) {
 #if HAVE_ACL
 static int path_set_acl(const char *path, const char *pretty, acl_type_t type, acl_t acl, bool modify) {
         _cleanup_(acl_free_charpp) char *t = NULL;
-        _cleanup_(acl_freep) acl_t dup = NULL;
+        _cleanup_(acl_freep) acl_t dup = NULL, old = NULL;
         int r;
 
         /* Returns 0 for success, positive error if already warned,
@@ -1015,6 +1261,15 @@ static int path_set_acl(const char *path, const char *pretty, acl_type_t type, a
                 return r;
 
         t = acl_to_any_text(dup, NULL, ',', TEXT_ABBREVIATE);
+
+        old = acl_get_file(path, type);
+        if (old && acl_cmp(old, dup) == 0) {
+                log_debug("%s ACL %s is set on %s already.",
+                          type == ACL_TYPE_ACCESS ? "Access" : "Default",
+                          strna(t), pretty);
+                return 0;
+        }
+
         log_debug("Setting %s ACL %s on %s.",
                   type == ACL_TYPE_ACCESS ? "access" : "default",
                   strna(t), pretty);
@@ -1027,6 +1282,7 @@ static int path_set_acl(const char *path, const char *pretty, acl_type_t type, a
                                         type == ACL_TYPE_ACCESS ? "access" : "default",
                                         strna(t), pretty);
 
+        note_change();
         return 0;
 }
 #endif
@@ -1237,6 +1493,8 @@ static int fd_set_attribute(Item *item, int fd, const char *path, const struct s
                                r,
                                "Cannot set file attribute for '%s', value=0x%08x, mask=0x%08x, ignoring: %m",
                                path, item->attribute_value, item->attribute_mask);
+        else if (r > 0)
+                note_change();
 
         return 0;
 }
@@ -1288,6 +1546,7 @@ static int write_one_file(Item *i, const char *path) {
         r = loop_write(fd, i->argument, strlen(i->argument), false);
         if (r < 0)
                 return log_error_errno(r, "Failed to write file \"%s\": %m", path);
+        note_change();
 
         return fd_set_perms(i, fd, path, NULL);
 }
@@ -1346,6 +1605,7 @@ static int create_file(Item *i, const char *path) {
         } else {
 
                 log_debug("\"%s\" has been created.", path);
+                note_change();
 
                 if (i->argument) {
                         log_debug("Writing to \"%s\".", path);
@@ -1425,6 +1685,7 @@ static int truncate_file(Item *i, const char *path) {
                         r = erofs ? -EROFS : -errno;
                         return log_error_errno(r, "Failed to truncate file %s: %m", path);
                 }
+                note_change();
         } else
                 st = &stbuf;
 
@@ -1438,6 +1699,7 @@ static int truncate_file(Item *i, const char *path) {
                         r = erofs ? -EROFS : r;
                         return log_error_errno(r, "Failed to write file %s: %m", path);
                 }
+                note_change();
         }
 
         return fd_set_perms(i, fd, path, st);
@@ -1486,7 +1748,8 @@ static int copy_files(Item *i) {
                         log_debug("Can't copy to %s, file exists already and is of different type", i->path);
                         return 0;
                 }
-        }
+        } else
+                note_change();
 
         fd = openat(dfd, bn, O_NOFOLLOW|O_CLOEXEC|O_PATH);
         if (fd < 0)
@@ -1567,8 +1830,10 @@ static int create_directory_or_subvolume(const char *path, mode_t mode, bool sub
                 }
 
                 *creation = CREATION_EXISTING;
-        } else
+        } else {
                 *creation = CREATION_NORMAL;
+                note_change();
+        }
 
         log_debug("%s directory \"%s\".", creation_mode_verb_to_string(*creation), path);
 
@@ -1717,6 +1982,9 @@ static int create_device(Item *i, mode_t file_type) {
         } else
                 creation = CREATION_NORMAL;
 
+        if (creation != CREATION_EXISTING)
+                note_change();
+
         log_debug("%s %s device node \"%s\" %u:%u.",
                   creation_mode_verb_to_string(creation),
                   i->type == CREATE_BLOCK_DEVICE ? "block" : "char",
@@ -1776,6 +2044,9 @@ static int create_fifo(Item *i, const char *path) {
         } else
                 creation = CREATION_NORMAL;
 
+        if (creation != CREATION_EXISTING)
+                note_change();
+
         log_debug("%s fifo \"%s\".", creation_mode_verb_to_string(creation), path);
 
         fd = openat(pfd, bn, O_NOFOLLOW|O_CLOEXEC|O_PATH);
@@ -1788,7 +2059,42 @@ static int create_fifo(Item *i, const char *path) {
 typedef int (*action_t)(Item *i, const char *path);
 typedef int (*fdaction_t)(Item *i, int fd, const char *path, const struct stat *st);
 
-static int item_do(Item *i, int fd, const char *path, fdaction_t action) {
+/* Recursive items are applied to subdirectories by a worker pool, to which each directory found on the way is
+ * offered. If the queue is full, the directory is handled right away by the thread that found it. */
+
+typedef struct RecurseContext {
+        Item *item;
+        fdaction_t action;
+        WorkerPool *pool;
+} RecurseContext;
+
+typedef struct RecurseJob {
+        int fd;
+        char *path;
+} RecurseJob;
+
+static void recurse_job_free(void *p) {
+        RecurseJob *j = p;
+
+        if (!j)
+                return;
+
+        safe_close(j->fd);
+        free(j->path);
+        free(j);
+}
+
+static int item_do(RecurseContext *c, int fd, const char *path);
+
+static int recurse_job_run(void *job, void *userdata) {
+        RecurseJob *j = job;
+
+        /* Pass ownership of the fd over */
+        return item_do(userdata, TAKE_FD(j->fd), j->path);
+}
+
+static int item_do(RecurseContext *c, int fd, const char *path) {
+        Item *i = c->item;
         struct stat st;
         int r = 0, q;
 
@@ -1803,7 +2109,7 @@ static int item_do(Item *i, int fd, const char *path, fdaction_t action) {
 
         /* This returns the first error we run into, but nevertheless
          * tries to go on */
-        r = action(i, fd, path, &st);
+        r = c->action(i, fd, path, &st);
 
         if (S_ISDIR(st.st_mode)) {
                 char procfs_path[STRLEN("/proc/self/fd/") + DECIMAL_STR_MAX(int)];
@@ -1835,11 +2141,32 @@ static int item_do(Item *i, int fd, const char *path, fdaction_t action) {
                                 _cleanup_free_ char *de_path = NULL;
 
                                 de_path = path_join(path, de->d_name);
-                                if (!de_path)
+                                if (!de_path) {
+                                        safe_close(de_fd);
                                         q = log_oom();
-                                else
+                                } else {
+                                        if (c->pool && de->d_type == DT_DIR) {
+                                                RecurseJob *j;
+
+                                                j = new(RecurseJob, 1);
+                                                if (j) {
+                                                        *j = (RecurseJob) {
+                                                                .fd = de_fd,
+                                                                .path = de_path,
+                                                        };
+
+                                                        if (worker_pool_try_add(c->pool, j)) {
+                                                                de_path = NULL;
+                                                                continue;
+                                                        }
+
+                                                        free(j);
+                                                }
+                                        }
+
                                         /* Pass ownership of dirent fd over */
-                                        q = item_do(i, de_fd, de_path, action);
+                                        q = item_do(c, de_fd, de_path);
+                                }
                         }
 
                         if (q < 0 && r == 0)
@@ -1875,6 +2202,10 @@ static int glob_item_recursively(Item *i, fdaction_t action) {
         _cleanup_globfree_ glob_t g = {
                 .gl_opendir = (void *(*)(const char *)) opendir_nomod,
         };
+        RecurseContext c = {
+                .item = i,
+                .action = action,
+        };
         int r = 0, k;
         char **fn;
 
@@ -1898,7 +2229,11 @@ static int glob_item_recursively(Item *i, fdaction_t action) {
                         continue;
                 }
 
-                k = item_do(i, fd, *fn, action);
+                /* Only start the threads once there's a directory to descend into */
+                if (!c.pool && is_dir_fd(fd) > 0)
+                        c.pool = worker_pool_new(recurse_job_run, recurse_job_free, &c);
+
+                k = item_do(&c, fd, *fn);
                 if (k < 0 && r == 0)
                         r = k;
 
@@ -1906,6 +2241,10 @@ static int glob_item_recursively(Item *i, fdaction_t action) {
                 fd = -1;
         }
 
+        k = worker_pool_finish(c.pool);
+        if (k < 0 && r == 0)
+                r = k;
+
         return r;
 }
 
@@ -2039,6 +2378,10 @@ static int create_item(Item *i) {
                 } else
 
                         creation = CREATION_NORMAL;
+
+                if (creation != CREATION_EXISTING)
+                        note_change();
+
                 log_debug("%s symlink \"%s\".", creation_mode_verb_to_string(creation), i->path);
                 break;
         }
@@ -2173,10 +2516,12 @@ static int remove_item(Item *i) {
 
 static int clean_item_instance(Item *i, const char* instance) {
         _cleanup_closedir_ DIR *d = NULL;
+        CleanupStats stats = {};
         struct stat s, ps;
         bool mountpoint;
         usec_t cutoff, n;
-        char timestamp[FORMAT_TIMESTAMP_MAX];
+        char timestamp[FORMAT_TIMESTAMP_MAX], bytes[FORMAT_BYTES_MAX];
+        int r;
 
         assert(i);
 
@@ -2216,8 +2561,15 @@ static int clean_item_instance(Item *i, const char* instance) {
                   instance,
                   format_timestamp_us(timestamp, sizeof(timestamp), cutoff));
 
-        return dir_cleanup(i, instance, d, &s, cutoff, s.st_dev, mountpoint,
-                           MAX_DEPTH, i->keep_first_level);
+        r = dir_cleanup(i, instance, d, &s, cutoff, s.st_dev, mountpoint,
+                        MAX_DEPTH, i->keep_first_level, true, &stats);
+
+        log_full(stats.n_removed > 0 ? LOG_INFO : LOG_DEBUG,
+                 "Cleaned up \"%s\": scanned %" PRIu64 " entries, removed %" PRIu64 ", freed %s.",
+                 instance, stats.n_scanned, stats.n_removed,
+                 format_bytes(bytes, sizeof(bytes), stats.n_bytes));
+
+        return r;
 }
 
 static int clean_item(Item *i) {
@@ -2263,7 +2615,18 @@ static int process_item(Item *i, OperationMask operation) {
         if (r < 0)
                 log_debug_errno(r, "Failed to determine whether '%s' is below autofs, ignoring: %m", i->path);
 
-        r = FLAGS_SET(operation, OPERATION_CREATE) ? create_item(i) : 0;
+        if (FLAGS_SET(operation, OPERATION_CREATE)) {
+                unsigned n = n_changes;
+
+                r = create_item(i);
+
+                if (n_changes != n)
+                        n_items_changed++;
+                else
+                        n_items_unchanged++;
+        } else
+                r = 0;
+
         /* Failure can only be tolerated for create */
         if (i->allow_failure)
                 r = 0;
@@ -3263,6 +3626,10 @@ static int run(int argc, char *argv[]) {
                 }
         }
 
+        if (FLAGS_SET(arg_operation, OPERATION_CREATE))
+                log_debug("Applied %u items: %u changed, %u in place already.",
+                          n_items_changed + n_items_unchanged, n_items_changed, n_items_unchanged);
+
         if (ERRNO_IS_RESOURCE(-r))
                 return r;
         if (invalid_config)
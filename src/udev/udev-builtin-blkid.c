@@ -12,21 +12,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 
 #include "sd-id128.h"
 
 #include "alloc-util.h"
 #include "blkid-util.h"
+#include "device-private.h"
 #include "device-util.h"
 #include "efivars.h"
+#include "escape.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "gpt.h"
+#include "mkdir.h"
 #include "parse-util.h"
 #include "string-util.h"
+#include "strv.h"
 #include "strxcpyx.h"
 #include "udev-builtin.h"
 
+/* Probe results are cached per device in this directory, keyed by the device number, the inode of the
+ * device node, the size and the disk sequence number. Change events for devices whose content did not
+ * change, as frequently seen for dm and multipath devices, are then served without reprobing. udevd removes
+ * the entry of a watched device when it is closed after writing, and of removed devices. */
+#define BLKID_CACHE_DIR "/run/udev/blkid"
+
+/* not a libblkid value, the UUID of the root partition found by find_gpt_root() */
+#define BLKID_GPT_AUTO_ROOT_UUID "GPT_AUTO_ROOT_UUID"
+
 static void print_property(sd_device *dev, bool test, const char *name, const char *value) {
         char s[256];
 
@@ -95,7 +111,7 @@ static void print_property(sd_device *dev, bool test, const char *name, const ch
         }
 }
 
-static int find_gpt_root(sd_device *dev, blkid_probe pr, bool test) {
+static int find_gpt_root(blkid_probe pr, char **ret) {
 
 #if defined(GPT_ROOT_NATIVE) && ENABLE_EFI
 
@@ -105,6 +121,7 @@ static int find_gpt_root(sd_device *dev, blkid_probe pr, bool test) {
         int i, nvals, r;
 
         assert(pr);
+        assert(ret);
 
         /* Iterate through the partitions on this disk, and see if the
          * EFI ESP we booted from is on it. If so, find the first root
@@ -172,10 +189,13 @@ static int find_gpt_root(sd_device *dev, blkid_probe pr, bool test) {
 
         /* We found the ESP on this disk, and also found a root
          * partition, nice! Let's export its UUID */
-        if (found_esp && root_id)
-                udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT_UUID", root_id);
+        if (found_esp && root_id) {
+                *ret = TAKE_PTR(root_id);
+                return 1;
+        }
 #endif
 
+        *ret = NULL;
         return 0;
 }
 
@@ -213,13 +233,212 @@ static int probe_superblocks(blkid_probe pr) {
         return blkid_do_safeprobe(pr);
 }
 
-static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
-        const char *devnode, *root_partition = NULL, *data, *name;
+static int blkid_cache_path(sd_device *dev, char **ret) {
+        const char *id;
+        char *p;
+        int r;
+
+        r = device_get_id_filename(dev, &id);
+        if (r < 0)
+                return r;
+
+        p = strjoin(BLKID_CACHE_DIR "/", id);
+        if (!p)
+                return -ENOMEM;
+
+        *ret = p;
+        return 0;
+}
+
+static int blkid_cache_key(sd_device *dev, int fd, int64_t offset, bool noraid, char **ret) {
+        const char *diskseq = "-";
+        struct stat st;
+        uint64_t size;
+
+        /* Only what can be had without reading from the device, so that a miss costs no more than probing
+         * alone. The device node is recreated when the device is, and changed media gets a new disk
+         * sequence number. Changed content is taken care of by dropping the entry, see above. */
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (!S_ISBLK(st.st_mode))
+                return -ENOTBLK;
+
+        if (ioctl(fd, BLKGETSIZE64, &size) < 0)
+                return -errno;
+
+        (void) sd_device_get_sysattr_value(dev, "diskseq", &diskseq);
+
+        if (asprintf(ret, "%u:%u %"PRIu64" %"PRIu64" %s %"PRIi64" %s",
+                     major(st.st_rdev), minor(st.st_rdev), (uint64_t) st.st_ino, size, diskseq,
+                     offset, noraid ? "noraid" : "raid") < 0)
+                return -ENOMEM;
+
+        return 0;
+}
+
+static int blkid_cache_load(sd_device *dev, const char *key, char ***ret) {
+        _cleanup_free_ char *path = NULL, *contents = NULL;
+        _cleanup_strv_free_ char **lines = NULL, **values = NULL;
+        char **l;
+        int r;
+
+        r = blkid_cache_path(dev, &path);
+        if (r < 0)
+                return r;
+
+        r = read_full_file(path, &contents, NULL);
+        if (r == -ENOENT)
+                return 0;
+        if (r < 0)
+                return r;
+
+        lines = strv_split_newlines(contents);
+        if (!lines)
+                return -ENOMEM;
+
+        if (!streq_ptr(lines[0], key))
+                return 0;
+
+        STRV_FOREACH(l, lines + 1) {
+                _cleanup_free_ char *name = NULL, *value = NULL;
+                const char *eq;
+
+                eq = strchr(*l, '=');
+                if (!eq)
+                        return -EBADMSG;
+
+                name = strndup(*l, eq - *l);
+                if (!name)
+                        return -ENOMEM;
+
+                r = cunescape(eq + 1, 0, &value);
+                if (r < 0)
+                        return r;
+
+                r = strv_consume_pair(&values, TAKE_PTR(name), TAKE_PTR(value));
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(values);
+        return 1;
+}
+
+static int blkid_cache_save(sd_device *dev, const char *key, char **values) {
+        _cleanup_free_ char *path = NULL, *contents = NULL;
+        char **name, **value;
+        int r;
+
+        r = blkid_cache_path(dev, &path);
+        if (r < 0)
+                return r;
+
+        contents = strjoin(key, "\n");
+        if (!contents)
+                return -ENOMEM;
+
+        STRV_FOREACH_PAIR(name, value, values) {
+                _cleanup_free_ char *e = NULL;
+
+                e = cescape(*value);
+                if (!e)
+                        return -ENOMEM;
+
+                if (!strextend(&contents, *name, "=", e, "\n", NULL))
+                        return -ENOMEM;
+        }
+
+        r = mkdir_parents(path, 0755);
+        if (r < 0)
+                return r;
+
+        return write_string_file(path, contents, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC|WRITE_STRING_FILE_AVOID_NEWLINE);
+}
+
+int udev_builtin_blkid_cache_remove(sd_device *dev) {
+        _cleanup_free_ char *path = NULL;
+        int r;
+
+        r = blkid_cache_path(dev, &path);
+        if (r < 0)
+                return r;
+
+        if (unlink(path) < 0 && errno != ENOENT)
+                return -errno;
+
+        return 0;
+}
+
+static int blkid_probe_values(sd_device *dev, int fd, int64_t offset, bool noraid, char ***ret) {
         _cleanup_(blkid_free_probep) blkid_probe pr = NULL;
-        bool noraid = false, is_gpt = false;
+        _cleanup_strv_free_ char **values = NULL;
+        const char *data, *name;
+        bool is_gpt = false;
+        int nvals, i, r;
+
+        errno = 0;
+        pr = blkid_new_probe();
+        if (!pr)
+                return log_device_debug_errno(dev, errno > 0 ? errno : ENOMEM, "Failed to create blkid prober: %m");
+
+        blkid_probe_set_superblocks_flags(pr,
+                BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+                BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
+                BLKID_SUBLKS_USAGE | BLKID_SUBLKS_VERSION);
+
+        if (noraid)
+                blkid_probe_filter_superblocks_usage(pr, BLKID_FLTR_NOTIN, BLKID_USAGE_RAID);
+
+        errno = 0;
+        r = blkid_probe_set_device(pr, fd, offset, 0);
+        if (r < 0)
+                return log_device_debug_errno(dev, errno > 0 ? errno : ENOMEM, "Failed to set device to blkid prober: %m");
+
+        r = probe_superblocks(pr);
+        if (r < 0)
+                return log_device_debug_errno(dev, r, "Failed to probe superblocks: %m");
+
+        errno = 0;
+        nvals = blkid_probe_numof_values(pr);
+        if (nvals < 0)
+                return log_device_debug_errno(dev, errno > 0 ? errno : ENOMEM, "Failed to get number of probed values: %m");
+
+        for (i = 0; i < nvals; i++) {
+                if (blkid_probe_get_value(pr, i, &name, &data, NULL) < 0)
+                        continue;
+
+                if (strv_extend(&values, name) < 0 ||
+                    strv_extend(&values, data) < 0)
+                        return log_oom();
+
+                /* Is this a disk with GPT partition table? */
+                if (streq(name, "PTTYPE") && streq(data, "gpt"))
+                        is_gpt = true;
+        }
+
+        if (is_gpt) {
+                _cleanup_free_ char *root_id = NULL;
+
+                if (find_gpt_root(pr, &root_id) > 0 &&
+                    (strv_extend(&values, BLKID_GPT_AUTO_ROOT_UUID) < 0 ||
+                     strv_extend(&values, root_id) < 0))
+                        return log_oom();
+        }
+
+        *ret = TAKE_PTR(values);
+        return 0;
+}
+
+static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
+        const char *devnode, *root_partition = NULL;
+        _cleanup_strv_free_ char **values = NULL;
+        _cleanup_free_ char *key = NULL;
         _cleanup_close_ int fd = -1;
+        bool noraid = false, cached = false;
         int64_t offset = 0;
-        int nvals, i, r;
+        char **name, **data;
+        int r;
 
         static const struct option options[] = {
                 { "offset", required_argument, NULL, 'o' },
@@ -248,19 +467,6 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
                 }
         }
 
-        errno = 0;
-        pr = blkid_new_probe();
-        if (!pr)
-                return log_device_debug_errno(dev, errno > 0 ? errno : ENOMEM, "Failed to create blkid prober: %m");
-
-        blkid_probe_set_superblocks_flags(pr,
-                BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-                BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
-                BLKID_SUBLKS_USAGE | BLKID_SUBLKS_VERSION);
-
-        if (noraid)
-                blkid_probe_filter_superblocks_usage(pr, BLKID_FLTR_NOTIN, BLKID_USAGE_RAID);
-
         r = sd_device_get_devname(dev, &devnode);
         if (r < 0)
                 return log_device_debug_errno(dev, r, "Failed to get device name: %m");
@@ -269,44 +475,50 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
         if (fd < 0)
                 return log_device_debug_errno(dev, errno, "Failed to open block device %s: %m", devnode);
 
-        errno = 0;
-        r = blkid_probe_set_device(pr, fd, offset, 0);
+        r = blkid_cache_key(dev, fd, offset, noraid, &key);
         if (r < 0)
-                return log_device_debug_errno(dev, errno > 0 ? errno : ENOMEM, "Failed to set device to blkid prober: %m");
+                log_device_debug_errno(dev, r, "Failed to identify %s, not using cached probe results: %m", devnode);
+        else {
+                r = blkid_cache_load(dev, key, &values);
+                if (r < 0)
+                        log_device_debug_errno(dev, r, "Failed to read cached probe results, ignoring: %m");
+                else if (r > 0) {
+                        log_device_debug(dev, "%s is unchanged, using cached probe results", devnode);
+                        cached = true;
+                }
+        }
 
-        log_device_debug(dev, "Probe %s with %sraid and offset=%"PRIi64, devnode, noraid ? "no" : "", offset);
+        if (!cached) {
+                log_device_debug(dev, "Probe %s with %sraid and offset=%"PRIi64, devnode, noraid ? "no" : "", offset);
 
-        r = probe_superblocks(pr);
-        if (r < 0)
-                return log_device_debug_errno(dev, r, "Failed to probe superblocks: %m");
+                r = blkid_probe_values(dev, fd, offset, noraid, &values);
+                if (r < 0)
+                        return r;
+
+                if (key && !test) {
+                        r = blkid_cache_save(dev, key, values);
+                        if (r < 0)
+                                log_device_debug_errno(dev, r, "Failed to cache probe results, ignoring: %m");
+                }
+        }
 
         /* If the device is a partition then its parent passed the root partition UUID to the device */
         (void) sd_device_get_property_value(dev, "ID_PART_GPT_AUTO_ROOT_UUID", &root_partition);
 
-        errno = 0;
-        nvals = blkid_probe_numof_values(pr);
-        if (nvals < 0)
-                return log_device_debug_errno(dev, errno > 0 ? errno : ENOMEM, "Failed to get number of probed values: %m");
-
-        for (i = 0; i < nvals; i++) {
-                if (blkid_probe_get_value(pr, i, &name, &data, NULL) < 0)
+        STRV_FOREACH_PAIR(name, data, values) {
+                if (streq(*name, BLKID_GPT_AUTO_ROOT_UUID)) {
+                        udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT_UUID", *data);
                         continue;
+                }
 
-                print_property(dev, test, name, data);
-
-                /* Is this a disk with GPT partition table? */
-                if (streq(name, "PTTYPE") && streq(data, "gpt"))
-                        is_gpt = true;
+                print_property(dev, test, *name, *data);
 
                 /* Is this a partition that matches the root partition
                  * property inherited from the parent? */
-                if (root_partition && streq(name, "PART_ENTRY_UUID") && streq(data, root_partition))
+                if (root_partition && streq(*name, "PART_ENTRY_UUID") && streq(*data, root_partition))
                         udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT", "1");
         }
 
-        if (is_gpt)
-                find_gpt_root(dev, pr, test);
-
         return 0;
 }
 
@@ -255,4 +255,5 @@ const struct udev_builtin udev_builtin_keyboard = {
         .name = "keyboard",
         .cmd = builtin_keyboard,
         .help = "Keyboard scan code to key mapping",
+        .modifies_system = true,
 };
@@ -74,4 +74,5 @@ const struct udev_builtin udev_builtin_kmod = {
         .validate = builtin_kmod_validate,
         .help = "Kernel module loader",
         .run_once = false,
+        .modifies_system = true,
 };
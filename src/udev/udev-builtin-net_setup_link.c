@@ -82,4 +82,5 @@ const struct udev_builtin udev_builtin_net_setup_link = {
         .validate = builtin_net_setup_link_validate,
         .help = "Configure network link",
         .run_once = false,
+        .modifies_system = true,
 };
@@ -77,4 +77,5 @@ const struct udev_builtin udev_builtin_uaccess = {
         .name = "uaccess",
         .cmd = builtin_uaccess,
         .help = "Manage device node user ACL",
+        .modifies_system = true,
 };
@@ -12,6 +12,10 @@
 
 static bool initialized;
 
+/* When benchmarking, builtins are timed, and those which modify the system are not run */
+static bool benchmark;
+static UdevBuiltinStats stats[_UDEV_BUILTIN_MAX];
+
 static const struct udev_builtin *builtins[_UDEV_BUILTIN_MAX] = {
 #if HAVE_BLKID
         [UDEV_BUILTIN_BLKID] = &udev_builtin_blkid,
@@ -108,8 +112,21 @@ enum udev_builtin_cmd udev_builtin_lookup(const char *command) {
         return _UDEV_BUILTIN_INVALID;
 }
 
+void udev_builtin_set_benchmark(bool b) {
+        benchmark = b;
+}
+
+void udev_builtin_get_stats(enum udev_builtin_cmd cmd, UdevBuiltinStats *ret) {
+        assert(cmd >= 0 && cmd < _UDEV_BUILTIN_MAX);
+        assert(ret);
+
+        *ret = stats[cmd];
+}
+
 int udev_builtin_run(sd_device *dev, enum udev_builtin_cmd cmd, const char *command, bool test) {
         _cleanup_strv_free_ char **argv = NULL;
+        usec_t start;
+        int r;
 
         assert(dev);
         assert(cmd >= 0 && cmd < _UDEV_BUILTIN_MAX);
@@ -118,13 +135,28 @@ int udev_builtin_run(sd_device *dev, enum udev_builtin_cmd cmd, const char *comm
         if (!builtins[cmd])
                 return -EOPNOTSUPP;
 
+        if (benchmark && builtins[cmd]->modifies_system) {
+                log_device_debug(dev, "Benchmarking, not running builtin '%s'", builtins[cmd]->name);
+                stats[cmd].n_skipped++;
+                return 0;
+        }
+
         argv = strv_split_full(command, NULL, SPLIT_QUOTES | SPLIT_RELAX);
         if (!argv)
                 return -ENOMEM;
 
+        start = benchmark ? now(CLOCK_MONOTONIC) : 0;
+
         /* we need '0' here to reset the internal state */
         optind = 0;
-        return builtins[cmd]->cmd(dev, strv_length(argv), argv, test);
+        r = builtins[cmd]->cmd(dev, strv_length(argv), argv, test);
+
+        if (benchmark) {
+                stats[cmd].n_runs++;
+                stats[cmd].usec += usec_sub_unsigned(now(CLOCK_MONOTONIC), start);
+        }
+
+        return r;
 }
 
 int udev_builtin_add_property(sd_device *dev, bool test, const char *key, const char *val) {
@@ -5,6 +5,8 @@
 
 #include "sd-device.h"
 
+#include "time-util.h"
+
 enum udev_builtin_cmd {
 #if HAVE_BLKID
         UDEV_BUILTIN_BLKID,
@@ -35,8 +37,15 @@ struct udev_builtin {
         void (*exit)(void);
         bool (*validate)(void);
         bool run_once;
+        bool modifies_system; /* skipped when benchmarking */
 };
 
+typedef struct UdevBuiltinStats {
+        unsigned n_runs;
+        unsigned n_skipped;
+        usec_t usec;
+} UdevBuiltinStats;
+
 #if HAVE_BLKID
 extern const struct udev_builtin udev_builtin_blkid;
 #endif
@@ -63,6 +72,15 @@ bool udev_builtin_run_once(enum udev_builtin_cmd cmd);
 int udev_builtin_run(sd_device *dev, enum udev_builtin_cmd cmd, const char *command, bool test);
 void udev_builtin_list(void);
 bool udev_builtin_validate(void);
+void udev_builtin_set_benchmark(bool b);
+void udev_builtin_get_stats(enum udev_builtin_cmd cmd, UdevBuiltinStats *ret);
 int udev_builtin_add_property(sd_device *dev, bool test, const char *key, const char *val);
 int udev_builtin_hwdb_lookup(sd_device *dev, const char *prefix, const char *modalias,
                              const char *filter, bool test);
+#if HAVE_BLKID
+int udev_builtin_blkid_cache_remove(sd_device *dev);
+#else
+static inline int udev_builtin_blkid_cache_remove(sd_device *dev) {
+        return 0;
+}
+#endif
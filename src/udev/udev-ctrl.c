@@ -47,7 +47,7 @@ struct udev_ctrl_msg_wire {
         enum udev_ctrl_msg_type type;
         union {
                 int intval;
-                char buf[256];
+                char buf[UDEV_CTRL_MSG_BUF_SIZE];
         };
 };
 
@@ -213,7 +213,7 @@ static struct udev_ctrl_connection *udev_ctrl_connection_free(struct udev_ctrl_c
 
 DEFINE_TRIVIAL_REF_UNREF_FUNC(struct udev_ctrl_connection, udev_ctrl_connection, udev_ctrl_connection_free);
 
-static int ctrl_send(struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, int intval, const char *buf, int timeout) {
+static int ctrl_send(struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, int intval, const char *buf, int timeout, char **ret_reply) {
         struct udev_ctrl_msg_wire ctrl_msg_wire = {
                 .version = "udev-" STRINGIFY(PROJECT_VERSION),
                 .magic = UDEV_CTRL_MAGIC,
@@ -251,40 +251,63 @@ static int ctrl_send(struct udev_ctrl *uctrl, enum udev_ctrl_msg_type type, int
                         return -ETIMEDOUT;
                 if (pfd.revents & POLLERR)
                         return -EIO;
-                return 0;
+                break;
         }
+
+        if (ret_reply) {
+                struct udev_ctrl_msg_wire reply = {};
+                ssize_t size;
+
+                /* Older daemons just close the connection without replying, hence a missing reply is not
+                 * an error. */
+                size = recv(uctrl->sock, &reply, sizeof(reply), MSG_DONTWAIT);
+                if (size < 0 && !IN_SET(errno, EAGAIN, ECONNRESET))
+                        return -errno;
+                if (size == sizeof(reply) && reply.magic == UDEV_CTRL_MAGIC && reply.type == type) {
+                        char *p;
+
+                        p = strndup(reply.buf, sizeof(reply.buf));
+                        if (!p)
+                                return -ENOMEM;
+
+                        *ret_reply = p;
+                } else
+                        *ret_reply = NULL;
+        }
+
+        return 0;
 }
 
 int udev_ctrl_send_set_log_level(struct udev_ctrl *uctrl, int priority, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_SET_LOG_LEVEL, priority, NULL, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_SET_LOG_LEVEL, priority, NULL, timeout, NULL);
 }
 
 int udev_ctrl_send_stop_exec_queue(struct udev_ctrl *uctrl, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_STOP_EXEC_QUEUE, 0, NULL, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_STOP_EXEC_QUEUE, 0, NULL, timeout, NULL);
 }
 
 int udev_ctrl_send_start_exec_queue(struct udev_ctrl *uctrl, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_START_EXEC_QUEUE, 0, NULL, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_START_EXEC_QUEUE, 0, NULL, timeout, NULL);
 }
 
 int udev_ctrl_send_reload(struct udev_ctrl *uctrl, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_RELOAD, 0, NULL, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_RELOAD, 0, NULL, timeout, NULL);
 }
 
 int udev_ctrl_send_set_env(struct udev_ctrl *uctrl, const char *key, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_SET_ENV, 0, key, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_SET_ENV, 0, key, timeout, NULL);
 }
 
 int udev_ctrl_send_set_children_max(struct udev_ctrl *uctrl, int count, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_SET_CHILDREN_MAX, count, NULL, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_SET_CHILDREN_MAX, count, NULL, timeout, NULL);
 }
 
-int udev_ctrl_send_ping(struct udev_ctrl *uctrl, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_PING, 0, NULL, timeout);
+int udev_ctrl_send_ping(struct udev_ctrl *uctrl, int timeout, char **ret_status) {
+        return ctrl_send(uctrl, UDEV_CTRL_PING, 0, NULL, timeout, ret_status);
 }
 
 int udev_ctrl_send_exit(struct udev_ctrl *uctrl, int timeout) {
-        return ctrl_send(uctrl, UDEV_CTRL_EXIT, 0, NULL, timeout);
+        return ctrl_send(uctrl, UDEV_CTRL_EXIT, 0, NULL, timeout, NULL);
 }
 
 struct udev_ctrl_msg *udev_ctrl_receive_msg(struct udev_ctrl_connection *conn) {
@@ -420,6 +443,27 @@ int udev_ctrl_get_ping(struct udev_ctrl_msg *ctrl_msg) {
         return -1;
 }
 
+int udev_ctrl_reply_ping(struct udev_ctrl_msg *ctrl_msg, const char *status) {
+        struct udev_ctrl_msg_wire ctrl_msg_wire = {
+                .version = "udev-" STRINGIFY(PROJECT_VERSION),
+                .magic = UDEV_CTRL_MAGIC,
+                .type = UDEV_CTRL_PING,
+        };
+
+        assert(ctrl_msg);
+        assert(status);
+
+        if (ctrl_msg->ctrl_msg_wire.type != UDEV_CTRL_PING)
+                return -EINVAL;
+
+        strscpy(ctrl_msg_wire.buf, sizeof(ctrl_msg_wire.buf), status);
+
+        if (send(ctrl_msg->conn->sock, &ctrl_msg_wire, sizeof(ctrl_msg_wire), MSG_DONTWAIT|MSG_NOSIGNAL) < 0)
+                return -errno;
+
+        return 0;
+}
+
 int udev_ctrl_get_exit(struct udev_ctrl_msg *ctrl_msg) {
         if (ctrl_msg->ctrl_msg_wire.type == UDEV_CTRL_EXIT)
                 return 1;
@@ -3,6 +3,9 @@
 
 #include "macro.h"
 
+/* The size of the string field of a control message, which limits the status sent in reply to a ping */
+#define UDEV_CTRL_MSG_BUF_SIZE 256
+
 struct udev_ctrl;
 struct udev_ctrl *udev_ctrl_new(void);
 struct udev_ctrl *udev_ctrl_new_from_fd(int fd);
@@ -14,7 +17,7 @@ int udev_ctrl_send_set_log_level(struct udev_ctrl *uctrl, int priority, int time
 int udev_ctrl_send_stop_exec_queue(struct udev_ctrl *uctrl, int timeout);
 int udev_ctrl_send_start_exec_queue(struct udev_ctrl *uctrl, int timeout);
 int udev_ctrl_send_reload(struct udev_ctrl *uctrl, int timeout);
-int udev_ctrl_send_ping(struct udev_ctrl *uctrl, int timeout);
+int udev_ctrl_send_ping(struct udev_ctrl *uctrl, int timeout, char **ret_status);
 int udev_ctrl_send_exit(struct udev_ctrl *uctrl, int timeout);
 int udev_ctrl_send_set_env(struct udev_ctrl *uctrl, const char *key, int timeout);
 int udev_ctrl_send_set_children_max(struct udev_ctrl *uctrl, int count, int timeout);
@@ -32,6 +35,7 @@ int udev_ctrl_get_stop_exec_queue(struct udev_ctrl_msg *ctrl_msg);
 int udev_ctrl_get_start_exec_queue(struct udev_ctrl_msg *ctrl_msg);
 int udev_ctrl_get_reload(struct udev_ctrl_msg *ctrl_msg);
 int udev_ctrl_get_ping(struct udev_ctrl_msg *ctrl_msg);
+int udev_ctrl_reply_ping(struct udev_ctrl_msg *ctrl_msg, const char *status);
 int udev_ctrl_get_exit(struct udev_ctrl_msg *ctrl_msg);
 const char *udev_ctrl_get_set_env(struct udev_ctrl_msg *ctrl_msg);
 int udev_ctrl_get_set_children_max(struct udev_ctrl_msg *ctrl_msg);
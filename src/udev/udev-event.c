@@ -789,8 +789,10 @@ static void event_execute_rules_on_remove(
         if (r < 0)
                 log_device_debug_errno(dev, r, "Failed to delete database under /run/udev/data/, ignoring: %m");
 
-        if (sd_device_get_devnum(dev, NULL) >= 0)
+        if (sd_device_get_devnum(dev, NULL) >= 0) {
                 (void) udev_watch_end(dev);
+                (void) udev_builtin_blkid_cache_remove(dev);
+        }
 
         (void) udev_rules_apply_to_event(rules, event, timeout_usec, properties_list);
 
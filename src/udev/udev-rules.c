@@ -10,9 +10,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "sd-id128.h"
+
 #include "alloc-util.h"
 #include "conf-files.h"
 #include "device-private.h"
@@ -28,6 +32,7 @@
 #include "parse-util.h"
 #include "path-util.h"
 #include "proc-cmdline.h"
+#include "siphash24.h"
 #include "stat-util.h"
 #include "stdio-util.h"
 #include "strbuf.h"
@@ -35,6 +40,7 @@
 #include "strv.h"
 #include "strxcpyx.h"
 #include "sysctl-util.h"
+#include "tmpfile-util.h"
 #include "udev-builtin.h"
 #include "udev.h"
 #include "user-util.h"
@@ -42,6 +48,10 @@
 
 #define PREALLOC_TOKEN          2048
 
+#define RULES_CACHE_PATH        "/run/udev/rules.bin"
+#define RULES_CACHE_SIG         { 'U', 'D', 'E', 'V', 'R', 'U', 'L', 'E' }
+#define RULES_CACHE_HASH_KEY    SD_ID128_MAKE(5c,0f,8e,a5,2b,61,4a,93,b4,e2,7d,19,c8,36,f0,4e)
+
 struct uid_gid {
         unsigned name_off;
         union {
@@ -69,6 +79,26 @@ struct UdevRules {
         /* all key strings are copied and de-duplicated in a single continuous string buffer */
         struct strbuf *strbuf;
 
+        /* rules indexed by their leading literal matches, sorted by type, value and position */
+        struct rule_index_entry *index;
+        size_t n_index;
+        size_t index_allocated;
+
+        /* ATTRS{} keys with a fixed attribute name, mapped to their slot in the per-event parent attribute cache */
+        Hashmap *parent_attrs;
+
+        /* when loaded from the compiled rules cache, tokens, index and strings point into this mapping */
+        void *map;
+        size_t map_size;
+        const char *map_strings;
+
+        /* when benchmarking, the time spent in each rules file, and which of them was used last */
+        bool benchmark;
+        UdevRulesFileStats *file_stats;
+        size_t n_file_stats;
+        size_t file_stats_allocated;
+        size_t file_stats_last;
+
         /* during rule parsing, uid/gid lookup results are cached */
         struct uid_gid *uids;
         unsigned uids_cur;
@@ -79,6 +109,9 @@ struct UdevRules {
 };
 
 static char *rules_str(UdevRules *rules, unsigned off) {
+        if (rules->map)
+                return (char*) rules->map_strings + off;
+
         return rules->strbuf->buf + off;
 }
 
@@ -214,6 +247,33 @@ struct token {
         };
 };
 
+/* A rule that contains a literal SUBSYSTEM==, KERNEL== or ACTION== match can only ever apply to events with that
+ * value. Such rules are indexed by one of those values, so that while processing an event all rules for other values
+ * can be skipped without looking at their tokens. All other rules are indexed with type TK_UNSET, and apply to every
+ * event. */
+struct rule_index_entry {
+        enum token_type type;
+        unsigned value_off;
+        unsigned rule;
+};
+
+struct rule_index_range {
+        const struct rule_index_entry *cur;
+        const struct rule_index_entry *end;
+};
+
+/* While an event is processed, the parent devices looked at by KERNELS==, ATTRS== and friends are remembered,
+ * together with the ATTRS{} attributes they turned out not to have. Many rules look for the same attribute
+ * on the same parents, hence they don't need to walk the chain and look it up over and over again. */
+#define PARENT_CHAIN_MAX      64
+struct parent_chain {
+        sd_device *devices[PARENT_CHAIN_MAX];
+        size_t n_devices;
+        bool complete;
+        /* indexed by parent_attrs slot, bit N is set if devices[N] does not have the attribute */
+        uint64_t *missing;
+};
+
 #define MAX_TK                64
 struct rule_tmp {
         UdevRules *rules;
@@ -323,7 +383,7 @@ static void dump_token(UdevRules *rules, struct token *token) {
         enum operation_type op = token->key.op;
         enum string_glob_type glob = token->key.glob;
         const char *value = rules_str(rules, token->key.value_off);
-        const char *attr = &rules->strbuf->buf[token->key.attr_off];
+        const char *attr = rules_str(rules, token->key.attr_off);
 
         switch (type) {
         case TK_RULE:
@@ -333,9 +393,9 @@ static void dump_token(UdevRules *rules, struct token *token) {
                         unsigned idx = (tk_ptr - tks_ptr) / sizeof(struct token);
 
                         log_debug("* RULE %s:%u, token: %u, count: %u, label: '%s'",
-                                  &rules->strbuf->buf[token->rule.filename_off], token->rule.filename_line,
+                                  rules_str(rules, token->rule.filename_off), token->rule.filename_line,
                                   idx, token->rule.token_count,
-                                  &rules->strbuf->buf[token->rule.label_off]);
+                                  rules_str(rules, token->rule.label_off));
                         break;
                 }
         case TK_M_ACTION:
@@ -1514,9 +1574,404 @@ static int parse_file(UdevRules *rules, const char *filename) {
         return 0;
 }
 
+static int rule_index_compare_key(UdevRules *rules, const struct rule_index_entry *e, enum token_type type, const char *value) {
+        int r;
+
+        r = CMP(e->type, type);
+        if (r != 0)
+                return r;
+
+        /* unindexed rules have no value */
+        if (type == TK_UNSET)
+                return 0;
+
+        return strcmp(rules_str(rules, e->value_off), value);
+}
+
+static int rule_index_compare(const struct rule_index_entry *a, const struct rule_index_entry *b, UdevRules *rules) {
+        int r;
+
+        r = rule_index_compare_key(rules, a, b->type, rules_str(rules, b->value_off));
+        if (r != 0)
+                return r;
+
+        return CMP(a->rule, b->rule);
+}
+
+static int rule_index_add(UdevRules *rules, enum token_type type, unsigned value_off, unsigned rule) {
+        if (!GREEDY_REALLOC(rules->index, rules->index_allocated, rules->n_index + 1))
+                return -ENOMEM;
+
+        rules->index[rules->n_index++] = (struct rule_index_entry) {
+                .type = type,
+                .value_off = value_off,
+                .rule = rule,
+        };
+
+        return 0;
+}
+
+static int rule_index_add_rule(UdevRules *rules, unsigned rule) {
+        struct token *key = NULL;
+        const char *value, *p;
+        unsigned i;
+
+        /* The match tokens of a rule are sorted by type, hence ACTION, KERNEL and SUBSYSTEM are among the first
+         * ones. Prefer the last suitable one, since SUBSYSTEM and KERNEL tend to be more selective than ACTION. */
+        for (i = 1; i < rules->tokens[rule].rule.token_count; i++) {
+                struct token *t = &rules->tokens[rule + i];
+
+                if (t->type > TK_M_SUBSYSTEM)
+                        break;
+                if (!IN_SET(t->type, TK_M_ACTION, TK_M_KERNEL, TK_M_SUBSYSTEM))
+                        continue;
+                if (t->key.op != OP_MATCH || !IN_SET(t->key.glob, GL_PLAIN, GL_SPLIT))
+                        continue;
+
+                /* an empty alternative matches an empty value, which we do not index */
+                value = rules_str(rules, t->key.value_off);
+                if (isempty(value) || startswith(value, "|") || endswith(value, "|") || strstr(value, "||"))
+                        continue;
+
+                key = t;
+        }
+
+        if (!key)
+                return rule_index_add(rules, TK_UNSET, 0, rule);
+
+        if (key->key.glob == GL_PLAIN)
+                return rule_index_add(rules, key->type, key->key.value_off, rule);
+
+        /* A|B → index the rule once for each alternative */
+        for (p = rules_str(rules, key->key.value_off);;) {
+                _cleanup_free_ char *alternative = NULL;
+                size_t n;
+                int r;
+
+                n = strcspn(p, "|");
+                alternative = strndup(p, n);
+                if (!alternative)
+                        return -ENOMEM;
+
+                /* rules_add_string() might reallocate the string buffer, so remember where we are */
+                p += n;
+                i = p - rules->strbuf->buf;
+
+                r = rule_index_add(rules, key->type, rules_add_string(rules, alternative), rule);
+                if (r < 0)
+                        return r;
+
+                p = rules->strbuf->buf + i;
+                if (*p == '\0')
+                        return 0;
+                p++;
+        }
+}
+
+static int rule_index_build(UdevRules *rules) {
+        size_t i, j;
+        unsigned rule;
+        int r;
+
+        for (rule = 0; rules->tokens[rule].type == TK_RULE; rule += rules->tokens[rule].rule.token_count) {
+                r = rule_index_add_rule(rules, rule);
+                if (r < 0)
+                        return r;
+        }
+
+        typesafe_qsort_r(rules->index, rules->n_index, rule_index_compare, rules);
+
+        /* A|A or A|B|A list the same rule twice, drop the duplicates */
+        for (i = j = 0; i < rules->n_index; i++) {
+                if (j > 0 && rule_index_compare(&rules->index[j - 1], &rules->index[i], rules) == 0)
+                        continue;
+
+                rules->index[j++] = rules->index[i];
+        }
+        rules->n_index = j;
+
+        return 0;
+}
+
+static int parent_attrs_build(UdevRules *rules) {
+        unsigned i;
+        int r;
+
+        /* Strings are de-duplicated, hence the offset of the attribute name identifies it */
+        for (i = 0; rules->tokens[i].type != TK_END; i++) {
+                const struct token *t = &rules->tokens[i];
+
+                if (t->type != TK_M_ATTRS || t->key.attrsubst != SB_NONE)
+                        continue;
+
+                r = hashmap_ensure_allocated(&rules->parent_attrs, NULL);
+                if (r < 0)
+                        return r;
+
+                r = hashmap_put(rules->parent_attrs, UINT_TO_PTR(t->key.attr_off),
+                                UINT_TO_PTR(hashmap_size(rules->parent_attrs) + 1));
+                if (r < 0 && r != -EEXIST)
+                        return r;
+        }
+
+        return 0;
+}
+
+static void rule_index_lookup(UdevRules *rules, enum token_type type, const char *value, struct rule_index_range *ret) {
+        size_t lo = 0, hi = rules->n_index, end;
+
+        assert(ret);
+
+        if (type != TK_UNSET && !value) {
+                *ret = (struct rule_index_range) {};
+                return;
+        }
+
+        /* find the first entry with this type and value */
+        while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+
+                if (rule_index_compare_key(rules, &rules->index[mid], type, value) < 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        /* and the first one after them */
+        end = lo;
+        hi = rules->n_index;
+        while (end < hi) {
+                size_t mid = (end + hi) / 2;
+
+                if (rule_index_compare_key(rules, &rules->index[mid], type, value) <= 0)
+                        end = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        *ret = (struct rule_index_range) {
+                .cur = rules->index + lo,
+                .end = rules->index + end,
+        };
+}
+
+/* Returns the position of the first rule at or after 'pos' that is in any of the ranges, or the one of TK_END. */
+static unsigned rule_index_next(UdevRules *rules, struct rule_index_range *ranges, size_t n_ranges, unsigned pos) {
+        unsigned next = rules->token_cur - 1;
+        size_t i;
+
+        for (i = 0; i < n_ranges; i++) {
+                struct rule_index_range *r = ranges + i;
+
+                while (r->cur < r->end && r->cur->rule < pos)
+                        r->cur++;
+
+                if (r->cur < r->end && r->cur->rule < next)
+                        next = r->cur->rule;
+        }
+
+        return next;
+}
+
+/* The on-disk format of the compiled rules: the header is followed by the tokens, the index entries and the strings.
+ * These are stored in the in-memory format of the running binary, hence a cache is only ever valid for the very same
+ * build of udev, and is simply rebuilt otherwise. */
+struct rules_cache_header {
+        uint8_t signature[8];
+
+        /* version of the tool which created the file */
+        uint64_t tool_version;
+        uint64_t file_size;
+
+        /* sizes of the structures, and the number of token types, to catch changes of the format */
+        uint64_t header_size;
+        uint64_t token_size;
+        uint64_t index_entry_size;
+        uint64_t token_types;
+
+        /* hash over the state of everything the rules were compiled from, see rules_cache_stamp() */
+        uint64_t stamp;
+
+        uint64_t tokens_count;
+        uint64_t index_count;
+        uint64_t strings_len;
+} _packed_;
+
+static void rules_cache_stamp_file(struct siphash *state, const char *path, const struct stat *st) {
+        uint64_t v;
+
+        siphash24_compress(path, strlen(path) + 1, state);
+        siphash24_compress(&st->st_dev, sizeof(st->st_dev), state);
+        siphash24_compress(&st->st_ino, sizeof(st->st_ino), state);
+        siphash24_compress(&st->st_size, sizeof(st->st_size), state);
+        v = timespec_load_nsec(&st->st_mtim);
+        siphash24_compress(&v, sizeof(v), state);
+}
+
+static int rules_cache_stamp(char **files, ResolveNameTiming resolve_name_timing, uint64_t *ret) {
+        struct siphash state;
+        const char *p;
+        char **f;
+
+        assert(ret);
+
+        siphash24_init(&state, RULES_CACHE_HASH_KEY.bytes);
+        siphash24_compress(&resolve_name_timing, sizeof(resolve_name_timing), &state);
+
+        STRV_FOREACH(f, files) {
+                struct stat st;
+
+                if (stat(*f, &st) < 0)
+                        return -errno;
+
+                rules_cache_stamp_file(&state, *f, &st);
+        }
+
+        /* With early name resolution, user and group IDs are part of the compiled rules */
+        if (resolve_name_timing == RESOLVE_NAME_EARLY)
+                FOREACH_STRING(p, "/etc/passwd", "/etc/group") {
+                        struct stat st;
+
+                        if (stat(p, &st) < 0) {
+                                if (errno == ENOENT)
+                                        continue;
+                                return -errno;
+                        }
+
+                        rules_cache_stamp_file(&state, p, &st);
+                }
+
+        *ret = siphash24_finalize(&state);
+        return 0;
+}
+
+static int rules_cache_load(UdevRules *rules, uint64_t stamp) {
+        const uint8_t sig[] = RULES_CACHE_SIG;
+        const struct rules_cache_header *h;
+        _cleanup_close_ int fd = -1;
+        const struct token *end;
+        uint64_t size;
+        struct stat st;
+        void *map;
+        int r;
+
+        fd = open(RULES_CACHE_PATH, O_RDONLY|O_CLOEXEC);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if ((size_t) st.st_size < sizeof(struct rules_cache_header))
+                return -EBADMSG;
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+                return -errno;
+
+        h = map;
+        if (memcmp(h->signature, sig, sizeof(h->signature)) != 0 ||
+            h->tool_version != PROJECT_VERSION ||
+            h->file_size != (uint64_t) st.st_size ||
+            h->header_size != sizeof(struct rules_cache_header) ||
+            h->token_size != sizeof(struct token) ||
+            h->index_entry_size != sizeof(struct rule_index_entry) ||
+            h->token_types != TK_END ||
+            h->tokens_count == 0 || h->tokens_count > UINT_MAX ||
+            h->index_count > h->file_size ||
+            h->strings_len == 0 || h->strings_len > h->file_size) {
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        size = h->header_size + h->tokens_count * h->token_size + h->index_count * h->index_entry_size + h->strings_len;
+        if (size != h->file_size) {
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        if (h->stamp != stamp) {
+                r = -ESTALE;
+                goto fail;
+        }
+
+        rules->tokens = (struct token*) ((uint8_t*) map + h->header_size);
+        rules->token_cur = rules->token_max = h->tokens_count;
+        rules->index = (struct rule_index_entry*) (rules->tokens + h->tokens_count);
+        rules->n_index = h->index_count;
+        rules->map_strings = (const char*) (rules->index + h->index_count);
+
+        /* the string buffer and the token array are terminated, like freshly compiled ones */
+        end = rules->tokens + h->tokens_count - 1;
+        if (end->type != TK_END || rules->map_strings[h->strings_len - 1] != '\0') {
+                rules->tokens = NULL;
+                rules->index = NULL;
+                rules->token_cur = rules->token_max = rules->n_index = 0;
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        rules->map = map;
+        rules->map_size = st.st_size;
+
+        return 0;
+
+fail:
+        (void) munmap(map, st.st_size);
+        return r;
+}
+
+static int rules_cache_store(UdevRules *rules, uint64_t stamp) {
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *temp = NULL;
+        struct rules_cache_header h = {
+                .signature = RULES_CACHE_SIG,
+                .tool_version = PROJECT_VERSION,
+                .header_size = sizeof(struct rules_cache_header),
+                .token_size = sizeof(struct token),
+                .index_entry_size = sizeof(struct rule_index_entry),
+                .token_types = TK_END,
+                .stamp = stamp,
+                .tokens_count = rules->token_cur,
+                .index_count = rules->n_index,
+                .strings_len = rules->strbuf->len,
+        };
+        int r;
+
+        h.file_size = h.header_size + h.tokens_count * h.token_size + h.index_count * h.index_entry_size + h.strings_len;
+
+        r = fopen_temporary(RULES_CACHE_PATH, &f, &temp);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0444);
+
+        fwrite(&h, sizeof(h), 1, f);
+        fwrite(rules->tokens, sizeof(struct token), rules->token_cur, f);
+        fwrite(rules->index, sizeof(struct rule_index_entry), rules->n_index, f);
+        fwrite(rules->strbuf->buf, 1, rules->strbuf->len, f);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp, RULES_CACHE_PATH) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(temp);
+        return r;
+}
+
 int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing) {
         _cleanup_(udev_rules_freep) UdevRules *rules = NULL;
         _cleanup_strv_free_ char **files = NULL;
+        bool cacheable = false;
+        uint64_t stamp = 0;
         char **f;
         int r;
 
@@ -1530,6 +1985,37 @@ int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing)
                 .resolve_name_timing = resolve_name_timing,
         };
 
+        udev_rules_check_timestamp(rules);
+
+        r = conf_files_list_strv(&files, ".rules", NULL, 0, rules_dirs);
+        if (r < 0)
+                return log_error_errno(r, "Failed to enumerate rules files: %m");
+
+        /* Use the compiled rules if they are from the same set of rules files, unmodified since */
+        r = rules_cache_stamp(files, resolve_name_timing, &stamp);
+        if (r < 0)
+                log_debug_errno(r, "Failed to determine state of rules files, not using %s: %m", RULES_CACHE_PATH);
+        else {
+                r = rules_cache_load(rules, stamp);
+                if (r >= 0) {
+                        log_debug("Loaded %u tokens and %zu index entries from %s",
+                                  rules->token_cur, rules->n_index, RULES_CACHE_PATH);
+
+                        r = parent_attrs_build(rules);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to index parent attributes: %m");
+
+                        *ret_rules = TAKE_PTR(rules);
+                        return 0;
+                }
+                if (r == -ESTALE)
+                        log_debug("%s is out of date, compiling rules.", RULES_CACHE_PATH);
+                else if (r != -ENOENT)
+                        log_debug_errno(r, "Failed to load %s, ignoring: %m", RULES_CACHE_PATH);
+
+                cacheable = true;
+        }
+
         /* init token array and string buffer */
         rules->tokens = malloc_multiply(PREALLOC_TOKEN, sizeof(struct token));
         if (!rules->tokens)
@@ -1540,12 +2026,6 @@ int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing)
         if (!rules->strbuf)
                 return -ENOMEM;
 
-        udev_rules_check_timestamp(rules);
-
-        r = conf_files_list_strv(&files, ".rules", NULL, 0, rules_dirs);
-        if (r < 0)
-                return log_error_errno(r, "Failed to enumerate rules files: %m");
-
         /*
          * The offset value in the rules strct is limited; add all
          * rules file names to the beginning of the string buffer.
@@ -1557,7 +2037,18 @@ int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing)
                 parse_file(rules, *f);
 
         struct token end_token = { .type = TK_END };
-        add_token(rules, &end_token);
+        if (add_token(rules, &end_token) != 0)
+                return -ENOMEM;
+
+        r = rule_index_build(rules);
+        if (r < 0)
+                return log_error_errno(r, "Failed to index rules: %m");
+        log_debug("Rules index contains %zu entries", rules->n_index);
+
+        r = parent_attrs_build(rules);
+        if (r < 0)
+                return log_error_errno(r, "Failed to index parent attributes: %m");
+        log_debug("Rules match %u distinct parent attributes", hashmap_size(rules->parent_attrs));
         log_debug("Rules contain %zu bytes tokens (%u * %zu bytes), %zu bytes strings",
                   rules->token_max * sizeof(struct token), rules->token_max, sizeof(struct token), rules->strbuf->len);
 
@@ -1576,6 +2067,13 @@ int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing)
         rules->gids_max = 0;
 
         dump_rules(rules);
+
+        if (cacheable) {
+                r = rules_cache_store(rules, stamp);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to write %s, ignoring: %m", RULES_CACHE_PATH);
+        }
+
         *ret_rules = TAKE_PTR(rules);
         return 0;
 }
@@ -1583,13 +2081,105 @@ int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing)
 UdevRules *udev_rules_free(UdevRules *rules) {
         if (!rules)
                 return NULL;
-        free(rules->tokens);
+        if (rules->map)
+                (void) munmap(rules->map, rules->map_size);
+        else {
+                free(rules->tokens);
+                free(rules->index);
+        }
         strbuf_cleanup(rules->strbuf);
+        hashmap_free(rules->parent_attrs);
+        free(rules->file_stats);
         free(rules->uids);
         free(rules->gids);
         return mfree(rules);
 }
 
+void udev_rules_set_benchmark(UdevRules *rules, bool b) {
+        assert(rules);
+
+        rules->benchmark = b;
+}
+
+const UdevRulesFileStats *udev_rules_get_file_stats(UdevRules *rules, size_t *ret_n) {
+        assert(rules);
+        assert(ret_n);
+
+        *ret_n = rules->n_file_stats;
+        return rules->file_stats;
+}
+
+int udev_rules_get_sysattr_names(UdevRules *rules, char ***ret) {
+        _cleanup_strv_free_ char **names = NULL;
+        unsigned i;
+        int r;
+
+        assert(rules);
+        assert(ret);
+
+        /* The attributes matched by ATTR{} and ATTRS{} keys, as far as their names are fixed */
+        for (i = 0; rules->tokens && rules->tokens[i].type != TK_END; i++) {
+                const struct token *t = &rules->tokens[i];
+                const char *name;
+
+                if (!IN_SET(t->type, TK_M_ATTR, TK_M_ATTRS) || t->key.attrsubst != SB_NONE)
+                        continue;
+
+                name = rules_str(rules, t->key.attr_off);
+                if (strv_contains(names, name))
+                        continue;
+
+                r = strv_extend(&names, name);
+                if (r < 0)
+                        return r;
+        }
+
+        strv_sort(names);
+        *ret = TAKE_PTR(names);
+        return 0;
+}
+
+/* Adds the time since *start to the rules file of the specified rule, and makes now the new start */
+static void rules_benchmark_account(UdevRules *rules, const struct token *rule, usec_t *start) {
+        UdevRulesFileStats *s = NULL;
+        const char *filename;
+        usec_t n;
+        size_t i;
+
+        n = now(CLOCK_MONOTONIC);
+
+        if (rule) {
+                filename = rules_str(rules, rule->rule.filename_off);
+
+                /* Consecutive rules are usually from the same file, hence try the last one first. Strings are
+                 * de-duplicated, hence comparing the pointers is enough. */
+                if (rules->file_stats_last < rules->n_file_stats &&
+                    rules->file_stats[rules->file_stats_last].filename == filename)
+                        s = rules->file_stats + rules->file_stats_last;
+                else
+                        for (i = 0; i < rules->n_file_stats; i++)
+                                if (rules->file_stats[i].filename == filename) {
+                                        s = rules->file_stats + i;
+                                        break;
+                                }
+
+                if (!s && GREEDY_REALLOC(rules->file_stats, rules->file_stats_allocated, rules->n_file_stats + 1)) {
+                        s = rules->file_stats + rules->n_file_stats++;
+                        *s = (UdevRulesFileStats) {
+                                .filename = filename,
+                        };
+                }
+
+                if (s) {
+                        s->n_rules++;
+                        s->usec += usec_sub_unsigned(n, *start);
+                        rules->file_stats_last = s - rules->file_stats;
+                }
+        }
+
+        *start = n;
+}
+
 bool udev_rules_check_timestamp(UdevRules *rules) {
         if (!rules)
                 return false;
@@ -1670,11 +2260,14 @@ static int match_key(UdevRules *rules, struct token *token, const char *val) {
         return -1;
 }
 
-static int match_attr(UdevRules *rules, sd_device *dev, UdevEvent *event, struct token *cur) {
+static int match_attr(UdevRules *rules, sd_device *dev, UdevEvent *event, struct token *cur, bool *ret_missing) {
         char nbuf[UTIL_NAME_SIZE], vbuf[UTIL_NAME_SIZE];
         const char *name, *value;
         size_t len;
 
+        if (ret_missing)
+                *ret_missing = false;
+
         name = rules_str(rules, cur->key.attr_off);
         switch (cur->key.attrsubst) {
         case SB_FORMAT:
@@ -1682,8 +2275,11 @@ static int match_attr(UdevRules *rules, sd_device *dev, UdevEvent *event, struct
                 name = nbuf;
                 _fallthrough_;
         case SB_NONE:
-                if (sd_device_get_sysattr_value(dev, name, &value) < 0)
+                if (sd_device_get_sysattr_value(dev, name, &value) < 0) {
+                        if (ret_missing)
+                                *ret_missing = true;
                         return -1;
+                }
                 break;
         case SB_SUBSYS:
                 if (util_resolve_subsys_kernel(name, vbuf, sizeof(vbuf), true) != 0)
@@ -1715,6 +2311,62 @@ static int match_attr(UdevRules *rules, sd_device *dev, UdevEvent *event, struct
         return match_key(rules, cur, value);
 }
 
+static int parent_chain_next(struct parent_chain *chain, size_t depth, sd_device *child, sd_device **ret) {
+        int r;
+
+        assert(chain);
+        assert(depth > 0);
+        assert(child);
+        assert(ret);
+
+        if (depth < chain->n_devices) {
+                *ret = chain->devices[depth];
+                return 0;
+        }
+
+        if (depth == chain->n_devices && chain->complete)
+                return -ENOENT;
+
+        r = sd_device_get_parent(child, ret);
+        if (r < 0) {
+                if (depth == chain->n_devices)
+                        chain->complete = true;
+                return r;
+        }
+
+        if (depth == chain->n_devices && depth < ELEMENTSOF(chain->devices))
+                chain->devices[chain->n_devices++] = *ret;
+
+        return 0;
+}
+
+static int match_parent_attr(UdevRules *rules, struct parent_chain *chain, size_t depth, UdevEvent *event, struct token *cur) {
+        uint64_t bit;
+        unsigned slot;
+        bool missing;
+        void *p;
+        int r;
+
+        if (!chain->missing || depth >= PARENT_CHAIN_MAX || cur->key.attrsubst != SB_NONE)
+                return match_attr(rules, event->dev_parent, event, cur, NULL);
+
+        p = hashmap_get(rules->parent_attrs, UINT_TO_PTR(cur->key.attr_off));
+        if (!p)
+                return match_attr(rules, event->dev_parent, event, cur, NULL);
+
+        slot = PTR_TO_UINT(p) - 1;
+        bit = UINT64_C(1) << depth;
+
+        if (chain->missing[slot] & bit)
+                return -1;
+
+        r = match_attr(rules, event->dev_parent, event, cur, &missing);
+        if (missing)
+                chain->missing[slot] |= bit;
+
+        return r;
+}
+
 enum escape_type {
         ESCAPE_UNSET,
         ESCAPE_NONE,
@@ -1728,9 +2380,17 @@ int udev_rules_apply_to_event(
                 Hashmap *properties_list) {
         sd_device *dev = event->dev;
         enum escape_type esc = ESCAPE_UNSET;
-        struct token *cur, *rule;
+        _cleanup_free_ uint64_t *missing = NULL;
+        struct parent_chain chain = {
+                .devices = { dev },
+                .n_devices = 1,
+        };
+        struct rule_index_range candidates[4];
+        struct token *cur, *rule, *timed = NULL;
         const char *action, *val;
+        usec_t timed_start = 0;
         bool can_set_name;
+        unsigned next;
         int r;
 
         if (!rules->tokens)
@@ -1740,6 +2400,18 @@ int udev_rules_apply_to_event(
         if (r < 0)
                 return r;
 
+        /* only rules without a literal match, or with one that matches this event, may apply */
+        rule_index_lookup(rules, TK_UNSET, NULL, &candidates[0]);
+        rule_index_lookup(rules, TK_M_ACTION, action, &candidates[1]);
+        rule_index_lookup(rules, TK_M_KERNEL, sd_device_get_sysname(dev, &val) >= 0 ? val : NULL, &candidates[2]);
+        rule_index_lookup(rules, TK_M_SUBSYSTEM, sd_device_get_subsystem(dev, &val) >= 0 ? val : NULL, &candidates[3]);
+
+        /* without memory for the cache, parent attributes are simply looked up each time */
+        if (!hashmap_isempty(rules->parent_attrs)) {
+                missing = new0(uint64_t, hashmap_size(rules->parent_attrs));
+                chain.missing = missing;
+        }
+
         can_set_name = (!streq(action, "remove") &&
                         (sd_device_get_devnum(dev, NULL) >= 0 ||
                          sd_device_get_ifindex(dev, NULL) >= 0));
@@ -1751,6 +2423,18 @@ int udev_rules_apply_to_event(
                 dump_token(rules, cur);
                 switch (cur->type) {
                 case TK_RULE:
+                        /* skip forward over rules which cannot match this event */
+                        next = rule_index_next(rules, candidates, ELEMENTSOF(candidates), cur - rules->tokens);
+                        if (next != (unsigned) (cur - rules->tokens)) {
+                                cur = &rules->tokens[next];
+                                continue;
+                        }
+
+                        if (rules->benchmark) {
+                                rules_benchmark_account(rules, timed, &timed_start);
+                                timed = cur;
+                        }
+
                         /* current rule */
                         rule = cur;
                         /* possibly skip rules which want to set NAME, SYMLINK, OWNER, GROUP, MODE */
@@ -1835,7 +2519,7 @@ int udev_rules_apply_to_event(
                                 goto nomatch;
                         break;
                 case TK_M_ATTR:
-                        if (match_attr(rules, dev, event, cur) != 0)
+                        if (match_attr(rules, dev, event, cur, NULL) != 0)
                                 goto nomatch;
                         break;
                 case TK_M_SYSCTL: {
@@ -1861,6 +2545,7 @@ int udev_rules_apply_to_event(
                 case TK_M_ATTRS:
                 case TK_M_TAGS: {
                         struct token *next;
+                        size_t depth = 0;
 
                         /* get whole sequence of parent matches */
                         next = cur;
@@ -1895,7 +2580,7 @@ int udev_rules_apply_to_event(
                                                         goto try_parent;
                                                 break;
                                         case TK_M_ATTRS:
-                                                if (match_attr(rules, event->dev_parent, event, key) != 0)
+                                                if (match_parent_attr(rules, &chain, depth, event, key) != 0)
                                                         goto try_parent;
                                                 break;
                                         case TK_M_TAGS: {
@@ -1914,7 +2599,8 @@ int udev_rules_apply_to_event(
                                 break;
 
                         try_parent:
-                                if (sd_device_get_parent(event->dev_parent, &event->dev_parent) < 0) {
+                                depth++;
+                                if (parent_chain_next(&chain, depth, event->dev_parent, &event->dev_parent) < 0) {
                                         event->dev_parent = NULL;
                                         goto nomatch;
                                 }
@@ -2377,6 +3063,11 @@ int udev_rules_apply_to_event(
                         attr_subst_subdir(attr, sizeof(attr));
 
                         udev_event_apply_format(event, rules_str(rules, cur->key.value_off), value, sizeof(value), false);
+                        if (rules->benchmark) {
+                                log_device_debug(dev, "Benchmarking, not writing ATTR '%s'", attr);
+                                break;
+                        }
+
                         log_device_debug(dev, "ATTR '%s' writing '%s' %s:%u", attr, value,
                                          rules_str(rules, rule->rule.filename_off),
                                          rule->rule.filename_line);
@@ -2393,6 +3084,11 @@ int udev_rules_apply_to_event(
                         udev_event_apply_format(event, rules_str(rules, cur->key.attr_off), filename, sizeof(filename), false);
                         sysctl_normalize(filename);
                         udev_event_apply_format(event, rules_str(rules, cur->key.value_off), value, sizeof(value), false);
+                        if (rules->benchmark) {
+                                log_device_debug(dev, "Benchmarking, not writing SYSCTL '%s'", filename);
+                                break;
+                        }
+
                         log_device_debug(dev, "SYSCTL '%s' writing '%s' %s:%u", filename, value,
                                          rules_str(rules, rule->rule.filename_off), rule->rule.filename_line);
                         r = sysctl_write(filename, value);
@@ -2433,6 +3129,8 @@ int udev_rules_apply_to_event(
                         cur = &rules->tokens[cur->key.rule_goto];
                         continue;
                 case TK_END:
+                        if (rules->benchmark)
+                                rules_benchmark_account(rules, timed, &timed_start);
                         return 0;
 
                 case TK_M_PARENTS_MIN:
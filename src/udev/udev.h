@@ -48,6 +48,12 @@ typedef struct UdevEvent {
 /* udev-rules.c */
 typedef struct UdevRules UdevRules;
 
+typedef struct UdevRulesFileStats {
+        const char *filename;
+        unsigned n_rules; /* how often any rule of the file was evaluated */
+        usec_t usec;      /* including programs and builtins run by these rules */
+} UdevRulesFileStats;
+
 int udev_rules_new(UdevRules **ret_rules, ResolveNameTiming resolve_name_timing);
 UdevRules *udev_rules_free(UdevRules *rules);
 
@@ -56,6 +62,9 @@ int udev_rules_apply_to_event(UdevRules *rules, UdevEvent *event,
                               usec_t timeout_usec,
                               Hashmap *properties_list);
 int udev_rules_apply_static_dev_perms(UdevRules *rules);
+void udev_rules_set_benchmark(UdevRules *rules, bool b);
+const UdevRulesFileStats *udev_rules_get_file_stats(UdevRules *rules, size_t *ret_n);
+int udev_rules_get_sysattr_names(UdevRules *rules, char ***ret);
 
 static inline usec_t udev_warn_timeout(usec_t timeout_usec) {
         return DIV_ROUND_UP(timeout_usec, 3);
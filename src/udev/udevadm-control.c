@@ -19,6 +19,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "alloc-util.h"
 #include "parse-util.h"
 #include "process-util.h"
 #include "syslog-util.h"
@@ -40,6 +41,7 @@ static int help(void) {
                "  -R --reload              Reload rules and databases\n"
                "  -p --property=KEY=VALUE  Set a global property for all events\n"
                "  -m --children-max=N      Maximum number of children\n"
+               "     --ping                Wait for the daemon to reply, and show its status\n"
                "  -t --timeout=SECONDS     Maximum time to block for a reply\n"
                , program_invocation_short_name);
 
@@ -51,6 +53,10 @@ int control_main(int argc, char *argv[], void *userdata) {
         int timeout = 60;
         int c, r;
 
+        enum {
+                ARG_PING = 0x100,
+        };
+
         static const struct option options[] = {
                 { "exit",             no_argument,       NULL, 'e' },
                 { "log-priority",     required_argument, NULL, 'l' },
@@ -61,6 +67,7 @@ int control_main(int argc, char *argv[], void *userdata) {
                 { "property",         required_argument, NULL, 'p' },
                 { "env",              required_argument, NULL, 'p' }, /* alias for -p */
                 { "children-max",     required_argument, NULL, 'm' },
+                { "ping",             no_argument,       NULL, ARG_PING },
                 { "timeout",          required_argument, NULL, 't' },
                 { "version",          no_argument,       NULL, 'V' },
                 { "help",             no_argument,       NULL, 'h' },
@@ -135,6 +142,17 @@ int control_main(int argc, char *argv[], void *userdata) {
                                 return r;
                         break;
                 }
+                case ARG_PING: {
+                        _cleanup_free_ char *status = NULL;
+
+                        r = udev_ctrl_send_ping(uctrl, timeout, &status);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to connect to udev daemon: %m");
+
+                        if (status)
+                                puts(status);
+                        break;
+                }
                 case 't': {
                         usec_t s;
 
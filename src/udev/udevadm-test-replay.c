@@ -0,0 +1,468 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "sd-device.h"
+
+#include "alloc-util.h"
+#include "device-enumerator-private.h"
+#include "device-private.h"
+#include "device-util.h"
+#include "escape.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "hashmap.h"
+#include "set.h"
+#include "string-util.h"
+#include "strv.h"
+#include "udev-builtin.h"
+#include "udevadm-test-replay.h"
+#include "util.h"
+
+/* A recording contains one record per device, terminated by an empty line, parents always before their
+ * children:
+ *
+ *   D:<devpath>        starts the record of a device an event is replayed for
+ *   O:<devpath>        starts the record of a device that is only needed as parent of others
+ *   P:<devpath>        the parent of the device, if any
+ *   E:<key>=<value>    a property, as read from the uevent file
+ *   A:<name>=<value>   the value of a sysfs attribute matched by ATTR{} or ATTRS{} keys of the rules
+ *   N:<name>           the same, for an attribute the device does not have
+ *
+ * Values are C-escaped. What the recording does not cover, e.g. attributes whose names are only known while
+ * the rules are applied, TEST= keys, and programs run by PROGRAM= and IMPORT{program}= keys, is looked up on
+ * the live system when replaying. */
+
+static int record_device(FILE *f, const char *syspath, Set *events, Set *recorded, char **sysattrs) {
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        const char *devpath, *parent_devpath = NULL, *key, *value;
+        sd_device *parent;
+        char **a;
+        int r;
+
+        if (set_contains(recorded, syspath))
+                return 1;
+
+        r = device_new_from_synthetic_event(&dev, syspath, "add");
+        if (r < 0) {
+                log_debug_errno(r, "Failed to open device '%s', ignoring: %m", syspath);
+                return 0;
+        }
+
+        /* Only record what the kernel tells about the device, not what udev stored in its database */
+        device_seal(dev);
+
+        /* These are read from symlinks in sysfs, and only become properties once asked for */
+        (void) sd_device_get_subsystem(dev, &value);
+        (void) sd_device_get_driver(dev, &value);
+
+        r = sd_device_get_devpath(dev, &devpath);
+        if (r < 0)
+                return log_device_error_errno(dev, r, "Failed to get devpath: %m");
+
+        /* Parents first, so that they exist when their children are replayed */
+        if (sd_device_get_parent(dev, &parent) >= 0) {
+                const char *parent_syspath;
+
+                r = sd_device_get_syspath(parent, &parent_syspath);
+                if (r < 0)
+                        return log_device_error_errno(parent, r, "Failed to get syspath: %m");
+
+                r = record_device(f, parent_syspath, events, recorded, sysattrs);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        (void) sd_device_get_devpath(parent, &parent_devpath);
+        }
+
+        fprintf(f, "%c:%s\n", set_contains(events, syspath) ? 'D' : 'O', devpath);
+        if (parent_devpath)
+                fprintf(f, "P:%s\n", parent_devpath);
+
+        FOREACH_DEVICE_PROPERTY(dev, key, value) {
+                _cleanup_free_ char *escaped = NULL;
+
+                escaped = cescape(value);
+                if (!escaped)
+                        return log_oom();
+
+                fprintf(f, "E:%s=%s\n", key, escaped);
+        }
+
+        STRV_FOREACH(a, sysattrs) {
+                _cleanup_free_ char *escaped = NULL;
+
+                r = sd_device_get_sysattr_value(dev, *a, &value);
+                if (r == -ENOENT) {
+                        fprintf(f, "N:%s\n", *a);
+                        continue;
+                }
+                if (r < 0) /* directories, unreadable attributes, … are looked up when replaying */
+                        continue;
+
+                escaped = cescape(value);
+                if (!escaped)
+                        return log_oom();
+
+                fprintf(f, "A:%s=%s\n", *a, escaped);
+        }
+
+        fputc('\n', f);
+
+        r = set_put_strdup(recorded, syspath);
+        if (r < 0)
+                return log_oom();
+
+        return 1;
+}
+
+int test_record(UdevRules *rules, const char *path) {
+        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+        _cleanup_set_free_free_ Set *events = NULL, *recorded = NULL;
+        _cleanup_strv_free_ char **sysattrs = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        const char *syspath;
+        sd_device *d;
+        int r;
+
+        assert(rules);
+        assert(path);
+
+        r = udev_rules_get_sysattr_names(rules, &sysattrs);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get attributes matched by rules: %m");
+
+        r = sd_device_enumerator_new(&e);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create device enumerator: %m");
+
+        r = sd_device_enumerator_allow_uninitialized(e);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allow uninitialized devices: %m");
+
+        events = set_new(&string_hash_ops);
+        recorded = set_new(&string_hash_ops);
+        if (!events || !recorded)
+                return log_oom();
+
+        /* The devices a coldplug triggers events for, i.e. 'udevadm trigger --type=devices' */
+        FOREACH_DEVICE(e, d) {
+                r = sd_device_get_syspath(d, &syspath);
+                if (r < 0)
+                        return log_device_error_errno(d, r, "Failed to get syspath: %m");
+
+                r = set_put_strdup(events, syspath);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        f = fopen(path, "we");
+        if (!f)
+                return log_error_errno(errno, "Failed to open %s: %m", path);
+
+        fputs("# udev event recording, see 'udevadm test --replay='\n\n", f);
+
+        FOREACH_DEVICE(e, d) {
+                r = sd_device_get_syspath(d, &syspath);
+                if (r < 0)
+                        return log_device_error_errno(d, r, "Failed to get syspath: %m");
+
+                r = record_device(f, syspath, events, recorded, sysattrs);
+                if (r < 0)
+                        return r;
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to write %s: %m", path);
+
+        printf("Recorded %u devices, and %zu attributes matched by rules, to %s.\n",
+               set_size(recorded), strv_length(sysattrs), path);
+
+        return 0;
+}
+
+typedef struct ReplayRecord {
+        bool event;
+        char *parent;
+        char **properties;
+        char **attrs;         /* name, value, name, value, … */
+        char **missing_attrs;
+} ReplayRecord;
+
+typedef struct Replay {
+        Hashmap *devices;     /* devpath → sd_device, owning the device */
+        sd_device **events;
+        size_t n_events;
+        size_t n_events_allocated;
+} Replay;
+
+static void replay_record_done(ReplayRecord *record) {
+        assert(record);
+
+        free(record->parent);
+        strv_free(record->properties);
+        strv_free(record->attrs);
+        strv_free(record->missing_attrs);
+
+        *record = (ReplayRecord) {};
+}
+
+static void replay_done(Replay *replay) {
+        assert(replay);
+
+        free(replay->events);
+        hashmap_free_with_destructor(replay->devices, sd_device_unref);
+}
+
+static int replay_add_device(Replay *replay, ReplayRecord *record) {
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        sd_device *parent = NULL;
+        const char *devpath;
+        char **a, **v;
+        int r;
+
+        assert(replay);
+        assert(record);
+
+        if (record->event) {
+                /* Like the kernel does, number the events */
+                r = strv_extendf(&record->properties, "SEQNUM=%zu", replay->n_events + 1);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        r = device_new_from_strv_unverified(&dev, record->properties);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create device from recording: %m");
+
+        r = sd_device_get_devpath(dev, &devpath);
+        if (r < 0)
+                return log_device_error_errno(dev, r, "Failed to get devpath: %m");
+
+        if (record->parent) {
+                parent = hashmap_get(replay->devices, record->parent);
+                if (!parent)
+                        return log_device_error_errno(dev, SYNTHETIC_ERRNO(EBADMSG),
+                                                      "Parent device %s is not recorded before its child.", record->parent);
+        }
+
+        /* Never look at sysfs for the parents, but use the recorded ones, which are also the ones the rules
+         * were applied to, if they had an event */
+        device_set_parent(dev, parent);
+
+        STRV_FOREACH_PAIR(a, v, record->attrs) {
+                r = device_cache_sysattr_value(dev, *a, *v);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        STRV_FOREACH(a, record->missing_attrs) {
+                r = device_cache_sysattr_value(dev, *a, NULL);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        if (record->event &&
+            !GREEDY_REALLOC(replay->events, replay->n_events_allocated, replay->n_events + 1))
+                return log_oom();
+
+        r = hashmap_ensure_allocated(&replay->devices, &string_hash_ops);
+        if (r < 0)
+                return log_oom();
+
+        r = hashmap_put(replay->devices, devpath, dev);
+        if (r == -EEXIST)
+                return log_device_error_errno(dev, SYNTHETIC_ERRNO(EBADMSG), "Device is recorded twice.");
+        if (r < 0)
+                return log_oom();
+
+        if (record->event)
+                replay->events[replay->n_events++] = dev;
+
+        TAKE_PTR(dev);
+        return 0;
+}
+
+static int replay_load(Replay *replay, const char *path) {
+        _cleanup_(replay_record_done) ReplayRecord record = {};
+        _cleanup_fclose_ FILE *f = NULL;
+        bool in_record = false;
+        unsigned line_nr = 0;
+        int r;
+
+        assert(replay);
+        assert(path);
+
+        f = fopen(path, "re");
+        if (!f)
+                return log_error_errno(errno, "Failed to open %s: %m", path);
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL, *unescaped = NULL;
+                const char *val;
+                char *eq;
+                bool eof;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to read %s: %m", path);
+                eof = r == 0;
+                line_nr++;
+
+                if (eof || isempty(line)) {
+                        if (in_record) {
+                                r = replay_add_device(replay, &record);
+                                if (r < 0)
+                                        return r;
+
+                                replay_record_done(&record);
+                                in_record = false;
+                        }
+
+                        if (eof)
+                                break;
+                        continue;
+                }
+
+                if (line[0] == '#')
+                        continue;
+
+                if (line[1] != ':' || (!in_record) != IN_SET(line[0], 'D', 'O'))
+                        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "%s:%u: Unexpected line, refusing.", path, line_nr);
+
+                val = line + 2;
+
+                switch (line[0]) {
+
+                case 'D':
+                case 'O':
+                        record.event = line[0] == 'D';
+                        in_record = true;
+                        break;
+
+                case 'P':
+                        r = free_and_strdup(&record.parent, val);
+                        if (r < 0)
+                                return log_oom();
+                        break;
+
+                case 'E':
+                case 'A':
+                        eq = strchr(val, '=');
+                        if (!eq)
+                                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "%s:%u: Missing '=', refusing.", path, line_nr);
+                        *eq = '\0';
+
+                        r = cunescape(eq + 1, 0, &unescaped);
+                        if (r < 0)
+                                return log_error_errno(r, "%s:%u: Failed to unescape value: %m", path, line_nr);
+
+                        if (line[0] == 'E')
+                                r = strv_extendf(&record.properties, "%s=%s", val, unescaped);
+                        else
+                                r = strv_extend_strv(&record.attrs, STRV_MAKE(val, unescaped), false);
+                        if (r < 0)
+                                return log_oom();
+                        break;
+
+                case 'N':
+                        r = strv_extend(&record.missing_attrs, val);
+                        if (r < 0)
+                                return log_oom();
+                        break;
+
+                default:
+                        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "%s:%u: Unknown line type, refusing.", path, line_nr);
+                }
+        }
+
+        return 0;
+}
+
+static int file_stats_compare(const UdevRulesFileStats *a, const UdevRulesFileStats *b) {
+        return CMP(b->usec, a->usec);
+}
+
+static int print_stats(UdevRules *rules, size_t n_events, usec_t usec) {
+        _cleanup_free_ UdevRulesFileStats *files = NULL;
+        const UdevRulesFileStats *s;
+        enum udev_builtin_cmd c;
+        size_t n, i;
+
+        printf("Replayed %zu events in %.3fms", n_events, (double) usec / USEC_PER_MSEC);
+        if (usec > 0)
+                printf(", %.1f events/s", (double) n_events * USEC_PER_SEC / usec);
+        printf(".\n\n");
+
+        s = udev_rules_get_file_stats(rules, &n);
+        if (n > 0) {
+                files = newdup(UdevRulesFileStats, s, n);
+                if (!files)
+                        return log_oom();
+
+                typesafe_qsort(files, n, file_stats_compare);
+        }
+
+        printf("%12s %10s  %s\n", "TIME", "RULES", "RULES FILE");
+        for (i = 0; i < n; i++)
+                printf("%10.3fms %10u  %s\n",
+                       (double) files[i].usec / USEC_PER_MSEC, files[i].n_rules, files[i].filename);
+
+        printf("\n%12s %10s %10s  %s\n", "TIME", "RUNS", "SKIPPED", "BUILTIN");
+        for (c = 0; c < _UDEV_BUILTIN_MAX; c++) {
+                UdevBuiltinStats stats;
+
+                if (!udev_builtin_name(c))
+                        continue;
+
+                udev_builtin_get_stats(c, &stats);
+                if (stats.n_runs == 0 && stats.n_skipped == 0)
+                        continue;
+
+                printf("%10.3fms %10u %10u  %s\n",
+                       (double) stats.usec / USEC_PER_MSEC, stats.n_runs, stats.n_skipped, udev_builtin_name(c));
+        }
+
+        return 0;
+}
+
+int test_replay(UdevRules *rules, const char *path) {
+        _cleanup_(replay_done) Replay replay = {};
+        usec_t start, usec;
+        size_t i;
+        int r;
+
+        assert(rules);
+        assert(path);
+
+        r = replay_load(&replay, path);
+        if (r < 0)
+                return r;
+
+        /* Time rules files and builtins, and do not modify the system */
+        udev_builtin_set_benchmark(true);
+        udev_rules_set_benchmark(rules, true);
+
+        start = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < replay.n_events; i++) {
+                _cleanup_(udev_event_freep) UdevEvent *event = NULL;
+
+                event = udev_event_new(replay.events[i], 0, NULL);
+                if (!event)
+                        return log_oom();
+
+                r = udev_rules_apply_to_event(rules, event, 60 * USEC_PER_SEC, NULL);
+                if (r < 0)
+                        log_device_warning_errno(event->dev, r, "Failed to apply rules, ignoring: %m");
+        }
+
+        usec = usec_sub_unsigned(now(CLOCK_MONOTONIC), start);
+
+        udev_rules_set_benchmark(rules, false);
+        udev_builtin_set_benchmark(false);
+
+        return print_stats(rules, replay.n_events, usec);
+}
@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+#pragma once
+
+#include "udev.h"
+
+int test_record(UdevRules *rules, const char *path);
+int test_replay(UdevRules *rules, const char *path);
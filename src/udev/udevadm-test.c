@@ -21,31 +21,44 @@
 #include "strxcpyx.h"
 #include "udev-builtin.h"
 #include "udev.h"
+#include "udevadm-test-replay.h"
 #include "udevadm.h"
 
 static const char *arg_action = "add";
 static ResolveNameTiming arg_resolve_name_timing = RESOLVE_NAME_EARLY;
 static char arg_syspath[UTIL_PATH_SIZE] = {};
+static const char *arg_record = NULL;
+static const char *arg_replay = NULL;
 
 static int help(void) {
 
-        printf("%s test [OPTIONS] DEVPATH\n\n"
+        printf("%s test [OPTIONS] DEVPATH\n"
+               "%s test [OPTIONS] --record=FILE|--replay=FILE\n\n"
                "Test an event run.\n\n"
                "  -h --help                            Show this help\n"
                "  -V --version                         Show package version\n"
                "  -a --action=ACTION                   Set action string\n"
                "  -N --resolve-names=early|late|never  When to resolve names\n"
-               , program_invocation_short_name);
+               "     --record=FILE                     Record the devices of a coldplug to FILE\n"
+               "     --replay=FILE                     Replay recorded events and show where time is spent\n"
+               , program_invocation_short_name, program_invocation_short_name);
 
         return 0;
 }
 
 static int parse_argv(int argc, char *argv[]) {
+        enum {
+                ARG_RECORD = 0x100,
+                ARG_REPLAY,
+        };
+
         static const struct option options[] = {
-                { "action",        required_argument, NULL, 'a' },
-                { "resolve-names", required_argument, NULL, 'N' },
-                { "version",       no_argument,       NULL, 'V' },
-                { "help",          no_argument,       NULL, 'h' },
+                { "action",        required_argument, NULL, 'a'        },
+                { "resolve-names", required_argument, NULL, 'N'        },
+                { "record",        required_argument, NULL, ARG_RECORD },
+                { "replay",        required_argument, NULL, ARG_REPLAY },
+                { "version",       no_argument,       NULL, 'V'        },
+                { "help",          no_argument,       NULL, 'h'        },
                 {}
         };
 
@@ -62,6 +75,12 @@ static int parse_argv(int argc, char *argv[]) {
                                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                        "--resolve-names= must be early, late or never");
                         break;
+                case ARG_RECORD:
+                        arg_record = optarg;
+                        break;
+                case ARG_REPLAY:
+                        arg_replay = optarg;
+                        break;
                 case 'V':
                         return print_version();
                 case 'h':
@@ -72,6 +91,17 @@ static int parse_argv(int argc, char *argv[]) {
                         assert_not_reached("Unknown option");
                 }
 
+        if (arg_record && arg_replay)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "--record= and --replay= cannot be combined.");
+
+        if (arg_record || arg_replay) {
+                if (argv[optind])
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                               "No syspath expected with --record= or --replay=.");
+                return 1;
+        }
+
         if (!argv[optind])
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "syspath parameter missing.");
@@ -85,6 +115,34 @@ static int parse_argv(int argc, char *argv[]) {
         return 1;
 }
 
+static int test_record_or_replay(void) {
+        _cleanup_(udev_rules_freep) UdevRules *rules = NULL;
+        sigset_t mask;
+        int r;
+
+        udev_builtin_init();
+
+        r = udev_rules_new(&rules, arg_resolve_name_timing);
+        if (r < 0) {
+                log_error_errno(r, "Failed to read udev rules: %m");
+                goto out;
+        }
+
+        if (arg_record)
+                r = test_record(rules, arg_record);
+        else {
+                /* Like a normal test run, programs are run, hence block signals the same way */
+                assert_se(sigfillset(&mask) >= 0);
+                assert_se(sigprocmask(SIG_SETMASK, &mask, NULL) >= 0);
+
+                r = test_replay(rules, arg_replay);
+        }
+
+out:
+        udev_builtin_exit();
+        return r;
+}
+
 int test_main(int argc, char *argv[], void *userdata) {
         _cleanup_(udev_rules_freep) UdevRules *rules = NULL;
         _cleanup_(udev_event_freep) UdevEvent *event = NULL;
@@ -95,12 +153,15 @@ int test_main(int argc, char *argv[], void *userdata) {
         void *val;
         int r;
 
-        log_set_max_level(LOG_DEBUG);
-
         r = parse_argv(argc, argv);
         if (r <= 0)
                 return r;
 
+        if (arg_record || arg_replay)
+                return test_record_or_replay();
+
+        log_set_max_level(LOG_DEBUG);
+
         printf("This program is for debugging only, it does not run any program\n"
                "specified by a RUN key. It may show incorrect results, because\n"
                "some values may be different, or not available at a simulation run.\n"
@@ -2,31 +2,141 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "sd-device.h"
 #include "sd-event.h"
 
+#include "alloc-util.h"
 #include "device-enumerator-private.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "set.h"
 #include "string-util.h"
 #include "strv.h"
 #include "udevadm.h"
 #include "udevadm-util.h"
+#include "util.h"
 #include "virt.h"
 
 static bool arg_verbose = false;
 static bool arg_dry_run = false;
+static unsigned arg_jobs = 1;
+static bool arg_ordered = true;
+
+typedef struct TriggerEntry {
+        char *syspath;
+        size_t index;
+        unsigned depth;
+        int result;
+} TriggerEntry;
+
+typedef struct TriggerContext {
+        TriggerEntry *entries;
+        const char *action;
+        size_t next;
+        size_t end;
+} TriggerContext;
+
+static int trigger_entry_compare(const TriggerEntry *a, const TriggerEntry *b) {
+        int r;
+
+        /* Parents always have fewer path components than their children, hence triggering one depth after the
+         * other makes sure udevd sees the event of a parent before those of its children, even if the events
+         * of a single depth are triggered in parallel. */
+        r = CMP(a->depth, b->depth);
+        if (r != 0)
+                return r;
+
+        return CMP(a->index, b->index);
+}
+
+static unsigned syspath_depth(const char *syspath) {
+        unsigned n = 0;
+
+        for (; *syspath; syspath++)
+                if (*syspath == '/')
+                        n++;
+
+        return n;
+}
+
+static void *trigger_thread(void *p) {
+        TriggerContext *c = p;
+        size_t k;
+
+        while ((k = __sync_fetch_and_add(&c->next, 1)) < c->end) {
+                _cleanup_free_ char *filename = NULL;
+
+                filename = path_join(c->entries[k].syspath, "uevent");
+                if (!filename) {
+                        c->entries[k].result = -ENOMEM;
+                        continue;
+                }
+
+                c->entries[k].result = write_string_file(filename, c->action, WRITE_STRING_FILE_DISABLE_BUFFER);
+        }
+
+        return NULL;
+}
+
+static void trigger_entries(TriggerEntry *entries, size_t begin, size_t end, const char *action, unsigned n_threads) {
+        TriggerContext c = {
+                .entries = entries,
+                .action = action,
+                .next = begin,
+                .end = end,
+        };
+        pthread_t *threads = NULL;
+        size_t n_started = 0, k;
+
+        /* Each write to a uevent file synchronously generates the event in the kernel, which takes a while for
+         * some devices. If we fail to start some threads the calling thread simply picks up the slack. */
+
+        if (n_threads > end - begin)
+                n_threads = end - begin;
+
+        if (n_threads > 1) {
+                threads = newa(pthread_t, n_threads - 1);
+
+                for (n_started = 0; n_started < n_threads - 1; n_started++) {
+                        int r;
+
+                        r = pthread_create(threads + n_started, NULL, trigger_thread, &c);
+                        if (r != 0) {
+                                log_debug_errno(-r, "Failed to start trigger thread, continuing with %zu: %m", n_started + 1);
+                                break;
+                        }
+                }
+        }
+
+        trigger_thread(&c);
+
+        for (k = 0; k < n_started; k++)
+                assert_se(pthread_join(threads[k], NULL) == 0);
+}
+
+static void trigger_entries_free(TriggerEntry *entries, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                free(entries[i].syspath);
+
+        free(entries);
+}
 
 static int exec_list(sd_device_enumerator *e, const char *action, Set *settle_set) {
+        TriggerEntry *entries = NULL;
+        size_t n_entries = 0, n_allocated = 0, begin, end, i;
         sd_device *d;
-        int r;
+        int r = 0;
 
         FOREACH_DEVICE_AND_SUBSYSTEM(e, d) {
-                _cleanup_free_ char *filename = NULL;
                 const char *syspath;
+                char *copy;
 
                 if (sd_device_get_syspath(d, &syspath) < 0)
                         continue;
@@ -36,24 +146,63 @@ static int exec_list(sd_device_enumerator *e, const char *action, Set *settle_se
                 if (arg_dry_run)
                         continue;
 
-                filename = path_join(syspath, "uevent");
-                if (!filename)
-                        return log_oom();
+                copy = strdup(syspath);
+                if (!copy) {
+                        r = log_oom();
+                        goto finish;
+                }
 
-                r = write_string_file(filename, action, WRITE_STRING_FILE_DISABLE_BUFFER);
-                if (r < 0) {
-                        log_debug_errno(r, "Failed to write '%s' to '%s', ignoring: %m", action, filename);
-                        continue;
+                if (!GREEDY_REALLOC(entries, n_allocated, n_entries + 1)) {
+                        free(copy);
+                        r = log_oom();
+                        goto finish;
                 }
 
-                if (settle_set) {
-                        r = set_put_strdup(settle_set, syspath);
-                        if (r < 0)
-                                return log_oom();
+                entries[n_entries] = (TriggerEntry) {
+                        .syspath = copy,
+                        .index = n_entries,
+                        .depth = syspath_depth(copy),
+                };
+                n_entries++;
+        }
+
+        if (arg_ordered && arg_jobs > 1)
+                typesafe_qsort(entries, n_entries, trigger_entry_compare);
+
+        for (begin = 0; begin < n_entries; begin = end) {
+                /* Without ordering, or when triggering one device at a time anyway, everything goes in one
+                 * go. Otherwise each depth is triggered in full before the next one is started. */
+                end = begin + 1;
+                if (arg_ordered && arg_jobs > 1)
+                        while (end < n_entries && entries[end].depth == entries[begin].depth)
+                                end++;
+                else
+                        end = n_entries;
+
+                trigger_entries(entries, begin, end, action, arg_jobs);
+
+                for (i = begin; i < end; i++) {
+                        if (entries[i].result < 0) {
+                                log_debug_errno(entries[i].result, "Failed to write '%s' to '%s/uevent', ignoring: %m",
+                                                action, entries[i].syspath);
+                                continue;
+                        }
+
+                        if (settle_set) {
+                                r = set_put_strdup(settle_set, entries[i].syspath);
+                                if (r < 0) {
+                                        r = log_oom();
+                                        goto finish;
+                                }
+                        }
                 }
         }
 
-        return 0;
+        r = 0;
+
+finish:
+        trigger_entries_free(entries, n_entries);
+        return r;
 }
 
 static int device_monitor_handler(sd_device_monitor *m, sd_device *dev, void *userdata) {
@@ -118,6 +267,10 @@ static int help(void) {
                "     --name-match=NAME              Trigger devices with this /dev name\n"
                "  -b --parent-match=NAME            Trigger devices with that parent device\n"
                "  -w --settle                       Wait for the triggered events to complete\n"
+               "  -j --jobs=N                       Trigger up to N events at the same time,\n"
+               "                                    0 means one per CPU\n"
+               "     --ordered=BOOL                 Trigger parents before their children when\n"
+               "                                    running parallel jobs (default: yes)\n"
                , program_invocation_short_name);
 
         return 0;
@@ -126,25 +279,28 @@ static int help(void) {
 int trigger_main(int argc, char *argv[], void *userdata) {
         enum {
                 ARG_NAME = 0x100,
+                ARG_ORDERED,
         };
 
         static const struct option options[] = {
-                { "verbose",           no_argument,       NULL, 'v'      },
-                { "dry-run",           no_argument,       NULL, 'n'      },
-                { "type",              required_argument, NULL, 't'      },
-                { "action",            required_argument, NULL, 'c'      },
-                { "subsystem-match",   required_argument, NULL, 's'      },
-                { "subsystem-nomatch", required_argument, NULL, 'S'      },
-                { "attr-match",        required_argument, NULL, 'a'      },
-                { "attr-nomatch",      required_argument, NULL, 'A'      },
-                { "property-match",    required_argument, NULL, 'p'      },
-                { "tag-match",         required_argument, NULL, 'g'      },
-                { "sysname-match",     required_argument, NULL, 'y'      },
-                { "name-match",        required_argument, NULL, ARG_NAME },
-                { "parent-match",      required_argument, NULL, 'b'      },
-                { "settle",            no_argument,       NULL, 'w'      },
-                { "version",           no_argument,       NULL, 'V'      },
-                { "help",              no_argument,       NULL, 'h'      },
+                { "verbose",           no_argument,       NULL, 'v'         },
+                { "dry-run",           no_argument,       NULL, 'n'         },
+                { "type",              required_argument, NULL, 't'         },
+                { "action",            required_argument, NULL, 'c'         },
+                { "subsystem-match",   required_argument, NULL, 's'         },
+                { "subsystem-nomatch", required_argument, NULL, 'S'         },
+                { "attr-match",        required_argument, NULL, 'a'         },
+                { "attr-nomatch",      required_argument, NULL, 'A'         },
+                { "property-match",    required_argument, NULL, 'p'         },
+                { "tag-match",         required_argument, NULL, 'g'         },
+                { "sysname-match",     required_argument, NULL, 'y'         },
+                { "name-match",        required_argument, NULL, ARG_NAME    },
+                { "parent-match",      required_argument, NULL, 'b'         },
+                { "settle",            no_argument,       NULL, 'w'         },
+                { "jobs",              required_argument, NULL, 'j'         },
+                { "ordered",           required_argument, NULL, ARG_ORDERED },
+                { "version",           no_argument,       NULL, 'V'         },
+                { "help",              no_argument,       NULL, 'h'         },
                 {}
         };
         enum {
@@ -172,7 +328,7 @@ int trigger_main(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return r;
 
-        while ((c = getopt_long(argc, argv, "vnt:c:s:S:a:A:p:g:y:b:wVh", options, NULL)) >= 0) {
+        while ((c = getopt_long(argc, argv, "vnt:c:s:S:a:A:p:g:y:b:wj:Vh", options, NULL)) >= 0) {
                 _cleanup_free_ char *buf = NULL;
                 const char *key, *val;
 
@@ -262,6 +418,26 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                         settle = true;
                         break;
 
+                case 'j':
+                        r = safe_atou(optarg, &arg_jobs);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --jobs= value '%s': %m", optarg);
+                        if (arg_jobs == 0) {
+                                cpu_set_t cpu_set;
+
+                                arg_jobs = 1;
+                                if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+                                        arg_jobs = MAX(1, CPU_COUNT(&cpu_set));
+                        }
+                        break;
+
+                case ARG_ORDERED:
+                        r = parse_boolean(optarg);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --ordered= value '%s': %m", optarg);
+                        arg_ordered = r;
+                        break;
+
                 case ARG_NAME: {
                         _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
 
@@ -35,6 +35,7 @@
 #include "cgroup-util.h"
 #include "cpu-set-util.h"
 #include "dev-setup.h"
+#include "device-database.h"
 #include "device-monitor-private.h"
 #include "device-private.h"
 #include "device-util.h"
@@ -57,6 +58,7 @@
 #include "selinux-util.h"
 #include "signal-util.h"
 #include "socket-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "strxcpyx.h"
@@ -75,10 +77,23 @@ static unsigned arg_children_max = 0;
 static usec_t arg_exec_delay_usec = 0;
 static usec_t arg_event_timeout_usec = 180 * USEC_PER_SEC;
 
+/* The worker pool is resized at most once per interval, see manager_adjust_children() */
+#define CHILDREN_ADJUST_INTERVAL_USEC (1 * USEC_PER_SEC)
+/* Number of intervals to wait before growing the pool again, after it had to shrink */
+#define CHILDREN_HOLD_INTERVALS 5
+/* Percentage of time tasks were stalled on CPU or memory, above which the pool shrinks */
+#define CHILDREN_PRESSURE_MAX 40.0
+
+/* Where the timings of processed events are recorded for "systemd-analyze trace", and when to stop doing so */
+#define EVENT_TIMINGS_PATH "/run/udev/event-timings"
+#define EVENT_TIMINGS_SIZE_MAX (4U * 1024U * 1024U)
+
 typedef struct Manager {
         sd_event *event;
         Hashmap *workers;
         LIST_HEAD(struct event, events);
+        struct event *events_tail;
+        Hashmap *event_index; /* struct event_bucket by key, see event_index_keys() */
         const char *cgroup;
         pid_t pid; /* the process that originally allocated the manager object */
 
@@ -100,7 +115,34 @@ typedef struct Manager {
 
         usec_t last_usec;
 
+        /* The number of workers is adjusted between children_min and arg_children_max, depending on the
+         * queue depth, the throughput and the pressure on the system. */
+        unsigned n_cpus;
+        unsigned children_min;
+        unsigned children_target;
+        unsigned children_last_target; /* the target before the pool grew the last time */
+        unsigned children_hold;        /* intervals to wait before growing the pool again */
+        usec_t children_adjust_usec;   /* start of the current measurement interval */
+        unsigned events_done;          /* events processed in the current interval */
+        usec_t events_busy_usec;       /* time spent processing them */
+        uint64_t events_per_sec;       /* throughput of the last interval */
+        usec_t event_avg_usec;         /* average processing time of an event in the last interval */
+        unsigned events_started;       /* events passed to a worker in the current interval */
+        usec_t events_wait_usec;       /* time they waited in the queue */
+        usec_t events_wait_max_usec;
+        usec_t event_wait_avg_usec;    /* average time an event waited in the queue in the last interval */
+        usec_t event_wait_max_usec;    /* longest time an event waited in the queue in the last interval */
+        uint64_t events_total;
+        double pressure;
+
+        uint64_t database_size;        /* size of the database file after it was last imported or compacted */
+
+        int fd_event_timings;
+        uint64_t event_timings_size;
+
+        bool children_grown:1;
         bool stop_exec_queue:1;
+        bool event_timings_full:1;
         bool exit:1;
 } Manager;
 
@@ -119,14 +161,32 @@ struct event {
         sd_device *dev_kernel; /* clone of originally received device */
 
         uint64_t seqnum;
-        uint64_t delaying_seqnum;
+        usec_t queued_usec; /* when the event was queued */
+        usec_t start_usec; /* when the event was passed to a worker */
 
         sd_event_source *timeout_warning_event;
         sd_event_source *timeout_event;
 
+        /* the entries of the event in manager->event_index */
+        struct event_link *links;
+        size_t n_links;
+
         LIST_FIELDS(struct event, event);
 };
 
+/* All queued and running events, that share a key in manager->event_index, in the order of their seqnum. */
+struct event_bucket {
+        char *key;
+        LIST_HEAD(struct event_link, links);
+        struct event_link *links_tail;
+};
+
+struct event_link {
+        struct event *event;
+        struct event_bucket *bucket;
+        LIST_FIELDS(struct event_link, links);
+};
+
 static void event_queue_cleanup(Manager *manager, enum event_state type);
 
 enum worker_state {
@@ -148,12 +208,42 @@ struct worker {
 struct worker_message {
 };
 
+static void event_index_remove(Manager *manager, struct event *event) {
+        size_t i;
+
+        assert(manager);
+        assert(event);
+
+        for (i = 0; i < event->n_links; i++) {
+                struct event_link *link = event->links + i;
+                struct event_bucket *bucket = link->bucket;
+
+                if (bucket->links_tail == link)
+                        bucket->links_tail = link->links_prev;
+                LIST_REMOVE(links, bucket->links, link);
+
+                if (!LIST_IS_EMPTY(bucket->links))
+                        continue;
+
+                hashmap_remove(manager->event_index, bucket->key);
+                free(bucket->key);
+                free(bucket);
+        }
+
+        event->links = mfree(event->links);
+        event->n_links = 0;
+}
+
 static void event_free(struct event *event) {
         if (!event)
                 return;
 
         assert(event->manager);
 
+        event_index_remove(event->manager, event);
+
+        if (event->manager->events_tail == event)
+                event->manager->events_tail = event->event_prev;
         LIST_REMOVE(event, event->manager->events, event);
         sd_device_unref(event->dev);
         sd_device_unref(event->dev_kernel);
@@ -267,6 +357,12 @@ static void worker_attach_event(struct worker *worker, struct event *event) {
         e = worker->manager->event;
 
         assert_se(sd_event_now(e, CLOCK_MONOTONIC, &usec) >= 0);
+        event->start_usec = usec;
+
+        worker->manager->events_started++;
+        worker->manager->events_wait_usec += usec_sub_unsigned(usec, event->queued_usec);
+        worker->manager->events_wait_max_usec = MAX(worker->manager->events_wait_max_usec,
+                                                    usec_sub_unsigned(usec, event->queued_usec));
 
         (void) sd_event_add_time(e, &event->timeout_warning_event, CLOCK_MONOTONIC,
                                  usec + udev_warn_timeout(arg_event_timeout_usec), USEC_PER_SEC, on_event_timeout_warning, event);
@@ -287,12 +383,14 @@ static void manager_clear_for_worker(Manager *manager) {
 
         manager->workers = hashmap_free(manager->workers);
         event_queue_cleanup(manager, EVENT_UNDEF);
+        manager->event_index = hashmap_free(manager->event_index);
 
         manager->monitor = sd_device_monitor_unref(manager->monitor);
         manager->ctrl_conn_blocking = udev_ctrl_connection_unref(manager->ctrl_conn_blocking);
         manager->ctrl = udev_ctrl_unref(manager->ctrl);
 
         manager->worker_watch[READ_END] = safe_close(manager->worker_watch[READ_END]);
+        manager->fd_event_timings = safe_close(manager->fd_event_timings);
 }
 
 static void manager_free(Manager *manager) {
@@ -575,8 +673,8 @@ static void event_run(Manager *manager, struct event *event) {
                 return;
         }
 
-        if (hashmap_size(manager->workers) >= arg_children_max) {
-                if (arg_children_max > 1)
+        if (hashmap_size(manager->workers) >= manager->children_target) {
+                if (manager->children_target > 1)
                         log_debug("Maximum number (%u) of children reached.", hashmap_size(manager->workers));
                 return;
         }
@@ -585,6 +683,116 @@ static void event_run(Manager *manager, struct event *event) {
         worker_spawn(manager, event);
 }
 
+/* Events are indexed by the keys they may conflict with other events on: their devpath, every parent devpath
+ * ("below:"), their device number and their network interface index. See is_device_busy(). */
+static int event_index_keys(struct event *event, char ***ret) {
+        _cleanup_strv_free_ char **keys = NULL;
+        const char *subsystem, *devpath;
+        dev_t devnum;
+        char *key, *p;
+        int ifindex, r;
+
+        assert(event);
+        assert(ret);
+
+        r = sd_device_get_subsystem(event->dev, &subsystem);
+        if (r < 0)
+                return r;
+
+        r = sd_device_get_devpath(event->dev, &devpath);
+        if (r < 0)
+                return r;
+
+        key = strjoina("devpath:", devpath);
+        r = strv_extend(&keys, key);
+        if (r < 0)
+                return r;
+
+        key = strjoina("below:", devpath);
+        for (p = key + STRLEN("below:") + 1; (p = strchr(p, '/')); p++) {
+                *p = '\0';
+                r = strv_extend(&keys, key);
+                *p = '/';
+                if (r < 0)
+                        return r;
+        }
+
+        if (sd_device_get_devnum(event->dev, &devnum) >= 0 && major(devnum) != 0) {
+                r = strv_extendf(&keys, "devnum:%c%u:%u", streq(subsystem, "block") ? 'b' : 'c', major(devnum), minor(devnum));
+                if (r < 0)
+                        return r;
+        }
+
+        if (sd_device_get_ifindex(event->dev, &ifindex) >= 0 && ifindex > 0) {
+                r = strv_extendf(&keys, "ifindex:%i", ifindex);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(keys);
+        return 0;
+}
+
+static int event_index_add(Manager *manager, struct event *event) {
+        _cleanup_strv_free_ char **keys = NULL;
+        char **k;
+        int r;
+
+        assert(manager);
+        assert(event);
+        assert(!event->links);
+
+        r = event_index_keys(event, &keys);
+        if (r < 0)
+                return r;
+
+        r = hashmap_ensure_allocated(&manager->event_index, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        event->links = new0(struct event_link, strv_length(keys));
+        if (!event->links)
+                return -ENOMEM;
+
+        STRV_FOREACH(k, keys) {
+                struct event_bucket *bucket;
+                struct event_link *link;
+
+                bucket = hashmap_get(manager->event_index, *k);
+                if (!bucket) {
+                        _cleanup_free_ struct event_bucket *b = NULL;
+
+                        b = new0(struct event_bucket, 1);
+                        if (!b)
+                                return -ENOMEM;
+
+                        b->key = strdup(*k);
+                        if (!b->key)
+                                return -ENOMEM;
+
+                        r = hashmap_put(manager->event_index, b->key, b);
+                        if (r < 0) {
+                                free(b->key);
+                                return r;
+                        }
+
+                        bucket = TAKE_PTR(b);
+                }
+
+                link = event->links + event->n_links++;
+                *link = (struct event_link) {
+                        .event = event,
+                        .bucket = bucket,
+                };
+
+                /* events are queued in the order of their seqnum, hence the first one in a bucket is the oldest */
+                LIST_INSERT_AFTER(links, bucket->links, bucket->links_tail, link);
+                bucket->links_tail = link;
+        }
+
+        return 0;
+}
+
 static int event_queue_insert(Manager *manager, sd_device *dev) {
         _cleanup_(sd_device_unrefp) sd_device *clone = NULL;
         const char *val, *action;
@@ -639,13 +847,22 @@ static int event_queue_insert(Manager *manager, sd_device *dev) {
                 .state = EVENT_QUEUED,
         };
 
+        assert_se(sd_event_now(manager->event, CLOCK_MONOTONIC, &event->queued_usec) >= 0);
+
         if (LIST_IS_EMPTY(manager->events)) {
                 r = touch("/run/udev/queue");
                 if (r < 0)
                         log_warning_errno(r, "Failed to touch /run/udev/queue: %m");
         }
 
-        LIST_APPEND(event, manager->events, event);
+        LIST_INSERT_AFTER(event, manager->events, manager->events_tail, event);
+        manager->events_tail = event;
+
+        r = event_index_add(manager, event);
+        if (r < 0) {
+                event_free(event);
+                return r;
+        }
 
         log_device_debug(dev, "Device (SEQNUM=%"PRIu64", ACTION=%s) is queued", seqnum, action);
 
@@ -667,27 +884,259 @@ static void manager_kill_workers(Manager *manager) {
         }
 }
 
-/* lookup event for identical, parent, child device */
+static void manager_set_children_max(Manager *manager, unsigned n) {
+        assert(manager);
+
+        arg_children_max = n;
+
+        /* Start out with a couple of workers per CPU, and let the pool grow from there when events queue up */
+        manager->children_min = MIN(n, MAX(2U, 2 * manager->n_cpus));
+        manager->children_target = CLAMP(manager->children_target, manager->children_min, n);
+}
+
+static void manager_reset_children(Manager *manager) {
+        assert(manager);
+
+        manager->children_target = manager->children_min;
+        manager->children_hold = 0;
+        manager->children_grown = false;
+        manager->children_adjust_usec = 0;
+        manager->events_done = 0;
+        manager->events_busy_usec = 0;
+        manager->events_per_sec = 0;
+        manager->events_started = 0;
+        manager->events_wait_usec = 0;
+        manager->events_wait_max_usec = 0;
+}
+
+static void manager_count_events(Manager *manager, unsigned *ret_busy, unsigned *ret_queued) {
+        unsigned n_busy = 0, n_queued = 0;
+        struct worker *worker;
+        struct event *event;
+        Iterator i;
+
+        assert(manager);
+
+        HASHMAP_FOREACH(worker, manager->workers, i)
+                if (worker->state == WORKER_RUNNING)
+                        n_busy++;
+
+        LIST_FOREACH(event, event, manager->events)
+                if (event->state == EVENT_QUEUED)
+                        n_queued++;
+
+        *ret_busy = n_busy;
+        *ret_queued = n_queued;
+}
+
+static double manager_get_pressure(Manager *manager) {
+        CGroupPressure cpu, memory;
+        double load;
+
+        assert(manager);
+
+        if (cg_get_system_pressure(CGROUP_PRESSURE_CPU, &cpu) >= 0 &&
+            cg_get_system_pressure(CGROUP_PRESSURE_MEMORY, &memory) >= 0)
+                return MAX(cpu.avg10, memory.avg10);
+
+        /* Without PSI, estimate the share of runnable tasks that wait for a CPU from the load average */
+        if (getloadavg(&load, 1) < 1 || load <= manager->n_cpus)
+                return 0;
+
+        return 100.0 * (load - manager->n_cpus) / load;
+}
+
+static void manager_trim_workers(Manager *manager) {
+        struct worker *worker;
+        unsigned n = 0;
+        Iterator i;
+
+        assert(manager);
+
+        HASHMAP_FOREACH(worker, manager->workers, i)
+                if (worker->state != WORKER_KILLED)
+                        n++;
+
+        HASHMAP_FOREACH(worker, manager->workers, i) {
+                if (n <= manager->children_target)
+                        break;
+
+                if (worker->state != WORKER_IDLE)
+                        continue;
+
+                worker->state = WORKER_KILLED;
+                (void) kill(worker->pid, SIGTERM);
+                n--;
+        }
+}
+
+static void manager_adjust_children(Manager *manager, usec_t usec) {
+        unsigned n_busy, n_queued, target;
+        uint64_t throughput;
+        usec_t interval;
+
+        assert(manager);
+
+        if (manager->children_adjust_usec == 0) {
+                manager->children_adjust_usec = usec;
+                return;
+        }
+
+        interval = usec_sub_unsigned(usec, manager->children_adjust_usec);
+        if (interval < CHILDREN_ADJUST_INTERVAL_USEC)
+                return;
+
+        throughput = (uint64_t) manager->events_done * USEC_PER_SEC / interval;
+        manager->event_avg_usec = manager->events_done > 0 ? manager->events_busy_usec / manager->events_done : 0;
+        manager->event_wait_avg_usec = manager->events_started > 0 ? manager->events_wait_usec / manager->events_started : 0;
+        manager->event_wait_max_usec = manager->events_wait_max_usec;
+        manager->pressure = manager_get_pressure(manager);
+
+        manager_count_events(manager, &n_busy, &n_queued);
+
+        target = manager->children_target;
+
+        if (manager->pressure >= CHILDREN_PRESSURE_MAX ||
+            manager->event_avg_usec > arg_event_timeout_usec / 3) {
+                /* The system is congested, or events get close to their timeout. More workers would only make
+                 * things worse, hence back off. */
+                target -= MIN(target - manager->children_min, MAX(1U, target / 4));
+                manager->children_hold = CHILDREN_HOLD_INTERVALS;
+                manager->children_grown = false;
+
+        } else if (manager->children_grown && n_queued > 0 &&
+                   throughput * 20 < manager->events_per_sec * 21) {
+                /* The pool grew, but the throughput did not improve by at least 5%, the bottleneck is
+                 * elsewhere. Undo the last step and wait a bit before trying again. */
+                target = MAX(manager->children_last_target, manager->children_min);
+                manager->children_hold = CHILDREN_HOLD_INTERVALS;
+                manager->children_grown = false;
+
+        } else if (manager->children_hold > 0) {
+                manager->children_hold--;
+                manager->children_grown = false;
+
+        } else if (n_queued > 0 && n_busy >= target && target < arg_children_max) {
+                /* Events are waiting for a worker, grow the pool */
+                manager->children_last_target = target;
+                target = MIN(arg_children_max, target + MAX(1U, target / 2));
+                manager->children_grown = true;
+
+        } else
+                manager->children_grown = false;
+
+        if (target != manager->children_target)
+                log_debug("Adjusting number of children from %u to %u (%"PRIu64" events/s, %s per event, %.1f%% pressure)",
+                          manager->children_target, target, throughput,
+                          format_timespan((char[FORMAT_TIMESPAN_MAX]) {}, FORMAT_TIMESPAN_MAX, manager->event_avg_usec, USEC_PER_MSEC),
+                          manager->pressure);
+
+        manager->children_target = target;
+        manager->events_per_sec = throughput;
+        manager->events_done = 0;
+        manager->events_busy_usec = 0;
+        manager->events_started = 0;
+        manager->events_wait_usec = 0;
+        manager->events_wait_max_usec = 0;
+        manager->children_adjust_usec = usec;
+
+        manager_trim_workers(manager);
+}
+
+static void manager_record_event_timing(Manager *manager, struct event *event, usec_t usec) {
+        _cleanup_free_ char *line = NULL;
+        const char *action = NULL, *devpath = NULL;
+        struct stat st;
+        int r;
+
+        assert(manager);
+        assert(event);
+
+        /* Append one line per processed event, with the devpath last as the only field that might contain spaces.
+         * Stop once the file reached its maximum size, so that hotplug activity does not fill up /run over time:
+         * what is interesting is the coldplug during boot. */
+
+        if (manager->event_timings_full)
+                return;
+
+        if (manager->fd_event_timings < 0) {
+                manager->fd_event_timings = open(EVENT_TIMINGS_PATH, O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC|O_NOCTTY, 0644);
+                if (manager->fd_event_timings < 0) {
+                        log_debug_errno(errno, "Failed to open %s, not recording event timings: %m", EVENT_TIMINGS_PATH);
+                        manager->event_timings_full = true;
+                        return;
+                }
+
+                /* The file might have been left behind by the udevd instance of the initrd */
+                if (fstat(manager->fd_event_timings, &st) >= 0)
+                        manager->event_timings_size = st.st_size;
+        }
+
+        if (manager->event_timings_size >= EVENT_TIMINGS_SIZE_MAX) {
+                log_debug("%s reached its maximum size, not recording further event timings.", EVENT_TIMINGS_PATH);
+                manager->fd_event_timings = safe_close(manager->fd_event_timings);
+                manager->event_timings_full = true;
+                return;
+        }
+
+        (void) sd_device_get_property_value(event->dev, "ACTION", &action);
+        (void) sd_device_get_devpath(event->dev, &devpath);
+
+        if (asprintf(&line, "%" PRIu64 " " USEC_FMT " " USEC_FMT " " USEC_FMT " %s %s\n",
+                     event->seqnum, event->queued_usec, event->start_usec, usec, strna(action), strna(devpath)) < 0) {
+                log_oom();
+                return;
+        }
+
+        /* A single write() per line, so that nothing is buffered that the workers could inherit */
+        r = loop_write(manager->fd_event_timings, line, strlen(line), false);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to write to %s, not recording further event timings: %m", EVENT_TIMINGS_PATH);
+                manager->fd_event_timings = safe_close(manager->fd_event_timings);
+                manager->event_timings_full = true;
+                return;
+        }
+
+        manager->event_timings_size += strlen(line);
+}
+
+static void manager_account_event(Manager *manager, struct event *event) {
+        usec_t usec;
+
+        assert(manager);
+        assert(event);
+
+        assert_se(sd_event_now(manager->event, CLOCK_MONOTONIC, &usec) >= 0);
+
+        manager->events_done++;
+        manager->events_total++;
+        manager->events_busy_usec += usec_sub_unsigned(usec, event->start_usec);
+
+        manager_record_event_timing(manager, event, usec);
+}
+
+static bool event_index_has_earlier(Manager *manager, const char *key, uint64_t seqnum) {
+        struct event_bucket *bucket;
+
+        bucket = hashmap_get(manager->event_index, key);
+        return bucket && bucket->links->event->seqnum < seqnum;
+}
+
+/* lookup earlier event for identical, parent, child device */
 static int is_device_busy(Manager *manager, struct event *event) {
         const char *subsystem, *devpath, *devpath_old = NULL;
         dev_t devnum = makedev(0, 0);
-        struct event *loop_event;
-        size_t devpath_len;
         int r, ifindex = 0;
-        bool is_block;
+        char *key, *p;
 
         r = sd_device_get_subsystem(event->dev, &subsystem);
         if (r < 0)
                 return r;
 
-        is_block = streq(subsystem, "block");
-
         r = sd_device_get_devpath(event->dev, &devpath);
         if (r < 0)
                 return r;
 
-        devpath_len = strlen(devpath);
-
         r = sd_device_get_property_value(event->dev, "DEVPATH_OLD", &devpath_old);
         if (r < 0 && r != -ENOENT)
                 return r;
@@ -700,85 +1149,48 @@ static int is_device_busy(Manager *manager, struct event *event) {
         if (r < 0 && r != -ENOENT)
                 return r;
 
-        /* check if queue contains events we depend on */
-        LIST_FOREACH(event, loop_event, manager->events) {
-                size_t loop_devpath_len, common;
-                const char *loop_devpath;
+        /* check major/minor */
+        if (major(devnum) != 0) {
+                char buf[STRLEN("devnum:b") + DECIMAL_STR_MAX(unsigned) * 2 + 1];
 
-                /* we already found a later event, earlier cannot block us, no need to check again */
-                if (loop_event->seqnum < event->delaying_seqnum)
-                        continue;
-
-                /* event we checked earlier still exists, no need to check again */
-                if (loop_event->seqnum == event->delaying_seqnum)
+                xsprintf(buf, "devnum:%c%u:%u", streq(subsystem, "block") ? 'b' : 'c', major(devnum), minor(devnum));
+                if (event_index_has_earlier(manager, buf, event->seqnum))
                         return true;
+        }
 
-                /* found ourself, no later event can block us */
-                if (loop_event->seqnum >= event->seqnum)
-                        break;
-
-                /* check major/minor */
-                if (major(devnum) != 0) {
-                        const char *s;
-                        dev_t d;
-
-                        if (sd_device_get_subsystem(loop_event->dev, &s) < 0)
-                                continue;
-
-                        if (sd_device_get_devnum(loop_event->dev, &d) >= 0 &&
-                            devnum == d && is_block == streq(s, "block"))
-                                return true;
-                }
-
-                /* check network device ifindex */
-                if (ifindex > 0) {
-                        int i;
-
-                        if (sd_device_get_ifindex(loop_event->dev, &i) >= 0 &&
-                            ifindex == i)
-                                return true;
-                }
-
-                if (sd_device_get_devpath(loop_event->dev, &loop_devpath) < 0)
-                        continue;
+        /* check network device ifindex */
+        if (ifindex > 0) {
+                char buf[STRLEN("ifindex:") + DECIMAL_STR_MAX(int)];
 
-                /* check our old name */
-                if (devpath_old && streq(devpath_old, loop_devpath)) {
-                        event->delaying_seqnum = loop_event->seqnum;
+                xsprintf(buf, "ifindex:%i", ifindex);
+                if (event_index_has_earlier(manager, buf, event->seqnum))
                         return true;
-                }
+        }
 
-                loop_devpath_len = strlen(loop_devpath);
+        /* check our old name */
+        if (devpath_old && event_index_has_earlier(manager, strjoina("devpath:", devpath_old), event->seqnum))
+                return true;
 
-                /* compare devpath */
-                common = MIN(devpath_len, loop_devpath_len);
+        /* identical device event found, unless devices names might have changed/swapped in the meantime */
+        key = strjoina("devpath:", devpath);
+        if (major(devnum) == 0 && ifindex <= 0 && event_index_has_earlier(manager, key, event->seqnum))
+                return true;
 
-                /* one devpath is contained in the other? */
-                if (!strneq(devpath, loop_devpath, common))
-                        continue;
+        /* parent device event found */
+        for (p = key + STRLEN("devpath:") + 1; (p = strchr(p, '/')); p++) {
+                bool found;
 
-                /* identical device event found */
-                if (devpath_len == loop_devpath_len) {
-                        /* devices names might have changed/swapped in the meantime */
-                        if (major(devnum) != 0 || ifindex > 0)
-                                continue;
-                        event->delaying_seqnum = loop_event->seqnum;
+                *p = '\0';
+                found = event_index_has_earlier(manager, key, event->seqnum);
+                *p = '/';
+                if (found)
                         return true;
-                }
-
-                /* parent device event found */
-                if (devpath[common] == '/') {
-                        event->delaying_seqnum = loop_event->seqnum;
-                        return true;
-                }
-
-                /* child device event found */
-                if (loop_devpath[common] == '/') {
-                        event->delaying_seqnum = loop_event->seqnum;
-                        return true;
-                }
         }
 
+        /* child device event found */
+        if (event_index_has_earlier(manager, strjoina("below:", devpath), event->seqnum))
+                return true;
+
         return false;
 }
 
@@ -852,6 +1264,7 @@ static int on_kill_workers_event(sd_event_source *s, uint64_t usec, void *userda
 
         log_debug("Cleanup idle workers");
         manager_kill_workers(manager);
+        manager_reset_children(manager);
 
         return 1;
 }
@@ -902,6 +1315,9 @@ static void event_queue_start(Manager *manager) {
 
                 event_run(manager, event);
         }
+
+        /* Now that all workers got something to do, check whether the pool should be resized */
+        manager_adjust_children(manager, usec);
 }
 
 static void event_queue_cleanup(Manager *manager, enum event_state match_type) {
@@ -977,6 +1393,8 @@ static int on_worker(sd_event_source *s, int fd, uint32_t revents, void *userdat
                         worker->state = WORKER_IDLE;
 
                 /* worker returned */
+                if (worker->event)
+                        manager_account_event(manager, worker->event);
                 event_free(worker->event);
         }
 
@@ -1104,16 +1522,59 @@ static int on_ctrl_msg(sd_event_source *s, int fd, uint32_t revents, void *userd
         i = udev_ctrl_get_set_children_max(ctrl_msg);
         if (i >= 0) {
                 log_debug("Receivd udev control message (SET_MAX_CHILDREN), setting children_max=%i", i);
-                arg_children_max = i;
+                manager_set_children_max(manager, i);
 
                 (void) sd_notifyf(false,
                                   "READY=1\n"
                                   "STATUS=Processing with %u children at max", arg_children_max);
         }
 
-        if (udev_ctrl_get_ping(ctrl_msg) > 0)
+        if (udev_ctrl_get_ping(ctrl_msg) > 0) {
+                char status[UDEV_CTRL_MSG_BUF_SIZE], *p = status;
+                unsigned n_busy, n_queued;
+                size_t l = sizeof(status);
+                usec_t usec, oldest_usec = 0;
+                struct event *event;
+
                 log_debug("Received udev control message (SYNC)");
 
+                manager_count_events(manager, &n_busy, &n_queued);
+
+                assert_se(sd_event_now(manager->event, CLOCK_MONOTONIC, &usec) >= 0);
+                LIST_FOREACH(event, event, manager->events)
+                        if (event->state == EVENT_QUEUED) {
+                                oldest_usec = usec_sub_unsigned(usec, event->queued_usec);
+                                break;
+                        }
+
+                /* The reply has room for 255 characters. That's enough for all values short of absurdly large
+                 * ones, in which case the later ones are cut off. */
+                l = strpcpyf(&p, l,
+                             "children_max=%u\n"
+                             "children_target=%u\n"
+                             "workers=%u\n"
+                             "workers_busy=%u\n"
+                             "events_queued=%u\n"
+                             "events_processed=%"PRIu64"\n"
+                             "events_per_sec=%"PRIu64"\n"
+                             "event_avg_usec="USEC_FMT"\n"
+                             "event_wait_avg_usec="USEC_FMT"\n"
+                             "event_wait_max_usec="USEC_FMT"\n"
+                             "queue_oldest_usec="USEC_FMT"\n"
+                             "pressure=%.1f",
+                             arg_children_max, manager->children_target,
+                             hashmap_size(manager->workers), n_busy, n_queued,
+                             manager->events_total, manager->events_per_sec,
+                             manager->event_avg_usec, manager->event_wait_avg_usec,
+                             manager->event_wait_max_usec, oldest_usec, manager->pressure);
+                if (l == 0)
+                        log_debug("Status does not fit into the reply to ping, truncating.");
+
+                r = udev_ctrl_reply_ping(ctrl_msg, status);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to send reply to ping, ignoring: %m");
+        }
+
         if (udev_ctrl_get_exit(ctrl_msg) > 0) {
                 log_debug("Received udev control message (EXIT)");
                 manager_exit(manager);
@@ -1231,6 +1692,7 @@ static int synthesize_change(sd_device *dev) {
                                 continue;
 
                         log_debug("Device '%s' is closed, synthesising partition '%s' 'change'", devname, n);
+                        (void) udev_builtin_blkid_cache_remove(d);
                         strscpyl(filename, sizeof(filename), s, "/uevent", NULL);
                         write_string_file(filename, "change", WRITE_STRING_FILE_DISABLE_BUFFER);
                 }
@@ -1277,8 +1739,11 @@ static int on_inotify(sd_event_source *s, int fd, uint32_t revents, void *userda
                         continue;
 
                 log_device_debug(dev, "Inotify event: %x for %s", e->mask, devnode);
-                if (e->mask & IN_CLOSE_WRITE)
+                if (e->mask & IN_CLOSE_WRITE) {
+                        /* the content may have changed, do not let the change event use stale probe results */
+                        (void) udev_builtin_blkid_cache_remove(dev);
                         synthesize_change(dev);
+                }
                 else if (e->mask & IN_IGNORED)
                         udev_watch_end(dev);
         }
@@ -1372,6 +1837,53 @@ static int on_sigchld(sd_event_source *s, const struct signalfd_siginfo *si, voi
         return 1;
 }
 
+/* Don't bother compacting the database file before it reached this size */
+#define DATABASE_COMPACT_MIN (1U * 1024U * 1024U)
+
+static void manager_maintain_database(Manager *manager) {
+        struct stat st;
+        int r;
+
+        assert(manager);
+
+        /* Only called while no events are processed, so that no worker updates the per-device files while we
+         * import them, or appends a record that is not in them yet. */
+
+        if (stat(DEVICE_DATABASE_PATH, &st) < 0) {
+                if (errno != ENOENT) {
+                        log_debug_errno(errno, "Failed to check %s, ignoring: %m", DEVICE_DATABASE_PATH);
+                        return;
+                }
+
+                r = device_database_import(DEVICE_DATABASE_PATH, "/run/udev/data");
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to import udev database into %s, ignoring: %m", DEVICE_DATABASE_PATH);
+                        return;
+                }
+
+                if (stat(DEVICE_DATABASE_PATH, &st) >= 0)
+                        manager->database_size = st.st_size;
+
+                log_debug("Imported udev database into %s.", DEVICE_DATABASE_PATH);
+                return;
+        }
+
+        /* Every update appends a record, drop the superseded ones once they make up more than half of it */
+        if ((uint64_t) st.st_size < MAX((uint64_t) DATABASE_COMPACT_MIN, 2 * manager->database_size))
+                return;
+
+        r = device_database_compact(DEVICE_DATABASE_PATH, &manager->database_size);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to compact %s, ignoring: %m", DEVICE_DATABASE_PATH);
+                /* Don't try again right away */
+                manager->database_size = st.st_size;
+                return;
+        }
+
+        log_debug("Compacted %s from %"PRIu64" to %"PRIu64" bytes.", DEVICE_DATABASE_PATH,
+                  (uint64_t) st.st_size, manager->database_size);
+}
+
 static int on_post(sd_event_source *s, void *userdata) {
         Manager *manager = userdata;
 
@@ -1380,7 +1892,10 @@ static int on_post(sd_event_source *s, void *userdata) {
         if (!LIST_IS_EMPTY(manager->events))
                 return 1;
 
-        /* There are no pending events. Let's cleanup idle process. */
+        /* There are no pending events. Let's take the chance to tidy up the database file. */
+        manager_maintain_database(manager);
+
+        /* Let's cleanup idle process. */
 
         if (!hashmap_isempty(manager->workers)) {
                 /* There are idle workers */
@@ -1588,6 +2103,7 @@ static int parse_argv(int argc, char *argv[]) {
 
 static int manager_new(Manager **ret, int fd_ctrl, int fd_uevent, const char *cgroup) {
         _cleanup_(manager_freep) Manager *manager = NULL;
+        cpu_set_t cpu_set;
         int r;
 
         assert(ret);
@@ -1599,9 +2115,16 @@ static int manager_new(Manager **ret, int fd_ctrl, int fd_uevent, const char *cg
         *manager = (Manager) {
                 .fd_inotify = -1,
                 .worker_watch = { -1, -1 },
+                .fd_event_timings = -1,
                 .cgroup = cgroup,
+                .n_cpus = 1,
         };
 
+        if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+                manager->n_cpus = MAX(1, CPU_COUNT(&cpu_set));
+
+        manager_set_children_max(manager, arg_children_max);
+
         manager->ctrl = udev_ctrl_new_from_fd(fd_ctrl);
         if (!manager->ctrl)
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Failed to initialize udev control socket");
@@ -1293,6 +1293,21 @@ EOF
 KERNEL=="sda1", GOTO="does-not-exist"
 KERNEL=="sda1", SYMLINK+="right",
 LABEL="exists"
+EOF
+        },
+        {
+                desc            => "rules indexed by literal matches keep their order",
+                devpath         => "/devices/pci0000:00/0000:00:1f.2/host0/target0:0:0/0:0:0:0/block/sda/sda1",
+                exp_name        => "right",
+                not_exp_name    => "wrong",
+                rules           => <<EOF
+SUBSYSTEM=="net", SYMLINK+="wrong"
+KERNEL=="sdb|sda1|sdc", ENV{TEST_ORDER}="1", GOTO="found"
+KERNEL=="sda1", SYMLINK+="wrong"
+LABEL="found"
+ACTION=="remove", SYMLINK+="wrong"
+SUBSYSTEM=="block", ENV{TEST_ORDER}=="1", ENV{TEST_ORDER}="2"
+KERNEL=="sda1", ENV{TEST_ORDER}=="2", SYMLINK+="right"
 EOF
         },
         {